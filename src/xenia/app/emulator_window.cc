@@ -9,6 +9,8 @@
 
 #include "xenia/app/emulator_window.h"
 
+#include <algorithm>
+#include <cfloat>
 #include <filesystem>
 #include <functional>
 #include <memory>
@@ -21,10 +23,14 @@
 #include "third_party/imgui/imgui.h"
 #include "third_party/stb/stb_image_write.h"
 #include "third_party/tomlplusplus/toml.hpp"
+#include "xenia/apu/audio_system.h"
+#include "xenia/apu/xma_context.h"
+#include "xenia/apu/xma_decoder.h"
 #include "xenia/base/assert.h"
 #include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
 #include "xenia/base/debugging.h"
+#include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/platform.h"
 #include "xenia/base/profiling.h"
@@ -36,6 +42,9 @@
 #include "xenia/gpu/d3d12/d3d12_command_processor.h"
 #include "xenia/gpu/graphics_system.h"
 #include "xenia/hid/input_system.h"
+#include "xenia/kernel/kernel_flags.h"
+#include "xenia/kernel/util/export_profiler.h"
+#include "xenia/kernel/util/spinlock_profiler.h"
 #include "xenia/kernel/xam/profile_manager.h"
 #include "xenia/kernel/xam/xam_module.h"
 #include "xenia/kernel/xam/xam_state.h"
@@ -48,6 +57,7 @@
 #include "xenia/ui/presenter.h"
 #include "xenia/ui/ui_event.h"
 #include "xenia/ui/virtual_key.h"
+#include "xenia/vfs/virtual_file_system.h"
 
 // Autogenerated by `xb premake`.
 #include "build/version.h"
@@ -62,6 +72,10 @@ DECLARE_bool(clear_memory_page_state);
 
 DECLARE_bool(d3d12_readback_resolve);
 
+DECLARE_bool(jit_statistics);
+
+DECLARE_path(jit_statistics_path);
+
 DEFINE_bool(fullscreen, false, "Whether to launch the emulator in fullscreen.",
             "Display");
 
@@ -160,6 +174,8 @@ extern std::atomic<int> xam_dialogs_shown_;
 namespace xe {
 namespace app {
 
+using namespace xe::literals;
+
 using xe::ui::FileDropEvent;
 using xe::ui::KeyEvent;
 using xe::ui::MenuItem;
@@ -567,6 +583,443 @@ void EmulatorWindow::DisplayConfigDialog::OnDraw(ImGuiIO& io) {
   }
 }
 
+void EmulatorWindow::XmaContextsDialog::OnDraw(ImGuiIO& io) {
+  apu::AudioSystem* audio_system = emulator_window_.emulator_->audio_system();
+  if (!audio_system) {
+    return;
+  }
+  const apu::XmaDecoder* xma_decoder = audio_system->xma_decoder();
+  if (!xma_decoder) {
+    return;
+  }
+
+  ImGui::SetNextWindowPos(ImVec2(20, 20), ImGuiCond_FirstUseEver);
+  ImGui::SetNextWindowBgAlpha(0.6f);
+  bool dialog_open = true;
+  if (!ImGui::Begin("XMA contexts", &dialog_open,
+                    ImGuiWindowFlags_NoCollapse |
+                        ImGuiWindowFlags_AlwaysAutoResize)) {
+    ImGui::End();
+    return;
+  }
+
+  static const char* const kColumnNames[] = {
+      "Context", "Works",         "Average",       "Last",  "Frames",
+      "Loops",   "Input stalls",  "Output stalls", "Output"};
+  ImGui::Columns(int(xe::countof(kColumnNames)));
+  for (const char* column_name : kColumnNames) {
+    ImGui::TextUnformatted(column_name);
+    ImGui::NextColumn();
+  }
+  ImGui::Separator();
+  for (uint32_t i = 0; i < xma_decoder->context_count(); ++i) {
+    const apu::XmaContext& context = xma_decoder->context(i);
+    if (!context.is_allocated()) {
+      continue;
+    }
+    const apu::XmaContext::Statistics& statistics = context.statistics();
+    uint64_t work_count =
+        statistics.work_count.load(std::memory_order_relaxed);
+    uint64_t work_time_us =
+        statistics.work_time_us.load(std::memory_order_relaxed);
+    ImGui::Text("%u", i);
+    ImGui::NextColumn();
+    ImGui::Text("%llu", static_cast<unsigned long long>(work_count));
+    ImGui::NextColumn();
+    ImGui::Text("%llu us", static_cast<unsigned long long>(
+                               work_count ? work_time_us / work_count : 0));
+    ImGui::NextColumn();
+    ImGui::Text("%u us",
+                statistics.last_work_time_us.load(std::memory_order_relaxed));
+    ImGui::NextColumn();
+    ImGui::Text("%llu",
+                static_cast<unsigned long long>(
+                    statistics.frames_decoded.load(std::memory_order_relaxed)));
+    ImGui::NextColumn();
+    ImGui::Text("%u", statistics.loops.load(std::memory_order_relaxed));
+    ImGui::NextColumn();
+    ImGui::Text("%u", statistics.input_stalls.load(std::memory_order_relaxed));
+    ImGui::NextColumn();
+    ImGui::Text("%u",
+                statistics.output_stalls.load(std::memory_order_relaxed));
+    ImGui::NextColumn();
+    ImGui::Text(
+        "%u/%u blocks",
+        statistics.output_blocks_filled.load(std::memory_order_relaxed),
+        statistics.output_blocks_total.load(std::memory_order_relaxed));
+    ImGui::NextColumn();
+  }
+  ImGui::Columns(1);
+
+  ImGui::End();
+
+  if (!dialog_open) {
+    emulator_window_.ToggleXmaContextsDialog();
+    // `this` might have been destroyed by ToggleXmaContextsDialog.
+    return;
+  }
+}
+
+void EmulatorWindow::KernelExportsDialog::OnDraw(ImGuiIO& io) {
+  using kernel::util::ExportProfiler;
+  using kernel::util::SpinLockProfiler;
+
+  ImGui::SetNextWindowPos(ImVec2(20, 20), ImGuiCond_FirstUseEver);
+  ImGui::SetNextWindowSize(ImVec2(760, 480), ImGuiCond_FirstUseEver);
+  ImGui::SetNextWindowBgAlpha(0.6f);
+  bool dialog_open = true;
+  if (!ImGui::Begin("Kernel export profile", &dialog_open,
+                    ImGuiWindowFlags_NoCollapse)) {
+    ImGui::End();
+    return;
+  }
+
+  ImGui::Checkbox("Profile kernel exports", &cvars::profile_kernel_exports);
+  ImGui::SameLine();
+  if (ImGui::Button("Reset")) {
+    ExportProfiler::Reset();
+    SpinLockProfiler::Reset();
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Dump to CSV")) {
+    ExportProfiler::DumpStatistics(cvars::kernel_export_profile_path);
+  }
+  ImGui::Separator();
+
+  // The exports taking the most time in total first.
+  std::vector<ExportProfiler::ExportStatistics> statistics =
+      ExportProfiler::GetStatistics();
+  std::sort(statistics.begin(), statistics.end(),
+            [](const auto& a, const auto& b) {
+              return a.host_ticks > b.host_ticks;
+            });
+  double ticks_to_us =
+      1000000.0 / static_cast<double>(Clock::QueryHostTickFrequency());
+
+  // The locks waited for the longest first.
+  std::vector<SpinLockProfiler::LockStatistics> lock_statistics =
+      SpinLockProfiler::GetStatistics();
+  if (ImGui::CollapsingHeader("Spinlock contention")) {
+    std::sort(lock_statistics.begin(), lock_statistics.end(),
+              [](const auto& a, const auto& b) {
+                return a.wait_host_ticks > b.wait_host_ticks;
+              });
+    static const char* const kLockColumnNames[] = {
+        "Lock", "Contended", "Failed tries", "Spins", "Yields", "Waited"};
+    ImGui::Columns(int(xe::countof(kLockColumnNames)), "spinlocks");
+    for (const char* column_name : kLockColumnNames) {
+      ImGui::TextUnformatted(column_name);
+      ImGui::NextColumn();
+    }
+    ImGui::Separator();
+    for (const auto& lock : lock_statistics) {
+      ImGui::Text("%08X", lock.guest_address);
+      ImGui::NextColumn();
+      ImGui::Text("%llu",
+                  static_cast<unsigned long long>(lock.contended_count));
+      ImGui::NextColumn();
+      ImGui::Text("%llu",
+                  static_cast<unsigned long long>(lock.failed_try_count));
+      ImGui::NextColumn();
+      ImGui::Text("%llu", static_cast<unsigned long long>(lock.spin_count));
+      ImGui::NextColumn();
+      ImGui::Text("%llu", static_cast<unsigned long long>(lock.yield_count));
+      ImGui::NextColumn();
+      ImGui::Text("%.3f ms", lock.wait_host_ticks * ticks_to_us / 1000.0);
+      ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+    ImGui::Separator();
+  }
+
+  static const char* const kColumnNames[] = {
+      "Export", "Calls", "Total", "Average", "Latency (log2 us)"};
+  ImGui::BeginChild("exports");
+  ImGui::Columns(int(xe::countof(kColumnNames)));
+  for (const char* column_name : kColumnNames) {
+    ImGui::TextUnformatted(column_name);
+    ImGui::NextColumn();
+  }
+  ImGui::Separator();
+  for (const auto& export_statistics : statistics) {
+    double total_us = export_statistics.host_ticks * ticks_to_us;
+    ImGui::Text("%s!%s", export_statistics.module_name,
+                export_statistics.export_entry->name);
+    ImGui::NextColumn();
+    ImGui::Text("%llu",
+                static_cast<unsigned long long>(export_statistics.call_count));
+    ImGui::NextColumn();
+    ImGui::Text("%.3f ms", total_us / 1000.0);
+    ImGui::NextColumn();
+    ImGui::Text("%.2f us", total_us / export_statistics.call_count);
+    ImGui::NextColumn();
+    float latency_buckets[ExportProfiler::kLatencyBucketCount];
+    for (uint32_t i = 0; i < ExportProfiler::kLatencyBucketCount; ++i) {
+      latency_buckets[i] = float(export_statistics.latency_buckets[i]);
+    }
+    ImGui::PushID(export_statistics.export_entry);
+    ImGui::PlotHistogram("", latency_buckets,
+                         int(xe::countof(latency_buckets)), 0, nullptr, 0.0f,
+                         FLT_MAX, ImVec2(0, ImGui::GetTextLineHeight()));
+    ImGui::PopID();
+    ImGui::NextColumn();
+  }
+  ImGui::Columns(1);
+  ImGui::EndChild();
+
+  ImGui::End();
+
+  if (!dialog_open) {
+    emulator_window_.ToggleKernelExportsDialog();
+    // `this` might have been destroyed by ToggleKernelExportsDialog.
+    return;
+  }
+}
+
+void EmulatorWindow::MemoryHeapsDialog::OnDraw(ImGuiIO& io) {
+  Memory* memory = emulator_window_.emulator_->memory();
+  if (!memory) {
+    return;
+  }
+
+  // Walking the page tables takes the global lock, so the statistics are only
+  // sampled periodically rather than every frame.
+  uint64_t host_ticks = Clock::QueryHostTickCount();
+  uint64_t host_tick_frequency = Clock::QueryHostTickFrequency();
+  uint64_t sample_interval_ticks =
+      host_tick_frequency * kSampleIntervalMs / 1000;
+  if (statistics_.empty() ||
+      host_ticks - last_sample_host_ticks_ >= sample_interval_ticks) {
+    std::vector<HeapStatistics> statistics;
+    memory->GetHeapStatistics(statistics);
+    alloc_rate_history_.resize(statistics.size());
+    if (!statistics_.empty()) {
+      double seconds = double(host_ticks - last_sample_host_ticks_) /
+                       double(host_tick_frequency);
+      for (size_t i = 0; i < statistics.size(); ++i) {
+        std::vector<float>& history = alloc_rate_history_[i];
+        if (history.size() >= kHistoryLength) {
+          history.erase(history.begin());
+        }
+        history.push_back(float(
+            (statistics[i].alloc_count - statistics_[i].alloc_count) /
+            seconds));
+      }
+    }
+    statistics_ = std::move(statistics);
+    last_sample_host_ticks_ = host_ticks;
+  }
+
+  ImGui::SetNextWindowPos(ImVec2(20, 20), ImGuiCond_FirstUseEver);
+  ImGui::SetNextWindowBgAlpha(0.6f);
+  bool dialog_open = true;
+  if (!ImGui::Begin("Guest memory heaps", &dialog_open,
+                    ImGuiWindowFlags_NoCollapse |
+                        ImGuiWindowFlags_AlwaysAutoResize)) {
+    ImGui::End();
+    return;
+  }
+
+  static const char* const kColumnNames[] = {
+      "Heap",         "Page size",   "Usage",
+      "Committed",    "Reserved",    "Free",
+      "Largest free", "Allocations", "Failed",
+      "Allocations/s"};
+  ImGui::Columns(int(xe::countof(kColumnNames)));
+  for (const char* column_name : kColumnNames) {
+    ImGui::TextUnformatted(column_name);
+    ImGui::NextColumn();
+  }
+  ImGui::Separator();
+  for (size_t i = 0; i < statistics_.size(); ++i) {
+    const HeapStatistics& heap = statistics_[i];
+    uint32_t page_kb = heap.page_size / 1024;
+    ImGui::TextUnformatted(heap.name);
+    ImGui::NextColumn();
+    ImGui::Text("%u KB", page_kb);
+    ImGui::NextColumn();
+    // The committed share first, then the share only reserved.
+    float committed =
+        float(heap.committed_page_count) / float(heap.total_page_count);
+    float reserved = float(heap.committed_page_count +
+                           heap.reserved_page_count) /
+                     float(heap.total_page_count);
+    ImGui::ProgressBar(committed, ImVec2(80, 0), "");
+    ImGui::SameLine();
+    ImGui::Text("%.0f%%/%.0f%%", committed * 100.0f, reserved * 100.0f);
+    ImGui::NextColumn();
+    ImGui::Text("%llu KB",
+                static_cast<unsigned long long>(heap.committed_page_count) *
+                    page_kb);
+    ImGui::NextColumn();
+    ImGui::Text("%llu KB",
+                static_cast<unsigned long long>(heap.reserved_page_count) *
+                    page_kb);
+    ImGui::NextColumn();
+    ImGui::Text("%llu KB in %u",
+                static_cast<unsigned long long>(heap.unreserved_page_count) *
+                    page_kb,
+                heap.free_range_count);
+    ImGui::NextColumn();
+    // Highlight the heaps where large allocations are about to fail.
+    bool is_exhausted = heap.largest_free_range * 16 < heap.total_page_count;
+    if (is_exhausted) {
+      ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.3f, 0.3f, 1.0f));
+    }
+    ImGui::Text("%llu KB",
+                static_cast<unsigned long long>(heap.largest_free_range) *
+                    page_kb);
+    if (is_exhausted) {
+      ImGui::PopStyleColor();
+    }
+    ImGui::NextColumn();
+    ImGui::Text("%llu", static_cast<unsigned long long>(heap.alloc_count));
+    ImGui::NextColumn();
+    ImGui::Text("%llu",
+                static_cast<unsigned long long>(heap.alloc_failure_count));
+    ImGui::NextColumn();
+    const std::vector<float>& history = alloc_rate_history_[i];
+    std::string alloc_rate =
+        history.empty() ? std::string() : fmt::format("{:.0f}", history.back());
+    ImGui::PushID(int(i));
+    ImGui::PlotLines("", history.data(), int(history.size()), 0,
+                     alloc_rate.c_str(), 0.0f, FLT_MAX,
+                     ImVec2(120, ImGui::GetTextLineHeight()));
+    ImGui::PopID();
+    ImGui::NextColumn();
+  }
+  ImGui::Columns(1);
+
+  ImGui::End();
+
+  if (!dialog_open) {
+    emulator_window_.ToggleMemoryHeapsDialog();
+    // `this` might have been destroyed by ToggleMemoryHeapsDialog.
+    return;
+  }
+}
+
+void EmulatorWindow::VfsStatisticsDialog::OnDraw(ImGuiIO& io) {
+  vfs::VirtualFileSystem* file_system =
+      emulator_window_.emulator_->file_system();
+  if (!file_system) {
+    return;
+  }
+
+  uint64_t host_ticks = Clock::QueryHostTickCount();
+  uint64_t host_tick_frequency = Clock::QueryHostTickFrequency();
+  uint64_t sample_interval_ticks =
+      host_tick_frequency * kSampleIntervalMs / 1000;
+  if (statistics_.empty() ||
+      host_ticks - last_sample_host_ticks_ >= sample_interval_ticks) {
+    std::vector<vfs::DeviceStatistics> statistics;
+    file_system->GetDeviceStatistics(statistics);
+    if (statistics.size() != statistics_.size()) {
+      // Devices have been mounted or unmounted, the history doesn't match.
+      read_rate_history_.clear();
+      statistics_.clear();
+    }
+    read_rate_history_.resize(statistics.size());
+    if (!statistics_.empty()) {
+      double seconds = double(host_ticks - last_sample_host_ticks_) /
+                       double(host_tick_frequency);
+      for (size_t i = 0; i < statistics.size(); ++i) {
+        std::vector<float>& history = read_rate_history_[i];
+        if (history.size() >= kHistoryLength) {
+          history.erase(history.begin());
+        }
+        uint64_t read_bytes =
+            statistics[i].read_bytes >= statistics_[i].read_bytes
+                ? statistics[i].read_bytes - statistics_[i].read_bytes
+                : 0;
+        history.push_back(float(read_bytes / (1024.0 * 1024.0) / seconds));
+      }
+    }
+    statistics_ = std::move(statistics);
+    last_sample_host_ticks_ = host_ticks;
+  }
+
+  ImGui::SetNextWindowPos(ImVec2(20, 20), ImGuiCond_FirstUseEver);
+  ImGui::SetNextWindowBgAlpha(0.6f);
+  bool dialog_open = true;
+  if (!ImGui::Begin("File I/O statistics", &dialog_open,
+                    ImGuiWindowFlags_NoCollapse |
+                        ImGuiWindowFlags_AlwaysAutoResize)) {
+    ImGui::End();
+    return;
+  }
+
+  double ticks_to_us = 1000000.0 / double(host_tick_frequency);
+  static const char* const kColumnNames[] = {
+      "Device", "Reads",   "Read",   "Read MB/s", "Average",
+      "Max",    "Latency", "Writes", "Written",   "Cache hits"};
+  ImGui::Columns(int(xe::countof(kColumnNames)));
+  for (const char* column_name : kColumnNames) {
+    ImGui::TextUnformatted(column_name);
+    ImGui::NextColumn();
+  }
+  ImGui::Separator();
+  for (size_t i = 0; i < statistics_.size(); ++i) {
+    const vfs::DeviceStatistics& device = statistics_[i];
+    ImGui::Text("%s (%s)", device.mount_path.c_str(), device.name.c_str());
+    ImGui::NextColumn();
+    ImGui::Text("%llu", static_cast<unsigned long long>(device.read_count));
+    ImGui::NextColumn();
+    ImGui::Text("%.1f MB", device.read_bytes / (1024.0 * 1024.0));
+    ImGui::NextColumn();
+    const std::vector<float>& history = read_rate_history_[i];
+    std::string read_rate =
+        history.empty() ? std::string() : fmt::format("{:.1f}", history.back());
+    ImGui::PushID(int(i));
+    ImGui::PlotLines("##read_rate", history.data(), int(history.size()), 0,
+                     read_rate.c_str(), 0.0f, FLT_MAX,
+                     ImVec2(120, ImGui::GetTextLineHeight()));
+    ImGui::NextColumn();
+    if (device.read_count) {
+      ImGui::Text("%.1f us",
+                  device.read_host_ticks * ticks_to_us / device.read_count);
+    } else {
+      ImGui::TextUnformatted("-");
+    }
+    ImGui::NextColumn();
+    ImGui::Text("%.1f us", device.read_max_host_ticks * ticks_to_us);
+    ImGui::NextColumn();
+    float latency_buckets[vfs::DeviceStatistics::kLatencyBucketCount];
+    for (uint32_t j = 0; j < vfs::DeviceStatistics::kLatencyBucketCount;
+         ++j) {
+      latency_buckets[j] = float(device.read_latency_buckets[j]);
+    }
+    ImGui::PlotHistogram("##latency", latency_buckets,
+                         int(xe::countof(latency_buckets)), 0, nullptr, 0.0f,
+                         FLT_MAX, ImVec2(0, ImGui::GetTextLineHeight()));
+    ImGui::PopID();
+    ImGui::NextColumn();
+    ImGui::Text("%llu", static_cast<unsigned long long>(device.write_count));
+    ImGui::NextColumn();
+    ImGui::Text("%.1f MB", device.write_bytes / (1024.0 * 1024.0));
+    ImGui::NextColumn();
+    uint64_t cache_access_count =
+        device.cache_hit_count + device.cache_miss_count;
+    if (cache_access_count) {
+      ImGui::Text("%.1f%% of %llu",
+                  device.cache_hit_count * 100.0 / cache_access_count,
+                  static_cast<unsigned long long>(cache_access_count));
+    } else {
+      ImGui::TextUnformatted("-");
+    }
+    ImGui::NextColumn();
+  }
+  ImGui::Columns(1);
+
+  ImGui::End();
+
+  if (!dialog_open) {
+    emulator_window_.ToggleVfsStatisticsDialog();
+    // `this` might have been destroyed by ToggleVfsStatisticsDialog.
+    return;
+  }
+}
+
 bool EmulatorWindow::Initialize() {
   window_->AddListener(&window_listener_);
   window_->AddInputListener(&window_listener_, kZOrderEmulatorWindowInput);
@@ -641,6 +1094,18 @@ bool EmulatorWindow::Initialize() {
     cpu_menu->AddChild(MenuItem::Create(MenuItem::Type::kString,
                                         "&Pause/Resume Profiler", "`",
                                         []() { Profiler::TogglePause(); }));
+    cpu_menu->AddChild(MenuItem::Create(
+        MenuItem::Type::kString, "Dump &JIT Statistics",
+        std::bind(&EmulatorWindow::CpuDumpJitStatistics, this)));
+    cpu_menu->AddChild(MenuItem::Create(
+        MenuItem::Type::kString, "Show &Kernel Export Profile",
+        std::bind(&EmulatorWindow::ToggleKernelExportsDialog, this)));
+    cpu_menu->AddChild(MenuItem::Create(
+        MenuItem::Type::kString, "Show Guest &Memory Heaps",
+        std::bind(&EmulatorWindow::ToggleMemoryHeapsDialog, this)));
+    cpu_menu->AddChild(MenuItem::Create(
+        MenuItem::Type::kString, "Show &File I/O Statistics",
+        std::bind(&EmulatorWindow::ToggleVfsStatisticsDialog, this)));
   }
   cpu_menu->AddChild(MenuItem::Create(MenuItem::Type::kSeparator));
   {
@@ -669,6 +1134,15 @@ bool EmulatorWindow::Initialize() {
   }
   main_menu->AddChild(std::move(gpu_menu));
 
+  // APU menu.
+  auto apu_menu = MenuItem::Create(MenuItem::Type::kPopup, "&APU");
+  {
+    apu_menu->AddChild(MenuItem::Create(
+        MenuItem::Type::kString, "Show &XMA Contexts",
+        std::bind(&EmulatorWindow::ToggleXmaContextsDialog, this)));
+  }
+  main_menu->AddChild(std::move(apu_menu));
+
   // Display menu.
   auto display_menu = MenuItem::Create(MenuItem::Type::kPopup, "&Display");
   {
@@ -1043,8 +1517,9 @@ void EmulatorWindow::FileOpen() {
   file_picker->set_multi_selection(false);
   file_picker->set_title("Select Content Package");
   file_picker->set_extensions({
-      {"Supported Files", "*.iso;*.xex;*.zar;*.*"},
+      {"Supported Files", "*.iso;*.xcz;*.xex;*.zar;*.*"},
       {"Disc Image (*.iso)", "*.iso"},
+      {"Compressed Disc Image (*.xcz)", "*.xcz"},
       {"Disc Archive (*.zar)", "*.zar"},
       {"Xbox Executable (*.xex)", "*.xex"},
       //{"Content Package (*.xcp)", "*.xcp" },
@@ -1301,8 +1776,9 @@ void EmulatorWindow::CreateZarchive() {
 
       XELOGI("Creating zar package: {}\n", zarchive_file.filename().string());
 
-      auto result =
-          emulator_->CreateZarchivePackage(abs_content_dir, zarchive_file);
+      Emulator::ZarchivePackStatistics statistics;
+      auto result = emulator_->CreateZarchivePackage(
+          abs_content_dir, zarchive_file, &statistics);
 
       if (result != X_ERROR_SUCCESS) {
         std::error_code ec;
@@ -1314,7 +1790,13 @@ void EmulatorWindow::CreateZarchive() {
 
         XELOGE("Failed to create Zarchive package.", result);
       } else {
-        summary += fmt::format("\nSuccess: {}", path_to_utf8(zarchive_file));
+        summary += fmt::format(
+            "\nSuccess: {} ({} MB into {} MB, {:.1f} MB/s)",
+            path_to_utf8(zarchive_file), statistics.input_size / 1_MiB,
+            statistics.output_size / 1_MiB,
+            statistics.seconds > 0.0 ? double(statistics.input_size) /
+                                           double(1_MiB) / statistics.seconds
+                                     : 0.0);
       }
     }
 
@@ -1351,6 +1833,17 @@ void EmulatorWindow::CpuTimeScalarSetDouble() {
   UpdateTitle();
 }
 
+void EmulatorWindow::CpuDumpJitStatistics() {
+  if (!cvars::jit_statistics) {
+    xe::ui::ImGuiDialog::ShowMessageBox(
+        imgui_drawer_.get(), "JIT Statistics",
+        "Xenia must be launched with the --jit_statistics flag in order to "
+        "gather JIT statistics.");
+    return;
+  }
+  emulator()->processor()->DumpJitStatistics(cvars::jit_statistics_path);
+}
+
 void EmulatorWindow::CpuBreakIntoDebugger() {
   if (!cvars::debug) {
     xe::ui::ImGuiDialog::ShowMessageBox(imgui_drawer_.get(), "Xenia Debugger",
@@ -1393,6 +1886,42 @@ void EmulatorWindow::ToggleFullscreen() {
   SetFullscreen(!window_->IsFullscreen());
 }
 
+void EmulatorWindow::ToggleXmaContextsDialog() {
+  if (!xma_contexts_dialog_) {
+    xma_contexts_dialog_ = std::unique_ptr<XmaContextsDialog>(
+        new XmaContextsDialog(imgui_drawer_.get(), *this));
+  } else {
+    xma_contexts_dialog_.reset();
+  }
+}
+
+void EmulatorWindow::ToggleKernelExportsDialog() {
+  if (!kernel_exports_dialog_) {
+    kernel_exports_dialog_ = std::unique_ptr<KernelExportsDialog>(
+        new KernelExportsDialog(imgui_drawer_.get(), *this));
+  } else {
+    kernel_exports_dialog_.reset();
+  }
+}
+
+void EmulatorWindow::ToggleMemoryHeapsDialog() {
+  if (!memory_heaps_dialog_) {
+    memory_heaps_dialog_ = std::unique_ptr<MemoryHeapsDialog>(
+        new MemoryHeapsDialog(imgui_drawer_.get(), *this));
+  } else {
+    memory_heaps_dialog_.reset();
+  }
+}
+
+void EmulatorWindow::ToggleVfsStatisticsDialog() {
+  if (!vfs_statistics_dialog_) {
+    vfs_statistics_dialog_ = std::unique_ptr<VfsStatisticsDialog>(
+        new VfsStatisticsDialog(imgui_drawer_.get(), *this));
+  } else {
+    vfs_statistics_dialog_.reset();
+  }
+}
+
 void EmulatorWindow::ToggleDisplayConfigDialog() {
   if (!display_config_dialog_) {
     display_config_dialog_ = std::unique_ptr<DisplayConfigDialog>(
@@ -2017,6 +2546,22 @@ xe::X_STATUS EmulatorWindow::RunTitle(
     display_config_dialog_.reset();
   }
 
+  if (xma_contexts_dialog_) {
+    xma_contexts_dialog_.reset();
+  }
+
+  if (kernel_exports_dialog_) {
+    kernel_exports_dialog_.reset();
+  }
+
+  if (memory_heaps_dialog_) {
+    memory_heaps_dialog_.reset();
+  }
+
+  if (vfs_statistics_dialog_) {
+    vfs_statistics_dialog_.reset();
+  }
+
   imgui_drawer_.get()->ClearDialogs();
 
   if (result) {
@@ -12,6 +12,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "xenia/emulator.h"
 #include "xenia/gpu/command_processor.h"
@@ -23,6 +24,7 @@
 #include "xenia/ui/window.h"
 #include "xenia/ui/window_listener.h"
 #include "xenia/ui/windowed_app_context.h"
+#include "xenia/vfs/device.h"
 #include "xenia/xbox.h"
 
 #include "xenia/app/profile_dialogs.h"
@@ -186,6 +188,74 @@ class EmulatorWindow {
     EmulatorWindow& emulator_window_;
   };
 
+  class XmaContextsDialog final : public ui::ImGuiDialog {
+   public:
+    XmaContextsDialog(ui::ImGuiDrawer* imgui_drawer,
+                      EmulatorWindow& emulator_window)
+        : ui::ImGuiDialog(imgui_drawer), emulator_window_(emulator_window) {}
+
+   protected:
+    void OnDraw(ImGuiIO& io) override;
+
+   private:
+    EmulatorWindow& emulator_window_;
+  };
+
+  class KernelExportsDialog final : public ui::ImGuiDialog {
+   public:
+    KernelExportsDialog(ui::ImGuiDrawer* imgui_drawer,
+                        EmulatorWindow& emulator_window)
+        : ui::ImGuiDialog(imgui_drawer), emulator_window_(emulator_window) {}
+
+   protected:
+    void OnDraw(ImGuiIO& io) override;
+
+   private:
+    EmulatorWindow& emulator_window_;
+  };
+
+  class MemoryHeapsDialog final : public ui::ImGuiDialog {
+   public:
+    MemoryHeapsDialog(ui::ImGuiDrawer* imgui_drawer,
+                      EmulatorWindow& emulator_window)
+        : ui::ImGuiDialog(imgui_drawer), emulator_window_(emulator_window) {}
+
+   protected:
+    void OnDraw(ImGuiIO& io) override;
+
+   private:
+    // Samples taken at this interval for the allocation rate graphs.
+    static constexpr uint32_t kSampleIntervalMs = 250;
+    static constexpr uint32_t kHistoryLength = 120;
+
+    EmulatorWindow& emulator_window_;
+    std::vector<HeapStatistics> statistics_;
+    uint64_t last_sample_host_ticks_ = 0;
+    // Allocations per second of every heap, oldest first.
+    std::vector<std::vector<float>> alloc_rate_history_;
+  };
+
+  class VfsStatisticsDialog final : public ui::ImGuiDialog {
+   public:
+    VfsStatisticsDialog(ui::ImGuiDrawer* imgui_drawer,
+                        EmulatorWindow& emulator_window)
+        : ui::ImGuiDialog(imgui_drawer), emulator_window_(emulator_window) {}
+
+   protected:
+    void OnDraw(ImGuiIO& io) override;
+
+   private:
+    // Samples taken at this interval for the throughput graphs.
+    static constexpr uint32_t kSampleIntervalMs = 250;
+    static constexpr uint32_t kHistoryLength = 120;
+
+    EmulatorWindow& emulator_window_;
+    std::vector<vfs::DeviceStatistics> statistics_;
+    uint64_t last_sample_host_ticks_ = 0;
+    // Megabytes read per second from every device, oldest first.
+    std::vector<std::vector<float>> read_rate_history_;
+  };
+
   explicit EmulatorWindow(Emulator* emulator,
                           ui::WindowedAppContext& app_context, uint32_t width,
                           uint32_t height);
@@ -222,10 +292,15 @@ class EmulatorWindow {
   void CpuTimeScalarReset();
   void CpuTimeScalarSetHalf();
   void CpuTimeScalarSetDouble();
+  void CpuDumpJitStatistics();
+  void ToggleKernelExportsDialog();
+  void ToggleMemoryHeapsDialog();
+  void ToggleVfsStatisticsDialog();
   void CpuBreakIntoDebugger();
   void CpuBreakIntoHostDebugger();
   void GpuTraceFrame();
   void GpuClearCaches();
+  void ToggleXmaContextsDialog();
   void ToggleDisplayConfigDialog();
   void ToggleControllerVibration();
   void ShowCompatibility();
@@ -266,6 +341,10 @@ class EmulatorWindow {
   bool initializing_shader_storage_ = false;
 
   std::unique_ptr<DisplayConfigDialog> display_config_dialog_;
+  std::unique_ptr<XmaContextsDialog> xma_contexts_dialog_;
+  std::unique_ptr<KernelExportsDialog> kernel_exports_dialog_;
+  std::unique_ptr<MemoryHeapsDialog> memory_heaps_dialog_;
+  std::unique_ptr<VfsStatisticsDialog> vfs_statistics_dialog_;
 
   // Storing pointers and toggling dialog state is useful for broadcasting
   // messages back to guest.
@@ -23,6 +23,7 @@
 #include "xenia/base/logging.h"
 #include "xenia/base/platform.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/startup_timeline.h"
 #include "xenia/base/threading.h"
 #include "xenia/config.h"
 #include "xenia/debug/ui/debug_window.h"
@@ -389,6 +390,7 @@ bool EmulatorApp::OnInitialize() {
 #endif
   Profiler::Initialize();
   Profiler::ThreadEnter("Main");
+  StartupTimelinePhase startup_phase("EmulatorApp::OnInitialize");
 
   // Figure out where internal files and content should go.
   std::filesystem::path storage_root = cvars::storage_root;
@@ -453,8 +455,11 @@ bool EmulatorApp::OnInitialize() {
   auto res = xe::gpu::GraphicsSystem::GetInternalDisplayResolution();
 
   // Main emulator display window.
-  emulator_window_ = EmulatorWindow::Create(emulator_.get(), app_context(),
-                                            res.first, res.second);
+  {
+    StartupTimelinePhase window_phase("Main window creation");
+    emulator_window_ = EmulatorWindow::Create(emulator_.get(), app_context(),
+                                              res.first, res.second);
+  }
   if (!emulator_window_) {
     XELOGE("Failed to create the main emulator window");
     return false;
@@ -610,6 +615,9 @@ void EmulatorApp::EmulatorThread() {
     }
   });
 
+  emulator_->on_benchmark_complete.AddListener(
+      [this]() { app_context().RequestDeferredQuit(); });
+
   // Enable emulator input now that the emulator is properly loaded.
   app_context().CallInUIThread(
       [this]() { emulator_window_->OnEmulatorInitialized(); });
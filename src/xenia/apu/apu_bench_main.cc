@@ -0,0 +1,273 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "xenia/apu/conversion.h"
+#include "xenia/apu/xma_context.h"
+#include "xenia/apu/xma_context_dump.h"
+#include "xenia/apu/xma_context_new.h"
+#include "xenia/apu/xma_context_old.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/console_app_main.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/memory.h"
+
+DEFINE_path(xma_dump_input, "",
+            "XMA context dump recorded with --xma_context_dump_path to replay "
+            "through both XMA decoders.",
+            "APU");
+DEFINE_uint32(conversion_bench_frames, 100000,
+              "Number of 5.1 frames to convert in the sample conversion "
+              "benchmark, 0 to skip it.",
+              "APU");
+
+namespace xe {
+namespace apu {
+
+struct DumpRecord {
+  XmaContextDumpRecord record;
+  std::vector<uint8_t> input_buffers[2];
+};
+
+static double GetHostTicksSeconds(uint64_t host_ticks) {
+  return double(host_ticks) / double(Clock::QueryHostTickFrequency());
+}
+
+static bool LoadXmaContextDump(const std::filesystem::path& path,
+                               std::vector<DumpRecord>& records) {
+  FILE* file = filesystem::OpenFile(path, "rb");
+  if (!file) {
+    XELOGE("Unable to open the XMA context dump: {}", xe::path_to_utf8(path));
+    return false;
+  }
+  XmaContextDumpHeader header;
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      header.signature != kXmaContextDumpSignature ||
+      header.version != kXmaContextDumpVersion) {
+    XELOGE("{} is not a supported XMA context dump", xe::path_to_utf8(path));
+    fclose(file);
+    return false;
+  }
+  DumpRecord record;
+  while (fread(&record.record, sizeof(record.record), 1, file) == 1) {
+    bool is_complete = true;
+    for (uint32_t i = 0; i < 2; ++i) {
+      record.input_buffers[i].resize(record.record.input_buffer_sizes[i]);
+      if (!record.input_buffers[i].empty() &&
+          fread(record.input_buffers[i].data(), 1,
+                record.input_buffers[i].size(),
+                file) != record.input_buffers[i].size()) {
+        is_complete = false;
+      }
+    }
+    if (!is_complete) {
+      XELOGW("The XMA context dump is truncated");
+      break;
+    }
+    records.push_back(record);
+  }
+  fclose(file);
+  return true;
+}
+
+// Replays the kicks of the dump, in their order, through contexts of the
+// given type, and reports how much faster than realtime each stream has been
+// decoded.
+template <typename Context>
+static void ReplayXmaContextDump(Memory& memory,
+                                 const std::vector<DumpRecord>& records,
+                                 const char* decoder_name) {
+  struct Stream {
+    std::unique_ptr<Context> context;
+    uint32_t context_data_ptr = 0;
+    uint32_t output_buffer_ptr = 0;
+    uint32_t input_buffer_ptrs[2] = {};
+    uint32_t input_buffer_capacities[2] = {};
+    uint32_t sample_rate = 0;
+    uint64_t kick_count = 0;
+    uint64_t work_host_ticks = 0;
+  };
+  std::map<uint32_t, Stream> streams;
+  uint64_t total_audio_samples = 0;
+  uint64_t total_work_host_ticks = 0;
+  uint32_t stream_count = 0;
+
+  auto finish_stream = [&](uint32_t context_id, Stream& stream) {
+    uint64_t frames_decoded = stream.context->statistics().frames_decoded.load(
+        std::memory_order_relaxed);
+    uint64_t audio_samples = frames_decoded * XmaContext::kSamplesPerFrame;
+    double work_seconds = GetHostTicksSeconds(stream.work_host_ticks);
+    double audio_seconds =
+        stream.sample_rate ? double(audio_samples) / stream.sample_rate : 0.0;
+    XELOGI(
+        "{} decoder, stream {} (context {}, {} Hz): {} kicks, {} frames, "
+        "{:.3f} ms, {:.1f}x realtime",
+        decoder_name, stream_count, context_id, stream.sample_rate,
+        stream.kick_count, frames_decoded, work_seconds * 1000.0,
+        work_seconds > 0.0 ? audio_seconds / work_seconds : 0.0);
+    ++stream_count;
+    if (stream.sample_rate) {
+      // Normalized to 48 kHz for the total.
+      total_audio_samples += audio_samples * 48000 / stream.sample_rate;
+    }
+    total_work_host_ticks += stream.work_host_ticks;
+    stream.context.reset();
+    memory.SystemHeapFree(stream.context_data_ptr);
+    memory.SystemHeapFree(stream.output_buffer_ptr);
+    for (uint32_t input_buffer_ptr : stream.input_buffer_ptrs) {
+      if (input_buffer_ptr) {
+        memory.SystemHeapFree(input_buffer_ptr);
+      }
+    }
+  };
+
+  for (const DumpRecord& record : records) {
+    uint32_t context_id = record.record.context_id;
+    auto stream_it = streams.find(context_id);
+    if (record.record.type == XmaContextDumpRecordType::kRelease) {
+      if (stream_it != streams.end()) {
+        finish_stream(context_id, stream_it->second);
+        streams.erase(stream_it);
+      }
+      continue;
+    }
+    if (stream_it == streams.end()) {
+      Stream& new_stream = streams[context_id];
+      new_stream.context_data_ptr = memory.SystemHeapAlloc(
+          sizeof(XMA_CONTEXT_DATA), 256, kSystemHeapPhysical);
+      new_stream.output_buffer_ptr = memory.SystemHeapAlloc(
+          XmaContextNew::kOutputMaxSizeBytes, 256, kSystemHeapPhysical);
+      new_stream.context = std::make_unique<Context>();
+      new_stream.context->Setup(context_id, &memory,
+                                new_stream.context_data_ptr);
+      new_stream.context->set_is_allocated(true);
+      stream_it = streams.find(context_id);
+    }
+    Stream& stream = stream_it->second;
+
+    // Relocate the recorded buffers to the memory of the replay.
+    XMA_CONTEXT_DATA data = record.record.context_data;
+    for (uint32_t i = 0; i < 2; ++i) {
+      const std::vector<uint8_t>& input_buffer = record.input_buffers[i];
+      if (input_buffer.size() > stream.input_buffer_capacities[i]) {
+        if (stream.input_buffer_ptrs[i]) {
+          memory.SystemHeapFree(stream.input_buffer_ptrs[i]);
+        }
+        stream.input_buffer_capacities[i] = uint32_t(input_buffer.size());
+        stream.input_buffer_ptrs[i] = memory.SystemHeapAlloc(
+            stream.input_buffer_capacities[i], 256, kSystemHeapPhysical);
+      }
+      if (!input_buffer.empty()) {
+        std::memcpy(memory.TranslateVirtual(stream.input_buffer_ptrs[i]),
+                    input_buffer.data(), input_buffer.size());
+      }
+    }
+    // Buffers that have never been valid in the recording are left null.
+    data.input_buffer_0_ptr =
+        stream.input_buffer_ptrs[0]
+            ? memory.GetPhysicalAddress(stream.input_buffer_ptrs[0])
+            : 0;
+    data.input_buffer_1_ptr =
+        stream.input_buffer_ptrs[1]
+            ? memory.GetPhysicalAddress(stream.input_buffer_ptrs[1])
+            : 0;
+    data.output_buffer_ptr =
+        memory.GetPhysicalAddress(stream.output_buffer_ptr);
+    data.Store(memory.TranslateVirtual(stream.context_data_ptr));
+    stream.sample_rate = uint32_t(kIdToSampleRate[data.sample_rate]);
+
+    stream.context->Enable();
+    uint64_t work_start_host_ticks = Clock::QueryHostTickCount();
+    stream.context->Work();
+    stream.work_host_ticks +=
+        Clock::QueryHostTickCount() - work_start_host_ticks;
+    ++stream.kick_count;
+  }
+  for (auto& stream : streams) {
+    finish_stream(stream.first, stream.second);
+  }
+
+  double total_work_seconds = GetHostTicksSeconds(total_work_host_ticks);
+  XELOGI("{} decoder: {} streams, {:.3f} ms, {:.1f}x realtime in total",
+         decoder_name, stream_count, total_work_seconds * 1000.0,
+         total_work_seconds > 0.0
+             ? double(total_audio_samples) / 48000.0 / total_work_seconds
+             : 0.0);
+}
+
+static void BenchmarkConversion() {
+  const uint32_t frame_count = cvars::conversion_bench_frames;
+  if (!frame_count) {
+    return;
+  }
+  constexpr uint32_t kChannelSamples = 256;
+  std::vector<float> input(6 * kChannelSamples);
+  for (size_t i = 0; i < input.size(); ++i) {
+    input[i] = xe::byte_swap(float(i % kChannelSamples) / kChannelSamples);
+  }
+  std::vector<float> output(6 * kChannelSamples);
+  double audio_seconds = double(frame_count) * kChannelSamples / 48000.0;
+
+  uint64_t start_host_ticks = Clock::QueryHostTickCount();
+  for (uint32_t i = 0; i < frame_count; ++i) {
+    conversion::sequential_6_BE_to_interleaved_6_LE(
+        output.data(), input.data(), kChannelSamples);
+  }
+  double seconds =
+      GetHostTicksSeconds(Clock::QueryHostTickCount() - start_host_ticks);
+  XELOGI("5.1 to interleaved 5.1: {} frames, {:.3f} ms, {:.1f}x realtime",
+         frame_count, seconds * 1000.0,
+         seconds > 0.0 ? audio_seconds / seconds : 0.0);
+
+  start_host_ticks = Clock::QueryHostTickCount();
+  for (uint32_t i = 0; i < frame_count; ++i) {
+    conversion::sequential_6_BE_to_interleaved_2_LE(
+        output.data(), input.data(), kChannelSamples);
+  }
+  seconds = GetHostTicksSeconds(Clock::QueryHostTickCount() - start_host_ticks);
+  XELOGI("5.1 to interleaved stereo: {} frames, {:.3f} ms, {:.1f}x realtime",
+         frame_count, seconds * 1000.0,
+         seconds > 0.0 ? audio_seconds / seconds : 0.0);
+}
+
+int apu_bench_main(const std::vector<std::string>& args) {
+  BenchmarkConversion();
+
+  if (cvars::xma_dump_input.empty()) {
+    return 0;
+  }
+  std::vector<DumpRecord> records;
+  if (!LoadXmaContextDump(cvars::xma_dump_input, records)) {
+    return 1;
+  }
+  XELOGI("Loaded {} records from {}", records.size(),
+         xe::path_to_utf8(cvars::xma_dump_input));
+
+  auto memory = std::make_unique<Memory>();
+  if (!memory->Initialize()) {
+    XELOGE("Failed to initialize the guest memory");
+    return 1;
+  }
+  ReplayXmaContextDump<XmaContextNew>(*memory, records, "New");
+  ReplayXmaContextDump<XmaContextOld>(*memory, records, "Old");
+  return 0;
+}
+
+}  // namespace apu
+}  // namespace xe
+
+XE_DEFINE_CONSOLE_APP("xenia-apu-bench", xe::apu::apu_bench_main,
+                      "xma_dump.bin", "xma_dump_input");
@@ -23,6 +23,10 @@ class AudioDriver {
 
   virtual void SubmitFrame(uint32_t samples_ptr) = 0;
 
+  // Number of times the host ran out of submitted frames after playback has
+  // started, may be read from any thread.
+  virtual uint32_t GetUnderrunCount() const { return 0; }
+
  protected:
   inline uint8_t* TranslatePhysical(uint32_t guest_address) const {
     return memory_->TranslatePhysical(guest_address);
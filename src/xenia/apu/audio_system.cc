@@ -41,6 +41,12 @@ DEFINE_uint32(apu_max_queued_frames, 8,
               "Value range: [4-64]",
               "APU");
 UPDATE_from_uint32(apu_max_queued_frames, 2024, 8, 31, 20, 64);
+DEFINE_bool(apu_adaptive_queued_frames, false,
+            "Adjust the number of buffered audio frames at runtime, lowering "
+            "it towards 4 while the host keeps up with playback and raising "
+            "it back towards apu_max_queued_frames when it runs out of audio. "
+            "Reduces audio delay on fast hosts.",
+            "APU");
 
 namespace xe {
 namespace apu {
@@ -52,7 +58,7 @@ AudioSystem::AudioSystem(cpu::Processor* processor)
   std::memset(clients_, 0, sizeof(clients_));
   queued_frames_ = std::min(
       static_cast<uint32_t>(kMaximumQueuedFrames),
-      std::max(cvars::apu_max_queued_frames, static_cast<uint32_t>(4)));
+      std::max(cvars::apu_max_queued_frames, kMinimumQueuedFrames));
 
   for (size_t i = 0; i < kMaximumClientCount; ++i) {
     client_semaphores_[i] = xe::threading::Semaphore::Create(0, queued_frames_);
@@ -132,9 +138,13 @@ void AudioSystem::WorkerThreadMain() {
       auto global_lock = global_critical_region_.Acquire();
       uint32_t client_callback = clients_[index].callback;
       uint32_t client_callback_arg = clients_[index].wrapped_callback_arg;
+      // If the queue is being shortened, consume the slot without requesting
+      // a frame.
+      bool skip_frame = cvars::apu_adaptive_queued_frames &&
+                        UpdateClientQueuedFrames(index);
       global_lock.unlock();
 
-      if (client_callback) {
+      if (client_callback && !skip_frame) {
         SCOPE_profile_cpu_i("apu", "xe::apu::AudioSystem->client_callback");
         uint64_t args[] = {client_callback_arg};
         processor_->Execute(worker_thread_->thread_state(), client_callback,
@@ -158,6 +168,35 @@ void AudioSystem::WorkerThreadMain() {
   // TODO(benvanik): call module API to kill?
 }
 
+bool AudioSystem::UpdateClientQueuedFrames(size_t index) {
+  auto& client = clients_[index];
+  if (!client.driver) {
+    return false;
+  }
+  uint32_t underrun_count = client.driver->GetUnderrunCount();
+  if (underrun_count != client.underrun_count) {
+    client.underrun_count = underrun_count;
+    client.frames_since_underrun = 0;
+    uint32_t growth = std::min(kAdaptiveQueuedFramesGrowth,
+                               queued_frames_ - client.queued_frames);
+    if (growth) {
+      client.queued_frames += growth;
+      auto ret = client_semaphores_[index]->Release(growth, nullptr);
+      assert_true(ret);
+      COUNT_profile_set("apu/queued_frames", client.queued_frames);
+    }
+    return false;
+  }
+  if (client.queued_frames <= kMinimumQueuedFrames ||
+      ++client.frames_since_underrun < kAdaptiveQueuedFramesShrinkInterval) {
+    return false;
+  }
+  client.frames_since_underrun = 0;
+  --client.queued_frames;
+  COUNT_profile_set("apu/queued_frames", client.queued_frames);
+  return true;
+}
+
 int AudioSystem::FindFreeClient() {
   for (int i = 0; i < kMaximumClientCount; i++) {
     auto& client = clients_[i];
@@ -201,7 +240,7 @@ X_STATUS AudioSystem::RegisterClient(uint32_t callback, uint32_t callback_arg,
   uint32_t ptr = memory()->SystemHeapAlloc(0x4);
   xe::store_and_swap<uint32_t>(memory()->TranslateVirtual(ptr), callback_arg);
 
-  clients_[index] = {driver, callback, callback_arg, ptr, true};
+  clients_[index] = {driver, callback, callback_arg, ptr, true, queued_frames_};
 
   if (out_index) {
     *out_index = index;
@@ -215,8 +254,13 @@ void AudioSystem::SubmitFrame(size_t index, uint32_t samples_ptr) {
 
   auto global_lock = global_critical_region_.Acquire();
   assert_true(index < kMaximumClientCount);
-  assert_true(clients_[index].driver != NULL);
-  (clients_[index].driver)->SubmitFrame(samples_ptr);
+  AudioDriver* driver = clients_[index].driver;
+  assert_true(driver != NULL);
+  // The client is only unregistered by the guest code submitting frames to
+  // it, so the driver stays alive - don't block other guest threads on the
+  // global critical region while the frame is being converted and copied.
+  global_lock.unlock();
+  driver->SubmitFrame(samples_ptr);
 }
 
 void AudioSystem::UnregisterClient(size_t index) {
@@ -289,6 +333,9 @@ bool AudioSystem::Restore(ByteStream* stream) {
     client.wrapped_callback_arg = stream->Read<uint32_t>();
 
     client.in_use = true;
+    client.queued_frames = queued_frames_;
+    client.underrun_count = 0;
+    client.frames_since_underrun = 0;
 
     auto client_semaphore = client_semaphores_[id].get();
     auto ret = client_semaphore->Release(queued_frames_, nullptr);
@@ -311,6 +358,17 @@ bool AudioSystem::Restore(ByteStream* stream) {
   return true;
 }
 
+uint64_t AudioSystem::GetUnderrunCount() {
+  auto global_lock = global_critical_region_.Acquire();
+  uint64_t underrun_count = 0;
+  for (const auto& client : clients_) {
+    if (client.in_use && client.driver) {
+      underrun_count += client.driver->GetUnderrunCount();
+    }
+  }
+  return underrun_count;
+}
+
 void AudioSystem::Pause() {
   if (paused_) {
     return;
@@ -43,6 +43,9 @@ class AudioSystem {
                           size_t* out_index);
   void UnregisterClient(size_t index);
   void SubmitFrame(size_t index, uint32_t samples_ptr);
+  // Total of the buffer underruns reported by the drivers of the registered
+  // clients.
+  uint64_t GetUnderrunCount();
 
   bool Save(ByteStream* stream);
   bool Restore(ByteStream* stream);
@@ -66,6 +69,13 @@ class AudioSystem {
   // TODO(gibbed): respect XAUDIO2_MAX_QUEUED_BUFFERS somehow (ie min(64,
   // XAUDIO2_MAX_QUEUED_BUFFERS))
   static const size_t kMaximumQueuedFrames = 64;
+  static constexpr uint32_t kMinimumQueuedFrames = 4;
+  // With apu_adaptive_queued_frames, the number of frames added after an
+  // underrun, and the number of frames played without underruns before the
+  // queue is shortened by one (1024 frames of 256 samples is about 5 seconds
+  // at 48 kHz).
+  static constexpr uint32_t kAdaptiveQueuedFramesGrowth = 2;
+  static constexpr uint32_t kAdaptiveQueuedFramesShrinkInterval = 1024;
 
   Memory* memory_ = nullptr;
   cpu::Processor* processor_ = nullptr;
@@ -83,9 +93,18 @@ class AudioSystem {
     uint32_t callback_arg;
     uint32_t wrapped_callback_arg;
     bool in_use;
+    // Frames in flight allowed by the semaphore, from kMinimumQueuedFrames to
+    // queued_frames_.
+    uint32_t queued_frames;
+    uint32_t underrun_count;
+    uint32_t frames_since_underrun;
   } clients_[kMaximumClientCount];
 
   int FindFreeClient();
+  // Adjusts the client's queue length based on the driver's underruns,
+  // returns whether the current frame slot should be dropped to shorten it.
+  // Called with the global critical region held.
+  bool UpdateClientQueuedFrames(size_t index);
 
   std::unique_ptr<xe::threading::Semaphore>
       client_semaphores_[kMaximumClientCount];
@@ -21,51 +21,61 @@ namespace conversion {
 
 #if XE_ARCH_AMD64
 
-XE_NOINLINE
-static void _generic_sequential_6_BE_to_interleaved_6_LE(
-    float* XE_RESTRICT output, const float* XE_RESTRICT input,
-    unsigned ch_sample_count) {
-  for (unsigned sample = 0; sample < ch_sample_count; sample++) {
-    for (unsigned channel = 0; channel < 6; channel++) {
-      unsigned int value = *reinterpret_cast<const unsigned int*>(
-          &input[channel * ch_sample_count + sample]);
-
-      *reinterpret_cast<unsigned int*>(&output[sample * 6 + channel]) =
-          xe::byte_swap(value);
-    }
+inline static void sequential_6_BE_to_interleaved_6_LE(
+    float* output, const float* input, unsigned ch_sample_count) {
+  const __m128i byte_swap_shuffle =
+      _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  unsigned sample = 0;
+  for (; sample + 4 <= ch_sample_count; sample += 4) {
+    // load 4 samples from 6 channels each and byte swap
+    __m128 c0 = _mm_castsi128_ps(_mm_shuffle_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+            &input[0 * ch_sample_count + sample])),
+        byte_swap_shuffle));
+    __m128 c1 = _mm_castsi128_ps(_mm_shuffle_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+            &input[1 * ch_sample_count + sample])),
+        byte_swap_shuffle));
+    __m128 c2 = _mm_castsi128_ps(_mm_shuffle_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+            &input[2 * ch_sample_count + sample])),
+        byte_swap_shuffle));
+    __m128 c3 = _mm_castsi128_ps(_mm_shuffle_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+            &input[3 * ch_sample_count + sample])),
+        byte_swap_shuffle));
+    __m128 c4 = _mm_castsi128_ps(_mm_shuffle_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+            &input[4 * ch_sample_count + sample])),
+        byte_swap_shuffle));
+    __m128 c5 = _mm_castsi128_ps(_mm_shuffle_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+            &input[5 * ch_sample_count + sample])),
+        byte_swap_shuffle));
+    // channels 0-3 of each sample
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    // channels 4-5 of samples 0 and 1, and of samples 2 and 3
+    __m128 c45_01 = _mm_unpacklo_ps(c4, c5);
+    __m128 c45_23 = _mm_unpackhi_ps(c4, c5);
+    float* sample_output = &output[sample * 6];
+    _mm_storeu_ps(sample_output, c0);
+    _mm_storeu_ps(sample_output + 4, _mm_movelh_ps(c45_01, c1));
+    _mm_storeu_ps(sample_output + 8,
+                  _mm_shuffle_ps(c1, c45_01, _MM_SHUFFLE(3, 2, 3, 2)));
+    _mm_storeu_ps(sample_output + 12, c2);
+    _mm_storeu_ps(sample_output + 16, _mm_movelh_ps(c45_23, c3));
+    _mm_storeu_ps(sample_output + 20,
+                  _mm_shuffle_ps(c3, c45_23, _MM_SHUFFLE(3, 2, 3, 2)));
   }
-}
-#if XE_COMPILER_CLANG_CL != 1
-// load_be_u32 unavailable on clang-cl
-XE_NOINLINE
-static void _movbe_sequential_6_BE_to_interleaved_6_LE(
-    float* XE_RESTRICT output, const float* XE_RESTRICT input,
-    unsigned ch_sample_count) {
-  for (unsigned sample = 0; sample < ch_sample_count; sample++) {
+  // remaining samples if the count is not a multiple of 4
+  for (; sample < ch_sample_count; sample++) {
     for (unsigned channel = 0; channel < 6; channel++) {
-      *reinterpret_cast<unsigned int*>(&output[sample * 6 + channel]) =
-          _load_be_u32(reinterpret_cast<const unsigned int*>(
-              &input[channel * ch_sample_count + sample]));
+      output[sample * 6 + channel] =
+          xe::byte_swap(input[channel * ch_sample_count + sample]);
     }
   }
 }
 
-inline static void sequential_6_BE_to_interleaved_6_LE(
-    float* output, const float* input, unsigned ch_sample_count) {
-  if (amd64::GetFeatureFlags() & amd64::kX64EmitMovbe) {
-    _movbe_sequential_6_BE_to_interleaved_6_LE(output, input, ch_sample_count);
-  } else {
-    _generic_sequential_6_BE_to_interleaved_6_LE(output, input,
-                                                 ch_sample_count);
-  }
-}
-#else
-inline static void sequential_6_BE_to_interleaved_6_LE(
-    float* output, const float* input, unsigned ch_sample_count) {
-  _generic_sequential_6_BE_to_interleaved_6_LE(output, input, ch_sample_count);
-}
-#endif
-
 inline void sequential_6_BE_to_interleaved_2_LE(float* output,
                                                 const float* input,
                                                 size_t ch_sample_count) {
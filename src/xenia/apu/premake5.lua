@@ -17,3 +17,28 @@ project("xenia-apu")
     project_root.."/third_party/FFmpeg/",
   })
   local_platform_files()
+
+group("src")
+project("xenia-apu-bench")
+  uuid("6c2b0f4e-2a4d-4f0b-9d3e-8a51c7e0b6a9")
+  kind("ConsoleApp")
+  language("C++")
+  links({
+    "fmt",
+    "libavcodec",
+    "libavutil",
+    "xenia-apu",
+    "xenia-base",
+    "xenia-core",
+    "xenia-cpu",
+
+    -- Needed by xenia-base.
+    "xenia-ui",
+  })
+  includedirs({
+    project_root.."/third_party/FFmpeg/",
+  })
+  files({
+    "apu_bench_main.cc",
+    "../base/console_app_main_"..platform_suffix..".cc",
+  })
@@ -10,12 +10,12 @@
 #ifndef XENIA_APU_SDL_SDL_AUDIO_DRIVER_H_
 #define XENIA_APU_SDL_SDL_AUDIO_DRIVER_H_
 
-#include <mutex>
-#include <queue>
-#include <stack>
+#include <array>
+#include <atomic>
 
 #include "SDL.h"
 #include "xenia/apu/audio_driver.h"
+#include "xenia/base/concurrent_queue.h"
 #include "xenia/base/threading.h"
 
 namespace xe {
@@ -29,6 +29,9 @@ class SDLAudioDriver : public AudioDriver {
 
   bool Initialize();
   void SubmitFrame(uint32_t frame_ptr) override;
+  uint32_t GetUnderrunCount() const override {
+    return frames_underrun_count_.load(std::memory_order_relaxed);
+  }
   void Shutdown();
 
  protected:
@@ -45,9 +48,14 @@ class SDLAudioDriver : public AudioDriver {
   static const uint32_t channel_samples_ = 256;
   static const uint32_t frame_samples_ = frame_channels_ * channel_samples_;
   static const uint32_t frame_size_ = sizeof(float) * frame_samples_;
-  std::queue<float*> frames_queued_ = {};
-  std::stack<float*> frames_unused_ = {};
-  std::mutex frames_mutex_ = {};
+  // Single-producer (SubmitFrame), single-consumer (SDLCallback) ring of
+  // frames. The client semaphore limits the number of frames in flight to
+  // AudioSystem::kMaximumQueuedFrames or less.
+  static const uint32_t frame_count_ = 64;
+  SpscQueue<std::array<float, frame_samples_>, frame_count_> frames_;
+  // Written only by the SDL callback.
+  bool frames_started_ = false;
+  std::atomic<uint32_t> frames_underrun_count_ = 0;
 };
 
 }  // namespace sdl
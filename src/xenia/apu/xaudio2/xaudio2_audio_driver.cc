@@ -196,6 +196,11 @@ void XAudio2AudioDriver::SubmitFrame(uint32_t frame_ptr) {
     objects_.api_2_7.pcm_voice->GetState(&state);
   }
   assert_true(state.BuffersQueued < frame_count_);
+  // The voice has played everything submitted before.
+  if (!state.BuffersQueued && frame_submitted_) {
+    underrun_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+  frame_submitted_ = true;
 
   auto input_frame = memory_->TranslateVirtual<float*>(frame_ptr);
   auto output_frame = reinterpret_cast<float*>(frames_[current_frame_]);
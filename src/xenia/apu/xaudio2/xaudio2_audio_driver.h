@@ -10,6 +10,7 @@
 #ifndef XENIA_APU_XAUDIO2_XAUDIO2_AUDIO_DRIVER_H_
 #define XENIA_APU_XAUDIO2_XAUDIO2_AUDIO_DRIVER_H_
 
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
 #include <thread>
@@ -40,6 +41,9 @@ class XAudio2AudioDriver : public AudioDriver {
   // have initialized MTA).
   // https://devblogs.microsoft.com/oldnewthing/?p=4613
   void SubmitFrame(uint32_t frame_ptr) override;
+  uint32_t GetUnderrunCount() const override {
+    return underrun_count_.load(std::memory_order_relaxed);
+  }
   void Shutdown();
 
  private:
@@ -101,6 +105,8 @@ class XAudio2AudioDriver : public AudioDriver {
   static const uint32_t frame_size_ = sizeof(float) * frame_samples_;
   float frames_[frame_count_][frame_samples_];
   uint32_t current_frame_ = 0;
+  bool frame_submitted_ = false;
+  std::atomic<uint32_t> underrun_count_ = 0;
 };
 
 }  // namespace xaudio2
@@ -55,6 +55,24 @@ void XmaContext::DumpRaw(AVFrame* frame, int id) {
   fclose(outfile);
 }
 
+void XmaContext::UpdateOutputBufferStatistics(const XMA_CONTEXT_DATA& data) {
+  uint32_t blocks_total = data.output_buffer_block_count;
+  uint32_t blocks_filled = 0;
+  if (blocks_total) {
+    blocks_filled = (data.output_buffer_write_offset + blocks_total -
+                     data.output_buffer_read_offset) %
+                    blocks_total;
+    // Equal offsets with a valid buffer mean it's full rather than empty.
+    if (!blocks_filled && data.output_buffer_valid) {
+      blocks_filled = blocks_total;
+    }
+  }
+  statistics_.output_blocks_filled.store(blocks_filled,
+                                         std::memory_order_relaxed);
+  statistics_.output_blocks_total.store(blocks_total,
+                                        std::memory_order_relaxed);
+}
+
 void XmaContext::ConvertFrame(const uint8_t** samples, bool is_two_channel,
                               uint8_t* output_buffer) {
   // Loop through every sample, convert and drop it into the output array.
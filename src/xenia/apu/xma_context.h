@@ -108,6 +108,7 @@ struct XMA_CONTEXT_DATA {
   // DWORD 10-15
   uint32_t unk_dwords_10_15[6];  // reserved?
 
+  XMA_CONTEXT_DATA() = default;
   explicit XMA_CONTEXT_DATA(const void* ptr) {
     xe::copy_and_swap(reinterpret_cast<uint32_t*>(this),
                       reinterpret_cast<const uint32_t*>(ptr),
@@ -175,6 +176,25 @@ class XmaContext {
   // static const uint32_t kOutputBytesPerBlock = 256;
   // static const uint32_t kOutputMaxSizeBytes = 31 * kOutputBytesPerBlock;
 
+  // Diagnostic counters, updated by the thread working on the context and
+  // read by the debug UI.
+  struct Statistics {
+    std::atomic<uint64_t> work_count = 0;
+    std::atomic<uint64_t> work_time_us = 0;
+    std::atomic<uint32_t> last_work_time_us = 0;
+    std::atomic<uint64_t> frames_decoded = 0;
+    std::atomic<uint32_t> loops = 0;
+    // Worked on without a valid input buffer (the guest hasn't provided more
+    // data yet).
+    std::atomic<uint32_t> input_stalls = 0;
+    // Worked on without enough space in the output buffer (the guest hasn't
+    // consumed the decoded data yet).
+    std::atomic<uint32_t> output_stalls = 0;
+    // Output buffer fill level after the last work, in 256-byte blocks.
+    std::atomic<uint32_t> output_blocks_filled = 0;
+    std::atomic<uint32_t> output_blocks_total = 0;
+  };
+
   explicit XmaContext();
   ~XmaContext();
 
@@ -193,17 +213,21 @@ class XmaContext {
 
   uint32_t id() { return id_; }
   uint32_t guest_ptr() { return guest_ptr_; }
-  bool is_allocated() { return is_allocated_; }
+  bool is_allocated() const { return is_allocated_; }
   bool is_enabled() { return is_enabled_; }
 
   void set_is_allocated(bool is_allocated) { is_allocated_ = is_allocated; }
   void set_is_enabled(bool is_enabled) { is_enabled_ = is_enabled; }
 
+  Statistics& statistics() { return statistics_; }
+  const Statistics& statistics() const { return statistics_; }
+
  protected:
   static void DumpRaw(AVFrame* frame, int id);
   // Convert sample format and swap bytes
   static void ConvertFrame(const uint8_t** samples, bool is_two_channel,
                            uint8_t* output_buffer);
+  void UpdateOutputBufferStatistics(const XMA_CONTEXT_DATA& data);
 
   Memory* memory_ = nullptr;
 
@@ -213,6 +237,8 @@ class XmaContext {
   volatile bool is_allocated_ = false;
   volatile bool is_enabled_ = false;
 
+  Statistics statistics_;
+
   // ffmpeg structures
   AVPacket* av_packet_ = nullptr;
   AVCodec* av_codec_ = nullptr;
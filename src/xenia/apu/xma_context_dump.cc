@@ -0,0 +1,84 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/apu/xma_context_dump.h"
+
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+
+namespace xe {
+namespace apu {
+
+std::unique_ptr<XmaContextDumpWriter> XmaContextDumpWriter::Create(
+    const std::filesystem::path& path) {
+  FILE* file = filesystem::OpenFile(path, "wb");
+  if (!file) {
+    XELOGE("Unable to open the XMA context dump file: {}",
+           xe::path_to_utf8(path));
+    return nullptr;
+  }
+  XmaContextDumpHeader header;
+  header.signature = kXmaContextDumpSignature;
+  header.version = kXmaContextDumpVersion;
+  fwrite(&header, sizeof(header), 1, file);
+  return std::unique_ptr<XmaContextDumpWriter>(new XmaContextDumpWriter(file));
+}
+
+XmaContextDumpWriter::~XmaContextDumpWriter() { fclose(file_); }
+
+void XmaContextDumpWriter::WriteKick(const Memory& memory,
+                                     uint32_t context_id,
+                                     const XMA_CONTEXT_DATA& context_data) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (context_id >= input_buffer_states_.size()) {
+    input_buffer_states_.resize(context_id + 1, {});
+  }
+  std::array<InputBufferState, 2>& input_buffer_states =
+      input_buffer_states_[context_id];
+  XmaContextDumpRecord record;
+  record.type = XmaContextDumpRecordType::kKick;
+  record.context_id = context_id;
+  record.context_data = context_data;
+  for (uint8_t i = 0; i < 2; ++i) {
+    InputBufferState& state = input_buffer_states[i];
+    bool valid = context_data.IsInputBufferValid(i);
+    uint32_t ptr = context_data.GetInputBufferAddress(i);
+    uint32_t packet_count = context_data.GetInputBufferPacketCount(i);
+    // A buffer becoming valid again may have been refilled by the game.
+    record.input_buffer_sizes[i] =
+        (valid && (!state.valid || state.ptr != ptr ||
+                   state.packet_count != packet_count))
+            ? packet_count * XmaContext::kBytesPerPacket
+            : 0;
+    state.ptr = ptr;
+    state.packet_count = packet_count;
+    state.valid = valid;
+  }
+  fwrite(&record, sizeof(record), 1, file_);
+  for (uint8_t i = 0; i < 2; ++i) {
+    if (record.input_buffer_sizes[i]) {
+      fwrite(memory.TranslatePhysical(context_data.GetInputBufferAddress(i)),
+             1, record.input_buffer_sizes[i], file_);
+    }
+  }
+}
+
+void XmaContextDumpWriter::WriteRelease(uint32_t context_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (context_id < input_buffer_states_.size()) {
+    input_buffer_states_[context_id] = {};
+  }
+  XmaContextDumpRecord record = {};
+  record.type = XmaContextDumpRecordType::kRelease;
+  record.context_id = context_id;
+  fwrite(&record, sizeof(record), 1, file_);
+}
+
+}  // namespace apu
+}  // namespace xe
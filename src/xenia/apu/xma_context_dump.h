@@ -0,0 +1,87 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_APU_XMA_CONTEXT_DUMP_H_
+#define XENIA_APU_XMA_CONTEXT_DUMP_H_
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "xenia/apu/xma_context.h"
+#include "xenia/memory.h"
+#include "xenia/xbox.h"
+
+namespace xe {
+namespace apu {
+
+// Recording of the XMA context states and the input data at context kicks,
+// written with --xma_context_dump_path and replayed by xenia-apu-bench. The
+// file is the header followed by records, each followed by the contents of
+// the input buffers with a non-zero size in the record.
+
+constexpr fourcc_t kXmaContextDumpSignature = make_fourcc("XMAD");
+constexpr uint32_t kXmaContextDumpVersion = 1;
+
+struct XmaContextDumpHeader {
+  fourcc_t signature;
+  uint32_t version;
+};
+
+enum class XmaContextDumpRecordType : uint32_t {
+  kKick,
+  // The context has been released, the next kick of the same context ID
+  // starts a new stream.
+  kRelease,
+};
+
+struct XmaContextDumpRecord {
+  XmaContextDumpRecordType type;
+  uint32_t context_id;
+  // Byte-swapped, with the addresses still referring to the guest memory of
+  // the recorded title.
+  XMA_CONTEXT_DATA context_data;
+  // Size of the input buffer contents following the record, 0 if the buffer
+  // is invalid or has not been changed since the previous kick of the context.
+  uint32_t input_buffer_sizes[2];
+};
+
+class XmaContextDumpWriter {
+ public:
+  static std::unique_ptr<XmaContextDumpWriter> Create(
+      const std::filesystem::path& path);
+  ~XmaContextDumpWriter();
+
+  void WriteKick(const Memory& memory, uint32_t context_id,
+                 const XMA_CONTEXT_DATA& context_data);
+  void WriteRelease(uint32_t context_id);
+
+ private:
+  struct InputBufferState {
+    uint32_t ptr;
+    uint32_t packet_count;
+    bool valid;
+  };
+
+  explicit XmaContextDumpWriter(FILE* file) : file_(file) {}
+
+  std::mutex mutex_;
+  FILE* file_;
+  // Per context ID, for writing only the input buffers that have changed.
+  std::vector<std::array<InputBufferState, 2>> input_buffer_states_;
+};
+
+}  // namespace apu
+}  // namespace xe
+
+#endif  // XENIA_APU_XMA_CONTEXT_DUMP_H_
@@ -11,10 +11,16 @@
 #include "xenia/apu/xma_helpers.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
 
+#include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/platform.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/xxhash.h"
 
 extern "C" {
 #if XE_COMPILER_MSVC
@@ -30,9 +36,85 @@ extern "C" {
 // Credits for most of this code goes to:
 // https://github.com/koolkdev/libertyv/blob/master/libav_wrapper/xma2dec.c
 
+DEFINE_bool(xma_decoded_frame_cache, false,
+            "Reuse the decoded audio of XMA frames played repeatedly, such as "
+            "looped sound effects and music, instead of decoding them again. "
+            "Only used by the new XMA audio decoder.",
+            "APU");
+DEFINE_bool(xma_predecode_frame, false,
+            "Decode the next XMA frame of a context while its output buffer "
+            "is full, so the frame can be written as soon as the game consumes "
+            "the decoded audio, reducing the time spent decoding after a "
+            "context is kicked. Only used by the new XMA audio decoder.",
+            "APU");
+
 namespace xe {
 namespace apu {
 
+namespace {
+
+// Decoded frames, shared between all the contexts since the same sounds are
+// often played through different contexts.
+class DecodedFrameCache {
+ public:
+  using RawFrame =
+      std::array<uint8_t, XmaContextNew::kBytesPerFrameChannel * 2>;
+
+  bool Lookup(uint64_t key, RawFrame& raw_frame_out) {
+    bool found;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = frames_.find(key);
+      found = it != frames_.end();
+      if (found) {
+        raw_frame_out = it->second;
+      }
+    }
+    if (found) {
+      hits_.fetch_add(1, std::memory_order_relaxed);
+    }
+    uint64_t lookups = lookups_.fetch_add(1, std::memory_order_relaxed) + 1;
+    COUNT_profile_set("apu/xma/decoded_frame_cache_hit_percent",
+                      hits_.load(std::memory_order_relaxed) * 100 / lookups);
+    return found;
+  }
+
+  void Insert(uint64_t key, const RawFrame& raw_frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Dropping everything when full as it's unknown which frames will be
+    // played again.
+    if (frames_.size() >= kMaxFrameCount) {
+      frames_.clear();
+    }
+    frames_.emplace(key, raw_frame);
+    COUNT_profile_set("apu/xma/decoded_frame_cache_frames", frames_.size());
+  }
+
+ private:
+  // 8 MB of stereo frames.
+  static constexpr size_t kMaxFrameCount = 4096;
+
+  std::mutex mutex_;
+  std::unordered_map<uint64_t, RawFrame> frames_;
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> lookups_{0};
+};
+
+DecodedFrameCache decoded_frame_cache;
+
+// Copies the fields of the context data not used or modified when decoding a
+// frame.
+void CopyOutputBufferState(const XMA_CONTEXT_DATA& source,
+                           XMA_CONTEXT_DATA& target) {
+  target.output_buffer_block_count = source.output_buffer_block_count;
+  target.output_buffer_write_offset = source.output_buffer_write_offset;
+  target.output_buffer_valid = source.output_buffer_valid;
+  target.output_buffer_ptr = source.output_buffer_ptr;
+  target.output_buffer_read_offset = source.output_buffer_read_offset;
+}
+
+}  // namespace
+
 XmaContextNew::XmaContextNew() = default;
 
 XmaContextNew::~XmaContextNew() {
@@ -128,6 +210,10 @@ bool XmaContextNew::Work() {
     return true;
   }
 
+  if (!data.IsAnyInputBufferValid()) {
+    statistics_.input_stalls.fetch_add(1, std::memory_order_relaxed);
+  }
+
   RingBuffer output_rb = PrepareOutputRingBuffer(&data);
 
   const int32_t minimum_subframe_decode_count =
@@ -140,10 +226,27 @@ bool XmaContextNew::Work() {
     XELOGD("XmaContext {}: No space for subframe decoding {}/{}!", id(),
            minimum_subframe_decode_count,
            remaining_subframe_blocks_in_output_buffer_);
+    statistics_.output_stalls.fetch_add(1, std::memory_order_relaxed);
+    UpdateOutputBufferStatistics(data);
     data.Store(context_ptr);
     return true;
   }
 
+  if (is_frame_predecoded_) {
+    is_frame_predecoded_ = false;
+    // The predecoded frame can only be used if the game hasn't changed the
+    // input since it was decoded.
+    XMA_CONTEXT_DATA expected_data = predecode_source_data_;
+    CopyOutputBufferState(data, expected_data);
+    if (!std::memcmp(&expected_data, &data, sizeof(data))) {
+      CopyOutputBufferState(data, predecode_result_data_);
+      data = predecode_result_data_;
+      current_frame_remaining_subframes_ = predecoded_frame_subframes_;
+    } else {
+      DiscardPredecodedFrame();
+    }
+  }
+
   while (remaining_subframe_blocks_in_output_buffer_ >=
          minimum_subframe_decode_count) {
     XELOGAPU(
@@ -176,6 +279,16 @@ bool XmaContextNew::Work() {
     data.output_buffer_valid = 0;
   }
 
+  UpdateOutputBufferStatistics(data);
+
+  // The output buffer is full - decode the next frame while waiting for the
+  // game to consume the output, without making the progress visible to the
+  // game until the frame is actually written.
+  if (cvars::xma_predecode_frame && !current_frame_remaining_subframes_ &&
+      data.IsAnyInputBufferValid() && data.error_status != 4) {
+    PredecodeFrame(data);
+  }
+
   // TODO: Rewrite!
   // There is a case when game can modify certain parts of context mid-play
   // and decoder should be aware of it
@@ -225,6 +338,8 @@ void XmaContextNew::Clear() {
   data.input_buffer_read_offset = kBitsPerPacketHeader;
 
   current_frame_remaining_subframes_ = 0;
+  previous_xma_frame_hash_ = 0;
+  is_frame_predecoded_ = false;
   data.Store(context_ptr);
 }
 
@@ -259,6 +374,36 @@ void XmaContextNew::SwapInputBuffer(XMA_CONTEXT_DATA* data) {
   data->input_buffer_read_offset = kBitsPerPacketHeader;
 }
 
+void XmaContextNew::PredecodeFrame(const XMA_CONTEXT_DATA& data) {
+  predecode_source_data_ = data;
+  predecode_result_data_ = data;
+  // Keep the frame preceding the predecoded one to be able to restore the
+  // decoder state if the predecoded frame is discarded.
+  predecode_previous_xma_frame_size_ = previous_xma_frame_size_;
+  if (previous_xma_frame_size_) {
+    std::memcpy(predecode_previous_xma_frame_.data(),
+                previous_xma_frame_.data(), size_t(previous_xma_frame_size_));
+  }
+  predecode_previous_xma_frame_hash_ = previous_xma_frame_hash_;
+  Decode(&predecode_result_data_);
+  predecoded_frame_subframes_ = current_frame_remaining_subframes_;
+  current_frame_remaining_subframes_ = 0;
+  if (predecoded_frame_subframes_) {
+    is_frame_predecoded_ = true;
+  } else {
+    DiscardPredecodedFrame();
+  }
+}
+
+void XmaContextNew::DiscardPredecodedFrame() {
+  std::memcpy(previous_xma_frame_.data(), predecode_previous_xma_frame_.data(),
+              size_t(predecode_previous_xma_frame_size_));
+  previous_xma_frame_size_ = predecode_previous_xma_frame_size_;
+  previous_xma_frame_hash_ = predecode_previous_xma_frame_hash_;
+  // The decoder may have been fed the discarded frame.
+  is_decoder_behind_ = true;
+}
+
 void XmaContextNew::Consume(RingBuffer* output_rb, XMA_CONTEXT_DATA* data) {
   if (!current_frame_remaining_subframes_) {
     return;
@@ -407,17 +552,52 @@ void XmaContextNew::Decode(XMA_CONTEXT_DATA* data) {
 
   raw_frame_.fill(0);
 
-  PrepareDecoder(data->sample_rate, bool(data->is_stereo));
+  if (PrepareDecoder(data->sample_rate, bool(data->is_stereo)) > 0) {
+    // The decoder has been reopened, no previous frame to overlap with.
+    previous_xma_frame_hash_ = 0;
+    is_decoder_behind_ = false;
+  }
   PreparePacket(packet_info.current_frame_size_, padding_start);
-  if (DecodePacket(av_context_, av_packet_, av_frame_)) {
-    // dump_raw(av_frame_, id());
-    ConvertFrame(reinterpret_cast<const uint8_t**>(&av_frame_->data),
-                 bool(data->is_stereo), raw_frame_.data());
+  if (cvars::xma_decoded_frame_cache) {
+    uint64_t xma_frame_hash =
+        XXH3_64bits(xma_frame_.data(), size_t(av_packet_->size));
+    uint64_t frame_key_data[] = {xma_frame_hash, previous_xma_frame_hash_,
+                                 uint64_t(data->sample_rate),
+                                 uint64_t(data->is_stereo)};
+    uint64_t frame_key = XXH3_64bits(frame_key_data, sizeof(frame_key_data));
+    if (decoded_frame_cache.Lookup(frame_key, raw_frame_)) {
+      is_decoder_behind_ = true;
+    } else {
+      CatchUpDecoder(packet_info.current_frame_size_, padding_start);
+      if (DecodePacket(av_context_, av_packet_, av_frame_)) {
+        ConvertFrame(reinterpret_cast<const uint8_t**>(&av_frame_->data),
+                     bool(data->is_stereo), raw_frame_.data());
+        decoded_frame_cache.Insert(frame_key, raw_frame_);
+      }
+    }
+    std::memcpy(previous_xma_frame_.data(), xma_frame_.data(),
+                size_t(av_packet_->size));
+    previous_xma_frame_size_ = av_packet_->size;
+    previous_xma_frame_hash_ = xma_frame_hash;
+  } else {
+    CatchUpDecoder(packet_info.current_frame_size_, padding_start);
+    if (DecodePacket(av_context_, av_packet_, av_frame_)) {
+      // dump_raw(av_frame_, id());
+      ConvertFrame(reinterpret_cast<const uint8_t**>(&av_frame_->data),
+                   bool(data->is_stereo), raw_frame_.data());
+    }
+    if (cvars::xma_predecode_frame) {
+      std::memcpy(previous_xma_frame_.data(), xma_frame_.data(),
+                  size_t(av_packet_->size));
+      previous_xma_frame_size_ = av_packet_->size;
+      previous_xma_frame_hash_ = 0;
+    }
   }
 
   // TODO: Write function to regenerate decoder
   // TODO: Be aware of subframe_skips & loops subframes skips
   current_frame_remaining_subframes_ = 4 << data->is_stereo;
+  statistics_.frames_decoded.fetch_add(1, std::memory_order_relaxed);
 
   // Compute where to go next.
   if (!packet_info.isLastFrameInPacket()) {
@@ -493,6 +673,7 @@ void XmaContextNew::UpdateLoopStatus(XMA_CONTEXT_DATA* data) {
   }
 
   data->input_buffer_read_offset = loop_start;
+  statistics_.loops.fetch_add(1, std::memory_order_relaxed);
 
   if (data->loop_count != 255) {
     data->loop_count--;
@@ -662,6 +843,19 @@ int XmaContextNew::PrepareDecoder(int sample_rate, bool is_two_channel) {
   return 0;
 }
 
+void XmaContextNew::CatchUpDecoder(const uint32_t frame_size,
+                                   const uint32_t frame_padding) {
+  if (is_decoder_behind_ && previous_xma_frame_size_) {
+    // Restore the overlap state of the decoder by decoding the previous
+    // frame, dropping its output.
+    av_packet_->data = previous_xma_frame_.data();
+    av_packet_->size = previous_xma_frame_size_;
+    DecodePacket(av_context_, av_packet_, av_frame_);
+    PreparePacket(frame_size, frame_padding);
+  }
+  is_decoder_behind_ = false;
+}
+
 void XmaContextNew::PreparePacket(const uint32_t frame_size,
                                   const uint32_t frame_padding) {
   av_packet_->data = xma_frame_.data();
@@ -107,10 +107,17 @@ class XmaContextNew : public XmaContext {
 
   void Decode(XMA_CONTEXT_DATA* data);
   void Consume(RingBuffer* output_rb, XMA_CONTEXT_DATA* data);
+  // For xma_predecode_frame, decodes the next frame without modifying the
+  // context data.
+  void PredecodeFrame(const XMA_CONTEXT_DATA& data);
+  void DiscardPredecodedFrame();
 
   void UpdateLoopStatus(XMA_CONTEXT_DATA* data);
   int PrepareDecoder(int sample_rate, bool is_two_channel);
   void PreparePacket(const uint32_t frame_size, const uint32_t frame_padding);
+  // Feeds the previous frame to the decoder again if it wasn't the frame
+  // decoded last, then prepares the packet for the current frame again.
+  void CatchUpDecoder(const uint32_t frame_size, const uint32_t frame_padding);
 
   RingBuffer PrepareOutputRingBuffer(XMA_CONTEXT_DATA* data);
 
@@ -126,6 +133,27 @@ class XmaContextNew : public XmaContext {
   std::array<uint8_t, 1 + 4096> xma_frame_;
   std::array<uint8_t, kBytesPerFrameChannel * 2> raw_frame_;
 
+  // For xma_decoded_frame_cache and xma_predecode_frame. WMA Pro frames
+  // overlap, so the output of a frame depends on the previous one, which is
+  // thus a part of the cache key, and if the previous frame was taken from the
+  // cache, or a different frame has been decoded after it, it has to be fed to
+  // the decoder again before decoding the next frame.
+  std::array<uint8_t, 1 + 4096> previous_xma_frame_;
+  int previous_xma_frame_size_ = 0;
+  uint64_t previous_xma_frame_hash_ = 0;
+  bool is_decoder_behind_ = false;
+
+  // For xma_predecode_frame, the frame in raw_frame_ decoded from
+  // predecode_source_data_ while the output buffer was full, not yet visible
+  // to the game.
+  bool is_frame_predecoded_ = false;
+  uint8_t predecoded_frame_subframes_ = 0;
+  XMA_CONTEXT_DATA predecode_source_data_;
+  XMA_CONTEXT_DATA predecode_result_data_;
+  std::array<uint8_t, 1 + 4096> predecode_previous_xma_frame_;
+  int predecode_previous_xma_frame_size_ = 0;
+  uint64_t predecode_previous_xma_frame_hash_ = 0;
+
   int32_t remaining_subframe_blocks_in_output_buffer_ = 0;
   uint8_t current_frame_remaining_subframes_ = 0;
 };
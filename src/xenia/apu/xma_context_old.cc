@@ -102,7 +102,11 @@ bool XmaContextOld::Work() {
 
     auto context_ptr = memory()->TranslateVirtual(guest_ptr());
     XMA_CONTEXT_DATA data(context_ptr);
+    if (!data.IsAnyInputBufferValid()) {
+      statistics_.input_stalls.fetch_add(1, std::memory_order_relaxed);
+    }
     Decode(&data);
+    UpdateOutputBufferStatistics(data);
     data.Store(context_ptr);
     return true;
   }
@@ -197,6 +201,7 @@ bool XmaContextOld::TrySetupNextLoop(XMA_CONTEXT_DATA* data,
        data->input_buffer_read_offset >= data->loop_end)) {
     // Loop back to the beginning.
     data->input_buffer_read_offset = data->loop_start;
+    statistics_.loops.fetch_add(1, std::memory_order_relaxed);
     if (data->loop_count < 255) {
       data->loop_count--;
     }
@@ -399,6 +404,9 @@ void XmaContextOld::Decode(XMA_CONTEXT_DATA* data) {
   size_t output_remaining_bytes = output_rb.write_count();
   output_remaining_bytes -=
       output_remaining_bytes % (kBytesPerFrameChannel << data->is_stereo);
+  if (!output_remaining_bytes) {
+    statistics_.output_stalls.fetch_add(1, std::memory_order_relaxed);
+  }
 
   // is_dirty_ = true; // TODO
   // is_dirty_ = false;  // TODO
@@ -666,6 +674,7 @@ void XmaContextOld::Decode(XMA_CONTEXT_DATA* data) {
       //			dump_raw(av_frame_, id());
       ConvertFrame(reinterpret_cast<const uint8_t**>(&av_frame_->data),
                    bool(av_frame_->channels > 1), raw_frame_.data());
+      statistics_.frames_decoded.fetch_add(1, std::memory_order_relaxed);
       // decoded_consumed_samples_ += kSamplesPerFrame;
 
       auto byte_count = kBytesPerFrameChannel << data->is_stereo;
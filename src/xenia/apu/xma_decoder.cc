@@ -9,10 +9,14 @@
 
 #include "xenia/apu/xma_decoder.h"
 
+#include <algorithm>
+
 #include "xenia/apu/xma_context.h"
+#include "xenia/apu/xma_context_dump.h"
 #include "xenia/apu/xma_context_new.h"
 #include "xenia/apu/xma_context_old.h"
 
+#include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
@@ -62,6 +66,17 @@ DEFINE_bool(use_dedicated_xma_thread, true,
             "better results, but decrease performance a bit.",
             "APU");
 
+DEFINE_int32(xma_decoder_thread_count, 1,
+             "Number of threads decoding XMA contexts in parallel if "
+             "use_dedicated_xma_thread is enabled. More threads may prevent "
+             "audio from starving in titles playing many streams at once.",
+             "APU");
+
+DEFINE_path(xma_context_dump_path, "",
+            "Path to record the states and the input data of the XMA contexts "
+            "at every kick to, for replaying them in xenia-apu-bench.",
+            "APU");
+
 namespace xe {
 namespace apu {
 
@@ -137,6 +152,11 @@ X_STATUS XmaDecoder::Setup(kernel::KernelState* kernel_state) {
   register_file_[XmaRegister::ContextArrayAddress] =
       memory()->GetPhysicalAddress(context_data_first_ptr_);
 
+  if (!cvars::xma_context_dump_path.empty()) {
+    context_dump_writer_ =
+        XmaContextDumpWriter::Create(cvars::xma_context_dump_path);
+  }
+
   // Setup XMA contexts.
   for (int i = 0; i < kContextCount; ++i) {
     if (cvars::use_new_decoder) {
@@ -152,6 +172,14 @@ X_STATUS XmaDecoder::Setup(kernel::KernelState* kernel_state) {
   }
   register_file_[XmaRegister::NextContextIndex] = 1;
   context_bitmap_.Resize(kContextCount);
+  for (std::atomic<uint64_t>& kicked_context_bits_word :
+       kicked_context_bits_) {
+    kicked_context_bits_word.store(0, std::memory_order_relaxed);
+  }
+  for (std::atomic<uint64_t>& context_kick_host_ticks :
+       context_kick_host_ticks_) {
+    context_kick_host_ticks.store(0, std::memory_order_relaxed);
+  }
 
   worker_running_ = true;
   work_event_ = xe::threading::Event::CreateAutoResetEvent(false);
@@ -172,21 +200,68 @@ X_STATUS XmaDecoder::Setup(kernel::KernelState* kernel_state) {
   worker_thread_->set_can_debugger_suspend(true);
   worker_thread_->Create();
 
+  if (cvars::use_dedicated_xma_thread) {
+    // The helpers never call guest code and only run while the worker thread,
+    // which can be suspended by the debugger, is waiting for them.
+    uint32_t helper_thread_count =
+        uint32_t(std::min(std::max(cvars::xma_decoder_thread_count, 1), 16)) -
+        1;
+    for (uint32_t i = 0; i < helper_thread_count; ++i) {
+      xe::threading::Thread::CreationParameters helper_thread_parameters;
+      helper_thread_parameters.stack_size = 128 * 1024;
+      std::unique_ptr<xe::threading::Thread> helper_thread =
+          xe::threading::Thread::Create(helper_thread_parameters,
+                                        [this]() { HelperThreadMain(); });
+      if (!helper_thread) {
+        XELOGE("XMA: Failed to create a decoder helper thread");
+        break;
+      }
+      helper_thread->set_name("XMA Decoder Helper");
+      helper_threads_.push_back(std::move(helper_thread));
+    }
+  }
+
   return X_STATUS_SUCCESS;
 }
 
 void XmaDecoder::WorkerThreadMain() {
   uint32_t idle_loop_count = 0;
   while (worker_running_) {
-    // Okay, let's loop through XMA contexts to find ones we need to decode!
-    bool did_work = false;
-    for (uint32_t n = 0; n < kContextCount; n++) {
-      did_work = contexts_[n]->Work() || did_work;
-
-      // TODO: Need thread safety to do this.
-      // Probably not too important though.
-      // registers_.current_context = n;
-      // registers_.next_context = (n + 1) % kContextCount;
+    // Okay, let's gather the XMA contexts kicked since the last pass - only
+    // they may need decoding, so not scanning all of them.
+    // TODO: Need thread safety to update registers_.current_context and
+    // registers_.next_context. Probably not too important though.
+    work_pass_context_count_ = 0;
+    for (uint32_t i = 0; i < uint32_t(kicked_context_bits_.size()); ++i) {
+      uint64_t kicked_context_bits =
+          kicked_context_bits_[i].exchange(0, std::memory_order_acquire);
+      uint32_t kicked_context_bit;
+      while (xe::bit_scan_forward(kicked_context_bits, &kicked_context_bit)) {
+        kicked_context_bits = xe::clear_lowest_bit(kicked_context_bits);
+        work_pass_contexts_[work_pass_context_count_++] =
+            uint16_t(i * 64 + kicked_context_bit);
+      }
+    }
+    COUNT_profile_set("apu/xma/contexts_per_pass", work_pass_context_count_);
+    work_pass_next_context_.store(0, std::memory_order_relaxed);
+    // Not waking up the helpers if there's nothing to share with them.
+    bool use_helper_threads =
+        !helper_threads_.empty() && work_pass_context_count_ > 1;
+    if (use_helper_threads) {
+      {
+        std::lock_guard<std::mutex> lock(work_pass_mutex_);
+        ++work_pass_index_;
+        work_pass_helpers_remaining_ = helper_threads_.size();
+      }
+      work_pass_start_cond_.notify_all();
+    }
+    bool did_work = WorkPassContexts();
+    if (use_helper_threads) {
+      std::unique_lock<std::mutex> lock(work_pass_mutex_);
+      work_pass_end_cond_.wait(
+          lock, [this]() { return !work_pass_helpers_remaining_; });
+      did_work = work_pass_helpers_did_work_ || did_work;
+      work_pass_helpers_did_work_ = false;
     }
 
     if (paused_) {
@@ -203,6 +278,79 @@ void XmaDecoder::WorkerThreadMain() {
   }
 }
 
+void XmaDecoder::HelperThreadMain() {
+  uint64_t last_work_pass_index = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(work_pass_mutex_);
+      work_pass_start_cond_.wait(lock, [this, last_work_pass_index]() {
+        return !worker_running_ || work_pass_index_ != last_work_pass_index;
+      });
+      if (!worker_running_) {
+        return;
+      }
+      last_work_pass_index = work_pass_index_;
+    }
+    bool did_work = WorkPassContexts();
+    bool is_last_helper;
+    {
+      std::lock_guard<std::mutex> lock(work_pass_mutex_);
+      work_pass_helpers_did_work_ = work_pass_helpers_did_work_ || did_work;
+      is_last_helper = !--work_pass_helpers_remaining_;
+    }
+    if (is_last_helper) {
+      work_pass_end_cond_.notify_one();
+    }
+  }
+}
+
+bool XmaDecoder::WorkPassContexts() {
+  // Each context has its own lock and decoder state, so different contexts can
+  // be processed on different threads.
+  bool did_work = false;
+  uint64_t max_decode_host_ticks = 0;
+  uint64_t max_kick_latency_host_ticks = 0;
+  uint32_t pass_context_index;
+  while ((pass_context_index = work_pass_next_context_.fetch_add(
+              1, std::memory_order_relaxed)) < work_pass_context_count_) {
+    uint32_t n = work_pass_contexts_[pass_context_index];
+    uint64_t kick_host_ticks =
+        context_kick_host_ticks_[n].load(std::memory_order_relaxed);
+    uint64_t decode_start_host_ticks = Clock::QueryHostTickCount();
+    if (!contexts_[n]->Work()) {
+      continue;
+    }
+    did_work = true;
+    uint64_t decode_end_host_ticks = Clock::QueryHostTickCount();
+    uint64_t decode_host_ticks =
+        decode_end_host_ticks - decode_start_host_ticks;
+    max_decode_host_ticks = std::max(max_decode_host_ticks, decode_host_ticks);
+    XmaContext::Statistics& statistics = contexts_[n]->statistics();
+    uint64_t decode_us =
+        decode_host_ticks * 1000000 / Clock::QueryHostTickFrequency();
+    statistics.work_count.fetch_add(1, std::memory_order_relaxed);
+    statistics.work_time_us.fetch_add(decode_us, std::memory_order_relaxed);
+    statistics.last_work_time_us.store(uint32_t(decode_us),
+                                       std::memory_order_relaxed);
+    if (kick_host_ticks &&
+        context_kick_host_ticks_[n].compare_exchange_strong(
+            kick_host_ticks, 0, std::memory_order_relaxed)) {
+      max_kick_latency_host_ticks =
+          std::max(max_kick_latency_host_ticks,
+                   decode_end_host_ticks - kick_host_ticks);
+    }
+  }
+  if (did_work) {
+    uint64_t host_tick_frequency = Clock::QueryHostTickFrequency();
+    COUNT_profile_set("apu/xma/context_decode_max_us",
+                      max_decode_host_ticks * 1000000 / host_tick_frequency);
+    COUNT_profile_set(
+        "apu/xma/kick_to_output_max_us",
+        max_kick_latency_host_ticks * 1000000 / host_tick_frequency);
+  }
+  return did_work;
+}
+
 void XmaDecoder::Shutdown() {
   worker_running_ = false;
 
@@ -220,12 +368,26 @@ void XmaDecoder::Shutdown() {
     worker_thread_.reset();
   }
 
+  if (!helper_threads_.empty()) {
+    // Taking the lock so a helper checking worker_running_ doesn't miss the
+    // notification.
+    { std::lock_guard<std::mutex> lock(work_pass_mutex_); }
+    work_pass_start_cond_.notify_all();
+    for (const std::unique_ptr<xe::threading::Thread>& helper_thread :
+         helper_threads_) {
+      xe::threading::Wait(helper_thread.get(), false);
+    }
+    helper_threads_.clear();
+  }
+
   if (context_data_first_ptr_) {
     memory()->SystemHeapFree(context_data_first_ptr_);
   }
 
   context_data_first_ptr_ = 0;
   context_data_last_ptr_ = 0;
+
+  context_dump_writer_.reset();
 }
 
 int XmaDecoder::GetContextId(uint32_t guest_ptr) {
@@ -259,6 +421,9 @@ void XmaDecoder::ReleaseContext(uint32_t guest_ptr) {
   assert_true(context.is_allocated());
   context.Release();
   context_bitmap_.Release(context_id);
+  if (context_dump_writer_) {
+    context_dump_writer_->WriteRelease(uint32_t(context_id));
+  }
 }
 
 bool XmaDecoder::BlockOnContext(uint32_t guest_ptr, bool poll) {
@@ -327,8 +492,22 @@ void XmaDecoder::WriteRegister(uint32_t addr, uint32_t value) {
       if (value & 1) {
         uint32_t context_id = base_context_id + i;
         auto& context = *contexts_[context_id];
+        uint64_t no_kick_host_ticks = 0;
+        context_kick_host_ticks_[context_id].compare_exchange_strong(
+            no_kick_host_ticks, Clock::QueryHostTickCount(),
+            std::memory_order_relaxed);
+        if (context_dump_writer_) {
+          context_dump_writer_->WriteKick(
+              *memory(), context_id,
+              XMA_CONTEXT_DATA(
+                  memory()->TranslateVirtual(context.guest_ptr())));
+        }
         context.Enable();
-        if (!cvars::use_dedicated_xma_thread) {
+        if (cvars::use_dedicated_xma_thread) {
+          // Release so the worker thread sees the context enabled.
+          kicked_context_bits_[context_id >> 6].fetch_or(
+              uint64_t(1) << (context_id & 63), std::memory_order_release);
+        } else {
           context.Work();
         }
       }
@@ -10,9 +10,13 @@
 #ifndef XENIA_APU_XMA_DECODER_H_
 #define XENIA_APU_XMA_DECODER_H_
 
+#include <array>
 #include <atomic>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <queue>
+#include <vector>
 
 #include "xenia/apu/xma_context.h"
 #include "xenia/apu/xma_register_file.h"
@@ -25,6 +29,8 @@ namespace apu {
 
 struct XMA_CONTEXT_DATA;
 
+class XmaContextDumpWriter;
+
 class XmaDecoder {
  public:
   explicit XmaDecoder(cpu::Processor* processor);
@@ -47,6 +53,9 @@ class XmaDecoder {
   uint32_t ReadRegister(uint32_t addr);
   void WriteRegister(uint32_t addr, uint32_t value);
 
+  uint32_t context_count() const { return kContextCount; }
+  const XmaContext& context(uint32_t id) const { return *contexts_[id]; }
+
   bool is_paused() const { return paused_; }
   void Pause();
   void Resume();
@@ -56,6 +65,10 @@ class XmaDecoder {
 
  private:
   void WorkerThreadMain();
+  void HelperThreadMain();
+  // Processes the contexts of the current pass not taken by other threads yet,
+  // returns whether any of them has done any work.
+  bool WorkPassContexts();
 
   static uint32_t MMIOReadRegisterThunk(void* ppc_context, XmaDecoder* as,
                                         uint32_t addr) {
@@ -67,6 +80,8 @@ class XmaDecoder {
   }
 
  protected:
+  static const uint32_t kContextCount = 320;
+
   Memory* memory_ = nullptr;
   cpu::Processor* processor_ = nullptr;
 
@@ -74,14 +89,42 @@ class XmaDecoder {
   kernel::object_ref<kernel::XHostThread> worker_thread_;
   std::unique_ptr<xe::threading::Event> work_event_ = nullptr;
 
+  std::unique_ptr<XmaContextDumpWriter> context_dump_writer_;
+
+  // Additional threads decoding contexts in parallel with the worker thread,
+  // which distributes the contexts between itself and them in every pass.
+  std::vector<std::unique_ptr<xe::threading::Thread>> helper_threads_;
+  std::mutex work_pass_mutex_;
+  // Notified when a new pass is started or when shutting down.
+  std::condition_variable work_pass_start_cond_;
+  // Notified when the last helper thread completes the pass.
+  std::condition_variable work_pass_end_cond_;
+  // Protected by work_pass_mutex_.
+  uint64_t work_pass_index_ = 0;
+  size_t work_pass_helpers_remaining_ = 0;
+  bool work_pass_helpers_did_work_ = false;
+  // Contexts kicked since they have been gathered for the previous pass,
+  // written by the worker thread before starting a pass.
+  std::array<uint16_t, kContextCount> work_pass_contexts_;
+  uint32_t work_pass_context_count_ = 0;
+  // Index in work_pass_contexts_ of the next context to take in the current
+  // pass.
+  std::atomic<uint32_t> work_pass_next_context_ = {0};
+
   bool paused_ = false;
   xe::threading::Fence pause_fence_;   // Signaled when worker paused.
   xe::threading::Fence resume_fence_;  // Signaled when resume requested.
 
   XmaRegisterFile register_file_;
 
-  static const uint32_t kContextCount = 320;
   XmaContext* contexts_[kContextCount];
+  // Contexts kicked since the worker thread has last gathered them. A context
+  // can only do work after being kicked, as it disables itself in Work.
+  std::array<std::atomic<uint64_t>, (kContextCount + 63) / 64>
+      kicked_context_bits_;
+  // Host ticks when each context has been kicked and not processed yet, or 0,
+  // for statistics.
+  std::array<std::atomic<uint64_t>, kContextCount> context_kick_host_ticks_;
   BitMap context_bitmap_;
 
   uint32_t context_data_first_ptr_ = 0;
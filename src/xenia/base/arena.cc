@@ -9,6 +9,7 @@
 
 #include "xenia/base/arena.h"
 
+#include <algorithm>
 #include <cstring>
 #include <memory>
 
@@ -32,6 +33,7 @@ Arena::~Arena() {
 }
 
 void Arena::Reset() {
+  peak_reset_size_ = std::max(peak_reset_size_, CalculateSize());
   active_chunk_ = head_chunk_;
   if (active_chunk_) {
     active_chunk_->offset = 0;
@@ -47,35 +49,42 @@ void Arena::DebugFill() {
 }
 
 void* Arena::Alloc(size_t size, size_t align) {
-  assert_true(
-      align > 0 && xe::is_pow2(align) && align <= 16,
-      "align needs to be a power of 2 and not greater than Chunk alignment");
+  assert_true(align > 0 && xe::is_pow2(align),
+              "align needs to be a power of 2");
 
-  // for alignment
-  const auto get_padding = [this, align]() -> size_t {
+  // For the alignment of the address, as chunks are only aligned to 16 bytes.
+  const auto get_padding = [align](const Chunk* chunk) -> size_t {
     const size_t mask = align - 1;
-    size_t deviation = active_chunk_->offset & mask;
+    size_t deviation =
+        reinterpret_cast<size_t>(chunk->buffer + chunk->offset) & mask;
     return (align - deviation) & mask;
   };
 
-  if (active_chunk_) {
-    if (active_chunk_->capacity - active_chunk_->offset <
-        size + get_padding() + 4_KiB) {
-      Chunk* next = active_chunk_->next;
-      if (!next) {
-        assert_true(size + get_padding() < chunk_size_,
-                    "need to support larger chunks");
-        next = new Chunk(chunk_size_);
+  if (!active_chunk_ ||
+      active_chunk_->capacity - active_chunk_->offset <
+          size + get_padding(active_chunk_) + 4_KiB) {
+    // Worst case padding in an empty chunk.
+    size_t required_capacity = size + (align > 16 ? align - 16 : 0);
+    Chunk* next = active_chunk_ ? active_chunk_->next : nullptr;
+    if (!next || next->capacity < required_capacity) {
+      // Allocations larger than the chunk size get a dedicated chunk, which
+      // stays in the list to be reused after resets. Inserted before the next
+      // chunk if it's too small, to keep the chunks after it for reuse too.
+      Chunk* new_chunk = new Chunk(std::max(chunk_size_, required_capacity));
+      new_chunk->next = next;
+      next = new_chunk;
+      if (active_chunk_) {
         active_chunk_->next = next;
+      } else {
+        head_chunk_ = next;
       }
-      next->offset = 0;
-      active_chunk_ = next;
     }
-  } else {
-    head_chunk_ = active_chunk_ = new Chunk(chunk_size_);
+    next->offset = 0;
+    active_chunk_ = next;
   }
 
-  active_chunk_->offset += get_padding();
+  ++allocation_count_;
+  active_chunk_->offset += get_padding(active_chunk_);
   uint8_t* p = active_chunk_->buffer + active_chunk_->offset;
   active_chunk_->offset += size;
   assert_true((reinterpret_cast<size_t>(p) & (align - 1)) == 0,
@@ -83,9 +92,22 @@ void* Arena::Alloc(size_t size, size_t align) {
   return p;
 }
 
-void Arena::Rewind(size_t size) { active_chunk_->offset -= size; }
+void Arena::Rewind(size_t size) {
+  assert_true(active_chunk_ && size <= active_chunk_->offset,
+              "rewinding past the beginning of the current chunk");
+  active_chunk_->offset -= size;
+}
+
+size_t Arena::peak_size() const {
+  return std::max(peak_reset_size_, CalculateSize());
+}
+
+void Arena::ResetStatistics() {
+  allocation_count_ = 0;
+  peak_reset_size_ = 0;
+}
 
-size_t Arena::CalculateSize() {
+size_t Arena::CalculateSize() const {
   size_t total_length = 0;
   Chunk* chunk = head_chunk_;
   while (chunk) {
@@ -28,6 +28,8 @@ class Arena {
   void Reset();
   void DebugFill();
 
+  // Any power of two alignment, and sizes larger than the chunk size (in a
+  // dedicated chunk) are supported.
   void* Alloc(size_t size, size_t align);
   template <typename T>
   T* Alloc() {
@@ -44,6 +46,11 @@ class Arena {
     CloneContents(buffer->data(), buffer->size() * sizeof(T));
   }
 
+  // Usage since construction or the last ResetStatistics, across Resets.
+  size_t allocation_count() const { return allocation_count_; }
+  size_t peak_size() const;
+  void ResetStatistics();
+
  private:
   class Chunk {
    public:
@@ -57,12 +64,16 @@ class Arena {
     size_t offset;
   };
 
-  size_t CalculateSize();
+  size_t CalculateSize() const;
   void CloneContents(void* buffer, size_t buffer_length);
 
   size_t chunk_size_;
   Chunk* head_chunk_;
   Chunk* active_chunk_;
+
+  size_t allocation_count_ = 0;
+  // Largest size before a Reset.
+  size_t peak_reset_size_ = 0;
 };
 
 }  // namespace xe
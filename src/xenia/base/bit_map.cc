@@ -9,6 +9,9 @@
 
 #include "xenia/base/bit_map.h"
 
+#include <cstring>
+#include <utility>
+
 #include "xenia/base/assert.h"
 #include "xenia/base/atomic.h"
 #include "xenia/base/math.h"
@@ -23,7 +26,8 @@ BitMap::BitMap(uint64_t* data, size_t size_bits) {
   assert_true(size_bits % kDataSizeBits == 0);
 
   data_.resize(size_bits / kDataSizeBits);
-  std::memcpy(data_.data(), data, size_bits / kDataSizeBits);
+  std::memcpy(data_.data(), data, size_bits / 8);
+  UpdateSummary();
 }
 inline size_t BitMap::TryAcquireAt(size_t i) {
   uint64_t entry = 0;
@@ -53,11 +57,46 @@ inline size_t BitMap::TryAcquireAt(size_t i) {
   }
   return -1LL;
 }
+void BitMap::MarkWordFull(size_t i) {
+  size_t summary_index = i / kDataSizeBits;
+  uint64_t bit = 1ull << (i % kDataSizeBits);
+  uint64_t summary = 0;
+  do {
+    summary = summary_[summary_index];
+    if (!(summary & bit)) {
+      return;
+    }
+  } while (!atomic_cas(summary, summary & ~bit, &summary_[summary_index]));
+  // An entry may have been released after the word was found full, but before
+  // its summary bit was cleared, and Release might have seen the bit still set.
+  if (*reinterpret_cast<volatile uint64_t*>(&data_[i])) {
+    SetSummaryBit(i);
+  }
+}
+
+void BitMap::SetSummaryBit(size_t i) {
+  size_t summary_index = i / kDataSizeBits;
+  uint64_t bit = 1ull << (i % kDataSizeBits);
+  uint64_t summary = 0;
+  do {
+    summary = summary_[summary_index];
+    if (summary & bit) {
+      return;
+    }
+  } while (!atomic_cas(summary, summary | bit, &summary_[summary_index]));
+}
+
 size_t BitMap::Acquire() {
-  for (size_t i = 0; i < data_.size(); i++) {
-    size_t attempt_result = TryAcquireAt(i);
-    if (attempt_result != -1LL) {
-      return attempt_result;
+  for (size_t i = 0; i < summary_.size(); i++) {
+    uint64_t summary = *reinterpret_cast<volatile uint64_t*>(&summary_[i]);
+    while (summary) {
+      size_t word_index = i * kDataSizeBits + tzcnt(summary);
+      size_t attempt_result = TryAcquireAt(word_index);
+      if (attempt_result != -1LL) {
+        return attempt_result;
+      }
+      MarkWordFull(word_index);
+      summary &= summary - 1;
     }
   }
 
@@ -65,13 +104,17 @@ size_t BitMap::Acquire() {
 }
 
 size_t BitMap::AcquireFromBack() {
-  if (!data_.size()) {
-    return -1LL;
-  }
-  for (ptrdiff_t i = data_.size() - 1; i >= 0; i--) {
-    size_t attempt_result = TryAcquireAt(static_cast<size_t>(i));
-    if (attempt_result != -1LL) {
-      return attempt_result;
+  for (size_t i = summary_.size(); i-- > 0;) {
+    uint64_t summary = *reinterpret_cast<volatile uint64_t*>(&summary_[i]);
+    while (summary) {
+      uint32_t bit_index = uint32_t(kDataSizeBits - 1 - lzcnt(summary));
+      size_t word_index = i * kDataSizeBits + bit_index;
+      size_t attempt_result = TryAcquireAt(word_index);
+      if (attempt_result != -1LL) {
+        return attempt_result;
+      }
+      MarkWordFull(word_index);
+      summary &= ~(1ull << bit_index);
     }
   }
 
@@ -92,6 +135,8 @@ void BitMap::Release(size_t index) {
 
     new_entry = entry | bit;
   } while (!atomic_cas(entry, new_entry, &data_[slot]));
+
+  SetSummaryBit(slot);
 }
 
 void BitMap::Resize(size_t new_size_bits) {
@@ -105,12 +150,29 @@ void BitMap::Resize(size_t new_size_bits) {
       data_[i] = -1;
     }
   }
+  UpdateSummary();
 }
 
 void BitMap::Reset() {
   for (size_t i = 0; i < data_.size(); i++) {
     data_[i] = -1;
   }
+  UpdateSummary();
+}
+
+void BitMap::SetData(std::vector<uint64_t> data) {
+  data_ = std::move(data);
+  UpdateSummary();
+}
+
+void BitMap::UpdateSummary() {
+  summary_.clear();
+  summary_.resize((data_.size() + kDataSizeBits - 1) / kDataSizeBits);
+  for (size_t i = 0; i < data_.size(); i++) {
+    if (data_[i]) {
+      summary_[i / kDataSizeBits] |= 1ull << (i % kDataSizeBits);
+    }
+  }
 }
 
 }  // namespace xe
\ No newline at end of file
@@ -17,6 +17,9 @@
 namespace xe {
 
 // Bit Map: Efficient lookup of free/used entries.
+// A second level of summary bits, one for every 64-entry word, tracks which
+// words may have free entries, so acquisition skips the full words without
+// touching them, and doesn't slow down as the map fills up.
 class BitMap {
  public:
   BitMap();
@@ -43,13 +46,23 @@ class BitMap {
   void Reset();
 
   const std::vector<uint64_t> data() const { return data_; }
-  std::vector<uint64_t>& data() { return data_; }
+  // Replaces the entries, such as when restoring the state, with set bits
+  // being free entries like in data().
+  void SetData(std::vector<uint64_t> data);
 
  private:
   const static size_t kDataSize = 8;
   const static size_t kDataSizeBits = kDataSize * 8;
   std::vector<uint64_t> data_;
+  // Bit i % 64 of summary_[i / 64] is set if data_[i] may have free entries.
+  // It's always set while data_[i] has free entries, but may stay set for some
+  // time after the last one has been acquired.
+  std::vector<uint64_t> summary_;
   inline size_t TryAcquireAt(size_t i);
+  // Clears the summary bit of a word found to be full.
+  void MarkWordFull(size_t i);
+  void SetSummaryBit(size_t i);
+  void UpdateSummary();
 };
 
 }  // namespace xe
@@ -14,8 +14,10 @@
 #include <mutex>
 
 #include "xenia/base/assert.h"
+#include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/mutex.h"
+#include "xenia/base/threading.h"
 
 #if defined(_WIN32)
 
@@ -31,6 +33,11 @@ DEFINE_bool(clock_source_raw, false,
             "Use the RDTSC instruction as the time source. "
             "Host CPU must support invariant TSC.",
             "CPU");
+DEFINE_bool(clock_guest_tsc, true,
+            "Derive the guest clock from the TSC if the host CPU has an "
+            "invariant one, calibrated against the host clock, so it can be "
+            "read without system calls, also directly by the generated code.",
+            "CPU");
 
 namespace xe {
 
@@ -45,17 +52,167 @@ uint64_t guest_system_time_base_ = Clock::QueryHostSystemTime();
 // Computed by RecomputeGuestTickScalar.
 std::pair<uint64_t, uint64_t> guest_tick_ratio_ = std::make_pair(1, 1);
 
-// Native guest ticks.
-uint64_t last_guest_tick_count_ = 0;
-// Last sampled host tick count.
-uint64_t last_host_tick_count_ = Clock::QueryHostTickCount();
+// Mapping of host ticks to guest ticks, initialized on the first use, after
+// the cvars have been loaded.
+Clock::GuestClockParameters guest_clock_;
+// Frequency of the host ticks of guest_clock_.
+uint64_t guest_clock_host_tick_frequency_ = 0;
+std::atomic<bool> guest_clock_initialized_{false};
+std::once_flag guest_clock_initialization_flag_;
 
 using tick_mutex_type = std::mutex;
 
-// Mutex to ensure last_host_tick_count_ and last_guest_tick_count_ are in sync
-// std::mutex tick_mutex_;
+// Mutex to serialize the changes of guest_tick_ratio_ and guest_clock_.
 static tick_mutex_type tick_mutex_;
 
+static uint64_t GuestClockHostTickCount() {
+#if XE_CLOCK_RAW_AVAILABLE
+  if (guest_clock_.host_ticks_tsc) {
+    return __rdtsc();
+  }
+#endif
+  return Clock::QueryHostTickCount();
+}
+
+// (host_tick_delta * multiplier) >> Clock::kGuestClockShift.
+static uint64_t ScaleGuestClockHostTicks(uint64_t host_tick_delta,
+                                         uint64_t multiplier) {
+  static_assert(Clock::kGuestClockShift == 32);
+#if XE_COMPILER_MSVC && XE_ARCH_AMD64
+  uint64_t product_high;
+  uint64_t product_low = _umul128(host_tick_delta, multiplier, &product_high);
+  return __shiftright128(product_low, product_high, 32);
+#elif XE_COMPILER_MSVC
+  return (__umulh(host_tick_delta, multiplier) << 32) |
+         ((host_tick_delta * multiplier) >> 32);
+#else
+  return uint64_t((unsigned __int128)host_tick_delta * multiplier >> 32);
+#endif
+}
+
+static uint64_t MapGuestClockHostTicks(uint64_t host_ticks,
+                                       uint64_t host_tick_base,
+                                       uint64_t guest_tick_base,
+                                       uint64_t multiplier) {
+  // The TSC may be slightly behind on another core.
+  uint64_t host_tick_delta =
+      host_ticks > host_tick_base ? host_ticks - host_tick_base : 0;
+  return guest_tick_base +
+         ScaleGuestClockHostTicks(host_tick_delta, multiplier);
+}
+
+static uint64_t ComputeGuestClockMultiplier() {
+  return uint64_t(double(guest_tick_frequency_) * guest_time_scalar_ /
+                      double(guest_clock_host_tick_frequency_) *
+                      double(UINT64_C(1) << Clock::kGuestClockShift) +
+                  0.5);
+}
+
+#if XE_CLOCK_RAW_AVAILABLE
+// Measures the TSC frequency against the platform clock, for CPUs not
+// reporting it, taking the platform clock samples with the shortest TSC
+// interval around them.
+static uint64_t CalibrateTscFrequency() {
+  constexpr uint32_t kCalibrationMillis = 20;
+  constexpr uint32_t kSampleAttempts = 16;
+  auto sample = [](uint64_t& tsc_out, uint64_t& platform_ticks_out) {
+    uint64_t best_tsc_interval = UINT64_MAX;
+    for (uint32_t i = 0; i < kSampleAttempts; ++i) {
+      uint64_t tsc_before = __rdtsc();
+      uint64_t platform_ticks = Clock::host_tick_count_platform();
+      uint64_t tsc_interval = __rdtsc() - tsc_before;
+      if (tsc_interval < best_tsc_interval) {
+        best_tsc_interval = tsc_interval;
+        tsc_out = tsc_before + tsc_interval / 2;
+        platform_ticks_out = platform_ticks;
+      }
+    }
+  };
+  uint64_t tsc_start, platform_ticks_start;
+  sample(tsc_start, platform_ticks_start);
+  xe::threading::Sleep(std::chrono::milliseconds(kCalibrationMillis));
+  uint64_t tsc_end, platform_ticks_end;
+  sample(tsc_end, platform_ticks_end);
+  if (tsc_end <= tsc_start || platform_ticks_end <= platform_ticks_start) {
+    return 0;
+  }
+  return uint64_t(double(tsc_end - tsc_start) *
+                      double(Clock::host_tick_frequency_platform()) /
+                      double(platform_ticks_end - platform_ticks_start) +
+                  0.5);
+}
+#endif
+
+static void InitializeGuestClock() {
+  std::call_once(guest_clock_initialization_flag_, []() {
+    bool host_ticks_tsc = false;
+#if XE_CLOCK_RAW_AVAILABLE
+    if (cvars::clock_guest_tsc && Clock::host_tsc_invariant()) {
+      uint64_t tsc_frequency = Clock::host_tsc_frequency_reported();
+      if (!tsc_frequency) {
+        tsc_frequency = CalibrateTscFrequency();
+      }
+      if (tsc_frequency) {
+        host_ticks_tsc = true;
+        guest_clock_host_tick_frequency_ = tsc_frequency;
+        XELOGI("Guest clock: invariant TSC at {} Hz", tsc_frequency);
+      }
+    }
+#endif
+    if (!host_ticks_tsc) {
+      guest_clock_host_tick_frequency_ = Clock::QueryHostTickFrequency();
+    }
+    guest_clock_.host_ticks_tsc = host_ticks_tsc;
+    guest_clock_.host_tick_base.store(GuestClockHostTickCount(),
+                                      std::memory_order_relaxed);
+    guest_clock_.guest_tick_base.store(0, std::memory_order_relaxed);
+    guest_clock_.multiplier.store(ComputeGuestClockMultiplier(),
+                                  std::memory_order_relaxed);
+    guest_clock_initialized_.store(true, std::memory_order_release);
+  });
+}
+
+// Rebases the guest clock at the current time, so the guest ticks stay
+// continuous when the rate is changed.
+static void UpdateGuestClockParameters() {
+  InitializeGuestClock();
+  std::lock_guard<tick_mutex_type> lock(tick_mutex_);
+  uint64_t host_ticks = GuestClockHostTickCount();
+  uint64_t guest_ticks = MapGuestClockHostTicks(
+      host_ticks, guest_clock_.host_tick_base.load(std::memory_order_relaxed),
+      guest_clock_.guest_tick_base.load(std::memory_order_relaxed),
+      guest_clock_.multiplier.load(std::memory_order_relaxed));
+  uint32_t sequence = guest_clock_.sequence.load(std::memory_order_relaxed);
+  guest_clock_.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  guest_clock_.host_tick_base.store(host_ticks, std::memory_order_relaxed);
+  guest_clock_.guest_tick_base.store(guest_ticks, std::memory_order_relaxed);
+  guest_clock_.multiplier.store(ComputeGuestClockMultiplier(),
+                                std::memory_order_relaxed);
+  guest_clock_.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+static uint64_t ReadGuestClock() {
+  if (!guest_clock_initialized_.load(std::memory_order_acquire)) {
+    InitializeGuestClock();
+  }
+  uint32_t sequence;
+  uint64_t host_ticks, host_tick_base, guest_tick_base, multiplier;
+  do {
+    sequence = guest_clock_.sequence.load(std::memory_order_acquire);
+    host_tick_base =
+        guest_clock_.host_tick_base.load(std::memory_order_relaxed);
+    guest_tick_base =
+        guest_clock_.guest_tick_base.load(std::memory_order_relaxed);
+    multiplier = guest_clock_.multiplier.load(std::memory_order_relaxed);
+    host_ticks = GuestClockHostTickCount();
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((sequence & 1) ||
+           guest_clock_.sequence.load(std::memory_order_relaxed) != sequence);
+  return MapGuestClockHostTicks(host_ticks, host_tick_base, guest_tick_base,
+                                multiplier);
+}
+
 void RecomputeGuestTickScalar() {
   // Create a rational number with numerator (first) and denominator (second)
   auto frac =
@@ -72,36 +229,23 @@ void RecomputeGuestTickScalar() {
   // Keep this a rational calculation and reduce the fraction
   reduce_fraction(frac);
 
-  std::lock_guard<tick_mutex_type> lock(tick_mutex_);
-  guest_tick_ratio_ = frac;
+  {
+    std::lock_guard<tick_mutex_type> lock(tick_mutex_);
+    guest_tick_ratio_ = frac;
+  }
+
+  UpdateGuestClockParameters();
 }
 
-// Update the guest timer for all threads.
-// Return a copy of the value so locking is reduced.
+// Current guest tick count, the same for all threads.
 uint64_t UpdateGuestClock() {
-  uint64_t host_tick_count = Clock::QueryHostTickCount();
-
   if (cvars::clock_no_scaling) {
     // Nothing to update, calculate on the fly
+    uint64_t host_tick_count = Clock::QueryHostTickCount();
     return host_tick_count * guest_tick_ratio_.first / guest_tick_ratio_.second;
   }
 
-  std::unique_lock<tick_mutex_type> lock(tick_mutex_, std::defer_lock);
-  if (lock.try_lock()) {
-    // Translate host tick count to guest tick count.
-    uint64_t host_tick_delta = host_tick_count > last_host_tick_count_
-                                   ? host_tick_count - last_host_tick_count_
-                                   : 0;
-    last_host_tick_count_ = host_tick_count;
-    uint64_t guest_tick_delta =
-        host_tick_delta * guest_tick_ratio_.first / guest_tick_ratio_.second;
-    last_guest_tick_count_ += guest_tick_delta;
-    return last_guest_tick_count_;
-  } else {
-    // Wait until another thread has finished updating the clock.
-    lock.lock();
-    return last_guest_tick_count_;
-  }
+  return ReadGuestClock();
 }
 
 // Offset of the current guest system file time relative to the guest base time.
@@ -169,7 +313,13 @@ uint64_t Clock::QueryGuestTickCount() {
   return guest_tick_count;
 }
 
-uint64_t* Clock::GetGuestTickCountPointer() { return &last_guest_tick_count_; }
+const Clock::GuestClockParameters& Clock::guest_clock_parameters() {
+  if (!guest_clock_initialized_.load(std::memory_order_acquire)) {
+    InitializeGuestClock();
+  }
+  return guest_clock_;
+}
+
 uint64_t Clock::QueryGuestSystemTime() {
   if (cvars::clock_no_scaling) {
     return Clock::QueryHostSystemTime();
@@ -10,6 +10,7 @@
 #ifndef XENIA_BASE_CLOCK_H_
 #define XENIA_BASE_CLOCK_H_
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 
@@ -22,6 +23,7 @@
 
 DECLARE_bool(clock_no_scaling);
 DECLARE_bool(clock_source_raw);
+DECLARE_bool(clock_guest_tsc);
 
 namespace xe {
 
@@ -43,8 +45,34 @@ class Clock {
   // speculatively executed each time the branch history was lost
   XE_NOINLINE
   static uint64_t host_tick_count_raw();
+  // Whether the TSC runs at a constant rate regardless of the power states,
+  // synchronized between the cores.
+  static bool host_tsc_invariant();
+  // TSC frequency reported by the CPU, or 0 if it's not reported.
+  static uint64_t host_tsc_frequency_reported();
 #endif
 
+  // Mapping of host ticks to guest ticks, updated when the guest tick
+  // frequency or the time scalar is changed, and read without locking, also
+  // by the generated code:
+  // guest ticks = guest_tick_base +
+  //     (((host ticks - host_tick_base) * multiplier) >> kGuestClockShift),
+  // with a 128-bit product, and a negative host tick difference clamped to 0.
+  // Published with a sequence lock - the sequence is odd while the parameters
+  // are being changed, so a reader must load the sequence, the parameters and
+  // the host ticks, and retry if the sequence was odd or has changed since.
+  struct alignas(XE_HOST_CACHE_LINE_SIZE) GuestClockParameters {
+    std::atomic<uint32_t> sequence;
+    // Host ticks are the TSC value if true, QueryHostTickCount otherwise.
+    // Constant after the initialization.
+    bool host_ticks_tsc;
+    std::atomic<uint64_t> host_tick_base;
+    std::atomic<uint64_t> guest_tick_base;
+    std::atomic<uint64_t> multiplier;
+  };
+  static constexpr uint32_t kGuestClockShift = 32;
+  static const GuestClockParameters& guest_clock_parameters();
+
   // Queries the host tick frequency.
   static uint64_t QueryHostTickFrequency();
   // Queries the current host tick count.
@@ -77,7 +105,6 @@ class Clock {
   // and scaling.
   static uint64_t QueryGuestTickCount();
 
-  static uint64_t* GetGuestTickCountPointer();
   // Queries the guest time, in FILETIME format, accounting for scaling.
   static uint64_t QueryGuestSystemTime();
   // Queries the milliseconds since the guest began, accounting for scaling.
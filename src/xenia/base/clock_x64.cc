@@ -45,32 +45,28 @@ namespace xe {
 // Getting the TSC frequency can be a bit tricky. This method here only works on
 // Intel as it seems. There is no easy way to get the frequency outside of ring0
 // on AMD, so we fail gracefully if not possible.
-XE_NOINLINE
-uint64_t Clock::host_tick_frequency_raw() {
+bool Clock::host_tsc_invariant() {
   uint32_t eax, ebx, ecx, edx;
 
-  // 00H Get max supported cpuid level.
-  xe_cpu_cpuid(0x0, eax, ebx, ecx, edx);
-  auto max_cpuid = eax;
   // 80000000H Get max extended cpuid level
   xe_cpu_cpuid(0x80000000, eax, ebx, ecx, edx);
   auto max_cpuid_ex = eax;
 
   // 80000007H Get extended power feature info
-  if (max_cpuid_ex >= 0x80000007) {
-    xe_cpu_cpuid(0x80000007, eax, ebx, ecx, edx);
-    // Invariant TSC bit at position 8
-    auto tsc_invariant = edx & (1 << 8);
-    // If the TSC is not invariant it will change its frequency with power
-    // states and across cores.
-    if (!tsc_invariant) {
-      CLOCK_FATAL("The CPU has no invariant TSC.");
-      return 0;
-    }
-  } else {
-    CLOCK_FATAL("Unclear if the CPU has an invariant TSC.")
-    return 0;
+  if (max_cpuid_ex < 0x80000007) {
+    return false;
   }
+  xe_cpu_cpuid(0x80000007, eax, ebx, ecx, edx);
+  // Invariant TSC bit at position 8
+  return (edx & (1 << 8)) != 0;
+}
+
+uint64_t Clock::host_tsc_frequency_reported() {
+  uint32_t eax, ebx, ecx, edx;
+
+  // 00H Get max supported cpuid level.
+  xe_cpu_cpuid(0x0, eax, ebx, ecx, edx);
+  auto max_cpuid = eax;
 
   if (max_cpuid >= 0x15) {
     // 15H Get TSC/Crystal ratio and Crystal Hz.
@@ -84,6 +80,28 @@ uint64_t Clock::host_tick_frequency_raw() {
       return cryst_freq * ratio_num / ratio_den;
     }
   }
+  return 0;
+}
+
+XE_NOINLINE
+uint64_t Clock::host_tick_frequency_raw() {
+  // If the TSC is not invariant it will change its frequency with power
+  // states and across cores.
+  if (!host_tsc_invariant()) {
+    CLOCK_FATAL("The CPU has no invariant TSC.");
+    return 0;
+  }
+
+  uint64_t reported_frequency = host_tsc_frequency_reported();
+  if (reported_frequency) {
+    return reported_frequency;
+  }
+
+  uint32_t eax, ebx, ecx, edx;
+
+  // 00H Get max supported cpuid level.
+  xe_cpu_cpuid(0x0, eax, ebx, ecx, edx);
+  auto max_cpuid = eax;
 
   if (max_cpuid >= 0x16) {
     // 16H Get CPU base frequency MHz in EAX.
@@ -0,0 +1,327 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_CONCURRENT_QUEUE_H_
+#define XENIA_BASE_CONCURRENT_QUEUE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+#include "xenia/base/platform.h"
+#include "xenia/base/threading.h"
+
+namespace xe {
+
+// Wait strategies of the concurrent queues, for when they're full or empty,
+// trading the latency of waking up for the processor time spent waiting.
+// Wait returns when the value may have changed from old_value, and Notify is
+// called after every change of a value that may be waited for.
+
+inline void SpinPause() {
+#if XE_ARCH_AMD64
+  _mm_pause();
+#elif XE_ARCH_ARM64 && XE_COMPILER_MSVC
+  __yield();
+#elif XE_ARCH_ARM64
+  __asm__ volatile("yield");
+#endif
+}
+
+// Busy-waits, for waits known to be very short, with the other side running on
+// another processor.
+class SpinWaitStrategy {
+ public:
+  void Wait(const std::atomic<uint32_t>& value, uint32_t old_value) {
+    while (value.load(std::memory_order_acquire) == old_value) {
+      SpinPause();
+    }
+  }
+  void Notify(const std::atomic<uint32_t>& value) {}
+};
+
+// Spins briefly, then gives the rest of the time slice to other threads.
+class YieldWaitStrategy {
+ public:
+  void Wait(const std::atomic<uint32_t>& value, uint32_t old_value) {
+    for (uint32_t i = 0; value.load(std::memory_order_acquire) == old_value;
+         ++i) {
+      if (i < kSpinCount) {
+        SpinPause();
+      } else {
+        xe::threading::MaybeYield();
+      }
+    }
+  }
+  void Notify(const std::atomic<uint32_t>& value) {}
+
+ private:
+  static constexpr uint32_t kSpinCount = 64;
+};
+
+// Spins briefly, then sleeps on the value (with a futex on Linux). Notify only
+// makes a system call while there are sleeping threads.
+class BlockingWaitStrategy {
+ public:
+  void Wait(const std::atomic<uint32_t>& value, uint32_t old_value) {
+    for (uint32_t i = 0; i < kSpinCount; ++i) {
+      if (value.load(std::memory_order_acquire) != old_value) {
+        return;
+      }
+      SpinPause();
+    }
+    waiter_count_.fetch_add(1, std::memory_order_seq_cst);
+    while (value.load(std::memory_order_seq_cst) == old_value) {
+      xe::threading::AtomicWait(value, old_value);
+    }
+    waiter_count_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  void Notify(const std::atomic<uint32_t>& value) {
+    // Either the waiter sees the new value before sleeping, or this sees the
+    // waiter.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiter_count_.load(std::memory_order_relaxed)) {
+      xe::threading::AtomicNotifyAll(value);
+    }
+  }
+
+ private:
+  static constexpr uint32_t kSpinCount = 64;
+  std::atomic<uint32_t> waiter_count_{0};
+};
+
+// Lock-free bounded single-producer, single-consumer ring of kCapacity
+// elements. The slots can also be accessed in place, for elements that are
+// expensive to move, such as audio frames - BeginWrite returns the slot to
+// write the next element to, or nullptr if the ring is full, and EndWrite
+// publishes it to the consumer, and the same for BeginRead and EndRead.
+template <typename T, uint32_t kCapacity,
+          typename WaitStrategy = YieldWaitStrategy>
+class SpscQueue {
+  static_assert(kCapacity && !(kCapacity & (kCapacity - 1)),
+                "The capacity must be a power of two");
+
+ public:
+  // Producer.
+
+  T* BeginWrite() {
+    uint32_t write_index = write_index_.load(std::memory_order_relaxed);
+    if (write_index - read_index_.load(std::memory_order_acquire) >=
+        kCapacity) {
+      return nullptr;
+    }
+    return &slots_[write_index & (kCapacity - 1)];
+  }
+  // Waits until there's space in the ring.
+  T& WaitBeginWrite() {
+    uint32_t write_index = write_index_.load(std::memory_order_relaxed);
+    while (true) {
+      uint32_t read_index = read_index_.load(std::memory_order_acquire);
+      if (write_index - read_index < kCapacity) {
+        return slots_[write_index & (kCapacity - 1)];
+      }
+      wait_strategy_.Wait(read_index_, read_index);
+    }
+  }
+  void EndWrite() {
+    write_index_.store(write_index_.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_release);
+    wait_strategy_.Notify(write_index_);
+  }
+  bool TryPush(T&& value) {
+    T* slot = BeginWrite();
+    if (!slot) {
+      return false;
+    }
+    *slot = std::move(value);
+    EndWrite();
+    return true;
+  }
+  void Push(T value) {
+    WaitBeginWrite() = std::move(value);
+    EndWrite();
+  }
+
+  // Consumer.
+
+  T* BeginRead() {
+    uint32_t read_index = read_index_.load(std::memory_order_relaxed);
+    if (read_index == write_index_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &slots_[read_index & (kCapacity - 1)];
+  }
+  // Waits until there's an element in the ring.
+  T& WaitBeginRead() {
+    uint32_t read_index = read_index_.load(std::memory_order_relaxed);
+    while (true) {
+      uint32_t write_index = write_index_.load(std::memory_order_acquire);
+      if (read_index != write_index) {
+        return slots_[read_index & (kCapacity - 1)];
+      }
+      wait_strategy_.Wait(write_index_, write_index);
+    }
+  }
+  void EndRead() {
+    read_index_.store(read_index_.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_release);
+    wait_strategy_.Notify(read_index_);
+  }
+  bool TryPop(T& value_out) {
+    T* slot = BeginRead();
+    if (!slot) {
+      return false;
+    }
+    value_out = std::move(*slot);
+    EndRead();
+    return true;
+  }
+  T Pop() {
+    T value = std::move(WaitBeginRead());
+    EndRead();
+    return value;
+  }
+
+  // Approximate if called while the other side is working.
+  uint32_t size() const {
+    return write_index_.load(std::memory_order_acquire) -
+           read_index_.load(std::memory_order_acquire);
+  }
+  bool empty() const { return !size(); }
+  static constexpr uint32_t capacity() { return kCapacity; }
+
+ private:
+  // Free-running indices, only written by the producer and the consumer
+  // respectively, on separate cache lines to avoid false sharing.
+  alignas(XE_HOST_CACHE_LINE_SIZE) std::atomic<uint32_t> write_index_{0};
+  alignas(XE_HOST_CACHE_LINE_SIZE) std::atomic<uint32_t> read_index_{0};
+  alignas(XE_HOST_CACHE_LINE_SIZE) WaitStrategy wait_strategy_;
+  alignas(XE_HOST_CACHE_LINE_SIZE) T slots_[kCapacity];
+};
+
+// Lock-free bounded multiple-producer, single-consumer queue of kCapacity
+// elements. Every slot has a sequence number telling whether it holds an
+// element of the current lap, so producers only contend for the write
+// position, and the consumer doesn't need atomic read-modify-write.
+template <typename T, uint32_t kCapacity,
+          typename WaitStrategy = YieldWaitStrategy>
+class MpscQueue {
+  static_assert(kCapacity && !(kCapacity & (kCapacity - 1)) &&
+                    kCapacity <= (UINT32_C(1) << 30),
+                "The capacity must be a power of two");
+
+ public:
+  MpscQueue() {
+    for (uint32_t i = 0; i < kCapacity; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Producers.
+
+  // Moves from the value only if it has been pushed.
+  bool TryPush(T&& value) {
+    uint32_t position = write_position_.load(std::memory_order_relaxed);
+    while (true) {
+      Slot& slot = slots_[position & (kCapacity - 1)];
+      uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+      int32_t lap_difference = int32_t(sequence - position);
+      if (!lap_difference) {
+        if (write_position_.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          Publish(slot, position, std::move(value));
+          return true;
+        }
+      } else if (lap_difference < 0) {
+        // Not consumed yet since the previous lap.
+        return false;
+      } else {
+        // Taken by another producer.
+        position = write_position_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+  // Waits until there's space in the queue.
+  void Push(T value) {
+    uint32_t position = write_position_.load(std::memory_order_relaxed);
+    while (true) {
+      Slot& slot = slots_[position & (kCapacity - 1)];
+      uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+      int32_t lap_difference = int32_t(sequence - position);
+      if (!lap_difference) {
+        if (write_position_.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          Publish(slot, position, std::move(value));
+          return;
+        }
+      } else {
+        if (lap_difference < 0) {
+          wait_strategy_.Wait(slot.sequence, sequence);
+        }
+        position = write_position_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Consumer.
+
+  bool TryPop(T& value_out) {
+    Slot& slot = slots_[read_position_ & (kCapacity - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != read_position_ + 1) {
+      return false;
+    }
+    Consume(slot, value_out);
+    return true;
+  }
+  // Waits until there's an element in the queue.
+  T Pop() {
+    Slot& slot = slots_[read_position_ & (kCapacity - 1)];
+    while (true) {
+      uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+      if (sequence == read_position_ + 1) {
+        break;
+      }
+      wait_strategy_.Wait(slot.sequence, sequence);
+    }
+    T value;
+    Consume(slot, value);
+    return value;
+  }
+
+  static constexpr uint32_t capacity() { return kCapacity; }
+
+ private:
+  struct Slot {
+    std::atomic<uint32_t> sequence;
+    T value;
+  };
+
+  void Publish(Slot& slot, uint32_t position, T&& value) {
+    slot.value = std::move(value);
+    slot.sequence.store(position + 1, std::memory_order_release);
+    wait_strategy_.Notify(slot.sequence);
+  }
+  void Consume(Slot& slot, T& value_out) {
+    value_out = std::move(slot.value);
+    // Free for the producer of the next lap.
+    slot.sequence.store(read_position_ + kCapacity, std::memory_order_release);
+    ++read_position_;
+    wait_strategy_.Notify(slot.sequence);
+  }
+
+  alignas(XE_HOST_CACHE_LINE_SIZE) std::atomic<uint32_t> write_position_{0};
+  // Only accessed by the consumer.
+  alignas(XE_HOST_CACHE_LINE_SIZE) uint32_t read_position_ = 0;
+  alignas(XE_HOST_CACHE_LINE_SIZE) WaitStrategy wait_strategy_;
+  alignas(XE_HOST_CACHE_LINE_SIZE) Slot slots_[kCapacity];
+};
+
+}  // namespace xe
+
+#endif  // XENIA_BASE_CONCURRENT_QUEUE_H_
@@ -48,6 +48,9 @@ class IConfigVar : virtual public ICommandVar {
   virtual const std::string& category() const = 0;
   virtual bool is_transient() const = 0;
   virtual std::string config_value() const = 0;
+  // The value currently in use, after applying the config, the game config and
+  // the command line.
+  virtual std::string effective_value() const = 0;
   virtual void LoadConfigValue(const toml::node* result) = 0;
   virtual void LoadGameConfigValue(const toml::node* result) = 0;
   virtual void ResetConfigValueToDefault() = 0;
@@ -83,6 +86,7 @@ class ConfigVar : public CommandVar<T>, virtual public IConfigVar {
   ConfigVar<T>(const char* name, T* default_value, const char* description,
                const char* category, bool is_transient);
   std::string config_value() const override;
+  std::string effective_value() const override;
   const T& GetTypedConfigValue() const;
   const std::string& category() const override;
   bool is_transient() const override;
@@ -251,6 +255,10 @@ std::string ConfigVar<T>::config_value() const {
   return this->ToString(this->default_value_);
 }
 template <class T>
+std::string ConfigVar<T>::effective_value() const {
+  return this->ToString(*this->current_value_);
+}
+template <class T>
 const T& ConfigVar<T>::GetTypedConfigValue() const {
   return config_value_ ? *config_value_ : this->default_value_;
 }
@@ -10,6 +10,10 @@
 #include "xenia/base/filesystem.h"
 
 #include <algorithm>
+#include <atomic>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/threading.h"
 
 namespace xe {
 namespace filesystem {
@@ -24,5 +28,46 @@ bool CreateParentFolder(const std::filesystem::path& path) {
   return true;
 }
 
+std::filesystem::path GetTemporaryFilePath(const std::filesystem::path& path) {
+  // The system thread ID is unique among the running processes, and the counter
+  // among the files created by the thread.
+  static std::atomic<uint32_t> counter{0};
+  std::filesystem::path temp_path = path;
+  temp_path += fmt::format(".{:x}-{:x}.tmp",
+                           xe::threading::current_thread_system_id(),
+                           counter.fetch_add(1, std::memory_order_relaxed));
+  return temp_path;
+}
+
+bool ReplaceFile(const std::filesystem::path& temp_path,
+                 const std::filesystem::path& path) {
+  std::error_code ec;
+  std::filesystem::rename(temp_path, path, ec);
+  if (ec) {
+    std::filesystem::remove(temp_path, ec);
+    return false;
+  }
+  return true;
+}
+
+bool FileHandle::ReadScatter(size_t file_offset, const ScatterBuffer* buffers,
+                             size_t buffer_count, size_t* out_bytes_read) {
+  size_t bytes_read_total = 0;
+  for (size_t i = 0; i < buffer_count; ++i) {
+    size_t bytes_read = 0;
+    if (!Read(file_offset + bytes_read_total, buffers[i].data,
+              buffers[i].length, &bytes_read)) {
+      return false;
+    }
+    bytes_read_total += bytes_read;
+    if (bytes_read < buffers[i].length) {
+      // End of the file.
+      break;
+    }
+  }
+  *out_bytes_read = bytes_read_total;
+  return true;
+}
+
 }  // namespace filesystem
 }  // namespace xe
@@ -62,6 +62,19 @@ int64_t Tell(FILE* file);
 // undefined.
 bool TruncateStdioFile(FILE* file, uint64_t length);
 
+// Returns a path for a temporary file next to the given path, unique within the
+// host, for writing a file completely before putting it in place with
+// ReplaceFile.
+std::filesystem::path GetTemporaryFilePath(const std::filesystem::path& path);
+
+// Moves a completely written temporary file to the path, replacing the file
+// there in one step, so readers, including other emulator instances sharing the
+// file, see either the old or the new contents in full, never a partially
+// written file. The temporary file is removed if it can't be moved - on
+// Windows, this happens while another process has the file open.
+bool ReplaceFile(const std::filesystem::path& temp_path,
+                 const std::filesystem::path& path);
+
 struct FileAccess {
   // Implies kFileReadData.
   static const uint32_t kGenericRead = 0x80000000;
@@ -74,6 +87,12 @@ struct FileAccess {
   static const uint32_t kFileAppendData = 0x00000004;
 };
 
+// A buffer of a scatter read.
+struct ScatterBuffer {
+  void* data;
+  size_t length;
+};
+
 class FileHandle {
  public:
   // Opens the file, failing if it doesn't exist.
@@ -91,6 +110,12 @@ class FileHandle {
   virtual bool Read(size_t file_offset, void* buffer, size_t buffer_length,
                     size_t* out_bytes_read) = 0;
 
+  // Reads into the buffers in order, as if they were one contiguous buffer,
+  // with as few system calls as possible. The total number of bytes read is
+  // returned only if the complete read succeeds.
+  virtual bool ReadScatter(size_t file_offset, const ScatterBuffer* buffers,
+                           size_t buffer_count, size_t* out_bytes_read);
+
   // Writes the given buffer to the file starting at the given offset.
   // The total number of bytes written is returned only if the complete
   // write succeeds.
@@ -22,7 +22,10 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <algorithm>
+#include <climits>
 #include <iostream>
 
 namespace xe {
@@ -145,6 +148,35 @@ class PosixFileHandle : public FileHandle {
     *out_bytes_read = out;
     return out >= 0 ? true : false;
   }
+  bool ReadScatter(size_t file_offset, const ScatterBuffer* buffers,
+                   size_t buffer_count, size_t* out_bytes_read) override {
+    // One system call per IOV_MAX buffers.
+    iovec iovecs[IOV_MAX];
+    size_t bytes_read_total = 0;
+    while (buffer_count) {
+      int iovec_count = int(std::min(buffer_count, size_t(IOV_MAX)));
+      size_t iovecs_length = 0;
+      for (int i = 0; i < iovec_count; ++i) {
+        iovecs[i].iov_base = buffers[i].data;
+        iovecs[i].iov_len = buffers[i].length;
+        iovecs_length += buffers[i].length;
+      }
+      ssize_t out = preadv(handle_, iovecs, iovec_count,
+                           off_t(file_offset + bytes_read_total));
+      if (out < 0) {
+        return false;
+      }
+      bytes_read_total += size_t(out);
+      if (size_t(out) < iovecs_length) {
+        // End of the file.
+        break;
+      }
+      buffers += iovec_count;
+      buffer_count -= iovec_count;
+    }
+    *out_bytes_read = bytes_read_total;
+    return true;
+  }
   bool Write(size_t file_offset, const void* buffer, size_t buffer_length,
              size_t* out_bytes_written) override {
     ssize_t out = pwrite(handle_, buffer, buffer_length, file_offset);
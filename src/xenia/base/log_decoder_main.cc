@@ -0,0 +1,144 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "xenia/base/console_app_main.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/logging_binary.h"
+
+DEFINE_transient_path(binary_log, "",
+                      "Binary log written with log_binary_file to decode.",
+                      "General");
+DEFINE_transient_path(text_log, "",
+                      "Text file to write the decoded log to, or empty to "
+                      "write it to stdout.",
+                      "General");
+
+namespace xe {
+namespace logging {
+namespace binary {
+
+// Writes a line the same way as the log writer thread.
+static void WriteTextLine(FILE* file, const RecordHeader& header,
+                          const fmt::memory_buffer& text) {
+  if (header.prefix_char) {
+    fmt::print(file, "{}> {:08X} ", header.prefix_char, header.thread_id);
+  }
+  fwrite(text.data(), 1, text.size(), file);
+  if (!text.size() || text[text.size() - 1] != '\n') {
+    fputc('\n', file);
+  }
+}
+
+int log_decoder_main(const std::vector<std::string>& args) {
+  if (cvars::binary_log.empty()) {
+    XELOGE("Usage: {} [binary_log] [text_log]", xe::path_to_utf8(args[0]));
+    return 1;
+  }
+
+  FILE* binary_file = xe::filesystem::OpenFile(cvars::binary_log, "rb");
+  if (!binary_file) {
+    XELOGE("Unable to open {}", xe::path_to_utf8(cvars::binary_log));
+    return 1;
+  }
+  FileHeader file_header;
+  if (fread(&file_header, sizeof(file_header), 1, binary_file) != 1 ||
+      std::memcmp(file_header.signature, kFileSignature,
+                  sizeof(kFileSignature)) ||
+      file_header.version != kFileVersion) {
+    XELOGE("{} is not a supported binary log",
+           xe::path_to_utf8(cvars::binary_log));
+    fclose(binary_file);
+    return 1;
+  }
+
+  FILE* text_file = stdout;
+  if (!cvars::text_log.empty()) {
+    text_file = xe::filesystem::OpenFile(cvars::text_log, "wt");
+    if (!text_file) {
+      XELOGE("Unable to create {}", xe::path_to_utf8(cvars::text_log));
+      fclose(binary_file);
+      return 1;
+    }
+  }
+
+  std::vector<std::string> formats;
+  std::vector<char> data;
+  fmt::memory_buffer text;
+  bool is_malformed = false;
+  RecordHeader header;
+  while (!is_malformed &&
+         fread(&header, sizeof(header), 1, binary_file) == 1) {
+    data.resize(header.data_size);
+    if (header.data_size &&
+        fread(data.data(), 1, header.data_size, binary_file) !=
+            header.data_size) {
+      // The emulator may have been terminated while writing.
+      XELOGW("The last record is incomplete");
+      break;
+    }
+    uint32_t format_id = UINT32_MAX;
+    if (header.type == RecordType::kFormat ||
+        header.type == RecordType::kLine) {
+      if (data.size() < sizeof(format_id)) {
+        is_malformed = true;
+        break;
+      }
+      std::memcpy(&format_id, data.data(), sizeof(format_id));
+    }
+    std::string_view record_data(data.data(), data.size());
+    text.clear();
+    switch (header.type) {
+      case RecordType::kFormat:
+        if (format_id >= formats.size()) {
+          formats.resize(size_t(format_id) + 1);
+        }
+        formats[format_id] = record_data.substr(sizeof(format_id));
+        continue;
+      case RecordType::kLine:
+        is_malformed =
+            format_id >= formats.size() ||
+            !FormatLine(formats[format_id],
+                        record_data.substr(sizeof(format_id)), text);
+        break;
+      case RecordType::kText:
+        text.append(data.data(), data.data() + data.size());
+        break;
+      default:
+        is_malformed = true;
+    }
+    if (!is_malformed) {
+      WriteTextLine(text_file, header, text);
+    }
+  }
+  if (is_malformed) {
+    XELOGE("{} contains a malformed record",
+           xe::path_to_utf8(cvars::binary_log));
+  }
+
+  if (text_file != stdout) {
+    fclose(text_file);
+  }
+  fclose(binary_file);
+  return is_malformed ? 1 : 0;
+}
+
+}  // namespace binary
+}  // namespace logging
+}  // namespace xe
+
+XE_DEFINE_CONSOLE_APP("xenia-log-decoder",
+                      xe::logging::binary::log_decoder_main,
+                      "[binary_log] [text_log]", "binary_log", "text_log");
@@ -13,7 +13,11 @@
 #include <atomic>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <iterator>
 #include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "third_party/disruptorplus/include/disruptorplus/multi_threaded_claim_strategy.hpp"
@@ -43,6 +47,7 @@
 #include "xenia/base/platform_win.h"
 #endif  // XE_PLATFORM
 
+#include "third_party/fmt/include/fmt/args.h"
 #include "third_party/fmt/include/fmt/format.h"
 
 #if XE_PLATFORM_ANDROID
@@ -52,7 +57,19 @@ DEFINE_bool(log_to_logcat, true, "Write log output to Android Logcat.",
 DEFINE_path(log_file, "", "Logs are written to the given file", "Logging");
 DEFINE_bool(log_to_stdout, true, "Write log output to stdout", "Logging");
 DEFINE_bool(log_to_debugprint, false, "Dump the log to DebugPrint.", "Logging");
+DEFINE_path(log_binary_file, "",
+            "With log_binary, write the log lines to the given file without "
+            "formatting them, to be converted to text with xenia-log-decoder. "
+            "The other logs then only contain the lines that had to be "
+            "formatted by the thread doing the logging.",
+            "Logging");
 #endif  // XE_PLATFORM_ANDROID
+DEFINE_bool(log_binary, false,
+            "Append log lines as the format string and the raw arguments, "
+            "formatting them on the log writer thread instead of the thread "
+            "doing the logging. Lines with arguments of other types than "
+            "numbers, pointers and strings are still formatted immediately.",
+            "Logging");
 DEFINE_bool(flush_log, true, "Flush log file after each log line batch.",
             "Logging");
 
@@ -78,7 +95,8 @@ Logger* logger_ = nullptr;
 struct LogLine {
   size_t buffer_length;
   uint32_t thread_id;
-  uint16_t _pad_0;  // (2b) padding
+  bool binary;
+  uint8_t _pad_0;  // (1b) padding
   bool terminate;
   char prefix_char;
 };
@@ -235,14 +253,27 @@ class Logger {
   }
 
   ~Logger() {
-    AppendLine(0, '\0', nullptr, 0, true);  // append a terminator
+    AppendLine(0, '\0', nullptr, 0, false, true);  // append a terminator
     xe::threading::Wait(write_thread_.get(), true);
+    if (binary_file_) {
+      fclose(binary_file_);
+    }
   }
 
   void AddLogSink(std::unique_ptr<LogSink>&& sink) {
     sinks_.push_back(std::move(sink));
   }
 
+  // Takes ownership of the file.
+  void SetBinaryFile(FILE* file) {
+    logging::binary::FileHeader header = {};
+    std::memcpy(header.signature, logging::binary::kFileSignature,
+                sizeof(header.signature));
+    header.version = logging::binary::kFileVersion;
+    fwrite(&header, sizeof(header), 1, file);
+    binary_file_ = file;
+  }
+
  private:
   static const size_t kBufferSize = 8_MiB;
   uint8_t buffer_[kBufferSize];
@@ -270,12 +301,113 @@ class Logger {
 
   std::unique_ptr<xe::threading::Thread> write_thread_;
 
+  // Only accessed by the writer thread.
+  FILE* binary_file_ = nullptr;
+  std::vector<char> binary_line_;
+  fmt::memory_buffer formatted_line_;
+  // Identifiers of the format strings already written to binary_file_, with
+  // the keys referencing binary_formats_.
+  std::unordered_map<std::string_view, uint32_t> binary_format_ids_;
+  std::deque<std::string> binary_formats_;
+
   void Write(const char* buf, size_t size) {
     for (const auto& sink : sinks_) {
       sink->Write(buf, size);
     }
   }
 
+  // The text may be in two parts if it's split in the ring buffer.
+  void WriteTextLine(char prefix_char, uint32_t thread_id, const char* first,
+                     size_t first_length, const char* second = nullptr,
+                     size_t second_length = 0) {
+    if (prefix_char) {
+      char prefix[] = {
+          prefix_char,
+          '>',
+          ' ',
+          '?',  // Thread ID gets placed here (8 chars).
+          '?',
+          '?',
+          '?',
+          '?',
+          '?',
+          '?',
+          '?',
+          ' ',
+          0,
+      };
+      fmt::format_to_n(prefix + 3, sizeof(prefix) - 3, "{:08X}", thread_id);
+      Write(prefix, sizeof(prefix) - 1);
+    }
+
+    if (first_length) {
+      Write(first, first_length);
+    }
+    if (second_length) {
+      Write(second, second_length);
+    }
+
+    // Always ensure there is a newline.
+    char last_char = second_length  ? second[second_length - 1]
+                     : first_length ? first[first_length - 1]
+                                    : '\0';
+    if (last_char != '\n') {
+      const char suffix[1] = {'\n'};
+      Write(suffix, 1);
+    }
+  }
+
+  void WriteBinaryRecord(logging::binary::RecordType type, const LogLine& line,
+                         const void* first, size_t first_size,
+                         const void* second = nullptr,
+                         size_t second_size = 0) {
+    logging::binary::RecordHeader header = {};
+    header.type = type;
+    header.prefix_char = line.prefix_char;
+    header.thread_id = line.thread_id;
+    header.data_size = uint32_t(first_size + second_size);
+    fwrite(&header, sizeof(header), 1, binary_file_);
+    if (first_size) {
+      fwrite(first, 1, first_size, binary_file_);
+    }
+    if (second_size) {
+      fwrite(second, 1, second_size, binary_file_);
+    }
+  }
+
+  void WriteBinaryLine(const LogLine& line) {
+    std::string_view format, args;
+    if (!logging::binary::SplitLine(binary_line_.data(), binary_line_.size(),
+                                    format, args)) {
+      assert_always("Malformed binary log line");
+      return;
+    }
+    if (binary_file_) {
+      // Formatting is left to xenia-log-decoder.
+      auto format_id_it = binary_format_ids_.find(format);
+      if (format_id_it == binary_format_ids_.end()) {
+        auto format_id = uint32_t(binary_formats_.size());
+        const std::string& stored_format = binary_formats_.emplace_back(format);
+        format_id_it =
+            binary_format_ids_.emplace(stored_format, format_id).first;
+        WriteBinaryRecord(logging::binary::RecordType::kFormat, line,
+                          &format_id, sizeof(format_id), stored_format.data(),
+                          stored_format.size());
+      }
+      WriteBinaryRecord(logging::binary::RecordType::kLine, line,
+                        &format_id_it->second, sizeof(uint32_t), args.data(),
+                        args.size());
+      return;
+    }
+    formatted_line_.clear();
+    if (!logging::binary::FormatLine(format, args, formatted_line_)) {
+      assert_always("Malformed binary log line arguments");
+      return;
+    }
+    WriteTextLine(line.prefix_char, line.thread_id, formatted_line_.data(),
+                  formatted_line_.size());
+  }
+
   void WriteThread() {
     RingBuffer rb(buffer_, kBufferSize);
 
@@ -315,53 +447,29 @@ class Logger {
           read_count += needed_count;
           i += needed_count;
 
-          if (line.prefix_char) {
-            char prefix[] = {
-                line.prefix_char,
-                '>',
-                ' ',
-                '?',  // Thread ID gets placed here (8 chars).
-                '?',
-                '?',
-                '?',
-                '?',
-                '?',
-                '?',
-                '?',
-                ' ',
-                0,
-            };
-            fmt::format_to_n(prefix + 3, sizeof(prefix) - 3, "{:08X}",
-                             line.thread_id);
-            Write(prefix, sizeof(prefix) - 1);
-          }
-
-          if (line.buffer_length) {
+          if (line.binary) {
+            // Made contiguous for decoding, as it may be split in the ring
+            // buffer.
+            binary_line_.resize(line.buffer_length);
+            rb.Read(binary_line_.data(), line.buffer_length);
+            WriteBinaryLine(line);
+          } else if (line.buffer_length) {
             // Get access to the line data - which may be split in the ring
             // buffer - and write it out in parts.
             auto line_range = rb.BeginRead(line.buffer_length);
-            Write(reinterpret_cast<const char*>(line_range.first),
-                  line_range.first_length);
-            if (line_range.second_length) {
-              Write(reinterpret_cast<const char*>(line_range.second),
-                    line_range.second_length);
-            }
-
-            // Always ensure there is a newline.
-            char last_char =
-                line_range.second
-                    ? line_range.second[line_range.second_length - 1]
-                    : line_range.first[line_range.first_length - 1];
-            if (last_char != '\n') {
-              const char suffix[1] = {'\n'};
-              Write(suffix, 1);
+            WriteTextLine(line.prefix_char, line.thread_id,
+                          reinterpret_cast<const char*>(line_range.first),
+                          line_range.first_length,
+                          reinterpret_cast<const char*>(line_range.second),
+                          line_range.second_length);
+            if (binary_file_ && !line.terminate) {
+              WriteBinaryRecord(logging::binary::RecordType::kText, line,
+                                line_range.first, line_range.first_length,
+                                line_range.second, line_range.second_length);
             }
-
             rb.EndRead(std::move(line_range));
           } else {
-            // Always ensure there is a newline.
-            const char suffix[1] = {'\n'};
-            Write(suffix, 1);
+            WriteTextLine(line.prefix_char, line.thread_id, nullptr, 0);
           }
 
           if (line.terminate) {
@@ -388,6 +496,9 @@ class Logger {
           for (const auto& sink : sinks_) {
             sink->Flush();
           }
+          if (binary_file_) {
+            fflush(binary_file_);
+          }
         }
 
         idle_loops = 0;
@@ -405,7 +516,7 @@ class Logger {
  public:
   void AppendLine(uint32_t thread_id, const char prefix_char,
                   const char* buffer_data, size_t buffer_length,
-                  bool terminate = false) {
+                  bool binary = false, bool terminate = false) {
     size_t count = BlockCount(sizeof(LogLine) + buffer_length);
 
     auto range = claim_strategy_.claim(count);
@@ -419,6 +530,7 @@ class Logger {
     line.buffer_length = buffer_length;
     line.thread_id = thread_id;
     line.prefix_char = prefix_char;
+    line.binary = binary;
     line.terminate = terminate;
 
     rb.Write(&line, sizeof(LogLine));
@@ -460,6 +572,14 @@ void InitializeLogging(const std::string_view app_name) {
   if (cvars::log_to_debugprint) {
     logger_->AddLogSink(std::make_unique<DebugPrintLogSink>());
   }
+
+  if (cvars::log_binary && !cvars::log_binary_file.empty()) {
+    xe::filesystem::CreateParentFolder(cvars::log_binary_file);
+    FILE* binary_file = xe::filesystem::OpenFile(cvars::log_binary_file, "wb");
+    if (binary_file) {
+      logger_->SetBinaryFile(binary_file);
+    }
+  }
 #endif  // XE_PLATFORM_ANDROID
 }
 
@@ -496,6 +616,17 @@ void logging::internal::AppendLogLine(LogLevel log_level,
   logger_->AppendLine(xe::threading::current_thread_id(), prefix_char,
                       thread_log_buffer_, written);
 }
+bool logging::internal::IsBinaryLogging() { return cvars::log_binary; }
+XE_NOALIAS
+void logging::internal::AppendBinaryLogLine(LogLevel log_level,
+                                            const char prefix_char,
+                                            size_t written) {
+  if (!logger_ || !ShouldLog(log_level) || !written) {
+    return;
+  }
+  logger_->AppendLine(xe::threading::current_thread_id(), prefix_char,
+                      thread_log_buffer_, written, true);
+}
 
 void logging::AppendLogLine(LogLevel log_level, const char prefix_char,
                             const std::string_view str, uint32_t log_mask) {
@@ -506,6 +637,120 @@ void logging::AppendLogLine(LogLevel log_level, const char prefix_char,
                       str.data(), str.size());
 }
 
+namespace logging::binary {
+
+namespace {
+class LineReader {
+ public:
+  explicit LineReader(std::string_view data) : data_(data) {}
+
+  bool empty() const { return data_.empty(); }
+  std::string_view remaining() const { return data_; }
+
+  template <typename T>
+  bool Read(T& value_out) {
+    if (data_.size() < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(&value_out, data_.data(), sizeof(T));
+    data_.remove_prefix(sizeof(T));
+    return true;
+  }
+  bool ReadString(std::string_view& str_out) {
+    uint32_t length;
+    if (!Read(length) || data_.size() < length) {
+      return false;
+    }
+    str_out = data_.substr(0, length);
+    data_.remove_prefix(length);
+    return true;
+  }
+
+ private:
+  std::string_view data_;
+};
+
+template <typename T>
+bool PushArg(LineReader& reader,
+             fmt::dynamic_format_arg_store<fmt::format_context>& store) {
+  T value;
+  if (!reader.Read(value)) {
+    return false;
+  }
+  store.push_back(value);
+  return true;
+}
+}  // namespace
+
+bool SplitLine(const char* line, size_t line_size, std::string_view& format_out,
+               std::string_view& args_out) {
+  LineReader reader(std::string_view(line, line_size));
+  if (!reader.ReadString(format_out)) {
+    return false;
+  }
+  args_out = reader.remaining();
+  return true;
+}
+
+bool FormatLine(std::string_view format, std::string_view args,
+                fmt::memory_buffer& out) {
+  fmt::dynamic_format_arg_store<fmt::format_context> store;
+  LineReader reader(args);
+  while (!reader.empty()) {
+    ArgType type;
+    reader.Read(type);
+    bool read;
+    switch (type) {
+      case ArgType::kInt32:
+        read = PushArg<int32_t>(reader, store);
+        break;
+      case ArgType::kUInt32:
+        read = PushArg<uint32_t>(reader, store);
+        break;
+      case ArgType::kInt64:
+        read = PushArg<int64_t>(reader, store);
+        break;
+      case ArgType::kUInt64:
+        read = PushArg<uint64_t>(reader, store);
+        break;
+      case ArgType::kFloat:
+        read = PushArg<float>(reader, store);
+        break;
+      case ArgType::kDouble:
+        read = PushArg<double>(reader, store);
+        break;
+      case ArgType::kBool: {
+        uint8_t value;
+        read = reader.Read(value);
+        store.push_back(bool(value));
+      } break;
+      case ArgType::kChar:
+        read = PushArg<char>(reader, store);
+        break;
+      case ArgType::kPointer: {
+        uint64_t value;
+        read = reader.Read(value);
+        store.push_back(reinterpret_cast<const void*>(uintptr_t(value)));
+      } break;
+      case ArgType::kString: {
+        std::string_view value;
+        read = reader.ReadString(value);
+        store.push_back(value);
+      } break;
+      default:
+        read = false;
+    }
+    if (!read) {
+      return false;
+    }
+  }
+  fmt::vformat_to(std::back_inserter(out),
+                  fmt::string_view(format.data(), format.size()), store);
+  return true;
+}
+
+}  // namespace logging::binary
+
 void FatalError(const std::string_view str) {
   logging::AppendLogLine(LogLevel::Error, 'x', str);
 
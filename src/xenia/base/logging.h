@@ -15,6 +15,7 @@
 #include <string>
 
 #include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/logging_binary.h"
 #include "xenia/base/string.h"
 
 namespace xe {
@@ -90,6 +91,11 @@ uint32_t GetLogLevel();
 std::pair<char*, size_t> GetThreadBuffer();
 XE_NOALIAS
 void AppendLogLine(LogLevel log_level, const char prefix_char, size_t written);
+bool IsBinaryLogging();
+// Appends a line encoded in the thread buffer with binary::EncodeLine.
+XE_NOALIAS
+void AppendBinaryLogLine(LogLevel log_level, const char prefix_char,
+                         size_t written);
 
 }  // namespace internal
 // technically, noalias is incorrect here, these functions do in fact alias
@@ -101,6 +107,17 @@ XE_NOALIAS XE_NOINLINE XE_COLD static void AppendLogLineFormat_Impl(
     LogLevel log_level, const char prefix_char, const char* format,
     const Args&... args) {
   auto target = internal::GetThreadBuffer();
+  if constexpr (binary::kAreArgsEncodable<Args...>) {
+    if (internal::IsBinaryLogging()) {
+      size_t written = binary::EncodeLine(target.first, target.second, format,
+                                          args...);
+      if (written) {
+        internal::AppendBinaryLogLine(log_level, prefix_char, written);
+        return;
+      }
+      // Too large to encode, formatting as text.
+    }
+  }
   auto result = fmt::format_to_n(target.first, target.second, format, args...);
   internal::AppendLogLine(log_level, prefix_char, result.size);
 }
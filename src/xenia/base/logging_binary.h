@@ -0,0 +1,230 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_LOGGING_BINARY_H_
+#define XENIA_BASE_LOGGING_BINARY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "third_party/fmt/include/fmt/format.h"
+
+// Binary log lines, appended with log_binary instead of being formatted by the
+// thread doing the logging. A line is the format string and the arguments in
+// their raw form, formatted by the log writer thread, or by xenia-log-decoder
+// after being written to a log_binary_file.
+//
+// Encoded line: uint32_t format string length, the format string, then for
+// every argument an ArgType followed by its value in the host byte order, with
+// strings being their uint32_t length and their characters.
+
+namespace xe {
+namespace logging {
+namespace binary {
+
+enum class ArgType : uint8_t {
+  kInt32,
+  kUInt32,
+  kInt64,
+  kUInt64,
+  kFloat,
+  kDouble,
+  kBool,
+  kChar,
+  kPointer,
+  kString,
+};
+
+class LineWriter {
+ public:
+  LineWriter(char* buffer, size_t capacity)
+      : buffer_(buffer), capacity_(capacity) {}
+
+  size_t size() const { return size_; }
+  bool overflowed() const { return overflowed_; }
+
+  void Append(const void* data, size_t size) {
+    if (size > capacity_ - size_) {
+      overflowed_ = true;
+      return;
+    }
+    std::memcpy(buffer_ + size_, data, size);
+    size_ += size;
+  }
+  template <typename T>
+  void AppendValue(ArgType type, T value) {
+    Append(&type, sizeof(type));
+    Append(&value, sizeof(value));
+  }
+  void AppendString(std::string_view str) {
+    if (str.size() > UINT32_MAX) {
+      overflowed_ = true;
+      return;
+    }
+    auto length = uint32_t(str.size());
+    Append(&length, sizeof(length));
+    Append(str.data(), str.size());
+  }
+
+ private:
+  char* buffer_;
+  size_t capacity_;
+  size_t size_ = 0;
+  bool overflowed_ = false;
+};
+
+// Types without an encoder, such as the ones with custom formatters, are
+// always formatted as text by the thread doing the logging.
+template <typename T, typename Enable = void>
+struct ArgEncoder {
+  static constexpr bool kEncodable = false;
+};
+
+template <typename T>
+struct ArgEncoder<T, std::enable_if_t<std::is_integral_v<T> &&
+                                      !std::is_same_v<T, bool> &&
+                                      !std::is_same_v<T, char>>> {
+  static constexpr bool kEncodable = true;
+  static void Encode(LineWriter& writer, T value) {
+    if constexpr (std::is_signed_v<T>) {
+      if constexpr (sizeof(T) <= sizeof(int32_t)) {
+        writer.AppendValue(ArgType::kInt32, int32_t(value));
+      } else {
+        writer.AppendValue(ArgType::kInt64, int64_t(value));
+      }
+    } else {
+      if constexpr (sizeof(T) <= sizeof(uint32_t)) {
+        writer.AppendValue(ArgType::kUInt32, uint32_t(value));
+      } else {
+        writer.AppendValue(ArgType::kUInt64, uint64_t(value));
+      }
+    }
+  }
+};
+
+template <>
+struct ArgEncoder<float> {
+  static constexpr bool kEncodable = true;
+  static void Encode(LineWriter& writer, float value) {
+    writer.AppendValue(ArgType::kFloat, value);
+  }
+};
+
+template <>
+struct ArgEncoder<double> {
+  static constexpr bool kEncodable = true;
+  static void Encode(LineWriter& writer, double value) {
+    writer.AppendValue(ArgType::kDouble, value);
+  }
+};
+
+template <>
+struct ArgEncoder<bool> {
+  static constexpr bool kEncodable = true;
+  static void Encode(LineWriter& writer, bool value) {
+    writer.AppendValue(ArgType::kBool, uint8_t(value));
+  }
+};
+
+template <>
+struct ArgEncoder<char> {
+  static constexpr bool kEncodable = true;
+  static void Encode(LineWriter& writer, char value) {
+    writer.AppendValue(ArgType::kChar, value);
+  }
+};
+
+template <typename T>
+struct ArgEncoder<T*, std::enable_if_t<std::is_void_v<T>>> {
+  static constexpr bool kEncodable = true;
+  static void Encode(LineWriter& writer, const void* value) {
+    writer.AppendValue(ArgType::kPointer, uint64_t(uintptr_t(value)));
+  }
+};
+
+template <typename T>
+struct ArgEncoder<
+    T, std::enable_if_t<std::is_same_v<T, const char*> ||
+                        std::is_same_v<T, char*> ||
+                        std::is_same_v<T, std::string_view> ||
+                        std::is_same_v<T, std::string>>> {
+  static constexpr bool kEncodable = true;
+  static void Encode(LineWriter& writer, std::string_view value) {
+    ArgType type = ArgType::kString;
+    writer.Append(&type, sizeof(type));
+    writer.AppendString(value);
+  }
+  static void Encode(LineWriter& writer, const char* value) {
+    Encode(writer, value ? std::string_view(value) : std::string_view());
+  }
+};
+
+// Character arrays, such as string literals, decay to pointers.
+template <typename... Args>
+constexpr bool kAreArgsEncodable =
+    (ArgEncoder<std::decay_t<Args>>::kEncodable && ...);
+
+// Returns the size of the line, or 0 if it doesn't fit in the buffer.
+template <typename... Args>
+size_t EncodeLine(char* buffer, size_t capacity, std::string_view format,
+                  const Args&... args) {
+  LineWriter writer(buffer, capacity);
+  writer.AppendString(format);
+  (ArgEncoder<std::decay_t<Args>>::Encode(writer, args), ...);
+  return writer.overflowed() ? 0 : writer.size();
+}
+
+// Splits an encoded line into the format string and the arguments, returns
+// false if it's malformed.
+bool SplitLine(const char* line, size_t line_size, std::string_view& format_out,
+               std::string_view& args_out);
+
+// Appends the text of a line to out, returns false if the arguments are
+// malformed.
+bool FormatLine(std::string_view format, std::string_view args,
+                fmt::memory_buffer& out);
+
+// log_binary_file contents, in the host byte order: a FileHeader, then records
+// until the end of the file, each being a RecordHeader and its data.
+constexpr char kFileSignature[4] = {'X', 'L', 'O', 'G'};
+constexpr uint32_t kFileVersion = 1;
+
+struct FileHeader {
+  char signature[4];
+  uint32_t version;
+};
+
+enum class RecordType : uint8_t {
+  // Data: uint32_t format string identifier, then the format string, written
+  // before the first line using it.
+  kFormat,
+  // Data: uint32_t format string identifier, then the encoded arguments.
+  kLine,
+  // Data: the text of a line that was formatted by the logging thread.
+  kText,
+};
+
+struct RecordHeader {
+  RecordType type;
+  // '\0' if the line has no prefix.
+  char prefix_char;
+  uint16_t reserved;
+  uint32_t thread_id;
+  uint32_t data_size;
+};
+
+}  // namespace binary
+}  // namespace logging
+}  // namespace xe
+
+#endif  // XENIA_BASE_LOGGING_BINARY_H_
@@ -19,6 +19,7 @@
 #include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/memory.h"
+#include "xenia/base/power.h"
 #include "xenia/base/system.h"
 #include "xenia/base/threading.h"
 
@@ -112,6 +113,8 @@ void InitializeAndroidAppFromMainThread(int32_t api_level,
 
   xe::memory::AndroidInitialize();
 
+  xe::power::AndroidInitialize();
+
   if (android_application_context_) {
     if (!xe::InitializeAndroidSystemForApplicationContext()) {
       __android_log_write(ANDROID_LOG_ERROR,
@@ -134,6 +137,8 @@ void ShutdownAndroidAppFromMainThread() {
 
   xe::ShutdownAndroidSystem();
 
+  xe::power::AndroidShutdown();
+
   xe::memory::AndroidShutdown();
 
   xe::ShutdownLogging();
@@ -10,6 +10,7 @@
 #include "xenia/base/memory.h"
 #include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
+#include "xenia/base/math.h"
 #include "xenia/base/platform.h"
 
 #if XE_ARCH_ARM64
@@ -23,6 +24,15 @@ DEFINE_bool(
     "Allow mapping memory with both write and execute access, for simulating "
     "behavior on platforms where that's not supported",
     "Memory");
+DEFINE_bool(
+    low_memory_mode, false,
+    "Reduce the host memory usage for hosts with little RAM, such as 8 GB "
+    "systems and handhelds, at the cost of more reloading of data. Uses "
+    "sparse / tiled GPU shared memory even if disabled with "
+    "d3d12_tiled_shared_memory or vulkan_sparse_shared_memory, caps the "
+    "texture cache memory limits and the unused texture lifetime, and "
+    "shrinks the upload buffers back after bursts of uploads.",
+    "Memory");
 
 namespace xe {
 namespace memory {
@@ -244,10 +254,157 @@ void copy_128_aligned(void* dest, const void* src, size_t count) {
 #else
 #define XE_WORKAROUND_CONSTANT_RETURN_IF(x)
 #endif
+
+// Swaps the bytes within each 32-byte block as specified by the shuffle mask,
+// returns the number of bytes processed.
+template <bool non_temporal>
+static size_t copy_and_swap_avx2(uint8_t* dest, const uint8_t* src,
+                                 size_t size, __m256i shufmask) {
+  size_t i = 0;
+  if constexpr (non_temporal) {
+    // Overlap the first unaligned store with the aligned ones, the
+    // destination is aligned to the element size so that swaps the same bytes.
+    // Stored after the aligned ones, which load the overlapping bytes, for
+    // swapping in place.
+    __m256i head = _mm256_shuffle_epi8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)), shufmask);
+    i = 32 - (reinterpret_cast<uintptr_t>(dest) & 31);
+    for (; i + 64 <= size; i += 64) {
+      __m256i input1 =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i]));
+      __m256i input2 =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i + 32]));
+      _mm256_stream_si256(reinterpret_cast<__m256i*>(&dest[i]),
+                          _mm256_shuffle_epi8(input1, shufmask));
+      _mm256_stream_si256(reinterpret_cast<__m256i*>(&dest[i + 32]),
+                          _mm256_shuffle_epi8(input2, shufmask));
+    }
+    _mm_sfence();
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), head);
+  }
+  // with vpshufb being a 0.5 through instruction, it makes the most sense to
+  // double up on our iters
+  for (; i + 64 <= size; i += 64) {
+    __m256i input1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i]));
+    __m256i input2 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i + 32]));
+    __m256i output1 = _mm256_shuffle_epi8(input1, shufmask);
+    __m256i output2 = _mm256_shuffle_epi8(input2, shufmask);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i]), output1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i + 32]), output2);
+  }
+  if (i + 32 <= size) {
+    __m256i input =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i]));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i]),
+                        _mm256_shuffle_epi8(input, shufmask));
+    i += 32;
+  }
+  return i;
+}
+
+// Returns the number of elements processed.
+static size_t copy_and_swap_avx2(void* dest, const void* src, size_t count,
+                                 size_t element_size, __m256i shufmask) {
+  size_t size = count * element_size;
+  auto dest_bytes = reinterpret_cast<uint8_t*>(dest);
+  auto src_bytes = reinterpret_cast<const uint8_t*>(src);
+  size_t processed =
+      size >= kNonTemporalCopyThreshold &&
+              !(reinterpret_cast<uintptr_t>(dest) & (element_size - 1))
+          ? copy_and_swap_avx2<true>(dest_bytes, src_bytes, size, shufmask)
+          : copy_and_swap_avx2<false>(dest_bytes, src_bytes, size, shufmask);
+  return processed / element_size;
+}
+
+// The rest of the code is built for AVX.
+#if XE_COMPILER_MSVC
+#define XE_TARGET_AVX512BW
+#else
+#define XE_TARGET_AVX512BW __attribute__((target("avx512f,avx512bw")))
+#endif
+
+static bool has_avx512bw() {
+  constexpr uint64_t kAVX512BWFlags =
+      amd64::kX64EmitAVX512F | amd64::kX64EmitAVX512BW;
+  return (amd64::GetFeatureFlags() & kAVX512BWFlags) == kAVX512BWFlags;
+}
+
+// Swaps the bytes within each 64-byte block as specified by the shuffle mask,
+// with the head and the tail handled with masked loads and stores, so there's
+// no scalar residual processing, and rewriting of the same bytes, which would
+// break swapping in place.
+template <bool non_temporal>
+XE_TARGET_AVX512BW static void copy_and_swap_avx512(uint8_t* dest,
+                                                    const uint8_t* src,
+                                                    size_t size,
+                                                    __m512i shufmask) {
+  size_t i = 0;
+  if constexpr (non_temporal) {
+    i = size_t(-reinterpret_cast<intptr_t>(dest) & 63);
+    if (i) {
+      __mmask64 head_mask = (UINT64_C(1) << i) - 1;
+      __m512i input = _mm512_maskz_loadu_epi8(head_mask, src);
+      _mm512_mask_storeu_epi8(dest, head_mask,
+                              _mm512_shuffle_epi8(input, shufmask));
+    }
+    for (; i + 128 <= size; i += 128) {
+      __m512i input1 = _mm512_loadu_si512(&src[i]);
+      __m512i input2 = _mm512_loadu_si512(&src[i + 64]);
+      _mm512_stream_si512(reinterpret_cast<__m512i*>(&dest[i]),
+                          _mm512_shuffle_epi8(input1, shufmask));
+      _mm512_stream_si512(reinterpret_cast<__m512i*>(&dest[i + 64]),
+                          _mm512_shuffle_epi8(input2, shufmask));
+    }
+    _mm_sfence();
+  }
+  for (; i + 128 <= size; i += 128) {
+    __m512i input1 = _mm512_loadu_si512(&src[i]);
+    __m512i input2 = _mm512_loadu_si512(&src[i + 64]);
+    _mm512_storeu_si512(&dest[i], _mm512_shuffle_epi8(input1, shufmask));
+    _mm512_storeu_si512(&dest[i + 64], _mm512_shuffle_epi8(input2, shufmask));
+  }
+  if (i + 64 <= size) {
+    __m512i input = _mm512_loadu_si512(&src[i]);
+    _mm512_storeu_si512(&dest[i], _mm512_shuffle_epi8(input, shufmask));
+    i += 64;
+  }
+  if (i < size) {
+    __mmask64 tail_mask = (UINT64_C(1) << (size - i)) - 1;
+    __m512i input = _mm512_maskz_loadu_epi8(tail_mask, &src[i]);
+    _mm512_mask_storeu_epi8(&dest[i], tail_mask,
+                            _mm512_shuffle_epi8(input, shufmask));
+  }
+}
+
+// Processes all the elements, with the shuffle mask for one 16-byte lane.
+XE_TARGET_AVX512BW static void copy_and_swap_avx512(void* dest,
+                                                    const void* src,
+                                                    size_t count,
+                                                    size_t element_size,
+                                                    __m128i shufmask) {
+  size_t size = count * element_size;
+  auto dest_bytes = reinterpret_cast<uint8_t*>(dest);
+  auto src_bytes = reinterpret_cast<const uint8_t*>(src);
+  __m512i shufmask_512 = _mm512_broadcast_i32x4(shufmask);
+  if (size >= kNonTemporalCopyThreshold &&
+      !(reinterpret_cast<uintptr_t>(dest) & (element_size - 1))) {
+    copy_and_swap_avx512<true>(dest_bytes, src_bytes, size, shufmask_512);
+  } else {
+    copy_and_swap_avx512<false>(dest_bytes, src_bytes, size, shufmask_512);
+  }
+}
+
 void copy_and_swap_16_aligned(void* dest_ptr, const void* src_ptr,
                               size_t count) {
   assert_zero(reinterpret_cast<uintptr_t>(dest_ptr) & 0xF);
   assert_zero(reinterpret_cast<uintptr_t>(src_ptr) & 0xF);
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+    // Unaligned AVX loads and stores are as fast when the data is aligned.
+    copy_and_swap_16_unaligned(dest_ptr, src_ptr, count);
+    return;
+  }
 
   auto dest = reinterpret_cast<uint16_t*>(dest_ptr);
   auto src = reinterpret_cast<const uint16_t*>(src_ptr);
@@ -275,8 +432,16 @@ void copy_and_swap_16_unaligned(void* dest_ptr, const void* src_ptr,
       _mm_set_epi8(0x0E, 0x0F, 0x0C, 0x0D, 0x0A, 0x0B, 0x08, 0x09, 0x06, 0x07,
                    0x04, 0x05, 0x02, 0x03, 0x00, 0x01);
 
-  size_t i;
-  for (i = 0; i + 8 <= count; i += 8) {
+  if (has_avx512bw()) {
+    copy_and_swap_avx512(dest, src, count, sizeof(*dest), shufmask);
+    return;
+  }
+  size_t i = 0;
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+    i = copy_and_swap_avx2(dest, src, count, sizeof(*dest),
+                           _mm256_broadcastsi128_si256(shufmask));
+  }
+  for (; i + 8 <= count; i += 8) {
     __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
     __m128i output = _mm_shuffle_epi8(input, shufmask);
     _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
@@ -291,6 +456,11 @@ void copy_and_swap_32_aligned(void* dest_ptr, const void* src_ptr,
                               size_t count) {
   assert_zero(reinterpret_cast<uintptr_t>(dest_ptr) & 0xF);
   assert_zero(reinterpret_cast<uintptr_t>(src_ptr) & 0xF);
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+    // Unaligned AVX loads and stores are as fast when the data is aligned.
+    copy_and_swap_32_unaligned(dest_ptr, src_ptr, count);
+    return;
+  }
 
   auto dest = reinterpret_cast<uint32_t*>(dest_ptr);
   auto src = reinterpret_cast<const uint32_t*>(src_ptr);
@@ -314,64 +484,24 @@ void copy_and_swap_32_unaligned(void* dest_ptr, const void* src_ptr,
                                 size_t count) {
   auto dest = reinterpret_cast<uint32_t*>(dest_ptr);
   auto src = reinterpret_cast<const uint32_t*>(src_ptr);
-  size_t i;
+  __m128i shufmask =
+      _mm_set_epi8(0x0C, 0x0D, 0x0E, 0x0F, 0x08, 0x09, 0x0A, 0x0B, 0x04, 0x05,
+                   0x06, 0x07, 0x00, 0x01, 0x02, 0x03);
+  if (has_avx512bw()) {
+    copy_and_swap_avx512(dest, src, count, sizeof(*dest), shufmask);
+    return;
+  }
+  size_t i = 0;
   // chrispy: this optimization mightt backfire if our unaligned load spans two
   // cachelines... which it probably will
   if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
-    __m256i shufmask = _mm256_set_epi8(
-        0x0C, 0x0D, 0x0E, 0x0F, 0x08, 0x09, 0x0A, 0x0B, 0x04, 0x05, 0x06, 0x07,
-        0x00, 0x01, 0x02, 0x03, 0x0C, 0x0D, 0x0E, 0x0F, 0x08, 0x09, 0x0A, 0x0B,
-        0x04, 0x05, 0x06, 0x07, 0x00, 0x01, 0x02, 0x03);
-    // with vpshufb being a 0.5 through instruction, it makes the most sense to
-    // double up on our iters
-    for (i = 0; i + 16 <= count; i += 16) {
-      __m256i input1 =
-          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i]));
-      __m256i input2 =
-          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i + 8]));
-
-      __m256i output1 = _mm256_shuffle_epi8(input1, shufmask);
-      __m256i output2 = _mm256_shuffle_epi8(input2, shufmask);
-// chrispy: todo, benchmark this w/ and w/out these prefetches here on multiple
-// machines finding a good distance for prefetchw in particular is probably
-// important for when we're writing across 2 cachelines
-#if 0
-      if (i + 48 <= count) {
-        swcache::PrefetchNTA(&src[i + 32]);
-        if (amd64::GetFeatureFlags() & amd64::kX64EmitPrefetchW) {
-          swcache::PrefetchW(&dest[i + 32]);
-        }
-      }
-#endif
-      _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i]), output1);
-      _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i + 8]), output2);
-    }
-    if (i + 8 <= count) {
-      __m256i input =
-          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i]));
-      __m256i output = _mm256_shuffle_epi8(input, shufmask);
-      _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i]), output);
-      i += 8;
-    }
-    if (i + 4 <= count) {
-      __m128i input =
-          _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
-      __m128i output =
-          _mm_shuffle_epi8(input, _mm256_castsi256_si128(shufmask));
-      _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
-      i += 4;
-    }
-  } else {
-    __m128i shufmask =
-        _mm_set_epi8(0x0C, 0x0D, 0x0E, 0x0F, 0x08, 0x09, 0x0A, 0x0B, 0x04, 0x05,
-                     0x06, 0x07, 0x00, 0x01, 0x02, 0x03);
-
-    for (i = 0; i + 4 <= count; i += 4) {
-      __m128i input =
-          _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
-      __m128i output = _mm_shuffle_epi8(input, shufmask);
-      _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
-    }
+    i = copy_and_swap_avx2(dest, src, count, sizeof(*dest),
+                           _mm256_broadcastsi128_si256(shufmask));
+  }
+  for (; i + 4 <= count; i += 4) {
+    __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
+    __m128i output = _mm_shuffle_epi8(input, shufmask);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
   }
   XE_WORKAROUND_CONSTANT_RETURN_IF(count % 4 == 0);
   for (; i < count; ++i) {  // handle residual elements
@@ -383,6 +513,11 @@ void copy_and_swap_64_aligned(void* dest_ptr, const void* src_ptr,
                               size_t count) {
   assert_zero(reinterpret_cast<uintptr_t>(dest_ptr) & 0xF);
   assert_zero(reinterpret_cast<uintptr_t>(src_ptr) & 0xF);
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+    // Unaligned AVX loads and stores are as fast when the data is aligned.
+    copy_and_swap_64_unaligned(dest_ptr, src_ptr, count);
+    return;
+  }
 
   auto dest = reinterpret_cast<uint64_t*>(dest_ptr);
   auto src = reinterpret_cast<const uint64_t*>(src_ptr);
@@ -410,8 +545,16 @@ void copy_and_swap_64_unaligned(void* dest_ptr, const void* src_ptr,
       _mm_set_epi8(0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x00, 0x01,
                    0x02, 0x03, 0x04, 0x05, 0x06, 0x07);
 
-  size_t i;
-  for (i = 0; i + 2 <= count; i += 2) {
+  if (has_avx512bw()) {
+    copy_and_swap_avx512(dest, src, count, sizeof(*dest), shufmask);
+    return;
+  }
+  size_t i = 0;
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+    i = copy_and_swap_avx2(dest, src, count, sizeof(*dest),
+                           _mm256_broadcastsi128_si256(shufmask));
+  }
+  for (; i + 2 <= count; i += 2) {
     __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
     __m128i output = _mm_shuffle_epi8(input, shufmask);
     _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
@@ -424,6 +567,11 @@ void copy_and_swap_64_unaligned(void* dest_ptr, const void* src_ptr,
 
 void copy_and_swap_16_in_32_aligned(void* dest_ptr, const void* src_ptr,
                                     size_t count) {
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+    // Unaligned AVX loads and stores are as fast when the data is aligned.
+    copy_and_swap_16_in_32_unaligned(dest_ptr, src_ptr, count);
+    return;
+  }
   auto dest = reinterpret_cast<uint32_t*>(dest_ptr);
   auto src = reinterpret_cast<const uint32_t*>(src_ptr);
   size_t i;
@@ -443,8 +591,20 @@ void copy_and_swap_16_in_32_unaligned(void* dest_ptr, const void* src_ptr,
                                       size_t count) {
   auto dest = reinterpret_cast<uint32_t*>(dest_ptr);
   auto src = reinterpret_cast<const uint32_t*>(src_ptr);
-  size_t i;
-  for (i = 0; i + 4 <= count; i += 4) {
+  // Swapping the 16-bit halves is a shuffle of the bytes too.
+  __m128i shufmask =
+      _mm_set_epi8(0x0D, 0x0C, 0x0F, 0x0E, 0x09, 0x08, 0x0B, 0x0A, 0x05, 0x04,
+                   0x07, 0x06, 0x01, 0x00, 0x03, 0x02);
+  if (has_avx512bw()) {
+    copy_and_swap_avx512(dest, src, count, sizeof(*dest), shufmask);
+    return;
+  }
+  size_t i = 0;
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+    i = copy_and_swap_avx2(dest, src, count, sizeof(*dest),
+                           _mm256_broadcastsi128_si256(shufmask));
+  }
+  for (; i + 4 <= count; i += 4) {
     __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
     __m128i output =
         _mm_or_si128(_mm_slli_epi32(input, 16), _mm_srli_epi32(input, 16));
@@ -456,6 +616,199 @@ void copy_and_swap_16_in_32_unaligned(void* dest_ptr, const void* src_ptr,
   }
 }
 
+size_t count_matching_prefix(const void* a_ptr, const void* b_ptr,
+                             size_t length) {
+  auto a = reinterpret_cast<const uint8_t*>(a_ptr);
+  auto b = reinterpret_cast<const uint8_t*>(b_ptr);
+  size_t i = 0;
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+    for (; i + 32 <= length; i += 32) {
+      __m256i a_bytes =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&a[i]));
+      __m256i b_bytes =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&b[i]));
+      uint32_t mismatches =
+          ~uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a_bytes, b_bytes)));
+      if (mismatches) {
+        return i + xe::tzcnt(mismatches);
+      }
+    }
+  }
+  for (; i + 16 <= length; i += 16) {
+    __m128i a_bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&a[i]));
+    __m128i b_bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&b[i]));
+    uint32_t mismatches =
+        ~uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(a_bytes, b_bytes))) &
+        0xFFFF;
+    if (mismatches) {
+      return i + xe::tzcnt(mismatches);
+    }
+  }
+  for (; i < length && a[i] == b[i]; ++i) {
+  }
+  return i;
+}
+
+size_t count_matching_prefix_32(const void* ptr, size_t count,
+                                uint32_t value) {
+  auto values = reinterpret_cast<const uint32_t*>(ptr);
+  size_t i = 0;
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+    __m256i pattern = _mm256_set1_epi32(int32_t(value));
+    for (; i + 8 <= count; i += 8) {
+      __m256i input =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&values[i]));
+      uint32_t mismatches = ~uint32_t(
+          _mm256_movemask_epi8(_mm256_cmpeq_epi32(input, pattern)));
+      if (mismatches) {
+        return i + xe::tzcnt(mismatches) / 4;
+      }
+    }
+  }
+  __m128i pattern = _mm_set1_epi32(int32_t(value));
+  for (; i + 4 <= count; i += 4) {
+    __m128i input =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(&values[i]));
+    uint32_t mismatches =
+        ~uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi32(input, pattern))) & 0xFFFF;
+    if (mismatches) {
+      return i + xe::tzcnt(mismatches) / 4;
+    }
+  }
+  for (; i < count && values[i] == value; ++i) {
+  }
+  return i;
+}
+
+void fill_32(void* dest_ptr, size_t count, uint32_t value) {
+  auto dest = reinterpret_cast<uint32_t*>(dest_ptr);
+  size_t i = 0;
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+    __m256i pattern = _mm256_set1_epi32(int32_t(value));
+    for (; i + 8 <= count; i += 8) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i]), pattern);
+    }
+  }
+  __m128i pattern = _mm_set1_epi32(int32_t(value));
+  for (; i + 4 <= count; i += 4) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), pattern);
+  }
+  for (; i < count; ++i) {
+    dest[i] = value;
+  }
+}
+
+// Below this size, the C library routines are the fastest, as they are
+// specialized for the exact size ranges.
+static constexpr size_t kSmallCopyThreshold = 2048;
+
+static void copy_bytes_non_temporal(uint8_t* dest, const uint8_t* src,
+                                    size_t size) {
+  // Align the destination to a cache line, so every line is written as a
+  // whole by the streaming stores.
+  size_t head = (0 - reinterpret_cast<uintptr_t>(dest)) & 63;
+  std::memcpy(dest, src, head);
+  size_t i = head;
+  for (; i + 64 <= size; i += 64) {
+    __m128i line0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
+    __m128i line1 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i + 16]));
+    __m128i line2 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i + 32]));
+    __m128i line3 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i + 48]));
+    _mm_stream_si128(reinterpret_cast<__m128i*>(&dest[i]), line0);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(&dest[i + 16]), line1);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(&dest[i + 32]), line2);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(&dest[i + 48]), line3);
+  }
+  _mm_sfence();
+  std::memcpy(&dest[i], &src[i], size - i);
+}
+
+void copy_bytes(void* dest_ptr, const void* src_ptr, size_t size) {
+  auto dest = reinterpret_cast<uint8_t*>(dest_ptr);
+  auto src = reinterpret_cast<const uint8_t*>(src_ptr);
+  if (size < kSmallCopyThreshold) {
+    std::memcpy(dest, src, size);
+    return;
+  }
+  if (size >= kNonTemporalCopyThreshold) {
+    copy_bytes_non_temporal(dest, src, size);
+    return;
+  }
+  if (amd64::GetFeatureFlags() & amd64::kX64FastRepMovs) {
+#if XE_COMPILER_MSVC
+    __movsb(dest, src, size);
+#else
+    __asm__ volatile("rep movsb"
+                     : "+D"(dest), "+S"(src), "+c"(size)
+                     :
+                     : "memory");
+#endif
+    return;
+  }
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+      __m256i low =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i]));
+      __m256i high =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i + 32]));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i]), low);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i + 32]), high);
+    }
+    std::memcpy(&dest[i], &src[i], size - i);
+    return;
+  }
+  std::memcpy(dest, src, size);
+}
+
+void fill_bytes(void* dest_ptr, uint8_t value, size_t size) {
+  auto dest = reinterpret_cast<uint8_t*>(dest_ptr);
+  if (size < kSmallCopyThreshold) {
+    std::memset(dest, value, size);
+    return;
+  }
+  if (size >= kNonTemporalCopyThreshold) {
+    size_t head = (0 - reinterpret_cast<uintptr_t>(dest)) & 63;
+    std::memset(dest, value, head);
+    __m128i pattern = _mm_set1_epi8(char(value));
+    size_t i = head;
+    for (; i + 64 <= size; i += 64) {
+      _mm_stream_si128(reinterpret_cast<__m128i*>(&dest[i]), pattern);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(&dest[i + 16]), pattern);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(&dest[i + 32]), pattern);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(&dest[i + 48]), pattern);
+    }
+    _mm_sfence();
+    std::memset(&dest[i], value, size - i);
+    return;
+  }
+  if (amd64::GetFeatureFlags() & amd64::kX64FastRepMovs) {
+#if XE_COMPILER_MSVC
+    __stosb(dest, value, size);
+#else
+    __asm__ volatile("rep stosb"
+                     : "+D"(dest), "+c"(size)
+                     : "a"(value)
+                     : "memory");
+#endif
+    return;
+  }
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
+    __m256i pattern = _mm256_set1_epi8(char(value));
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i]), pattern);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i + 32]), pattern);
+    }
+    std::memset(&dest[i], value, size - i);
+    return;
+  }
+  std::memset(dest, value, size);
+}
+
 #elif XE_ARCH_ARM64
 
 // Although NEON offers vector rev instructions (like vrev32q_u8), they are
@@ -570,6 +923,15 @@ void copy_and_swap_16_in_32_unaligned(void* dst_ptr, const void* src_ptr,
                                       size_t count) {
   auto dst = reinterpret_cast<uint16_t*>(dst_ptr);
   auto src = reinterpret_cast<const uint16_t*>(src_ptr);
+
+  while (count >= 4) {
+    vst1q_u16(dst, vrev32q_u16(vld1q_u16(src)));
+
+    count -= 4;
+    dst += 8;
+    src += 8;
+  }
+
   while (count > 0) {
     uint16_t word0 = *src++;
     uint16_t word1 = *src++;
@@ -642,4 +1004,42 @@ void copy_and_swap_16_in_32_unaligned(void* dst_ptr, const void* src_ptr,
 
 #endif
 
+#if !XE_ARCH_AMD64
+
+size_t count_matching_prefix(const void* a_ptr, const void* b_ptr,
+                             size_t length) {
+  auto a = reinterpret_cast<const uint8_t*>(a_ptr);
+  auto b = reinterpret_cast<const uint8_t*>(b_ptr);
+  size_t i = 0;
+  for (; i < length && a[i] == b[i]; ++i) {
+  }
+  return i;
+}
+
+size_t count_matching_prefix_32(const void* ptr, size_t count,
+                                uint32_t value) {
+  auto values = reinterpret_cast<const uint32_t*>(ptr);
+  size_t i = 0;
+  for (; i < count && values[i] == value; ++i) {
+  }
+  return i;
+}
+
+void fill_32(void* dest_ptr, size_t count, uint32_t value) {
+  auto dest = reinterpret_cast<uint32_t*>(dest_ptr);
+  for (size_t i = 0; i < count; ++i) {
+    dest[i] = value;
+  }
+}
+
+void copy_bytes(void* dest, const void* src, size_t size) {
+  std::memcpy(dest, src, size);
+}
+
+void fill_bytes(void* dest, uint8_t value, size_t size) {
+  std::memset(dest, value, size);
+}
+
+#endif
+
 }  // namespace xe
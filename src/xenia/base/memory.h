@@ -17,6 +17,7 @@
 #include <string>
 #include <string_view>
 #include <type_traits>
+#include <utility>
 
 #include "xenia/base/byte_order.h"
 
@@ -112,6 +113,16 @@ bool Protect(void* base_address, size_t length, PageAccess access,
 // the region.
 bool QueryProtect(void* base_address, size_t& length, PageAccess& access_out);
 
+// Asks the system to back the given range with large pages where the layout
+// allows it, keeping the ability to change the protection of individual
+// pages. Returns false if not supported by the host.
+bool AdviseLargePages(void* base_address, size_t length);
+
+// Asks the system to start reading the pages of a file mapping in the range
+// from the storage in the background. Returns false if not supported by the
+// host.
+bool AdviseWillNeed(const void* base_address, size_t length);
+
 // Allocates a block of memory for a type with the given alignment.
 // The memory must be freed with AlignedFree.
 template <typename T>
@@ -189,6 +200,24 @@ void copy_and_swap_16_in_32_aligned(void* dest, const void* src, size_t count);
 void copy_and_swap_16_in_32_unaligned(void* dest, const void* src,
                                       size_t count);
 
+// Returns how many bytes at the beginning of the buffers are equal.
+size_t count_matching_prefix(const void* a, const void* b, size_t length);
+// Returns how many 32-bit values at the beginning of the buffer are equal to
+// the value.
+size_t count_matching_prefix_32(const void* ptr, size_t count, uint32_t value);
+void fill_32(void* dest, size_t count, uint32_t value);
+
+// Ranges at least this large are written with non-temporal stores by
+// copy_bytes, fill_bytes and copy_and_swap, so copying them doesn't evict the
+// working set from the host caches.
+constexpr size_t kNonTemporalCopyThreshold = 4 * 1024 * 1024;
+// Equivalents of memcpy (for non-overlapping ranges) and memset for large or
+// variable sizes, using rep movsb / stosb on hosts with fast string
+// instructions, vector loops on others, and streaming stores above
+// kNonTemporalCopyThreshold.
+void copy_bytes(void* dest, const void* src, size_t size);
+void fill_bytes(void* dest, uint8_t value, size_t size);
+
 template <typename T>
 void copy_and_swap(T* dest, const T* src, size_t count) {
   bool is_aligned = reinterpret_cast<uintptr_t>(dest) % 32 == 0 &&
@@ -531,6 +560,10 @@ class FixedVMemVector {
   void clear() {
     resize(0);  // todo:maybe zero out
   }
+  void swap(FixedVMemVector& other) {
+    std::swap(data_, other.data_);
+    std::swap(nbytes_, other.nbytes_);
+  }
   void reserve(size_t size) { xenia_assert(size < sz); }
 };
 // software prefetches/cache operations
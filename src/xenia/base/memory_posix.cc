@@ -91,8 +91,7 @@ void* AllocFixed(void* base_address, size_t length,
   } else {
     flags = MAP_PRIVATE | MAP_ANONYMOUS;
   }
-  void* result = mmap(base_address, length, prot,
-                      MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS, -1, 0);
+  void* result = mmap(base_address, length, prot, flags, -1, 0);
   if (result == MAP_FAILED) {
     return nullptr;
   } else {
@@ -118,6 +117,25 @@ bool QueryProtect(void* base_address, size_t& length, PageAccess& access_out) {
   return false;
 }
 
+bool AdviseLargePages(void* base_address, size_t length) {
+#ifdef MADV_HUGEPAGE
+  // Transparent huge pages are split by the kernel when the protection of a
+  // part of them is changed, unlike hugetlbfs pages.
+  return madvise(base_address, length, MADV_HUGEPAGE) == 0;
+#else
+  return false;
+#endif
+}
+
+bool AdviseWillNeed(const void* base_address, size_t length) {
+  // madvise requires a page-aligned base.
+  uintptr_t page_mask = uintptr_t(page_size()) - 1;
+  uintptr_t address = reinterpret_cast<uintptr_t>(base_address);
+  uintptr_t aligned_address = address & ~page_mask;
+  return madvise(reinterpret_cast<void*>(aligned_address),
+                 length + (address - aligned_address), MADV_WILLNEED) == 0;
+}
+
 FileMappingHandle CreateFileMappingHandle(const std::filesystem::path& path,
                                           size_t length, PageAccess access,
                                           bool commit) {
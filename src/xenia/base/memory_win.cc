@@ -210,6 +210,20 @@ bool QueryProtect(void* base_address, size_t& length, PageAccess& access_out) {
   return true;
 }
 
+bool AdviseLargePages(void* base_address, size_t length) {
+  // Large pages require a SEC_LARGE_PAGES section committed as a whole, and
+  // their protection can't be changed at the granularity of smaller pages,
+  // which the guest heaps and the access watches rely on.
+  return false;
+}
+
+bool AdviseWillNeed(const void* base_address, size_t length) {
+  WIN32_MEMORY_RANGE_ENTRY range;
+  range.VirtualAddress = const_cast<void*>(base_address);
+  range.NumberOfBytes = length;
+  return PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0) != FALSE;
+}
+
 FileMappingHandle CreateFileMappingHandle(const std::filesystem::path& path,
                                           size_t length, PageAccess access,
                                           bool commit) {
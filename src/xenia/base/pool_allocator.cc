@@ -0,0 +1,122 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/pool_allocator.h"
+
+#include <cstdlib>
+
+#include "xenia/base/assert.h"
+#include "xenia/base/math.h"
+
+namespace xe {
+
+namespace {
+constexpr uint32_t kMinSizeClassLog2 = 4;
+constexpr uint32_t kMaxSizeClassLog2 = 12;
+constexpr uint32_t kSizeClassCount = kMaxSizeClassLog2 - kMinSizeClassLog2 + 1;
+static_assert(kPoolAllocatorMaxPooledSize ==
+              (size_t(1) << kMaxSizeClassLog2));
+// Blocks beyond this are freed, so a burst of allocations doesn't keep the
+// memory forever.
+constexpr uint32_t kMaxFreeBlocksPerSizeClass = 64;
+
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+struct ThreadPools {
+  FreeBlock* free_blocks[kSizeClassCount];
+  uint32_t free_block_counts[kSizeClassCount];
+  PoolAllocatorStatistics statistics;
+  bool releaser_registered;
+  // After the thread has been shut down, blocks are freed directly.
+  bool released;
+};
+// Trivially destructible, so it's still usable in the destructors of other
+// thread-local objects.
+thread_local ThreadPools thread_pools;
+
+class ThreadPoolsReleaser {
+ public:
+  ~ThreadPoolsReleaser() {
+    ThreadPools& pools = thread_pools;
+    for (uint32_t i = 0; i < kSizeClassCount; ++i) {
+      FreeBlock* block = pools.free_blocks[i];
+      while (block) {
+        FreeBlock* next = block->next;
+        std::free(block);
+        block = next;
+      }
+      pools.free_blocks[i] = nullptr;
+      pools.free_block_counts[i] = 0;
+    }
+    pools.released = true;
+  }
+  // For constructing the object on the thread, to destroy it on exit.
+  void Register() {}
+};
+thread_local ThreadPoolsReleaser thread_pools_releaser;
+
+uint32_t GetSizeClass(size_t size) {
+  if (size <= (size_t(1) << kMinSizeClassLog2)) {
+    return 0;
+  }
+  return uint32_t(64 - xe::lzcnt(uint64_t(size - 1))) - kMinSizeClassLog2;
+}
+}  // namespace
+
+void* PoolAllocate(size_t size) {
+  ThreadPools& pools = thread_pools;
+  if (size <= kPoolAllocatorMaxPooledSize) {
+    uint32_t size_class = GetSizeClass(size);
+    FreeBlock* block = pools.free_blocks[size_class];
+    if (block) {
+      pools.free_blocks[size_class] = block->next;
+      --pools.free_block_counts[size_class];
+      ++pools.statistics.pooled_allocations;
+      return block;
+    }
+    // Allocating the whole size class for the block to be reusable.
+    size = size_t(1) << (size_class + kMinSizeClassLog2);
+  }
+  ++pools.statistics.system_allocations;
+  void* block = std::malloc(size);
+  assert_not_null(block);
+  return block;
+}
+
+void PoolFree(void* block, size_t size) {
+  if (!block) {
+    return;
+  }
+  ThreadPools& pools = thread_pools;
+  if (size <= kPoolAllocatorMaxPooledSize && !pools.released) {
+    uint32_t size_class = GetSizeClass(size);
+    if (pools.free_block_counts[size_class] < kMaxFreeBlocksPerSizeClass) {
+      if (!pools.releaser_registered) {
+        thread_pools_releaser.Register();
+        pools.releaser_registered = true;
+      }
+      auto free_block = static_cast<FreeBlock*>(block);
+      free_block->next = pools.free_blocks[size_class];
+      pools.free_blocks[size_class] = free_block;
+      ++pools.free_block_counts[size_class];
+      return;
+    }
+  }
+  std::free(block);
+}
+
+PoolAllocatorStatistics GetThreadPoolAllocatorStatistics() {
+  return thread_pools.statistics;
+}
+
+void ResetThreadPoolAllocatorStatistics() { thread_pools.statistics = {}; }
+
+}  // namespace xe
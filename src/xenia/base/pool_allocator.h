@@ -0,0 +1,78 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_POOL_ALLOCATOR_H_
+#define XENIA_BASE_POOL_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace xe {
+
+// Thread-local pools of freed blocks in power of two size classes from 16 bytes
+// to 4 KiB, for short-lived allocations made at a high frequency, such as
+// per-draw and per-call temporaries, to avoid going to the system allocator
+// (and its locks) every time. A block freed on a thread other than the one
+// that allocated it is kept in the pool of the freeing thread. Larger blocks
+// are allocated and freed directly. The blocks are aligned like malloc.
+constexpr size_t kPoolAllocatorMaxPooledSize = 4096;
+
+void* PoolAllocate(size_t size);
+// The size must be the same as when allocating.
+void PoolFree(void* block, size_t size);
+
+struct PoolAllocatorStatistics {
+  // Allocations taking a block from the pools.
+  uint64_t pooled_allocations;
+  // Allocations made with the system allocator, because the pool of the size
+  // class was empty or the size was too large for pooling.
+  uint64_t system_allocations;
+};
+
+// Of the current thread, since it was started or the statistics were reset.
+PoolAllocatorStatistics GetThreadPoolAllocatorStatistics();
+void ResetThreadPoolAllocatorStatistics();
+
+// Allocator for the standard library containers using the pools.
+template <typename T>
+class PoolAllocator {
+ public:
+  static_assert(alignof(T) <= alignof(std::max_align_t),
+                "Pooled blocks are only aligned like malloc");
+
+  using value_type = T;
+
+  PoolAllocator() noexcept = default;
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+  T* allocate(size_t count) {
+    return static_cast<T*>(PoolAllocate(sizeof(T) * count));
+  }
+  void deallocate(T* block, size_t count) noexcept {
+    PoolFree(block, sizeof(T) * count);
+  }
+
+  template <typename U>
+  bool operator==(const PoolAllocator<U>&) const noexcept {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const PoolAllocator<U>&) const noexcept {
+    return false;
+  }
+};
+
+template <typename T>
+using pooled_vector = std::vector<T, PoolAllocator<T>>;
+
+}  // namespace xe
+
+#endif  // XENIA_BASE_POOL_ALLOCATOR_H_
@@ -0,0 +1,31 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/power.h"
+
+namespace xe {
+namespace power {
+
+#if !XE_PLATFORM_ANDROID
+// Not exposed by the other host platforms to applications in a usable way yet.
+
+float GetThermalHeadroom(uint32_t forecast_seconds) { return -1.0f; }
+bool IsThermalHeadroomAvailable() { return false; }
+
+bool PerformanceHintSession::IsSupported() { return false; }
+
+std::unique_ptr<PerformanceHintSession> PerformanceHintSession::Create(
+    const std::vector<uint32_t>& thread_system_ids,
+    uint64_t target_work_duration_ns) {
+  return nullptr;
+}
+#endif  // !XE_PLATFORM_ANDROID
+
+}  // namespace power
+}  // namespace xe
@@ -0,0 +1,56 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_POWER_H_
+#define XENIA_BASE_POWER_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "xenia/base/platform.h"
+
+namespace xe {
+namespace power {
+
+#if XE_PLATFORM_ANDROID
+void AndroidInitialize();
+void AndroidShutdown();
+#endif
+
+// Returns how close the host is expected to be to thermal throttling in the
+// specified number of seconds, from 0 (no load) to 1 (severe throttling), may
+// exceed 1. Returns a negative value if not available on the host. Must not be
+// called more often than once per second, the OS may fail the query otherwise.
+float GetThermalHeadroom(uint32_t forecast_seconds);
+// Whether GetThermalHeadroom may return valid values on the host.
+bool IsThermalHeadroomAvailable();
+
+// Tells the OS how long a group of threads should take to do periodic work,
+// such as producing a frame, so it can adjust the CPU clocks to meet the target
+// before the load changes are visible to the usual CPU frequency governor.
+class PerformanceHintSession {
+ public:
+  static bool IsSupported();
+  // Returns nullptr if not supported on the host. The thread IDs are the
+  // system IDs of the host threads.
+  static std::unique_ptr<PerformanceHintSession> Create(
+      const std::vector<uint32_t>& thread_system_ids,
+      uint64_t target_work_duration_ns);
+
+  virtual ~PerformanceHintSession() = default;
+
+  virtual void UpdateTargetWorkDuration(uint64_t target_work_duration_ns) = 0;
+  virtual void ReportActualWorkDuration(uint64_t actual_work_duration_ns) = 0;
+};
+
+}  // namespace power
+}  // namespace xe
+
+#endif  // XENIA_BASE_POWER_H_
@@ -0,0 +1,174 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/power.h"
+
+#include <dlfcn.h>
+#include <algorithm>
+#include <cmath>
+
+#include "xenia/base/assert.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/main_android.h"
+
+namespace xe {
+namespace power {
+
+// The functions are loaded dynamically because they are newer than the minimum
+// supported API level. The opaque manager and session types are void.
+
+// May be null if no dynamically loaded functions are available.
+static void* libandroid_;
+
+// API 31+ (AThermal_getThermalHeadroom is the reason for requiring 31).
+static void* (*android_AThermal_acquireManager_)();
+static void (*android_AThermal_releaseManager_)(void* manager);
+static float (*android_AThermal_getThermalHeadroom_)(void* manager,
+                                                     int forecast_seconds);
+static void* android_thermal_manager_;
+
+// API 33+.
+static void* (*android_APerformanceHint_getManager_)();
+static void* (*android_APerformanceHint_createSession_)(
+    void* manager, const int32_t* thread_ids, size_t size,
+    int64_t initial_target_work_duration_nanos);
+static int (*android_APerformanceHint_updateTargetWorkDuration_)(
+    void* session, int64_t target_duration_nanos);
+static int (*android_APerformanceHint_reportActualWorkDuration_)(
+    void* session, int64_t actual_duration_nanos);
+static void (*android_APerformanceHint_closeSession_)(void* session);
+static void* android_performance_hint_manager_;
+
+template <typename Function>
+static bool LoadLibandroidFunction(Function& function_out, const char* name) {
+  function_out = reinterpret_cast<Function>(dlsym(libandroid_, name));
+  return function_out != nullptr;
+}
+
+void AndroidInitialize() {
+  int32_t api_level = xe::GetAndroidApiLevel();
+  if (api_level < 31) {
+    return;
+  }
+  libandroid_ = dlopen("libandroid.so", RTLD_NOW);
+  assert_not_null(libandroid_);
+  if (!libandroid_) {
+    return;
+  }
+
+  bool thermal_functions_loaded = true;
+  thermal_functions_loaded &= LoadLibandroidFunction(
+      android_AThermal_acquireManager_, "AThermal_acquireManager");
+  thermal_functions_loaded &= LoadLibandroidFunction(
+      android_AThermal_releaseManager_, "AThermal_releaseManager");
+  thermal_functions_loaded &= LoadLibandroidFunction(
+      android_AThermal_getThermalHeadroom_, "AThermal_getThermalHeadroom");
+  assert_true(thermal_functions_loaded);
+  if (thermal_functions_loaded) {
+    android_thermal_manager_ = android_AThermal_acquireManager_();
+  }
+
+  if (api_level >= 33) {
+    bool performance_hint_functions_loaded = true;
+    performance_hint_functions_loaded &=
+        LoadLibandroidFunction(android_APerformanceHint_getManager_,
+                               "APerformanceHint_getManager");
+    performance_hint_functions_loaded &=
+        LoadLibandroidFunction(android_APerformanceHint_createSession_,
+                               "APerformanceHint_createSession");
+    performance_hint_functions_loaded &= LoadLibandroidFunction(
+        android_APerformanceHint_updateTargetWorkDuration_,
+        "APerformanceHint_updateTargetWorkDuration");
+    performance_hint_functions_loaded &= LoadLibandroidFunction(
+        android_APerformanceHint_reportActualWorkDuration_,
+        "APerformanceHint_reportActualWorkDuration");
+    performance_hint_functions_loaded &=
+        LoadLibandroidFunction(android_APerformanceHint_closeSession_,
+                               "APerformanceHint_closeSession");
+    assert_true(performance_hint_functions_loaded);
+    if (performance_hint_functions_loaded) {
+      // Null if the device doesn't support performance hints.
+      android_performance_hint_manager_ =
+          android_APerformanceHint_getManager_();
+    }
+  }
+}
+
+void AndroidShutdown() {
+  android_performance_hint_manager_ = nullptr;
+  if (android_thermal_manager_) {
+    android_AThermal_releaseManager_(android_thermal_manager_);
+    android_thermal_manager_ = nullptr;
+  }
+  if (libandroid_) {
+    dlclose(libandroid_);
+    libandroid_ = nullptr;
+  }
+}
+
+float GetThermalHeadroom(uint32_t forecast_seconds) {
+  if (!android_thermal_manager_) {
+    return -1.0f;
+  }
+  float headroom = android_AThermal_getThermalHeadroom_(
+      android_thermal_manager_,
+      int(std::min(forecast_seconds, uint32_t(60))));
+  // NaN if not supported by the device or polled too often.
+  return std::isnan(headroom) ? -1.0f : headroom;
+}
+
+bool IsThermalHeadroomAvailable() {
+  return android_thermal_manager_ != nullptr;
+}
+
+class AndroidPerformanceHintSession : public PerformanceHintSession {
+ public:
+  explicit AndroidPerformanceHintSession(void* session) : session_(session) {}
+  ~AndroidPerformanceHintSession() override {
+    android_APerformanceHint_closeSession_(session_);
+  }
+
+  void UpdateTargetWorkDuration(uint64_t target_work_duration_ns) override {
+    android_APerformanceHint_updateTargetWorkDuration_(
+        session_, int64_t(std::max(target_work_duration_ns, uint64_t(1))));
+  }
+  void ReportActualWorkDuration(uint64_t actual_work_duration_ns) override {
+    android_APerformanceHint_reportActualWorkDuration_(
+        session_, int64_t(std::max(actual_work_duration_ns, uint64_t(1))));
+  }
+
+ private:
+  void* session_;
+};
+
+bool PerformanceHintSession::IsSupported() {
+  return android_performance_hint_manager_ != nullptr;
+}
+
+std::unique_ptr<PerformanceHintSession> PerformanceHintSession::Create(
+    const std::vector<uint32_t>& thread_system_ids,
+    uint64_t target_work_duration_ns) {
+  if (!android_performance_hint_manager_ || thread_system_ids.empty()) {
+    return nullptr;
+  }
+  std::vector<int32_t> thread_ids(thread_system_ids.cbegin(),
+                                  thread_system_ids.cend());
+  void* session = android_APerformanceHint_createSession_(
+      android_performance_hint_manager_, thread_ids.data(), thread_ids.size(),
+      int64_t(std::max(target_work_duration_ns, uint64_t(1))));
+  if (!session) {
+    XELOGW("Failed to create a performance hint session for {} threads",
+           thread_ids.size());
+    return nullptr;
+  }
+  return std::make_unique<AndroidPerformanceHintSession>(session);
+}
+
+}  // namespace power
+}  // namespace xe
@@ -13,8 +13,29 @@ project("xenia-base")
   local_platform_files()
   removefiles({"console_app_main_*.cc"})
   removefiles({"main_init_*.cc"})
+  removefiles({"log_decoder_main.cc"})
   files({
     "debug_visualizers.natvis",
   })
 
+  filter("platforms:Windows")
+    links({
+      -- WaitOnAddress.
+      "synchronization",
+    })
+  filter({})
+
+project("xenia-log-decoder")
+  uuid("8b1f3e2a-6c4d-4e59-a7b0-3d9c5f21e6a4")
+  kind("ConsoleApp")
+  language("C++")
+  links({
+    "fmt",
+    "xenia-base",
+  })
+  files({
+    "log_decoder_main.cc",
+    "console_app_main_"..platform_suffix..".cc",
+  })
+
 include("testing")
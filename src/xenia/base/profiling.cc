@@ -52,6 +52,12 @@
 DEFINE_bool(profiler_dpi_scaling, false,
             "Apply window DPI scaling to the profiler.", "UI");
 DEFINE_bool(show_profiler, false, "Show profiling UI by default.", "UI");
+DEFINE_path(profile_trace_path, "",
+            "Path to write the profiling scopes and counters to as Chrome "
+            "trace events, viewable in chrome://tracing or Perfetto, from "
+            "startup until exit. Only used when the build doesn't include "
+            "microprofile.",
+            "General");
 
 namespace xe {
 
@@ -333,20 +339,26 @@ void Profiler::PostInputEvent() {
 
 #else
 
-bool Profiler::is_enabled() { return false; }
+bool Profiler::is_enabled() { return ProfileTrace::is_active(); }
 bool Profiler::is_visible() { return false; }
-void Profiler::Initialize() {}
+void Profiler::Initialize() {
+  if (!cvars::profile_trace_path.empty()) {
+    ProfileTrace::Start(cvars::profile_trace_path);
+  }
+}
 void Profiler::Dump() {}
-void Profiler::Shutdown() {}
+void Profiler::Shutdown() { ProfileTrace::Stop(); }
 uint32_t Profiler::GetColor(const char* str) { return 0; }
-void Profiler::ThreadEnter(const char* name) {}
-void Profiler::ThreadExit() {}
+void Profiler::ThreadEnter(const char* name) {
+  ProfileTrace::SetThreadName(name);
+}
+void Profiler::ThreadExit() { ProfileTrace::FlushThread(); }
 void Profiler::ToggleDisplay() {}
 void Profiler::TogglePause() {}
 void Profiler::SetUserIO(size_t z_order, ui::Window* window,
                          ui::Presenter* presenter,
                          ui::ImmediateDrawer* immediate_drawer) {}
-void Profiler::Flip() {}
+void Profiler::Flip() { ProfileTrace::RecordFrame(); }
 
 #endif  // XE_OPTION_PROFILING
 
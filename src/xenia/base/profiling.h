@@ -31,6 +31,8 @@
 // Pollutes the global namespace. Yuck.
 #define MICROPROFILE_MAX_THREADS 256
 #include <microprofile/microprofile.h>
+#else
+#include "xenia/base/profiling_trace.h"
 #endif  // XE_OPTION_PROFILING
 
 namespace xe {
@@ -113,19 +115,26 @@ namespace xe {
 
 #else
 
+// Without microprofile, the CPU scopes and the counters are recorded by
+// xe::ProfileTrace while a trace is being written (see profile_trace_path).
+// GPU scopes need GPU timestamps, which only microprofile provides.
+#define XE_PROFILE_TRACE_CONCAT_(a, b) a##b
+#define XE_PROFILE_TRACE_CONCAT(a, b) XE_PROFILE_TRACE_CONCAT_(a, b)
+#define XE_PROFILE_TRACE_SCOPE(group_name, scope_name)                \
+  xe::ProfileTraceScope XE_PROFILE_TRACE_CONCAT(profile_trace_scope_, \
+                                                __LINE__)(group_name,  \
+                                                          scope_name)
+
 #define DEFINE_profile_cpu(name, group_name, scope_name)
 #define DEFINE_profile_gpu(name, group_name, scope_name)
 #define DECLARE_profile_cpu(name)
 #define DECLARE_profile_gpu(name)
-#define SCOPE_profile_cpu(name) \
-  do {                          \
-  } while (false)
-#define SCOPE_profile_cpu_f(name) \
-  do {                            \
-  } while (false)
+// The definition isn't available, so the scope is named after the identifier.
+#define SCOPE_profile_cpu(name) XE_PROFILE_TRACE_SCOPE("", #name)
+#define SCOPE_profile_cpu_f(group_name) \
+  XE_PROFILE_TRACE_SCOPE(group_name, __FUNCTION__)
 #define SCOPE_profile_cpu_i(group_name, scope_name) \
-  do {                                              \
-  } while (false)
+  XE_PROFILE_TRACE_SCOPE(group_name, scope_name)
 #define SCOPE_profile_gpu(name) \
   do {                          \
   } while (false)
@@ -141,8 +150,12 @@ namespace xe {
 #define COUNT_profile_sub(name, count) \
   do {                                 \
   } while (false)
-#define COUNT_profile_set(name, count) \
-  do {                                 \
+// The count is only evaluated while a trace is being written.
+#define COUNT_profile_set(name, count)                       \
+  do {                                                       \
+    if (xe::ProfileTrace::is_active()) {                     \
+      xe::ProfileTrace::RecordCounter(name, int64_t(count)); \
+    }                                                        \
   } while (false)
 #define COUNT_profile_cpu(name, count) \
   do {                                 \
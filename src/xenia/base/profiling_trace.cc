@@ -0,0 +1,274 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/profiling_trace.h"
+
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+
+namespace xe {
+
+namespace {
+
+constexpr size_t kEventsPerFlush = 1024;
+
+enum class TraceEventType : uint8_t {
+  kScope,
+  kCounter,
+  kFrame,
+};
+
+struct TraceEvent {
+  TraceEventType type;
+  const char* group_name;
+  const char* name;
+  uint64_t host_ticks;
+  // The end of scopes, the value of counters.
+  int64_t value;
+};
+
+struct ThreadBuffer {
+  // Only contended while the trace is being stopped.
+  std::mutex mutex;
+  uint32_t thread_id;
+  std::string name;
+  bool is_name_written = false;
+  std::vector<TraceEvent> events;
+};
+
+struct TraceState {
+  std::mutex mutex;
+  FILE* file = nullptr;
+  bool is_first_event = true;
+  uint64_t start_host_ticks = 0;
+  double ticks_to_us = 0.0;
+  // Kept after the threads exit, as they may still be referenced by the
+  // thread_local pointers of threads outliving the trace.
+  std::vector<std::unique_ptr<ThreadBuffer>> threads;
+};
+
+TraceState& GetTraceState() {
+  static TraceState state;
+  return state;
+}
+
+thread_local ThreadBuffer* thread_buffer = nullptr;
+
+ThreadBuffer& GetThreadBuffer() {
+  ThreadBuffer* buffer = thread_buffer;
+  if (!buffer) {
+    TraceState& state = GetTraceState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.threads.push_back(std::make_unique<ThreadBuffer>());
+    buffer = state.threads.back().get();
+    buffer->thread_id = uint32_t(state.threads.size());
+    thread_buffer = buffer;
+  }
+  return *buffer;
+}
+
+void AppendEscaped(std::string& output, const char* value) {
+  for (; *value; ++value) {
+    char c = *value;
+    if (c == '"' || c == '\\') {
+      output.push_back('\\');
+      output.push_back(c);
+    } else if (uint8_t(c) < 0x20) {
+      fmt::format_to(std::back_inserter(output), "\\u{:04x}", uint32_t(c));
+    } else {
+      output.push_back(c);
+    }
+  }
+}
+
+// Must be called with the mutex of the buffer held.
+void WriteThreadEvents(ThreadBuffer& buffer) {
+  TraceState& state = GetTraceState();
+  std::string output;
+  auto begin_event = [&]() {
+    output += state.is_first_event ? "\n" : ",\n";
+    state.is_first_event = false;
+  };
+  std::lock_guard<std::mutex> lock(state.mutex);
+  if (!state.file) {
+    buffer.events.clear();
+    return;
+  }
+  if (!buffer.is_name_written && !buffer.name.empty()) {
+    begin_event();
+    fmt::format_to(std::back_inserter(output),
+                   "{{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,"
+                   "\"tid\":{},\"args\":{{\"name\":\"",
+                   buffer.thread_id);
+    AppendEscaped(output, buffer.name.c_str());
+    output += "\"}}";
+    buffer.is_name_written = true;
+  }
+  for (const TraceEvent& event : buffer.events) {
+    // Events from before the current trace are dropped.
+    if (event.host_ticks < state.start_host_ticks) {
+      continue;
+    }
+    double timestamp_us =
+        (event.host_ticks - state.start_host_ticks) * state.ticks_to_us;
+    begin_event();
+    switch (event.type) {
+      case TraceEventType::kScope:
+        output += "{\"ph\":\"X\",\"cat\":\"";
+        AppendEscaped(output, event.group_name);
+        output += "\",\"name\":\"";
+        AppendEscaped(output, event.name);
+        fmt::format_to(std::back_inserter(output),
+                       "\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},"
+                       "\"dur\":{:.3f}}}",
+                       buffer.thread_id, timestamp_us,
+                       (uint64_t(event.value) - event.host_ticks) *
+                           state.ticks_to_us);
+        break;
+      case TraceEventType::kCounter:
+        output += "{\"ph\":\"C\",\"name\":\"";
+        AppendEscaped(output, event.name);
+        fmt::format_to(std::back_inserter(output),
+                       "\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},"
+                       "\"args\":{{\"value\":{}}}}}",
+                       buffer.thread_id, timestamp_us, event.value);
+        break;
+      case TraceEventType::kFrame:
+        fmt::format_to(std::back_inserter(output),
+                       "{{\"ph\":\"i\",\"s\":\"g\",\"name\":\"Frame\","
+                       "\"pid\":1,\"tid\":{},\"ts\":{:.3f}}}",
+                       buffer.thread_id, timestamp_us);
+        break;
+    }
+  }
+  buffer.events.clear();
+  fwrite(output.data(), 1, output.size(), state.file);
+}
+
+void RecordEvent(const TraceEvent& event) {
+  ThreadBuffer& buffer = GetThreadBuffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  if (buffer.events.empty()) {
+    buffer.events.reserve(kEventsPerFlush);
+  }
+  buffer.events.push_back(event);
+  if (buffer.events.size() >= kEventsPerFlush) {
+    WriteThreadEvents(buffer);
+  }
+}
+
+}  // namespace
+
+std::atomic<bool> ProfileTrace::active_{false};
+
+bool ProfileTrace::Start(const std::filesystem::path& path) {
+  TraceState& state = GetTraceState();
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (state.file) {
+      return false;
+    }
+    state.file = xe::filesystem::OpenFile(path, "wb");
+    if (!state.file) {
+      XELOGE("Failed to open {} for writing the profiling trace",
+             xe::path_to_utf8(path));
+      return false;
+    }
+    // The JSON array format allows the closing bracket to be missing, so the
+    // trace is still usable if the emulator doesn't exit cleanly.
+    fputc('[', state.file);
+    state.is_first_event = true;
+    state.start_host_ticks = Clock::QueryHostTickCount();
+    state.ticks_to_us =
+        1000000.0 / static_cast<double>(Clock::QueryHostTickFrequency());
+  }
+  active_.store(true, std::memory_order_relaxed);
+  XELOGI("Writing the profiling trace to {}", xe::path_to_utf8(path));
+  return true;
+}
+
+void ProfileTrace::Stop() {
+  if (!active_.exchange(false, std::memory_order_relaxed)) {
+    return;
+  }
+  TraceState& state = GetTraceState();
+  std::vector<ThreadBuffer*> threads;
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    for (const std::unique_ptr<ThreadBuffer>& thread : state.threads) {
+      threads.push_back(thread.get());
+    }
+  }
+  for (ThreadBuffer* thread : threads) {
+    std::lock_guard<std::mutex> lock(thread->mutex);
+    WriteThreadEvents(*thread);
+    // For the next trace.
+    thread->is_name_written = false;
+  }
+  std::lock_guard<std::mutex> lock(state.mutex);
+  fputs("\n]\n", state.file);
+  fclose(state.file);
+  state.file = nullptr;
+}
+
+void ProfileTrace::SetThreadName(const char* name) {
+  // Not creating buffers for threads that will never record anything.
+  if (!is_active()) {
+    return;
+  }
+  ThreadBuffer& buffer = GetThreadBuffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  buffer.name = name ? name : "";
+  buffer.is_name_written = false;
+}
+
+void ProfileTrace::FlushThread() {
+  ThreadBuffer* buffer = thread_buffer;
+  if (!buffer) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(buffer->mutex);
+  if (!buffer->events.empty()) {
+    WriteThreadEvents(*buffer);
+  }
+  buffer->events.shrink_to_fit();
+}
+
+void ProfileTrace::RecordScope(const char* group_name, const char* scope_name,
+                               uint64_t start_host_ticks,
+                               uint64_t end_host_ticks) {
+  RecordEvent({TraceEventType::kScope, group_name, scope_name,
+               start_host_ticks, int64_t(end_host_ticks)});
+}
+
+void ProfileTrace::RecordCounter(const char* name, int64_t value) {
+  if (!is_active()) {
+    return;
+  }
+  RecordEvent({TraceEventType::kCounter, nullptr, name,
+               Clock::QueryHostTickCount(), value});
+}
+
+void ProfileTrace::RecordFrame() {
+  if (!is_active()) {
+    return;
+  }
+  RecordEvent({TraceEventType::kFrame, nullptr, "Frame",
+               Clock::QueryHostTickCount(), 0});
+}
+
+}  // namespace xe
@@ -0,0 +1,78 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_PROFILING_TRACE_H_
+#define XENIA_BASE_PROFILING_TRACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+
+#include "xenia/base/clock.h"
+
+namespace xe {
+
+// Backend of the profiling macros when microprofile isn't built in, writing
+// the scopes, the counters and the frame boundaries as Chrome trace events
+// (the JSON array format opened by chrome://tracing, Perfetto and Speedscope)
+// while a trace has been started. The events are buffered per thread and
+// written out in batches, so while no trace is active, the instrumentation
+// only costs a relaxed load.
+class ProfileTrace {
+ public:
+  // Writes the events to the file until Stop.
+  static bool Start(const std::filesystem::path& path);
+  // Writes the remaining events of all threads and closes the file.
+  static void Stop();
+
+  static bool is_active() { return active_.load(std::memory_order_relaxed); }
+
+  // The name the events of the calling thread are shown with.
+  static void SetThreadName(const char* name);
+  // Writes the buffered events of the calling thread, before it exits.
+  static void FlushThread();
+
+  // The names must be string literals, or otherwise live until Stop.
+  static void RecordScope(const char* group_name, const char* scope_name,
+                          uint64_t start_host_ticks, uint64_t end_host_ticks);
+  static void RecordCounter(const char* name, int64_t value);
+  static void RecordFrame();
+
+ private:
+  static std::atomic<bool> active_;
+};
+
+// Records a scope of the trace for the duration of the containing block.
+class ProfileTraceScope {
+ public:
+  ProfileTraceScope(const char* group_name, const char* scope_name)
+      : group_name_(group_name),
+        scope_name_(scope_name),
+        start_host_ticks_(ProfileTrace::is_active()
+                              ? Clock::QueryHostTickCount()
+                              : 0) {}
+  ~ProfileTraceScope() {
+    if (start_host_ticks_) {
+      ProfileTrace::RecordScope(group_name_, scope_name_, start_host_ticks_,
+                                Clock::QueryHostTickCount());
+    }
+  }
+
+  ProfileTraceScope(const ProfileTraceScope&) = delete;
+  ProfileTraceScope& operator=(const ProfileTraceScope&) = delete;
+
+ private:
+  const char* group_name_;
+  const char* scope_name_;
+  uint64_t start_host_ticks_;
+};
+
+}  // namespace xe
+
+#endif  // XENIA_BASE_PROFILING_TRACE_H_
@@ -0,0 +1,78 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_SEQLOCK_H_
+#define XENIA_BASE_SEQLOCK_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace xe {
+
+// A value with a single writer and any number of lock-free readers, for small
+// snapshots published at a high rate, such as the state of a device polled on
+// a dedicated thread. A reader retries if the writer has modified the value
+// while it was being copied, and the writer never waits for the readers.
+template <typename T>
+class SeqLockValue {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "The value is copied as words");
+
+ public:
+  SeqLockValue() = default;
+  explicit SeqLockValue(const T& value) { Store(value); }
+
+  // Only called by one thread at a time.
+  void Store(const T& value) {
+    uint64_t words[kWordCount] = {};
+    std::memcpy(words, &value, sizeof(T));
+    uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWordCount; ++i) {
+      words_[i].store(words[i], std::memory_order_relaxed);
+    }
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  T Load() const {
+    uint64_t words[kWordCount];
+    while (true) {
+      uint32_t sequence = sequence_.load(std::memory_order_acquire);
+      if (sequence & 1) {
+        continue;
+      }
+      for (size_t i = 0; i < kWordCount; ++i) {
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == sequence) {
+        break;
+      }
+    }
+    T value;
+    std::memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+ private:
+  static constexpr size_t kWordCount =
+      (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  // Incremented before and after writing, so it's odd while the value is
+  // being written.
+  std::atomic<uint32_t> sequence_{0};
+  std::atomic<uint64_t> words_[kWordCount] = {};
+};
+
+}  // namespace xe
+
+#endif  // XENIA_BASE_SEQLOCK_H_
@@ -0,0 +1,402 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/socket.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <cerrno>
+#include <condition_variable>
+#include <mutex>
+
+#include "xenia/base/assert.h"
+#include "xenia/base/logging.h"
+
+namespace xe {
+
+namespace {
+
+bool CreateWakePipe(int (&pipe_fds)[2]) {
+  if (pipe(pipe_fds)) {
+    pipe_fds[0] = -1;
+    pipe_fds[1] = -1;
+    return false;
+  }
+  fcntl(pipe_fds[0], F_SETFL, fcntl(pipe_fds[0], F_GETFL) | O_NONBLOCK);
+  fcntl(pipe_fds[1], F_SETFL, fcntl(pipe_fds[1], F_GETFL) | O_NONBLOCK);
+  return true;
+}
+
+void CloseWakePipe(int (&pipe_fds)[2]) {
+  for (int& fd : pipe_fds) {
+    if (fd != -1) {
+      close(fd);
+      fd = -1;
+    }
+  }
+}
+
+void WakeUp(int (&pipe_fds)[2]) {
+  if (pipe_fds[1] != -1) {
+    char wake_byte = 0;
+    ssize_t written = write(pipe_fds[1], &wake_byte, 1);
+    (void)written;
+  }
+}
+
+}  // namespace
+
+// There's no event object to bind a socket to on POSIX, so every socket has a
+// thread polling it and setting the event when it becomes readable, until the
+// consumer has received everything and the event is reset.
+class PosixSocket : public Socket {
+ public:
+  PosixSocket() = default;
+  ~PosixSocket() override { Close(); }
+
+  bool Connect(std::string& hostname, uint16_t port) {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    // May return multiple results, so attempt to connect to an address until
+    // one succeeds.
+    addrinfo* result = nullptr;
+    auto port_string = std::to_string(port);
+    int ret =
+        getaddrinfo(hostname.c_str(), port_string.c_str(), &hints, &result);
+    if (ret != 0) {
+      XELOGE("getaddrinfo failed with error: {}", ret);
+      return false;
+    }
+    int try_socket = -1;
+    for (addrinfo* ptr = result; ptr; ptr = ptr->ai_next) {
+      try_socket = socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
+      if (try_socket == -1) {
+        XELOGE("socket failed with error: {}", errno);
+        freeaddrinfo(result);
+        return false;
+      }
+      if (connect(try_socket, ptr->ai_addr, ptr->ai_addrlen) == -1) {
+        close(try_socket);
+        try_socket = -1;
+        continue;
+      }
+      break;
+    }
+    freeaddrinfo(result);
+    if (try_socket == -1) {
+      XELOGE("Unable to connect to server");
+      return false;
+    }
+
+    // Piggyback to setup the socket.
+    return Accept(try_socket);
+  }
+
+  bool Accept(int socket) {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+    socket_ = socket;
+    fcntl(socket_, F_SETFL, fcntl(socket_, F_GETFL) | O_NONBLOCK);
+    // Keepalive for a looong time, as we may be paused by the debugger/etc.
+    int opt_value = 1;
+    setsockopt(socket_, SOL_SOCKET, SO_KEEPALIVE, &opt_value,
+               sizeof(opt_value));
+
+    // Set true to start so we'll force a query of the socket on first run.
+    event_ = xe::threading::Event::CreateManualResetEvent(true);
+    assert_not_null(event_);
+    data_pending_ = true;
+    if (!CreateWakePipe(poll_wake_pipe_)) {
+      XELOGE("Unable to create the socket wake pipe: {}", errno);
+      Close();
+      return false;
+    }
+    poll_thread_ = xe::threading::Thread::Create(
+        {}, [this, socket = socket_]() { PollThread(socket); });
+    assert_not_null(poll_thread_);
+
+    return true;
+  }
+
+  xe::threading::WaitHandle* wait_handle() override { return event_.get(); }
+
+  bool is_connected() override {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    return socket_ != -1;
+  }
+
+  void Close() override {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+    if (poll_thread_) {
+      {
+        std::lock_guard<std::mutex> poll_lock(poll_mutex_);
+        poll_shutdown_ = true;
+      }
+      poll_cond_.notify_all();
+      WakeUp(poll_wake_pipe_);
+      // The socket must not be closed while being polled.
+      xe::threading::Wait(poll_thread_.get(), false);
+      poll_thread_.reset();
+    }
+    CloseWakePipe(poll_wake_pipe_);
+
+    if (socket_ != -1) {
+      int socket = socket_;
+      socket_ = -1;
+      shutdown(socket, SHUT_WR);
+      close(socket);
+    }
+
+    if (event_) {
+      // Set event so any future waits will immediately succeed.
+      event_->Set();
+    }
+  }
+
+  size_t Receive(void* buffer, size_t buffer_capacity) override {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+    if (socket_ == -1) {
+      return -1;
+    }
+    ssize_t ret = recv(socket_, buffer, buffer_capacity, 0);
+    if (ret == -1) {
+      int e = errno;
+      if (e == EAGAIN || e == EWOULDBLOCK) {
+        // Ok - no more data to read.
+        // Reset our event so we'll block next time, and resume polling.
+        {
+          std::lock_guard<std::mutex> poll_lock(poll_mutex_);
+          data_pending_ = false;
+          event_->Reset();
+        }
+        poll_cond_.notify_all();
+        return 0;
+      }
+      XELOGE("Socket receive error: {}", e);
+      Close();
+      return -1;
+    } else if (ret == 0) {
+      // Socket gracefully closed.
+      Close();
+      return -1;
+    }
+    return size_t(ret);
+  }
+
+  bool Send(const std::pair<const void*, size_t>* buffers,
+            size_t buffer_count) override {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+    if (socket_ == -1) {
+      return false;
+    }
+    for (size_t i = 0; i < buffer_count; ++i) {
+      const uint8_t* data = reinterpret_cast<const uint8_t*>(buffers[i].first);
+      size_t remaining = buffers[i].second;
+      while (remaining) {
+        ssize_t ret = send(socket_, data, remaining, MSG_NOSIGNAL);
+        if (ret == -1) {
+          int e = errno;
+          if (e == EINTR) {
+            continue;
+          }
+          if (e == EAGAIN || e == EWOULDBLOCK) {
+            // The socket is non-blocking for receiving, wait for the space in
+            // the send buffer.
+            pollfd socket_poll = {socket_, POLLOUT, 0};
+            poll(&socket_poll, 1, -1);
+            continue;
+          }
+          XELOGE("Socket send error: {}", e);
+          Close();
+          return false;
+        }
+        data += ret;
+        remaining -= size_t(ret);
+      }
+    }
+    return true;
+  }
+
+ private:
+  void PollThread(int socket) {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> poll_lock(poll_mutex_);
+        poll_cond_.wait(poll_lock,
+                        [this]() { return poll_shutdown_ || !data_pending_; });
+        if (poll_shutdown_) {
+          return;
+        }
+      }
+      pollfd fds[2] = {{socket, POLLIN, 0}, {poll_wake_pipe_[0], POLLIN, 0}};
+      if (poll(fds, 2, -1) == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+        XELOGE("Socket poll error: {}", errno);
+        return;
+      }
+      if (fds[1].revents) {
+        return;
+      }
+      if (fds[0].revents) {
+        // Also on errors and hangups, for the consumer to find them when
+        // receiving.
+        std::lock_guard<std::mutex> poll_lock(poll_mutex_);
+        data_pending_ = true;
+        event_->Set();
+      }
+    }
+  }
+
+  std::recursive_mutex mutex_;
+  int socket_ = -1;
+  std::unique_ptr<xe::threading::Event> event_;
+
+  std::unique_ptr<xe::threading::Thread> poll_thread_;
+  int poll_wake_pipe_[2] = {-1, -1};
+  // Protected with poll_mutex_, the poll thread is notified via poll_cond_
+  // when the event is reset or on shutdown.
+  std::mutex poll_mutex_;
+  std::condition_variable poll_cond_;
+  bool data_pending_ = true;
+  bool poll_shutdown_ = false;
+};
+
+std::unique_ptr<Socket> Socket::Connect(std::string hostname, uint16_t port) {
+  auto socket = std::make_unique<PosixSocket>();
+  if (!socket->Connect(hostname, port)) {
+    return nullptr;
+  }
+  return std::unique_ptr<Socket>(socket.release());
+}
+
+class PosixSocketServer : public SocketServer {
+ public:
+  PosixSocketServer(
+      std::function<void(std::unique_ptr<Socket> client)> accept_callback)
+      : accept_callback_(std::move(accept_callback)) {}
+  ~PosixSocketServer() override {
+    if (accept_thread_) {
+      // Closing the socket doesn't interrupt a blocked accept on all systems,
+      // so the thread is woken up explicitly.
+      WakeUp(wake_pipe_);
+      xe::threading::Wait(accept_thread_.get(), false);
+      accept_thread_.reset();
+    }
+    CloseWakePipe(wake_pipe_);
+    if (socket_ != -1) {
+      close(socket_);
+      socket_ = -1;
+    }
+  }
+
+  bool Bind(uint16_t port) {
+    socket_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (socket_ == -1) {
+      XELOGE("Unable to create listen socket");
+      return false;
+    }
+    int opt_value = 1;
+    setsockopt(socket_, SOL_SOCKET, SO_KEEPALIVE, &opt_value,
+               sizeof(opt_value));
+    opt_value = 1;
+    setsockopt(socket_, SOL_SOCKET, SO_REUSEADDR, &opt_value,
+               sizeof(opt_value));
+    opt_value = 1;
+    setsockopt(socket_, IPPROTO_TCP, TCP_NODELAY, &opt_value,
+               sizeof(opt_value));
+
+    sockaddr_in socket_addr = {};
+    socket_addr.sin_family = AF_INET;
+    socket_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socket_addr.sin_port = htons(port);
+    if (bind(socket_, reinterpret_cast<sockaddr*>(&socket_addr),
+             sizeof(socket_addr)) == -1) {
+      XELOGE("Unable to bind debug socket: {}", errno);
+      return false;
+    }
+    if (listen(socket_, 5) == -1) {
+      XELOGE("Unable to listen on accept socket {}", errno);
+      return false;
+    }
+    if (!CreateWakePipe(wake_pipe_)) {
+      XELOGE("Unable to create the socket server wake pipe: {}", errno);
+      return false;
+    }
+
+    accept_thread_ = xe::threading::Thread::Create({}, [this, port]() {
+      xe::threading::set_name(std::string("xe::SocketServer localhost:") +
+                              std::to_string(port));
+      while (true) {
+        pollfd fds[2] = {{socket_, POLLIN, 0}, {wake_pipe_[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) == -1) {
+          if (errno == EINTR) {
+            continue;
+          }
+          XELOGE("Socket server poll error: {}", errno);
+          return;
+        }
+        if (fds[1].revents) {
+          return;
+        }
+        if (!fds[0].revents) {
+          continue;
+        }
+        int client_socket = accept(socket_, nullptr, nullptr);
+        if (client_socket == -1) {
+          continue;
+        }
+
+        auto client = std::make_unique<PosixSocket>();
+        if (!client->Accept(client_socket)) {
+          XELOGE("Unable to accept socket; ignoring");
+          continue;
+        }
+        accept_callback_(std::move(client));
+      }
+    });
+    assert_not_null(accept_thread_);
+
+    return true;
+  }
+
+ private:
+  std::function<void(std::unique_ptr<Socket> client)> accept_callback_;
+  std::unique_ptr<xe::threading::Thread> accept_thread_;
+
+  int socket_ = -1;
+  int wake_pipe_[2] = {-1, -1};
+};
+
+std::unique_ptr<SocketServer> SocketServer::Create(
+    uint16_t port,
+    std::function<void(std::unique_ptr<Socket> client)> accept_callback) {
+  auto socket_server =
+      std::make_unique<PosixSocketServer>(std::move(accept_callback));
+  if (!socket_server->Bind(port)) {
+    return nullptr;
+  }
+  return std::unique_ptr<SocketServer>(socket_server.release());
+}
+
+}  // namespace xe
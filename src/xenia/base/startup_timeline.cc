@@ -0,0 +1,144 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/startup_timeline.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/threading.h"
+
+DEFINE_path(startup_timeline_path, "",
+            "File to write the startup timeline to when the first guest frame "
+            "is presented, as Chrome trace events (opened by "
+            "chrome://tracing and Perfetto). The timeline is logged anyway.",
+            "General");
+
+namespace xe {
+
+namespace {
+
+// Taken during the static initialization.
+const StartupTimeline::clock::time_point process_start_time =
+    StartupTimeline::clock::now();
+
+struct Phase {
+  const char* name;
+  StartupTimeline::clock::time_point start;
+  StartupTimeline::clock::time_point end;
+  uint32_t thread_id;
+};
+
+struct TimelineState {
+  std::mutex mutex;
+  std::vector<Phase> phases;
+};
+
+TimelineState& GetTimelineState() {
+  static TimelineState state;
+  return state;
+}
+
+double ToMilliseconds(StartupTimeline::clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+void WriteTraceFile(const std::vector<Phase>& phases,
+                    StartupTimeline::clock::time_point first_frame_time,
+                    uint32_t first_frame_thread_id) {
+  FILE* file = xe::filesystem::OpenFile(cvars::startup_timeline_path, "wb");
+  if (!file) {
+    XELOGE("Failed to open {} for writing the startup timeline",
+           xe::path_to_utf8(cvars::startup_timeline_path));
+    return;
+  }
+  auto to_us = [](StartupTimeline::clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+  };
+  fputc('[', file);
+  for (const Phase& phase : phases) {
+    fmt::print(file,
+               "\n{{\"ph\":\"X\",\"cat\":\"Startup\",\"name\":\"{}\","
+               "\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}},",
+               phase.name, phase.thread_id,
+               to_us(phase.start - process_start_time),
+               to_us(phase.end - phase.start));
+  }
+  fmt::print(file,
+             "\n{{\"ph\":\"i\",\"s\":\"g\",\"name\":\"First guest frame\","
+             "\"pid\":1,\"tid\":{},\"ts\":{:.3f}}}\n]\n",
+             first_frame_thread_id,
+             to_us(first_frame_time - process_start_time));
+  fclose(file);
+  XELOGI("Wrote the startup timeline to {}",
+         xe::path_to_utf8(cvars::startup_timeline_path));
+}
+
+}  // namespace
+
+std::atomic<bool> StartupTimeline::complete_{false};
+
+void StartupTimeline::RecordPhase(const char* name, clock::time_point start,
+                                  clock::time_point end) {
+  TimelineState& state = GetTimelineState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  // Checked under the lock not to lose a phase to MarkFirstGuestFrame taking
+  // the phases.
+  if (is_complete()) {
+    return;
+  }
+  state.phases.push_back(
+      {name, start, end, xe::threading::current_thread_system_id()});
+}
+
+void StartupTimeline::MarkFirstGuestFrame() {
+  if (is_complete()) {
+    return;
+  }
+  clock::time_point first_frame_time = clock::now();
+  uint32_t first_frame_thread_id = xe::threading::current_thread_system_id();
+  std::vector<Phase> phases;
+  {
+    TimelineState& state = GetTimelineState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (complete_.exchange(true, std::memory_order_relaxed)) {
+      return;
+    }
+    phases.swap(state.phases);
+  }
+  // Phases are recorded when they end, nested ones before the outer ones.
+  std::stable_sort(phases.begin(), phases.end(),
+                   [](const Phase& a, const Phase& b) {
+                     return a.start < b.start;
+                   });
+
+  XELOGI("Startup timeline, {:.1f} ms from the process start to the first "
+         "guest frame:",
+         ToMilliseconds(first_frame_time - process_start_time));
+  XELOGI("  Start (ms)  Duration (ms)  Thread    Phase");
+  for (const Phase& phase : phases) {
+    XELOGI("  {:10.1f}  {:13.1f}  {:08X}  {}",
+           ToMilliseconds(phase.start - process_start_time),
+           ToMilliseconds(phase.end - phase.start), phase.thread_id,
+           phase.name);
+  }
+
+  if (!cvars::startup_timeline_path.empty()) {
+    WriteTraceFile(phases, first_frame_time, first_frame_thread_id);
+  }
+}
+
+}  // namespace xe
@@ -0,0 +1,69 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_STARTUP_TIMELINE_H_
+#define XENIA_BASE_STARTUP_TIMELINE_H_
+
+#include <atomic>
+#include <chrono>
+
+namespace xe {
+
+// Phases of the startup of the emulator, from the process start to the first
+// guest frame, with their times and threads. When the first guest frame is
+// presented, the timeline is written to the log and, if startup_timeline_path
+// is set, as a Chrome trace file. Phases ending after that are not recorded.
+//
+// The steady clock is used rather than Clock, as the process start time is
+// taken during the static initialization, before the cvars selecting the host
+// clock source are loaded.
+class StartupTimeline {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  // The name must be a string literal.
+  static void RecordPhase(const char* name, clock::time_point start,
+                          clock::time_point end);
+  // Completes the timeline, only the first call has an effect.
+  static void MarkFirstGuestFrame();
+
+  static bool is_complete() {
+    return complete_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static std::atomic<bool> complete_;
+};
+
+// Records a phase of the startup for the duration of the containing block.
+class StartupTimelinePhase {
+ public:
+  explicit StartupTimelinePhase(const char* name)
+      : name_(name),
+        start_(StartupTimeline::is_complete()
+                   ? StartupTimeline::clock::time_point()
+                   : StartupTimeline::clock::now()) {}
+  ~StartupTimelinePhase() {
+    if (start_ != StartupTimeline::clock::time_point()) {
+      StartupTimeline::RecordPhase(name_, start_,
+                                   StartupTimeline::clock::now());
+    }
+  }
+
+  StartupTimelinePhase(const StartupTimelinePhase&) = delete;
+  StartupTimelinePhase& operator=(const StartupTimelinePhase&) = delete;
+
+ private:
+  const char* name_;
+  StartupTimeline::clock::time_point start_;
+};
+
+}  // namespace xe
+
+#endif  // XENIA_BASE_STARTUP_TIMELINE_H_
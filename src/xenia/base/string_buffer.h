@@ -35,8 +35,17 @@ class StringBuffer {
 
   template <typename... Args>
   void AppendFormat(const char* format, const Args&... args) {
-    auto s = fmt::format(format, args...);
-    Append(s.c_str());
+    // Formatting in place, and only again after growing if it didn't fit.
+    size_t available = buffer_capacity_ - buffer_offset_ - 1;
+    size_t length =
+        fmt::format_to_n(buffer_ + buffer_offset_, available, format, args...)
+            .size;
+    if (length > available) {
+      Grow(length + 1);
+      fmt::format_to_n(buffer_ + buffer_offset_, length, format, args...);
+    }
+    buffer_offset_ += length;
+    buffer_[buffer_offset_] = 0;
   }
 
   void AppendVarargs(const char* format, va_list args);
@@ -0,0 +1,74 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/arena.h"
+
+#include "third_party/catch/include/catch.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+namespace xe::base::test {
+
+TEST_CASE("Arena allocation statistics", "[arena]") {
+  Arena arena(64_KiB);
+  REQUIRE(arena.allocation_count() == 0);
+  REQUIRE(arena.peak_size() == 0);
+
+  arena.Alloc(100, 4);
+  arena.Alloc<uint64_t>();
+  REQUIRE(arena.allocation_count() == 2);
+  REQUIRE(arena.peak_size() == 112);
+
+  SECTION("Peak size is kept across resets") {
+    arena.Reset();
+    arena.Alloc(16, 16);
+    REQUIRE(arena.allocation_count() == 3);
+    REQUIRE(arena.peak_size() == 112);
+    arena.Alloc(200, 8);
+    REQUIRE(arena.peak_size() == 216);
+  }
+
+  SECTION("Statistics are cleared") {
+    arena.ResetStatistics();
+    REQUIRE(arena.allocation_count() == 0);
+    // The current allocations are still counted until a reset.
+    REQUIRE(arena.peak_size() == 112);
+    arena.Reset();
+    arena.ResetStatistics();
+    REQUIRE(arena.peak_size() == 0);
+  }
+
+  SECTION("Allocations spanning multiple chunks") {
+    arena.Alloc(40_KiB, 16);
+    arena.Alloc(40_KiB, 16);
+    REQUIRE(arena.allocation_count() == 4);
+    REQUIRE(arena.peak_size() == 112 + 80_KiB);
+  }
+}
+
+TEST_CASE("Arena large and overaligned allocations", "[arena]") {
+  Arena arena(16_KiB);
+  arena.Alloc(1000, 4);
+  void* large = arena.Alloc(100_KiB, 16);
+  REQUIRE(large);
+  std::memset(large, 0xAB, 100_KiB);
+  void* aligned = arena.Alloc(100, 256);
+  REQUIRE((reinterpret_cast<uintptr_t>(aligned) & 255) == 0);
+  // The large chunk is reused after a reset.
+  arena.Reset();
+  arena.Alloc(1000, 4);
+  REQUIRE(arena.Alloc(100_KiB, 16) == large);
+  // Larger than the reused chunk.
+  void* larger = arena.Alloc(200_KiB, 16);
+  std::memset(larger, 0xCD, 200_KiB);
+  REQUIRE(arena.allocation_count() == 6);
+}
+
+}  // namespace xe::base::test
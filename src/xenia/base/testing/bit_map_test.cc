@@ -0,0 +1,126 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/bit_map.h"
+
+#include "third_party/catch/include/catch.hpp"
+#include "third_party/fmt/include/fmt/format.h"
+
+#include "xenia/base/clock.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace xe {
+namespace base {
+namespace test {
+
+TEST_CASE("BitMap acquires from the front and the back", "[bit_map]") {
+  BitMap bit_map(64 * 100);
+  for (size_t i = 0; i < 64 * 100; ++i) {
+    REQUIRE(bit_map.Acquire() == i);
+  }
+  REQUIRE(bit_map.Acquire() == size_t(-1));
+  REQUIRE(bit_map.AcquireFromBack() == size_t(-1));
+
+  bit_map.Release(5000);
+  bit_map.Release(70);
+  REQUIRE(bit_map.Acquire() == 70);
+  REQUIRE(bit_map.AcquireFromBack() == 5000);
+  REQUIRE(bit_map.Acquire() == size_t(-1));
+
+  // From the back, the last word with free entries is used, but the entries
+  // are acquired in order within it.
+  bit_map.Reset();
+  REQUIRE(bit_map.AcquireFromBack() == 64 * 99);
+  REQUIRE(bit_map.Acquire() == 0);
+}
+
+TEST_CASE("BitMap resizing and restoring", "[bit_map]") {
+  BitMap bit_map(64);
+  for (size_t i = 0; i < 64; ++i) {
+    REQUIRE(bit_map.Acquire() == i);
+  }
+  bit_map.Resize(64 * 70);
+  REQUIRE(bit_map.Acquire() == 64);
+  REQUIRE(bit_map.AcquireFromBack() == 64 * 69);
+
+  BitMap restored_bit_map;
+  restored_bit_map.SetData(bit_map.data());
+  REQUIRE(restored_bit_map.Acquire() == 65);
+  REQUIRE(restored_bit_map.AcquireFromBack() == 64 * 69 + 1);
+}
+
+TEST_CASE("BitMap concurrent acquisition", "[bit_map]") {
+  constexpr size_t kThreadCount = 4;
+  constexpr size_t kEntryCount = 64 * 64 * 4;
+  BitMap bit_map(kEntryCount);
+  std::vector<std::vector<size_t>> acquired(kThreadCount);
+  std::atomic<uint32_t> failed_acquisitions{0};
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < kThreadCount; ++i) {
+    threads.emplace_back([&bit_map, &acquired, &failed_acquisitions, i]() {
+      // Churn to race releases against words being found full.
+      for (uint32_t j = 0; j < 10000; ++j) {
+        size_t index = bit_map.Acquire();
+        if (index == size_t(-1)) {
+          ++failed_acquisitions;
+          continue;
+        }
+        bit_map.Release(index);
+      }
+      for (size_t j = 0; j < kEntryCount / kThreadCount; ++j) {
+        acquired[i].push_back(bit_map.Acquire());
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  REQUIRE(failed_acquisitions == 0);
+  std::vector<size_t> all_acquired;
+  for (const std::vector<size_t>& thread_acquired : acquired) {
+    all_acquired.insert(all_acquired.end(), thread_acquired.cbegin(),
+                        thread_acquired.cend());
+  }
+  std::sort(all_acquired.begin(), all_acquired.end());
+  REQUIRE(all_acquired.size() == kEntryCount);
+  for (size_t i = 0; i < kEntryCount; ++i) {
+    REQUIRE(all_acquired[i] == i);
+  }
+  REQUIRE(bit_map.Acquire() == size_t(-1));
+}
+
+// Hidden, run with the [benchmark] tag.
+TEST_CASE("bit_map_benchmark", "[.][benchmark]") {
+  constexpr size_t kEntryCount = 64 * 1024;
+  constexpr uint32_t kIterationCount = 1000000;
+  for (uint32_t fill_percent : {0, 50, 90, 99}) {
+    BitMap bit_map(kEntryCount);
+    size_t fill_count = kEntryCount * fill_percent / 100;
+    for (size_t i = 0; i < fill_count; ++i) {
+      bit_map.Acquire();
+    }
+    uint64_t start_host_ticks = Clock::QueryHostTickCount();
+    for (uint32_t i = 0; i < kIterationCount; ++i) {
+      bit_map.Release(bit_map.Acquire());
+    }
+    double seconds = double(Clock::QueryHostTickCount() - start_host_ticks) /
+                     double(Clock::QueryHostTickFrequency());
+    fmt::print("{:3}% full: {:8.2f} M acquire and release pairs/s\n",
+               fill_percent, kIterationCount / seconds / 1e6);
+  }
+}
+
+}  // namespace test
+}  // namespace base
+}  // namespace xe
@@ -0,0 +1,216 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/concurrent_queue.h"
+
+#include "third_party/catch/include/catch.hpp"
+#include "third_party/fmt/include/fmt/format.h"
+
+#include "xenia/base/clock.h"
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace xe {
+namespace base {
+namespace test {
+
+TEST_CASE("spsc_queue_single_thread", "[concurrent_queue]") {
+  SpscQueue<uint32_t, 4> queue;
+  uint32_t value;
+  REQUIRE(queue.empty());
+  REQUIRE_FALSE(queue.TryPop(value));
+  // Wrapping around the ring multiple times.
+  for (uint32_t lap = 0; lap < 3; ++lap) {
+    for (uint32_t i = 0; i < 4; ++i) {
+      REQUIRE(queue.TryPush(lap * 4 + i));
+    }
+    REQUIRE(queue.size() == 4);
+    REQUIRE_FALSE(queue.TryPush(0));
+    for (uint32_t i = 0; i < 4; ++i) {
+      REQUIRE(queue.TryPop(value));
+      REQUIRE(value == lap * 4 + i);
+    }
+    REQUIRE_FALSE(queue.TryPop(value));
+  }
+}
+
+TEST_CASE("spsc_queue_in_place", "[concurrent_queue]") {
+  SpscQueue<std::array<uint32_t, 16>, 2> queue;
+  std::array<uint32_t, 16>* slot = queue.BeginWrite();
+  REQUIRE(slot);
+  slot->fill(5);
+  // Not visible to the consumer until published.
+  REQUIRE_FALSE(queue.BeginRead());
+  queue.EndWrite();
+  const std::array<uint32_t, 16>* read_slot = queue.BeginRead();
+  REQUIRE(read_slot == slot);
+  REQUIRE((*read_slot)[15] == 5);
+  queue.EndRead();
+  REQUIRE(queue.empty());
+}
+
+template <typename WaitStrategy>
+void TestSpscQueueThreads() {
+  constexpr uint32_t kCount = 100000;
+  SpscQueue<uint32_t, 64, WaitStrategy> queue;
+  std::thread producer([&]() {
+    for (uint32_t i = 0; i < kCount; ++i) {
+      queue.Push(i);
+    }
+  });
+  bool in_order = true;
+  for (uint32_t i = 0; i < kCount; ++i) {
+    in_order &= queue.Pop() == i;
+  }
+  producer.join();
+  REQUIRE(in_order);
+  REQUIRE(queue.empty());
+}
+
+// Not testing SpinWaitStrategy, it takes very long with fewer processors than
+// threads.
+TEST_CASE("spsc_queue_threads", "[concurrent_queue]") {
+  TestSpscQueueThreads<YieldWaitStrategy>();
+  TestSpscQueueThreads<BlockingWaitStrategy>();
+}
+
+TEST_CASE("mpsc_queue_single_thread", "[concurrent_queue]") {
+  MpscQueue<uint32_t, 4> queue;
+  uint32_t value;
+  REQUIRE_FALSE(queue.TryPop(value));
+  for (uint32_t lap = 0; lap < 3; ++lap) {
+    for (uint32_t i = 0; i < 4; ++i) {
+      REQUIRE(queue.TryPush(lap * 4 + i));
+    }
+    value = 123;
+    REQUIRE_FALSE(queue.TryPush(std::move(value)));
+    // Not moved from if not pushed.
+    REQUIRE(value == 123);
+    for (uint32_t i = 0; i < 4; ++i) {
+      REQUIRE(queue.TryPop(value));
+      REQUIRE(value == lap * 4 + i);
+    }
+    REQUIRE_FALSE(queue.TryPop(value));
+  }
+}
+
+template <typename WaitStrategy>
+void TestMpscQueueThreads() {
+  constexpr uint32_t kProducerCount = 4;
+  constexpr uint32_t kCountPerProducer = 50000;
+  MpscQueue<uint32_t, 64, WaitStrategy> queue;
+  std::vector<std::thread> producers;
+  for (uint32_t i = 0; i < kProducerCount; ++i) {
+    producers.emplace_back([&queue, i]() {
+      for (uint32_t j = 0; j < kCountPerProducer; ++j) {
+        queue.Push(i * kCountPerProducer + j);
+      }
+    });
+  }
+  // Every element received once, in the order of each producer.
+  std::vector<uint32_t> next_values(kProducerCount);
+  for (uint32_t i = 0; i < kProducerCount; ++i) {
+    next_values[i] = i * kCountPerProducer;
+  }
+  bool in_order = true;
+  for (uint32_t i = 0; i < kProducerCount * kCountPerProducer; ++i) {
+    uint32_t value = queue.Pop();
+    uint32_t& next_value = next_values[value / kCountPerProducer];
+    in_order &= value == next_value;
+    ++next_value;
+  }
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  REQUIRE(in_order);
+  uint32_t value;
+  REQUIRE_FALSE(queue.TryPop(value));
+}
+
+TEST_CASE("mpsc_queue_threads", "[concurrent_queue]") {
+  TestMpscQueueThreads<YieldWaitStrategy>();
+  TestMpscQueueThreads<BlockingWaitStrategy>();
+}
+
+// The mutex, std::deque and condition variable queue the subsystems used.
+class LockingQueue {
+ public:
+  void Push(uint32_t value) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(value);
+    }
+    cond_.notify_one();
+  }
+  uint32_t Pop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this]() { return !queue_.empty(); });
+    uint32_t value = queue_.front();
+    queue_.pop_front();
+    return value;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<uint32_t> queue_;
+};
+
+template <typename Queue>
+void MeasureQueue(const char* name, uint32_t producer_count) {
+  constexpr uint32_t kCount = 4000000;
+  auto queue = std::make_unique<Queue>();
+  uint64_t start_host_ticks = Clock::QueryHostTickCount();
+  std::vector<std::thread> producers;
+  for (uint32_t i = 0; i < producer_count; ++i) {
+    producers.emplace_back([&]() {
+      for (uint32_t j = 0; j < kCount / producer_count; ++j) {
+        queue->Push(j);
+      }
+    });
+  }
+  for (uint32_t i = 0; i < kCount / producer_count * producer_count; ++i) {
+    queue->Pop();
+  }
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  double seconds = double(Clock::QueryHostTickCount() - start_host_ticks) /
+                   double(Clock::QueryHostTickFrequency());
+  fmt::print("{} producers, {:<24} {:8.2f} M elements/s\n", producer_count,
+             name, kCount / seconds / 1e6);
+}
+
+// Hidden, run with the [benchmark] tag.
+TEST_CASE("concurrent_queue_benchmark", "[.][benchmark]") {
+  MeasureQueue<LockingQueue>("mutex and deque", 1);
+  MeasureQueue<SpscQueue<uint32_t, 1024, SpinWaitStrategy>>("spsc spin", 1);
+  MeasureQueue<SpscQueue<uint32_t, 1024, YieldWaitStrategy>>("spsc yield", 1);
+  MeasureQueue<SpscQueue<uint32_t, 1024, BlockingWaitStrategy>>(
+      "spsc blocking", 1);
+  for (uint32_t producer_count : {1, 4}) {
+    MeasureQueue<LockingQueue>("mutex and deque", producer_count);
+    MeasureQueue<MpscQueue<uint32_t, 1024, SpinWaitStrategy>>(
+        "mpsc spin", producer_count);
+    MeasureQueue<MpscQueue<uint32_t, 1024, YieldWaitStrategy>>(
+        "mpsc yield", producer_count);
+    MeasureQueue<MpscQueue<uint32_t, 1024, BlockingWaitStrategy>>(
+        "mpsc blocking", producer_count);
+  }
+}
+
+}  // namespace test
+}  // namespace base
+}  // namespace xe
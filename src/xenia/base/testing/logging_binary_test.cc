@@ -0,0 +1,76 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/logging_binary.h"
+
+#include <string>
+#include <string_view>
+
+#include "third_party/catch/include/catch.hpp"
+
+namespace xe {
+namespace base {
+namespace test {
+using namespace xe::logging::binary;
+
+enum class TestEnum { kValue };
+
+static_assert(kAreArgsEncodable<int8_t, uint16_t, int32_t, uint64_t, float,
+                                double, bool, char, const void*, char[4],
+                                const char*, std::string, std::string_view>);
+static_assert(!kAreArgsEncodable<uint32_t, TestEnum>);
+
+template <typename... Args>
+std::string EncodeAndFormat(const char* format, const Args&... args) {
+  char line[256];
+  size_t line_size = EncodeLine(line, sizeof(line), format, args...);
+  REQUIRE(line_size);
+  std::string_view line_format, line_args;
+  REQUIRE(SplitLine(line, line_size, line_format, line_args));
+  REQUIRE(line_format == format);
+  fmt::memory_buffer text;
+  REQUIRE(FormatLine(line_format, line_args, text));
+  return std::string(text.data(), text.size());
+}
+
+TEST_CASE("logging_binary_format", "[logging]") {
+  REQUIRE(EncodeAndFormat("No arguments") == "No arguments");
+  REQUIRE(EncodeAndFormat("{} {} {:08X} {}", int8_t(-5), -123456789,
+                          UINT64_C(0xFEDCBA9876543210), uint16_t(7)) ==
+          "-5 -123456789 FEDCBA9876543210 7");
+  // float formatted as float, not as double.
+  REQUIRE(EncodeAndFormat("{} {} {} {}", 0.1f, 0.25, true, 'x') ==
+          "0.1 0.25 true x");
+  std::string str = "string";
+  REQUIRE(EncodeAndFormat("{} {} {} {}", "literal", str, std::string_view(str),
+                          str.c_str()) == "literal string string string");
+  const void* pointer = reinterpret_cast<const void*>(uintptr_t(0x1234));
+  REQUIRE(EncodeAndFormat("{}", pointer) == fmt::format("{}", pointer));
+}
+
+TEST_CASE("logging_binary_overflow", "[logging]") {
+  char line[16];
+  REQUIRE(EncodeLine(line, sizeof(line), "{}", 1));
+  REQUIRE_FALSE(EncodeLine(line, sizeof(line), "{}", "a long string"));
+}
+
+TEST_CASE("logging_binary_malformed", "[logging]") {
+  char line[64];
+  size_t line_size = EncodeLine(line, sizeof(line), "{} {}", 1, "string");
+  REQUIRE(line_size);
+  std::string_view format, args;
+  REQUIRE(SplitLine(line, line_size, format, args));
+  fmt::memory_buffer text;
+  REQUIRE_FALSE(FormatLine(format, args.substr(0, args.size() - 1), text));
+  REQUIRE_FALSE(SplitLine(line, 2, format, args));
+}
+
+}  // namespace test
+}  // namespace base
+}  // namespace xe
@@ -13,8 +13,14 @@
 #include "third_party/fmt/include/fmt/format.h"
 
 #include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
 
 #include <array>
+#include <vector>
+
+#if XE_ARCH_AMD64
+DECLARE_int64(x64_extension_mask);
+#endif
 
 namespace xe {
 namespace base {
@@ -506,6 +512,235 @@ TEST_CASE("copy_and_swap_16_in_32_unaligned", "[copy_and_swap]") {
   }
 }
 
+TEST_CASE("count_matching_prefix", "[memory_compare]") {
+  std::array<uint8_t, 100> a{};
+  std::array<uint8_t, 100> b{};
+  for (size_t i = 0; i < a.size(); ++i) {
+    a[i] = b[i] = static_cast<uint8_t>(i * 7);
+  }
+  REQUIRE(count_matching_prefix(a.data(), b.data(), a.size()) == a.size());
+  REQUIRE(count_matching_prefix(a.data(), b.data(), 0) == 0);
+  // Mismatches in the vector loops and in the residual bytes.
+  for (size_t mismatch : {size_t(0), size_t(5), size_t(31), size_t(32),
+                          size_t(47), size_t(64), size_t(99)}) {
+    b[mismatch] ^= 0x80;
+    REQUIRE(count_matching_prefix(a.data(), b.data(), a.size()) == mismatch);
+    // Bytes after the length are not compared.
+    REQUIRE(count_matching_prefix(a.data(), b.data(), mismatch) == mismatch);
+    b[mismatch] ^= 0x80;
+  }
+  // Unaligned buffers.
+  REQUIRE(count_matching_prefix(a.data() + 1, b.data() + 1, a.size() - 1) ==
+          a.size() - 1);
+}
+
+TEST_CASE("count_matching_prefix_32", "[memory_compare]") {
+  constexpr uint32_t pattern = 0x12345678;
+  std::array<uint32_t, 37> values;
+  values.fill(pattern);
+  REQUIRE(count_matching_prefix_32(values.data(), values.size(), pattern) ==
+          values.size());
+  for (size_t mismatch : {size_t(0), size_t(3), size_t(8), size_t(13),
+                          size_t(20), size_t(36)}) {
+    values[mismatch] = pattern ^ 0x100;
+    REQUIRE(count_matching_prefix_32(values.data(), values.size(), pattern) ==
+            mismatch);
+    values[mismatch] = pattern;
+  }
+}
+
+TEST_CASE("fill_32", "[memory_fill]") {
+  for (size_t count : {size_t(0), size_t(3), size_t(4), size_t(13),
+                       size_t(32), size_t(35)}) {
+    std::array<uint32_t, 36> values{};
+    fill_32(values.data(), count, 0xCAFEBABE);
+    for (size_t i = 0; i < values.size(); ++i) {
+      REQUIRE(values[i] == (i < count ? 0xCAFEBABE : 0));
+    }
+  }
+}
+
+// Sizes around the thresholds of every copy method.
+static const size_t kCopyTestSizes[] = {
+    0, 1, 63, 2047, 2048, 2049, 65536 + 7, kNonTemporalCopyThreshold - 1,
+    kNonTemporalCopyThreshold, kNonTemporalCopyThreshold + 67};
+
+TEST_CASE("copy_bytes", "[memory_copy]") {
+  std::vector<uint8_t> src(kNonTemporalCopyThreshold + 128);
+  for (size_t i = 0; i < src.size(); ++i) {
+    src[i] = static_cast<uint8_t>(i * 7 + (i >> 8));
+  }
+  std::vector<uint8_t> dst(src.size() + 128);
+  for (size_t size : kCopyTestSizes) {
+    for (size_t offset : {size_t(0), size_t(1), size_t(13)}) {
+      std::fill(dst.begin(), dst.end(), uint8_t(0xCD));
+      copy_bytes(dst.data() + offset, src.data() + 3, size);
+      REQUIRE(count_matching_prefix(dst.data() + offset, src.data() + 3,
+                                    size) == size);
+      REQUIRE(dst[offset + size] == 0xCD);
+      if (offset) {
+        REQUIRE(dst[offset - 1] == 0xCD);
+      }
+    }
+  }
+}
+
+TEST_CASE("fill_bytes", "[memory_fill]") {
+  std::vector<uint8_t> dst(kNonTemporalCopyThreshold + 256);
+  for (size_t size : kCopyTestSizes) {
+    for (size_t offset : {size_t(0), size_t(5)}) {
+      std::fill(dst.begin(), dst.end(), uint8_t(0xCD));
+      fill_bytes(dst.data() + offset, 0x5A, size);
+      for (size_t i = 0; i < size; ++i) {
+        if (dst[offset + i] != 0x5A) {
+          REQUIRE(dst[offset + i] == 0x5A);
+        }
+      }
+      REQUIRE(dst[offset + size] == 0xCD);
+      if (offset) {
+        REQUIRE(dst[offset - 1] == 0xCD);
+      }
+    }
+  }
+}
+
+TEST_CASE("copy_and_swap_non_temporal", "[copy_and_swap]") {
+  // Large enough for the streaming stores, with a destination that isn't
+  // aligned to 32 bytes.
+  constexpr size_t count = kNonTemporalCopyThreshold / 4 + 13;
+  std::vector<uint32_t> src(count);
+  for (size_t i = 0; i < count; ++i) {
+    src[i] = uint32_t(i * 0x01020304);
+  }
+  std::vector<uint32_t> dst(count + 2);
+  copy_and_swap_32_unaligned(dst.data() + 1, src.data(), count);
+  for (size_t i = 0; i < count; ++i) {
+    if (dst[i + 1] != byte_swap(src[i])) {
+      REQUIRE(dst[i + 1] == byte_swap(src[i]));
+    }
+  }
+  REQUIRE(dst[0] == 0);
+  REQUIRE(dst[count + 1] == 0);
+
+  std::vector<uint16_t> dst_16(count * 2 + 1);
+  copy_and_swap_16_unaligned(dst_16.data() + 1, src.data(), count * 2);
+  auto src_16 = reinterpret_cast<const uint16_t*>(src.data());
+  for (size_t i = 0; i < count * 2; ++i) {
+    if (dst_16[i + 1] != byte_swap(src_16[i])) {
+      REQUIRE(dst_16[i + 1] == byte_swap(src_16[i]));
+    }
+  }
+
+  // In place, where the head must not be swapped twice.
+  std::vector<uint32_t> in_place(count + 1);
+  for (size_t i = 0; i < count; ++i) {
+    in_place[i + 1] = src[i];
+  }
+  copy_and_swap_32_unaligned(in_place.data() + 1, in_place.data() + 1, count);
+  for (size_t i = 0; i < count; ++i) {
+    if (in_place[i + 1] != byte_swap(src[i])) {
+      REQUIRE(in_place[i + 1] == byte_swap(src[i]));
+    }
+  }
+}
+
+// Hidden, run with the [benchmark] tag.
+TEST_CASE("copy_bytes_benchmark", "[.][benchmark]") {
+  std::vector<uint8_t> src(64 * 1024 * 1024, 1);
+  std::vector<uint8_t> dst(src.size());
+  for (size_t size : {size_t(256), size_t(4096), size_t(256 * 1024),
+                      size_t(2 * 1024 * 1024), size_t(16 * 1024 * 1024),
+                      size_t(64 * 1024 * 1024)}) {
+    size_t iterations = std::max(size_t(1), size_t(256 * 1024 * 1024) / size);
+    auto measure = [&](const char* name, auto function) {
+      uint64_t start_host_ticks = Clock::QueryHostTickCount();
+      for (size_t i = 0; i < iterations; ++i) {
+        function();
+      }
+      double seconds = double(Clock::QueryHostTickCount() - start_host_ticks) /
+                       double(Clock::QueryHostTickFrequency());
+      fmt::print("{:>10} bytes, {:<12} {:8.2f} GB/s\n", size, name,
+                 double(size) * iterations / seconds / 1e9);
+    };
+    measure("memcpy", [&]() { std::memcpy(dst.data(), src.data(), size); });
+    measure("copy_bytes", [&]() { copy_bytes(dst.data(), src.data(), size); });
+    measure("memset", [&]() { std::memset(dst.data(), 0, size); });
+    measure("fill_bytes", [&]() { fill_bytes(dst.data(), 0, size); });
+    measure("swap_32", [&]() {
+      copy_and_swap_32_unaligned(dst.data(), src.data(), size / 4);
+    });
+  }
+}
+
+#if XE_ARCH_AMD64
+// Hidden, run with the [benchmark] tag. Measured with every instruction set
+// that the byte swapping functions have paths for, as the functions use the
+// best one available.
+TEST_CASE("copy_and_swap_benchmark", "[.][benchmark]") {
+  struct IsaLevel {
+    const char* name;
+    uint64_t feature_flags;
+  };
+  const IsaLevel isa_levels[] = {
+      {"AVX", 0},
+      {"AVX2", amd64::kX64EmitAVX2},
+      {"AVX-512BW", amd64::kX64EmitAVX2 | amd64::kX64EmitAVX512F |
+                        amd64::kX64EmitAVX512BW},
+  };
+  int64_t original_extension_mask = cvars::x64_extension_mask;
+  // Extra bytes for the unaligned and the odd sizes.
+  std::vector<uint8_t> src(16 * 1024 * 1024 + 64, 1);
+  std::vector<uint8_t> dst(src.size());
+  for (const IsaLevel& isa_level : isa_levels) {
+    cvars::x64_extension_mask = int64_t(isa_level.feature_flags);
+    amd64::InitFeatureFlags();
+    if ((amd64::GetFeatureFlags() & isa_level.feature_flags) !=
+        isa_level.feature_flags) {
+      fmt::print("{}: not supported by the host\n", isa_level.name);
+      continue;
+    }
+    // Odd sizes, such as of constant uploads, with residual elements.
+    for (size_t size : {size_t(72), size_t(1000), size_t(4096),
+                        size_t(256 * 1024), size_t(16 * 1024 * 1024)}) {
+      size_t iterations =
+          std::max(size_t(1), size_t(256 * 1024 * 1024) / size);
+      auto measure = [&](const char* name, auto function) {
+        uint64_t start_host_ticks = Clock::QueryHostTickCount();
+        for (size_t i = 0; i < iterations; ++i) {
+          function();
+        }
+        double seconds =
+            double(Clock::QueryHostTickCount() - start_host_ticks) /
+            double(Clock::QueryHostTickFrequency());
+        fmt::print("{:<10} {:>10} bytes, {:<16} {:8.2f} GB/s\n",
+                   isa_level.name, size, name,
+                   double(size) * iterations / seconds / 1e9);
+      };
+      measure("swap_16", [&]() {
+        copy_and_swap_16_unaligned(dst.data(), src.data(), size / 2);
+      });
+      measure("swap_16 unaligned", [&]() {
+        copy_and_swap_16_unaligned(dst.data() + 1, src.data() + 3, size / 2);
+      });
+      measure("swap_32", [&]() {
+        copy_and_swap_32_unaligned(dst.data(), src.data(), size / 4);
+      });
+      measure("swap_32 unaligned", [&]() {
+        copy_and_swap_32_unaligned(dst.data() + 1, src.data() + 3, size / 4);
+      });
+      measure("swap_64", [&]() {
+        copy_and_swap_64_unaligned(dst.data(), src.data(), size / 8);
+      });
+      measure("swap_16_in_32", [&]() {
+        copy_and_swap_16_in_32_unaligned(dst.data(), src.data(), size / 4);
+      });
+    }
+  }
+  cvars::x64_extension_mask = original_extension_mask;
+  amd64::InitFeatureFlags();
+}
+#endif  // XE_ARCH_AMD64
+
 TEST_CASE("create_and_close_file_mapping", "Virtual Memory Mapping") {
   auto path = fmt::format("xenia_test_{}", Clock::QueryHostTickCount());
   auto memory = xe::memory::CreateFileMappingHandle(
@@ -0,0 +1,60 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/seqlock.h"
+
+#include "third_party/catch/include/catch.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace xe::base::test {
+
+// Not a multiple of the word size.
+struct SeqLockTestValue {
+  uint32_t values[5];
+};
+
+TEST_CASE("SeqLockValue store and load", "[seqlock]") {
+  SeqLockValue<SeqLockTestValue> value;
+  REQUIRE(value.Load().values[4] == 0);
+  value.Store({{1, 2, 3, 4, 5}});
+  SeqLockTestValue loaded = value.Load();
+  REQUIRE(loaded.values[0] == 1);
+  REQUIRE(loaded.values[4] == 5);
+}
+
+TEST_CASE("SeqLockValue consistent snapshots", "[seqlock]") {
+  SeqLockValue<SeqLockTestValue> value;
+  std::atomic<bool> done{false};
+  std::thread writer([&]() {
+    for (uint32_t i = 1; i <= 200000; ++i) {
+      value.Store({{i, i, i, i, i}});
+    }
+    done.store(true, std::memory_order_release);
+  });
+  // Every snapshot must be from a single store, and not older than the
+  // previous one.
+  bool consistent = true;
+  uint32_t last = 0;
+  while (!done.load(std::memory_order_acquire)) {
+    SeqLockTestValue loaded = value.Load();
+    for (uint32_t element : loaded.values) {
+      consistent &= element == loaded.values[0];
+    }
+    consistent &= loaded.values[0] >= last;
+    last = loaded.values[0];
+  }
+  writer.join();
+  REQUIRE(consistent);
+  REQUIRE(value.Load().values[0] == 200000);
+}
+
+}  // namespace xe::base::test
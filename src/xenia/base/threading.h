@@ -90,6 +90,24 @@ class Fence {
 // Returns the total number of logical processors in the host system.
 uint32_t logical_processor_count();
 
+struct LogicalProcessor {
+  // Bit of the processor in affinity masks.
+  uint32_t index;
+  // Same for the SMT siblings sharing a physical core.
+  uint32_t core_id;
+  // Same for the processors sharing the last level cache, such as a CCX of a
+  // Zen CPU.
+  uint32_t cache_id;
+  // Higher for the faster cores of hybrid CPUs, same for all processors
+  // otherwise.
+  uint32_t efficiency_class;
+};
+
+// Returns the topology of the host logical processors that can be used in
+// affinity masks, sorted by the index. Processors with no information
+// available are reported as separate cores sharing the cache.
+const std::vector<LogicalProcessor>& GetLogicalProcessors();
+
 // Enables the current process to set thread affinity.
 // Must be called at startup before attempting to set thread affinity.
 void EnableAffinityConfiguration();
@@ -113,6 +131,17 @@ void MaybeYield();
 // Memory barrier (request - may be ignored).
 void SyncMemory();
 
+// Blocks the current thread while the value equals expected_value, until
+// AtomicNotifyAll is called for it (like std::atomic::wait in C++20). May also
+// return spuriously, so the value must be checked again.
+void AtomicWait(const std::atomic<uint32_t>& value, uint32_t expected_value);
+// Like AtomicWait, but also returns after the timeout, which may be rounded up
+// to the timer resolution of the host.
+void AtomicWait(const std::atomic<uint32_t>& value, uint32_t expected_value,
+                std::chrono::microseconds timeout);
+// Wakes up all the threads in AtomicWait for the value.
+void AtomicNotifyAll(const std::atomic<uint32_t>& value);
+
 // Sleeps the current thread for at least as long as the given duration.
 void Sleep(std::chrono::microseconds duration);
 void NanoSleep(int64_t ns);
@@ -121,6 +150,28 @@ void Sleep(std::chrono::duration<Rep, Period> duration) {
   Sleep(std::chrono::duration_cast<std::chrono::microseconds>(duration));
 }
 
+// Sleeps until deadlines on the host tick clock (Clock::QueryHostTickCount)
+// much more precisely than Sleep, using a high-resolution waitable timer on
+// Windows and clock_nanosleep on other platforms. The last part of every wait
+// is spun to hide the wake-up latency of the host scheduler.
+class PreciseSleeper {
+ public:
+  PreciseSleeper();
+  ~PreciseSleeper();
+  PreciseSleeper(const PreciseSleeper&) = delete;
+  PreciseSleeper& operator=(const PreciseSleeper&) = delete;
+
+  // Returns the host tick count when the wait has ended, which is not earlier
+  // than the deadline.
+  uint64_t SleepUntil(uint64_t deadline_host_ticks, uint64_t spin_host_ticks);
+
+ private:
+#if XE_PLATFORM_WIN32
+  // The waitable timer handle.
+  void* timer_ = nullptr;
+#endif
+};
+
 enum class SleepResult {
   kSuccess,
   kAlerted,
@@ -483,6 +534,12 @@ class Thread : public WaitHandle {
   std::string name_;
 };
 
+// Calls function for every index, on the calling thread and the workers of
+// JobSystem::Get() (in threading_job_system.cc). The name is shown in
+// profiling traces and must be a string literal.
+void ParallelFor(size_t count, const char* name,
+                 const std::function<void(size_t)>& function);
+
 }  // namespace threading
 }  // namespace xe
 
@@ -0,0 +1,221 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/threading_job_system.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "xenia/base/assert.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/profiling_trace.h"
+
+DEFINE_int32(job_system_threads, 0,
+             "Number of threads executing the background work of the "
+             "emulator, such as function precompilation, loading and "
+             "decompression. 0 to use the logical processors not reserved for "
+             "the 6 guest hardware threads, but at least 2.",
+             "General");
+
+namespace xe::threading {
+
+namespace {
+// Logical processors left for the guest hardware threads by default.
+constexpr uint32_t kGuestHardwareThreadCount = 6;
+
+// The job system and the index of its worker the current thread is, if any.
+thread_local JobSystem* current_job_system = nullptr;
+thread_local size_t current_worker_index = 0;
+}  // namespace
+
+JobSystem& JobSystem::Get() {
+  // Intentionally never destroyed, as static destruction may happen while
+  // other threads are still submitting jobs.
+  static JobSystem* instance = []() {
+    int32_t worker_count = cvars::job_system_threads;
+    if (worker_count <= 0) {
+      worker_count =
+          std::max(int32_t(logical_processor_count()) -
+                       int32_t(kGuestHardwareThreadCount),
+                   int32_t(2));
+    }
+    XELOGI("Job system: {} worker threads", worker_count);
+    return new JobSystem(size_t(worker_count));
+  }();
+  return *instance;
+}
+
+JobSystem::JobSystem(size_t worker_count) {
+  assert_not_zero(worker_count);
+  workers_.reserve(worker_count);
+  for (size_t i = 0; i < worker_count; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  // Background work must not take time from the guest threads.
+  Thread::CreationParameters thread_parameters;
+  thread_parameters.initial_priority = ThreadPriority::kBelowNormal;
+  for (size_t i = 0; i < worker_count; ++i) {
+    Worker& worker = *workers_[i];
+    worker.thread =
+        Thread::Create(thread_parameters, [this, i]() { WorkerThread(i); });
+    assert_not_null(worker.thread);
+    worker.thread->set_name("Job System Worker");
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(idle_lock_);
+    shutdown_ = true;
+  }
+  idle_cond_.notify_all();
+  for (const std::unique_ptr<Worker>& worker : workers_) {
+    if (worker->thread) {
+      Wait(worker->thread.get(), false);
+    }
+  }
+}
+
+void JobSystem::Submit(JobPriority priority, Job job) {
+  assert_true(priority < JobPriority::kCount);
+  size_t worker_index;
+  if (current_job_system == this) {
+    worker_index = current_worker_index;
+  } else {
+    std::lock_guard<std::mutex> lock(idle_lock_);
+    worker_index = next_worker_;
+    next_worker_ = (next_worker_ + 1) % workers_.size();
+  }
+  {
+    Worker& worker = *workers_[worker_index];
+    std::lock_guard<std::mutex> lock(worker.jobs_lock);
+    worker.jobs[size_t(priority)].push_back(std::move(job));
+  }
+  // Only counted once it's in a queue, so a worker reserving it will find it.
+  {
+    std::lock_guard<std::mutex> lock(idle_lock_);
+    ++unreserved_jobs_;
+  }
+  idle_cond_.notify_one();
+}
+
+void JobSystem::WorkerThread(size_t worker_index) {
+  current_job_system = this;
+  current_worker_index = worker_index;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(idle_lock_);
+      idle_cond_.wait(lock,
+                      [this]() { return shutdown_ || unreserved_jobs_ != 0; });
+      if (shutdown_) {
+        return;
+      }
+      --unreserved_jobs_;
+    }
+    // A job has been reserved, so there's a job in the queues not taken by
+    // another worker yet, though a worker reserving a later job may take it
+    // before this one gets to it - retry then, the other job is in a queue.
+    Job job;
+    while (!TakeJob(worker_index, job)) {
+      MaybeYield();
+    }
+    job();
+  }
+}
+
+bool JobSystem::TakeJob(size_t worker_index, Job& job_out) {
+  for (size_t priority = 0; priority < size_t(JobPriority::kCount);
+       ++priority) {
+    {
+      Worker& worker = *workers_[worker_index];
+      std::lock_guard<std::mutex> lock(worker.jobs_lock);
+      std::deque<Job>& jobs = worker.jobs[priority];
+      if (!jobs.empty()) {
+        job_out = std::move(jobs.back());
+        jobs.pop_back();
+        return true;
+      }
+    }
+    for (size_t i = 1; i < workers_.size(); ++i) {
+      Worker& victim = *workers_[(worker_index + i) % workers_.size()];
+      std::lock_guard<std::mutex> lock(victim.jobs_lock);
+      std::deque<Job>& jobs = victim.jobs[priority];
+      if (!jobs.empty()) {
+        job_out = std::move(jobs.front());
+        jobs.pop_front();
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+namespace {
+// Shared with the helpers, which may start only after the loop is over.
+struct ParallelForState {
+  size_t count;
+  const std::function<void(size_t)>* function;
+  std::atomic<size_t> next_index{0};
+  // Protected with mutex, notify finished_cond when changed.
+  std::mutex mutex;
+  std::condition_variable finished_cond;
+  size_t active_helpers = 0;
+  bool finished = false;
+
+  void Run() {
+    for (;;) {
+      size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+      if (index >= count) {
+        break;
+      }
+      (*function)(index);
+    }
+  }
+};
+}  // namespace
+
+void ParallelFor(size_t count, const char* name,
+                 const std::function<void(size_t)>& function) {
+  if (!count) {
+    return;
+  }
+  ProfileTraceScope profile_scope("ParallelFor", name);
+  auto state = std::make_shared<ParallelForState>();
+  state->count = count;
+  state->function = &function;
+  JobSystem& job_system = JobSystem::Get();
+  size_t helper_count = std::min(job_system.worker_count(), count - 1);
+  for (size_t i = 0; i < helper_count; ++i) {
+    job_system.Submit(JobPriority::kHigh, [state]() {
+      {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->finished) {
+          return;
+        }
+        ++state->active_helpers;
+      }
+      state->Run();
+      {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        --state->active_helpers;
+      }
+      state->finished_cond.notify_all();
+    });
+  }
+  // The caller takes part rather than waiting for the workers, so the loop
+  // completes even if they are all busy, or if this is one of them.
+  state->Run();
+  // Only waiting for the helpers that have started taking indices.
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->finished = true;
+  state->finished_cond.wait(lock, [&]() { return !state->active_helpers; });
+}
+
+}  // namespace xe::threading
@@ -0,0 +1,85 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_THREADING_JOB_SYSTEM_H_
+#define XENIA_BASE_THREADING_JOB_SYSTEM_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "xenia/base/threading.h"
+
+namespace xe::threading {
+
+enum class JobPriority : uint32_t {
+  // Work something is waiting for, such as the helpers of ParallelFor.
+  kHigh,
+  kNormal,
+  // Work done ahead of time, such as function precompilation, only taking
+  // the capacity not needed by the rest.
+  kBackground,
+
+  kCount,
+};
+
+// Work-stealing pool of threads shared by the subsystems, instead of each
+// creating its own threads and oversubscribing the host processors together
+// with the guest hardware threads. Each worker has its own queues - jobs
+// submitted from a worker go to its own queue and are taken most recent
+// first, while idle workers steal the oldest jobs from the queues of the
+// others, with the higher priorities always taken first.
+class JobSystem {
+ public:
+  using Job = std::function<void()>;
+
+  // The instance shared by the emulator, with job_system_threads workers,
+  // created on the first use and living until the process exits, since jobs
+  // may be submitted from anywhere.
+  static JobSystem& Get();
+
+  explicit JobSystem(size_t worker_count);
+  // Waits for the jobs being executed to complete and drops the pending ones.
+  ~JobSystem();
+
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+
+  size_t worker_count() const { return workers_.size(); }
+
+  void Submit(JobPriority priority, Job job);
+
+ private:
+  struct Worker {
+    std::mutex jobs_lock;
+    std::deque<Job> jobs[size_t(JobPriority::kCount)];
+    std::unique_ptr<Thread> thread;
+  };
+
+  void WorkerThread(size_t worker_index);
+  bool TakeJob(size_t worker_index, Job& job_out);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  size_t next_worker_ = 0;
+
+  // Number of queued jobs not reserved by a worker yet, and the shutdown
+  // request, protected with idle_lock_, notify idle_cond_ when changed.
+  std::mutex idle_lock_;
+  std::condition_variable idle_cond_;
+  size_t unreserved_jobs_ = 0;
+  bool shutdown_ = false;
+};
+
+}  // namespace xe::threading
+
+#endif  // XENIA_BASE_THREADING_JOB_SYSTEM_H_
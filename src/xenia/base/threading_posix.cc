@@ -11,9 +11,13 @@
 
 #include "xenia/base/assert.h"
 #include "xenia/base/chrono_steady_cast.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/concurrent_queue.h"
+#include "xenia/base/math.h"
 #include "xenia/base/platform.h"
 #include "xenia/base/threading_timer_queue.h"
 
+#include <linux/futex.h>
 #include <pthread.h>
 #include <sched.h>
 #include <signal.h>
@@ -25,7 +29,11 @@
 #include <array>
 #include <cstddef>
 #include <ctime>
+#include <fstream>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #if XE_PLATFORM_ANDROID
 #include <dlfcn.h>
@@ -132,6 +140,72 @@ void install_signal_handler(SignalType type) {
 // TODO(dougvj)
 void EnableAffinityConfiguration() {}
 
+static bool ReadSysfsUint(const std::string& path, uint32_t& value_out) {
+  std::ifstream file(path);
+  return bool(file >> value_out);
+}
+
+// Parses a list like 0-3,8-11 into a mask of the first 64 processors.
+static uint64_t ReadSysfsCpuListMask(const std::string& path) {
+  std::ifstream file(path);
+  std::string list;
+  if (!std::getline(file, list)) {
+    return 0;
+  }
+  uint64_t mask = 0;
+  size_t position = 0;
+  while (position < list.size()) {
+    size_t range_end = list.find(',', position);
+    if (range_end == std::string::npos) {
+      range_end = list.size();
+    }
+    std::string range = list.substr(position, range_end - position);
+    position = range_end + 1;
+    uint32_t first, last;
+    char separator;
+    std::istringstream range_stream(range);
+    if (!(range_stream >> first)) {
+      continue;
+    }
+    if (!(range_stream >> separator >> last) || separator != '-') {
+      last = first;
+    }
+    for (uint32_t i = first; i <= last && i < 64; ++i) {
+      mask |= uint64_t(1) << i;
+    }
+  }
+  return mask;
+}
+
+const std::vector<LogicalProcessor>& GetLogicalProcessors() {
+  static const std::vector<LogicalProcessor> processors = [] {
+    std::vector<LogicalProcessor> result;
+    // The efficiency cores of hybrid Intel CPUs have a separate PMU.
+    uint64_t atom_mask = ReadSysfsCpuListMask("/sys/devices/cpu_atom/cpus");
+    uint32_t count = std::min(logical_processor_count(), uint32_t(64));
+    for (uint32_t i = 0; i < count; ++i) {
+      std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(i);
+      LogicalProcessor& processor = result.emplace_back();
+      processor.index = i;
+      uint32_t package_id = 0, core_id = i;
+      ReadSysfsUint(path + "/topology/physical_package_id", package_id);
+      ReadSysfsUint(path + "/topology/core_id", core_id);
+      // Core IDs are only unique within a package.
+      processor.core_id = (package_id << 16) | core_id;
+      // Identified by the lowest processor sharing the L3 cache.
+      uint64_t cache_mask =
+          ReadSysfsCpuListMask(path + "/cache/index3/shared_cpu_list");
+      processor.cache_id = cache_mask ? xe::tzcnt(cache_mask) : package_id;
+      // Reported on heterogeneous ARM CPUs.
+      if (!ReadSysfsUint(path + "/cpu_capacity", processor.efficiency_class)) {
+        processor.efficiency_class = (atom_mask & (uint64_t(1) << i)) ? 0 : 1;
+      }
+    }
+    return result;
+  }();
+  return processors;
+}
+
 // uint64_t ticks() { return mach_absolute_time(); }
 
 uint32_t current_thread_system_id() {
@@ -145,6 +219,53 @@ void MaybeYield() {
 
 void SyncMemory() { __sync_synchronize(); }
 
+void AtomicWait(const std::atomic<uint32_t>& value, uint32_t expected_value) {
+  static_assert(sizeof(value) == sizeof(uint32_t));
+  syscall(SYS_futex, &value, FUTEX_WAIT_PRIVATE, expected_value, nullptr,
+          nullptr, 0);
+}
+
+void AtomicWait(const std::atomic<uint32_t>& value, uint32_t expected_value,
+                std::chrono::microseconds timeout) {
+  static_assert(sizeof(value) == sizeof(uint32_t));
+  // Relative for FUTEX_WAIT.
+  timespec timeout_timespec = DurationToTimeSpec(timeout);
+  syscall(SYS_futex, &value, FUTEX_WAIT_PRIVATE, expected_value,
+          &timeout_timespec, nullptr, 0);
+}
+
+void AtomicNotifyAll(const std::atomic<uint32_t>& value) {
+  syscall(SYS_futex, &value, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+PreciseSleeper::PreciseSleeper() = default;
+
+PreciseSleeper::~PreciseSleeper() = default;
+
+uint64_t PreciseSleeper::SleepUntil(uint64_t deadline_host_ticks,
+                                    uint64_t spin_host_ticks) {
+  uint64_t host_ticks = Clock::QueryHostTickCount();
+  if (deadline_host_ticks > host_ticks + spin_host_ticks) {
+    // The host ticks may be on a different clock than CLOCK_MONOTONIC, so the
+    // absolute wake-up time is derived from the remaining duration.
+    uint64_t wait_ns =
+        uint64_t(double(deadline_host_ticks - spin_host_ticks - host_ticks) *
+                 1000000000.0 / double(Clock::QueryHostTickFrequency()));
+    timespec wake_time;
+    clock_gettime(CLOCK_MONOTONIC, &wake_time);
+    wait_ns += uint64_t(wake_time.tv_nsec);
+    wake_time.tv_sec += time_t(wait_ns / 1000000000);
+    wake_time.tv_nsec = long(wait_ns % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake_time,
+                           nullptr) == EINTR) {
+    }
+  }
+  while ((host_ticks = Clock::QueryHostTickCount()) < deadline_host_ticks) {
+    SpinPause();
+  }
+  return host_ticks;
+}
+
 void Sleep(std::chrono::microseconds duration) {
   timespec rqtp = DurationToTimeSpec(duration);
   timespec rmtp = {};
@@ -599,7 +720,14 @@ class PosixCondition<Thread> : public PosixConditionBase {
   }
 #endif
 
+#if XE_PLATFORM_ANDROID
+  // The kernel thread ID, as needed by the performance hint API.
+  uint32_t system_id() const {
+    return static_cast<uint32_t>(pthread_gettid_np(thread_));
+  }
+#else
   uint32_t system_id() const { return static_cast<uint32_t>(thread_); }
+#endif
 
   uint64_t affinity_mask() {
     WaitStarted();
@@ -628,7 +756,7 @@ class PosixCondition<Thread> : public PosixConditionBase {
     cpu_set_t cpu_set;
     CPU_ZERO(&cpu_set);
     for (auto i = 0u; i < 64; i++) {
-      if (mask & (1 << i)) {
+      if (mask & (uint64_t(1) << i)) {
         CPU_SET(i, &cpu_set);
       }
     }
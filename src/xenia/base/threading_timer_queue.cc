@@ -9,6 +9,8 @@
 
 #include <algorithm>
 #include <forward_list>
+#include <iterator>
+#include <vector>
 
 #include "third_party/disruptorplus/include/disruptorplus/blocking_wait_strategy.hpp"
 #include "third_party/disruptorplus/include/disruptorplus/multi_threaded_claim_strategy.hpp"
@@ -17,6 +19,8 @@
 #include "third_party/disruptorplus/include/disruptorplus/spin_wait.hpp"
 #include "third_party/disruptorplus/include/disruptorplus/spin_wait_strategy.hpp"
 #include "xenia/base/assert.h"
+#include "xenia/base/math.h"
+#include "xenia/base/profiling.h"
 #include "xenia/base/threading.h"
 #include "xenia/base/threading_timer_queue.h"
 
@@ -53,6 +57,7 @@ class TimerQueue {
         consumed_(wait_strategy_),
         shutdown_(false) {
     claim_strategy_.add_claim_barrier(consumed_);
+    wheel_epoch_ = clock::now();
     dispatch_thread_ = std::thread(&TimerQueue::TimerThreadMain, this);
   }
 
@@ -71,40 +76,39 @@ class TimerQueue {
 
   void TimerThreadMain() {
     dp::sequence_t next_sequence = 0;
-    const auto comp = [](const std::shared_ptr<WaitItem>& left,
-                         const std::shared_ptr<WaitItem>& right) {
-      return left->due_ < right->due_;
-    };
 
     xe::threading::set_name("xe::threading::TimerQueue");
 
     while (!shutdown_.load(std::memory_order_relaxed)) {
       {
-        // Consume new wait items and add them to sorted wait queue
+        // Consume new wait items and add them to the wheel
         dp::sequence_t available = claim_strategy_.wait_until_published(
-            next_sequence, next_sequence - 1,
-            wait_queue_.empty() ? clock::time_point::max()
-                                : wait_queue_.front()->due_);
+            next_sequence, next_sequence - 1, GetNextWakeTime());
 
         // Check for timeout
         if (available != next_sequence - 1) {
-          std::forward_list<std::shared_ptr<WaitItem>> wait_items;
           do {
-            wait_items.push_front(std::move(buffer_[next_sequence]));
+            ScheduleWaitItem(std::move(buffer_[next_sequence]));
+            ++wait_item_count_;
           } while (next_sequence++ != available);
 
           consumed_.publish(available);
-
-          wait_items.sort(comp);
-          wait_queue_.merge(wait_items, comp);
         }
       }
 
       {
         // Check wait queue, invoke callbacks and reschedule
-        std::forward_list<std::shared_ptr<WaitItem>> wait_items;
-        while (!wait_queue_.empty() &&
-               wait_queue_.front()->due_ <= clock::now()) {
+        AdvanceWheel(clock::now());
+        std::vector<std::shared_ptr<WaitItem>> wait_items;
+        clock::duration max_jitter = clock::duration::zero();
+        bool any_dispatched = false;
+        while (!wait_queue_.empty()) {
+          // Also dispatch the callbacks due shortly after the current one
+          // without waiting for them, rather than waking up again.
+          clock::time_point now = clock::now();
+          if (wait_queue_.front()->due_ > now + kCoalescingSlack) {
+            break;
+          }
           auto wait_item = std::move(wait_queue_.front());
           wait_queue_.pop_front();
 
@@ -113,6 +117,12 @@ class TimerQueue {
           if (wait_item->state_.compare_exchange_strong(
                   state, WaitItem::State::kInCallback,
                   std::memory_order_acq_rel)) {
+            clock::duration jitter = now > wait_item->due_
+                                         ? now - wait_item->due_
+                                         : wait_item->due_ - now;
+            max_jitter = std::max(max_jitter, jitter);
+            any_dispatched = true;
+
             // Possibility to dispatch to a thread pool here
             assert_not_null(wait_item->callback_);
             wait_item->callback_(wait_item->userdata_);
@@ -124,18 +134,28 @@ class TimerQueue {
               wait_item->due_ += wait_item->interval_;
               wait_item->state_.store(WaitItem::State::kIdle,
                                       std::memory_order_release);
-              wait_items.push_front(std::move(wait_item));
+              wait_items.push_back(std::move(wait_item));
             } else {
               wait_item->state_.store(WaitItem::State::kDisarmed,
                                       std::memory_order_release);
+              --wait_item_count_;
             }
           } else {
             // Specifically, kInCallback is illegal here
             assert_true(WaitItem::State::kDisarmed == state);
+            --wait_item_count_;
           }
         }
-        wait_items.sort(comp);
-        wait_queue_.merge(wait_items, comp);
+        for (auto& wait_item : wait_items) {
+          ScheduleWaitItem(std::move(wait_item));
+        }
+        if (any_dispatched) {
+          COUNT_profile_set("base/timer_queue/timers", wait_item_count_);
+          COUNT_profile_set(
+              "base/timer_queue/wakeup_jitter_us",
+              std::chrono::duration_cast<std::chrono::microseconds>(max_jitter)
+                  .count());
+        }
       }
     }
   }
@@ -157,6 +177,146 @@ class TimerQueue {
   const std::thread& dispatch_thread() const { return dispatch_thread_; }
 
  private:
+  // Wait items are kept in a hierarchical timing wheel, so scheduling them is
+  // constant time regardless of how many are queued. Only the ones due within
+  // the expired ticks are sorted in the wait queue to be dispatched precisely,
+  // the dispatch thread waking up at the granularity of ticks otherwise.
+  static constexpr clock::duration kWheelTickDuration =
+      std::chrono::milliseconds(1);
+  static constexpr uint32_t kWheelSlotCountLog2 = 6;
+  static constexpr uint32_t kWheelSlotCount =
+      uint32_t(1) << kWheelSlotCountLog2;
+  static constexpr uint64_t kWheelSlotMask = kWheelSlotCount - 1;
+  // 64^4 ticks, or about 4.6 hours, before items go to the overflow list.
+  static constexpr uint32_t kWheelLevelCount = 4;
+  // Callbacks due within this time after the current one are dispatched
+  // immediately, coalescing the wake-ups.
+  static constexpr clock::duration kCoalescingSlack =
+      std::chrono::microseconds(100);
+
+  uint64_t GetWheelTick(clock::time_point time) const {
+    if (time <= wheel_epoch_) {
+      return 0;
+    }
+    return uint64_t((time - wheel_epoch_) / kWheelTickDuration);
+  }
+  clock::time_point GetWheelTickTime(uint64_t tick) const {
+    return wheel_epoch_ + int64_t(tick) * kWheelTickDuration;
+  }
+
+  void ScheduleWaitItem(std::shared_ptr<WaitItem> wait_item) {
+    uint64_t tick = GetWheelTick(wait_item->due_);
+    if (tick < wheel_tick_) {
+      // The tick has already expired, insert it in the sorted wait queue after
+      // the items due at the same time.
+      auto it = wait_queue_.before_begin();
+      for (auto it_next = std::next(it);
+           it_next != wait_queue_.end() && (*it_next)->due_ <= wait_item->due_;
+           it = it_next++) {
+      }
+      wait_queue_.insert_after(it, std::move(wait_item));
+      return;
+    }
+    // The level is the one of the highest bits differing from the current
+    // tick, so the item is cascaded to the lower levels as the tick advances.
+    uint64_t tick_difference = tick ^ wheel_tick_;
+    ++wheel_wait_item_count_;
+    if (tick_difference >> (kWheelSlotCountLog2 * kWheelLevelCount)) {
+      wheel_overflow_.push_back(std::move(wait_item));
+      return;
+    }
+    uint32_t level = 0;
+    while (level + 1 < kWheelLevelCount &&
+           (tick_difference >> (kWheelSlotCountLog2 * (level + 1)))) {
+      ++level;
+    }
+    uint64_t slot = (tick >> (kWheelSlotCountLog2 * level)) & kWheelSlotMask;
+    wheel_[level][slot].push_back(std::move(wait_item));
+    wheel_occupancy_[level] |= uint64_t(1) << slot;
+  }
+
+  // The overflow list for the level past the last one.
+  void RescheduleWheelSlot(uint32_t level, uint64_t slot) {
+    std::vector<std::shared_ptr<WaitItem>> wait_items;
+    if (level < kWheelLevelCount) {
+      wait_items.swap(wheel_[level][slot]);
+      wheel_occupancy_[level] &= ~(uint64_t(1) << slot);
+    } else {
+      wait_items.swap(wheel_overflow_);
+    }
+    wheel_wait_item_count_ -= uint32_t(wait_items.size());
+    for (auto& wait_item : wait_items) {
+      ScheduleWaitItem(std::move(wait_item));
+    }
+  }
+
+  // Expires all ticks up to and including the one of the time, moving their
+  // items to the wait queue.
+  void AdvanceWheel(clock::time_point time) {
+    uint64_t target_tick = GetWheelTick(time);
+    if (!wheel_wait_item_count_) {
+      wheel_tick_ = std::max(wheel_tick_, target_tick + 1);
+      return;
+    }
+    while (wheel_tick_ <= target_tick) {
+      if (!(wheel_tick_ & kWheelSlotMask)) {
+        // The first level has wrapped around, cascade the higher levels.
+        for (uint32_t level = 1; level <= kWheelLevelCount; ++level) {
+          uint64_t level_slot =
+              (wheel_tick_ >> (kWheelSlotCountLog2 * level)) & kWheelSlotMask;
+          RescheduleWheelSlot(level, level_slot);
+          if (level_slot) {
+            break;
+          }
+        }
+      }
+      uint64_t slot = wheel_tick_ & kWheelSlotMask;
+      ++wheel_tick_;
+      RescheduleWheelSlot(0, slot);
+    }
+  }
+
+  clock::time_point GetNextWakeTime() const {
+    clock::time_point wake_time = wait_queue_.empty()
+                                      ? clock::time_point::max()
+                                      : wait_queue_.front()->due_;
+    if (!wheel_wait_item_count_) {
+      return wake_time;
+    }
+    // Wake up for the next tick with items in the first level, or for
+    // cascading the nearest non-empty slots of the higher levels, which is
+    // done at the start of the range of ticks they cover.
+    for (uint32_t level = 0; level < kWheelLevelCount; ++level) {
+      uint32_t shift = kWheelSlotCountLog2 * level;
+      uint64_t first_slot = (wheel_tick_ >> shift) & kWheelSlotMask;
+      // The slot of the current tick has already been cascaded unless the
+      // tick is at the start of its range.
+      if (wheel_tick_ & ((uint64_t(1) << shift) - 1)) {
+        ++first_slot;
+      }
+      if (first_slot >= kWheelSlotCount) {
+        continue;
+      }
+      uint64_t occupancy =
+          wheel_occupancy_[level] & ~((uint64_t(1) << first_slot) - 1);
+      if (occupancy) {
+        uint64_t tick =
+            (((wheel_tick_ >> shift) & ~kWheelSlotMask) | xe::tzcnt(occupancy))
+            << shift;
+        wake_time = std::min(wake_time, GetWheelTickTime(tick));
+      }
+    }
+    if (!wheel_overflow_.empty()) {
+      uint32_t shift = kWheelSlotCountLog2 * kWheelLevelCount;
+      uint64_t tick = wheel_tick_;
+      if (tick & ((uint64_t(1) << shift) - 1)) {
+        tick = ((tick >> shift) + 1) << shift;
+      }
+      wake_time = std::min(wake_time, GetWheelTickTime(tick));
+    }
+    return wake_time;
+  }
+
   // This ring buffer will be used to introduce timers queued by the public API
   static constexpr size_t kWaitCount = 512;
   dp::ring_buffer<std::shared_ptr<WaitItem>> buffer_;
@@ -165,9 +325,21 @@ class TimerQueue {
   dp::multi_threaded_claim_strategy<WaitStrat> claim_strategy_;
   dp::sequence_barrier<WaitStrat> consumed_;
 
-  // This is a _sorted_ (ascending due_) list of active timers managed by a
-  // dedicated thread
+  // The wheel and the wait queue are only accessed by the dispatch thread.
+  clock::time_point wheel_epoch_;
+  // The next tick to expire.
+  uint64_t wheel_tick_ = 0;
+  std::vector<std::shared_ptr<WaitItem>> wheel_[kWheelLevelCount]
+                                               [kWheelSlotCount];
+  // Bits of the non-empty slots of each level.
+  uint64_t wheel_occupancy_[kWheelLevelCount] = {};
+  std::vector<std::shared_ptr<WaitItem>> wheel_overflow_;
+  uint32_t wheel_wait_item_count_ = 0;
+  // This is a _sorted_ (ascending due_) list of the timers due within the
+  // expired ticks
   std::forward_list<std::shared_ptr<WaitItem>> wait_queue_;
+  // Including the disarmed ones not reached yet.
+  uint32_t wait_item_count_ = 0;
   std::atomic_bool shutdown_;
   std::thread dispatch_thread_;
 };
@@ -10,6 +10,8 @@
 #include <winternl.h>
 #include "xenia/base/assert.h"
 #include "xenia/base/chrono_steady_cast.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/concurrent_queue.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/platform_win.h"
 #include "xenia/base/threading.h"
@@ -74,6 +76,66 @@ void EnableAffinityConfiguration() {
   SetProcessAffinityMask(process_handle, system_affinity_mask);
 }
 
+const std::vector<LogicalProcessor>& GetLogicalProcessors() {
+  static const std::vector<LogicalProcessor> processors = [] {
+    uint32_t count = std::min(logical_processor_count(), uint32_t(64));
+    std::vector<LogicalProcessor> result(count);
+    for (uint32_t i = 0; i < count; ++i) {
+      LogicalProcessor& processor = result[i];
+      processor.index = i;
+      processor.core_id = i;
+      processor.cache_id = 0;
+      processor.efficiency_class = 0;
+    }
+    DWORD buffer_size = 0;
+    GetLogicalProcessorInformationEx(RelationAll, nullptr, &buffer_size);
+    std::vector<uint8_t> buffer(buffer_size);
+    if (!buffer_size ||
+        !GetLogicalProcessorInformationEx(
+            RelationAll,
+            reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(
+                buffer.data()),
+            &buffer_size)) {
+      return result;
+    }
+    // Only the processors of the first group can be used in affinity masks.
+    uint32_t core_id = 0, cache_id = 0;
+    for (DWORD offset = 0; offset < buffer_size;) {
+      auto& info =
+          *reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(
+              buffer.data() + offset);
+      offset += info.Size;
+      uint64_t mask = 0;
+      if (info.Relationship == RelationProcessorCore) {
+        if (info.Processor.GroupCount && !info.Processor.GroupMask[0].Group) {
+          mask = info.Processor.GroupMask[0].Mask;
+        }
+      } else if (info.Relationship == RelationCache &&
+                 info.Cache.Level == 3 && !info.Cache.GroupMask.Group) {
+        mask = info.Cache.GroupMask.Mask;
+      }
+      for (uint32_t i = 0; i < count; ++i) {
+        if (!(mask & (uint64_t(1) << i))) {
+          continue;
+        }
+        if (info.Relationship == RelationProcessorCore) {
+          result[i].core_id = core_id;
+          result[i].efficiency_class = info.Processor.EfficiencyClass;
+        } else {
+          result[i].cache_id = cache_id;
+        }
+      }
+      if (info.Relationship == RelationProcessorCore) {
+        ++core_id;
+      } else if (info.Relationship == RelationCache && mask) {
+        ++cache_id;
+      }
+    }
+    return result;
+  }();
+  return processors;
+}
+
 uint32_t current_thread_system_id() {
   return static_cast<uint32_t>(GetCurrentThreadId());
 }
@@ -161,6 +223,70 @@ void NanoSleep(int64_t ns) {
 }
 void SyncMemory() { MemoryBarrier(); }
 
+void AtomicWait(const std::atomic<uint32_t>& value, uint32_t expected_value) {
+  static_assert(sizeof(value) == sizeof(uint32_t));
+  ::WaitOnAddress(const_cast<std::atomic<uint32_t>*>(&value), &expected_value,
+                  sizeof(expected_value), INFINITE);
+}
+
+void AtomicWait(const std::atomic<uint32_t>& value, uint32_t expected_value,
+                std::chrono::microseconds timeout) {
+  static_assert(sizeof(value) == sizeof(uint32_t));
+  DWORD timeout_ms = DWORD((timeout.count() + 999) / 1000);
+  if (!timeout_ms) {
+    timeout_ms = 1;
+  }
+  ::WaitOnAddress(const_cast<std::atomic<uint32_t>*>(&value), &expected_value,
+                  sizeof(expected_value), timeout_ms);
+}
+
+void AtomicNotifyAll(const std::atomic<uint32_t>& value) {
+  ::WakeByAddressAll(const_cast<std::atomic<uint32_t>*>(&value));
+}
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+PreciseSleeper::PreciseSleeper() {
+  // High-resolution timers are available since Windows 10 version 1803, the
+  // regular ones are limited to the system timer resolution.
+  timer_ = CreateWaitableTimerExW(nullptr, nullptr,
+                                  CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                  TIMER_ALL_ACCESS);
+  if (!timer_) {
+    timer_ = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+  }
+}
+
+PreciseSleeper::~PreciseSleeper() {
+  if (timer_) {
+    CloseHandle(timer_);
+  }
+}
+
+uint64_t PreciseSleeper::SleepUntil(uint64_t deadline_host_ticks,
+                                    uint64_t spin_host_ticks) {
+  uint64_t host_ticks = Clock::QueryHostTickCount();
+  if (deadline_host_ticks > host_ticks + spin_host_ticks) {
+    // In 100 nanosecond units, negative for a relative due time.
+    LARGE_INTEGER due_time;
+    due_time.QuadPart = -int64_t(
+        double(deadline_host_ticks - spin_host_ticks - host_ticks) *
+        10000000.0 / double(Clock::QueryHostTickFrequency()));
+    if (timer_ && due_time.QuadPart < 0 &&
+        SetWaitableTimer(timer_, &due_time, 0, nullptr, nullptr, FALSE)) {
+      WaitForSingleObject(timer_, INFINITE);
+    } else {
+      NanoSleep(-due_time.QuadPart * 100);
+    }
+  }
+  while ((host_ticks = Clock::QueryHostTickCount()) < deadline_host_ticks) {
+    SpinPause();
+  }
+  return host_ticks;
+}
+
 void Sleep(std::chrono::microseconds duration) {
   if (duration.count() < 100) {
     MaybeYield();
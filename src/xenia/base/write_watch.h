@@ -0,0 +1,51 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_WRITE_WATCH_H_
+#define XENIA_BASE_WRITE_WATCH_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+namespace xe {
+namespace memory {
+
+// Tracking of writes to memory by the OS, polled in batches, without taking an
+// access violation in the process on the first write to every page like with
+// protection-based watches.
+class WriteWatch {
+ public:
+  // Returns nullptr if not supported by the host OS.
+  static std::unique_ptr<WriteWatch> Create();
+
+  WriteWatch(const WriteWatch& write_watch) = delete;
+  WriteWatch& operator=(const WriteWatch& write_watch) = delete;
+  virtual ~WriteWatch() = default;
+
+  // Starts tracking writes to a page-aligned mapped range, with none of the
+  // pages considered written initially.
+  virtual bool Register(void* base_address, size_t length) = 0;
+
+  // Calls the callback for every run of pages within the range written since
+  // the previous scan, and starts tracking them again, atomically with writes
+  // done by other threads.
+  using WrittenRangeCallback =
+      std::function<void(void* address, size_t length)>;
+  virtual bool ScanWrittenRanges(void* base_address, size_t length,
+                                 const WrittenRangeCallback& callback) = 0;
+
+ protected:
+  WriteWatch() = default;
+};
+
+}  // namespace memory
+}  // namespace xe
+
+#endif  // XENIA_BASE_WRITE_WATCH_H_
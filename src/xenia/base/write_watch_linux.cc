@@ -0,0 +1,164 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/write_watch.h"
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <linux/userfaultfd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstdint>
+
+#include "xenia/base/logging.h"
+
+// Asynchronous userfaultfd write protection and PAGEMAP_SCAN are available
+// since Linux 6.7, define what's needed if the headers are older.
+#ifndef UFFD_USER_MODE_ONLY
+#define UFFD_USER_MODE_ONLY 1
+#endif
+#ifndef UFFD_FEATURE_WP_UNPOPULATED
+#define UFFD_FEATURE_WP_UNPOPULATED (1 << 13)
+#endif
+#ifndef UFFD_FEATURE_WP_ASYNC
+#define UFFD_FEATURE_WP_ASYNC (1 << 15)
+#endif
+#ifndef PAGEMAP_SCAN
+#define PAGE_IS_WRITTEN (1 << 1)
+struct page_region {
+  __u64 start;
+  __u64 end;
+  __u64 categories;
+};
+#define PM_SCAN_WP_MATCHING (1 << 0)
+#define PM_SCAN_CHECK_WPASYNC (1 << 1)
+struct pm_scan_arg {
+  __u64 size;
+  __u64 flags;
+  __u64 start;
+  __u64 end;
+  __u64 walk_end;
+  __u64 vec;
+  __u64 vec_len;
+  __u64 max_pages;
+  __u64 category_inverted;
+  __u64 category_mask;
+  __u64 category_anyof_mask;
+  __u64 return_mask;
+};
+#define PAGEMAP_SCAN _IOWR('f', 16, struct pm_scan_arg)
+#endif
+
+namespace xe {
+namespace memory {
+
+// Pages are write-protected via userfaultfd in the asynchronous mode, where the
+// kernel resolves the write faults by itself without notifying the process,
+// only marking the pages as written, and PAGEMAP_SCAN atomically collects the
+// written pages and protects them again.
+class UserfaultfdWriteWatch : public WriteWatch {
+ public:
+  static std::unique_ptr<UserfaultfdWriteWatch> Create() {
+    // Only the asynchronous mode is used, so no fault handling from the kernel
+    // mode is needed, which is also allowed without privileges.
+    int uffd = int(syscall(SYS_userfaultfd,
+                           O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY));
+    if (uffd < 0) {
+      XELOGI("Write watch: userfaultfd is not available");
+      return nullptr;
+    }
+    uffdio_api api = {};
+    api.api = UFFD_API;
+    api.features = UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_HUGETLBFS_SHMEM |
+                   UFFD_FEATURE_WP_UNPOPULATED;
+    if (ioctl(uffd, UFFDIO_API, &api)) {
+      XELOGI(
+          "Write watch: asynchronous userfaultfd write protection of shared "
+          "memory is not supported");
+      close(uffd);
+      return nullptr;
+    }
+    int pagemap_fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+    if (pagemap_fd < 0) {
+      XELOGI("Write watch: Failed to open /proc/self/pagemap");
+      close(uffd);
+      return nullptr;
+    }
+    return std::unique_ptr<UserfaultfdWriteWatch>(
+        new UserfaultfdWriteWatch(uffd, pagemap_fd));
+  }
+
+  ~UserfaultfdWriteWatch() override {
+    close(pagemap_fd_);
+    close(uffd_);
+  }
+
+  bool Register(void* base_address, size_t length) override {
+    uffdio_register register_args = {};
+    register_args.range.start = uint64_t(base_address);
+    register_args.range.len = length;
+    register_args.mode = UFFDIO_REGISTER_MODE_WP;
+    if (ioctl(uffd_, UFFDIO_REGISTER, &register_args)) {
+      XELOGE("Write watch: Failed to register {} bytes at {}", length,
+             base_address);
+      return false;
+    }
+    uffdio_writeprotect writeprotect_args = {};
+    writeprotect_args.range = register_args.range;
+    writeprotect_args.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+    if (ioctl(uffd_, UFFDIO_WRITEPROTECT, &writeprotect_args)) {
+      XELOGE("Write watch: Failed to write-protect {} bytes at {}", length,
+             base_address);
+      return false;
+    }
+    return true;
+  }
+
+  bool ScanWrittenRanges(void* base_address, size_t length,
+                         const WrittenRangeCallback& callback) override {
+    page_region regions[64];
+    pm_scan_arg scan_args = {};
+    scan_args.size = sizeof(scan_args);
+    scan_args.flags = PM_SCAN_WP_MATCHING | PM_SCAN_CHECK_WPASYNC;
+    scan_args.start = uint64_t(base_address);
+    scan_args.end = uint64_t(base_address) + length;
+    scan_args.vec = uint64_t(regions);
+    scan_args.vec_len = sizeof(regions) / sizeof(regions[0]);
+    scan_args.category_mask = PAGE_IS_WRITTEN;
+    scan_args.return_mask = PAGE_IS_WRITTEN;
+    while (scan_args.start < scan_args.end) {
+      long region_count = ioctl(pagemap_fd_, PAGEMAP_SCAN, &scan_args);
+      if (region_count < 0) {
+        return false;
+      }
+      for (long i = 0; i < region_count; ++i) {
+        callback(reinterpret_cast<void*>(regions[i].start),
+                 size_t(regions[i].end - regions[i].start));
+      }
+      // Stopped early if the output vector is full.
+      scan_args.start = scan_args.walk_end;
+    }
+    return true;
+  }
+
+ private:
+  explicit UserfaultfdWriteWatch(int uffd, int pagemap_fd)
+      : uffd_(uffd), pagemap_fd_(pagemap_fd) {}
+
+  int uffd_;
+  int pagemap_fd_;
+};
+
+std::unique_ptr<WriteWatch> WriteWatch::Create() {
+  return UserfaultfdWriteWatch::Create();
+}
+
+}  // namespace memory
+}  // namespace xe
@@ -0,0 +1,23 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/write_watch.h"
+
+namespace xe {
+namespace memory {
+
+std::unique_ptr<WriteWatch> WriteWatch::Create() {
+  // MEM_WRITE_WATCH / GetWriteWatch is only available for VirtualAlloc
+  // allocations, not for views of file mappings, which the guest memory is
+  // made of.
+  return nullptr;
+}
+
+}  // namespace memory
+}  // namespace xe
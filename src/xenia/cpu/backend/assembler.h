@@ -10,6 +10,7 @@
 #ifndef XENIA_CPU_BACKEND_ASSEMBLER_H_
 #define XENIA_CPU_BACKEND_ASSEMBLER_H_
 
+#include <cstdint>
 #include <memory>
 
 namespace xe {
@@ -28,6 +29,14 @@ namespace backend {
 
 class Backend;
 
+// Pass pipeline the HIR given to the assembler has been compiled with.
+enum class CompilationTier {
+  // Minimal optimizations. The code requests a retranslation with the full
+  // pipeline once the function has been called enough times.
+  kBaseline,
+  kOptimized,
+};
+
 class Assembler {
  public:
   explicit Assembler(Backend* backend);
@@ -37,12 +46,25 @@ class Assembler {
 
   virtual void Reset();
 
+  // If the function already has baseline code, optimized code replaces it.
   virtual bool Assemble(GuestFunction* function, hir::HIRBuilder* builder,
                         uint32_t debug_info_flags,
-                        std::unique_ptr<FunctionDebugInfo> debug_info) = 0;
+                        std::unique_ptr<FunctionDebugInfo> debug_info,
+                        CompilationTier tier) = 0;
+
+  // Sets up the function with machine code loaded from the persistent code
+  // storage of the backend, if it has code for the function generated by the
+  // same pass pipeline. Returns false if the function must be assembled.
+  virtual bool AssembleFromStorage(GuestFunction* function) { return false; }
+
+  // Identifies the HIR pass pipeline the assembled code is generated by.
+  void set_pipeline_fingerprint(uint64_t pipeline_fingerprint) {
+    pipeline_fingerprint_ = pipeline_fingerprint;
+  }
 
  protected:
   Backend* backend_;
+  uint64_t pipeline_fingerprint_ = 0;
 };
 
 }  // namespace backend
@@ -10,7 +10,9 @@
 #ifndef XENIA_CPU_BACKEND_BACKEND_H_
 #define XENIA_CPU_BACKEND_BACKEND_H_
 
+#include <filesystem>
 #include <memory>
+#include <vector>
 
 #include "xenia/cpu/backend/machine_info.h"
 #include "xenia/cpu/thread_debug_info.h"
@@ -58,6 +60,24 @@ class Backend {
   virtual void CommitExecutableRange(uint32_t guest_low,
                                      uint32_t guest_high) = 0;
 
+  // Opens the persistent storage for code generated for the given module,
+  // loading code stored during previous runs. Only the first executable module
+  // loaded may use the storage, as code is restored to its original location.
+  virtual void InitializeCodeStorage(Module* module,
+                                     const std::filesystem::path& path) {}
+
+  // Makes the code of the functions of the module unreachable before they're
+  // destroyed, so its space can be reclaimed by ReclaimRetiredCode.
+  virtual void RetireModuleCode(Module* module) {}
+  // Number of blocks of unreachable code that haven't been reclaimed yet.
+  virtual size_t GetRetiredCodeCount() { return 0; }
+  // Reclaims the space of the retired_count blocks retired first not containing
+  // any of the addresses, which must include the host PCs of the frames and the
+  // registers of all threads that may be running guest code.
+  virtual void ReclaimRetiredCode(size_t retired_count,
+                                  const std::vector<uint64_t>& live_addresses) {
+  }
+
   virtual std::unique_ptr<Assembler> CreateAssembler() = 0;
 
   virtual std::unique_ptr<GuestFunction> CreateGuestFunction(
@@ -28,6 +28,8 @@ class CodeCache {
   virtual const std::filesystem::path& file_name() const = 0;
   virtual uintptr_t execute_base_address() const = 0;
   virtual size_t total_size() const = 0;
+  // Host memory committed for the generated code so far.
+  virtual size_t committed_size() const = 0;
 
   // Finds a function based on the given host PC (that may be within a
   // function).
@@ -9,10 +9,12 @@
 
 #include "xenia/cpu/backend/x64/x64_assembler.h"
 
+#include <algorithm>
 #include <climits>
 
 #include "third_party/capstone/include/capstone/capstone.h"
 #include "third_party/capstone/include/capstone/x86.h"
+#include "xenia/base/mutex.h"
 #include "xenia/base/profiling.h"
 #include "xenia/base/reset_scope.h"
 #include "xenia/base/string.h"
@@ -69,15 +71,30 @@ void X64Assembler::Reset() {
 
 bool X64Assembler::Assemble(GuestFunction* function, HIRBuilder* builder,
                             uint32_t debug_info_flags,
-                            std::unique_ptr<FunctionDebugInfo> debug_info) {
+                            std::unique_ptr<FunctionDebugInfo> debug_info,
+                            CompilationTier tier) {
   SCOPE_profile_cpu_f("cpu");
 
   // Reset when we leave.
   xe::make_reset_scope(this);
 
+  auto x64_function = static_cast<X64Function*>(function);
+  if (x64_function->is_baseline() || x64_function->machine_code()) {
+    assert_true(tier == CompilationTier::kOptimized);
+    return AssembleTierUp(x64_function, builder);
+  }
+  if (tier == CompilationTier::kBaseline) {
+    // Must be visible before the code, so no calls directly into it are made.
+    x64_function->set_baseline(true);
+    x64_function->set_tier_up_counter(
+        std::max(cvars::tier_up_call_threshold, uint32_t(1)));
+  }
+
   // Lower HIR -> x64.
   void* machine_code = nullptr;
   size_t code_size = 0;
+  emitter_->set_pipeline_fingerprint(pipeline_fingerprint_);
+  emitter_->set_compilation_tier(tier);
   if (!emitter_->Emit(function, builder, debug_info_flags, debug_info.get(),
                       &machine_code, &code_size, &function->source_map())) {
     return false;
@@ -105,6 +122,66 @@ bool X64Assembler::Assemble(GuestFunction* function, HIRBuilder* builder,
   return true;
 }
 
+bool X64Assembler::AssembleTierUp(X64Function* function, HIRBuilder* builder) {
+  // The previous code may be running on other threads while the new code is
+  // emitted, so the function is only updated once the code is ready. Callers
+  // already in the previous code or calling it directly keep running it.
+  void* machine_code = nullptr;
+  size_t code_size = 0;
+  std::vector<SourceMapEntry> source_map;
+  emitter_->set_pipeline_fingerprint(pipeline_fingerprint_);
+  emitter_->set_compilation_tier(CompilationTier::kOptimized);
+  if (!emitter_->Emit(function, builder, 0, nullptr, &machine_code, &code_size,
+                      &source_map)) {
+    return false;
+  }
+
+  auto global_lock = global_critical_region::AcquireDirect();
+  uint8_t* previous_code = function->machine_code();
+  bool was_baseline = function->is_baseline();
+  function->source_map().swap(source_map);
+  function->Setup(reinterpret_cast<uint8_t*>(machine_code), code_size);
+  function->set_baseline(false);
+
+  // Redirect callers into the optimized code. Callers already in the baseline
+  // code finish running it.
+  uint64_t host_address = reinterpret_cast<uint64_t>(machine_code);
+  assert_true((host_address >> 32) == 0);
+  x64_backend_->code_cache()->AddIndirection(
+      function->address(), static_cast<uint32_t>(host_address));
+
+  // Baseline code is only called through the indirection table, so once no
+  // thread is running it, its space can be reused. Optimized code replaced
+  // after MMIO accesses may still be called directly by other functions.
+  if (was_baseline && previous_code) {
+    x64_backend_->code_cache()->RetireCode(previous_code);
+  }
+
+  return true;
+}
+
+bool X64Assembler::AssembleFromStorage(GuestFunction* function) {
+  auto code_cache = x64_backend_->code_cache();
+  void* machine_code;
+  size_t code_size;
+  if (!code_cache->ClaimStoredGuestCode(function, pipeline_fingerprint_,
+                                        machine_code, code_size)) {
+    return false;
+  }
+
+  auto x64_function = static_cast<X64Function*>(function);
+  x64_function->Setup(reinterpret_cast<uint8_t*>(machine_code), code_size);
+  x64_function->set_code_stored(true);
+
+  // Install into indirection table.
+  uint64_t host_address = reinterpret_cast<uint64_t>(machine_code);
+  assert_true((host_address >> 32) == 0);
+  code_cache->AddIndirection(function->address(),
+                             static_cast<uint32_t>(host_address));
+
+  return true;
+}
+
 void X64Assembler::DumpMachineCode(
     void* machine_code, size_t code_size,
     const std::vector<SourceMapEntry>& source_map, StringBuffer* str) {
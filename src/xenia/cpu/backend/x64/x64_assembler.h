@@ -24,6 +24,7 @@ namespace x64 {
 
 class X64Backend;
 class X64Emitter;
+class X64Function;
 class XbyakAllocator;
 
 class X64Assembler : public Assembler {
@@ -37,9 +38,16 @@ class X64Assembler : public Assembler {
 
   bool Assemble(GuestFunction* function, hir::HIRBuilder* builder,
                 uint32_t debug_info_flags,
-                std::unique_ptr<FunctionDebugInfo> debug_info) override;
+                std::unique_ptr<FunctionDebugInfo> debug_info,
+                CompilationTier tier) override;
+
+  bool AssembleFromStorage(GuestFunction* function) override;
 
  private:
+  // Replaces the baseline code of a function with code emitted from the HIR
+  // compiled with the full pass pipeline.
+  bool AssembleTierUp(X64Function* function, hir::HIRBuilder* builder);
+
   void DumpMachineCode(void* machine_code, size_t code_size,
                        const std::vector<SourceMapEntry>& source_map,
                        StringBuffer* str);
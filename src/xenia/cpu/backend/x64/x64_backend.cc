@@ -11,11 +11,19 @@
 
 #include <stddef.h>
 #include <algorithm>
+#include <chrono>
+#include <vector>
+
 #include "third_party/capstone/include/capstone/capstone.h"
 #include "third_party/capstone/include/capstone/x86.h"
 
+#include "xenia/base/byte_order.h"
 #include "xenia/base/exception_handler.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
+#include "xenia/base/platform_amd64.h"
+#include "xenia/base/threading.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/cpu/backend/x64/x64_assembler.h"
 #include "xenia/cpu/backend/x64/x64_code_cache.h"
 #include "xenia/cpu/backend/x64/x64_emitter.h"
@@ -23,6 +31,7 @@
 #include "xenia/cpu/backend/x64/x64_sequences.h"
 #include "xenia/cpu/backend/x64/x64_stack_layout.h"
 #include "xenia/cpu/breakpoint.h"
+#include "xenia/cpu/cpu_flags.h"
 #include "xenia/cpu/processor.h"
 #include "xenia/cpu/stack_walker.h"
 #include "xenia/cpu/xex_module.h"
@@ -41,9 +50,46 @@ DEFINE_bool(enable_host_guest_stack_synchronization, true,
             "and checks for reentry at return sites. Has slight performance "
             "impact, but fixes crashes in games that use setjmp/longjmp.",
             "x64");
+DEFINE_bool(lazy_host_guest_stack_synchronization, false,
+            "With enable_host_guest_stack_synchronization, only store the "
+            "guest stack pointer and the return address in the frame of each "
+            "function, and reconstruct the host->guest stack mappings from "
+            "the return addresses of the frames when the stacks need to be "
+            "synchronized, instead of recording them at every call.",
+            "x64");
+DEFINE_bool(store_generated_code, false,
+            "Store the code generated for the title executable in the cache "
+            "directory and reuse it on the next launch instead of translating "
+            "the functions again, reducing stuttering. Stored code is "
+            "discarded when the executable, the host CPU or the CPU settings "
+            "change.",
+            "x64");
+DEFINE_uint32(reservation_granularity_shift, 7,
+              "Log2 of the size of the memory blocks reservations of lwarx "
+              "and ldarx are tracked at, from 2 to 16 (128 bytes, the guest "
+              "cache line size, by default). Smaller blocks reduce spurious "
+              "failures of stwcx. and stdcx. for neighboring variables.",
+              "x64");
+DEFINE_bool(reservation_statistics, false,
+            "Log the number of reserved stores (stwcx. and stdcx.) and of "
+            "the failed ones per guest thread when it exits and in total on "
+            "shutdown.",
+            "x64");
+DEFINE_uint32(x64_shared_sequence_min_size, 32,
+              "Size in bytes from which long instruction sequences, such as "
+              "the emulation of vector shifts by per-element amounts, are "
+              "emitted once on startup and called from the translated "
+              "functions instead of being emitted in every function using "
+              "them, reducing the size of the code cache at the cost of a "
+              "call. 0 to always emit them inline.",
+              "x64");
 #if XE_X64_PROFILER_AVAILABLE == 1
 DECLARE_bool(instrument_call_times);
 #endif
+DECLARE_bool(mxcsr_statistics);
+DECLARE_bool(indirect_call_inline_cache_statistics);
+DECLARE_bool(return_statistics);
+DECLARE_bool(emit_mmio_aware_stores_for_recorded_exception_addresses);
 
 namespace xe {
 namespace cpu {
@@ -65,19 +111,26 @@ class X64HelperEmitter : public X64Emitter {
   GuestToHostThunk EmitGuestToHostThunk();
   ResolveFunctionThunk EmitResolveFunctionThunk();
   void* EmitGuestAndHostSynchronizeStackHelper();
+  // Reconstructs the stackpoints before jumping to sync_func.
+  void* EmitLazyGuestAndHostSynchronizeStackHelper(void* sync_func);
   // 1 for loading byte, 2 for halfword and 4 for word.
   // these specialized versions save space in the caller
   void* EmitGuestAndHostSynchronizeStackSizeLoadThunk(
       void* sync_func, unsigned stack_element_size);
 
-  void* EmitTryAcquireReservationHelper();
-  void* EmitReservedStoreHelper(bool bit64 = false);
+  void* EmitTryAcquireReservationHelper(uint32_t granularity_shift);
+  void* EmitReservedStoreHelper(uint32_t granularity_shift,
+                                bool bit64 = false);
 
   void* EmitScalarVRsqrteHelper();
   void* EmitVectorVRsqrteHelper(void* scalar_helper);
 
   void* EmitFrsqrteHelper();
 
+  // The calling convention is described at X64Backend::GetVectorShiftHelper.
+  void* EmitVectorShiftHelper(VectorShift shift, uint32_t element_size_log2,
+                              uint32_t& body_size_out);
+
  private:
   void* EmitCurrentForOffsets(const _code_offsets& offsets,
                               size_t stack_size = 0);
@@ -136,6 +189,32 @@ X64Backend::X64Backend() : Backend(), code_cache_(nullptr) {
 }
 
 X64Backend::~X64Backend() {
+  if (cvars::indirect_call_inline_cache_statistics) {
+    LogIndirectCallSiteStatistics();
+  }
+  if (cvars::return_statistics) {
+    LogReturnSiteStatistics();
+  }
+  if (cvars::reservation_statistics) {
+    XELOGI("Reserved stores by the exited threads: {}, failed: {}",
+           reserved_store_count_.load(), reserved_store_failure_count_.load());
+  }
+  if (cvars::mxcsr_statistics) {
+    XELOGI("MXCSR mode checks by the exited threads: {}, switches: {}",
+           mxcsr_check_count_.load(), mxcsr_switch_count_.load());
+  }
+  if (shared_sequence_call_count_) {
+    XELOGI("Shared sequence call sites: {}, code size saved: {} bytes",
+           shared_sequence_call_count_.load(),
+           shared_sequence_saved_size_.load());
+  }
+
+  if (reservation_table_) {
+    memory::DeallocFixed(reservation_table_, kReservationTableSize,
+                         memory::DeallocationType::kRelease);
+    reservation_table_ = nullptr;
+  }
+
   if (capstone_handle_) {
     cs_close(&capstone_handle_);
   }
@@ -229,13 +308,9 @@ bool X64Backend::Initialize(Processor* processor) {
     return false;
   }
 
-  // Need movbe to do advanced LOAD/STORE tricks.
-  if (cvars::x64_extension_mask & kX64EmitMovbe) {
-    machine_info_.supports_extended_load_store =
-        cpu.has(Xbyak::util::Cpu::tMOVBE);
-  } else {
-    machine_info_.supports_extended_load_store = false;
-  }
+  // Byte-swapping LOAD/STORE use movbe when available, and a separate bswap
+  // otherwise, which is still no worse than a separate BYTE_SWAP.
+  machine_info_.supports_extended_load_store = true;
 
   auto& gprs = machine_info_.register_sets[0];
   gprs.id = 0;
@@ -271,6 +346,11 @@ bool X64Backend::Initialize(Processor* processor) {
   if (cvars::enable_host_guest_stack_synchronization) {
     synchronize_guest_and_host_stack_helper_ =
         thunk_emitter.EmitGuestAndHostSynchronizeStackHelper();
+    if (cvars::lazy_host_guest_stack_synchronization) {
+      synchronize_guest_and_host_stack_helper_ =
+          thunk_emitter.EmitLazyGuestAndHostSynchronizeStackHelper(
+              synchronize_guest_and_host_stack_helper_);
+    }
 
     synchronize_guest_and_host_stack_helper_size8_ =
         thunk_emitter.EmitGuestAndHostSynchronizeStackSizeLoadThunk(
@@ -282,14 +362,37 @@ bool X64Backend::Initialize(Processor* processor) {
         thunk_emitter.EmitGuestAndHostSynchronizeStackSizeLoadThunk(
             synchronize_guest_and_host_stack_helper_, 4);
   }
+  reservation_granularity_shift_ =
+      std::min(std::max(cvars::reservation_granularity_shift, uint32_t(2)),
+               uint32_t(16));
+  reservation_table_ = reinterpret_cast<ReservationTableEntry*>(
+      xe::memory::AllocFixed(nullptr, kReservationTableSize,
+                             xe::memory::AllocationType::kReserveCommit,
+                             xe::memory::PageAccess::kReadWrite));
+  if (!reservation_table_) {
+    XELOGE("Unable to allocate the reservation table");
+    return false;
+  }
   try_acquire_reservation_helper_ =
-      thunk_emitter.EmitTryAcquireReservationHelper();
-  reserved_store_32_helper = thunk_emitter.EmitReservedStoreHelper(false);
-  reserved_store_64_helper = thunk_emitter.EmitReservedStoreHelper(true);
+      thunk_emitter.EmitTryAcquireReservationHelper(
+          reservation_granularity_shift_);
+  reserved_store_32_helper = thunk_emitter.EmitReservedStoreHelper(
+      reservation_granularity_shift_, false);
+  reserved_store_64_helper = thunk_emitter.EmitReservedStoreHelper(
+      reservation_granularity_shift_, true);
   vrsqrtefp_scalar_helper = thunk_emitter.EmitScalarVRsqrteHelper();
   vrsqrtefp_vector_helper =
       thunk_emitter.EmitVectorVRsqrteHelper(vrsqrtefp_scalar_helper);
   frsqrtefp_helper = thunk_emitter.EmitFrsqrteHelper();
+  for (uint32_t shift = 0; shift < uint32_t(VectorShift::kCount); ++shift) {
+    for (uint32_t element_size_log2 = 0; element_size_log2 < 3;
+         ++element_size_log2) {
+      vector_shift_helpers_[shift][element_size_log2] =
+          thunk_emitter.EmitVectorShiftHelper(
+              VectorShift(shift), element_size_log2,
+              vector_shift_helper_sizes_[shift][element_size_log2]);
+    }
+  }
   // Set the code cache to use the ResolveFunction thunk for default
   // indirections.
   assert_zero(uint64_t(resolve_function_thunk_) & 0xFFFFFFFF00000000ull);
@@ -328,6 +431,223 @@ void X64Backend::CommitExecutableRange(uint32_t guest_low,
   code_cache_->CommitExecutableRange(guest_low, guest_high);
 }
 
+void X64Backend::InitializeCodeStorage(Module* module,
+                                       const std::filesystem::path& path) {
+  if (!cvars::store_generated_code || !module->is_executable() ||
+      code_cache_->has_storage()) {
+    return;
+  }
+  std::filesystem::path parent_path = path.parent_path();
+  if (!std::filesystem::exists(parent_path) &&
+      !std::filesystem::create_directories(parent_path)) {
+    XELOGE("Failed to create the generated code storage directory {}",
+           xe::path_to_utf8(parent_path));
+    return;
+  }
+  code_cache_->OpenStorage(path, CalculateCodeStorageFingerprint());
+}
+
+void X64Backend::UpdateIndirectCallInlineCache(uint8_t* site,
+                                               uint32_t target_address) {
+  auto function = processor()->QueryFunction(target_address);
+  if (!function || !function->is_guest()) {
+    return;
+  }
+  auto x64_function = static_cast<X64Function*>(function);
+  // Baseline code is replaced when the function becomes hot.
+  uint8_t* target_code = x64_function->machine_code();
+  if (!target_code || x64_function->is_baseline()) {
+    return;
+  }
+
+  // Multiple threads may miss at the same site at once.
+  std::lock_guard<std::mutex> lock(indirect_call_inline_cache_lock_);
+  for (uint32_t i = 0; i < X64Emitter::kIndirectCallInlineCacheEntryCount;
+       ++i) {
+    uint8_t* entry = site + i * X64Emitter::kIndirectCallInlineCacheEntrySize;
+    uint32_t entry_address = *reinterpret_cast<volatile uint32_t*>(
+        entry + X64Emitter::kIndirectCallInlineCacheEntryAddressOffset);
+    if (entry_address == target_address) {
+      return;
+    }
+    if (entry_address != X64Emitter::kIndirectCallInlineCacheEmptyEntry) {
+      continue;
+    }
+    int32_t call_displacement = static_cast<int32_t>(
+        target_code -
+        (entry + X64Emitter::kIndirectCallInlineCacheEntryCallEnd));
+    code_cache_->PatchCode(
+        entry + X64Emitter::kIndirectCallInlineCacheEntryCallOffset,
+        &call_displacement, sizeof(call_displacement));
+    code_cache_->PatchCode32(
+        entry + X64Emitter::kIndirectCallInlineCacheEntryAddressOffset,
+        target_address);
+    return;
+  }
+  // Megamorphic - fall through to the indirection table without the helper.
+  code_cache_->PatchCode32(
+      site + X64Emitter::kIndirectCallInlineCacheMissJumpOffset, 0);
+}
+
+IndirectCallSiteStatistics* X64Backend::AllocateIndirectCallSiteStatistics(
+    uint32_t guest_address) {
+  std::lock_guard<std::mutex> lock(indirect_call_site_statistics_lock_);
+  IndirectCallSiteStatistics& statistics =
+      indirect_call_site_statistics_.emplace_back();
+  statistics.calls = 0;
+  statistics.misses = 0;
+  statistics.guest_address = guest_address;
+  return &statistics;
+}
+
+void X64Backend::LogIndirectCallSiteStatistics() {
+  std::lock_guard<std::mutex> lock(indirect_call_site_statistics_lock_);
+  std::vector<const IndirectCallSiteStatistics*> sites;
+  sites.reserve(indirect_call_site_statistics_.size());
+  uint64_t total_calls = 0, total_misses = 0;
+  for (const IndirectCallSiteStatistics& statistics :
+       indirect_call_site_statistics_) {
+    sites.push_back(&statistics);
+    total_calls += statistics.calls;
+    total_misses += statistics.misses;
+  }
+  XELOGI("Indirect calls: {} through {} inline caches, {} missed",
+         total_calls, sites.size(), total_misses);
+  const size_t kLoggedSiteCount = 32;
+  size_t logged_site_count = std::min(sites.size(), kLoggedSiteCount);
+  std::partial_sort(sites.begin(), sites.begin() + logged_site_count,
+                    sites.end(),
+                    [](const IndirectCallSiteStatistics* a,
+                       const IndirectCallSiteStatistics* b) {
+                      return a->calls > b->calls;
+                    });
+  for (size_t i = 0; i < logged_site_count; ++i) {
+    XELOGI("  {:08X}: {} calls, {} missed", sites[i]->guest_address,
+           sites[i]->calls, sites[i]->misses);
+  }
+}
+
+ReturnSiteStatistics* X64Backend::AllocateReturnSiteStatistics(
+    uint32_t guest_address) {
+  std::lock_guard<std::mutex> lock(return_site_statistics_lock_);
+  ReturnSiteStatistics& statistics = return_site_statistics_.emplace_back();
+  statistics.returns = 0;
+  statistics.mismatches = 0;
+  statistics.guest_address = guest_address;
+  return &statistics;
+}
+
+void X64Backend::LogReturnSiteStatistics() {
+  std::lock_guard<std::mutex> lock(return_site_statistics_lock_);
+  std::vector<const ReturnSiteStatistics*> sites;
+  sites.reserve(return_site_statistics_.size());
+  uint64_t total_returns = 0, total_mismatches = 0;
+  for (const ReturnSiteStatistics& statistics : return_site_statistics_) {
+    sites.push_back(&statistics);
+    total_returns += statistics.returns;
+    total_mismatches += statistics.mismatches;
+  }
+  XELOGI("Likely returns: {} through {} sites, {} not to the native caller",
+         total_returns, sites.size(), total_mismatches);
+  const size_t kLoggedSiteCount = 32;
+  size_t logged_site_count = std::min(sites.size(), kLoggedSiteCount);
+  std::partial_sort(
+      sites.begin(), sites.begin() + logged_site_count, sites.end(),
+      [](const ReturnSiteStatistics* a, const ReturnSiteStatistics* b) {
+        return a->mismatches > b->mismatches;
+      });
+  for (size_t i = 0; i < logged_site_count && sites[i]->mismatches; ++i) {
+    XELOGI("  {:08X}: {} returns, {} not to the native caller",
+           sites[i]->guest_address, sites[i]->returns, sites[i]->mismatches);
+  }
+}
+
+bool X64Backend::ShouldCallVectorShiftHelper(
+    VectorShift shift, uint32_t element_size_log2) const {
+  uint32_t min_size = cvars::x64_shared_sequence_min_size;
+  return min_size && GetVectorShiftHelper(shift, element_size_log2) &&
+         vector_shift_helper_sizes_[size_t(shift)][element_size_log2] >=
+             min_size;
+}
+
+void X64Backend::RecordSharedSequenceCall(VectorShift shift,
+                                          uint32_t element_size_log2,
+                                          size_t call_size) {
+  ++shared_sequence_call_count_;
+  shared_sequence_saved_size_ +=
+      int64_t(vector_shift_helper_sizes_[size_t(shift)][element_size_log2]) -
+      int64_t(call_size);
+}
+
+uint64_t X64Backend::CalculateCodeStorageFingerprint() const {
+  XXH3_state_t hash_state;
+  XXH3_64bits_reset(&hash_state);
+
+  uint64_t feature_flags = amd64::GetFeatureFlags();
+  XXH3_64bits_update(&hash_state, &feature_flags, sizeof(feature_flags));
+
+  // Generated code references these directly, so it can only be reused if they
+  // are emitted at the same locations.
+  const uintptr_t code_locations[] = {
+      emitter_data_,
+      uintptr_t(host_to_guest_thunk_),
+      uintptr_t(guest_to_host_thunk_),
+      uintptr_t(resolve_function_thunk_),
+      uintptr_t(synchronize_guest_and_host_stack_helper_),
+      uintptr_t(synchronize_guest_and_host_stack_helper_size8_),
+      uintptr_t(synchronize_guest_and_host_stack_helper_size16_),
+      uintptr_t(synchronize_guest_and_host_stack_helper_size32_),
+      uintptr_t(try_acquire_reservation_helper_),
+      uintptr_t(reserved_store_32_helper),
+      uintptr_t(reserved_store_64_helper),
+      uintptr_t(vrsqrtefp_vector_helper),
+      uintptr_t(vrsqrtefp_scalar_helper),
+      uintptr_t(frsqrtefp_helper),
+      uintptr_t(processor()->memory()->virtual_membase()),
+  };
+  XXH3_64bits_update(&hash_state, code_locations, sizeof(code_locations));
+  XXH3_64bits_update(&hash_state, vector_shift_helpers_,
+                     sizeof(vector_shift_helpers_));
+
+  if (cvar::ConfigVars) {
+    for (const auto& it : *cvar::ConfigVars) {
+      const cvar::IConfigVar* config_var = it.second;
+      if (config_var->category() != "CPU" && config_var->category() != "x64") {
+        continue;
+      }
+      std::string setting =
+          config_var->name() + '=' + config_var->effective_value();
+      // Including the terminator to separate the settings.
+      XXH3_64bits_update(&hash_state, setting.c_str(), setting.size() + 1);
+    }
+  }
+
+  return XXH3_64bits_digest(&hash_state);
+}
+
+void X64Backend::RetireModuleCode(Module* module) {
+  module->ForEachFunction([this](Function* function) {
+    if (!function->is_guest()) {
+      return;
+    }
+    auto x64_function = static_cast<X64Function*>(function);
+    if (x64_function->machine_code()) {
+      code_cache_->RemoveIndirection(function->address());
+      code_cache_->RetireCode(x64_function->machine_code());
+    }
+  });
+  code_cache_->ForgetModule(module);
+}
+
+size_t X64Backend::GetRetiredCodeCount() {
+  return code_cache_->GetRetiredCodeCount();
+}
+
+void X64Backend::ReclaimRetiredCode(
+    size_t retired_count, const std::vector<uint64_t>& live_addresses) {
+  code_cache_->ReclaimRetiredCode(retired_count, live_addresses);
+}
+
 std::unique_ptr<Assembler> X64Backend::CreateAssembler() {
   return std::make_unique<X64Assembler>(this);
 }
@@ -579,8 +899,14 @@ void X64Backend::RecordMMIOExceptionForGuestInstruction(void* host_address) {
         cpu::InfoCacheFlags* icf =
             xex_guest_module->GetInstructionAddressFlags(guestaddr);
 
-        if (icf) {
+        if (icf && !icf->accessed_mmio) {
           icf->accessed_mmio = true;
+          // The access will keep faulting until the function is translated
+          // with the flag taken into account.
+          if (cvars::retranslate_on_mmio_access &&
+              cvars::emit_mmio_aware_stores_for_recorded_exception_addresses) {
+            processor()->RequestFunctionTierUp(fnfor);
+          }
         }
       }
     }
@@ -735,7 +1061,8 @@ GuestToHostThunk X64HelperEmitter::EmitGuestToHostThunk() {
 }
 
 // X64Emitter handles actually resolving functions.
-uint64_t ResolveFunction(void* raw_context, uint64_t target_address);
+uint64_t ResolveFunction(void* raw_context, uint64_t target_address,
+                         uint64_t host_rsp);
 
 ResolveFunctionThunk X64HelperEmitter::EmitResolveFunctionThunk() {
   // ebx = target PPC address
@@ -758,6 +1085,7 @@ ResolveFunctionThunk X64HelperEmitter::EmitResolveFunctionThunk() {
 
   mov(rcx, rsi);  // context
   mov(rdx, rbx);
+  lea(r8, ptr[rsp + stack_size]);  // return address into the caller
   mov(rax, reinterpret_cast<uint64_t>(&ResolveFunction));
   call(rax);
 
@@ -892,6 +1220,31 @@ void* X64HelperEmitter::EmitGuestAndHostSynchronizeStackHelper() {
   return EmitCurrentForOffsets(code_offsets);
 }
 
+// r11 = size of callers stack, r8 = return address w/ adjustment, as for
+// EmitGuestAndHostSynchronizeStackHelper
+void* X64HelperEmitter::EmitLazyGuestAndHostSynchronizeStackHelper(
+    void* sync_func) {
+  _code_offsets code_offsets = {};
+  code_offsets.prolog = getSize();
+  push(r8);
+  push(r11);
+  // The stack is misaligned by the call into the body of the function.
+  sub(rsp, 8);
+  lea(GetNativeParam(0), ptr[rsp + 24]);
+  mov(rcx,
+      reinterpret_cast<uint64_t>(&X64Backend::ReconstructStackpointsThunk));
+  call(backend()->guest_to_host_thunk());
+  add(rsp, 8);
+  pop(r11);
+  pop(r8);
+  jmp(sync_func, T_NEAR);
+  code_offsets.prolog_stack_alloc = getSize();
+  code_offsets.body = getSize();
+  code_offsets.epilog = getSize();
+  code_offsets.tail = getSize();
+  return EmitCurrentForOffsets(code_offsets);
+}
+
 void* X64HelperEmitter::EmitGuestAndHostSynchronizeStackSizeLoadThunk(
     void* sync_func, unsigned stack_element_size) {
   _code_offsets code_offsets = {};
@@ -1347,39 +1700,102 @@ void* X64HelperEmitter::EmitFrsqrteHelper() {
   return EmitCurrentForOffsets(code_offsets);
 }
 
-void* X64HelperEmitter::EmitTryAcquireReservationHelper() {
+void* X64HelperEmitter::EmitVectorShiftHelper(VectorShift shift,
+                                              uint32_t element_size_log2,
+                                              uint32_t& body_size_out) {
   _code_offsets code_offsets = {};
   code_offsets.prolog = getSize();
+  code_offsets.prolog_stack_alloc = getSize();
+  code_offsets.body = getSize();
 
-  Xbyak::Label already_has_a_reservation;
-  Xbyak::Label acquire_new_reservation;
-
-  btr(GetBackendFlagsPtr(), kX64BackendHasReserveBit);
-  mov(r8, GetBackendCtxPtr(offsetof(X64BackendContext, reserve_helper_)));
-  jc(already_has_a_reservation);
+  if (shift == VectorShift::kLeft && !element_size_log2 &&
+      IsFeatureEnabled(kX64EmitAVX2)) {
+    // The same as the inline AVX2 sequence, shifting the bytes as dwords.
+    vpunpckhqdq(xmm2, xmm0, xmm0);
+    vpunpckhqdq(xmm3, xmm1, xmm1);
+    vpmovzxbd(ymm0, xmm0);
+    vpmovzxbd(ymm1, xmm1);
+    vpmovzxbd(ymm2, xmm2);
+    vpmovzxbd(ymm3, xmm3);
+    vpsllvd(ymm0, ymm0, ymm1);
+    vpsllvd(ymm1, ymm2, ymm3);
+    vextracti128(xmm2, ymm0, 1);
+    vextracti128(xmm3, ymm1, 1);
+    vpshufb(xmm0, xmm0, GetXmmConstPtr(XMMIntsToBytes));
+    vpshufb(xmm1, xmm1, GetXmmConstPtr(XMMIntsToBytes));
+    vpshufb(xmm2, xmm2, GetXmmConstPtr(XMMIntsToBytes));
+    vpshufb(xmm3, xmm3, GetXmmConstPtr(XMMIntsToBytes));
+    vpunpckldq(xmm0, xmm0, xmm1);
+    vpunpckldq(xmm2, xmm2, xmm3);
+    vpunpcklqdq(xmm0, xmm0, xmm2);
+  } else {
+    // The scalar loop of the sequences, with the values and the amounts in the
+    // backend context rather than on the stack of the calling function.
+    Xbyak::Address values_ptr =
+        GetBackendCtxPtr(offsetof(X64BackendContext, helper_scratch_xmms[0]));
+    vmovdqa(values_ptr, xmm0);
+    vmovdqa(
+        GetBackendCtxPtr(offsetof(X64BackendContext, helper_scratch_xmms[1])),
+        xmm1);
+    const int values_offset =
+        int(offsetof(X64BackendContext, helper_scratch_xmms[0])) -
+        int(sizeof(X64BackendContext));
+    const int amounts_offset = values_offset + int(sizeof(__m128));
+    const Xbyak::AddressFrame& element =
+        element_size_log2 == 0 ? byte : (element_size_log2 == 1 ? word : dword);
+    Xbyak::Label looper;
+    xor_(edx, edx);
+    L(looper);
+    if (element_size_log2 < 2) {
+      movzx(ecx, element[GetContextReg() + rdx + amounts_offset]);
+    } else {
+      mov(ecx, element[GetContextReg() + rdx + amounts_offset]);
+    }
+    switch (shift) {
+      case VectorShift::kLeft:
+        shl(element[GetContextReg() + rdx + values_offset], cl);
+        break;
+      case VectorShift::kRightLogical:
+        shr(element[GetContextReg() + rdx + values_offset], cl);
+        break;
+      default:
+        sar(element[GetContextReg() + rdx + values_offset], cl);
+        break;
+    }
+    add(edx, 1 << element_size_log2);
+    cmp(edx, 16);
+    jnz(looper);
+    vmovdqa(xmm0, values_ptr);
+  }
+  // Without the return, as the inline sequence doesn't have it.
+  body_size_out = uint32_t(getSize() - code_offsets.body);
+  ret();
 
-  shr(ecx, RESERVE_BLOCK_SHIFT);
-  xor_(r9d, r9d);
-  mov(edx, ecx);
-  shr(edx, 6);  // divide by 64
-  lea(rdx, ptr[r8 + rdx * 8]);
-  and_(ecx, 64 - 1);
+  code_offsets.epilog = getSize();
+  code_offsets.tail = getSize();
+  return EmitCurrentForOffsets(code_offsets);
+}
 
-  lock();
-  bts(qword[rdx], rcx);
-  // set flag on local backend context for thread to indicate our previous
-  // attempt to get the reservation succeeded
-  setnc(r9b);  // success = bitmap did not have a set bit at the idx
-  shl(r9b, kX64BackendHasReserveBit);
+// ecx = guest address
+// rax = host address, preserved
+void* X64HelperEmitter::EmitTryAcquireReservationHelper(
+    uint32_t granularity_shift) {
+  _code_offsets code_offsets = {};
+  code_offsets.prolog = getSize();
 
-  mov(GetBackendCtxPtr(offsetof(X64BackendContext, cached_reserve_offset)),
+  // A new reservation replaces the previous one, if there is any.
+  shr(ecx, granularity_shift);
+  mov(GetBackendCtxPtr(offsetof(X64BackendContext, cached_reserve_granule)),
+      ecx);
+  and_(ecx, (uint32_t(1) << kReservationTableEntryCountLog2) - 1);
+  shl(rcx, kReservationTableEntrySizeLog2);
+  add(rcx, GetBackendCtxPtr(offsetof(X64BackendContext, reservation_table)));
+  // Must be read before the value, which is loaded after returning.
+  mov(rdx, qword[rcx]);
+  mov(GetBackendCtxPtr(offsetof(X64BackendContext, cached_reserve_version)),
       rdx);
-  mov(GetBackendCtxPtr(offsetof(X64BackendContext, cached_reserve_bit)), ecx);
-
-  or_(GetBackendCtxPtr(offsetof(X64BackendContext, flags)), r9d);
+  bts(GetBackendFlagsPtr(), kX64BackendHasReserveBit);
   ret();
-  L(already_has_a_reservation);
-  DebugBreak();
 
   code_offsets.prolog_stack_alloc = getSize();
   code_offsets.body = getSize();
@@ -1387,76 +1803,77 @@ void* X64HelperEmitter::EmitTryAcquireReservationHelper() {
   code_offsets.tail = getSize();
   return EmitCurrentForOffsets(code_offsets);
 }
-// ecx=guest addr
+// ecx = guest addr
 // r9 = host addr
 // r8 = value
-// if ZF is set and CF is set, we succeeded
-void* X64HelperEmitter::EmitReservedStoreHelper(bool bit64) {
+// if ZF is set, we succeeded
+void* X64HelperEmitter::EmitReservedStoreHelper(uint32_t granularity_shift,
+                                                bool bit64) {
   _code_offsets code_offsets = {};
   code_offsets.prolog = getSize();
-  Xbyak::Label done;
-  Xbyak::Label reservation_isnt_for_our_addr;
-  Xbyak::Label somehow_double_cleared;
-  // carry must be set + zero flag must be set
-
-  btr(GetBackendFlagsPtr(), kX64BackendHasReserveBit);
-
-  jnc(done);
+  Xbyak::Label failed, wake_spin_waiters;
 
-  mov(rax, GetBackendCtxPtr(offsetof(X64BackendContext, reserve_helper_)));
+  mov(rdx, GetBackendCtxPtr(offsetof(X64BackendContext, reserved_store_count)));
+  inc(rdx);
+  mov(GetBackendCtxPtr(offsetof(X64BackendContext, reserved_store_count)), rdx);
 
-  shr(ecx, RESERVE_BLOCK_SHIFT);
-  mov(edx, ecx);
-  shr(edx, 6);  // divide by 64
-  lea(rdx, ptr[rax + rdx * 8]);
-  // begin acquiring exclusive access to cacheline containing our bit
-  prefetchw(ptr[rdx]);
-
-  cmp(GetBackendCtxPtr(offsetof(X64BackendContext, cached_reserve_offset)),
-      rdx);
-  jnz(reservation_isnt_for_our_addr);
+  btr(GetBackendFlagsPtr(), kX64BackendHasReserveBit);
+  jnc(failed);
+
+  shr(ecx, granularity_shift);
+  cmp(GetBackendCtxPtr(offsetof(X64BackendContext, cached_reserve_granule)),
+      ecx);
+  jnz(failed);
+  and_(ecx, (uint32_t(1) << kReservationTableEntryCountLog2) - 1);
+  shl(rcx, kReservationTableEntrySizeLog2);
+  add(rcx, GetBackendCtxPtr(offsetof(X64BackendContext, reservation_table)));
+
+  // Claim the granule, failing if a reserved store has been done to it by
+  // another thread since the reserved load. This is done before the store
+  // itself, so a reservation taken in between will be lost either because of
+  // the version or because of the value.
+  mov(rax,
+      GetBackendCtxPtr(offsetof(X64BackendContext, cached_reserve_version)));
+  lea(rdx, ptr[rax + 1]);
+  lock();
+  cmpxchg(qword[rcx], rdx);
+  jnz(failed);
 
+  // Fail if the memory has been modified by a normal store or by the kernel.
   mov(rax,
       GetBackendCtxPtr(offsetof(X64BackendContext, cached_reserve_value_)));
-
-  // we need modulo bitsize, it turns out bittests' modulus behavior for the
-  // bitoffset only applies for register operands, for memory ones we bug out
-  // todo: actually, the above note may not be true, double check it
-  and_(ecx, 64 - 1);
-  cmp(GetBackendCtxPtr(offsetof(X64BackendContext, cached_reserve_bit)), ecx);
-  jnz(reservation_isnt_for_our_addr);
-
-  // was our memory modified by kernel code or something?
   lock();
   if (bit64) {
-    cmpxchg(ptr[r9], r8);
-
+    cmpxchg(qword[r9], r8);
   } else {
-    cmpxchg(ptr[r9], r8d);
+    cmpxchg(dword[r9], r8d);
   }
-  // the ZF flag is unaffected by BTR! we exploit this for the retval
-
-  // cancel our lock on the 65k block
-  lock();
-  btr(qword[rdx], rcx);
-
-  jnc(somehow_double_cleared);
-
-  L(done);
-  // i don't care that theres a dependency on the prev value of rax atm
-  // sadly theres no CF&ZF condition code
-  setz(al);
-  setc(ah);
-  cmp(ax, 0x0101);
+  jnz(failed);
+  // Succeeded, with ZF set by the comparison if there are no spin waiters.
+  cmp(dword[rcx + offsetof(ReservationTableEntry, spin_waiter_count)], 0);
+  jnz(wake_spin_waiters);
   ret();
 
-  // could be the same label, but otherwise we don't know where we came from
-  // when one gets triggered
-  L(reservation_isnt_for_our_addr);
-  DebugBreak();
+  L(wake_spin_waiters);
+  mov(GetNativeParam(0), rcx);
+  mov(rcx, reinterpret_cast<uint64_t>(&X64Backend::WakeSpinWaitersThunk));
+  // Aligning the stack as in the guest code calling the thunk.
+  sub(rsp, 8);
+  call(backend()->guest_to_host_thunk());
+  add(rsp, 8);
+  // Sets ZF.
+  xor_(eax, eax);
+  ret();
 
-  L(somehow_double_cleared);  // somehow, something else cleared our reserve??
-  DebugBreak();
+  L(failed);
+  mov(rdx, GetBackendCtxPtr(
+               offsetof(X64BackendContext, reserved_store_failure_count)));
+  // The incremented counter is not zero, so ZF is cleared by this.
+  inc(rdx);
+  mov(GetBackendCtxPtr(
+          offsetof(X64BackendContext, reserved_store_failure_count)),
+      rdx);
+  ret();
 
   code_offsets.prolog_stack_alloc = getSize();
   code_offsets.body = getSize();
@@ -1582,12 +1999,29 @@ void X64Backend::InitializeBackendContext(void* ctx) {
   bctx->flags = (1U << kX64BackendNJMOn);  // NJM on by default
   // https://media.discordapp.net/attachments/440280035056943104/1000765256643125308/unknown.png
   bctx->Ox1000 = 0x1000;
-  bctx->guest_tick_count = Clock::GetGuestTickCountPointer();
-  bctx->reserve_helper_ = &reserve_helper_;
+  bctx->guest_clock = &Clock::guest_clock_parameters();
+  bctx->reservation_table = reservation_table_;
+  bctx->reserved_store_count = 0;
+  bctx->reserved_store_failure_count = 0;
+  bctx->mxcsr_check_count = 0;
+  bctx->mxcsr_switch_count = 0;
 }
 void X64Backend::DeinitializeBackendContext(void* ctx) {
   X64BackendContext* bctx = BackendContextForGuestContext(ctx);
 
+  reserved_store_count_ += bctx->reserved_store_count;
+  reserved_store_failure_count_ += bctx->reserved_store_failure_count;
+  if (cvars::reservation_statistics && bctx->reserved_store_count) {
+    XELOGI("Reserved stores: {}, failed: {}", bctx->reserved_store_count,
+           bctx->reserved_store_failure_count);
+  }
+  mxcsr_check_count_ += bctx->mxcsr_check_count;
+  mxcsr_switch_count_ += bctx->mxcsr_switch_count;
+  if (cvars::mxcsr_statistics && bctx->mxcsr_check_count) {
+    XELOGI("MXCSR mode checks: {}, switches: {}", bctx->mxcsr_check_count,
+           bctx->mxcsr_switch_count);
+  }
+
   if (bctx->stackpoints) {
     delete[] bctx->stackpoints;
     bctx->stackpoints = nullptr;
@@ -1615,8 +2049,122 @@ void X64Backend::SetGuestRoundingMode(void* ctx, unsigned int mode) {
   ppc_context->fpscr.bits.ni = control >> 2;
 }
 
+void X64Backend::ReconstructStackpoints(void* ctx, uint64_t host_rsp) {
+  X64BackendContext* bctx = BackendContextForGuestContext(ctx);
+  X64BackendStackpoint* stackpoints = bctx->stackpoints;
+  uint32_t count = 0;
+  uint64_t return_address_pointer = host_rsp;
+  while (return_address_pointer &&
+         count < static_cast<uint64_t>(cvars::max_stackpoints)) {
+    uint64_t return_address =
+        *reinterpret_cast<const uint64_t*>(return_address_pointer);
+    if (!code_cache_->LookupFunction(return_address)) {
+      break;
+    }
+    // Guest calls are made with rsp at the start of the frame.
+    uintptr_t frame = uintptr_t(return_address_pointer + 8);
+    X64BackendStackpoint& stackpoint = stackpoints[count++];
+    stackpoint.host_stack_ =
+        frame + *reinterpret_cast<const uint32_t*>(
+                    frame + StackLayout::GUEST_FRAME_SIZE);
+    stackpoint.guest_stack_ = *reinterpret_cast<const uint32_t*>(
+        frame + StackLayout::GUEST_ENTRY_STACK);
+    stackpoint.guest_return_address_ = *reinterpret_cast<const uint32_t*>(
+        frame + StackLayout::GUEST_ENTRY_LR);
+    return_address_pointer = stackpoint.host_stack_;
+  }
+  // Recorded from the outermost frame.
+  std::reverse(stackpoints, stackpoints + count);
+  bctx->current_stackpoint_depth = count;
+}
+
+uint64_t X64Backend::ReconstructStackpointsThunk(void* raw_context,
+                                                 uint64_t host_rsp) {
+  auto guest_context = reinterpret_cast<ppc::PPCContext*>(raw_context);
+  auto backend = static_cast<X64Backend*>(
+      guest_context->thread_state->processor()->backend());
+  backend->ReconstructStackpoints(raw_context, host_rsp);
+  return 0;
+}
+
+uint64_t X64Backend::SpinWaitThunk(void* raw_context, uint64_t guest_address,
+                                   uint64_t value,
+                                   uint64_t load_flags_and_size) {
+  auto guest_context = reinterpret_cast<ppc::PPCContext*>(raw_context);
+  auto backend = static_cast<X64Backend*>(
+      guest_context->thread_state->processor()->backend());
+  uint32_t size = uint32_t(load_flags_and_size >> 8);
+  if (size < 8) {
+    value &= (uint64_t(1) << (size * 8)) - 1;
+  }
+  if (load_flags_and_size & hir::LOAD_STORE_BYTE_SWAP) {
+    value = xe::byte_swap(value) >> (64 - size * 8);
+  }
+  const volatile uint8_t* host_address =
+      guest_context->TranslateVirtual(uint32_t(guest_address));
+  auto changed = [host_address, size, value]() -> bool {
+    switch (size) {
+      case 1:
+        return *host_address != uint8_t(value);
+      case 2:
+        return *reinterpret_cast<const volatile uint16_t*>(host_address) !=
+               uint16_t(value);
+      case 4:
+        return *reinterpret_cast<const volatile uint32_t*>(host_address) !=
+               uint32_t(value);
+      default:
+        return *reinterpret_cast<const volatile uint64_t*>(host_address) !=
+               value;
+    }
+  };
+
+  // Values are often changed soon, before getting to the host waits is worth
+  // it.
+  const uint32_t kSpinCount = 1024;
+  for (uint32_t i = 0; i < kSpinCount; ++i) {
+    if (changed()) {
+      return 0;
+    }
+    _mm_pause();
+  }
+
+  // Normal stores don't wake up the thread, so checking periodically. Also
+  // returning to the guest code after a while, so the thread isn't stuck in
+  // the host if the value is changed by something not noticed here.
+  const auto kCheckInterval = std::chrono::microseconds(100);
+  const auto kMaxWaitDuration = std::chrono::milliseconds(2);
+  uint32_t entry_index =
+      (uint32_t(guest_address) >> backend->reservation_granularity_shift_) &
+      ((uint32_t(1) << kReservationTableEntryCountLog2) - 1);
+  ReservationTableEntry& entry = backend->reservation_table_[entry_index];
+  // Ordered before checking the value, so a reserved store after the check
+  // sees the waiter.
+  entry.spin_waiter_count.fetch_add(1);
+  auto wait_end = std::chrono::steady_clock::now() + kMaxWaitDuration;
+  while (true) {
+    uint32_t wake_count = entry.spin_wake_count.load();
+    if (changed() || std::chrono::steady_clock::now() >= wait_end) {
+      break;
+    }
+    xe::threading::AtomicWait(entry.spin_wake_count, wake_count,
+                              kCheckInterval);
+  }
+  entry.spin_waiter_count.fetch_sub(1);
+  return 0;
+}
+
+uint64_t X64Backend::WakeSpinWaitersThunk(void* raw_context, uint64_t entry) {
+  auto& reservation = *reinterpret_cast<ReservationTableEntry*>(entry);
+  reservation.spin_wake_count.fetch_add(1);
+  xe::threading::AtomicNotifyAll(reservation.spin_wake_count);
+  return 0;
+}
+
 bool X64Backend::PopulatePseudoStacktrace(GuestPseudoStackTrace* st) {
-  if (!cvars::enable_host_guest_stack_synchronization) {
+  // Lazily recorded stackpoints are only valid while the stacks are being
+  // synchronized.
+  if (!cvars::enable_host_guest_stack_synchronization ||
+      cvars::lazy_host_guest_stack_synchronization) {
     return false;
   }
 
@@ -10,9 +10,13 @@
 #ifndef XENIA_CPU_BACKEND_X64_X64_BACKEND_H_
 #define XENIA_CPU_BACKEND_X64_X64_BACKEND_H_
 
+#include <atomic>
+#include <deque>
 #include <memory>
+#include <mutex>
 
 #include "xenia/base/bit_map.h"
+#include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
 #include "xenia/cpu/backend/backend.h"
 
@@ -27,6 +31,7 @@
 DECLARE_int64(x64_extension_mask);
 DECLARE_int64(max_stackpoints);
 DECLARE_bool(enable_host_guest_stack_synchronization);
+DECLARE_bool(lazy_host_guest_stack_synchronization);
 namespace xe {
 class Exception;
 }  // namespace xe
@@ -43,6 +48,14 @@ typedef void* (*HostToGuestThunk)(void* target, void* arg0, void* arg1);
 typedef void* (*GuestToHostThunk)(void* target, void* arg0, void* arg1);
 typedef void (*ResolveFunctionThunk)();
 
+enum class VectorShift : uint32_t {
+  kLeft,
+  kRightLogical,
+  kRightArithmetic,
+
+  kCount,
+};
+
 /*
     place guest trampolines in the memory range that the HV normally occupies.
     This way guests can call in via the indirection table and we don't have to
@@ -57,16 +70,32 @@ static constexpr uint32_t GUEST_TRAMPOLINE_MIN_LEN = 8;
 static constexpr uint32_t MAX_GUEST_TRAMPOLINES =
     (GUEST_TRAMPOLINE_END - GUEST_TRAMPOLINE_BASE) / GUEST_TRAMPOLINE_MIN_LEN;
 
-#define RESERVE_BLOCK_SHIFT 16
-
-#define RESERVE_NUM_ENTRIES \
-  ((1024ULL * 1024ULL * 1024ULL * 4ULL) >> RESERVE_BLOCK_SHIFT)
 // https://codalogic.com/blog/2022/12/06/Exploring-PowerPCs-read-modify-write-operations
-struct ReserveHelper {
-  uint64_t blocks[RESERVE_NUM_ENTRIES / 64];
-
-  ReserveHelper() { memset(blocks, 0, sizeof(blocks)); }
+// Reservations are tracked without locking using a version counter per
+// reservation granule. A reserved store succeeds if no other reserved store to
+// the granule has been done since the reserved load, and the value in memory is
+// still the loaded one. Granules are hashed into a fixed-size table, so
+// unrelated granules may share a counter (and the mirrors of physical memory
+// always do), which may only cause spurious reservation losses.
+// Spin waits (OPCODE_SPIN_WAIT) for memory in a granule are woken up by the
+// reserved stores to it, with the cost of checking the waiter count only paid
+// by the reserved stores.
+constexpr uint32_t kReservationTableEntryCountLog2 = 16;
+constexpr uint32_t kReservationTableEntrySizeLog2 = 6;
+struct alignas(64) ReservationTableEntry {
+  // Each entry takes a whole host cache line so reserved stores to different
+  // granules don't contend.
+  uint64_t version;
+  std::atomic<uint32_t> spin_waiter_count;
+  // Incremented before waking up the spin waiters.
+  std::atomic<uint32_t> spin_wake_count;
+  uint8_t padding[(1 << kReservationTableEntrySizeLog2) - sizeof(uint64_t) -
+                  sizeof(uint32_t) * 2];
 };
+static_assert(sizeof(ReservationTableEntry) ==
+              (1 << kReservationTableEntrySizeLog2));
+constexpr size_t kReservationTableSize = sizeof(ReservationTableEntry)
+                                         << kReservationTableEntryCountLog2;
 
 struct X64BackendStackpoint {
   uint64_t host_stack_;
@@ -89,19 +118,30 @@ enum : uint32_t {
 // context (somehow placing a global X64BackendCtx prior to membase, so we can
 // negatively index the membase reg)
 struct X64BackendContext {
+  // Dynamic checks of the MXCSR mode and switches between the FPU and the VMX
+  // values done by the thread, counted with mxcsr_statistics. Placed first for
+  // the same reason as the reserved store counters.
+  uint64_t mxcsr_check_count;
+  uint64_t mxcsr_switch_count;
+  // Reserved stores (stwcx. and stdcx.) done by the thread and how many of them
+  // have failed. Placed first so adding them doesn't move the other fields
+  // further away from the context register.
+  uint64_t reserved_store_count;
+  uint64_t reserved_store_failure_count;
   union {
     __m128 helper_scratch_xmms[4];
     uint64_t helper_scratch_u64s[8];
     uint32_t helper_scratch_u32s[16];
   };
-  ReserveHelper* reserve_helper_;
+  ReservationTableEntry* reservation_table;
   uint64_t cached_reserve_value_;
-  // guest_tick_count is used if inline_loadclock is used
-  uint64_t* guest_tick_count;
+  // Read by the inline guest clock queries of inline_loadclock.
+  const Clock::GuestClockParameters* guest_clock;
   // records mapping of host_stack to guest_stack
   X64BackendStackpoint* stackpoints;
-  uint64_t cached_reserve_offset;
-  uint32_t cached_reserve_bit;
+  uint64_t cached_reserve_version;
+  // Guest address of the reservation shifted by the granularity.
+  uint32_t cached_reserve_granule;
   unsigned int current_stackpoint_depth;
   unsigned int mxcsr_fpu;  // currently, the way we implement rounding mode
                            // affects both vmx and the fpu
@@ -118,6 +158,25 @@ constexpr unsigned int DEFAULT_VMX_MXCSR =
 
 constexpr unsigned int DEFAULT_FPU_MXCSR = 0x1F80;
 extern const uint32_t mxcsr_table[8];
+// Counters of an indirect call site with an inline cache, collected with
+// indirect_call_inline_cache_statistics.
+struct IndirectCallSiteStatistics {
+  uint64_t calls;
+  // Calls made through the indirection table rather than the cache.
+  uint64_t misses;
+  uint32_t guest_address;
+};
+
+// Counters of a likely guest function return site, collected with
+// return_statistics.
+struct ReturnSiteStatistics {
+  uint64_t returns;
+  // Indirect branches taken because the link register was not the return
+  // address of the native call.
+  uint64_t mismatches;
+  uint32_t guest_address;
+};
+
 class X64Backend : public Backend {
  public:
   static const uint32_t kForceReturnAddress = 0x9FFF0000u;
@@ -154,6 +213,14 @@ class X64Backend : public Backend {
 
   void CommitExecutableRange(uint32_t guest_low, uint32_t guest_high) override;
 
+  void InitializeCodeStorage(Module* module,
+                             const std::filesystem::path& path) override;
+
+  void RetireModuleCode(Module* module) override;
+  size_t GetRetiredCodeCount() override;
+  void ReclaimRetiredCode(size_t retired_count,
+                          const std::vector<uint64_t>& live_addresses) override;
+
   std::unique_ptr<Assembler> CreateAssembler() override;
 
   std::unique_ptr<GuestFunction> CreateGuestFunction(Module* module,
@@ -190,7 +257,61 @@ class X64Backend : public Backend {
 #if XE_X64_PROFILER_AVAILABLE == 1
   uint64_t* GetProfilerRecordForFunction(uint32_t guest_address);
 #endif
+
+  // Adds the target to the inline cache of an indirect call site emitted by
+  // X64Emitter, or makes the site call only through the indirection table if
+  // all its entries are used. The target is cached only when it has final
+  // code already.
+  void UpdateIndirectCallInlineCache(uint8_t* site, uint32_t target_address);
+  // The returned counters stay valid for the lifetime of the backend.
+  IndirectCallSiteStatistics* AllocateIndirectCallSiteStatistics(
+      uint32_t guest_address);
+  ReturnSiteStatistics* AllocateReturnSiteStatistics(uint32_t guest_address);
+
+  // With lazy_host_guest_stack_synchronization, rebuilds the stackpoints of the
+  // thread from the frames of the guest functions, host_rsp pointing to the
+  // return address into the innermost one. The chain ends at the first return
+  // address not in guest code, such as the one into the host to guest thunk.
+  void ReconstructStackpoints(void* ctx, uint64_t host_rsp);
+  // For calling ReconstructStackpoints through the guest to host thunk.
+  static uint64_t ReconstructStackpointsThunk(void* raw_context,
+                                              uint64_t host_rsp);
+
+  // OPCODE_SPIN_WAIT, called through the guest to host thunk with the loaded
+  // value and the load flags and the size of the value in bytes shifted left by
+  // 8.
+  static uint64_t SpinWaitThunk(void* raw_context, uint64_t guest_address,
+                                uint64_t value, uint64_t load_flags_and_size);
+  // Called by the reserved store helpers for the reservation table entry with
+  // spin waiters.
+  static uint64_t WakeSpinWaitersThunk(void* raw_context, uint64_t entry);
+
+  // Shared out-of-line emulation of the vector shifts by per-element amounts,
+  // for the element size log2 from 0 (bytes) to 2 (dwords), called instead of
+  // emitting the sequence in every function if the sequence takes at least
+  // x64_shared_sequence_min_size bytes. Takes the values in xmm0 and the
+  // amounts in xmm1, and returns the result in xmm0, clobbering xmm1 to xmm3,
+  // rcx and rdx.
+  void* GetVectorShiftHelper(VectorShift shift,
+                             uint32_t element_size_log2) const {
+    return vector_shift_helpers_[size_t(shift)][element_size_log2];
+  }
+  bool ShouldCallVectorShiftHelper(VectorShift shift,
+                                   uint32_t element_size_log2) const;
+  // For the statistics logged on shutdown - the size of the emitted call site
+  // including moving the operands and the result.
+  void RecordSharedSequenceCall(VectorShift shift, uint32_t element_size_log2,
+                                size_t call_size);
+
  private:
+  // Identifies everything stored code depends on besides the guest code and
+  // the translation passes - host features, the location of the thunks and
+  // constants it references, and the settings affecting the emitted code.
+  uint64_t CalculateCodeStorageFingerprint() const;
+
+  void LogIndirectCallSiteStatistics();
+  void LogReturnSiteStatistics();
+
   static bool ExceptionCallbackThunk(Exception* ex, void* data);
   bool ExceptionCallback(Exception* ex);
 
@@ -218,16 +339,34 @@ class X64Backend : public Backend {
   void* frsqrtefp_helper = nullptr;
 
  private:
+  void* vector_shift_helpers_[size_t(VectorShift::kCount)][3] = {};
+  uint32_t vector_shift_helper_sizes_[size_t(VectorShift::kCount)][3] = {};
 #if XE_X64_PROFILER_AVAILABLE == 1
   GuestProfilerData profiler_data_;
 #endif
 
-  alignas(64) ReserveHelper reserve_helper_;
+  uint32_t reservation_granularity_shift_ = 7;
+  ReservationTableEntry* reservation_table_ = nullptr;
+  // Totals of the counters of the exited threads.
+  std::atomic<uint64_t> reserved_store_count_{0};
+  std::atomic<uint64_t> reserved_store_failure_count_{0};
+  std::atomic<uint64_t> mxcsr_check_count_{0};
+  std::atomic<uint64_t> mxcsr_switch_count_{0};
+  // Call sites of the shared sequences, and the code size they have saved
+  // compared to emitting the sequences inline.
+  std::atomic<uint64_t> shared_sequence_call_count_{0};
+  std::atomic<int64_t> shared_sequence_saved_size_{0};
   // allocates 8-byte aligned addresses in a normally not executable guest
   // address
   // range that will be used to dispatch to host code
   BitMap guest_trampoline_address_bitmap_;
   uint8_t* guest_trampoline_memory_;
+
+  std::mutex indirect_call_inline_cache_lock_;
+  std::mutex indirect_call_site_statistics_lock_;
+  std::deque<IndirectCallSiteStatistics> indirect_call_site_statistics_;
+  std::mutex return_site_statistics_lock_;
+  std::deque<ReturnSiteStatistics> return_site_statistics_;
 };
 
 }  // namespace x64
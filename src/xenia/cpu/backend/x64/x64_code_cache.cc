@@ -9,9 +9,16 @@
 
 #include "xenia/cpu/backend/x64/x64_code_cache.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 
+#include "xenia/base/platform.h"
+
+#if XE_PLATFORM_LINUX
+#include <unistd.h>
+#endif
+
 #if ENABLE_VTUNE
 #include "third_party/vtune/include/jitprofiling.h"
 #pragma comment(lib, "../third_party/vtune/lib64/jitprofiling.lib")
@@ -20,13 +27,22 @@
 #include "third_party/fmt/include/fmt/format.h"
 #include "xenia/base/assert.h"
 #include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/memory.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/cpu/function.h"
 #include "xenia/cpu/module.h"
 
+DEFINE_bool(perf_map, false,
+            "Write the symbols of the generated code to /tmp/perf-<pid>.map "
+            "for attributing the samples in it to guest functions in Linux "
+            "perf.",
+            "x64");
+
 namespace xe {
 namespace cpu {
 namespace backend {
@@ -34,9 +50,66 @@ namespace x64 {
 
 using namespace xe::literals;
 
+namespace {
+
+// 'XJIT'.
+constexpr uint32_t kStorageMagic = 0x54494A58;
+// Increment when the storage layout or the code generation changes in a way not
+// covered by the fingerprints.
+constexpr uint32_t kStorageVersion = 3;
+
+struct StorageFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t fingerprint;
+  // Address of a function in the host executable in the process the code was
+  // stored by, for rebasing the image relocations.
+  uint64_t image_anchor;
+};
+
+struct StoredFunctionHeader {
+  uint32_t guest_address;
+  // Offset of the code from the generated code base.
+  uint32_t code_offset;
+  uint64_t pipeline_fingerprint;
+  EmitFunctionInfo func_info;
+  uint32_t image_relocation_count;
+  uint32_t source_map_count;
+  // Hash of the code, the relocations and the source map, for validating file
+  // integrity.
+  uint64_t data_hash;
+};
+
+uint64_t GetStorageImageAnchor() {
+  return uint64_t(reinterpret_cast<uintptr_t>(&X64CodeCache::Create));
+}
+
+uint64_t HashStoredFunctionData(
+    const void* code, size_t code_size,
+    const std::vector<ImageRelocation>& image_relocations,
+    const std::vector<SourceMapEntry>& source_map) {
+  XXH3_state_t hash_state;
+  XXH3_64bits_reset(&hash_state);
+  XXH3_64bits_update(&hash_state, code, code_size);
+  XXH3_64bits_update(&hash_state, image_relocations.data(),
+                     sizeof(ImageRelocation) * image_relocations.size());
+  XXH3_64bits_update(&hash_state, source_map.data(),
+                     sizeof(SourceMapEntry) * source_map.size());
+  return XXH3_64bits_digest(&hash_state);
+}
+
+}  // namespace
+
 X64CodeCache::X64CodeCache() = default;
 
 X64CodeCache::~X64CodeCache() {
+  CloseStorage();
+
+  if (perf_map_file_) {
+    std::fclose(perf_map_file_);
+    perf_map_file_ = nullptr;
+  }
+
   if (indirection_table_base_) {
     xe::memory::DeallocFixed(indirection_table_base_, 0,
                              xe::memory::DeallocationType::kRelease);
@@ -123,9 +196,44 @@ bool X64CodeCache::Initialize() {
   // Preallocate the function map to a large, reasonable size.
   generated_code_map_.reserve(kMaximumFunctionCount);
 
+#if XE_PLATFORM_LINUX
+  if (cvars::perf_map) {
+    std::string perf_map_path = fmt::format("/tmp/perf-{}.map", getpid());
+    perf_map_file_ = std::fopen(perf_map_path.c_str(), "w");
+    if (!perf_map_file_) {
+      XELOGE("Failed to open {} for writing generated code symbols",
+             perf_map_path);
+    }
+  }
+#endif  // XE_PLATFORM_LINUX
+
   return true;
 }
 
+void X64CodeCache::CommitGeneratedCode(size_t high_mark) {
+  // It's ok if multiple threads do this, as redundant commits aren't harmful.
+  size_t old_commit_mark, new_commit_mark;
+  do {
+    old_commit_mark = generated_code_commit_mark_;
+    if (high_mark <= old_commit_mark) break;
+
+    new_commit_mark = old_commit_mark + 16_MiB;
+    if (generated_code_execute_base_ == generated_code_write_base_) {
+      xe::memory::AllocFixed(generated_code_execute_base_, new_commit_mark,
+                             xe::memory::AllocationType::kCommit,
+                             xe::memory::PageAccess::kExecuteReadWrite);
+    } else {
+      xe::memory::AllocFixed(generated_code_execute_base_, new_commit_mark,
+                             xe::memory::AllocationType::kCommit,
+                             xe::memory::PageAccess::kExecuteReadOnly);
+      xe::memory::AllocFixed(generated_code_write_base_, new_commit_mark,
+                             xe::memory::AllocationType::kCommit,
+                             xe::memory::PageAccess::kReadWrite);
+    }
+  } while (generated_code_commit_mark_.compare_exchange_weak(old_commit_mark,
+                                                             new_commit_mark));
+}
+
 void X64CodeCache::set_indirection_default(uint32_t default_value) {
   indirection_default_value_ = default_value;
 }
@@ -168,6 +276,8 @@ void X64CodeCache::PlaceHostCode(uint32_t guest_address, void* machine_code,
   // we only want to place guest code in a serialized cache on disk.
   PlaceGuestCode(guest_address, machine_code, func_info, nullptr,
                  code_execute_address_out, code_write_address_out);
+  RegisterCodeSymbol(guest_address, nullptr, code_execute_address_out,
+                     func_info.code_size.total);
 }
 
 void X64CodeCache::PlaceGuestCode(uint32_t guest_address, void* machine_code,
@@ -184,67 +294,77 @@ void X64CodeCache::PlaceGuestCode(uint32_t guest_address, void* machine_code,
   {
     auto global_lock = global_critical_region_.Acquire();
 
-    low_mark = generated_code_offset_;
-
-    // Reserve code.
-    // Always move the code to land on 16b alignment.
-    code_execute_address =
-        generated_code_execute_base_ + generated_code_offset_;
+    size_t code_size = xe::round_up(func_info.code_size.total, 16);
+    uint8_t* code_write_address;
+    uint8_t* tail_write_address;
+    uint8_t* end_write_address;
+    auto free_block = free_code_blocks_.lower_bound(
+        code_size + xe::round_up(unwind_reservation_size(), 16));
+    if (free_block != free_code_blocks_.end()) {
+      // Reuse reclaimed space, keeping its entry in the map and the unwind
+      // table, so they stay sorted.
+      CodeBlock block = free_block->second;
+      free_code_blocks_.erase(free_block);
+      free_code_size_ -= block.size;
+
+      low_mark = block.offset;
+      code_execute_address = generated_code_execute_base_ + block.offset;
+      code_write_address = generated_code_write_base_ + block.offset;
+      tail_write_address = code_write_address + code_size;
+      unwind_reservation =
+          ReuseUnwindReservation(tail_write_address, block.map_index);
+      end_write_address =
+          tail_write_address + xe::round_up(unwind_reservation.data_size, 16);
+      high_mark = size_t(end_write_address - generated_code_write_base_);
+
+      generated_code_map_[block.map_index] = std::make_pair(
+          (uint64_t(block.offset) << 32) | high_mark, function_info);
+      if (high_mark - block.offset < block.size) {
+        reused_code_block_sizes_[block.map_index] = block.size;
+      }
+    } else {
+      low_mark = generated_code_offset_;
+
+      // Reserve code.
+      // Always move the code to land on 16b alignment.
+      code_execute_address =
+          generated_code_execute_base_ + generated_code_offset_;
+      code_write_address = generated_code_write_base_ + generated_code_offset_;
+      generated_code_offset_ += code_size;
+
+      tail_write_address = generated_code_write_base_ + generated_code_offset_;
+
+      // Reserve unwind info.
+      // We go on the high size of the unwind info as we don't know how big we
+      // need it, and a few extra bytes of padding isn't the worst thing.
+      unwind_reservation = RequestUnwindReservation(generated_code_write_base_ +
+                                                    generated_code_offset_);
+      assert_true(!unwind_reservation.data_size ||
+                  unwind_reservation.table_slot == generated_code_map_.size());
+      generated_code_offset_ += xe::round_up(unwind_reservation.data_size, 16);
+
+      end_write_address = generated_code_write_base_ + generated_code_offset_;
+
+      high_mark = generated_code_offset_;
+
+      // Store in map. It is maintained in sorted order of host PC dependent on
+      // us also being append-only.
+      generated_code_map_.emplace_back(
+          (uint64_t(code_execute_address - generated_code_execute_base_)
+           << 32) |
+              generated_code_offset_,
+          function_info);
+
+      // TODO(DrChat): The following code doesn't really need to be under the
+      // global lock except for PlaceCode (but it depends on the previous code
+      // already being ran)
+
+      // If we are going above the high water mark of committed memory, commit
+      // some more.
+      CommitGeneratedCode(high_mark);
+    }
     code_execute_address_out = code_execute_address;
-    uint8_t* code_write_address =
-        generated_code_write_base_ + generated_code_offset_;
     code_write_address_out = code_write_address;
-    generated_code_offset_ += xe::round_up(func_info.code_size.total, 16);
-
-    auto tail_write_address =
-        generated_code_write_base_ + generated_code_offset_;
-
-    // Reserve unwind info.
-    // We go on the high size of the unwind info as we don't know how big we
-    // need it, and a few extra bytes of padding isn't the worst thing.
-    unwind_reservation = RequestUnwindReservation(generated_code_write_base_ +
-                                                  generated_code_offset_);
-    generated_code_offset_ += xe::round_up(unwind_reservation.data_size, 16);
-
-    auto end_write_address =
-        generated_code_write_base_ + generated_code_offset_;
-
-    high_mark = generated_code_offset_;
-
-    // Store in map. It is maintained in sorted order of host PC dependent on
-    // us also being append-only.
-    generated_code_map_.emplace_back(
-        (uint64_t(code_execute_address - generated_code_execute_base_) << 32) |
-            generated_code_offset_,
-        function_info);
-
-    // TODO(DrChat): The following code doesn't really need to be under the
-    // global lock except for PlaceCode (but it depends on the previous code
-    // already being ran)
-
-    // If we are going above the high water mark of committed memory, commit
-    // some more. It's ok if multiple threads do this, as redundant commits
-    // aren't harmful.
-    size_t old_commit_mark, new_commit_mark;
-    do {
-      old_commit_mark = generated_code_commit_mark_;
-      if (high_mark <= old_commit_mark) break;
-
-      new_commit_mark = old_commit_mark + 16_MiB;
-      if (generated_code_execute_base_ == generated_code_write_base_) {
-        xe::memory::AllocFixed(generated_code_execute_base_, new_commit_mark,
-                               xe::memory::AllocationType::kCommit,
-                               xe::memory::PageAccess::kExecuteReadWrite);
-      } else {
-        xe::memory::AllocFixed(generated_code_execute_base_, new_commit_mark,
-                               xe::memory::AllocationType::kCommit,
-                               xe::memory::PageAccess::kExecuteReadOnly);
-        xe::memory::AllocFixed(generated_code_write_base_, new_commit_mark,
-                               xe::memory::AllocationType::kCommit,
-                               xe::memory::PageAccess::kReadWrite);
-      }
-    } while (generated_code_commit_mark_.compare_exchange_weak(
-        old_commit_mark, new_commit_mark));
 
     // Copy code.
     std::memcpy(code_write_address, machine_code, func_info.code_size.total);
@@ -258,35 +378,74 @@ void X64CodeCache::PlaceGuestCode(uint32_t guest_address, void* machine_code,
               unwind_reservation);
   }
 
+  if (function_info) {
+    RegisterCodeSymbol(guest_address, function_info, code_execute_address,
+                       func_info.code_size.total);
+  }
+
+  // Now that everything is ready, fix up the indirection table.
+  // Note that we do support code that doesn't have an indirection fixup, so
+  // ignore those when we see them.
+  if (guest_address && indirection_table_base_) {
+    uint32_t* indirection_slot = reinterpret_cast<uint32_t*>(
+        indirection_table_base_ + (guest_address - kIndirectionTableBase));
+    *indirection_slot =
+        uint32_t(reinterpret_cast<uint64_t>(code_execute_address));
+  }
+}
+
+void X64CodeCache::RegisterCodeSymbol(uint32_t guest_address,
+                                      GuestFunction* function,
+                                      const void* code_execute_address,
+                                      size_t code_size) {
+  bool vtune_active = false;
 #if ENABLE_VTUNE
-  if (iJIT_IsProfilingActive() == iJIT_SAMPLING_ON) {
-    std::string method_name;
-    if (function_info && function_info->name().size() != 0) {
-      method_name = function_info->name();
+  vtune_active = iJIT_IsProfilingActive() == iJIT_SAMPLING_ON;
+#endif
+  if (!vtune_active && !perf_map_file_) {
+    return;
+  }
+
+  // Tools only see the host addresses, so the name includes the guest address
+  // even when the function has a symbol name from the module.
+  std::string symbol_name;
+  if (function) {
+    if (function->name().empty()) {
+      symbol_name = fmt::format("sub_{:08X}", guest_address);
     } else {
-      method_name = xe::format_string("sub_%.8X", guest_address);
+      symbol_name = fmt::format("{} [{:08X}]", function->name(), guest_address);
     }
+  } else {
+    symbol_name = fmt::format("xe_host_code_{:08X}",
+                              uint32_t(reinterpret_cast<uintptr_t>(
+                                  code_execute_address)));
+  }
 
+#if ENABLE_VTUNE
+  if (vtune_active) {
     iJIT_Method_Load_V2 method = {0};
     method.method_id = iJIT_GetNewMethodID();
-    method.method_load_address = code_execute_address;
+    method.method_load_address = const_cast<void*>(code_execute_address);
     method.method_size = uint32_t(code_size);
-    method.method_name = const_cast<char*>(method_name.data());
-    method.module_name = function_info
-                             ? (char*)function_info->module()->name().c_str()
-                             : nullptr;
+    method.method_name = const_cast<char*>(symbol_name.c_str());
+    method.module_name =
+        function ? const_cast<char*>(function->module()->name().c_str())
+                 : nullptr;
     iJIT_NotifyEvent(iJVM_EVENT_TYPE_METHOD_LOAD_FINISHED_V2, (void*)&method);
   }
 #endif
 
-  // Now that everything is ready, fix up the indirection table.
-  // Note that we do support code that doesn't have an indirection fixup, so
-  // ignore those when we see them.
-  if (guest_address && indirection_table_base_) {
-    uint32_t* indirection_slot = reinterpret_cast<uint32_t*>(
-        indirection_table_base_ + (guest_address - kIndirectionTableBase));
-    *indirection_slot =
-        uint32_t(reinterpret_cast<uint64_t>(code_execute_address));
+  if (perf_map_file_) {
+    if (function) {
+      symbol_name = function->module()->name() + '!' + symbol_name;
+    }
+    std::lock_guard<std::mutex> perf_map_lock(perf_map_mutex_);
+    // Flushed immediately, as perf reads the map when the report is made,
+    // possibly while the emulator is still running or after it has crashed.
+    fmt::print(perf_map_file_, "{:x} {:x} {}\n",
+               reinterpret_cast<uintptr_t>(code_execute_address), code_size,
+               symbol_name);
+    std::fflush(perf_map_file_);
   }
 }
 
@@ -306,28 +465,8 @@ uint32_t X64CodeCache::PlaceData(const void* data, size_t length) {
   }
 
   // If we are going above the high water mark of committed memory, commit some
-  // more. It's ok if multiple threads do this, as redundant commits aren't
-  // harmful.
-  size_t old_commit_mark, new_commit_mark;
-  do {
-    old_commit_mark = generated_code_commit_mark_;
-    if (high_mark <= old_commit_mark) break;
-
-    new_commit_mark = old_commit_mark + 16_MiB;
-    if (generated_code_execute_base_ == generated_code_write_base_) {
-      xe::memory::AllocFixed(generated_code_execute_base_, new_commit_mark,
-                             xe::memory::AllocationType::kCommit,
-                             xe::memory::PageAccess::kExecuteReadWrite);
-    } else {
-      xe::memory::AllocFixed(generated_code_execute_base_, new_commit_mark,
-                             xe::memory::AllocationType::kCommit,
-                             xe::memory::PageAccess::kExecuteReadOnly);
-      xe::memory::AllocFixed(generated_code_write_base_, new_commit_mark,
-                             xe::memory::AllocationType::kCommit,
-                             xe::memory::PageAccess::kReadWrite);
-    }
-  } while (generated_code_commit_mark_.compare_exchange_weak(old_commit_mark,
-                                                             new_commit_mark));
+  // more.
+  CommitGeneratedCode(high_mark);
 
   // Copy code.
   std::memcpy(data_address, data, length);
@@ -335,6 +474,378 @@ uint32_t X64CodeCache::PlaceData(const void* data, size_t length) {
   return uint32_t(uintptr_t(data_address));
 }
 
+bool X64CodeCache::PlaceCodeGap(size_t new_offset) {
+  auto global_lock = global_critical_region_.Acquire();
+  size_t old_offset = generated_code_offset_;
+  if (new_offset < old_offset) {
+    return false;
+  }
+  generated_code_offset_ = new_offset;
+  CommitGeneratedCode(new_offset);
+  std::memset(generated_code_write_base_ + old_offset, 0xCC,
+              new_offset - old_offset);
+  return true;
+}
+
+void X64CodeCache::PatchCode(void* code_execute_address, const void* data,
+                             size_t size) {
+  size_t offset = reinterpret_cast<uint8_t*>(code_execute_address) -
+                  generated_code_execute_base_;
+  assert_true(offset + size <= kGeneratedCodeSize);
+  std::memcpy(generated_code_write_base_ + offset, data, size);
+}
+
+void X64CodeCache::PatchCode32(void* code_execute_address, uint32_t value) {
+  size_t offset = reinterpret_cast<uint8_t*>(code_execute_address) -
+                  generated_code_execute_base_;
+  assert_zero(offset & 3);
+  assert_true(offset + sizeof(value) <= kGeneratedCodeSize);
+  *reinterpret_cast<volatile uint32_t*>(generated_code_write_base_ + offset) =
+      value;
+}
+
+void X64CodeCache::RemoveIndirection(uint32_t guest_address) {
+  AddIndirection(guest_address, indirection_default_value_);
+}
+
+void X64CodeCache::RetireCode(void* code_execute_address) {
+  auto global_lock = global_critical_region_.Acquire();
+  if (has_storage()) {
+    return;
+  }
+  size_t offset = size_t(reinterpret_cast<uint8_t*>(code_execute_address) -
+                         generated_code_execute_base_);
+  uint64_t key = uint64_t(offset) << 32;
+  auto it = std::lower_bound(
+      generated_code_map_.begin(), generated_code_map_.end(), key,
+      [](const std::pair<uint64_t, GuestFunction*>& element, uint64_t key) {
+        return element.first < key;
+      });
+  if (it == generated_code_map_.end() || (it->first >> 32) != offset) {
+    return;
+  }
+  CodeBlock block;
+  block.offset = offset;
+  block.map_index = size_t(it - generated_code_map_.begin());
+  auto reused_size_it = reused_code_block_sizes_.find(block.map_index);
+  if (reused_size_it != reused_code_block_sizes_.end()) {
+    block.size = reused_size_it->second;
+    reused_code_block_sizes_.erase(reused_size_it);
+  } else {
+    block.size = size_t(uint32_t(it->first)) - offset;
+  }
+  retired_code_blocks_.push_back(block);
+  retired_code_size_ += block.size;
+}
+
+void X64CodeCache::ForgetModule(Module* module) {
+  auto global_lock = global_critical_region_.Acquire();
+  for (const CodeBlock& block : retired_code_blocks_) {
+    auto& map_entry = generated_code_map_[block.map_index];
+    if (map_entry.second && map_entry.second->module() == module) {
+      map_entry.second = nullptr;
+    }
+  }
+}
+
+size_t X64CodeCache::GetRetiredCodeCount() {
+  auto global_lock = global_critical_region_.Acquire();
+  return retired_code_blocks_.size();
+}
+
+void X64CodeCache::ReclaimRetiredCode(
+    size_t retired_count, const std::vector<uint64_t>& live_addresses) {
+  std::vector<uint64_t> sorted_live_addresses(live_addresses);
+  std::sort(sorted_live_addresses.begin(), sorted_live_addresses.end());
+  auto global_lock = global_critical_region_.Acquire();
+  retired_count = std::min(retired_count, retired_code_blocks_.size());
+  size_t reclaimed_count = 0;
+  size_t reclaimed_size = 0;
+  size_t kept_count = 0;
+  for (size_t i = 0; i < retired_count; ++i) {
+    const CodeBlock& block = retired_code_blocks_[i];
+    uint64_t block_start =
+        uint64_t(reinterpret_cast<uintptr_t>(generated_code_execute_base_)) +
+        block.offset;
+    uint64_t block_end = block_start + block.size;
+    auto live_it = std::lower_bound(sorted_live_addresses.cbegin(),
+                                    sorted_live_addresses.cend(), block_start);
+    if (live_it != sorted_live_addresses.cend() && *live_it < block_end) {
+      retired_code_blocks_[kept_count++] = block;
+      continue;
+    }
+    // Trap if anything still jumps into it.
+    std::memset(generated_code_write_base_ + block.offset, 0xCC, block.size);
+    generated_code_map_[block.map_index].second = nullptr;
+    free_code_blocks_.emplace(block.size, block);
+    free_code_size_ += block.size;
+    retired_code_size_ -= block.size;
+    ++reclaimed_count;
+    reclaimed_size += block.size;
+  }
+  retired_code_blocks_.erase(retired_code_blocks_.begin() + kept_count,
+                             retired_code_blocks_.begin() + retired_count);
+  XELOGI(
+      "Reclaimed {} generated code blocks ({} bytes), {} still in use ({} "
+      "bytes); {} free blocks ({} bytes, largest {} bytes), {} bytes placed "
+      "in total",
+      reclaimed_count, reclaimed_size, retired_code_blocks_.size(),
+      retired_code_size_, free_code_blocks_.size(), free_code_size_,
+      free_code_blocks_.empty() ? size_t(0)
+                                : free_code_blocks_.rbegin()->first,
+      generated_code_offset_);
+}
+
+bool X64CodeCache::OpenStorage(const std::filesystem::path& path,
+                               uint64_t fingerprint) {
+  {
+    std::lock_guard<std::mutex> storage_lock(storage_mutex_);
+    if (storage_file_) {
+      return false;
+    }
+  }
+
+  FILE* file = xe::filesystem::OpenFile(path, "a+b");
+  if (!file) {
+    XELOGE(
+        "Failed to open the code storage file for writing, generated code "
+        "will not be stored: {}",
+        xe::path_to_utf8(path));
+    return false;
+  }
+
+  // The file is not published until loading is done, so placing the code,
+  // which needs the global critical region, isn't done with the storage lock
+  // held.
+  uint64_t load_start = Clock::QueryHostTickCount();
+  std::unordered_map<uint32_t, StoredFunction> stored_functions;
+  StorageFileHeader file_header;
+  if (fread(&file_header, sizeof(file_header), 1, file) &&
+      file_header.magic == kStorageMagic &&
+      file_header.version == kStorageVersion &&
+      file_header.fingerprint == fingerprint) {
+    int64_t valid_bytes = int64_t(sizeof(file_header));
+    uint64_t image_delta = GetStorageImageAnchor() - file_header.image_anchor;
+    struct LoadedFunction {
+      StoredFunctionHeader header;
+      std::vector<uint8_t> code;
+      std::vector<ImageRelocation> image_relocations;
+      std::vector<SourceMapEntry> source_map;
+    };
+    std::vector<LoadedFunction> loaded_functions;
+    while (true) {
+      LoadedFunction loaded_function;
+      StoredFunctionHeader& function_header = loaded_function.header;
+      if (!fread(&function_header, sizeof(function_header), 1, file)) {
+        break;
+      }
+      std::vector<uint8_t>& code = loaded_function.code;
+      std::vector<ImageRelocation>& image_relocations =
+          loaded_function.image_relocations;
+      std::vector<SourceMapEntry>& source_map = loaded_function.source_map;
+      code.resize(function_header.func_info.code_size.total);
+      image_relocations.resize(function_header.image_relocation_count);
+      source_map.resize(function_header.source_map_count);
+      if ((!code.empty() && !fread(code.data(), code.size(), 1, file)) ||
+          (!image_relocations.empty() &&
+           !fread(image_relocations.data(),
+                  sizeof(ImageRelocation) * image_relocations.size(), 1,
+                  file)) ||
+          (!source_map.empty() &&
+           !fread(source_map.data(),
+                  sizeof(SourceMapEntry) * source_map.size(), 1, file))) {
+        break;
+      }
+      if (HashStoredFunctionData(code.data(), code.size(), image_relocations,
+                                 source_map) != function_header.data_hash) {
+        break;
+      }
+      loaded_functions.push_back(std::move(loaded_function));
+      valid_bytes = xe::filesystem::Tell(file);
+    }
+
+    // Functions translated on different threads may be stored in a different
+    // order than they were placed in.
+    std::sort(loaded_functions.begin(), loaded_functions.end(),
+              [](const LoadedFunction& a, const LoadedFunction& b) {
+                return a.header.code_offset < b.header.code_offset;
+              });
+
+    for (LoadedFunction& loaded_function : loaded_functions) {
+      const StoredFunctionHeader& function_header = loaded_function.header;
+      std::vector<uint8_t>& code = loaded_function.code;
+      size_t code_size = code.size();
+
+      // Rebase the pointers into the host executable. Code placed after a
+      // function that can't be loaded may reference it, so stop at the first
+      // failure.
+      bool relocated = true;
+      for (const ImageRelocation& relocation :
+           loaded_function.image_relocations) {
+        if (relocation.code_offset > code_size ||
+            code_size - relocation.code_offset < relocation.size) {
+          relocated = false;
+          break;
+        }
+        uint8_t* immediate = code.data() + relocation.code_offset;
+        if (relocation.size == sizeof(uint64_t)) {
+          uint64_t value;
+          std::memcpy(&value, immediate, sizeof(value));
+          value += image_delta;
+          std::memcpy(immediate, &value, sizeof(value));
+        } else {
+          uint32_t value;
+          std::memcpy(&value, immediate, sizeof(value));
+          uint64_t rebased_value = uint64_t(value) + image_delta;
+          if (rebased_value >= 0x80000000ull) {
+            relocated = false;
+            break;
+          }
+          value = uint32_t(rebased_value);
+          std::memcpy(immediate, &value, sizeof(value));
+        }
+      }
+      if (!relocated) {
+        break;
+      }
+
+      // Restore the code to exactly where it was placed originally.
+      if (!PlaceCodeGap(function_header.code_offset)) {
+        break;
+      }
+      void* code_execute_address;
+      void* code_write_address;
+      PlaceGuestCode(0, code.data(), function_header.func_info, nullptr,
+                     code_execute_address, code_write_address);
+      if (code_execute_address !=
+          generated_code_execute_base_ + function_header.code_offset) {
+        break;
+      }
+
+      StoredFunction& stored_function =
+          stored_functions[function_header.guest_address];
+      stored_function.code_execute_address =
+          reinterpret_cast<uint8_t*>(code_execute_address);
+      stored_function.code_size = code_size;
+      stored_function.pipeline_fingerprint =
+          function_header.pipeline_fingerprint;
+      stored_function.source_map = std::move(loaded_function.source_map);
+    }
+    xe::filesystem::TruncateStdioFile(file, uint64_t(valid_bytes));
+    xe::filesystem::Seek(file, 0, SEEK_END);
+    XELOGI("Loaded {} guest functions from the code storage in {} milliseconds",
+           stored_functions.size(),
+           (Clock::QueryHostTickCount() - load_start) * 1000 /
+               Clock::QueryHostTickFrequency());
+  } else {
+    xe::filesystem::TruncateStdioFile(file, 0);
+    file_header.magic = kStorageMagic;
+    file_header.version = kStorageVersion;
+    file_header.fingerprint = fingerprint;
+    file_header.image_anchor = GetStorageImageAnchor();
+    fwrite(&file_header, sizeof(file_header), 1, file);
+  }
+
+  std::lock_guard<std::mutex> storage_lock(storage_mutex_);
+  storage_file_ = file;
+  stored_functions_ = std::move(stored_functions);
+  return true;
+}
+
+void X64CodeCache::CloseStorage() {
+  std::lock_guard<std::mutex> storage_lock(storage_mutex_);
+  if (storage_file_) {
+    fclose(storage_file_);
+    storage_file_ = nullptr;
+  }
+  stored_functions_.clear();
+}
+
+void X64CodeCache::StoreGuestCode(
+    GuestFunction* function, const void* code_execute_address,
+    const EmitFunctionInfo& func_info,
+    const std::vector<ImageRelocation>& image_relocations,
+    uint64_t pipeline_fingerprint) {
+  size_t code_offset = size_t(
+      reinterpret_cast<const uint8_t*>(code_execute_address) -
+      generated_code_execute_base_);
+  const uint8_t* code_write_address = generated_code_write_base_ + code_offset;
+  const std::vector<SourceMapEntry>& source_map = function->source_map();
+
+  StoredFunctionHeader function_header = {};
+  function_header.guest_address = function->address();
+  function_header.code_offset = uint32_t(code_offset);
+  function_header.pipeline_fingerprint = pipeline_fingerprint;
+  function_header.func_info = func_info;
+  function_header.image_relocation_count = uint32_t(image_relocations.size());
+  function_header.source_map_count = uint32_t(source_map.size());
+  function_header.data_hash =
+      HashStoredFunctionData(code_write_address, func_info.code_size.total,
+                             image_relocations, source_map);
+
+  std::lock_guard<std::mutex> storage_lock(storage_mutex_);
+  if (!storage_file_) {
+    return;
+  }
+  fwrite(&function_header, sizeof(function_header), 1, storage_file_);
+  fwrite(code_write_address, func_info.code_size.total, 1, storage_file_);
+  if (!image_relocations.empty()) {
+    fwrite(image_relocations.data(),
+           sizeof(ImageRelocation) * image_relocations.size(), 1,
+           storage_file_);
+  }
+  if (!source_map.empty()) {
+    fwrite(source_map.data(), sizeof(SourceMapEntry) * source_map.size(), 1,
+           storage_file_);
+  }
+}
+
+bool X64CodeCache::ClaimStoredGuestCode(GuestFunction* function,
+                                        uint64_t pipeline_fingerprint,
+                                        void*& code_execute_address_out,
+                                        size_t& code_size_out) {
+  StoredFunction stored_function;
+  {
+    std::lock_guard<std::mutex> storage_lock(storage_mutex_);
+    auto it = stored_functions_.find(function->address());
+    if (it == stored_functions_.end()) {
+      return false;
+    }
+    if (it->second.pipeline_fingerprint != pipeline_fingerprint) {
+      // The function will be recompiled and stored again.
+      stored_functions_.erase(it);
+      return false;
+    }
+    stored_function = std::move(it->second);
+    stored_functions_.erase(it);
+  }
+
+  {
+    // Associate the function with its code for host PC lookups.
+    auto global_lock = global_critical_region_.Acquire();
+    uint64_t key = uint64_t(stored_function.code_execute_address -
+                            generated_code_execute_base_)
+                   << 32;
+    auto it = std::lower_bound(
+        generated_code_map_.begin(), generated_code_map_.end(), key,
+        [](const std::pair<uint64_t, GuestFunction*>& element, uint64_t key) {
+          return element.first < key;
+        });
+    if (it != generated_code_map_.end() && (it->first >> 32) == (key >> 32)) {
+      it->second = function;
+    }
+  }
+
+  RegisterCodeSymbol(function->address(), function,
+                     stored_function.code_execute_address,
+                     stored_function.code_size);
+
+  function->source_map() = std::move(stored_function.source_map);
+  code_execute_address_out = stored_function.code_execute_address;
+  code_size_out = stored_function.code_size;
+  return true;
+}
+
 GuestFunction* X64CodeCache::LookupFunction(uint64_t host_pc) {
   uint32_t key = uint32_t(host_pc - kGeneratedCodeExecuteBase);
   void* fn_entry = std::bsearch(
@@ -13,8 +13,13 @@
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -39,6 +44,16 @@ struct EmitFunctionInfo {
   size_t stack_size;
 };
 
+// Location of a host pointer embedded in generated code that points into the
+// host executable image, and needs to be rebased when the code is loaded from
+// the persistent storage by a process where the image is mapped elsewhere.
+struct ImageRelocation {
+  uint32_t code_offset;
+  // 4 for 32-bit immediates (only usable while the image is below 2 GB), 8 for
+  // 64-bit ones.
+  uint32_t size;
+};
+
 class X64CodeCache : public CodeCache {
  public:
   ~X64CodeCache() override;
@@ -52,6 +67,9 @@ class X64CodeCache : public CodeCache {
     return kGeneratedCodeExecuteBase;
   }
   size_t total_size() const override { return kGeneratedCodeSize; }
+  size_t committed_size() const override {
+    return generated_code_commit_mark_.load(std::memory_order_relaxed);
+  }
 
   // TODO(benvanik): ELF serialization/etc
   // TODO(benvanik): keep track of code blocks
@@ -74,6 +92,51 @@ class X64CodeCache : public CodeCache {
                       void*& code_write_address_out);
   uint32_t PlaceData(const void* data, size_t length);
 
+  // Modifies placed code. Code that may be running concurrently must only be
+  // modified with PatchCode32 at 4-byte aligned addresses, other parts must not
+  // be reachable by any thread while they're modified.
+  void PatchCode(void* code_execute_address, const void* data, size_t size);
+  void PatchCode32(void* code_execute_address, uint32_t value);
+
+  // Persistent code storage. Stored guest code is placed back at exactly the
+  // host addresses it was originally emitted to when the storage is opened, so
+  // relative references to the thunks, the helpers and other stored functions
+  // stay valid and only pointers into the host executable need relocation.
+  // Because of that, the storage must be opened before any guest code is
+  // placed. The fingerprint must identify everything that affects code
+  // generation other than the pass pipeline, which is checked per function.
+  bool OpenStorage(const std::filesystem::path& path, uint64_t fingerprint);
+  void CloseStorage();
+  bool has_storage() const { return storage_file_ != nullptr; }
+  // Appends the code placed for the function to the storage.
+  void StoreGuestCode(GuestFunction* function, const void* code_execute_address,
+                      const EmitFunctionInfo& func_info,
+                      const std::vector<ImageRelocation>& image_relocations,
+                      uint64_t pipeline_fingerprint);
+  // Takes the code loaded from the storage for the function, if there is code
+  // generated by the same pass pipeline, associating the function with it and
+  // installing it into the indirection table.
+  bool ClaimStoredGuestCode(GuestFunction* function,
+                            uint64_t pipeline_fingerprint,
+                            void*& code_execute_address_out,
+                            size_t& code_size_out);
+
+  // Code space reclamation. Code that can't be reached through calls anymore
+  // is retired, and is reclaimed for new code once it's known that no thread
+  // is running it. Not done with the persistent storage, which needs the code
+  // to be placed in order.
+  void RemoveIndirection(uint32_t guest_address);
+  void RetireCode(void* code_execute_address);
+  // Dissociates the functions of the module from their retired code, before
+  // they're destroyed.
+  void ForgetModule(Module* module);
+  size_t GetRetiredCodeCount();
+  // Reclaims the blocks among the retired_count ones retired first that don't
+  // contain any of the addresses, which must include the host PCs of the frames
+  // and the registers of all threads that may be running guest code.
+  void ReclaimRetiredCode(size_t retired_count,
+                          const std::vector<uint64_t>& live_addresses);
+
   GuestFunction* LookupFunction(uint64_t host_pc) override;
 
  protected:
@@ -105,14 +168,33 @@ class X64CodeCache : public CodeCache {
 
   X64CodeCache();
 
+  // Commits executable memory for generated code up to the given offset.
+  void CommitGeneratedCode(size_t high_mark);
+  // Advances the placement offset to the specified one, filling the skipped
+  // space with int3. Returns false if code has already been placed beyond it.
+  bool PlaceCodeGap(size_t new_offset);
+
   virtual UnwindReservation RequestUnwindReservation(uint8_t* entry_address) {
     return UnwindReservation();
   }
+  // Size of the unwind data placed after the code of each function.
+  virtual size_t unwind_reservation_size() const { return 0; }
+  // Reuses the unwind table slot of reclaimed code, which is the same as its
+  // index in generated_code_map_ as both are allocated together.
+  virtual UnwindReservation ReuseUnwindReservation(uint8_t* entry_address,
+                                                   size_t table_slot) {
+    return UnwindReservation();
+  }
   virtual void PlaceCode(uint32_t guest_address, void* machine_code,
                          const EmitFunctionInfo& func_info,
                          void* code_execute_address,
                          UnwindReservation unwind_reservation) {}
 
+  // Makes the code known to the host profilers that are active - VTune and
+  // Linux perf via the map file. The function is null for host code.
+  void RegisterCodeSymbol(uint32_t guest_address, GuestFunction* function,
+                          const void* code_execute_address, size_t code_size);
+
   std::filesystem::path file_name_;
   xe::memory::FileMappingHandle mapping_ =
       xe::memory::kFileMappingHandleInvalid;
@@ -143,6 +225,42 @@ class X64CodeCache : public CodeCache {
   // This can be used to bsearch on host PC to find the guest function.
   // The key is [start address | end address].
   std::vector<std::pair<uint64_t, GuestFunction*>> generated_code_map_;
+
+  struct CodeBlock {
+    // Offset from the generated code base.
+    size_t offset;
+    // Including the unwind data and the padding.
+    size_t size;
+    size_t map_index;
+  };
+  // Code that can't be reached anymore, but may still be running, in the order
+  // of retirement.
+  std::vector<CodeBlock> retired_code_blocks_;
+  size_t retired_code_size_ = 0;
+  // Reclaimed blocks by size, for best fit placement. Blocks aren't split or
+  // coalesced, as each has its own entry in generated_code_map_.
+  std::multimap<size_t, CodeBlock> free_code_blocks_;
+  size_t free_code_size_ = 0;
+  // Sizes of reclaimed blocks that have been reused for smaller code, by the
+  // index in generated_code_map_.
+  std::unordered_map<size_t, size_t> reused_code_block_sizes_;
+
+  struct StoredFunction {
+    uint8_t* code_execute_address;
+    size_t code_size;
+    uint64_t pipeline_fingerprint;
+    std::vector<SourceMapEntry> source_map;
+  };
+  // Guards the storage file and the stored functions. File writes must not be
+  // done in the global critical region.
+  std::mutex storage_mutex_;
+  FILE* storage_file_ = nullptr;
+  // Code loaded from the storage that has not been claimed by a function yet.
+  std::unordered_map<uint32_t, StoredFunction> stored_functions_;
+
+  // Linux perf JIT symbol map, if enabled.
+  std::mutex perf_map_mutex_;
+  FILE* perf_map_file_ = nullptr;
 };
 
 }  // namespace x64
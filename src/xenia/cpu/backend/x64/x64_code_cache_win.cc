@@ -106,6 +106,11 @@ class Win32X64CodeCache : public X64CodeCache {
 
  private:
   UnwindReservation RequestUnwindReservation(uint8_t* entry_address) override;
+  size_t unwind_reservation_size() const override {
+    return xe::round_up(kUnwindInfoSize, 16);
+  }
+  UnwindReservation ReuseUnwindReservation(uint8_t* entry_address,
+                                           size_t table_slot) override;
   void PlaceCode(uint32_t guest_address, void* machine_code,
                  const EmitFunctionInfo& func_info, void* code_execute_address,
                  UnwindReservation unwind_reservation) override;
@@ -221,12 +226,22 @@ Win32X64CodeCache::RequestUnwindReservation(uint8_t* entry_address) {
   assert_false(unwind_table_count_ >= kMaximumFunctionCount);
 #endif
   UnwindReservation unwind_reservation;
-  unwind_reservation.data_size = xe::round_up(kUnwindInfoSize, 16);
+  unwind_reservation.data_size = unwind_reservation_size();
   unwind_reservation.table_slot = unwind_table_count_++;
   unwind_reservation.entry_address = entry_address;
   return unwind_reservation;
 }
 
+Win32X64CodeCache::UnwindReservation Win32X64CodeCache::ReuseUnwindReservation(
+    uint8_t* entry_address, size_t table_slot) {
+  assert_true(table_slot < unwind_table_count_);
+  UnwindReservation unwind_reservation;
+  unwind_reservation.data_size = unwind_reservation_size();
+  unwind_reservation.table_slot = table_slot;
+  unwind_reservation.entry_address = entry_address;
+  return unwind_reservation;
+}
+
 void Win32X64CodeCache::PlaceCode(uint32_t guest_address, void* machine_code,
                                   const EmitFunctionInfo& func_info,
                                   void* code_execute_address,
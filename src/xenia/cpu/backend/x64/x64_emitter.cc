@@ -11,6 +11,7 @@
 
 #include <stddef.h>
 
+#include <algorithm>
 #include <climits>
 #include <cstring>
 
@@ -51,13 +52,48 @@ DEFINE_bool(enable_incorrect_roundingmode_behavior, false,
             "Disables the FPU/VMX MXCSR sharing workaround, potentially "
             "causing incorrect rounding behavior and denormal handling in VMX "
             "code. The workaround may cause reduced CPU performance but is a "
-            "more accurate emulation",
+            "more accurate emulation. The cost of the workaround can be "
+            "measured with mxcsr_statistics.",
+            "x64");
+DEFINE_bool(propagate_mxcsr_mode, true,
+            "Track the MXCSR mode (FPU or VMX) across the blocks of a "
+            "function, skipping the check of the mode before the first "
+            "floating-point operation of the blocks it's known at the start "
+            "of.",
+            "x64");
+DEFINE_bool(mxcsr_statistics, false,
+            "Count the MXCSR mode checks and switches between the FPU and the "
+            "VMX modes done by the generated code, and log them per guest "
+            "thread when it exits and in total on shutdown.",
             "x64");
 DEFINE_uint32(align_all_basic_blocks, 0,
               "Aligns the start of all basic blocks to N bytes. Only specify a "
               "power of 2, 16 is the recommended value. Results in larger "
               "icache usage, but potentially faster loops",
               "x64");
+DEFINE_bool(profile_guided_block_layout, false,
+            "Count the executions of the blocks of the baseline code with "
+            "tiered_compilation, and emit the blocks it has never executed "
+            "after the epilog of the optimized code, aligning the starts of "
+            "the hot loops to 16 bytes unless align_all_basic_blocks is set.",
+            "x64");
+DEFINE_bool(indirect_call_inline_caches, true,
+            "Emit inline caches of the most recent targets at indirect call "
+            "sites, calling them directly instead of through the indirection "
+            "table.",
+            "x64");
+DEFINE_bool(indirect_call_inline_cache_statistics, false,
+            "Count the calls and inline cache misses of indirect call sites and "
+            "log the sites called the most on shutdown. Functions with indirect "
+            "calls are not stored in the generated code storage then.",
+            "x64");
+DEFINE_bool(return_statistics, false,
+            "Count the likely returns of guest functions, and the ones with a "
+            "link register not matching the return address of the native "
+            "call, which can't use the host return prediction, and log the "
+            "sites with the most mismatches on shutdown. Functions with likely "
+            "returns are not stored in the generated code storage then.",
+            "x64");
 #if XE_X64_PROFILER_AVAILABLE == 1
 DEFINE_bool(instrument_call_times, false,
             "Compute time taken for functions, for profiling guest code",
@@ -120,6 +156,21 @@ bool X64Emitter::Emit(GuestFunction* function, HIRBuilder* builder,
   debug_info_flags_ = debug_info_flags;
   trace_data_ = &function->trace_data();
   source_map_arena_.Reset();
+  storable_ = true;
+  image_relocations_.clear();
+  tier_up_function_ = compilation_tier_ == CompilationTier::kBaseline
+                          ? static_cast<X64Function*>(function)
+                          : nullptr;
+  sampled_call_count_ =
+      cvars::jit_statistics ? function->sampled_call_count_ptr() : nullptr;
+  block_profile_function_ = cvars::profile_guided_block_layout
+                                ? static_cast<X64Function*>(function)
+                                : nullptr;
+  // Whether the folded memory is still read-only is only tracked for the
+  // translations in this run.
+  if (!builder->folded_load_addresses().empty()) {
+    MarkNotStorable();
+  }
 
   // Fill the generator with code.
   EmitFunctionInfo func_info = {};
@@ -134,6 +185,15 @@ bool X64Emitter::Emit(GuestFunction* function, HIRBuilder* builder,
   // Stash source map.
   source_map_arena_.CloneContents(out_source_map);
 
+  // Also reset when replacing stored code, so the new code isn't called
+  // directly from stored code once it's set up.
+  bool store = storable_ && code_cache_->has_storage();
+  if (store) {
+    code_cache_->StoreGuestCode(function, *out_code_address, func_info,
+                                image_relocations_, pipeline_fingerprint_);
+  }
+  static_cast<X64Function*>(function)->set_code_stored(store);
+
   return true;
 }
 void* X64Emitter::Emplace(const EmitFunctionInfo& func_info,
@@ -240,6 +300,7 @@ bool X64Emitter::Emit(HIRBuilder* builder, EmitFunctionInfo& func_info) {
 
   code_offsets.prolog_stack_alloc = getSize();
   code_offsets.body = getSize();
+  StoreLazyStackpoint();
   xor_(eax, eax);
   /*
   * chrispy: removed this, it serves no purpose
@@ -258,8 +319,15 @@ bool X64Emitter::Emit(HIRBuilder* builder, EmitFunctionInfo& func_info) {
         rdx);  // save time for end of function
   }
 #endif
+  if (sampled_call_count_) {
+    // Not atomic, to be cheap enough to keep enabled in every function.
+    MarkNotStorable();
+    mov(rax, reinterpret_cast<uintptr_t>(sampled_call_count_));
+    inc(qword[rax]);
+  }
   // Safe now to do some tracing.
   if (debug_info_flags_ & DebugInfoFlags::kDebugInfoTraceFunctions) {
+    MarkNotStorable();
     // We require 32-bit addresses.
     assert_true(uint64_t(trace_data_->header()) < UINT_MAX);
     auto trace_header = trace_data_->header();
@@ -286,6 +354,27 @@ bool X64Emitter::Emit(HIRBuilder* builder, EmitFunctionInfo& func_info) {
     bts(qword[low_address(&trace_header->function_thread_use)], rax);
   }
 
+  // Count calls of baseline code, requesting the optimized code once the
+  // counter reaches zero. All volatile registers are free at this point.
+  Xbyak::Label tier_up_return_label;
+  if (tier_up_function_) {
+    // The counter is in the function object.
+    MarkNotStorable();
+    mov(rax, reinterpret_cast<uint64_t>(tier_up_function_->tier_up_counter()));
+    lock();
+    dec(dword[rax]);
+    Xbyak::Label& tier_up_label = AddToTail(
+        [&tier_up_return_label](X64Emitter& e, Xbyak::Label& our_tail_label) {
+          e.L(our_tail_label);
+          e.mov(e.GetNativeParam(0),
+                reinterpret_cast<uint64_t>(e.tier_up_function_));
+          e.CallNativeSafe(reinterpret_cast<void*>(RequestTierUp));
+          e.jmp(tier_up_return_label, e.T_NEAR);
+        });
+    jz(tier_up_label, T_NEAR);
+    L(tier_up_return_label);
+  }
+
   // Load membase.
   /*
   * chrispy: removed this, as long as we load it in HostToGuestThunk we can
@@ -293,48 +382,16 @@ bool X64Emitter::Emit(HIRBuilder* builder, EmitFunctionInfo& func_info) {
       qword[GetContextReg() + offsetof(ppc::PPCContext, virtual_membase)]);
   */
   // Body.
-  auto block = builder->first_block();
   synchronize_stack_on_next_instruction_ = false;
-  while (block) {
-    ForgetMxcsrMode();  // at start of block, mxcsr mode is undefined
-
-    // Mark block labels.
-    auto label = block->label_head;
-    while (label) {
-      L(std::to_string(label->id));
-      label = label->next;
-    }
-
-    if (cvars::align_all_basic_blocks) {
-      align(cvars::align_all_basic_blocks, true);
-    }
-    // Process instructions.
-    const Instr* instr = block->instr_head;
-    while (instr) {
-      if (synchronize_stack_on_next_instruction_) {
-        if (instr->GetOpcodeNum() != hir::OPCODE_SOURCE_OFFSET) {
-          synchronize_stack_on_next_instruction_ = false;
-          EnsureSynchronizedGuestAndHostStack();
-        }
-      }
-      const Instr* new_tail = instr;
-      if (!SelectSequence(this, instr, &new_tail)) {
-        // No sequence found!
-        // NOTE: If you encounter this after adding a new instruction, do a full
-        // rebuild!
-        assert_always();
-        XELOGE("Unable to process HIR opcode {}", GetOpcodeName(instr->opcode));
-        break;
-      }
-      instr = new_tail;
-    }
-
-    block = block->next;
+  ComputeBlockLayout(builder);
+  PrepareBlockEntryMxcsrModes(builder);
+  PrepareBlockProfileCounters(builder);
+  for (size_t i = 0; i < hot_block_count_; ++i) {
+    EmitBlock(i);
   }
 
   // Function epilog.
   L(epilog_label);
-  epilog_label_ = nullptr;
   EmitTraceUserCallReturn();
   /*
   * chrispy: removed this, it serves no purpose
@@ -346,6 +403,13 @@ bool X64Emitter::Emit(HIRBuilder* builder, EmitFunctionInfo& func_info) {
   add(rsp, (uint32_t)stack_size);
   PopStackpoint();
   ret();
+
+  // Cold blocks, out of the way of the hot ones, but still within the range
+  // of the function for the unwind information and the source map.
+  for (size_t i = hot_block_count_; i < block_layout_.size(); ++i) {
+    EmitBlock(i);
+  }
+  epilog_label_ = nullptr;
   // todo: do some kind of sorting by alignment?
   for (auto&& tail_item : tail_code_) {
     if (tail_item.alignment) {
@@ -371,12 +435,257 @@ bool X64Emitter::Emit(HIRBuilder* builder, EmitFunctionInfo& func_info) {
 
   return true;
 }
+void X64Emitter::EmitBlock(size_t layout_index) {
+  const BlockLayoutEntry& layout_entry = block_layout_[layout_index];
+  hir::Block* block = layout_entry.block;
+
+  // Undefined unless known for all the ways into the block.
+  mxcsr_mode_ = GetBlockEntryMxcsrMode(block);
+
+  if (layout_entry.align && !cvars::align_all_basic_blocks) {
+    align(16, true);
+  }
+
+  // Mark block labels.
+  if (!block_start_labels_.empty()) {
+    L(*block_start_labels_[block->ordinal]);
+  }
+  auto label = block->label_head;
+  while (label) {
+    L(std::to_string(label->id));
+    label = label->next;
+  }
+
+  if (cvars::align_all_basic_blocks) {
+    align(cvars::align_all_basic_blocks, true);
+  }
+
+  // Only the scratch registers and the flags are free at the start of a block.
+  if (!block_profile_counters_.empty() &&
+      block_profile_counters_[block->ordinal]) {
+    // Not atomic, only a heuristic.
+    MarkNotStorable();
+    mov(rax, reinterpret_cast<uintptr_t>(
+                 block_profile_counters_[block->ordinal]));
+    inc(qword[rax]);
+  }
+
+  // Process instructions.
+  const Instr* instr = block->instr_head;
+  while (instr) {
+    if (synchronize_stack_on_next_instruction_) {
+      if (instr->GetOpcodeNum() != hir::OPCODE_SOURCE_OFFSET) {
+        synchronize_stack_on_next_instruction_ = false;
+        EnsureSynchronizedGuestAndHostStack();
+      }
+    }
+    const Instr* new_tail = instr;
+    MXCSRMode mxcsr_mode_before = mxcsr_mode_;
+    if (!SelectSequence(this, instr, &new_tail)) {
+      // No sequence found!
+      // NOTE: If you encounter this after adding a new instruction, do a full
+      // rebuild!
+      assert_always();
+      XELOGE("Unable to process HIR opcode {}", GetOpcodeName(instr->opcode));
+      break;
+    }
+    // A sequence made of multiple instructions may branch before or after
+    // changing the mode.
+    MXCSRMode branch_mxcsr_mode =
+        mxcsr_mode_before == mxcsr_mode_ ? mxcsr_mode_ : MXCSRMode::Unknown;
+    for (const Instr* sequence_instr = instr; sequence_instr != new_tail;
+         sequence_instr = sequence_instr->next) {
+      MergeBranchTargetMxcsrModes(sequence_instr, branch_mxcsr_mode);
+    }
+    instr = new_tail;
+  }
+
+  bool falls_through = !EndsWithUnconditionalBranch(block);
+  if (block->next && falls_through) {
+    MergeBlockEntryMxcsrMode(block->next, mxcsr_mode_);
+  }
+
+  // Jump to the next block (or the epilog after the last one) if it's not
+  // emitted right after this one.
+  size_t next_layout_index = layout_index + 1;
+  const hir::Block* next_emitted_block =
+      next_layout_index != hot_block_count_ &&
+              next_layout_index < block_layout_.size()
+          ? block_layout_[next_layout_index].block
+          : nullptr;
+  if (block->next != next_emitted_block) {
+    if (falls_through) {
+      if (synchronize_stack_on_next_instruction_) {
+        EnsureSynchronizedGuestAndHostStack();
+      }
+      jmp(block->next ? *block_start_labels_[block->next->ordinal]
+                      : epilog_label(),
+          T_NEAR);
+    }
+    // Not needed at the start of the block emitted next if this one doesn't
+    // fall through to it.
+    synchronize_stack_on_next_instruction_ = false;
+  }
+}
+
+void X64Emitter::ComputeBlockLayout(HIRBuilder* builder) {
+  block_layout_.clear();
+  block_layout_positions_.clear();
+  block_start_labels_.clear();
+  bool blocks_numbered = true;
+  for (auto block = builder->first_block(); block; block = block->next) {
+    if (block->ordinal != block_layout_.size()) {
+      blocks_numbered = false;
+    }
+    block_layout_.push_back({block, false});
+  }
+  hot_block_count_ = block_layout_.size();
+  // Blocks are numbered in order by the finalization pass, if it hasn't been
+  // run, they're emitted in the HIR order.
+  if (!blocks_numbered) {
+    return;
+  }
+  block_layout_positions_.resize(block_layout_.size());
+  for (size_t i = 0; i < block_layout_positions_.size(); ++i) {
+    block_layout_positions_[i] = i;
+  }
+
+  // Only the optimized code is laid out with the profile of the baseline code.
+  if (tier_up_function_ || !block_profile_function_ ||
+      !block_profile_function_->has_block_profile() ||
+      block_profile_function_->block_profile_addresses().empty()) {
+    return;
+  }
+  // The first profiled block is the entry of the function.
+  uint64_t entry_count = block_profile_function_->block_profile_counts()[0];
+  if (!entry_count) {
+    return;
+  }
+  // Blocks without a guest address in the function, such as ones starting
+  // with inlined code, are assumed to be hot.
+  std::vector<uint64_t> block_counts(block_layout_.size(), UINT64_MAX);
+  for (size_t i = 0; i < block_layout_.size(); ++i) {
+    uint32_t address;
+    if (GetBlockProfileAddress(block_layout_[i].block, address)) {
+      block_counts[i] = block_profile_function_->GetBlockProfileCount(address);
+    }
+  }
+
+  // Loop heads are the blocks branched to from themselves or later blocks,
+  // hot if executed more often than the function is called.
+  for (size_t i = 0; i < block_layout_.size(); ++i) {
+    for (auto instr = block_layout_[i].block->instr_head; instr;
+         instr = instr->next) {
+      uint32_t signature = instr->opcode->signature;
+      hir::Label* labels[] = {
+          GET_OPCODE_SIG_TYPE_SRC1(signature) == hir::OPCODE_SIG_TYPE_L
+              ? instr->src1.label
+              : nullptr,
+          GET_OPCODE_SIG_TYPE_SRC2(signature) == hir::OPCODE_SIG_TYPE_L
+              ? instr->src2.label
+              : nullptr,
+          GET_OPCODE_SIG_TYPE_SRC3(signature) == hir::OPCODE_SIG_TYPE_L
+              ? instr->src3.label
+              : nullptr,
+      };
+      for (hir::Label* label : labels) {
+        if (!label || !label->block || label->block->ordinal > i) {
+          continue;
+        }
+        uint64_t head_count = block_counts[label->block->ordinal];
+        if (head_count != UINT64_MAX && head_count > entry_count) {
+          block_layout_[label->block->ordinal].align = true;
+        }
+      }
+    }
+  }
+
+  // Blocks never executed by the baseline code are cold, except for the entry.
+  std::vector<BlockLayoutEntry> cold_blocks;
+  size_t hot_block_count = 1;
+  for (size_t i = 1; i < block_layout_.size(); ++i) {
+    if (block_counts[i]) {
+      block_layout_[hot_block_count++] = block_layout_[i];
+    } else {
+      cold_blocks.push_back(block_layout_[i]);
+    }
+  }
+  if (cold_blocks.empty()) {
+    return;
+  }
+  hot_block_count_ = hot_block_count;
+  std::copy(cold_blocks.cbegin(), cold_blocks.cend(),
+            block_layout_.begin() + hot_block_count);
+  block_start_labels_.reserve(block_layout_.size());
+  for (size_t i = 0; i < block_layout_.size(); ++i) {
+    block_layout_positions_[block_layout_[i].block->ordinal] = i;
+    block_start_labels_.push_back(&NewCachedLabel());
+  }
+}
+
+bool X64Emitter::GetBlockProfileAddress(const hir::Block* block,
+                                        uint32_t& address_out) const {
+  for (auto instr = block->instr_head; instr; instr = instr->next) {
+    if (instr->opcode == &hir::OPCODE_SOURCE_OFFSET_info) {
+      uint32_t address = static_cast<uint32_t>(instr->src1.offset);
+      if (!block_profile_function_->ContainsAddress(address)) {
+        return false;
+      }
+      address_out = address;
+      return true;
+    }
+  }
+  return false;
+}
+
+void X64Emitter::PrepareBlockProfileCounters(HIRBuilder* builder) {
+  block_profile_counters_.clear();
+  if (!tier_up_function_ || !block_profile_function_ ||
+      block_layout_positions_.empty()) {
+    return;
+  }
+  // Blocks are in the guest order in the baseline code.
+  std::vector<uint32_t> block_addresses;
+  for (auto block = builder->first_block(); block; block = block->next) {
+    uint32_t address;
+    if (GetBlockProfileAddress(block, address)) {
+      block_addresses.push_back(address);
+    }
+  }
+  std::sort(block_addresses.begin(), block_addresses.end());
+  block_addresses.erase(
+      std::unique(block_addresses.begin(), block_addresses.end()),
+      block_addresses.end());
+  // Kept if the function is translated again, only counting the blocks still
+  // starting at the same addresses.
+  if (!block_profile_function_->has_block_profile()) {
+    block_profile_function_->SetupBlockProfile(std::move(block_addresses));
+  }
+  const std::vector<uint32_t>& profile_addresses =
+      block_profile_function_->block_profile_addresses();
+  block_profile_counters_.resize(block_layout_positions_.size(), nullptr);
+  for (auto block = builder->first_block(); block; block = block->next) {
+    uint32_t address;
+    if (!GetBlockProfileAddress(block, address)) {
+      continue;
+    }
+    auto it = std::lower_bound(profile_addresses.cbegin(),
+                               profile_addresses.cend(), address);
+    if (it != profile_addresses.cend() && *it == address) {
+      block_profile_counters_[block->ordinal] =
+          block_profile_function_->block_profile_counts() +
+          (it - profile_addresses.cbegin());
+    }
+  }
+}
+
 // dont use rax, we do this in tail call handling
 void X64Emitter::EmitProfilerEpilogue() {
 #if XE_X64_PROFILER_AVAILABLE == 1
   if (cvars::instrument_call_times) {
     uint64_t* profiler_entry =
         backend()->GetProfilerRecordForFunction(current_guest_function_);
+    MarkNotStorable();
 
     mov(ecx, 0x7ffe0014);
     mov(rdx, qword[rcx]);
@@ -399,6 +708,7 @@ void X64Emitter::MarkSourceOffset(const Instr* i) {
   entry->guest_address = static_cast<uint32_t>(i->src1.offset);
   entry->hir_offset = uint32_t(i->block->ordinal << 16) | i->ordinal;
   entry->code_offset = static_cast<uint32_t>(getSize());
+  current_guest_address_ = entry->guest_address;
 
   if (cvars::emit_source_annotations) {
     nop(2);
@@ -406,7 +716,11 @@ void X64Emitter::MarkSourceOffset(const Instr* i) {
     nop(2);
   }
 
-  if (debug_info_flags_ & DebugInfoFlags::kDebugInfoTraceFunctionCoverage) {
+  // Inlined code is outside the range of the coverage counts.
+  if ((debug_info_flags_ & DebugInfoFlags::kDebugInfoTraceFunctionCoverage) &&
+      entry->guest_address >= trace_data_->start_address() &&
+      entry->guest_address <= trace_data_->end_address()) {
+    MarkNotStorable();
     uint32_t instruction_index =
         (entry->guest_address - trace_data_->start_address()) / 4;
     lock();
@@ -482,8 +796,11 @@ void X64Emitter::UnimplementedInstr(const hir::Instr* i) {
   assert_always();
 }
 
-// This is used by the X64ThunkEmitter's ResolveFunctionThunk.
-uint64_t ResolveFunction(void* raw_context, uint64_t target_address) {
+// This is used by the X64ThunkEmitter's ResolveFunctionThunk, host_rsp
+// pointing to the return address into the calling guest function, or 0 if not
+// known.
+uint64_t ResolveFunction(void* raw_context, uint64_t target_address,
+                         uint64_t host_rsp) {
   auto guest_context = reinterpret_cast<ppc::PPCContext_s*>(raw_context);
 
   auto thread_state = guest_context->thread_state;
@@ -564,6 +881,10 @@ uint64_t ResolveFunction(void* raw_context, uint64_t target_address) {
                 // restored (probably by longjmp)
                 X64BackendContext* backend_context =
                     backend->BackendContextForGuestContext(guest_context);
+                if (cvars::lazy_host_guest_stack_synchronization) {
+                  // Not recorded at the calls, get them from the frames.
+                  backend->ReconstructStackpoints(guest_context, host_rsp);
+                }
 
                 uint32_t current_stackpoint_index =
                     backend_context->current_stackpoint_depth;
@@ -702,7 +1023,12 @@ void X64Emitter::Call(const hir::Instr* instr, GuestFunction* function) {
   auto fn = static_cast<X64Function*>(function);
   // Resolve address to the function to call and store in rax.
 
-  if (fn->machine_code()) {
+  // Stored code may only call directly into code that will be restored to the
+  // same location on the next run.
+  // Baseline code is replaced when the function becomes hot, so it's only
+  // called through the indirection table.
+  if (!fn->is_baseline() && fn->machine_code() &&
+      (!code_cache_->has_storage() || fn->code_stored())) {
     if (!(instr->flags & hir::CALL_TAIL)) {
       mov(rcx, qword[rsp + StackLayout::GUEST_CALL_RET_ADDR]);
 
@@ -731,7 +1057,9 @@ void X64Emitter::Call(const hir::Instr* instr, GuestFunction* function) {
     // Old-style resolve.
     // Not too important because indirection table is almost always available.
     // TODO: Overwrite the call-site with a straight call.
-    CallNative(&ResolveFunction, function->address());
+    mov(GetNativeParam(0), function->address());
+    xor_(GetNativeParam(1).cvt32(), GetNativeParam(1).cvt32());
+    CallNativeSafe(reinterpret_cast<void*>(ResolveFunction));
   }
 
   // Actually jump/call to rax.
@@ -757,10 +1085,27 @@ void X64Emitter::Call(const hir::Instr* instr, GuestFunction* function) {
 void X64Emitter::CallIndirect(const hir::Instr* instr,
                               const Xbyak::Reg64& reg) {
   ForgetMxcsrMode();
-  // Check if return.
+  // Check if return. Guest functions are entered with native calls, so
+  // returning through the epilog pairs with the call in the host return
+  // prediction, and the indirect branch below is only taken for link registers
+  // changed to something else, such as by longjmp.
   if (instr->flags & hir::CALL_POSSIBLE_RETURN) {
+    ReturnSiteStatistics* statistics = nullptr;
+    if (cvars::return_statistics) {
+      MarkNotStorable();
+      statistics =
+          backend()->AllocateReturnSiteStatistics(current_guest_address_);
+      mov(rax, reinterpret_cast<uint64_t>(statistics));
+      lock();
+      inc(qword[rax + offsetof(ReturnSiteStatistics, returns)]);
+    }
     cmp(reg.cvt32(), dword[rsp + StackLayout::GUEST_RET_ADDR]);
     je(epilog_label(), CodeGenerator::T_NEAR);
+    if (statistics) {
+      mov(rax, reinterpret_cast<uint64_t>(statistics));
+      lock();
+      inc(qword[rax + offsetof(ReturnSiteStatistics, mismatches)]);
+    }
   }
 
   // Load the pointer to the indirection table maintained in X64CodeCache.
@@ -770,12 +1115,19 @@ void X64Emitter::CallIndirect(const hir::Instr* instr,
     if (reg.cvt32() != ebx) {
       mov(ebx, reg.cvt32());
     }
+    // Tail calls leave no room for the cache after the stack frame is popped.
+    if (!(instr->flags & hir::CALL_TAIL) &&
+        cvars::indirect_call_inline_caches) {
+      EmitIndirectCallInlineCache();
+      return;
+    }
     mov(eax, dword[ebx]);
   } else {
     // Old-style resolve.
     // Not too important because indirection table is almost always available.
     mov(edx, reg.cvt32());
-    mov(rax, reinterpret_cast<uint64_t>(ResolveFunction));
+    xor_(r8d, r8d);
+    MovImagePointer(rax, reinterpret_cast<void*>(ResolveFunction));
     mov(rcx, GetContextReg());
     call(rax);
   }
@@ -800,6 +1152,84 @@ void X64Emitter::CallIndirect(const hir::Instr* instr,
   }
 }
 
+void X64Emitter::EmitIndirectCallInlineCache() {
+  // The target guest address is in ebx.
+  IndirectCallSiteStatistics* statistics = nullptr;
+  if (cvars::indirect_call_inline_cache_statistics) {
+    MarkNotStorable();
+    statistics =
+        backend()->AllocateIndirectCallSiteStatistics(current_guest_address_);
+    mov(rax, reinterpret_cast<uint64_t>(statistics));
+    lock();
+    inc(qword[rax + offsetof(IndirectCallSiteStatistics, calls)]);
+  }
+
+  // Return address is from the previous SET_RETURN_ADDRESS.
+  mov(rcx, qword[rsp + StackLayout::GUEST_CALL_RET_ADDR]);
+
+  // The entries are compared in order, each is written once by
+  // X64Backend::UpdateIndirectCallInlineCache - the call first, then the
+  // 4-byte aligned target address making the entry reachable.
+  Xbyak::Label& site_label = NewCachedLabel();
+  Xbyak::Label& table_label = NewCachedLabel();
+  Xbyak::Label done_label;
+  while ((getSize() & 3) != (4 - kIndirectCallInlineCacheEntryAddressOffset)) {
+    nop();
+  }
+  L(site_label);
+  for (uint32_t i = 0; i < kIndirectCallInlineCacheEntryCount; ++i) {
+    Xbyak::Label next_entry_label;
+    // cmp ebx, imm32 - always the 32-bit immediate form.
+    db(0x81);
+    db(0xFB);
+    dd(kIndirectCallInlineCacheEmptyEntry);
+    jne(next_entry_label, T_SHORT);
+    // Never reached until the entry is filled.
+    call(reinterpret_cast<void*>(backend()->resolve_function_thunk()));
+    jmp(done_label, T_NEAR);
+    db(0xCC);
+    db(0xCC);
+    L(next_entry_label);
+  }
+
+  // Jump to the handler of the misses, changed to the next instruction when all
+  // the entries have been filled.
+  nop();
+  Xbyak::Label& miss_label = AddToTail(
+      [&site_label, &table_label](X64Emitter& e, Xbyak::Label& our_tail_label) {
+        e.L(our_tail_label);
+        e.lea(e.GetNativeParam(0), e.ptr[e.rip + site_label]);
+        e.mov(e.GetNativeParam(1).cvt32(), e.ebx);
+        e.CallNativeSafe(reinterpret_cast<void*>(IndirectCallInlineCacheMiss));
+        e.jmp(table_label, e.T_NEAR);
+      });
+  jmp(miss_label, T_NEAR);
+
+  L(table_label);
+  if (statistics) {
+    mov(rax, reinterpret_cast<uint64_t>(statistics));
+    lock();
+    inc(qword[rax + offsetof(IndirectCallSiteStatistics, misses)]);
+  }
+  mov(eax, dword[ebx]);
+  mov(rcx, qword[rsp + StackLayout::GUEST_CALL_RET_ADDR]);
+  call(rax);
+
+  L(done_label);
+  synchronize_stack_on_next_instruction_ = true;
+}
+
+uint64_t X64Emitter::IndirectCallInlineCacheMiss(void* raw_context,
+                                                 uint64_t site,
+                                                 uint64_t target_address) {
+  auto guest_context = reinterpret_cast<ppc::PPCContext_s*>(raw_context);
+  auto backend = static_cast<X64Backend*>(
+      guest_context->thread_state->processor()->backend());
+  backend->UpdateIndirectCallInlineCache(reinterpret_cast<uint8_t*>(site),
+                                         static_cast<uint32_t>(target_address));
+  return 0;
+}
+
 uint64_t UndefinedCallExtern(void* raw_context, uint64_t function_ptr) {
   auto function = reinterpret_cast<Function*>(function_ptr);
   if (!cvars::ignore_undefined_externs) {
@@ -822,9 +1252,11 @@ void X64Emitter::CallExtern(const hir::Instr* instr, const Function* function) {
       // rdx = arg0
       // r8  = arg1
       // r9  = arg2
-      mov(rcx, reinterpret_cast<uint64_t>(builtin_function->handler()));
+      MovImagePointer(rcx,
+                      reinterpret_cast<void*>(builtin_function->handler()));
       mov(rdx, reinterpret_cast<uint64_t>(builtin_function->arg0()));
       mov(r8, reinterpret_cast<uint64_t>(builtin_function->arg1()));
+      MarkNotStorable();
       call(backend()->guest_to_host_thunk());
       // rax = host return
     }
@@ -836,7 +1268,8 @@ void X64Emitter::CallExtern(const hir::Instr* instr, const Function* function) {
       // rdx = arg0
       // r8  = arg1
       // r9  = arg2
-      mov(rcx, reinterpret_cast<uint64_t>(extern_function->extern_handler()));
+      MovImagePointer(
+          rcx, reinterpret_cast<void*>(extern_function->extern_handler()));
       mov(rdx,
           qword[GetContextReg() + offsetof(ppc::PPCContext, kernel_state)]);
       call(backend()->guest_to_host_thunk());
@@ -844,6 +1277,7 @@ void X64Emitter::CallExtern(const hir::Instr* instr, const Function* function) {
     }
   }
   if (undefined) {
+    MarkNotStorable();
     CallNative(UndefinedCallExtern, reinterpret_cast<uint64_t>(function));
   }
 }
@@ -869,7 +1303,7 @@ void X64Emitter::CallNativeSafe(void* fn) {
   // rdx = arg0
   // r8  = arg1
   // r9  = arg2
-  mov(rcx, reinterpret_cast<uint64_t>(fn));
+  MovImagePointer(rcx, fn);
   call(backend()->guest_to_host_thunk());
   // rax = host return
 }
@@ -879,6 +1313,18 @@ void X64Emitter::SetReturnAddress(uint64_t value) {
   mov(qword[rsp + StackLayout::GUEST_CALL_RET_ADDR], rax);
 }
 
+void X64Emitter::MovImagePointer(const Xbyak::Reg64& reg, const void* ptr) {
+  size_t instruction_offset = getSize();
+  mov(reg, reinterpret_cast<uint64_t>(ptr));
+  // Xbyak uses shorter encodings with a 32-bit immediate for values that fit in
+  // 32 bits, the immediate is at the end of the instruction in all cases.
+  uint32_t immediate_size =
+      getSize() - instruction_offset >= 10 ? sizeof(uint64_t)
+                                            : sizeof(uint32_t);
+  image_relocations_.push_back(
+      {uint32_t(getSize() - immediate_size), immediate_size});
+}
+
 Xbyak::Reg64 X64Emitter::GetNativeParam(uint32_t param) {
   if (param == 0)
     return rdx;
@@ -1641,8 +2087,120 @@ Xbyak::Label& X64Emitter::NewCachedLabel() {
   return *tmp;
 }
 
+void X64Emitter::PrepareBlockEntryMxcsrModes(HIRBuilder* builder) {
+  block_entry_mxcsr_modes_.clear();
+  if (!cvars::propagate_mxcsr_mode) {
+    return;
+  }
+  // Blocks are numbered in order by the finalization pass, if it hasn't been
+  // run, the mode is not propagated.
+  size_t block_count = block_layout_positions_.size();
+  if (!block_count) {
+    return;
+  }
+  block_entry_mxcsr_modes_.resize(block_count);
+  // Entered from the prolog, with the mode left by the caller.
+  block_entry_mxcsr_modes_[0].reached = true;
+  // The blocks branched or falling through to from themselves or blocks
+  // emitted after them are emitted before the mode at the branches is known.
+  for (auto block = builder->first_block(); block; block = block->next) {
+    size_t position = block_layout_positions_[block->ordinal];
+    if (block->next && !EndsWithUnconditionalBranch(block) &&
+        block_layout_positions_[block->next->ordinal] <= position) {
+      MergeBlockEntryMxcsrMode(block->next, MXCSRMode::Unknown);
+    }
+    for (auto instr = block->instr_head; instr; instr = instr->next) {
+      uint32_t signature = instr->opcode->signature;
+      hir::Label* labels[] = {
+          GET_OPCODE_SIG_TYPE_SRC1(signature) == hir::OPCODE_SIG_TYPE_L
+              ? instr->src1.label
+              : nullptr,
+          GET_OPCODE_SIG_TYPE_SRC2(signature) == hir::OPCODE_SIG_TYPE_L
+              ? instr->src2.label
+              : nullptr,
+          GET_OPCODE_SIG_TYPE_SRC3(signature) == hir::OPCODE_SIG_TYPE_L
+              ? instr->src3.label
+              : nullptr,
+      };
+      for (hir::Label* label : labels) {
+        if (label && label->block &&
+            block_layout_positions_[label->block->ordinal] <= position) {
+          MergeBlockEntryMxcsrMode(label->block, MXCSRMode::Unknown);
+        }
+      }
+    }
+  }
+}
+
+void X64Emitter::MergeBlockEntryMxcsrMode(const hir::Block* block,
+                                          MXCSRMode mode) {
+  if (block->ordinal >= block_entry_mxcsr_modes_.size()) {
+    return;
+  }
+  BlockEntryMxcsrMode& entry_mode = block_entry_mxcsr_modes_[block->ordinal];
+  if (!entry_mode.reached) {
+    entry_mode.reached = true;
+    entry_mode.mode = mode;
+  } else if (entry_mode.mode != mode) {
+    entry_mode.mode = MXCSRMode::Unknown;
+  }
+}
+
+void X64Emitter::MergeBranchTargetMxcsrModes(const Instr* instr,
+                                             MXCSRMode mode) {
+  uint32_t signature = instr->opcode->signature;
+  if (GET_OPCODE_SIG_TYPE_SRC1(signature) == hir::OPCODE_SIG_TYPE_L &&
+      instr->src1.label->block) {
+    MergeBlockEntryMxcsrMode(instr->src1.label->block, mode);
+  }
+  if (GET_OPCODE_SIG_TYPE_SRC2(signature) == hir::OPCODE_SIG_TYPE_L &&
+      instr->src2.label->block) {
+    MergeBlockEntryMxcsrMode(instr->src2.label->block, mode);
+  }
+  if (GET_OPCODE_SIG_TYPE_SRC3(signature) == hir::OPCODE_SIG_TYPE_L &&
+      instr->src3.label->block) {
+    MergeBlockEntryMxcsrMode(instr->src3.label->block, mode);
+  }
+}
+
+MXCSRMode X64Emitter::GetBlockEntryMxcsrMode(const hir::Block* block) const {
+  if (block->ordinal >= block_entry_mxcsr_modes_.size()) {
+    return MXCSRMode::Unknown;
+  }
+  const BlockEntryMxcsrMode& entry_mode =
+      block_entry_mxcsr_modes_[block->ordinal];
+  // Not reached from anywhere if unreachable.
+  return entry_mode.reached ? entry_mode.mode : MXCSRMode::Unknown;
+}
+
+bool X64Emitter::EndsWithUnconditionalBranch(const hir::Block* block) {
+  const Instr* tail = block->instr_tail;
+  while (tail && tail->IsFake()) {
+    tail = tail->prev;
+  }
+  if (!tail) {
+    return false;
+  }
+  if (tail->opcode == &hir::OPCODE_CALL_info ||
+      tail->opcode == &hir::OPCODE_CALL_INDIRECT_info) {
+    return (tail->flags & hir::CALL_TAIL) != 0;
+  }
+  return tail->opcode == &hir::OPCODE_BRANCH_info ||
+         tail->opcode == &hir::OPCODE_RETURN_info;
+}
+
+void X64Emitter::CountMxcsrStatistic(size_t counter_offset) {
+  if (!cvars::mxcsr_statistics) {
+    return;
+  }
+  Xbyak::Address counter = GetBackendCtxPtr(int(counter_offset));
+  counter.setBit(64);
+  inc(counter);
+}
+
 template <bool switching_to_fpu>
 static void ChangeMxcsrModeDynamicHelper(X64Emitter& e) {
+  e.CountMxcsrStatistic(offsetof(X64BackendContext, mxcsr_check_count));
   auto flags = e.GetBackendFlagsPtr();
   if (switching_to_fpu) {
     e.btr(flags, 0);  // bit 0 set to 0 = is fpu mode
@@ -1721,9 +2279,11 @@ bool X64Emitter::ChangeMxcsrMode(MXCSRMode new_mode, bool already_set) {
   return false;
 }
 void X64Emitter::LoadFpuMxcsrDirect() {
+  CountMxcsrStatistic(offsetof(X64BackendContext, mxcsr_switch_count));
   vldmxcsr(GetBackendCtxPtr(offsetof(X64BackendContext, mxcsr_fpu)));
 }
 void X64Emitter::LoadVmxMxcsrDirect() {
+  CountMxcsrStatistic(offsetof(X64BackendContext, mxcsr_switch_count));
   vldmxcsr(GetBackendCtxPtr(offsetof(X64BackendContext, mxcsr_vmx)));
 }
 Xbyak::Address X64Emitter::GetBackendFlagsPtr() const {
@@ -1743,8 +2303,16 @@ void X64Emitter::HandleStackpointOverflowError(ppc::PPCContext* context) {
       "Xenia developers.");
 }
 
+uint64_t X64Emitter::RequestTierUp(void* raw_context, uint64_t function) {
+  auto guest_context = reinterpret_cast<ppc::PPCContext_s*>(raw_context);
+  guest_context->thread_state->processor()->RequestFunctionTierUp(
+      reinterpret_cast<GuestFunction*>(function));
+  return 0;
+}
+
 void X64Emitter::PushStackpoint() {
-  if (!cvars::enable_host_guest_stack_synchronization) {
+  if (!cvars::enable_host_guest_stack_synchronization ||
+      cvars::lazy_host_guest_stack_synchronization) {
     return;
   }
   // push the current host and guest stack pointers
@@ -1788,7 +2356,8 @@ void X64Emitter::PushStackpoint() {
   jge(overflowed_stackpoints, T_NEAR);
 }
 void X64Emitter::PopStackpoint() {
-  if (!cvars::enable_host_guest_stack_synchronization) {
+  if (!cvars::enable_host_guest_stack_synchronization ||
+      cvars::lazy_host_guest_stack_synchronization) {
     return;
   }
   // todo: maybe verify that rsp and r1 == the stackpoint?
@@ -1798,6 +2367,22 @@ void X64Emitter::PopStackpoint() {
   dec(stackpoint_pos_pointer);
 }
 
+void X64Emitter::StoreLazyStackpoint() {
+  if (!cvars::enable_host_guest_stack_synchronization ||
+      !cvars::lazy_host_guest_stack_synchronization) {
+    return;
+  }
+  // Only plain stores to the frame, the stackpoint is reconstructed from them
+  // by X64Backend::ReconstructStackpoints when the stacks need to be
+  // synchronized.
+  mov(eax, dword[GetContextReg() + offsetof(ppc::PPCContext, r[1])]);
+  mov(dword[rsp + StackLayout::GUEST_ENTRY_STACK], eax);
+  mov(eax, dword[GetContextReg() + offsetof(ppc::PPCContext, lr)]);
+  mov(dword[rsp + StackLayout::GUEST_ENTRY_LR], eax);
+  mov(dword[rsp + StackLayout::GUEST_FRAME_SIZE],
+      static_cast<uint32_t>(stack_size()));
+}
+
 void X64Emitter::EnsureSynchronizedGuestAndHostStack() {
   if (!cvars::enable_host_guest_stack_synchronization) {
     return;
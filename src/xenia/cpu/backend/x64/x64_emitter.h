@@ -13,6 +13,8 @@
 #include <vector>
 
 #include "xenia/base/arena.h"
+#include "xenia/cpu/backend/assembler.h"
+#include "xenia/cpu/backend/x64/x64_code_cache.h"
 #include "xenia/cpu/function.h"
 #include "xenia/cpu/function_trace_data.h"
 #include "xenia/cpu/hir/hir_builder.h"
@@ -37,6 +39,7 @@ namespace x64 {
 using namespace amd64;
 class X64Backend;
 class X64CodeCache;
+class X64Function;
 
 struct EmitFunctionInfo;
 
@@ -221,6 +224,13 @@ class X64Emitter : public Xbyak::CodeGenerator {
             void** out_code_address, size_t* out_code_size,
             std::vector<SourceMapEntry>* out_source_map);
 
+  void set_pipeline_fingerprint(uint64_t pipeline_fingerprint) {
+    pipeline_fingerprint_ = pipeline_fingerprint;
+  }
+  void set_compilation_tier(CompilationTier compilation_tier) {
+    compilation_tier_ = compilation_tier;
+  }
+
  public:
   // Reserved:  rsp, rsi, rdi
   // Scratch:   rax/rcx/rdx
@@ -251,7 +261,26 @@ class X64Emitter : public Xbyak::CodeGenerator {
     r = Xbyak::Xmm(idx);
   }
 
+  // Layout of the inline cache of an indirect call site, entries of
+  // cmp ebx, target; jne next; call target_code; jmp done; int3; int3, followed
+  // by a jmp to the miss handler and the call through the indirection table.
+  static constexpr uint32_t kIndirectCallInlineCacheEntryCount = 4;
+  static constexpr uint32_t kIndirectCallInlineCacheEntrySize = 20;
+  static constexpr uint32_t kIndirectCallInlineCacheEntryAddressOffset = 2;
+  static constexpr uint32_t kIndirectCallInlineCacheEntryCallOffset = 9;
+  static constexpr uint32_t kIndirectCallInlineCacheEntryCallEnd = 13;
+  static constexpr uint32_t kIndirectCallInlineCacheMissJumpOffset =
+      kIndirectCallInlineCacheEntryCount * kIndirectCallInlineCacheEntrySize +
+      2;
+  static constexpr uint32_t kIndirectCallInlineCacheEmptyEntry = UINT32_MAX;
+
   Xbyak::Label& epilog_label() { return *epilog_label_; }
+  // Whether the block is emitted right before the epilog, so returning from
+  // its end only needs to fall through.
+  bool IsLastBlockBeforeEpilog(const hir::Block* block) const {
+    return hot_block_count_ &&
+           block_layout_[hot_block_count_ - 1].block == block;
+  }
 
   void MarkSourceOffset(const hir::Instr* i);
 
@@ -270,6 +299,13 @@ class X64Emitter : public Xbyak::CodeGenerator {
   void CallNativeSafe(void* fn);
   void SetReturnAddress(uint64_t value);
 
+  // Loads a pointer to a function or data in the host executable, recording it
+  // so the code can be rebased when loaded from the persistent code storage.
+  void MovImagePointer(const Xbyak::Reg64& reg, const void* ptr);
+  // Excludes the function being emitted from the persistent code storage, for
+  // code depending on pointers to host objects that differ between runs.
+  void MarkNotStorable() { storable_ = false; }
+
   Xbyak::Reg64 GetNativeParam(uint32_t param);
 
   Xbyak::Reg64 GetContextReg() const;
@@ -307,6 +343,9 @@ class X64Emitter : public Xbyak::CodeGenerator {
 
   void PushStackpoint();
   void PopStackpoint();
+  // Stores the values the stackpoint of the function is made of in its frame
+  // with lazy_host_guest_stack_synchronization, in the body.
+  void StoreLazyStackpoint();
 
   void EnsureSynchronizedGuestAndHostStack();
   FunctionDebugInfo* debug_info() const { return debug_info_; }
@@ -327,6 +366,9 @@ class X64Emitter : public Xbyak::CodeGenerator {
 
   void LoadFpuMxcsrDirect();  // unsafe, does not change mxcsr_mode_
   void LoadVmxMxcsrDirect();  // unsafe, does not change mxcsr_mode_
+  // Increments the X64BackendContext counter at the offset if mxcsr_statistics
+  // is enabled. Changes the flags.
+  void CountMxcsrStatistic(size_t counter_offset);
 
   XexModule* GuestModule() { return guest_module_; }
 
@@ -393,6 +435,10 @@ class X64Emitter : public Xbyak::CodeGenerator {
   void EmitGetCurrentThreadId();
   void EmitTraceUserCallReturn();
   static void HandleStackpointOverflowError(ppc::PPCContext* context);
+  static uint64_t RequestTierUp(void* raw_context, uint64_t function);
+  void EmitIndirectCallInlineCache();
+  static uint64_t IndirectCallInlineCacheMiss(void* raw_context, uint64_t site,
+                                              uint64_t target_address);
 
  protected:
   Processor* processor_ = nullptr;
@@ -405,6 +451,8 @@ class X64Emitter : public Xbyak::CodeGenerator {
   Xbyak::util::Cpu cpu_;
   uint64_t feature_flags_ = 0;
   uint32_t current_guest_function_ = 0;
+  // Guest address of the last source offset marked.
+  uint32_t current_guest_address_ = 0;
   Xbyak::Label* epilog_label_ = nullptr;
 
   hir::Instr* current_instr_ = nullptr;
@@ -416,6 +464,17 @@ class X64Emitter : public Xbyak::CodeGenerator {
 
   size_t stack_size_ = 0;
 
+  // Persistent code storage state of the function being emitted.
+  bool storable_ = true;
+  std::vector<ImageRelocation> image_relocations_;
+  uint64_t pipeline_fingerprint_ = 0;
+
+  CompilationTier compilation_tier_ = CompilationTier::kOptimized;
+  // Function whose call counter the baseline code being emitted decrements.
+  X64Function* tier_up_function_ = nullptr;
+  // Call counter of the function being emitted if jit_statistics is enabled.
+  uint64_t* sampled_call_count_ = nullptr;
+
   static const uint32_t gpr_reg_map_[GPR_COUNT];
   static const uint32_t xmm_reg_map_[XMM_COUNT];
   /*
@@ -429,6 +488,46 @@ class X64Emitter : public Xbyak::CodeGenerator {
       label_cache_;  // for creating labels that need to be referenced much
                      // later by tail emitters
   MXCSRMode mxcsr_mode_ = MXCSRMode::Unknown;
+
+  // Mode at the start of each block by ordinal, merged from the modes at the
+  // branches to it and at the end of the previous block if it falls through.
+  struct BlockEntryMxcsrMode {
+    bool reached = false;
+    MXCSRMode mode = MXCSRMode::Unknown;
+  };
+  void PrepareBlockEntryMxcsrModes(hir::HIRBuilder* builder);
+  void MergeBlockEntryMxcsrMode(const hir::Block* block, MXCSRMode mode);
+  void MergeBranchTargetMxcsrModes(const hir::Instr* instr, MXCSRMode mode);
+  MXCSRMode GetBlockEntryMxcsrMode(const hir::Block* block) const;
+  static bool EndsWithUnconditionalBranch(const hir::Block* block);
+  std::vector<BlockEntryMxcsrMode> block_entry_mxcsr_modes_;
+
+  // Blocks in the order they're emitted - the hot blocks, followed by the
+  // epilog and the cold blocks if laid out with a block profile, otherwise all
+  // blocks in the HIR order before the epilog.
+  struct BlockLayoutEntry {
+    hir::Block* block;
+    // Start of a hot loop, aligned unless all blocks are.
+    bool align;
+  };
+  void ComputeBlockLayout(hir::HIRBuilder* builder);
+  void EmitBlock(size_t layout_index);
+  // Guest address of the first instruction of the block if it's in the
+  // function being emitted, for the block profile.
+  bool GetBlockProfileAddress(const hir::Block* block,
+                              uint32_t& address_out) const;
+  void PrepareBlockProfileCounters(hir::HIRBuilder* builder);
+  std::vector<BlockLayoutEntry> block_layout_;
+  size_t hot_block_count_ = 0;
+  // Position in block_layout_ by block ordinal if the blocks are numbered in
+  // order, for blocks falling through to ones not emitted right after them.
+  std::vector<size_t> block_layout_positions_;
+  // Labels at the start of the blocks by ordinal if reordered.
+  std::vector<Xbyak::Label*> block_start_labels_;
+  // Counters of the blocks by ordinal if profiling the baseline code.
+  std::vector<uint64_t*> block_profile_counters_;
+  // Function the blocks of which are being profiled or laid out.
+  X64Function* block_profile_function_ = nullptr;
 };
 
 }  // namespace x64
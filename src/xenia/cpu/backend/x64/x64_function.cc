@@ -9,6 +9,9 @@
 
 #include "xenia/cpu/backend/x64/x64_function.h"
 
+#include <algorithm>
+
+#include "xenia/base/assert.h"
 #include "xenia/cpu/backend/x64/x64_backend.h"
 #include "xenia/cpu/processor.h"
 #include "xenia/cpu/thread_state.h"
@@ -30,6 +33,28 @@ void X64Function::Setup(uint8_t* machine_code, size_t machine_code_length) {
   machine_code_length_ = machine_code_length;
 }
 
+void X64Function::SetupBlockProfile(std::vector<uint32_t> block_addresses) {
+  assert_false(has_block_profile());
+  block_profile_addresses_ = std::move(block_addresses);
+  block_profile_counts_ =
+      std::make_unique<uint64_t[]>(block_profile_addresses_.size());
+}
+
+uint64_t X64Function::GetBlockProfileCount(uint32_t guest_address) const {
+  if (!has_block_profile()) {
+    return UINT64_MAX;
+  }
+  // Blocks of the baseline code are in guest order, so the guest address is in
+  // the last block starting before it.
+  auto it = std::upper_bound(block_profile_addresses_.cbegin(),
+                             block_profile_addresses_.cend(), guest_address);
+  if (it == block_profile_addresses_.cbegin()) {
+    return UINT64_MAX;
+  }
+  return block_profile_counts_[size_t(it - block_profile_addresses_.cbegin()) -
+                               1];
+}
+
 bool X64Function::CallImpl(ThreadState* thread_state, uint32_t return_address) {
   auto backend =
       reinterpret_cast<X64Backend*>(thread_state->processor()->backend());
@@ -10,6 +10,11 @@
 #ifndef XENIA_CPU_BACKEND_X64_X64_FUNCTION_H_
 #define XENIA_CPU_BACKEND_X64_X64_FUNCTION_H_
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 #include "xenia/cpu/function.h"
 #include "xenia/cpu/thread_state.h"
 
@@ -28,12 +33,47 @@ class X64Function : public GuestFunction {
 
   void Setup(uint8_t* machine_code, size_t machine_code_length);
 
+  // Whether the machine code is in the persistent code storage, and will be
+  // restored to the same location on the next run.
+  bool code_stored() const { return code_stored_; }
+  void set_code_stored(bool code_stored) { code_stored_ = code_stored; }
+
+  // Whether the machine code is from the baseline pass pipeline and is going to
+  // be replaced, so it must only be called through the indirection table.
+  // Cleared after the optimized code has been set up.
+  bool is_baseline() const { return baseline_.load(std::memory_order_acquire); }
+  void set_baseline(bool baseline) {
+    baseline_.store(baseline, std::memory_order_release);
+  }
+  // Decremented by the baseline code on every call, the optimized
+  // retranslation is requested when it reaches zero.
+  uint32_t* tier_up_counter() { return &tier_up_counter_; }
+  void set_tier_up_counter(uint32_t value) { tier_up_counter_ = value; }
+
+  // Execution counts of the blocks of the baseline code, by the guest address
+  // of their first instruction in ascending order, incremented by the baseline
+  // code if profile_guided_block_layout is enabled. Kept while the function
+  // exists, as the baseline code may still be running after tiering up.
+  bool has_block_profile() const { return block_profile_counts_ != nullptr; }
+  const std::vector<uint32_t>& block_profile_addresses() const {
+    return block_profile_addresses_;
+  }
+  uint64_t* block_profile_counts() const { return block_profile_counts_.get(); }
+  void SetupBlockProfile(std::vector<uint32_t> block_addresses);
+  // Count of the block containing the guest address, or UINT64_MAX if unknown.
+  uint64_t GetBlockProfileCount(uint32_t guest_address) const;
+
  protected:
   bool CallImpl(ThreadState* thread_state, uint32_t return_address) override;
 
  private:
   uint8_t* machine_code_ = nullptr;
   size_t machine_code_length_ = 0;
+  bool code_stored_ = false;
+  std::atomic<bool> baseline_{false};
+  uint32_t tier_up_counter_ = 0;
+  std::vector<uint32_t> block_profile_addresses_;
+  std::unique_ptr<uint64_t[]> block_profile_counts_;
 };
 
 }  // namespace x64
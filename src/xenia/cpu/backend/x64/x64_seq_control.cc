@@ -417,9 +417,9 @@ EMITTER_OPCODE_TABLE(OPCODE_CALL_EXTERN, CALL_EXTERN);
 // ============================================================================
 struct RETURN : Sequence<RETURN, I<OPCODE_RETURN, VoidOp>> {
   static void Emit(X64Emitter& e, const EmitArgType& i) {
-    // If this is the last instruction in the last block, just let us
-    // fall through.
-    if (i.instr->next || i.instr->block->next) {
+    // If this is the last instruction in the last block emitted before the
+    // epilog, just let us fall through.
+    if (i.instr->next || !e.IsLastBlockBeforeEpilog(i.instr->block)) {
       e.jmp(e.epilog_label(), CodeGenerator::T_NEAR);
     }
   }
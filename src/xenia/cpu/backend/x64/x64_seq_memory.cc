@@ -182,8 +182,65 @@ static bool is_eo_def(const hir::Value* v) {
   return false;
 }
 
+// Upper bound of the unsigned value, for proving that an address can't be in
+// 0xE0000000+ without the range check. Exact, unlike elide_e0_check, so always
+// used.
+static uint64_t GetUnsignedValueBound(const hir::Value* v, uint32_t depth = 0) {
+  uint64_t type_max;
+  switch (v->type) {
+    case INT8_TYPE:
+      type_max = UINT8_MAX;
+      break;
+    case INT16_TYPE:
+      type_max = UINT16_MAX;
+      break;
+    case INT32_TYPE:
+      type_max = UINT32_MAX;
+      break;
+    default:
+      type_max = UINT64_MAX;
+      break;
+  }
+  if (v->IsConstant()) {
+    return v->constant.u64 & type_max;
+  }
+  const hir::Instr* df = v->def;
+  if (!df || depth >= 8) {
+    return type_max;
+  }
+  switch (df->opcode->num) {
+    case OPCODE_ASSIGN:
+    case OPCODE_ZERO_EXTEND:
+      return std::min(type_max,
+                      GetUnsignedValueBound(df->src1.value, depth + 1));
+    case OPCODE_AND:
+      return std::min(GetUnsignedValueBound(df->src1.value, depth + 1),
+                      GetUnsignedValueBound(df->src2.value, depth + 1));
+    case OPCODE_ADD:
+    case OPCODE_OR: {
+      // a | b <= a + b.
+      uint64_t a = GetUnsignedValueBound(df->src1.value, depth + 1);
+      uint64_t b = GetUnsignedValueBound(df->src2.value, depth + 1);
+      return a <= type_max - b ? a + b : type_max;
+    }
+    case OPCODE_SHR:
+      if (df->src2.value->IsConstant()) {
+        return GetUnsignedValueBound(df->src1.value, depth + 1) >>
+               (df->src2.value->constant.u8 & 63);
+      }
+      return type_max;
+    default:
+      return type_max;
+  }
+}
+
 template <typename T>
-static bool is_definitely_not_eo(const T& v) {
+static bool is_definitely_not_eo(const T& v, int32_t offset = 0) {
+  // Negative offsets may wrap the address to 0xE0000000+.
+  if (offset >= 0 &&
+      GetUnsignedValueBound(v.value) < uint64_t(0xE0000000) - offset) {
+    return true;
+  }
   if (!cvars::elide_e0_check) {
     return false;
   }
@@ -263,7 +320,7 @@ RegExp ComputeMemoryAddressOffset(X64Emitter& e, const T& guest,
     }
   } else {
     if (xe::memory::allocation_granularity() > 0x1000 &&
-        !is_definitely_not_eo(guest)) {
+        !is_definitely_not_eo(guest, offset_const)) {
       // Emulate the 4 KB physical address offset in 0xE0000000+ when can't do
       // it via memory mapping.
 
@@ -560,6 +617,68 @@ struct RESERVED_STORE_INT64
 EMITTER_OPCODE_TABLE(OPCODE_RESERVED_STORE, RESERVED_STORE_INT32,
                      RESERVED_STORE_INT64);
 
+// ============================================================================
+// OPCODE_SPIN_WAIT
+// ============================================================================
+template <typename T>
+static void EmitSpinWait(X64Emitter& e, const T& i, uint32_t size) {
+  Xbyak::Label skip;
+  if (i.src1.is_constant) {
+    if (!i.src1.constant()) {
+      return;
+    }
+  } else {
+    e.test(i.src1, i.src1);
+    e.jz(skip, e.T_NEAR);
+  }
+  if (i.src2.is_constant) {
+    e.mov(e.GetNativeParam(0).cvt32(), uint32_t(i.src2.constant()));
+  } else {
+    e.mov(e.GetNativeParam(0).cvt32(), i.src2.reg().cvt32());
+  }
+  if (i.src3.is_constant) {
+    e.mov(e.GetNativeParam(1), uint64_t(i.src3.constant()));
+  } else if (size == 8) {
+    e.mov(e.GetNativeParam(1), i.src3.reg().cvt64());
+  } else if (size == 4) {
+    e.mov(e.GetNativeParam(1).cvt32(), i.src3.reg().cvt32());
+  } else {
+    e.movzx(e.GetNativeParam(1).cvt32(), i.src3.reg());
+  }
+  e.mov(e.GetNativeParam(2), (uint64_t(size) << 8) | i.instr->flags);
+  e.CallNativeSafe(reinterpret_cast<void*>(X64Backend::SpinWaitThunk));
+  e.L(skip);
+}
+struct SPIN_WAIT_I8
+    : Sequence<SPIN_WAIT_I8, I<OPCODE_SPIN_WAIT, VoidOp, I8Op, I64Op, I8Op>> {
+  static void Emit(X64Emitter& e, const EmitArgType& i) {
+    EmitSpinWait(e, i, 1);
+  }
+};
+struct SPIN_WAIT_I16
+    : Sequence<SPIN_WAIT_I16,
+               I<OPCODE_SPIN_WAIT, VoidOp, I8Op, I64Op, I16Op>> {
+  static void Emit(X64Emitter& e, const EmitArgType& i) {
+    EmitSpinWait(e, i, 2);
+  }
+};
+struct SPIN_WAIT_I32
+    : Sequence<SPIN_WAIT_I32,
+               I<OPCODE_SPIN_WAIT, VoidOp, I8Op, I64Op, I32Op>> {
+  static void Emit(X64Emitter& e, const EmitArgType& i) {
+    EmitSpinWait(e, i, 4);
+  }
+};
+struct SPIN_WAIT_I64
+    : Sequence<SPIN_WAIT_I64,
+               I<OPCODE_SPIN_WAIT, VoidOp, I8Op, I64Op, I64Op>> {
+  static void Emit(X64Emitter& e, const EmitArgType& i) {
+    EmitSpinWait(e, i, 8);
+  }
+};
+EMITTER_OPCODE_TABLE(OPCODE_SPIN_WAIT, SPIN_WAIT_I8, SPIN_WAIT_I16,
+                     SPIN_WAIT_I32, SPIN_WAIT_I64);
+
 // ============================================================================
 // OPCODE_ATOMIC_COMPARE_EXCHANGE
 // ============================================================================
@@ -1126,6 +1245,7 @@ struct LOAD_MMIO_I32
     // uint64_t (context, addr)
     auto mmio_range = reinterpret_cast<MMIORange*>(i.src1.value);
     auto read_address = uint32_t(i.src2.value);
+    e.MarkNotStorable();
     e.mov(e.GetNativeParam(0), uint64_t(mmio_range->callback_context));
     e.mov(e.GetNativeParam(1).cvt32(), read_address);
     e.CallNativeSafe(reinterpret_cast<void*>(mmio_range->read));
@@ -1151,6 +1271,7 @@ struct STORE_MMIO_I32
     // void (context, addr, value)
     auto mmio_range = reinterpret_cast<MMIORange*>(i.src1.value);
     auto write_address = uint32_t(i.src2.value);
+    e.MarkNotStorable();
     e.mov(e.GetNativeParam(0), uint64_t(mmio_range->callback_context));
     e.mov(e.GetNativeParam(1).cvt32(), write_address);
     if (i.src3.is_constant) {
@@ -1249,6 +1370,47 @@ struct LOAD_OFFSET_I8
   }
 };
 
+// Byte-swapping store of an integer, with movbe when available, otherwise
+// swapped in rcx as rax may be holding the address. Constants are swapped while
+// translating.
+template <typename T>
+static void EmitByteSwappedStore(X64Emitter& e, const RegExp& addr,
+                                 const T& src) {
+  using reg_type = typename T::reg_type;
+  if constexpr (std::is_same_v<reg_type, Reg16>) {
+    if (src.is_constant) {
+      e.mov(e.word[addr], xe::byte_swap(uint16_t(src.constant())));
+    } else if (e.IsFeatureEnabled(kX64EmitMovbe)) {
+      e.movbe(e.word[addr], src);
+    } else {
+      e.mov(e.cx, src);
+      e.ror(e.cx, 8);
+      e.mov(e.word[addr], e.cx);
+    }
+  } else if constexpr (std::is_same_v<reg_type, Reg32>) {
+    if (src.is_constant) {
+      e.mov(e.dword[addr], xe::byte_swap(uint32_t(src.constant())));
+    } else if (e.IsFeatureEnabled(kX64EmitMovbe)) {
+      e.movbe(e.dword[addr], src);
+    } else {
+      e.mov(e.ecx, src);
+      e.bswap(e.ecx);
+      e.mov(e.dword[addr], e.ecx);
+    }
+  } else {
+    static_assert(std::is_same_v<reg_type, Reg64>);
+    if (src.is_constant) {
+      e.MovMem64(addr, xe::byte_swap(uint64_t(src.constant())));
+    } else if (e.IsFeatureEnabled(kX64EmitMovbe)) {
+      e.movbe(e.qword[addr], src);
+    } else {
+      e.mov(e.rcx, src);
+      e.bswap(e.rcx);
+      e.mov(e.qword[addr], e.rcx);
+    }
+  }
+}
+
 struct LOAD_OFFSET_I16
     : Sequence<LOAD_OFFSET_I16, I<OPCODE_LOAD_OFFSET, I16Op, I64Op, I64Op>> {
   static void Emit(X64Emitter& e, const EmitArgType& i) {
@@ -1347,12 +1509,7 @@ struct STORE_OFFSET_I16
   static void Emit(X64Emitter& e, const EmitArgType& i) {
     auto addr = ComputeMemoryAddressOffset(e, i.src1, i.src2);
     if (i.instr->flags & LoadStoreFlags::LOAD_STORE_BYTE_SWAP) {
-      assert_false(i.src3.is_constant);
-      if (e.IsFeatureEnabled(kX64EmitMovbe)) {
-        e.movbe(e.word[addr], i.src3);
-      } else {
-        assert_always("not implemented");
-      }
+      EmitByteSwappedStore(e, addr, i.src3);
     } else {
       if (i.src3.is_constant) {
         if (i.src3.constant() == 0 && e.CanUseMembaseLow32As0()) {
@@ -1397,12 +1554,7 @@ struct STORE_OFFSET_I32
     } else {
       auto addr = ComputeMemoryAddressOffset(e, i.src1, i.src2);
       if (i.instr->flags & LoadStoreFlags::LOAD_STORE_BYTE_SWAP) {
-        assert_false(i.src3.is_constant);
-        if (e.IsFeatureEnabled(kX64EmitMovbe)) {
-          e.movbe(e.dword[addr], i.src3);
-        } else {
-          assert_always("not implemented");
-        }
+        EmitByteSwappedStore(e, addr, i.src3);
       } else {
         if (i.src3.is_constant) {
           if (i.src3.constant() == 0 && e.CanUseMembaseLow32As0()) {
@@ -1424,12 +1576,7 @@ struct STORE_OFFSET_I64
   static void Emit(X64Emitter& e, const EmitArgType& i) {
     auto addr = ComputeMemoryAddressOffset(e, i.src1, i.src2);
     if (i.instr->flags & LoadStoreFlags::LOAD_STORE_BYTE_SWAP) {
-      assert_false(i.src3.is_constant);
-      if (e.IsFeatureEnabled(kX64EmitMovbe)) {
-        e.movbe(e.qword[addr], i.src3);
-      } else {
-        assert_always("not implemented");
-      }
+      EmitByteSwappedStore(e, addr, i.src3);
     } else {
       if (i.src3.is_constant) {
         e.MovMem64(addr, i.src3.constant());
@@ -1535,9 +1682,16 @@ struct LOAD_I64 : Sequence<LOAD_I64, I<OPCODE_LOAD, I64Op, I64Op>> {
 struct LOAD_F32 : Sequence<LOAD_F32, I<OPCODE_LOAD, F32Op, I64Op>> {
   static void Emit(X64Emitter& e, const EmitArgType& i) {
     auto addr = ComputeMemoryAddress(e, i.src1);
-    e.vmovss(i.dest, e.dword[addr]);
     if (i.instr->flags & LoadStoreFlags::LOAD_STORE_BYTE_SWAP) {
-      assert_always("not implemented yet");
+      if (e.IsFeatureEnabled(kX64EmitMovbe)) {
+        e.movbe(e.ecx, e.dword[addr]);
+      } else {
+        e.mov(e.ecx, e.dword[addr]);
+        e.bswap(e.ecx);
+      }
+      e.vmovd(i.dest, e.ecx);
+    } else {
+      e.vmovss(i.dest, e.dword[addr]);
     }
     if (IsTracingData()) {
       e.lea(e.GetNativeParam(1), e.dword[addr]);
@@ -1549,9 +1703,16 @@ struct LOAD_F32 : Sequence<LOAD_F32, I<OPCODE_LOAD, F32Op, I64Op>> {
 struct LOAD_F64 : Sequence<LOAD_F64, I<OPCODE_LOAD, F64Op, I64Op>> {
   static void Emit(X64Emitter& e, const EmitArgType& i) {
     auto addr = ComputeMemoryAddress(e, i.src1);
-    e.vmovsd(i.dest, e.qword[addr]);
     if (i.instr->flags & LoadStoreFlags::LOAD_STORE_BYTE_SWAP) {
-      assert_always("not implemented yet");
+      if (e.IsFeatureEnabled(kX64EmitMovbe)) {
+        e.movbe(e.rcx, e.qword[addr]);
+      } else {
+        e.mov(e.rcx, e.qword[addr]);
+        e.bswap(e.rcx);
+      }
+      e.vmovq(i.dest, e.rcx);
+    } else {
+      e.vmovsd(i.dest, e.qword[addr]);
     }
     if (IsTracingData()) {
       e.lea(e.GetNativeParam(1), e.qword[addr]);
@@ -1564,7 +1725,11 @@ struct LOAD_V128 : Sequence<LOAD_V128, I<OPCODE_LOAD, V128Op, I64Op>> {
   static void Emit(X64Emitter& e, const EmitArgType& i) {
     auto addr = ComputeMemoryAddress(e, i.src1);
     // TODO(benvanik): we should try to stick to movaps if possible.
-    e.vmovdqa(i.dest, e.ptr[addr]);
+    if (i.instr->flags & LoadStoreFlags::LOAD_STORE_UNALIGNED) {
+      e.vmovdqu(i.dest, e.ptr[addr]);
+    } else {
+      e.vmovdqa(i.dest, e.ptr[addr]);
+    }
     if (i.instr->flags & LoadStoreFlags::LOAD_STORE_BYTE_SWAP) {
       // TODO(benvanik): find a way to do this without the memory load.
       e.vpshufb(i.dest, i.dest, e.GetXmmConstPtr(XMMByteSwapMask));
@@ -1603,12 +1768,7 @@ struct STORE_I16 : Sequence<STORE_I16, I<OPCODE_STORE, VoidOp, I64Op, I16Op>> {
   static void Emit(X64Emitter& e, const EmitArgType& i) {
     auto addr = ComputeMemoryAddress(e, i.src1);
     if (i.instr->flags & LoadStoreFlags::LOAD_STORE_BYTE_SWAP) {
-      assert_false(i.src2.is_constant);
-      if (e.IsFeatureEnabled(kX64EmitMovbe)) {
-        e.movbe(e.word[addr], i.src2);
-      } else {
-        assert_always("not implemented");
-      }
+      EmitByteSwappedStore(e, addr, i.src2);
     } else {
       if (i.src2.is_constant) {
         e.mov(e.word[addr], i.src2.constant());
@@ -1647,12 +1807,7 @@ struct STORE_I32 : Sequence<STORE_I32, I<OPCODE_STORE, VoidOp, I64Op, I32Op>> {
     } else {
       auto addr = ComputeMemoryAddress(e, i.src1);
       if (i.instr->flags & LoadStoreFlags::LOAD_STORE_BYTE_SWAP) {
-        assert_false(i.src2.is_constant);
-        if (e.IsFeatureEnabled(kX64EmitMovbe)) {
-          e.movbe(e.dword[addr], i.src2);
-        } else {
-          assert_always("not implemented");
-        }
+        EmitByteSwappedStore(e, addr, i.src2);
       } else {
         if (i.src2.is_constant) {
           e.mov(e.dword[addr], i.src2.constant());
@@ -1672,12 +1827,7 @@ struct STORE_I64 : Sequence<STORE_I64, I<OPCODE_STORE, VoidOp, I64Op, I64Op>> {
   static void Emit(X64Emitter& e, const EmitArgType& i) {
     auto addr = ComputeMemoryAddress(e, i.src1);
     if (i.instr->flags & LoadStoreFlags::LOAD_STORE_BYTE_SWAP) {
-      assert_false(i.src2.is_constant);
-      if (e.IsFeatureEnabled(kX64EmitMovbe)) {
-        e.movbe(e.qword[addr], i.src2);
-      } else {
-        assert_always("not implemented");
-      }
+      EmitByteSwappedStore(e, addr, i.src2);
     } else {
       if (i.src2.is_constant) {
         e.MovMem64(addr, i.src2.constant());
@@ -1697,8 +1847,18 @@ struct STORE_F32 : Sequence<STORE_F32, I<OPCODE_STORE, VoidOp, I64Op, F32Op>> {
   static void Emit(X64Emitter& e, const EmitArgType& i) {
     auto addr = ComputeMemoryAddress(e, i.src1);
     if (i.instr->flags & LoadStoreFlags::LOAD_STORE_BYTE_SWAP) {
-      assert_false(i.src2.is_constant);
-      assert_always("not yet implemented");
+      if (i.src2.is_constant) {
+        e.mov(e.dword[addr],
+              xe::byte_swap(uint32_t(i.src2.value->constant.i32)));
+      } else {
+        e.vmovd(e.ecx, i.src2);
+        if (e.IsFeatureEnabled(kX64EmitMovbe)) {
+          e.movbe(e.dword[addr], e.ecx);
+        } else {
+          e.bswap(e.ecx);
+          e.mov(e.dword[addr], e.ecx);
+        }
+      }
     } else {
       if (i.src2.is_constant) {
         e.mov(e.dword[addr], i.src2.value->constant.i32);
@@ -1718,8 +1878,17 @@ struct STORE_F64 : Sequence<STORE_F64, I<OPCODE_STORE, VoidOp, I64Op, F64Op>> {
   static void Emit(X64Emitter& e, const EmitArgType& i) {
     auto addr = ComputeMemoryAddress(e, i.src1);
     if (i.instr->flags & LoadStoreFlags::LOAD_STORE_BYTE_SWAP) {
-      assert_false(i.src2.is_constant);
-      assert_always("not yet implemented");
+      if (i.src2.is_constant) {
+        e.MovMem64(addr, xe::byte_swap(uint64_t(i.src2.value->constant.i64)));
+      } else {
+        e.vmovq(e.rcx, i.src2);
+        if (e.IsFeatureEnabled(kX64EmitMovbe)) {
+          e.movbe(e.qword[addr], e.rcx);
+        } else {
+          e.bswap(e.rcx);
+          e.mov(e.qword[addr], e.rcx);
+        }
+      }
     } else {
       if (i.src2.is_constant) {
         e.MovMem64(addr, i.src2.value->constant.i64);
@@ -1739,19 +1908,27 @@ struct STORE_V128
     : Sequence<STORE_V128, I<OPCODE_STORE, VoidOp, I64Op, V128Op>> {
   static void Emit(X64Emitter& e, const EmitArgType& i) {
     auto addr = ComputeMemoryAddress(e, i.src1);
-    if (i.instr->flags & LoadStoreFlags::LOAD_STORE_BYTE_SWAP) {
-      assert_false(i.src2.is_constant);
+    Xmm src = e.xmm0;
+    if (i.instr->flags & LoadStoreFlags::LOAD_STORE_BYTE_SWAP &&
+        i.src2.is_constant) {
+      vec128_t swapped = i.src2.constant();
+      for (size_t n = 0; n < 4; ++n) {
+        swapped.u32[n] = xe::byte_swap(swapped.u32[n]);
+      }
+      e.LoadConstantXmm(e.xmm0, swapped);
+    } else if (i.instr->flags & LoadStoreFlags::LOAD_STORE_BYTE_SWAP) {
       e.vpshufb(e.xmm0, i.src2, e.GetXmmConstPtr(XMMByteSwapMask));
       // changed from vmovaps, the penalty on the vpshufb is unavoidable but
       // we dont need to incur another here too
-      e.vmovdqa(e.ptr[addr], e.xmm0);
+    } else if (i.src2.is_constant) {
+      e.LoadConstantXmm(e.xmm0, i.src2.constant());
     } else {
-      if (i.src2.is_constant) {
-        e.LoadConstantXmm(e.xmm0, i.src2.constant());
-        e.vmovdqa(e.ptr[addr], e.xmm0);
-      } else {
-        e.vmovdqa(e.ptr[addr], i.src2);
-      }
+      src = i.src2;
+    }
+    if (i.instr->flags & LoadStoreFlags::LOAD_STORE_UNALIGNED) {
+      e.vmovdqu(e.ptr[addr], src);
+    } else {
+      e.vmovdqa(e.ptr[addr], src);
     }
     if (IsTracingData()) {
       addr = ComputeMemoryAddress(e, i.src1);
@@ -1905,13 +2082,26 @@ struct MEMSET_I64_I8_I64
         break;
       case 128:
         // probably should lea the address beforehand
-        e.vmovdqa(e.ptr[addr + 0 * 16], e.ymm0);
+        if (i.instr->flags & MEMSET_NON_TEMPORAL) {
+          // Weakly ordered, but other threads are synchronized with through
+          // guest barriers and reservations, emitted as mfence and locked
+          // instructions, which drain the write combining buffers.
+          for (int n = 0; n < 4; ++n) {
+            e.vmovntdq(e.ptr[addr + n * 32], e.ymm0);
+          }
+        } else if (e.IsFeatureEnabled(kX64EmitAVX512F)) {
+          // The VEX vpxor has cleared the whole zmm0.
+          e.vmovdqa64(e.ptr[addr], e.zmm0);
+          e.vmovdqa64(e.ptr[addr + 64], e.zmm0);
+        } else {
+          e.vmovdqa(e.ptr[addr + 0 * 16], e.ymm0);
 
-        e.vmovdqa(e.ptr[addr + 2 * 16], e.ymm0);
+          e.vmovdqa(e.ptr[addr + 2 * 16], e.ymm0);
 
-        e.vmovdqa(e.ptr[addr + 4 * 16], e.ymm0);
+          e.vmovdqa(e.ptr[addr + 4 * 16], e.ymm0);
 
-        e.vmovdqa(e.ptr[addr + 6 * 16], e.ymm0);
+          e.vmovdqa(e.ptr[addr + 6 * 16], e.ymm0);
+        }
         break;
       default:
         assert_unhandled_case(i.src3.constant());
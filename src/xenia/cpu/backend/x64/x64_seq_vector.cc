@@ -17,6 +17,7 @@
 // For OPCODE_PACK/OPCODE_UNPACK
 #include "third_party/half/include/half.hpp"
 #include "xenia/base/cvar.h"
+#include "xenia/cpu/backend/x64/x64_backend.h"
 #include "xenia/cpu/backend/x64/x64_stack_layout.h"
 
 DEFINE_bool(xop_rotates, false, "rotate via xop", "x64");
@@ -880,6 +881,68 @@ static XmmConst GetShiftmaskForType(unsigned typ) {
     return XMMXOPDwordShiftMask;
   }
 }
+
+// AVX-512BW can shift words by per-lane counts, and bytes can be shifted as
+// words in a ymm register and narrowed back, instead of the scalar loops.
+static bool IsVectorShiftByWordAvailable(X64Emitter& e) {
+  return e.IsFeatureEnabled(kX64EmitAVX512Ortho | kX64EmitAVX512BW);
+}
+template <typename T>
+static void EmitVectorShiftWordsByVector(X64Emitter& e, const T& dest,
+                                         const T& src1, const T& src2,
+                                         VectorShift shift) {
+  switch (shift) {
+    case VectorShift::kLeft:
+      e.vpsllvw(dest, src1, src2);
+      break;
+    case VectorShift::kRightLogical:
+      e.vpsrlvw(dest, src1, src2);
+      break;
+    case VectorShift::kRightArithmetic:
+      e.vpsravw(dest, src1, src2);
+      break;
+  }
+}
+// Uses xmm1 as a temporary, src1 may be xmm0.
+static void EmitVectorShiftInt16AVX512(X64Emitter& e, const Xmm& dest,
+                                       const Xmm& src1, const Xmm& src2,
+                                       VectorShift shift) {
+  e.vpand(e.xmm1, src2, e.GetXmmConstPtr(XMMXOPWordShiftMask));
+  EmitVectorShiftWordsByVector(e, dest, src1, e.xmm1, shift);
+}
+// Uses ymm0 and ymm1 as temporaries, src1 may be xmm0.
+static void EmitVectorShiftInt8AVX512(X64Emitter& e, const Xmm& dest,
+                                      const Xmm& src1, const Xmm& src2,
+                                      VectorShift shift) {
+  e.vpand(e.xmm1, src2, e.GetXmmConstPtr(XMMXOPByteShiftMask));
+  e.vpmovzxbw(e.ymm1, e.xmm1);
+  if (shift == VectorShift::kRightArithmetic) {
+    e.vpmovsxbw(e.ymm0, src1);
+  } else {
+    e.vpmovzxbw(e.ymm0, src1);
+  }
+  EmitVectorShiftWordsByVector(e, e.ymm0, e.ymm0, e.ymm1, shift);
+  e.vpmovwb(dest, e.ymm0);
+}
+// Calls the shared out-of-line emulation of the shift if
+// X64Backend::ShouldCallVectorShiftHelper allows it. src1 must not be xmm1, and
+// src2 must not be xmm0.
+static void EmitVectorShiftHelperCall(X64Emitter& e, const Xmm& dest,
+                                      const Xmm& src1, const Xmm& src2,
+                                      VectorShift shift,
+                                      uint32_t element_size_log2) {
+  size_t call_start = e.getSize();
+  if (src1.getIdx() != 0) {
+    e.vmovdqa(e.xmm0, src1);
+  }
+  if (src2.getIdx() != 1) {
+    e.vmovdqa(e.xmm1, src2);
+  }
+  e.call(e.backend()->GetVectorShiftHelper(shift, element_size_log2));
+  e.vmovdqa(dest, e.xmm0);
+  e.backend()->RecordSharedSequenceCall(shift, element_size_log2,
+                                        e.getSize() - call_start);
+}
 struct VECTOR_SHL_V128
     : Sequence<VECTOR_SHL_V128, I<OPCODE_VECTOR_SHL, V128Op, V128Op, V128Op>> {
   static void Emit(X64Emitter& e, const EmitArgType& i) {
@@ -923,8 +986,22 @@ struct VECTOR_SHL_V128
   static void EmitInt8(X64Emitter& e, const EmitArgType& i) {
     // TODO(benvanik): native version (with shift magic).
 
+    if (IsVectorShiftByWordAvailable(e)) {
+      EmitVectorShiftInt8AVX512(e, i.dest,
+                                GetInputRegOrConstant(e, i.src1, e.xmm0),
+                                GetInputRegOrConstant(e, i.src2, e.xmm1),
+                                VectorShift::kLeft);
+      return;
+    }
+
     if (e.IsFeatureEnabled(kX64EmitAVX2)) {
       if (!i.src2.is_constant) {
+        if (e.backend()->ShouldCallVectorShiftHelper(VectorShift::kLeft, 0)) {
+          EmitVectorShiftHelperCall(e, i.dest,
+                                    GetInputRegOrConstant(e, i.src1, e.xmm0),
+                                    i.src2, VectorShift::kLeft, 0);
+          return;
+        }
         // get high 8 bytes
         e.vpunpckhqdq(e.xmm1, i.src1, i.src1);
         e.vpunpckhqdq(e.xmm3, i.src2, i.src2);
@@ -974,6 +1051,14 @@ struct VECTOR_SHL_V128
           return;
 
         } else {
+          if (e.backend()->ShouldCallVectorShiftHelper(VectorShift::kLeft,
+                                                       0)) {
+            e.LoadConstantXmm(e.xmm1, constmask);
+            EmitVectorShiftHelperCall(e, i.dest,
+                                      GetInputRegOrConstant(e, i.src1, e.xmm0),
+                                      e.xmm1, VectorShift::kLeft, 0);
+            return;
+          }
           e.LoadConstantXmm(e.xmm2, constmask);
 
           e.vpunpckhqdq(e.xmm1, i.src1, i.src1);
@@ -1003,6 +1088,14 @@ struct VECTOR_SHL_V128
       }
     }
 
+    if (e.backend()->ShouldCallVectorShiftHelper(VectorShift::kLeft, 0)) {
+      EmitVectorShiftHelperCall(e, i.dest,
+                                GetInputRegOrConstant(e, i.src1, e.xmm0),
+                                GetInputRegOrConstant(e, i.src2, e.xmm1),
+                                VectorShift::kLeft, 0);
+      return;
+    }
+
     unsigned stack_offset_src1 = StackLayout::GUEST_SCRATCH;
     unsigned stack_offset_src2 = StackLayout::GUEST_SCRATCH + 16;
 
@@ -1063,6 +1156,13 @@ struct VECTOR_SHL_V128
       }
     }
 
+    if (IsVectorShiftByWordAvailable(e)) {
+      EmitVectorShiftInt16AVX512(e, i.dest, src1,
+                                 GetInputRegOrConstant(e, i.src2, e.xmm0),
+                                 VectorShift::kLeft);
+      return;
+    }
+
     // Shift 8 words in src1 by amount specified in src2.
     Xbyak::Label emu, end;
 
@@ -1086,6 +1186,14 @@ struct VECTOR_SHL_V128
     // TODO(benvanik): native version (with shift magic).
     e.L(emu);
 
+    if (e.backend()->ShouldCallVectorShiftHelper(VectorShift::kLeft, 1)) {
+      EmitVectorShiftHelperCall(e, i.dest, src1,
+                                GetInputRegOrConstant(e, i.src2, e.xmm1),
+                                VectorShift::kLeft, 1);
+      e.L(end);
+      return;
+    }
+
     unsigned stack_offset_src1 = StackLayout::GUEST_SCRATCH;
     unsigned stack_offset_src2 = StackLayout::GUEST_SCRATCH + 16;
 
@@ -1180,6 +1288,14 @@ struct VECTOR_SHL_V128
       // TODO(benvanik): native version (with shift magic).
       e.L(emu);
 
+      if (e.backend()->ShouldCallVectorShiftHelper(VectorShift::kLeft, 2)) {
+        EmitVectorShiftHelperCall(e, i.dest, src1,
+                                  GetInputRegOrConstant(e, i.src2, e.xmm1),
+                                  VectorShift::kLeft, 2);
+        e.L(end);
+        return;
+      }
+
       unsigned stack_offset_src1 = StackLayout::GUEST_SCRATCH;
       unsigned stack_offset_src2 = StackLayout::GUEST_SCRATCH + 16;
 
@@ -1281,6 +1397,23 @@ struct VECTOR_SHR_V128
         return;
       }
     }
+    if (IsVectorShiftByWordAvailable(e)) {
+      EmitVectorShiftInt8AVX512(e, i.dest,
+                                GetInputRegOrConstant(e, i.src1, e.xmm0),
+                                GetInputRegOrConstant(e, i.src2, e.xmm1),
+                                VectorShift::kRightLogical);
+      return;
+    }
+
+    if (e.backend()->ShouldCallVectorShiftHelper(VectorShift::kRightLogical,
+                                                 0)) {
+      EmitVectorShiftHelperCall(e, i.dest,
+                                GetInputRegOrConstant(e, i.src1, e.xmm0),
+                                GetInputRegOrConstant(e, i.src2, e.xmm1),
+                                VectorShift::kRightLogical, 0);
+      return;
+    }
+
     unsigned stack_offset_src1 = StackLayout::GUEST_SCRATCH;
     unsigned stack_offset_src2 = StackLayout::GUEST_SCRATCH + 16;
 
@@ -1338,6 +1471,14 @@ struct VECTOR_SHR_V128
       }
     }
 
+    if (IsVectorShiftByWordAvailable(e)) {
+      EmitVectorShiftInt16AVX512(e, i.dest,
+                                 GetInputRegOrConstant(e, i.src1, e.xmm0),
+                                 GetInputRegOrConstant(e, i.src2, e.xmm1),
+                                 VectorShift::kRightLogical);
+      return;
+    }
+
     // Shift 8 words in src1 by amount specified in src2.
     Xbyak::Label emu, end;
 
@@ -1361,6 +1502,16 @@ struct VECTOR_SHR_V128
     // TODO(benvanik): native version (with shift magic).
     e.L(emu);
 
+    if (e.backend()->ShouldCallVectorShiftHelper(VectorShift::kRightLogical,
+                                                 1)) {
+      EmitVectorShiftHelperCall(e, i.dest,
+                                GetInputRegOrConstant(e, i.src1, e.xmm0),
+                                GetInputRegOrConstant(e, i.src2, e.xmm1),
+                                VectorShift::kRightLogical, 1);
+      e.L(end);
+      return;
+    }
+
     unsigned stack_offset_src1 = StackLayout::GUEST_SCRATCH;
     unsigned stack_offset_src2 = StackLayout::GUEST_SCRATCH + 16;
     if (i.src1.is_constant) {
@@ -1461,6 +1612,15 @@ struct VECTOR_SHR_V128
       // TODO(benvanik): native version.
       e.L(emu);
 
+      if (e.backend()->ShouldCallVectorShiftHelper(VectorShift::kRightLogical,
+                                                   2)) {
+        EmitVectorShiftHelperCall(e, i.dest, src1,
+                                  GetInputRegOrConstant(e, i.src2, e.xmm1),
+                                  VectorShift::kRightLogical, 2);
+        e.L(end);
+        return;
+      }
+
       unsigned stack_offset_src1 = StackLayout::GUEST_SCRATCH;
       unsigned stack_offset_src2 = StackLayout::GUEST_SCRATCH + 16;
       if (i.src1.is_constant) {
@@ -1582,7 +1742,26 @@ struct VECTOR_SHA_V128
         e.vpacksswb(i.dest, e.xmm0, e.xmm1);
         return;
       }
+    }
+
+    if (IsVectorShiftByWordAvailable(e)) {
+      EmitVectorShiftInt8AVX512(e, i.dest,
+                                GetInputRegOrConstant(e, i.src1, e.xmm0),
+                                GetInputRegOrConstant(e, i.src2, e.xmm1),
+                                VectorShift::kRightArithmetic);
+      return;
+    }
+
+    if (e.backend()->ShouldCallVectorShiftHelper(VectorShift::kRightArithmetic,
+                                                 0)) {
+      EmitVectorShiftHelperCall(e, i.dest,
+                                GetInputRegOrConstant(e, i.src1, e.xmm0),
+                                GetInputRegOrConstant(e, i.src2, e.xmm1),
+                                VectorShift::kRightArithmetic, 0);
+      return;
+    }
 
+    if (i.src2.is_constant) {
       e.StashConstantXmm(1, i.src2.constant());
       stack_offset_src2 = X64Emitter::kStashOffset + 16;
     } else {
@@ -1637,6 +1816,14 @@ struct VECTOR_SHA_V128
       }
     }
 
+    if (IsVectorShiftByWordAvailable(e)) {
+      EmitVectorShiftInt16AVX512(e, i.dest,
+                                 GetInputRegOrConstant(e, i.src1, e.xmm0),
+                                 GetInputRegOrConstant(e, i.src2, e.xmm1),
+                                 VectorShift::kRightArithmetic);
+      return;
+    }
+
     // Shift 8 words in src1 by amount specified in src2.
     Xbyak::Label emu, end;
 
@@ -1660,6 +1847,16 @@ struct VECTOR_SHA_V128
     // TODO(benvanik): native version (with shift magic).
     e.L(emu);
 
+    if (e.backend()->ShouldCallVectorShiftHelper(VectorShift::kRightArithmetic,
+                                                 1)) {
+      EmitVectorShiftHelperCall(e, i.dest,
+                                GetInputRegOrConstant(e, i.src1, e.xmm0),
+                                GetInputRegOrConstant(e, i.src2, e.xmm1),
+                                VectorShift::kRightArithmetic, 1);
+      e.L(end);
+      return;
+    }
+
     unsigned stack_offset_src1 = StackLayout::GUEST_SCRATCH;
     unsigned stack_offset_src2 = StackLayout::GUEST_SCRATCH + 16;
     if (i.src1.is_constant) {
@@ -1744,6 +1941,17 @@ struct VECTOR_SHA_V128
 
       // TODO(benvanik): native version.
       e.L(emu);
+
+      if (e.backend()->ShouldCallVectorShiftHelper(
+              VectorShift::kRightArithmetic, 2)) {
+        EmitVectorShiftHelperCall(e, i.dest,
+                                  GetInputRegOrConstant(e, i.src1, e.xmm0),
+                                  GetInputRegOrConstant(e, i.src2, e.xmm1),
+                                  VectorShift::kRightArithmetic, 2);
+        e.L(end);
+        return;
+      }
+
       unsigned stack_offset_src1 = StackLayout::GUEST_SCRATCH;
       unsigned stack_offset_src2 = StackLayout::GUEST_SCRATCH + 16;
       if (i.src1.is_constant) {
@@ -1809,6 +2017,21 @@ struct VECTOR_ROTATE_LEFT_V128
       unsigned stack_offset_src2 = StackLayout::GUEST_SCRATCH + 16;
       switch (i.instr->flags) {
         case INT8_TYPE: {
+          if (IsVectorShiftByWordAvailable(e)) {
+            // Shift words made of the byte repeated twice, the upper byte is
+            // then rotated.
+            Xmm src1 = GetInputRegOrConstant(e, i.src1, e.xmm0);
+            Xmm src2 = GetInputRegOrConstant(e, i.src2, e.xmm1);
+            e.vpand(e.xmm1, src2, e.GetXmmConstPtr(XMMXOPByteShiftMask));
+            e.vpmovzxbw(e.ymm1, e.xmm1);
+            e.vpmovzxbw(e.ymm0, src1);
+            e.vpsllw(e.ymm2, e.ymm0, 8);
+            e.vpor(e.ymm0, e.ymm0, e.ymm2);
+            e.vpsllvw(e.ymm0, e.ymm0, e.ymm1);
+            e.vpsrlw(e.ymm0, e.ymm0, 8);
+            e.vpmovwb(i.dest, e.ymm0);
+            break;
+          }
           if (i.src1.is_constant) {
             e.StashConstantXmm(0, i.src1.constant());
             stack_offset_src1 = X64Emitter::kStashOffset;
@@ -1841,6 +2064,19 @@ struct VECTOR_ROTATE_LEFT_V128
 
         } break;
         case INT16_TYPE: {
+          if (IsVectorShiftByWordAvailable(e)) {
+            // (x << n) | ((x >> 1) >> (15 - n)), so a count of 0 doesn't need
+            // a shift by 16.
+            Xmm src1 = GetInputRegOrConstant(e, i.src1, e.xmm0);
+            Xmm src2 = GetInputRegOrConstant(e, i.src2, e.xmm1);
+            e.vpand(e.xmm1, src2, e.GetXmmConstPtr(XMMXOPWordShiftMask));
+            e.vpsllvw(e.xmm2, src1, e.xmm1);
+            e.vpxor(e.xmm1, e.xmm1, e.GetXmmConstPtr(XMMXOPWordShiftMask));
+            e.vpsrlw(e.xmm3, src1, 1);
+            e.vpsrlvw(e.xmm3, e.xmm3, e.xmm1);
+            e.vpor(i.dest, e.xmm2, e.xmm3);
+            break;
+          }
           if (i.src1.is_constant) {
             e.StashConstantXmm(0, i.src1.constant());
             stack_offset_src1 = X64Emitter::kStashOffset;
@@ -2171,7 +2407,7 @@ struct EXTRACT_I32
       e.mov(e.al, i.src2);
       e.and_(e.al, 0x03);
       e.shl(e.al, 4);
-      e.mov(e.rdx, reinterpret_cast<uint64_t>(extract_table_32));
+      e.MovImagePointer(e.rdx, extract_table_32);
       e.vmovaps(e.xmm0, e.ptr[e.rdx + e.rax]);
       e.vpshufb(e.xmm0, src1, e.xmm0);
       e.vpextrd(i.dest, e.xmm0, 0);
@@ -2275,6 +2511,24 @@ struct PERMUTE_I32
     assert_true(i.instr->flags == INT32_TYPE);
     // Permute words between src2 and src3.
     // TODO(benvanik): check src3 for zero. if 0, we can use pshufb.
+    if (e.IsFeatureEnabled(kX64EmitAVX512Ortho)) {
+      // Each control byte is directly the index of the word in src2:src3, and
+      // vpermi2d only looks at the low 3 bits of each.
+      if (i.src1.is_constant) {
+        uint32_t control = i.src1.constant();
+        e.LoadConstantXmm(e.xmm0,
+                          vec128i(control & 0xFF, (control >> 8) & 0xFF,
+                                  (control >> 16) & 0xFF, control >> 24));
+      } else {
+        e.vmovd(e.xmm0, i.src1);
+        e.vpmovzxbd(e.xmm0, e.xmm0);
+      }
+      Xmm src2 = GetInputRegOrConstant(e, i.src2, e.xmm1);
+      Xmm src3 = GetInputRegOrConstant(e, i.src3, e.xmm2);
+      e.vpermi2d(e.xmm0, src2, src3);
+      e.vmovdqa(i.dest, e.xmm0);
+      return;
+    }
     if (i.src1.is_constant) {
       uint32_t control = i.src1.constant();
       // Shuffle things into the right places in dest & xmm0,
@@ -51,9 +51,10 @@ DEFINE_bool(no_round_to_single, false,
             "Not for users, breaks games. Skip rounding double values to "
             "single precision and back",
             "CPU");
-DEFINE_bool(inline_loadclock, false,
-            "Directly read cached guest clock without calling the LoadClock "
-            "method (it gets repeatedly updated by calls from other threads)",
+DEFINE_bool(inline_loadclock, true,
+            "Compute the guest clock in the generated code instead of calling "
+            "the LoadClock method, if the guest clock is derived from the "
+            "TSC.",
             "CPU");
 DEFINE_bool(delay_via_maybeyield, false,
             "implement the db16cyc instruction via MaybeYield, may improve "
@@ -85,6 +86,7 @@ struct COMMENT : Sequence<COMMENT, I<OPCODE_COMMENT, VoidOp, OffsetOp>> {
       // TODO(benvanik): pass through.
       // TODO(benvanik): don't just leak this memory.
       auto str_copy = strdup(str);
+      e.MarkNotStorable();
       e.mov(e.rdx, reinterpret_cast<uint64_t>(str_copy));
       e.CallNative(reinterpret_cast<void*>(TraceString));
     }
@@ -495,10 +497,39 @@ EMITTER_OPCODE_TABLE(OPCODE_ROUND, ROUND_F32, ROUND_F64, ROUND_V128);
 // ============================================================================
 struct LOAD_CLOCK : Sequence<LOAD_CLOCK, I<OPCODE_LOAD_CLOCK, I64Op>> {
   static void Emit(X64Emitter& e, const EmitArgType& i) {
-    if (cvars::inline_loadclock) {
+    if (cvars::inline_loadclock && !cvars::clock_no_scaling &&
+        Clock::guest_clock_parameters().host_ticks_tsc) {
+      // The sequence lock read of Clock::GuestClockParameters. Loads are not
+      // reordered with other loads on x86, so no fences are needed.
+      static_assert(Clock::kGuestClockShift == 32);
       e.mov(e.rcx,
-            e.GetBackendCtxPtr(offsetof(X64BackendContext, guest_tick_count)));
-      e.mov(i.dest, e.qword[e.rcx]);
+            e.GetBackendCtxPtr(offsetof(X64BackendContext, guest_clock)));
+      Xbyak::Label retry;
+      e.L(retry);
+      e.mov(e.r8d, e.dword[e.rcx + offsetof(Clock::GuestClockParameters,
+                                            sequence)]);
+      e.rdtsc();
+      e.shl(e.rdx, 32);
+      e.or_(e.rax, e.rdx);
+      e.sub(e.rax, e.qword[e.rcx + offsetof(Clock::GuestClockParameters,
+                                            host_tick_base)]);
+      // Clamp to 0 if the TSC of this core is behind the base.
+      e.sbb(e.rdx, e.rdx);
+      e.not_(e.rdx);
+      e.and_(e.rax, e.rdx);
+      e.mul(e.qword[e.rcx +
+                    offsetof(Clock::GuestClockParameters, multiplier)]);
+      e.shrd(e.rax, e.rdx, 32);
+      e.add(e.rax, e.qword[e.rcx + offsetof(Clock::GuestClockParameters,
+                                            guest_tick_base)]);
+      // Retry if the parameters were being changed (odd sequence), or have
+      // been changed.
+      e.test(e.r8d, 1);
+      e.jnz(retry);
+      e.cmp(e.r8d, e.dword[e.rcx + offsetof(Clock::GuestClockParameters,
+                                            sequence)]);
+      e.jne(retry);
+      e.mov(i.dest, e.rax);
     } else {
       // When scaling is disabled and the raw clock source is selected, the code
       // in the Clock class is actually just forwarding tick counts after one
@@ -115,13 +115,21 @@ class StackLayout {
    *  +------------------+
    *  | call ret addr    | rsp + 96
    *  +------------------+
+   *  | entry r1         | rsp + 104
+   *  +------------------+
+   *  | entry lr         | rsp + 108
+   *  +------------------+
+   *  | frame size       | rsp + 112
+   *  +------------------+
+   *  | (unused)         | rsp + 116
+   *  +------------------+
    *    ... locals ...
    *  +------------------+
    *  | (return address) |
    *  +------------------+
    *
    */
-  static const size_t GUEST_STACK_SIZE = 104;
+  static const size_t GUEST_STACK_SIZE = 120;
   // was GUEST_CTX_HOME, can't remove because that'd throw stack alignment off.
   // instead, can be used as a temporary in sequences
   static const size_t GUEST_SCRATCH = 0;
@@ -131,6 +139,12 @@ class StackLayout {
   static const size_t GUEST_PROFILER_START = 80;
   static const size_t GUEST_RET_ADDR = 88;
   static const size_t GUEST_CALL_RET_ADDR = 96;
+  // With lazy_host_guest_stack_synchronization, the guest stack pointer and
+  // the link register at the entry and the size of the frame, from which the
+  // stackpoints are reconstructed when the host stack needs to be restored.
+  static const size_t GUEST_ENTRY_STACK = 104;
+  static const size_t GUEST_ENTRY_LR = 108;
+  static const size_t GUEST_FRAME_SIZE = 112;
 };
 
 }  // namespace x64
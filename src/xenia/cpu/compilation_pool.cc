@@ -0,0 +1,74 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/compilation_pool.h"
+
+#include "xenia/base/assert.h"
+#include "xenia/base/threading_job_system.h"
+
+namespace xe {
+namespace cpu {
+
+CompilationPool::CompilationPool(size_t concurrency)
+    : concurrency_(concurrency) {
+  assert_not_zero(concurrency);
+}
+
+CompilationPool::~CompilationPool() {
+  std::vector<Job> dropped_jobs;
+  std::unique_lock<std::mutex> lock(lock_);
+  shutdown_ = true;
+  dropped_jobs.swap(jobs_);
+  // Also waiting for the RunJobs not started yet, as they reference the pool.
+  idle_cond_.wait(lock, [this]() { return !running_; });
+}
+
+void CompilationPool::Submit(Job job) {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (shutdown_) {
+      return;
+    }
+    jobs_.push_back(std::move(job));
+    if (running_ >= concurrency_) {
+      return;
+    }
+    ++running_;
+  }
+  // Compilation ahead of time must only take the capacity not needed by the
+  // rest of the emulator.
+  xe::threading::JobSystem::Get().Submit(
+      xe::threading::JobPriority::kBackground, [this]() { RunJobs(); });
+}
+
+size_t CompilationPool::GetPendingJobCount() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return jobs_.size();
+}
+
+void CompilationPool::RunJobs() {
+  while (true) {
+    Job job;
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      if (shutdown_ || jobs_.empty()) {
+        --running_;
+        // Notifying under the lock, the pool may be destroyed right after.
+        idle_cond_.notify_all();
+        return;
+      }
+      job = std::move(jobs_.back());
+      jobs_.pop_back();
+    }
+    job();
+  }
+}
+
+}  // namespace cpu
+}  // namespace xe
@@ -0,0 +1,57 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_CPU_COMPILATION_POOL_H_
+#define XENIA_CPU_COMPILATION_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace xe {
+namespace cpu {
+
+// Compiles functions ahead of their execution as background jobs of the
+// shared xe::threading::JobSystem, on up to concurrency workers at once. The
+// jobs are taken most recent first, so the callees of the function that has
+// just been compiled are compiled before the older jobs.
+class CompilationPool {
+ public:
+  using Job = std::function<void()>;
+
+  explicit CompilationPool(size_t concurrency);
+  // Waits for the jobs being executed to complete and drops the pending ones.
+  ~CompilationPool();
+
+  size_t concurrency() const { return concurrency_; }
+
+  void Submit(Job job);
+  // Jobs submitted and not started yet.
+  size_t GetPendingJobCount() const;
+
+ private:
+  void RunJobs();
+
+  size_t concurrency_;
+
+  // Protected with lock_, notify idle_cond_ when running_ is decremented.
+  mutable std::mutex lock_;
+  std::condition_variable idle_cond_;
+  std::vector<Job> jobs_;
+  // Number of RunJobs submitted to the job system and not returned yet.
+  size_t running_ = 0;
+  bool shutdown_ = false;
+};
+
+}  // namespace cpu
+}  // namespace xe
+
+#endif  // XENIA_CPU_COMPILATION_POOL_H_
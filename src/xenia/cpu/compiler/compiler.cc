@@ -9,7 +9,9 @@
 
 #include "xenia/cpu/compiler/compiler.h"
 
+#include "xenia/base/clock.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/cpu/compiler/compiler_pass.h"
 
 namespace xe {
@@ -27,20 +29,39 @@ void Compiler::AddPass(std::unique_ptr<CompilerPass> pass) {
 
 void Compiler::Reset() {}
 
-bool Compiler::Compile(xe::cpu::hir::HIRBuilder* builder) {
+bool Compiler::Compile(
+    xe::cpu::hir::HIRBuilder* builder,
+    std::vector<FunctionCompilationStatistics::PassTime>* pass_ticks) {
   // TODO(benvanik): sophisticated stuff. Run passes in parallel, run until they
   //                 stop changing things, etc.
+  scratch_arena_.Reset();
+  scratch_arena_.ResetStatistics();
   for (size_t i = 0; i < passes_.size(); ++i) {
     auto& pass = passes_[i];
     scratch_arena_.Reset();
+    uint64_t pass_start = pass_ticks ? Clock::QueryHostTickCount() : 0;
     if (!pass->Run(builder)) {
       return false;
     }
+    if (pass_ticks) {
+      pass_ticks->push_back(
+          {pass->name(), Clock::QueryHostTickCount() - pass_start});
+    }
   }
 
   return true;
 }
 
+uint64_t Compiler::fingerprint() const {
+  uint64_t result = 0;
+  for (const auto& pass : passes_) {
+    uint64_t pass_fingerprint = pass->fingerprint();
+    result = XXH3_64bits_withSeed(&pass_fingerprint, sizeof(pass_fingerprint),
+                                  result);
+  }
+  return result;
+}
+
 }  // namespace compiler
 }  // namespace cpu
 }  // namespace xe
@@ -14,6 +14,7 @@
 #include <vector>
 
 #include "xenia/base/arena.h"
+#include "xenia/cpu/function.h"
 #include "xenia/cpu/hir/hir_builder.h"
 
 namespace xe {
@@ -40,7 +41,14 @@ class Compiler {
 
   void Reset();
 
-  bool Compile(hir::HIRBuilder* builder);
+  // The time taken by each pass is appended to pass_ticks if it's not null.
+  bool Compile(
+      hir::HIRBuilder* builder,
+      std::vector<FunctionCompilationStatistics::PassTime>* pass_ticks =
+          nullptr);
+
+  // Identifies the pass pipeline, for invalidation of stored generated code.
+  uint64_t fingerprint() const;
 
  private:
   Processor* processor_;
@@ -9,8 +9,18 @@
 
 #include "xenia/cpu/compiler/compiler_pass.h"
 
+#include <cstdlib>
+#include <cstring>
+#include <typeinfo>
+
+#include "xenia/base/platform.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/cpu/compiler/compiler.h"
 
+#if !XE_COMPILER_MSVC
+#include <cxxabi.h>
+#endif  // !XE_COMPILER_MSVC
+
 namespace xe {
 namespace cpu {
 namespace compiler {
@@ -25,6 +35,31 @@ bool CompilerPass::Initialize(Compiler* compiler) {
   return true;
 }
 
+uint64_t CompilerPass::fingerprint() const {
+  const char* name = typeid(*this).name();
+  return XXH3_64bits(name, std::strlen(name));
+}
+
+const char* CompilerPass::name() const {
+  if (name_.empty()) {
+    const char* type_name = typeid(*this).name();
+#if XE_COMPILER_MSVC
+    name_ = type_name;
+#else
+    int status;
+    char* demangled = abi::__cxa_demangle(type_name, nullptr, nullptr, &status);
+    name_ = demangled ? demangled : type_name;
+    std::free(demangled);
+#endif  // XE_COMPILER_MSVC
+    // Without the namespaces.
+    size_t namespace_end = name_.rfind(':');
+    if (namespace_end != std::string::npos) {
+      name_.erase(0, namespace_end + 1);
+    }
+  }
+  return name_.c_str();
+}
+
 Arena* CompilerPass::scratch_arena() const {
   return compiler_->scratch_arena();
 }
@@ -10,6 +10,8 @@
 #ifndef XENIA_CPU_COMPILER_COMPILER_PASS_H_
 #define XENIA_CPU_COMPILER_COMPILER_PASS_H_
 
+#include <string>
+
 #include "xenia/base/arena.h"
 #include "xenia/cpu/hir/hir_builder.h"
 
@@ -34,12 +36,22 @@ class CompilerPass {
 
   virtual bool Run(hir::HIRBuilder* builder) = 0;
 
+  // Identifies the pass (and any nested passes) for invalidation of stored
+  // code generated by a pipeline containing it.
+  virtual uint64_t fingerprint() const;
+
+  // Name of the pass class for diagnostics.
+  const char* name() const;
+
  protected:
   Arena* scratch_arena() const;
 
  protected:
   Processor* processor_;
   Compiler* compiler_;
+
+ private:
+  mutable std::string name_;
 };
 
 }  // namespace compiler
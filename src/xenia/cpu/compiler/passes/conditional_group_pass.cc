@@ -10,6 +10,7 @@
 #include "xenia/cpu/compiler/passes/conditional_group_pass.h"
 
 #include "xenia/base/profiling.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/cpu/compiler/compiler.h"
 #include "xenia/cpu/ppc/ppc_context.h"
 #include "xenia/cpu/processor.h"
@@ -70,6 +71,16 @@ bool ConditionalGroupPass::Run(HIRBuilder* builder) {
   return true;
 }
 
+uint64_t ConditionalGroupPass::fingerprint() const {
+  uint64_t result = CompilerPass::fingerprint();
+  for (const auto& pass : passes_) {
+    uint64_t pass_fingerprint = pass->fingerprint();
+    result = XXH3_64bits_withSeed(&pass_fingerprint, sizeof(pass_fingerprint),
+                                  result);
+  }
+  return result;
+}
+
 void ConditionalGroupPass::AddPass(std::unique_ptr<CompilerPass> pass) {
   passes_.push_back(std::move(pass));
 }
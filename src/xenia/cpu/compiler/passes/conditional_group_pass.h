@@ -31,6 +31,8 @@ class ConditionalGroupPass : public CompilerPass {
 
   bool Run(hir::HIRBuilder* builder) override;
 
+  uint64_t fingerprint() const override;
+
   void AddPass(std::unique_ptr<CompilerPass> pass);
 
  private:
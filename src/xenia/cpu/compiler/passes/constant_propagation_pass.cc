@@ -311,6 +311,9 @@ bool ConstantPropagationPass::Run(HIRBuilder* builder, bool& result) {
                     assert_unhandled_case(v->type);
                     break;
                 }
+                if (v->IsConstant()) {
+                  builder->folded_load_addresses().push_back(address);
+                }
               }
             }
           }
@@ -9,6 +9,8 @@
 
 #include "xenia/cpu/compiler/passes/context_promotion_pass.h"
 
+#include <algorithm>
+
 #include "xenia/apu/apu_flags.h"
 #include "xenia/base/cvar.h"
 #include "xenia/base/profiling.h"
@@ -51,6 +53,7 @@ bool ContextPromotionPass::Initialize(Compiler* compiler) {
   // This is a terrible implementation.
   context_values_.resize(sizeof(ppc::PPCContext));
   context_validity_.resize(static_cast<uint32_t>(sizeof(ppc::PPCContext)));
+  context_store_sizes_.resize(sizeof(ppc::PPCContext));
 
   return true;
 }
@@ -70,10 +73,23 @@ bool ContextPromotionPass::Run(HIRBuilder* builder) {
   //   store_context +100, v1
   // This is more generally done by DSE, however if it could be done here
   // instead as it may be faster (at least on the block-level).
+  //
+  // Both are done across blocks using the CFG, but only following forward
+  // edges in the block order so each block is visited once - the values known
+  // at the entry of a block are the ones known on all its incoming edges, and
+  // the stores certain to happen after the exit of a block on all its outgoing
+  // edges. Loop back edges and the function entry and exits know nothing.
+  uint16_t block_ordinal = 0;
+  auto block = builder->first_block();
+  while (block) {
+    block->ordinal = block_ordinal++;
+    block = block->next;
+  }
+  block_states_.clear();
+  block_states_.resize(block_ordinal);
 
   // Promote loads to values.
-  // Process each block independently, for now.
-  auto block = builder->first_block();
+  block = builder->first_block();
   while (block) {
     PromoteBlock(block);
     block = block->next;
@@ -84,10 +100,10 @@ bool ContextPromotionPass::Run(HIRBuilder* builder) {
   // trying to extract stack traces/register values, so we don't do that.
   if (cvars::full_optimization_even_with_debug ||
       (!cvars::debug && !cvars::store_all_context_values)) {
-    block = builder->first_block();
+    block = builder->last_block();
     while (block) {
       RemoveDeadStoresBlock(block);
-      block = block->next;
+      block = block->prev;
     }
   }
 
@@ -98,21 +114,45 @@ void ContextPromotionPass::PromoteBlock(Block* block) {
   auto& validity = context_validity_;
   validity.reset();
 
+  // Values are only known if the block can't be entered without passing
+  // through the forward branches merged into its entry state.
+  const BlockState& block_state = block_states_[block->ordinal];
+  uint32_t incoming_edge_count = 0;
+  for (auto edge = block->incoming_edge_head; edge;
+       edge = edge->incoming_next) {
+    ++incoming_edge_count;
+  }
+  if (incoming_edge_count &&
+      block_state.merged_edge_count == incoming_edge_count) {
+    for (const auto& entry : block_state.entry_values) {
+      context_values_[entry.first] = entry.second;
+      validity.set(entry.first);
+    }
+  }
+
   Instr* i = block->instr_head;
   while (i) {
     auto next = i->next;
-    if (i->opcode->flags & OPCODE_FLAG_VOLATILE) {
+    if (i->opcode == &OPCODE_BRANCH_info) {
+      MergeEntryValues(block, i->src1.label->block);
+    } else if (i->opcode == &OPCODE_BRANCH_TRUE_info ||
+               i->opcode == &OPCODE_BRANCH_FALSE_info) {
+      // Doesn't touch the context, only volatile due to being conditional.
+      MergeEntryValues(block, i->src2.label->block);
+    } else if (i->opcode->flags & OPCODE_FLAG_VOLATILE) {
       // Volatile instruction - requires all context values be flushed.
       validity.reset();
     } else if (i->opcode == &OPCODE_LOAD_CONTEXT_info) {
       size_t offset = i->src1.offset;
-      if (validity.test(static_cast<uint32_t>(offset))) {
+      if (validity.test(static_cast<uint32_t>(offset)) &&
+          context_values_[offset]->type == i->dest->type) {
         // Legit previous value, reuse.
         Value* previous_value = context_values_[offset];
         i->opcode = &hir::OPCODE_ASSIGN_info;
         i->set_src1(previous_value);
       } else {
         // Store the loaded value into the table.
+        InvalidateOverlappingValues(offset, GetTypeSize(i->dest->type));
         context_values_[offset] = i->dest;
         validity.set(static_cast<uint32_t>(offset));
       }
@@ -120,6 +160,7 @@ void ContextPromotionPass::PromoteBlock(Block* block) {
       size_t offset = i->src1.offset;
       Value* value = i->src2.value;
       // Store value into the table for later.
+      InvalidateOverlappingValues(offset, GetTypeSize(value->type));
       context_values_[offset] = value;
       validity.set(static_cast<uint32_t>(offset));
     }
@@ -127,6 +168,43 @@ void ContextPromotionPass::PromoteBlock(Block* block) {
   }
 }
 
+void ContextPromotionPass::MergeEntryValues(Block* block, Block* target) {
+  if (target->ordinal <= block->ordinal) {
+    // Back edge, the target has already been promoted.
+    return;
+  }
+  auto& validity = context_validity_;
+  BlockState& target_state = block_states_[target->ordinal];
+  ContextValueList& entry_values = target_state.entry_values;
+  if (!target_state.merged_edge_count++) {
+    for (int offset = validity.find_first(); offset != -1;
+         offset = validity.find_next(offset)) {
+      entry_values.emplace_back(uint32_t(offset), context_values_[offset]);
+    }
+    return;
+  }
+  // Only keep the values that are the same on all the edges.
+  entry_values.erase(
+      std::remove_if(entry_values.begin(), entry_values.end(),
+                     [this](const std::pair<uint32_t, Value*>& entry) {
+                       return !context_validity_.test(entry.first) ||
+                              context_values_[entry.first] != entry.second;
+                     }),
+      entry_values.end());
+}
+
+void ContextPromotionPass::InvalidateOverlappingValues(size_t offset,
+                                                       size_t size) {
+  auto& validity = context_validity_;
+  size_t end = std::min(offset + size, context_values_.size());
+  for (size_t i = offset >= 15 ? offset - 15 : 0; i < end; ++i) {
+    if (validity.test(static_cast<uint32_t>(i)) &&
+        i + GetTypeSize(context_values_[i]->type) > offset) {
+      validity.reset(static_cast<uint32_t>(i));
+    }
+  }
+}
+
 void ContextPromotionPass::RemoveDeadStoresBlock(Block* block) {
   auto& validity = context_validity_;
   validity.reset();
@@ -136,21 +214,90 @@ void ContextPromotionPass::RemoveDeadStoresBlock(Block* block) {
   Instr* i = block->instr_tail;
   while (i) {
     Instr* prev = i->prev;
-    if (i->opcode->flags & (OPCODE_FLAG_VOLATILE | OPCODE_FLAG_BRANCH)) {
+    if (i->opcode == &OPCODE_BRANCH_info) {
+      // Nothing after an unconditional branch is executed.
+      LoadEntryStores(block, i->src1.label->block);
+    } else if (i->opcode == &OPCODE_BRANCH_TRUE_info ||
+               i->opcode == &OPCODE_BRANCH_FALSE_info) {
+      IntersectEntryStores(block, i->src2.label->block);
+    } else if (i->opcode->flags & (OPCODE_FLAG_VOLATILE | OPCODE_FLAG_BRANCH)) {
       // Volatile instruction - requires all context values be flushed.
       validity.reset();
+    } else if (i->opcode == &OPCODE_LOAD_CONTEXT_info) {
+      InvalidateOverlappingStores(i->src1.offset, GetTypeSize(i->dest->type));
     } else if (i->opcode == &OPCODE_STORE_CONTEXT_info) {
       size_t offset = i->src1.offset;
+      uint8_t size = static_cast<uint8_t>(GetTypeSize(i->src2.value->type));
       if (!validity.test(static_cast<uint32_t>(offset))) {
         // Offset not yet written, mark and continue.
         validity.set(static_cast<uint32_t>(offset));
-      } else {
+        context_store_sizes_[offset] = size;
+      } else if (context_store_sizes_[offset] >= size) {
         // Already written to. Remove this store.
         i->UnlinkAndNOP();
+      } else {
+        // Only partially overwritten later.
+        context_store_sizes_[offset] = size;
       }
     }
     i = prev;
   }
+
+  ContextStoreList& entry_stores = block_states_[block->ordinal].entry_stores;
+  entry_stores.clear();
+  for (int offset = validity.find_first(); offset != -1;
+       offset = validity.find_next(offset)) {
+    entry_stores.emplace_back(uint32_t(offset), context_store_sizes_[offset]);
+  }
+}
+
+void ContextPromotionPass::LoadEntryStores(Block* block, Block* target) {
+  auto& validity = context_validity_;
+  validity.reset();
+  if (target->ordinal <= block->ordinal) {
+    // Back edge, not known yet.
+    return;
+  }
+  for (const auto& entry : block_states_[target->ordinal].entry_stores) {
+    validity.set(entry.first);
+    context_store_sizes_[entry.first] = entry.second;
+  }
+}
+
+void ContextPromotionPass::IntersectEntryStores(Block* block, Block* target) {
+  auto& validity = context_validity_;
+  if (target->ordinal <= block->ordinal) {
+    validity.reset();
+    return;
+  }
+  const ContextStoreList& entry_stores =
+      block_states_[target->ordinal].entry_stores;
+  for (int offset = validity.find_first(); offset != -1;
+       offset = validity.find_next(offset)) {
+    auto it = std::lower_bound(
+        entry_stores.begin(), entry_stores.end(), uint32_t(offset),
+        [](const std::pair<uint32_t, uint8_t>& entry, uint32_t offset) {
+          return entry.first < offset;
+        });
+    if (it == entry_stores.end() || it->first != uint32_t(offset)) {
+      validity.reset(offset);
+    } else {
+      context_store_sizes_[offset] =
+          std::min(context_store_sizes_[offset], it->second);
+    }
+  }
+}
+
+void ContextPromotionPass::InvalidateOverlappingStores(size_t offset,
+                                                       size_t size) {
+  auto& validity = context_validity_;
+  size_t end = std::min(offset + size, context_store_sizes_.size());
+  for (size_t i = offset >= 15 ? offset - 15 : 0; i < end; ++i) {
+    if (validity.test(static_cast<uint32_t>(i)) &&
+        i + context_store_sizes_[i] > offset) {
+      validity.reset(static_cast<uint32_t>(i));
+    }
+  }
 }
 
 }  // namespace passes
@@ -11,6 +11,8 @@
 #define XENIA_CPU_COMPILER_PASSES_CONTEXT_PROMOTION_PASS_H_
 
 #include <cmath>
+#include <cstdint>
+#include <utility>
 #include <vector>
 
 #include "xenia/base/platform.h"
@@ -41,12 +43,32 @@ class ContextPromotionPass : public CompilerPass {
   bool Run(hir::HIRBuilder* builder) override;
 
  private:
+  // Context values known at the entry of a block, sorted by offset.
+  using ContextValueList = std::vector<std::pair<uint32_t, hir::Value*>>;
+  // Offsets and sizes of context stores certain to happen before any read of
+  // the stored bytes from the entry of a block, sorted by offset.
+  using ContextStoreList = std::vector<std::pair<uint32_t, uint8_t>>;
+  struct BlockState {
+    ContextValueList entry_values;
+    // Forward branches to the block taken into account in entry_values.
+    uint32_t merged_edge_count = 0;
+    ContextStoreList entry_stores;
+  };
+
   void PromoteBlock(hir::Block* block);
+  void MergeEntryValues(hir::Block* block, hir::Block* target);
+  void InvalidateOverlappingValues(size_t offset, size_t size);
   void RemoveDeadStoresBlock(hir::Block* block);
+  void LoadEntryStores(hir::Block* block, hir::Block* target);
+  void IntersectEntryStores(hir::Block* block, hir::Block* target);
+  void InvalidateOverlappingStores(size_t offset, size_t size);
 
  private:
   std::vector<hir::Value*> context_values_;
   llvm::BitVector context_validity_;
+  // Size of the store at each offset - valid if set in context_validity_.
+  std::vector<uint8_t> context_store_sizes_;
+  std::vector<BlockState> block_states_;
 };
 
 }  // namespace passes
@@ -41,13 +41,12 @@ bool ControlFlowAnalysisPass::Run(HIRBuilder* builder) {
   }
 
   // Add edges.
+  // Blocks merged by ControlFlowSimplificationPass may have branches before
+  // their tail.
   block = builder->first_block();
   while (block) {
     auto instr = block->instr_tail;
     while (instr) {
-      if ((instr->opcode->flags & OPCODE_FLAG_BRANCH) == 0) {
-        break;
-      }
       if (instr->opcode == &OPCODE_BRANCH_info) {
         auto label = instr->src1.label;
         builder->AddEdge(block, label->block, Edge::UNCONDITIONAL);
@@ -71,25 +71,31 @@ void DataFlowAnalysisPass::AnalyzeFlow(HIRBuilder* builder,
       builder->max_value_ordinal() + 1 + block_count * 4;
 
   // Stash for value map. We may want to maintain this during building.
-  auto arena = builder->arena();
-  auto value_map = reinterpret_cast<Value**>(
-      arena->Alloc(sizeof(Value*) * max_value_estimate, alignof(Value)));
-
-  // Allocate incoming bitvectors for use by blocks. We don't need outgoing
-  // because they are only used during the block iteration.
-  // Mapped by block ordinal.
-  // TODO(benvanik): cache this list, grow as needed, etc.
-  auto incoming_bitvectors = (llvm::BitVector**)arena->Alloc(
-      sizeof(llvm::BitVector*) * block_count, alignof(llvm::BitVector));
+  auto value_map = reinterpret_cast<Value**>(scratch_arena()->Alloc(
+      sizeof(Value*) * max_value_estimate, alignof(Value*)));
+
+  // Incoming bitvectors for use by blocks, mapped by block ordinal. We only
+  // need one outgoing because they are only used during the block iteration.
+  // Kept across functions, so the storage of their bits is reused.
+  if (incoming_bitvectors_.size() < block_count) {
+    incoming_bitvectors_.reserve(block_count);
+    while (incoming_bitvectors_.size() < block_count) {
+      incoming_bitvectors_.push_back(std::make_unique<llvm::BitVector>());
+    }
+  }
   for (auto n = 0u; n < block_count; n++) {
-    incoming_bitvectors[n] = new llvm::BitVector(max_value_estimate);
+    incoming_bitvectors_[n]->clear();
+    incoming_bitvectors_[n]->resize(max_value_estimate);
+  }
+  if (!outgoing_bitvector_) {
+    outgoing_bitvector_ = std::make_unique<llvm::BitVector>();
   }
 
   // Walk blocks in reverse and calculate incoming/outgoing values.
   auto block = builder->last_block();
   while (block) {
     // Allocate bitsets based on max value number.
-    block->incoming_values = incoming_bitvectors[block->ordinal];
+    block->incoming_values = incoming_bitvectors_[block->ordinal].get();
     auto& incoming_values = *block->incoming_values;
 
     // Walk instructions and gather up incoming values.
@@ -117,7 +123,9 @@ void DataFlowAnalysisPass::AnalyzeFlow(HIRBuilder* builder,
 
     // Add all successor incoming values to our outgoing, as we need to
     // pass them through.
-    llvm::BitVector outgoing_values(max_value_estimate);
+    llvm::BitVector& outgoing_values = *outgoing_bitvector_;
+    outgoing_values.clear();
+    outgoing_values.resize(max_value_estimate);
     auto outgoing_edge = block->outgoing_edge_head;
     while (outgoing_edge) {
       if (outgoing_edge->dest->ordinal > block->ordinal) {
@@ -202,9 +210,9 @@ void DataFlowAnalysisPass::AnalyzeFlow(HIRBuilder* builder,
     block = block->prev;
   }
 
-  // Cleanup bitvectors.
-  for (auto n = 0u; n < block_count; n++) {
-    delete incoming_bitvectors[n];
+  // Not valid after the pass.
+  for (block = builder->first_block(); block; block = block->next) {
+    block->incoming_values = nullptr;
   }
 }
 
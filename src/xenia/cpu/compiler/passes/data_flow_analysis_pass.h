@@ -10,8 +10,15 @@
 #ifndef XENIA_CPU_COMPILER_PASSES_DATA_FLOW_ANALYSIS_PASS_H_
 #define XENIA_CPU_COMPILER_PASSES_DATA_FLOW_ANALYSIS_PASS_H_
 
+#include <memory>
+#include <vector>
+
 #include "xenia/cpu/compiler/compiler_pass.h"
 
+namespace llvm {
+class BitVector;
+}  // namespace llvm
+
 namespace xe {
 namespace cpu {
 namespace compiler {
@@ -27,6 +34,9 @@ class DataFlowAnalysisPass : public CompilerPass {
  private:
   uint32_t LinearizeBlocks(hir::HIRBuilder* builder);
   void AnalyzeFlow(hir::HIRBuilder* builder, uint32_t block_count);
+
+  std::vector<std::unique_ptr<llvm::BitVector>> incoming_bitvectors_;
+  std::unique_ptr<llvm::BitVector> outgoing_bitvector_;
 };
 
 }  // namespace passes
@@ -0,0 +1,299 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/compiler/passes/global_value_numbering_pass.h"
+
+#include <algorithm>
+
+#include "xenia/base/profiling.h"
+#include "xenia/base/xxhash.h"
+#include "xenia/cpu/compiler/compiler.h"
+
+namespace xe {
+namespace cpu {
+namespace compiler {
+namespace passes {
+
+// TODO(benvanik): remove when enums redefined.
+using namespace xe::cpu::hir;
+
+using xe::cpu::hir::Block;
+using xe::cpu::hir::Edge;
+using xe::cpu::hir::HIRBuilder;
+using xe::cpu::hir::Instr;
+using xe::cpu::hir::Value;
+
+namespace {
+
+Value* ResolveAssignments(Value* value) {
+  while (!value->IsConstant() && value->def &&
+         value->def->opcode == &OPCODE_ASSIGN_info) {
+    value = value->def->src1.value;
+  }
+  return value;
+}
+
+}  // namespace
+
+GlobalValueNumberingPass::GlobalValueNumberingPass() : CompilerPass() {}
+
+GlobalValueNumberingPass::~GlobalValueNumberingPass() {}
+
+bool GlobalValueNumberingPass::IsPure(const Instr* instr) {
+  if (!instr->dest) {
+    return false;
+  }
+  // Saturation is checked right after the instruction setting it.
+  if (instr->next && instr->next->opcode->flags & OPCODE_FLAG_PAIRED_PREV) {
+    return false;
+  }
+  switch (instr->opcode->num) {
+    case OPCODE_ASSIGN:
+    case OPCODE_CAST:
+    case OPCODE_ZERO_EXTEND:
+    case OPCODE_SIGN_EXTEND:
+    case OPCODE_TRUNCATE:
+    case OPCODE_LOAD_VECTOR_SHL:
+    case OPCODE_LOAD_VECTOR_SHR:
+    case OPCODE_SELECT:
+    case OPCODE_AND:
+    case OPCODE_AND_NOT:
+    case OPCODE_OR:
+    case OPCODE_XOR:
+    case OPCODE_NOT:
+    case OPCODE_SHL:
+    case OPCODE_VECTOR_SHL:
+    case OPCODE_SHR:
+    case OPCODE_VECTOR_SHR:
+    case OPCODE_SHA:
+    case OPCODE_VECTOR_SHA:
+    case OPCODE_ROTATE_LEFT:
+    case OPCODE_VECTOR_ROTATE_LEFT:
+    case OPCODE_BYTE_SWAP:
+    case OPCODE_CNTLZ:
+    case OPCODE_INSERT:
+    case OPCODE_EXTRACT:
+    case OPCODE_SPLAT:
+    case OPCODE_PERMUTE:
+    case OPCODE_SWIZZLE:
+      return true;
+    case OPCODE_ADD:
+    case OPCODE_ADD_CARRY:
+    case OPCODE_SUB:
+    case OPCODE_MUL:
+    case OPCODE_MUL_HI:
+    case OPCODE_NEG:
+      return IsScalarIntegralType(instr->dest->type);
+    case OPCODE_COMPARE_EQ:
+    case OPCODE_COMPARE_NE:
+    case OPCODE_COMPARE_SLT:
+    case OPCODE_COMPARE_SLE:
+    case OPCODE_COMPARE_SGT:
+    case OPCODE_COMPARE_SGE:
+    case OPCODE_COMPARE_ULT:
+    case OPCODE_COMPARE_ULE:
+    case OPCODE_COMPARE_UGT:
+    case OPCODE_COMPARE_UGE:
+      return IsScalarIntegralType(instr->src1.value->type);
+    default:
+      return false;
+  }
+}
+
+size_t GlobalValueNumberingPass::ExpressionHasher::operator()(
+    const Expression& expression) const {
+  return size_t(XXH3_64bits(&expression, sizeof(expression)));
+}
+
+bool GlobalValueNumberingPass::Run(HIRBuilder* builder) {
+  SCOPE_profile_cpu_f("cpu");
+
+  // Value numbering is done in a preorder walk of the dominator tree, so the
+  // instructions an expression may be replaced with are those in the blocks
+  // through which every path to the instruction goes, with the blocks not
+  // reachable from the entry left alone.
+  if (!builder->first_block()) {
+    return true;
+  }
+  ComputeDominators(builder);
+
+  available_.clear();
+  scope_expressions_.clear();
+  walk_stack_.clear();
+  walk_stack_.push_back({0, 0, 0});
+  NumberBlock(blocks_[0]);
+  while (!walk_stack_.empty()) {
+    WalkEntry& entry = walk_stack_.back();
+    const std::vector<uint32_t>& dominated_blocks =
+        dominated_blocks_[entry.block];
+    if (entry.next_dominated_block < dominated_blocks.size()) {
+      uint32_t block = dominated_blocks[entry.next_dominated_block++];
+      walk_stack_.push_back({block, 0, uint32_t(scope_expressions_.size())});
+      NumberBlock(blocks_[block]);
+      continue;
+    }
+    while (scope_expressions_.size() > entry.scope_start) {
+      available_.erase(scope_expressions_.back());
+      scope_expressions_.pop_back();
+    }
+    walk_stack_.pop_back();
+  }
+
+  // The assignments are left to the simplification pass.
+  return true;
+}
+
+void GlobalValueNumberingPass::ComputeDominators(HIRBuilder* builder) {
+  blocks_.clear();
+  for (auto block = builder->first_block(); block; block = block->next) {
+    block->ordinal = uint16_t(blocks_.size());
+    blocks_.push_back(block);
+  }
+  uint32_t block_count = uint32_t(blocks_.size());
+
+  // Postorder of the blocks reachable from the entry.
+  reverse_postorder_.clear();
+  reverse_postorder_indices_.clear();
+  reverse_postorder_indices_.resize(block_count, UINT32_MAX);
+  dfs_stack_.clear();
+  // Marking as visited until the order is known.
+  reverse_postorder_indices_[0] = 0;
+  dfs_stack_.emplace_back(blocks_[0], blocks_[0]->outgoing_edge_head);
+  while (!dfs_stack_.empty()) {
+    auto& [block, edge] = dfs_stack_.back();
+    if (!edge) {
+      reverse_postorder_.push_back(block->ordinal);
+      dfs_stack_.pop_back();
+      continue;
+    }
+    Block* successor = edge->dest;
+    edge = edge->outgoing_next;
+    if (reverse_postorder_indices_[successor->ordinal] == UINT32_MAX) {
+      reverse_postorder_indices_[successor->ordinal] = 0;
+      dfs_stack_.emplace_back(successor, successor->outgoing_edge_head);
+    }
+  }
+  std::reverse(reverse_postorder_.begin(), reverse_postorder_.end());
+  for (uint32_t i = 0; i < uint32_t(reverse_postorder_.size()); ++i) {
+    reverse_postorder_indices_[reverse_postorder_[i]] = i;
+  }
+
+  // "A Simple, Fast Dominance Algorithm" by Cooper, Harvey and Kennedy.
+  immediate_dominators_.clear();
+  immediate_dominators_.resize(block_count, UINT32_MAX);
+  immediate_dominators_[0] = 0;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t i = 1; i < reverse_postorder_.size(); ++i) {
+      uint32_t block = reverse_postorder_[i];
+      uint32_t immediate_dominator = UINT32_MAX;
+      for (auto edge = blocks_[block]->incoming_edge_head; edge;
+           edge = edge->incoming_next) {
+        uint32_t predecessor = edge->src->ordinal;
+        if (immediate_dominators_[predecessor] == UINT32_MAX) {
+          // Not processed yet or unreachable.
+          continue;
+        }
+        immediate_dominator =
+            immediate_dominator == UINT32_MAX
+                ? predecessor
+                : IntersectDominators(predecessor, immediate_dominator);
+      }
+      if (immediate_dominators_[block] != immediate_dominator) {
+        immediate_dominators_[block] = immediate_dominator;
+        changed = true;
+      }
+    }
+  }
+
+  dominated_blocks_.resize(std::max(dominated_blocks_.size(),
+                                    size_t(block_count)));
+  for (uint32_t i = 0; i < block_count; ++i) {
+    dominated_blocks_[i].clear();
+  }
+  for (size_t i = 1; i < reverse_postorder_.size(); ++i) {
+    uint32_t block = reverse_postorder_[i];
+    dominated_blocks_[immediate_dominators_[block]].push_back(block);
+  }
+}
+
+uint32_t GlobalValueNumberingPass::IntersectDominators(uint32_t a,
+                                                       uint32_t b) const {
+  while (a != b) {
+    while (reverse_postorder_indices_[a] > reverse_postorder_indices_[b]) {
+      a = immediate_dominators_[a];
+    }
+    while (reverse_postorder_indices_[b] > reverse_postorder_indices_[a]) {
+      b = immediate_dominators_[b];
+    }
+  }
+  return a;
+}
+
+void GlobalValueNumberingPass::NumberBlock(Block* block) {
+  Expression expression;
+  for (auto instr = block->instr_head; instr; instr = instr->next) {
+    if (instr->opcode == &OPCODE_ASSIGN_info || !IsPure(instr)) {
+      continue;
+    }
+    BuildExpression(instr, expression);
+    auto it = available_.find(expression);
+    if (it == available_.end()) {
+      available_.emplace(expression, instr->dest);
+      scope_expressions_.push_back(expression);
+      continue;
+    }
+    instr->Replace(&OPCODE_ASSIGN_info, 0);
+    instr->set_src1(it->second);
+  }
+}
+
+void GlobalValueNumberingPass::BuildExpression(const Instr* instr,
+                                               Expression& expression) {
+  // Compared as bytes.
+  std::memset(&expression, 0, sizeof(expression));
+  expression.opcode = instr->opcode;
+  expression.flags = instr->flags;
+  expression.type = instr->dest->type;
+  uint32_t signature = instr->opcode->signature;
+  OpcodeSignatureType operand_types[] = {
+      OpcodeSignatureType(GET_OPCODE_SIG_TYPE_SRC1(signature)),
+      OpcodeSignatureType(GET_OPCODE_SIG_TYPE_SRC2(signature)),
+      OpcodeSignatureType(GET_OPCODE_SIG_TYPE_SRC3(signature)),
+  };
+  for (uint32_t i = 0; i < 3; ++i) {
+    Operand& operand = expression.operands[i];
+    if (operand_types[i] == OPCODE_SIG_TYPE_O) {
+      operand.kind = 3;
+      operand.data[0] = instr->srcs[i].offset;
+    } else if (operand_types[i] == OPCODE_SIG_TYPE_V) {
+      Value* value = ResolveAssignments(instr->srcs[i].value);
+      operand.type = value->type;
+      if (value->IsConstant()) {
+        operand.kind = 2;
+        std::memcpy(operand.data, &value->constant,
+                    GetTypeSize(value->type));
+      } else {
+        operand.kind = 1;
+        operand.data[0] = uint64_t(uintptr_t(value));
+      }
+    }
+  }
+  if ((instr->opcode->flags & OPCODE_FLAG_COMMUNATIVE) &&
+      std::memcmp(&expression.operands[0], &expression.operands[1],
+                  sizeof(Operand)) > 0) {
+    std::swap(expression.operands[0], expression.operands[1]);
+  }
+}
+
+}  // namespace passes
+}  // namespace compiler
+}  // namespace cpu
+}  // namespace xe
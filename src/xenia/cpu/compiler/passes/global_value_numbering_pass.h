@@ -0,0 +1,98 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_CPU_COMPILER_PASSES_GLOBAL_VALUE_NUMBERING_PASS_H_
+#define XENIA_CPU_COMPILER_PASSES_GLOBAL_VALUE_NUMBERING_PASS_H_
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "xenia/cpu/compiler/compiler_pass.h"
+
+namespace xe {
+namespace cpu {
+namespace compiler {
+namespace passes {
+
+// Replaces instructions computing the same value as an instruction in a
+// dominating block, or earlier in the same block, with assignments of that
+// value. Requires the CFG.
+class GlobalValueNumberingPass : public CompilerPass {
+ public:
+  GlobalValueNumberingPass();
+  ~GlobalValueNumberingPass() override;
+
+  bool Run(hir::HIRBuilder* builder) override;
+
+  // Whether the result of the instruction only depends on its operands, and
+  // it can be executed anywhere they're available without side effects.
+  // Guest memory accesses are never pure, as the memory may be written by
+  // other threads or be MMIO, and neither are floating-point operations, as
+  // the rounding and denormal modes may change between them.
+  static bool IsPure(const hir::Instr* instr);
+
+ private:
+  struct Operand {
+    // 0 if none, 1 for values, 2 for constants, 3 for offsets.
+    uint32_t kind;
+    uint32_t type;
+    // The value pointer, the constant bits, or the offset.
+    uint64_t data[2];
+  };
+  struct Expression {
+    const hir::OpcodeInfo* opcode;
+    uint32_t flags;
+    uint32_t type;
+    Operand operands[3];
+
+    bool operator==(const Expression& other) const {
+      return !std::memcmp(this, &other, sizeof(*this));
+    }
+  };
+  struct ExpressionHasher {
+    size_t operator()(const Expression& expression) const;
+  };
+  struct WalkEntry {
+    uint32_t block;
+    uint32_t next_dominated_block;
+    // Size of scope_expressions_ before the block.
+    uint32_t scope_start;
+  };
+
+  void ComputeDominators(hir::HIRBuilder* builder);
+  uint32_t IntersectDominators(uint32_t a, uint32_t b) const;
+  void NumberBlock(hir::Block* block);
+  static void BuildExpression(const hir::Instr* instr, Expression& expression);
+
+  // By block ordinal.
+  std::vector<hir::Block*> blocks_;
+  // UINT32_MAX for blocks unreachable from the entry.
+  std::vector<uint32_t> reverse_postorder_indices_;
+  std::vector<uint32_t> reverse_postorder_;
+  std::vector<uint32_t> immediate_dominators_;
+  std::vector<std::vector<uint32_t>> dominated_blocks_;
+  std::vector<std::pair<hir::Block*, hir::Edge*>> dfs_stack_;
+
+  // Expressions available in the current block, from it and the blocks
+  // dominating it, with the ones added by each block removed after visiting
+  // the blocks it dominates.
+  std::unordered_map<Expression, hir::Value*, ExpressionHasher> available_;
+  std::vector<Expression> scope_expressions_;
+  std::vector<WalkEntry> walk_stack_;
+};
+
+}  // namespace passes
+}  // namespace compiler
+}  // namespace cpu
+}  // namespace xe
+
+#endif  // XENIA_CPU_COMPILER_PASSES_GLOBAL_VALUE_NUMBERING_PASS_H_
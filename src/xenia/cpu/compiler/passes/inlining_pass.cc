@@ -0,0 +1,126 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/compiler/passes/inlining_pass.h"
+
+#include <vector>
+
+#include "xenia/base/profiling.h"
+#include "xenia/cpu/cpu_flags.h"
+#include "xenia/cpu/function.h"
+
+namespace xe {
+namespace cpu {
+namespace compiler {
+namespace passes {
+
+// TODO(benvanik): remove when enums redefined.
+using namespace xe::cpu::hir;
+
+using xe::cpu::hir::HIRBuilder;
+using xe::cpu::hir::Instr;
+using xe::cpu::hir::Label;
+
+InliningPass::InliningPass() : CompilerPass() {}
+
+InliningPass::~InliningPass() {}
+
+bool InliningPass::Run(HIRBuilder* builder) {
+  SCOPE_profile_cpu_f("cpu");
+
+  // Gather the calls first so calls in the inlined code, appended after the
+  // last block, are not inlined recursively.
+  std::vector<Instr*> calls;
+  auto block = builder->first_block();
+  while (block) {
+    auto i = block->instr_head;
+    while (i) {
+      if (i->opcode == &OPCODE_CALL_info) {
+        calls.push_back(i);
+      }
+      i = i->next;
+    }
+    block = block->next;
+  }
+
+  uint32_t budget = cvars::inline_function_budget;
+  bool inlined_any = false;
+  for (Instr* call : calls) {
+    Function* function = call->src1.symbol;
+    if (!function) {
+      continue;
+    }
+    switch (function->behavior()) {
+      case Function::Behavior::kDefault:
+      case Function::Behavior::kProlog:
+      case Function::Behavior::kEpilog:
+      case Function::Behavior::kEpilogReturn:
+        break;
+      default:
+        continue;
+    }
+    // Only the extents of functions already analyzed are final - the
+    // save/restore helpers are declared with theirs.
+    if (!function->has_end_address() ||
+        (function->status() != Symbol::Status::kDefined &&
+         !function->IsSaverest())) {
+      continue;
+    }
+    uint32_t instruction_count =
+        (function->end_address() - function->address()) / 4 + 1;
+    if (instruction_count > cvars::inline_function_max_instructions ||
+        instruction_count > budget) {
+      continue;
+    }
+
+    // Calls end their block, and Finalize adds the branch to the block after it
+    // that the inlined code returns to. Tail calls return from the caller.
+    Label* return_label = nullptr;
+    if (!(call->flags & CALL_TAIL)) {
+      Instr* next = call->next;
+      if (!next || next->opcode != &OPCODE_BRANCH_info) {
+        continue;
+      }
+      return_label = next->src1.label;
+    }
+
+    Label* entry_label = builder->EmitInlinedFunction(
+        function, FindCallAddress(call), return_label);
+    if (!entry_label) {
+      continue;
+    }
+    if (return_label) {
+      call->next->UnlinkAndNOP();
+    }
+    call->Replace(&OPCODE_BRANCH_info, 0);
+    call->src1.label = entry_label;
+    budget -= instruction_count;
+    inlined_any = true;
+  }
+
+  // Add the fallthrough branches between the new blocks.
+  if (inlined_any) {
+    builder->Finalize();
+  }
+  return true;
+}
+
+uint32_t InliningPass::FindCallAddress(Instr* call) {
+  for (Instr* i = call->prev; i; i = i->prev) {
+    if (i->opcode == &OPCODE_SOURCE_OFFSET_info) {
+      return static_cast<uint32_t>(i->src1.offset);
+    }
+  }
+  return 0;
+}
+
+}  // namespace passes
+}  // namespace compiler
+}  // namespace cpu
+}  // namespace xe
@@ -0,0 +1,39 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_CPU_COMPILER_PASSES_INLINING_PASS_H_
+#define XENIA_CPU_COMPILER_PASSES_INLINING_PASS_H_
+
+#include "xenia/cpu/compiler/compiler_pass.h"
+
+namespace xe {
+namespace cpu {
+namespace compiler {
+namespace passes {
+
+// Replaces direct calls of small functions with their code, emitted by the
+// frontend through HIRBuilder::EmitInlinedFunction. Must run before the CFG is
+// built, as it adds blocks.
+class InliningPass : public CompilerPass {
+ public:
+  InliningPass();
+  ~InliningPass() override;
+
+  bool Run(hir::HIRBuilder* builder) override;
+
+ private:
+  static uint32_t FindCallAddress(hir::Instr* call);
+};
+
+}  // namespace passes
+}  // namespace compiler
+}  // namespace cpu
+}  // namespace xe
+
+#endif  // XENIA_CPU_COMPILER_PASSES_INLINING_PASS_H_
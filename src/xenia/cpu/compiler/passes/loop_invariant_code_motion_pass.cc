@@ -0,0 +1,196 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/compiler/passes/loop_invariant_code_motion_pass.h"
+
+#include <algorithm>
+
+#include "xenia/base/profiling.h"
+#include "xenia/cpu/compiler/compiler.h"
+#include "xenia/cpu/compiler/passes/global_value_numbering_pass.h"
+
+namespace xe {
+namespace cpu {
+namespace compiler {
+namespace passes {
+
+// TODO(benvanik): remove when enums redefined.
+using namespace xe::cpu::hir;
+
+using xe::cpu::hir::Block;
+using xe::cpu::hir::HIRBuilder;
+using xe::cpu::hir::Instr;
+using xe::cpu::hir::Label;
+using xe::cpu::hir::Value;
+
+LoopInvariantCodeMotionPass::LoopInvariantCodeMotionPass() : CompilerPass() {}
+
+LoopInvariantCodeMotionPass::~LoopInvariantCodeMotionPass() {}
+
+bool LoopInvariantCodeMotionPass::Run(HIRBuilder* builder) {
+  SCOPE_profile_cpu_f("cpu");
+
+  blocks_.clear();
+  for (auto block = builder->first_block(); block; block = block->next) {
+    block->ordinal = uint16_t(blocks_.size());
+    blocks_.push_back(block);
+  }
+
+  // As in register allocation, branches to the same or an earlier block form
+  // loops, spanning the blocks from the target to the last block branching
+  // to it in the block order.
+  loops_.clear();
+  for (Block* block : blocks_) {
+    for (auto instr = block->instr_head; instr; instr = instr->next) {
+      if (!(instr->opcode->flags & OPCODE_FLAG_BRANCH)) {
+        continue;
+      }
+      uint32_t signature = instr->opcode->signature;
+      Label* labels[] = {
+          GET_OPCODE_SIG_TYPE_SRC1(signature) == OPCODE_SIG_TYPE_L
+              ? instr->src1.label
+              : nullptr,
+          GET_OPCODE_SIG_TYPE_SRC2(signature) == OPCODE_SIG_TYPE_L
+              ? instr->src2.label
+              : nullptr,
+          GET_OPCODE_SIG_TYPE_SRC3(signature) == OPCODE_SIG_TYPE_L
+              ? instr->src3.label
+              : nullptr,
+      };
+      for (Label* label : labels) {
+        if (!label || label->block->ordinal > block->ordinal) {
+          continue;
+        }
+        uint32_t header = label->block->ordinal;
+        auto loop_it = std::find_if(
+            loops_.begin(), loops_.end(),
+            [header](const Loop& loop) { return loop.header == header; });
+        if (loop_it != loops_.end()) {
+          loop_it->latch = std::max(loop_it->latch, uint32_t(block->ordinal));
+        } else {
+          loops_.push_back({header, block->ordinal});
+        }
+      }
+    }
+  }
+
+  // Inner loops first, so what's moved out of them into the outer loops may
+  // be moved further.
+  std::sort(loops_.begin(), loops_.end(), [](const Loop& a, const Loop& b) {
+    return a.latch - a.header < b.latch - b.header;
+  });
+  for (const Loop& loop : loops_) {
+    if (IsEnteredOnlyFromPreheader(loop)) {
+      HoistLoop(loop);
+    }
+  }
+  return true;
+}
+
+bool LoopInvariantCodeMotionPass::IsEnteredOnlyFromPreheader(
+    const Loop& loop) const {
+  // The preheader is the block before the header, where the instructions are
+  // moved, and it must always branch to the header at its end.
+  Block* header = blocks_[loop.header];
+  Block* preheader = header->prev;
+  if (!preheader) {
+    return false;
+  }
+  Instr* preheader_tail = preheader->instr_tail;
+  if (!preheader_tail || preheader_tail->opcode != &OPCODE_BRANCH_info ||
+      preheader_tail->src1.label->block != header) {
+    return false;
+  }
+  uint32_t preheader_edge_count = 0;
+  for (uint32_t i = loop.header; i <= loop.latch; ++i) {
+    for (auto edge = blocks_[i]->incoming_edge_head; edge;
+         edge = edge->incoming_next) {
+      uint32_t source = edge->src->ordinal;
+      if (source >= loop.header && source <= loop.latch) {
+        continue;
+      }
+      if (i != loop.header || edge->src != preheader) {
+        return false;
+      }
+      ++preheader_edge_count;
+    }
+  }
+  return preheader_edge_count == 1;
+}
+
+void LoopInvariantCodeMotionPass::HoistLoop(const Loop& loop) {
+  // Context loads are invariant if nothing in the loop may write the loaded
+  // bytes. Guest memory loads are never moved - the memory may be written by
+  // other threads or be MMIO, and spin loops wait for such writes.
+  bool context_clobbered = false;
+  context_stores_.clear();
+  for (uint32_t i = loop.header; i <= loop.latch; ++i) {
+    for (auto instr = blocks_[i]->instr_head; instr; instr = instr->next) {
+      if (instr->opcode->flags & OPCODE_FLAG_VOLATILE ||
+          instr->opcode == &OPCODE_CONTEXT_BARRIER_info) {
+        context_clobbered = true;
+      } else if (instr->opcode == &OPCODE_STORE_CONTEXT_info) {
+        context_stores_.emplace_back(
+            uint32_t(instr->src1.offset),
+            uint32_t(GetTypeSize(instr->src2.value->type)));
+      }
+    }
+  }
+
+  // Visiting in order, so instructions only depending on the results of the
+  // instructions already moved are moved as well.
+  Instr* insertion_point = blocks_[loop.header]->prev->instr_tail;
+  for (uint32_t i = loop.header; i <= loop.latch; ++i) {
+    Instr* instr = blocks_[i]->instr_head;
+    while (instr) {
+      Instr* next = instr->next;
+      if (IsInvariant(instr, loop, context_clobbered)) {
+        instr->MoveBefore(insertion_point);
+      }
+      instr = next;
+    }
+  }
+}
+
+bool LoopInvariantCodeMotionPass::IsInvariant(Instr* instr, const Loop& loop,
+                                              bool context_clobbered) const {
+  if (instr->opcode == &OPCODE_LOAD_CONTEXT_info) {
+    if (context_clobbered) {
+      return false;
+    }
+    uint32_t offset = uint32_t(instr->src1.offset);
+    uint32_t end = offset + uint32_t(GetTypeSize(instr->dest->type));
+    for (const auto& store : context_stores_) {
+      if (store.first < end && offset < store.first + store.second) {
+        return false;
+      }
+    }
+    return true;
+  }
+  if (!GlobalValueNumberingPass::IsPure(instr)) {
+    return false;
+  }
+  bool invariant = true;
+  instr->VisitValueOperands([&loop, &invariant](Value* value, uint32_t index) {
+    if (value->IsConstant()) {
+      return;
+    }
+    // Moved instructions are in the preheader.
+    if (!value->def || (value->def->block->ordinal >= loop.header &&
+                        value->def->block->ordinal <= loop.latch)) {
+      invariant = false;
+    }
+  });
+  return invariant;
+}
+
+}  // namespace passes
+}  // namespace compiler
+}  // namespace cpu
+}  // namespace xe
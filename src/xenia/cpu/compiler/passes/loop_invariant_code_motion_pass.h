@@ -0,0 +1,57 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_CPU_COMPILER_PASSES_LOOP_INVARIANT_CODE_MOTION_PASS_H_
+#define XENIA_CPU_COMPILER_PASSES_LOOP_INVARIANT_CODE_MOTION_PASS_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "xenia/cpu/compiler/compiler_pass.h"
+
+namespace xe {
+namespace cpu {
+namespace compiler {
+namespace passes {
+
+// Moves the instructions computing the same value in every iteration of a
+// loop to the block before the loop. Requires the CFG.
+class LoopInvariantCodeMotionPass : public CompilerPass {
+ public:
+  LoopInvariantCodeMotionPass();
+  ~LoopInvariantCodeMotionPass() override;
+
+  bool Run(hir::HIRBuilder* builder) override;
+
+ private:
+  // Ordinals of the first and the last blocks of the loop.
+  struct Loop {
+    uint32_t header;
+    uint32_t latch;
+  };
+
+  bool IsEnteredOnlyFromPreheader(const Loop& loop) const;
+  void HoistLoop(const Loop& loop);
+  bool IsInvariant(hir::Instr* instr, const Loop& loop,
+                   bool context_clobbered) const;
+
+  // By block ordinal.
+  std::vector<hir::Block*> blocks_;
+  std::vector<Loop> loops_;
+  // Offsets and sizes of the context stores in the loop.
+  std::vector<std::pair<uint32_t, uint32_t>> context_stores_;
+};
+
+}  // namespace passes
+}  // namespace compiler
+}  // namespace cpu
+}  // namespace xe
+
+#endif  // XENIA_CPU_COMPILER_PASSES_LOOP_INVARIANT_CODE_MOTION_PASS_H_
@@ -9,8 +9,19 @@
 
 #include "xenia/cpu/compiler/passes/memory_sequence_combination_pass.h"
 
+#include <algorithm>
+
+#include "xenia/base/cvar.h"
+#include "xenia/base/math.h"
 #include "xenia/base/profiling.h"
 
+DEFINE_bool(non_temporal_dcbz_loops, false,
+            "Bypass the host cache when zeroing memory in loops doing nothing "
+            "else with memory, such as memset of large buffers. Faster for "
+            "buffers larger than the host cache, but slower if the memory is "
+            "used soon after.",
+            "CPU");
+
 namespace xe {
 namespace cpu {
 namespace compiler {
@@ -19,10 +30,93 @@ namespace passes {
 // TODO(benvanik): remove when enums redefined.
 using namespace xe::cpu::hir;
 
+using xe::cpu::hir::Block;
 using xe::cpu::hir::HIRBuilder;
 using xe::cpu::hir::Instr;
+using xe::cpu::hir::Label;
 using xe::cpu::hir::Value;
 
+namespace {
+
+Value* SkipAssignments(Value* value) {
+  while (!value->IsConstant() && value->def &&
+         value->def->opcode == &OPCODE_ASSIGN_info) {
+    value = value->def->src1.value;
+  }
+  return value;
+}
+
+// The values and the constant added together to form an address.
+struct AddressTerms {
+  Value* values[4];
+  uint32_t value_count = 0;
+  uint64_t offset = 0;
+};
+
+bool DecomposeAddress(Value* address, AddressTerms& terms) {
+  Value* pending[8];
+  uint32_t pending_count = 0;
+  pending[pending_count++] = address;
+  while (pending_count) {
+    Value* value = SkipAssignments(pending[--pending_count]);
+    if (value->IsConstant()) {
+      terms.offset += uint64_t(value->constant.i64);
+      continue;
+    }
+    if (value->def && value->def->opcode == &OPCODE_ADD_info) {
+      if (pending_count + 2 > xe::countof(pending)) {
+        return false;
+      }
+      pending[pending_count++] = value->def->src1.value;
+      pending[pending_count++] = value->def->src2.value;
+      continue;
+    }
+    if (terms.value_count >= xe::countof(terms.values)) {
+      return false;
+    }
+    terms.values[terms.value_count++] = value;
+  }
+  std::sort(terms.values, terms.values + terms.value_count);
+  return true;
+}
+
+// Whether the right half of the vector at the left address is accessed at
+// the right address - the halves accessed by the Cell lvlx and lvrx, or
+// stvlx and stvrx, together forming an unaligned vector access.
+bool AreVectorHalfAddresses(Value* left_address, Value* right_address) {
+  AddressTerms left_terms, right_terms;
+  if (!DecomposeAddress(left_address, left_terms) ||
+      !DecomposeAddress(right_address, right_terms) ||
+      left_terms.value_count != right_terms.value_count ||
+      right_terms.offset - left_terms.offset != 16) {
+    return false;
+  }
+  return std::equal(left_terms.values,
+                    left_terms.values + left_terms.value_count,
+                    right_terms.values);
+}
+
+// Whether last is after first in the same block, with no memory accesses
+// between them.
+bool IsLaterWithoutMemoryAccesses(const Instr* first, const Instr* last) {
+  for (const Instr* instr = first->next; instr; instr = instr->next) {
+    if (instr == last) {
+      return true;
+    }
+    if (instr->opcode->flags & (OPCODE_FLAG_MEMORY | OPCODE_FLAG_VOLATILE)) {
+      return false;
+    }
+  }
+  return false;
+}
+
+bool IsCacheLineMemset(const Instr* i) {
+  return i->opcode == &OPCODE_MEMSET_info && i->src3.value->IsConstant() &&
+         i->src3.value->constant.i64 == 128;
+}
+
+}  // namespace
+
 MemorySequenceCombinationPass::MemorySequenceCombinationPass()
     : CompilerPass() {}
 
@@ -31,24 +125,86 @@ MemorySequenceCombinationPass::~MemorySequenceCombinationPass() = default;
 bool MemorySequenceCombinationPass::Run(HIRBuilder* builder) {
   // Run over all loads and stores and see if we can collapse sequences into the
   // fat opcodes. See the respective utility functions for examples.
+  if (cvars::non_temporal_dcbz_loops) {
+    MarkStreamingMemsets(builder);
+  }
   auto block = builder->first_block();
   while (block) {
     auto i = block->instr_head;
     while (i) {
+      // Combining unaligned vector accesses moves or removes the instruction.
+      auto next = i->next;
       if (i->opcode == &OPCODE_LOAD_info ||
           i->opcode == &OPCODE_LOAD_OFFSET_info) {
         CombineLoadSequence(i);
       } else if (i->opcode == &OPCODE_STORE_info ||
                  i->opcode == &OPCODE_STORE_OFFSET_info) {
         CombineStoreSequence(i);
+      } else if (i->opcode == &OPCODE_OR_info &&
+                 i->dest->type == VEC128_TYPE) {
+        CombineUnalignedVectorLoad(i);
+      } else if (i->opcode == &OPCODE_STVL_info ||
+                 i->opcode == &OPCODE_STVR_info) {
+        CombineUnalignedVectorStore(i);
       }
-      i = i->next;
+      i = next;
     }
     block = block->next;
   }
   return true;
 }
 
+void MemorySequenceCombinationPass::MarkStreamingMemsets(HIRBuilder* builder) {
+  // Loops from branches to the same or an earlier block, with memory only
+  // accessed by whole cache line memsets from dcbz128.
+  uint16_t block_ordinal = 0;
+  for (auto block = builder->first_block(); block; block = block->next) {
+    block->ordinal = block_ordinal++;
+  }
+  for (auto block = builder->first_block(); block; block = block->next) {
+    for (auto i = block->instr_head; i; i = i->next) {
+      Label* label = nullptr;
+      if (i->opcode == &OPCODE_BRANCH_info) {
+        label = i->src1.label;
+      } else if (i->opcode == &OPCODE_BRANCH_TRUE_info ||
+                 i->opcode == &OPCODE_BRANCH_FALSE_info) {
+        label = i->src2.label;
+      }
+      if (!label || label->block->ordinal > block->ordinal) {
+        continue;
+      }
+      Block* loop_end = block->next;
+      bool streaming = true;
+      bool sets_cache_lines = false;
+      for (auto loop_block = label->block; streaming && loop_block != loop_end;
+           loop_block = loop_block->next) {
+        for (auto loop_i = loop_block->instr_head; loop_i;
+             loop_i = loop_i->next) {
+          if (IsCacheLineMemset(loop_i)) {
+            sets_cache_lines = true;
+          } else if (loop_i->opcode->flags &
+                     (OPCODE_FLAG_MEMORY | OPCODE_FLAG_VOLATILE)) {
+            streaming = false;
+            break;
+          }
+        }
+      }
+      if (!streaming || !sets_cache_lines) {
+        continue;
+      }
+      for (auto loop_block = label->block; loop_block != loop_end;
+           loop_block = loop_block->next) {
+        for (auto loop_i = loop_block->instr_head; loop_i;
+             loop_i = loop_i->next) {
+          if (IsCacheLineMemset(loop_i)) {
+            loop_i->flags |= MEMSET_NON_TEMPORAL;
+          }
+        }
+      }
+    }
+  }
+}
+
 void MemorySequenceCombinationPass::CombineLoadSequence(Instr* i) {
   // Load with swap:
   //   v1.i32 = load v0
@@ -150,6 +306,91 @@ void MemorySequenceCombinationPass::CombineStoreSequence(Instr* i) {
   // TODO(benvanik): extend/truncate.
 }
 
+void MemorySequenceCombinationPass::CombineUnalignedVectorLoad(Instr* i) {
+  // Unaligned vector load:
+  //   v2.v128 = loadv_left v0.i64
+  //   v3.v128 = loadv_right v1.i64  ; v1 = v0 + 16
+  //   v4.v128 = or v2.v128, v3.v128
+  // becomes:
+  //   v4.v128 = load v0.i64, [swap|unaligned]
+  //
+  // Both halves are in the two 16-byte blocks containing the unaligned
+  // vector, or only in the first one if it's aligned, so no other pages are
+  // accessed.
+  Instr* left = SkipAssignments(i->src1.value)->def;
+  Instr* right = SkipAssignments(i->src2.value)->def;
+  if (!left || !right) {
+    return;
+  }
+  if (left->opcode == &OPCODE_LVR_info) {
+    std::swap(left, right);
+  }
+  if (left->opcode != &OPCODE_LVL_info || right->opcode != &OPCODE_LVR_info ||
+      left->block != i->block || right->block != i->block ||
+      !AreVectorHalfAddresses(left->src1.value, right->src1.value)) {
+    return;
+  }
+  // The whole vector is loaded at the later of the halves, so the memory must
+  // not be written between them.
+  Instr* last;
+  if (IsLaterWithoutMemoryAccesses(left, right)) {
+    last = right;
+  } else if (IsLaterWithoutMemoryAccesses(right, left)) {
+    last = left;
+  } else {
+    return;
+  }
+
+  Value* address = left->src1.value;
+  i->Replace(&OPCODE_LOAD_info, LoadStoreFlags::LOAD_STORE_BYTE_SWAP |
+                                    LoadStoreFlags::LOAD_STORE_UNALIGNED);
+  i->set_src1(address);
+  i->src2.value = i->src3.value = nullptr;
+  if (last->next != i) {
+    i->MoveBefore(last->next);
+  }
+  // The halves will go away in DCE if not used elsewhere.
+}
+
+void MemorySequenceCombinationPass::CombineUnalignedVectorStore(Instr* i) {
+  // Unaligned vector store:
+  //   storev_left v0.i64, v2.v128
+  //   storev_right v1.i64, v2.v128  ; v1 = v0 + 16
+  // becomes:
+  //   store v0.i64, v2.v128, [swap|unaligned]
+  //
+  // The halves may be stored in any order. The whole vector is stored at the
+  // later one, so the memory must not be accessed between them.
+  const OpcodeInfo* other_half_opcode =
+      i->opcode == &OPCODE_STVL_info ? &OPCODE_STVR_info : &OPCODE_STVL_info;
+  Value* value = SkipAssignments(i->src2.value);
+  Instr* other_half = i->next;
+  while (other_half && other_half->opcode != other_half_opcode) {
+    if (other_half->opcode->flags &
+        (OPCODE_FLAG_MEMORY | OPCODE_FLAG_VOLATILE)) {
+      return;
+    }
+    other_half = other_half->next;
+  }
+  if (!other_half || SkipAssignments(other_half->src2.value) != value) {
+    return;
+  }
+  Instr* left = i->opcode == &OPCODE_STVL_info ? i : other_half;
+  Instr* right = left == i ? other_half : i;
+  if (!AreVectorHalfAddresses(left->src1.value, right->src1.value)) {
+    return;
+  }
+
+  Value* address = left->src1.value;
+  other_half->Replace(&OPCODE_STORE_info,
+                      LoadStoreFlags::LOAD_STORE_BYTE_SWAP |
+                          LoadStoreFlags::LOAD_STORE_UNALIGNED);
+  other_half->set_src1(address);
+  other_half->set_src2(value);
+  other_half->src3.value = nullptr;
+  i->UnlinkAndNOP();
+}
+
 }  // namespace passes
 }  // namespace compiler
 }  // namespace cpu
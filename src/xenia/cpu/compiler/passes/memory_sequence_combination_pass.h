@@ -26,8 +26,11 @@ class MemorySequenceCombinationPass : public CompilerPass {
 
  private:
   void CombineMemorySequences(hir::HIRBuilder* builder);
+  void MarkStreamingMemsets(hir::HIRBuilder* builder);
   void CombineLoadSequence(hir::Instr* i);
   void CombineStoreSequence(hir::Instr* i);
+  void CombineUnalignedVectorLoad(hir::Instr* i);
+  void CombineUnalignedVectorStore(hir::Instr* i);
 };
 
 }  // namespace passes
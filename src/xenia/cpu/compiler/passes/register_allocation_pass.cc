@@ -13,10 +13,16 @@
 #include <cstring>
 
 #include "xenia/base/assert.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/profiling.h"
 
+DEFINE_bool(global_register_allocation, true,
+            "Keep values used in multiple blocks in host registers across the "
+            "blocks when possible, instead of passing them through the stack.",
+            "CPU");
+
 namespace xe {
 namespace cpu {
 namespace compiler {
@@ -72,10 +78,20 @@ RegisterAllocationPass::~RegisterAllocationPass() {
 
 bool RegisterAllocationPass::Run(HIRBuilder* builder) {
   // Simple per-block allocator that operates on SSA form.
-  // Registers do not move across blocks, though this could be
-  // optimized with some intra-block analysis (dominators/etc).
+  // Values used in multiple blocks are first assigned registers for their whole
+  // live range with a linear scan over the function, or passed through locals,
+  // and the remaining registers of each block are then allocated to the values
+  // local to it.
   // Really, it'd just be nice to have someone who knew what they
   // were doing lower SSA and do this right.
+  for (size_t i = 0; i < xe::countof(usage_sets_.all_sets); ++i) {
+    if (usage_sets_.all_sets[i]) {
+      usage_sets_.all_sets[i]->global_registers.clear();
+    }
+  }
+  if (cvars::global_register_allocation) {
+    AllocateGlobalRegisters(builder);
+  }
 
   uint16_t block_ordinal = 0;
   uint32_t instr_ordinal = 0;
@@ -85,7 +101,7 @@ bool RegisterAllocationPass::Run(HIRBuilder* builder) {
     block->ordinal = block_ordinal++;
 
     // Reset all state.
-    PrepareBlockState();
+    PrepareBlockState(block->ordinal);
 
     // Renumber all instructions in the block. This is required so that
     // we can sort the usage pointers below.
@@ -125,9 +141,9 @@ bool RegisterAllocationPass::Run(HIRBuilder* builder) {
         }
       }
 
-      if (GET_OPCODE_SIG_TYPE_DEST(signature) == OPCODE_SIG_TYPE_V) {
-        // Must not have been set already.
-        assert_null(instr->dest->reg.set);
+      if (GET_OPCODE_SIG_TYPE_DEST(signature) == OPCODE_SIG_TYPE_V &&
+          !instr->dest->reg.set) {
+        // Not assigned a register by AllocateGlobalRegisters.
 
         // Sort the usage list. We depend on this in future uses of this
         // variable.
@@ -173,6 +189,276 @@ bool RegisterAllocationPass::Run(HIRBuilder* builder) {
   return true;
 }
 
+namespace {
+bool IsCallClobberingRegisters(const Instr* instr) {
+  if (instr->opcode == &OPCODE_CALL_info ||
+      instr->opcode == &OPCODE_CALL_TRUE_info ||
+      instr->opcode == &OPCODE_CALL_INDIRECT_info ||
+      instr->opcode == &OPCODE_CALL_INDIRECT_TRUE_info) {
+    // Nothing is live after a tail call.
+    return !(instr->flags & CALL_TAIL);
+  }
+  return instr->opcode == &OPCODE_CALL_EXTERN_info;
+}
+
+bool IsUsedInOtherBlock(const Value* value) {
+  for (auto use = value->use_head; use; use = use->next) {
+    if (use->instr->block != value->def->block) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+void RegisterAllocationPass::AllocateGlobalRegisters(HIRBuilder* builder) {
+  // Number the instructions across the function, and gather the ranges of the
+  // blocks, the calls clobbering all the registers, and the values live in
+  // multiple blocks. The lists are kept across functions to reuse their
+  // storage.
+  auto& block_ranges = global_block_ranges_;
+  auto& calls = global_calls_;
+  auto& global_values = global_values_;
+  block_ranges.clear();
+  calls.clear();
+  global_values.clear();
+  uint16_t block_ordinal = 0;
+  uint32_t instr_ordinal = 0;
+  for (auto block = builder->first_block(); block; block = block->next) {
+    block->ordinal = block_ordinal++;
+    BlockRange& block_range = block_ranges.emplace_back();
+    block_range.start = instr_ordinal;
+    for (auto instr = block->instr_head; instr; instr = instr->next) {
+      instr->ordinal = instr_ordinal++;
+      if (IsCallClobberingRegisters(instr)) {
+        calls.push_back(instr->ordinal);
+      }
+      if (GET_OPCODE_SIG_TYPE_DEST(instr->opcode->signature) ==
+              OPCODE_SIG_TYPE_V &&
+          IsUsedInOtherBlock(instr->dest)) {
+        global_values.push_back(instr->dest);
+      }
+    }
+    block_range.end = instr_ordinal;
+  }
+  if (global_values.empty()) {
+    return;
+  }
+
+  // Branches to the same or an earlier block form loops, with values live
+  // anywhere in one live throughout it.
+  auto& loops = global_loops_;
+  loops.clear();
+  for (auto block = builder->first_block(); block; block = block->next) {
+    for (auto instr = block->instr_head; instr; instr = instr->next) {
+      if (!(instr->opcode->flags & OPCODE_FLAG_BRANCH)) {
+        continue;
+      }
+      uint32_t signature = instr->opcode->signature;
+      Label* labels[] = {
+          GET_OPCODE_SIG_TYPE_SRC1(signature) == OPCODE_SIG_TYPE_L
+              ? instr->src1.label
+              : nullptr,
+          GET_OPCODE_SIG_TYPE_SRC2(signature) == OPCODE_SIG_TYPE_L
+              ? instr->src2.label
+              : nullptr,
+          GET_OPCODE_SIG_TYPE_SRC3(signature) == OPCODE_SIG_TYPE_L
+              ? instr->src3.label
+              : nullptr,
+      };
+      for (Label* label : labels) {
+        if (label && label->block->ordinal <= block->ordinal) {
+          loops.push_back({block_ranges[label->block->ordinal].start,
+                           block_ranges[block->ordinal].end});
+        }
+      }
+    }
+  }
+
+  // Live intervals, conservatively covering every instruction on a path from
+  // the definition to a use.
+  auto& intervals = global_intervals_;
+  auto& lowered_values = lowered_values_;
+  intervals.clear();
+  lowered_values.clear();
+  intervals.reserve(global_values.size());
+  for (Value* value : global_values) {
+    uint32_t start = value->def->ordinal;
+    uint32_t end = start + 1;
+    for (auto use = value->use_head; use; use = use->next) {
+      start = std::min(start, use->instr->ordinal);
+      end = std::max(end, use->instr->ordinal + 1);
+    }
+    bool extended;
+    do {
+      extended = false;
+      for (const BlockRange& loop : loops) {
+        if (loop.start < end && start < loop.end &&
+            (loop.start < start || loop.end > end)) {
+          start = std::min(start, loop.start);
+          end = std::max(end, loop.end);
+          extended = true;
+        }
+      }
+    } while (extended);
+    // No registers are preserved across calls.
+    auto call_it = std::lower_bound(calls.begin(), calls.end(), start);
+    if (call_it != calls.end() && *call_it + 1 < end) {
+      lowered_values.push_back(value);
+      continue;
+    }
+    intervals.push_back({value, start, end});
+  }
+
+  // Linear scan, leaving at least half of each set to the values local to the
+  // blocks, evicting the intervals ending the furthest away.
+  std::sort(intervals.begin(), intervals.end(),
+            [](const GlobalInterval& a, const GlobalInterval& b) {
+              return a.start < b.start;
+            });
+  auto& set_states = global_set_states_;
+  for (GlobalSetState& set_state : set_states) {
+    set_state.active.clear();
+    set_state.used.reset();
+  }
+  auto& allocated = allocated_intervals_;
+  allocated.clear();
+  for (GlobalInterval& interval : intervals) {
+    RegisterSetUsage* usage_set = RegisterSetForValue(interval.value);
+    size_t set_index = 0;
+    while (usage_sets_.all_sets[set_index] != usage_set) {
+      ++set_index;
+    }
+    GlobalSetState& set_state = set_states[set_index];
+    auto& active = set_state.active;
+    for (size_t i = 0; i < active.size();) {
+      if (active[i]->end <= interval.start) {
+        set_state.used.reset(active[i]->value->reg.index);
+        active.erase(active.begin() + i);
+      } else {
+        ++i;
+      }
+    }
+    if (active.size() < usage_set->count / 2) {
+      // Taking from the end, as the per-block allocation takes the first free.
+      uint32_t index = usage_set->count - 1;
+      while (set_state.used.test(index)) {
+        --index;
+      }
+      set_state.used.set(index);
+      interval.value->reg.set = usage_set->set;
+      interval.value->reg.index = index;
+      active.push_back(&interval);
+      allocated.push_back(&interval);
+      continue;
+    }
+    if (active.empty()) {
+      lowered_values.push_back(interval.value);
+      continue;
+    }
+    auto furthest = std::max_element(
+        active.begin(), active.end(),
+        [](const GlobalInterval* a, const GlobalInterval* b) {
+          return a->end < b->end;
+        });
+    if ((*furthest)->end <= interval.end) {
+      lowered_values.push_back(interval.value);
+      continue;
+    }
+    GlobalInterval* evicted = *furthest;
+    interval.value->reg = evicted->value->reg;
+    evicted->value->reg.set = nullptr;
+    evicted->value->reg.index = -1;
+    lowered_values.push_back(evicted->value);
+    *furthest = &interval;
+    allocated.push_back(&interval);
+  }
+
+  // Reserve the registers in the blocks the intervals overlap.
+  for (size_t i = 0; i < xe::countof(usage_sets_.all_sets); ++i) {
+    if (usage_sets_.all_sets[i]) {
+      usage_sets_.all_sets[i]->global_registers.resize(block_ranges.size());
+    }
+  }
+  for (const GlobalInterval* interval : allocated) {
+    Value* value = interval->value;
+    if (!value->reg.set) {
+      // Evicted.
+      continue;
+    }
+    auto& global_registers = RegisterSetForValue(value)->global_registers;
+    for (size_t i = 0; i < block_ranges.size(); ++i) {
+      if (block_ranges[i].start < interval->end &&
+          interval->start < block_ranges[i].end) {
+        global_registers[i].set(value->reg.index);
+      }
+    }
+  }
+
+  for (Value* value : lowered_values) {
+    LowerValueToLocals(builder, value);
+  }
+}
+
+void RegisterAllocationPass::LowerValueToLocals(HIRBuilder* builder,
+                                                Value* value) {
+  // Store right after the definition, respecting PAIRED flags.
+  if (!value->HasLocalSlot()) {
+    value->SetLocalSlot(builder->AllocLocal(value->type));
+  }
+  builder->StoreLocal(value->GetLocalSlot(), value);
+  auto def_next = value->def->next;
+  while (def_next && def_next->opcode->flags & OPCODE_FLAG_PAIRED_PREV) {
+    def_next = def_next->next;
+  }
+  assert_not_null(def_next);
+  builder->last_instr()->MoveBefore(def_next);
+
+  // Load before the first use in each other block, and use the loaded value in
+  // that block.
+  // Renaming removes the uses, so gathering the instructions first.
+  auto& use_instrs = lowered_use_instrs_;
+  use_instrs.clear();
+  for (auto use = value->use_head; use; use = use->next) {
+    if (use->instr->block != value->def->block) {
+      use_instrs.push_back(use->instr);
+    }
+  }
+  std::sort(use_instrs.begin(), use_instrs.end(),
+            [](const Instr* a, const Instr* b) {
+              return a->ordinal < b->ordinal;
+            });
+  use_instrs.erase(std::unique(use_instrs.begin(), use_instrs.end()),
+                   use_instrs.end());
+  Block* current_block = nullptr;
+  Value* local_value = nullptr;
+  for (Instr* instr : use_instrs) {
+    if (instr->block != current_block) {
+      current_block = instr->block;
+      local_value = builder->LoadLocal(value->GetLocalSlot());
+      local_value->SetLocalSlot(value->GetLocalSlot());
+      auto insert_before = instr;
+      while (insert_before->opcode->flags & OPCODE_FLAG_PAIRED_PREV) {
+        insert_before = insert_before->prev;
+      }
+      builder->last_instr()->MoveBefore(insert_before);
+    }
+    uint32_t signature = instr->opcode->signature;
+    if (GET_OPCODE_SIG_TYPE_SRC1(signature) == OPCODE_SIG_TYPE_V &&
+        instr->src1.value == value) {
+      instr->set_src1(local_value);
+    }
+    if (GET_OPCODE_SIG_TYPE_SRC2(signature) == OPCODE_SIG_TYPE_V &&
+        instr->src2.value == value) {
+      instr->set_src2(local_value);
+    }
+    if (GET_OPCODE_SIG_TYPE_SRC3(signature) == OPCODE_SIG_TYPE_V &&
+        instr->src3.value == value) {
+      instr->set_src3(local_value);
+    }
+  }
+}
+
 void RegisterAllocationPass::DumpUsage(const char* name) {
 #if 0
   fprintf(stdout, "\n%s:\n", name);
@@ -195,11 +481,14 @@ void RegisterAllocationPass::DumpUsage(const char* name) {
 #endif
 }
 
-void RegisterAllocationPass::PrepareBlockState() {
+void RegisterAllocationPass::PrepareBlockState(uint16_t block_ordinal) {
   for (size_t i = 0; i < xe::countof(usage_sets_.all_sets); ++i) {
     auto usage_set = usage_sets_.all_sets[i];
     if (usage_set) {
       usage_set->availability.set();
+      if (block_ordinal < usage_set->global_registers.size()) {
+        usage_set->availability &= ~usage_set->global_registers[block_ordinal];
+      }
       usage_set->upcoming_uses.clear();
     }
   }
@@ -49,10 +49,29 @@ class RegisterAllocationPass : public CompilerPass {
     std::bitset<32> availability = 0;
     // TODO(benvanik): another data type.
     std::vector<RegisterUsage> upcoming_uses;
+    // Registers holding values live across the block, by block ordinal.
+    std::vector<std::bitset<32>> global_registers;
+  };
+  // Range of instruction ordinals a value live in multiple blocks must stay in
+  // its register for, end not included.
+  struct GlobalInterval {
+    hir::Value* value;
+    uint32_t start;
+    uint32_t end;
+  };
+  struct BlockRange {
+    uint32_t start;
+    uint32_t end;
+  };
+  struct GlobalSetState {
+    std::vector<GlobalInterval*> active;
+    std::bitset<32> used;
   };
 
   void DumpUsage(const char* name);
-  void PrepareBlockState();
+  void AllocateGlobalRegisters(hir::HIRBuilder* builder);
+  void LowerValueToLocals(hir::HIRBuilder* builder, hir::Value* value);
+  void PrepareBlockState(uint16_t block_ordinal);
   void AdvanceUses(hir::Instr* instr);
   bool IsRegInUse(const hir::RegAssignment& reg);
   RegisterSetUsage* MarkRegUsed(const hir::RegAssignment& reg,
@@ -76,6 +95,18 @@ class RegisterAllocationPass : public CompilerPass {
     RegisterSetUsage* vec_set = nullptr;
     RegisterSetUsage* all_sets[3];
   } usage_sets_;
+
+  // Scratch lists of the allocation of the registers of the values live in
+  // multiple blocks, cleared for each function, but keeping their storage.
+  std::vector<BlockRange> global_block_ranges_;
+  std::vector<uint32_t> global_calls_;
+  std::vector<hir::Value*> global_values_;
+  std::vector<BlockRange> global_loops_;
+  std::vector<GlobalInterval> global_intervals_;
+  std::vector<hir::Value*> lowered_values_;
+  GlobalSetState global_set_states_[3];
+  std::vector<GlobalInterval*> allocated_intervals_;
+  std::vector<hir::Instr*> lowered_use_instrs_;
 };
 
 }  // namespace passes
@@ -0,0 +1,175 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/compiler/passes/spin_wait_detection_pass.h"
+
+#include "xenia/base/profiling.h"
+#include "xenia/cpu/compiler/compiler.h"
+#include "xenia/cpu/compiler/passes/global_value_numbering_pass.h"
+
+namespace xe {
+namespace cpu {
+namespace compiler {
+namespace passes {
+
+// TODO(benvanik): remove when enums redefined.
+using namespace xe::cpu::hir;
+
+using xe::cpu::hir::Block;
+using xe::cpu::hir::HIRBuilder;
+using xe::cpu::hir::Instr;
+using xe::cpu::hir::Value;
+
+namespace {
+
+bool IsConditionalBranch(const Instr* instr) {
+  return instr && (instr->opcode == &OPCODE_BRANCH_TRUE_info ||
+                   instr->opcode == &OPCODE_BRANCH_FALSE_info);
+}
+
+// Whether the block only branches to the target.
+bool IsOnlyBranch(const Block* block, const Block* target) {
+  for (auto instr = block->instr_head; instr; instr = instr->next) {
+    if (instr->opcode == &OPCODE_BRANCH_info) {
+      return instr == block->instr_tail && instr->src1.label->block == target;
+    }
+    if (instr->opcode != &OPCODE_SOURCE_OFFSET_info &&
+        instr->opcode != &OPCODE_COMMENT_info &&
+        instr->opcode != &OPCODE_NOP_info) {
+      return false;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+SpinWaitDetectionPass::SpinWaitDetectionPass() : CompilerPass() {}
+
+SpinWaitDetectionPass::~SpinWaitDetectionPass() {}
+
+bool SpinWaitDetectionPass::Run(HIRBuilder* builder) {
+  SCOPE_profile_cpu_f("cpu");
+
+  // Two loop shapes are recognized - a block branching to itself while
+  // polling:
+  //   loop: lwz r11, 0(r3); cmpwi r11, 0; beq loop
+  // and a block exiting conditionally followed by a block only branching back:
+  //   loop: lwz r11, 0(r3); cmpwi r11, 0; bne done; b loop
+  for (auto block = builder->first_block(); block; block = block->next) {
+    Instr* branch = block->instr_tail;
+    if (!IsConditionalBranch(branch) ||
+        !IsScalarIntegralType(branch->src1.value->type)) {
+      continue;
+    }
+    bool branches_back = branch->src2.label->block == block;
+    Block* back_block = block->next;
+    if (!branches_back &&
+        (!back_block || branch->src2.label->block == back_block ||
+         !IsOnlyBranch(back_block, block))) {
+      continue;
+    }
+    Block* last_block = branches_back ? block : back_block;
+    Instr* load = FindPollingLoad(block, last_block);
+    if (!load) {
+      continue;
+    }
+    Value* cond;
+    Instr* insertion_point;
+    if (branches_back) {
+      // Waiting only if going to the next iteration.
+      cond = branch->src1.value;
+      if (branch->opcode == &OPCODE_BRANCH_FALSE_info) {
+        cond = builder->IsFalse(cond);
+        builder->last_instr()->MoveBefore(branch);
+      } else if (cond->type != INT8_TYPE) {
+        cond = builder->IsTrue(cond);
+        builder->last_instr()->MoveBefore(branch);
+      }
+      insertion_point = branch;
+    } else {
+      cond = builder->LoadConstantInt8(1);
+      insertion_point = back_block->instr_tail;
+    }
+    builder->SpinWait(cond, load->src1.value, load->dest, load->flags);
+    builder->last_instr()->MoveBefore(insertion_point);
+    block = last_block;
+  }
+  return true;
+}
+
+Instr* SpinWaitDetectionPass::FindPollingLoad(Block* first_block,
+                                              Block* last_block) {
+  // If the only input changing between the iterations is the value loaded
+  // from memory, an iteration loading the same value as the previous one does
+  // the same and goes to the next iteration again, so waiting for the value to
+  // change is equivalent to spinning. So context loads must not overlap the
+  // context stores in the loop, and memory may be only loaded once.
+  Instr* load = nullptr;
+  context_stores_.clear();
+  for (auto block = first_block;; block = block->next) {
+    for (auto instr = block->instr_head; instr; instr = instr->next) {
+      if (instr->opcode == &OPCODE_STORE_CONTEXT_info) {
+        context_stores_.emplace_back(
+            uint32_t(instr->src1.offset),
+            uint32_t(GetTypeSize(instr->src2.value->type)));
+      }
+    }
+    if (block == last_block) {
+      break;
+    }
+  }
+  for (auto block = first_block;; block = block->next) {
+    for (auto instr = block->instr_head; instr; instr = instr->next) {
+      switch (instr->opcode->num) {
+        case OPCODE_LOAD:
+        case OPCODE_RESERVED_LOAD:
+          if (load || !IsScalarIntegralType(instr->dest->type)) {
+            return nullptr;
+          }
+          load = instr;
+          break;
+        case OPCODE_LOAD_CONTEXT: {
+          uint32_t offset = uint32_t(instr->src1.offset);
+          uint32_t end = offset + uint32_t(GetTypeSize(instr->dest->type));
+          for (const auto& store : context_stores_) {
+            if (store.first < end && offset < store.first + store.second) {
+              return nullptr;
+            }
+          }
+        } break;
+        case OPCODE_STORE_CONTEXT:
+        case OPCODE_CONTEXT_BARRIER:
+        case OPCODE_MEMORY_BARRIER:
+        case OPCODE_DELAY_EXECUTION:
+        case OPCODE_SOURCE_OFFSET:
+        case OPCODE_COMMENT:
+        case OPCODE_NOP:
+        case OPCODE_BRANCH:
+        case OPCODE_BRANCH_TRUE:
+        case OPCODE_BRANCH_FALSE:
+          break;
+        default:
+          if (!GlobalValueNumberingPass::IsPure(instr)) {
+            return nullptr;
+          }
+          break;
+      }
+    }
+    if (block == last_block) {
+      break;
+    }
+  }
+  return load;
+}
+
+}  // namespace passes
+}  // namespace compiler
+}  // namespace cpu
+}  // namespace xe
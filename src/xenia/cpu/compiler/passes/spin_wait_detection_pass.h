@@ -0,0 +1,47 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_CPU_COMPILER_PASSES_SPIN_WAIT_DETECTION_PASS_H_
+#define XENIA_CPU_COMPILER_PASSES_SPIN_WAIT_DETECTION_PASS_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "xenia/cpu/compiler/compiler_pass.h"
+
+namespace xe {
+namespace cpu {
+namespace compiler {
+namespace passes {
+
+// Makes loops polling a single memory location, with every iteration doing the
+// same until the value in memory changes, wait for the change in the host
+// before repeating.
+class SpinWaitDetectionPass : public CompilerPass {
+ public:
+  SpinWaitDetectionPass();
+  ~SpinWaitDetectionPass() override;
+
+  bool Run(hir::HIRBuilder* builder) override;
+
+ private:
+  // Returns the only memory load of the loop if it's polling it.
+  hir::Instr* FindPollingLoad(hir::Block* first_block, hir::Block* last_block);
+
+  // Offsets and sizes of the context stores in the loop.
+  std::vector<std::pair<uint32_t, uint32_t>> context_stores_;
+};
+
+}  // namespace passes
+}  // namespace compiler
+}  // namespace cpu
+}  // namespace xe
+
+#endif  // XENIA_CPU_COMPILER_PASSES_SPIN_WAIT_DETECTION_PASS_H_
@@ -77,7 +77,9 @@ bool ValidationPass::ValidateInstruction(Block* block, Instr* instr) {
     assert_true(instr->dest->def == instr);
     auto use = instr->dest->use_head;
     while (use) {
-      assert_true(use->instr->block == block);
+      // Values may be used in other blocks, kept in registers across them by
+      // the register allocator or lowered to locals by it.
+      assert_not_null(use->instr->block);
       use = use->next;
     }
   }
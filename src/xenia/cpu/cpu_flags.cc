@@ -33,6 +33,84 @@ DEFINE_bool(trace_function_data, false,
 DEFINE_bool(validate_hir, false,
             "Perform validation checks on the HIR during compilation.", "CPU");
 
+DEFINE_bool(tiered_compilation, false,
+            "Translate functions with a minimal set of optimizations first, and "
+            "retranslate them with all optimizations in the background once "
+            "they have been called tier_up_call_threshold times. Reduces "
+            "stuttering when new code is reached.",
+            "CPU");
+DEFINE_uint32(tier_up_call_threshold, 1000,
+              "Number of calls after which a function translated with minimal "
+              "optimizations is retranslated with all optimizations.",
+              "CPU");
+DEFINE_bool(retranslate_on_mmio_access, true,
+            "Retranslate functions in the background when an access to MMIO "
+            "from them has been caught by the exception handler, so the "
+            "access is done through the MMIO handlers directly afterwards "
+            "instead of faulting each time. Requires "
+            "record_mmio_access_exceptions.",
+            "CPU");
+DEFINE_uint32(code_reclamation_threshold, 256,
+              "Number of unreachable blocks of generated code (such as "
+              "baseline code replaced by optimized code) after which the "
+              "guest threads are checked for still running them, and the "
+              "space of those not running is reused for new code. 0 to never "
+              "reuse the space.",
+              "CPU");
+
+DEFINE_int32(compilation_threads, 0,
+             "Number of job system workers (job_system_threads) translating "
+             "functions in the background ahead of their execution, starting "
+             "from the targets of direct calls and branches in the translated "
+             "functions. 0 to disable, -1 to use all the workers.",
+             "CPU");
+
+DEFINE_bool(inline_functions, true,
+            "Translate small leaf functions into the code of their callers "
+            "instead of calling them.",
+            "CPU");
+DEFINE_uint32(inline_function_max_instructions, 24,
+              "Size limit, in guest instructions, of functions translated into "
+              "the code of their callers.",
+              "CPU");
+DEFINE_uint32(inline_function_budget, 256,
+              "Maximum number of guest instructions of callees translated into "
+              "the code of a single function.",
+              "CPU");
+
+DEFINE_bool(global_value_numbering, true,
+            "Reuse the results of computations already done on every path to "
+            "an instruction instead of repeating them, across blocks.",
+            "CPU");
+DEFINE_bool(loop_invariant_code_motion, true,
+            "Move computations and context loads giving the same result in "
+            "every iteration of a loop out of the loop.",
+            "CPU");
+DEFINE_bool(spin_wait_detection, false,
+            "Make loops polling a memory location until it changes wait for "
+            "the change in the host after spinning briefly, woken up by "
+            "reserved stores (stwcx.) to the location, otherwise checking it "
+            "periodically, so the change made with a normal store may be "
+            "noticed later.",
+            "CPU");
+DEFINE_bool(inline_tls_exports, true,
+            "Translate calls to KeTlsGetValue and KeTlsSetValue with a slot "
+            "within the TLS slot array of the title as a direct load or store "
+            "through the PCR instead of calling the kernel export. Disable to "
+            "log every call of these exports.",
+            "CPU");
+
+DEFINE_bool(jit_statistics, false,
+            "Record the time taken by each stage of the translation of every "
+            "function, the size of its code, and approximately how many times "
+            "it has been called, to be dumped to jit_statistics_path from the "
+            "CPU menu. Generated code is not stored then.",
+            "CPU");
+DEFINE_path(jit_statistics_path, "jit_statistics.csv",
+            "File the JIT statistics are dumped to, as JSON if it has the "
+            ".json extension, or CSV otherwise.",
+            "CPU");
+
 DEFINE_uint64(
     pvr, 0x710700,
     "Processor version and revision number.\nBits 0 to 15 are the version "
@@ -47,6 +125,16 @@ DEFINE_int32(break_condition_gpr, -1, "GPR compared to", "CPU");
 DEFINE_uint64(break_condition_value, 0, "value compared against", "CPU");
 DEFINE_string(break_condition_op, "eq", "comparison operator", "CPU");
 DEFINE_bool(break_condition_truncate, true, "truncate value to 32-bits", "CPU");
+DEFINE_uint32(break_condition_hit_count, 0,
+              "Only break on the given hit of break_on_instruction, counting "
+              "only the hits where the condition holds. 0 to break on every "
+              "hit.",
+              "CPU");
+DEFINE_bool(break_on_instruction_trace, false,
+            "Log the registers on every hit of break_on_instruction instead of "
+            "breaking, unless break_condition_hit_count is also set, in which "
+            "case only that hit breaks.",
+            "CPU");
 
 DEFINE_bool(break_on_debugbreak, true, "int3 on JITed __debugbreak requests.",
             "CPU");
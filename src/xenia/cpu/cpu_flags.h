@@ -24,6 +24,25 @@ DECLARE_bool(trace_function_data);
 
 DECLARE_bool(validate_hir);
 
+DECLARE_bool(tiered_compilation);
+DECLARE_uint32(tier_up_call_threshold);
+DECLARE_bool(retranslate_on_mmio_access);
+DECLARE_uint32(code_reclamation_threshold);
+
+DECLARE_int32(compilation_threads);
+
+DECLARE_bool(inline_functions);
+DECLARE_uint32(inline_function_max_instructions);
+DECLARE_uint32(inline_function_budget);
+
+DECLARE_bool(global_value_numbering);
+DECLARE_bool(loop_invariant_code_motion);
+DECLARE_bool(spin_wait_detection);
+DECLARE_bool(inline_tls_exports);
+
+DECLARE_bool(jit_statistics);
+DECLARE_path(jit_statistics_path);
+
 DECLARE_uint64(pvr);
 
 // Breakpoints:
@@ -32,6 +51,8 @@ DECLARE_int32(break_condition_gpr);
 DECLARE_uint64(break_condition_value);
 DECLARE_string(break_condition_op);
 DECLARE_bool(break_condition_truncate);
+DECLARE_uint32(break_condition_hit_count);
+DECLARE_bool(break_on_instruction_trace);
 
 DECLARE_bool(break_on_debugbreak);
 
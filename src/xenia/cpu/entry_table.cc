@@ -9,29 +9,128 @@
 
 #include "xenia/cpu/entry_table.h"
 
+#include "xenia/base/assert.h"
 #include "xenia/base/profiling.h"
 #include "xenia/base/threading.h"
 
 namespace xe {
 namespace cpu {
 
+namespace {
+// Placed in the slots of deleted entries, so probing continues past them.
+Entry deleted_entry;
+}  // namespace
+
+EntryTable::Table::Table(uint32_t capacity)
+    : capacity_mask(capacity - 1),
+      slots(new std::atomic<Entry*>[capacity]) {
+  assert_true(!(capacity & (capacity - 1)));
+  for (uint32_t i = 0; i < capacity; ++i) {
+    slots[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
 EntryTable::EntryTable() = default;
 
 EntryTable::~EntryTable() {
-  auto global_lock = global_critical_region_.Acquire();
-  for (auto it : map_.Values()) {
-    Entry* entry = it;
-    delete entry;
+  for (Shard& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.lock);
+    Table* table = shard.table.load(std::memory_order_relaxed);
+    if (table) {
+      for (uint32_t i = 0; i <= table->capacity_mask; ++i) {
+        Entry* entry = table->slots[i].load(std::memory_order_relaxed);
+        if (entry != &deleted_entry) {
+          delete entry;
+        }
+      }
+    }
+    for (Entry* entry : shard.deleted_entries) {
+      delete entry;
+    }
   }
 }
 
-Entry* EntryTable::Get(uint32_t address) {
-  auto global_lock = global_critical_region_.Acquire();
-  uint32_t idx = map_.IndexForKey(address);
-  if (idx == map_.size() || *map_.KeyAt(idx) != address) {
+uint32_t EntryTable::HashAddress(uint32_t address) {
+  // Fibonacci hashing of the instruction index, the upper bits select the
+  // shard, and the lower bits the slot.
+  return (address >> 2) * UINT32_C(0x9E3779B1);
+}
+
+Entry* EntryTable::Find(const Table* table, uint32_t hash, uint32_t address,
+                        std::atomic<Entry*>** slot_out) {
+  if (!table) {
     return nullptr;
   }
-  Entry* entry = *map_.ValueAt(idx);
+  // Tables are never full, so there's always an empty slot to stop at.
+  for (uint32_t i = hash;; ++i) {
+    std::atomic<Entry*>& slot = table->slots[i & table->capacity_mask];
+    Entry* entry = slot.load(std::memory_order_acquire);
+    if (!entry) {
+      return nullptr;
+    }
+    if (entry != &deleted_entry && entry->address == address) {
+      if (slot_out) {
+        *slot_out = &slot;
+      }
+      return entry;
+    }
+  }
+}
+
+void EntryTable::Insert(Shard& shard, uint32_t hash, Entry* entry) {
+  Table* table = shard.table.load(std::memory_order_relaxed);
+  // Keep at most half of the slots used, dropping the deleted entries when
+  // growing.
+  if (!table || (shard.used_slot_count + 1) * 2 > table->capacity_mask + 1) {
+    uint32_t entry_count = 0;
+    if (table) {
+      for (uint32_t i = 0; i <= table->capacity_mask; ++i) {
+        Entry* old_entry = table->slots[i].load(std::memory_order_relaxed);
+        if (old_entry && old_entry != &deleted_entry) {
+          ++entry_count;
+        }
+      }
+    }
+    uint32_t capacity = kInitialTableCapacity;
+    while (capacity < (entry_count + 1) * 4) {
+      capacity *= 2;
+    }
+    auto new_table = std::make_unique<Table>(capacity);
+    if (table) {
+      for (uint32_t i = 0; i <= table->capacity_mask; ++i) {
+        Entry* old_entry = table->slots[i].load(std::memory_order_relaxed);
+        if (!old_entry || old_entry == &deleted_entry) {
+          continue;
+        }
+        for (uint32_t j = HashAddress(old_entry->address);; ++j) {
+          std::atomic<Entry*>& slot = new_table->slots[j & (capacity - 1)];
+          if (!slot.load(std::memory_order_relaxed)) {
+            slot.store(old_entry, std::memory_order_relaxed);
+            break;
+          }
+        }
+      }
+    }
+    table = new_table.get();
+    shard.tables.push_back(std::move(new_table));
+    shard.used_slot_count = entry_count;
+    // Lookups may start using it from now on.
+    shard.table.store(table, std::memory_order_release);
+  }
+  for (uint32_t i = hash;; ++i) {
+    std::atomic<Entry*>& slot = table->slots[i & table->capacity_mask];
+    if (!slot.load(std::memory_order_relaxed)) {
+      slot.store(entry, std::memory_order_release);
+      ++shard.used_slot_count;
+      return;
+    }
+  }
+}
+
+Entry* EntryTable::Get(uint32_t address) {
+  uint32_t hash = HashAddress(address);
+  Entry* entry = Find(GetShard(hash).table.load(std::memory_order_acquire),
+                      hash, address);
   if (entry) {
     // TODO(benvanik): wait if needed?
     if (entry->status != Entry::STATUS_READY) {
@@ -42,64 +141,75 @@ Entry* EntryTable::Get(uint32_t address) {
 }
 
 Entry::Status EntryTable::GetOrCreate(uint32_t address, Entry** out_entry) {
-  // TODO(benvanik): replace with a map with wait-free for find.
-  // https://github.com/facebook/folly/blob/master/folly/AtomicHashMap.h
-
-  auto global_lock = global_critical_region_.Acquire();
-
-  uint32_t idx = map_.IndexForKey(address);
-
-  Entry* entry = idx != map_.size() && *map_.KeyAt(idx) == address
-                     ? *map_.ValueAt(idx)
-                     : nullptr;
-  Entry::Status status;
-  if (entry) {
-    // If we aren't ready yet spin and wait.
-    if (entry->status == Entry::STATUS_COMPILING) {
-      // chrispy: i think this is dead code, if we are compiling we're holding
-      // the global lock, arent we? so we wouldnt be executing here
-      // Still compiling, so spin.
-      do {
-        global_lock.unlock();
-        // TODO(benvanik): sleep for less time?
-        xe::threading::Sleep(std::chrono::microseconds(10));
-        global_lock.lock();
-      } while (entry->status == Entry::STATUS_COMPILING);
+  uint32_t hash = HashAddress(address);
+  Shard& shard = GetShard(hash);
+  Entry* entry =
+      Find(shard.table.load(std::memory_order_acquire), hash, address);
+  if (!entry) {
+    std::lock_guard<std::mutex> lock(shard.lock);
+    // May have been created by another thread meanwhile.
+    entry = Find(shard.table.load(std::memory_order_relaxed), hash, address);
+    if (!entry) {
+      // Create and return for initialization.
+      entry = new Entry();
+      entry->address = address;
+      entry->end_address = 0;
+      entry->status = Entry::STATUS_COMPILING;
+      entry->function = 0;
+      Insert(shard, hash, entry);
+      *out_entry = entry;
+      return Entry::STATUS_NEW;
     }
-    status = entry->status;
-  } else {
-    // Create and return for initialization.
-    entry = new Entry();
-    entry->address = address;
-    entry->end_address = 0;
-    entry->status = Entry::STATUS_COMPILING;
-    entry->function = 0;
-    map_.InsertAt(address, entry, idx);
-    // map_[address] = entry;
-    status = Entry::STATUS_NEW;
   }
-  global_lock.unlock();
+  // If we aren't ready yet spin and wait.
+  Entry::Status status;
+  while ((status = entry->status) == Entry::STATUS_COMPILING) {
+    // TODO(benvanik): sleep for less time?
+    xe::threading::Sleep(std::chrono::microseconds(10));
+  }
   *out_entry = entry;
   return status;
 }
 
 void EntryTable::Delete(uint32_t address) {
-  auto global_lock = global_critical_region_.Acquire();
-  // doesnt this leak memory by not deleting the entry?
-  uint32_t idx = map_.IndexForKey(address);
-  if (idx != map_.size() && *map_.KeyAt(idx) == address) {
-    map_.EraseAt(idx);
+  uint32_t hash = HashAddress(address);
+  Shard& shard = GetShard(hash);
+  std::lock_guard<std::mutex> lock(shard.lock);
+  std::atomic<Entry*>* slot;
+  Entry* entry =
+      Find(shard.table.load(std::memory_order_relaxed), hash, address, &slot);
+  if (entry) {
+    slot->store(&deleted_entry, std::memory_order_release);
+    shard.deleted_entries.push_back(entry);
   }
 }
 
 std::vector<Function*> EntryTable::FindWithAddress(uint32_t address) {
-  auto global_lock = global_critical_region_.Acquire();
+  return FindWithRange(address, 1);
+}
+
+std::vector<Function*> EntryTable::FindWithRange(uint32_t address,
+                                                 uint32_t length) {
   std::vector<Function*> fns;
-  for (auto& it : map_.Values()) {
-    Entry* entry = it;
-    if (address >= entry->address && address <= entry->end_address) {
-      if (entry->status == Entry::STATUS_READY) {
-        fns.push_back(entry->function);
+  if (!length) {
+    return fns;
+  }
+  uint32_t last_address = address + (length - 1);
+  for (Shard& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.lock);
+    Table* table = shard.table.load(std::memory_order_relaxed);
+    if (!table) {
+      continue;
+    }
+    for (uint32_t i = 0; i <= table->capacity_mask; ++i) {
+      Entry* entry = table->slots[i].load(std::memory_order_relaxed);
+      if (!entry || entry == &deleted_entry) {
+        continue;
+      }
+      if (last_address >= entry->address && address <= entry->end_address) {
+        if (entry->status == Entry::STATUS_READY) {
+          fns.push_back(entry->function);
+        }
       }
     }
   }
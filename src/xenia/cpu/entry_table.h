@@ -10,11 +10,12 @@
 #ifndef XENIA_CPU_ENTRY_TABLE_H_
 #define XENIA_CPU_ENTRY_TABLE_H_
 
-#include <unordered_map>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <vector>
 
-#include "xenia/base/mutex.h"
-#include "xenia/base/split_map.h"
 namespace xe {
 namespace cpu {
 
@@ -30,10 +31,14 @@ typedef struct Entry_t {
 
   uint32_t address;
   uint32_t end_address;
-  Status status;
+  // Set after the function and the end address once it's not compiling
+  // anymore, as it may be read without locking.
+  std::atomic<Status> status;
   Function* function;
 } Entry;
 
+// Entries are looked up without locking, only creation and deletion are
+// serialized, per shard of the address space.
 class EntryTable {
  public:
   EntryTable();
@@ -44,12 +49,45 @@ class EntryTable {
   void Delete(uint32_t address);
 
   std::vector<Function*> FindWithAddress(uint32_t address);
+  // Ready functions with any code in the range, in a single pass over the
+  // table.
+  std::vector<Function*> FindWithRange(uint32_t address, uint32_t length);
 
  private:
-  xe::global_critical_region global_critical_region_;
-  // TODO(benvanik): replace with a better data structure.
-  xe::split_map<uint32_t, Entry*> map_;
-  // std::unordered_map<uint32_t, Entry*> map_;
+  // Open-addressed table with linear probing. Replaced with a bigger copy when
+  // filled, with the old ones kept until the entry table is destroyed, as
+  // lookups may still be probing them.
+  struct Table {
+    explicit Table(uint32_t capacity);
+    uint32_t capacity_mask;
+    std::unique_ptr<std::atomic<Entry*>[]> slots;
+  };
+  struct Shard {
+    // Protects the modification of the table.
+    std::mutex lock;
+    std::atomic<Table*> table{nullptr};
+    // Slots of the table that are not empty, including deleted entries.
+    uint32_t used_slot_count = 0;
+    std::vector<std::unique_ptr<Table>> tables;
+    // Kept until the entry table is destroyed, as they may still be in use.
+    std::vector<Entry*> deleted_entries;
+  };
+
+  static constexpr uint32_t kShardCountLog2 = 4;
+  static constexpr uint32_t kInitialTableCapacity = 256;
+
+  static uint32_t HashAddress(uint32_t address);
+  Shard& GetShard(uint32_t hash) {
+    return shards_[hash >> (32 - kShardCountLog2)];
+  }
+  // Returns the entry for the address in the table if there's one, and the
+  // slot containing it.
+  static Entry* Find(const Table* table, uint32_t hash, uint32_t address,
+                     std::atomic<Entry*>** slot_out = nullptr);
+  // Must be called with the lock of the shard held.
+  void Insert(Shard& shard, uint32_t hash, Entry* entry);
+
+  Shard shards_[size_t(1) << kShardCountLog2];
 };
 
 }  // namespace cpu
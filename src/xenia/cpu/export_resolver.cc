@@ -93,5 +93,26 @@ void ExportResolver::SetFunctionMapping(const std::string_view module_name,
   export_entry->function_data.trampoline = trampoline;
 }
 
+void ExportResolver::SetRoutineReplacement(const std::string_view name,
+                                           ExportTrampoline trampoline) {
+  for (auto& routine_replacement : routine_replacements_) {
+    if (routine_replacement.first == name) {
+      routine_replacement.second = trampoline;
+      return;
+    }
+  }
+  routine_replacements_.emplace_back(std::string(name), trampoline);
+}
+
+ExportTrampoline ExportResolver::GetRoutineReplacement(
+    const std::string_view name) const {
+  for (const auto& routine_replacement : routine_replacements_) {
+    if (routine_replacement.first == name) {
+      return routine_replacement.second;
+    }
+  }
+  return nullptr;
+}
+
 }  // namespace cpu
 }  // namespace xe
@@ -11,6 +11,7 @@
 #define XENIA_CPU_EXPORT_RESOLVER_H_
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "xenia/base/math.h"
@@ -155,9 +156,18 @@ class ExportResolver {
   void SetFunctionMapping(const std::string_view module_name, uint16_t ordinal,
                           ExportTrampoline trampoline);
 
+  // Host implementations of routines statically linked into the titles, such
+  // as the CRT string formatting, that may replace the guest code of the
+  // routines found by signature (see memory_routine_signatures). Called with
+  // the guest arguments like exports.
+  void SetRoutineReplacement(const std::string_view name,
+                             ExportTrampoline trampoline);
+  ExportTrampoline GetRoutineReplacement(const std::string_view name) const;
+
  private:
   std::vector<Table> tables_;
   std::vector<Export*> all_exports_by_name_;
+  std::vector<std::pair<std::string, ExportTrampoline>> routine_replacements_;
 };
 
 }  // namespace cpu
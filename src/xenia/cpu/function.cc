@@ -79,14 +79,17 @@ const SourceMapEntry* GuestFunction::LookupGuestAddress(
 }
 
 const SourceMapEntry* GuestFunction::LookupHIROffset(uint32_t offset) const {
-  // TODO(benvanik): binary search? We know the list is sorted by code order.
+  // The list is sorted by code order, which is not the HIR order if the blocks
+  // have been reordered by the backend.
+  const SourceMapEntry* closest_entry = nullptr;
   for (size_t i = 0; i < source_map_.size(); ++i) {
     const auto& entry = source_map_[i];
-    if (entry.hir_offset >= offset) {
-      return &entry;
+    if (entry.hir_offset >= offset &&
+        (!closest_entry || entry.hir_offset < closest_entry->hir_offset)) {
+      closest_entry = &entry;
     }
   }
-  return nullptr;
+  return closest_entry;
 }
 
 const SourceMapEntry* GuestFunction::LookupMachineCodeOffset(
@@ -125,6 +128,20 @@ uint32_t GuestFunction::MapMachineCodeToGuestAddress(
   return entry ? entry->guest_address : address();
 }
 
+const InlinedFunctionEntry* GuestFunction::LookupInlinedFunction(
+    uint32_t guest_address) const {
+  if (guest_address >= address() && guest_address <= end_address()) {
+    return nullptr;
+  }
+  for (const InlinedFunctionEntry& entry : inlined_functions_) {
+    if (guest_address >= entry.function->address() &&
+        guest_address <= entry.function->end_address()) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
 bool GuestFunction::Call(ThreadState* thread_state, uint32_t return_address) {
   // SCOPE_profile_cpu_f("cpu");
 
@@ -11,6 +11,7 @@
 #define XENIA_CPU_FUNCTION_H_
 
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include "xenia/cpu/function_debug_info.h"
@@ -33,6 +34,40 @@ struct SourceMapEntry {
 };
 enum class SaveRestoreType : uint8_t { NONE, GPR, VMX, FPR };
 
+class GuestFunction;
+
+// Function whose code was translated into the code of another one in place of
+// a call.
+struct InlinedFunctionEntry {
+  uint32_t call_address;  // PPC guest address of the replaced call.
+  GuestFunction* function;
+};
+
+// Measurements of the latest translation of a function, gathered when the
+// jit_statistics cvar is enabled. Times are in host ticks.
+struct FunctionCompilationStatistics {
+  struct PassTime {
+    const char* pass_name;
+    uint64_t ticks;
+  };
+
+  uint32_t translation_count = 0;
+  // Translations before this one, such as baseline code before tiering up.
+  uint64_t previous_translations_ticks = 0;
+  uint64_t hir_build_ticks = 0;
+  std::vector<PassTime> pass_ticks;
+  uint64_t assembly_ticks = 0;
+  // As emitted by the frontend, and after the compiler passes.
+  uint32_t raw_hir_instruction_count = 0;
+  uint32_t hir_instruction_count = 0;
+  uint32_t machine_code_length = 0;
+  // Memory of the HIR and of the scratch data of the compiler passes.
+  uint32_t hir_arena_size = 0;
+  uint32_t hir_allocation_count = 0;
+  uint32_t scratch_arena_peak_size = 0;
+  uint32_t scratch_allocation_count = 0;
+};
+
 class Function : public Symbol {
  public:
   enum class Behavior : uint8_t {
@@ -136,6 +171,9 @@ class GuestFunction : public Function {
   }
   FunctionTraceData& trace_data() { return trace_data_; }
   std::vector<SourceMapEntry>& source_map() { return source_map_; }
+  std::vector<InlinedFunctionEntry>& inlined_functions() {
+    return inlined_functions_;
+  }
 
   ExternHandler extern_handler() const { return extern_handler_; }
   Export* export_data() const { return export_data_; }
@@ -148,9 +186,28 @@ class GuestFunction : public Function {
   uint32_t MapGuestAddressToMachineCodeOffset(uint32_t guest_address) const;
   uintptr_t MapGuestAddressToMachineCode(uint32_t guest_address) const;
   uint32_t MapMachineCodeToGuestAddress(uintptr_t host_address) const;
+  // Finds the inlined function the guest address is in if it's outside this
+  // function. The first call is returned if a function was inlined at multiple
+  // calls.
+  const InlinedFunctionEntry* LookupInlinedFunction(
+      uint32_t guest_address) const;
 
   bool Call(ThreadState* thread_state, uint32_t return_address) override;
 
+  FunctionCompilationStatistics compilation_statistics() const {
+    std::lock_guard<std::mutex> lock(compilation_statistics_lock_);
+    return compilation_statistics_;
+  }
+  void set_compilation_statistics(
+      const FunctionCompilationStatistics& statistics) {
+    std::lock_guard<std::mutex> lock(compilation_statistics_lock_);
+    compilation_statistics_ = statistics;
+  }
+  // Incremented by the generated code when the jit_statistics cvar is enabled,
+  // without synchronization, so it may miss some concurrent calls.
+  uint64_t sampled_call_count() const { return sampled_call_count_; }
+  uint64_t* sampled_call_count_ptr() { return &sampled_call_count_; }
+
  protected:
   virtual bool CallImpl(ThreadState* thread_state, uint32_t return_address) = 0;
 
@@ -158,6 +215,10 @@ class GuestFunction : public Function {
   std::unique_ptr<FunctionDebugInfo> debug_info_;
   FunctionTraceData trace_data_;
   std::vector<SourceMapEntry> source_map_;
+  std::vector<InlinedFunctionEntry> inlined_functions_;
+  mutable std::mutex compilation_statistics_lock_;
+  FunctionCompilationStatistics compilation_statistics_;
+  uint64_t sampled_call_count_ = 0;
   ExternHandler extern_handler_ = nullptr;
   Export* export_data_ = nullptr;
 };
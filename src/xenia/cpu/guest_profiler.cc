@@ -0,0 +1,255 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/guest_profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/assert.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/cpu/backend/code_cache.h"
+
+DEFINE_uint32(guest_profiler_interval, 1000,
+              "Interval between the call stack samples taken by the guest "
+              "profiler in the debugger, in microseconds.",
+              "CPU");
+
+namespace xe {
+namespace cpu {
+
+namespace {
+
+std::string FormatFunctionName(
+    const std::unordered_map<uint32_t, std::string>& function_names,
+    uint32_t address) {
+  if (address == GuestProfiler::kHostCodeAddress) {
+    return "[host]";
+  }
+  auto it = function_names.find(address);
+  if (it != function_names.end()) {
+    return it->second;
+  }
+  return fmt::format("sub_{:08X}", address);
+}
+
+void SortStackNodes(GuestProfiler::StackNode& node) {
+  std::sort(node.children.begin(), node.children.end(),
+            [](const GuestProfiler::StackNode& a,
+               const GuestProfiler::StackNode& b) {
+              return a.samples > b.samples;
+            });
+  for (GuestProfiler::StackNode& child : node.children) {
+    SortStackNodes(child);
+  }
+}
+
+}  // namespace
+
+GuestProfiler::GuestProfiler(Processor* processor) : processor_(processor) {}
+
+GuestProfiler::~GuestProfiler() { Stop(); }
+
+bool GuestProfiler::Start() {
+  if (sampler_thread_) {
+    return true;
+  }
+  if (!processor_->stack_walker()) {
+    XELOGE("Guest profiler: call stacks can't be captured on this host");
+    return false;
+  }
+  sampler_shutdown_ = false;
+  sampler_thread_ =
+      xe::threading::Thread::Create({}, [this]() { SamplerThread(); });
+  assert_not_null(sampler_thread_);
+  sampler_thread_->set_name("Guest Profiler");
+  return true;
+}
+
+void GuestProfiler::Stop() {
+  if (!sampler_thread_) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(sampler_shutdown_mutex_);
+    sampler_shutdown_ = true;
+  }
+  sampler_shutdown_cond_.notify_all();
+  xe::threading::Wait(sampler_thread_.get(), false);
+  sampler_thread_.reset();
+}
+
+void GuestProfiler::Reset() {
+  std::lock_guard<std::mutex> lock(samples_mutex_);
+  stack_samples_.clear();
+  function_names_.clear();
+  sample_count_ = 0;
+}
+
+void GuestProfiler::SamplerThread() {
+  const auto interval = std::chrono::microseconds(
+      std::max(cvars::guest_profiler_interval, uint32_t(100)));
+  std::vector<ThreadStackSample> samples;
+  std::unique_lock<std::mutex> shutdown_lock(sampler_shutdown_mutex_);
+  while (!sampler_shutdown_cond_.wait_for(
+      shutdown_lock, interval, [this]() { return sampler_shutdown_; })) {
+    shutdown_lock.unlock();
+    processor_->CaptureThreadStacks(&samples);
+    for (const ThreadStackSample& sample : samples) {
+      RecordSample(sample);
+    }
+    shutdown_lock.lock();
+  }
+}
+
+void GuestProfiler::RecordSample(const ThreadStackSample& sample) {
+  backend::CodeCache* code_cache = processor_->backend()->code_cache();
+  uintptr_t code_cache_begin = code_cache->execute_base_address();
+  uintptr_t code_cache_end = code_cache_begin + code_cache->total_size();
+  // From the innermost function - reversed afterwards.
+  std::vector<GuestFunction*> functions;
+  bool in_host_code = true;
+  for (size_t i = 0; i < sample.frame_count; ++i) {
+    uint64_t host_pc = sample.frame_host_pcs[i];
+    if (host_pc < code_cache_begin || host_pc >= code_cache_end) {
+      continue;
+    }
+    GuestFunction* function = code_cache->LookupFunction(host_pc);
+    if (!function) {
+      // Thunks.
+      continue;
+    }
+    if (i == 0) {
+      in_host_code = false;
+    }
+    const InlinedFunctionEntry* inlined_function =
+        function->LookupInlinedFunction(
+            function->MapMachineCodeToGuestAddress(host_pc));
+    if (inlined_function) {
+      functions.push_back(inlined_function->function);
+    }
+    functions.push_back(function);
+  }
+
+  std::vector<uint32_t> stack;
+  stack.reserve(functions.size() + 1);
+  std::lock_guard<std::mutex> lock(samples_mutex_);
+  for (auto it = functions.crbegin(); it != functions.crend(); ++it) {
+    GuestFunction* function = *it;
+    uint32_t address = function->address();
+    stack.push_back(address);
+    if (function_names_.find(address) == function_names_.end()) {
+      function_names_.emplace(address,
+                              function->name().empty()
+                                  ? fmt::format("sub_{:08X}", address)
+                                  : function->name());
+    }
+  }
+  if (in_host_code) {
+    stack.push_back(kHostCodeAddress);
+  }
+  ++stack_samples_[std::move(stack)];
+  ++sample_count_;
+}
+
+GuestProfiler::Report GuestProfiler::CreateReport() const {
+  Report report;
+  std::unordered_map<uint32_t, FunctionSamples> functions;
+  {
+    std::lock_guard<std::mutex> lock(samples_mutex_);
+    report.sample_count = sample_count_;
+    // Recursive calls are counted once in the inclusive samples.
+    std::vector<uint32_t> stack_functions;
+    for (const auto& [stack, samples] : stack_samples_) {
+      StackNode* node = &report.root;
+      node->samples += samples;
+      stack_functions.clear();
+      for (uint32_t address : stack) {
+        auto child_it =
+            std::find_if(node->children.begin(), node->children.end(),
+                         [address](const StackNode& child) {
+                           return child.address == address;
+                         });
+        if (child_it == node->children.end()) {
+          StackNode& child = node->children.emplace_back();
+          child.address = address;
+          node = &child;
+        } else {
+          node = &*child_it;
+        }
+        node->samples += samples;
+        if (std::find(stack_functions.cbegin(), stack_functions.cend(),
+                      address) == stack_functions.cend()) {
+          stack_functions.push_back(address);
+          functions.try_emplace(address, FunctionSamples{address, 0, 0})
+              .first->second.inclusive_samples += samples;
+        }
+      }
+      if (!stack.empty()) {
+        functions[stack.back()].self_samples += samples;
+      }
+    }
+  }
+  SortStackNodes(report.root);
+  report.functions.reserve(functions.size());
+  for (const auto& function : functions) {
+    report.functions.push_back(function.second);
+  }
+  std::sort(report.functions.begin(), report.functions.end(),
+            [](const FunctionSamples& a, const FunctionSamples& b) {
+              if (a.self_samples != b.self_samples) {
+                return a.self_samples > b.self_samples;
+              }
+              return a.inclusive_samples > b.inclusive_samples;
+            });
+  return report;
+}
+
+std::string GuestProfiler::GetFunctionName(uint32_t address) const {
+  std::lock_guard<std::mutex> lock(samples_mutex_);
+  return FormatFunctionName(function_names_, address);
+}
+
+bool GuestProfiler::WriteFoldedStacks(
+    const std::filesystem::path& path) const {
+  FILE* file = xe::filesystem::OpenFile(path, "wb");
+  if (!file) {
+    XELOGE("Guest profiler: failed to open {} for writing",
+           xe::path_to_utf8(path));
+    return false;
+  }
+  std::string line;
+  {
+    std::lock_guard<std::mutex> lock(samples_mutex_);
+    for (const auto& [stack, samples] : stack_samples_) {
+      line.clear();
+      for (uint32_t address : stack) {
+        if (!line.empty()) {
+          line.push_back(';');
+        }
+        std::string name = FormatFunctionName(function_names_, address);
+        // Semicolons separate the frames.
+        std::replace(name.begin(), name.end(), ';', ':');
+        line += name;
+      }
+      fmt::print(file, "{} {}\n", line, samples);
+    }
+  }
+  fclose(file);
+  XELOGI("Guest profiler: wrote the folded stacks to {}",
+         xe::path_to_utf8(path));
+  return true;
+}
+
+}  // namespace cpu
+}  // namespace xe
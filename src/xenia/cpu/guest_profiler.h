@@ -0,0 +1,103 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_CPU_GUEST_PROFILER_H_
+#define XENIA_CPU_GUEST_PROFILER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "xenia/base/threading.h"
+#include "xenia/cpu/processor.h"
+
+namespace xe {
+namespace cpu {
+
+// Sampling profiler of the guest code. A host thread periodically captures the
+// call stacks of the running guest threads and maps the host code in them to
+// the guest functions it has been translated from, counting how many times
+// each call stack has been seen.
+class GuestProfiler {
+ public:
+  // Address standing for the host code called by the guest, such as the
+  // kernel, at the top of a call stack.
+  static constexpr uint32_t kHostCodeAddress = 0;
+
+  struct FunctionSamples {
+    uint32_t address;
+    // Samples in the function itself.
+    uint64_t self_samples;
+    // Samples in the function and the functions it calls.
+    uint64_t inclusive_samples;
+  };
+
+  // Node of the tree of the sampled call stacks, for flame graphs.
+  struct StackNode {
+    uint32_t address = kHostCodeAddress;
+    uint64_t samples = 0;
+    std::vector<StackNode> children;
+  };
+
+  struct Report {
+    uint64_t sample_count = 0;
+    // From the most to the least self samples.
+    std::vector<FunctionSamples> functions;
+    // The children of the root are the outermost functions.
+    StackNode root;
+  };
+
+  explicit GuestProfiler(Processor* processor);
+  ~GuestProfiler();
+
+  bool is_running() const { return sampler_thread_ != nullptr; }
+  // Returns false if the call stacks can't be captured on the host.
+  bool Start();
+  void Stop();
+  // Drops the samples taken so far.
+  void Reset();
+
+  Report CreateReport() const;
+  std::string GetFunctionName(uint32_t address) const;
+  // Writes the samples as folded stacks (a line of semicolon-separated function
+  // names from the outermost one, and the sample count), as read by the
+  // flamegraph.pl, speedscope and Perfetto tools.
+  bool WriteFoldedStacks(const std::filesystem::path& path) const;
+
+ private:
+  void SamplerThread();
+  void RecordSample(const ThreadStackSample& sample);
+
+  Processor* processor_;
+
+  std::unique_ptr<xe::threading::Thread> sampler_thread_;
+  std::mutex sampler_shutdown_mutex_;
+  std::condition_variable sampler_shutdown_cond_;
+  bool sampler_shutdown_ = false;
+
+  mutable std::mutex samples_mutex_;
+  // Guest function addresses from the outermost one to the sample count,
+  // protected with samples_mutex_.
+  std::map<std::vector<uint32_t>, uint64_t> stack_samples_;
+  // Names of the sampled functions, taken when sampled as functions may be
+  // destroyed with their modules, protected with samples_mutex_.
+  std::unordered_map<uint32_t, std::string> function_names_;
+  uint64_t sample_count_ = 0;
+};
+
+}  // namespace cpu
+}  // namespace xe
+
+#endif  // XENIA_CPU_GUEST_PROFILER_H_
@@ -74,6 +74,7 @@ void HIRBuilder::Reset() {
   next_label_id_ = 0;
   next_value_ordinal_ = 0;
   locals_.clear();
+  folded_load_addresses_.clear();
   block_head_ = block_tail_ = NULL;
   current_block_ = NULL;
 #if SCRIBBLE_ARENA_ON_RESET
@@ -117,6 +118,12 @@ bool HIRBuilder::Finalize() {
   }
   return true;
 }
+Label* HIRBuilder::EmitInlinedFunction(Function* function,
+                                       uint32_t call_address,
+                                       Label* return_label) {
+  return nullptr;
+}
+
 Instr* HIRBuilder::AllocateInstruction() {
   Instr* result = free_instrs_.NewEntry();
   if (result) {
@@ -1359,6 +1366,15 @@ void HIRBuilder::MemoryBarrier() { AppendInstr(OPCODE_MEMORY_BARRIER_info, 0); }
 void HIRBuilder::DelayExecution() {
   AppendInstr(OPCODE_DELAY_EXECUTION_info, 0);
 }
+void HIRBuilder::SpinWait(Value* cond, Value* address, Value* value,
+                          uint32_t load_flags) {
+  ASSERT_ADDRESS_TYPE(address);
+  ASSERT_INTEGER_TYPE(value);
+  Instr* i = AppendInstr(OPCODE_SPIN_WAIT_info, load_flags);
+  i->set_src1(cond);
+  i->set_src2(address);
+  i->set_src3(value);
+}
 void HIRBuilder::SetRoundingMode(Value* value) {
   ASSERT_INTEGER_TYPE(value);
   Instr* i = AppendInstr(OPCODE_SET_ROUNDING_MODE_info, 0);
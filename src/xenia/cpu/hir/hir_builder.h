@@ -49,6 +49,14 @@ class HIRBuilder {
 
   virtual bool Finalize();
 
+  // Appends the code of a function called by the function being built in new
+  // blocks after the last one, for InliningPass. Returns of the inlined code
+  // branch to return_label, or return from the function being built if it's
+  // null for a tail call. Returns the label of the entry of the inlined code,
+  // or nullptr without modifying the HIR if the function can't be inlined.
+  virtual Label* EmitInlinedFunction(Function* function, uint32_t call_address,
+                                     Label* return_label);
+
   void Dump(StringBuffer* str);
   void AssertNoCycles();
 
@@ -58,6 +66,11 @@ class HIRBuilder {
   void set_attributes(uint32_t value) { attributes_ = value; }
 
   std::vector<Value*>& locals() { return locals_; }
+  // Guest addresses of the loads from read-only memory folded into constants,
+  // for retranslation of the function if the memory is made writable.
+  std::vector<uint32_t>& folded_load_addresses() {
+    return folded_load_addresses_;
+  }
 
   uint32_t max_value_ordinal() const { return next_value_ordinal_; }
 
@@ -203,6 +216,11 @@ class HIRBuilder {
                     CacheControlType type);
   void MemoryBarrier();
   void DelayExecution();
+  // If the condition is true, waits for a bounded time until the memory at the
+  // address differs from the value loaded from it with the load flags. For
+  // loops polling the memory.
+  void SpinWait(Value* cond, Value* address, Value* value,
+                uint32_t load_flags = 0);
   void SetRoundingMode(Value* value);
   Value* Max(Value* value1, Value* value2);
   Value* VectorMax(Value* value1, Value* value2, TypeName part_type,
@@ -322,6 +340,7 @@ class HIRBuilder {
   uint32_t next_value_ordinal_;
 
   std::vector<Value*> locals_;
+  std::vector<uint32_t> folded_load_addresses_;
 
   Block* block_head_;
   Block* block_tail_;
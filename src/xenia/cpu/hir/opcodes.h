@@ -37,6 +37,13 @@ enum RoundMode {
 
 enum LoadStoreFlags {
   LOAD_STORE_BYTE_SWAP = 1 << 0,
+  // Only for vectors, which must be 16-byte aligned otherwise.
+  LOAD_STORE_UNALIGNED = 1 << 1,
+};
+
+enum MemsetFlags {
+  // Not expected to be read soon, such as when only memory is set in a loop.
+  MEMSET_NON_TEMPORAL = 1 << 0,
 };
 
 enum CacheControlType {
@@ -293,6 +300,7 @@ enum Opcode {
   OPCODE_DELAY_EXECUTION,  // for db16cyc
   OPCODE_RESERVED_LOAD,
   OPCODE_RESERVED_STORE,
+  OPCODE_SPIN_WAIT,
 
   __OPCODE_MAX_VALUE,  // Keep at end.
 };
@@ -722,4 +722,10 @@ DEFINE_OPCODE(
     OPCODE_RESERVED_STORE,
     "reserved_store",
     OPCODE_SIG_V_V_V,
-    OPCODE_FLAG_MEMORY)
\ No newline at end of file
+    OPCODE_FLAG_MEMORY)
+
+DEFINE_OPCODE(
+    OPCODE_SPIN_WAIT,
+    "spin_wait",
+    OPCODE_SIG_X_V_V_V,
+    OPCODE_FLAG_MEMORY | OPCODE_FLAG_VOLATILE)
@@ -11,6 +11,7 @@
 
 #include <algorithm>
 #include <climits>
+#include <cstring>
 
 #include "xenia/base/byte_order.h"
 #include "xenia/base/logging.h"
@@ -145,9 +146,10 @@ int lzx_decompress(const void* lzx_data, size_t lzx_len, void* dest,
   return result_code;
 }
 
-int lzxdelta_apply_patch(xe::xex2_delta_patch* patch, size_t patch_len,
-                         uint32_t window_size, void* dest) {
-  void* patch_end = (char*)patch + patch_len;
+int lzxdelta_get_patch_entries(
+    const xe::xex2_delta_patch* patch, size_t patch_len,
+    std::vector<const xe::xex2_delta_patch*>& entries) {
+  const void* patch_end = (const char*)patch + patch_len;
   auto* cur_patch = patch;
 
   while (patch_end > cur_patch) {
@@ -156,36 +158,98 @@ int lzxdelta_apply_patch(xe::xex2_delta_patch* patch, size_t patch_len,
     if (cur_patch->compressed_len == 0 && cur_patch->uncompressed_len == 0 &&
         cur_patch->new_addr == 0 && cur_patch->old_addr == 0)
       break;
-    switch (cur_patch->compressed_len) {
-      case 0:  // fill with 0
-        std::memset((char*)dest + cur_patch->new_addr, 0,
-                    cur_patch->uncompressed_len);
-        break;
-      case 1:  // copy from old -> new
-        std::memcpy((char*)dest + cur_patch->new_addr,
-                    (char*)dest + cur_patch->old_addr,
-                    cur_patch->uncompressed_len);
-        break;
-      default:  // delta patch
-        patch_sz =
-            cur_patch->compressed_len - 4;  // -4 because of patch_data field
-
-        int result = lzx_decompress(
-            cur_patch->patch_data, cur_patch->compressed_len,
-            (char*)dest + cur_patch->new_addr, cur_patch->uncompressed_len,
-            window_size, (char*)dest + cur_patch->old_addr,
-            cur_patch->uncompressed_len);
-
-        if (result) {
-          return result;
-        }
-        break;
+    if (cur_patch->compressed_len > 1) {
+      patch_sz =
+          cur_patch->compressed_len - 4;  // -4 because of patch_data field
     }
+    entries.push_back(cur_patch);
 
     cur_patch++;
-    cur_patch = (xe::xex2_delta_patch*)((char*)cur_patch +
-                                        patch_sz);  // TODO: make this less ugly
+    cur_patch = (const xe::xex2_delta_patch*)((const char*)cur_patch +
+                                              patch_sz);
   }
 
   return 0;
 }
+
+int lzxdelta_apply_patch_entry(const xe::xex2_delta_patch* entry,
+                               uint32_t window_size, void* dest) {
+  switch (entry->compressed_len) {
+    case 0:  // fill with 0
+      std::memset((char*)dest + entry->new_addr, 0, entry->uncompressed_len);
+      return 0;
+    case 1:  // copy from old -> new
+      std::memcpy((char*)dest + entry->new_addr,
+                  (char*)dest + entry->old_addr, entry->uncompressed_len);
+      return 0;
+    default:  // delta patch
+      return lzx_decompress(
+          entry->patch_data, entry->compressed_len,
+          (char*)dest + entry->new_addr, entry->uncompressed_len, window_size,
+          (char*)dest + entry->old_addr, entry->uncompressed_len);
+  }
+}
+
+bool lzxdelta_patch_entries_independent(
+    const std::vector<const xe::xex2_delta_patch*>& entries) {
+  struct Range {
+    uint32_t start;
+    uint32_t end;
+    size_t entry_index;
+  };
+  std::vector<Range> writes;
+  writes.reserve(entries.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const xe::xex2_delta_patch* entry = entries[i];
+    if (entry->uncompressed_len) {
+      writes.push_back({entry->new_addr,
+                        entry->new_addr + entry->uncompressed_len, i});
+    }
+  }
+  std::sort(writes.begin(), writes.end(),
+            [](const Range& a, const Range& b) { return a.start < b.start; });
+  for (size_t i = 1; i < writes.size(); ++i) {
+    if (writes[i].start < writes[i - 1].end) {
+      return false;
+    }
+  }
+  // Zero fills don't read anything, and an entry may read the data it
+  // replaces, as the source window is copied before decompressing.
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const xe::xex2_delta_patch* entry = entries[i];
+    if (!entry->compressed_len || !entry->uncompressed_len) {
+      continue;
+    }
+    uint32_t read_start = entry->old_addr;
+    uint32_t read_end = read_start + entry->uncompressed_len;
+    auto it = std::upper_bound(
+        writes.begin(), writes.end(), read_end,
+        [](uint32_t address, const Range& range) {
+          return address <= range.start;
+        });
+    while (it != writes.begin()) {
+      --it;
+      if (it->end <= read_start) {
+        // The writes are disjoint, so the earlier ones also end before.
+        break;
+      }
+      if (it->entry_index != i) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int lzxdelta_apply_patch(xe::xex2_delta_patch* patch, size_t patch_len,
+                         uint32_t window_size, void* dest) {
+  std::vector<const xe::xex2_delta_patch*> entries;
+  lzxdelta_get_patch_entries(patch, patch_len, entries);
+  for (const xe::xex2_delta_patch* entry : entries) {
+    int result = lzxdelta_apply_patch_entry(entry, window_size, dest);
+    if (result) {
+      return result;
+    }
+  }
+  return 0;
+}
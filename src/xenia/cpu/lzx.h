@@ -26,4 +26,16 @@ int lzx_decompress(const void* lzx_data, size_t lzx_len, void* dest,
 int lzxdelta_apply_patch(xe::xex2_delta_patch* patch, size_t patch_len,
                          uint32_t window_size, void* dest);
 
+// Appends the entries of a delta patch block, so they can be applied
+// separately with lzxdelta_apply_patch_entry.
+int lzxdelta_get_patch_entries(
+    const xe::xex2_delta_patch* patch, size_t patch_len,
+    std::vector<const xe::xex2_delta_patch*>& entries);
+int lzxdelta_apply_patch_entry(const xe::xex2_delta_patch* entry,
+                               uint32_t window_size, void* dest);
+// Whether no entry reads or writes the data written by another one, so the
+// entries may be applied in any order, or at the same time.
+bool lzxdelta_patch_entries_independent(
+    const std::vector<const xe::xex2_delta_patch*>& entries);
+
 #endif  // XENIA_CPU_LZX_H_
@@ -56,6 +56,10 @@ class Module {
 
   virtual void Precompile() {}
 
+  // Returns the address of the last instruction of the function starting at
+  // the address if the module knows the exact extents of it, 0 otherwise.
+  virtual uint32_t GetKnownFunctionEnd(uint32_t address) const { return 0; }
+
  protected:
   virtual std::unique_ptr<Function> CreateFunction(uint32_t address) = 0;
 
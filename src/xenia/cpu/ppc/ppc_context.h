@@ -10,6 +10,7 @@
 #ifndef XENIA_CPU_PPC_PPC_CONTEXT_H_
 #define XENIA_CPU_PPC_PPC_CONTEXT_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <mutex>
 #include <string>
@@ -248,6 +249,13 @@ enum class PPCRegister {
 
 #pragma pack(push, 8)
 typedef struct alignas(64) PPCContext_s {
+  // Most frequently used fields first, packed into the first cache lines - the
+  // condition register fields and the carry set by the integer instructions,
+  // the link and count registers, and the general purpose registers, with the
+  // stack pointer and the argument registers in the first three lines.
+
+  // Condition registers:
+  // These are split to make it easier to do DCE on unused stores.
   union {
     uint32_t value;
     struct {
@@ -257,7 +265,7 @@ typedef struct alignas(64) PPCContext_s {
                        // successfully
       uint8_t cr0_so;  // Summary Overflow (SO) - copy of XER[SO]
     };
-  } cr0;  // 0xA24
+  } cr0;  // 0x0
   union {
     uint32_t value;
     struct {
@@ -371,31 +379,28 @@ typedef struct alignas(64) PPCContext_s {
       uint32_t
           fx : 1;  // FP exception summary                             -- sticky
     } bits;
-  } fpscr;  // Floating-point status and control register
+  } fpscr;  // 0x20 Floating-point status and control register
 
-  // Most frequently used registers first.
+  // XER register:
+  // Split to make it easier to do individual updates.
+  uint8_t xer_ca;  // 0x24
+  uint8_t xer_ov;
+  uint8_t xer_so;
+  // todo: remove, saturation should be represented by a vector
+  uint8_t vscr_sat;
 
-  uint64_t r[32];  // 0x20 General purpose registers
-  uint64_t ctr;    // 0x18 Count register
-  uint64_t lr;     // 0x10 Link register
+  uint64_t lr;     // 0x28 Link register
+  uint64_t ctr;    // 0x30 Count register
+  uint64_t r[32];  // 0x38 General purpose registers
 
   uint64_t msr;  // machine state register
 
-  double f[32];     // 0x120 Floating-point registers
-  vec128_t v[128];  // 0x220 VMX128 vector registers
+  double f[32];     // 0x140 Floating-point registers
+  vec128_t v[128];  // 0x240 VMX128 vector registers
   vec128_t vscr_vec;
-  // XER register:
-  // Split to make it easier to do individual updates.
-  uint8_t xer_ca;
-  uint8_t xer_ov;
-  uint8_t xer_so;
 
-  // Condition registers:
-  // These are split to make it easier to do DCE on unused stores.
   uint64_t cr() const;
   void set_cr(uint64_t value);
-  // todo: remove, saturation should be represented by a vector
-  uint8_t vscr_sat;
 
   uint32_t vrsave;
 
@@ -487,6 +492,8 @@ typedef struct alignas(64) PPCContext_s {
 #pragma pack(pop)
 constexpr size_t ppcctx_size = sizeof(PPCContext);
 static_assert(sizeof(PPCContext) % 64 == 0, "64b padded");
+static_assert(offsetof(PPCContext, r) + sizeof(uint64_t) * 13 <= 192,
+              "r0 to r12 must be in the first three cache lines");
 
 }  // namespace ppc
 }  // namespace cpu
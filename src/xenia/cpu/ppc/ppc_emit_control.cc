@@ -11,11 +11,13 @@
 
 #include "xenia/base/assert.h"
 #include "xenia/cpu/cpu_flags.h"
+#include "xenia/cpu/export_resolver.h"
 #include "xenia/cpu/ppc/ppc_context.h"
 #include "xenia/cpu/ppc/ppc_frontend.h"
 #include "xenia/cpu/ppc/ppc_hir_builder.h"
 
 #include <stddef.h>
+#include <string_view>
 // chrispy: added this, we can have simpler control flow and do dce on the
 // inputs
 DEFINE_bool(ignore_trap_instructions, true,
@@ -91,6 +93,18 @@ int InstrEmit_branch(PPCHIRBuilder& f, const char* src, uint64_t cia,
         f.Call(function, call_flags);
       }
     }
+  } else if (!lk && nia_is_lr && f.inline_return_label()) {
+    // Return from an inlined function, to the code after the call.
+    Label* label = f.inline_return_label();
+    if (cond) {
+      if (expect_true) {
+        f.BranchTrue(cond, label);
+      } else {
+        f.BranchFalse(cond, label);
+      }
+    } else {
+      f.Branch(label);
+    }
   } else {
 // Indirect branch to pointer.
 
@@ -432,6 +446,56 @@ int InstrEmit_mcrf(PPCHIRBuilder& f, const InstrData& i) {
 
 // System linkage (A-24)
 
+// Translates KeTlsGetValue and KeTlsSetValue, called very often by some titles,
+// as a load or a store of the slot, with the export only called for slots out
+// of the bounds of the array. The slots are reached through the TLS pointer at
+// the beginning of the PCR in r13. Returns false if not inlined.
+static bool EmitInlineTlsExport(PPCHIRBuilder& f) {
+  if (!cvars::inline_tls_exports) {
+    return false;
+  }
+  const Export* export_data = f.function()->export_data();
+  if (!export_data) {
+    return false;
+  }
+  std::string_view export_name(export_data->name);
+  bool is_get = export_name == "KeTlsGetValue";
+  if (!is_get && export_name != "KeTlsSetValue") {
+    return false;
+  }
+  uint32_t slot_count = f.frontend()->guest_tls_slot_count();
+  if (!slot_count) {
+    return false;
+  }
+  uint32_t slot_array_offset = f.frontend()->guest_tls_slot_array_offset();
+
+  Value* slot = f.Truncate(f.LoadGPR(3), INT32_TYPE);
+  Label* call_export = f.NewLabel();
+  Label* end = f.NewLabel();
+  f.BranchFalse(f.CompareULT(slot, f.LoadConstantUint32(slot_count)),
+                call_export);
+  Value* tls_address = f.ZeroExtend(
+      f.ByteSwap(f.LoadOffset(f.LoadGPR(13), f.LoadZeroInt64(), INT32_TYPE)),
+      INT64_TYPE);
+  Value* slot_offset =
+      f.Add(f.Shl(f.ZeroExtend(slot, INT64_TYPE), int8_t(2)),
+            f.LoadConstantUint64(slot_array_offset));
+  if (is_get) {
+    f.StoreGPR(3, f.ZeroExtend(f.ByteSwap(f.LoadOffset(tls_address, slot_offset,
+                                                       INT32_TYPE)),
+                               INT64_TYPE));
+  } else {
+    f.StoreOffset(tls_address, slot_offset,
+                  f.ByteSwap(f.Truncate(f.LoadGPR(4), INT32_TYPE)));
+    f.StoreGPR(3, f.LoadConstantUint64(1));
+  }
+  f.Branch(end);
+  f.MarkLabel(call_export);
+  f.CallExtern(f.function());
+  f.MarkLabel(end);
+  return true;
+}
+
 int InstrEmit_sc(PPCHIRBuilder& f, const InstrData& i) {
   // Game code should only ever use LEV=0.
   // LEV=2 is to signify 'call import' from Xenia.
@@ -441,7 +505,9 @@ int InstrEmit_sc(PPCHIRBuilder& f, const InstrData& i) {
     return 0;
   }
   if (i.SC.LEV == 2) {
-    f.CallExtern(f.function());
+    if (!EmitInlineTlsExport(f)) {
+      f.CallExtern(f.function());
+    }
     return 0;
   }
   XEINSTRNOTIMPLEMENTED();
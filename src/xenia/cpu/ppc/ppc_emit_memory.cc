@@ -22,6 +22,11 @@ DEFINE_bool(
     "instructions were written with the Xbox 360's cache in mind, and modern "
     "processors do their own automatic prefetching.",
     "CPU");
+DEFINE_bool(translate_data_cache_touch, true,
+            "Translate the dcbt and dcbtst cache touch hints to host prefetch "
+            "instructions, even if disable_prefetch_and_cachecontrol is "
+            "enabled, as they're much cheaper than cache flushes.",
+            "CPU");
 
 DEFINE_bool(no_reserved_ops, false,
             "For testing whether a game may have races with a broken reserved "
@@ -1140,7 +1145,8 @@ int InstrEmit_dcbst(PPCHIRBuilder& f, const InstrData& i) {
 }
 
 int InstrEmit_dcbt(PPCHIRBuilder& f, const InstrData& i) {
-  if (!cvars::disable_prefetch_and_cachecontrol) {
+  if (!cvars::disable_prefetch_and_cachecontrol ||
+      cvars::translate_data_cache_touch) {
     Value* ea = CalculateEA_0(f, i.X.RA, i.X.RB);
     f.CacheControl(ea, 128, CacheControlType::CACHE_CONTROL_TYPE_DATA_TOUCH);
   }
@@ -1148,7 +1154,8 @@ int InstrEmit_dcbt(PPCHIRBuilder& f, const InstrData& i) {
 }
 
 int InstrEmit_dcbtst(PPCHIRBuilder& f, const InstrData& i) {
-  if (!cvars::disable_prefetch_and_cachecontrol) {
+  if (!cvars::disable_prefetch_and_cachecontrol ||
+      cvars::translate_data_cache_touch) {
     Value* ea = CalculateEA_0(f, i.X.RA, i.X.RB);
     f.CacheControl(ea, 128,
                    CacheControlType::CACHE_CONTROL_TYPE_DATA_TOUCH_FOR_STORE);
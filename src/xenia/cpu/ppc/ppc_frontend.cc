@@ -10,8 +10,11 @@
 #include "xenia/cpu/ppc/ppc_frontend.h"
 
 #include "xenia/base/atomic.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/debugging.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/mutex.h"
+#include "xenia/cpu/cpu_flags.h"
 #include "xenia/cpu/ppc/ppc_context.h"
 #include "xenia/cpu/ppc/ppc_emit.h"
 #include "xenia/cpu/ppc/ppc_opcode_info.h"
@@ -91,6 +94,28 @@ void SyscallHandler(PPCContext* ppc_context, void* arg0, void* arg1) {
   }
 }
 
+// Called from the guest code at break_on_instruction when the condition holds,
+// only if the hits need to be counted or traced - plain conditional
+// breakpoints trap inline.
+void InstructionBreakpointHit(PPCContext* ppc_context, void* arg0,
+                              void* arg1) {
+  auto hit_count = reinterpret_cast<int32_t*>(arg0);
+  uint32_t hit = uint32_t(xe::atomic_inc(hit_count));
+  if (cvars::break_on_instruction_trace) {
+    XELOGI(
+        "Tracepoint {:08X} hit {}: r3={:016X} r4={:016X} r5={:016X} "
+        "r6={:016X} lr={:08X}",
+        uint32_t(cvars::break_on_instruction), hit, ppc_context->r[3],
+        ppc_context->r[4], ppc_context->r[5], ppc_context->r[6],
+        uint32_t(ppc_context->lr));
+  }
+  if (cvars::break_condition_hit_count
+          ? hit == cvars::break_condition_hit_count
+          : !cvars::break_on_instruction_trace) {
+    xe::debugging::Break();
+  }
+}
+
 bool PPCFrontend::Initialize() {
   void* arg0 = reinterpret_cast<void*>(&xe::global_critical_region::mutex());
   void* arg1 = reinterpret_cast<void*>(&builtins_.global_lock_count);
@@ -102,6 +127,9 @@ bool PPCFrontend::Initialize() {
       processor_->DefineBuiltin("LeaveGlobalLock", LeaveGlobalLock, arg0, arg1);
   builtins_.syscall_handler = processor_->DefineBuiltin(
       "SyscallHandler", SyscallHandler, nullptr, nullptr);
+  builtins_.instruction_breakpoint_hit = processor_->DefineBuiltin(
+      "InstructionBreakpointHit", InstructionBreakpointHit,
+      &builtins_.instruction_breakpoint_hit_count, nullptr);
   return true;
 }
 
@@ -122,13 +150,32 @@ bool PPCFrontend::DeclareFunction(GuestFunction* function) {
 
 bool PPCFrontend::DefineFunction(GuestFunction* function,
                                  uint32_t debug_info_flags) {
+  uint64_t start_host_ticks = Clock::QueryHostTickCount();
   auto translator = translator_pool_.Allocate(this);
   bool result = translator->Translate(function, debug_info_flags);
   translator->Reset();
   translator_pool_.Release(translator);
+  RecordTranslation(start_host_ticks);
+  return result;
+}
+
+bool PPCFrontend::TierUpFunction(GuestFunction* function) {
+  uint64_t start_host_ticks = Clock::QueryHostTickCount();
+  auto translator = translator_pool_.Allocate(this);
+  bool result = translator->TierUp(function);
+  translator->Reset();
+  translator_pool_.Release(translator);
+  RecordTranslation(start_host_ticks);
   return result;
 }
 
+void PPCFrontend::RecordTranslation(uint64_t start_host_ticks) {
+  translation_count_.fetch_add(1, std::memory_order_relaxed);
+  translation_host_ticks_.fetch_add(
+      Clock::QueryHostTickCount() - start_host_ticks,
+      std::memory_order_relaxed);
+}
+
 }  // namespace ppc
 }  // namespace cpu
 }  // namespace xe
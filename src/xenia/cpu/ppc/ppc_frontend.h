@@ -10,6 +10,8 @@
 #ifndef XENIA_CPU_PPC_PPC_FRONTEND_H_
 #define XENIA_CPU_PPC_PPC_FRONTEND_H_
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 
 #include "xenia/base/type_pool.h"
@@ -34,6 +36,10 @@ struct PPCBuiltins {
   Function* enter_global_lock;
   Function* leave_global_lock;
   Function* syscall_handler;
+  // Hits of break_on_instruction where the condition holds, for counting
+  // breakpoints and tracepoints.
+  int32_t instruction_breakpoint_hit_count;
+  Function* instruction_breakpoint_hit;
 };
 
 class PPCFrontend {
@@ -49,11 +55,62 @@ class PPCFrontend {
 
   bool DeclareFunction(GuestFunction* function);
   bool DefineFunction(GuestFunction* function, uint32_t debug_info_flags);
+  // Retranslates a function defined with baseline code with all optimizations.
+  bool TierUpFunction(GuestFunction* function);
+
+  // Translations done so far, including tier-ups, and the host time they have
+  // taken. Can be read from any thread.
+  uint64_t translation_count() const {
+    return translation_count_.load(std::memory_order_relaxed);
+  }
+  uint64_t translation_host_ticks() const {
+    return translation_host_ticks_.load(std::memory_order_relaxed);
+  }
+
+  // Functions scanned with the exact extents provided by the module, and how
+  // many of them the heuristics would have ended early, splitting the rest
+  // into functions translated separately.
+  void RecordKnownFunctionExtents(bool heuristics_ended_early) {
+    known_extent_function_count_.fetch_add(1, std::memory_order_relaxed);
+    if (heuristics_ended_early) {
+      early_end_avoided_count_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  uint64_t known_extent_function_count() const {
+    return known_extent_function_count_.load(std::memory_order_relaxed);
+  }
+  uint64_t early_end_avoided_count() const {
+    return early_end_avoided_count_.load(std::memory_order_relaxed);
+  }
+
+  // The TLS slot array of the guest threads is at the offset from the TLS
+  // pointer in the PCR, after the static TLS data of the title. Set by the
+  // kernel when the title is loaded, so KeTlsGetValue and KeTlsSetValue can be
+  // inlined, the slot count is 0 until then.
+  void SetGuestTlsLayout(uint32_t slot_array_offset, uint32_t slot_count) {
+    guest_tls_slot_array_offset_.store(slot_array_offset,
+                                       std::memory_order_relaxed);
+    guest_tls_slot_count_.store(slot_count, std::memory_order_release);
+  }
+  uint32_t guest_tls_slot_array_offset() const {
+    return guest_tls_slot_array_offset_.load(std::memory_order_relaxed);
+  }
+  uint32_t guest_tls_slot_count() const {
+    return guest_tls_slot_count_.load(std::memory_order_acquire);
+  }
 
  private:
+  void RecordTranslation(uint64_t start_host_ticks);
+
   Processor* processor_;
   PPCBuiltins builtins_ = {0};
   TypePool<PPCTranslator, PPCFrontend*> translator_pool_;
+  std::atomic<uint64_t> translation_count_{0};
+  std::atomic<uint64_t> translation_host_ticks_{0};
+  std::atomic<uint64_t> known_extent_function_count_{0};
+  std::atomic<uint64_t> early_end_avoided_count_{0};
+  std::atomic<uint32_t> guest_tls_slot_array_offset_{0};
+  std::atomic<uint32_t> guest_tls_slot_count_{0};
 };
 // Checks the state of the global lock and sets scratch to the current MSR
 // value.
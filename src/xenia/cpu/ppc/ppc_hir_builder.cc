@@ -78,6 +78,8 @@ void PPCHIRBuilder::Reset() {
   instr_count_ = 0;
   instr_offset_list_ = NULL;
   label_list_ = NULL;
+  inline_return_label_ = nullptr;
+  inlined_functions_.clear();
   with_debug_info_ = false;
   HIRBuilder::Reset();
 }
@@ -85,8 +87,6 @@ void PPCHIRBuilder::Reset() {
 bool PPCHIRBuilder::Emit(GuestFunction* function, uint32_t flags) {
   SCOPE_profile_cpu_f("cpu");
 
-  Memory* memory = frontend_->memory();
-
   function_ = function;
   start_address_ = function_->address();
   // chrispy: i've seen this one happen, not sure why but i think from trying to
@@ -117,8 +117,122 @@ bool PPCHIRBuilder::Emit(GuestFunction* function, uint32_t flags) {
   // Always mark entry with label.
   label_list_[0] = NewLabel();
 
-  uint32_t start_address = function_->address();
-  uint32_t end_address = function_->end_address();
+  EmitInstructions(function_->address(), function_->end_address());
+
+  if (false) {
+    DumpAllOpcodeCounts();
+  }
+
+  return Finalize();
+}
+
+Label* PPCHIRBuilder::EmitInlinedFunction(Function* function,
+                                          uint32_t call_address,
+                                          Label* return_label) {
+  auto callee = static_cast<GuestFunction*>(function);
+  if (!CanInlineFunction(callee, !return_label)) {
+    return nullptr;
+  }
+
+  // The state of the function being emitted is restored once the callee is
+  // emitted in new blocks, appended after the last one.
+  GuestFunction* caller = function_;
+  uint64_t caller_start_address = start_address_;
+  uint64_t caller_instr_count = instr_count_;
+  Instr** caller_instr_offset_list = instr_offset_list_;
+  Label** caller_label_list = label_list_;
+
+  function_ = callee;
+  start_address_ = callee->address();
+  instr_count_ = (callee->end_address() - callee->address()) / 4 + 1;
+  size_t list_size = instr_count_ * sizeof(void*);
+  instr_offset_list_ = (Instr**)arena_->Alloc(list_size, alignof(void*));
+  label_list_ = (Label**)arena_->Alloc(list_size, alignof(void*));
+  std::memset(instr_offset_list_, 0, list_size);
+  std::memset(label_list_, 0, list_size);
+  inline_return_label_ = return_label;
+
+  // Branches to the start of the callee get their own label, placed after the
+  // comment.
+  current_block_ = nullptr;
+  Label* entry_label = NewLabel();
+  MarkLabel(entry_label);
+  if (with_debug_info_) {
+    CommentFormat("inlined fn {:08X}-{:08X} {} called at {:08X}",
+                  callee->address(), callee->end_address(),
+                  callee->name().c_str(), call_address);
+  }
+  EmitInstructions(callee->address(), callee->end_address());
+  current_block_ = nullptr;
+
+  function_ = caller;
+  start_address_ = caller_start_address;
+  instr_count_ = caller_instr_count;
+  instr_offset_list_ = caller_instr_offset_list;
+  label_list_ = caller_label_list;
+  inline_return_label_ = nullptr;
+
+  inlined_functions_.push_back({call_address, callee});
+  return entry_label;
+}
+
+bool PPCHIRBuilder::CanInlineFunction(GuestFunction* function,
+                                      bool is_tail_call) {
+  // Only leaf code with all the branches inside it, returning at the end, is
+  // inlined. Tail calls return from the caller, so the callee may change LR
+  // then, as the save/restore helpers do.
+  Memory* memory = frontend_->memory();
+  uint32_t start_address = function->address();
+  uint32_t end_address = function->end_address();
+  for (uint32_t address = start_address; address <= end_address;
+       address += 4) {
+    uint32_t code =
+        xe::load_and_swap<uint32_t>(memory->TranslateVirtual(address));
+    PPCDecodeData d;
+    d.address = address;
+    d.code = code;
+    switch (LookupOpcode(code)) {
+      case PPCOpcode::kInvalid:
+      case PPCOpcode::bcctrx:
+      case PPCOpcode::sc:
+        return false;
+      case PPCOpcode::bx:
+        if (d.I.LK() || d.I.ADDR() < start_address ||
+            d.I.ADDR() > end_address) {
+          return false;
+        }
+        break;
+      case PPCOpcode::bcx:
+        if (d.B.LK() || d.B.ADDR() < start_address ||
+            d.B.ADDR() > end_address) {
+          return false;
+        }
+        break;
+      case PPCOpcode::bclrx:
+        if (d.XL.LK()) {
+          return false;
+        }
+        break;
+      case PPCOpcode::mtspr:
+        if (!is_tail_call && d.XFX.TBR() == 8) {
+          return false;
+        }
+        break;
+      default:
+        break;
+    }
+    // blr
+    if (address == end_address && code != 0x4E800020) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void PPCHIRBuilder::EmitInstructions(uint32_t start_address,
+                                     uint32_t end_address) {
+  Memory* memory = frontend_->memory();
+
   for (uint32_t address = start_address, offset = 0; address <= end_address;
        address += 4, offset++) {
     trace_info_.dest_count = 0;
@@ -191,12 +305,6 @@ bool PPCHIRBuilder::Emit(GuestFunction* function, uint32_t flags) {
       }
     }
   }
-
-  if (false) {
-    DumpAllOpcodeCounts();
-  }
-
-  return Finalize();
 }
 
 void PPCHIRBuilder::MaybeBreakOnInstruction(uint32_t address) {
@@ -206,8 +314,17 @@ void PPCHIRBuilder::MaybeBreakOnInstruction(uint32_t address) {
 
   Comment("--break-on-instruction target");
 
+  // Counting breakpoints and tracepoints call into the host only when the
+  // condition holds, everything else traps inline.
+  bool count_hits = cvars::break_condition_hit_count != 0 ||
+                    cvars::break_on_instruction_trace;
+
   if (cvars::break_condition_gpr < 0) {
-    DebugBreak();
+    if (count_hits) {
+      CallExtern(builtins()->instruction_breakpoint_hit);
+    } else {
+      DebugBreak();
+    }
     return;
   }
 
@@ -218,30 +335,35 @@ void PPCHIRBuilder::MaybeBreakOnInstruction(uint32_t address) {
     right = Truncate(right, INT32_TYPE);
   }
 
-  auto op = cvars::break_condition_op.c_str();
-  // TODO(rick): table?
-  if (xe_strcasecmp(op, "eq") == 0) {
-    TrapTrue(CompareEQ(left, right));
-  } else if (xe_strcasecmp(op, "ne") == 0) {
-    TrapTrue(CompareNE(left, right));
-  } else if (xe_strcasecmp(op, "slt") == 0) {
-    TrapTrue(CompareSLT(left, right));
-  } else if (xe_strcasecmp(op, "sle") == 0) {
-    TrapTrue(CompareSLE(left, right));
-  } else if (xe_strcasecmp(op, "sgt") == 0) {
-    TrapTrue(CompareSGT(left, right));
-  } else if (xe_strcasecmp(op, "sge") == 0) {
-    TrapTrue(CompareSGE(left, right));
-  } else if (xe_strcasecmp(op, "ult") == 0) {
-    TrapTrue(CompareULT(left, right));
-  } else if (xe_strcasecmp(op, "ule") == 0) {
-    TrapTrue(CompareULE(left, right));
-  } else if (xe_strcasecmp(op, "ugt") == 0) {
-    TrapTrue(CompareUGT(left, right));
-  } else if (xe_strcasecmp(op, "uge") == 0) {
-    TrapTrue(CompareUGE(left, right));
-  } else {
+  static const struct {
+    const char* name;
+    Value* (HIRBuilder::*compare)(Value* value1, Value* value2);
+  } kConditionOps[] = {
+      {"eq", &HIRBuilder::CompareEQ},   {"ne", &HIRBuilder::CompareNE},
+      {"slt", &HIRBuilder::CompareSLT}, {"sle", &HIRBuilder::CompareSLE},
+      {"sgt", &HIRBuilder::CompareSGT}, {"sge", &HIRBuilder::CompareSGE},
+      {"ult", &HIRBuilder::CompareULT}, {"ule", &HIRBuilder::CompareULE},
+      {"ugt", &HIRBuilder::CompareUGT}, {"uge", &HIRBuilder::CompareUGE},
+  };
+  Value* condition = nullptr;
+  for (const auto& condition_op : kConditionOps) {
+    if (!xe_strcasecmp(cvars::break_condition_op.c_str(), condition_op.name)) {
+      condition = (this->*condition_op.compare)(left, right);
+      break;
+    }
+  }
+  if (!condition) {
     assert_always();
+    return;
+  }
+
+  if (count_hits) {
+    Label* skip = NewLabel();
+    BranchFalse(condition, skip);
+    CallExtern(builtins()->instruction_breakpoint_hit);
+    MarkLabel(skip);
+  } else {
+    TrapTrue(condition);
   }
 }
 
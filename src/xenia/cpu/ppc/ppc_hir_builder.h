@@ -10,6 +10,8 @@
 #ifndef XENIA_CPU_PPC_PPC_HIR_BUILDER_H_
 #define XENIA_CPU_PPC_PPC_HIR_BUILDER_H_
 
+#include <vector>
+
 #include "xenia/base/string_buffer.h"
 #include "xenia/cpu/function.h"
 #include "xenia/cpu/hir/hir_builder.h"
@@ -39,10 +41,19 @@ class PPCHIRBuilder : public hir::HIRBuilder {
     EMIT_DEBUG_COMMENTS = 1 << 0,
   };
   bool Emit(GuestFunction* function, uint32_t flags);
+  Label* EmitInlinedFunction(Function* function, uint32_t call_address,
+                             Label* return_label) override;
 
   GuestFunction* function() const { return function_; }
+  PPCFrontend* frontend() const { return frontend_; }
   Function* LookupFunction(uint32_t address);
   Label* LookupLabel(uint32_t address);
+  // Where returns branch to in an inlined function not tail called.
+  Label* inline_return_label() const { return inline_return_label_; }
+  // Functions inlined into the function emitted last.
+  const std::vector<InlinedFunctionEntry>& inlined_functions() const {
+    return inlined_functions_;
+  }
 
   Value* LoadLR();
   void StoreLR(Value* value);
@@ -85,6 +96,8 @@ class PPCHIRBuilder : public hir::HIRBuilder {
   void SetReturnAddress(Value* value);
 
  private:
+  void EmitInstructions(uint32_t start_address, uint32_t end_address);
+  bool CanInlineFunction(GuestFunction* function, bool is_tail_call);
   void MaybeBreakOnInstruction(uint32_t address);
   void AnnotateLabel(uint32_t address, Label* label);
 
@@ -100,6 +113,8 @@ class PPCHIRBuilder : public hir::HIRBuilder {
   uint64_t instr_count_;
   Instr** instr_offset_list_;
   Label** label_list_;
+  Label* inline_return_label_ = nullptr;
+  std::vector<InlinedFunctionEntry> inlined_functions_;
 
   // Reset each instruction.
   struct {
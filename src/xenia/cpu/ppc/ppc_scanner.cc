@@ -273,6 +273,21 @@ bool PPCScanner::Scan(GuestFunction* function, FunctionDebugInfo* debug_info) {
     LOGPPC("Function ran under: {:08X}-{:08X} ended at {:08X}", start_address,
            end_address, address + 4);
   }
+
+  // The heuristics may end the function early, for instance, at a blr
+  // followed by code reached only through a jump table, which then gets
+  // translated again as separate functions, so use the exact extents if the
+  // module has them.
+  uint32_t known_end_address =
+      function->module()->GetKnownFunctionEnd(start_address);
+  if (known_end_address) {
+    frontend_->RecordKnownFunctionExtents(address < known_end_address);
+    if (address != known_end_address) {
+      LOGPPC("Function {:08X} ends at {:08X} rather than {:08X}", start_address,
+             known_end_address, address);
+    }
+    address = known_end_address;
+  }
   function->set_end_address(address);
 
   // If there's spare bits at the end, split the function.
@@ -11,6 +11,7 @@
 
 #include "xenia/base/assert.h"
 #include "xenia/base/byte_order.h"
+#include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
 #include "xenia/base/memory.h"
 #include "xenia/base/profiling.h"
@@ -33,6 +34,7 @@ namespace cpu {
 namespace ppc {
 
 using xe::cpu::backend::Backend;
+using xe::cpu::backend::CompilationTier;
 using xe::cpu::compiler::Compiler;
 namespace passes = xe::cpu::compiler::passes;
 
@@ -42,11 +44,20 @@ PPCTranslator::PPCTranslator(PPCFrontend* frontend) : frontend_(frontend) {
   scanner_.reset(new PPCScanner(frontend));
   builder_.reset(new PPCHIRBuilder(frontend));
   compiler_.reset(new Compiler(frontend->processor()));
+  baseline_compiler_.reset(new Compiler(frontend->processor()));
   assembler_ = backend->CreateAssembler();
   assembler_->Initialize();
 
   bool validate = cvars::validate_hir;
 
+  // Inlining adds blocks, so it must come before the CFG is built.
+  if (cvars::inline_functions) {
+    compiler_->AddPass(std::make_unique<passes::InliningPass>());
+    if (validate) {
+      compiler_->AddPass(std::make_unique<passes::ValidationPass>());
+    }
+  }
+
   // Merge blocks early. This will let us use more context in other passes.
   // The CFG is required for simplification and dirtied by it.
   compiler_->AddPass(std::make_unique<passes::ControlFlowAnalysisPass>());
@@ -55,6 +66,8 @@ PPCTranslator::PPCTranslator(PPCFrontend* frontend) : frontend_(frontend) {
   // Passes are executed in the order they are added. Multiple of the same
   // pass type may be used.
   if (validate) compiler_->AddPass(std::make_unique<passes::ValidationPass>());
+  // Context promotion follows the edges, which merging has made stale.
+  compiler_->AddPass(std::make_unique<passes::ControlFlowAnalysisPass>());
   compiler_->AddPass(std::make_unique<passes::ContextPromotionPass>());
   if (validate) compiler_->AddPass(std::make_unique<passes::ValidationPass>());
 
@@ -67,6 +80,30 @@ PPCTranslator::PPCTranslator(PPCFrontend* frontend) : frontend_(frontend) {
   if (validate) sap->AddPass(std::make_unique<passes::ValidationPass>());
   compiler_->AddPass(std::move(sap));
 
+  // Constant propagation may have changed the branches.
+  if (cvars::global_value_numbering || cvars::loop_invariant_code_motion) {
+    compiler_->AddPass(std::make_unique<passes::ControlFlowAnalysisPass>());
+  }
+  if (cvars::global_value_numbering) {
+    compiler_->AddPass(std::make_unique<passes::GlobalValueNumberingPass>());
+    if (validate) {
+      compiler_->AddPass(std::make_unique<passes::ValidationPass>());
+    }
+  }
+  // After value numbering, so equal computations in a loop are moved once.
+  if (cvars::loop_invariant_code_motion) {
+    compiler_->AddPass(std::make_unique<passes::LoopInvariantCodeMotionPass>());
+    if (validate) {
+      compiler_->AddPass(std::make_unique<passes::ValidationPass>());
+    }
+  }
+  if (cvars::spin_wait_detection) {
+    compiler_->AddPass(std::make_unique<passes::SpinWaitDetectionPass>());
+    if (validate) {
+      compiler_->AddPass(std::make_unique<passes::ValidationPass>());
+    }
+  }
+
   if (backend->machine_info()->supports_extended_load_store) {
     // Backend supports the advanced LOAD/STORE instructions.
     // These will save us a lot of HIR opcodes.
@@ -97,6 +134,24 @@ PPCTranslator::PPCTranslator(PPCFrontend* frontend) : frontend_(frontend) {
 
   // Must come last. The HIR is not really HIR after this.
   compiler_->AddPass(std::make_unique<passes::FinalizationPass>());
+
+  // Baseline pipeline for tiered compilation, only doing what's required to
+  // emit the code, and removing dead code to make register allocation cheaper.
+  if (validate) {
+    baseline_compiler_->AddPass(std::make_unique<passes::ValidationPass>());
+  }
+  baseline_compiler_->AddPass(
+      std::make_unique<passes::DeadCodeEliminationPass>());
+  baseline_compiler_->AddPass(std::make_unique<passes::RegisterAllocationPass>(
+      backend->machine_info()));
+  if (validate) {
+    baseline_compiler_->AddPass(std::make_unique<passes::ValidationPass>());
+  }
+  baseline_compiler_->AddPass(std::make_unique<passes::FinalizationPass>());
+
+  // Baseline code is never stored, so only the full pipeline identifies the
+  // stored code.
+  assembler_->set_pipeline_fingerprint(compiler_->fingerprint());
 }
 
 PPCTranslator::~PPCTranslator() = default;
@@ -157,8 +212,10 @@ bool PPCTranslator::Translate(GuestFunction* function,
   // Reset() all caching when we leave.
   xe::make_reset_scope(builder_);
   xe::make_reset_scope(compiler_);
+  xe::make_reset_scope(baseline_compiler_);
   xe::make_reset_scope(assembler_);
   xe::make_reset_scope(&string_buffer_);
+  builder_->arena()->ResetStatistics();
 
   // NOTE: we only want to do this when required, as it's expensive to build.
   if (cvars::disassemble_functions) {
@@ -186,6 +243,12 @@ bool PPCTranslator::Translate(GuestFunction* function,
     return false;
   }
 
+  // Reuse code generated during a previous run if possible. Debug info is only
+  // available when the function is actually translated.
+  if (!debug_info_flags && assembler_->AssembleFromStorage(function)) {
+    return true;
+  }
+
   // Setup trace data, if needed.
   if (debug_info_flags & DebugInfoFlags::kDebugInfoTraceFunctions) {
     // Base trace data.
@@ -215,6 +278,9 @@ bool PPCTranslator::Translate(GuestFunction* function,
   }
 
   // Emit function.
+  bool gather_statistics = cvars::jit_statistics;
+  uint64_t hir_build_start =
+      gather_statistics ? Clock::QueryHostTickCount() : 0;
   uint32_t emit_flags = 0;
   if (debug_info) {
     emit_flags |= PPCHIRBuilder::EMIT_DEBUG_COMMENTS;
@@ -222,6 +288,10 @@ bool PPCTranslator::Translate(GuestFunction* function,
   if (!builder_->Emit(function, emit_flags)) {
     return false;
   }
+  uint64_t hir_build_ticks =
+      gather_statistics ? Clock::QueryHostTickCount() - hir_build_start : 0;
+  uint32_t raw_hir_instruction_count =
+      gather_statistics ? CountHIRInstructions() : 0;
 
   // Stash raw HIR.
   if (debug_info_flags & DebugInfoFlags::kDebugInfoDisasmRawHir) {
@@ -230,10 +300,20 @@ bool PPCTranslator::Translate(GuestFunction* function,
     string_buffer_.Reset();
   }
 
-  // Compile/optimize/etc.
-  if (!compiler_->Compile(builder_.get())) {
+  // Compile/optimize/etc. Functions are compiled with minimal optimizations
+  // first if possible, and recompiled in TierUp once they become hot.
+  CompilationTier tier = cvars::tiered_compilation && !debug_info_flags
+                             ? CompilationTier::kBaseline
+                             : CompilationTier::kOptimized;
+  Compiler* compiler = tier == CompilationTier::kBaseline
+                           ? baseline_compiler_.get()
+                           : compiler_.get();
+  std::vector<FunctionCompilationStatistics::PassTime> pass_ticks;
+  if (!compiler->Compile(builder_.get(),
+                         gather_statistics ? &pass_ticks : nullptr)) {
     return false;
   }
+  function->inlined_functions() = builder_->inlined_functions();
 
   // Stash optimized HIR.
   if (debug_info_flags & DebugInfoFlags::kDebugInfoDisasmHir) {
@@ -245,14 +325,118 @@ bool PPCTranslator::Translate(GuestFunction* function,
   DumpHIR(function, builder_.get());
 
   // Assemble to backend machine code.
+  uint64_t assembly_start =
+      gather_statistics ? Clock::QueryHostTickCount() : 0;
   if (!assembler_->Assemble(function, builder_.get(), debug_info_flags,
-                            std::move(debug_info))) {
+                            std::move(debug_info), tier)) {
     return false;
   }
+  frontend_->processor()->RegisterFoldedLoads(
+      function, builder_->folded_load_addresses());
+  if (gather_statistics) {
+    RecordCompilationStatistics(function, hir_build_ticks,
+                                raw_hir_instruction_count,
+                                std::move(pass_ticks),
+                                Clock::QueryHostTickCount() - assembly_start,
+                                compiler);
+  }
 
   return true;
 }
+
+bool PPCTranslator::TierUp(GuestFunction* function) {
+  SCOPE_profile_cpu_f("cpu");
+  HirBuilderScope hir_build_scope{builder_.get()};
+  xe::make_reset_scope(builder_);
+  xe::make_reset_scope(compiler_);
+  xe::make_reset_scope(assembler_);
+  builder_->arena()->ResetStatistics();
+
+  // The extents of the function are already known from the baseline
+  // translation, and baseline code is only emitted without debug info.
+  bool gather_statistics = cvars::jit_statistics;
+  uint64_t hir_build_start =
+      gather_statistics ? Clock::QueryHostTickCount() : 0;
+  if (!builder_->Emit(function, 0)) {
+    return false;
+  }
+  uint64_t hir_build_ticks =
+      gather_statistics ? Clock::QueryHostTickCount() - hir_build_start : 0;
+  uint32_t raw_hir_instruction_count =
+      gather_statistics ? CountHIRInstructions() : 0;
+  std::vector<FunctionCompilationStatistics::PassTime> pass_ticks;
+  if (!compiler_->Compile(builder_.get(),
+                          gather_statistics ? &pass_ticks : nullptr)) {
+    return false;
+  }
+  // Baseline code has nothing inlined, so this can't be read by the stack
+  // walker before the optimized code is set up. Optimized code retranslated
+  // for other reasons has the same functions inlined, and may be running.
+  if (function->inlined_functions().empty()) {
+    function->inlined_functions() = builder_->inlined_functions();
+  }
+  DumpHIR(function, builder_.get());
+  uint64_t assembly_start =
+      gather_statistics ? Clock::QueryHostTickCount() : 0;
+  if (!assembler_->Assemble(function, builder_.get(), 0, nullptr,
+                            CompilationTier::kOptimized)) {
+    return false;
+  }
+  frontend_->processor()->RegisterFoldedLoads(
+      function, builder_->folded_load_addresses());
+  if (gather_statistics) {
+    RecordCompilationStatistics(function, hir_build_ticks,
+                                raw_hir_instruction_count,
+                                std::move(pass_ticks),
+                                Clock::QueryHostTickCount() - assembly_start,
+                                compiler_.get());
+  }
+  return true;
+}
 void PPCTranslator::Reset() { builder_->ResetPools(); }
+
+void PPCTranslator::RecordCompilationStatistics(
+    GuestFunction* function, uint64_t hir_build_ticks,
+    uint32_t raw_hir_instruction_count,
+    std::vector<FunctionCompilationStatistics::PassTime> pass_ticks,
+    uint64_t assembly_ticks, Compiler* compiler) {
+  FunctionCompilationStatistics statistics = function->compilation_statistics();
+  statistics.previous_translations_ticks +=
+      statistics.hir_build_ticks + statistics.assembly_ticks;
+  for (const auto& pass_time : statistics.pass_ticks) {
+    statistics.previous_translations_ticks += pass_time.ticks;
+  }
+  ++statistics.translation_count;
+  statistics.hir_build_ticks = hir_build_ticks;
+  statistics.pass_ticks = std::move(pass_ticks);
+  statistics.assembly_ticks = assembly_ticks;
+  statistics.raw_hir_instruction_count = raw_hir_instruction_count;
+  statistics.hir_instruction_count = CountHIRInstructions();
+  statistics.machine_code_length =
+      static_cast<uint32_t>(function->machine_code_length());
+  Arena* hir_arena = builder_->arena();
+  statistics.hir_arena_size = static_cast<uint32_t>(hir_arena->peak_size());
+  statistics.hir_allocation_count =
+      static_cast<uint32_t>(hir_arena->allocation_count());
+  Arena* scratch_arena = compiler->scratch_arena();
+  statistics.scratch_arena_peak_size =
+      static_cast<uint32_t>(scratch_arena->peak_size());
+  statistics.scratch_allocation_count =
+      static_cast<uint32_t>(scratch_arena->allocation_count());
+  function->set_compilation_statistics(statistics);
+}
+
+uint32_t PPCTranslator::CountHIRInstructions() const {
+  uint32_t count = 0;
+  for (auto block = builder_->first_block(); block; block = block->next) {
+    for (auto instr = block->instr_head; instr; instr = instr->next) {
+      if (!instr->IsFake()) {
+        ++count;
+      }
+    }
+  }
+  return count;
+}
 void PPCTranslator::DumpSource(GuestFunction* function,
                                StringBuffer* string_buffer) {
   Memory* memory = frontend_->memory();
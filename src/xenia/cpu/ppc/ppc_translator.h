@@ -11,6 +11,7 @@
 #define XENIA_CPU_PPC_PPC_TRANSLATOR_H_
 
 #include <memory>
+#include <vector>
 
 #include "xenia/base/string_buffer.h"
 #include "xenia/cpu/backend/assembler.h"
@@ -31,16 +32,26 @@ class PPCTranslator {
   ~PPCTranslator();
 
   bool Translate(GuestFunction* function, uint32_t debug_info_flags);
+  // Replaces the baseline code of a translated function with code compiled
+  // with all optimizations.
+  bool TierUp(GuestFunction* function);
   void DumpHIR(GuestFunction* function, PPCHIRBuilder* builder);
   void Reset();
 
  private:
   void DumpSource(GuestFunction* function, StringBuffer* string_buffer);
+  uint32_t CountHIRInstructions() const;
+  void RecordCompilationStatistics(
+      GuestFunction* function, uint64_t hir_build_ticks,
+      uint32_t raw_hir_instruction_count,
+      std::vector<FunctionCompilationStatistics::PassTime> pass_ticks,
+      uint64_t assembly_ticks, compiler::Compiler* compiler);
 
   PPCFrontend* frontend_;
   std::unique_ptr<PPCScanner> scanner_;
   std::unique_ptr<PPCHIRBuilder> builder_;
   std::unique_ptr<compiler::Compiler> compiler_;
+  std::unique_ptr<compiler::Compiler> baseline_compiler_;
   std::unique_ptr<backend::Assembler> assembler_;
 
   StringBuffer string_buffer_;
@@ -0,0 +1,220 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/console_app_main.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/string_util.h"
+#include "xenia/base/utf8.h"
+#include "xenia/cpu/ppc/testing/ppc_testing.h"
+
+#if XE_ARCH_AMD64
+#include "xenia/base/platform_amd64.h"
+#endif  // XE_ARCH
+
+DEFINE_transient_string(test_name, "", "Test suite name.", "General");
+DEFINE_uint32(benchmark_iterations, 1000000,
+              "Number of times each test case is executed.", "Other");
+DEFINE_string(benchmark_extension_masks, "0,-1",
+              "Comma-separated x64_extension_mask values to benchmark every "
+              "test case with.",
+              "Other");
+DEFINE_path(benchmark_csv_path, "",
+            "File to write the results to as CSV, for comparing runs.",
+            "Other");
+
+namespace xe {
+namespace cpu {
+namespace test {
+
+// Cycles of the time stamp counter where available.
+uint64_t QueryBenchmarkTicks() {
+#if XE_CLOCK_RAW_AVAILABLE
+  return Clock::host_tick_count_raw();
+#else
+  return Clock::QueryHostTickCount();
+#endif  // XE_CLOCK_RAW_AVAILABLE
+}
+
+struct BenchmarkResult {
+  std::string name;
+  // Of the whole snippet, which is straight-line code in most tests.
+  uint32_t guest_instruction_count;
+  // Per mask.
+  std::vector<double> ticks_per_call;
+};
+
+// Returns the host ticks per execution of the test case, or a negative value
+// if it can't be run.
+double BenchmarkTestCase(TestSuite& test_suite, TestRunner& runner,
+                         TestCase& test_case,
+                         uint32_t* out_guest_instruction_count) {
+  if (!runner.Setup(test_suite) || !runner.SetupTestState(test_case)) {
+    XELOGE("    BENCHMARK FAILED SETUP");
+    return -1.0;
+  }
+  Function* fn = runner.processor_->ResolveFunction(test_case.address);
+  if (!fn) {
+    XELOGE("    Entry function not found");
+    return -1.0;
+  }
+  *out_guest_instruction_count =
+      fn->has_end_address() ? (fn->end_address() - fn->address()) / 4 + 1 : 0;
+
+  ThreadState* thread_state = runner.thread_state_.get();
+  PPCContext* context = thread_state->context();
+  const uint32_t return_address = 0xBCBCBCBC;
+  context->lr = return_address;
+  // The snippets depend on their inputs, so the context is restored before
+  // every execution, and the time of restoring it is subtracted.
+  auto initial_context = std::make_unique<PPCContext>();
+  std::memcpy(initial_context.get(), context, sizeof(PPCContext));
+
+  // Also translates the function and warms up the caches.
+  fn->Call(thread_state, return_address);
+  if (!runner.CheckTestResults(test_case)) {
+    XELOGW("    Results don't match the expectations, the code may be wrong");
+  }
+
+  uint32_t iterations = std::max(cvars::benchmark_iterations, uint32_t(1));
+  uint64_t restore_start_ticks = QueryBenchmarkTicks();
+  for (uint32_t i = 0; i < iterations; ++i) {
+    std::memcpy(context, initial_context.get(), sizeof(PPCContext));
+  }
+  uint64_t restore_ticks = QueryBenchmarkTicks() - restore_start_ticks;
+  uint64_t run_start_ticks = QueryBenchmarkTicks();
+  for (uint32_t i = 0; i < iterations; ++i) {
+    std::memcpy(context, initial_context.get(), sizeof(PPCContext));
+    fn->Call(thread_state, return_address);
+  }
+  uint64_t run_ticks = QueryBenchmarkTicks() - run_start_ticks;
+  return double(run_ticks - std::min(restore_ticks, run_ticks)) / iterations;
+}
+
+bool WriteBenchmarkCsv(const std::vector<int64_t>& masks,
+                       const std::vector<BenchmarkResult>& results) {
+  FILE* file = xe::filesystem::OpenFile(cvars::benchmark_csv_path, "w");
+  if (!file) {
+    XELOGE("Unable to open {} for writing",
+           xe::path_to_utf8(cvars::benchmark_csv_path));
+    return false;
+  }
+  fmt::print(file, "test,guest_instructions");
+  for (int64_t mask : masks) {
+    fmt::print(file, ",ticks_per_call_mask_{}", mask);
+  }
+  fmt::print(file, "\n");
+  for (const BenchmarkResult& result : results) {
+    fmt::print(file, "{},{}", result.name, result.guest_instruction_count);
+    for (double ticks_per_call : result.ticks_per_call) {
+      fmt::print(file, ",{:.2f}", ticks_per_call);
+    }
+    fmt::print(file, "\n");
+  }
+  fclose(file);
+  return true;
+}
+
+bool RunBenchmarks(const std::string_view test_name) {
+  std::vector<int64_t> masks;
+  for (std::string_view mask : xe::utf8::split(
+           cvars::benchmark_extension_masks, ", ", true)) {
+    masks.push_back(xe::string_util::from_string<int64_t>(mask));
+  }
+  if (masks.empty()) {
+#if XE_ARCH_AMD64
+    masks.push_back(cvars::x64_extension_mask);
+#else
+    masks.push_back(-1);
+#endif  // XE_ARCH_AMD64
+  }
+
+  std::vector<std::filesystem::path> test_files;
+  if (!DiscoverTests(cvars::test_path, test_files) || test_files.empty()) {
+    XELOGE("No tests discovered - invalid path?");
+    return false;
+  }
+  std::vector<TestSuite> test_suites;
+  for (auto& test_path : test_files) {
+    TestSuite test_suite(test_path);
+    if (!test_name.empty() && test_suite.name() != test_name) {
+      continue;
+    }
+    if (!test_suite.Load()) {
+      XELOGE("TEST SUITE {} FAILED TO LOAD", xe::path_to_utf8(test_path));
+      continue;
+    }
+    test_suites.push_back(std::move(test_suite));
+  }
+  XELOGI("{} test suites loaded, {} iterations per test case.",
+         test_suites.size(), cvars::benchmark_iterations);
+
+  std::vector<BenchmarkResult> results;
+  for (auto& test_suite : test_suites) {
+    for (auto& test_case : test_suite.test_cases()) {
+      BenchmarkResult& result = results.emplace_back();
+      result.name = test_suite.name() + "." + test_case.name;
+      result.guest_instruction_count = 0;
+    }
+  }
+
+  bool any_failed = false;
+  for (size_t i = 0; i < masks.size(); ++i) {
+#if XE_ARCH_AMD64
+    // The emitter takes the features when it's created with the processor.
+    cvars::x64_extension_mask = masks[i];
+    amd64::InitFeatureFlags();
+#endif  // XE_ARCH_AMD64
+    XELOGI("Instruction feature mask {}:", masks[i]);
+    TestRunner runner;
+    size_t result_index = 0;
+    for (auto& test_suite : test_suites) {
+      for (auto& test_case : test_suite.test_cases()) {
+        BenchmarkResult& result = results[result_index++];
+        double ticks_per_call = BenchmarkTestCase(
+            test_suite, runner, test_case, &result.guest_instruction_count);
+        any_failed |= ticks_per_call < 0.0;
+        result.ticks_per_call.push_back(ticks_per_call);
+        if (ticks_per_call >= 0.0) {
+          XELOGI("  {:40} {:8.2f} ticks/call {:8.2f} ticks/instruction",
+                 result.name, ticks_per_call,
+                 ticks_per_call /
+                     std::max(result.guest_instruction_count, uint32_t(1)));
+        }
+      }
+    }
+  }
+
+  if (!cvars::benchmark_csv_path.empty() &&
+      !WriteBenchmarkCsv(masks, results)) {
+    return false;
+  }
+  return !any_failed;
+}
+
+int main(const std::vector<std::string>& args) {
+  return RunBenchmarks(cvars::test_name) ? 0 : 1;
+}
+
+}  // namespace test
+}  // namespace cpu
+}  // namespace xe
+
+XE_DEFINE_CONSOLE_APP("xenia-cpu-ppc-benchmark", xe::cpu::test::main,
+                      "[test name]", "test_name");
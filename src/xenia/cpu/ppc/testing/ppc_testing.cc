@@ -0,0 +1,15 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2020 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/ppc/testing/ppc_testing.h"
+
+DEFINE_path(test_path, "src/xenia/cpu/ppc/testing/",
+            "Directory scanned for test files.", "Other");
+DEFINE_path(test_bin_path, "src/xenia/cpu/ppc/testing/bin/",
+            "Directory with binary outputs of the test files.", "Other");
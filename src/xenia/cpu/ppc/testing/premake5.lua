@@ -19,6 +19,8 @@ project("xenia-cpu-ppc-tests")
     "xenia-patcher",
   })
   files({
+    "ppc_testing.cc",
+    "ppc_testing.h",
     "ppc_testing_main.cc",
     "../../../base/console_app_main_"..platform_suffix..".cc",
   })
@@ -41,6 +43,39 @@ project("xenia-cpu-ppc-tests")
     -- xenia-base needs this
     links({"xenia-ui"})
 
+project("xenia-cpu-ppc-benchmark")
+  uuid("7d3c5a1e-2b9f-4e86-a0c4-5f1d8e6b3a92")
+  kind("ConsoleApp")
+  language("C++")
+  links({
+    "capstone", -- cpu-backend-x64
+    "fmt",
+    "mspack",
+    "imgui",
+    "xenia-core",
+    "xenia-cpu",
+    "xenia-gpu",
+    "xenia-base",
+    "xenia-kernel",
+    "xenia-patcher",
+  })
+  files({
+    "ppc_benchmark_main.cc",
+    "ppc_testing.cc",
+    "ppc_testing.h",
+    "../../../base/console_app_main_"..platform_suffix..".cc",
+  })
+  filter("architecture:x86_64")
+    links({
+      "xenia-cpu-backend-x64",
+    })
+  filter("platforms:Windows")
+    debugdir(project_root)
+
+    -- xenia-base needs this
+    links({"xenia-ui"})
+  filter({})
+
 if ARCH == "ppc64" or ARCH == "powerpc64" then
 
 project("xenia-cpu-ppc-nativetests")
@@ -0,0 +1,33 @@
+test_dcbz128_loop_1:
+  # Zeroes whole cache lines, like memset of large guest buffers.
+  #_ MEMORY_IN 10001000 01010101 02020202
+  #_ MEMORY_IN 100011F8 03030303 04040404
+  #_ MEMORY_IN 10001200 05050505
+  #_ REGISTER_IN r3 0x10001000
+  #_ REGISTER_IN r4 4
+  mtctr r4
+dcbz128_loop_1_loop:
+  # dcbz128 r0, r3
+  .long 0x7C201FEC
+  addi r3, r3, 128
+  bdnz dcbz128_loop_1_loop
+  blr
+  #_ REGISTER_OUT r3 0x10001200
+  #_ REGISTER_OUT r4 4
+  #_ MEMORY_OUT 10001000 00000000 00000000
+  #_ MEMORY_OUT 100011F8 00000000 00000000
+  #_ MEMORY_OUT 10001200 05050505
+
+test_dcbz128_1:
+  # The address is rounded down to the line.
+  #_ MEMORY_IN 10001000 01010101 02020202
+  #_ MEMORY_IN 10001078 03030303 04040404
+  #_ MEMORY_IN 10001080 05050505
+  #_ REGISTER_IN r3 0x10001044
+  # dcbz128 r0, r3
+  .long 0x7C201FEC
+  blr
+  #_ REGISTER_OUT r3 0x10001044
+  #_ MEMORY_OUT 10001000 00000000 00000000
+  #_ MEMORY_OUT 10001078 00000000 00000000
+  #_ MEMORY_OUT 10001080 05050505
@@ -0,0 +1,74 @@
+test_loop_invariant_1:
+  # The shift and the first add compute the same values in every iteration.
+  #_ REGISTER_IN r3 5
+  #_ REGISTER_IN r4 0x10
+  #_ REGISTER_IN r5 3
+  li r6, 0
+loop_invariant_1_loop:
+  slwi r7, r4, 2
+  add r8, r7, r5
+  add r6, r6, r8
+  addi r3, r3, -1
+  cmpwi r3, 0
+  bne loop_invariant_1_loop
+  blr
+  #_ REGISTER_OUT r3 0
+  #_ REGISTER_OUT r4 0x10
+  #_ REGISTER_OUT r5 3
+  #_ REGISTER_OUT r6 0x14F
+  #_ REGISTER_OUT r7 0x40
+  #_ REGISTER_OUT r8 0x43
+
+test_loop_invariant_2:
+  # The shifted register is written in the loop, so the shift must stay.
+  #_ REGISTER_IN r3 4
+  #_ REGISTER_IN r4 1
+  li r6, 0
+loop_invariant_2_loop:
+  add r6, r6, r4
+  slwi r4, r4, 1
+  addi r3, r3, -1
+  cmpwi r3, 0
+  bne loop_invariant_2_loop
+  blr
+  #_ REGISTER_OUT r3 0
+  #_ REGISTER_OUT r4 16
+  #_ REGISTER_OUT r6 15
+
+test_loop_invariant_3:
+  # The value computed before the loop is the same as in the loop.
+  #_ REGISTER_IN r3 3
+  #_ REGISTER_IN r4 0x1234
+  #_ REGISTER_IN r5 0x10
+  add r6, r4, r5
+  li r8, 0
+loop_invariant_3_loop:
+  add r7, r4, r5
+  subf r9, r6, r7
+  add r8, r8, r9
+  addi r3, r3, -1
+  cmpwi r3, 0
+  bne loop_invariant_3_loop
+  blr
+  #_ REGISTER_OUT r3 0
+  #_ REGISTER_OUT r6 0x1244
+  #_ REGISTER_OUT r7 0x1244
+  #_ REGISTER_OUT r8 0
+  #_ REGISTER_OUT r9 0
+
+test_value_numbering_1:
+  # The sum in the taken branch is computed in the entry block already.
+  #_ REGISTER_IN r4 0x1234
+  #_ REGISTER_IN r5 0x10
+  add r6, r4, r5
+  cmpwi r4, 0
+  beq value_numbering_1_skip
+  add r7, r4, r5
+  subf r8, r6, r7
+  blr
+value_numbering_1_skip:
+  li r8, -1
+  blr
+  #_ REGISTER_OUT r6 0x1244
+  #_ REGISTER_OUT r7 0x1244
+  #_ REGISTER_OUT r8 0
@@ -0,0 +1,55 @@
+test_unaligned_vector_load_1:
+  #_ MEMORY_IN 10001040 00010203 04050607 08090A0B 0C0D0E0F 10111213 14151617 18191A1B 1C1D1E1F
+  #_ REGISTER_IN r4 0x10001044
+  li r5, 16
+  lvlx v3, r0, r4
+  lvrx v4, r4, r5
+  vor v5, v3, v4
+  blr
+  #_ REGISTER_OUT r4 0x10001044
+  #_ REGISTER_OUT r5 16
+  #_ REGISTER_OUT v3 [04050607, 08090A0B, 0C0D0E0F, 00000000]
+  #_ REGISTER_OUT v4 [00000000, 00000000, 00000000, 10111213]
+  #_ REGISTER_OUT v5 [04050607, 08090A0B, 0C0D0E0F, 10111213]
+
+test_unaligned_vector_load_2:
+  # Aligned, with nothing loaded by lvrx.
+  #_ MEMORY_IN 10001040 00010203 04050607 08090A0B 0C0D0E0F 10111213 14151617 18191A1B 1C1D1E1F
+  #_ REGISTER_IN r4 0x10001040
+  li r5, 16
+  lvlx v3, r0, r4
+  lvrx v4, r4, r5
+  vor v5, v4, v3
+  blr
+  #_ REGISTER_OUT r4 0x10001040
+  #_ REGISTER_OUT r5 16
+  #_ REGISTER_OUT v3 [00010203, 04050607, 08090A0B, 0C0D0E0F]
+  #_ REGISTER_OUT v4 [00000000, 00000000, 00000000, 00000000]
+  #_ REGISTER_OUT v5 [00010203, 04050607, 08090A0B, 0C0D0E0F]
+
+test_unaligned_vector_store_1:
+  #_ MEMORY_IN 10001040 CCCCCCCC CCCCCCCC CCCCCCCC CCCCCCCC CCCCCCCC CCCCCCCC CCCCCCCC CCCCCCCC
+  #_ REGISTER_IN r4 0x10001044
+  #_ REGISTER_IN v3 [00010203, 04050607, 08090A0B, 0C0D0E0F]
+  li r5, 16
+  stvlx v3, r0, r4
+  stvrx v3, r4, r5
+  blr
+  #_ REGISTER_OUT r4 0x10001044
+  #_ REGISTER_OUT r5 16
+  #_ REGISTER_OUT v3 [00010203, 04050607, 08090A0B, 0C0D0E0F]
+  #_ MEMORY_OUT 10001040 CCCCCCCC 00010203 04050607 08090A0B 0C0D0E0F CCCCCCCC CCCCCCCC CCCCCCCC
+
+test_unaligned_vector_store_2:
+  # Aligned, with nothing stored by stvrx.
+  #_ MEMORY_IN 10001040 CCCCCCCC CCCCCCCC CCCCCCCC CCCCCCCC CCCCCCCC CCCCCCCC CCCCCCCC CCCCCCCC
+  #_ REGISTER_IN r4 0x10001040
+  #_ REGISTER_IN v3 [00010203, 04050607, 08090A0B, 0C0D0E0F]
+  li r5, 16
+  stvrx v3, r4, r5
+  stvlx v3, r0, r4
+  blr
+  #_ REGISTER_OUT r4 0x10001040
+  #_ REGISTER_OUT r5 16
+  #_ REGISTER_OUT v3 [00010203, 04050607, 08090A0B, 0C0D0E0F]
+  #_ MEMORY_OUT 10001040 00010203 04050607 08090A0B 0C0D0E0F CCCCCCCC CCCCCCCC CCCCCCCC CCCCCCCC
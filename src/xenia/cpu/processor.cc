@@ -9,19 +9,25 @@
 
 #include "xenia/cpu/processor.h"
 
+#include <algorithm>
+
 #include "xenia/base/assert.h"
 #include "xenia/base/atomic.h"
 #include "xenia/base/byte_order.h"
 #include "xenia/base/byte_stream.h"
+#include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
 #include "xenia/base/debugging.h"
 #include "xenia/base/exception_handler.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/memory.h"
 #include "xenia/base/platform.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/startup_timeline.h"
 #include "xenia/base/threading.h"
+#include "xenia/base/threading_job_system.h"
 #include "xenia/cpu/breakpoint.h"
 #include "xenia/cpu/cpu_flags.h"
 #include "xenia/cpu/export_resolver.h"
@@ -86,9 +92,29 @@ Processor::Processor(xe::Memory* memory, ExportResolver* export_resolver)
     : memory_(memory), export_resolver_(export_resolver) {}
 
 Processor::~Processor() {
+  if (write_unprotect_callback_handle_) {
+    memory_->UnregisterWriteUnprotectCallback(write_unprotect_callback_handle_);
+    write_unprotect_callback_handle_ = nullptr;
+  }
+
+  // Translation jobs use the modules, finish the running ones.
+  compilation_pool_.reset();
+
+  if (tier_up_thread_) {
+    {
+      std::lock_guard<std::mutex> lock(tier_up_request_lock_);
+      tier_up_thread_shutdown_ = true;
+    }
+    tier_up_request_cond_.notify_all();
+    xe::threading::Wait(tier_up_thread_.get(), false);
+    tier_up_thread_.reset();
+  }
+  tier_up_queue_.clear();
+
   {
     auto global_lock = global_critical_region_.Acquire();
     modules_.clear();
+    tier_up_retired_modules_.clear();
   }
 
   frontend_.reset();
@@ -101,6 +127,7 @@ Processor::~Processor() {
 }
 
 bool Processor::Setup(std::unique_ptr<backend::Backend> backend) {
+  StartupTimelinePhase startup_phase("Processor::Setup");
   // TODO(benvanik): query mode from debugger?
   debug_info_flags_ = 0;
 
@@ -154,6 +181,27 @@ bool Processor::Setup(std::unique_ptr<backend::Backend> backend) {
         ChunkedMappedMemoryWriter::Open(functions_trace_path_, 32_MiB, true);
   }
 
+  int32_t compilation_threads = cvars::compilation_threads;
+  if (compilation_threads < 0) {
+    compilation_threads =
+        int32_t(xe::threading::JobSystem::Get().worker_count());
+  }
+  if (compilation_threads) {
+    compilation_pool_ =
+        std::make_unique<CompilationPool>(size_t(compilation_threads));
+  }
+
+  if (cvars::tiered_compilation || cvars::retranslate_on_mmio_access) {
+    tier_up_thread_shutdown_ = false;
+    tier_up_thread_ =
+        xe::threading::Thread::Create({}, [this]() { TierUpThread(); });
+    assert_not_null(tier_up_thread_);
+    tier_up_thread_->set_name("CPU Tier-Up");
+  }
+
+  write_unprotect_callback_handle_ = memory_->RegisterWriteUnprotectCallback(
+      WriteUnprotectCallbackThunk, this);
+
   return true;
 }
 
@@ -179,20 +227,38 @@ void Processor::RemoveModule(const std::string_view name) {
   auto global_lock = global_critical_region_.Acquire();
 
   auto itr =
-      std::find_if(modules_.cbegin(), modules_.cend(),
+      std::find_if(modules_.begin(), modules_.end(),
                    [name](std::unique_ptr<xe::cpu::Module> const& module) {
                      return module->name() == name;
                    });
 
-  if (itr != modules_.cend()) {
+  if (itr != modules_.end()) {
     const std::vector<uint32_t> addressed_functions =
         (*itr)->GetAddressedFunctions();
 
+    std::unique_ptr<Module> module = std::move(*itr);
     modules_.erase(itr);
+    DiscardModuleTierUps(module);
+
+    for (auto it = folded_loads_.begin(); it != folded_loads_.end();) {
+      if (it->second->module() == module.get()) {
+        it = folded_loads_.erase(it);
+      } else {
+        ++it;
+      }
+    }
 
     for (const uint32_t entry : addressed_functions) {
       RemoveFunctionByAddress(entry);
     }
+
+    // If one of the functions is being retranslated, the code is retired once
+    // the retranslation is done, as it installs the new code.
+    if (module) {
+      backend_->RetireModuleCode(module.get());
+      module.reset();
+      ReclaimCodeSpace();
+    }
   }
 }
 
@@ -208,7 +274,8 @@ Module* Processor::GetModule(const std::string_view name) {
 
 std::vector<Module*> Processor::GetModules() {
   auto global_lock = global_critical_region_.Acquire();
-  std::vector<Module*> clone(modules_.size());
+  std::vector<Module*> clone;
+  clone.reserve(modules_.size());
   for (const auto& module : modules_) {
     clone.push_back(module.get());
   }
@@ -249,6 +316,142 @@ void Processor::RemoveFunctionByAddress(uint32_t address) {
   entry_table_.Delete(address);
 }
 
+std::vector<GuestFunction*> Processor::RetranslateFunctionsInRanges(
+    const std::vector<std::pair<uint32_t, uint32_t>>& ranges) {
+  std::vector<GuestFunction*> functions;
+  for (const std::pair<uint32_t, uint32_t>& range : ranges) {
+    for (Function* function :
+         entry_table_.FindWithRange(range.first, range.second)) {
+      if (!function->is_guest()) {
+        continue;
+      }
+      auto guest_function = static_cast<GuestFunction*>(function);
+      if (std::find(functions.cbegin(), functions.cend(), guest_function) ==
+          functions.cend()) {
+        functions.push_back(guest_function);
+      }
+    }
+  }
+  if (functions.empty()) {
+    return functions;
+  }
+  if (!tier_up_thread_) {
+    XELOGW(
+        "{} translated functions have been modified, but can't be "
+        "retranslated without tiered_compilation or "
+        "retranslate_on_mmio_access",
+        functions.size());
+    return functions;
+  }
+  for (GuestFunction* function : functions) {
+    RequestFunctionTierUp(function);
+  }
+  return functions;
+}
+
+bool Processor::DumpJitStatistics(const std::filesystem::path& path) {
+  FILE* file = xe::filesystem::OpenFile(path, "w");
+  if (!file) {
+    XELOGE("Failed to open {} for writing JIT statistics",
+           xe::path_to_utf8(path));
+    return false;
+  }
+  bool json = path.extension() == ".json";
+  double ticks_to_us =
+      1000000.0 / static_cast<double>(Clock::QueryHostTickFrequency());
+  if (json) {
+    fputs("[\n", file);
+  } else {
+    fputs(
+        "module,address,end_address,name,translations,"
+        "raw_hir_instructions,hir_instructions,code_size,sampled_calls,"
+        "hir_build_us,passes_us,assembly_us,"
+        "previous_translations_us,hir_arena_bytes,hir_allocations,"
+        "scratch_arena_bytes,scratch_allocations\n",
+        file);
+  }
+  size_t function_count = 0;
+  for (Module* module : GetModules()) {
+    module->ForEachFunction([&](Function* function) {
+      if (!function->is_guest()) {
+        return;
+      }
+      auto guest_function = static_cast<GuestFunction*>(function);
+      FunctionCompilationStatistics statistics =
+          guest_function->compilation_statistics();
+      if (!statistics.translation_count) {
+        return;
+      }
+      uint64_t pass_ticks = 0;
+      for (const FunctionCompilationStatistics::PassTime& pass_time :
+           statistics.pass_ticks) {
+        pass_ticks += pass_time.ticks;
+      }
+      if (json) {
+        fprintf(file,
+                "%s  {\"module\": \"%s\", \"address\": %u, "
+                "\"end_address\": %u, \"name\": \"%s\", "
+                "\"translations\": %u, \"raw_hir_instructions\": %u, "
+                "\"hir_instructions\": %u, "
+                "\"code_size\": %u, \"sampled_calls\": %llu, "
+                "\"hir_build_us\": %.3f, \"assembly_us\": %.3f, "
+                "\"previous_translations_us\": %.3f, "
+                "\"hir_arena_bytes\": %u, \"hir_allocations\": %u, "
+                "\"scratch_arena_bytes\": %u, \"scratch_allocations\": %u, "
+                "\"passes_us\": {",
+                function_count ? ",\n" : "", module->name().c_str(),
+                function->address(), function->end_address(),
+                function->name().c_str(), statistics.translation_count,
+                statistics.raw_hir_instruction_count,
+                statistics.hir_instruction_count,
+                statistics.machine_code_length,
+                static_cast<unsigned long long>(
+                    guest_function->sampled_call_count()),
+                statistics.hir_build_ticks * ticks_to_us,
+                statistics.assembly_ticks * ticks_to_us,
+                statistics.previous_translations_ticks * ticks_to_us,
+                statistics.hir_arena_size, statistics.hir_allocation_count,
+                statistics.scratch_arena_peak_size,
+                statistics.scratch_allocation_count);
+        for (size_t i = 0; i < statistics.pass_ticks.size(); ++i) {
+          const FunctionCompilationStatistics::PassTime& pass_time =
+              statistics.pass_ticks[i];
+          fprintf(file, "%s\"%s\": %.3f", i ? ", " : "", pass_time.pass_name,
+                  pass_time.ticks * ticks_to_us);
+        }
+        fputs("}}", file);
+      } else {
+        fprintf(file,
+                "%s,%08X,%08X,%s,%u,%u,%u,%u,%llu,%.3f,%.3f,%.3f,%.3f,%u,%u,"
+                "%u,%u\n",
+                module->name().c_str(), function->address(),
+                function->end_address(), function->name().c_str(),
+                statistics.translation_count,
+                statistics.raw_hir_instruction_count,
+                statistics.hir_instruction_count,
+                statistics.machine_code_length,
+                static_cast<unsigned long long>(
+                    guest_function->sampled_call_count()),
+                statistics.hir_build_ticks * ticks_to_us,
+                pass_ticks * ticks_to_us,
+                statistics.assembly_ticks * ticks_to_us,
+                statistics.previous_translations_ticks * ticks_to_us,
+                statistics.hir_arena_size, statistics.hir_allocation_count,
+                statistics.scratch_arena_peak_size,
+                statistics.scratch_allocation_count);
+      }
+      ++function_count;
+    });
+  }
+  if (json) {
+    fputs("\n]\n", file);
+  }
+  fclose(file);
+  XELOGI("Wrote JIT statistics of {} functions to {}", function_count,
+         xe::path_to_utf8(path));
+  return true;
+}
+
 Function* Processor::ResolveFunction(uint32_t address) {
   Entry* entry;
   Entry::Status status = entry_table_.GetOrCreate(address, &entry);
@@ -290,6 +493,51 @@ Function* Processor::ResolveFunction(uint32_t address) {
     return nullptr;
   }
 }
+
+void Processor::PrecompileFunction(uint32_t address) {
+  if (!compilation_pool_) {
+    ResolveFunction(address);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(precompile_requests_lock_);
+    if (!precompile_requests_.insert(address).second) {
+      return;
+    }
+  }
+  // If a guest thread reaches the function before the job is started, the
+  // guest thread translates it, and the job finds it ready. If the job is
+  // already running, the guest thread waits for the entry to become ready.
+  compilation_pool_->Submit([this, address]() { ResolveFunction(address); });
+}
+
+size_t Processor::GetPendingCompilationCount() {
+  size_t count =
+      compilation_pool_ ? compilation_pool_->GetPendingJobCount() : 0;
+  std::lock_guard<std::mutex> lock(tier_up_request_lock_);
+  return count + tier_up_queue_.size() + (tier_up_function_ ? 1 : 0);
+}
+
+void Processor::PrecompileCallTargets(GuestFunction* function) {
+  Module* module = function->module();
+  uint32_t function_address = function->address();
+  uint32_t function_end_address = function->end_address();
+  xe::cpu::ppc::PPCDecodeData d;
+  for (d.address = function_address; d.address <= function_end_address;
+       d.address += 4) {
+    d.code = xe::load_and_swap<uint32_t>(memory_->TranslateVirtual(d.address));
+    if (xe::cpu::ppc::LookupOpcode(d.code) != PPCOpcode::bx) {
+      continue;
+    }
+    // b/ba/bl/bla - branches within the function are to its own blocks.
+    uint32_t target = d.I.ADDR();
+    if ((target >= function_address && target <= function_end_address) ||
+        !module->ContainsAddress(target)) {
+      continue;
+    }
+    PrecompileFunction(target);
+  }
+}
 Module* Processor::LookupModule(uint32_t address) {
   auto global_lock = global_critical_region_.Acquire();
   // TODO(benvanik): sort by code address (if contiguous) so can bsearch.
@@ -351,6 +599,10 @@ bool Processor::DemandFunction(Function* function) {
 
     function->set_status(Symbol::Status::kDefined);
     symbol_status = function->status();
+
+    if (compilation_pool_) {
+      PrecompileCallTargets(static_cast<GuestFunction*>(function));
+    }
   }
 
   if (symbol_status == Symbol::Status::kFailed) {
@@ -465,6 +717,201 @@ uint8_t* Processor::AllocateFunctionTraceData(size_t size) {
   return functions_trace_file_->Allocate(size);
 }
 
+void Processor::RequestFunctionTierUp(GuestFunction* function) {
+  {
+    std::lock_guard<std::mutex> lock(tier_up_request_lock_);
+    if (!tier_up_thread_ || tier_up_thread_shutdown_) {
+      return;
+    }
+    tier_up_queue_.push_back(function);
+  }
+  tier_up_request_cond_.notify_one();
+}
+
+void Processor::RegisterFoldedLoads(GuestFunction* function,
+                                    const std::vector<uint32_t>& addresses) {
+  if (addresses.empty()) {
+    return;
+  }
+  auto global_lock = global_critical_region_.Acquire();
+  // The memory may have been made writable after the loads were folded.
+  bool made_writable = false;
+  for (uint32_t address : addresses) {
+    BaseHeap* heap = memory_->LookupHeap(address);
+    uint32_t protect;
+    if (!heap || !heap->QueryProtect(address, &protect) ||
+        (protect & kMemoryProtectWrite)) {
+      made_writable = true;
+      continue;
+    }
+    auto range = folded_loads_.equal_range(address);
+    if (std::find_if(range.first, range.second, [function](const auto& entry) {
+          return entry.second == function;
+        }) == range.second) {
+      folded_loads_.emplace(address, function);
+    }
+  }
+  if (made_writable) {
+    RequestFunctionTierUp(function);
+  }
+}
+
+void Processor::WriteUnprotectCallbackThunk(void* context_ptr,
+                                            uint32_t address,
+                                            uint32_t length) {
+  reinterpret_cast<Processor*>(context_ptr)->OnWriteUnprotect(address, length);
+}
+
+void Processor::OnWriteUnprotect(uint32_t address, uint32_t length) {
+  auto global_lock = global_critical_region_.Acquire();
+  auto it = folded_loads_.lower_bound(address);
+  if (it == folded_loads_.end() || it->first - address >= length) {
+    return;
+  }
+  std::vector<GuestFunction*> functions;
+  while (it != folded_loads_.end() && it->first - address < length) {
+    if (std::find(functions.cbegin(), functions.cend(), it->second) ==
+        functions.cend()) {
+      functions.push_back(it->second);
+    }
+    it = folded_loads_.erase(it);
+  }
+  if (!tier_up_thread_) {
+    XELOGW(
+        "{} functions have folded loads from {:08X}-{:08X} made writable, but "
+        "can't be retranslated",
+        functions.size(), address, address + (length - 1));
+    return;
+  }
+  XELOGD(
+      "Retranslating {} functions with folded loads from {:08X}-{:08X} made "
+      "writable",
+      functions.size(), address, address + (length - 1));
+  for (GuestFunction* function : functions) {
+    RequestFunctionTierUp(function);
+  }
+}
+
+void Processor::TierUpThread() {
+  while (true) {
+    GuestFunction* function;
+    {
+      std::unique_lock<std::mutex> lock(tier_up_request_lock_);
+      tier_up_request_cond_.wait(lock, [this]() {
+        return tier_up_thread_shutdown_ || !tier_up_queue_.empty();
+      });
+      if (tier_up_thread_shutdown_) {
+        return;
+      }
+      function = tier_up_queue_.front();
+      tier_up_queue_.pop_front();
+      tier_up_function_ = function;
+    }
+
+    if (frontend_->TierUpFunction(function)) {
+      // Breakpoints need to be installed in the new code.
+      OnFunctionDefined(function);
+    } else {
+      XELOGW("Failed to retranslate function {:08X} with all optimizations",
+             function->address());
+    }
+
+    std::vector<std::unique_ptr<Module>> retired_modules;
+    {
+      std::lock_guard<std::mutex> lock(tier_up_request_lock_);
+      tier_up_function_ = nullptr;
+      retired_modules.swap(tier_up_retired_modules_);
+    }
+    if (!retired_modules.empty()) {
+      auto global_lock = global_critical_region_.Acquire();
+      for (const std::unique_ptr<Module>& module : retired_modules) {
+        backend_->RetireModuleCode(module.get());
+      }
+      retired_modules.clear();
+    }
+
+    if (cvars::code_reclamation_threshold &&
+        backend_->GetRetiredCodeCount() >= cvars::code_reclamation_threshold) {
+      ReclaimCodeSpace();
+    }
+  }
+}
+
+void Processor::ReclaimCodeSpace() {
+  if (!stack_walker_ || !cvars::code_reclamation_threshold) {
+    return;
+  }
+  auto global_lock = global_critical_region_.Acquire();
+  size_t retired_count = backend_->GetRetiredCodeCount();
+  if (!retired_count) {
+    return;
+  }
+
+  // Collect everything that may point into the generated code that threads
+  // will return to or continue executing - the return addresses on the stacks,
+  // and the registers of the top frames, as a thread may be suspended in a
+  // prolog or between calls. If any stack can't be walked completely, nothing
+  // is reclaimed.
+  constexpr size_t kMaxFrames = 256;
+  uint64_t frame_host_pcs[kMaxFrames];
+  std::vector<uint64_t> live_addresses;
+  live_addresses.reserve(kMaxFrames * (thread_debug_infos_.size() + 1));
+  size_t count = stack_walker_->CaptureStackTrace(frame_host_pcs, 0,
+                                                  kMaxFrames);
+  if (!count || count >= kMaxFrames) {
+    return;
+  }
+  live_addresses.insert(live_addresses.end(), frame_host_pcs,
+                        frame_host_pcs + count);
+  for (const auto& it : thread_debug_infos_) {
+    ThreadDebugInfo* thread_info = it.second.get();
+    if ((thread_info->state != ThreadDebugInfo::State::kAlive &&
+         thread_info->state != ThreadDebugInfo::State::kWaiting) ||
+        !thread_info->thread ||
+        thread_info->thread == Thread::GetCurrentThread()) {
+      continue;
+    }
+    // Only the stack and the registers are needed, so the thread doesn't have
+    // to be stepped to a guest safe point.
+    xe::threading::Thread* host_thread = thread_info->thread->thread();
+    if (!host_thread->Suspend()) {
+      return;
+    }
+    HostThreadContext host_context;
+    count = stack_walker_->CaptureStackTrace(
+        host_thread->native_handle(), frame_host_pcs, 0, kMaxFrames, nullptr,
+        &host_context);
+    host_thread->Resume();
+    if (!count || count >= kMaxFrames) {
+      return;
+    }
+    live_addresses.insert(live_addresses.end(), frame_host_pcs,
+                          frame_host_pcs + count);
+#if XE_ARCH_AMD64
+    live_addresses.push_back(host_context.rip);
+    live_addresses.insert(live_addresses.end(),
+                          std::begin(host_context.int_registers),
+                          std::end(host_context.int_registers));
+#endif  // XE_ARCH_AMD64
+  }
+
+  backend_->ReclaimRetiredCode(retired_count, live_addresses);
+}
+
+void Processor::DiscardModuleTierUps(std::unique_ptr<Module>& module) {
+  std::lock_guard<std::mutex> lock(tier_up_request_lock_);
+  Module* module_ptr = module.get();
+  tier_up_queue_.erase(
+      std::remove_if(tier_up_queue_.begin(), tier_up_queue_.end(),
+                     [module_ptr](GuestFunction* function) {
+                       return function->module() == module_ptr;
+                     }),
+      tier_up_queue_.end());
+  if (tier_up_function_ && tier_up_function_->module() == module_ptr) {
+    tier_up_retired_modules_.push_back(std::move(module));
+  }
+}
+
 void Processor::OnFunctionDefined(Function* function) {
   auto global_lock = global_critical_region_.Acquire();
   for (auto breakpoint : breakpoints_) {
@@ -542,6 +989,48 @@ ThreadDebugInfo* Processor::QueryThreadDebugInfo(uint32_t thread_id) {
   return it->second.get();
 }
 
+bool Processor::CaptureThreadStacks(
+    std::vector<ThreadStackSample>* out_samples) {
+  out_samples->clear();
+  if (!stack_walker_) {
+    return false;
+  }
+  auto global_lock = global_critical_region_.Acquire();
+  if (execution_state_ != ExecutionState::kRunning) {
+    return true;
+  }
+  // Not allocating while a thread is suspended, as it may be holding the lock
+  // of the heap.
+  out_samples->reserve(thread_debug_infos_.size());
+  for (auto& it : thread_debug_infos_) {
+    ThreadDebugInfo* thread_info = it.second.get();
+    Thread* thread = thread_info->thread;
+    if (!thread || thread_info->suspended ||
+        thread_info->state != ThreadDebugInfo::State::kAlive ||
+        !thread->can_debugger_suspend()) {
+      continue;
+    }
+    if (Thread::IsInThread() &&
+        thread_info->thread_id == Thread::GetCurrentThreadId()) {
+      continue;
+    }
+    xe::threading::Thread* host_thread = thread->thread();
+    if (!host_thread->Suspend()) {
+      continue;
+    }
+    ThreadStackSample& sample = out_samples->emplace_back();
+    sample.thread_id = thread_info->thread_id;
+    sample.frame_count = stack_walker_->CaptureStackTrace(
+        host_thread->native_handle(), sample.frame_host_pcs, 0,
+        ThreadStackSample::kMaxFrameCount, nullptr, nullptr);
+    host_thread->Resume();
+    if (!sample.frame_count) {
+      out_samples->pop_back();
+    }
+  }
+  return true;
+}
+
 void Processor::AddBreakpoint(Breakpoint* breakpoint) {
   auto global_lock = global_critical_region_.Acquire();
 
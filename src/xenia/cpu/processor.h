@@ -10,15 +10,21 @@
 #ifndef XENIA_CPU_PROCESSOR_H_
 #define XENIA_CPU_PROCESSOR_H_
 
+#include <condition_variable>
+#include <deque>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include "xenia/base/cvar.h"
 #include "xenia/base/mapped_memory.h"
 #include "xenia/base/mutex.h"
+#include "xenia/base/threading.h"
 #include "xenia/cpu/backend/backend.h"
+#include "xenia/cpu/compilation_pool.h"
 #include "xenia/cpu/debug_listener.h"
 #include "xenia/cpu/entry_table.h"
 #include "xenia/cpu/export_resolver.h"
@@ -61,6 +67,15 @@ enum class ExecutionState {
   kEnded,
 };
 
+// Host call stack of a running guest thread, captured for sampling profilers.
+struct ThreadStackSample {
+  static constexpr size_t kMaxFrameCount = 64;
+  uint32_t thread_id;
+  // From the innermost frame.
+  size_t frame_count;
+  uint64_t frame_host_pcs[kMaxFrameCount];
+};
+
 class Processor {
  public:
   Processor(Memory* memory, ExportResolver* export_resolver);
@@ -113,11 +128,26 @@ class Processor {
   Function* QueryFunction(uint32_t address);
   std::vector<Function*> FindFunctionsWithAddress(uint32_t address);
   void RemoveFunctionByAddress(uint32_t address);
+  // Queues retranslation of the translated guest functions with code in the
+  // <address, length> ranges, such as after it has been patched, in the
+  // background. Returns the functions found.
+  std::vector<GuestFunction*> RetranslateFunctionsInRanges(
+      const std::vector<std::pair<uint32_t, uint32_t>>& ranges);
+
+  // Writes the compilation statistics of the translated guest functions, as
+  // JSON if the path has the .json extension, or as CSV otherwise.
+  bool DumpJitStatistics(const std::filesystem::path& path);
 
   Function* LookupFunction(uint32_t address);
   Module* LookupModule(uint32_t address);
   Function* LookupFunction(Module* module, uint32_t address);
   Function* ResolveFunction(uint32_t address);
+  // Translates the function at the address ahead of its execution, in the
+  // background if the compilation pool is enabled, or immediately otherwise.
+  void PrecompileFunction(uint32_t address);
+  // Functions queued for precompilation or for the tier-up retranslation and
+  // not translated yet, the backlog of the background compilation.
+  size_t GetPendingCompilationCount();
 
   bool Execute(ThreadState* thread_state, uint32_t address);
   bool ExecuteRaw(ThreadState* thread_state, uint32_t address);
@@ -135,6 +165,12 @@ class Processor {
   // Returns the debugger info for the given thread.
   ThreadDebugInfo* QueryThreadDebugInfo(uint32_t thread_id);
 
+  // Briefly suspends the running guest threads one by one to capture their
+  // host call stacks, for sampling profilers. Threads that are waiting or
+  // paused by the debugger are skipped. Returns false if the call stacks can't
+  // be captured on the host.
+  bool CaptureThreadStacks(std::vector<ThreadStackSample>* out_samples);
+
   // Adds a breakpoint to the debugger and activates it (if enabled).
   // The given breakpoint will not be owned by the debugger and must remain
   // allocated so long as it is added.
@@ -211,6 +247,22 @@ class Processor {
 
   uint8_t* AllocateFunctionTraceData(size_t size);
 
+  // Queues retranslation of a function with all optimizations. Called by the
+  // baseline code once the function is hot, and by the backend when something
+  // it translates differently has been discovered about the function.
+  void RequestFunctionTierUp(GuestFunction* function);
+
+  // Records the guest addresses of the loads from read-only memory folded into
+  // constants in the code of the function, so it's retranslated if the memory
+  // is made writable.
+  void RegisterFoldedLoads(GuestFunction* function,
+                           const std::vector<uint32_t>& addresses);
+
+  // Reuses the space of the generated code that can't be reached anymore, such
+  // as the code of removed modules and baseline code replaced by optimized
+  // code, once no thread is running it.
+  void ReclaimCodeSpace();
+
  private:
   // Synchronously demands a debug listener.
   void DemandDebugListener();
@@ -248,6 +300,17 @@ class Processor {
                                          uint32_t current_pc);
 
   bool DemandFunction(Function* function);
+  // Queues precompilation of the functions the function calls or branches to.
+  void PrecompileCallTargets(GuestFunction* function);
+
+  void TierUpThread();
+  // Drops pending tier-ups of functions of a module being removed, taking the
+  // ownership of the module if one of its functions is being retranslated.
+  void DiscardModuleTierUps(std::unique_ptr<Module>& module);
+
+  static void WriteUnprotectCallbackThunk(void* context_ptr, uint32_t address,
+                                          uint32_t length);
+  void OnWriteUnprotect(uint32_t address, uint32_t length);
 
   Memory* memory_ = nullptr;
   std::unique_ptr<StackWalker> stack_walker_;
@@ -279,6 +342,29 @@ class Processor {
   // TODO(benvanik): cleanup/change structures.
   std::vector<Breakpoint*> breakpoints_;
 
+  std::unique_ptr<CompilationPool> compilation_pool_;
+  // Addresses ever queued for precompilation, so functions also reachable from
+  // other functions are only queued once.
+  std::mutex precompile_requests_lock_;
+  std::unordered_set<uint32_t> precompile_requests_;
+
+  // Tier-up thread input is protected with tier_up_request_lock_, and the
+  // thread is notified about its change via tier_up_request_cond_.
+  std::mutex tier_up_request_lock_;
+  std::condition_variable tier_up_request_cond_;
+  std::deque<GuestFunction*> tier_up_queue_;
+  bool tier_up_thread_shutdown_ = false;
+  // Function being retranslated by the tier-up thread, and removed modules to
+  // destroy once it's done, protected with tier_up_request_lock_.
+  GuestFunction* tier_up_function_ = nullptr;
+  std::vector<std::unique_ptr<Module>> tier_up_retired_modules_;
+  std::unique_ptr<xe::threading::Thread> tier_up_thread_;
+
+  // Guest addresses of the loads folded into constants, to the functions with
+  // them in their code, protected with the global lock.
+  std::multimap<uint32_t, GuestFunction*> folded_loads_;
+  void* write_unprotect_callback_handle_ = nullptr;
+
   Irql irql_;
 };
 
@@ -51,6 +51,10 @@ struct StackFrame {
     // Contains symbol information for kGuest frames.
     struct {
       Function* function;
+      // Set if guest_pc is in the code of a function inlined into function, to
+      // it and the address of the call it replaced.
+      Function* inlined_function;
+      uint32_t inlined_call_pc;
     } guest_symbol;
   };
 };
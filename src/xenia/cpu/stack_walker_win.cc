@@ -247,6 +247,13 @@ class Win32StackWalker : public StackWalker {
             // a call).
             frame.guest_pc =
                 guest_function->MapMachineCodeToGuestAddress(frame.host_pc);
+            auto inlined_function =
+                guest_function->LookupInlinedFunction(frame.guest_pc);
+            if (inlined_function) {
+              frame.guest_symbol.inlined_function = inlined_function->function;
+              frame.guest_symbol.inlined_call_pc =
+                  inlined_function->call_address;
+            }
           }
         } else {
           frame.guest_symbol.function = nullptr;
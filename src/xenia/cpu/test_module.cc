@@ -95,7 +95,8 @@ Symbol::Status TestModule::DeclareFunction(uint32_t address,
     compiler_->Compile(builder_.get());
 
     // Assemble the function.
-    assembler_->Assemble(function, builder_.get(), 0, nullptr);
+    assembler_->Assemble(function, builder_.get(), 0, nullptr,
+                         backend::CompilationTier::kOptimized);
 
     status = Symbol::Status::kDefined;
     function->set_status(status);
@@ -0,0 +1,66 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/entry_table.h"
+
+#include "third_party/catch/include/catch.hpp"
+
+using namespace xe::cpu;
+
+TEST_CASE("ENTRY_TABLE_CREATE_AND_DELETE", "[entry_table]") {
+  EntryTable table;
+  constexpr uint32_t kBase = 0x82000000;
+  // More than the initial capacity of the tables, to grow them.
+  constexpr uint32_t kCount = 8192;
+  for (uint32_t i = 0; i < kCount; ++i) {
+    Entry* entry;
+    REQUIRE(table.GetOrCreate(kBase + i * 4, &entry) == Entry::STATUS_NEW);
+    REQUIRE(entry->address == kBase + i * 4);
+    REQUIRE(table.Get(kBase + i * 4) == nullptr);
+    entry->end_address = kBase + i * 4;
+    entry->status = Entry::STATUS_READY;
+  }
+  for (uint32_t i = 0; i < kCount; i += 2) {
+    table.Delete(kBase + i * 4);
+  }
+  for (uint32_t i = 0; i < kCount; ++i) {
+    Entry* entry = table.Get(kBase + i * 4);
+    if (i & 1) {
+      REQUIRE(entry != nullptr);
+      REQUIRE(entry->address == kBase + i * 4);
+    } else {
+      REQUIRE(entry == nullptr);
+    }
+  }
+
+  Entry* entry;
+  REQUIRE(table.GetOrCreate(kBase + 4, &entry) == Entry::STATUS_READY);
+  REQUIRE(entry->address == kBase + 4);
+  REQUIRE(table.GetOrCreate(kBase, &entry) == Entry::STATUS_NEW);
+  entry->status = Entry::STATUS_FAILED;
+  REQUIRE(table.GetOrCreate(kBase, &entry) == Entry::STATUS_FAILED);
+  REQUIRE(table.FindWithAddress(kBase + 4).size() == 1);
+}
+
+TEST_CASE("ENTRY_TABLE_FIND_WITH_RANGE", "[entry_table]") {
+  EntryTable table;
+  // Functions of 16 bytes each, the last one not ready.
+  for (uint32_t i = 0; i < 4; ++i) {
+    Entry* entry;
+    table.GetOrCreate(0x82000000 + i * 16, &entry);
+    entry->end_address = 0x82000000 + i * 16 + 12;
+    entry->status = i < 3 ? Entry::STATUS_READY : Entry::STATUS_NEW;
+  }
+  REQUIRE(table.FindWithRange(0x82000000, 0).empty());
+  REQUIRE(table.FindWithRange(0x82000000, 4).size() == 1);
+  // The last instruction of the first function and the first of the second.
+  REQUIRE(table.FindWithRange(0x8200000C, 8).size() == 2);
+  REQUIRE(table.FindWithRange(0x81FFFFF0, 0x100).size() == 3);
+  REQUIRE(table.FindWithRange(0x82000030, 16).empty());
+}
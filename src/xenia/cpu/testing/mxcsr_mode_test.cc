@@ -0,0 +1,80 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/testing/util.h"
+
+#include <limits>
+
+using namespace xe;
+using namespace xe::cpu;
+using namespace xe::cpu::hir;
+using namespace xe::cpu::testing;
+using xe::cpu::ppc::PPCContext;
+
+// Denormals are kept by the FPU, but treated as zero by VMX.
+TEST_CASE("MXCSR_MODE_ACROSS_BLOCKS", "[instr]") {
+  TestFunction test([](HIRBuilder& b) {
+    auto vmx_label = b.NewLabel();
+    auto join_label = b.NewLabel();
+    StoreVR(b, 3, b.VectorAdd(LoadVR(b, 4), LoadVR(b, 5), FLOAT32_TYPE));
+    b.BranchTrue(LoadGPR(b, 4), vmx_label);
+    StoreFPR(b, 3, b.Add(LoadFPR(b, 4), LoadFPR(b, 5)));
+    b.Branch(join_label);
+    b.MarkLabel(vmx_label);
+    StoreVR(b, 6, b.VectorAdd(LoadVR(b, 4), LoadVR(b, 5), FLOAT32_TYPE));
+    b.MarkLabel(join_label);
+    StoreFPR(b, 6, b.Add(LoadFPR(b, 4), LoadFPR(b, 5)));
+    b.Return();
+  });
+  for (uint64_t take_vmx_path = 0; take_vmx_path <= 1; ++take_vmx_path) {
+    test.Run(
+        [take_vmx_path](PPCContext* ctx) {
+          ctx->r[4] = take_vmx_path;
+          ctx->f[4] = std::numeric_limits<double>::denorm_min();
+          ctx->f[5] = 0.0;
+          ctx->v[4] = vec128f(1.0f);
+          ctx->v[5] = vec128f(std::numeric_limits<float>::denorm_min());
+        },
+        [take_vmx_path](PPCContext* ctx) {
+          REQUIRE(ctx->v[3] == vec128f(1.0f));
+          if (take_vmx_path) {
+            REQUIRE(ctx->v[6] == vec128f(1.0f));
+          } else {
+            REQUIRE(ctx->f[3] == std::numeric_limits<double>::denorm_min());
+          }
+          REQUIRE(ctx->f[6] == std::numeric_limits<double>::denorm_min());
+        });
+  }
+}
+
+TEST_CASE("MXCSR_MODE_IN_LOOP", "[instr]") {
+  TestFunction test([](HIRBuilder& b) {
+    auto loop_label = b.NewLabel();
+    b.MarkLabel(loop_label);
+    StoreFPR(b, 3, b.Add(LoadFPR(b, 4), LoadFPR(b, 5)));
+    StoreVR(b, 3, b.VectorAdd(LoadVR(b, 4), LoadVR(b, 5), FLOAT32_TYPE));
+    auto counter = b.Sub(LoadGPR(b, 4), b.LoadConstantInt64(1));
+    StoreGPR(b, 4, counter);
+    b.BranchTrue(counter, loop_label);
+    b.Return();
+  });
+  test.Run(
+      [](PPCContext* ctx) {
+        ctx->r[4] = 3;
+        ctx->f[4] = std::numeric_limits<double>::denorm_min();
+        ctx->f[5] = 0.0;
+        ctx->v[4] = vec128f(1.0f);
+        ctx->v[5] = vec128f(0.0f);
+      },
+      [](PPCContext* ctx) {
+        REQUIRE(ctx->r[4] == 0);
+        REQUIRE(ctx->f[3] == std::numeric_limits<double>::denorm_min());
+        REQUIRE(ctx->v[3] == vec128f(1.0f));
+      });
+}
@@ -10,14 +10,24 @@
 #include "xenia/cpu/xex_module.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <sstream>
 
 #include "third_party/fmt/include/fmt/format.h"
 
 #include "xenia/base/byte_order.h"
+#include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/memory.h"
+#include "xenia/base/startup_timeline.h"
+#include "xenia/base/threading.h"
+#include "xenia/base/xxhash.h"
 
 #include "xenia/cpu/cpu_flags.h"
 #include "xenia/cpu/export_resolver.h"
@@ -48,6 +58,23 @@ DEFINE_bool(
     "finding/stress testing with the JIT",
     "CPU");
 
+DEFINE_path(
+    memory_routine_signatures, "",
+    "File with the code of statically linked memory and CRT string routines "
+    "to replace with host implementations. Each line is the routine (memcpy, "
+    "memmove, memset, memcmp, XMemCpy, XMemSet, sprintf, _snprintf, vsprintf, "
+    "_vsnprintf, swprintf, _snwprintf, vswprintf, _vsnwprintf, _vscwprintf, "
+    "atof, strtod, atoi, atol, strtol or strtoul) followed by its first "
+    "instructions as 8 hex digits, or ???????? for instructions that differ "
+    "between titles, such as relative branches.",
+    "CPU");
+
+DEFINE_bool(xex_image_cache, true,
+            "Store the decrypted, decompressed and patched images of the "
+            "loaded XEX modules in the cache, and load them from it on the "
+            "next boot instead of processing the XEX again.",
+            "CPU");
+
 DECLARE_bool(allow_plugins);
 
 static const uint8_t xe_xex2_retail_key[16] = {
@@ -57,9 +84,44 @@ static const uint8_t xe_xex2_devkit_key[16] = {
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 
+using xe::threading::ParallelFor;
+
+static double GetElapsedMilliseconds(uint64_t start_host_ticks) {
+  return double(xe::Clock::QueryHostTickCount() - start_host_ticks) * 1000.0 /
+         double(xe::Clock::QueryHostTickFrequency());
+}
+
 void aes_decrypt_buffer(const uint8_t* session_key, const uint8_t* input_buffer,
                         const size_t input_size, uint8_t* output_buffer,
                         const size_t output_size) {
+  // CBC decryption only depends on the previous ciphertext block, so large
+  // buffers are split into chunks decrypted on multiple threads.
+  constexpr size_t kChunkSize = 1024 * 1024;
+  if (input_size > kChunkSize && input_buffer != output_buffer) {
+    ParallelFor(
+        (input_size + kChunkSize - 1) / kChunkSize, "XEX Decryption",
+        [&](size_t chunk_index) {
+          size_t chunk_offset = chunk_index * kChunkSize;
+          size_t chunk_size = std::min(kChunkSize, input_size - chunk_offset);
+          uint8_t ivec[16] = {0};
+          if (chunk_offset) {
+            std::memcpy(ivec, input_buffer + chunk_offset - 16, 16);
+          }
+          uint32_t rk[4 * (MAXNR + 1)];
+          int32_t Nr = rijndaelKeySetupDec(rk, session_key, 128);
+          const uint8_t* ct = input_buffer + chunk_offset;
+          uint8_t* pt = output_buffer + chunk_offset;
+          for (size_t n = 0; n < chunk_size; n += 16, ct += 16, pt += 16) {
+            rijndaelDecrypt(rk, Nr, ct, pt);
+            for (size_t i = 0; i < 16; i++) {
+              pt[i] ^= ivec[i];
+              ivec[i] = ct[i];
+            }
+          }
+        });
+    return;
+  }
+
   uint32_t rk[4 * (MAXNR + 1)];
   uint8_t ivec[16] = {0};
   int32_t Nr = rijndaelKeySetupDec(rk, session_key, 128);
@@ -218,12 +280,61 @@ uint32_t XexModule::GetProcAddress(const std::string_view name) const {
   return 0;
 }
 
+namespace {
+
+struct CompressedBlock {
+  const uint8_t* data;
+  uint32_t size;
+  const uint8_t* hash;
+};
+
+// Every block starts with the size and the hash of the next one, so the chain
+// is walked first, and the hashes, the slow part, are then checked on multiple
+// threads.
+bool VerifyCompressedBlocks(const xex2_compressed_block_info* first_block,
+                            const uint8_t* data, size_t data_size,
+                            std::vector<CompressedBlock>& blocks) {
+  const xex2_compressed_block_info* cur_block = first_block;
+  const uint8_t* p = data;
+  const uint8_t* data_end = data + data_size;
+  while (cur_block->block_size) {
+    if (cur_block->block_size < sizeof(xex2_compressed_block_info) ||
+        cur_block->block_size > size_t(data_end - p)) {
+      return false;
+    }
+    blocks.push_back({p, cur_block->block_size, cur_block->block_hash});
+    cur_block = reinterpret_cast<const xex2_compressed_block_info*>(p);
+    p += blocks.back().size;
+  }
+  std::atomic<bool> hashes_match{true};
+  ParallelFor(blocks.size(), "XEX Verification", [&](size_t block_index) {
+    const CompressedBlock& block = blocks[block_index];
+    uint8_t digest[0x14];
+    sha1::SHA1 s;
+    s.processBytes(block.data, block.size);
+    s.finalize(digest);
+    if (std::memcmp(digest, block.hash, 0x14) != 0) {
+      hashes_match.store(false, std::memory_order_relaxed);
+    }
+  });
+  return hashes_match.load(std::memory_order_relaxed);
+}
+
+}  // namespace
+
 int XexModule::ApplyPatch(XexModule* module) {
   if (!is_patch()) {
     // This isn't a XEX2 patch.
     return 1;
   }
 
+  // Keyed by both the base XEX and the title update.
+  const uint64_t patched_image_cache_key = XXH3_64bits_withSeed(
+      &image_cache_key_, sizeof(image_cache_key_), module->image_cache_key_);
+  if (module->LoadImageCache(patched_image_cache_key, true)) {
+    return 0;
+  }
+
   const uint32_t original_base_address = module->base_address();
 
   // Grab the delta descriptor and get to work.
@@ -389,6 +500,7 @@ int XexModule::ApplyPatch(XexModule* module) {
   }
 
   // Decrypt (if needed).
+  uint64_t stage_start_host_ticks = Clock::QueryHostTickCount();
   bool free_input = false;
   const uint8_t* patch_buffer = xexp_data_mem_.data();
   const size_t patch_length = xexp_data_mem_.size();
@@ -411,10 +523,34 @@ int XexModule::ApplyPatch(XexModule* module) {
       return 8;
   }
 
-  const xex2_compressed_block_info* cur_block =
-      &file_format_header->compression_info.normal.first_block;
+  const uint32_t window_size =
+      file_format_header->compression_info.normal.window_size;
+  double decryption_ms = GetElapsedMilliseconds(stage_start_host_ticks);
 
-  const uint8_t* p = input_buffer;
+  // Compare block hashes, if no match we probably used wrong decrypt key
+  stage_start_host_ticks = Clock::QueryHostTickCount();
+  std::vector<CompressedBlock> blocks;
+  if (!VerifyCompressedBlocks(
+          &file_format_header->compression_info.normal.first_block,
+          input_buffer, patch_length, blocks)) {
+    XELOGE("XEX patch block hash doesn't match hash inside block info!");
+    if (free_input) {
+      free((void*)input_buffer);
+    }
+    return 9;
+  }
+  std::vector<const xex2_delta_patch*> entries;
+  for (const CompressedBlock& block : blocks) {
+    // skip block info
+    const uint32_t block_info_size = sizeof(xex2_compressed_block_info);
+    lzxdelta_get_patch_entries(
+        reinterpret_cast<const xex2_delta_patch*>(block.data +
+                                                  block_info_size),
+        block.size - block_info_size, entries);
+  }
+  double verification_ms = GetElapsedMilliseconds(stage_start_host_ticks);
+
+  stage_start_host_ticks = Clock::QueryHostTickCount();
   uint8_t* base_exe = memory()->TranslateVirtual(module->base_address_);
 
   // If image_source_offset is set, copy [source_offset:source_size] to
@@ -435,41 +571,36 @@ int XexModule::ApplyPatch(XexModule* module) {
            original_image_size - image_target_size);
   }
 
-  uint8_t digest[0x14];
-  sha1::SHA1 s;
-  // Now loop through each block and apply the delta patches inside
-  while (cur_block->block_size) {
-    const auto* next_block = (const xex2_compressed_block_info*)p;
-
-    // Compare block hash, if no match we probably used wrong decrypt key
-    s.reset();
-    s.processBytes(p, cur_block->block_size);
-    s.finalize(digest);
-
-    if (memcmp(digest, cur_block->block_hash, 0x14) != 0) {
-      result_code = 9;
-      XELOGE("XEX patch block hash doesn't match hash inside block info!");
-      break;
-    }
-
-    // skip block info
-    p += 20;
-    p += 4;
-
-    uint32_t block_data_size = cur_block->block_size - 20 - 4;
-
-    // Apply delta patch
-    result_code = lzxdelta_apply_patch(
-        (xex2_delta_patch*)p, block_data_size,
-        file_format_header->compression_info.normal.window_size, base_exe);
-    if (result_code) {
-      break;
+  // Now apply the delta patches of all blocks - each entry is decompressed
+  // separately, with its own window, so unless some entry depends on the
+  // output of another, they're applied on multiple threads.
+  bool parallel_patch = lzxdelta_patch_entries_independent(entries);
+  if (parallel_patch) {
+    std::atomic<int> first_result_code{0};
+    ParallelFor(entries.size(), "XEX Patching", [&](size_t entry_index) {
+      int entry_result_code = lzxdelta_apply_patch_entry(
+          entries[entry_index], window_size, base_exe);
+      if (entry_result_code) {
+        int expected = 0;
+        first_result_code.compare_exchange_strong(expected,
+                                                  entry_result_code);
+      }
+    });
+    result_code = first_result_code.load();
+  } else {
+    for (const xex2_delta_patch* entry : entries) {
+      result_code = lzxdelta_apply_patch_entry(entry, window_size, base_exe);
+      if (result_code) {
+        break;
+      }
     }
-
-    p += block_data_size;
-    cur_block = next_block;
   }
-
+  XELOGI(
+      "XEX patch stages: decryption {:.1f} ms, verification {:.1f} ms, "
+      "{} delta entries {:.1f} ms{}",
+      decryption_ms, verification_ms, entries.size(),
+      GetElapsedMilliseconds(stage_start_host_ticks),
+      parallel_patch ? " on multiple threads" : "");
   if (!result_code) {
     // Decommit unused pages if new image size is smaller than original
     if (original_image_size > new_image_size) {
@@ -495,6 +626,7 @@ int XexModule::ApplyPatch(XexModule* module) {
         "version: {}.{}.{}.{}",
         source_ver.major, source_ver.minor, source_ver.build, source_ver.qfe,
         target_ver.major, target_ver.minor, target_ver.build, target_ver.qfe);
+    module->StoreImageCache(patched_image_cache_key);
   } else {
     XELOGE("XEX patch application failed, error code {}", result_code);
   }
@@ -707,9 +839,9 @@ int XexModule::ReadImageCompressed(const void* xex_addr, size_t xex_length) {
   uint8_t* compress_buffer = NULL;
   const uint8_t* p = NULL;
   uint8_t* d = NULL;
-  sha1::SHA1 s;
 
   // Decrypt (if needed).
+  uint64_t stage_start_host_ticks = Clock::QueryHostTickCount();
   bool free_input = false;
   const uint8_t* input_buffer = exe_buffer;
   size_t input_size = exe_length;
@@ -731,34 +863,29 @@ int XexModule::ReadImageCompressed(const void* xex_addr, size_t xex_length) {
   }
 
   const auto* compression_info = &opt_file_format_info()->compression_info;
-  const xex2_compressed_block_info* cur_block =
-      &compression_info->normal.first_block;
+  double decryption_ms = GetElapsedMilliseconds(stage_start_host_ticks);
+
+  // Compare block hashes, if no match we probably used wrong decrypt key
+  stage_start_host_ticks = Clock::QueryHostTickCount();
+  int result_code = 0;
+  std::vector<CompressedBlock> blocks;
+  if (!VerifyCompressedBlocks(&compression_info->normal.first_block,
+                              input_buffer, input_size, blocks)) {
+    result_code = 2;
+  }
 
   compress_buffer = (uint8_t*)calloc(1, exe_length);
 
-  p = input_buffer;
   d = compress_buffer;
 
   // De-block.
-  int result_code = 0;
-
-  uint8_t block_calced_digest[0x14];
-  while (cur_block->block_size) {
-    const uint8_t* pnext = p + cur_block->block_size;
-    const auto* next_block = (const xex2_compressed_block_info*)p;
-
-    // Compare block hash, if no match we probably used wrong decrypt key
-    s.reset();
-    s.processBytes(p, cur_block->block_size);
-    s.finalize(block_calced_digest);
-    if (memcmp(block_calced_digest, cur_block->block_hash, 0x14) != 0) {
-      result_code = 2;
+  for (const CompressedBlock& block : blocks) {
+    if (result_code) {
       break;
     }
 
     // skip block info
-    p += 4;
-    p += 20;
+    p = block.data + sizeof(xex2_compressed_block_info);
 
     while (true) {
       const size_t chunk_size = (p[0] << 8) | p[1];
@@ -771,10 +898,8 @@ int XexModule::ReadImageCompressed(const void* xex_addr, size_t xex_length) {
       p += chunk_size;
       d += chunk_size;
     }
-
-    p = pnext;
-    cur_block = next_block;
   }
+  double verification_ms = GetElapsedMilliseconds(stage_start_host_ticks);
 
   if (!result_code) {
     uint32_t uncompressed_size = image_size();
@@ -792,10 +917,18 @@ int XexModule::ReadImageCompressed(const void* xex_addr, size_t xex_length) {
       uint8_t* buffer = memory()->TranslateVirtual(base_address_);
       std::memset(buffer, 0, uncompressed_size);
 
-      // Decompress into XEX base
+      // Decompress into XEX base - the whole image is a single LZX stream,
+      // every block referencing the window of the previous ones, so this
+      // can't be split between threads.
+      stage_start_host_ticks = Clock::QueryHostTickCount();
       result_code = lzx_decompress(
           compress_buffer, d - compress_buffer, buffer, uncompressed_size,
           compression_info->normal.window_size, nullptr, 0);
+      XELOGI(
+          "XEX image stages: decryption {:.1f} ms, verification {:.1f} ms, "
+          "decompression {:.1f} ms",
+          decryption_ms, verification_ms,
+          GetElapsedMilliseconds(stage_start_host_ticks));
     } else {
       XELOGE("Unable to allocate XEX memory at {:08X}-{:08X}.", base_address_,
              uncompressed_size);
@@ -812,6 +945,150 @@ int XexModule::ReadImageCompressed(const void* xex_addr, size_t xex_length) {
   return result_code;
 }
 
+namespace {
+
+constexpr uint32_t kXexImageCacheSignature = 0x474D4958;  // 'XIMG'
+constexpr uint32_t kXexImageCacheVersion = 1;
+
+// Followed by the XEX headers of the module and its image.
+struct XexImageCacheHeader {
+  uint32_t signature;
+  uint32_t version;
+  uint32_t base_address;
+  uint32_t image_size;
+  uint32_t header_size;
+  uint32_t is_dev_kit;
+  uint8_t session_key[0x10];
+  uint64_t image_hash;
+};
+
+}  // namespace
+
+std::filesystem::path XexModule::GetImageCachePath(uint64_t key) const {
+  std::filesystem::path cache_root = kernel_state_->emulator()->cache_root();
+  if (cache_root.empty()) {
+    return {};
+  }
+  return cache_root / "modules" / "images" / fmt::format("{:016X}.bin", key);
+}
+
+bool XexModule::LoadImageCache(uint64_t key, bool replace_image) {
+  if (!cvars::xex_image_cache) {
+    return false;
+  }
+  std::filesystem::path path = GetImageCachePath(key);
+  if (path.empty()) {
+    return false;
+  }
+  // Mapped rather than read, so the emulator instances running the same title
+  // on the host share the pages of the entry in the file cache instead of each
+  // having a private copy of the image in addition to the guest memory.
+  auto file = xe::MappedMemory::Open(path, xe::MappedMemory::Mode::kRead);
+  if (!file) {
+    return false;
+  }
+  XexImageCacheHeader cache_header;
+  if (file->size() < sizeof(cache_header)) {
+    return false;
+  }
+  std::memcpy(&cache_header, file->data(), sizeof(cache_header));
+  if (cache_header.signature != kXexImageCacheSignature ||
+      cache_header.version != kXexImageCacheVersion ||
+      cache_header.header_size < sizeof(xex2_header) ||
+      !cache_header.image_size) {
+    return false;
+  }
+  // Verified before anything is changed, so the XEX can still be processed
+  // normally if the entry is broken.
+  const uint8_t* header_data = file->data() + sizeof(cache_header);
+  const uint8_t* image = header_data + cache_header.header_size;
+  if (file->size() - sizeof(cache_header) <
+          uint64_t(cache_header.header_size) + cache_header.image_size ||
+      XXH3_64bits(image, cache_header.image_size) != cache_header.image_hash) {
+    XELOGW("XEX image cache entry {} is corrupted", xe::path_to_utf8(path));
+    return false;
+  }
+
+  BaseHeap* heap = memory()->LookupHeap(base_address_);
+  if (replace_image) {
+    heap->Release(base_address_);
+  } else {
+    heap->Reset();
+  }
+  heap = memory()->LookupHeap(cache_header.base_address);
+  if (!heap ||
+      !heap->AllocFixed(
+          cache_header.base_address, cache_header.image_size, 4096,
+          xe::kMemoryAllocationReserve | xe::kMemoryAllocationCommit,
+          xe::kMemoryProtectRead | xe::kMemoryProtectWrite)) {
+    XELOGE("Unable to allocate XEX memory at {:08X}-{:08X}.",
+           cache_header.base_address, cache_header.image_size);
+    return false;
+  }
+  std::memcpy(memory()->TranslateVirtual(cache_header.base_address), image,
+              cache_header.image_size);
+
+  xex_header_mem_.assign(header_data, header_data + cache_header.header_size);
+  file.reset();
+  ReadSecurityInfo();
+  base_address_ = cache_header.base_address;
+  is_dev_kit_ = cache_header.is_dev_kit != 0;
+  std::memcpy(session_key_, cache_header.session_key, sizeof(session_key_));
+  XELOGI(
+      "Loaded the image of {} from the XEX image cache, mapping {} KiB shared "
+      "with other instances rather than reading it into private memory",
+      name_, cache_header.image_size >> 10);
+  return true;
+}
+
+void XexModule::StoreImageCache(uint64_t key) const {
+  if (!cvars::xex_image_cache) {
+    return;
+  }
+  std::filesystem::path path = GetImageCachePath(key);
+  if (path.empty()) {
+    return;
+  }
+  std::filesystem::create_directories(path.parent_path());
+  // Other instances may be loading the entry, so it's written to a temporary
+  // file, and put in place once complete.
+  std::filesystem::path temp_path = xe::filesystem::GetTemporaryFilePath(path);
+  FILE* file = xe::filesystem::OpenFile(temp_path, "wb");
+  if (!file) {
+    XELOGW("Unable to create XEX image cache entry {}",
+           xe::path_to_utf8(path));
+    return;
+  }
+  const uint8_t* image = memory()->TranslateVirtual(base_address_);
+  XexImageCacheHeader cache_header = {};
+  cache_header.signature = kXexImageCacheSignature;
+  cache_header.version = kXexImageCacheVersion;
+  cache_header.base_address = base_address_;
+  cache_header.image_size = image_size();
+  cache_header.header_size = uint32_t(xex_header_mem_.size());
+  cache_header.is_dev_kit = is_dev_kit_ ? 1 : 0;
+  std::memcpy(cache_header.session_key, session_key_,
+              sizeof(cache_header.session_key));
+  cache_header.image_hash = XXH3_64bits(image, cache_header.image_size);
+  bool written =
+      fwrite(&cache_header, sizeof(cache_header), 1, file) == 1 &&
+      fwrite(xex_header_mem_.data(), 1, xex_header_mem_.size(), file) ==
+          xex_header_mem_.size() &&
+      fwrite(image, 1, cache_header.image_size, file) ==
+          cache_header.image_size;
+  written &= fclose(file) == 0;
+  if (!written) {
+    XELOGW("Unable to write XEX image cache entry {}",
+           xe::path_to_utf8(path));
+    std::error_code ec;
+    std::filesystem::remove(temp_path, ec);
+    return;
+  }
+  // Fails on Windows if another instance is loading the same entry, which is
+  // fine as the contents are the same.
+  xe::filesystem::ReplaceFile(temp_path, path);
+}
+
 int XexModule::ReadPEHeaders() {
   const uint8_t* p = memory()->TranslateVirtual(base_address_);
 
@@ -936,6 +1213,7 @@ void XexModule::ReadSecurityInfo() {
 
 bool XexModule::Load(const std::string_view name, const std::string_view path,
                      const void* xex_addr, size_t xex_length) {
+  StartupTimelinePhase startup_phase("XexModule::Load");
   auto src_header = reinterpret_cast<const xex2_header*>(xex_addr);
 
   if (src_header->magic == kXEX1Signature) {
@@ -969,6 +1247,20 @@ bool XexModule::Load(const std::string_view name, const std::string_view path,
   name_ = name;
   path_ = path;
 
+  const uint64_t load_start_host_ticks = Clock::QueryHostTickCount();
+
+  // The security info in the headers contains the digest of the image, so
+  // they identify the image without hashing the whole file. The patch data of
+  // title updates is not covered by it though.
+  image_cache_key_ = XXH3_64bits_withSeed(
+      xex_header_mem_.data(), xex_header_mem_.size(), xex_length);
+  if (!is_patch() && opt_file_format_info() &&
+      LoadImageCache(image_cache_key_, false) && is_valid_executable()) {
+    XELOGI("XEX {} image loaded in {:.1f} ms", name_,
+           GetElapsedMilliseconds(load_start_host_ticks));
+    return true;
+  }
+
   // Load in the XEX basefile
   // We'll try using both XEX2 keys to see if any give a valid PE
   int result_code = ReadImage(xex_addr, xex_length, false);
@@ -984,12 +1276,22 @@ bool XexModule::Load(const std::string_view name, const std::string_view path,
     }
   }
 
+  if (is_patch()) {
+    image_cache_key_ = XXH3_64bits_withSeed(
+        xexp_data_mem_.data(), xexp_data_mem_.size(), image_cache_key_);
+  } else {
+    StoreImageCache(image_cache_key_);
+  }
+  XELOGI("XEX {} image loaded in {:.1f} ms", name_,
+         GetElapsedMilliseconds(load_start_host_ticks));
+
   // Note: caller will have to call LoadContinue once it's determined whether a
   // patch file exists or not!
   return true;
 }
 
 bool XexModule::LoadContinue() {
+  StartupTimelinePhase startup_phase("XexModule::LoadContinue");
   // Second part of image load
   // Split from Load() so that we can patch the XEX before loading this data
   assert_false(finished_load_);
@@ -1093,6 +1395,11 @@ bool XexModule::LoadContinue() {
     }
   }
 
+  // Must be done while the code is still writable.
+  if (!cvars::memory_routine_signatures.empty()) {
+    ReplaceMemoryRoutines();
+  }
+
   // Disable write protection if plugins are enabled
   if (cvars::allow_plugins && !cvars::writable_code_segments) {
     OVERRIDE_bool(writable_code_segments, true);
@@ -1126,6 +1433,7 @@ bool XexModule::LoadContinue() {
 }
 
 void XexModule::Precompile() {
+  StartupTimelinePhase startup_phase("XexModule::Precompile");
   sha1::SHA1 final_image_sha_;
 
   final_image_sha_.reset();
@@ -1143,6 +1451,8 @@ void XexModule::Precompile() {
     image_sha_str_ += &fmtbuf[0];
   }
 
+  LoadPdataFunctionExtents();
+
   // Find __savegprlr_* and __restgprlr_* and the others.
   // We can flag these for special handling (inlining/etc).
   if (!FindSaveRest()) {
@@ -1150,6 +1460,14 @@ void XexModule::Precompile() {
   }
 
   info_cache_.Init(this);
+  if (is_executable()) {
+    std::filesystem::path code_storage_path =
+        kernel_state_->emulator()->cache_root();
+    code_storage_path.append("modules");
+    code_storage_path.append(image_sha_str_);
+    code_storage_path.append("generated_code.bin");
+    processor_->backend()->InitializeCodeStorage(this, code_storage_path);
+  }
   PrecompileDiscoveredFunctions();
 }
 bool XexModule::Unload() {
@@ -1421,7 +1739,26 @@ void XexModule::PrecompileDiscoveredFunctions() {
   if (!cvars::enable_early_precompilation) {
     return;
   }
-  auto others = PreanalyzeCode();
+  // The discovered functions are stored in the cache of the final image, so
+  // the code only has to be analyzed on the first boot.
+  std::filesystem::path discovered_functions_path =
+      kernel_state_->emulator()->cache_root();
+  if (!discovered_functions_path.empty()) {
+    discovered_functions_path.append("modules");
+    discovered_functions_path.append(image_sha_str_);
+    discovered_functions_path.append("discovered_functions.bin");
+  }
+  std::vector<uint32_t> others;
+  if (discovered_functions_path.empty() ||
+      !LoadDiscoveredFunctions(discovered_functions_path, others)) {
+    uint64_t start_host_ticks = Clock::QueryHostTickCount();
+    others = PreanalyzeCode();
+    XELOGI("Discovered {} functions in {} in {:.1f} ms", others.size(), name_,
+           GetElapsedMilliseconds(start_host_ticks));
+    if (!discovered_functions_path.empty()) {
+      StoreDiscoveredFunctions(discovered_functions_path, others);
+    }
+  }
 
   for (auto&& other : others) {
     if (other < low_address_ || other >= high_address_) {
@@ -1430,10 +1767,71 @@ void XexModule::PrecompileDiscoveredFunctions() {
     auto sym = processor_->LookupFunction(other);
 
     if (!sym || sym->status() != Symbol::Status::kDefined) {
-      processor_->ResolveFunction(other);
+      processor_->PrecompileFunction(other);
     }
   }
 }
+namespace {
+
+constexpr uint32_t kDiscoveredFunctionsSignature = 0x43464458;  // 'XDFC'
+constexpr uint32_t kDiscoveredFunctionsVersion = 1;
+
+struct DiscoveredFunctionsHeader {
+  uint32_t signature;
+  uint32_t version;
+  uint32_t function_count;
+};
+
+}  // namespace
+
+bool XexModule::LoadDiscoveredFunctions(const std::filesystem::path& path,
+                                        std::vector<uint32_t>& functions) {
+  FILE* file = xe::filesystem::OpenFile(path, "rb");
+  if (!file) {
+    return false;
+  }
+  DiscoveredFunctionsHeader header;
+  bool loaded = fread(&header, sizeof(header), 1, file) == 1 &&
+                header.signature == kDiscoveredFunctionsSignature &&
+                header.version == kDiscoveredFunctionsVersion &&
+                header.function_count <= (high_address_ - low_address_) / 4;
+  if (loaded) {
+    functions.resize(header.function_count);
+    loaded = fread(functions.data(), sizeof(uint32_t), functions.size(),
+                   file) == functions.size();
+  }
+  fclose(file);
+  if (!loaded) {
+    functions.clear();
+  }
+  return loaded;
+}
+
+void XexModule::StoreDiscoveredFunctions(
+    const std::filesystem::path& path, const std::vector<uint32_t>& functions) {
+  std::filesystem::create_directories(path.parent_path());
+  std::filesystem::path temp_path = xe::filesystem::GetTemporaryFilePath(path);
+  FILE* file = xe::filesystem::OpenFile(temp_path, "wb");
+  if (!file) {
+    return;
+  }
+  DiscoveredFunctionsHeader header;
+  header.signature = kDiscoveredFunctionsSignature;
+  header.version = kDiscoveredFunctionsVersion;
+  header.function_count = uint32_t(functions.size());
+  bool written =
+      fwrite(&header, sizeof(header), 1, file) == 1 &&
+      fwrite(functions.data(), sizeof(uint32_t), functions.size(), file) ==
+          functions.size();
+  written &= fclose(file) == 0;
+  if (!written) {
+    std::error_code ec;
+    std::filesystem::remove(temp_path, ec);
+    return;
+  }
+  xe::filesystem::ReplaceFile(temp_path, path);
+}
+
 void XexModule::PrecompileKnownFunctions() {
   if (!cvars::enable_early_precompilation) {
     return;
@@ -1451,7 +1849,7 @@ void XexModule::PrecompileKnownFunctions() {
       auto sym = processor_->LookupFunction(addr);
 
       if (!sym || sym->status() != Symbol::Status::kDefined) {
-        processor_->ResolveFunction(addr);
+        processor_->PrecompileFunction(addr);
       }
     }
   }
@@ -1483,36 +1881,40 @@ std::vector<uint32_t> XexModule::PreanalyzeCode() {
     }
   }
   uint32_t high_8_aligned = highest_exec_addr & ~(8U - 1);
-  uint32_t n_possible_8byte_addresses = (high_8_aligned - low_8_aligned) / 8;
-  uint32_t* funcstart_candidate_stack =
-      new uint32_t[n_possible_8byte_addresses];
-  uint32_t* funcstart_candstack2 = new uint32_t[n_possible_8byte_addresses];
-
-  uint32_t stack_pos = 0;
-  {
-    // all functions seem to start on 8 byte boundaries, except for obvious ones
-    // like the save/rest funcs
+  if (high_8_aligned <= low_8_aligned) {
+    return {};
+  }
+
+  // all functions seem to start on 8 byte boundaries, except for obvious ones
+  // like the save/rest funcs
+  const uint8_t mfspr_r12_lr[4] = {0x7D, 0x88, 0x02, 0xA6};
+
+  // a blr instruction, with 4 zero bytes afterwards to pad the next address
+  // to 8 byte alignment
+  // if we see this prior to our address, we can assume we are a function
+  // start
+  const uint8_t blr[4] = {0x4E, 0x80, 0x0, 0x20};
+
+  uint32_t blr32 = *reinterpret_cast<const uint32_t*>(&blr[0]);
+
+  uint32_t mfspr_r12_lr32 =
+      *reinterpret_cast<const uint32_t*>(&mfspr_r12_lr[0]);
+
+  // The code is scanned in shards on multiple threads, each collecting the
+  // function starts it finds separately, merged and deduplicated afterwards.
+  constexpr uint32_t kShardSize = 256 * 1024;
+  const uint32_t shard_count =
+      (high_8_aligned - low_8_aligned + kShardSize - 1) / kShardSize;
+  std::vector<std::vector<uint32_t>> shard_funcstarts(shard_count);
+  ParallelFor(shard_count, "XEX Code Analysis", [&](size_t shard_index) {
+    uint32_t shard_start = low_8_aligned + uint32_t(shard_index) * kShardSize;
+    uint32_t shard_end =
+        std::min(shard_start + kShardSize, high_8_aligned);  // multiple of 8
     uint32_t* range_start =
-        (uint32_t*)memory()->TranslateVirtual(low_8_aligned);
-    uint32_t* range_end = (uint32_t*)memory()->TranslateVirtual(
-        high_8_aligned);  // align down to multiple of 8
-
-    const uint8_t mfspr_r12_lr[4] = {0x7D, 0x88, 0x02, 0xA6};
-
-    // a blr instruction, with 4 zero bytes afterwards to pad the next address
-    // to 8 byte alignment
-    // if we see this prior to our address, we can assume we are a function
-    // start
-    const uint8_t blr[4] = {0x4E, 0x80, 0x0, 0x20};
-
-    uint32_t blr32 = *reinterpret_cast<const uint32_t*>(&blr[0]);
-
-    uint32_t mfspr_r12_lr32 =
-        *reinterpret_cast<const uint32_t*>(&mfspr_r12_lr[0]);
+        (uint32_t*)memory()->TranslateVirtual(shard_start);
+    uint32_t* range_end = (uint32_t*)memory()->TranslateVirtual(shard_end);
+    std::vector<uint32_t>& funcstarts = shard_funcstarts[shard_index];
 
-    auto add_new_func = [funcstart_candidate_stack, &stack_pos](uint32_t addr) {
-      funcstart_candidate_stack[stack_pos++] = addr;
-    };
     /*
                 First pass: detect save of the link register at an eight byte
        aligned address
@@ -1521,11 +1923,10 @@ std::vector<uint32_t> XexModule::PreanalyzeCode() {
          first_pass += 2) {
       if (*first_pass == mfspr_r12_lr32) {
         // Push our newly discovered function start into our list
-        // All addresses in the list are sorted until the second pass
-        add_new_func(
+        funcstarts.push_back(
             static_cast<uint32_t>(reinterpret_cast<uintptr_t>(first_pass) -
                                   reinterpret_cast<uintptr_t>(range_start)) +
-            low_8_aligned);
+            shard_start);
       } else if (first_pass[-1] == 0 && *first_pass != 0) {
         // originally i checked for blr followed by 0, but some functions are
         // actually aligned to greater boundaries. something that appears to be
@@ -1538,14 +1939,14 @@ std::vector<uint32_t> XexModule::PreanalyzeCode() {
         }
 
         XE_LIKELY_IF(*check_iter == blr32) {
-          add_new_func(
+          funcstarts.push_back(
               static_cast<uint32_t>(reinterpret_cast<uintptr_t>(first_pass) -
                                     reinterpret_cast<uintptr_t>(range_start)) +
-              low_8_aligned);
+              shard_start);
         }
       }
     }
-    uint32_t current_guestaddr = low_8_aligned;
+    uint32_t current_guestaddr = shard_start;
     // Second pass: detect branch with link instructions and decode the target
     // address. We can safely assume that if bl is to address, that address is
     // the start of the function
@@ -1560,62 +1961,263 @@ std::vector<uint32_t> XexModule::PreanalyzeCode() {
         if ((called_function & (8 - 1)) == 0 &&
             called_function >= low_address_ &&
             called_function < high_address_) {
-          add_new_func(called_function);
+          funcstarts.push_back(called_function);
         }
       }
     }
+  });
 
-    auto pdata = this->GetPESection(".pdata");
-
-    if (pdata) {
-      uint32_t* pdata_base =
-          (uint32_t*)this->memory()->TranslateVirtual(pdata->address);
-
-      uint32_t n_pdata_entries = pdata->raw_size / 8;
+  std::vector<uint32_t> result;
+  size_t funcstart_count = 0;
+  for (const std::vector<uint32_t>& funcstarts : shard_funcstarts) {
+    funcstart_count += funcstarts.size();
+  }
+  result.reserve(funcstart_count);
+  for (const std::vector<uint32_t>& funcstarts : shard_funcstarts) {
+    result.insert(result.end(), funcstarts.begin(), funcstarts.end());
+  }
 
-      for (uint32_t i = 0; i < n_pdata_entries; ++i) {
-        uint32_t funcaddr = xe::load_and_swap<uint32_t>(&pdata_base[i * 2]);
-        if (funcaddr >= low_address_ && funcaddr <= highest_exec_addr) {
-          add_new_func(funcaddr);
-        } else {
-          // we hit 0 for func addr, that means we're done
-          break;
-        }
-      }
-    }
+  for (const FunctionExtent& pdata_function_extent : pdata_function_extents_) {
+    result.push_back(pdata_function_extent.address);
   }
 
   // Sort the list of function starts and then ensure that all addresses are
   // unique
-  uint32_t n_known_funcaddrs = 0;
-  {
-    // make addresses unique
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
+void XexModule::LoadPdataFunctionExtents() {
+  pdata_function_extents_.clear();
+  auto pdata = GetPESection(".pdata");
+  if (!pdata) {
+    return;
+  }
+  // IMAGE_CE_RUNTIME_FUNCTION_ENTRY - the begin address, and the prolog length
+  // in bits 0:7 and the function length in instructions in bits 8:29.
+  auto pdata_base =
+      memory()->TranslateVirtual<const uint32_t*>(pdata->address);
+  uint32_t pdata_entry_count = pdata->raw_size / 8;
+  pdata_function_extents_.reserve(pdata_entry_count);
+  for (uint32_t i = 0; i < pdata_entry_count; ++i) {
+    uint32_t address = xe::load_and_swap<uint32_t>(&pdata_base[i * 2]);
+    uint32_t instruction_count =
+        (xe::load_and_swap<uint32_t>(&pdata_base[i * 2 + 1]) >> 8) & 0x3FFFFF;
+    if (!address) {
+      // The table is padded with zeros.
+      break;
+    }
+    if ((address & 3) || !instruction_count || address < low_address_ ||
+        address >= high_address_ ||
+        instruction_count > (high_address_ - address) / 4) {
+      continue;
+    }
+    pdata_function_extents_.push_back(
+        {address, address + (instruction_count - 1) * 4});
+  }
+  std::sort(pdata_function_extents_.begin(), pdata_function_extents_.end(),
+            [](const FunctionExtent& a, const FunctionExtent& b) {
+              return a.address < b.address;
+            });
+  pdata_function_extents_.erase(
+      std::unique(pdata_function_extents_.begin(),
+                  pdata_function_extents_.end(),
+                  [](const FunctionExtent& a, const FunctionExtent& b) {
+                    return a.address == b.address;
+                  }),
+      pdata_function_extents_.end());
+  if (!pdata_function_extents_.empty()) {
+    XELOGI("Loaded the extents of {} functions in {} from .pdata",
+           pdata_function_extents_.size(), name_);
+  }
+}
 
-    std::sort(funcstart_candidate_stack, funcstart_candidate_stack + stack_pos);
+uint32_t XexModule::GetKnownFunctionEnd(uint32_t address) const {
+  auto it = std::lower_bound(
+      pdata_function_extents_.cbegin(), pdata_function_extents_.cend(),
+      address, [](const FunctionExtent& extent, uint32_t address) {
+        return extent.address < address;
+      });
+  if (it == pdata_function_extents_.cend() || it->address != address) {
+    return 0;
+  }
+  return it->end_address;
+}
 
-    uint32_t read_pos = 0;
-    uint32_t write_pos = 0;
-    uint32_t previous_addr = ~0u;
-    while (read_pos < stack_pos) {
-      uint32_t current_addr = funcstart_candidate_stack[read_pos++];
+// Host implementations of the guest CRT memory routines, called through the
+// same extern mechanism as the kernel imports. The host CRT already picks the
+// widest vector instructions available.
+static void GuestMemmove(ppc::PPCContext* ppc_context,
+                         kernel::KernelState* kernel_state) {
+  uint32_t size = uint32_t(ppc_context->r[5]);
+  if (size) {
+    std::memmove(ppc_context->TranslateVirtual(uint32_t(ppc_context->r[3])),
+                 ppc_context->TranslateVirtual(uint32_t(ppc_context->r[4])),
+                 size);
+  }
+  // The destination is returned, and r3 still holds it.
+}
 
-      if (current_addr != previous_addr) {
-        previous_addr = current_addr;
-        funcstart_candstack2[write_pos++] = current_addr;
+static void GuestMemset(ppc::PPCContext* ppc_context,
+                        kernel::KernelState* kernel_state) {
+  uint32_t size = uint32_t(ppc_context->r[5]);
+  if (size) {
+    std::memset(ppc_context->TranslateVirtual(uint32_t(ppc_context->r[3])),
+                uint8_t(ppc_context->r[4]), size);
+  }
+}
+
+static void GuestMemcmp(ppc::PPCContext* ppc_context,
+                        kernel::KernelState* kernel_state) {
+  uint32_t size = uint32_t(ppc_context->r[5]);
+  int result = 0;
+  if (size) {
+    result = std::memcmp(
+        ppc_context->TranslateVirtual(uint32_t(ppc_context->r[3])),
+        ppc_context->TranslateVirtual(uint32_t(ppc_context->r[4])), size);
+  }
+  ppc_context->r[3] = uint64_t(int64_t(result < 0 ? -1 : (result > 0)));
+}
+
+void XexModule::ReplaceMemoryRoutines() {
+  static const struct {
+    const char* name;
+    GuestFunction::ExternHandler handler;
+  } kMemoryRoutines[] = {
+      {"memcpy", GuestMemmove}, {"memmove", GuestMemmove},
+      {"XMemCpy", GuestMemmove}, {"memset", GuestMemset},
+      {"XMemSet", GuestMemset}, {"memcmp", GuestMemcmp},
+  };
+  struct Signature {
+    const char* name;
+    GuestFunction::ExternHandler handler;
+    std::vector<uint32_t> values;
+    std::vector<uint32_t> masks;
+  };
+  std::vector<Signature> signatures;
+  // Names of the routines from the export resolver, referenced by the
+  // signatures.
+  std::list<std::string> routine_names;
+
+  std::ifstream infile(cvars::memory_routine_signatures);
+  if (!infile) {
+    XELOGE("Failed to open the memory routine signatures {}",
+           xe::path_to_utf8(cvars::memory_routine_signatures));
+    return;
+  }
+  std::string line;
+  std::stringstream sstream;
+  std::string token;
+  while (std::getline(infile, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    sstream.clear();
+    sstream.str(line);
+    Signature signature = {};
+    sstream >> token;
+    for (const auto& routine : kMemoryRoutines) {
+      if (token == routine.name) {
+        signature.name = routine.name;
+        signature.handler = routine.handler;
+        break;
       }
     }
-    n_known_funcaddrs = write_pos;
+    if (!signature.handler) {
+      // The string routines are implemented by the kernel, with the
+      // formatting shared with its exports.
+      ExportTrampoline trampoline =
+          processor_->export_resolver()->GetRoutineReplacement(token);
+      if (trampoline) {
+        routine_names.push_back(token);
+        signature.name = routine_names.back().c_str();
+        signature.handler = (GuestFunction::ExternHandler)(void*)trampoline;
+      }
+    }
+    if (!signature.handler) {
+      XELOGW("Skipping the signature of the unknown routine {}", token);
+      continue;
+    }
+    bool is_valid = true;
+    while (sstream >> token) {
+      if (token == "????????") {
+        signature.values.push_back(0);
+        signature.masks.push_back(0);
+        continue;
+      }
+      char* token_end;
+      uint32_t value = uint32_t(std::strtoul(token.c_str(), &token_end, 16));
+      if (token.size() != 8 || *token_end) {
+        is_valid = false;
+        break;
+      }
+      signature.values.push_back(value);
+      signature.masks.push_back(UINT32_MAX);
+    }
+    // Two instructions are overwritten with the call to the host.
+    if (!is_valid || signature.values.size() < 2 || !signature.masks[0]) {
+      XELOGW("Skipping the invalid signature of {}", signature.name);
+      continue;
+    }
+    signatures.push_back(std::move(signature));
+  }
+  if (signatures.empty()) {
+    return;
   }
 
-  delete[] funcstart_candidate_stack;
+  auto page_size = base_address_ <= 0x90000000 ? 64 * 1024 : 4 * 1024;
+  auto sec_header = xex_security_info();
+  for (uint32_t i = 0, page = 0; i < sec_header->page_descriptor_count; i++) {
+    // Byteswap the bitfield manually.
+    xex2_page_descriptor desc;
+    desc.value = xe::byte_swap(sec_header->page_descriptors[i].value);
 
-  std::vector<uint32_t> result;
-  result.resize(n_known_funcaddrs);
-  memcpy(&result[0], funcstart_candstack2,
-         sizeof(uint32_t) * n_known_funcaddrs);
-  delete[] funcstart_candstack2;
-  return result;
+    const auto start_address = base_address_ + (page * page_size);
+    const auto end_address = start_address + (desc.page_count * page_size);
+    page += desc.page_count;
+    if (desc.info != XEX_SECTION_CODE) {
+      continue;
+    }
+
+    auto code = memory()->TranslateVirtual<xe::be<uint32_t>*>(start_address);
+    uint32_t code_count = (end_address - start_address) / 4;
+    for (const Signature& signature : signatures) {
+      uint32_t signature_count = uint32_t(signature.values.size());
+      for (uint32_t j = 0; j + signature_count <= code_count; ++j) {
+        if (uint32_t(code[j]) != signature.values[0]) {
+          continue;
+        }
+        uint32_t k = 1;
+        for (; k < signature_count; ++k) {
+          if ((uint32_t(code[j + k]) & signature.masks[k]) !=
+              signature.values[k]) {
+            break;
+          }
+        }
+        if (k != signature_count) {
+          continue;
+        }
+        uint32_t address = start_address + j * 4;
+        // Same as the import thunks:
+        //     sc 2
+        //     blr
+        code[j] = 0x44000042;
+        code[j + 1] = 0x4E800020;
+        Function* function;
+        DeclareFunction(address, &function);
+        function->set_end_address(address + 8);
+        function->set_name(fmt::format("__host_{}_{:08X}", signature.name,
+                                       address));
+        static_cast<GuestFunction*>(function)->SetupExtern(signature.handler);
+        function->set_status(Symbol::Status::kDeclared);
+        XELOGI("Replaced {} at {:08X} with the host implementation",
+               signature.name, address);
+        j += signature_count - 1;
+      }
+    }
+  }
 }
+
 bool XexModule::FindSaveRest() {
   // Special stack save/restore functions.
   // http://research.microsoft.com/en-us/um/redmond/projects/invisible/src/crt/md/ppc/xxx.s.htm
@@ -10,6 +10,7 @@
 #ifndef XENIA_CPU_XEX_MODULE_H_
 #define XENIA_CPU_XEX_MODULE_H_
 
+#include <filesystem>
 #include <string>
 #include <vector>
 #include "xenia/base/mapped_memory.h"
@@ -234,6 +235,9 @@ class XexModule : public xe::cpu::Module {
 
   virtual void Precompile() override;
 
+  // From the .pdata runtime function table, if the image has one.
+  uint32_t GetKnownFunctionEnd(uint32_t address) const override;
+
  protected:
   std::unique_ptr<Function> CreateFunction(uint32_t address) override;
 
@@ -241,6 +245,12 @@ class XexModule : public xe::cpu::Module {
   void PrecompileKnownFunctions();
   void PrecompileDiscoveredFunctions();
   std::vector<uint32_t> PreanalyzeCode();
+  void LoadPdataFunctionExtents();
+  // Cache of the function starts found by PreanalyzeCode.
+  bool LoadDiscoveredFunctions(const std::filesystem::path& path,
+                               std::vector<uint32_t>& functions);
+  void StoreDiscoveredFunctions(const std::filesystem::path& path,
+                                const std::vector<uint32_t>& functions);
   friend struct XexInfoCache;
   void ReadSecurityInfo();
 
@@ -249,11 +259,20 @@ class XexModule : public xe::cpu::Module {
   int ReadImageBasicCompressed(const void* xex_addr, size_t xex_length);
   int ReadImageCompressed(const void* xex_addr, size_t xex_length);
 
+  // Cache of the final images, after decryption, decompression and
+  // patching, along with the headers they have been loaded with.
+  std::filesystem::path GetImageCachePath(uint64_t key) const;
+  // If replace_image is false, the heap of the image is reset like when the
+  // XEX is read, otherwise only the current image is released.
+  bool LoadImageCache(uint64_t key, bool replace_image);
+  void StoreImageCache(uint64_t key) const;
+
   int ReadPEHeaders();
 
   bool SetupLibraryImports(const std::string_view name,
                            const xex2_import_library* library);
   bool FindSaveRest();
+  void ReplaceMemoryRoutines();
 
   Processor* processor_ = nullptr;
   kernel::KernelState* kernel_state_ = nullptr;
@@ -272,6 +291,9 @@ class XexModule : public xe::cpu::Module {
   uint8_t session_key_[0x10];
   bool is_dev_kit_ = false;
 
+  // Identifies the image of the XEX, or the patch data of an XEXP.
+  uint64_t image_cache_key_ = 0;
+
   bool loaded_ = false;         // Loaded into memory?
   bool finished_load_ = false;  // PE/imports/symbols/etc all loaded?
 
@@ -285,6 +307,14 @@ class XexModule : public xe::cpu::Module {
   uint8_t image_sha_bytes_[20];
   std::string image_sha_str_;
   XexInfoCache info_cache_;
+
+  struct FunctionExtent {
+    uint32_t address;
+    // Of the last instruction.
+    uint32_t end_address;
+  };
+  // Sorted by the address.
+  std::vector<FunctionExtent> pdata_function_extents_;
 };
 
 }  // namespace cpu
@@ -30,6 +30,7 @@
 #include "xenia/gpu/graphics_system.h"
 #include "xenia/kernel/xmodule.h"
 #include "xenia/kernel/xthread.h"
+#include "xenia/ui/file_picker.h"
 #include "xenia/ui/graphics_provider.h"
 #include "xenia/ui/imgui_drawer.h"
 #include "xenia/ui/immediate_drawer.h"
@@ -217,6 +218,9 @@ void DebugWindow::DrawFrame(ImGuiIO& io) {
   ImGui::SameLine();
   ImGui::RadioButton("Memory", &state_.right_pane_tab,
                      ImState::kRightPaneMemory);
+  ImGui::SameLine();
+  ImGui::RadioButton("Profiler", &state_.right_pane_tab,
+                     ImState::kRightPaneProfiler);
   ImGui::EndGroup();
   ImGui::Separator();
   switch (state_.right_pane_tab) {
@@ -230,6 +234,11 @@ void DebugWindow::DrawFrame(ImGuiIO& io) {
       DrawMemoryPane();
       ImGui::EndChild();
       break;
+    case ImState::kRightPaneProfiler:
+      ImGui::BeginChild("##profiler_pane");
+      DrawProfilerPane();
+      ImGui::EndChild();
+      break;
   }
   ImGui::EndChild();
   ImGui::InvisibleButton("##hsplitter0", ImVec2(-1, kSplitterWidth));
@@ -1130,6 +1139,206 @@ void DebugWindow::DrawMemoryPane() {
   // https://github.com/ocornut/imgui/wiki/memory_editor_example
 }
 
+void DebugWindow::DrawProfilerPane() {
+  auto& profiler_state = state_.profiler;
+  if (!profiler_) {
+    profiler_ = std::make_unique<cpu::GuestProfiler>(processor_);
+  }
+  bool update_report = false;
+  if (profiler_->is_running()) {
+    if (ImGui::Button("Stop", ImVec2(80, 0))) {
+      profiler_->Stop();
+      update_report = true;
+    }
+  } else {
+    if (ImGui::Button("Start", ImVec2(80, 0))) {
+      profiler_->Start();
+    }
+    if (ImGui::IsItemHovered()) {
+      ImGui::SetTooltip(
+          "Sample the call stacks of the running guest threads every "
+          "guest_profiler_interval microseconds.");
+    }
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Reset", ImVec2(80, 0))) {
+    profiler_->Reset();
+    update_report = true;
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Export")) {
+    ExportProfilerFoldedStacks();
+  }
+  if (ImGui::IsItemHovered()) {
+    ImGui::SetTooltip("Save the samples as folded stacks for flamegraph.pl, "
+                      "speedscope or Perfetto.");
+  }
+  ImGui::SameLine();
+  ImGui::Dummy(ImVec2(8, 0));
+  ImGui::SameLine();
+  ImGui::RadioButton("Functions", &profiler_state.view,
+                     ImState::kProfilerViewFunctions);
+  ImGui::SameLine();
+  ImGui::RadioButton("Flame Graph", &profiler_state.view,
+                     ImState::kProfilerViewFlameGraph);
+
+  // Aggregating all the samples is too slow for every frame.
+  uint64_t host_ticks = Clock::QueryHostTickCount();
+  if (update_report ||
+      (profiler_->is_running() &&
+       host_ticks - profiler_state.report_host_ticks >=
+           Clock::QueryHostTickFrequency() / 2)) {
+    profiler_state.report = profiler_->CreateReport();
+    profiler_state.report_host_ticks = host_ticks;
+  }
+  ImGui::Text("%" PRIu64 " samples", profiler_state.report.sample_count);
+  ImGui::Separator();
+
+  switch (profiler_state.view) {
+    case ImState::kProfilerViewFunctions:
+      ImGui::BeginChild("##profiler_functions");
+      DrawProfilerFunctions();
+      ImGui::EndChild();
+      break;
+    case ImState::kProfilerViewFlameGraph:
+      ImGui::BeginChild("##profiler_flame_graph", ImVec2(0, 0), false,
+                        ImGuiWindowFlags_HorizontalScrollbar);
+      DrawFlameGraph();
+      ImGui::EndChild();
+      break;
+  }
+}
+
+void DebugWindow::DrawProfilerFunctions() {
+  const cpu::GuestProfiler::Report& report = state_.profiler.report;
+  if (!report.sample_count) {
+    return;
+  }
+  static const char* const kColumnNames[] = {"Self", "Self %", "Inclusive %",
+                                             "Function"};
+  ImGui::Columns(int(xe::countof(kColumnNames)));
+  for (const char* column_name : kColumnNames) {
+    ImGui::TextUnformatted(column_name);
+    ImGui::NextColumn();
+  }
+  ImGui::Separator();
+  // The tail is not interesting and is slow to draw.
+  constexpr size_t kMaxFunctionCount = 500;
+  double sample_percent = 100.0 / double(report.sample_count);
+  for (size_t i = 0; i < std::min(report.functions.size(), kMaxFunctionCount);
+       ++i) {
+    const cpu::GuestProfiler::FunctionSamples& function = report.functions[i];
+    ImGui::Text("%" PRIu64, function.self_samples);
+    ImGui::NextColumn();
+    ImGui::Text("%.2f", function.self_samples * sample_percent);
+    ImGui::NextColumn();
+    ImGui::Text("%.2f", function.inclusive_samples * sample_percent);
+    ImGui::NextColumn();
+    ImGui::PushID(int(i));
+    if (ImGui::Selectable(
+            profiler_->GetFunctionName(function.address).c_str()) &&
+        function.address != cpu::GuestProfiler::kHostCodeAddress) {
+      NavigateToFunction(processor_->LookupFunction(function.address),
+                         function.address);
+    }
+    ImGui::PopID();
+    ImGui::NextColumn();
+  }
+  ImGui::Columns(1);
+}
+
+void DebugWindow::DrawFlameGraph() {
+  const cpu::GuestProfiler::Report& report = state_.profiler.report;
+  if (!report.sample_count) {
+    return;
+  }
+  uint32_t depth = 0;
+  std::vector<const cpu::GuestProfiler::StackNode*> level(1, &report.root),
+      next_level;
+  while (!level.empty()) {
+    next_level.clear();
+    for (const cpu::GuestProfiler::StackNode* node : level) {
+      for (const cpu::GuestProfiler::StackNode& child : node->children) {
+        next_level.push_back(&child);
+      }
+    }
+    level.swap(next_level);
+    ++depth;
+  }
+  float width = std::max(ImGui::GetContentRegionAvail().x, 100.0f);
+  float row_height = ImGui::GetTextLineHeightWithSpacing();
+  ImVec2 position = ImGui::GetCursorScreenPos();
+  // The root isn't drawn, the outermost functions are at the top.
+  float x = position.x;
+  for (const cpu::GuestProfiler::StackNode& child : report.root.children) {
+    float child_width = width * float(child.samples) / report.sample_count;
+    DrawFlameGraphNode(child, ImVec2(x, position.y), child_width, row_height,
+                       report.sample_count);
+    x += child_width;
+  }
+  ImGui::Dummy(ImVec2(width, row_height * (depth - 1)));
+}
+
+void DebugWindow::DrawFlameGraphNode(const cpu::GuestProfiler::StackNode& node,
+                                     ImVec2 position, float width,
+                                     float row_height,
+                                     uint64_t total_samples) {
+  if (width < 1.0f) {
+    return;
+  }
+  ImDrawList* draw_list = ImGui::GetWindowDrawList();
+  ImVec2 max(position.x + width - 1.0f, position.y + row_height - 1.0f);
+  bool is_host_code = node.address == cpu::GuestProfiler::kHostCodeAddress;
+  // A stable warm color for each function.
+  uint32_t hash = node.address * 2654435761u;
+  ImU32 color =
+      is_host_code
+          ? IM_COL32(128, 128, 128, 255)
+          : IM_COL32(200 + (hash >> 27), 80 + ((hash >> 19) & 127),
+                     (hash >> 11) & 63, 255);
+  draw_list->AddRectFilled(position, max, color);
+  std::string name = profiler_->GetFunctionName(node.address);
+  if (width > 16.0f) {
+    draw_list->PushClipRect(position, max, true);
+    draw_list->AddText(ImVec2(position.x + 2.0f, position.y),
+                       IM_COL32(0, 0, 0, 255), name.c_str());
+    draw_list->PopClipRect();
+  }
+  if (ImGui::IsMouseHoveringRect(position, max)) {
+    ImGui::SetTooltip("%s\n%" PRIu64 " samples, %.2f%%", name.c_str(),
+                      node.samples, 100.0 * node.samples / total_samples);
+    if (ImGui::IsMouseClicked(0) && !is_host_code) {
+      NavigateToFunction(processor_->LookupFunction(node.address),
+                         node.address);
+    }
+  }
+  float x = position.x;
+  for (const cpu::GuestProfiler::StackNode& child : node.children) {
+    float child_width = width * float(child.samples) / node.samples;
+    DrawFlameGraphNode(child, ImVec2(x, position.y + row_height), child_width,
+                       row_height, total_samples);
+    x += child_width;
+  }
+}
+
+void DebugWindow::ExportProfilerFoldedStacks() {
+  auto file_picker = xe::ui::FilePicker::Create();
+  file_picker->set_mode(xe::ui::FilePicker::Mode::kSave);
+  file_picker->set_type(xe::ui::FilePicker::Type::kFile);
+  file_picker->set_multi_selection(false);
+  file_picker->set_file_name("guest_profile");
+  file_picker->set_default_extension("folded");
+  file_picker->set_title("Export Folded Stacks");
+  file_picker->set_extensions({
+      {"Folded Stacks (*.folded)", "*.folded"},
+      {"All Files (*.*)", "*.*"},
+  });
+  if (file_picker->Show(window_.get()) &&
+      !file_picker->selected_files().empty()) {
+    profiler_->WriteFoldedStacks(file_picker->selected_files().front());
+  }
+}
+
 void DebugWindow::DrawBreakpointsPane() {
   auto& state = state_.breakpoints;
 
@@ -1568,6 +1777,9 @@ Breakpoint* DebugWindow::LookupBreakpointAtAddress(
 void DebugWindow::OnFocus() { Focus(); }
 
 void DebugWindow::OnDetached() {
+  if (profiler_) {
+    profiler_->Stop();
+  }
   UpdateCache();
 
   // Remove all breakpoints.
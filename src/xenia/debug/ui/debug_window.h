@@ -16,6 +16,7 @@
 #include "xenia/base/host_thread_context.h"
 #include "xenia/cpu/breakpoint.h"
 #include "xenia/cpu/debug_listener.h"
+#include "xenia/cpu/guest_profiler.h"
 #include "xenia/cpu/processor.h"
 #include "xenia/emulator.h"
 #include "xenia/ui/imgui_dialog.h"
@@ -86,6 +87,13 @@ class DebugWindow : public cpu::DebugListener {
   bool DrawRegisterTextBoxes(int id, float* value);
   void DrawThreadsPane();
   void DrawMemoryPane();
+  void DrawProfilerPane();
+  void DrawProfilerFunctions();
+  void DrawFlameGraph();
+  void DrawFlameGraphNode(const cpu::GuestProfiler::StackNode& node,
+                          ImVec2 position, float width, float row_height,
+                          uint64_t total_samples);
+  void ExportProfilerFoldedStacks();
   void DrawBreakpointsPane();
   void DrawLogPane();
 
@@ -117,6 +125,9 @@ class DebugWindow : public cpu::DebugListener {
 
   uintptr_t capstone_handle_ = 0;
 
+  // Created when the profiler pane is opened.
+  std::unique_ptr<cpu::GuestProfiler> profiler_;
+
   // Cached debugger data, updated on every break before a frame is drawn.
   // Prefer putting stuff here that will be queried either each frame or
   // multiple times per frame to avoid expensive redundant work.
@@ -139,6 +150,7 @@ class DebugWindow : public cpu::DebugListener {
   struct ImState {
     static const int kRightPaneThreads = 0;
     static const int kRightPaneMemory = 1;
+    static const int kRightPaneProfiler = 2;
     int right_pane_tab = kRightPaneThreads;
 
     cpu::ThreadDebugInfo* thread_info = nullptr;
@@ -163,6 +175,15 @@ class DebugWindow : public cpu::DebugListener {
     } breakpoints;
 
     xe::kernel::XThread* isolated_log_thread = nullptr;
+
+    static const int kProfilerViewFunctions = 0;
+    static const int kProfilerViewFlameGraph = 1;
+    struct {
+      int view = kProfilerViewFunctions;
+      // Refreshed periodically while sampling.
+      cpu::GuestProfiler::Report report;
+      uint64_t report_host_ticks = 0;
+    } profiler;
   } state_;
 };
 
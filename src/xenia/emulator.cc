@@ -11,6 +11,11 @@
 
 #include <algorithm>
 #include <cinttypes>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
 
 #include "config.h"
 #include "third_party/fmt/include/fmt/format.h"
@@ -25,16 +30,19 @@
 #include "xenia/base/cvar.h"
 #include "xenia/base/debugging.h"
 #include "xenia/base/exception_handler.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/mapped_memory.h"
 #include "xenia/base/platform.h"
+#include "xenia/base/startup_timeline.h"
 #include "xenia/base/string.h"
 #include "xenia/base/system.h"
 #include "xenia/cpu/backend/code_cache.h"
 #include "xenia/cpu/backend/null_backend.h"
 #include "xenia/cpu/cpu_flags.h"
 #include "xenia/cpu/thread_state.h"
+#include "xenia/emulator_benchmark.h"
 #include "xenia/gpu/command_processor.h"
 #include "xenia/gpu/graphics_system.h"
 #include "xenia/hid/input_driver.h"
@@ -47,6 +55,8 @@
 #include "xenia/kernel/xbdm/xbdm_module.h"
 #include "xenia/kernel/xboxkrnl/xboxkrnl_module.h"
 #include "xenia/memory.h"
+#include "xenia/metrics_server.h"
+#include "xenia/performance_governor.h"
 #include "xenia/ui/file_picker.h"
 #include "xenia/ui/imgui_dialog.h"
 #include "xenia/ui/imgui_drawer.h"
@@ -54,6 +64,7 @@
 #include "xenia/ui/window.h"
 #include "xenia/ui/windowed_app_context.h"
 #include "xenia/vfs/device.h"
+#include "xenia/vfs/devices/compressed_disc_image_device.h"
 #include "xenia/vfs/devices/disc_image_device.h"
 #include "xenia/vfs/devices/disc_zarchive_device.h"
 #include "xenia/vfs/devices/host_path_device.h"
@@ -82,6 +93,19 @@ DEFINE_bool(allow_game_relative_writes, false,
             "generating test data to compare with original hardware. ",
             "General");
 
+DEFINE_bool(incremental_save_states, false,
+            "Store only the guest memory pages changed since the previous save "
+            "state, which the new one refers to for the rest, compressed after "
+            "resuming the emulation. The previous save states must be kept, "
+            "and saving to the file of any of them makes the new one full.",
+            "General");
+
+DEFINE_bool(warm_title_relaunch, true,
+            "When launching a title again from the same unchanged file, keep "
+            "its mounted device and, for the same title, its open shader "
+            "storage with everything loaded from it, to relaunch faster.",
+            "General");
+
 DECLARE_int32(user_language);
 
 DECLARE_bool(allow_plugins);
@@ -150,6 +174,12 @@ Emulator::Emulator(const std::filesystem::path& command_line,
 }
 
 Emulator::~Emulator() {
+  WaitForSaveStateWriter();
+
+  benchmark_.reset();
+  metrics_server_.reset();
+  performance_governor_.reset();
+
   // Note that we delete things in the reverse order they were initialized.
 
   // Give the systems time to shutdown before we delete them.
@@ -183,6 +213,7 @@ X_STATUS Emulator::Setup(
         graphics_system_factory,
     std::function<std::vector<std::unique_ptr<hid::InputDriver>>(ui::Window*)>
         input_driver_factory) {
+  StartupTimelinePhase startup_phase("Emulator::Setup");
   X_STATUS result = X_STATUS_UNSUCCESSFUL;
 
   display_window_ = display_window;
@@ -200,6 +231,18 @@ X_STATUS Emulator::Setup(
   // logical processors.
   xe::threading::EnableAffinityConfiguration();
 
+  // The subsystems are mostly brought up in the order of their dependencies:
+  // memory -> processor -> audio, and the processor, the kernel state and the
+  // VFS -> graphics. However, creating the host graphics device takes a
+  // significant amount of time and doesn't depend on anything, so it's done on
+  // another thread while everything before the graphics system setup is being
+  // initialized.
+  graphics_system_ = graphics_system_factory();
+  if (!graphics_system_) {
+    return X_STATUS_NOT_IMPLEMENTED;
+  }
+  graphics_system_->BeginProviderCreation(display_window_ != nullptr);
+
   // Create memory system first, as it is required for other systems.
   memory_ = std::make_unique<Memory>();
   if (!memory_->Initialize()) {
@@ -241,12 +284,6 @@ X_STATUS Emulator::Setup(
     }
   }
 
-  // Initialize the GPU.
-  graphics_system_ = graphics_system_factory();
-  if (!graphics_system_) {
-    return X_STATUS_NOT_IMPLEMENTED;
-  }
-
   // Initialize the HID.
   input_system_ = std::make_unique<xe::hid::InputSystem>(display_window_);
   if (!input_system_) {
@@ -261,6 +298,11 @@ X_STATUS Emulator::Setup(
       input_system_->AddDriver(std::move(input_driver));
     }
   }
+  std::unique_ptr<hid::InputDriver> input_script_driver =
+      EmulatorBenchmark::CreateInputScriptDriver(this);
+  if (input_script_driver) {
+    input_system_->AddDriver(std::move(input_script_driver));
+  }
 
   result = input_system_->Setup();
   if (result) {
@@ -300,6 +342,12 @@ X_STATUS Emulator::Setup(
     }
   }
 
+  if (MetricsServer::IsRequested()) {
+    // Not fatal, the emulation doesn't depend on it.
+    metrics_server_ = MetricsServer::Create(this);
+  }
+  performance_governor_ = PerformanceGovernor::Create(this);
+
   // Initialize emulator fallback exception handling last.
   ExceptionHandler::Install(Emulator::ExceptionCallbackThunk, this);
 
@@ -311,7 +359,9 @@ X_STATUS Emulator::TerminateTitle() {
     return X_STATUS_UNSUCCESSFUL;
   }
 
+  benchmark_.reset();
   kernel_state_->TerminateTitle();
+  file_system_->access_trace().Stop();
   title_id_ = std::nullopt;
   title_name_ = "";
   title_version_ = "";
@@ -342,6 +392,10 @@ const std::unique_ptr<vfs::Device> Emulator::CreateVfsDevice(
     case FileSignatureType::ZAR: {
       return std::make_unique<vfs::DiscZarchiveDevice>(mount_path, path);
     } break;
+    case FileSignatureType::XCZ: {
+      return std::make_unique<vfs::CompressedDiscImageDevice>(mount_path,
+                                                              path);
+    } break;
     case FileSignatureType::EXE:
     case FileSignatureType::Unknown:
     default:
@@ -407,6 +461,12 @@ X_STATUS Emulator::MountPath(const std::filesystem::path& path,
     return X_STATUS_NO_SUCH_FILE;
   }
 
+  RegisterTitleSymbolicLinks(mount_path);
+
+  return X_STATUS_SUCCESS;
+}
+
+void Emulator::RegisterTitleSymbolicLinks(const std::string_view mount_path) {
   file_system_->UnregisterSymbolicLink(kDefaultPartitionSymbolicLink);
   file_system_->UnregisterSymbolicLink(kDefaultGameSymbolicLink);
   file_system_->UnregisterSymbolicLink("plugins:");
@@ -414,8 +474,6 @@ X_STATUS Emulator::MountPath(const std::filesystem::path& path,
   // Create symlinks to the device.
   file_system_->RegisterSymbolicLink(kDefaultGameSymbolicLink, mount_path);
   file_system_->RegisterSymbolicLink(kDefaultPartitionSymbolicLink, mount_path);
-
-  return X_STATUS_SUCCESS;
 }
 
 Emulator::FileSignatureType Emulator::GetFileSignature(
@@ -454,6 +512,8 @@ Emulator::FileSignatureType Emulator::GetFileSignature(
       return FileSignatureType::PIRS;
     case xe::vfs::kXSFSignature:
       return FileSignatureType::XISO;
+    case xe::vfs::kCompressedDiscImageSignature:
+      return FileSignatureType::XCZ;
     case xe::cpu::kElfSignature:
       return FileSignatureType::ELF;
     default:
@@ -491,28 +551,90 @@ Emulator::FileSignatureType Emulator::GetFileSignature(
   return FileSignatureType::Unknown;
 }
 
+bool Emulator::IsTitleFileMounted(const std::filesystem::path& path,
+                                  const std::string_view mount_path) {
+  if (!mounted_title_file_ || mounted_title_file_->path != path ||
+      (!mount_path.empty() && mounted_title_file_->mount_path != mount_path)) {
+    return false;
+  }
+  std::error_code ec;
+  std::filesystem::file_time_type write_time =
+      std::filesystem::last_write_time(path, ec);
+  if (ec || write_time != mounted_title_file_->write_time) {
+    return false;
+  }
+  uintmax_t size = std::filesystem::file_size(path, ec);
+  if (ec || size != mounted_title_file_->size) {
+    return false;
+  }
+  return file_system_->ResolvePath(mounted_title_file_->mount_path) != nullptr;
+}
+
+X_STATUS Emulator::MountTitleFile(const std::filesystem::path& path,
+                                  FileSignatureType signature,
+                                  const std::string_view mount_path) {
+  StartupTimelinePhase startup_phase("MountPath");
+  if (cvars::warm_title_relaunch && IsTitleFileMounted(path, mount_path)) {
+    XELOGI("Keeping {} mounted to {}", xe::path_to_utf8(path), mount_path);
+    RegisterTitleSymbolicLinks(mount_path);
+    return X_STATUS_SUCCESS;
+  }
+
+  // A device left from the previous title would take precedence over the new
+  // one.
+  mounted_title_file_.reset();
+  if (file_system_->ResolvePath(mount_path)) {
+    file_system_->UnregisterDevice(mount_path);
+  }
+  X_STATUS mount_result = MountPath(path, mount_path);
+  if (mount_result) {
+    return mount_result;
+  }
+
+  MountedTitleFile mounted_title_file;
+  mounted_title_file.path = path;
+  mounted_title_file.mount_path = mount_path;
+  mounted_title_file.signature = signature;
+  std::error_code write_time_ec, size_ec;
+  mounted_title_file.write_time =
+      std::filesystem::last_write_time(path, write_time_ec);
+  mounted_title_file.size = std::filesystem::file_size(path, size_ec);
+  if (!write_time_ec && !size_ec) {
+    mounted_title_file_ = std::move(mounted_title_file);
+  }
+  return X_STATUS_SUCCESS;
+}
+
 X_STATUS Emulator::LaunchPath(const std::filesystem::path& path) {
   X_STATUS mount_result = X_STATUS_SUCCESS;
 
-  switch (GetFileSignature(path)) {
+  // Detecting the signature of a disc image involves parsing it as a whole.
+  FileSignatureType signature =
+      cvars::warm_title_relaunch && IsTitleFileMounted(path)
+          ? mounted_title_file_->signature
+          : GetFileSignature(path);
+
+  switch (signature) {
     case FileSignatureType::XEX1:
     case FileSignatureType::XEX2:
     case FileSignatureType::ELF: {
-      mount_result = MountPath(path, "\\Device\\Harddisk0\\Partition1");
+      mount_result = MountTitleFile(path, signature,
+                                    "\\Device\\Harddisk0\\Partition1");
       return mount_result ? mount_result : LaunchXexFile(path);
     } break;
     case FileSignatureType::LIVE:
     case FileSignatureType::CON:
     case FileSignatureType::PIRS: {
-      mount_result = MountPath(path, "\\Device\\Cdrom0");
+      mount_result = MountTitleFile(path, signature, "\\Device\\Cdrom0");
       return mount_result ? mount_result : LaunchStfsContainer(path);
     } break;
-    case FileSignatureType::XISO: {
-      mount_result = MountPath(path, "\\Device\\Cdrom0");
+    case FileSignatureType::XISO:
+    case FileSignatureType::XCZ: {
+      mount_result = MountTitleFile(path, signature, "\\Device\\Cdrom0");
       return mount_result ? mount_result : LaunchDiscImage(path);
     } break;
     case FileSignatureType::ZAR: {
-      mount_result = MountPath(path, "\\Device\\Cdrom0");
+      mount_result = MountTitleFile(path, signature, "\\Device\\Cdrom0");
       return mount_result ? mount_result : LaunchDiscArchive(path);
     } break;
     case FileSignatureType::EXE:
@@ -839,11 +961,95 @@ X_STATUS Emulator::ExtractZarchivePackage(
   return vfs::VirtualFileSystem::ExtractContentFiles(device.get(), extract_dir);
 }
 
+namespace {
+
+// Reads the files to pack on a separate thread, so reading the input overlaps
+// the compression done by the zarchive writer on the calling thread.
+class ZarchiveInputReader {
+ public:
+  static constexpr size_t kChunkSize = 4_MiB;
+  static constexpr size_t kMaxQueuedChunks = 4;
+
+  struct Chunk {
+    std::vector<uint8_t> data;
+    // The last chunk of the file, possibly empty.
+    bool last;
+    bool failed;
+  };
+
+  explicit ZarchiveInputReader(std::vector<std::filesystem::path> paths)
+      : paths_(std::move(paths)), thread_([this]() { ReadFiles(); }) {}
+  ~ZarchiveInputReader() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cancelled_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+  }
+
+  // Returns the chunks of all the files in order.
+  Chunk Pop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this]() { return !chunks_.empty(); });
+    Chunk chunk = std::move(chunks_.front());
+    chunks_.pop_front();
+    cond_.notify_all();
+    return chunk;
+  }
+
+ private:
+  void ReadFiles() {
+    for (const std::filesystem::path& path : paths_) {
+      FILE* file = xe::filesystem::OpenFile(path, "rb");
+      bool last = false;
+      while (!last) {
+        Chunk chunk;
+        chunk.data.resize(kChunkSize);
+        size_t bytes_read =
+            file ? fread(chunk.data.data(), 1, kChunkSize, file) : 0;
+        chunk.data.resize(bytes_read);
+        chunk.failed = !file || ferror(file);
+        chunk.last = chunk.failed || bytes_read < kChunkSize;
+        last = chunk.last;
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this]() {
+          return cancelled_ || chunks_.size() < kMaxQueuedChunks;
+        });
+        if (cancelled_) {
+          last = true;
+          break;
+        }
+        chunks_.push_back(std::move(chunk));
+        cond_.notify_all();
+      }
+      if (file) {
+        fclose(file);
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (cancelled_) {
+        return;
+      }
+    }
+  }
+
+  std::vector<std::filesystem::path> paths_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<Chunk> chunks_;
+  bool cancelled_ = false;
+  // Started last, once everything it uses is initialized.
+  std::thread thread_;
+};
+
+}  // namespace
+
 X_STATUS Emulator::CreateZarchivePackage(
     const std::filesystem::path& inputDirectory,
-    const std::filesystem::path& outputFile) {
-  std::vector<uint8_t> buffer;
-  buffer.resize(64 * 1024);
+    const std::filesystem::path& outputFile,
+    ZarchivePackStatistics* statistics_out) {
+  const uint64_t start_host_ticks = Clock::QueryHostTickCount();
+  const uint64_t host_tick_frequency = Clock::QueryHostTickFrequency();
 
   std::error_code ec;
   PackContext packContext;
@@ -865,6 +1071,7 @@ X_STATUS Emulator::CreateZarchivePackage(
         PackContext* packContext = reinterpret_cast<PackContext*>(ctx);
         packContext->currentOutputFile.write(
             reinterpret_cast<const char*>(data), length);
+        packContext->writtenSize += length;
       },
       &packContext);
 
@@ -872,6 +1079,15 @@ X_STATUS Emulator::CreateZarchivePackage(
     return X_STATUS_UNSUCCESSFUL;
   }
 
+  // Gather the entries first, so the files can be read ahead of the
+  // compression.
+  struct PackEntry {
+    std::filesystem::path path;
+    bool is_directory;
+  };
+  std::vector<PackEntry> entries;
+  std::vector<std::filesystem::path> file_paths;
+  uint64_t input_size = 0;
   for (auto const& dirEntry :
        std::filesystem::recursive_directory_iterator(inputDirectory)) {
     std::filesystem::path pathEntry =
@@ -883,45 +1099,59 @@ X_STATUS Emulator::CreateZarchivePackage(
     }
 
     if (dirEntry.is_directory()) {
-      if (!zWriter.MakeDir(pathEntry.generic_string().c_str(), false)) {
-        XELOGI("Failed to create directory {}\n", pathEntry.string());
-        return X_STATUS_UNSUCCESSFUL;
-      }
+      entries.push_back({pathEntry, true});
     } else if (dirEntry.is_regular_file()) {
       // Don't pack itself to prevent infinite packing.
       if (dirEntry == outputFile) {
         continue;
       }
+      entries.push_back({pathEntry, false});
+      file_paths.push_back(inputDirectory / pathEntry);
+      input_size += dirEntry.file_size(ec);
+    }
+  }
 
-      XELOGI("Adding file: {}\n", pathEntry.string());
-
-      if (!zWriter.StartNewFile(pathEntry.generic_string().c_str())) {
-        XELOGI("Failed to create archive file {}\n", pathEntry.string());
+  ZarchiveInputReader input_reader(std::move(file_paths));
+  uint64_t packed_size = 0;
+  uint64_t last_report_host_ticks = start_host_ticks;
+  auto get_throughput = [&](uint64_t host_ticks) {
+    double seconds = double(host_ticks - start_host_ticks) /
+                     double(host_tick_frequency);
+    return seconds > 0.0 ? double(packed_size) / double(1_MiB) / seconds
+                         : 0.0;
+  };
+  for (const PackEntry& entry : entries) {
+    if (entry.is_directory) {
+      if (!zWriter.MakeDir(entry.path.generic_string().c_str(), false)) {
+        XELOGI("Failed to create directory {}\n", entry.path.string());
         return X_STATUS_UNSUCCESSFUL;
       }
+      continue;
+    }
+
+    XELOGI("Adding file: {}\n", entry.path.string());
 
-      std::filesystem::path file_to_pack_path = inputDirectory / pathEntry;
-      FILE* file = xe::filesystem::OpenFile(file_to_pack_path, "rb");
+    if (!zWriter.StartNewFile(entry.path.generic_string().c_str())) {
+      XELOGI("Failed to create archive file {}\n", entry.path.string());
+      return X_STATUS_UNSUCCESSFUL;
+    }
 
-      if (!file) {
-        XELOGI("Failed to open input file {}\n", pathEntry.string());
+    ZarchiveInputReader::Chunk chunk;
+    do {
+      chunk = input_reader.Pop();
+      if (chunk.failed) {
+        XELOGI("Failed to read input file {}\n", entry.path.string());
         return X_STATUS_UNSUCCESSFUL;
       }
-
-      const uint64_t file_size = std::filesystem::file_size(file_to_pack_path);
-      uint64_t total_bytes_read = 0;
-
-      while (total_bytes_read < file_size) {
-        uint64_t bytes_read =
-            fread_s(buffer.data(), buffer.size(), 1, buffer.size(), file);
-
-        total_bytes_read += bytes_read;
-
-        zWriter.AppendData(buffer.data(), bytes_read);
+      zWriter.AppendData(chunk.data.data(), chunk.data.size());
+      packed_size += chunk.data.size();
+      uint64_t host_ticks = Clock::QueryHostTickCount();
+      if (host_ticks - last_report_host_ticks >= host_tick_frequency) {
+        last_report_host_ticks = host_ticks;
+        XELOGI("Packed {} of {} MB, {:.1f} MB/s", packed_size / 1_MiB,
+               input_size / 1_MiB, get_throughput(host_ticks));
       }
-
-      fclose(file);
-    }
+    } while (!chunk.last);
 
     if (packContext.hasError) {
       return X_STATUS_UNSUCCESSFUL;
@@ -929,6 +1159,21 @@ X_STATUS Emulator::CreateZarchivePackage(
   }
 
   zWriter.Finalize();
+  packContext.currentOutputFile.flush();
+  if (!packContext.currentOutputFile) {
+    XELOGI("Failed to write output file: {}\n", outputFile.string());
+    return X_STATUS_UNSUCCESSFUL;
+  }
+
+  uint64_t end_host_ticks = Clock::QueryHostTickCount();
+  XELOGI("Packed {} MB into {} MB at {:.1f} MB/s", packed_size / 1_MiB,
+         packContext.writtenSize / 1_MiB, get_throughput(end_host_ticks));
+  if (statistics_out) {
+    statistics_out->input_size = packed_size;
+    statistics_out->output_size = packContext.writtenSize;
+    statistics_out->seconds = double(end_host_ticks - start_host_ticks) /
+                              double(host_tick_frequency);
+  }
 
   return X_STATUS_SUCCESS;
 }
@@ -989,7 +1234,17 @@ void Emulator::Resume() {
   }
 }
 
+void Emulator::WaitForSaveStateWriter() {
+  if (save_state_writer_thread_) {
+    threading::Wait(save_state_writer_thread_.get(), false);
+    save_state_writer_thread_.reset();
+  }
+}
+
 bool Emulator::SaveToFile(const std::filesystem::path& path) {
+  // The memory snapshot the next one refers to must be complete.
+  WaitForSaveStateWriter();
+
   Pause();
 
   filesystem::CreateEmptyFile(path);
@@ -1012,14 +1267,46 @@ bool Emulator::SaveToFile(const std::filesystem::path& path) {
   graphics_system_->Save(&stream);
   audio_system_->Save(&stream);
   kernel_state_->Save(&stream);
-  memory_->Save(&stream);
-  map->Close(stream.offset());
+  if (!cvars::incremental_save_states) {
+    memory_->Save(&stream);
+    map->Close(stream.offset());
 
+    Resume();
+    return true;
+  }
+
+  // Only the changed pages are copied while the guest is paused, they're
+  // compressed and appended to the file afterwards.
+  uint64_t memory_offset = stream.offset();
+  std::shared_ptr<MemorySnapshot> snapshot =
+      memory_->CaptureSnapshot(path, memory_offset);
+  map->Close(memory_offset);
   Resume();
+
+  auto write_snapshot = [this, path, snapshot]() {
+    FILE* file = filesystem::OpenFile(path, "ab");
+    bool is_written = file && snapshot->Write(file);
+    if (file) {
+      fclose(file);
+    }
+    if (!is_written) {
+      XELOGE("Failed to write the memory snapshot to {}",
+             xe::path_to_utf8(path));
+      memory_->ResetSnapshotChain();
+    }
+  };
+  save_state_writer_thread_ = threading::Thread::Create({}, write_snapshot);
+  if (save_state_writer_thread_) {
+    save_state_writer_thread_->set_name("Save State Writer");
+  } else {
+    write_snapshot();
+  }
   return true;
 }
 
 bool Emulator::RestoreFromFile(const std::filesystem::path& path) {
+  WaitForSaveStateWriter();
+
   // Restore the emulator state from a file
   auto map = MappedMemory::Open(path, MappedMemory::Mode::kReadWrite);
   if (!map) {
@@ -1336,6 +1623,7 @@ static std::string format_version(xex2_version version) {
 
 X_STATUS Emulator::CompleteLaunch(const std::filesystem::path& path,
                                   const std::string_view module_path) {
+  StartupTimelinePhase startup_phase("Emulator::CompleteLaunch");
   // Making changes to the UI (setting the icon) and executing game config
   // load callbacks which expect to be called from the UI thread.
   assert_true(display_window_->app_context().IsInUIThread());
@@ -1355,6 +1643,9 @@ X_STATUS Emulator::CompleteLaunch(const std::filesystem::path& path,
                      std::string("\\Cache1")};
   auto null_device =
       std::make_unique<vfs::NullDevice>("\\Device\\Harddisk0", null_paths);
+  // Replacing the one registered by the previous launch, if any, to keep it
+  // after the partition device.
+  file_system_->UnregisterDevice("\\Device\\Harddisk0");
   if (null_device->Initialize()) {
     file_system_->RegisterDevice(std::move(null_device));
   }
@@ -1375,16 +1666,46 @@ X_STATUS Emulator::CompleteLaunch(const std::filesystem::path& path,
     return X_STATUS_NOT_FOUND;
   }
 
+  if (module->title_id()) {
+    // Load the per-game configuration file and make sure updates are handled
+    // by the callbacks - before anything depending on the per-game options,
+    // such as the shader storage and patching, is done.
+    config::LoadGameConfig(fmt::format("{:08X}", module->title_id()));
+    assert_true(game_config_load_callback_loop_next_index_ == SIZE_MAX);
+    game_config_load_callback_loop_next_index_ = 0;
+    while (game_config_load_callback_loop_next_index_ <
+           game_config_load_callbacks_.size()) {
+      game_config_load_callbacks_[game_config_load_callback_loop_next_index_++]
+          ->PostGameConfigLoad();
+    }
+    game_config_load_callback_loop_next_index_ = SIZE_MAX;
+  }
+
+  // The shader storage is loaded on the GPU thread while the title update is
+  // applied and the module is patched and finished, but it is waited for
+  // before launching the module so the user doesn't miss the initial seconds -
+  // for instance, sound from an intro video may start playing before the
+  // video can be seen if doing this in parallel with the title.
+  on_shader_storage_initialization(true);
+  graphics_system_->BeginShaderStorageInitialization(cache_root_,
+                                                     module->title_id());
+  auto end_shader_storage_initialization = [this]() {
+    graphics_system_->WaitForShaderStorageInitialization();
+    on_shader_storage_initialization(false);
+  };
+
   X_RESULT result = kernel_state_->ApplyTitleUpdate(module);
   if (XFAILED(result)) {
     XELOGE("Failed to apply title update! Cannot run module {}",
            xe::path_to_utf8(path));
+    end_shader_storage_initialization();
     return result;
   }
 
   result = kernel_state_->FinishLoadingUserModule(module);
   if (XFAILED(result)) {
     XELOGE("Failed to initialize user module {}", xe::path_to_utf8(path));
+    end_shader_storage_initialization();
     return result;
   }
   // Grab the current title ID.
@@ -1411,20 +1732,6 @@ X_STATUS Emulator::CompleteLaunch(const std::filesystem::path& path,
 
   // Try and load the resource database (xex only).
   if (module->title_id()) {
-    auto title_id = fmt::format("{:08X}", module->title_id());
-
-    // Load the per-game configuration file and make sure updates are handled
-    // by the callbacks.
-    config::LoadGameConfig(title_id);
-    assert_true(game_config_load_callback_loop_next_index_ == SIZE_MAX);
-    game_config_load_callback_loop_next_index_ = 0;
-    while (game_config_load_callback_loop_next_index_ <
-           game_config_load_callbacks_.size()) {
-      game_config_load_callbacks_[game_config_load_callback_loop_next_index_++]
-          ->PostGameConfigLoad();
-    }
-    game_config_load_callback_loop_next_index_ = SIZE_MAX;
-
     const kernel::util::XdbfGameData db = kernel_state_->module_xdbf(module);
 
     game_info_database_ = std::make_unique<kernel::util::GameInfoDatabase>(&db);
@@ -1491,14 +1798,13 @@ X_STATUS Emulator::CompleteLaunch(const std::filesystem::path& path,
     }
   }
 
-  // Initializing the shader storage in a blocking way so the user doesn't
-  // miss the initial seconds - for instance, sound from an intro video may
-  // start playing before the video can be seen if doing this in parallel with
-  // the main thread.
-  on_shader_storage_initialization(true);
-  graphics_system_->InitializeShaderStorage(cache_root_, title_id_.value(),
-                                            true);
-  on_shader_storage_initialization(false);
+  if (!cache_root_.empty()) {
+    file_system_->access_trace().Start(
+        cache_root_ / "file_access" /
+        fmt::format("{:08X}.bin", title_id_.value()));
+  }
+
+  end_shader_storage_initialization();
 
   auto main_thread = kernel_state_->LaunchModule(module);
   if (!main_thread) {
@@ -1507,6 +1813,11 @@ X_STATUS Emulator::CompleteLaunch(const std::filesystem::path& path,
   main_thread_ = main_thread;
   on_launch(title_id_.value(), title_name_);
 
+  if (EmulatorBenchmark::IsRequested()) {
+    benchmark_ = std::make_unique<EmulatorBenchmark>(this);
+    benchmark_->Start();
+  }
+
   // Plugins must be loaded after calling LaunchModule() and
   // FinishLoadingUserModule() which will apply TUs and patching to the main
   // xex.
@@ -12,6 +12,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <filesystem>
 #include <functional>
 #include <optional>
 #include <string>
@@ -30,6 +31,9 @@
 #include "xenia/xbox.h"
 
 namespace xe {
+class EmulatorBenchmark;
+class MetricsServer;
+class PerformanceGovernor;
 namespace apu {
 class AudioSystem;
 }  // namespace apu
@@ -198,6 +202,7 @@ class Emulator {
     PIRS,
     XISO,
     ZAR,
+    XCZ,
     EXE,
     Unknown
   };
@@ -205,6 +210,11 @@ class Emulator {
   // Determine the executable signature
   FileSignatureType GetFileSignature(const std::filesystem::path& path);
 
+  // Whether the file the current or the last title was launched from is still
+  // mounted (to mount_path if not empty) and hasn't been modified since.
+  bool IsTitleFileMounted(const std::filesystem::path& path,
+                          const std::string_view mount_path = {});
+
   // Launches a game from the given file path.
   // This will attempt to infer the type of the given file (such as an iso, etc)
   // using heuristics.
@@ -243,13 +253,22 @@ class Emulator {
       const std::filesystem::path& path,
       const std::filesystem::path& extract_dir);
 
+  struct ZarchivePackStatistics {
+    uint64_t input_size;
+    uint64_t output_size;
+    double seconds;
+  };
+
   // Pack contents of a folder into a zar package.
-  X_STATUS CreateZarchivePackage(const std::filesystem::path& inputDirectory,
-                                 const std::filesystem::path& outputFile);
+  X_STATUS CreateZarchivePackage(
+      const std::filesystem::path& inputDirectory,
+      const std::filesystem::path& outputFile,
+      ZarchivePackStatistics* statistics_out = nullptr);
 
   struct PackContext {
     std::filesystem::path outputFilePath;
     std::ofstream currentOutputFile;
+    uint64_t writtenSize{0};
     bool hasError{false};
   };
 
@@ -270,6 +289,8 @@ class Emulator {
   xe::Delegate<> on_patch_apply;
   xe::Delegate<> on_terminate;
   xe::Delegate<> on_exit;
+  // Called from the benchmark thread once the results have been written.
+  xe::Delegate<> on_benchmark_complete;
 
  private:
   enum : uint64_t { EmulatorFlagDisclaimerAcknowledged = 1ULL << 0 };
@@ -281,11 +302,20 @@ class Emulator {
   void AddGameConfigLoadCallback(GameConfigLoadCallback* callback);
   void RemoveGameConfigLoadCallback(GameConfigLoadCallback* callback);
 
+  void WaitForSaveStateWriter();
+
   std::string FindLaunchModule();
 
   X_STATUS CompleteLaunch(const std::filesystem::path& path,
                           const std::string_view module_path);
 
+  // Mounts the file a title is launched from, or keeps it mounted if
+  // relaunching from it.
+  X_STATUS MountTitleFile(const std::filesystem::path& path,
+                          FileSignatureType signature,
+                          const std::string_view mount_path);
+  void RegisterTitleSymbolicLinks(const std::string_view mount_path);
+
   std::filesystem::path command_line_;
   std::filesystem::path storage_root_;
   std::filesystem::path content_root_;
@@ -294,6 +324,15 @@ class Emulator {
   std::string title_name_;
   std::string title_version_;
 
+  struct MountedTitleFile {
+    std::filesystem::path path;
+    std::string mount_path;
+    FileSignatureType signature;
+    std::filesystem::file_time_type write_time;
+    uintmax_t size;
+  };
+  std::optional<MountedTitleFile> mounted_title_file_;
+
   ui::Window* display_window_ = nullptr;
   ui::ImGuiDrawer* imgui_drawer_ = nullptr;
 
@@ -311,6 +350,10 @@ class Emulator {
 
   std::unique_ptr<kernel::KernelState> kernel_state_;
 
+  std::unique_ptr<EmulatorBenchmark> benchmark_;
+  std::unique_ptr<MetricsServer> metrics_server_;
+  std::unique_ptr<PerformanceGovernor> performance_governor_;
+
   // Accessible only from the thread that invokes those callbacks (the UI thread
   // if the UI is available).
   std::vector<GameConfigLoadCallback*> game_config_load_callbacks_;
@@ -328,6 +371,8 @@ class Emulator {
   bool paused_;
   bool restoring_;
   threading::Fence restore_fence_;  // Fired on restore finish.
+  // Writing the memory of the last incremental save state.
+  std::unique_ptr<threading::Thread> save_state_writer_thread_;
 };
 
 }  // namespace xe
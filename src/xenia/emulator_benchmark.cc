@@ -0,0 +1,469 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/emulator_benchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "xenia/apu/audio_system.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/math.h"
+#include "xenia/base/string.h"
+#include "xenia/cpu/processor.h"
+#include "xenia/emulator.h"
+#include "xenia/gpu/graphics_system.h"
+#include "xenia/hid/input.h"
+#include "xenia/hid/input_driver.h"
+#include "xenia/kernel/kernel_state.h"
+
+DEFINE_uint32(benchmark_frames, 0,
+              "Number of guest frames to measure the performance of the title "
+              "over after launching it, then write the results and exit.",
+              "General");
+DEFINE_uint32(benchmark_seconds, 0,
+              "Number of seconds to measure the performance of the title over "
+              "after launching it, then write the results and exit. The "
+              "benchmark ends at whichever of benchmark_frames and "
+              "benchmark_seconds is reached first.",
+              "General");
+DEFINE_uint32(benchmark_warmup_frames, 0,
+              "Number of guest frames since the launch to skip before starting "
+              "the benchmark.",
+              "General");
+DEFINE_path(benchmark_output_path, "benchmark.json",
+            "Path to write the benchmark results to as JSON. The times of "
+            "every frame are written to a CSV file with the same name.",
+            "General");
+DEFINE_uint32(benchmark_frame_hash_interval, 0,
+              "Read back and hash the guest output image on every this many "
+              "guest frames of the benchmark, and write the hashes to the "
+              "results, to check whether different settings change the "
+              "output of a replay. 0 to disable.",
+              "General");
+DEFINE_path(benchmark_input_script, "",
+            "Text file with the controller input to replay for the first "
+            "user, as lines of \"frame buttons [left_trigger right_trigger "
+            "thumb_lx thumb_ly thumb_rx thumb_ry]\", with the frame counted "
+            "in guest swaps and the buttons as a hexadecimal mask. Combine "
+            "with --hid=nop so no other controller takes precedence.",
+            "General");
+
+namespace xe {
+
+namespace {
+
+struct InputScriptEntry {
+  uint64_t frame;
+  hid::X_INPUT_GAMEPAD gamepad;
+};
+
+class InputScriptDriver final : public hid::InputDriver {
+ public:
+  InputScriptDriver(Emulator* emulator, std::vector<InputScriptEntry> entries)
+      : InputDriver(nullptr, 0),
+        emulator_(emulator),
+        entries_(std::move(entries)) {}
+
+  X_STATUS Setup() override { return X_STATUS_SUCCESS; }
+
+  X_RESULT GetCapabilities(uint32_t user_index, uint32_t flags,
+                           hid::X_INPUT_CAPABILITIES* out_caps) override {
+    if (user_index) {
+      return X_ERROR_DEVICE_NOT_CONNECTED;
+    }
+    std::memset(out_caps, 0, sizeof(*out_caps));
+    out_caps->type = 0x01;      // XINPUT_DEVTYPE_GAMEPAD
+    out_caps->sub_type = 0x01;  // XINPUT_DEVSUBTYPE_GAMEPAD
+    out_caps->gamepad.buttons = 0xFFFF;
+    out_caps->gamepad.left_trigger = 0xFF;
+    out_caps->gamepad.right_trigger = 0xFF;
+    out_caps->gamepad.thumb_lx = (int16_t)0xFFFFu;
+    out_caps->gamepad.thumb_ly = (int16_t)0xFFFFu;
+    out_caps->gamepad.thumb_rx = (int16_t)0xFFFFu;
+    out_caps->gamepad.thumb_ry = (int16_t)0xFFFFu;
+    return X_ERROR_SUCCESS;
+  }
+
+  X_RESULT GetState(uint32_t user_index,
+                    hid::X_INPUT_STATE* out_state) override {
+    if (user_index) {
+      return X_ERROR_DEVICE_NOT_CONNECTED;
+    }
+    gpu::CommandProcessor* command_processor =
+        emulator_->graphics_system()->command_processor();
+    uint64_t frame = command_processor ? command_processor->swap_count() : 0;
+    // The latest entry not after the current frame.
+    auto it = std::upper_bound(
+        entries_.cbegin(), entries_.cend(), frame,
+        [](uint64_t frame, const InputScriptEntry& entry) {
+          return frame < entry.frame;
+        });
+    size_t entry_index = size_t(it - entries_.cbegin());
+    if (entry_index != packet_entry_index_) {
+      packet_entry_index_ = entry_index;
+      ++packet_number_;
+    }
+    out_state->packet_number = packet_number_;
+    if (entry_index) {
+      out_state->gamepad = entries_[entry_index - 1].gamepad;
+    } else {
+      std::memset(&out_state->gamepad, 0, sizeof(out_state->gamepad));
+    }
+    return X_ERROR_SUCCESS;
+  }
+
+  X_RESULT SetState(uint32_t user_index,
+                    hid::X_INPUT_VIBRATION* vibration) override {
+    return user_index ? X_ERROR_DEVICE_NOT_CONNECTED : X_ERROR_SUCCESS;
+  }
+
+  X_RESULT GetKeystroke(uint32_t user_index, uint32_t flags,
+                        hid::X_INPUT_KEYSTROKE* out_keystroke) override {
+    return user_index ? X_ERROR_DEVICE_NOT_CONNECTED : X_ERROR_EMPTY;
+  }
+
+ private:
+  Emulator* emulator_;
+  std::vector<InputScriptEntry> entries_;
+  size_t packet_entry_index_ = 0;
+  uint32_t packet_number_ = 0;
+};
+
+bool LoadInputScript(const std::filesystem::path& path,
+                     std::vector<InputScriptEntry>& entries) {
+  FILE* file = xe::filesystem::OpenFile(path, "r");
+  if (!file) {
+    XELOGE("Failed to open the benchmark input script {}",
+           xe::path_to_utf8(path));
+    return false;
+  }
+  char line[256];
+  uint32_t line_number = 0;
+  bool result = true;
+  while (fgets(line, sizeof(line), file)) {
+    ++line_number;
+    char* comment = std::strchr(line, '#');
+    if (comment) {
+      *comment = '\0';
+    }
+    // Frame, buttons, two triggers and four thumbstick axes.
+    long long values[8] = {};
+    size_t value_count = 0;
+    char* position = line;
+    while (value_count < xe::countof(values)) {
+      char* value_end;
+      values[value_count] = std::strtoll(position, &value_end,
+                                         value_count == 1 ? 16 : 10);
+      if (value_end == position) {
+        break;
+      }
+      position = value_end;
+      ++value_count;
+    }
+    if (!value_count) {
+      continue;
+    }
+    if (value_count < 2 ||
+        (!entries.empty() && uint64_t(values[0]) < entries.back().frame)) {
+      XELOGE("Invalid line {} in the benchmark input script", line_number);
+      result = false;
+      break;
+    }
+    InputScriptEntry entry;
+    entry.frame = uint64_t(values[0]);
+    entry.gamepad.buttons = uint16_t(values[1]);
+    entry.gamepad.left_trigger = uint8_t(std::clamp(values[2], 0ll, 255ll));
+    entry.gamepad.right_trigger = uint8_t(std::clamp(values[3], 0ll, 255ll));
+    entry.gamepad.thumb_lx = int16_t(std::clamp(values[4], -32768ll, 32767ll));
+    entry.gamepad.thumb_ly = int16_t(std::clamp(values[5], -32768ll, 32767ll));
+    entry.gamepad.thumb_rx = int16_t(std::clamp(values[6], -32768ll, 32767ll));
+    entry.gamepad.thumb_ry = int16_t(std::clamp(values[7], -32768ll, 32767ll));
+    entries.push_back(entry);
+  }
+  fclose(file);
+  return result;
+}
+
+double GetPercentile(const std::vector<double>& sorted_values,
+                     double percentile) {
+  if (sorted_values.empty()) {
+    return 0.0;
+  }
+  return sorted_values[std::min(
+      size_t(percentile * sorted_values.size()), sorted_values.size() - 1)];
+}
+
+std::string EscapeJsonString(const std::string_view value) {
+  std::string escaped;
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      escaped.push_back('\\');
+    }
+    escaped.push_back(uint8_t(c) < 0x20 ? ' ' : c);
+  }
+  return escaped;
+}
+
+}  // namespace
+
+bool EmulatorBenchmark::IsRequested() {
+  return cvars::benchmark_frames || cvars::benchmark_seconds;
+}
+
+std::unique_ptr<hid::InputDriver> EmulatorBenchmark::CreateInputScriptDriver(
+    Emulator* emulator) {
+  if (cvars::benchmark_input_script.empty()) {
+    return nullptr;
+  }
+  std::vector<InputScriptEntry> entries;
+  if (!LoadInputScript(cvars::benchmark_input_script, entries)) {
+    return nullptr;
+  }
+  XELOGI("Loaded {} input states from the benchmark input script",
+         entries.size());
+  return std::make_unique<InputScriptDriver>(emulator, std::move(entries));
+}
+
+EmulatorBenchmark::EmulatorBenchmark(Emulator* emulator)
+    : emulator_(emulator),
+      command_processor_(emulator->graphics_system()->command_processor()) {}
+
+EmulatorBenchmark::~EmulatorBenchmark() {
+  if (thread_) {
+    shutdown_event_->Set();
+    xe::threading::Wait(thread_.get(), false);
+  }
+}
+
+void EmulatorBenchmark::Start() {
+  if (thread_) {
+    return;
+  }
+  shutdown_event_ = xe::threading::Event::CreateManualResetEvent(false);
+  thread_ = xe::threading::Thread::Create({}, [this]() { ThreadMain(); });
+  thread_->set_name("Benchmark");
+}
+
+void EmulatorBenchmark::ThreadMain() {
+  if (!WaitForSwapCount(command_processor_->swap_count() +
+                        cvars::benchmark_warmup_frames)) {
+    return;
+  }
+  CallInCommandProcessorThread([this]() {
+    command_processor_->BeginBenchmark(cvars::benchmark_frame_hash_interval);
+  });
+  Counters start = GetCounters();
+  XELOGI("Benchmark started at frame {}", start.swap_count);
+
+  uint64_t end_swap_count =
+      cvars::benchmark_frames ? start.swap_count + cvars::benchmark_frames
+                              : UINT64_MAX;
+  uint64_t end_host_ticks =
+      cvars::benchmark_seconds
+          ? start.host_ticks +
+                Clock::QueryHostTickFrequency() * cvars::benchmark_seconds
+          : UINT64_MAX;
+  while (command_processor_->swap_count() < end_swap_count &&
+         Clock::QueryHostTickCount() < end_host_ticks) {
+    if (xe::threading::Wait(shutdown_event_.get(), false,
+                            std::chrono::milliseconds(10)) !=
+        xe::threading::WaitResult::kTimeout) {
+      XELOGW("The benchmark has been cancelled");
+      CallInCommandProcessorThread(
+          [this]() { command_processor_->EndBenchmark(); });
+      return;
+    }
+  }
+
+  gpu::CommandProcessor::BenchmarkStatistics statistics;
+  CallInCommandProcessorThread([this, &statistics]() {
+    statistics = command_processor_->EndBenchmark();
+  });
+  Counters end = GetCounters();
+  if (WriteResults(start, end, statistics)) {
+    emulator_->on_benchmark_complete();
+  }
+}
+
+bool EmulatorBenchmark::WaitForSwapCount(uint64_t swap_count) {
+  while (command_processor_->swap_count() < swap_count) {
+    if (xe::threading::Wait(shutdown_event_.get(), false,
+                            std::chrono::milliseconds(10)) !=
+        xe::threading::WaitResult::kTimeout) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void EmulatorBenchmark::CallInCommandProcessorThread(
+    std::function<void()> fn) {
+  threading::Fence fence;
+  command_processor_->CallInThread([&fence, &fn]() {
+    fn();
+    fence.Signal();
+  });
+  fence.Wait();
+}
+
+EmulatorBenchmark::Counters EmulatorBenchmark::GetCounters() const {
+  Counters counters;
+  counters.host_ticks = Clock::QueryHostTickCount();
+  counters.swap_count = command_processor_->swap_count();
+  cpu::ppc::PPCFrontend* frontend = emulator_->processor()->frontend();
+  counters.translation_count = frontend->translation_count();
+  counters.translation_host_ticks = frontend->translation_host_ticks();
+  kernel::KernelState* kernel_state = emulator_->kernel_state();
+  counters.thread_creation_count = kernel_state->thread_creation_count();
+  counters.thread_creation_host_ticks =
+      kernel_state->thread_creation_host_ticks();
+  apu::AudioSystem* audio_system = emulator_->audio_system();
+  counters.audio_underrun_count =
+      audio_system ? audio_system->GetUnderrunCount() : 0;
+  return counters;
+}
+
+bool EmulatorBenchmark::WriteResults(
+    const Counters& start, const Counters& end,
+    const gpu::CommandProcessor::BenchmarkStatistics& statistics) const {
+  double ticks_to_ms =
+      1000.0 / static_cast<double>(Clock::QueryHostTickFrequency());
+  const std::vector<uint64_t>& swap_host_ticks = statistics.swap_host_ticks;
+  std::vector<double> frame_ms;
+  if (!swap_host_ticks.empty()) {
+    frame_ms.reserve(swap_host_ticks.size());
+    frame_ms.push_back((swap_host_ticks[0] - start.host_ticks) * ticks_to_ms);
+    for (size_t i = 1; i < swap_host_ticks.size(); ++i) {
+      frame_ms.push_back((swap_host_ticks[i] - swap_host_ticks[i - 1]) *
+                         ticks_to_ms);
+    }
+  }
+  using GpuTimingCategory = gpu::CommandProcessor::GpuTimingCategory;
+
+  // Frames of the GPU submissions are matched to the guest swaps by their
+  // order, as the timestamps are only received after the work is complete.
+  std::filesystem::path csv_path =
+      std::filesystem::path(cvars::benchmark_output_path)
+          .replace_extension(".csv");
+  FILE* csv_file = xe::filesystem::OpenFile(csv_path, "w");
+  if (!csv_file) {
+    XELOGE("Failed to open {} for writing the benchmark frame times",
+           xe::path_to_utf8(csv_path));
+    return false;
+  }
+  fputs("frame,frame_ms,gpu_ms,present_ms\n", csv_file);
+  for (size_t i = 0; i < frame_ms.size(); ++i) {
+    fprintf(csv_file, "%llu,%.3f",
+            static_cast<unsigned long long>(start.swap_count + i), frame_ms[i]);
+    if (i < statistics.gpu_frames.size()) {
+      const uint64_t* work_time_ns = statistics.gpu_frames[i].work_time_ns;
+      uint64_t gpu_ns = 0;
+      for (size_t j = 0; j < size_t(GpuTimingCategory::kCount); ++j) {
+        gpu_ns += work_time_ns[j];
+      }
+      fprintf(csv_file, ",%.3f,%.3f\n", gpu_ns / 1000000.0,
+              work_time_ns[size_t(GpuTimingCategory::kPresent)] / 1000000.0);
+    } else {
+      fputs(",,\n", csv_file);
+    }
+  }
+  fclose(csv_file);
+
+  FILE* file = xe::filesystem::OpenFile(cvars::benchmark_output_path, "w");
+  if (!file) {
+    XELOGE("Failed to open {} for writing the benchmark results",
+           xe::path_to_utf8(cvars::benchmark_output_path));
+    return false;
+  }
+  double seconds = (end.host_ticks - start.host_ticks) * ticks_to_ms / 1000.0;
+  uint64_t frame_count = end.swap_count - start.swap_count;
+  fprintf(file, "{\n  \"title_id\": \"%08X\",\n  \"title_name\": \"%s\",\n",
+          emulator_->title_id(),
+          EscapeJsonString(emulator_->title_name()).c_str());
+  fprintf(file, "  \"start_frame\": %llu,\n  \"frames\": %llu,\n",
+          static_cast<unsigned long long>(start.swap_count),
+          static_cast<unsigned long long>(frame_count));
+  fprintf(file, "  \"seconds\": %.3f,\n  \"average_fps\": %.3f,\n", seconds,
+          seconds > 0.0 ? frame_count / seconds : 0.0);
+  std::vector<double> sorted_frame_ms = frame_ms;
+  std::sort(sorted_frame_ms.begin(), sorted_frame_ms.end());
+  fprintf(file,
+          "  \"frame_ms\": {\"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, "
+          "\"max\": %.3f},\n",
+          GetPercentile(sorted_frame_ms, 0.5),
+          GetPercentile(sorted_frame_ms, 0.95),
+          GetPercentile(sorted_frame_ms, 0.99),
+          sorted_frame_ms.empty() ? 0.0 : sorted_frame_ms.back());
+  fprintf(file, "  \"gpu\": {\"supported\": %s",
+          statistics.gpu_timing_supported ? "true" : "false");
+  static const char* const kGpuWorkNames[] = {
+      nullptr,
+      "render_target_update",
+      "texture_load",
+      "draw",
+      "resolve",
+      "present",
+  };
+  static_assert(xe::countof(kGpuWorkNames) ==
+                size_t(GpuTimingCategory::kCount));
+  for (size_t i = 1; i < xe::countof(kGpuWorkNames); ++i) {
+    fprintf(file, ", \"%s\": {\"count\": %llu, \"ns\": %llu}",
+            kGpuWorkNames[i],
+            static_cast<unsigned long long>(statistics.gpu_work_count[i]),
+            static_cast<unsigned long long>(statistics.gpu_work_time_ns[i]));
+  }
+  fprintf(file,
+          "},\n  \"pipeline_creation\": {\"stalls\": %llu, "
+          "\"stall_ns\": %llu, \"draws_skipped\": %llu},\n",
+          static_cast<unsigned long long>(statistics.pipeline_creation_stalls),
+          static_cast<unsigned long long>(
+              statistics.pipeline_creation_stall_ns),
+          static_cast<unsigned long long>(
+              statistics.draws_skipped_for_pipeline_creation));
+  fprintf(file, "  \"upload_bytes\": %llu,\n",
+          static_cast<unsigned long long>(statistics.upload_bytes));
+  fprintf(file, "  \"jit\": {\"translations\": %llu, \"ms\": %.3f},\n",
+          static_cast<unsigned long long>(end.translation_count -
+                                          start.translation_count),
+          (end.translation_host_ticks - start.translation_host_ticks) *
+              ticks_to_ms);
+  fprintf(file, "  \"threads\": {\"created\": %llu, \"ms\": %.3f},\n",
+          static_cast<unsigned long long>(end.thread_creation_count -
+                                          start.thread_creation_count),
+          (end.thread_creation_host_ticks - start.thread_creation_host_ticks) *
+              ticks_to_ms);
+  fputs("  \"frame_hashes\": [", file);
+  for (size_t i = 0; i < statistics.frame_hashes.size(); ++i) {
+    const gpu::CommandProcessor::BenchmarkStatistics::FrameHash& frame_hash =
+        statistics.frame_hashes[i];
+    // As strings, as JSON numbers may lose the precision of 64-bit values.
+    fprintf(file, "%s{\"frame\": %llu, \"hash\": \"%016llX\"}",
+            i ? ", " : "", static_cast<unsigned long long>(frame_hash.frame),
+            static_cast<unsigned long long>(frame_hash.hash));
+  }
+  fputs("],\n", file);
+  // The underruns of the clients unregistered during the benchmark are lost.
+  fprintf(file, "  \"audio_underruns\": %llu\n}\n",
+          static_cast<unsigned long long>(
+              end.audio_underrun_count >= start.audio_underrun_count
+                  ? end.audio_underrun_count - start.audio_underrun_count
+                  : 0));
+  fclose(file);
+  XELOGI("Wrote the benchmark results of {} frames to {}", frame_count,
+         xe::path_to_utf8(cvars::benchmark_output_path));
+  return true;
+}
+
+}  // namespace xe
@@ -0,0 +1,92 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_EMULATOR_BENCHMARK_H_
+#define XENIA_EMULATOR_BENCHMARK_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "xenia/base/threading.h"
+#include "xenia/gpu/command_processor.h"
+
+namespace xe {
+class Emulator;
+namespace hid {
+class InputDriver;
+}  // namespace hid
+}  // namespace xe
+
+namespace xe {
+
+// Measures the performance of the running title over benchmark_frames guest
+// frames or benchmark_seconds seconds, after skipping
+// benchmark_warmup_frames, and writes the results as JSON to
+// benchmark_output_path, with the times of every frame in a CSV file next to
+// it. Together with headless and benchmark_input_script, titles can be
+// benchmarked unattended. With benchmark_frame_hash_interval, the results
+// also contain the hashes of the guest output images, which are used by
+// `xb autotune` to reject settings changing the output.
+class EmulatorBenchmark {
+ public:
+  // Whether a benchmark has been requested with the cvars.
+  static bool IsRequested();
+
+  // Creates the driver replaying benchmark_input_script as the controller of
+  // the first user, or returns nullptr if there's no script or it can't be
+  // loaded. The script is a text file with one line per change of the state,
+  // in the order of the frames:
+  // frame buttons [left_trigger right_trigger thumb_lx thumb_ly thumb_rx
+  // thumb_ry]
+  // with the frame counted in guest swaps since the emulator has started, the
+  // buttons as an X_INPUT_GAMEPAD_ mask, and # starting comments.
+  static std::unique_ptr<hid::InputDriver> CreateInputScriptDriver(
+      Emulator* emulator);
+
+  explicit EmulatorBenchmark(Emulator* emulator);
+  // Discards the results if the benchmark hasn't completed yet.
+  ~EmulatorBenchmark();
+
+  // Starts measuring in the background, to be called once the title has been
+  // launched. Emulator::on_benchmark_complete is called when the results have
+  // been written.
+  void Start();
+
+ private:
+  struct Counters {
+    uint64_t host_ticks;
+    uint64_t swap_count;
+    uint64_t translation_count;
+    uint64_t translation_host_ticks;
+    uint64_t thread_creation_count;
+    uint64_t thread_creation_host_ticks;
+    uint64_t audio_underrun_count;
+  };
+
+  void ThreadMain();
+  // Returns false if the benchmark has been cancelled while waiting.
+  bool WaitForSwapCount(uint64_t swap_count);
+  void CallInCommandProcessorThread(std::function<void()> fn);
+  Counters GetCounters() const;
+  bool WriteResults(const Counters& start, const Counters& end,
+                    const gpu::CommandProcessor::BenchmarkStatistics&
+                        statistics) const;
+
+  Emulator* emulator_;
+  gpu::CommandProcessor* command_processor_;
+  std::unique_ptr<xe::threading::Event> shutdown_event_;
+  std::unique_ptr<xe::threading::Thread> thread_;
+};
+
+}  // namespace xe
+
+#endif  // XENIA_EMULATOR_BENCHMARK_H_
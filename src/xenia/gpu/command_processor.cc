@@ -9,13 +9,21 @@
 
 #include "xenia/gpu/command_processor.h"
 
+#include <algorithm>
 #include <cinttypes>
+#include <cstring>
 
 #include "third_party/fmt/include/fmt/format.h"
 #include "xenia/base/byte_stream.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/concurrent_queue.h"
 #include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
+#include "xenia/base/math.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/threading.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/gpu/gpu_flags.h"
 #include "xenia/gpu/graphics_system.h"
 #include "xenia/gpu/packet_disassembler.h"
@@ -50,6 +58,44 @@ DEFINE_bool(clear_memory_page_state, false,
             "for 'Team Ninja' Games to fix missing character models)",
             "GPU");
 
+DEFINE_bool(
+    gpu_timestamp_profiling, false,
+    "Measure the host GPU time of render target updates, texture loading, "
+    "draws, resolves and presentation using GPU timestamp queries, and report "
+    "it per frame to the profiler.",
+    "GPU");
+DEFINE_int32(gpu_timestamp_profiling_top_draws, 8,
+             "Number of the most expensive combinations of shaders used in "
+             "draws to export for each frame with gpu_timestamp_profiling.",
+             "GPU");
+DEFINE_path(gpu_timestamp_profiling_export_path, "",
+            "CSV file to write the per-frame GPU timing statistics to with "
+            "gpu_timestamp_profiling.",
+            "GPU");
+
+DEFINE_bool(
+    gpu_indirect_buffer_reuse_statistics, false,
+    "Hash the contents of the indirect buffers executed by the guest, and "
+    "report per frame to the profiler how many of them, and how many of their "
+    "dwords, are identical to ones executed in the previous frame, to estimate "
+    "how much of the command recording could be reused across frames.",
+    "GPU");
+
+DEFINE_uint32(
+    command_processor_spin_us, 50,
+    "Microseconds the GPU command processor polls for new commands from the "
+    "guest, or for the value awaited by a WAIT_REG_MEM packet, before "
+    "sleeping. Longer polling reduces the latency of picking up the work "
+    "submitted by the guest at the cost of CPU time.",
+    "GPU");
+DEFINE_bool(
+    log_command_processor_idle, false,
+    "Log how much of the time the GPU command processor spends polling and "
+    "blocked waiting for new commands, and the latency between the guest "
+    "updating the ring buffer write pointer and the command processor waking "
+    "up, every 10 seconds.",
+    "GPU");
+
 namespace xe {
 namespace gpu {
 
@@ -72,10 +118,7 @@ CommandProcessor::CommandProcessor(GraphicsSystem* graphics_system,
       register_file_(graphics_system_->register_file()),
       trace_writer_(graphics_system->memory()->physical_membase()),
       worker_running_(true),
-      write_ptr_index_event_(xe::threading::Event::CreateAutoResetEvent(false)),
-      write_ptr_index_(0) {
-  assert_not_null(write_ptr_index_event_);
-}
+      write_ptr_index_(0) {}
 
 CommandProcessor::~CommandProcessor() = default;
 
@@ -117,8 +160,13 @@ bool CommandProcessor::Initialize() {
 void CommandProcessor::Shutdown() {
   EndTracing();
 
+  if (gpu_timing_export_file_) {
+    fclose(gpu_timing_export_file_);
+    gpu_timing_export_file_ = nullptr;
+  }
+
   worker_running_ = false;
-  write_ptr_index_event_->Set();
+  RingDoorbell();
   worker_thread_->Wait(0, 0, 0, nullptr);
   worker_thread_.reset();
 }
@@ -188,6 +236,7 @@ void CommandProcessor::RestoreRegisters(uint32_t first_register,
   } else {
     std::memcpy(register_file_->values + first_register, register_values,
                 sizeof(uint32_t) * register_count);
+    register_file_->MarkRangeWritten(first_register, register_count);
   }
 }
 
@@ -210,6 +259,7 @@ void CommandProcessor::CallInThread(std::function<void()> fn) {
     fn();
   } else {
     pending_fns_.push(std::move(fn));
+    RingDoorbell();
   }
 }
 
@@ -243,24 +293,8 @@ void CommandProcessor::WorkerThreadMain() {
     if (write_ptr_index == 0xBAADF00D || read_ptr_index_ == write_ptr_index) {
       SCOPE_profile_cpu_i("gpu", "xe::gpu::CommandProcessor::Stall");
       // We've run out of commands to execute.
-      // We spin here waiting for new ones, as the overhead of waiting on our
-      // event is too high.
       PrepareForWait();
-      uint32_t loop_count = 0;
-      do {
-        // If we spin around too much, revert to a "low-power" state.
-        if (loop_count > 500) {
-          const int wait_time_ms = 2;
-          xe::threading::Wait(write_ptr_index_event_.get(), true,
-                              std::chrono::milliseconds(wait_time_ms));
-        } else {
-          xe::threading::MaybeYield();
-        }
-        loop_count++;
-        write_ptr_index = write_ptr_index_.load();
-      } while (worker_running_ && pending_fns_.empty() &&
-               (write_ptr_index == 0xBAADF00D ||
-                read_ptr_index_ == write_ptr_index));
+      write_ptr_index = WaitForWork();
       ReturnFromWait();
       if (!worker_running_ || !pending_fns_.empty()) {
         continue;
@@ -268,6 +302,10 @@ void CommandProcessor::WorkerThreadMain() {
     }
     assert_true(read_ptr_index_ != write_ptr_index);
 
+    // The guest has written the data used by the new commands before kicking
+    // them, invalidate what it has modified if not done on write faults.
+    memory_->PollPhysicalMemoryWrites();
+
     // Execute. Note that we handle wraparound transparently.
     read_ptr_index_ = ExecutePrimaryBuffer(read_ptr_index_, write_ptr_index);
 
@@ -287,6 +325,129 @@ void CommandProcessor::WorkerThreadMain() {
   ShutdownContext();
 }
 
+uint32_t CommandProcessor::WaitForWork() {
+  const uint64_t host_tick_frequency = Clock::QueryHostTickFrequency();
+  uint64_t wait_start_host_ticks = Clock::QueryHostTickCount();
+
+  // The guest often kicks more commands shortly after the GPU runs out of them,
+  // and waking up from a blocking wait takes much longer than that, so poll
+  // for a bit first.
+  uint64_t spin_end_host_ticks =
+      wait_start_host_ticks +
+      host_tick_frequency * cvars::command_processor_spin_us / 1000000;
+  uint32_t write_ptr_index = write_ptr_index_.load();
+  while (IsWaitingForWork(write_ptr_index) &&
+         Clock::QueryHostTickCount() < spin_end_host_ticks) {
+    xe::SpinPause();
+    write_ptr_index = write_ptr_index_.load();
+  }
+
+  uint64_t block_start_host_ticks = 0;
+  if (IsWaitingForWork(write_ptr_index)) {
+    block_start_host_ticks = Clock::QueryHostTickCount();
+    while (true) {
+      uint32_t doorbell = doorbell_.load();
+      // Sequentially consistent with the write pointer update in
+      // UpdateWritePointer - either the update sees that the worker is
+      // blocked and rings the doorbell, or the write pointer is seen here.
+      worker_blocked_.store(true);
+      write_ptr_index = write_ptr_index_.load();
+      if (!IsWaitingForWork(write_ptr_index)) {
+        break;
+      }
+      if (IsPollingWhileWaitingNeeded()) {
+        xe::threading::AtomicWait(doorbell_, doorbell,
+                                  std::chrono::milliseconds(1));
+        PollWhileWaiting();
+      } else {
+        xe::threading::AtomicWait(doorbell_, doorbell);
+      }
+    }
+    worker_blocked_.store(false);
+  }
+
+  XE_UNLIKELY_IF(cvars::log_command_processor_idle) {
+    UpdateIdleStatistics(wait_start_host_ticks, block_start_host_ticks,
+                         Clock::QueryHostTickCount(),
+                         doorbell_kick_host_ticks_.load());
+  }
+  return write_ptr_index;
+}
+
+void CommandProcessor::RingDoorbell() {
+  doorbell_.fetch_add(1);
+  xe::threading::AtomicNotifyAll(doorbell_);
+}
+
+void CommandProcessor::UpdateIdleStatistics(uint64_t wait_start_host_ticks,
+                                            uint64_t block_start_host_ticks,
+                                            uint64_t wait_end_host_ticks,
+                                            uint64_t kick_host_ticks) {
+  IdleStatistics& statistics = idle_statistics_;
+  if (!statistics.period_start_host_ticks) {
+    statistics.period_start_host_ticks = wait_start_host_ticks;
+  }
+  if (block_start_host_ticks) {
+    statistics.spin_host_ticks +=
+        block_start_host_ticks - wait_start_host_ticks;
+    statistics.blocked_host_ticks +=
+        wait_end_host_ticks - block_start_host_ticks;
+    // A kick from before this wait was for a previous one.
+    if (kick_host_ticks >= block_start_host_ticks &&
+        kick_host_ticks <= wait_end_host_ticks) {
+      uint64_t kick_latency_host_ticks = wait_end_host_ticks - kick_host_ticks;
+      ++statistics.kick_count;
+      statistics.kick_latency_host_ticks += kick_latency_host_ticks;
+      statistics.kick_latency_max_host_ticks = std::max(
+          statistics.kick_latency_max_host_ticks, kick_latency_host_ticks);
+    }
+  } else {
+    statistics.spin_host_ticks += wait_end_host_ticks - wait_start_host_ticks;
+  }
+
+  const uint64_t host_tick_frequency = Clock::QueryHostTickFrequency();
+  uint64_t period_host_ticks =
+      wait_end_host_ticks - statistics.period_start_host_ticks;
+  if (period_host_ticks < host_tick_frequency * 10) {
+    return;
+  }
+  double us_per_host_tick = 1000000.0 / double(host_tick_frequency);
+  XELOGI(
+      "GPU command processor idle: {:.1f}% polling, {:.1f}% blocked, {} kicks "
+      "while blocked, {:.1f} us average and {:.1f} us maximum kick latency",
+      100.0 * double(statistics.spin_host_ticks) / double(period_host_ticks),
+      100.0 * double(statistics.blocked_host_ticks) /
+          double(period_host_ticks),
+      statistics.kick_count,
+      statistics.kick_count
+          ? double(statistics.kick_latency_host_ticks) * us_per_host_tick /
+                double(statistics.kick_count)
+          : 0.0,
+      double(statistics.kick_latency_max_host_ticks) * us_per_host_tick);
+  statistics = IdleStatistics();
+}
+
+bool CommandProcessor::WaitBeforeRegMemPoll(RegMemWait& wait,
+                                            uint32_t max_sleep_ms) {
+  uint64_t host_ticks = Clock::QueryHostTickCount();
+  if (!wait.spin_end_host_ticks) {
+    wait.spin_end_host_ticks =
+        host_ticks + Clock::QueryHostTickFrequency() *
+                         cvars::command_processor_spin_us / 1000000;
+  }
+  if (host_ticks < wait.spin_end_host_ticks) {
+    xe::SpinPause();
+    return false;
+  }
+  // Rather than always sleeping for the interval specified by the guest, start
+  // with short sleeps, as the value is usually written soon.
+  uint32_t max_sleep_us = max_sleep_ms * 1000;
+  wait.sleep_us = std::min(wait.sleep_us ? wait.sleep_us * 2 : uint32_t(50),
+                           max_sleep_us);
+  xe::threading::Sleep(std::chrono::microseconds(wait.sleep_us));
+  return true;
+}
+
 void CommandProcessor::Pause() {
   if (paused_) {
     return;
@@ -388,7 +549,13 @@ void CommandProcessor::UpdateWritePointer(uint32_t value) {
     LogKickoffInitator(value);
   }
   write_ptr_index_ = value;
-  write_ptr_index_event_->SetBoostPriority();
+  if (worker_blocked_.load()) {
+    XE_UNLIKELY_IF(cvars::log_command_processor_idle) {
+      doorbell_kick_host_ticks_.store(Clock::QueryHostTickCount(),
+                                      std::memory_order_relaxed);
+    }
+    RingDoorbell();
+  }
 }
 
 void CommandProcessor::LogRegisterSet(uint32_t register_index, uint32_t value) {
@@ -597,6 +764,7 @@ void CommandProcessor::WriteRegister(uint32_t index, uint32_t value) {
 
   if (XE_LIKELY(index < RegisterFile::kRegisterCount)) {
     register_file_->values[index] = value;
+    register_file_->MarkWritten(index);
 
     // quick pre-test
     // todo: figure out just how unlikely this is. if very (it ought to be,
@@ -752,6 +920,344 @@ void CommandProcessor::PrepareForWait() { trace_writer_.Flush(); }
 
 void CommandProcessor::ReturnFromWait() {}
 
+void CommandProcessor::WriteOcclusionQueryResult(
+    uint32_t sample_counts_address, uint32_t sample_count) {
+  // Set by D3D as BE but struct ABI is LE.
+  const uint32_t kQueryFinished = xe::byte_swap(0xFFFFFEED);
+  auto* sample_counts =
+      memory_->TranslatePhysical<xe_gpu_depth_sample_counts*>(
+          sample_counts_address);
+  if (!(sample_counts->ZPass_A == kQueryFinished &&
+        sample_counts->ZPass_B == kQueryFinished) &&
+      !(sample_counts->ZFail_A == kQueryFinished &&
+        sample_counts->ZFail_B == kQueryFinished)) {
+    return;
+  }
+  std::memset(sample_counts, 0, sizeof(xe_gpu_depth_sample_counts));
+  sample_counts->ZPass_A = sample_count;
+  sample_counts->Total_A = sample_count;
+  trace_writer_.WriteMemoryWrite(CpuToGpu(sample_counts_address),
+                                 sizeof(xe_gpu_depth_sample_counts));
+}
+
+void CommandProcessor::BeginBenchmark(uint32_t frame_hash_interval) {
+  benchmark_statistics_ = BenchmarkStatistics();
+  benchmark_frame_hash_interval_ = frame_hash_interval;
+  benchmarking_ = true;
+  OnBeginBenchmark();
+}
+
+CommandProcessor::BenchmarkStatistics CommandProcessor::EndBenchmark() {
+  OnEndBenchmark();
+  benchmarking_ = false;
+  return benchmark_statistics_;
+}
+
+bool CommandProcessor::is_gpu_timing_enabled() const {
+  return benchmarking_ || cvars::gpu_timestamp_profiling ||
+         render_target_path_tuning_;
+}
+
+void CommandProcessor::BeginRenderTargetPathMeasurement(
+    std::shared_ptr<RenderTargetPathTuning> tuning) {
+  render_target_path_tuning_ = std::move(tuning);
+  render_target_path_tuning_frame_ = UINT64_MAX;
+  render_target_path_tuning_frames_completed_ = 0;
+  render_target_path_tuning_time_ns_ = 0;
+}
+
+void CommandProcessor::AccumulateGpuTimestamps(uint64_t frame,
+                                               const uint64_t* timestamps,
+                                               const GpuTimestampLabel* labels,
+                                               size_t count,
+                                               double ns_per_tick) {
+  bool profiling = cvars::gpu_timestamp_profiling;
+  if (profiling && gpu_timing_frame_ != frame) {
+    if (gpu_timing_frame_ != UINT64_MAX) {
+      PublishGpuTimingFrame();
+    }
+    gpu_timing_frame_ = frame;
+  }
+  bool measuring_render_target_path = false;
+  if (render_target_path_tuning_) {
+    if (render_target_path_tuning_frame_ != frame) {
+      if (render_target_path_tuning_frame_ != UINT64_MAX) {
+        ++render_target_path_tuning_frames_completed_;
+      }
+      render_target_path_tuning_frame_ = frame;
+    }
+    uint32_t warmup_frame_count = RenderTargetPathTuning::GetWarmupFrameCount();
+    uint32_t measured_frame_count =
+        RenderTargetPathTuning::GetMeasuredFrameCount();
+    if (render_target_path_tuning_frames_completed_ >=
+        warmup_frame_count + measured_frame_count) {
+      std::optional<RenderTargetCache::Path> render_target_path =
+          GetRenderTargetPath();
+      if (render_target_path) {
+        render_target_path_tuning_->StoreMeasurement(
+            *render_target_path,
+            render_target_path_tuning_time_ns_ / measured_frame_count);
+      }
+      render_target_path_tuning_.reset();
+    } else {
+      measuring_render_target_path =
+          render_target_path_tuning_frames_completed_ >= warmup_frame_count;
+    }
+  }
+  for (size_t i = 1; i < count; ++i) {
+    const GpuTimestampLabel& label = labels[i];
+    if (label.category == GpuTimingCategory::kNone ||
+        timestamps[i] < timestamps[i - 1]) {
+      continue;
+    }
+    auto time_ns =
+        uint64_t(double(timestamps[i] - timestamps[i - 1]) * ns_per_tick);
+    size_t category_index = size_t(label.category);
+    if (measuring_render_target_path) {
+      render_target_path_tuning_time_ns_ += time_ns;
+    }
+    if (benchmarking_) {
+      ++benchmark_statistics_.gpu_work_count[category_index];
+      benchmark_statistics_.gpu_work_time_ns[category_index] += time_ns;
+      std::vector<BenchmarkStatistics::GpuFrame>& gpu_frames =
+          benchmark_statistics_.gpu_frames;
+      if (gpu_frames.empty() || gpu_frames.back().frame != frame) {
+        gpu_frames.push_back({frame, {}});
+      }
+      gpu_frames.back().work_time_ns[category_index] += time_ns;
+    }
+    if (profiling) {
+      ++gpu_timing_frame_count_[category_index];
+      gpu_timing_frame_time_ns_[category_index] += time_ns;
+      if (label.category == GpuTimingCategory::kDraw) {
+        GpuDrawTiming& draw_timing = gpu_timing_frame_draws_
+            [label.vertex_shader_hash ^ xe::rotate_left<uint64_t>(
+                                            label.pixel_shader_hash, 1)];
+        draw_timing.vertex_shader_hash = label.vertex_shader_hash;
+        draw_timing.pixel_shader_hash = label.pixel_shader_hash;
+        ++draw_timing.count;
+        draw_timing.time_ns += time_ns;
+      }
+    }
+  }
+}
+
+void CommandProcessor::PublishGpuTimingFrame() {
+  const uint64_t* frame_time_ns = gpu_timing_frame_time_ns_;
+  COUNT_profile_set(
+      "gpu/timing/render_target_update_us",
+      frame_time_ns[size_t(GpuTimingCategory::kRenderTargetUpdate)] / 1000);
+  COUNT_profile_set(
+      "gpu/timing/texture_load_us",
+      frame_time_ns[size_t(GpuTimingCategory::kTextureLoad)] / 1000);
+  COUNT_profile_set("gpu/timing/draw_us",
+                    frame_time_ns[size_t(GpuTimingCategory::kDraw)] / 1000);
+  COUNT_profile_set("gpu/timing/resolve_us",
+                    frame_time_ns[size_t(GpuTimingCategory::kResolve)] / 1000);
+  COUNT_profile_set("gpu/timing/present_us",
+                    frame_time_ns[size_t(GpuTimingCategory::kPresent)] / 1000);
+
+  std::vector<GpuDrawTiming> top_draws;
+  size_t top_draw_count =
+      std::min(size_t(std::max(cvars::gpu_timestamp_profiling_top_draws, 0)),
+               gpu_timing_frame_draws_.size());
+  if (top_draw_count) {
+    top_draws.reserve(gpu_timing_frame_draws_.size());
+    for (const auto& draw_timing : gpu_timing_frame_draws_) {
+      top_draws.push_back(draw_timing.second);
+    }
+    std::partial_sort(top_draws.begin(), top_draws.begin() + top_draw_count,
+                      top_draws.end(),
+                      [](const GpuDrawTiming& a, const GpuDrawTiming& b) {
+                        return a.time_ns > b.time_ns;
+                      });
+    top_draws.resize(top_draw_count);
+  }
+  COUNT_profile_set("gpu/timing/top_draw_us",
+                    top_draws.empty() ? 0 : top_draws.front().time_ns / 1000);
+
+  if (!gpu_timing_export_file_ && !gpu_timing_export_failed_ &&
+      !cvars::gpu_timestamp_profiling_export_path.empty()) {
+    gpu_timing_export_file_ = xe::filesystem::OpenFile(
+        cvars::gpu_timestamp_profiling_export_path, "w");
+    if (gpu_timing_export_file_) {
+      fputs("frame,category,vertex_shader,pixel_shader,count,time_us\n",
+            gpu_timing_export_file_);
+    } else {
+      XELOGE("Failed to open {} for exporting the GPU timing statistics",
+             xe::path_to_utf8(cvars::gpu_timestamp_profiling_export_path));
+      // Don't retry every frame.
+      gpu_timing_export_failed_ = true;
+    }
+  }
+  if (gpu_timing_export_file_) {
+    static const char* const kCategoryNames[] = {
+        nullptr,
+        "render_target_update",
+        "texture_load",
+        "draw",
+        "resolve",
+        "present",
+    };
+    static_assert(xe::countof(kCategoryNames) ==
+                  size_t(GpuTimingCategory::kCount));
+    for (size_t i = 1; i < xe::countof(kCategoryNames); ++i) {
+      fprintf(gpu_timing_export_file_, "%" PRIu64 ",%s,,,%" PRIu64 ",%.3f\n",
+              gpu_timing_frame_, kCategoryNames[i], gpu_timing_frame_count_[i],
+              frame_time_ns[i] * 0.001);
+    }
+    for (const GpuDrawTiming& draw_timing : top_draws) {
+      fprintf(gpu_timing_export_file_,
+              "%" PRIu64 ",top_draw,%016" PRIX64 ",%016" PRIX64 ",%" PRIu64
+              ",%.3f\n",
+              gpu_timing_frame_, draw_timing.vertex_shader_hash,
+              draw_timing.pixel_shader_hash, draw_timing.count,
+              draw_timing.time_ns * 0.001);
+    }
+  }
+
+  std::memset(gpu_timing_frame_count_, 0, sizeof(gpu_timing_frame_count_));
+  std::memset(gpu_timing_frame_time_ns_, 0, sizeof(gpu_timing_frame_time_ns_));
+  gpu_timing_frame_draws_.clear();
+}
+
+CommandProcessor::RuntimeStatistics CommandProcessor::GetRuntimeStatistics()
+    const {
+  RuntimeStatistics statistics;
+  statistics.swap_count = swap_count_.load(std::memory_order_relaxed);
+  statistics.pipeline_creation_stalls =
+      pipeline_creation_stalls_.load(std::memory_order_relaxed);
+  statistics.pipeline_creation_stall_ns =
+      pipeline_creation_stall_ns_.load(std::memory_order_relaxed);
+  statistics.draws_skipped_for_pipeline_creation =
+      draws_skipped_for_pipeline_creation_.load(std::memory_order_relaxed);
+  statistics.texture_memory_bytes =
+      texture_memory_bytes_.load(std::memory_order_relaxed);
+  statistics.shared_memory_bytes =
+      shared_memory_bytes_.load(std::memory_order_relaxed);
+  statistics.upload_buffer_bytes =
+      upload_buffer_bytes_.load(std::memory_order_relaxed);
+  return statistics;
+}
+
+void CommandProcessor::GetRecentSwapHostTicks(
+    std::vector<uint64_t>& host_ticks_out) const {
+  host_ticks_out.clear();
+  std::lock_guard<std::mutex> lock(recent_swaps_mutex_);
+  uint64_t swap_count = swap_count_.load(std::memory_order_relaxed);
+  uint64_t first_swap =
+      swap_count - std::min(swap_count, uint64_t(kRecentSwapCount));
+  host_ticks_out.reserve(size_t(swap_count - first_swap));
+  for (uint64_t i = first_swap; i < swap_count; ++i) {
+    host_ticks_out.push_back(recent_swap_host_ticks_[i % kRecentSwapCount]);
+  }
+}
+
+void CommandProcessor::RecordPipelineCreationStall(
+    uint64_t start_host_tick_count) {
+  uint64_t stall_ns =
+      (Clock::QueryHostTickCount() - start_host_tick_count) * 1000000000 /
+      Clock::QueryHostTickFrequency();
+  pipeline_creation_stalls_.fetch_add(1, std::memory_order_relaxed);
+  pipeline_creation_stall_ns_.fetch_add(stall_ns, std::memory_order_relaxed);
+  if (benchmarking_) {
+    ++benchmark_statistics_.pipeline_creation_stalls;
+    benchmark_statistics_.pipeline_creation_stall_ns += stall_ns;
+  }
+}
+
+void CommandProcessor::RecordDrawSkippedForPipelineCreation() {
+  draws_skipped_for_pipeline_creation_.fetch_add(1, std::memory_order_relaxed);
+  if (benchmarking_) {
+    ++benchmark_statistics_.draws_skipped_for_pipeline_creation;
+  }
+}
+
+void CommandProcessor::RecordSwap() {
+  uint64_t host_ticks = Clock::QueryHostTickCount();
+  uint64_t swap_index;
+  {
+    // The swap count is incremented under the lock, so the ring is consistent
+    // with it when read.
+    std::lock_guard<std::mutex> lock(recent_swaps_mutex_);
+    swap_index = swap_count_.load(std::memory_order_relaxed);
+    recent_swap_host_ticks_[swap_index % kRecentSwapCount] = host_ticks;
+    swap_count_.store(swap_index + 1, std::memory_order_relaxed);
+  }
+  if (benchmarking_) {
+    std::vector<uint64_t>& swap_host_ticks =
+        benchmark_statistics_.swap_host_ticks;
+    swap_host_ticks.push_back(host_ticks);
+    if (benchmark_frame_hash_interval_ &&
+        !(swap_host_ticks.size() % benchmark_frame_hash_interval_)) {
+      RecordBenchmarkFrameHash(swap_index);
+    }
+  }
+
+  if (cvars::gpu_indirect_buffer_reuse_statistics) {
+    COUNT_profile_set("gpu/command_processor/indirect_buffers",
+                      frame_indirect_buffers_);
+    COUNT_profile_set("gpu/command_processor/indirect_buffers_repeated",
+                      frame_indirect_buffers_repeated_);
+    COUNT_profile_set("gpu/command_processor/indirect_buffer_kb",
+                      frame_indirect_buffer_dwords_ * sizeof(uint32_t) / 1024);
+    COUNT_profile_set(
+        "gpu/command_processor/indirect_buffer_repeated_kb",
+        frame_indirect_buffer_dwords_repeated_ * sizeof(uint32_t) / 1024);
+    indirect_buffer_hashes_previous_frame_.swap(
+        indirect_buffer_hashes_current_frame_);
+    indirect_buffer_hashes_current_frame_.clear();
+    frame_indirect_buffers_ = 0;
+    frame_indirect_buffer_dwords_ = 0;
+    frame_indirect_buffers_repeated_ = 0;
+    frame_indirect_buffer_dwords_repeated_ = 0;
+  }
+}
+
+void CommandProcessor::RecordBenchmarkFrameHash(uint64_t frame) {
+  ui::Presenter* presenter = graphics_system_->presenter();
+  ui::RawImage image;
+  if (!presenter || !presenter->CaptureGuestOutput(image)) {
+    return;
+  }
+  // Only the color of the pixels is hashed, without the row padding and the
+  // undefined X component.
+  size_t row_size = size_t(image.width) * 4;
+  std::vector<uint8_t> pixels(row_size * image.height);
+  for (uint32_t y = 0; y < image.height; ++y) {
+    uint8_t* row = pixels.data() + row_size * y;
+    std::memcpy(row, image.data.data() + image.stride * y, row_size);
+    for (size_t x = 3; x < row_size; x += 4) {
+      row[x] = 0;
+    }
+  }
+  BenchmarkStatistics::FrameHash& frame_hash =
+      benchmark_statistics_.frame_hashes.emplace_back();
+  frame_hash.frame = frame;
+  frame_hash.hash = XXH3_64bits_withSeed(
+      pixels.data(), pixels.size(),
+      (uint64_t(image.width) << 32) | image.height);
+}
+
+void CommandProcessor::RecordIndirectBuffer(uint32_t ptr, uint32_t count) {
+  if (!cvars::gpu_indirect_buffer_reuse_statistics) {
+    return;
+  }
+  // Only the PM4 stream itself is hashed - a repeated indirect buffer is a
+  // reuse candidate, but the register state at its beginning and the memory
+  // referenced by it may still differ.
+  uint64_t hash = XXH3_64bits_withSeed(memory_->TranslatePhysical(ptr),
+                                       sizeof(uint32_t) * count, count);
+  ++frame_indirect_buffers_;
+  frame_indirect_buffer_dwords_ += count;
+  if (indirect_buffer_hashes_previous_frame_.find(hash) !=
+      indirect_buffer_hashes_previous_frame_.cend()) {
+    ++frame_indirect_buffers_repeated_;
+    frame_indirect_buffer_dwords_repeated_ += count;
+  }
+  indirect_buffer_hashes_current_frame_.insert(hash);
+}
+
 void CommandProcessor::InitializeTrace() {
   // Write the initial register values, to be loaded directly into the
   // RegisterFile since all registers, including those that may have side
@@ -11,16 +11,23 @@
 #define XENIA_GPU_COMMAND_PROCESSOR_H_
 
 #include <atomic>
+#include <cstdio>
 #include <cstring>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "xenia/base/ring_buffer.h"
 #include "xenia/gpu/register_file.h"
+#include "xenia/gpu/render_target_cache.h"
+#include "xenia/gpu/render_target_path_tuning.h"
 #include "xenia/gpu/trace_writer.h"
 #include "xenia/gpu/xenos.h"
 #include "xenia/kernel/xthread.h"
@@ -87,6 +94,33 @@ class CommandProcessor {
   virtual ~CommandProcessor();
   uint32_t counter() const { return counter_; }
   void increment_counter() { counter_++; }
+  // Guest swaps executed so far, can be read from any thread.
+  uint64_t swap_count() const {
+    return swap_count_.load(std::memory_order_relaxed);
+  }
+
+  // Totals since the creation of the command processor, gathered all the time
+  // unlike the BenchmarkStatistics, can be read from any thread.
+  struct RuntimeStatistics {
+    uint64_t swap_count;
+    // Draws that had to wait for their pipelines to be created, and the total
+    // time spent waiting.
+    uint64_t pipeline_creation_stalls;
+    uint64_t pipeline_creation_stall_ns;
+    uint64_t draws_skipped_for_pipeline_creation;
+    // Host memory used by the GPU emulation as of the beginning of the latest
+    // frame.
+    uint64_t texture_memory_bytes;
+    uint64_t shared_memory_bytes;
+    uint64_t upload_buffer_bytes;
+  };
+  RuntimeStatistics GetRuntimeStatistics() const;
+  static constexpr size_t kRecentSwapCount = 256;
+  // Host times of up to kRecentSwapCount latest guest swaps, from the oldest,
+  // can be called from any thread.
+  void GetRecentSwapHostTicks(std::vector<uint64_t>& host_ticks_out) const;
+
+  kernel::XHostThread* worker_thread() const { return worker_thread_.get(); }
 
   Shader* active_vertex_shader() const { return active_vertex_shader_; }
   Shader* active_pixel_shader() const { return active_pixel_shader_; }
@@ -131,6 +165,98 @@ class CommandProcessor {
       const reg::DC_LUT_PWL_DATA* new_gamma_ramp_pwl_rgb,
       uint32_t new_gamma_ramp_rw_component);
   virtual void RestoreEdramSnapshot(const void* snapshot) = 0;
+  // For the keyframes of trace playback, captures the state the trace player
+  // doesn't track itself: writes the memory written by the GPU, such as by
+  // resolves, back to the guest memory, returning the written ranges, and
+  // downloads the EDRAM contents (xenos::kEdramSizeBytes). Returns false if the
+  // state can't be captured completely.
+  virtual bool CaptureTracePlaybackState(
+      std::vector<std::pair<uint32_t, uint32_t>>& gpu_written_ranges_out,
+      void* edram_snapshot_out) {
+    return false;
+  }
+
+  // Categories of the work the host GPU time is measured for using GPU
+  // timestamps while benchmarking trace playback or with
+  // gpu_timestamp_profiling. The time between two consecutive timestamps in a
+  // submission is attributed to the category of the work ending at the latter
+  // one.
+  enum class GpuTimingCategory : uint32_t {
+    // Not attributed to any category, written in the beginning of operations.
+    kNone,
+    // EDRAM ownership transfers and other preparation of the render targets
+    // for a draw.
+    kRenderTargetUpdate,
+    kTextureLoad,
+    // The draw itself and the rest of the preparation for it.
+    kDraw,
+    kResolve,
+    // Refreshing the guest output image on a swap.
+    kPresent,
+
+    kCount,
+  };
+
+  struct BenchmarkStatistics {
+    // Whether the host GPU timestamps are supported by the implementation.
+    bool gpu_timing_supported = false;
+    uint64_t gpu_work_count[size_t(GpuTimingCategory::kCount)] = {};
+    uint64_t gpu_work_time_ns[size_t(GpuTimingCategory::kCount)] = {};
+    // Draws that had to wait for their pipelines to be created, and the total
+    // time spent waiting.
+    uint64_t pipeline_creation_stalls = 0;
+    uint64_t pipeline_creation_stall_ns = 0;
+    uint64_t draws_skipped_for_pipeline_creation = 0;
+    // Guest memory uploaded to the shared memory buffer.
+    uint64_t upload_bytes = 0;
+    // Host time of every guest swap.
+    std::vector<uint64_t> swap_host_ticks;
+    // Host GPU time of the work of every submission frame, if the timestamps
+    // are supported.
+    struct GpuFrame {
+      uint64_t frame;
+      uint64_t work_time_ns[size_t(GpuTimingCategory::kCount)];
+    };
+    std::vector<GpuFrame> gpu_frames;
+    // Hashes of the guest output image captured on every frame_hash_interval
+    // swaps, for comparing the output of runs with different settings. The
+    // image is the one of the swap preceding the one counted by the frame.
+    struct FrameHash {
+      uint64_t frame;
+      uint64_t hash;
+    };
+    std::vector<FrameHash> frame_hashes;
+  };
+
+  // Must be called on the command processor thread. EndBenchmark submits and
+  // awaits the completion of the GPU work done since BeginBenchmark, and
+  // returns its statistics. If frame_hash_interval is not 0, the guest output
+  // image is read back and hashed on every frame_hash_interval swaps.
+  void BeginBenchmark(uint32_t frame_hash_interval = 0);
+  BenchmarkStatistics EndBenchmark();
+
+  // The render target path used by the implementation, if it has a choice
+  // between multiple. Must be called on the command processor thread.
+  virtual std::optional<RenderTargetCache::Path> GetRenderTargetPath() const {
+    return std::nullopt;
+  }
+  // Identifier of the host GPU model without spaces, such as the PCI vendor and
+  // device IDs. Must be called on the command processor thread.
+  virtual std::string GetHostGpuModel() const { return std::string(); }
+  // The path to use instead of the configured one, must be set before
+  // Initialize.
+  std::optional<RenderTargetCache::Path> render_target_path_override() const {
+    return render_target_path_override_;
+  }
+  void SetRenderTargetPathOverride(
+      std::optional<RenderTargetCache::Path> path) {
+    render_target_path_override_ = path;
+  }
+  // Starts measuring the GPU time of the frames with the current render target
+  // path for render_target_path_auto_tune, storing the result in the tuning
+  // records when done. Must be called on the command processor thread.
+  void BeginRenderTargetPathMeasurement(
+      std::shared_ptr<RenderTargetPathTuning> tuning);
 
   void InitializeRingBuffer(uint32_t ptr, uint32_t size_log2);
   void EnableReadPointerWriteBack(uint32_t ptr, uint32_t block_size_log2);
@@ -158,6 +284,32 @@ class CommandProcessor {
   };
 
   void WorkerThreadMain();
+  // Waits until there are new commands in the ring buffer or functions to call
+  // in the worker thread, or until the worker is stopped, returning the last
+  // write pointer. Polls for a short time first, then blocks until the doorbell
+  // is rung.
+  uint32_t WaitForWork();
+  bool IsWaitingForWork(uint32_t write_ptr_index) const {
+    return worker_running_ && pending_fns_.empty() &&
+           (write_ptr_index == 0xBAADF00D ||
+            read_ptr_index_ == write_ptr_index);
+  }
+  // Wakes up the worker thread if it's blocked in WaitForWork.
+  void RingDoorbell();
+  void UpdateIdleStatistics(uint64_t wait_start_host_ticks,
+                            uint64_t block_start_host_ticks,
+                            uint64_t wait_end_host_ticks,
+                            uint64_t kick_host_ticks);
+
+  // Progress of a WAIT_REG_MEM wait - the value is polled without sleeping
+  // first, and then with exponentially growing sleeps.
+  struct RegMemWait {
+    uint64_t spin_end_host_ticks = 0;
+    uint32_t sleep_us = 0;
+  };
+  // Returns whether the thread has slept rather than only paused.
+  bool WaitBeforeRegMemPoll(RegMemWait& wait, uint32_t max_sleep_ms);
+
   virtual bool SetupContext() = 0;
   virtual void ShutdownContext() = 0;
   // rarely needed, most register writes have no special logic here
@@ -166,6 +318,17 @@ class CommandProcessor {
 
   virtual void WriteRegister(uint32_t index, uint32_t value);
 
+  // For the runtime statistics, to be called by the implementations once per
+  // frame.
+  void PublishHostMemoryUsage(uint64_t texture_memory_bytes,
+                              uint64_t shared_memory_bytes,
+                              uint64_t upload_buffer_bytes) {
+    texture_memory_bytes_.store(texture_memory_bytes,
+                                std::memory_order_relaxed);
+    shared_memory_bytes_.store(shared_memory_bytes, std::memory_order_relaxed);
+    upload_buffer_bytes_.store(upload_buffer_bytes, std::memory_order_relaxed);
+  }
+
   // mem has big-endian register values
   XE_FORCEINLINE
   virtual void WriteRegistersFromMem(uint32_t start_index, uint32_t* base,
@@ -218,15 +381,77 @@ class CommandProcessor {
   const reg::DC_LUT_PWL_DATA* gamma_ramp_pwl_rgb() const {
     return gamma_ramp_pwl_rgb_[0];
   }
+  uint32_t gamma_ramp_rw_component() const { return gamma_ramp_rw_component_; }
   virtual void OnGammaRamp256EntryTableValueWritten() {}
   virtual void OnGammaRampPWLValueWritten() {}
 
   virtual void MakeCoherent();
   virtual void PrepareForWait();
   virtual void ReturnFromWait();
+  // Called periodically while the command processor is waiting for new
+  // commands from the guest, which may be waiting for the results of
+  // asynchronous GPU work, such as occlusion queries, in the meantime.
+  virtual void PollWhileWaiting() {}
+  // Whether PollWhileWaiting has anything to do - if not, the command processor
+  // blocks until the guest submits new commands without waking up
+  // periodically.
+  virtual bool IsPollingWhileWaitingNeeded() const { return false; }
 
   virtual void OnPrimaryBufferEnd() {}
 
+  // Called before the guest is notified of the progress of the GPU - via an
+  // interrupt or a fence write - or before waiting for a value written by the
+  // guest, so data read back from the GPU asynchronously must be written to
+  // guest memory here at the latest.
+  virtual void FlushReadbacks() {}
+
+  // Host occlusion queries for EVENT_WRITE_ZPD in the query_occlusion_host
+  // mode. Return false if not supported or failed, in this case, the fake
+  // sample count is reported. After a successful end, the host is responsible
+  // for calling WriteOcclusionQueryResult when the result is available.
+  virtual bool BeginOcclusionQuery() { return false; }
+  virtual bool EndOcclusionQuery(uint32_t sample_counts_address) {
+    return false;
+  }
+  // Writes the sample count for the ended query if the guest still expects it
+  // (if the end markers haven't been overwritten since the end of the query).
+  void WriteOcclusionQueryResult(uint32_t sample_counts_address,
+                                 uint32_t sample_count);
+
+  bool is_benchmarking() const { return benchmarking_; }
+  // Called in BeginBenchmark and EndBenchmark. Both must await the completion
+  // of the GPU work submitted so far, so the GPU timestamps of only the work
+  // done during the benchmark are accumulated, and the end must add the
+  // uploaded data size to benchmark_statistics_.
+  virtual void OnBeginBenchmark() {}
+  virtual void OnEndBenchmark() {}
+
+  struct GpuTimestampLabel {
+    GpuTimingCategory category;
+    // The shaders used by a kDraw, or 0.
+    uint64_t vertex_shader_hash;
+    uint64_t pixel_shader_hash;
+  };
+  // Whether the implementations need to write GPU timestamps around their
+  // work, while benchmarking or with gpu_timestamp_profiling.
+  bool is_gpu_timing_enabled() const;
+  // Adds the time between each pair of consecutive timestamps of a completed
+  // submission to the statistics of the category of the work ending at the
+  // latter one. Must be called for the submissions in their order. When the
+  // timestamps of a new frame are received, the statistics of the previous
+  // one are published to the profiler and exported.
+  void AccumulateGpuTimestamps(uint64_t frame, const uint64_t* timestamps,
+                               const GpuTimestampLabel* labels, size_t count,
+                               double ns_per_tick);
+  // Adds the time since start_host_tick_count a draw has waited for its
+  // pipeline to be created to the runtime and the benchmark statistics.
+  void RecordPipelineCreationStall(uint64_t start_host_tick_count);
+  void RecordDrawSkippedForPipelineCreation();
+  // Called for every guest swap.
+  void RecordSwap();
+  // Called for every non-empty indirect buffer before executing it.
+  void RecordIndirectBuffer(uint32_t ptr, uint32_t count);
+
 #include "pm4_command_processor_declare.h"
 
   virtual Shader* LoadShader(xenos::ShaderType shader_type,
@@ -283,8 +508,25 @@ class CommandProcessor {
   uint32_t read_ptr_update_freq_ = 0;
   uint32_t read_ptr_writeback_ptr_ = 0;
 
-  std::unique_ptr<xe::threading::Event> write_ptr_index_event_;
   std::atomic<uint32_t> write_ptr_index_;
+  // Incremented and notified to wake the worker thread up from WaitForWork.
+  // Write pointer updates only ring it if worker_blocked_ is set, so kicking
+  // while the worker is busy or still polling costs no system call.
+  std::atomic<uint32_t> doorbell_{0};
+  std::atomic<bool> worker_blocked_{false};
+  // Host tick count of the last write pointer update that rang the doorbell.
+  std::atomic<uint64_t> doorbell_kick_host_ticks_{0};
+
+  // Accumulated in the worker thread for log_command_processor_idle.
+  struct IdleStatistics {
+    uint64_t period_start_host_ticks = 0;
+    uint64_t spin_host_ticks = 0;
+    uint64_t blocked_host_ticks = 0;
+    uint64_t kick_count = 0;
+    uint64_t kick_latency_host_ticks = 0;
+    uint64_t kick_latency_max_host_ticks = 0;
+  };
+  IdleStatistics idle_statistics_;
 
   uint64_t bin_select_ = 0xFFFFFFFFull;
   uint64_t bin_mask_ = 0xFFFFFFFFull;
@@ -299,11 +541,62 @@ class CommandProcessor {
   SwapPostEffect swap_post_effect_desired_ = SwapPostEffect::kNone;
   SwapPostEffect swap_post_effect_actual_ = SwapPostEffect::kNone;
 
+  // Statistics of the work done since BeginBenchmark, to be filled by the
+  // implementations while is_benchmarking() is true.
+  BenchmarkStatistics benchmark_statistics_;
+
  private:
   reg::DC_LUT_30_COLOR gamma_ramp_256_entry_table_[256] = {};
   reg::DC_LUT_PWL_DATA gamma_ramp_pwl_rgb_[128][3] = {};
   uint32_t gamma_ramp_rw_component_ = 0;
 
+  bool benchmarking_ = false;
+  uint32_t benchmark_frame_hash_interval_ = 0;
+  std::atomic<uint64_t> swap_count_{0};
+  std::atomic<uint64_t> pipeline_creation_stalls_{0};
+  std::atomic<uint64_t> pipeline_creation_stall_ns_{0};
+  std::atomic<uint64_t> draws_skipped_for_pipeline_creation_{0};
+  std::atomic<uint64_t> texture_memory_bytes_{0};
+  std::atomic<uint64_t> shared_memory_bytes_{0};
+  std::atomic<uint64_t> upload_buffer_bytes_{0};
+  // Ring indexed by the swap count, protected with recent_swaps_mutex_.
+  mutable std::mutex recent_swaps_mutex_;
+  uint64_t recent_swap_host_ticks_[kRecentSwapCount] = {};
+
+  void PublishGpuTimingFrame();
+  void RecordBenchmarkFrameHash(uint64_t frame);
+
+  // Content hashes of the indirect buffers executed in the previous and in the
+  // current frame, with gpu_indirect_buffer_reuse_statistics.
+  std::unordered_set<uint64_t> indirect_buffer_hashes_previous_frame_;
+  std::unordered_set<uint64_t> indirect_buffer_hashes_current_frame_;
+  uint64_t frame_indirect_buffers_ = 0;
+  uint64_t frame_indirect_buffer_dwords_ = 0;
+  uint64_t frame_indirect_buffers_repeated_ = 0;
+  uint64_t frame_indirect_buffer_dwords_repeated_ = 0;
+
+  struct GpuDrawTiming {
+    uint64_t vertex_shader_hash;
+    uint64_t pixel_shader_hash;
+    uint64_t count;
+    uint64_t time_ns;
+  };
+  // The frame the GPU timing statistics are currently accumulated for.
+  uint64_t gpu_timing_frame_ = UINT64_MAX;
+  uint64_t gpu_timing_frame_count_[size_t(GpuTimingCategory::kCount)] = {};
+  uint64_t gpu_timing_frame_time_ns_[size_t(GpuTimingCategory::kCount)] = {};
+  // Keyed by the combination of the shader hashes.
+  std::unordered_map<uint64_t, GpuDrawTiming> gpu_timing_frame_draws_;
+  FILE* gpu_timing_export_file_ = nullptr;
+  bool gpu_timing_export_failed_ = false;
+
+  std::optional<RenderTargetCache::Path> render_target_path_override_;
+  // Measurement of the current render target path, if in progress.
+  std::shared_ptr<RenderTargetPathTuning> render_target_path_tuning_;
+  uint64_t render_target_path_tuning_frame_ = UINT64_MAX;
+  uint32_t render_target_path_tuning_frames_completed_ = 0;
+  uint64_t render_target_path_tuning_time_ns_ = 0;
+
   XE_NOINLINE XE_COLD void LogKickoffInitator(uint32_t value);
 };
 
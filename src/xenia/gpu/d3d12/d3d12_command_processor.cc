@@ -10,10 +10,12 @@
 #include "xenia/gpu/d3d12/d3d12_command_processor.h"
 #include <algorithm>
 #include <cstring>
+#include <iterator>
 #include <sstream>
 #include <utility>
 #include "xenia/base/assert.h"
 #include "xenia/base/byte_order.h"
+#include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
@@ -45,10 +47,32 @@ DEFINE_bool(d3d12_readback_resolve, false,
             "causes mid-frame synchronization, so it has a huge performance "
             "impact.",
             "D3D12");
+DEFINE_bool(d3d12_readback_async, true,
+            "With d3d12_readback_memexport and d3d12_readback_resolve, don't "
+            "wait for the GPU after copying the data to read back, instead, "
+            "write it to guest memory once the GPU has completed the "
+            "submission, or, at the latest, when the guest is notified of the "
+            "progress of the GPU via an interrupt or a fence write.",
+            "D3D12");
 DEFINE_bool(d3d12_submit_on_primary_buffer_end, true,
             "Submit the command list when a PM4 primary buffer ends if it's "
             "possible to submit immediately to try to reduce frame latency.",
             "D3D12");
+DEFINE_bool(
+    d3d12_submission_thread, false,
+    "Replay the recorded commands into the Direct3D 12 command list and "
+    "submit them on a separate thread, so the GPU command processor thread "
+    "can start processing the next PM4 commands while the previous "
+    "submission is being recorded by the driver. Submissions ending frames "
+    "are still awaited before presenting.",
+    "D3D12");
+DEFINE_bool(
+    d3d12_async_shared_memory_upload, false,
+    "Copy guest memory to the shared memory buffer on a separate copy queue "
+    "if the pages are not used by any submission that may still be executing "
+    "on the GPU, so the uploads can overlap with the previous GPU work "
+    "instead of being done with barriers between draws.",
+    "D3D12");
 
 DECLARE_bool(clear_memory_page_state);
 
@@ -116,12 +140,94 @@ void D3D12CommandProcessor::RestoreEdramSnapshot(const void* snapshot) {
   render_target_cache_->RestoreEdramSnapshot(snapshot);
 }
 
+bool D3D12CommandProcessor::CaptureTracePlaybackState(
+    std::vector<std::pair<uint32_t, uint32_t>>& gpu_written_ranges_out,
+    void* edram_snapshot_out) {
+  gpu_written_ranges_out.clear();
+  if (!BeginSubmission(false)) {
+    return false;
+  }
+  // Fails with resolution scaling, as there's no 1:1 mapping.
+  if (!render_target_cache_->InitializeTraceSubmitDownloads()) {
+    return false;
+  }
+  bool shared_memory_submitted =
+      shared_memory_->InitializeTraceSubmitDownloads();
+  AwaitAllQueueOperationsCompletion();
+  bool edram_downloaded = false;
+  render_target_cache_->InitializeTraceCompleteDownloads(
+      [edram_snapshot_out, &edram_downloaded](const void* snapshot) {
+        std::memcpy(edram_snapshot_out, snapshot, xenos::kEdramSizeBytes);
+        edram_downloaded = true;
+      });
+  if (shared_memory_submitted) {
+    shared_memory_->InitializeTraceCompleteDownloads(
+        [this, &gpu_written_ranges_out](uint32_t address, uint32_t length,
+                                        const void* data) {
+          std::memcpy(memory_->TranslatePhysical(address), data, length);
+          gpu_written_ranges_out.emplace_back(address, length);
+        });
+  }
+  return edram_downloaded;
+}
+
 bool D3D12CommandProcessor::PushTransitionBarrier(
     ID3D12Resource* resource, D3D12_RESOURCE_STATES old_state,
     D3D12_RESOURCE_STATES new_state, UINT subresource) {
   if (old_state == new_state) {
     return false;
   }
+  // Merge with a transition of the same resource still in the batch, if no
+  // other barrier involving the resource is between them - no commands have
+  // been recorded between the two transitions, so the intermediate state has
+  // not been used. This happens, for instance, when consecutive resolves and
+  // transfers move the same resource between the copy, UAV and shader
+  // resource states.
+  for (auto it = barriers_.rbegin(); it != barriers_.rend(); ++it) {
+    if (it->Type == D3D12_RESOURCE_BARRIER_TYPE_UAV) {
+      if (!it->UAV.pResource || it->UAV.pResource == resource) {
+        break;
+      }
+      continue;
+    }
+    if (it->Type == D3D12_RESOURCE_BARRIER_TYPE_ALIASING) {
+      if (!it->Aliasing.pResourceBefore || !it->Aliasing.pResourceAfter ||
+          it->Aliasing.pResourceBefore == resource ||
+          it->Aliasing.pResourceAfter == resource) {
+        break;
+      }
+      continue;
+    }
+    if (it->Transition.pResource != resource) {
+      continue;
+    }
+    if (it->Transition.Subresource != subresource ||
+        it->Transition.StateAfter != old_state) {
+      break;
+    }
+    if (it->Transition.StateBefore != new_state) {
+      it->Transition.StateAfter = new_state;
+      ++frame_barriers_merged_;
+      return true;
+    }
+    // Returning to the original state. Read-only states need no
+    // synchronization with the work done before the batch, and for
+    // unordered access, only a UAV barrier is needed. Other states may be
+    // written without ordering guarantees, so keeping the transitions.
+    if (!(new_state & ~D3D12_RESOURCE_STATE_GENERIC_READ)) {
+      barriers_.erase(std::next(it).base());
+      frame_barriers_merged_ += 2;
+      return true;
+    }
+    if (new_state == D3D12_RESOURCE_STATE_UNORDERED_ACCESS) {
+      it->Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+      it->Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+      it->UAV.pResource = resource;
+      ++frame_barriers_merged_;
+      return true;
+    }
+    break;
+  }
   D3D12_RESOURCE_BARRIER barrier;
   barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
   barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
@@ -144,6 +250,16 @@ void D3D12CommandProcessor::PushAliasingBarrier(ID3D12Resource* old_resource,
 }
 
 void D3D12CommandProcessor::PushUAVBarrier(ID3D12Resource* resource) {
+  if (!barriers_.empty()) {
+    // A UAV barrier right after an identical or a global one is redundant.
+    const D3D12_RESOURCE_BARRIER& last_barrier = barriers_.back();
+    if (last_barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_UAV &&
+        (!last_barrier.UAV.pResource ||
+         last_barrier.UAV.pResource == resource)) {
+      ++frame_barriers_merged_;
+      return;
+    }
+  }
   D3D12_RESOURCE_BARRIER barrier;
   barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
   barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
@@ -156,6 +272,8 @@ void D3D12CommandProcessor::SubmitBarriers() {
   if (barrier_count != 0) {
     deferred_command_list_.D3DResourceBarrier(barrier_count, barriers_.data());
     barriers_.clear();
+    frame_barriers_submitted_ += barrier_count;
+    ++frame_barrier_batches_submitted_;
   }
 }
 
@@ -469,6 +587,53 @@ void D3D12CommandProcessor::ReleaseViewBindlessDescriptorImmediately(
   view_bindless_heap_free_.push_back(descriptor_index);
 }
 
+uint32_t D3D12CommandProcessor::FindOrWriteBindlessSampler(
+    D3D12TextureCache::SamplerParameters parameters) {
+  assert_true(bindless_resources_used_);
+  auto it = texture_cache_bindless_sampler_map_.find(parameters.value);
+  if (it != texture_cache_bindless_sampler_map_.end()) {
+    it->second.last_used_frame = frame_current_;
+    return it->second.descriptor_index;
+  }
+  if (sampler_bindless_heap_free_.empty() &&
+      sampler_bindless_heap_allocated_ >= kSamplerHeapSize) {
+    // Reclaim the samplers that the GPU can't be accessing anymore instead of
+    // switching to a new heap and rewriting all the samplers that are still
+    // in use.
+    for (auto sampler_it = texture_cache_bindless_sampler_map_.begin();
+         sampler_it != texture_cache_bindless_sampler_map_.end();) {
+      if (sampler_it->second.last_used_frame <= frame_completed_) {
+        sampler_bindless_heap_free_.push_back(
+            sampler_it->second.descriptor_index);
+        sampler_it = texture_cache_bindless_sampler_map_.erase(sampler_it);
+      } else {
+        ++sampler_it;
+      }
+    }
+    frame_bindless_samplers_reclaimed_ +=
+        uint32_t(sampler_bindless_heap_free_.size());
+  }
+  uint32_t descriptor_index;
+  if (!sampler_bindless_heap_free_.empty()) {
+    descriptor_index = sampler_bindless_heap_free_.back();
+    sampler_bindless_heap_free_.pop_back();
+  } else {
+    if (sampler_bindless_heap_allocated_ >= kSamplerHeapSize) {
+      return UINT32_MAX;
+    }
+    descriptor_index = sampler_bindless_heap_allocated_++;
+  }
+  texture_cache_->WriteSampler(
+      parameters, GetD3D12Provider().OffsetSamplerDescriptor(
+                      sampler_bindless_heap_cpu_start_, descriptor_index));
+  ++frame_bindless_samplers_written_;
+  BindlessSampler& sampler =
+      texture_cache_bindless_sampler_map_[parameters.value];
+  sampler.descriptor_index = descriptor_index;
+  sampler.last_used_frame = frame_current_;
+  return descriptor_index;
+}
+
 bool D3D12CommandProcessor::RequestOneUseSingleViewDescriptors(
     uint32_t count, ui::d3d12::util::DescriptorCpuGpuHandlePair* handles_out) {
   assert_true(submission_open_);
@@ -821,6 +986,20 @@ std::string D3D12CommandProcessor::GetWindowTitleText() const {
   return title.str();
 }
 
+std::optional<RenderTargetCache::Path>
+D3D12CommandProcessor::GetRenderTargetPath() const {
+  if (!render_target_cache_) {
+    return std::nullopt;
+  }
+  return render_target_cache_->GetPath();
+}
+
+std::string D3D12CommandProcessor::GetHostGpuModel() const {
+  const ui::d3d12::D3D12Provider& provider = GetD3D12Provider();
+  return fmt::format("{:04X}:{:04X}", uint32_t(provider.GetAdapterVendorID()),
+                     provider.GetAdapterDeviceID());
+}
+
 bool D3D12CommandProcessor::SetupContext() {
   if (!CommandProcessor::SetupContext()) {
     XELOGE("Failed to initialize base command processor context");
@@ -874,6 +1053,53 @@ bool D3D12CommandProcessor::SetupContext() {
   // Optional - added in Creators Update (SDK 10.0.15063.0).
   command_list_->QueryInterface(IID_PPV_ARGS(&command_list_1_));
 
+  if (cvars::d3d12_submission_thread) {
+    submission_thread_command_list_ =
+        std::make_unique<DeferredCommandList>(*this);
+    submission_thread_shutdown_ = false;
+    submission_thread_ = xe::threading::Thread::Create(
+        {}, [this]() { SubmissionThread(); });
+    if (!submission_thread_) {
+      XELOGE("Failed to create the Direct3D 12 submission thread");
+      return false;
+    }
+    submission_thread_->set_name("GPU Submission");
+  }
+
+  if (cvars::d3d12_async_shared_memory_upload) {
+    D3D12_COMMAND_QUEUE_DESC async_copy_queue_desc;
+    async_copy_queue_desc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+    async_copy_queue_desc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
+    async_copy_queue_desc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+    async_copy_queue_desc.NodeMask = 0;
+    if (FAILED(device->CreateCommandQueue(&async_copy_queue_desc,
+                                          IID_PPV_ARGS(&async_copy_queue_)))) {
+      XELOGE("Failed to create the async copy queue");
+      return false;
+    }
+    if (FAILED(device->CreateFence(0, D3D12_FENCE_FLAG_NONE,
+                                   IID_PPV_ARGS(&async_copy_fence_)))) {
+      XELOGE("Failed to create the async copy fence");
+      return false;
+    }
+    ID3D12CommandAllocator* async_copy_command_allocator;
+    if (FAILED(device->CreateCommandAllocator(
+            D3D12_COMMAND_LIST_TYPE_COPY,
+            IID_PPV_ARGS(&async_copy_command_allocator)))) {
+      XELOGE("Failed to create an async copy command allocator");
+      return false;
+    }
+    async_copy_command_allocators_writable_.push_back(
+        async_copy_command_allocator);
+    if (FAILED(device->CreateCommandList(
+            0, D3D12_COMMAND_LIST_TYPE_COPY, async_copy_command_allocator,
+            nullptr, IID_PPV_ARGS(&async_copy_command_list_)))) {
+      XELOGE("Failed to create the async copy command list");
+      return false;
+    }
+    async_copy_command_list_->Close();
+  }
+
   bindless_resources_used_ =
       cvars::d3d12_bindless &&
       provider.GetResourceBindingTier() >= D3D12_RESOURCE_BINDING_TIER_2;
@@ -1628,6 +1854,43 @@ bool D3D12CommandProcessor::SetupContext() {
   pix_capture_requested_.store(false, std::memory_order_relaxed);
   pix_capturing_ = false;
 
+  if (cvars::query_occlusion_host) {
+    // Not fatal if failed - the fake sample count will be reported then.
+    D3D12_QUERY_HEAP_DESC occlusion_query_heap_desc;
+    occlusion_query_heap_desc.Type = D3D12_QUERY_HEAP_TYPE_OCCLUSION;
+    occlusion_query_heap_desc.Count = kOcclusionQueryCount;
+    occlusion_query_heap_desc.NodeMask = 0;
+    D3D12_RESOURCE_DESC occlusion_query_readback_buffer_desc;
+    ui::d3d12::util::FillBufferResourceDesc(
+        occlusion_query_readback_buffer_desc,
+        sizeof(uint64_t) * kOcclusionQueryCount, D3D12_RESOURCE_FLAG_NONE);
+    void* occlusion_query_readback_mapping;
+    D3D12_RANGE occlusion_query_read_range = {
+        0, sizeof(uint64_t) * kOcclusionQueryCount};
+    if (FAILED(device->CreateQueryHeap(&occlusion_query_heap_desc,
+                                       IID_PPV_ARGS(&occlusion_query_heap_))) ||
+        FAILED(device->CreateCommittedResource(
+            &ui::d3d12::util::kHeapPropertiesReadback,
+            provider.GetHeapFlagCreateNotZeroed(),
+            &occlusion_query_readback_buffer_desc,
+            D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+            IID_PPV_ARGS(&occlusion_query_readback_buffer_))) ||
+        FAILED(occlusion_query_readback_buffer_->Map(
+            0, &occlusion_query_read_range,
+            &occlusion_query_readback_mapping))) {
+      XELOGE("Failed to create the host occlusion query heap");
+      ui::d3d12::util::ReleaseAndNull(occlusion_query_readback_buffer_);
+      ui::d3d12::util::ReleaseAndNull(occlusion_query_heap_);
+    } else {
+      occlusion_query_readback_mapping_ =
+          reinterpret_cast<const uint64_t*>(occlusion_query_readback_mapping);
+      occlusion_queries_free_.reserve(kOcclusionQueryCount);
+      for (uint32_t i = kOcclusionQueryCount; i; --i) {
+        occlusion_queries_free_.push_back(i - 1);
+      }
+    }
+  }
+
   // Just not to expose uninitialized memory.
   std::memset(&system_constants_, 0, sizeof(system_constants_));
 
@@ -1637,9 +1900,52 @@ bool D3D12CommandProcessor::SetupContext() {
 void D3D12CommandProcessor::ShutdownContext() {
   AwaitAllQueueOperationsCompletion();
 
+  if (submission_thread_) {
+    {
+      std::lock_guard<std::mutex> lock(submission_thread_mutex_);
+      submission_thread_shutdown_ = true;
+    }
+    submission_thread_cond_.notify_all();
+    xe::threading::Wait(submission_thread_.get(), false);
+    submission_thread_.reset();
+  }
+  submission_thread_command_list_.reset();
+
   ui::d3d12::util::ReleaseAndNull(readback_buffer_);
   readback_buffer_size_ = 0;
 
+  occlusion_query_active_.reset();
+  occlusion_query_host_active_ = false;
+  occlusion_queries_pending_.clear();
+  occlusion_queries_free_.clear();
+  if (occlusion_query_readback_buffer_) {
+    D3D12_RANGE occlusion_query_write_range = {};
+    occlusion_query_readback_buffer_->Unmap(0, &occlusion_query_write_range);
+    occlusion_query_readback_mapping_ = nullptr;
+  }
+  ui::d3d12::util::ReleaseAndNull(occlusion_query_readback_buffer_);
+  ui::d3d12::util::ReleaseAndNull(occlusion_query_heap_);
+
+  gpu_timestamp_submission_labels_.clear();
+  gpu_timestamp_submissions_pending_.clear();
+  gpu_timestamp_operation_skipped_ = true;
+  gpu_timestamp_creation_failed_ = false;
+  ui::d3d12::util::ReleaseAndNull(gpu_timestamp_readback_buffer_);
+  ui::d3d12::util::ReleaseAndNull(gpu_timestamp_heap_);
+
+  // All submissions have been awaited, so the pending readbacks, if any, are
+  // only left if the device has been removed.
+  for (PendingReadback& readback : readbacks_pending_) {
+    readback_async_buffers_free_.push_back(readback.buffer);
+  }
+  readbacks_pending_.clear();
+  for (const ReadbackAsyncBuffer& buffer : readback_async_buffers_free_) {
+    D3D12_RANGE readback_write_range = {};
+    buffer.buffer->Unmap(0, &readback_write_range);
+    buffer.buffer->Release();
+  }
+  readback_async_buffers_free_.clear();
+
   ui::d3d12::util::ReleaseAndNull(scratch_buffer_);
   scratch_buffer_size_ = 0;
 
@@ -1692,6 +1998,7 @@ void D3D12CommandProcessor::ShutdownContext() {
     }
     sampler_bindless_heaps_overflowed_.clear();
     sampler_bindless_heap_allocated_ = 0;
+    sampler_bindless_heap_free_.clear();
     ui::d3d12::util::ReleaseAndNull(sampler_bindless_heap_current_);
     view_bindless_one_use_descriptors_.clear();
     view_bindless_heap_free_.clear();
@@ -1711,6 +2018,11 @@ void D3D12CommandProcessor::ShutdownContext() {
   ui::d3d12::util::ReleaseAndNull(command_list_);
   ClearCommandAllocatorCache();
 
+  ui::d3d12::util::ReleaseAndNull(async_copy_command_list_);
+  ui::d3d12::util::ReleaseAndNull(async_copy_command_allocator_current_);
+  ui::d3d12::util::ReleaseAndNull(async_copy_fence_);
+  ui::d3d12::util::ReleaseAndNull(async_copy_queue_);
+
   frame_open_ = false;
   frame_current_ = 1;
   frame_completed_ = 0;
@@ -1769,6 +2081,7 @@ void D3D12CommandProcessor::WriteRegisterForceinline(uint32_t index,
   __m128i is_below_upper = _mm_cmplt_epi16(to_rangecheck, upper_bounds);
   __m128i is_within_range = _mm_and_si128(is_above_lower, is_below_upper);
   register_file_->values[index] = value;
+  register_file_->MarkWritten(index);
 
   uint32_t movmask = static_cast<uint32_t>(_mm_movemask_epi8(is_within_range));
 
@@ -2070,6 +2383,7 @@ D3D12CommandProcessor::WriteRegisterRangeFromMem_WithKnownBound(
     uint32_t start_index, uint32_t* base, uint32_t num_registers) {
   uint32_t end = start_index + num_registers;
   LogRegisterSets(start_index, base, num_registers);
+  register_file_->MarkRangeWritten(start_index, num_registers);
   uint32_t current_index = start_index;
 
   auto get_end_before_qty = [&end, current_index](uint32_t regnum) {
@@ -2193,6 +2507,7 @@ void D3D12CommandProcessor::IssueSwap(uint32_t frontbuffer_ptr,
   if (!BeginSubmission(true)) {
     return;
   }
+  WriteGpuTimestamp(GpuTimingCategory::kNone);
 
   // Obtain the actual front buffer size to pass to RefreshGuestOutput,
   // resolution-scaled if it's a resolve destination, or not otherwise.
@@ -2521,6 +2836,7 @@ void D3D12CommandProcessor::IssueSwap(uint32_t frontbuffer_ptr,
         // presenter so it can submit its own commands for displaying it to the
         // queue.
         SubmitBarriers();
+        WriteGpuTimestamp(GpuTimingCategory::kPresent);
         EndSubmission(true);
         return true;
       });
@@ -2612,6 +2928,7 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
   if (!BeginSubmission(true)) {
     return false;
   }
+  WriteGpuTimestamp(GpuTimingCategory::kNone);
 
   // Process primitives.
   PrimitiveProcessor::ProcessingResult primitive_processing_result;
@@ -2654,6 +2971,7 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
                                     normalized_color_mask, *vertex_shader)) {
     return false;
   }
+  WriteGpuTimestamp(GpuTimingCategory::kRenderTargetUpdate);
 
   // Create the pipeline (for this, need the actually used render target formats
   // from the render target cache), translating the shaders - doing this now to
@@ -2690,6 +3008,20 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
           &root_signature)) {
     return false;
   }
+  if (cvars::async_pipeline_creation &&
+      !pipeline_cache_->IsPipelineCreated(pipeline_handle)) {
+    if (!memexport_used) {
+      // Skip the draw until the pipeline is created on the creation threads.
+      ++frame_draws_skipped_for_pipeline_creation_;
+      RecordDrawSkippedForPipelineCreation();
+      return true;
+    }
+    // The effects of memory export may be needed by the guest, can't skip.
+    uint64_t await_start_host_tick_count = Clock::QueryHostTickCount();
+    pipeline_cache_->AwaitPipelineCreation();
+    ++frame_draws_awaiting_pipeline_creation_;
+    RecordPipelineCreationStall(await_start_host_tick_count);
+  }
 
   // Update the textures - this may bind pipelines.
   uint32_t used_texture_mask =
@@ -2698,6 +3030,7 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
            ? pixel_shader->GetUsedTextureMaskAfterTranslation()
            : 0);
   texture_cache_->RequestTextures(used_texture_mask);
+  WriteGpuTimestamp(GpuTimingCategory::kTextureLoad);
 
   // Bind the pipeline after configuring it and doing everything that may bind
   // other pipelines.
@@ -2708,7 +3041,9 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
     current_external_pipeline_ = nullptr;
   }
 
-  // Get dynamic rasterizer state.
+  // Get dynamic rasterizer state, recomputing only what depends on registers
+  // that have been written since the previous draw.
+  uint64_t draw_register_write_stamp = register_file_->AdvanceWriteStamp();
   uint32_t draw_resolution_scale_x = texture_cache_->draw_resolution_scale_x();
   uint32_t draw_resolution_scale_y = texture_cache_->draw_resolution_scale_y();
   draw_util::ViewportInfo viewport_info;
@@ -2723,7 +3058,12 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
       host_render_targets_used &&
           render_target_cache_->depth_float24_convert_in_pixel_shader(),
       host_render_targets_used, pixel_shader && pixel_shader->writes_depth());
-  gviargs.SetupRegisterValues(regs);
+  if (draw_util::GetViewportInfoArgs::AreRegistersWrittenSince(
+          regs, previous_draw_register_write_stamp_)) {
+    gviargs.SetupRegisterValues(regs);
+  } else {
+    gviargs.CopyRegisterValues(previous_viewport_info_args_);
+  }
 
   if (gviargs == previous_viewport_info_args_) {
     viewport_info = previous_viewport_info_;
@@ -2733,8 +3073,12 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
     previous_viewport_info_ = viewport_info;
   }
   // todo: use SIMD for getscissor + scaling here, should reduce code size more
-  draw_util::Scissor scissor;
-  draw_util::GetScissor(regs, scissor);
+  if (draw_util::AreScissorRegistersWrittenSince(
+          regs, previous_draw_register_write_stamp_)) {
+    draw_util::GetScissor(regs, previous_scissor_);
+  }
+  previous_draw_register_write_stamp_ = draw_register_write_stamp;
+  draw_util::Scissor scissor = previous_scissor_;
 #if XE_ARCH_AMD64 == 1
   __m128i* scisp = (__m128i*)&scissor;
   *scisp = _mm_mullo_epi32(
@@ -2753,10 +3097,9 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
   // Update system constants before uploading them.
   // TODO(Triang3l): With ROV, pass the disabled render target mask for safety.
   UpdateSystemConstantValues(
-      memexport_used, primitive_polygonal,
-      primitive_processing_result.line_loop_closing_index,
-      primitive_processing_result.host_shader_index_endian, viewport_info,
-      used_texture_mask, normalized_depth_control, normalized_color_mask);
+      memexport_used, primitive_polygonal, primitive_processing_result,
+      viewport_info, used_texture_mask, normalized_depth_control,
+      normalized_color_mask);
 
   // Update constant buffers, descriptors and root parameters.
   if (!UpdateBindings(vertex_shader, pixel_shader, root_signature,
@@ -2998,6 +3341,8 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
                               D3D12_RESOURCE_STATE_INDEX_BUFFER);
     }
   }
+  WriteGpuTimestamp(GpuTimingCategory::kDraw, vertex_shader->ucode_data_hash(),
+                    pixel_shader ? pixel_shader->ucode_data_hash() : 0);
 
   if (memexport_used) {
     // Make sure this memexporting draw is ordered with other work using shared
@@ -3018,7 +3363,13 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
            memexport_ranges_) {
         memexport_total_size += memexport_range.size_bytes;
       }
-      if (memexport_total_size != 0) {
+      if (memexport_total_size != 0 && cvars::d3d12_readback_async) {
+        for (const draw_util::MemExportRange& memexport_range :
+             memexport_ranges_) {
+          ReadbackAsync(memexport_range.base_address_dwords << 2,
+                        memexport_range.size_bytes);
+        }
+      } else if (memexport_total_size != 0) {
         ID3D12Resource* readback_buffer =
             RequestReadbackBuffer(memexport_total_size);
         if (readback_buffer != nullptr) {
@@ -3091,22 +3442,28 @@ bool D3D12CommandProcessor::IssueCopy() {
   if (!BeginSubmission(true)) {
     return false;
   }
+  WriteGpuTimestamp(GpuTimingCategory::kNone);
+  bool result;
   if (!cvars::d3d12_readback_resolve) {
     uint32_t written_address, written_length;
-    return render_target_cache_->Resolve(*memory_, *shared_memory_,
-                                         *texture_cache_, written_address,
-                                         written_length);
+    result = render_target_cache_->Resolve(*memory_, *shared_memory_,
+                                           *texture_cache_, written_address,
+                                           written_length);
   } else {
-    return IssueCopy_ReadbackResolvePath();
+    result = IssueCopy_ReadbackResolvePath();
   }
-  return true;
+  WriteGpuTimestamp(GpuTimingCategory::kResolve);
+  return result;
 }
 XE_NOINLINE
 bool D3D12CommandProcessor::IssueCopy_ReadbackResolvePath() {
   uint32_t written_address, written_length;
   if (render_target_cache_->Resolve(*memory_, *shared_memory_, *texture_cache_,
                                     written_address, written_length)) {
-    if (!texture_cache_->IsDrawResolutionScaled() && written_length) {
+    if (!texture_cache_->IsDrawResolutionScaled() && written_length &&
+        cvars::d3d12_readback_async) {
+      ReadbackAsync(written_address, written_length);
+    } else if (!texture_cache_->IsDrawResolutionScaled() && written_length) {
       // Read the resolved data on the CPU.
       ID3D12Resource* readback_buffer = RequestReadbackBuffer(written_length);
       if (readback_buffer != nullptr) {
@@ -3204,6 +3561,15 @@ void D3D12CommandProcessor::CheckSubmissionFence(uint64_t await_submission) {
   if (!command_allocator_submitted_first_) {
     command_allocator_submitted_last_ = nullptr;
   }
+  // The direct queue awaits the copy queue, so the copy commands of the
+  // completed submissions have been executed too.
+  while (!async_copy_command_allocators_submitted_.empty() &&
+         async_copy_command_allocators_submitted_.front().second <=
+             submission_completed_) {
+    async_copy_command_allocators_writable_.push_back(
+        async_copy_command_allocators_submitted_.front().first);
+    async_copy_command_allocators_submitted_.pop_front();
+  }
 
   // Release single-use bindless descriptors.
   while (!view_bindless_one_use_descriptors_.empty()) {
@@ -3232,6 +3598,12 @@ void D3D12CommandProcessor::CheckSubmissionFence(uint64_t await_submission) {
   primitive_processor_->CompletedSubmissionUpdated();
 
   texture_cache_->CompletedSubmissionUpdated(submission_completed_);
+
+  CompleteReadbacks(false);
+
+  CompleteOcclusionQueries(false);
+
+  CompleteGpuTimestamps();
 }
 
 bool D3D12CommandProcessor::BeginSubmission(bool is_guest_command) {
@@ -3282,6 +3654,24 @@ bool D3D12CommandProcessor::BeginSubmission(bool is_guest_command) {
       }
       frame_completed_ = frame;
     }
+
+    // Don't let the guest wait for the results of occlusion queries for too
+    // long if it needs them.
+    if (cvars::query_occlusion_host_latency_frames >= 0) {
+      uint64_t occlusion_query_await_submission = 0;
+      for (const OcclusionQuery& occlusion_query :
+           occlusion_queries_pending_) {
+        if (occlusion_query.frame +
+                uint64_t(cvars::query_occlusion_host_latency_frames) >
+            frame_current_) {
+          break;
+        }
+        occlusion_query_await_submission = occlusion_query.submission;
+      }
+      if (occlusion_query_await_submission > submission_completed_) {
+        CheckSubmissionFence(occlusion_query_await_submission);
+      }
+    }
   }
 
   if (!submission_open_) {
@@ -3315,6 +3705,12 @@ bool D3D12CommandProcessor::BeginSubmission(bool is_guest_command) {
     primitive_processor_->BeginSubmission();
 
     texture_cache_->BeginSubmission(submission_current_);
+
+    // Continue counting the samples for the guest occlusion query in the new
+    // submission.
+    if (occlusion_query_active_ && !BeginHostOcclusionQuery()) {
+      occlusion_query_active_->incomplete = true;
+    }
   }
 
   if (is_opening_frame) {
@@ -3366,6 +3762,16 @@ bool D3D12CommandProcessor::BeginSubmission(bool is_guest_command) {
     primitive_processor_->BeginFrame();
 
     texture_cache_->BeginFrame();
+
+    shared_memory_->BeginFrame();
+
+    render_target_cache_->BeginFrame();
+
+    PublishHostMemoryUsage(
+        texture_cache_->textures_total_host_memory_usage(),
+        shared_memory_->GetHostGpuMemoryUsage(),
+        constant_buffer_pool_->page_size() +
+            shared_memory_->upload_buffer_pool_size());
   }
 
   return true;
@@ -3398,32 +3804,88 @@ bool D3D12CommandProcessor::EndSubmission(bool is_swap) {
     texture_cache_->EndFrame();
 
     primitive_processor_->EndFrame();
+
+    COUNT_profile_set("gpu/pipeline_cache/pending_pipelines",
+                      pipeline_cache_->GetPendingPipelineCount());
+    COUNT_profile_set("gpu/pipeline_cache/draws_skipped",
+                      frame_draws_skipped_for_pipeline_creation_);
+    COUNT_profile_set("gpu/pipeline_cache/draws_awaiting_creation",
+                      frame_draws_awaiting_pipeline_creation_);
+    frame_draws_skipped_for_pipeline_creation_ = 0;
+    frame_draws_awaiting_pipeline_creation_ = 0;
+
+    COUNT_profile_set("gpu/d3d12/barriers", frame_barriers_submitted_);
+    COUNT_profile_set("gpu/d3d12/barrier_batches",
+                      frame_barrier_batches_submitted_);
+    COUNT_profile_set("gpu/d3d12/barriers_merged", frame_barriers_merged_);
+    frame_barriers_submitted_ = 0;
+    frame_barrier_batches_submitted_ = 0;
+    frame_barriers_merged_ = 0;
+
+    if (bindless_resources_used_) {
+      COUNT_profile_set("gpu/d3d12/bindless_sampler_writes",
+                        frame_bindless_samplers_written_);
+      COUNT_profile_set("gpu/d3d12/bindless_samplers_reclaimed",
+                        frame_bindless_samplers_reclaimed_);
+      frame_bindless_samplers_written_ = 0;
+      frame_bindless_samplers_reclaimed_ = 0;
+    }
   }
 
   if (submission_open_) {
     assert_false(scratch_buffer_used_);
 
+    EndHostOcclusionQuery();
+
+    EndGpuTimestampSubmission();
+
     pipeline_cache_->EndSubmission();
 
     // Submit barriers now because resources with the queued barriers may be
     // destroyed between frames.
     SubmitBarriers();
 
-    ID3D12CommandQueue* direct_queue = provider.GetDirectQueue();
+    // Execute the copy commands not depending on the pending submissions, so
+    // they may be done while the direct queue is still busy.
+    bool await_async_copy = false;
+    if (async_copy_command_allocator_current_) {
+      async_copy_command_list_->Close();
+      ID3D12CommandList* async_copy_command_lists[] = {
+          async_copy_command_list_};
+      async_copy_queue_->ExecuteCommandLists(1, async_copy_command_lists);
+      async_copy_queue_->Signal(async_copy_fence_, submission_current_);
+      async_copy_command_allocators_submitted_.emplace_back(
+          async_copy_command_allocator_current_, submission_current_);
+      async_copy_command_allocator_current_ = nullptr;
+      await_async_copy = true;
+    }
 
     // Submit the deferred command list.
-    // Only one deferred command list must be executed in the same
-    // ExecuteCommandLists - the boundaries of ExecuteCommandLists are a full
-    // UAV and aliasing barrier, and subsystems of the emulator assume it
-    // happens between Xenia submissions.
     ID3D12CommandAllocator* command_allocator =
         command_allocator_writable_first_->command_allocator;
-    command_allocator->Reset();
-    command_list_->Reset(command_allocator, nullptr);
-    deferred_command_list_.Execute(command_list_, command_list_1_);
-    command_list_->Close();
-    ID3D12CommandList* execute_command_lists[] = {command_list_};
-    direct_queue->ExecuteCommandLists(1, execute_command_lists);
+    if (submission_thread_) {
+      {
+        std::unique_lock<std::mutex> lock(submission_thread_mutex_);
+        // command_list_ is still being used for the previous submission.
+        submission_thread_cond_.wait(lock, [this]() {
+          return submission_thread_command_allocator_ == nullptr;
+        });
+        deferred_command_list_.Swap(*submission_thread_command_list_);
+        submission_thread_command_allocator_ = command_allocator;
+        submission_thread_submission_ = submission_current_;
+        submission_thread_await_async_copy_ = await_async_copy;
+      }
+      submission_thread_cond_.notify_all();
+      // The presenter submits its work and signals its fences on the same
+      // queue after the refresh of the guest output, which must be executed
+      // before that.
+      if (is_swap) {
+        AwaitSubmissionThread();
+      }
+    } else {
+      ExecuteDeferredCommandList(deferred_command_list_, command_allocator,
+                                 submission_current_, await_async_copy);
+    }
     command_allocator_writable_first_->last_usage_submission =
         submission_current_;
     if (command_allocator_submitted_last_) {
@@ -3439,7 +3901,7 @@ bool D3D12CommandProcessor::EndSubmission(bool is_swap) {
       command_allocator_writable_last_ = nullptr;
     }
 
-    direct_queue->Signal(submission_fence_, submission_current_++);
+    ++submission_current_;
 
     submission_open_ = false;
 
@@ -3481,6 +3943,7 @@ bool D3D12CommandProcessor::EndSubmission(bool is_swap) {
         }
         sampler_bindless_heaps_overflowed_.clear();
         sampler_bindless_heap_allocated_ = 0;
+        sampler_bindless_heap_free_.clear();
       } else {
         sampler_bindful_heap_pool_->ClearCache();
         view_bindful_heap_pool_->ClearCache();
@@ -3503,8 +3966,67 @@ bool D3D12CommandProcessor::EndSubmission(bool is_swap) {
   return true;
 }
 
+void D3D12CommandProcessor::ExecuteDeferredCommandList(
+    DeferredCommandList& deferred_command_list,
+    ID3D12CommandAllocator* command_allocator, uint64_t submission,
+    bool await_async_copy) {
+  // Only one deferred command list must be executed in the same
+  // ExecuteCommandLists - the boundaries of ExecuteCommandLists are a full UAV
+  // and aliasing barrier, and subsystems of the emulator assume it happens
+  // between Xenia submissions.
+  command_allocator->Reset();
+  command_list_->Reset(command_allocator, nullptr);
+  deferred_command_list.Execute(command_list_, command_list_1_);
+  command_list_->Close();
+  ID3D12CommandList* execute_command_lists[] = {command_list_};
+  ID3D12CommandQueue* direct_queue = GetD3D12Provider().GetDirectQueue();
+  if (await_async_copy) {
+    direct_queue->Wait(async_copy_fence_, submission);
+  }
+  direct_queue->ExecuteCommandLists(1, execute_command_lists);
+  direct_queue->Signal(submission_fence_, submission);
+  deferred_command_list.Reset();
+}
+
+void D3D12CommandProcessor::SubmissionThread() {
+  std::unique_lock<std::mutex> lock(submission_thread_mutex_);
+  while (true) {
+    submission_thread_cond_.wait(lock, [this]() {
+      return submission_thread_shutdown_ ||
+             submission_thread_command_allocator_ != nullptr;
+    });
+    if (submission_thread_command_allocator_) {
+      // Recording of the next submission doesn't need the lock - it only
+      // waits for this submission when it ends.
+      lock.unlock();
+      ExecuteDeferredCommandList(*submission_thread_command_list_,
+                                 submission_thread_command_allocator_,
+                                 submission_thread_submission_,
+                                 submission_thread_await_async_copy_);
+      lock.lock();
+      submission_thread_command_allocator_ = nullptr;
+      submission_thread_cond_.notify_all();
+      continue;
+    }
+    if (submission_thread_shutdown_) {
+      return;
+    }
+  }
+}
+
+void D3D12CommandProcessor::AwaitSubmissionThread() {
+  if (!submission_thread_) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(submission_thread_mutex_);
+  submission_thread_cond_.wait(lock, [this]() {
+    return submission_thread_command_allocator_ == nullptr;
+  });
+}
+
 bool D3D12CommandProcessor::CanEndSubmissionImmediately() const {
-  return !submission_open_ || !pipeline_cache_->IsCreatingPipelines();
+  return !submission_open_ || cvars::async_pipeline_creation ||
+         !pipeline_cache_->IsCreatingPipelines();
 }
 
 void D3D12CommandProcessor::ClearCommandAllocatorCache() {
@@ -3522,6 +4044,44 @@ void D3D12CommandProcessor::ClearCommandAllocatorCache() {
     command_allocator_writable_first_ = next;
   }
   command_allocator_writable_last_ = nullptr;
+  for (const auto& async_copy_command_allocator_submitted :
+       async_copy_command_allocators_submitted_) {
+    async_copy_command_allocator_submitted.first->Release();
+  }
+  async_copy_command_allocators_submitted_.clear();
+  for (ID3D12CommandAllocator* async_copy_command_allocator :
+       async_copy_command_allocators_writable_) {
+    async_copy_command_allocator->Release();
+  }
+  async_copy_command_allocators_writable_.clear();
+}
+
+ID3D12GraphicsCommandList* D3D12CommandProcessor::GetAsyncCopyCommandList() {
+  assert_true(submission_open_);
+  if (!async_copy_queue_) {
+    return nullptr;
+  }
+  if (async_copy_command_allocator_current_) {
+    return async_copy_command_list_;
+  }
+  ID3D12CommandAllocator* command_allocator;
+  if (!async_copy_command_allocators_writable_.empty()) {
+    command_allocator = async_copy_command_allocators_writable_.back();
+    async_copy_command_allocators_writable_.pop_back();
+    command_allocator->Reset();
+  } else if (FAILED(GetD3D12Provider().GetDevice()->CreateCommandAllocator(
+                 D3D12_COMMAND_LIST_TYPE_COPY,
+                 IID_PPV_ARGS(&command_allocator)))) {
+    XELOGE("Failed to create an async copy command allocator");
+    return nullptr;
+  }
+  if (FAILED(async_copy_command_list_->Reset(command_allocator, nullptr))) {
+    XELOGE("Failed to open the async copy command list");
+    async_copy_command_allocators_writable_.push_back(command_allocator);
+    return nullptr;
+  }
+  async_copy_command_allocator_current_ = command_allocator;
+  return async_copy_command_list_;
 }
 
 void D3D12CommandProcessor::UpdateFixedFunctionState(
@@ -3593,9 +4153,10 @@ void D3D12CommandProcessor::UpdateFixedFunctionState(
 }
 template <bool primitive_polygonal, bool edram_rov_used>
 XE_NOINLINE void D3D12CommandProcessor::UpdateSystemConstantValues_Impl(
-    bool shared_memory_is_uav, uint32_t line_loop_closing_index,
-    xenos::Endian index_endian, const draw_util::ViewportInfo& viewport_info,
-    uint32_t used_texture_mask, reg::RB_DEPTHCONTROL normalized_depth_control,
+    bool shared_memory_is_uav,
+    const PrimitiveProcessor::ProcessingResult& primitive_processing_result,
+    const draw_util::ViewportInfo& viewport_info, uint32_t used_texture_mask,
+    reg::RB_DEPTHCONTROL normalized_depth_control,
     uint32_t normalized_color_mask) {
   const RegisterFile& regs = *register_file_;
   auto pa_cl_clip_cntl = regs.Get<reg::PA_CL_CLIP_CNTL>();
@@ -3680,6 +4241,14 @@ XE_NOINLINE void D3D12CommandProcessor::UpdateSystemConstantValues_Impl(
   if (shared_memory_is_uav) {
     flags |= DxbcShaderTranslator::kSysFlag_SharedMemoryIsUAV;
   }
+  // Vertex index loading for primitive type conversion on the GPU.
+  if (primitive_processing_result.index_buffer_type ==
+      PrimitiveProcessor::ProcessedIndexBufferType::kHostBuiltinForDMA) {
+    flags |= DxbcShaderTranslator::kSysFlag_PrimitiveVertexIndexLoad;
+    if (vgt_draw_initiator.index_size == xenos::IndexFormat::kInt32) {
+      flags |= DxbcShaderTranslator::kSysFlag_PrimitiveVertexIndexLoad32Bit;
+    }
+  }
   // W0 division control.
   // http://www.x.org/docs/AMD/old/evergreen_3D_registers_v2.pdf
   // 8: VTX_XY_FMT = true: the incoming XY have already been multiplied by 1/W0.
@@ -3772,14 +4341,25 @@ XE_NOINLINE void D3D12CommandProcessor::UpdateSystemConstantValues_Impl(
   // index buffer).
 
   update_dirty_uint32_cmp(system_constants_.line_loop_closing_index,
-                          line_loop_closing_index);
-  system_constants_.line_loop_closing_index = line_loop_closing_index;
+                          primitive_processing_result.line_loop_closing_index);
+  system_constants_.line_loop_closing_index =
+      primitive_processing_result.line_loop_closing_index;
+
+  // Index buffer address for loading in the vertex shader.
+  if (flags & DxbcShaderTranslator::kSysFlag_PrimitiveVertexIndexLoad) {
+    update_dirty_uint32_cmp(system_constants_.vertex_index_load_address,
+                            primitive_processing_result.guest_index_base);
+    system_constants_.vertex_index_load_address =
+        primitive_processing_result.guest_index_base;
+  }
 
   // Index or tessellation edge factor buffer endianness.
   update_dirty_uint32_cmp(
       static_cast<uint32_t>(system_constants_.vertex_index_endian),
-      static_cast<uint32_t>(index_endian));
-  system_constants_.vertex_index_endian = index_endian;
+      static_cast<uint32_t>(
+          primitive_processing_result.host_shader_index_endian));
+  system_constants_.vertex_index_endian =
+      primitive_processing_result.host_shader_index_endian;
 
   // Vertex index offset.
 
@@ -4182,7 +4762,7 @@ XE_NOINLINE void D3D12CommandProcessor::UpdateSystemConstantValues_Impl(
 
 void D3D12CommandProcessor::UpdateSystemConstantValues(
     bool shared_memory_is_uav, bool primitive_polygonal,
-    uint32_t line_loop_closing_index, xenos::Endian index_endian,
+    const PrimitiveProcessor::ProcessingResult& primitive_processing_result,
     const draw_util::ViewportInfo& viewport_info, uint32_t used_texture_mask,
     reg::RB_DEPTHCONTROL normalized_depth_control,
     uint32_t normalized_color_mask) {
@@ -4192,26 +4772,22 @@ void D3D12CommandProcessor::UpdateSystemConstantValues(
   if (!edram_rov_used) {
     if (primitive_polygonal) {
       UpdateSystemConstantValues_Impl<true, false>(
-          shared_memory_is_uav, line_loop_closing_index, index_endian,
-          viewport_info, used_texture_mask, normalized_depth_control,
-          normalized_color_mask);
+          shared_memory_is_uav, primitive_processing_result, viewport_info,
+          used_texture_mask, normalized_depth_control, normalized_color_mask);
     } else {
       UpdateSystemConstantValues_Impl<false, false>(
-          shared_memory_is_uav, line_loop_closing_index, index_endian,
-          viewport_info, used_texture_mask, normalized_depth_control,
-          normalized_color_mask);
+          shared_memory_is_uav, primitive_processing_result, viewport_info,
+          used_texture_mask, normalized_depth_control, normalized_color_mask);
     }
   } else {
     if (primitive_polygonal) {
       UpdateSystemConstantValues_Impl<true, true>(
-          shared_memory_is_uav, line_loop_closing_index, index_endian,
-          viewport_info, used_texture_mask, normalized_depth_control,
-          normalized_color_mask);
+          shared_memory_is_uav, primitive_processing_result, viewport_info,
+          used_texture_mask, normalized_depth_control, normalized_color_mask);
     } else {
       UpdateSystemConstantValues_Impl<false, true>(
-          shared_memory_is_uav, line_loop_closing_index, index_endian,
-          viewport_info, used_texture_mask, normalized_depth_control,
-          normalized_color_mask);
+          shared_memory_is_uav, primitive_processing_result, viewport_info,
+          used_texture_mask, normalized_depth_control, normalized_color_mask);
     }
   }
 }
@@ -4584,6 +5160,7 @@ bool D3D12CommandProcessor::UpdateBindings(const D3D12Shader* vertex_shader,
               sampler_bindless_heap_current_
                   ->GetGPUDescriptorHandleForHeapStart();
           sampler_bindless_heap_allocated_ = 0;
+          sampler_bindless_heap_free_.clear();
           // The only thing the heap is used for now is texture cache samplers -
           // invalidate all of them.
           texture_cache_bindless_sampler_map_.clear();
@@ -4599,25 +5176,11 @@ bool D3D12CommandProcessor::UpdateBindings(const D3D12Shader* vertex_shader,
               std::max(current_sampler_bindless_indices_vertex_.size(),
                        size_t(sampler_count_vertex)));
           for (uint32_t j = 0; j < sampler_count_vertex; ++j) {
-            D3D12TextureCache::SamplerParameters sampler_parameters =
-                current_samplers_vertex_[j];
-            uint32_t sampler_index;
-            auto it = texture_cache_bindless_sampler_map_.find(
-                sampler_parameters.value);
-            if (it != texture_cache_bindless_sampler_map_.end()) {
-              sampler_index = it->second;
-            } else {
-              if (sampler_bindless_heap_allocated_ >= kSamplerHeapSize) {
-                samplers_overflowed = true;
-                break;
-              }
-              sampler_index = sampler_bindless_heap_allocated_++;
-              texture_cache_->WriteSampler(
-                  sampler_parameters,
-                  provider.OffsetSamplerDescriptor(
-                      sampler_bindless_heap_cpu_start_, sampler_index));
-              texture_cache_bindless_sampler_map_.emplace(
-                  sampler_parameters.value, sampler_index);
+            uint32_t sampler_index =
+                FindOrWriteBindlessSampler(current_samplers_vertex_[j]);
+            if (sampler_index == UINT32_MAX) {
+              samplers_overflowed = true;
+              break;
             }
             current_sampler_bindless_indices_vertex_[j] = sampler_index;
           }
@@ -4631,25 +5194,11 @@ bool D3D12CommandProcessor::UpdateBindings(const D3D12Shader* vertex_shader,
               std::max(current_sampler_bindless_indices_pixel_.size(),
                        size_t(sampler_count_pixel)));
           for (uint32_t j = 0; j < sampler_count_pixel; ++j) {
-            D3D12TextureCache::SamplerParameters sampler_parameters =
-                current_samplers_pixel_[j];
-            uint32_t sampler_index;
-            auto it = texture_cache_bindless_sampler_map_.find(
-                sampler_parameters.value);
-            if (it != texture_cache_bindless_sampler_map_.end()) {
-              sampler_index = it->second;
-            } else {
-              if (sampler_bindless_heap_allocated_ >= kSamplerHeapSize) {
-                samplers_overflowed = true;
-                break;
-              }
-              sampler_index = sampler_bindless_heap_allocated_++;
-              texture_cache_->WriteSampler(
-                  sampler_parameters,
-                  provider.OffsetSamplerDescriptor(
-                      sampler_bindless_heap_cpu_start_, sampler_index));
-              texture_cache_bindless_sampler_map_.emplace(
-                  sampler_parameters.value, sampler_index);
+            uint32_t sampler_index =
+                FindOrWriteBindlessSampler(current_samplers_pixel_[j]);
+            if (sampler_index == UINT32_MAX) {
+              samplers_overflowed = true;
+              break;
             }
             current_sampler_bindless_indices_pixel_[j] = sampler_index;
           }
@@ -5123,6 +5672,368 @@ ID3D12Resource* D3D12CommandProcessor::RequestReadbackBuffer(uint32_t size) {
   return readback_buffer_;
 }
 
+void D3D12CommandProcessor::ReadbackAsync(uint32_t address, uint32_t length) {
+  if (!length) {
+    return;
+  }
+  // Keep the ranges starting at cache line boundaries in the buffer, for
+  // copying with non-temporal stores.
+  uint32_t length_aligned =
+      xe::align(length, uint32_t(XE_HOST_CACHE_LINE_SIZE));
+  PendingReadback* readback = nullptr;
+  if (!readbacks_pending_.empty()) {
+    PendingReadback& readback_last = readbacks_pending_.back();
+    if (readback_last.submission == submission_current_ &&
+        readback_last.buffer.size - readback_last.buffer_used >=
+            length_aligned) {
+      readback = &readback_last;
+    }
+  }
+  if (!readback) {
+    ReadbackAsyncBuffer buffer = {};
+    for (auto it = readback_async_buffers_free_.begin();
+         it != readback_async_buffers_free_.end(); ++it) {
+      if (it->size >= length_aligned) {
+        buffer = *it;
+        readback_async_buffers_free_.erase(it);
+        break;
+      }
+    }
+    if (!buffer.buffer) {
+      uint32_t size =
+          xe::align(length_aligned, kReadbackAsyncBufferSizeIncrement);
+      const ui::d3d12::D3D12Provider& provider = GetD3D12Provider();
+      ID3D12Device* device = provider.GetDevice();
+      D3D12_RESOURCE_DESC buffer_desc;
+      ui::d3d12::util::FillBufferResourceDesc(buffer_desc, size,
+                                              D3D12_RESOURCE_FLAG_NONE);
+      if (FAILED(device->CreateCommittedResource(
+              &ui::d3d12::util::kHeapPropertiesReadback,
+              provider.GetHeapFlagCreateNotZeroed(), &buffer_desc,
+              D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+              IID_PPV_ARGS(&buffer.buffer)))) {
+        XELOGE("Failed to create a {} MB asynchronous readback buffer",
+               size >> 20);
+        return;
+      }
+      // Readback heaps may stay mapped while the GPU is writing to them, the
+      // data only needs to be read after the fence.
+      void* mapping;
+      D3D12_RANGE read_range = {0, size};
+      if (FAILED(buffer.buffer->Map(0, &read_range, &mapping))) {
+        XELOGE("Failed to map a {} MB asynchronous readback buffer",
+               size >> 20);
+        buffer.buffer->Release();
+        return;
+      }
+      buffer.mapping = reinterpret_cast<const uint8_t*>(mapping);
+      buffer.size = size;
+    }
+    readback = &readbacks_pending_.emplace_back();
+    readback->buffer = buffer;
+    readback->submission = submission_current_;
+    readback->buffer_used = 0;
+  }
+  shared_memory_->UseAsCopySource();
+  SubmitBarriers();
+  deferred_command_list_.D3DCopyBufferRegion(
+      readback->buffer.buffer, readback->buffer_used,
+      shared_memory_->GetBuffer(), address, length);
+  readback->ranges.emplace_back(address, length);
+  readback->buffer_used += length_aligned;
+}
+
+void D3D12CommandProcessor::PrepareForWait() {
+  CommandProcessor::PrepareForWait();
+  // The guest may be waiting for the results of the work in the current
+  // submission, make sure the GPU starts executing it.
+  if (submission_open_ &&
+      ((!readbacks_pending_.empty() &&
+        readbacks_pending_.back().submission == submission_current_) ||
+       (!occlusion_queries_pending_.empty() &&
+        occlusion_queries_pending_.back().submission ==
+            submission_current_))) {
+    EndSubmission(false);
+  }
+}
+
+void D3D12CommandProcessor::PollWhileWaiting() {
+  if (!readbacks_pending_.empty() || !occlusion_queries_pending_.empty()) {
+    CheckSubmissionFence(0);
+  }
+}
+
+bool D3D12CommandProcessor::BeginOcclusionQuery() {
+  if (!occlusion_query_heap_ || !BeginSubmission(true)) {
+    return false;
+  }
+  if (occlusion_query_active_) {
+    // Begun again without ending - the previous result is not needed.
+    EndHostOcclusionQuery();
+    for (uint32_t host_query : occlusion_query_active_->host_queries) {
+      occlusion_queries_free_.push_back(host_query);
+    }
+    occlusion_query_active_.reset();
+  }
+  OcclusionQuery& occlusion_query = occlusion_query_active_.emplace();
+  occlusion_query.sample_counts_address = 0;
+  occlusion_query.frame = 0;
+  occlusion_query.submission = 0;
+  occlusion_query.incomplete = false;
+  if (!BeginHostOcclusionQuery()) {
+    occlusion_query_active_.reset();
+    return false;
+  }
+  return true;
+}
+
+bool D3D12CommandProcessor::EndOcclusionQuery(uint32_t sample_counts_address) {
+  if (!occlusion_query_active_) {
+    return false;
+  }
+  BeginSubmission(true);
+  EndHostOcclusionQuery();
+  OcclusionQuery& occlusion_query = *occlusion_query_active_;
+  if (occlusion_query.incomplete || occlusion_query.host_queries.empty()) {
+    for (uint32_t host_query : occlusion_query.host_queries) {
+      occlusion_queries_free_.push_back(host_query);
+    }
+    occlusion_query_active_.reset();
+    return false;
+  }
+  occlusion_query.sample_counts_address = sample_counts_address;
+  occlusion_query.frame = frame_current_;
+  occlusion_queries_pending_.push_back(std::move(occlusion_query));
+  occlusion_query_active_.reset();
+  return true;
+}
+
+bool D3D12CommandProcessor::BeginHostOcclusionQuery() {
+  assert_true(occlusion_query_active_.has_value());
+  assert_false(occlusion_query_host_active_);
+  if (!submission_open_ || occlusion_queries_free_.empty()) {
+    return false;
+  }
+  uint32_t host_query = occlusion_queries_free_.back();
+  occlusion_queries_free_.pop_back();
+  deferred_command_list_.D3DBeginQuery(
+      occlusion_query_heap_, D3D12_QUERY_TYPE_OCCLUSION, host_query);
+  occlusion_query_active_->host_queries.push_back(host_query);
+  occlusion_query_host_active_ = true;
+  return true;
+}
+
+void D3D12CommandProcessor::EndHostOcclusionQuery() {
+  if (!occlusion_query_host_active_) {
+    return;
+  }
+  assert_true(submission_open_);
+  uint32_t host_query = occlusion_query_active_->host_queries.back();
+  deferred_command_list_.D3DEndQuery(occlusion_query_heap_,
+                                     D3D12_QUERY_TYPE_OCCLUSION, host_query);
+  deferred_command_list_.D3DResolveQueryData(
+      occlusion_query_heap_, D3D12_QUERY_TYPE_OCCLUSION, host_query, 1,
+      occlusion_query_readback_buffer_, sizeof(uint64_t) * host_query);
+  occlusion_query_active_->submission = submission_current_;
+  occlusion_query_host_active_ = false;
+}
+
+void D3D12CommandProcessor::CompleteOcclusionQueries(bool await) {
+  if (occlusion_queries_pending_.empty()) {
+    return;
+  }
+  if (await) {
+    // Calls CompleteOcclusionQueries(false) after the submissions have been
+    // awaited.
+    CheckSubmissionFence(occlusion_queries_pending_.back().submission);
+  }
+  // Report the sample count at the guest resolution.
+  uint64_t resolution_scale =
+      uint64_t(texture_cache_->draw_resolution_scale_x()) *
+      texture_cache_->draw_resolution_scale_y();
+  while (!occlusion_queries_pending_.empty()) {
+    OcclusionQuery& occlusion_query = occlusion_queries_pending_.front();
+    if (occlusion_query.submission > submission_completed_) {
+      break;
+    }
+    uint64_t sample_count = 0;
+    for (uint32_t host_query : occlusion_query.host_queries) {
+      sample_count += occlusion_query_readback_mapping_[host_query];
+      occlusion_queries_free_.push_back(host_query);
+    }
+    WriteOcclusionQueryResult(
+        occlusion_query.sample_counts_address,
+        uint32_t(std::min(sample_count / resolution_scale,
+                          uint64_t(UINT32_MAX))));
+    occlusion_queries_pending_.pop_front();
+  }
+}
+
+void D3D12CommandProcessor::OnBeginBenchmark() {
+  AwaitAllQueueOperationsCompletion();
+  benchmark_upload_bytes_start_ = shared_memory_->total_upload_bytes();
+}
+
+void D3D12CommandProcessor::OnEndBenchmark() {
+  AwaitAllQueueOperationsCompletion();
+  benchmark_statistics_.gpu_timing_supported = gpu_timestamp_heap_ != nullptr;
+  benchmark_statistics_.upload_bytes =
+      shared_memory_->total_upload_bytes() - benchmark_upload_bytes_start_;
+}
+
+void D3D12CommandProcessor::WriteGpuTimestamp(GpuTimingCategory category,
+                                              uint64_t vertex_shader_hash,
+                                              uint64_t pixel_shader_hash) {
+  if (category == GpuTimingCategory::kNone) {
+    gpu_timestamp_operation_skipped_ = true;
+    if (!submission_open_ || !is_gpu_timing_enabled()) {
+      return;
+    }
+    if (!gpu_timestamp_heap_) {
+      if (gpu_timestamp_creation_failed_) {
+        return;
+      }
+      const ui::d3d12::D3D12Provider& provider = GetD3D12Provider();
+      ID3D12Device* device = provider.GetDevice();
+      D3D12_QUERY_HEAP_DESC timestamp_heap_desc;
+      timestamp_heap_desc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+      timestamp_heap_desc.Count = kGpuTimestampCount;
+      timestamp_heap_desc.NodeMask = 0;
+      D3D12_RESOURCE_DESC timestamp_readback_buffer_desc;
+      ui::d3d12::util::FillBufferResourceDesc(
+          timestamp_readback_buffer_desc, sizeof(uint64_t) * kGpuTimestampCount,
+          D3D12_RESOURCE_FLAG_NONE);
+      UINT64 timestamp_frequency;
+      if (FAILED(provider.GetDirectQueue()->GetTimestampFrequency(
+              &timestamp_frequency)) ||
+          FAILED(device->CreateQueryHeap(&timestamp_heap_desc,
+                                         IID_PPV_ARGS(&gpu_timestamp_heap_))) ||
+          FAILED(device->CreateCommittedResource(
+              &ui::d3d12::util::kHeapPropertiesReadback,
+              provider.GetHeapFlagCreateNotZeroed(),
+              &timestamp_readback_buffer_desc, D3D12_RESOURCE_STATE_COPY_DEST,
+              nullptr, IID_PPV_ARGS(&gpu_timestamp_readback_buffer_)))) {
+        XELOGE("Failed to create the GPU timestamp query heap");
+        ui::d3d12::util::ReleaseAndNull(gpu_timestamp_readback_buffer_);
+        ui::d3d12::util::ReleaseAndNull(gpu_timestamp_heap_);
+        gpu_timestamp_creation_failed_ = true;
+        return;
+      }
+      gpu_timestamp_ns_per_tick_ = 1000000000.0 / double(timestamp_frequency);
+    }
+    // The timestamps of the pending submissions are still in use.
+    uint64_t first_in_use =
+        gpu_timestamp_submissions_pending_.empty()
+            ? gpu_timestamp_submission_first_
+            : gpu_timestamp_submissions_pending_.front().first;
+    if (gpu_timestamps_written_ + kGpuTimestampsPerOperationMax -
+            first_in_use >
+        kGpuTimestampCount) {
+      return;
+    }
+    gpu_timestamp_operation_skipped_ = false;
+  } else if (gpu_timestamp_operation_skipped_ || !submission_open_) {
+    return;
+  }
+  deferred_command_list_.D3DEndQuery(
+      gpu_timestamp_heap_, D3D12_QUERY_TYPE_TIMESTAMP,
+      UINT(gpu_timestamps_written_ % kGpuTimestampCount));
+  ++gpu_timestamps_written_;
+  GpuTimestampLabel& label = gpu_timestamp_submission_labels_.emplace_back();
+  label.category = category;
+  label.vertex_shader_hash = vertex_shader_hash;
+  label.pixel_shader_hash = pixel_shader_hash;
+}
+
+void D3D12CommandProcessor::EndGpuTimestampSubmission() {
+  gpu_timestamp_operation_skipped_ = true;
+  if (gpu_timestamp_submission_labels_.empty()) {
+    return;
+  }
+  auto first = UINT(gpu_timestamp_submission_first_ % kGpuTimestampCount);
+  auto count = UINT(gpu_timestamp_submission_labels_.size());
+  // May wrap around the end of the ring.
+  UINT count_before_end = std::min(count, kGpuTimestampCount - first);
+  deferred_command_list_.D3DResolveQueryData(
+      gpu_timestamp_heap_, D3D12_QUERY_TYPE_TIMESTAMP, first, count_before_end,
+      gpu_timestamp_readback_buffer_, sizeof(uint64_t) * first);
+  if (count_before_end < count) {
+    deferred_command_list_.D3DResolveQueryData(
+        gpu_timestamp_heap_, D3D12_QUERY_TYPE_TIMESTAMP, 0,
+        count - count_before_end, gpu_timestamp_readback_buffer_, 0);
+  }
+  GpuTimestampSubmission& submission =
+      gpu_timestamp_submissions_pending_.emplace_back();
+  submission.submission = submission_current_;
+  submission.frame = frame_current_;
+  submission.first = gpu_timestamp_submission_first_;
+  submission.labels = std::move(gpu_timestamp_submission_labels_);
+  gpu_timestamp_submission_labels_.clear();
+  gpu_timestamp_submission_first_ = gpu_timestamps_written_;
+}
+
+void D3D12CommandProcessor::CompleteGpuTimestamps() {
+  std::vector<uint64_t> timestamps;
+  while (!gpu_timestamp_submissions_pending_.empty()) {
+    GpuTimestampSubmission& submission =
+        gpu_timestamp_submissions_pending_.front();
+    if (submission.submission > submission_completed_) {
+      break;
+    }
+    auto first = UINT(submission.first % kGpuTimestampCount);
+    auto count = UINT(submission.labels.size());
+    UINT count_before_end = std::min(count, kGpuTimestampCount - first);
+    void* timestamp_mapping;
+    D3D12_RANGE timestamp_read_range = {0,
+                                        sizeof(uint64_t) * kGpuTimestampCount};
+    if (SUCCEEDED(gpu_timestamp_readback_buffer_->Map(
+            0, &timestamp_read_range, &timestamp_mapping))) {
+      auto timestamp_ring =
+          reinterpret_cast<const uint64_t*>(timestamp_mapping);
+      timestamps.resize(count);
+      std::memcpy(timestamps.data(), timestamp_ring + first,
+                  sizeof(uint64_t) * count_before_end);
+      std::memcpy(timestamps.data() + count_before_end, timestamp_ring,
+                  sizeof(uint64_t) * (count - count_before_end));
+      D3D12_RANGE timestamp_write_range = {};
+      gpu_timestamp_readback_buffer_->Unmap(0, &timestamp_write_range);
+      AccumulateGpuTimestamps(submission.frame, timestamps.data(),
+                              submission.labels.data(), count,
+                              gpu_timestamp_ns_per_tick_);
+    }
+    gpu_timestamp_submissions_pending_.pop_front();
+  }
+}
+
+void D3D12CommandProcessor::CompleteReadbacks(bool await) {
+  if (readbacks_pending_.empty()) {
+    return;
+  }
+  if (await) {
+    // Calls CompleteReadbacks(false) after the submissions have been awaited.
+    CheckSubmissionFence(readbacks_pending_.back().submission);
+  }
+  while (!readbacks_pending_.empty()) {
+    PendingReadback& readback = readbacks_pending_.front();
+    if (readback.submission > submission_completed_) {
+      break;
+    }
+    const uint8_t* source = readback.buffer.mapping;
+    for (const std::pair<uint32_t, uint32_t>& range : readback.ranges) {
+      uint8_t* destination = memory_->TranslatePhysical(range.first);
+      if (!((range.first | range.second) & (XE_HOST_CACHE_LINE_SIZE - 1))) {
+        memory::vastcpy(destination, const_cast<uint8_t*>(source),
+                        range.second);
+      } else {
+        std::memcpy(destination, source, range.second);
+      }
+      source += xe::align(range.second, uint32_t(XE_HOST_CACHE_LINE_SIZE));
+    }
+    readback_async_buffers_free_.push_back(readback.buffer);
+    readbacks_pending_.pop_front();
+  }
+}
+
 void D3D12CommandProcessor::WriteGammaRampSRV(
     bool is_pwl, D3D12_CPU_DESCRIPTOR_HANDLE handle) const {
   ID3D12Device* device = GetD3D12Provider().GetDevice();
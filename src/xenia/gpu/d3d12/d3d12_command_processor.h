@@ -12,8 +12,10 @@
 
 #include <algorithm>
 #include <atomic>
+#include <condition_variable>
 #include <deque>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <unordered_map>
@@ -21,6 +23,8 @@
 #include <vector>
 
 #include "xenia/base/assert.h"
+#include "xenia/base/pool_allocator.h"
+#include "xenia/base/threading.h"
 #include "xenia/gpu/command_processor.h"
 #include "xenia/gpu/d3d12/d3d12_graphics_system.h"
 #include "xenia/gpu/d3d12/d3d12_primitive_processor.h"
@@ -75,6 +79,9 @@ class D3D12CommandProcessor final : public CommandProcessor {
   void TracePlaybackWroteMemory(uint32_t base_ptr, uint32_t length) override;
 
   void RestoreEdramSnapshot(const void* snapshot) override;
+  bool CaptureTracePlaybackState(
+      std::vector<std::pair<uint32_t, uint32_t>>& gpu_written_ranges_out,
+      void* edram_snapshot_out) override;
 
   ui::d3d12::D3D12Provider& GetD3D12Provider() const {
     return *static_cast<ui::d3d12::D3D12Provider*>(
@@ -88,6 +95,16 @@ class D3D12CommandProcessor final : public CommandProcessor {
     return deferred_command_list_;
   }
 
+  // Whether d3d12_async_shared_memory_upload is enabled and the copy queue has
+  // been created.
+  bool IsAsyncCopyQueueUsed() const { return async_copy_queue_ != nullptr; }
+  // Returns the command list that will be executed on the copy queue before
+  // the currently open submission is executed on the direct queue, or nullptr
+  // if not available. The copy queue doesn't wait for the direct queue, so the
+  // commands must not access anything that the submissions that may still be
+  // executing use.
+  ID3D12GraphicsCommandList* GetAsyncCopyCommandList();
+
   uint64_t GetCurrentSubmission() const { return submission_current_; }
   uint64_t GetCompletedSubmission() const { return submission_completed_; }
 
@@ -102,6 +119,8 @@ class D3D12CommandProcessor final : public CommandProcessor {
   uint64_t GetCompletedFrame() const { return frame_completed_; }
 
   // Returns true if the barrier has been inserted (the new state is different).
+  // A transition of a resource that already has a pending transition in the
+  // batch may be merged with it instead.
   bool PushTransitionBarrier(
       ID3D12Resource* resource, D3D12_RESOURCE_STATES old_state,
       D3D12_RESOURCE_STATES new_state,
@@ -225,6 +244,9 @@ class D3D12CommandProcessor final : public CommandProcessor {
   // Returns the text to display in the GPU backend name in the window title.
   std::string GetWindowTitleText() const;
 
+  std::optional<RenderTargetCache::Path> GetRenderTargetPath() const override;
+  std::string GetHostGpuModel() const override;
+
  protected:
   bool SetupContext() override;
   void ShutdownContext() override;
@@ -313,6 +335,24 @@ class D3D12CommandProcessor final : public CommandProcessor {
 
   void OnPrimaryBufferEnd() override;
 
+  void FlushReadbacks() override {
+    if (!readbacks_pending_.empty()) {
+      CompleteReadbacks(true);
+    }
+  }
+
+  void PrepareForWait() override;
+  void PollWhileWaiting() override;
+  bool IsPollingWhileWaitingNeeded() const override {
+    return !readbacks_pending_.empty() || !occlusion_queries_pending_.empty();
+  }
+
+  bool BeginOcclusionQuery() override;
+  bool EndOcclusionQuery(uint32_t sample_counts_address) override;
+
+  void OnBeginBenchmark() override;
+  void OnEndBenchmark() override;
+
   Shader* LoadShader(xenos::ShaderType shader_type, uint32_t guest_address,
                      const uint32_t* host_address,
                      uint32_t dword_count) override;
@@ -429,6 +469,17 @@ class D3D12CommandProcessor final : public CommandProcessor {
   // clearing and stopping capturing. Returns whether the submission was done
   // successfully, if it has failed, leaves it open.
   bool EndSubmission(bool is_swap);
+  // Replays the deferred command list into command_list_ and executes it on the
+  // direct queue, signaling the submission fence with the specified value, and
+  // resets the deferred command list. If await_async_copy is true, the direct
+  // queue first waits for the copy queue commands of the same submission.
+  void ExecuteDeferredCommandList(DeferredCommandList& deferred_command_list,
+                                  ID3D12CommandAllocator* command_allocator,
+                                  uint64_t submission, bool await_async_copy);
+  void SubmissionThread();
+  // Waits until the submission handed off to the submission thread, if any,
+  // has been executed on the queue.
+  void AwaitSubmissionThread();
   // Checks if ending a submission right now would not cause potentially more
   // delay than it would reduce by making the GPU start working earlier - such
   // as when there are unfinished graphics pipeline creation requests that would
@@ -462,19 +513,18 @@ class D3D12CommandProcessor final : public CommandProcessor {
 
   template <bool primitive_polygonal, bool edram_rov_used>
   XE_NOINLINE void UpdateSystemConstantValues_Impl(
-      bool shared_memory_is_uav, uint32_t line_loop_closing_index,
-      xenos::Endian index_endian, const draw_util::ViewportInfo& viewport_info,
-      uint32_t used_texture_mask, reg::RB_DEPTHCONTROL normalized_depth_control,
+      bool shared_memory_is_uav,
+      const PrimitiveProcessor::ProcessingResult& primitive_processing_result,
+      const draw_util::ViewportInfo& viewport_info, uint32_t used_texture_mask,
+      reg::RB_DEPTHCONTROL normalized_depth_control,
       uint32_t normalized_color_mask);
 
-  void UpdateSystemConstantValues(bool shared_memory_is_uav,
-                                  bool primitive_polygonal,
-                                  uint32_t line_loop_closing_index,
-                                  xenos::Endian index_endian,
-                                  const draw_util::ViewportInfo& viewport_info,
-                                  uint32_t used_texture_mask,
-                                  reg::RB_DEPTHCONTROL normalized_depth_control,
-                                  uint32_t normalized_color_mask);
+  void UpdateSystemConstantValues(
+      bool shared_memory_is_uav, bool primitive_polygonal,
+      const PrimitiveProcessor::ProcessingResult& primitive_processing_result,
+      const draw_util::ViewportInfo& viewport_info, uint32_t used_texture_mask,
+      reg::RB_DEPTHCONTROL normalized_depth_control,
+      uint32_t normalized_color_mask);
   bool UpdateBindings(const D3D12Shader* vertex_shader,
                       const D3D12Shader* pixel_shader,
                       ID3D12RootSignature* root_signature,
@@ -491,10 +541,44 @@ class D3D12CommandProcessor final : public CommandProcessor {
       const std::vector<xe::gpu::DxbcShader::TextureBinding>* textures_pixel,
       const size_t sampler_count_vertex, const size_t sampler_count_pixel,
       bool& retflag);
+  // Returns the index of the sampler in the current bindless sampler heap,
+  // writing the descriptor if it's not in the heap yet, or UINT32_MAX if the
+  // heap is full even after reclaiming samplers not used by frames still
+  // executed by the GPU.
+  uint32_t FindOrWriteBindlessSampler(
+      D3D12TextureCache::SamplerParameters parameters);
 
   // Returns a buffer for reading GPU data back to the CPU. Assuming
   // synchronizing immediately after use. Always in COPY_DEST state.
   ID3D12Resource* RequestReadbackBuffer(uint32_t size);
+  // Copies a range of shared memory to a persistently mapped readback buffer
+  // without waiting for the GPU, the data is written to guest memory when the
+  // current submission is completed, or when the readbacks are flushed.
+  void ReadbackAsync(uint32_t address, uint32_t length);
+  // Writes the data from the completed asynchronous readbacks to guest memory,
+  // or, if await is true, waits for all the pending ones.
+  void CompleteReadbacks(bool await);
+
+  // Begins or ends the host query for the active guest occlusion query in the
+  // current submission.
+  bool BeginHostOcclusionQuery();
+  void EndHostOcclusionQuery();
+  // Writes the results of the completed occlusion queries to guest memory, or,
+  // if await is true, waits for all the pending ones.
+  void CompleteOcclusionQueries(bool await);
+
+  // Writes a GPU timestamp ending the work of the specified category if GPU
+  // timing is enabled. kNone must be written in the beginning of an operation,
+  // and if there's no space for the timestamps of the operation in the ring,
+  // the rest of them are skipped until the next operation.
+  void WriteGpuTimestamp(GpuTimingCategory category,
+                         uint64_t vertex_shader_hash = 0,
+                         uint64_t pixel_shader_hash = 0);
+  // Resolves the timestamps written in the current submission, called before
+  // it's ended.
+  void EndGpuTimestampSubmission();
+  // Accumulates the timestamps of the completed submissions.
+  void CompleteGpuTimestamps();
 
   void WriteGammaRampSRV(bool is_pwl, D3D12_CPU_DESCRIPTOR_HANDLE handle) const;
 
@@ -525,6 +609,10 @@ class D3D12CommandProcessor final : public CommandProcessor {
   uint64_t frame_completed_ = 0;
   // Submission indices of frames that have already been submitted.
   uint64_t closed_frame_submissions_[kQueueFrames] = {};
+  // Draws in the current frame that have been skipped, or that have had to
+  // wait, because their pipelines were still being created asynchronously.
+  uint32_t frame_draws_skipped_for_pipeline_creation_ = 0;
+  uint32_t frame_draws_awaiting_pipeline_creation_ = 0;
 
   struct CommandAllocator {
     ID3D12CommandAllocator* command_allocator;
@@ -539,6 +627,36 @@ class D3D12CommandProcessor final : public CommandProcessor {
   ID3D12GraphicsCommandList1* command_list_1_ = nullptr;
   DeferredCommandList deferred_command_list_;
 
+  // With d3d12_submission_thread, the deferred command list of the ended
+  // submission is swapped with submission_thread_command_list_ and replayed on
+  // the submission thread while the next submission is being recorded. The
+  // handed off submission is protected by submission_thread_mutex_, and is
+  // pending while submission_thread_command_allocator_ is not null - notify
+  // submission_thread_cond_ when it's changed.
+  std::unique_ptr<xe::threading::Thread> submission_thread_;
+  std::unique_ptr<DeferredCommandList> submission_thread_command_list_;
+  std::mutex submission_thread_mutex_;
+  std::condition_variable submission_thread_cond_;
+  ID3D12CommandAllocator* submission_thread_command_allocator_ = nullptr;
+  uint64_t submission_thread_submission_ = 0;
+  bool submission_thread_await_async_copy_ = false;
+  bool submission_thread_shutdown_ = false;
+
+  // With d3d12_async_shared_memory_upload, the commands not depending on the
+  // pending submissions are recorded into async_copy_command_list_ and executed
+  // on async_copy_queue_ when the submission ends, signaling async_copy_fence_
+  // with the submission index, which the direct queue awaits before executing
+  // the submission itself. The command list is open while
+  // async_copy_command_allocator_current_ is not null.
+  ID3D12CommandQueue* async_copy_queue_ = nullptr;
+  ID3D12Fence* async_copy_fence_ = nullptr;
+  ID3D12GraphicsCommandList* async_copy_command_list_ = nullptr;
+  ID3D12CommandAllocator* async_copy_command_allocator_current_ = nullptr;
+  std::vector<ID3D12CommandAllocator*> async_copy_command_allocators_writable_;
+  // Allocators with the submission they were last used in.
+  std::deque<std::pair<ID3D12CommandAllocator*, uint64_t>>
+      async_copy_command_allocators_submitted_;
+
   // Should bindless textures and samplers be used - many times faster
   // UpdateBindings than bindful (that becomes a significant bottleneck with
   // bindful - mainly because of CopyDescriptorsSimple, which takes the majority
@@ -590,10 +708,11 @@ class D3D12CommandProcessor final : public CommandProcessor {
   ID3D12DescriptorHeap* sampler_bindless_heap_current_ = nullptr;
   D3D12_CPU_DESCRIPTOR_HANDLE sampler_bindless_heap_cpu_start_;
   D3D12_GPU_DESCRIPTOR_HANDLE sampler_bindless_heap_gpu_start_;
-  // Currently the sampler heap is used only for texture cache samplers, so
-  // individual samplers are never freed, and using a simple linear allocator
-  // inside the current heap without a free list.
+  // Currently the sampler heap is used only for texture cache samplers. They're
+  // allocated linearly, and when the heap is full, samplers not used since the
+  // last completed frame are evicted from the map and their indices are reused.
   uint32_t sampler_bindless_heap_allocated_ = 0;
+  std::vector<uint32_t> sampler_bindless_heap_free_;
   // <Heap, overflow submission number>, if total sampler count used so far
   // exceeds kSamplerHeapSize, and the heap has been switched (this is not a
   // totally impossible situation considering Direct3D 9 has sampler parameter
@@ -602,9 +721,20 @@ class D3D12CommandProcessor final : public CommandProcessor {
   // number (so checking if the first can be reused is enough).
   std::deque<std::pair<ID3D12DescriptorHeap*, uint64_t>>
       sampler_bindless_heaps_overflowed_;
-  // D3D12TextureCache::SamplerParameters::value -> indices within the current
+  struct BindlessSampler {
+    // Index within the current bindless sampler heap.
+    uint32_t descriptor_index;
+    // Bindless descriptor indices are rewritten at the beginning of every
+    // frame, so the sampler can be replaced once this frame is completed.
+    uint64_t last_used_frame;
+  };
+  // D3D12TextureCache::SamplerParameters::value -> sampler in the current
   // bindless sampler heap.
-  std::unordered_map<uint32_t, uint32_t> texture_cache_bindless_sampler_map_;
+  std::unordered_map<uint32_t, BindlessSampler>
+      texture_cache_bindless_sampler_map_;
+  // Bindless sampler descriptor statistics for the current frame.
+  uint32_t frame_bindless_samplers_written_ = 0;
+  uint32_t frame_bindless_samplers_reclaimed_ = 0;
 
   // Root signatures for different descriptor counts.
   std::unordered_map<uint32_t, ID3D12RootSignature*> root_signatures_bindful_;
@@ -682,6 +812,11 @@ class D3D12CommandProcessor final : public CommandProcessor {
 
   // Unsubmitted barrier batch.
   std::vector<D3D12_RESOURCE_BARRIER> barriers_;
+  // Barrier statistics for the current frame - barriers and ResourceBarrier
+  // calls submitted, and barriers eliminated by merging within the batch.
+  uint32_t frame_barriers_submitted_ = 0;
+  uint32_t frame_barrier_batches_submitted_ = 0;
+  uint32_t frame_barriers_merged_ = 0;
 
   // <Submission where requested, resource>, sorted by the submission number.
   std::deque<std::pair<uint64_t, ID3D12Resource*>> resources_for_deletion_;
@@ -696,6 +831,77 @@ class D3D12CommandProcessor final : public CommandProcessor {
   ID3D12Resource* readback_buffer_ = nullptr;
   uint32_t readback_buffer_size_ = 0;
 
+  static constexpr uint32_t kReadbackAsyncBufferSizeIncrement = 4 * 1024 * 1024;
+  struct ReadbackAsyncBuffer {
+    ID3D12Resource* buffer;
+    const uint8_t* mapping;
+    uint32_t size;
+  };
+  struct PendingReadback {
+    ReadbackAsyncBuffer buffer;
+    uint64_t submission;
+    uint32_t buffer_used;
+    // <Guest physical address, length>, in the order of the data in the
+    // buffer, each range starting at a cache line boundary in the buffer.
+    // Usually a few, pooled as readbacks are created very frequently.
+    pooled_vector<std::pair<uint32_t, uint32_t>> ranges;
+  };
+  // Sorted by the submission number.
+  std::deque<PendingReadback> readbacks_pending_;
+  std::vector<ReadbackAsyncBuffer> readback_async_buffers_free_;
+
+  static constexpr uint32_t kOcclusionQueryCount = 4096;
+  ID3D12QueryHeap* occlusion_query_heap_ = nullptr;
+  // Persistently mapped, with a 64-bit result for every query in the heap.
+  ID3D12Resource* occlusion_query_readback_buffer_ = nullptr;
+  const uint64_t* occlusion_query_readback_mapping_ = nullptr;
+  std::vector<uint32_t> occlusion_queries_free_;
+  struct OcclusionQuery {
+    uint32_t sample_counts_address;
+    // The frame in which the guest query has been ended.
+    uint64_t frame;
+    // The last submission with host queries for this guest query.
+    uint64_t submission;
+    // The guest query is split into multiple host queries if it spans multiple
+    // submissions, the results are summed.
+    // Pooled, as there may be a guest query for every draw.
+    pooled_vector<uint32_t> host_queries;
+    // Whether the host query couldn't be begun in some submission.
+    bool incomplete;
+  };
+  // The guest query between the begin and the end EVENT_WRITE_ZPD.
+  std::optional<OcclusionQuery> occlusion_query_active_;
+  // Whether the last of host_queries of occlusion_query_active_ has been begun
+  // in the current submission and not ended yet.
+  bool occlusion_query_host_active_ = false;
+  // Ended guest queries, sorted by the submission number.
+  std::deque<OcclusionQuery> occlusion_queries_pending_;
+
+  // Ring of GPU timestamps, created when GPU timing is enabled for the first
+  // time.
+  static constexpr uint32_t kGpuTimestampCount = 16384;
+  static constexpr uint32_t kGpuTimestampsPerOperationMax = 4;
+  ID3D12QueryHeap* gpu_timestamp_heap_ = nullptr;
+  ID3D12Resource* gpu_timestamp_readback_buffer_ = nullptr;
+  bool gpu_timestamp_creation_failed_ = false;
+  double gpu_timestamp_ns_per_tick_ = 0.0;
+  // Total number of the timestamps written, not wrapped.
+  uint64_t gpu_timestamps_written_ = 0;
+  // The first timestamp of the current submission, not wrapped.
+  uint64_t gpu_timestamp_submission_first_ = 0;
+  std::vector<GpuTimestampLabel> gpu_timestamp_submission_labels_;
+  // Whether the rest of the timestamps of the current operation is skipped.
+  bool gpu_timestamp_operation_skipped_ = true;
+  struct GpuTimestampSubmission {
+    uint64_t submission;
+    uint64_t frame;
+    uint64_t first;
+    std::vector<GpuTimestampLabel> labels;
+  };
+  // Sorted by the submission number.
+  std::deque<GpuTimestampSubmission> gpu_timestamp_submissions_pending_;
+  uint64_t benchmark_upload_bytes_start_ = 0;
+
   // The current fixed-function drawing state.
   D3D12_VIEWPORT ff_viewport_;
   D3D12_RECT ff_scissor_;
@@ -794,6 +1000,12 @@ class D3D12CommandProcessor final : public CommandProcessor {
 
   draw_util::GetViewportInfoArgs previous_viewport_info_args_;
   draw_util::ViewportInfo previous_viewport_info_;
+  // Unscaled.
+  draw_util::Scissor previous_scissor_;
+  // Register file write stamp taken on the previous draw, for skipping
+  // gathering of the viewport arguments and the scissor if their registers
+  // haven't been written since.
+  uint64_t previous_draw_register_write_stamp_ = 0;
 
   std::atomic<bool> pix_capture_requested_ = false;
   bool pix_capturing_;
@@ -220,7 +220,11 @@ bool D3D12RenderTargetCache::Initialize() {
       command_processor_.GetD3D12Provider();
   ID3D12Device* device = provider.GetDevice();
 
-  if (cvars::render_target_path_d3d12 == "rtv") {
+  std::optional<Path> path_override =
+      command_processor_.render_target_path_override();
+  if (path_override) {
+    path_ = *path_override;
+  } else if (cvars::render_target_path_d3d12 == "rtv") {
     path_ = Path::kHostRenderTargets;
   } else if (cvars::render_target_path_d3d12 == "rov") {
     path_ = Path::kPixelShaderInterlock;
@@ -1482,6 +1486,7 @@ bool D3D12RenderTargetCache::Resolve(const Memory& memory,
           texture_cache.MarkRangeAsResolved(
               resolve_info.copy_dest_extent_start,
               resolve_info.copy_dest_extent_length);
+          texture_cache.MarkResolveDestination(resolve_info);
           written_address_out = resolve_info.copy_dest_extent_start;
           written_length_out = resolve_info.copy_dest_extent_length;
           copied = true;
@@ -1640,14 +1645,19 @@ bool D3D12RenderTargetCache::InitializeTraceSubmitDownloads() {
   return true;
 }
 
-void D3D12RenderTargetCache::InitializeTraceCompleteDownloads() {
+void D3D12RenderTargetCache::InitializeTraceCompleteDownloads(
+    const std::function<void(const void* snapshot)>& snapshot_callback) {
   if (!edram_snapshot_download_buffer_) {
     return;
   }
   void* download_mapping;
   if (SUCCEEDED(edram_snapshot_download_buffer_->Map(0, nullptr,
                                                      &download_mapping))) {
-    trace_writer_.WriteEdramSnapshot(download_mapping);
+    if (snapshot_callback) {
+      snapshot_callback(download_mapping);
+    } else {
+      trace_writer_.WriteEdramSnapshot(download_mapping);
+    }
     D3D12_RANGE download_write_range = {};
     edram_snapshot_download_buffer_->Unmap(0, &download_write_range);
   } else {
@@ -4587,6 +4597,7 @@ void D3D12RenderTargetCache::PerformTransfersAndResolveClears(
         command_list.D3DDispatch(group_count_x, group_count_y, 1);
         MarkEdramBufferModified();
       }
+      CountTransferPasses(transfer_rectangle_count, transfer_rectangle_count);
     }
     break;
   }
@@ -5311,6 +5322,7 @@ void D3D12RenderTargetCache::PerformTransfersAndResolveClears(
 
         // Draw the transfer rectangles.
         command_processor_.SubmitBarriers();
+        CountTransferPasses(is_stencil_bit ? 8 : 1, transfer_rectangle_count);
         for (uint32_t j = 0; j <= uint32_t(is_stencil_bit) * 7; ++j) {
           if (is_stencil_bit) {
             uint32_t transfer_stencil_bit = uint32_t(1) << j;
@@ -90,7 +90,11 @@ class D3D12RenderTargetCache final : public RenderTargetCache {
 
   // Returns true if any downloads were submitted to the command processor.
   bool InitializeTraceSubmitDownloads();
-  void InitializeTraceCompleteDownloads();
+  // Writes the downloaded snapshot to the trace, or passes it to the callback
+  // if it's provided, with the data valid only during the call.
+  void InitializeTraceCompleteDownloads(
+      const std::function<void(const void* snapshot)>& snapshot_callback =
+          nullptr);
   void RestoreEdramSnapshot(const void* snapshot);
 
   // For host render targets.
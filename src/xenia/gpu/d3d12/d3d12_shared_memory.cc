@@ -18,6 +18,7 @@
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/gpu/d3d12/d3d12_command_processor.h"
+#include "xenia/gpu/gpu_flags.h"
 #include "xenia/ui/d3d12/d3d12_util.h"
 
 DEFINE_bool(d3d12_tiled_shared_memory, true,
@@ -50,7 +51,7 @@ bool D3D12SharedMemory::Initialize() {
   ui::d3d12::util::FillBufferResourceDesc(
       buffer_desc, kBufferSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
   buffer_state_ = D3D12_RESOURCE_STATE_COPY_DEST;
-  if (cvars::d3d12_tiled_shared_memory &&
+  if ((cvars::d3d12_tiled_shared_memory || cvars::low_memory_mode) &&
       provider.GetTiledResourcesTier() !=
           D3D12_TILED_RESOURCES_TIER_NOT_SUPPORTED &&
       !provider.GetGraphicsAnalysis()) {
@@ -157,6 +158,11 @@ bool D3D12SharedMemory::Initialize() {
       provider, xe::align(ui::d3d12::D3D12UploadBufferPool::kDefaultPageSize,
                           size_t(1) << page_size_log2()));
 
+  if (command_processor_.IsAsyncCopyQueueUsed()) {
+    async_upload_block_submissions_.resize(
+        kBufferSize >> kAsyncUploadBlockSizeLog2, 0);
+  }
+
   return true;
 }
 
@@ -165,6 +171,8 @@ void D3D12SharedMemory::Shutdown(bool from_destructor) {
 
   upload_buffer_pool_.reset();
 
+  async_upload_block_submissions_.clear();
+
   ui::d3d12::util::ReleaseAndNull(buffer_descriptor_heap_);
 
   // First free the buffer to detach it from the heaps.
@@ -330,7 +338,9 @@ bool D3D12SharedMemory::InitializeTraceSubmitDownloads() {
   return true;
 }
 
-void D3D12SharedMemory::InitializeTraceCompleteDownloads() {
+void D3D12SharedMemory::InitializeTraceCompleteDownloads(
+    const std::function<void(uint32_t address, uint32_t length,
+                             const void* data)>& range_callback) {
   if (!trace_download_buffer_) {
     return;
   }
@@ -338,10 +348,17 @@ void D3D12SharedMemory::InitializeTraceCompleteDownloads() {
   if (SUCCEEDED(trace_download_buffer_->Map(0, nullptr, &download_mapping))) {
     uint32_t download_buffer_offset = 0;
     for (const auto& download_range : trace_download_ranges()) {
-      trace_writer_.WriteMemoryRead(
-          download_range.first, download_range.second,
+      const uint8_t* download_data =
           reinterpret_cast<const uint8_t*>(download_mapping) +
-              download_buffer_offset);
+          download_buffer_offset;
+      if (range_callback) {
+        range_callback(download_range.first, download_range.second,
+                       download_data);
+      } else {
+        trace_writer_.WriteMemoryRead(download_range.first,
+                                      download_range.second, download_data);
+      }
+      download_buffer_offset += download_range.second;
     }
     D3D12_RANGE download_write_range = {};
     trace_download_buffer_->Unmap(0, &download_write_range);
@@ -385,6 +402,9 @@ bool D3D12SharedMemory::AllocateSparseHostGpuMemoryRange(
     return false;
   }
   buffer_tiled_heaps_.push_back(heap);
+  // The copy queue must not write to the memory before the mapping is done on
+  // the direct queue.
+  MarkAsyncUploadBlocksUsed(offset_bytes, length_bytes);
 
   D3D12_TILED_RESOURCE_COORDINATE region_start_coordinates;
   region_start_coordinates.X =
@@ -411,9 +431,9 @@ bool D3D12SharedMemory::UploadRanges(
   if (!num_upload_page_ranges) {
     return true;
   }
-  CommitUAVWritesAndTransitionBuffer(D3D12_RESOURCE_STATE_COPY_DEST);
-  command_processor_.SubmitBarriers();
   auto& command_list = command_processor_.GetDeferredCommandList();
+  ID3D12GraphicsCommandList* async_copy_command_list = nullptr;
+  bool buffer_copy_dest = false;
   for (uint32_t i = 0; i < num_upload_page_ranges; ++i) {
     auto& upload_range = upload_page_ranges[i];
     uint32_t upload_range_start = upload_range.first;
@@ -449,9 +469,32 @@ bool D3D12SharedMemory::UploadRanges(
             memory().TranslatePhysical(upload_range_start << page_size_log2()),
             upload_buffer_size);
       }
-      command_list.D3DCopyBufferRegion(
-          buffer_, upload_range_start << page_size_log2(), upload_buffer,
-          UINT64(upload_buffer_offset), UINT64(upload_buffer_size));
+      uint32_t upload_buffer_start = upload_range_start << page_size_log2();
+      bool upload_async =
+          !async_upload_block_submissions_.empty() &&
+          AreAsyncUploadBlocksIdle(upload_buffer_start,
+                                   uint32_t(upload_buffer_size));
+      if (upload_async && !async_copy_command_list) {
+        async_copy_command_list = command_processor_.GetAsyncCopyCommandList();
+        upload_async = async_copy_command_list != nullptr;
+      }
+      if (upload_async) {
+        // Buffers are implicitly promoted to the copy destination state on the
+        // copy queue, and the direct queue awaits the copy queue before
+        // executing the current submission.
+        async_copy_command_list->CopyBufferRegion(
+            buffer_, upload_buffer_start, upload_buffer,
+            UINT64(upload_buffer_offset), UINT64(upload_buffer_size));
+      } else {
+        if (!buffer_copy_dest) {
+          CommitUAVWritesAndTransitionBuffer(D3D12_RESOURCE_STATE_COPY_DEST);
+          command_processor_.SubmitBarriers();
+          buffer_copy_dest = true;
+        }
+        command_list.D3DCopyBufferRegion(
+            buffer_, upload_buffer_start, upload_buffer,
+            UINT64(upload_buffer_offset), UINT64(upload_buffer_size));
+      }
       uint32_t upload_buffer_pages =
           uint32_t(upload_buffer_size >> page_size_log2());
       upload_range_start += upload_buffer_pages;
@@ -461,6 +504,36 @@ bool D3D12SharedMemory::UploadRanges(
   return true;
 }
 
+void D3D12SharedMemory::OnRangeRequested(uint32_t start, uint32_t length) {
+  MarkAsyncUploadBlocksUsed(start, length);
+}
+
+void D3D12SharedMemory::MarkAsyncUploadBlocksUsed(uint32_t start,
+                                                  uint32_t length) {
+  if (async_upload_block_submissions_.empty() || !length) {
+    return;
+  }
+  uint64_t submission = command_processor_.GetCurrentSubmission();
+  uint32_t block_last = (start + length - 1) >> kAsyncUploadBlockSizeLog2;
+  for (uint32_t block = start >> kAsyncUploadBlockSizeLog2;
+       block <= block_last; ++block) {
+    async_upload_block_submissions_[block] = submission;
+  }
+}
+
+bool D3D12SharedMemory::AreAsyncUploadBlocksIdle(uint32_t start,
+                                                 uint32_t length) const {
+  uint64_t submission_completed = command_processor_.GetCompletedSubmission();
+  uint32_t block_last = (start + length - 1) >> kAsyncUploadBlockSizeLog2;
+  for (uint32_t block = start >> kAsyncUploadBlockSizeLog2;
+       block <= block_last; ++block) {
+    if (async_upload_block_submissions_[block] > submission_completed) {
+      return false;
+    }
+  }
+  return true;
+}
+
 }  // namespace d3d12
 }  // namespace gpu
 }  // namespace xe
@@ -11,6 +11,7 @@
 #define XENIA_GPU_D3D12_D3D12_SHARED_MEMORY_H_
 
 #include <algorithm>
+#include <functional>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -45,6 +46,10 @@ class D3D12SharedMemory : public SharedMemory {
   void CompletedSubmissionUpdated();
   void BeginSubmission();
 
+  size_t upload_buffer_pool_size() const {
+    return upload_buffer_pool_->page_size();
+  }
+
   // RequestRange may transition the buffer to copy destination - call it before
   // UseForReading or UseForWriting.
 
@@ -85,7 +90,11 @@ class D3D12SharedMemory : public SharedMemory {
 
   // Returns true if any downloads were submitted to the command processor.
   bool InitializeTraceSubmitDownloads();
-  void InitializeTraceCompleteDownloads();
+  // Writes the downloaded ranges to the trace, or passes them to the callback
+  // if it's provided, with the data valid only during the call.
+  void InitializeTraceCompleteDownloads(
+      const std::function<void(uint32_t address, uint32_t length,
+                               const void* data)>& range_callback = nullptr);
 
  protected:
   bool AllocateSparseHostGpuMemoryRange(uint32_t offset_allocations,
@@ -94,6 +103,8 @@ class D3D12SharedMemory : public SharedMemory {
   bool UploadRanges(const std::pair<uint32_t, uint32_t>* upload_page_ranges,
                     uint32_t num_ranges) override;
 
+  void OnRangeRequested(uint32_t start, uint32_t length) override;
+
  private:
   D3D12CommandProcessor& command_processor_;
   TraceWriter& trace_writer_;
@@ -125,6 +136,17 @@ class D3D12SharedMemory : public SharedMemory {
 
   std::unique_ptr<ui::d3d12::D3D12UploadBufferPool> upload_buffer_pool_;
 
+  // With the async copy queue available, the index of the latest submission
+  // that has requested or mapped anything in each block of the buffer. Uploads
+  // to blocks not accessed by any submission that may still be executing go to
+  // the copy queue and are done before the current submission, without
+  // barriers and in parallel with the previous GPU work, while the rest are
+  // copied on the direct queue in order with the other commands.
+  static constexpr uint32_t kAsyncUploadBlockSizeLog2 = 16;
+  std::vector<uint64_t> async_upload_block_submissions_;
+  void MarkAsyncUploadBlocksUsed(uint32_t start, uint32_t length);
+  bool AreAsyncUploadBlocksIdle(uint32_t start, uint32_t length) const;
+
   // Created temporarily, only for downloading.
   ID3D12Resource* trace_download_buffer_ = nullptr;
   void ResetTraceDownload();
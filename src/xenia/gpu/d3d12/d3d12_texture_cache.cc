@@ -473,6 +473,10 @@ void D3D12TextureCache::EndFrame() {
            unsupported_features & kUnsupportedSnormBit ? " signed" : "");
     unsupported_format_features_used_[i] = 0;
   }
+
+  COUNT_profile_set("gpu/texture_cache/srv_descriptor_writes",
+                    frame_srv_descriptors_written_);
+  frame_srv_descriptors_written_ = 0;
 }
 
 void D3D12TextureCache::RequestTextures(uint32_t used_texture_mask) {
@@ -702,6 +706,10 @@ D3D12TextureCache::SamplerParameters D3D12TextureCache::GetSamplerParameters(
   texture_util::GetSubresourcesFromFetchConstant(fetch, nullptr, nullptr,
                                                  nullptr, nullptr, nullptr,
                                                  &mip_min_level, nullptr);
+  if (IsActiveTextureBaseDeferred(binding.fetch_constant)) {
+    // Only the mips have been loaded so far.
+    mip_min_level = std::max(mip_min_level, uint32_t(1));
+  }
   parameters.mip_min_level = mip_min_level;
   // high cache miss count here, prefetch fetch earlier
   //  TODO(Triang3l): Disable filtering for texture formats not supporting it.
@@ -1346,6 +1354,35 @@ std::unique_ptr<TextureCache::Texture> D3D12TextureCache::CreateTexture(
       new D3D12Texture(*this, key, resource.Get(), resource_state));
 }
 
+bool D3D12TextureCache::QueryHostMemoryBudget(uint64_t& usage_out,
+                                              uint64_t& budget_out) const {
+  return command_processor_.GetD3D12Provider().QueryVideoMemoryBudget(
+      usage_out, budget_out);
+}
+
+bool D3D12TextureCache::CopyTextureDataImpl(Texture& texture,
+                                            Texture& source) {
+  D3D12Texture& d3d12_texture = static_cast<D3D12Texture&>(texture);
+  D3D12Texture& d3d12_source = static_cast<D3D12Texture&>(source);
+  // Update LRU caching because the textures will be used by the command list.
+  d3d12_texture.MarkAsUsed();
+  d3d12_source.MarkAsUsed();
+  ID3D12Resource* texture_resource = d3d12_texture.resource();
+  ID3D12Resource* source_resource = d3d12_source.resource();
+  command_processor_.PushTransitionBarrier(
+      texture_resource,
+      d3d12_texture.SetResourceState(D3D12_RESOURCE_STATE_COPY_DEST),
+      D3D12_RESOURCE_STATE_COPY_DEST);
+  command_processor_.PushTransitionBarrier(
+      source_resource,
+      d3d12_source.SetResourceState(D3D12_RESOURCE_STATE_COPY_SOURCE),
+      D3D12_RESOURCE_STATE_COPY_SOURCE);
+  command_processor_.SubmitBarriers();
+  command_processor_.GetDeferredCommandList().D3DCopyResource(texture_resource,
+                                                              source_resource);
+  return true;
+}
+
 bool D3D12TextureCache::LoadTextureDataFromResidentMemoryImpl(Texture& texture,
                                                               bool load_base,
                                                               bool load_mips) {
@@ -1919,6 +1956,7 @@ uint32_t D3D12TextureCache::FindOrCreateTextureDescriptor(
   device->CreateShaderResourceView(
       texture.resource(), &desc,
       GetTextureDescriptorCPUHandle(descriptor_index));
+  ++frame_srv_descriptors_written_;
   texture.AddSRVDescriptorIndex(descriptor_key, descriptor_index);
   return descriptor_index;
 }
@@ -538,6 +538,11 @@ class D3D12TextureCache final : public TextureCache {
 
   std::unique_ptr<Texture> CreateTexture(TextureKey key) override;
 
+  bool QueryHostMemoryBudget(uint64_t& usage_out,
+                             uint64_t& budget_out) const override;
+
+  bool CopyTextureDataImpl(Texture& texture, Texture& source) override;
+
   // This binds pipelines, allocates descriptors, and copies!
   bool LoadTextureDataFromResidentMemoryImpl(Texture& texture, bool load_base,
                                              bool load_mips) override;
@@ -830,6 +835,11 @@ class D3D12TextureCache final : public TextureCache {
   };
   uint8_t unsupported_format_features_used_[64];
 
+  // Texture SRV descriptors created during this frame - with bindless, an
+  // already bound texture is referenced by its persistent descriptor index
+  // without writing any descriptors.
+  uint32_t frame_srv_descriptors_written_ = 0;
+
   // The tiled buffer for resolved data with resolution scaling.
   // Because on Direct3D 12 (at least on Windows 10 2004) typed SRV or UAV
   // creation fails for offsets above 4 GB, a single tiled 4.5 GB buffer can't
@@ -158,6 +158,21 @@ void DeferredCommandList::Execute(ID3D12GraphicsCommandList* command_list,
                 reinterpret_cast<const uint8_t*>(stream) +
                 xe::align(sizeof(UINT), alignof(D3D12_RESOURCE_BARRIER))));
       } break;
+      case Command::kD3DBeginQuery: {
+        auto& args = *reinterpret_cast<const QueryArguments*>(stream);
+        command_list->BeginQuery(args.query_heap, args.type, args.index);
+      } break;
+      case Command::kD3DEndQuery: {
+        auto& args = *reinterpret_cast<const QueryArguments*>(stream);
+        command_list->EndQuery(args.query_heap, args.type, args.index);
+      } break;
+      case Command::kD3DResolveQueryData: {
+        auto& args =
+            *reinterpret_cast<const D3DResolveQueryDataArguments*>(stream);
+        command_list->ResolveQueryData(
+            args.query_heap, args.type, args.start_index, args.num_queries,
+            args.destination_buffer, args.aligned_destination_buffer_offset);
+      } break;
       case Command::kRSSetScissorRect: {
         command_list->RSSetScissorRects(
             1, reinterpret_cast<const D3D12_RECT*>(stream));
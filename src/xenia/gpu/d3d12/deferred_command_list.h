@@ -39,6 +39,11 @@ class DeferredCommandList {
                       size_t initial_size_bytes = MAX_SIZEOF_COMMANDLIST);
 
   void Reset();
+  // Exchanges the recorded commands with another list, so one can be executed
+  // while commands are being recorded to the other.
+  void Swap(DeferredCommandList& other) {
+    command_stream_.swap(other.command_stream_);
+  }
   void Execute(ID3D12GraphicsCommandList* command_list,
                ID3D12GraphicsCommandList1* command_list_1);
 
@@ -279,6 +284,39 @@ class DeferredCommandList {
                 num_barriers * sizeof(D3D12_RESOURCE_BARRIER));
   }
 
+  void D3DBeginQuery(ID3D12QueryHeap* query_heap, D3D12_QUERY_TYPE type,
+                     UINT index) {
+    auto& args = *reinterpret_cast<QueryArguments*>(
+        WriteCommand(Command::kD3DBeginQuery, sizeof(QueryArguments)));
+    args.query_heap = query_heap;
+    args.type = type;
+    args.index = index;
+  }
+
+  void D3DEndQuery(ID3D12QueryHeap* query_heap, D3D12_QUERY_TYPE type,
+                   UINT index) {
+    auto& args = *reinterpret_cast<QueryArguments*>(
+        WriteCommand(Command::kD3DEndQuery, sizeof(QueryArguments)));
+    args.query_heap = query_heap;
+    args.type = type;
+    args.index = index;
+  }
+
+  void D3DResolveQueryData(ID3D12QueryHeap* query_heap, D3D12_QUERY_TYPE type,
+                           UINT start_index, UINT num_queries,
+                           ID3D12Resource* destination_buffer,
+                           UINT64 aligned_destination_buffer_offset) {
+    auto& args = *reinterpret_cast<D3DResolveQueryDataArguments*>(
+        WriteCommand(Command::kD3DResolveQueryData,
+                     sizeof(D3DResolveQueryDataArguments)));
+    args.query_heap = query_heap;
+    args.type = type;
+    args.start_index = start_index;
+    args.num_queries = num_queries;
+    args.destination_buffer = destination_buffer;
+    args.aligned_destination_buffer_offset = aligned_destination_buffer_offset;
+  }
+
   void RSSetScissorRect(const D3D12_RECT& rect) {
     auto& arg = *reinterpret_cast<D3D12_RECT*>(
         WriteCommand(Command::kRSSetScissorRect, sizeof(D3D12_RECT)));
@@ -424,6 +462,9 @@ class DeferredCommandList {
     kD3DOMSetRenderTargets,
     kD3DOMSetStencilRef,
     kD3DResourceBarrier,
+    kD3DBeginQuery,
+    kD3DEndQuery,
+    kD3DResolveQueryData,
     kRSSetScissorRect,
     kRSSetViewport,
     kD3DSetComputeRoot32BitConstants,
@@ -535,6 +576,21 @@ class DeferredCommandList {
     D3D12_CPU_DESCRIPTOR_HANDLE depth_stencil_descriptor;
   };
 
+  struct QueryArguments {
+    ID3D12QueryHeap* query_heap;
+    D3D12_QUERY_TYPE type;
+    UINT index;
+  };
+
+  struct D3DResolveQueryDataArguments {
+    ID3D12QueryHeap* query_heap;
+    D3D12_QUERY_TYPE type;
+    UINT start_index;
+    UINT num_queries;
+    ID3D12Resource* destination_buffer;
+    UINT64 aligned_destination_buffer_offset;
+  };
+
   struct SetRoot32BitConstantsHeader {
     UINT root_parameter_index;
     UINT num_32bit_values_to_set;
@@ -15,8 +15,10 @@
 #include <cmath>
 #include <cstring>
 #include <deque>
+#include <functional>
 #include <mutex>
 #include <set>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -43,6 +45,11 @@
 #include "xenia/gpu/xenos.h"
 #include "xenia/ui/d3d12/d3d12_util.h"
 
+DECLARE_bool(ac6_ground_fix);
+DECLARE_bool(dxbc_source_map);
+DECLARE_bool(dxbc_switch);
+DECLARE_bool(use_fuzzy_alpha_epsilon);
+
 DEFINE_bool(d3d12_dxbc_disasm, false,
             "Disassemble DXBC shaders after generation.", "D3D12");
 DEFINE_bool(
@@ -58,6 +65,12 @@ DEFINE_int32(
     "the number of threads explicitly (up to the number of logical CPU cores), "
     "0 to disable multithreaded pipeline creation.",
     "D3D12");
+DEFINE_bool(
+    d3d12_shader_storage_compaction, true,
+    "Rewrite the guest shader and the pipeline description storage files "
+    "without duplicate and obsolete entries when loading them, if at least an "
+    "eighth of the entries are redundant.",
+    "D3D12");
 DEFINE_bool(d3d12_tessellation_wireframe, false,
             "Display tessellated surfaces as wireframe for debugging.",
             "D3D12");
@@ -225,6 +238,50 @@ void PipelineCache::Shutdown() {
   ui::d3d12::util::ReleaseAndNull(dxbc_converter_);
 }
 
+namespace {
+
+// Only rewriting the storage files if a considerable part of them is
+// redundant, not to rewrite them in every launch.
+bool IsStorageCompactionNeeded(size_t entry_count, size_t kept_entry_count) {
+  return cvars::d3d12_shader_storage_compaction &&
+         kept_entry_count < entry_count &&
+         entry_count - kept_entry_count >= std::max(entry_count / 8, size_t(1));
+}
+
+// Replaces the contents of a storage file opened for appending with what the
+// function writes, through a temporary file, so the entries aren't lost if the
+// rewrite is interrupted. The file is reopened for appending, if possible,
+// even if replacing it has failed.
+bool ReplaceStorageFile(FILE*& file, const std::filesystem::path& path,
+                        const std::function<bool(FILE* temp_file)>& write) {
+  std::filesystem::path temp_path = xe::filesystem::GetTemporaryFilePath(path);
+  FILE* temp_file = xe::filesystem::OpenFile(temp_path, "wb");
+  if (!temp_file) {
+    return false;
+  }
+  bool written = write(temp_file);
+  written = !fclose(temp_file) && written;
+  if (!written) {
+    std::error_code error_code;
+    std::filesystem::remove(temp_path, error_code);
+    return false;
+  }
+  // Can't replace a file that's open on Windows.
+  fclose(file);
+  bool replaced = xe::filesystem::ReplaceFile(temp_path, path);
+  file = xe::filesystem::OpenFile(path, "a+b");
+  if (!file) {
+    XELOGE(
+        "Failed to reopen the storage file {} after compacting it, new "
+        "entries will not be stored",
+        xe::path_to_utf8(path));
+    return false;
+  }
+  return replaced;
+}
+
+}  // namespace
+
 void PipelineCache::InitializeShaderStorage(
     const std::filesystem::path& cache_root, uint32_t title_id, bool blocking) {
   ShutdownShaderStorage();
@@ -342,6 +399,139 @@ void PipelineCache::InitializeShaderStorage(
     logical_processor_count = 6;
   }
 
+  // Initialize the translation storage stream - read the translations to skip
+  // translating the shaders from the shader storage. The translator output
+  // depends on the configuration and possibly on the host GPU vendor, so it's
+  // stored in shaders/local/.
+  auto shader_storage_local_root = shader_storage_root / "local";
+  auto translation_storage_file_path =
+      shader_storage_local_root /
+      fmt::format("{:08X}.{}.d3d12.xtr", title_id,
+                  edram_rov_used ? "rov" : "rtv");
+  if (std::filesystem::exists(shader_storage_local_root) ||
+      std::filesystem::create_directories(shader_storage_local_root)) {
+    translation_storage_file_ =
+        xe::filesystem::OpenFile(translation_storage_file_path, "a+b");
+  }
+  if (translation_storage_file_) {
+    struct {
+      uint32_t magic;
+      uint32_t version_swapped;
+      uint32_t vendor_id;
+      uint32_t draw_resolution_scale_x;
+      uint32_t draw_resolution_scale_y;
+      uint32_t configuration_flags;
+    } translation_storage_file_header, translation_storage_expected_header;
+    const ui::d3d12::D3D12Provider& provider =
+        command_processor_.GetD3D12Provider();
+    // 'XETR'.
+    translation_storage_expected_header.magic = 0x52544558;
+    translation_storage_expected_header.version_swapped =
+        xe::byte_swap(std::max(TranslationStoredHeader::kVersion,
+                               DxbcShaderTranslator::Modification::kVersion));
+    translation_storage_expected_header.vendor_id =
+        uint32_t(provider.GetAdapterVendorID());
+    translation_storage_expected_header.draw_resolution_scale_x =
+        render_target_cache_.draw_resolution_scale_x();
+    translation_storage_expected_header.draw_resolution_scale_y =
+        render_target_cache_.draw_resolution_scale_y();
+    // Everything that the DXBC generated by the translator depends on.
+    translation_storage_expected_header.configuration_flags =
+        uint32_t(bindless_resources_used_) |
+        (uint32_t(edram_rov_used) << 1) |
+        (uint32_t(render_target_cache_.gamma_render_target_as_srgb()) << 2) |
+        (uint32_t(render_target_cache_.msaa_2x_supported()) << 3) |
+        (uint32_t(cvars::dxbc_source_map ||
+                  provider.GetGraphicsAnalysis() != nullptr)
+         << 4) |
+        (uint32_t(cvars::dxbc_switch) << 5) |
+        (uint32_t(cvars::ac6_ground_fix) << 6) |
+        (uint32_t(cvars::draw_resolution_scaled_texture_offsets) << 7) |
+        (uint32_t(cvars::use_fuzzy_alpha_epsilon) << 8);
+    if (fread(&translation_storage_file_header,
+              sizeof(translation_storage_file_header), 1,
+              translation_storage_file_) &&
+        !std::memcmp(&translation_storage_file_header,
+                     &translation_storage_expected_header,
+                     sizeof(translation_storage_file_header))) {
+      uint64_t translation_storage_valid_bytes =
+          sizeof(translation_storage_file_header);
+      // Load the translations until the end of the file or until a corrupted
+      // one is detected.
+      TranslationStoredHeader translation_header;
+      while (true) {
+        if (!fread(&translation_header, sizeof(translation_header), 1,
+                   translation_storage_file_)) {
+          break;
+        }
+        if (translation_header.texture_binding_count >
+                D3D12Shader::kMaxTextureBindings ||
+            translation_header.sampler_binding_count >
+                D3D12Shader::kMaxSamplerBindings) {
+          break;
+        }
+        StoredTranslation stored_translation;
+        size_t texture_bindings_size =
+            sizeof(D3D12Shader::TextureBinding) *
+            translation_header.texture_binding_count;
+        size_t sampler_bindings_size =
+            sizeof(D3D12Shader::SamplerBinding) *
+            translation_header.sampler_binding_count;
+        stored_translation.texture_bindings.resize(
+            translation_header.texture_binding_count);
+        stored_translation.sampler_bindings.resize(
+            translation_header.sampler_binding_count);
+        stored_translation.binary.resize(translation_header.binary_size_bytes);
+        if ((texture_bindings_size &&
+             !fread(stored_translation.texture_bindings.data(),
+                    texture_bindings_size, 1, translation_storage_file_)) ||
+            (sampler_bindings_size &&
+             !fread(stored_translation.sampler_bindings.data(),
+                    sampler_bindings_size, 1, translation_storage_file_)) ||
+            (translation_header.binary_size_bytes &&
+             !fread(stored_translation.binary.data(),
+                    translation_header.binary_size_bytes, 1,
+                    translation_storage_file_))) {
+          break;
+        }
+        XXH3_state_t hash_state;
+        XXH3_64bits_reset(&hash_state);
+        XXH3_64bits_update(&hash_state,
+                           stored_translation.texture_bindings.data(),
+                           texture_bindings_size);
+        XXH3_64bits_update(&hash_state,
+                           stored_translation.sampler_bindings.data(),
+                           sampler_bindings_size);
+        XXH3_64bits_update(&hash_state, stored_translation.binary.data(),
+                           translation_header.binary_size_bytes);
+        if (translation_header.data_hash != XXH3_64bits_digest(&hash_state) ||
+            stored_translation.binary.empty()) {
+          // Validation failed.
+          break;
+        }
+        translation_storage_valid_bytes +=
+            sizeof(translation_header) + texture_bindings_size +
+            sampler_bindings_size + translation_header.binary_size_bytes;
+        stored_translations_.emplace(
+            std::make_pair(translation_header.ucode_data_hash,
+                           translation_header.modification),
+            std::move(stored_translation));
+      }
+      xe::filesystem::TruncateStdioFile(translation_storage_file_,
+                                        translation_storage_valid_bytes);
+    } else {
+      xe::filesystem::TruncateStdioFile(translation_storage_file_, 0);
+      fwrite(&translation_storage_expected_header,
+             sizeof(translation_storage_expected_header), 1,
+             translation_storage_file_);
+    }
+  } else {
+    XELOGE(
+        "Failed to open the shader translation storage file for writing, "
+        "shaders will be translated in every run: {}",
+        xe::path_to_utf8(translation_storage_file_path));
+  }
+
   // Initialize the Xenos shader storage stream.
   uint64_t shader_storage_initialization_start =
       xe::Clock::QueryHostTickCount();
@@ -356,6 +546,11 @@ void PipelineCache::InitializeShaderStorage(
         xe::path_to_utf8(shader_storage_file_path));
     fclose(pipeline_storage_file_);
     pipeline_storage_file_ = nullptr;
+    if (translation_storage_file_) {
+      fclose(translation_storage_file_);
+      translation_storage_file_ = nullptr;
+    }
+    stored_translations_.clear();
     return;
   }
   ++shader_storage_index_;
@@ -378,6 +573,9 @@ void PipelineCache::InitializeShaderStorage(
     std::vector<uint32_t> ucode_dwords;
     ucode_dwords.reserve(0xFFFF);
     size_t shaders_translated = 0;
+    // For compaction - <offset, size> of every entry that isn't a duplicate.
+    size_t shader_storage_entry_count = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> shader_storage_kept_ranges;
 
     // Threads overlapping file reading.
     std::mutex shaders_translation_thread_mutex;
@@ -490,7 +688,9 @@ void PipelineCache::InitializeShaderStorage(
         // Validation failed.
         break;
       }
+      uint64_t shader_entry_offset = shader_storage_valid_bytes;
       shader_storage_valid_bytes += sizeof(shader_header) + ucode_byte_count;
+      ++shader_storage_entry_count;
       D3D12Shader* shader =
           LoadShader(shader_header.type, ucode_dwords.data(),
                      shader_header.ucode_dword_count, ucode_data_hash);
@@ -499,6 +699,9 @@ void PipelineCache::InitializeShaderStorage(
         // condition will be caused by translating twice in parallel.
         continue;
       }
+      shader_storage_kept_ranges.emplace_back(
+          shader_entry_offset,
+          shader_storage_valid_bytes - shader_entry_offset);
       // Loaded from the current storage - don't write again.
       shader->set_ucode_storage_index(shader_storage_index_);
       // Create new threads if the currently existing threads can't keep up
@@ -549,13 +752,44 @@ void PipelineCache::InitializeShaderStorage(
         }
       }
     }
-    XELOGGPU("Translated {} shaders from the storage in {} milliseconds",
-             shaders_translated,
-             (xe::Clock::QueryHostTickCount() -
-              shader_storage_initialization_start) *
-                 1000 / xe::Clock::QueryHostTickFrequency());
-    xe::filesystem::TruncateStdioFile(shader_storage_file_,
-                                      shader_storage_valid_bytes);
+    XELOGGPU(
+        "Translated {} shaders from the storage of {} entries in {} "
+        "milliseconds",
+        shaders_translated, shader_storage_entry_count,
+        (xe::Clock::QueryHostTickCount() -
+         shader_storage_initialization_start) *
+            1000 / xe::Clock::QueryHostTickFrequency());
+    if (IsStorageCompactionNeeded(shader_storage_entry_count,
+                                  shader_storage_kept_ranges.size())) {
+      std::vector<uint8_t> shader_entry_data;
+      auto write_kept_shaders = [&](FILE* temp_file) {
+        if (!fwrite(&shader_storage_file_header,
+                    sizeof(shader_storage_file_header), 1, temp_file)) {
+          return false;
+        }
+        for (const auto& kept_range : shader_storage_kept_ranges) {
+          shader_entry_data.resize(size_t(kept_range.second));
+          if (!xe::filesystem::Seek(shader_storage_file_,
+                                    int64_t(kept_range.first), SEEK_SET) ||
+              !fread(shader_entry_data.data(), shader_entry_data.size(), 1,
+                     shader_storage_file_) ||
+              !fwrite(shader_entry_data.data(), shader_entry_data.size(), 1,
+                      temp_file)) {
+            return false;
+          }
+        }
+        return true;
+      };
+      if (ReplaceStorageFile(shader_storage_file_, shader_storage_file_path,
+                             write_kept_shaders)) {
+        XELOGGPU("Compacted the guest shader storage from {} to {} entries",
+                 shader_storage_entry_count,
+                 shader_storage_kept_ranges.size());
+      }
+    } else {
+      xe::filesystem::TruncateStdioFile(shader_storage_file_,
+                                        shader_storage_valid_bytes);
+    }
   } else {
     xe::filesystem::TruncateStdioFile(shader_storage_file_, 0);
     shader_storage_file_header.magic = shader_storage_magic;
@@ -588,10 +822,26 @@ void PipelineCache::InitializeShaderStorage(
     }
 
     size_t pipelines_created = 0;
+    // For compaction - the descriptions that aren't duplicates and that can
+    // still be used.
+    std::vector<const PipelineStoredDescription*>
+        pipeline_stored_descriptions_kept;
+    std::unordered_map<uint64_t, const PipelineStoredDescription*>
+        pipeline_stored_descriptions_first;
     for (const PipelineStoredDescription& pipeline_stored_description :
          pipeline_stored_descriptions) {
       const PipelineDescription& pipeline_description =
           pipeline_stored_description.description;
+      auto first_it = pipeline_stored_descriptions_first
+                          .emplace(pipeline_stored_description.description_hash,
+                                   &pipeline_stored_description)
+                          .first;
+      if (first_it->second != &pipeline_stored_description &&
+          !std::memcmp(&first_it->second->description, &pipeline_description,
+                       sizeof(pipeline_description))) {
+        // Appeared twice in this file.
+        continue;
+      }
       // TODO(Triang3l): On Vulkan, skip pipelines requiring unsupported device
       // features (to keep the cache files mostly shareable across devices).
       // Skip already known pipelines - those have already been enqueued.
@@ -607,9 +857,13 @@ void PipelineCache::InitializeShaderStorage(
         }
       }
       if (pipeline_found) {
+        pipeline_stored_descriptions_kept.push_back(
+            &pipeline_stored_description);
         continue;
       }
 
+      // The pipelines skipped below use shaders that are not in the storage or
+      // can't be translated on this host anymore.
       PipelineRuntimeDescription pipeline_runtime_description;
       auto vertex_shader_it =
           shaders_.find(pipeline_description.vertex_shader_hash);
@@ -686,9 +940,10 @@ void PipelineCache::InitializeShaderStorage(
         }
         creation_request_cond_.notify_one();
       } else {
-        new_pipeline->state = CreateD3D12Pipeline(pipeline_runtime_description);
+        CreatePipeline(*new_pipeline);
       }
       ++pipelines_created;
+      pipeline_stored_descriptions_kept.push_back(&pipeline_stored_description);
     }
 
     if (!creation_threads_.empty()) {
@@ -733,13 +988,40 @@ void PipelineCache::InitializeShaderStorage(
         pipelines_created,
         (xe::Clock::QueryHostTickCount() - pipeline_creation_start_) * 1000 /
             xe::Clock::QueryHostTickFrequency());
-    // If any pipeline descriptions were corrupted (or the whole file has excess
-    // bytes in the end), truncate to the last valid pipeline description.
-    xe::filesystem::TruncateStdioFile(
-        pipeline_storage_file_,
-        uint64_t(sizeof(pipeline_storage_file_header) +
-                 sizeof(PipelineStoredDescription) *
-                     pipeline_stored_descriptions.size()));
+    if (IsStorageCompactionNeeded(pipeline_stored_descriptions.size(),
+                                  pipeline_stored_descriptions_kept.size())) {
+      auto write_kept_pipelines = [&](FILE* temp_file) {
+        if (!fwrite(&pipeline_storage_file_header,
+                    sizeof(pipeline_storage_file_header), 1, temp_file)) {
+          return false;
+        }
+        for (const PipelineStoredDescription* pipeline_stored_description :
+             pipeline_stored_descriptions_kept) {
+          if (!fwrite(pipeline_stored_description,
+                      sizeof(PipelineStoredDescription), 1, temp_file)) {
+            return false;
+          }
+        }
+        return true;
+      };
+      if (ReplaceStorageFile(pipeline_storage_file_,
+                             pipeline_storage_file_path,
+                             write_kept_pipelines)) {
+        XELOGGPU(
+            "Compacted the pipeline description storage from {} to {} entries",
+            pipeline_stored_descriptions.size(),
+            pipeline_stored_descriptions_kept.size());
+      }
+    } else {
+      // If any pipeline descriptions were corrupted (or the whole file has
+      // excess bytes in the end), truncate to the last valid pipeline
+      // description.
+      xe::filesystem::TruncateStdioFile(
+          pipeline_storage_file_,
+          uint64_t(sizeof(pipeline_storage_file_header) +
+                   sizeof(PipelineStoredDescription) *
+                       pipeline_stored_descriptions.size()));
+    }
   } else {
     xe::filesystem::TruncateStdioFile(pipeline_storage_file_, 0);
     pipeline_storage_file_header.magic = pipeline_storage_magic;
@@ -756,6 +1038,7 @@ void PipelineCache::InitializeShaderStorage(
   // Start the storage writing thread.
   storage_write_flush_shaders_ = false;
   storage_write_flush_pipelines_ = false;
+  storage_write_flush_translations_ = false;
   storage_write_thread_shutdown_ = false;
   storage_write_thread_ =
       xe::threading::Thread::Create({}, [this]() { StorageWriteThread(); });
@@ -775,6 +1058,13 @@ void PipelineCache::ShutdownShaderStorage() {
   }
   storage_write_shader_queue_.clear();
   storage_write_pipeline_queue_.clear();
+  storage_write_translation_queue_.clear();
+
+  if (translation_storage_file_) {
+    fclose(translation_storage_file_);
+    translation_storage_file_ = nullptr;
+  }
+  stored_translations_.clear();
 
   if (pipeline_storage_file_) {
     fclose(pipeline_storage_file_);
@@ -808,25 +1098,10 @@ void PipelineCache::EndSubmission() {
     shader_storage_file_flush_needed_ = false;
     pipeline_storage_file_flush_needed_ = false;
   }
-  if (!creation_threads_.empty()) {
-    CreateQueuedPipelinesOnProcessorThread();
-    // Await creation of all queued pipelines.
-    bool await_creation_completion_event;
-    {
-      std::lock_guard<xe_mutex> lock(creation_request_lock_);
-      // Assuming the creation queue is already empty (because the processor
-      // thread also worked on creating the leftover pipelines), so only check
-      // if there are threads with pipelines currently being created.
-      await_creation_completion_event = creation_threads_busy_ != 0;
-      if (await_creation_completion_event) {
-        creation_completion_event_->Reset();
-        creation_completion_set_event_ = true;
-      }
-    }
-    if (await_creation_completion_event) {
-      creation_request_cond_.notify_one();
-      xe::threading::Wait(creation_completion_event_.get(), false);
-    }
+  // With asynchronous creation, draws with pipelines not created yet are
+  // either skipped or await the creation themselves.
+  if (!cvars::async_pipeline_creation) {
+    AwaitPipelineCreation();
   }
 }
 
@@ -838,6 +1113,38 @@ bool PipelineCache::IsCreatingPipelines() {
   return !creation_queue_.empty() || creation_threads_busy_ != 0;
 }
 
+size_t PipelineCache::GetPendingPipelineCount() {
+  if (creation_threads_.empty()) {
+    return 0;
+  }
+  std::lock_guard<xe_mutex> lock(creation_request_lock_);
+  return creation_queue_.size() + creation_threads_busy_;
+}
+
+void PipelineCache::AwaitPipelineCreation() {
+  if (creation_threads_.empty()) {
+    return;
+  }
+  CreateQueuedPipelinesOnProcessorThread();
+  // Await creation of all queued pipelines.
+  bool await_creation_completion_event;
+  {
+    std::lock_guard<xe_mutex> lock(creation_request_lock_);
+    // Assuming the creation queue is already empty (because the processor
+    // thread also worked on creating the leftover pipelines), so only check
+    // if there are threads with pipelines currently being created.
+    await_creation_completion_event = creation_threads_busy_ != 0;
+    if (await_creation_completion_event) {
+      creation_completion_event_->Reset();
+      creation_completion_set_event_ = true;
+    }
+  }
+  if (await_creation_completion_event) {
+    creation_request_cond_.notify_one();
+    xe::threading::Wait(creation_completion_event_.get(), false);
+  }
+}
+
 D3D12Shader* PipelineCache::LoadShader(xenos::ShaderType shader_type,
                                        const uint32_t* host_address,
                                        uint32_t dword_count) {
@@ -1081,7 +1388,7 @@ bool PipelineCache::ConfigurePipeline(
     }
     creation_request_cond_.notify_one();
   } else {
-    new_pipeline->state = CreateD3D12Pipeline(runtime_description);
+    CreatePipeline(*new_pipeline);
   }
 
   if (pipeline_storage_file_) {
@@ -1111,9 +1418,24 @@ bool PipelineCache::TranslateAnalyzedShader(
     IDxcUtils* dxc_utils, IDxcCompiler* dxc_compiler) {
   D3D12Shader& shader = static_cast<D3D12Shader&>(translation.shader());
 
-  // Perform translation.
+  // Perform translation, unless the result is available in the translation
+  // storage.
   // If this fails the shader will be marked as invalid and ignored later.
-  if (!translator.TranslateAnalyzedShader(translation)) {
+  bool translation_loaded = false;
+  auto stored_translation_it = stored_translations_.find(
+      std::make_pair(shader.ucode_data_hash(), translation.modification()));
+  if (stored_translation_it != stored_translations_.end() &&
+      !stored_translation_it->second.binary.empty()) {
+    StoredTranslation& stored_translation = stored_translation_it->second;
+    shader.SetStoredBindings(stored_translation.texture_bindings.data(),
+                             stored_translation.texture_bindings.size(),
+                             stored_translation.sampler_bindings.data(),
+                             stored_translation.sampler_bindings.size());
+    translation.SetStoredTranslatedBinary(
+        std::move(stored_translation.binary));
+    translation_loaded = true;
+  }
+  if (!translation_loaded && !translator.TranslateAnalyzedShader(translation)) {
     XELOGE("Shader {:016X} translation failed; marking as ignored",
            shader.ucode_data_hash());
     return false;
@@ -1299,7 +1621,22 @@ bool PipelineCache::TranslateAnalyzedShader(
                          : "d3d12");
   }
 
-  return translation.is_valid();
+  if (!translation.is_valid()) {
+    return false;
+  }
+
+  // Write the new translation to the storage, flushing along with it since
+  // translation is rare.
+  if (translation_storage_file_ && !translation_loaded) {
+    {
+      std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+      storage_write_translation_queue_.push_back(&translation);
+      storage_write_flush_translations_ = true;
+    }
+    storage_write_request_cond_.notify_all();
+  }
+
+  return true;
 }
 
 bool PipelineCache::GetCurrentStateDescription(
@@ -3236,8 +3573,12 @@ void PipelineCache::StorageWriteThread() {
   std::vector<uint32_t> ucode_guest_endian;
   ucode_guest_endian.reserve(0xFFFF);
 
+  TranslationStoredHeader translation_header;
+  std::memset(&translation_header, 0, sizeof(translation_header));
+
   bool flush_shaders = false;
   bool flush_pipelines = false;
+  bool flush_translations = false;
 
   while (true) {
     if (flush_shaders) {
@@ -3250,10 +3591,16 @@ void PipelineCache::StorageWriteThread() {
       assert_not_null(pipeline_storage_file_);
       fflush(pipeline_storage_file_);
     }
+    if (flush_translations) {
+      flush_translations = false;
+      assert_not_null(translation_storage_file_);
+      fflush(translation_storage_file_);
+    }
 
     const Shader* shader = nullptr;
     PipelineStoredDescription pipeline_description;
     bool write_pipeline = false;
+    const D3D12Shader::D3D12Translation* translation = nullptr;
     {
       std::unique_lock<std::mutex> lock(storage_write_request_lock_);
       if (storage_write_thread_shutdown_) {
@@ -3276,7 +3623,14 @@ void PipelineCache::StorageWriteThread() {
         storage_write_flush_pipelines_ = false;
         flush_pipelines = true;
       }
-      if (!shader && !write_pipeline) {
+      if (!storage_write_translation_queue_.empty()) {
+        translation = storage_write_translation_queue_.front();
+        storage_write_translation_queue_.pop_front();
+      } else if (storage_write_flush_translations_) {
+        storage_write_flush_translations_ = false;
+        flush_translations = true;
+      }
+      if (!shader && !write_pipeline && !translation) {
         storage_write_request_cond_.wait(lock);
         continue;
       }
@@ -3305,6 +3659,49 @@ void PipelineCache::StorageWriteThread() {
       fwrite(&pipeline_description, sizeof(pipeline_description), 1,
              pipeline_storage_file_);
     }
+
+    if (translation) {
+      const D3D12Shader& translation_shader =
+          static_cast<const D3D12Shader&>(translation->shader());
+      const std::vector<D3D12Shader::TextureBinding>& texture_bindings =
+          translation_shader.GetTextureBindingsAfterTranslation();
+      const std::vector<D3D12Shader::SamplerBinding>& sampler_bindings =
+          translation_shader.GetSamplerBindingsAfterTranslation();
+      const std::vector<uint8_t>& binary = translation->translated_binary();
+      size_t texture_bindings_size =
+          sizeof(D3D12Shader::TextureBinding) * texture_bindings.size();
+      size_t sampler_bindings_size =
+          sizeof(D3D12Shader::SamplerBinding) * sampler_bindings.size();
+      translation_header.ucode_data_hash = translation_shader.ucode_data_hash();
+      translation_header.modification = translation->modification();
+      XXH3_state_t hash_state;
+      XXH3_64bits_reset(&hash_state);
+      XXH3_64bits_update(&hash_state, texture_bindings.data(),
+                         texture_bindings_size);
+      XXH3_64bits_update(&hash_state, sampler_bindings.data(),
+                         sampler_bindings_size);
+      XXH3_64bits_update(&hash_state, binary.data(), binary.size());
+      translation_header.data_hash = XXH3_64bits_digest(&hash_state);
+      translation_header.texture_binding_count =
+          uint32_t(texture_bindings.size());
+      translation_header.sampler_binding_count =
+          uint32_t(sampler_bindings.size());
+      translation_header.binary_size_bytes = uint32_t(binary.size());
+      assert_not_null(translation_storage_file_);
+      fwrite(&translation_header, sizeof(translation_header), 1,
+             translation_storage_file_);
+      if (texture_bindings_size) {
+        fwrite(texture_bindings.data(), texture_bindings_size, 1,
+               translation_storage_file_);
+      }
+      if (sampler_bindings_size) {
+        fwrite(sampler_bindings.data(), sampler_bindings_size, 1,
+               translation_storage_file_);
+      }
+      if (!binary.empty()) {
+        fwrite(binary.data(), binary.size(), 1, translation_storage_file_);
+      }
+    }
   }
 }
 
@@ -3339,8 +3736,7 @@ void PipelineCache::CreationThread(size_t thread_index) {
     }
 
     // Create the D3D12 pipeline state object.
-    pipeline_to_create->state =
-        CreateD3D12Pipeline(pipeline_to_create->description);
+    CreatePipeline(*pipeline_to_create);
 
     // Pipeline created - the thread is not busy anymore, safe to set the
     // completion event if needed (at the next iteration, or in some other
@@ -3364,11 +3760,15 @@ void PipelineCache::CreateQueuedPipelinesOnProcessorThread() {
       pipeline_to_create = creation_queue_.front();
       creation_queue_.pop_front();
     }
-    pipeline_to_create->state =
-        CreateD3D12Pipeline(pipeline_to_create->description);
+    CreatePipeline(*pipeline_to_create);
   }
 }
 
+void PipelineCache::CreatePipeline(Pipeline& pipeline) {
+  pipeline.state = CreateD3D12Pipeline(pipeline.description);
+  pipeline.created.store(true, std::memory_order_release);
+}
+
 }  // namespace d3d12
 }  // namespace gpu
 }  // namespace xe
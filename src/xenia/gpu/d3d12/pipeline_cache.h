@@ -10,10 +10,12 @@
 #ifndef XENIA_GPU_D3D12_PIPELINE_CACHE_H_
 #define XENIA_GPU_D3D12_PIPELINE_CACHE_H_
 
+#include <atomic>
 #include <condition_variable>
 #include <cstdio>
 #include <deque>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -66,6 +68,11 @@ class PipelineCache {
 
   void EndSubmission();
   bool IsCreatingPipelines();
+  // Number of pipelines queued or being created on the creation threads.
+  size_t GetPendingPipelineCount();
+  // Waits for all the queued pipelines to be created, helping the creation
+  // threads on the calling thread.
+  void AwaitPipelineCreation();
 
   D3D12Shader* LoadShader(xenos::ShaderType shader_type,
                           const uint32_t* host_address, uint32_t dword_count);
@@ -103,6 +110,12 @@ class PipelineCache {
   ID3D12PipelineState* GetD3D12PipelineByHandle(void* handle) const {
     return reinterpret_cast<const Pipeline*>(handle)->state;
   }
+  // Whether the creation of the pipeline, possibly on the creation threads, has
+  // been completed, successfully or not.
+  bool IsPipelineCreated(void* handle) const {
+    return reinterpret_cast<const Pipeline*>(handle)->created.load(
+        std::memory_order_acquire);
+  }
 
  private:
   XEPACKEDSTRUCT(ShaderStoredHeader, {
@@ -114,6 +127,21 @@ class PipelineCache {
     static constexpr uint32_t kVersion = 0x20201219;
   });
 
+  // Followed by the texture bindings, the sampler bindings and the DXBC.
+  XEPACKEDSTRUCT(TranslationStoredHeader, {
+    uint64_t ucode_data_hash;
+    uint64_t modification;
+    // XXH3 of the data following the header.
+    uint64_t data_hash;
+    uint32_t texture_binding_count;
+    uint32_t sampler_binding_count;
+    uint32_t binary_size_bytes;
+
+    // Update if the output of the translator is changed in any way, and also
+    // if the bindings structures are changed.
+    static constexpr uint32_t kVersion = 0x20261014;
+  });
+
   // Update PipelineDescription::kVersion if any of the Pipeline* enums are
   // changed!
 
@@ -361,6 +389,8 @@ class PipelineCache {
     // nullptr if creation has failed.
     ID3D12PipelineState* state;
     PipelineRuntimeDescription description;
+    // Set after the state is written, with release ordering.
+    std::atomic<bool> created{false};
   };
   // All previously generated pipelines identified by hash and the description.
   std::unordered_multimap<uint64_t, Pipeline*,
@@ -387,6 +417,21 @@ class PipelineCache {
   FILE* pipeline_storage_file_ = nullptr;
   bool pipeline_storage_file_flush_needed_ = false;
 
+  // Translation storage output stream, for skipping shader translation in the
+  // next emulator runs with the same translator configuration.
+  FILE* translation_storage_file_ = nullptr;
+  struct StoredTranslation {
+    std::vector<D3D12Shader::TextureBinding> texture_bindings;
+    std::vector<D3D12Shader::SamplerBinding> sampler_bindings;
+    // Moved to the translation when it's loaded, empty afterwards.
+    std::vector<uint8_t> binary;
+  };
+  // <Shader hash, modification bits> -> translation read from the storage. The
+  // map itself is only modified when the storage is opened and closed, so it
+  // can be accessed by the translation threads.
+  std::map<std::pair<uint64_t, uint64_t>, StoredTranslation>
+      stored_translations_;
+
   // Thread for asynchronous writing to the storage streams.
   void StorageWriteThread();
   std::mutex storage_write_request_lock_;
@@ -395,14 +440,18 @@ class PipelineCache {
   // thread is notified about its change via storage_write_request_cond_.
   std::deque<const Shader*> storage_write_shader_queue_;
   std::deque<PipelineStoredDescription> storage_write_pipeline_queue_;
+  std::deque<const D3D12Shader::D3D12Translation*>
+      storage_write_translation_queue_;
   bool storage_write_flush_shaders_ = false;
   bool storage_write_flush_pipelines_ = false;
+  bool storage_write_flush_translations_ = false;
   bool storage_write_thread_shutdown_ = false;
   std::unique_ptr<xe::threading::Thread> storage_write_thread_;
 
   // Pipeline creation threads.
   void CreationThread(size_t thread_index);
   void CreateQueuedPipelinesOnProcessorThread();
+  void CreatePipeline(Pipeline& pipeline);
   xe_mutex creation_request_lock_;
   std::condition_variable_any creation_request_cond_;
   // Protected with creation_request_lock_, notify_one creation_request_cond_
@@ -10,14 +10,18 @@
 #include "xenia/gpu/draw_extent_estimator.h"
 
 #include <algorithm>
+#include <array>
 #include <cfloat>
 #include <cstdint>
+#include <utility>
 
 #include "xenia/base/assert.h"
 #include "xenia/base/cvar.h"
 #include "xenia/base/memory.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/gpu/registers.h"
+#include "xenia/gpu/shared_memory.h"
 #include "xenia/gpu/ucode.h"
 #include "xenia/gpu/xenos.h"
 #include "xenia/ui/graphics_util.h"
@@ -73,6 +77,91 @@ void DrawExtentEstimator::PositionYExportSink::Export(
   }
 }
 
+std::pair<uint32_t, uint32_t> DrawExtentEstimator::GetVertexBufferRange(
+    uint32_t fetch_constant) const {
+  xenos::xe_gpu_vertex_fetch_t vfetch_constant =
+      register_file_.GetVertexFetch(fetch_constant);
+  uint32_t address =
+      (vfetch_constant.address << 2) & (SharedMemory::kBufferSize - 1);
+  return std::make_pair(
+      address, std::min(vfetch_constant.size << 2,
+                        SharedMemory::kBufferSize - address));
+}
+
+uint64_t DrawExtentEstimator::GetVertexMaxYCacheKey(
+    const Shader& vertex_shader, const void* index_buffer,
+    uint32_t index_buffer_size) const {
+  const RegisterFile& regs = register_file_;
+
+  XXH3_state_t hash_state;
+  XXH3_64bits_reset(&hash_state);
+
+  uint64_t ucode_data_hash = vertex_shader.ucode_data_hash();
+  XXH3_64bits_update(&hash_state, &ucode_data_hash, sizeof(ucode_data_hash));
+
+  // Registers used by EstimateVertexMaxY before the conversion of the maximum
+  // Y to pixels, and by the shader interpreter.
+  static constexpr uint32_t kKeyRegisters[] = {
+      XE_GPU_REG_VGT_DRAW_INITIATOR,
+      XE_GPU_REG_VGT_DMA_BASE,
+      XE_GPU_REG_VGT_DMA_SIZE,
+      XE_GPU_REG_PA_SU_SC_MODE_CNTL,
+      XE_GPU_REG_VGT_MULTI_PRIM_IB_RESET_INDX,
+      XE_GPU_REG_VGT_INDX_OFFSET,
+      XE_GPU_REG_VGT_MIN_VTX_INDX,
+      XE_GPU_REG_VGT_MAX_VTX_INDX,
+      XE_GPU_REG_PA_CL_VTE_CNTL,
+      XE_GPU_REG_PA_CL_VPORT_YSCALE,
+      XE_GPU_REG_PA_CL_VPORT_YOFFSET,
+      XE_GPU_REG_PA_SU_POINT_MINMAX,
+      XE_GPU_REG_PA_SU_POINT_SIZE,
+      XE_GPU_REG_SQ_VS_CONST,
+  };
+  for (uint32_t key_register : kKeyRegisters) {
+    XXH3_64bits_update(&hash_state, &regs[key_register], sizeof(uint32_t));
+  }
+  // Float constants accessible by the vertex shader.
+  auto sq_vs_const = regs.Get<reg::SQ_VS_CONST>();
+  uint32_t float_constants_end =
+      std::min(uint32_t(sq_vs_const.base) + sq_vs_const.size + 1,
+               UINT32_C(512));
+  if (sq_vs_const.base < float_constants_end) {
+    XXH3_64bits_update(
+        &hash_state,
+        &regs[XE_GPU_REG_SHADER_CONSTANT_000_X + 4 * sq_vs_const.base],
+        sizeof(uint32_t) * 4 * (float_constants_end - sq_vs_const.base));
+  }
+  // All the fetch, bool and loop constants.
+  static constexpr uint32_t kFetchConstantDwordCount =
+      XE_GPU_REG_SHADER_CONSTANT_FETCH_31_5 -
+      XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0 + 1;
+  XXH3_64bits_update(&hash_state, &regs[XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0],
+                     sizeof(uint32_t) * kFetchConstantDwordCount);
+  static constexpr uint32_t kBoolLoopConstantDwordCount =
+      XE_GPU_REG_SHADER_CONSTANT_LOOP_31 -
+      XE_GPU_REG_SHADER_CONSTANT_BOOL_000_031 + 1;
+  XXH3_64bits_update(&hash_state,
+                     &regs[XE_GPU_REG_SHADER_CONSTANT_BOOL_000_031],
+                     sizeof(uint32_t) * kBoolLoopConstantDwordCount);
+
+  // Memory contents.
+  if (index_buffer_size) {
+    XXH3_64bits_update(&hash_state, index_buffer, index_buffer_size);
+  }
+  for (const Shader::VertexBinding& vertex_binding :
+       vertex_shader.vertex_bindings()) {
+    std::pair<uint32_t, uint32_t> vertex_buffer_range =
+        GetVertexBufferRange(vertex_binding.fetch_constant);
+    if (vertex_buffer_range.second) {
+      XXH3_64bits_update(&hash_state,
+                         memory_.TranslatePhysical(vertex_buffer_range.first),
+                         vertex_buffer_range.second);
+    }
+  }
+
+  return XXH3_64bits_digest(&hash_state);
+}
+
 uint32_t DrawExtentEstimator::EstimateVertexMaxY(const Shader& vertex_shader) {
   SCOPE_profile_cpu_f("gpu");
 
@@ -104,11 +193,12 @@ uint32_t DrawExtentEstimator::EstimateVertexMaxY(const Shader& vertex_shader) {
 
   auto vgt_dma_size = regs.Get<reg::VGT_DMA_SIZE>();
   union {
-    const void* index_buffer;
+    const void* index_buffer = nullptr;
     const uint16_t* index_buffer_16;
     const uint32_t* index_buffer_32;
   };
   xenos::Endian index_endian = vgt_dma_size.swap_mode;
+  uint32_t index_buffer_read_size = 0;
   if (vgt_draw_initiator.source_select == xenos::SourceSelect::kDMA) {
     xenos::IndexFormat index_format = vgt_draw_initiator.index_size;
     uint32_t index_buffer_base = regs[XE_GPU_REG_VGT_DMA_BASE];
@@ -123,17 +213,14 @@ uint32_t DrawExtentEstimator::EstimateVertexMaxY(const Shader& vertex_shader) {
         index_endian = xenos::Endian::kNone;
       }
       index_buffer_base &= ~uint32_t(sizeof(uint16_t) - 1);
-      if (trace_writer_) {
-        trace_writer_->WriteMemoryRead(
-            index_buffer_base, sizeof(uint16_t) * index_buffer_read_count);
-      }
+      index_buffer_read_size = sizeof(uint16_t) * index_buffer_read_count;
     } else {
       assert_true(vgt_draw_initiator.index_size == xenos::IndexFormat::kInt32);
       index_buffer_base &= ~uint32_t(sizeof(uint32_t) - 1);
-      if (trace_writer_) {
-        trace_writer_->WriteMemoryRead(
-            index_buffer_base, sizeof(uint32_t) * index_buffer_read_count);
-      }
+      index_buffer_read_size = sizeof(uint32_t) * index_buffer_read_count;
+    }
+    if (trace_writer_) {
+      trace_writer_->WriteMemoryRead(index_buffer_base, index_buffer_read_size);
     }
     index_buffer = memory_.TranslatePhysical(index_buffer_base);
   }
@@ -166,85 +253,144 @@ uint32_t DrawExtentEstimator::EstimateVertexMaxY(const Shader& vertex_shader) {
         float(regs.Get<reg::PA_SU_POINT_SIZE>().height) * (1.0f / 16.0f);
   }
 
-  float max_y = -FLT_MAX;
-
-  shader_interpreter_.SetShader(vertex_shader);
+  // The result of the interpretation depends only on the state and the memory
+  // contents hashed in the key, which are usually the same across frames for
+  // static geometry, so reuse the result of a previous estimation if possible.
+  uint64_t vertex_max_y_cache_key = GetVertexMaxYCacheKey(
+      vertex_shader, index_buffer, index_buffer_read_size);
+  float max_y;
+  auto vertex_max_y_cache_it =
+      vertex_max_y_cache_.find(vertex_max_y_cache_key);
+  if (vertex_max_y_cache_it != vertex_max_y_cache_.end()) {
+    max_y = vertex_max_y_cache_it->second;
+    if (trace_writer_) {
+      // Make sure the vertex data is available in the trace even if not
+      // fetched by the interpreter this time.
+      for (const Shader::VertexBinding& vertex_binding :
+           vertex_shader.vertex_bindings()) {
+        std::pair<uint32_t, uint32_t> vertex_buffer_range =
+            GetVertexBufferRange(vertex_binding.fetch_constant);
+        trace_writer_->WriteMemoryRead(vertex_buffer_range.first,
+                                       vertex_buffer_range.second);
+      }
+    }
+  } else {
+    max_y = -FLT_MAX;
+
+    // Indexed geometry references the same vertices multiple times (up to 6
+    // times in a regular triangle grid), and the result of the vertex shader
+    // depends only on the vertex index, so, like the post-transform vertex
+    // cache in the hardware, remember the results of the recently processed
+    // vertices instead of interpreting the shader for them again.
+    std::array<VertexCacheEntry, kVertexCacheSize> vertex_cache;
+    for (VertexCacheEntry& vertex_cache_entry : vertex_cache) {
+      vertex_cache_entry.vertex_index = UINT32_MAX;
+    }
 
-  PositionYExportSink position_y_export_sink;
-  shader_interpreter_.SetExportSink(&position_y_export_sink);
-  for (uint32_t i = 0; i < vgt_draw_initiator.num_indices; ++i) {
-    uint32_t vertex_index;
-    if (vgt_draw_initiator.source_select == xenos::SourceSelect::kDMA) {
-      if (i < vgt_dma_size.num_words) {
-        if (vgt_draw_initiator.index_size == xenos::IndexFormat::kInt16) {
-          vertex_index = index_buffer_16[i];
+    shader_interpreter_.SetShader(vertex_shader);
+
+    PositionYExportSink position_y_export_sink;
+    shader_interpreter_.SetExportSink(&position_y_export_sink);
+    for (uint32_t i = 0; i < vgt_draw_initiator.num_indices; ++i) {
+      uint32_t vertex_index;
+      if (vgt_draw_initiator.source_select == xenos::SourceSelect::kDMA) {
+        if (i < vgt_dma_size.num_words) {
+          if (vgt_draw_initiator.index_size == xenos::IndexFormat::kInt16) {
+            vertex_index = index_buffer_16[i];
+          } else {
+            vertex_index = index_buffer_32[i];
+          }
+          // The Xenos only uses 24 bits of the index (reset_indx is 24-bit).
+          vertex_index = xenos::GpuSwap(vertex_index, index_endian) & 0xFFFFFF;
         } else {
-          vertex_index = index_buffer_32[i];
+          vertex_index = 0;
+        }
+        if (pa_su_sc_mode_cntl.multi_prim_ib_ena &&
+            vertex_index == reset_index) {
+          continue;
         }
-        // The Xenos only uses 24 bits of the index (reset_indx is 24-bit).
-        vertex_index = xenos::GpuSwap(vertex_index, index_endian) & 0xFFFFFF;
       } else {
-        vertex_index = 0;
+        assert_true(vgt_draw_initiator.source_select ==
+                    xenos::SourceSelect::kAutoIndex);
+        vertex_index = i;
       }
-      if (pa_su_sc_mode_cntl.multi_prim_ib_ena && vertex_index == reset_index) {
-        continue;
+      vertex_index = std::min(
+          max_index,
+          std::max(min_index, (vertex_index + index_offset) & 0xFFFFFF));
+
+      // The indices are 24-bit, so UINT32_MAX never matches a real index.
+      VertexCacheEntry& vertex_cache_entry =
+          vertex_cache[vertex_index & (kVertexCacheSize - 1)];
+      if (vertex_cache_entry.vertex_index != vertex_index) {
+        vertex_cache_entry.vertex_index = vertex_index;
+        vertex_cache_entry.is_visible = false;
+
+        position_y_export_sink.Reset();
+
+        shader_interpreter_.temp_registers()[0] = float(vertex_index);
+        shader_interpreter_.Execute();
+
+        if (position_y_export_sink.vertex_kill().has_value() &&
+            (position_y_export_sink.vertex_kill().value() &
+             ~(UINT32_C(1) << 31))) {
+          continue;
+        }
+        if (!position_y_export_sink.position_y().has_value()) {
+          continue;
+        }
+        vertex_cache_entry.y = position_y_export_sink.position_y().value();
+        if (!pa_cl_vte_cntl.vtx_xy_fmt) {
+          if (!position_y_export_sink.position_w().has_value()) {
+            continue;
+          }
+          vertex_cache_entry.y /= position_y_export_sink.position_w().value();
+        }
+        vertex_cache_entry.is_visible = true;
+        if (position_y_export_sink.point_size().has_value()) {
+          vertex_cache_entry.point_size =
+              position_y_export_sink.point_size().value();
+          vertex_cache_entry.has_point_size = true;
+        } else {
+          vertex_cache_entry.has_point_size = false;
+        }
       }
-    } else {
-      assert_true(vgt_draw_initiator.source_select ==
-                  xenos::SourceSelect::kAutoIndex);
-      vertex_index = i;
-    }
-    vertex_index =
-        std::min(max_index,
-                 std::max(min_index, (vertex_index + index_offset) & 0xFFFFFF));
-
-    position_y_export_sink.Reset();
-
-    shader_interpreter_.temp_registers()[0] = float(vertex_index);
-    shader_interpreter_.Execute();
-
-    if (position_y_export_sink.vertex_kill().has_value() &&
-        (position_y_export_sink.vertex_kill().value() & ~(UINT32_C(1) << 31))) {
-      continue;
-    }
-    if (!position_y_export_sink.position_y().has_value()) {
-      continue;
-    }
-    float vertex_y = position_y_export_sink.position_y().value();
-    if (!pa_cl_vte_cntl.vtx_xy_fmt) {
-      if (!position_y_export_sink.position_w().has_value()) {
+      if (!vertex_cache_entry.is_visible) {
         continue;
       }
-      vertex_y /= position_y_export_sink.position_w().value();
-    }
-
-    vertex_y = vertex_y * viewport_y_scale + viewport_y_offset;
-
-    if (vgt_draw_initiator.prim_type == xenos::PrimitiveType::kPointList) {
-      float point_radius_y;
-      if (position_y_export_sink.point_size().has_value()) {
-        // Vertex-specified diameter. Clamped effectively as a signed integer in
-        // the hardware, -NaN, -Infinity ... -0 to the minimum, +Infinity, +NaN
-        // to the maximum.
-        point_radius_y =
-            0.5f *
-            xe::memory::Reinterpret<float>(std::min(
-                point_vertex_max_diameter_float,
-                std::max(point_vertex_min_diameter_float,
-                         xe::memory::Reinterpret<int32_t>(
-                             position_y_export_sink.point_size().value()))));
-      } else {
-        // Constant radius.
-        point_radius_y = point_constant_radius_y;
+      float vertex_y = vertex_cache_entry.y;
+
+      vertex_y = vertex_y * viewport_y_scale + viewport_y_offset;
+
+      if (vgt_draw_initiator.prim_type == xenos::PrimitiveType::kPointList) {
+        float point_radius_y;
+        if (vertex_cache_entry.has_point_size) {
+          // Vertex-specified diameter. Clamped effectively as a signed integer
+          // in the hardware, -NaN, -Infinity ... -0 to the minimum, +Infinity,
+          // +NaN to the maximum.
+          point_radius_y =
+              0.5f * xe::memory::Reinterpret<float>(std::min(
+                         point_vertex_max_diameter_float,
+                         std::max(point_vertex_min_diameter_float,
+                                  xe::memory::Reinterpret<int32_t>(
+                                      vertex_cache_entry.point_size))));
+        } else {
+          // Constant radius.
+          point_radius_y = point_constant_radius_y;
+        }
+        vertex_y += point_radius_y;
       }
-      vertex_y += point_radius_y;
+
+      // std::max is `a < b ? b : a`, thus in case of NaN, the first argument is
+      // always returned - max_y, which is initialized to a normalized value.
+      max_y = std::max(max_y, vertex_y);
     }
+    shader_interpreter_.SetExportSink(nullptr);
 
-    // std::max is `a < b ? b : a`, thus in case of NaN, the first argument is
-    // always returned - max_y, which is initialized to a normalized value.
-    max_y = std::max(max_y, vertex_y);
+    if (vertex_max_y_cache_.size() >= kVertexMaxYCacheMaxSize) {
+      vertex_max_y_cache_.clear();
+    }
+    vertex_max_y_cache_.emplace(vertex_max_y_cache_key, max_y);
   }
-  shader_interpreter_.SetExportSink(nullptr);
 
   int32_t max_y_24p8 = ui::FloatToD3D11Fixed16p8(max_y);
   // 16p8 range is -32768 to 32767+255/256, but it's stored as uint32_t here,
@@ -12,6 +12,8 @@
 
 #include <cstdint>
 #include <optional>
+#include <unordered_map>
+#include <utility>
 
 #include "xenia/gpu/register_file.h"
 #include "xenia/gpu/shader.h"
@@ -39,6 +41,22 @@ class DrawExtentEstimator {
                         const Shader& vertex_shader);
 
  private:
+  // Must be a power of two.
+  static constexpr uint32_t kVertexCacheSize = 64;
+
+  // Dropping all the results when reaching this number of them, as it's
+  // unknown which of them are still actual.
+  static constexpr size_t kVertexMaxYCacheMaxSize = 4096;
+
+  struct VertexCacheEntry {
+    uint32_t vertex_index;
+    // Before the viewport transformation.
+    float y;
+    float point_size;
+    bool is_visible;
+    bool has_point_size;
+  };
+
   class PositionYExportSink : public ShaderInterpreter::ExportSink {
    public:
     void Export(ucode::ExportRegister export_register, const float* value,
@@ -63,11 +81,23 @@ class DrawExtentEstimator {
     std::optional<uint32_t> vertex_kill_;
   };
 
+  // Returns the physical address and the size of the vertex buffer, clamped to
+  // the physical memory.
+  std::pair<uint32_t, uint32_t> GetVertexBufferRange(
+      uint32_t fetch_constant) const;
+  uint64_t GetVertexMaxYCacheKey(const Shader& vertex_shader,
+                                 const void* index_buffer,
+                                 uint32_t index_buffer_size) const;
+
   const RegisterFile& register_file_;
   const Memory& memory_;
   TraceWriter* trace_writer_;
 
   ShaderInterpreter shader_interpreter_;
+
+  // Maximum Y before the conversion to pixels, keyed by the hash of everything
+  // it depends on.
+  std::unordered_map<uint64_t, float> vertex_max_y_cache_;
 };
 
 }  // namespace gpu
@@ -382,6 +382,35 @@ struct GetViewportInfoArgs {
     pa_sc_window_offset = regs.Get<reg::PA_SC_WINDOW_OFFSET>();
     depth_format = regs.Get<reg::RB_DEPTH_INFO>().depth_format;
   }
+  // Whether any register read by SetupRegisterValues has been written since
+  // the register file write stamp.
+  static bool AreRegistersWrittenSince(const RegisterFile& regs,
+                                       uint64_t stamp) {
+    return regs.WrittenSince(XE_GPU_REG_PA_CL_CLIP_CNTL, stamp) ||
+           regs.WrittenSince(XE_GPU_REG_PA_CL_VTE_CNTL, stamp) ||
+           regs.WrittenSince(XE_GPU_REG_PA_SU_SC_MODE_CNTL, stamp) ||
+           regs.WrittenSince(XE_GPU_REG_PA_SU_VTX_CNTL, stamp) ||
+           regs.WrittenSince(XE_GPU_REG_PA_CL_VPORT_XSCALE, stamp) ||
+           regs.WrittenSince(XE_GPU_REG_PA_CL_VPORT_ZOFFSET, stamp) ||
+           regs.WrittenSince(XE_GPU_REG_PA_SC_WINDOW_OFFSET, stamp) ||
+           regs.WrittenSince(XE_GPU_REG_RB_DEPTH_INFO, stamp);
+  }
+  // Takes the values that SetupRegisterValues would have written from
+  // arguments set up previously, if the registers haven't been written since.
+  void CopyRegisterValues(const GetViewportInfoArgs& other) {
+    pa_cl_clip_cntl = other.pa_cl_clip_cntl;
+    pa_cl_vte_cntl = other.pa_cl_vte_cntl;
+    pa_su_sc_mode_cntl = other.pa_su_sc_mode_cntl;
+    pa_su_vtx_cntl = other.pa_su_vtx_cntl;
+    PA_CL_VPORT_XSCALE = other.PA_CL_VPORT_XSCALE;
+    PA_CL_VPORT_YSCALE = other.PA_CL_VPORT_YSCALE;
+    PA_CL_VPORT_ZSCALE = other.PA_CL_VPORT_ZSCALE;
+    PA_CL_VPORT_XOFFSET = other.PA_CL_VPORT_XOFFSET;
+    PA_CL_VPORT_YOFFSET = other.PA_CL_VPORT_YOFFSET;
+    PA_CL_VPORT_ZOFFSET = other.PA_CL_VPORT_ZOFFSET;
+    pa_sc_window_offset = other.pa_sc_window_offset;
+    depth_format = other.depth_format;
+  }
   XE_FORCEINLINE
   bool operator==(const GetViewportInfoArgs& prev) {
 #if XE_ARCH_AMD64 == 0
@@ -444,6 +473,17 @@ struct alignas(16) Scissor {
 void GetScissor(const RegisterFile& XE_RESTRICT regs,
                 Scissor& XE_RESTRICT scissor_out,
                 bool clamp_to_surface_pitch = true);
+// Whether any register read by GetScissor has been written since the register
+// file write stamp.
+inline bool AreScissorRegistersWrittenSince(const RegisterFile& regs,
+                                            uint64_t stamp) {
+  return regs.WrittenSince(XE_GPU_REG_PA_SC_WINDOW_SCISSOR_TL, stamp) ||
+         regs.WrittenSince(XE_GPU_REG_PA_SC_WINDOW_SCISSOR_BR, stamp) ||
+         regs.WrittenSince(XE_GPU_REG_PA_SC_WINDOW_OFFSET, stamp) ||
+         regs.WrittenSince(XE_GPU_REG_PA_SC_SCREEN_SCISSOR_TL, stamp) ||
+         regs.WrittenSince(XE_GPU_REG_PA_SC_SCREEN_SCISSOR_BR, stamp) ||
+         regs.WrittenSince(XE_GPU_REG_RB_SURFACE_INFO, stamp);
+}
 
 // Returns the color component write mask for the draw command taking into
 // account which color targets are written to by the pixel shader, as well as
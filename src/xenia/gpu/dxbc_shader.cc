@@ -20,6 +20,23 @@ DxbcShader::DxbcShader(xenos::ShaderType shader_type, uint64_t ucode_data_hash,
     : Shader(shader_type, ucode_data_hash, ucode_dwords, ucode_dword_count,
              ucode_source_endian) {}
 
+void DxbcShader::SetStoredBindings(const TextureBinding* texture_bindings,
+                                   size_t texture_binding_count,
+                                   const SamplerBinding* sampler_bindings,
+                                   size_t sampler_binding_count) {
+  if (bindings_setup_entered_.test_and_set(std::memory_order_relaxed)) {
+    return;
+  }
+  texture_bindings_.assign(texture_bindings,
+                           texture_bindings + texture_binding_count);
+  used_texture_mask_ = 0;
+  for (const TextureBinding& texture_binding : texture_bindings_) {
+    used_texture_mask_ |= 1u << texture_binding.fetch_constant;
+  }
+  sampler_bindings_.assign(sampler_bindings,
+                           sampler_bindings + sampler_binding_count);
+}
+
 Shader::Translation* DxbcShader::CreateTranslationInstance(
     uint64_t modification) {
   return new DxbcTranslation(*this, modification);
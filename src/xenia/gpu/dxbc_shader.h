@@ -74,6 +74,14 @@ class DxbcShader : public Shader {
     return sampler_bindings_;
   }
 
+  // For translations loaded from a persistent storage, sets up the bindings
+  // that a successful translation would gather, unless a translation has done
+  // that already.
+  void SetStoredBindings(const TextureBinding* texture_bindings,
+                         size_t texture_binding_count,
+                         const SamplerBinding* sampler_bindings,
+                         size_t sampler_binding_count);
+
  protected:
   Translation* CreateTranslationInstance(uint64_t modification) override;
 
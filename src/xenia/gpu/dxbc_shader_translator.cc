@@ -406,6 +406,68 @@ void DxbcShaderTranslator::StartVertexShader_LoadVertexIndex() {
            dxbc::Src::V1D(kInRegisterVSVertexIndex, dxbc::Src::kXXXX),
            index_src);
 
+  {
+    // Load the guest index from the guest index buffer in the shared memory if
+    // the host index buffer only remaps the primitive type.
+    uint32_t load_temp = PushSystemTemp();
+    dxbc::Dest load_temp_x_dest(dxbc::Dest::R(load_temp, 0b0001));
+    dxbc::Src load_temp_x_src(dxbc::Src::R(load_temp, dxbc::Src::kXXXX));
+    dxbc::Dest load_temp_y_dest(dxbc::Dest::R(load_temp, 0b0010));
+    dxbc::Src load_temp_y_src(dxbc::Src::R(load_temp, dxbc::Src::kYYYY));
+    dxbc::Dest load_temp_z_dest(dxbc::Dest::R(load_temp, 0b0100));
+    dxbc::Src load_temp_z_src(dxbc::Src::R(load_temp, dxbc::Src::kZZZZ));
+    dxbc::Dest load_temp_w_dest(dxbc::Dest::R(load_temp, 0b1000));
+    dxbc::Src load_temp_w_src(dxbc::Src::R(load_temp, dxbc::Src::kWWWW));
+    a_.OpAnd(load_temp_x_dest, LoadFlagsSystemConstant(),
+             dxbc::Src::LU(kSysFlag_PrimitiveVertexIndexLoad));
+    a_.OpIf(true, load_temp_x_src);
+    // Whether the index is 32-bit to load_temp.x.
+    a_.OpAnd(load_temp_x_dest, LoadFlagsSystemConstant(),
+             dxbc::Src::LU(kSysFlag_PrimitiveVertexIndexLoad32Bit));
+    // Address of the index to load_temp.y.
+    a_.OpMovC(load_temp_y_dest, load_temp_x_src, dxbc::Src::LU(2),
+              dxbc::Src::LU(1));
+    a_.OpIShL(load_temp_y_dest, index_src, load_temp_y_src);
+    a_.OpIAdd(load_temp_y_dest, load_temp_y_src,
+              LoadSystemConstant(
+                  SystemConstants::Index::kVertexIndexLoadAddress,
+                  offsetof(SystemConstants, vertex_index_load_address),
+                  dxbc::Src::kXXXX));
+    // Address of the dword containing the index to load_temp.z.
+    a_.OpAnd(load_temp_z_dest, load_temp_y_src, dxbc::Src::LU(~uint32_t(3)));
+    // Load the dword to load_temp.w from the shared memory bound as an SRV or,
+    // if memexport is used, as a UAV.
+    if (srv_index_shared_memory_ == kBindingIndexUnallocated) {
+      srv_index_shared_memory_ = srv_count_++;
+    }
+    if (uav_index_shared_memory_ == kBindingIndexUnallocated) {
+      uav_index_shared_memory_ = uav_count_++;
+    }
+    a_.OpAnd(load_temp_w_dest, LoadFlagsSystemConstant(),
+             dxbc::Src::LU(kSysFlag_SharedMemoryIsUAV));
+    a_.OpIf(false, load_temp_w_src);
+    a_.OpLdRaw(load_temp_w_dest, load_temp_z_src,
+               dxbc::Src::T(srv_index_shared_memory_,
+                            uint32_t(SRVMainRegister::kSharedMemory)));
+    a_.OpElse();
+    a_.OpLdRaw(load_temp_w_dest, load_temp_z_src,
+               dxbc::Src::U(uav_index_shared_memory_,
+                            uint32_t(UAVRegister::kSharedMemory)));
+    a_.OpEndIf();
+    // Extract the 16-bit index from the dword if needed.
+    a_.OpIf(false, load_temp_x_src);
+    a_.OpAnd(load_temp_y_dest, load_temp_y_src, dxbc::Src::LU(2));
+    a_.OpIShL(load_temp_y_dest, load_temp_y_src, dxbc::Src::LU(3));
+    a_.OpUBFE(load_temp_w_dest, dxbc::Src::LU(16), load_temp_y_src,
+              load_temp_w_src);
+    a_.OpEndIf();
+    // The endian swap is done below.
+    a_.OpMov(index_dest, load_temp_w_src);
+    a_.OpEndIf();
+    // Release load_temp.
+    PopSystemTemp();
+  }
+
   {
     // Swap the vertex index's endianness.
     dxbc::Src endian_src(LoadSystemConstant(
@@ -2147,7 +2209,9 @@ const DxbcShaderTranslator::SystemConstantRdef
         {"xe_edram_32bpp_tile_pitch_dwords_scaled", ShaderRdefTypeIndex::kUint,
          sizeof(uint32_t)},
         {"xe_edram_depth_base_dwords_scaled", ShaderRdefTypeIndex::kUint,
-         sizeof(uint32_t), sizeof(uint32_t)},
+         sizeof(uint32_t)},
+        {"xe_vertex_index_load_address", ShaderRdefTypeIndex::kUint,
+         sizeof(uint32_t)},
 
         {"xe_color_exp_bias", ShaderRdefTypeIndex::kFloat4, sizeof(float) * 4},
 
@@ -240,6 +240,8 @@ class DxbcShaderTranslator : public ShaderTranslator {
     // taking into account the potential relation with occlusion queries (but
     // should be safe at least temporarily).
     kSysFlag_ROVDepthStencilEarlyWrite_Shift,
+    kSysFlag_PrimitiveVertexIndexLoad_Shift,
+    kSysFlag_PrimitiveVertexIndexLoad32Bit_Shift,
 
     kSysFlag_Count,
 
@@ -265,6 +267,14 @@ class DxbcShaderTranslator : public ShaderTranslator {
     kSysFlag_ROVStencilTest = 1u << kSysFlag_ROVStencilTest_Shift,
     kSysFlag_ROVDepthStencilEarlyWrite =
         1u << kSysFlag_ROVDepthStencilEarlyWrite_Shift,
+    // For HostVertexShaderType kVertex, whether the host index buffer only
+    // remaps the primitive type, and the guest vertex index needs to be loaded
+    // from the guest index buffer in the shared memory at the host index, and
+    // whether the guest index is 32-bit.
+    kSysFlag_PrimitiveVertexIndexLoad =
+        1u << kSysFlag_PrimitiveVertexIndexLoad_Shift,
+    kSysFlag_PrimitiveVertexIndexLoad32Bit =
+        1u << kSysFlag_PrimitiveVertexIndexLoad32Bit_Shift,
   };
   static_assert(kSysFlag_Count <= 32, "Too many flags in the system constants");
 
@@ -324,7 +334,8 @@ class DxbcShaderTranslator : public ShaderTranslator {
     uint32_t alpha_to_mask;
     uint32_t edram_32bpp_tile_pitch_dwords_scaled;
     uint32_t edram_depth_base_dwords_scaled;
-    uint32_t padding_edram_depth_base_dwords_scaled;
+    // Address of the guest index buffer for kSysFlag_PrimitiveVertexIndexLoad.
+    uint32_t vertex_index_load_address;
 
     float color_exp_bias[4];
 
@@ -426,6 +437,7 @@ class DxbcShaderTranslator : public ShaderTranslator {
       kAlphaToMask,
       kEdram32bppTilePitchDwordsScaled,
       kEdramDepthBaseDwordsScaled,
+      kVertexIndexLoadAddress,
 
       kColorExpBias,
 
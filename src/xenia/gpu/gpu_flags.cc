@@ -62,3 +62,31 @@ DEFINE_int32(query_occlusion_fake_sample_count, 100,
              "everything is reported as occluded.",
              "GPU");
 UPDATE_from_int32(query_occlusion_fake_sample_count, 2024, 9, 23, 9, 1000);
+
+DEFINE_bool(
+    query_occlusion_host, false,
+    "Count the samples for EVENT_WRITE_ZPD occlusion queries using host GPU "
+    "queries rather than reporting query_occlusion_fake_sample_count. The "
+    "results are written to guest memory without waiting for the GPU, once "
+    "the host queries have been completed, so the guest may see them a few "
+    "frames after issuing the queries. Host drawing done internally by the "
+    "emulator may be counted too.",
+    "GPU");
+DEFINE_int32(
+    query_occlusion_host_latency_frames, 2,
+    "Maximum number of frames after the end of a host occlusion query in "
+    "query_occlusion_host mode after which the GPU is awaited if the result "
+    "is not available yet, for games waiting for occlusion query results. "
+    "Lower values reduce the latency of occlusion culling, but may cause "
+    "CPU/GPU synchronization. If negative, the results are never awaited "
+    "explicitly.",
+    "GPU");
+
+DEFINE_bool(
+    async_pipeline_creation, false,
+    "Create graphics pipelines encountered for the first time on background "
+    "threads, and skip the draws using them until they are created, instead "
+    "of waiting for their creation. Reduces stuttering when new pipelines are "
+    "encountered at the cost of objects missing for a few frames. Draws "
+    "exporting data to memory still wait for their pipelines.",
+    "GPU");
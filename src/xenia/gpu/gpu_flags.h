@@ -28,6 +28,14 @@ DECLARE_bool(half_pixel_offset);
 
 DECLARE_int32(query_occlusion_fake_sample_count);
 
+DECLARE_bool(query_occlusion_host);
+
+DECLARE_int32(query_occlusion_host_latency_frames);
+
+DECLARE_bool(async_pipeline_creation);
+
 DECLARE_bool(disassemble_pm4);
 
+DECLARE_bool(low_memory_mode);
+
 #endif  // XENIA_GPU_GPU_FLAGS_H_
@@ -22,10 +22,12 @@
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/startup_timeline.h"
 #include "xenia/base/threading.h"
 #include "xenia/config.h"
 #include "xenia/gpu/command_processor.h"
 #include "xenia/gpu/gpu_flags.h"
+#include "xenia/gpu/render_target_path_tuning.h"
 #include "xenia/kernel/kernel_state.h"
 #include "xenia/ui/graphics_provider.h"
 #include "xenia/ui/window.h"
@@ -68,6 +70,25 @@ DEFINE_bool(
     "runtime spikes and freezes when playing the game not for the first time.",
     "GPU");
 
+DEFINE_bool(vblank_precise_timing, true,
+            "With vsync, schedule the guest vertical blanking interrupts at "
+            "exact intervals using high-resolution host timers and a short "
+            "final spin, rather than coarse sleeps that make the interrupts "
+            "jitter by milliseconds and the frame pacing uneven.",
+            "GPU");
+DEFINE_uint32(vblank_spin_us, 500,
+              "Microseconds spun before every vblank interrupt with "
+              "vblank_precise_timing, to hide the wake-up latency of the host "
+              "scheduler. Higher values make the interrupts more precise at "
+              "the cost of processor time.",
+              "GPU");
+DEFINE_bool(log_vblank_jitter, false,
+            "Log how late the vblank interrupts are delivered relative to "
+            "their schedule every 10 seconds with vblank_precise_timing.",
+            "GPU");
+
+DECLARE_bool(warm_title_relaunch);
+
 namespace xe {
 namespace gpu {
 
@@ -89,12 +110,37 @@ GraphicsSystem::GraphicsSystem() : frame_limiter_worker_running_(false) {
       memory::PageAccess::kReadWrite));
 }
 
-GraphicsSystem::~GraphicsSystem() = default;
+GraphicsSystem::~GraphicsSystem() { WaitForProviderCreation(); }
+
+void GraphicsSystem::BeginProviderCreation(bool is_surface_required) {
+  if (provider_ || provider_creation_thread_.joinable()) {
+    return;
+  }
+  provider_creation_thread_ = std::thread([this, is_surface_required]() {
+    xe::threading::set_name("Graphics Provider Creation");
+    StartupTimelinePhase startup_phase("Graphics provider creation");
+    provider_ = CreateProvider(is_surface_required);
+  });
+}
+
+void GraphicsSystem::WaitForProviderCreation() {
+  if (provider_creation_thread_.joinable()) {
+    provider_creation_thread_.join();
+  }
+}
 
 X_STATUS GraphicsSystem::Setup(cpu::Processor* processor,
                                kernel::KernelState* kernel_state,
                                ui::WindowedAppContext* app_context,
-                               [[maybe_unused]] bool is_surface_required) {
+                               bool is_surface_required) {
+  StartupTimelinePhase startup_phase("GraphicsSystem::Setup");
+  if (provider_creation_thread_.joinable()) {
+    WaitForProviderCreation();
+  } else if (!provider_) {
+    StartupTimelinePhase provider_phase("Graphics provider creation");
+    provider_ = CreateProvider(is_surface_required);
+  }
+
   memory_ = processor->memory();
   processor_ = processor;
   kernel_state_ = kernel_state;
@@ -156,78 +202,17 @@ X_STATUS GraphicsSystem::Setup(cpu::Processor* processor,
   frame_limiter_worker_thread_ =
       kernel::object_ref<kernel::XHostThread>(new kernel::XHostThread(
           kernel_state_, 128 * 1024, 0,
-          [this]() {
-            uint64_t normalized_framerate_limit =
-                std::max<uint64_t>(0, cvars::framerate_limit);
-
-            // If VSYNC is enabled, but frames are not limited,
-            // lock framerate at default value of 60
-            if (normalized_framerate_limit == 0 && cvars::vsync)
-              normalized_framerate_limit = 60;
-
-            const double vsync_duration_d =
-                cvars::vsync
-                    ? std::max<double>(5.0,
-                                       1000.0 / static_cast<double>(
-                                                    normalized_framerate_limit))
-                    : 1.0;
-            uint64_t last_frame_time = Clock::QueryGuestTickCount();
-            // Sleep for 90% of the vblank duration, spin for 10%
-            const double duration_scalar = 0.90;
-
-            while (frame_limiter_worker_running_) {
-              register_file()->values[XE_GPU_REG_D1MODE_V_COUNTER] +=
-                  GetInternalDisplayResolution().second;
-
-              if (cvars::vsync) {
-                const uint64_t current_time = Clock::QueryGuestTickCount();
-                const uint64_t tick_freq = Clock::guest_tick_frequency();
-                const uint64_t time_delta = current_time - last_frame_time;
-                const double elapsed_d =
-                    static_cast<double>(time_delta) /
-                    (static_cast<double>(tick_freq) / 1000.0);
-                if (elapsed_d >= vsync_duration_d) {
-                  last_frame_time = current_time;
-
-                  // TODO(disjtqz): should recalculate the remaining time to a
-                  // vblank after MarkVblank, no idea how long the guest code
-                  // normally takes
-                  MarkVblank();
-                  if (cvars::vsync) {
-                    const uint64_t estimated_nanoseconds =
-                        static_cast<uint64_t>(
-                            (vsync_duration_d * 1000000.0) *
-                            duration_scalar);  // 1000 microseconds = 1 ms
-
-                    threading::NanoSleep(estimated_nanoseconds);
-                  }
-                }
-              }
-
-              if (!cvars::vsync) {
-                MarkVblank();
-                if (normalized_framerate_limit > 0) {
-                  // framerate_limit is over 0, vsync disabled
-                  //  - No VSYNC + limited frames defined by user
-                  uint64_t framerate_limited_sleep_time =
-                      1000000000 / normalized_framerate_limit;
-                  xe::threading::NanoSleep(framerate_limited_sleep_time);
-                } else {
-                  // framerate_limit is 0, vsync disabled
-                  //  - No VSYNC + unlimited frames
-                  xe::threading::Sleep(std::chrono::milliseconds(1));
-                }
-              }
-            }
-            return 0;
-          },
+          [this]() { return FrameLimiterThread(); },
           kernel_state->GetIdleProcess()));
   // As we run vblank interrupts the debugger must be able to suspend us.
   frame_limiter_worker_thread_->set_can_debugger_suspend(true);
   frame_limiter_worker_thread_->set_name("GPU Frame limiter");
   frame_limiter_worker_thread_->Create();
+  // With precise vblank timing, the thread mostly sleeps, and needs to be woken
+  // up on time.
   frame_limiter_worker_thread_->thread()->set_priority(
-      threading::ThreadPriority::kLowest);
+      cvars::vblank_precise_timing ? threading::ThreadPriority::kHighest
+                                   : threading::ThreadPriority::kLowest);
   if (cvars::trace_gpu_stream) {
     BeginTracing();
   }
@@ -235,8 +220,145 @@ X_STATUS GraphicsSystem::Setup(cpu::Processor* processor,
   return X_STATUS_SUCCESS;
 }
 
+int GraphicsSystem::FrameLimiterThread() {
+  uint64_t last_frame_time = Clock::QueryGuestTickCount();
+  // Sleep for 90% of the vblank duration, spin for 10%
+  const double duration_scalar = 0.90;
+
+  threading::PreciseSleeper precise_sleeper;
+  const uint64_t host_tick_frequency = Clock::QueryHostTickFrequency();
+  // The time the next vblank is scheduled at with vblank_precise_timing,
+  // advanced by whole vblank periods so the errors don't accumulate.
+  uint64_t next_vblank_host_ticks = Clock::QueryHostTickCount();
+  uint64_t last_jitter_log_host_ticks = next_vblank_host_ticks;
+
+  while (frame_limiter_worker_running_) {
+    // May be lowered while running by the performance governor.
+    uint64_t normalized_framerate_limit = GetFramerateLimit();
+
+    // If VSYNC is enabled, but frames are not limited,
+    // lock framerate at default value of 60
+    if (normalized_framerate_limit == 0 && cvars::vsync)
+      normalized_framerate_limit = 60;
+
+    if (cvars::vsync && cvars::vblank_precise_timing) {
+      // At least 5 ms like the coarse path, and following the guest time
+      // scalar like the guest clock.
+      uint64_t vblank_period_host_ticks = uint64_t(
+          double(host_tick_frequency) /
+          (double(std::min<uint64_t>(normalized_framerate_limit, 200)) *
+           std::max(Clock::guest_time_scalar(), 0.001)));
+      next_vblank_host_ticks += vblank_period_host_ticks;
+      uint64_t host_ticks = Clock::QueryHostTickCount();
+      if (host_ticks > next_vblank_host_ticks + vblank_period_host_ticks) {
+        // Fell behind by more than a vblank (the thread was suspended, or the
+        // interrupt took long), start over instead of catching up with a burst
+        // of vblanks.
+        next_vblank_host_ticks = host_ticks;
+        ++vblank_jitter_.missed_count;
+      }
+      host_ticks = precise_sleeper.SleepUntil(
+          next_vblank_host_ticks,
+          host_tick_frequency * cvars::vblank_spin_us / 1000000);
+      register_file()->values[XE_GPU_REG_D1MODE_V_COUNTER] +=
+          GetInternalDisplayResolution().second;
+      MarkVblank();
+      RecordVblankLateness(host_ticks - next_vblank_host_ticks,
+                           host_tick_frequency);
+      if (cvars::log_vblank_jitter &&
+          host_ticks - last_jitter_log_host_ticks >= host_tick_frequency * 10) {
+        last_jitter_log_host_ticks = host_ticks;
+        LogVblankJitter();
+      }
+      last_frame_time = Clock::QueryGuestTickCount();
+      continue;
+    }
+    next_vblank_host_ticks = Clock::QueryHostTickCount();
+
+    const double vsync_duration_d =
+        cvars::vsync
+            ? std::max<double>(
+                  5.0,
+                  1000.0 / static_cast<double>(normalized_framerate_limit))
+            : 1.0;
+
+    register_file()->values[XE_GPU_REG_D1MODE_V_COUNTER] +=
+        GetInternalDisplayResolution().second;
+
+    if (cvars::vsync) {
+      const uint64_t current_time = Clock::QueryGuestTickCount();
+      const uint64_t tick_freq = Clock::guest_tick_frequency();
+      const uint64_t time_delta = current_time - last_frame_time;
+      const double elapsed_d = static_cast<double>(time_delta) /
+                               (static_cast<double>(tick_freq) / 1000.0);
+      if (elapsed_d >= vsync_duration_d) {
+        last_frame_time = current_time;
+
+        // TODO(disjtqz): should recalculate the remaining time to a
+        // vblank after MarkVblank, no idea how long the guest code
+        // normally takes
+        MarkVblank();
+        if (cvars::vsync) {
+          const uint64_t estimated_nanoseconds = static_cast<uint64_t>(
+              (vsync_duration_d * 1000000.0) *
+              duration_scalar);  // 1000 microseconds = 1 ms
+
+          threading::NanoSleep(estimated_nanoseconds);
+        }
+      }
+    }
+
+    if (!cvars::vsync) {
+      MarkVblank();
+      if (normalized_framerate_limit > 0) {
+        // framerate_limit is over 0, vsync disabled
+        //  - No VSYNC + limited frames defined by user
+        uint64_t framerate_limited_sleep_time =
+            1000000000 / normalized_framerate_limit;
+        xe::threading::NanoSleep(framerate_limited_sleep_time);
+      } else {
+        // framerate_limit is 0, vsync disabled
+        //  - No VSYNC + unlimited frames
+        xe::threading::Sleep(std::chrono::milliseconds(1));
+      }
+    }
+  }
+  return 0;
+}
+
+void GraphicsSystem::RecordVblankLateness(uint64_t lateness_host_ticks,
+                                          uint64_t host_tick_frequency) {
+  uint64_t lateness_ns = uint64_t(double(lateness_host_ticks) * 1000000000.0 /
+                                  double(host_tick_frequency));
+  VblankJitter& jitter = vblank_jitter_;
+  ++jitter.vblank_count;
+  jitter.lateness_sum_ns += lateness_ns;
+  jitter.lateness_max_ns = std::max(jitter.lateness_max_ns, lateness_ns);
+  if (lateness_ns >= 1000000) {
+    ++jitter.late_1ms_count;
+  }
+}
+
+void GraphicsSystem::LogVblankJitter() {
+  VblankJitter& jitter = vblank_jitter_;
+  if (!jitter.vblank_count) {
+    return;
+  }
+  XELOGI(
+      "Vblank jitter: {} interrupts, {:.1f} us late on average, {:.1f} us at "
+      "most, {} late by 1 ms or more, {} missed",
+      jitter.vblank_count,
+      double(jitter.lateness_sum_ns) / double(jitter.vblank_count) * 0.001,
+      double(jitter.lateness_max_ns) * 0.001, jitter.late_1ms_count,
+      jitter.missed_count);
+  jitter = {};
+}
+
 void GraphicsSystem::Shutdown() {
+  WaitForProviderCreation();
+
   if (command_processor_) {
+    WaitForShaderStorageInitialization();
     EndTracing();
     command_processor_->Shutdown();
     command_processor_.reset();
@@ -329,6 +451,7 @@ void GraphicsSystem::WriteRegister(uint32_t addr, uint32_t value) {
 
   assert_true(r < RegisterFile::kRegisterCount);
   this->register_file()->values[r] = value;
+  this->register_file()->MarkWritten(r);
 }
 
 void GraphicsSystem::InitializeRingBuffer(uint32_t ptr, uint32_t size_log2) {
@@ -365,32 +488,141 @@ void GraphicsSystem::MarkVblank() {
 }
 
 void GraphicsSystem::ClearCaches() {
+  // The shaders and the pipelines need to be loaded from the storage again.
+  shader_storage_title_id_ = std::nullopt;
   command_processor_->CallInThread(
       [&]() { command_processor_->ClearCaches(); });
 }
 
+bool GraphicsSystem::ShouldInitializeShaderStorage(
+    const std::filesystem::path& cache_root, uint32_t title_id) {
+  if (!cvars::store_shaders) {
+    return false;
+  }
+  if (cvars::warm_title_relaunch && shader_storage_title_id_ == title_id &&
+      shader_storage_cache_root_ == cache_root) {
+    // Relaunching the same title - the storage is still open, and everything
+    // from it is already loaded.
+    XELOGI("Keeping the shader storage of title {:08X} open", title_id);
+    return false;
+  }
+  shader_storage_cache_root_ = cache_root;
+  shader_storage_title_id_ = title_id;
+  return true;
+}
+
 void GraphicsSystem::InitializeShaderStorage(
     const std::filesystem::path& cache_root, uint32_t title_id, bool blocking) {
-  if (!cvars::store_shaders) {
+  if (blocking) {
+    BeginShaderStorageInitialization(cache_root, title_id);
+    WaitForShaderStorageInitialization();
     return;
   }
-  if (blocking) {
-    if (command_processor_->is_paused()) {
-      // Safe to run on any thread while the command processor is paused, no
-      // race condition.
-      command_processor_->InitializeShaderStorage(cache_root, title_id, true);
-    } else {
-      xe::threading::Fence fence;
-      command_processor_->CallInThread([this, cache_root, title_id, &fence]() {
-        command_processor_->InitializeShaderStorage(cache_root, title_id, true);
-        fence.Signal();
-      });
-      fence.Wait();
+  if (!ShouldInitializeShaderStorage(cache_root, title_id)) {
+    return;
+  }
+  command_processor_->CallInThread([this, cache_root, title_id]() {
+    command_processor_->InitializeShaderStorage(cache_root, title_id, false);
+  });
+}
+
+void GraphicsSystem::BeginShaderStorageInitialization(
+    const std::filesystem::path& cache_root, uint32_t title_id) {
+  WaitForShaderStorageInitialization();
+  TuneRenderTargetPath(cache_root, title_id);
+  if (!ShouldInitializeShaderStorage(cache_root, title_id)) {
+    return;
+  }
+  if (command_processor_->is_paused()) {
+    // Safe to run on any thread while the command processor is paused, no
+    // race condition.
+    StartupTimelinePhase startup_phase("Shader storage initialization");
+    command_processor_->InitializeShaderStorage(cache_root, title_id, true);
+    return;
+  }
+  shader_storage_initialization_fence_ =
+      std::make_unique<xe::threading::Fence>();
+  xe::threading::Fence* fence = shader_storage_initialization_fence_.get();
+  command_processor_->CallInThread([this, cache_root, title_id, fence]() {
+    StartupTimelinePhase startup_phase("Shader storage initialization");
+    command_processor_->InitializeShaderStorage(cache_root, title_id, true);
+    fence->Signal();
+  });
+}
+
+void GraphicsSystem::CallInCommandProcessorThreadSynchronous(
+    std::function<void()> fn) {
+  if (command_processor_->is_paused()) {
+    fn();
+    return;
+  }
+  xe::threading::Fence fence;
+  command_processor_->CallInThread([&fn, &fence]() {
+    fn();
+    fence.Signal();
+  });
+  fence.Wait();
+}
+
+void GraphicsSystem::TuneRenderTargetPath(
+    const std::filesystem::path& cache_root, uint32_t title_id) {
+  if (!RenderTargetPathTuning::IsEnabled() || !title_id) {
+    return;
+  }
+  std::optional<RenderTargetCache::Path> current_path;
+  std::string gpu_model;
+  CallInCommandProcessorThreadSynchronous([this, &current_path, &gpu_model]() {
+    current_path = command_processor_->GetRenderTargetPath();
+    gpu_model = command_processor_->GetHostGpuModel();
+  });
+  if (!current_path || gpu_model.empty()) {
+    return;
+  }
+  auto tuning =
+      std::make_shared<RenderTargetPathTuning>(cache_root, title_id, gpu_model);
+  RenderTargetCache::Path path = tuning->ChoosePath(*current_path);
+  // The render target path is chosen when the command processor is set up, and
+  // the state of the current one can't be moved to a new one, so only
+  // switching before the title has started using the GPU.
+  if (path != *current_path && !paused_ && !command_processor_->swap_count()) {
+    XELOGI(
+        "Render target path auto-tuning: Recreating the command processor to "
+        "use {} for title {:08X}",
+        RenderTargetPathTuning::GetPathName(path), title_id);
+    command_processor_->Shutdown();
+    command_processor_ = CreateCommandProcessor();
+    command_processor_->SetRenderTargetPathOverride(path);
+    if (!command_processor_->Initialize()) {
+      xe::FatalError("Unable to reinitialize the command processor");
     }
-  } else {
-    command_processor_->CallInThread([this, cache_root, title_id]() {
-      command_processor_->InitializeShaderStorage(cache_root, title_id, false);
+    // The shader storage needs to be loaded by the new command processor.
+    shader_storage_title_id_.reset();
+    CallInCommandProcessorThreadSynchronous([this, &current_path]() {
+      current_path = command_processor_->GetRenderTargetPath();
     });
+    if (!current_path) {
+      return;
+    }
+    if (*current_path != path) {
+      // Fell back to the other path because of missing features.
+      tuning->StoreMeasurement(path, UINT64_MAX);
+    }
+  }
+  if (!tuning->IsMeasured(*current_path)) {
+    XELOGI(
+        "Render target path auto-tuning: Measuring {} for title {:08X}",
+        RenderTargetPathTuning::GetPathName(*current_path), title_id);
+    command_processor_->CallInThread([this, tuning]() {
+      command_processor_->BeginRenderTargetPathMeasurement(tuning);
+    });
+  }
+}
+
+void GraphicsSystem::WaitForShaderStorageInitialization() {
+  if (shader_storage_initialization_fence_) {
+    StartupTimelinePhase startup_phase("Waiting for the shader storage");
+    shader_storage_initialization_fence_->Wait();
+    shader_storage_initialization_fence_.reset();
   }
 }
 
@@ -430,6 +662,17 @@ bool GraphicsSystem::Restore(ByteStream* stream) {
   return command_processor_->Restore(stream);
 }
 
+uint64_t GraphicsSystem::GetFramerateLimit() const {
+  uint64_t framerate_limit = cvars::framerate_limit;
+  uint32_t governed_framerate_limit =
+      governed_framerate_limit_.load(std::memory_order_relaxed);
+  if (governed_framerate_limit &&
+      (!framerate_limit || governed_framerate_limit < framerate_limit)) {
+    framerate_limit = governed_framerate_limit;
+  }
+  return framerate_limit;
+}
+
 std::pair<uint16_t, uint16_t> GraphicsSystem::GetInternalDisplayResolution() {
   if (cvars::internal_display_resolution >=
       internal_display_resolution_entries.size()) {
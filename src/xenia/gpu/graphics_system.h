@@ -12,9 +12,11 @@
 
 #include <atomic>
 #include <cstdint>
+#include <filesystem>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <thread>
 
@@ -55,6 +57,12 @@ class GraphicsSystem {
   ui::GraphicsProvider* provider() const { return provider_.get(); }
   ui::Presenter* presenter() const { return presenter_.get(); }
 
+  // Starts creating the host graphics provider and device on another thread,
+  // as that doesn't depend on the rest of the emulator, so it can be overlapped
+  // with the initialization of the other subsystems. Setup waits for it to be
+  // completed, or creates the provider itself if this hasn't been called.
+  void BeginProviderCreation(bool is_surface_required);
+
   virtual X_STATUS Setup(cpu::Processor* processor,
                          kernel::KernelState* kernel_state,
                          ui::WindowedAppContext* app_context,
@@ -81,6 +89,11 @@ class GraphicsSystem {
 
   void InitializeShaderStorage(const std::filesystem::path& cache_root,
                                uint32_t title_id, bool blocking);
+  // Blocking initialization on the command processor thread, overlapping with
+  // the work done until WaitForShaderStorageInitialization.
+  void BeginShaderStorageInitialization(
+      const std::filesystem::path& cache_root, uint32_t title_id);
+  void WaitForShaderStorageInitialization();
 
   void RequestFrameTrace();
   void BeginTracing();
@@ -95,6 +108,18 @@ class GraphicsSystem {
 
   static std::pair<uint16_t, uint16_t> GetInternalDisplayResolution();
 
+  // The framerate_limit, or a lower limit set by the performance governor, 0
+  // if unlimited. Takes effect in the frame limiter on the next vblank.
+  uint64_t GetFramerateLimit() const;
+  uint32_t governed_framerate_limit() const {
+    return governed_framerate_limit_.load(std::memory_order_relaxed);
+  }
+  // 0 to remove the governed limit.
+  void set_governed_framerate_limit(uint32_t framerate_limit) {
+    governed_framerate_limit_.store(framerate_limit,
+                                    std::memory_order_relaxed);
+  }
+
   std::pair<uint32_t, uint32_t> GetScaledAspectRatio() const {
     return {scaled_aspect_x_, scaled_aspect_y_};
   };
@@ -106,6 +131,9 @@ class GraphicsSystem {
  protected:
   GraphicsSystem();
 
+  // May be called on any thread. Null if not available.
+  virtual std::unique_ptr<ui::GraphicsProvider> CreateProvider(
+      bool is_surface_required) = 0;
   virtual std::unique_ptr<CommandProcessor> CreateCommandProcessor() = 0;
 
   static uint32_t ReadRegisterThunk(void* ppc_context, GraphicsSystem* gs,
@@ -126,7 +154,20 @@ class GraphicsSystem {
   uint32_t interrupt_callback_ = 0;
   uint32_t interrupt_callback_data_ = 0;
 
+  // Lateness of the vblank interrupts since the last log, only accessed by the
+  // frame limiter thread.
+  struct VblankJitter {
+    uint64_t vblank_count;
+    uint64_t lateness_sum_ns;
+    uint64_t lateness_max_ns;
+    uint64_t late_1ms_count;
+    // Vblanks dropped because the thread fell behind by more than a period.
+    uint64_t missed_count;
+  };
+
   std::atomic<bool> frame_limiter_worker_running_;
+  VblankJitter vblank_jitter_ = {};
+  std::atomic<uint32_t> governed_framerate_limit_ = {0};
   kernel::object_ref<kernel::XHostThread> frame_limiter_worker_thread_;
 
   RegisterFile* register_file_;
@@ -138,8 +179,36 @@ class GraphicsSystem {
   uint32_t scaled_aspect_y_ = 0;
 
  private:
+  void WaitForProviderCreation();
+  // Generates the vblank interrupts at the frame rate limit.
+  int FrameLimiterThread();
+  void RecordVblankLateness(uint64_t lateness_host_ticks,
+                            uint64_t host_tick_frequency);
+  void LogVblankJitter();
+  // Checks whether the storage isn't open already, and if not, records the
+  // storage about to be open.
+  bool ShouldInitializeShaderStorage(const std::filesystem::path& cache_root,
+                                     uint32_t title_id);
+  // Calls the function on the command processor thread and waits for it.
+  void CallInCommandProcessorThreadSynchronous(std::function<void()> fn);
+  // With render_target_path_auto_tune, recreates the command processor with
+  // the render target path chosen for the title if the title hasn't used the
+  // GPU yet, and starts measuring the path if it hasn't been measured.
+  void TuneRenderTargetPath(const std::filesystem::path& cache_root,
+                            uint32_t title_id);
+
+  std::thread provider_creation_thread_;
+
   std::unique_ptr<ui::Presenter> presenter_;
 
+  // Of the last InitializeShaderStorage, for keeping the storage when
+  // relaunching the same title.
+  std::filesystem::path shader_storage_cache_root_;
+  std::optional<uint32_t> shader_storage_title_id_;
+  // Signaled when the initialization started by
+  // BeginShaderStorageInitialization is completed.
+  std::unique_ptr<xe::threading::Fence> shader_storage_initialization_fence_;
+
   std::atomic_flag host_gpu_loss_reported_;
 };
 
@@ -9,6 +9,26 @@
 
 #include "xenia/gpu/null/null_command_processor.h"
 
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/profiling.h"
+#include "xenia/base/xxhash.h"
+#include "xenia/gpu/draw_util.h"
+#include "xenia/gpu/registers.h"
+
+DEFINE_bool(
+    null_gpu_process_draws, false,
+    "With the null GPU backend, run the host-independent part of the GPU "
+    "emulation done by the real backends - shader microcode analysis, "
+    "primitive processing and index buffer conversion, shared memory range "
+    "requests and invalidation, and texture cache lookups - without making "
+    "any host graphics API calls. The CPU time spent in draws is reported to "
+    "the profiler as gpu/null/draw_us and gpu/null/draw_ns_average, for "
+    "measuring the CPU cost of the GPU emulation separately from the cost of "
+    "the host driver.",
+    "GPU");
+
 namespace xe {
 namespace gpu {
 namespace null {
@@ -24,28 +44,190 @@ void NullCommandProcessor::TracePlaybackWroteMemory(uint32_t base_ptr,
 void NullCommandProcessor::RestoreEdramSnapshot(const void* snapshot) {}
 
 bool NullCommandProcessor::SetupContext() {
-  return CommandProcessor::SetupContext();
+  if (!CommandProcessor::SetupContext()) {
+    return false;
+  }
+
+  if (cvars::null_gpu_process_draws) {
+    shared_memory_ = std::make_unique<NullSharedMemory>(*memory_);
+    shared_memory_->Initialize();
+
+    primitive_processor_ = std::make_unique<NullPrimitiveProcessor>(
+        *register_file_, *memory_, trace_writer_, *shared_memory_);
+    if (!primitive_processor_->Initialize()) {
+      XELOGE("Unable to initialize the null primitive processor");
+      return false;
+    }
+
+    texture_cache_ =
+        std::make_unique<NullTextureCache>(*register_file_, *shared_memory_);
+    frame_index_ = 1;
+    texture_cache_->BeginSubmission(frame_index_);
+    texture_cache_->BeginFrame();
+  }
+
+  return true;
 }
 
 void NullCommandProcessor::ShutdownContext() {
+  texture_cache_.reset();
+  shaders_.clear();
+  primitive_processor_.reset();
+  shared_memory_.reset();
+  frame_draws_ = 0;
+  frame_draw_ticks_ = 0;
   return CommandProcessor::ShutdownContext();
 }
 
+void NullCommandProcessor::WriteRegister(uint32_t index, uint32_t value) {
+  CommandProcessor::WriteRegister(index, value);
+
+  if (texture_cache_ && index >= XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0 &&
+      index <= XE_GPU_REG_SHADER_CONSTANT_FETCH_31_5) {
+    texture_cache_->TextureFetchConstantWritten(
+        (index - XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0) / 6);
+  }
+}
+
 void NullCommandProcessor::IssueSwap(uint32_t frontbuffer_ptr,
                                      uint32_t frontbuffer_width,
-                                     uint32_t frontbuffer_height) {}
+                                     uint32_t frontbuffer_height) {
+  if (!texture_cache_) {
+    return;
+  }
+
+  COUNT_profile_set("gpu/null/draws", frame_draws_);
+  uint64_t draw_ns =
+      frame_draw_ticks_ * 1000000000 / Clock::QueryHostTickFrequency();
+  COUNT_profile_set("gpu/null/draw_us", draw_ns / 1000);
+  COUNT_profile_set("gpu/null/draw_ns_average",
+                    frame_draws_ ? draw_ns / frame_draws_ : 0);
+  frame_draws_ = 0;
+  frame_draw_ticks_ = 0;
+
+  // Each frame is treated as one submission completed immediately, as nothing
+  // is actually executed.
+  primitive_processor_->EndFrame();
+  shared_memory_->BeginFrame();
+  texture_cache_->CompletedSubmissionUpdated(frame_index_);
+  ++frame_index_;
+  texture_cache_->BeginSubmission(frame_index_);
+  texture_cache_->BeginFrame();
+}
 
 Shader* NullCommandProcessor::LoadShader(xenos::ShaderType shader_type,
                                          uint32_t guest_address,
                                          const uint32_t* host_address,
                                          uint32_t dword_count) {
-  return nullptr;
+  if (!cvars::null_gpu_process_draws) {
+    return nullptr;
+  }
+  uint64_t data_hash =
+      XXH3_64bits(host_address, dword_count * sizeof(uint32_t));
+  auto it = shaders_.find(data_hash);
+  if (it != shaders_.end()) {
+    return it->second.get();
+  }
+  Shader* shader =
+      new Shader(shader_type, data_hash, host_address, dword_count);
+  shaders_.emplace(data_hash, std::unique_ptr<Shader>(shader));
+  return shader;
 }
 
 bool NullCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
                                      uint32_t index_count,
                                      IndexBufferInfo* index_buffer_info,
                                      bool major_mode_explicit) {
+  if (!texture_cache_) {
+    return true;
+  }
+  uint64_t start_ticks = Clock::QueryHostTickCount();
+  bool result = ProcessDraw();
+  frame_draw_ticks_ += Clock::QueryHostTickCount() - start_ticks;
+  ++frame_draws_;
+  return result;
+}
+
+bool NullCommandProcessor::ProcessDraw() {
+  const RegisterFile& regs = *register_file_;
+
+  xenos::ModeControl edram_mode = regs.Get<reg::RB_MODECONTROL>().edram_mode;
+  if (edram_mode == xenos::ModeControl::kCopy) {
+    return IssueCopy();
+  }
+
+  Shader* vertex_shader = active_vertex_shader();
+  if (!vertex_shader) {
+    return false;
+  }
+  if (!vertex_shader->is_ucode_analyzed()) {
+    vertex_shader->AnalyzeUcode(ucode_disasm_buffer_);
+  }
+
+  bool primitive_polygonal = draw_util::IsPrimitivePolygonal(regs);
+  bool is_rasterization_done =
+      draw_util::IsRasterizationPotentiallyDone(regs, primitive_polygonal);
+  Shader* pixel_shader = nullptr;
+  if (is_rasterization_done) {
+    if (edram_mode == xenos::ModeControl::kColorDepth) {
+      pixel_shader = active_pixel_shader();
+      if (pixel_shader) {
+        if (!pixel_shader->is_ucode_analyzed()) {
+          pixel_shader->AnalyzeUcode(ucode_disasm_buffer_);
+        }
+        if (!draw_util::IsPixelShaderNeededWithRasterization(*pixel_shader,
+                                                             regs)) {
+          pixel_shader = nullptr;
+        }
+      }
+    }
+  } else if (!vertex_shader->memexport_eM_written()) {
+    // This draw has no effect.
+    return true;
+  }
+
+  PrimitiveProcessor::ProcessingResult primitive_processing_result;
+  if (!primitive_processor_->Process(primitive_processing_result)) {
+    return false;
+  }
+  if (!primitive_processing_result.host_draw_vertex_count) {
+    // Nothing to draw.
+    return true;
+  }
+
+  uint32_t used_texture_mask = 0;
+  for (const Shader* shader : {vertex_shader, pixel_shader}) {
+    if (!shader) {
+      continue;
+    }
+    for (const Shader::TextureBinding& texture_binding :
+         shader->texture_bindings()) {
+      used_texture_mask |= UINT32_C(1) << texture_binding.fetch_constant;
+    }
+  }
+  texture_cache_->RequestTextures(used_texture_mask);
+
+  uint64_t vertex_buffers_resident[2] = {};
+  for (const Shader::VertexBinding& vertex_binding :
+       vertex_shader->vertex_bindings()) {
+    uint32_t vfetch_index = vertex_binding.fetch_constant;
+    if (vertex_buffers_resident[vfetch_index >> 6] &
+        (uint64_t(1) << (vfetch_index & 63))) {
+      continue;
+    }
+    xenos::xe_gpu_vertex_fetch_t vfetch_constant =
+        regs.GetVertexFetch(vfetch_index);
+    if (vfetch_constant.type != xenos::FetchConstantType::kVertex) {
+      continue;
+    }
+    if (!shared_memory_->RequestRange(vfetch_constant.address << 2,
+                                      vfetch_constant.size << 2)) {
+      return false;
+    }
+    vertex_buffers_resident[vfetch_index >> 6] |= uint64_t(1)
+                                                  << (vfetch_index & 63);
+  }
+
   return true;
 }
 
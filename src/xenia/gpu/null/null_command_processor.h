@@ -10,8 +10,17 @@
 #ifndef XENIA_GPU_NULL_NULL_COMMAND_PROCESSOR_H_
 #define XENIA_GPU_NULL_NULL_COMMAND_PROCESSOR_H_
 
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+#include "xenia/base/string_buffer.h"
 #include "xenia/gpu/command_processor.h"
 #include "xenia/gpu/null/null_graphics_system.h"
+#include "xenia/gpu/null/null_primitive_processor.h"
+#include "xenia/gpu/null/null_shared_memory.h"
+#include "xenia/gpu/null/null_texture_cache.h"
+#include "xenia/gpu/shader.h"
 #include "xenia/gpu/xenos.h"
 #include "xenia/kernel/kernel_state.h"
 
@@ -33,6 +42,8 @@ class NullCommandProcessor : public CommandProcessor {
   bool SetupContext() override;
   void ShutdownContext() override;
 
+  void WriteRegister(uint32_t index, uint32_t value) override;
+
   void IssueSwap(uint32_t frontbuffer_ptr, uint32_t frontbuffer_width,
                  uint32_t frontbuffer_height) override;
 
@@ -46,6 +57,23 @@ class NullCommandProcessor : public CommandProcessor {
   bool IssueCopy() override;
 
   void InitializeTrace() override;
+
+  // The common part of draw processing done by the host backends, with
+  // null_gpu_process_draws.
+  bool ProcessDraw();
+
+  // With null_gpu_process_draws, the subsystems with the host-independent
+  // logic of the real backends, but without host resources.
+  std::unique_ptr<NullSharedMemory> shared_memory_;
+  std::unique_ptr<NullPrimitiveProcessor> primitive_processor_;
+  std::unique_ptr<NullTextureCache> texture_cache_;
+  std::unordered_map<uint64_t, std::unique_ptr<Shader>> shaders_;
+  StringBuffer ucode_disasm_buffer_;
+  uint64_t frame_index_ = 0;
+
+  // CPU time spent in the draws of the current frame.
+  uint32_t frame_draws_ = 0;
+  uint64_t frame_draw_ticks_ = 0;
 };
 
 }  // namespace null
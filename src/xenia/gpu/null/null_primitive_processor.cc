@@ -0,0 +1,69 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/null/null_primitive_processor.h"
+
+#include <algorithm>
+
+namespace xe {
+namespace gpu {
+namespace null {
+
+NullPrimitiveProcessor::~NullPrimitiveProcessor() { Shutdown(true); }
+
+bool NullPrimitiveProcessor::Initialize() {
+  // Same as the Direct3D 12 backend - triangle fans and line loops converted
+  // on the CPU.
+  if (!InitializeCommon(true, false, false, true, true, true)) {
+    Shutdown();
+    return false;
+  }
+  return true;
+}
+
+void NullPrimitiveProcessor::Shutdown(bool from_destructor) {
+  converted_index_buffer_.reset();
+  converted_index_buffer_size_ = 0;
+  builtin_index_buffer_.reset();
+  if (!from_destructor) {
+    ShutdownCommon();
+  }
+}
+
+bool NullPrimitiveProcessor::InitializeBuiltinIndexBuffer(
+    size_t size_bytes, std::function<void(void*)> fill_callback) {
+  builtin_index_buffer_ = std::make_unique<uint8_t[]>(size_bytes);
+  fill_callback(builtin_index_buffer_.get());
+  return true;
+}
+
+void* NullPrimitiveProcessor::RequestHostConvertedIndexBufferForCurrentFrame(
+    xenos::IndexFormat format, uint32_t index_count, bool coalign_for_simd,
+    uint32_t coalignment_original_address, size_t& backend_handle_out) {
+  size_t index_size = format == xenos::IndexFormat::kInt16 ? sizeof(uint16_t)
+                                                           : sizeof(uint32_t);
+  size_t size = index_size * index_count +
+                (coalign_for_simd ? XE_GPU_PRIMITIVE_PROCESSOR_SIMD_SIZE : 0);
+  if (converted_index_buffer_size_ < size) {
+    converted_index_buffer_size_ =
+        std::max(size, size_t(kMinRequiredConvertedIndexBufferSize));
+    converted_index_buffer_ =
+        std::make_unique<uint8_t[]>(converted_index_buffer_size_);
+  }
+  uint8_t* mapping = converted_index_buffer_.get();
+  if (coalign_for_simd) {
+    mapping += GetSimdCoalignmentOffset(mapping, coalignment_original_address);
+  }
+  backend_handle_out = 0;
+  return mapping;
+}
+
+}  // namespace null
+}  // namespace gpu
+}  // namespace xe
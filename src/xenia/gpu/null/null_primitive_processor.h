@@ -0,0 +1,60 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_NULL_NULL_PRIMITIVE_PROCESSOR_H_
+#define XENIA_GPU_NULL_NULL_PRIMITIVE_PROCESSOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "xenia/gpu/primitive_processor.h"
+
+namespace xe {
+namespace gpu {
+namespace null {
+
+// Primitive processor doing all the index buffer conversion on the CPU like on
+// a host without the support of the guest primitive types, but writing the
+// converted indices to a scratch buffer that is never read.
+class NullPrimitiveProcessor final : public PrimitiveProcessor {
+ public:
+  NullPrimitiveProcessor(const RegisterFile& register_file, Memory& memory,
+                         TraceWriter& trace_writer,
+                         SharedMemory& shared_memory)
+      : PrimitiveProcessor(register_file, memory, trace_writer, shared_memory) {
+  }
+  ~NullPrimitiveProcessor();
+
+  bool Initialize();
+  void Shutdown(bool from_destructor = false);
+
+  void EndFrame() { ClearPerFrameCache(); }
+
+ protected:
+  bool InitializeBuiltinIndexBuffer(
+      size_t size_bytes, std::function<void(void*)> fill_callback) override;
+  void* RequestHostConvertedIndexBufferForCurrentFrame(
+      xenos::IndexFormat format, uint32_t index_count, bool coalign_for_simd,
+      uint32_t coalignment_original_address,
+      size_t& backend_handle_out) override;
+
+ private:
+  std::unique_ptr<uint8_t[]> builtin_index_buffer_;
+  // Reused for all the conversions since the results are not consumed.
+  std::unique_ptr<uint8_t[]> converted_index_buffer_;
+  size_t converted_index_buffer_size_ = 0;
+};
+
+}  // namespace null
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_NULL_NULL_PRIMITIVE_PROCESSOR_H_
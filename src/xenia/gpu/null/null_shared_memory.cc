@@ -0,0 +1,41 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/null/null_shared_memory.h"
+
+namespace xe {
+namespace gpu {
+namespace null {
+
+NullSharedMemory::~NullSharedMemory() { Shutdown(true); }
+
+void NullSharedMemory::Initialize() { InitializeCommon(); }
+
+void NullSharedMemory::Shutdown(bool from_destructor) {
+  // If calling from the destructor, the SharedMemory destructor will call
+  // ShutdownCommon.
+  if (!from_destructor) {
+    ShutdownCommon();
+  }
+}
+
+bool NullSharedMemory::UploadRanges(
+    const std::pair<uint32_t, uint32_t>* upload_page_ranges,
+    uint32_t num_upload_ranges) {
+  for (uint32_t i = 0; i < num_upload_ranges; ++i) {
+    MakeRangeValid(upload_page_ranges[i].first << page_size_log2(),
+                   upload_page_ranges[i].second << page_size_log2(), false,
+                   false);
+  }
+  return true;
+}
+
+}  // namespace null
+}  // namespace gpu
+}  // namespace xe
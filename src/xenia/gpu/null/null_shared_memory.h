@@ -0,0 +1,42 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_NULL_NULL_SHARED_MEMORY_H_
+#define XENIA_GPU_NULL_NULL_SHARED_MEMORY_H_
+
+#include <cstdint>
+#include <utility>
+
+#include "xenia/gpu/shared_memory.h"
+#include "xenia/memory.h"
+
+namespace xe {
+namespace gpu {
+namespace null {
+
+// Shared memory tracking the validity and the watches of the guest memory like
+// on a real host, but without a host buffer to upload the data to.
+class NullSharedMemory : public SharedMemory {
+ public:
+  explicit NullSharedMemory(Memory& memory) : SharedMemory(memory) {}
+  ~NullSharedMemory() override;
+
+  void Initialize();
+  void Shutdown(bool from_destructor = false);
+
+ protected:
+  bool UploadRanges(const std::pair<uint32_t, uint32_t>* upload_page_ranges,
+                    uint32_t num_upload_ranges) override;
+};
+
+}  // namespace null
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_NULL_NULL_SHARED_MEMORY_H_
@@ -0,0 +1,63 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/null/null_texture_cache.h"
+
+#include "xenia/base/assert.h"
+
+namespace xe {
+namespace gpu {
+namespace null {
+
+uint32_t NullTextureCache::GetMaxHostTextureWidthHeight(
+    xenos::DataDimension dimension) const {
+  switch (dimension) {
+    case xenos::DataDimension::k1D:
+    case xenos::DataDimension::k2DOrStacked:
+    case xenos::DataDimension::kCube:
+      return xenos::kTexture2DCubeMaxWidthHeight;
+    case xenos::DataDimension::k3D:
+      return xenos::kTexture3DMaxWidthHeight;
+    default:
+      assert_unhandled_case(dimension);
+      return 0;
+  }
+}
+
+uint32_t NullTextureCache::GetMaxHostTextureDepthOrArraySize(
+    xenos::DataDimension dimension) const {
+  switch (dimension) {
+    case xenos::DataDimension::k1D:
+    case xenos::DataDimension::k2DOrStacked:
+      return xenos::kTexture2DMaxStackDepth;
+    case xenos::DataDimension::k3D:
+      return xenos::kTexture3DMaxDepth;
+    case xenos::DataDimension::kCube:
+      return 6;
+    default:
+      assert_unhandled_case(dimension);
+      return 0;
+  }
+}
+
+std::unique_ptr<TextureCache::Texture> NullTextureCache::CreateTexture(
+    TextureKey key) {
+  return std::unique_ptr<Texture>(new NullTexture(*this, key));
+}
+
+NullTextureCache::NullTexture::NullTexture(NullTextureCache& texture_cache,
+                                           const TextureKey& key)
+    : Texture(texture_cache, key) {
+  // Account for the memory a host texture would take for the memory limits.
+  SetHostMemoryUsage(uint64_t(GetGuestBaseSize()) + GetGuestMipsSize());
+}
+
+}  // namespace null
+}  // namespace gpu
+}  // namespace xe
@@ -11,6 +11,8 @@ void COMMAND_PROCESSOR::ExecuteIndirectBuffer(uint32_t ptr,
 
   trace_writer_.WriteIndirectBufferStart(ptr, count * sizeof(uint32_t));
   if (count != 0) {
+    RecordIndirectBuffer(ptr, count);
+
     RingBuffer old_reader = reader_;
 
     // Execute commands!
@@ -633,6 +635,7 @@ bool COMMAND_PROCESSOR::ExecutePacketType3_INTERRUPT(
 
   // generate interrupt from the command stream
   uint32_t cpu_mask = reader_.ReadAndSwap<uint32_t>();
+  FlushReadbacks();
   for (int n = 0; n < 6; n++) {
     if (cpu_mask & (1 << n)) {
       graphics_system_->DispatchInterruptCallback(1, n);
@@ -646,6 +649,7 @@ bool COMMAND_PROCESSOR::ExecutePacketType3_XE_SWAP(uint32_t packet,
   SCOPE_profile_cpu_f("gpu");
 
   Profiler::Flip();
+  RecordSwap();
 
   // Xenia-specific VdSwap hook.
   // VdSwap will post this to tell us we need to swap the screen/fire an
@@ -715,6 +719,7 @@ bool COMMAND_PROCESSOR::ExecutePacketType3_WAIT_REG_MEM(
                 : register_file_->values[poll_reg_addr];
 
   bool matched = false;
+  RegMemWait reg_mem_wait;
 
   do {
     uint32_t value = value_ref;
@@ -734,12 +739,12 @@ bool COMMAND_PROCESSOR::ExecutePacketType3_WAIT_REG_MEM(
     if (!matched) {
       // Wait.
       if (wait >= 0x100) {
+        FlushReadbacks();
         PrepareForWait();
         if (!cvars::vsync) {
           // User wants it fast and dangerous.
           // do nothing
-        } else {
-          xe::threading::Sleep(std::chrono::milliseconds(wait / 0x100));
+        } else if (WaitBeforeRegMemPoll(reg_mem_wait, wait / 0x100)) {
           ReturnFromWait();
         }
 
@@ -863,6 +868,7 @@ bool COMMAND_PROCESSOR::ExecutePacketType3_COND_WRITE(
 XE_FORCEINLINE
 void COMMAND_PROCESSOR::WriteEventInitiator(uint32_t value) XE_RESTRICT {
   register_file_->values[XE_GPU_REG_VGT_EVENT_INITIATOR] = value;
+  register_file_->MarkWritten(XE_GPU_REG_VGT_EVENT_INITIATOR);
 }
 bool COMMAND_PROCESSOR::ExecutePacketType3_EVENT_WRITE(
     uint32_t packet, uint32_t count) XE_RESTRICT {
@@ -900,6 +906,7 @@ bool COMMAND_PROCESSOR::ExecutePacketType3_EVENT_WRITE_SHD(
   auto endianness = static_cast<xenos::Endian>(address & 0x3);
   address &= ~0x3;
   data_value = GpuSwap(data_value, endianness);
+  FlushReadbacks();
   uint8_t* write_destination = memory_->TranslatePhysical(address);
   if (address > 0x1FFFFFFF) {
     uint32_t writeback_base = register_file_->values[XE_GPU_REG_WRITEBACK_BASE];
@@ -964,21 +971,35 @@ bool COMMAND_PROCESSOR::ExecutePacketType3_EVENT_WRITE_ZPD(
 
   // Occlusion queries:
   // This command is send on query begin and end.
+  uint32_t sample_counts_address =
+      register_file_->values[XE_GPU_REG_RB_SAMPLE_COUNT_ADDR];
+  auto* pSampleCounts =
+      memory_->TranslatePhysical<xe_gpu_depth_sample_counts*>(
+          sample_counts_address);
+  // 0xFFFFFEED is written to this two locations by D3D only on D3DISSUE_END
+  // and used to detect a finished query.
+  bool is_end_via_z_pass = pSampleCounts->ZPass_A == kQueryFinished &&
+                           pSampleCounts->ZPass_B == kQueryFinished;
+  // Older versions of D3D also checks for ZFail (4D5307D5).
+  bool is_end_via_z_fail = pSampleCounts->ZFail_A == kQueryFinished &&
+                           pSampleCounts->ZFail_B == kQueryFinished;
+  bool is_end = is_end_via_z_pass || is_end_via_z_fail;
+  if (cvars::query_occlusion_host) {
+    if (is_end) {
+      // The end markers are kept until the host writes the result.
+      if (EndOcclusionQuery(sample_counts_address)) {
+        return true;
+      }
+    } else if (BeginOcclusionQuery()) {
+      std::memset(pSampleCounts, 0, sizeof(xe_gpu_depth_sample_counts));
+      return true;
+    }
+  }
   // As a workaround report some fixed amount of passed samples.
   auto fake_sample_count = cvars::query_occlusion_fake_sample_count;
   if (fake_sample_count >= 0) {
-    auto* pSampleCounts =
-        memory_->TranslatePhysical<xe_gpu_depth_sample_counts*>(
-            register_file_->values[XE_GPU_REG_RB_SAMPLE_COUNT_ADDR]);
-    // 0xFFFFFEED is written to this two locations by D3D only on D3DISSUE_END
-    // and used to detect a finished query.
-    bool is_end_via_z_pass = pSampleCounts->ZPass_A == kQueryFinished &&
-                             pSampleCounts->ZPass_B == kQueryFinished;
-    // Older versions of D3D also checks for ZFail (4D5307D5).
-    bool is_end_via_z_fail = pSampleCounts->ZFail_A == kQueryFinished &&
-                             pSampleCounts->ZFail_B == kQueryFinished;
     std::memset(pSampleCounts, 0, sizeof(xe_gpu_depth_sample_counts));
-    if (is_end_via_z_pass || is_end_via_z_fail) {
+    if (is_end) {
       pSampleCounts->ZPass_A = fake_sample_count;
       pSampleCounts->Total_A = fake_sample_count;
     }
@@ -1007,6 +1028,7 @@ bool COMMAND_PROCESSOR::ExecutePacketType3Draw(
 
   register_file_->values[XE_GPU_REG_VGT_DRAW_INITIATOR] =
       vgt_draw_initiator.value;
+  register_file_->MarkWritten(XE_GPU_REG_VGT_DRAW_INITIATOR);
   bool draw_succeeded = true;
   // TODO(Triang3l): Remove IndexBufferInfo and replace handling of all this
   // with PrimitiveProcessor when the old Vulkan renderer is removed.
@@ -1028,6 +1050,7 @@ bool COMMAND_PROCESSOR::ExecutePacketType3Draw(
       uint32_t vgt_dma_base = reader_.ReadAndSwap<uint32_t>();
       --count_remaining;
       register_file_->values[XE_GPU_REG_VGT_DMA_BASE] = vgt_dma_base;
+      register_file_->MarkWritten(XE_GPU_REG_VGT_DMA_BASE);
       reg::VGT_DMA_SIZE vgt_dma_size;
       assert_not_zero(count_remaining);
       if (!count_remaining) {
@@ -1037,6 +1060,7 @@ bool COMMAND_PROCESSOR::ExecutePacketType3Draw(
       vgt_dma_size.value = reader_.ReadAndSwap<uint32_t>();
       --count_remaining;
       register_file_->values[XE_GPU_REG_VGT_DMA_SIZE] = vgt_dma_size.value;
+      register_file_->MarkWritten(XE_GPU_REG_VGT_DMA_SIZE);
 
       uint32_t index_size_bytes =
           vgt_draw_initiator.index_size == xenos::IndexFormat::kInt16
@@ -1345,9 +1369,11 @@ bool COMMAND_PROCESSOR::ExecutePacketType3_VIZ_QUERY(
     if (id < 32) {
       register_file_->values[XE_GPU_REG_PA_SC_VIZ_QUERY_STATUS_0] |= uint32_t(1)
                                                                      << id;
+      register_file_->MarkWritten(XE_GPU_REG_PA_SC_VIZ_QUERY_STATUS_0);
     } else {
       register_file_->values[XE_GPU_REG_PA_SC_VIZ_QUERY_STATUS_1] |=
           uint32_t(1) << (id - 32);
+      register_file_->MarkWritten(XE_GPU_REG_PA_SC_VIZ_QUERY_STATUS_1);
     }
   }
 
@@ -68,6 +68,25 @@ DEFINE_int32(
     "while a very low value may result in excessive locking and lookups.\n"
     "Negative values disable caching.",
     "GPU");
+DEFINE_uint32(
+    primitive_processor_cache_across_frames_mb, 32,
+    "Maximum size (in megabytes) of converted guest indices (with primitive "
+    "type conversion or reset index replacement) to keep in the cache across "
+    "frames, so static index buffers are not processed again every frame, "
+    "only copied. Processing results that don't require conversion (such as "
+    "when the reset index is not actually used) are also kept across frames "
+    "if this is not 0.\n"
+    "0 to reuse processed indices only within one frame.",
+    "GPU");
+DEFINE_int32(
+    primitive_processor_gpu_conversion_min_indices, 1024,
+    "Smallest number of guest indices of a triangle fan or a quad list "
+    "without primitive reset for converting it to a triangle list on the GPU, "
+    "by fetching the guest indices from the shared memory in the vertex "
+    "shader through a built-in index buffer, instead of converting and "
+    "uploading the indices on the CPU.\n"
+    "Negative values disable conversion on the GPU.",
+    "GPU");
 
 namespace xe {
 namespace gpu {
@@ -252,6 +271,8 @@ void PrimitiveProcessor::ShutdownCommon() {
                   sizeof(cache_buckets_non_empty_l1_));
       std::memset(cache_buckets_non_empty_l2_, 0,
                   sizeof(cache_buckets_non_empty_l2_));
+      cache_converted_data_.clear();
+      cache_converted_data_bytes_ = 0;
     }
     memory_.UnregisterPhysicalMemoryInvalidationCallback(
         memory_invalidation_callback_handle_);
@@ -261,11 +282,40 @@ void PrimitiveProcessor::ShutdownCommon() {
 }
 
 void PrimitiveProcessor::ClearPerFrameCache() {
+  COUNT_profile_set("gpu/primitive_processor/cache_hits", cache_frame_hits_);
+  COUNT_profile_set("gpu/primitive_processor/cache_misses",
+                    cache_frame_misses_);
+  COUNT_profile_set("gpu/primitive_processor/cache_copies_from_previous_frames",
+                    cache_frame_copies_from_previous_frames_);
+  cache_frame_hits_ = 0;
+  cache_frame_misses_ = 0;
+  cache_frame_copies_from_previous_frames_ = 0;
   if (!memory_invalidation_callback_handle_) {
     // Only do clearing if cache has ever been used.
     return;
   }
   auto global_lock = global_critical_region_.Acquire();
+  COUNT_profile_set("gpu/primitive_processor/cache_across_frames_kb",
+                    uint32_t(cache_converted_data_bytes_ >> 10));
+  if (cvars::primitive_processor_cache_across_frames_mb &&
+      cache_converted_data_bytes_ <=
+          size_t(cvars::primitive_processor_cache_across_frames_mb) << 20) {
+    // Keep the entries, but the buffers of the converted indices are only
+    // valid until the end of the frame.
+    for (const std::pair<CacheKey, size_t>& cache_map_entry : cache_map_) {
+      CachedResult& result = cache_entry_pool_[cache_map_entry.second].result;
+      if (result.index_buffer_type ==
+          ProcessedIndexBufferType::kHostConverted) {
+        result.host_index_buffer_handle = SIZE_MAX;
+      }
+    }
+    return;
+  }
+  ClearCacheEntries(global_lock);
+}
+
+void PrimitiveProcessor::ClearCacheEntries(
+    [[maybe_unused]] const global_unique_lock_type& global_lock) {
   for (const std::pair<CacheKey, size_t>& cache_map_entry : cache_map_) {
     cache_entry_pool_[cache_map_entry.second].free_next =
         cache_bucket_free_first_entry_;
@@ -276,6 +326,8 @@ void PrimitiveProcessor::ClearPerFrameCache() {
               sizeof(cache_buckets_non_empty_l1_));
   std::memset(cache_buckets_non_empty_l2_, 0,
               sizeof(cache_buckets_non_empty_l2_));
+  cache_converted_data_.clear();
+  cache_converted_data_bytes_ = 0;
 }
 
 bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
@@ -299,17 +351,17 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
       regs.Get<reg::VGT_HOS_CNTL>().tess_mode;
   Shader::HostVertexShaderType host_vertex_shader_type;
   if (tessellation_enabled) {
-    // Currently only supporting tessellation in known cases for safety, and not
-    // yet converting patch strips / fans to patch lists until games using them
-    // are found for easier debugging when it actually happens.
-    // TODO(Triang3l): Conversion of patch strips / fans if found.
+    // Currently only supporting tessellation in known cases for safety. Patch
+    // strips and fans are converted to patch lists, like other primitive types
+    // not supported by the host - the conversion results are cached across
+    // frames and invalidated when the guest index buffer is written to.
     host_vertex_shader_type = Shader::HostVertexShaderType(-1);
     switch (guest_primitive_type) {
       case xenos::PrimitiveType::kTriangleList:
-        // Also supported by triangle strips and fans according to:
-        // https://www.khronos.org/registry/OpenGL/extensions/AMD/AMD_vertex_shader_tessellator.txt
-        // Would need to convert those to triangle lists, but haven't seen any
-        // games using tessellated strips / fans so far.
+      case xenos::PrimitiveType::kTriangleFan:
+      case xenos::PrimitiveType::kTriangleStrip:
+        // Strips and fans haven't been seen in games so far.
+        host_primitive_type = xenos::PrimitiveType::kTriangleList;
         switch (tessellation_mode) {
           case xenos::TessellationMode::kDiscrete:
             // - 415607E1 - nets above barrels in the beginning of the first
@@ -330,11 +382,10 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
         }
         break;
       case xenos::PrimitiveType::kQuadList:
+      case xenos::PrimitiveType::kQuadStrip:
+        // Strips haven't been seen in games so far.
+        host_primitive_type = xenos::PrimitiveType::kQuadList;
         switch (tessellation_mode) {
-          // Also supported by quad strips according to:
-          // https://www.khronos.org/registry/OpenGL/extensions/AMD/AMD_vertex_shader_tessellator.txt
-          // Would need to convert those to quad lists, but haven't seen any
-          // games using tessellated strips so far.
           case xenos::TessellationMode::kDiscrete:
             // Not seen in games so far.
             host_vertex_shader_type =
@@ -566,6 +617,47 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
           cacheable.host_index_buffer_handle =
               builtin_ib_offset_quad_lists_to_triangle_lists_;
           break;
+        case xenos::PrimitiveType::kTriangleStrip:
+        case xenos::PrimitiveType::kQuadStrip: {
+          // Tessellated patch strips. The indices only depend on the vertex
+          // count, so they're simply generated for the current frame.
+          assert_true(tessellation_enabled);
+          bool is_triangle_strip =
+              guest_primitive_type == xenos::PrimitiveType::kTriangleStrip;
+          cacheable.host_draw_vertex_count =
+              is_triangle_strip
+                  ? GetTriangleStripListIndexCount(guest_draw_vertex_count)
+                  : GetQuadStripListIndexCount(guest_draw_vertex_count);
+          if (!cacheable.host_draw_vertex_count) {
+            break;
+          }
+          cacheable.index_buffer_type =
+              ProcessedIndexBufferType::kHostConverted;
+          auto host_indices = reinterpret_cast<uint16_t*>(
+              RequestHostConvertedIndexBufferForCurrentFrame(
+                  xenos::IndexFormat::kInt16, cacheable.host_draw_vertex_count,
+                  false, 0, cacheable.host_index_buffer_handle));
+          if (!host_indices) {
+            return false;
+          }
+          if (auto_index_sequence_.size() < guest_draw_vertex_count) {
+            size_t sequence_old_size = auto_index_sequence_.size();
+            auto_index_sequence_.resize(guest_draw_vertex_count);
+            for (size_t i = sequence_old_size; i < guest_draw_vertex_count;
+                 ++i) {
+              auto_index_sequence_[i] = uint16_t(i);
+            }
+          }
+          if (is_triangle_strip) {
+            TriangleStripToList(host_indices, auto_index_sequence_.data(),
+                                guest_draw_vertex_count,
+                                PassthroughIndexTransform());
+          } else {
+            QuadStripToList(host_indices, auto_index_sequence_.data(),
+                            guest_draw_vertex_count,
+                            PassthroughIndexTransform());
+          }
+        } break;
         default:
           assert_always();
           return false;
@@ -673,7 +765,42 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
         guest_index_format == xenos::IndexFormat::kInt16
             ? UINT16_MAX
             : GpuSwap(xenos::kVertexIndexMask, guest_index_endian);
-    if (host_primitive_type != guest_primitive_type) {
+    if (host_primitive_type != guest_primitive_type &&
+        host_vertex_shader_type == Shader::HostVertexShaderType::kVertex &&
+        !guest_primitive_reset_enabled &&
+        (guest_primitive_type == xenos::PrimitiveType::kTriangleFan ||
+         guest_primitive_type == xenos::PrimitiveType::kQuadList) &&
+        cvars::primitive_processor_gpu_conversion_min_indices >= 0 &&
+        guest_draw_vertex_count >=
+            uint32_t(cvars::primitive_processor_gpu_conversion_min_indices)) {
+      // A single primitive (or a list) - no need to look at the indices on
+      // the CPU. Remap the host vertices to guest index buffer elements with
+      // the same built-in index buffer as for auto-indexed draws, and load the
+      // guest indices from the shared memory in the vertex shader, where the
+      // endian swap and the masking are also done.
+      cacheable.index_buffer_type =
+          ProcessedIndexBufferType::kHostBuiltinForDMA;
+      cacheable.host_index_format = xenos::IndexFormat::kInt16;
+      cacheable.host_primitive_reset_enabled = false;
+      if (guest_primitive_type == xenos::PrimitiveType::kTriangleFan) {
+        assert_true(host_primitive_type ==
+                    xenos::PrimitiveType::kTriangleList);
+        cacheable.host_draw_vertex_count =
+            GetTriangleFanListIndexCount(guest_draw_vertex_count);
+        assert_true(builtin_ib_offset_triangle_fans_to_lists_ != SIZE_MAX);
+        cacheable.host_index_buffer_handle =
+            builtin_ib_offset_triangle_fans_to_lists_;
+      } else {
+        assert_true(host_primitive_type ==
+                    xenos::PrimitiveType::kTriangleList);
+        cacheable.host_draw_vertex_count =
+            GetQuadListTriangleListIndexCount(guest_draw_vertex_count);
+        assert_true(builtin_ib_offset_quad_lists_to_triangle_lists_ !=
+                    SIZE_MAX);
+        cacheable.host_index_buffer_handle =
+            builtin_ib_offset_quad_lists_to_triangle_lists_;
+      }
+    } else if (host_primitive_type != guest_primitive_type) {
       // Already converting to a different index type - primitive reset is
       // performed during conversion here. Also doing the endian swap here for
       // hosts not supporting 32-bit indices because indirection is only used
@@ -704,6 +831,12 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
           case xenos::PrimitiveType::kQuadList:
             host_index_count_getter = GetQuadListTriangleListIndexCount;
             break;
+          case xenos::PrimitiveType::kTriangleStrip:
+            host_index_count_getter = GetTriangleStripListIndexCount;
+            break;
+          case xenos::PrimitiveType::kQuadStrip:
+            host_index_count_getter = GetQuadStripListIndexCount;
+            break;
           default:
             assert_unhandled_case(guest_primitive_type);
             return false;
@@ -735,7 +868,7 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
                 0, guest_draw_vertex_count, cacheable.host_draw_vertex_count);
           }
           auto host_indices = reinterpret_cast<uint16_t*>(
-              RequestHostConvertedIndexBufferForCurrentFrame(
+              cache_transaction.RequestHostConvertedIndexBuffer(
                   xenos::IndexFormat::kInt16, cacheable.host_draw_vertex_count,
                   false, guest_index_base, cacheable.host_index_buffer_handle));
           if (!host_indices) {
@@ -769,7 +902,7 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
                 0, guest_draw_vertex_count, cacheable.host_draw_vertex_count);
           }
           auto host_indices = reinterpret_cast<uint32_t*>(
-              RequestHostConvertedIndexBufferForCurrentFrame(
+              cache_transaction.RequestHostConvertedIndexBuffer(
                   xenos::IndexFormat::kInt32, cacheable.host_draw_vertex_count,
                   false, guest_index_base, cacheable.host_index_buffer_handle));
           if (!host_indices) {
@@ -868,7 +1001,7 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
                                                   ? xenos::IndexFormat::kInt32
                                                   : xenos::IndexFormat::kInt16;
                 void* host_indices_ptr =
-                    RequestHostConvertedIndexBufferForCurrentFrame(
+                    cache_transaction.RequestHostConvertedIndexBuffer(
                         cacheable.host_index_format, guest_draw_vertex_count,
                         true, guest_index_base,
                         cacheable.host_index_buffer_handle);
@@ -920,7 +1053,7 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
               cacheable.index_buffer_type =
                   ProcessedIndexBufferType::kHostConverted;
               auto host_indices = reinterpret_cast<uint32_t*>(
-                  RequestHostConvertedIndexBufferForCurrentFrame(
+                  cache_transaction.RequestHostConvertedIndexBuffer(
                       xenos::IndexFormat::kInt32, guest_draw_vertex_count, true,
                       guest_index_base, cacheable.host_index_buffer_handle));
               if (!host_indices) {
@@ -962,6 +1095,12 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
     }
   }
 
+  if (cacheable.index_buffer_type == ProcessedIndexBufferType::kHostConverted &&
+      cacheable.host_index_buffer_handle == SIZE_MAX) {
+    // Failed to copy the indices converted in a previous frame.
+    return false;
+  }
+
   // Request the indices in the shared memory if they need to be accessed from
   // there on the GPU.
   if (cacheable.index_buffer_type == ProcessedIndexBufferType::kGuestDMA ||
@@ -1431,9 +1570,37 @@ PrimitiveProcessor::CacheTransaction::CacheTransaction(
     auto global_lock = processor_.global_critical_region_.Acquire();
     auto cache_map_it = processor_.cache_map_.find(key_);
     if (cache_map_it != processor_.cache_map_.end()) {
-      result_ = processor_.cache_entry_pool_[cache_map_it->second].result;
+      CachedResult& entry_result =
+          processor_.cache_entry_pool_[cache_map_it->second].result;
+      if (entry_result.index_buffer_type ==
+              ProcessedIndexBufferType::kHostConverted &&
+          entry_result.host_index_buffer_handle == SIZE_MAX) {
+        // Converted in a previous frame - copy the indices to a buffer for this
+        // frame. Doing this within the global critical region as the copy may
+        // be dropped by the invalidation callback otherwise.
+        auto converted_data_it = processor_.cache_converted_data_.find(key_);
+        if (converted_data_it != processor_.cache_converted_data_.end()) {
+          const CacheConvertedData& converted_data = converted_data_it->second;
+          void* mapping =
+              processor_.RequestHostConvertedIndexBufferForCurrentFrame(
+                  entry_result.host_index_format,
+                  entry_result.host_draw_vertex_count, false, key_.base,
+                  entry_result.host_index_buffer_handle);
+          if (mapping) {
+            std::memcpy(mapping,
+                        converted_data.data.data() + converted_data.offset,
+                        converted_data.size);
+            ++processor_.cache_frame_copies_from_previous_frames_;
+          } else {
+            entry_result.host_index_buffer_handle = SIZE_MAX;
+          }
+        }
+      }
+      result_ = entry_result;
       result_type_ = ResultType::kExisting;
+      ++processor_.cache_frame_hits_;
     } else {
+      ++processor_.cache_frame_misses_;
       // Inhibit writing the new result if the range happens to be modified
       // during the processing outside the lock.
       processor_.cache_currently_processing_base_ = key_.base;
@@ -1464,8 +1631,13 @@ PrimitiveProcessor::CacheTransaction::~CacheTransaction() {
 
   processor_.cache_currently_processing_base_ = 0;
   processor_.cache_currently_processing_size_bytes_ = 0;
+  bool invalidated = processor_.cache_currently_processing_invalidated_;
+  processor_.cache_currently_processing_invalidated_ = false;
 
-  if (result_type_ == ResultType::kNewSet) {
+  // If the guest indices have been modified during processing, the access
+  // callback has already been triggered, and the entry would never be
+  // invalidated if it's kept across frames.
+  if (result_type_ == ResultType::kNewSet && !invalidated) {
     size_t new_entry_index;
     if (processor_.cache_bucket_free_first_entry_ != SIZE_MAX) {
       new_entry_index = processor_.cache_bucket_free_first_entry_;
@@ -1513,6 +1685,58 @@ PrimitiveProcessor::CacheTransaction::~CacheTransaction() {
     new_entry.result = result_;
 
     processor_.cache_map_.emplace(key_, new_entry_index);
+
+    if (!converted_data_.empty() &&
+        result_.index_buffer_type == ProcessedIndexBufferType::kHostConverted) {
+      CacheConvertedData& new_converted_data =
+          processor_.cache_converted_data_[key_];
+      new_converted_data.data = std::move(converted_data_);
+      new_converted_data.offset = converted_data_offset_;
+      new_converted_data.size = converted_data_size_;
+      processor_.cache_converted_data_bytes_ += converted_data_size_;
+    }
+  }
+}
+
+void* PrimitiveProcessor::CacheTransaction::RequestHostConvertedIndexBuffer(
+    xenos::IndexFormat format, uint32_t index_count, bool coalign_for_simd,
+    uint32_t coalignment_original_address, size_t& backend_handle_out) {
+  void* mapping = processor_.RequestHostConvertedIndexBufferForCurrentFrame(
+      format, index_count, coalign_for_simd, coalignment_original_address,
+      backend_handle_out);
+  if (!mapping || !key_.count ||
+      !cvars::primitive_processor_cache_across_frames_mb) {
+    return mapping;
+  }
+  // Converting to memory that is not write-combined, to copy from it later.
+  converted_data_size_ =
+      size_t(index_count) * (format == xenos::IndexFormat::kInt16
+                                 ? sizeof(uint16_t)
+                                 : sizeof(uint32_t));
+  converted_data_.resize(converted_data_size_ +
+                         (coalign_for_simd
+                              ? size_t(XE_GPU_PRIMITIVE_PROCESSOR_SIMD_SIZE)
+                              : size_t(0)));
+  converted_data_offset_ = 0;
+  if (coalign_for_simd) {
+    converted_data_offset_ = size_t(GetSimdCoalignmentOffset(
+        converted_data_.data(), coalignment_original_address));
+  }
+  converted_data_frame_mapping_ = mapping;
+  return converted_data_.data() + converted_data_offset_;
+}
+
+void PrimitiveProcessor::CacheTransaction::SetNewResult(
+    const CachedResult& new_result) {
+  // Replacement of an existing entry is not allowed.
+  assert_true(result_type_ != ResultType::kExisting);
+  result_ = new_result;
+  result_type_ = ResultType::kNewSet;
+  if (converted_data_frame_mapping_) {
+    std::memcpy(converted_data_frame_mapping_,
+                converted_data_.data() + converted_data_offset_,
+                converted_data_size_);
+    converted_data_frame_mapping_ = nullptr;
   }
 }
 
@@ -1541,6 +1765,14 @@ std::pair<uint32_t, uint32_t> PrimitiveProcessor::MemoryInvalidationCallback(
   uint32_t bucket_l2_bits_index_first = bucket_index_first >> 12;
   uint32_t bucket_l2_bits_index_last = bucket_index_last >> 12;
   auto global_lock = global_critical_region_.Acquire();
+  if (cache_currently_processing_size_bytes_ &&
+      cache_currently_processing_base_ < physical_address_end &&
+      cache_currently_processing_base_ +
+              cache_currently_processing_size_bytes_ >
+          physical_address_start) {
+    cache_currently_processing_invalidated_ = true;
+    any_invalidated = true;
+  }
   for (uint32_t bucket_l2_bits_index = bucket_l2_bits_index_first;
        bucket_l2_bits_index <= bucket_l2_bits_index_last;
        ++bucket_l2_bits_index) {
@@ -1610,7 +1842,7 @@ std::pair<uint32_t, uint32_t> PrimitiveProcessor::MemoryInvalidationCallback(
           // the specified range.
           if (entry_key.base < physical_address_end) {
             uint32_t entry_end = entry_key.base + entry_key.GetSizeBytes();
-            if (entry_end > physical_address_end) {
+            if (entry_end > physical_address_start) {
               // Invalidate the entry.
               any_invalidated = true;
               // Remove the entry from the cache map.
@@ -1658,6 +1890,11 @@ std::pair<uint32_t, uint32_t> PrimitiveProcessor::MemoryInvalidationCallback(
                       entry_bucket_index)] = entry_link_prev;
                 }
               }
+              auto converted_data_it = cache_converted_data_.find(entry_key);
+              if (converted_data_it != cache_converted_data_.end()) {
+                cache_converted_data_bytes_ -= converted_data_it->second.size;
+                cache_converted_data_.erase(converted_data_it);
+              }
               // Make the entry free for reuse.
               entry.free_next = cache_bucket_free_first_entry_;
               cache_bucket_free_first_entry_ = entry_index;
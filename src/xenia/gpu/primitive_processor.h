@@ -20,6 +20,7 @@
 #include <mutex>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "xenia/base/assert.h"
 #include "xenia/base/cvar.h"
@@ -272,7 +273,10 @@ class PrimitiveProcessor {
 
   // Call at boundaries of lifespans of converted data (between frames,
   // preferably in the end of a frame so between the swap and the next draw,
-  // access violation handlers need to do less work).
+  // access violation handlers need to do less work). Results kept across
+  // frames (with primitive_processor_cache_across_frames_mb) stay in the
+  // cache, but their converted indices will be copied to a new buffer for the
+  // next frame when they're used again.
   void ClearPerFrameCache();
 
   static constexpr size_t GetBuiltinIndexBufferOffsetBytes(size_t handle) {
@@ -623,6 +627,60 @@ class PrimitiveProcessor {
     }
   }
 
+  // Patch strips, only used with tessellation, where the host needs patch
+  // lists. Supported by the Xenos according to:
+  // https://www.khronos.org/registry/OpenGL/extensions/AMD/AMD_vertex_shader_tessellator.txt
+  // Triangle strips as triangle lists.
+  // Ordered as (v0, v1, v2), (v1, v3, v2) in Direct3D.
+  // https://docs.microsoft.com/en-us/windows/win32/direct3d9/triangle-strips
+  static constexpr uint32_t GetTriangleStripListIndexCount(
+      uint32_t strip_index_count) {
+    return strip_index_count > 2 ? (strip_index_count - 2) * 3 : 0;
+  }
+  template <typename Index, typename IndexTransform>
+  static void TriangleStripToList(Index* dest, const Index* source,
+                                  uint32_t source_index_count,
+                                  const IndexTransform& index_transform) {
+    if (source_index_count <= 2) {
+      // To match GetTriangleStripListIndexCount.
+      return;
+    }
+    Index index_previous_2 = index_transform(source[0]);
+    Index index_previous_1 = index_transform(source[1]);
+    for (uint32_t i = 2; i < source_index_count; ++i) {
+      Index index_current = index_transform(source[i]);
+      *(dest++) = index_previous_2;
+      if (i & 1) {
+        *(dest++) = index_current;
+        *(dest++) = index_previous_1;
+      } else {
+        *(dest++) = index_previous_1;
+        *(dest++) = index_current;
+      }
+      index_previous_2 = index_previous_1;
+      index_previous_1 = index_current;
+    }
+  }
+  // Quad strips as quad lists, every quad made of the vertices (v0, v1, v3,
+  // v2) of the strip like in OpenGL.
+  static constexpr uint32_t GetQuadStripListIndexCount(
+      uint32_t strip_index_count) {
+    return strip_index_count >= 4 ? ((strip_index_count - 2) >> 1) * 4 : 0;
+  }
+  template <typename Index, typename IndexTransform>
+  static void QuadStripToList(Index* dest, const Index* source,
+                              uint32_t source_index_count,
+                              const IndexTransform& index_transform) {
+    uint32_t quad_count = GetQuadStripListIndexCount(source_index_count) / 4;
+    for (uint32_t i = 0; i < quad_count; ++i) {
+      *(dest++) = index_transform(source[0]);
+      *(dest++) = index_transform(source[1]);
+      *(dest++) = index_transform(source[3]);
+      *(dest++) = index_transform(source[2]);
+      source += 2;
+    }
+  }
+
   // Pre-gathering the ranges allows for usage of the same functions for
   // conversion with and without reset. In addition, this increases safety in
   // weird cases - there won't be mismatch between the pre-calculation of the
@@ -685,6 +743,22 @@ class PrimitiveProcessor {
           dest_write_ptr += range_it->host_index_count;
         }
         break;
+      case xenos::PrimitiveType::kTriangleStrip:
+        for (PrimitiveRangeIterator range_it = ranges_beginning;
+             range_it != ranges_end; ++range_it) {
+          TriangleStripToList(dest_write_ptr, source + range_it->guest_offset,
+                              range_it->guest_index_count, index_transform);
+          dest_write_ptr += range_it->host_index_count;
+        }
+        break;
+      case xenos::PrimitiveType::kQuadStrip:
+        for (PrimitiveRangeIterator range_it = ranges_beginning;
+             range_it != ranges_end; ++range_it) {
+          QuadStripToList(dest_write_ptr, source + range_it->guest_offset,
+                          range_it->guest_index_count, index_transform);
+          dest_write_ptr += range_it->host_index_count;
+        }
+        break;
       default:
         assert_unhandled_case(source_primitive_type);
     }
@@ -708,6 +782,8 @@ class PrimitiveProcessor {
   size_t builtin_ib_offset_quad_lists_to_triangle_lists_ = SIZE_MAX;
 
   std::deque<SinglePrimitiveRange> single_primitive_ranges_;
+  // 0, 1, 2... for converting auto-indexed patch strips.
+  std::vector<uint16_t> auto_index_sequence_;
 
   // Caching for reuse of converted indices within a frame.
 
@@ -767,7 +843,9 @@ class PrimitiveProcessor {
 
   // Subset of ConversionResult that can be reused for different primitive types
   // if the same result is used irrespective of one (like when only processing
-  // the reset index).
+  // the reset index). For kHostConverted results from previous frames,
+  // host_index_buffer_handle is SIZE_MAX until they're copied to a buffer for
+  // the current frame.
   struct CachedResult {
     uint32_t host_draw_vertex_count;
     ProcessedIndexBufferType index_buffer_type;
@@ -831,12 +909,17 @@ class PrimitiveProcessor {
     const CachedResult* GetFoundResult() const {
       return result_type_ == ResultType::kExisting ? &result_ : nullptr;
     }
-    void SetNewResult(const CachedResult& new_result) {
-      // Replacement of an existing entry is not allowed.
-      assert_true(result_type_ != ResultType::kExisting);
-      result_ = new_result;
-      result_type_ = ResultType::kNewSet;
-    }
+    // Requests the buffer to write the indices of the new result to, via
+    // RequestHostConvertedIndexBufferForCurrentFrame. If the result may be
+    // kept across frames, the indices are written to a copy owned by the
+    // cache instead, and are copied to the buffer for the current frame in
+    // SetNewResult.
+    void* RequestHostConvertedIndexBuffer(xenos::IndexFormat format,
+                                          uint32_t index_count,
+                                          bool coalign_for_simd,
+                                          uint32_t coalignment_original_address,
+                                          size_t& backend_handle_out);
+    void SetNewResult(const CachedResult& new_result);
     ~CacheTransaction();
 
    private:
@@ -847,6 +930,12 @@ class PrimitiveProcessor {
     // vertex count below the cache usage threshold.
     CacheKey key_;
     CachedResult result_;
+    // The copy of the converted indices to keep across frames, and the buffer
+    // for the current frame to copy it to.
+    std::vector<uint8_t> converted_data_;
+    size_t converted_data_offset_ = 0;
+    size_t converted_data_size_ = 0;
+    void* converted_data_frame_mapping_ = nullptr;
     enum class ResultType {
       kNewUnset,
       kNewSet,
@@ -857,6 +946,25 @@ class PrimitiveProcessor {
 
   std::deque<CacheEntry> cache_entry_pool_;
 
+  // Copies of the indices of kHostConverted results kept across frames,
+  // coaligned like in the buffers for the frames. Modified by both the
+  // processor and the invalidation callback.
+  struct CacheConvertedData {
+    std::vector<uint8_t> data;
+    size_t offset;
+    size_t size;
+  };
+  std::unordered_map<CacheKey, CacheConvertedData, CacheKey::Hasher>
+      cache_converted_data_;
+  size_t cache_converted_data_bytes_ = 0;
+  // Modified only by the processor.
+  uint32_t cache_frame_hits_ = 0;
+  uint32_t cache_frame_misses_ = 0;
+  uint32_t cache_frame_copies_from_previous_frames_ = 0;
+  // Must be called in a global critical region.
+  void ClearCacheEntries(
+      [[maybe_unused]] const global_unique_lock_type& global_lock);
+
   void* memory_invalidation_callback_handle_ = nullptr;
 
   xe::global_critical_region global_critical_region_;
@@ -871,6 +979,9 @@ class PrimitiveProcessor {
   // 0 if not in a cache transaction that hasn't found an existing entry
   // currently.
   uint32_t cache_currently_processing_size_bytes_ = 0;
+  // Whether the range currently being processed has been invalidated.
+  // Modified by both the processor and the invalidation callback.
+  bool cache_currently_processing_invalidated_ = false;
   // Modified by both the processor and the invalidation callback.
   size_t cache_bucket_free_first_entry_ = SIZE_MAX;
   // Modified by both the processor and the invalidation callback.
@@ -40,6 +40,43 @@ class RegisterFile {
   static constexpr size_t kRegisterCount = 0x5003;
   uint32_t values[kRegisterCount];
 
+  // Registers are grouped into blocks for tracking of writes, so host state
+  // derived from registers, such as the viewport and the scissor, doesn't
+  // need to be recomputed on every draw if the registers it depends on haven't
+  // been written. Every block has the write stamp that was current when a
+  // register in it was last written - writes to values not done through the
+  // command processor's register writing functions must be marked explicitly.
+  static constexpr uint32_t kWriteBlockSizeLog2 = 6;
+  static constexpr size_t kWriteBlockCount =
+      (kRegisterCount + (size_t(1) << kWriteBlockSizeLog2) - 1) >>
+      kWriteBlockSizeLog2;
+
+  void MarkWritten(uint32_t reg) {
+    write_block_stamps_[reg >> kWriteBlockSizeLog2] = write_stamp_;
+  }
+  void MarkRangeWritten(uint32_t first_reg, uint32_t count) {
+    if (!count) {
+      return;
+    }
+    uint32_t block_last = (first_reg + count - 1) >> kWriteBlockSizeLog2;
+    for (uint32_t i = first_reg >> kWriteBlockSizeLog2; i <= block_last; ++i) {
+      write_block_stamps_[i] = write_stamp_;
+    }
+  }
+  void MarkAllWritten() {
+    for (size_t i = 0; i < kWriteBlockCount; ++i) {
+      write_block_stamps_[i] = write_stamp_;
+    }
+  }
+  // Returns the stamp to pass to WrittenSince later to check if the registers
+  // have been written after this call.
+  uint64_t AdvanceWriteStamp() { return write_stamp_++; }
+  // Stamp 0 is older than the initial state, so the derived state is computed
+  // on the first check.
+  bool WrittenSince(uint32_t reg, uint64_t stamp) const {
+    return write_block_stamps_[reg >> kWriteBlockSizeLog2] > stamp;
+  }
+
   const uint32_t& operator[](uint32_t reg) const { return values[reg]; }
   uint32_t& operator[](uint32_t reg) { return values[reg]; }
 
@@ -86,6 +123,10 @@ class RegisterFile {
         sizeof(stream));
     return stream;
   }
+
+ private:
+  uint64_t write_stamp_ = 1;
+  uint64_t write_block_stamps_[kWriteBlockCount];
 };
 
 }  // namespace gpu
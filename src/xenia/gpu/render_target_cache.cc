@@ -21,6 +21,7 @@
 #include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
+#include "xenia/base/profiling.h"
 #include "xenia/gpu/draw_util.h"
 #include "xenia/gpu/register_file.h"
 #include "xenia/gpu/registers.h"
@@ -39,6 +40,16 @@ DEFINE_bool(
     "reduce bandwidth usage during transfers as the previous depth won't need "
     "to be read.",
     "GPU");
+DEFINE_bool(
+    host_depth_store_elide_after_clear, true,
+    "When the host depth buffer format differs from the guest one, don't "
+    "store the host depth of a depth render target to the EDRAM buffer for "
+    "restoring its precision during an ownership transfer back to it if it "
+    "has only been written by resolve clears in the transferred range - the "
+    "guest values are exact in this case. The stores done and skipped are "
+    "reported as the gpu/render_target_cache/host_depth_stores and "
+    "gpu/render_target_cache/host_depth_stores_elided profiler counters.",
+    "GPU");
 // Lossless round trip: 545407F2.
 // Lossy round trip with the "greater or equal" test afterwards: 4D530919.
 // Lossy round trip with the "equal" test afterwards: 535107F5, 565507EF.
@@ -527,6 +538,8 @@ void RenderTargetCache::DestroyAllRenderTargets(bool shutting_down) {
     }
   }
   render_targets_.clear();
+  render_targets_memory_usage_estimate_ = 0;
+  ReportRenderTargetStatistics();
 }
 
 void RenderTargetCache::ShutdownCommon() { DestroyAllRenderTargets(true); }
@@ -561,15 +574,44 @@ void RenderTargetCache::ClearCache() {
         }
         if (used_render_targets.find(it->second->key()) ==
             used_render_targets.end()) {
+          render_targets_memory_usage_estimate_ -=
+              GetRenderTargetMemoryUsageEstimate(it->second->key());
           delete it->second;
           render_targets_.erase(it);
         }
       }
     }
+    ReportRenderTargetStatistics();
   }
 }
 
-void RenderTargetCache::BeginFrame() { ResetAccumulatedRenderTargets(); }
+void RenderTargetCache::BeginFrame() {
+  ResetAccumulatedRenderTargets();
+
+  COUNT_profile_set("gpu/render_target_cache/transfers", frame_transfers_);
+  COUNT_profile_set("gpu/render_target_cache/transfer_tiles",
+                    frame_transfer_tiles_);
+  COUNT_profile_set("gpu/render_target_cache/transfers_elided",
+                    frame_transfers_elided_);
+  COUNT_profile_set("gpu/render_target_cache/transfer_tiles_elided",
+                    frame_transfer_tiles_elided_);
+  COUNT_profile_set("gpu/render_target_cache/transfer_passes",
+                    frame_transfer_passes_);
+  COUNT_profile_set("gpu/render_target_cache/transfer_rectangles",
+                    frame_transfer_rectangles_);
+  COUNT_profile_set("gpu/render_target_cache/host_depth_stores",
+                    frame_host_depth_stores_);
+  COUNT_profile_set("gpu/render_target_cache/host_depth_stores_elided",
+                    frame_host_depth_stores_elided_);
+  frame_transfers_ = 0;
+  frame_transfer_tiles_ = 0;
+  frame_transfers_elided_ = 0;
+  frame_transfer_tiles_elided_ = 0;
+  frame_transfer_passes_ = 0;
+  frame_transfer_rectangles_ = 0;
+  frame_host_depth_stores_ = 0;
+  frame_host_depth_stores_elided_ = 0;
+}
 
 bool RenderTargetCache::Update(bool is_rasterization_done,
                                reg::RB_DEPTHCONTROL normalized_depth_control,
@@ -1465,10 +1507,33 @@ RenderTargetCache::RenderTarget* RenderTargetCache::GetOrCreateRenderTarget(
     }
     // Insert even if failed to create, not to try to create again.
     render_targets_.emplace(key, render_target);
+    if (render_target) {
+      render_targets_memory_usage_estimate_ +=
+          GetRenderTargetMemoryUsageEstimate(key);
+      ReportRenderTargetStatistics();
+    }
   }
   return render_target;
 }
 
+uint64_t RenderTargetCache::GetRenderTargetMemoryUsageEstimate(
+    RenderTargetKey key) const {
+  return uint64_t(key.GetWidth()) *
+         GetRenderTargetHeight(key.pitch_tiles_at_32bpp, key.msaa_samples) *
+         draw_resolution_scale_x() * draw_resolution_scale_y() *
+         (uint32_t(1) << uint32_t(key.msaa_samples)) *
+         (key.Is64bpp() ? sizeof(uint64_t) : sizeof(uint32_t));
+}
+
+void RenderTargetCache::ReportRenderTargetStatistics() const {
+  // With draw_resolution_scale_x/y, this is the main cost of resolution scaling
+  // along with the scaled resolve memory of the texture cache.
+  COUNT_profile_set("gpu/render_target_cache/render_targets",
+                    render_targets_.size());
+  COUNT_profile_set("gpu/render_target_cache/render_targets_mb",
+                    render_targets_memory_usage_estimate_ >> 20);
+}
+
 bool RenderTargetCache::WouldOwnershipChangeRequireTransfers(
     RenderTargetKey dest, uint32_t start_tiles_base_relative,
     uint32_t length_tiles) const {
@@ -1553,6 +1618,14 @@ void RenderTargetCache::ChangeOwnership(
   bool host_depth_encoding_different =
       dest.is_depth && GetPath() == Path::kHostRenderTargets &&
       IsHostDepthEncodingDifferent(dest.GetDepthFormat());
+  // Whether the part of the range within the extent will be fully overwritten
+  // by the resolve clear.
+  auto is_range_cleared = [&](uint32_t range_start, uint32_t range_end) {
+    return resolve_clear_cutout &&
+           !Transfer::GetRangeRectangles(
+               range_start, range_end, dest.base_tiles, dest_pitch_tiles,
+               dest.msaa_samples, dest_is_64bpp, nullptr, resolve_clear_cutout);
+  };
   auto change_ownership_in_extent = [&](uint32_t extent_start,
                                         uint32_t extent_end) {
     // The map contains consecutive ranges, merged if the adjacent ones are the
@@ -1581,6 +1654,18 @@ void RenderTargetCache::ChangeOwnership(
       if (it->second.IsOwnedBy(dest, host_depth_encoding_different)) {
         // Already owned by the needed render target - no need to transfer
         // anything.
+        if (host_depth_encoding_different) {
+          bool& host_depth_cleared =
+              it->second.IsHostDepthCleared(dest.GetDepthFormat());
+          if (!resolve_clear_cutout) {
+            // May be drawn to with the host precision now.
+            host_depth_cleared = false;
+          } else if (cvars::host_depth_store_elide_after_clear &&
+                     it->second.end_tiles <= extent_end &&
+                     is_range_cleared(it->first, it->second.end_tiles)) {
+            host_depth_cleared = true;
+          }
+        }
         ++it;
         continue;
       }
@@ -1599,11 +1684,11 @@ void RenderTargetCache::ChangeOwnership(
         if (!transfer_source.IsEmpty() && transfer_source != dest) {
           uint32_t transfer_end_tiles =
               std::min(it->second.end_tiles, extent_end);
-          if (!resolve_clear_cutout ||
-              Transfer::GetRangeRectangles(it->first, transfer_end_tiles,
-                                           dest.base_tiles, dest_pitch_tiles,
-                                           dest.msaa_samples, dest_is_64bpp,
-                                           nullptr, resolve_clear_cutout)) {
+          if (is_range_cleared(it->first, transfer_end_tiles)) {
+            // Fully overwritten by the clear, no need to copy.
+            ++frame_transfers_elided_;
+            frame_transfer_tiles_elided_ += transfer_end_tiles - it->first;
+          } else {
             RenderTargetKey transfer_host_depth_source =
                 host_depth_encoding_different
                     ? it->second.GetHostDepthRenderTarget(dest.GetDepthFormat())
@@ -1612,6 +1697,15 @@ void RenderTargetCache::ChangeOwnership(
               // Same render target, don't provide a separate host depth source.
               transfer_host_depth_source = RenderTargetKey();
             }
+            if (!transfer_host_depth_source.IsEmpty() &&
+                it->second.IsHostDepthCleared(dest.GetDepthFormat())) {
+              // Only cleared values in the host depth, the guest values will
+              // be converted to the same ones.
+              if (transfer_host_depth_source == dest) {
+                ++frame_host_depth_stores_elided_;
+              }
+              transfer_host_depth_source = RenderTargetKey();
+            }
             if (!transfers_append_out->empty() &&
                 transfers_append_out->back().end_tiles == it->first &&
                 transfers_append_out->back().source->key() == transfer_source &&
@@ -1623,6 +1717,7 @@ void RenderTargetCache::ChangeOwnership(
               // Extend the last transfer if, for example, transferring color,
               // but host depth is different.
               transfers_append_out->back().end_tiles = transfer_end_tiles;
+              frame_transfer_tiles_ += transfer_end_tiles - it->first;
             } else {
               auto transfer_source_rt_it =
                   render_targets_.find(transfer_source);
@@ -1643,6 +1738,11 @@ void RenderTargetCache::ChangeOwnership(
                       transfer_host_depth_source_rt_it != render_targets_.end()
                           ? transfer_host_depth_source_rt_it->second
                           : nullptr);
+                  ++frame_transfers_;
+                  frame_transfer_tiles_ += transfer_end_tiles - it->first;
+                  if (transfer_host_depth_source == dest) {
+                    ++frame_host_depth_stores_;
+                  }
                 }
               }
             }
@@ -1653,6 +1753,9 @@ void RenderTargetCache::ChangeOwnership(
       it->second.render_target = dest;
       if (host_depth_encoding_different) {
         it->second.GetHostDepthRenderTarget(dest.GetDepthFormat()) = dest;
+        it->second.IsHostDepthCleared(dest.GetDepthFormat()) =
+            cvars::host_depth_store_elide_after_clear &&
+            is_range_cleared(it->first, it->second.end_tiles);
       }
       // Check if can merge with the next range after claiming.
       std::map<uint32_t, OwnershipRange>::iterator it_next;
@@ -557,6 +557,12 @@ class RenderTargetCache {
     assert_true(GetPath() == Path::kHostRenderTargets);
     return last_update_transfers_;
   }
+  // For the per-frame statistics, to be called by the implementation when
+  // issuing draws or dispatches performing ownership transfers.
+  void CountTransferPasses(uint32_t pass_count, uint32_t rectangle_count) {
+    frame_transfer_passes_ += pass_count;
+    frame_transfer_rectangles_ += rectangle_count;
+  }
 
   HostDepthStoreRenderTargetConstant GetHostDepthStoreRenderTargetConstant(
       uint32_t pitch_tiles, bool msaa_2x_supported) const {
@@ -650,6 +656,14 @@ class RenderTargetCache {
     // empty too.
     RenderTargetKey host_depth_render_target_unorm24;
     RenderTargetKey host_depth_render_target_float24;
+    // With host_depth_store_elide_after_clear, whether the respective host
+    // depth render target has only been written by resolve clears in this
+    // range since it has become the host depth render target. Such values are
+    // exactly representable in the guest format, so the host depth doesn't
+    // need to be stored and compared during ownership transfers back to it -
+    // converting the guest value gives the same result.
+    bool host_depth_unorm24_cleared = false;
+    bool host_depth_float24_cleared = false;
     OwnershipRange(uint32_t end_tiles, RenderTargetKey render_target,
                    RenderTargetKey host_depth_render_target_unorm24,
                    RenderTargetKey host_depth_render_target_float24)
@@ -673,6 +687,11 @@ class RenderTargetCache {
           const_cast<const OwnershipRange*>(this)->GetHostDepthRenderTarget(
               resource_format));
     }
+    bool& IsHostDepthCleared(xenos::DepthRenderTargetFormat resource_format) {
+      return resource_format == xenos::DepthRenderTargetFormat::kD24S8
+                 ? host_depth_unorm24_cleared
+                 : host_depth_float24_cleared;
+    }
     bool IsOwnedBy(RenderTargetKey key,
                    bool host_depth_encoding_different) const {
       if (render_target != key) {
@@ -693,7 +712,11 @@ class RenderTargetCache {
              host_depth_render_target_unorm24 ==
                  other_range.host_depth_render_target_unorm24 &&
              host_depth_render_target_float24 ==
-                 other_range.host_depth_render_target_float24;
+                 other_range.host_depth_render_target_float24 &&
+             host_depth_unorm24_cleared ==
+                 other_range.host_depth_unorm24_cleared &&
+             host_depth_float24_cleared ==
+                 other_range.host_depth_float24_cleared;
     }
   };
 
@@ -725,10 +748,18 @@ class RenderTargetCache {
       uint32_t length_tiles, std::vector<Transfer>* transfers_append_out,
       const Transfer::Rectangle* resolve_clear_cutout = nullptr);
 
+  // Approximate host memory usage of a render target with the key, for
+  // statistics, as the host may use different formats and padding.
+  uint64_t GetRenderTargetMemoryUsageEstimate(RenderTargetKey key) const;
+  void ReportRenderTargetStatistics() const;
+
   // If failed to create, may contain nullptr to prevent attempting to create a
   // render target twice.
   std::unordered_map<RenderTargetKey, RenderTarget*, RenderTargetKey::Hasher>
       render_targets_;
+  // Sum of GetRenderTargetMemoryUsageEstimate of all the existing render
+  // targets.
+  uint64_t render_targets_memory_usage_estimate_ = 0;
 
   // Map of host render targets currently containing the most up-to-date version
   // of the tile. Has no gaps, unused parts are represented by empty render
@@ -769,6 +800,22 @@ class RenderTargetCache {
   // consecutive in the array.
   std::vector<Transfer>
       last_update_transfers_[1 + xenos::kMaxColorRenderTargets];
+
+  // Ownership transfer statistics for the current frame, reported and reset in
+  // BeginFrame.
+  uint32_t frame_transfers_ = 0;
+  uint32_t frame_transfer_tiles_ = 0;
+  // Transfers not needed because the range will be cleared by a resolve.
+  uint32_t frame_transfers_elided_ = 0;
+  uint32_t frame_transfer_tiles_elided_ = 0;
+  // Draws and dispatches done by the implementation, and rectangles in them.
+  uint32_t frame_transfer_passes_ = 0;
+  uint32_t frame_transfer_rectangles_ = 0;
+  // Transfers for which the host depth of the destination needs to be stored
+  // to the EDRAM buffer, and ones for which this is not needed with
+  // host_depth_store_elide_after_clear.
+  uint32_t frame_host_depth_stores_ = 0;
+  uint32_t frame_host_depth_stores_elided_ = 0;
 };
 
 }  // namespace gpu
@@ -0,0 +1,137 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/render_target_path_tuning.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+
+DEFINE_bool(
+    render_target_path_auto_tune, false,
+    "Choose between the host render targets and the pixel shader interlock "
+    "(ROV / FSI) render target paths automatically for every title and host "
+    "GPU model. In the first launches of a title, each path is measured with "
+    "GPU timestamps over the same frames after the launch, and the faster one "
+    "is used afterwards. Overrides render_target_path_d3d12 and "
+    "render_target_path_vulkan once the title is launched.",
+    "GPU");
+DEFINE_uint32(render_target_path_auto_tune_warmup_frames, 600,
+              "Frames skipped after the launch of the title before measuring "
+              "the render target path with render_target_path_auto_tune.",
+              "GPU");
+DEFINE_uint32(render_target_path_auto_tune_frames, 1200,
+              "Frames measured for every render target path with "
+              "render_target_path_auto_tune.",
+              "GPU");
+
+namespace xe {
+namespace gpu {
+
+bool RenderTargetPathTuning::IsEnabled() {
+  return cvars::render_target_path_auto_tune;
+}
+
+uint32_t RenderTargetPathTuning::GetWarmupFrameCount() {
+  return cvars::render_target_path_auto_tune_warmup_frames;
+}
+
+uint32_t RenderTargetPathTuning::GetMeasuredFrameCount() {
+  return std::max(cvars::render_target_path_auto_tune_frames, uint32_t(1));
+}
+
+RenderTargetPathTuning::RenderTargetPathTuning(
+    const std::filesystem::path& cache_root, uint32_t title_id,
+    const std::string& gpu_model)
+    : file_path_(cache_root / "render_target_paths.txt"),
+      title_id_(title_id),
+      gpu_model_(gpu_model) {
+  // Every line is:
+  // title_id gpu_model path frame_time_ns
+  FILE* file = xe::filesystem::OpenFile(file_path_, "r");
+  if (!file) {
+    return;
+  }
+  uint32_t line_title_id;
+  char line_gpu_model[64];
+  char line_path[8];
+  uint64_t line_frame_time_ns;
+  while (std::fscanf(file, "%" SCNx32 " %63s %7s %" SCNu64, &line_title_id,
+                     line_gpu_model, line_path, &line_frame_time_ns) == 4) {
+    if (line_title_id != title_id_ || gpu_model_ != line_gpu_model ||
+        !line_frame_time_ns) {
+      continue;
+    }
+    for (RenderTargetCache::Path path :
+         {RenderTargetCache::Path::kHostRenderTargets,
+          RenderTargetCache::Path::kPixelShaderInterlock}) {
+      if (!std::strcmp(line_path, GetPathName(path))) {
+        frame_time_ns_[GetPathIndex(path)] = line_frame_time_ns;
+      }
+    }
+  }
+  std::fclose(file);
+}
+
+RenderTargetCache::Path RenderTargetPathTuning::ChoosePath(
+    RenderTargetCache::Path current_path) const {
+  RenderTargetCache::Path other_path =
+      current_path == RenderTargetCache::Path::kPixelShaderInterlock
+          ? RenderTargetCache::Path::kHostRenderTargets
+          : RenderTargetCache::Path::kPixelShaderInterlock;
+  if (!IsMeasured(current_path)) {
+    return current_path;
+  }
+  if (!IsMeasured(other_path)) {
+    return other_path;
+  }
+  return frame_time_ns_[GetPathIndex(other_path)] <
+                 frame_time_ns_[GetPathIndex(current_path)]
+             ? other_path
+             : current_path;
+}
+
+void RenderTargetPathTuning::StoreMeasurement(RenderTargetCache::Path path,
+                                              uint64_t frame_time_ns) {
+  frame_time_ns = std::max(frame_time_ns, uint64_t(1));
+  frame_time_ns_[GetPathIndex(path)] = frame_time_ns;
+  if (frame_time_ns == UINT64_MAX) {
+    XELOGI(
+        "Render target path auto-tuning: {} is not supported on GPU {} for "
+        "title {:08X}",
+        GetPathName(path), gpu_model_, title_id_);
+  } else {
+    XELOGI(
+        "Render target path auto-tuning: {} takes {:.3f} ms of GPU time per "
+        "frame on GPU {} for title {:08X}",
+        GetPathName(path), frame_time_ns * 0.000001, gpu_model_, title_id_);
+  }
+  FILE* file = xe::filesystem::OpenFile(file_path_, "a");
+  if (!file) {
+    XELOGE("Render target path auto-tuning: Failed to open {} for writing",
+           xe::path_to_utf8(file_path_));
+    return;
+  }
+  std::fprintf(file, "%08" PRIX32 " %s %s %" PRIu64 "\n", title_id_,
+               gpu_model_.c_str(), GetPathName(path), frame_time_ns);
+  std::fclose(file);
+}
+
+const char* RenderTargetPathTuning::GetPathName(RenderTargetCache::Path path) {
+  return path == RenderTargetCache::Path::kPixelShaderInterlock ? "psi"
+                                                                 : "rt";
+}
+
+}  // namespace gpu
+}  // namespace xe
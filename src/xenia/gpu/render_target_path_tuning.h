@@ -0,0 +1,75 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_RENDER_TARGET_PATH_TUNING_H_
+#define XENIA_GPU_RENDER_TARGET_PATH_TUNING_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#include "xenia/gpu/render_target_cache.h"
+
+namespace xe {
+namespace gpu {
+
+// Automatic selection between the host render targets and the pixel shader
+// interlock render target paths for every title and host GPU model, with
+// render_target_path_auto_tune. Which path is faster varies greatly between
+// titles and GPUs - pixel shader interlock needs no ownership transfers, but
+// lowers the pixel shader throughput.
+//
+// The path can only be changed by recreating the command processor, so each
+// path is measured in its own launch of the title, over the same range of guest
+// frames after the launch, using GPU timestamps. Once both paths have been
+// measured, the faster one is used in the later launches. The measurements are
+// appended to a text file in the cache root, the latest one for a path wins.
+class RenderTargetPathTuning {
+ public:
+  static bool IsEnabled();
+  // The number of frames skipped after the launch, and the number of frames
+  // measured after them.
+  static uint32_t GetWarmupFrameCount();
+  static uint32_t GetMeasuredFrameCount();
+
+  // Loads the measurements done so far for the title and the GPU model.
+  RenderTargetPathTuning(const std::filesystem::path& cache_root,
+                         uint32_t title_id, const std::string& gpu_model);
+
+  uint32_t title_id() const { return title_id_; }
+
+  bool IsMeasured(RenderTargetCache::Path path) const {
+    return frame_time_ns_[GetPathIndex(path)] != 0;
+  }
+  // Returns the path that still needs to be measured, preferring the current
+  // one, or the faster path if both have been measured.
+  RenderTargetCache::Path ChoosePath(
+      RenderTargetCache::Path current_path) const;
+  // Stores the average GPU time of a frame with the path, or UINT64_MAX if the
+  // path is not supported on the GPU.
+  void StoreMeasurement(RenderTargetCache::Path path, uint64_t frame_time_ns);
+
+  static const char* GetPathName(RenderTargetCache::Path path);
+
+ private:
+  static size_t GetPathIndex(RenderTargetCache::Path path) {
+    return path == RenderTargetCache::Path::kPixelShaderInterlock ? 1 : 0;
+  }
+
+  std::filesystem::path file_path_;
+  uint32_t title_id_;
+  std::string gpu_model_;
+  // 0 if not measured, UINT64_MAX if not supported.
+  uint64_t frame_time_ns_[2] = {};
+};
+
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_RENDER_TARGET_PATH_TUNING_H_
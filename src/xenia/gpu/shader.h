@@ -817,6 +817,21 @@ class Shader {
       host_disassembly_ = std::move(disassembly);
     }
 
+    // For loading a translation from a persistent storage instead of running
+    // the translator - marks the translation as successfully completed with
+    // the given binary.
+    void SetStoredTranslatedBinary(std::vector<uint8_t> binary) {
+      translated_binary_ = std::move(binary);
+      errors_.clear();
+      is_valid_ = true;
+      is_translated_ = true;
+    }
+
+    // For post-processing of the translated binary, such as optimization.
+    void ReplaceTranslatedBinary(std::vector<uint8_t> binary) {
+      translated_binary_ = std::move(binary);
+    }
+
     // For dumping after translation. Dumps the shader's translated code, and,
     // if available, translated disassembly, to files in the given directory
     // based on ucode hash. Returns {binary path, disassembly path if written}.
@@ -7,21 +7,32 @@
  ******************************************************************************
  */
 
+#include <algorithm>
+#include <atomic>
 #include <cinttypes>
 #include <cstring>
+#include <map>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "third_party/fmt/include/fmt/format.h"
 #include "third_party/glslang/SPIRV/disassemble.h"
 #include "xenia/base/assert.h"
+#include "xenia/base/byte_order.h"
+#include "xenia/base/clock.h"
 #include "xenia/base/console_app_main.h"
 #include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/platform.h"
 #include "xenia/base/string.h"
 #include "xenia/base/string_buffer.h"
+#include "xenia/base/threading.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/gpu/dxbc_shader_translator.h"
 #include "xenia/gpu/shader_translator.h"
 #include "xenia/gpu/spirv_shader_translator.h"
@@ -59,11 +70,587 @@ DEFINE_bool(
     "Output host shader with a render backend implementation based on pixel "
     "shader interlock.",
     "GPU");
+DEFINE_path(
+    shader_batch_input, "",
+    "Directory with shader binaries (.vs or .ps) or a shader storage file "
+    "(.xsh) to translate all shaders from with both the DXBC and the SPIR-V "
+    "translators, reporting the translation time and the output size of each "
+    "shader. The report is written to --shader_output as CSV if specified. "
+    "The --shader_input options are ignored in this mode.",
+    "GPU");
+DEFINE_int32(shader_batch_threads, 0,
+             "Number of threads translating the shaders in the batch mode, 0 "
+             "to use all logical processors.",
+             "GPU");
+DEFINE_bool(shader_batch_spirv_optimize, false,
+            "In the batch mode, also run the spirv-opt performance passes on "
+            "the SPIR-V using SPIRV-Tools from the Vulkan SDK, reporting the "
+            "optimization time and the optimized size.",
+            "GPU");
+DEFINE_path(
+    shader_storage_merge_input, "",
+    "Directory with shader storage files (.xsh) and pipeline storage files "
+    "(.xpso) collected from multiple machines or sessions, possibly in "
+    "subdirectories. Files with the same name (for the same title and host "
+    "configuration) are merged, without duplicates, into a file with that name "
+    "in the --shader_output directory, which can be placed in "
+    "cache/shaders/shareable/ to prepare the shaders and the pipelines while "
+    "the game is loading. The --shader_input options are ignored in this "
+    "mode.",
+    "GPU");
 
 namespace xe {
 namespace gpu {
 
+static Shader::HostVertexShaderType GetHostVertexShaderTypeFromCvar() {
+  if (cvars::vertex_shader_output_type == "linedomaincp") {
+    return Shader::HostVertexShaderType::kLineDomainCPIndexed;
+  }
+  if (cvars::vertex_shader_output_type == "linedomainpatch") {
+    return Shader::HostVertexShaderType::kLineDomainPatchIndexed;
+  }
+  if (cvars::vertex_shader_output_type == "triangledomaincp") {
+    return Shader::HostVertexShaderType::kTriangleDomainCPIndexed;
+  }
+  if (cvars::vertex_shader_output_type == "triangledomainpatch") {
+    return Shader::HostVertexShaderType::kTriangleDomainPatchIndexed;
+  }
+  if (cvars::vertex_shader_output_type == "quaddomaincp") {
+    return Shader::HostVertexShaderType::kQuadDomainCPIndexed;
+  }
+  if (cvars::vertex_shader_output_type == "quaddomainpatch") {
+    return Shader::HostVertexShaderType::kQuadDomainPatchIndexed;
+  }
+  return Shader::HostVertexShaderType::kVertex;
+}
+
+static uint64_t GetDefaultModification(
+    const ShaderTranslator& translator, xenos::ShaderType shader_type,
+    Shader::HostVertexShaderType host_vertex_shader_type) {
+  if (shader_type == xenos::ShaderType::kVertex) {
+    return translator.GetDefaultVertexShaderModification(
+        xenos::kMaxShaderTempRegisters, host_vertex_shader_type);
+  }
+  return translator.GetDefaultPixelShaderModification(
+      xenos::kMaxShaderTempRegisters);
+}
+
+struct BatchShader {
+  std::string name;
+  xenos::ShaderType type;
+  // Guest (big-endian) byte order.
+  std::vector<uint32_t> ucode_dwords;
+  uint64_t ucode_data_hash;
+
+  struct Result {
+    bool valid = false;
+    uint64_t time_us = 0;
+    size_t size_bytes = 0;
+  };
+  Result dxbc;
+  Result spirv;
+  Result spirv_optimized;
+};
+
+static bool LoadBatchShaders(const std::filesystem::path& path,
+                             std::vector<BatchShader>& shaders_out) {
+  shaders_out.clear();
+  if (std::filesystem::is_directory(path)) {
+    for (const filesystem::FileInfo& file_info : filesystem::ListFiles(path)) {
+      if (file_info.type != filesystem::FileInfo::Type::kFile) {
+        continue;
+      }
+      xenos::ShaderType shader_type;
+      std::filesystem::path extension = file_info.name.extension();
+      if (extension == ".vs") {
+        shader_type = xenos::ShaderType::kVertex;
+      } else if (extension == ".ps") {
+        shader_type = xenos::ShaderType::kPixel;
+      } else {
+        continue;
+      }
+      std::filesystem::path file_path = file_info.path / file_info.name;
+      FILE* file = filesystem::OpenFile(file_path, "rb");
+      if (!file) {
+        XELOGW("Unable to open shader file: {}", xe::path_to_utf8(file_path));
+        continue;
+      }
+      BatchShader& shader = shaders_out.emplace_back();
+      shader.name = xe::path_to_utf8(file_info.name);
+      shader.type = shader_type;
+      shader.ucode_dwords.resize(size_t(file_info.total_size / 4));
+      shader.ucode_dwords.resize(fread(shader.ucode_dwords.data(), 4,
+                                       shader.ucode_dwords.size(), file));
+      fclose(file);
+      shader.ucode_data_hash =
+          XXH3_64bits(shader.ucode_dwords.data(),
+                      shader.ucode_dwords.size() * sizeof(uint32_t));
+    }
+    // Stable order of the report.
+    std::sort(shaders_out.begin(), shaders_out.end(),
+              [](const BatchShader& a, const BatchShader& b) {
+                return a.name < b.name;
+              });
+    return true;
+  }
+
+  // Shader storage written by the emulator - 'XESH' and the version, followed
+  // by a 64-bit ucode hash, a 32-bit dword count with the shader type in the
+  // top bit, and the ucode for each shader.
+  FILE* file = filesystem::OpenFile(path, "rb");
+  if (!file) {
+    XELOGE("Unable to open the shader storage file: {}",
+           xe::path_to_utf8(path));
+    return false;
+  }
+  uint32_t storage_header[2];
+  if (!fread(storage_header, sizeof(storage_header), 1, file) ||
+      storage_header[0] != 0x48534558) {
+    XELOGE("{} is not a shader storage file", xe::path_to_utf8(path));
+    fclose(file);
+    return false;
+  }
+  while (true) {
+    uint64_t ucode_data_hash;
+    uint32_t ucode_dword_count_and_type;
+    if (!fread(&ucode_data_hash, sizeof(ucode_data_hash), 1, file) ||
+        !fread(&ucode_dword_count_and_type, sizeof(ucode_dword_count_and_type),
+               1, file)) {
+      break;
+    }
+    std::vector<uint32_t> ucode_dwords(ucode_dword_count_and_type &
+                                       0x7FFFFFFF);
+    if (!ucode_dwords.empty() &&
+        !fread(ucode_dwords.data(), ucode_dwords.size() * sizeof(uint32_t), 1,
+               file)) {
+      break;
+    }
+    if (XXH3_64bits(ucode_dwords.data(),
+                    ucode_dwords.size() * sizeof(uint32_t)) !=
+        ucode_data_hash) {
+      XELOGW("Shader storage is corrupted after {} shaders",
+             shaders_out.size());
+      break;
+    }
+    BatchShader& shader = shaders_out.emplace_back();
+    shader.name = fmt::format("{:016X}", ucode_data_hash);
+    shader.type = (ucode_dword_count_and_type >> 31)
+                      ? xenos::ShaderType::kPixel
+                      : xenos::ShaderType::kVertex;
+    shader.ucode_dwords = std::move(ucode_dwords);
+    shader.ucode_data_hash = ucode_data_hash;
+  }
+  fclose(file);
+  return true;
+}
+
+static void TranslateBatchShaders(std::vector<BatchShader>& shaders,
+                                  std::atomic<size_t>& next_shader_index) {
+  uint64_t tick_frequency = xe::Clock::QueryHostTickFrequency();
+  auto get_time_us = [tick_frequency](uint64_t start_ticks) {
+    return (xe::Clock::QueryHostTickCount() - start_ticks) * 1000000 /
+           tick_frequency;
+  };
+
+  SpirvShaderTranslator::Features spirv_features(true);
+  SpirvShaderTranslator spirv_translator(
+      spirv_features, true, true, cvars::shader_output_pixel_shader_interlock);
+  DxbcShaderTranslator dxbc_translator(
+      ui::GraphicsProvider::GpuVendorID(0),
+      cvars::shader_output_bindless_resources,
+      cvars::shader_output_pixel_shader_interlock);
+  std::unique_ptr<ui::vulkan::SpirvToolsContext> spirv_tools_context;
+  if (cvars::shader_batch_spirv_optimize) {
+    spirv_tools_context = std::make_unique<ui::vulkan::SpirvToolsContext>();
+    if (!spirv_tools_context->Initialize(spirv_features.spirv_version) ||
+        !spirv_tools_context->IsOptimizerAvailable()) {
+      spirv_tools_context.reset();
+    }
+  }
+  Shader::HostVertexShaderType host_vertex_shader_type =
+      GetHostVertexShaderTypeFromCvar();
+  StringBuffer ucode_disasm_buffer;
+  std::vector<uint32_t> spirv_optimized;
+
+  while (true) {
+    size_t shader_index =
+        next_shader_index.fetch_add(1, std::memory_order_relaxed);
+    if (shader_index >= shaders.size()) {
+      break;
+    }
+    BatchShader& batch_shader = shaders[shader_index];
+    // Separate shaders for each translator since their modification bits may
+    // be the same.
+    for (ShaderTranslator* translator :
+         {static_cast<ShaderTranslator*>(&dxbc_translator),
+          static_cast<ShaderTranslator*>(&spirv_translator)}) {
+      bool is_spirv = translator == &spirv_translator;
+      Shader shader(batch_shader.type, batch_shader.ucode_data_hash,
+                    batch_shader.ucode_dwords.data(),
+                    batch_shader.ucode_dwords.size());
+      shader.AnalyzeUcode(ucode_disasm_buffer);
+      Shader::Translation* translation =
+          shader.GetOrCreateTranslation(GetDefaultModification(
+              *translator, batch_shader.type, host_vertex_shader_type));
+      BatchShader::Result& result =
+          is_spirv ? batch_shader.spirv : batch_shader.dxbc;
+      uint64_t translation_start = xe::Clock::QueryHostTickCount();
+      result.valid = translator->TranslateAnalyzedShader(*translation);
+      result.time_us = get_time_us(translation_start);
+      result.size_bytes = translation->translated_binary().size();
+      if (!result.valid) {
+        XELOGW("Failed to translate shader {} to {}", batch_shader.name,
+               is_spirv ? "SPIR-V" : "DXBC");
+        continue;
+      }
+      if (is_spirv && spirv_tools_context) {
+        const std::vector<uint8_t>& spirv = translation->translated_binary();
+        uint64_t optimization_start = xe::Clock::QueryHostTickCount();
+        batch_shader.spirv_optimized.valid =
+            spirv_tools_context->Optimize(
+                reinterpret_cast<const uint32_t*>(spirv.data()),
+                spirv.size() / sizeof(uint32_t),
+                spirv_optimized) == SPV_SUCCESS;
+        batch_shader.spirv_optimized.time_us =
+            get_time_us(optimization_start);
+        batch_shader.spirv_optimized.size_bytes =
+            spirv_optimized.size() * sizeof(uint32_t);
+      }
+    }
+  }
+}
+
+static int shader_compiler_batch_main() {
+  std::vector<BatchShader> shaders;
+  if (!LoadBatchShaders(cvars::shader_batch_input, shaders)) {
+    return 1;
+  }
+  XELOGI("Loaded {} shaders from {}", shaders.size(),
+         xe::path_to_utf8(cvars::shader_batch_input));
+  if (shaders.empty()) {
+    return 0;
+  }
+
+  size_t thread_count = xe::threading::logical_processor_count();
+  if (cvars::shader_batch_threads > 0) {
+    thread_count = size_t(cvars::shader_batch_threads);
+  }
+  thread_count = std::max(std::min(thread_count, shaders.size()), size_t(1));
+  uint64_t batch_start = xe::Clock::QueryHostTickCount();
+  std::atomic<size_t> next_shader_index{0};
+  std::vector<std::unique_ptr<xe::threading::Thread>> threads;
+  threads.reserve(thread_count - 1);
+  // Also translating on this thread.
+  for (size_t i = 1; i < thread_count; ++i) {
+    auto thread = xe::threading::Thread::Create(
+        {}, [&shaders, &next_shader_index]() {
+          TranslateBatchShaders(shaders, next_shader_index);
+        });
+    assert_not_null(thread);
+    thread->set_name("Shader Translation");
+    threads.push_back(std::move(thread));
+  }
+  TranslateBatchShaders(shaders, next_shader_index);
+  for (auto& thread : threads) {
+    xe::threading::Wait(thread.get(), false);
+  }
+  uint64_t batch_time_ms = (xe::Clock::QueryHostTickCount() - batch_start) *
+                           1000 / xe::Clock::QueryHostTickFrequency();
+
+  FILE* report_file = nullptr;
+  if (!cvars::shader_output.empty()) {
+    report_file = filesystem::OpenFile(cvars::shader_output, "wb");
+    if (!report_file) {
+      XELOGE("Unable to open the report file: {}",
+             xe::path_to_utf8(cvars::shader_output));
+    } else {
+      fputs(
+          "shader,type,ucode_bytes,dxbc_valid,dxbc_us,dxbc_bytes,spirv_valid,"
+          "spirv_us,spirv_bytes,spirv_opt_valid,spirv_opt_us,"
+          "spirv_opt_bytes\n",
+          report_file);
+    }
+  }
+  BatchShader::Result dxbc_total, spirv_total, spirv_optimized_total;
+  size_t dxbc_valid_count = 0, spirv_valid_count = 0,
+         spirv_optimized_valid_count = 0;
+  auto add_to_total = [](const BatchShader::Result& result,
+                         BatchShader::Result& total, size_t& valid_count) {
+    if (result.valid) {
+      total.time_us += result.time_us;
+      total.size_bytes += result.size_bytes;
+      ++valid_count;
+    }
+  };
+  for (const BatchShader& shader : shaders) {
+    add_to_total(shader.dxbc, dxbc_total, dxbc_valid_count);
+    add_to_total(shader.spirv, spirv_total, spirv_valid_count);
+    add_to_total(shader.spirv_optimized, spirv_optimized_total,
+                 spirv_optimized_valid_count);
+    if (report_file) {
+      std::string line = fmt::format(
+          "{},{},{},{:d},{},{},{:d},{},{},{:d},{},{}\n", shader.name,
+          shader.type == xenos::ShaderType::kVertex ? "vs" : "ps",
+          shader.ucode_dwords.size() * sizeof(uint32_t), shader.dxbc.valid,
+          shader.dxbc.time_us, shader.dxbc.size_bytes, shader.spirv.valid,
+          shader.spirv.time_us, shader.spirv.size_bytes,
+          shader.spirv_optimized.valid, shader.spirv_optimized.time_us,
+          shader.spirv_optimized.size_bytes);
+      fwrite(line.data(), 1, line.size(), report_file);
+    }
+  }
+  if (report_file) {
+    fclose(report_file);
+  }
+
+  XELOGI("Translated {} shaders on {} threads in {} milliseconds",
+         shaders.size(), thread_count, batch_time_ms);
+  XELOGI("DXBC: {} valid, {} microseconds, {} bytes in total",
+         dxbc_valid_count, dxbc_total.time_us, dxbc_total.size_bytes);
+  XELOGI("SPIR-V: {} valid, {} microseconds, {} bytes in total",
+         spirv_valid_count, spirv_total.time_us, spirv_total.size_bytes);
+  if (cvars::shader_batch_spirv_optimize) {
+    if (spirv_optimized_valid_count) {
+      XELOGI("Optimized SPIR-V: {} valid, {} microseconds, {} bytes in total",
+             spirv_optimized_valid_count, spirv_optimized_total.time_us,
+             spirv_optimized_total.size_bytes);
+    } else {
+      XELOGW(
+          "No SPIR-V was optimized - SPIRV-Tools with the optimizer may be "
+          "unavailable");
+    }
+  }
+  return 0;
+}
+
+// Reads the records of a shader storage file - 'XESH' and the version,
+// followed by a 64-bit ucode hash, a 32-bit dword count with the shader type in
+// the top bit, and the ucode for each shader. Appends the records with hashes
+// not in hashes_written to records_out. Returns false if the file is not a
+// shader storage file with the expected header.
+static bool MergeShaderStorageFile(const std::filesystem::path& path,
+                                   const uint32_t* expected_header,
+                                   uint32_t* header_out,
+                                   std::unordered_set<uint64_t>& hashes_written,
+                                   std::vector<uint8_t>& records_out) {
+  FILE* file = filesystem::OpenFile(path, "rb");
+  if (!file) {
+    XELOGW("Unable to open the shader storage file: {}",
+           xe::path_to_utf8(path));
+    return false;
+  }
+  uint32_t header[2];
+  if (!fread(header, sizeof(header), 1, file) || header[0] != 0x48534558 ||
+      (expected_header && header[1] != expected_header[1])) {
+    fclose(file);
+    return false;
+  }
+  std::memcpy(header_out, header, sizeof(header));
+  std::vector<uint32_t> ucode_dwords;
+  while (true) {
+    uint64_t ucode_data_hash;
+    uint32_t ucode_dword_count_and_type;
+    if (!fread(&ucode_data_hash, sizeof(ucode_data_hash), 1, file) ||
+        !fread(&ucode_dword_count_and_type, sizeof(ucode_dword_count_and_type),
+               1, file)) {
+      break;
+    }
+    ucode_dwords.resize(ucode_dword_count_and_type & 0x7FFFFFFF);
+    size_t ucode_byte_count = ucode_dwords.size() * sizeof(uint32_t);
+    if (ucode_byte_count &&
+        !fread(ucode_dwords.data(), ucode_byte_count, 1, file)) {
+      break;
+    }
+    if (XXH3_64bits(ucode_dwords.data(), ucode_byte_count) !=
+        ucode_data_hash) {
+      XELOGW("{} is corrupted, ignoring the rest of it",
+             xe::path_to_utf8(path));
+      break;
+    }
+    if (!hashes_written.emplace(ucode_data_hash).second) {
+      continue;
+    }
+    size_t record_offset = records_out.size();
+    records_out.resize(record_offset + sizeof(ucode_data_hash) +
+                       sizeof(ucode_dword_count_and_type) + ucode_byte_count);
+    uint8_t* record = records_out.data() + record_offset;
+    std::memcpy(record, &ucode_data_hash, sizeof(ucode_data_hash));
+    record += sizeof(ucode_data_hash);
+    std::memcpy(record, &ucode_dword_count_and_type,
+                sizeof(ucode_dword_count_and_type));
+    record += sizeof(ucode_dword_count_and_type);
+    std::memcpy(record, ucode_dwords.data(), ucode_byte_count);
+  }
+  fclose(file);
+  return true;
+}
+
+// Reads the records of a pipeline storage file - 'XEPS', the host API and
+// configuration, and the version, followed by fixed-size records of a 64-bit
+// XXH3 hash of the pipeline description and the description itself. The
+// description structure is specific to the host API, so its size is detected
+// from the first record whose hash matches. Appends the records with hashes not
+// in hashes_written to records_out.
+static bool MergePipelineStorageFile(
+    const std::filesystem::path& path, const uint32_t* expected_header,
+    uint32_t* header_out, size_t& description_size,
+    std::unordered_set<uint64_t>& hashes_written,
+    std::vector<uint8_t>& records_out) {
+  FILE* file = filesystem::OpenFile(path, "rb");
+  if (!file) {
+    XELOGW("Unable to open the pipeline storage file: {}",
+           xe::path_to_utf8(path));
+    return false;
+  }
+  uint32_t header[3];
+  if (!fread(header, sizeof(header), 1, file) || header[0] != 0x53504558 ||
+      (expected_header &&
+       std::memcmp(header, expected_header, sizeof(header)))) {
+    fclose(file);
+    return false;
+  }
+  std::memcpy(header_out, header, sizeof(header));
+  std::vector<uint8_t> data;
+  filesystem::Seek(file, 0, SEEK_END);
+  int64_t file_size = filesystem::Tell(file);
+  if (file_size > int64_t(sizeof(header)) &&
+      filesystem::Seek(file, int64_t(sizeof(header)), SEEK_SET)) {
+    data.resize(size_t(file_size) - sizeof(header));
+    data.resize(fread(data.data(), 1, data.size(), file));
+  }
+  fclose(file);
+  if (!description_size) {
+    // Descriptions are much smaller than 4 KB on all hosts.
+    for (size_t size = sizeof(uint32_t);
+         size <= 4096 && sizeof(uint64_t) + size <= data.size();
+         size += sizeof(uint32_t)) {
+      uint64_t description_hash;
+      std::memcpy(&description_hash, data.data(), sizeof(description_hash));
+      if (XXH3_64bits(data.data() + sizeof(description_hash), size) ==
+          description_hash) {
+        description_size = size;
+        break;
+      }
+    }
+    if (!description_size) {
+      // Empty or corrupted from the beginning, nothing to merge.
+      return true;
+    }
+  }
+  size_t record_size = sizeof(uint64_t) + description_size;
+  for (size_t record_offset = 0; record_offset + record_size <= data.size();
+       record_offset += record_size) {
+    const uint8_t* record = data.data() + record_offset;
+    uint64_t description_hash;
+    std::memcpy(&description_hash, record, sizeof(description_hash));
+    if (XXH3_64bits(record + sizeof(description_hash), description_size) !=
+        description_hash) {
+      XELOGW("{} is corrupted, ignoring the rest of it",
+             xe::path_to_utf8(path));
+      break;
+    }
+    if (hashes_written.emplace(description_hash).second) {
+      records_out.insert(records_out.end(), record, record + record_size);
+    }
+  }
+  return true;
+}
+
+static int shader_compiler_storage_merge_main() {
+  if (cvars::shader_output.empty()) {
+    XELOGE("--shader_output must be the directory for the merged storage");
+    return 1;
+  }
+  if (!std::filesystem::exists(cvars::shader_output) &&
+      !std::filesystem::create_directories(cvars::shader_output)) {
+    XELOGE("Unable to create the output directory: {}",
+           xe::path_to_utf8(cvars::shader_output));
+    return 1;
+  }
+
+  // Group the inputs by the file name, which contains the title ID, and for
+  // pipelines, the host API and configuration.
+  std::map<std::filesystem::path, std::vector<std::filesystem::path>>
+      input_groups;
+  std::error_code error_code;
+  for (const auto& entry : std::filesystem::recursive_directory_iterator(
+           cvars::shader_storage_merge_input, error_code)) {
+    if (!entry.is_regular_file()) {
+      continue;
+    }
+    std::filesystem::path extension = entry.path().extension();
+    if (extension == ".xsh" || extension == ".xpso") {
+      input_groups[entry.path().filename()].push_back(entry.path());
+    }
+  }
+  if (error_code) {
+    XELOGE("Unable to list the storage files in {}",
+           xe::path_to_utf8(cvars::shader_storage_merge_input));
+    return 1;
+  }
+
+  for (auto& input_group : input_groups) {
+    bool is_pipeline_storage = input_group.first.extension() == ".xpso";
+    // Stable merging order.
+    std::sort(input_group.second.begin(), input_group.second.end());
+    uint32_t header[3] = {};
+    bool header_valid = false;
+    size_t description_size = 0;
+    std::unordered_set<uint64_t> hashes_written;
+    std::vector<uint8_t> records;
+    size_t files_merged = 0;
+    for (const std::filesystem::path& input_path : input_group.second) {
+      bool merged =
+          is_pipeline_storage
+              ? MergePipelineStorageFile(input_path,
+                                         header_valid ? header : nullptr,
+                                         header, description_size,
+                                         hashes_written, records)
+              : MergeShaderStorageFile(input_path,
+                                       header_valid ? header : nullptr, header,
+                                       hashes_written, records);
+      if (!merged) {
+        XELOGW(
+            "Skipping {} - not a storage file of the same version as the "
+            "previous ones with this name",
+            xe::path_to_utf8(input_path));
+        continue;
+      }
+      header_valid = true;
+      ++files_merged;
+    }
+    if (!header_valid) {
+      continue;
+    }
+    std::filesystem::path output_path =
+        cvars::shader_output / input_group.first;
+    FILE* output_file = filesystem::OpenFile(output_path, "wb");
+    if (!output_file) {
+      XELOGE("Unable to open the output storage file: {}",
+             xe::path_to_utf8(output_path));
+      return 1;
+    }
+    fwrite(header, sizeof(uint32_t) * (is_pipeline_storage ? 3 : 2), 1,
+           output_file);
+    if (!records.empty()) {
+      fwrite(records.data(), records.size(), 1, output_file);
+    }
+    fclose(output_file);
+    XELOGI("Merged {} files into {} with {} unique {}", files_merged,
+           xe::path_to_utf8(output_path), hashes_written.size(),
+           is_pipeline_storage ? "pipelines" : "shaders");
+  }
+  return 0;
+}
+
 int shader_compiler_main(const std::vector<std::string>& args) {
+  if (!cvars::shader_storage_merge_input.empty()) {
+    return shader_compiler_storage_merge_main();
+  }
+  if (!cvars::shader_batch_input.empty()) {
+    return shader_compiler_batch_main();
+  }
+
   xenos::ShaderType shader_type;
   if (!cvars::shader_input_type.empty()) {
     if (cvars::shader_input_type == "vs") {
@@ -145,43 +732,8 @@ int shader_compiler_main(const std::vector<std::string>& args) {
     return 0;
   }
 
-  Shader::HostVertexShaderType host_vertex_shader_type =
-      Shader::HostVertexShaderType::kVertex;
-  if (shader_type == xenos::ShaderType::kVertex) {
-    if (cvars::vertex_shader_output_type == "linedomaincp") {
-      host_vertex_shader_type =
-          Shader::HostVertexShaderType::kLineDomainCPIndexed;
-    } else if (cvars::vertex_shader_output_type == "linedomainpatch") {
-      host_vertex_shader_type =
-          Shader::HostVertexShaderType::kLineDomainPatchIndexed;
-    } else if (cvars::vertex_shader_output_type == "triangledomaincp") {
-      host_vertex_shader_type =
-          Shader::HostVertexShaderType::kTriangleDomainCPIndexed;
-    } else if (cvars::vertex_shader_output_type == "triangledomainpatch") {
-      host_vertex_shader_type =
-          Shader::HostVertexShaderType::kTriangleDomainPatchIndexed;
-    } else if (cvars::vertex_shader_output_type == "quaddomaincp") {
-      host_vertex_shader_type =
-          Shader::HostVertexShaderType::kQuadDomainCPIndexed;
-    } else if (cvars::vertex_shader_output_type == "quaddomainpatch") {
-      host_vertex_shader_type =
-          Shader::HostVertexShaderType::kQuadDomainPatchIndexed;
-    }
-  }
-  uint64_t modification;
-  switch (shader_type) {
-    case xenos::ShaderType::kVertex:
-      modification = translator->GetDefaultVertexShaderModification(
-          xenos::kMaxShaderTempRegisters, host_vertex_shader_type);
-      break;
-    case xenos::ShaderType::kPixel:
-      modification = translator->GetDefaultPixelShaderModification(
-          xenos::kMaxShaderTempRegisters);
-      break;
-    default:
-      assert_unhandled_case(shader_type);
-      return 1;
-  }
+  uint64_t modification = GetDefaultModification(
+      *translator, shader_type, GetHostVertexShaderTypeFromCvar());
 
   Shader::Translation* translation =
       shader->GetOrCreateTranslation(modification);
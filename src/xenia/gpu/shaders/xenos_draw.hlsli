@@ -30,6 +30,7 @@ cbuffer xe_system_cbuffer : register(b0) {
   uint xe_alpha_to_mask;
   uint xe_edram_32bpp_tile_pitch_dwords_scaled;
   uint xe_edram_depth_base_dwords_scaled;
+  uint xe_vertex_index_load_address;
 
   float4 xe_color_exp_bias;
 
@@ -13,9 +13,19 @@
 
 #include "xenia/base/assert.h"
 #include "xenia/base/bit_range.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/profiling.h"
 
+DEFINE_uint32(
+    shared_memory_upload_coalesce_pages, 2,
+    "Maximum number of up-to-date host pages between two ranges of guest "
+    "memory that need to be uploaded to the GPU for the ranges to be merged "
+    "into one, reuploading the pages in between, but issuing fewer copy "
+    "commands.\n"
+    "0 to upload only the modified pages.",
+    "GPU");
+
 namespace xe {
 namespace gpu {
 
@@ -414,24 +424,87 @@ bool SharedMemory::RequestRange(uint32_t start, uint32_t length,
   uint32_t block_last = page_last >> 6;
   uint32_t range_start = UINT32_MAX;
 
+  unsigned int upload_range_count_uncoalesced;
   {
     auto global_lock = global_critical_region_.Acquire();
     TryFindUploadRange(block_first, block_last, page_first, page_last,
                        any_data_resolved, range_start, current_upload_range,
                        uploads);
-  }
-  if (range_start != UINT32_MAX) {
-    uploads[current_upload_range++] =
-        (std::make_pair(range_start, page_last + 1 - range_start));
+    if (range_start != UINT32_MAX) {
+      uploads[current_upload_range++] =
+          (std::make_pair(range_start, page_last + 1 - range_start));
+    }
+    upload_range_count_uncoalesced = current_upload_range;
+    if (current_upload_range > 1) {
+      current_upload_range =
+          CoalesceUploadRanges(uploads, current_upload_range);
+    }
   }
   if (any_data_resolved_out) {
     *any_data_resolved_out = any_data_resolved;
   }
-  if (!current_upload_range) {
-    return true;
+  if (current_upload_range) {
+    frame_upload_ranges_ += current_upload_range;
+    frame_upload_ranges_coalesced_ +=
+        upload_range_count_uncoalesced - current_upload_range;
+    uint64_t upload_bytes = 0;
+    for (unsigned int i = 0; i < current_upload_range; ++i) {
+      upload_bytes += uint64_t(uploads[i].second) << page_size_log2_;
+    }
+    frame_upload_bytes_ += upload_bytes;
+    total_upload_bytes_ += upload_bytes;
+
+    if (!UploadRanges(uploads, current_upload_range)) {
+      return false;
+    }
   }
 
-  return UploadRanges(uploads, current_upload_range);
+  OnRangeRequested(start, length);
+  return true;
+}
+
+unsigned int SharedMemory::CoalesceUploadRanges(
+    std::pair<uint32_t, uint32_t>* uploads,
+    unsigned int upload_range_count) const {
+  uint32_t max_gap = cvars::shared_memory_upload_coalesce_pages;
+  if (!max_gap) {
+    return upload_range_count;
+  }
+  unsigned int coalesced_count = 1;
+  for (unsigned int i = 1; i < upload_range_count; ++i) {
+    std::pair<uint32_t, uint32_t>& previous = uploads[coalesced_count - 1];
+    const std::pair<uint32_t, uint32_t>& range = uploads[i];
+    uint32_t gap_first = previous.first + previous.second;
+    bool coalesce = range.first - gap_first <= max_gap;
+    if (coalesce) {
+      // The pages between the ranges are valid, but the GPU copy of those
+      // written by the GPU is newer than the guest memory.
+      for (uint32_t page = gap_first; page < range.first; ++page) {
+        if (system_page_flags_valid_and_gpu_written_[page >> 6] &
+            (uint64_t(1) << (page & 63))) {
+          coalesce = false;
+          break;
+        }
+      }
+    }
+    if (coalesce) {
+      previous.second = range.first + range.second - previous.first;
+    } else {
+      uploads[coalesced_count++] = range;
+    }
+  }
+  return coalesced_count;
+}
+
+void SharedMemory::BeginFrame() {
+  COUNT_profile_set("gpu/shared_memory/upload_kb",
+                    uint32_t(frame_upload_bytes_ >> 10));
+  COUNT_profile_set("gpu/shared_memory/upload_ranges", frame_upload_ranges_);
+  COUNT_profile_set("gpu/shared_memory/upload_ranges_coalesced",
+                    frame_upload_ranges_coalesced_);
+  frame_upload_bytes_ = 0;
+  frame_upload_ranges_ = 0;
+  frame_upload_ranges_coalesced_ = 0;
 }
 
 template <typename T>
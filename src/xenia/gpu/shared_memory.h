@@ -28,6 +28,14 @@ class SharedMemory {
   virtual void ClearCache();
   virtual void SetSystemPageBlocksValidWithGpuDataWritten();
 
+  // Host GPU memory backing the buffer - only the allocated parts of it if it's
+  // sparse.
+  virtual uint64_t GetHostGpuMemoryUsage() const {
+    return host_gpu_memory_sparse_granularity_log2_ != UINT32_MAX
+               ? host_gpu_memory_sparse_used_bytes_
+               : kBufferSize;
+  }
+
   typedef void (*GlobalWatchCallback)(
       const global_unique_lock_type& global_lock, void* context,
       uint32_t address_first, uint32_t address_last, bool invalidated_by_gpu);
@@ -74,6 +82,13 @@ class SharedMemory {
   bool RequestRange(uint32_t start, uint32_t length,
                     bool* any_data_resolved_out = nullptr);
 
+  // Publishes the upload statistics gathered since the previous call to the
+  // profiler, to be called once per frame.
+  void BeginFrame();
+
+  // Total size of the guest memory uploaded since the initialization.
+  uint64_t total_upload_bytes() const { return total_upload_bytes_; }
+
   void TryFindUploadRange(const uint32_t& block_first,
                           const uint32_t& block_last,
                           const uint32_t& page_first, const uint32_t& page_last,
@@ -85,6 +100,13 @@ class SharedMemory {
                              const uint32_t& i,
                              unsigned int& current_upload_range,
                              std::pair<uint32_t, uint32_t>* uploads);
+  // Merges upload ranges separated by up to shared_memory_upload_coalesce_pages
+  // valid pages not written by the GPU (containing the same data in the guest
+  // and the host memory, thus safe to upload again), to issue fewer copy
+  // commands. Returns the new number of ranges. Must be called within the
+  // global critical region.
+  unsigned int CoalesceUploadRanges(std::pair<uint32_t, uint32_t>* uploads,
+                                    unsigned int upload_range_count) const;
 
   // Marks the range and, if not exact_range, potentially its surroundings
   // (to up to the first GPU-written page, as an access violation exception
@@ -149,6 +171,11 @@ class SharedMemory {
       const std::pair<uint32_t, uint32_t>* upload_page_ranges,
       uint32_t num_upload_ranges) = 0;
 
+  // Called after a range has been successfully requested via RequestRange and
+  // uploaded if needed, for tracking which parts of the buffer are accessed by
+  // the GPU in the current submission.
+  virtual void OnRangeRequested(uint32_t start, uint32_t length) {}
+
   const std::vector<std::pair<uint32_t, uint32_t>>& trace_download_ranges() {
     return trace_download_ranges_;
   }
@@ -189,6 +216,12 @@ class SharedMemory {
   FixedVMemVector<MAX_UPLOAD_RANGES * sizeof(std::pair<uint32_t, uint32_t>)>
       upload_ranges_;
 
+  // Upload statistics since the last BeginFrame.
+  uint64_t frame_upload_bytes_ = 0;
+  uint32_t frame_upload_ranges_ = 0;
+  uint32_t frame_upload_ranges_coalesced_ = 0;
+  uint64_t total_upload_bytes_ = 0;
+
   // Mutex between the guest memory subsystem and the command processor, to be
   // locked when checking or updating validity of pages/ranges and when firing
   // watches.
@@ -1373,50 +1373,7 @@ void SpirvShaderTranslator::StartVertexOrTessEvalShaderInMain() {
             load_vertex_index, spv::SelectionControlDontFlattenMask, *builder_);
         spv::Id loaded_vertex_index;
         {
-          // Check if the index is 32-bit.
-          spv::Id vertex_index_is_32bit = builder_->createBinOp(
-              spv::OpINotEqual, type_bool_,
-              builder_->createBinOp(
-                  spv::OpBitwiseAnd, type_uint_, main_system_constant_flags_,
-                  builder_->makeUintConstant(static_cast<unsigned int>(
-                      kSysFlag_ComputeOrPrimitiveVertexIndexLoad32Bit))),
-              const_uint_0_);
-          // Calculate the vertex index address in the shared memory.
-          id_vector_temp_.clear();
-          id_vector_temp_.push_back(
-              builder_->makeIntConstant(kSystemConstantVertexIndexLoadAddress));
-          spv::Id vertex_index_address = builder_->createBinOp(
-              spv::OpIAdd, type_uint_,
-              builder_->createLoad(
-                  builder_->createAccessChain(spv::StorageClassUniform,
-                                              uniform_system_constants_,
-                                              id_vector_temp_),
-                  spv::NoPrecision),
-              builder_->createBinOp(
-                  spv::OpShiftLeftLogical, type_uint_, vertex_index,
-                  builder_->createTriOp(spv::OpSelect, type_uint_,
-                                        vertex_index_is_32bit, const_uint_2,
-                                        builder_->makeUintConstant(1))));
-          // Load the 32 bits containing the whole vertex index or two 16-bit
-          // vertex indices.
-          // TODO(Triang3l): Bounds checking.
-          loaded_vertex_index =
-              LoadUint32FromSharedMemory(builder_->createUnaryOp(
-                  spv::OpBitcast, type_int_,
-                  builder_->createBinOp(spv::OpShiftRightLogical, type_uint_,
-                                        vertex_index_address, const_uint_2)));
-          // Extract the 16-bit index from the loaded 32 bits if needed.
-          loaded_vertex_index = builder_->createTriOp(
-              spv::OpSelect, type_uint_, vertex_index_is_32bit,
-              loaded_vertex_index,
-              builder_->createTriOp(
-                  spv::OpBitFieldUExtract, type_uint_, loaded_vertex_index,
-                  builder_->createBinOp(
-                      spv::OpShiftLeftLogical, type_uint_,
-                      builder_->createBinOp(spv::OpBitwiseAnd, type_uint_,
-                                            vertex_index_address, const_uint_2),
-                      builder_->makeUintConstant(4 - 1)),
-                  builder_->makeUintConstant(16)));
+          loaded_vertex_index = LoadIndexBufferVertexIndex(vertex_index);
           // Endian-swap the loaded index.
           id_vector_temp_.clear();
           id_vector_temp_.push_back(
@@ -1437,6 +1394,25 @@ void SpirvShaderTranslator::StartVertexOrTessEvalShaderInMain() {
         // TODO(Triang3l): Close line loop primitive.
         // Load the unswapped index as uint for swapping, or for indirect
         // loading if needed.
+        {
+          // Check if the host index buffer only remaps the primitive type, and
+          // the guest index needs to be loaded from the guest index buffer.
+          spv::Id load_vertex_index = builder_->createBinOp(
+              spv::OpINotEqual, type_bool_,
+              builder_->createBinOp(
+                  spv::OpBitwiseAnd, type_uint_, main_system_constant_flags_,
+                  builder_->makeUintConstant(static_cast<unsigned int>(
+                      kSysFlag_ComputeOrPrimitiveVertexIndexLoad))),
+              const_uint_0_);
+          SpirvBuilder::IfBuilder load_vertex_index_if(
+              load_vertex_index, spv::SelectionControlDontFlattenMask,
+              *builder_);
+          spv::Id loaded_vertex_index =
+              LoadIndexBufferVertexIndex(vertex_index);
+          load_vertex_index_if.makeEndIf();
+          vertex_index = load_vertex_index_if.createMergePhi(
+              loaded_vertex_index, vertex_index);
+        }
         if (!features_.full_draw_index_uint32) {
           // Check if the full 32-bit index needs to be loaded indirectly.
           spv::Id load_vertex_index = builder_->createBinOp(
@@ -2982,6 +2958,54 @@ spv::Id SpirvShaderTranslator::EndianSwap128Uint4(spv::Id value,
   return EndianSwap32Uint(value, endian);
 }
 
+spv::Id SpirvShaderTranslator::LoadIndexBufferVertexIndex(
+    spv::Id element_index) {
+  spv::Id const_uint_2 = builder_->makeUintConstant(2);
+  // Check if the index is 32-bit.
+  spv::Id vertex_index_is_32bit = builder_->createBinOp(
+      spv::OpINotEqual, type_bool_,
+      builder_->createBinOp(
+          spv::OpBitwiseAnd, type_uint_, main_system_constant_flags_,
+          builder_->makeUintConstant(static_cast<unsigned int>(
+              kSysFlag_ComputeOrPrimitiveVertexIndexLoad32Bit))),
+      const_uint_0_);
+  // Calculate the vertex index address in the shared memory.
+  id_vector_temp_.clear();
+  id_vector_temp_.push_back(
+      builder_->makeIntConstant(kSystemConstantVertexIndexLoadAddress));
+  spv::Id vertex_index_address = builder_->createBinOp(
+      spv::OpIAdd, type_uint_,
+      builder_->createLoad(
+          builder_->createAccessChain(spv::StorageClassUniform,
+                                      uniform_system_constants_,
+                                      id_vector_temp_),
+          spv::NoPrecision),
+      builder_->createBinOp(
+          spv::OpShiftLeftLogical, type_uint_, element_index,
+          builder_->createTriOp(spv::OpSelect, type_uint_,
+                                vertex_index_is_32bit, const_uint_2,
+                                builder_->makeUintConstant(1))));
+  // Load the 32 bits containing the whole vertex index or two 16-bit vertex
+  // indices.
+  // TODO(Triang3l): Bounds checking.
+  spv::Id loaded_vertex_index =
+      LoadUint32FromSharedMemory(builder_->createUnaryOp(
+          spv::OpBitcast, type_int_,
+          builder_->createBinOp(spv::OpShiftRightLogical, type_uint_,
+                                vertex_index_address, const_uint_2)));
+  // Extract the 16-bit index from the loaded 32 bits if needed.
+  return builder_->createTriOp(
+      spv::OpSelect, type_uint_, vertex_index_is_32bit, loaded_vertex_index,
+      builder_->createTriOp(
+          spv::OpBitFieldUExtract, type_uint_, loaded_vertex_index,
+          builder_->createBinOp(
+              spv::OpShiftLeftLogical, type_uint_,
+              builder_->createBinOp(spv::OpBitwiseAnd, type_uint_,
+                                    vertex_index_address, const_uint_2),
+              builder_->makeUintConstant(4 - 1)),
+          builder_->makeUintConstant(16)));
+}
+
 spv::Id SpirvShaderTranslator::LoadUint32FromSharedMemory(
     spv::Id address_dwords_int) {
   spv::StorageClass storage_class = features_.spirv_version >= spv::Spv_1_3
@@ -137,10 +137,12 @@ class SpirvShaderTranslator : public ShaderTranslator {
     // For HostVertexShaderTypes kMemExportCompute, kPointListAsTriangleStrip,
     // kRectangleListAsTriangleStrip, whether the vertex index needs to be
     // loaded from the index buffer (rather than using autogenerated indices),
-    // and whether it's 32-bit. This is separate from kSysFlag_VertexIndexLoad
-    // because the same system constants may be used for the memexporting
-    // compute shader and the vertex shader for the same draw, but
-    // kSysFlag_VertexIndexLoad may be not needed.
+    // and whether it's 32-bit. For kVertex, whether the host index buffer only
+    // remaps the primitive type, and the guest index needs to be loaded from
+    // the index buffer at the host index. This is separate from
+    // kSysFlag_VertexIndexLoad because the same system constants may be used
+    // for the memexporting compute shader and the vertex shader for the same
+    // draw, but kSysFlag_VertexIndexLoad may be not needed.
     kSysFlag_ComputeOrPrimitiveVertexIndexLoad =
         1u << kSysFlag_ComputeOrPrimitiveVertexIndexLoad_Shift,
     kSysFlag_ComputeOrPrimitiveVertexIndexLoad32Bit =
@@ -607,6 +609,10 @@ class SpirvShaderTranslator : public ShaderTranslator {
   // Perform endian swap of a uint4 vector.
   spv::Id EndianSwap128Uint4(spv::Id value, spv::Id endian);
 
+  // Loads the unswapped guest vertex index at the element index within the
+  // index buffer at kSystemConstantVertexIndexLoadAddress, 32-bit or 16-bit
+  // depending on kSysFlag_ComputeOrPrimitiveVertexIndexLoad32Bit.
+  spv::Id LoadIndexBufferVertexIndex(spv::Id element_index);
   spv::Id LoadUint32FromSharedMemory(spv::Id address_dwords_int);
   // If `replace_mask` is provided, the bits specified in the mask will be
   // replaced with those from the value via OpAtomicAnd/Or.
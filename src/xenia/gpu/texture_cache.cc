@@ -13,6 +13,7 @@
 #include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/gpu/gpu_flags.h"
 
 DEFINE_int32(
@@ -59,6 +60,80 @@ DEFINE_uint32(
     "textures - so with 2x2 resolution scaling, the soft limit will be 360 + "
     "96 MB, and with 3x3, it will be 360 + 216 MB.",
     "GPU");
+DEFINE_uint32(
+    texture_cache_memory_limit_host_budget, 90,
+    "Percentage of the video memory budget given to the emulator by the host "
+    "OS or driver (DXGI QueryVideoMemoryInfo on Direct3D 12, "
+    "VK_EXT_memory_budget on Vulkan) above the total usage of which unused "
+    "textures will be destroyed as soon as possible, regardless of "
+    "texture_cache_memory_limit_hard.\n"
+    "0 to ignore the host budget.",
+    "GPU");
+DEFINE_bool(
+    texture_cache_content_hash, false,
+    "Hash the guest data of textures when loading them to skip reloading if "
+    "it has been rewritten with the same data, and to copy the data from "
+    "textures with the same content and layout at other addresses instead of "
+    "loading it again (for streaming pools and double-buffered atlases).\n"
+    "The hashing time is reported as the "
+    "gpu/texture_cache/content_hash_us profiler counter - disable this if it "
+    "doesn't pay off.\n"
+    "Textures written by resolves are not hashed, but data written by "
+    "memexport is not visible to the CPU, so this may cause stale textures in "
+    "games using it.",
+    "GPU");
+DEFINE_uint32(
+    texture_cache_recompression_candidate_frames, 0,
+    "Number of frames an uncompressed 32bpp or 64bpp float texture must stay "
+    "unmodified since loading (and not be a resolve target) to be counted as "
+    "a candidate for re-compression to BCn on the host in the "
+    "gpu/texture_cache/recompression_candidates_mb profiler counter, for "
+    "estimating the memory that may be saved.\n"
+    "0 to disable.",
+    "GPU");
+DEFINE_uint32(
+    texture_cache_deferred_base_frames, 0,
+    "Number of frames after creating a texture with mips to load only the "
+    "mips for, with sampling clamped to the first mip, before loading the "
+    "base level. Textures used only briefly, or only at distances where the "
+    "base level is not sampled anyway, then skip uploading their largest "
+    "level. The base level data not uploaded is reported as the "
+    "gpu/texture_cache/deferred_base_mb and "
+    "gpu/texture_cache/deferred_base_never_loaded_mb profiler counters.\n"
+    "0 to disable.",
+    "GPU");
+DEFINE_bool(
+    texture_cache_resolve_aliasing, false,
+    "Remember the destinations of the latest resolves, and let the GPU "
+    "backend write textures sampled from exactly a resolved region, not "
+    "modified by the CPU since, directly from the render target, instead of "
+    "loading the data from the resolved memory, which is a second pass over "
+    "the data. Textures that could be handled this way are reported as the "
+    "gpu/texture_cache/resolve_alias_candidates profiler counter, and the "
+    "ones actually written by the backend as "
+    "gpu/texture_cache/resolve_alias_loads.\n"
+    "The resolved data is still written to the memory, as CPU reads of it "
+    "can't be detected.",
+    "GPU");
+
+DEFINE_path(
+    texture_replacement_path, "",
+    "Directory with replacement textures as block-compressed DDS files, in "
+    "any of its subdirectories, named after the content hash of the guest "
+    "texture data as 16 hexadecimal digits (0123456789ABCDEF.dds). Requires "
+    "texture_cache_content_hash. The files are memory-mapped when the "
+    "textures are loaded.",
+    "GPU");
+DEFINE_uint32(
+    texture_replacement_mapped_limit_mb, 512,
+    "Amount of texture replacement files in megabytes above which the files "
+    "not used in the current frame are unmapped, least recently used first.",
+    "GPU");
+DEFINE_bool(
+    texture_replacement_log_hashes, false,
+    "Log the content hash of every texture loaded with "
+    "texture_cache_content_hash, for naming texture replacement files.",
+    "GPU");
 
 namespace xe {
 namespace gpu {
@@ -163,11 +238,32 @@ TextureCache::TextureCache(const RegisterFile& register_file,
     scaled_resolve_global_watch_handle_ = shared_memory.RegisterGlobalWatch(
         ScaledResolveGlobalWatchCallbackThunk, this);
   }
+
+  if (cvars::texture_cache_resolve_aliasing) {
+    resolve_destination_global_watch_handle_ =
+        shared_memory.RegisterGlobalWatch(
+            ResolveDestinationGlobalWatchCallbackThunk, this);
+  }
+
+  if (!cvars::texture_replacement_path.empty()) {
+    if (cvars::texture_cache_content_hash) {
+      replacement_pack_ = std::make_unique<TextureReplacementPack>(
+          cvars::texture_replacement_path);
+    } else {
+      XELOGW(
+          "Texture replacement requires texture_cache_content_hash, not "
+          "loading the replacements");
+    }
+  }
 }
 
 TextureCache::~TextureCache() {
   DestroyAllTextures(true);
 
+  if (resolve_destination_global_watch_handle_) {
+    shared_memory().UnregisterGlobalWatch(
+        resolve_destination_global_watch_handle_);
+  }
   if (scaled_resolve_global_watch_handle_) {
     shared_memory().UnregisterGlobalWatch(scaled_resolve_global_watch_handle_);
   }
@@ -199,25 +295,33 @@ void TextureCache::CompletedSubmissionUpdated(
   uint32_t limit_scaled_resolve_add_mb =
       cvars::texture_cache_memory_limit_render_to_texture *
       (draw_resolution_scale_x() * draw_resolution_scale_y() - 1);
-  uint32_t limit_soft_mb =
-      cvars::texture_cache_memory_limit_soft + limit_scaled_resolve_add_mb;
-  uint32_t limit_hard_mb =
-      cvars::texture_cache_memory_limit_hard + limit_scaled_resolve_add_mb;
+  uint32_t limit_soft_mb = cvars::texture_cache_memory_limit_soft;
+  uint32_t limit_hard_mb = cvars::texture_cache_memory_limit_hard;
   uint32_t limit_soft_lifetime =
       cvars::texture_cache_memory_limit_soft_lifetime * 1000;
+  if (cvars::low_memory_mode) {
+    limit_soft_mb = std::min(limit_soft_mb, kLowMemoryModeLimitSoftMB);
+    limit_hard_mb = std::min(limit_hard_mb, kLowMemoryModeLimitHardMB);
+    limit_soft_lifetime =
+        std::min(limit_soft_lifetime, kLowMemoryModeLimitSoftLifetimeMs);
+  }
+  limit_soft_mb += limit_scaled_resolve_add_mb;
+  limit_hard_mb += limit_scaled_resolve_add_mb;
   bool destroyed_any = false;
   while (texture_used_first_ != nullptr) {
     uint64_t total_host_memory_usage_mb =
         (textures_total_host_memory_usage_ + ((UINT32_C(1) << 20) - 1)) >> 20;
     bool limit_hard_exceeded = total_host_memory_usage_mb > limit_hard_mb;
-    if (total_host_memory_usage_mb <= limit_soft_mb && !limit_hard_exceeded) {
+    bool host_budget_exceeded = host_memory_budget_excess_ != 0;
+    if (total_host_memory_usage_mb <= limit_soft_mb && !limit_hard_exceeded &&
+        !host_budget_exceeded) {
       break;
     }
     Texture* texture = texture_used_first_;
     if (texture->last_usage_submission_index() > completed_submission_index) {
       break;
     }
-    if (!limit_hard_exceeded &&
+    if (!limit_hard_exceeded && !host_budget_exceeded &&
         (texture->last_usage_time() + limit_soft_lifetime) > current_time) {
       break;
     }
@@ -230,6 +334,17 @@ void TextureCache::CompletedSubmissionUpdated(
       // any texture has been destroyed.
       ResetTextureBindings();
     }
+    if (limit_hard_exceeded) {
+      ++textures_destroyed_hard_;
+    } else if (host_budget_exceeded) {
+      ++textures_destroyed_host_budget_;
+    } else {
+      ++textures_destroyed_soft_;
+    }
+    // The host usage is only updated on the next frame, assume the memory of
+    // the texture is returned to the budget.
+    host_memory_budget_excess_ -=
+        std::min(host_memory_budget_excess_, texture->GetHostMemoryUsage());
     // Remove the texture from the map and destroy it via its unique_ptr.
     auto found_texture_it = textures_.find(texture->key());
     assert_true(found_texture_it != textures_.end());
@@ -241,6 +356,12 @@ void TextureCache::CompletedSubmissionUpdated(
   }
   if (destroyed_any) {
     COUNT_profile_set("gpu/texture_cache/textures", textures_.size());
+    COUNT_profile_set("gpu/texture_cache/textures_destroyed_soft",
+                      textures_destroyed_soft_);
+    COUNT_profile_set("gpu/texture_cache/textures_destroyed_hard",
+                      textures_destroyed_hard_);
+    COUNT_profile_set("gpu/texture_cache/textures_destroyed_host_budget",
+                      textures_destroyed_host_budget_);
   }
 }
 
@@ -255,6 +376,86 @@ void TextureCache::BeginFrame() {
   // sure bindings are reset so a new attempt will surely be made if the texture
   // is requested again.
   ResetTextureBindings();
+
+  ++current_frame_index_;
+
+  if (cvars::texture_cache_recompression_candidate_frames) {
+    uint64_t recompression_candidates_memory_usage = 0;
+    uint32_t recompression_candidates = 0;
+    auto global_lock = global_critical_region_.Acquire();
+    for (const auto& texture_pair : textures_) {
+      const Texture& texture = *texture_pair.second;
+      if (IsTextureRecompressionCandidate(texture, global_lock)) {
+        recompression_candidates_memory_usage += texture.GetHostMemoryUsage();
+        ++recompression_candidates;
+      }
+    }
+    COUNT_profile_set("gpu/texture_cache/recompression_candidates",
+                      recompression_candidates);
+    COUNT_profile_set("gpu/texture_cache/recompression_candidates_mb",
+                      recompression_candidates_memory_usage >> 20);
+  }
+
+  if (cvars::texture_cache_deferred_base_frames) {
+    COUNT_profile_set("gpu/texture_cache/deferred_base_mb",
+                      deferred_base_bytes_ >> 20);
+    COUNT_profile_set("gpu/texture_cache/deferred_base_never_loaded_mb",
+                      deferred_base_bytes_never_loaded_ >> 20);
+  }
+
+  if (cvars::texture_cache_content_hash) {
+    COUNT_profile_set("gpu/texture_cache/content_hash_us",
+                      content_hash_ticks_ * 1000000 /
+                          xe::Clock::QueryHostTickFrequency());
+    COUNT_profile_set("gpu/texture_cache/content_hash_loads_skipped",
+                      content_hash_loads_skipped_);
+    COUNT_profile_set("gpu/texture_cache/content_hash_loads_copied",
+                      content_hash_loads_copied_);
+    content_hash_ticks_ = 0;
+    content_hash_loads_skipped_ = 0;
+    content_hash_loads_copied_ = 0;
+  }
+
+  if (replacement_pack_) {
+    replacement_pack_->Trim(
+        current_frame_index_,
+        uint64_t(cvars::texture_replacement_mapped_limit_mb) << 20);
+    COUNT_profile_set("gpu/texture_cache/replacements_found",
+                      replacements_found_);
+    COUNT_profile_set("gpu/texture_cache/replacements_loaded",
+                      replacements_loaded_);
+    COUNT_profile_set("gpu/texture_cache/replacement_mapped_mb",
+                      replacement_pack_->mapped_bytes() >> 20);
+    replacements_found_ = 0;
+    replacements_loaded_ = 0;
+  }
+
+  if (cvars::texture_cache_resolve_aliasing) {
+    COUNT_profile_set("gpu/texture_cache/resolve_alias_candidates",
+                      resolve_alias_candidates_);
+    COUNT_profile_set("gpu/texture_cache/resolve_alias_loads",
+                      resolve_alias_loads_);
+    resolve_alias_candidates_ = 0;
+    resolve_alias_loads_ = 0;
+  }
+
+  // Query the host budget once per frame, the usage reported by the host
+  // changes with a delay anyway.
+  host_memory_budget_excess_ = 0;
+  uint64_t host_memory_usage, host_memory_budget;
+  if (cvars::texture_cache_memory_limit_host_budget &&
+      QueryHostMemoryBudget(host_memory_usage, host_memory_budget)) {
+    uint64_t host_memory_budget_limit =
+        host_memory_budget / 100 *
+        std::min(cvars::texture_cache_memory_limit_host_budget, uint32_t(100));
+    if (host_memory_usage > host_memory_budget_limit) {
+      host_memory_budget_excess_ = host_memory_usage - host_memory_budget_limit;
+    }
+    COUNT_profile_set("gpu/texture_cache/host_memory_budget_mb",
+                      host_memory_budget >> 20);
+    COUNT_profile_set("gpu/texture_cache/host_memory_budget_usage_mb",
+                      host_memory_usage >> 20);
+  }
 }
 
 void TextureCache::MarkRangeAsResolved(uint32_t start_unscaled,
@@ -289,6 +490,37 @@ void TextureCache::MarkRangeAsResolved(uint32_t start_unscaled,
   shared_memory().RangeWrittenByGpu(start_unscaled, length_unscaled, true);
 }
 
+void TextureCache::MarkResolveDestination(
+    const draw_util::ResolveInfo& resolve_info) {
+  if (!cvars::texture_cache_resolve_aliasing ||
+      !resolve_info.copy_dest_extent_length) {
+    return;
+  }
+  uint32_t extent_start = resolve_info.copy_dest_extent_start & 0x1FFFFFFF;
+  uint32_t extent_end = extent_start + resolve_info.copy_dest_extent_length;
+  auto global_lock = global_critical_region_.Acquire();
+  // The older destinations overlapping this one don't contain what was
+  // resolved to them anymore.
+  for (ResolveDestination& destination : resolve_destinations_) {
+    if (!destination.valid) {
+      continue;
+    }
+    uint32_t destination_start =
+        destination.resolve_info.copy_dest_extent_start & 0x1FFFFFFF;
+    if (destination_start < extent_end &&
+        extent_start < destination_start +
+                           destination.resolve_info.copy_dest_extent_length) {
+      destination.valid = false;
+    }
+  }
+  ResolveDestination& destination =
+      resolve_destinations_[resolve_destination_next_];
+  destination.resolve_info = resolve_info;
+  destination.valid = true;
+  resolve_destination_next_ =
+      (resolve_destination_next_ + 1) % kResolveDestinationCount;
+}
+
 uint32_t TextureCache::GuestToHostSwizzle(uint32_t guest_swizzle,
                                           uint32_t host_format_swizzle) {
   uint32_t host_swizzle = 0;
@@ -470,7 +702,8 @@ TextureCache::Texture::Texture(TextureCache& texture_cache,
       last_usage_submission_index_(texture_cache.current_submission_index_),
       last_usage_time_(texture_cache.current_submission_time_),
       used_previous_(texture_cache.texture_used_last_),
-      used_next_(nullptr) {
+      used_next_(nullptr),
+      creation_frame_index_(texture_cache.current_frame_index_) {
   if (texture_cache.texture_used_last_) {
     texture_cache.texture_used_last_->used_next_ = this;
   } else {
@@ -481,6 +714,14 @@ TextureCache::Texture::Texture(TextureCache& texture_cache,
   // Never try to upload data that doesn't exist.
   base_outdated_ = guest_layout().base.level_data_extent_bytes != 0;
   mips_outdated_ = guest_layout().mips_total_extent_bytes != 0;
+
+  // Only defer the base when it's not in the packed mip tail together with the
+  // mips, and its data is written by the CPU.
+  if (cvars::texture_cache_deferred_base_frames && !key.scaled_resolve &&
+      base_outdated_ && mips_outdated_ && guest_layout().packed_level != 0) {
+    base_deferred_ = true;
+    texture_cache.deferred_base_bytes_ += GetGuestBaseSize();
+  }
 }
 
 TextureCache::Texture::~Texture() {
@@ -502,13 +743,40 @@ TextureCache::Texture::~Texture() {
     texture_cache_.texture_used_last_ = used_previous_;
   }
 
+  ClearContentHash();
+
+  if (base_deferred_) {
+    texture_cache_.deferred_base_bytes_ -= GetGuestBaseSize();
+    texture_cache_.deferred_base_bytes_never_loaded_ += GetGuestBaseSize();
+  }
+
   texture_cache_.UpdateTexturesTotalHostMemoryUsage(0, host_memory_usage_);
 }
 
+void TextureCache::Texture::SetContentHash(uint64_t content_hash) {
+  ClearContentHash();
+  content_hash_valid_ = true;
+  content_hash_ = content_hash;
+  texture_cache_.content_hash_textures_[GetContentHashTexturesKey(
+      key(), content_hash)] = this;
+}
+
+void TextureCache::Texture::ClearContentHash() {
+  if (!content_hash_valid_) {
+    return;
+  }
+  content_hash_valid_ = false;
+  auto it = texture_cache_.content_hash_textures_.find(
+      GetContentHashTexturesKey(key(), content_hash_));
+  if (it != texture_cache_.content_hash_textures_.end() && it->second == this) {
+    texture_cache_.content_hash_textures_.erase(it);
+  }
+}
+
 void TextureCache::Texture::MakeUpToDateAndWatch(
     const global_unique_lock_type& global_lock) {
   SharedMemory& shared_memory = texture_cache().shared_memory();
-  if (base_outdated_) {
+  if (base_outdated_ && !base_deferred_) {
     assert_not_zero(GetGuestBaseSize());
     base_outdated_ = false;
     base_watch_handle_ = shared_memory.WatchMemoryRange(
@@ -522,6 +790,15 @@ void TextureCache::Texture::MakeUpToDateAndWatch(
         key().mip_page << 12, GetGuestMipsSize(), TextureCache::WatchCallback,
         this, nullptr, 1);
   }
+  last_load_frame_index_ = texture_cache_.current_frame_index_;
+}
+
+void TextureCache::Texture::EndBaseDeferral() {
+  if (!base_deferred_) {
+    return;
+  }
+  base_deferred_ = false;
+  texture_cache_.deferred_base_bytes_ -= GetGuestBaseSize();
 }
 
 void TextureCache::Texture::MarkAsUsed() {
@@ -658,7 +935,8 @@ void TextureCache::LoadTexturesData(Texture** textures, uint32_t n_textures) {
     for (uint32_t i = 0; i < n_textures; ++i) {
       Texture* current = textures[i];
 
-      auto base_outdated = current->base_outdated(global_lock);
+      auto base_outdated = current->base_outdated(global_lock) &&
+                           !IsBaseLoadDeferred(*current);
       auto mips_outdated = current->mips_outdated(global_lock);
 
       index_base_outdated |= static_cast<uint64_t>(base_outdated) << i;
@@ -733,9 +1011,10 @@ void TextureCache::LoadTexturesData(Texture** textures, uint32_t n_textures) {
     }
 
     // Actually load the texture data.
-    if (!LoadTextureDataFromResidentMemoryImpl(
+    if (!LoadTextureDataFromResidentMemory(
             texture, (index_base_outdated & (1ULL << i)) != 0,
-            (index_mips_outdated & (1ULL << i)) != 0)) {
+            (index_mips_outdated & (1ULL << i)) != 0,
+            base_resolved || mips_resolved)) {
       continue;
     }
 
@@ -772,7 +1051,8 @@ bool TextureCache::LoadTextureData(Texture& texture) {
   bool base_outdated, mips_outdated;
   {
     auto global_lock = global_critical_region_.Acquire();
-    base_outdated = texture.base_outdated(global_lock);
+    base_outdated =
+        texture.base_outdated(global_lock) && !IsBaseLoadDeferred(texture);
     mips_outdated = texture.mips_outdated(global_lock);
   }
   if (!base_outdated && !mips_outdated) {
@@ -828,9 +1108,35 @@ bool TextureCache::LoadTextureData(Texture& texture) {
     }
   }
 
+  // With texture_cache_resolve_aliasing, try writing the base directly from
+  // the render target it has been resolved from.
+  bool load_base = base_outdated;
+  if (load_base && base_resolved && cvars::texture_cache_resolve_aliasing) {
+    draw_util::ResolveInfo resolve_info;
+    bool resolve_destination_found = false;
+    {
+      auto global_lock = global_critical_region_.Acquire();
+      const draw_util::ResolveInfo* resolve_destination =
+          FindResolveDestination(texture_key, global_lock);
+      if (resolve_destination) {
+        resolve_info = *resolve_destination;
+        resolve_destination_found = true;
+      }
+    }
+    if (resolve_destination_found) {
+      ++resolve_alias_candidates_;
+      if (LoadTextureDataFromResolveImpl(texture, resolve_info)) {
+        ++resolve_alias_loads_;
+        texture.ClearContentHash();
+        load_base = false;
+      }
+    }
+  }
+
   // Actually load the texture data.
-  if (!LoadTextureDataFromResidentMemoryImpl(texture, base_outdated,
-                                             mips_outdated)) {
+  if ((load_base || mips_outdated) &&
+      !LoadTextureDataFromResidentMemory(texture, load_base, mips_outdated,
+                                         base_resolved || mips_resolved)) {
     return false;
   }
 
@@ -975,6 +1281,137 @@ void TextureCache::UpdateTexturesTotalHostMemoryUsage(uint64_t add,
                              20));
 }
 
+uint64_t TextureCache::GetContentHashTexturesKey(const TextureKey& key,
+                                                 uint64_t content_hash) {
+  // The guest layout depends on whether the base and the mips are present, and
+  // the mips may be stored in the same place as the base.
+  TextureKey layout_key = key;
+  layout_key.base_page = key.base_page ? 1 : 0;
+  layout_key.mip_page =
+      key.mip_page ? (key.mip_page == key.base_page ? 1 : 2) : 0;
+  return XXH3_64bits_withSeed(&layout_key, sizeof(layout_key), content_hash);
+}
+
+bool TextureCache::IsTextureRecompressionCandidate(
+    const Texture& texture, const global_unique_lock_type& global_lock) const {
+  const TextureKey& key = texture.key();
+  // Resolve targets are rewritten by the GPU, and outdated textures have been
+  // written to since loading.
+  if (key.scaled_resolve || texture.IsResolved() ||
+      texture.base_outdated(global_lock) ||
+      texture.mips_outdated(global_lock)) {
+    return false;
+  }
+  switch (key.format) {
+    case xenos::TextureFormat::k_8_8_8_8:
+    case xenos::TextureFormat::k_16_16_16_16_FLOAT:
+      break;
+    default:
+      return false;
+  }
+  // Small textures, such as lookup tables, are not worth it and are likely to
+  // be sampled without filtering, where the precision matters.
+  if (key.GetWidth() < 64 || key.GetHeight() < 64) {
+    return false;
+  }
+  uint64_t last_load_frame_index = texture.last_load_frame_index();
+  return last_load_frame_index &&
+         current_frame_index_ - last_load_frame_index >=
+             cvars::texture_cache_recompression_candidate_frames;
+}
+
+bool TextureCache::IsBaseLoadDeferred(Texture& texture) {
+  if (!texture.base_deferred()) {
+    return false;
+  }
+  if (current_frame_index_ - texture.creation_frame_index() <
+      cvars::texture_cache_deferred_base_frames) {
+    return true;
+  }
+  texture.EndBaseDeferral();
+  return false;
+}
+
+bool TextureCache::LoadTextureDataFromResidentMemory(Texture& texture,
+                                                     bool load_base,
+                                                     bool load_mips,
+                                                     bool resolved) {
+  const TextureKey& texture_key = texture.key();
+  // Resolved data is written by the GPU, not present in the guest memory seen
+  // by the CPU. With the base deferred, not all of the hashed data is loaded.
+  if (!cvars::texture_cache_content_hash || texture_key.scaled_resolve ||
+      resolved || texture.base_deferred()) {
+    texture.ClearContentHash();
+    return LoadTextureDataFromResidentMemoryImpl(texture, load_base, load_mips);
+  }
+
+  // Hash the whole content, not only the outdated parts, as the parts not
+  // reloaded stay in the host data.
+  uint64_t hash_start_ticks = xe::Clock::QueryHostTickCount();
+  const Memory& memory = shared_memory().memory();
+  uint64_t content_hash = 0;
+  uint32_t guest_base_size = texture.GetGuestBaseSize();
+  if (guest_base_size) {
+    content_hash = XXH3_64bits(
+        memory.TranslatePhysical(texture_key.base_page << 12), guest_base_size);
+  }
+  uint32_t guest_mips_size = texture.GetGuestMipsSize();
+  if (guest_mips_size) {
+    content_hash = XXH3_64bits_withSeed(
+        memory.TranslatePhysical(texture_key.mip_page << 12), guest_mips_size,
+        content_hash);
+  }
+  content_hash_ticks_ += xe::Clock::QueryHostTickCount() - hash_start_ticks;
+
+  if (texture.content_hash_valid() && texture.content_hash() == content_hash) {
+    // Rewritten with the same data.
+    ++content_hash_loads_skipped_;
+    return true;
+  }
+
+  if (cvars::texture_replacement_log_hashes) {
+    XELOGI("Texture content hash {:016X}: {}x{}x{} {}", content_hash,
+           texture_key.GetWidth(), texture_key.GetHeight(),
+           texture_key.GetDepthOrArraySize(),
+           FormatInfo::GetName(texture_key.format));
+  }
+
+  if (replacement_pack_) {
+    const TextureReplacementPack::Replacement* replacement =
+        replacement_pack_->Acquire(content_hash, current_frame_index_);
+    if (replacement) {
+      ++replacements_found_;
+      if (LoadTextureDataFromReplacementImpl(texture, *replacement)) {
+        ++replacements_loaded_;
+        texture.SetContentHash(content_hash);
+        return true;
+      }
+    }
+  }
+
+  auto source_it = content_hash_textures_.find(
+      GetContentHashTexturesKey(texture_key, content_hash));
+  if (source_it != content_hash_textures_.end()) {
+    Texture& source = *source_it->second;
+    // The host data of the source stays the same until it's reloaded, which
+    // will update its content hash, even if its guest memory has been
+    // modified since.
+    if (&source != &texture && source.content_hash() == content_hash &&
+        CopyTextureDataImpl(texture, source)) {
+      ++content_hash_loads_copied_;
+      texture.SetContentHash(content_hash);
+      return true;
+    }
+  }
+
+  if (!LoadTextureDataFromResidentMemoryImpl(texture, load_base, load_mips)) {
+    texture.ClearContentHash();
+    return false;
+  }
+  texture.SetContentHash(content_hash);
+  return true;
+}
+
 bool TextureCache::IsRangeScaledResolved(uint32_t start_unscaled,
                                          uint32_t length_unscaled) {
   if (!IsDrawResolutionScaled()) {
@@ -1026,6 +1463,77 @@ bool TextureCache::IsRangeScaledResolved(uint32_t start_unscaled,
   return false;
 }
 
+const draw_util::ResolveInfo* TextureCache::FindResolveDestination(
+    const TextureKey& key, const global_unique_lock_type& global_lock) const {
+  // Only 2D textures with the same layout as the resolve destination, not
+  // containing anything not written by the resolve. Depth is stored on the
+  // host differently in render targets and in textures, so it's not aliased.
+  if (key.dimension != xenos::DataDimension::k2DOrStacked ||
+      key.depth_or_array_size_minus_1 || !key.tiled) {
+    return nullptr;
+  }
+  uint32_t texture_base = key.base_page << 12;
+  // Starting from the newest.
+  for (uint32_t i = 1; i <= kResolveDestinationCount; ++i) {
+    const ResolveDestination& destination =
+        resolve_destinations_[(resolve_destination_next_ +
+                               kResolveDestinationCount - i) %
+                              kResolveDestinationCount];
+    if (!destination.valid) {
+      continue;
+    }
+    const draw_util::ResolveInfo& resolve_info = destination.resolve_info;
+    if ((resolve_info.copy_dest_base & 0x1FFFFFFF) != texture_base ||
+        resolve_info.IsCopyingDepth() ||
+        resolve_info.copy_dest_info.copy_dest_array ||
+        resolve_info.copy_dest_coordinate_info.offset_x_div_8 ||
+        resolve_info.copy_dest_coordinate_info.offset_y_div_8 ||
+        resolve_info.copy_dest_coordinate_info.pitch_aligned_div_32 !=
+            key.pitch ||
+        xenos::TextureFormat(resolve_info.copy_dest_info.copy_dest_format) !=
+            key.format ||
+        key.GetWidth() > (resolve_info.coordinate_info.width_div_8
+                          << xenos::kResolveAlignmentPixelsLog2) ||
+        key.GetHeight() >
+            (resolve_info.height_div_8 << xenos::kResolveAlignmentPixelsLog2)) {
+      continue;
+    }
+    return &resolve_info;
+  }
+  return nullptr;
+}
+
+void TextureCache::ResolveDestinationGlobalWatchCallbackThunk(
+    const global_unique_lock_type& global_lock, void* context,
+    uint32_t address_first, uint32_t address_last, bool invalidated_by_gpu) {
+  TextureCache* texture_cache = reinterpret_cast<TextureCache*>(context);
+  texture_cache->ResolveDestinationGlobalWatchCallback(
+      global_lock, address_first, address_last, invalidated_by_gpu);
+}
+
+void TextureCache::ResolveDestinationGlobalWatchCallback(
+    const global_unique_lock_type& global_lock, uint32_t address_first,
+    uint32_t address_last, bool invalidated_by_gpu) {
+  if (invalidated_by_gpu) {
+    // Resolves replace the destinations themselves in MarkResolveDestination.
+    return;
+  }
+  for (ResolveDestination& destination : resolve_destinations_) {
+    if (!destination.valid) {
+      continue;
+    }
+    uint32_t destination_first =
+        destination.resolve_info.copy_dest_extent_start & 0x1FFFFFFF;
+    uint32_t destination_last =
+        destination_first + destination.resolve_info.copy_dest_extent_length -
+        1;
+    if (destination_first <= address_last &&
+        address_first <= destination_last) {
+      destination.valid = false;
+    }
+  }
+}
+
 void TextureCache::ScaledResolveGlobalWatchCallbackThunk(
     const global_unique_lock_type& global_lock, void* context,
     uint32_t address_first, uint32_t address_last, bool invalidated_by_gpu) {
@@ -21,8 +21,10 @@
 #include "xenia/base/hash.h"
 #include "xenia/base/math.h"
 #include "xenia/base/mutex.h"
+#include "xenia/gpu/draw_util.h"
 #include "xenia/gpu/register_file.h"
 #include "xenia/gpu/shared_memory.h"
+#include "xenia/gpu/texture_replacement.h"
 #include "xenia/gpu/texture_util.h"
 #include "xenia/gpu/xenos.h"
 
@@ -85,11 +87,20 @@ class TextureCache {
 
   virtual void ClearCache();
 
+  uint64_t textures_total_host_memory_usage() const {
+    return textures_total_host_memory_usage_;
+  }
+
   virtual void CompletedSubmissionUpdated(uint64_t completed_submission_index);
   virtual void BeginSubmission(uint64_t new_submission_index);
   virtual void BeginFrame();
 
   void MarkRangeAsResolved(uint32_t start_unscaled, uint32_t length_unscaled);
+  // With texture_cache_resolve_aliasing, remembers the destination of a resolve
+  // copy done after MarkRangeAsResolved, so textures sampled from exactly the
+  // resolved region can be written by the implementation directly from the
+  // render target instead of being loaded from the resolved memory.
+  void MarkResolveDestination(const draw_util::ResolveInfo& resolve_info);
   // Ensures the memory backing the range in the scaled resolve address space is
   // allocated and returns whether it is.
   virtual bool EnsureScaledResolveMemoryCommitted(
@@ -138,6 +149,19 @@ class TextureCache {
     return (binding->texture && binding->texture->IsResolved()) ||
            (binding->texture_signed && binding->texture_signed->IsResolved());
   }
+  // Whether the base level of the texture hasn't been loaded yet with
+  // texture_cache_deferred_base_frames, and sampling must be clamped to the
+  // mips.
+  bool IsActiveTextureBaseDeferred(uint32_t fetch_constant_index) const {
+    const TextureBinding* binding =
+        GetValidTextureBinding(fetch_constant_index);
+    if (!binding) {
+      return false;
+    }
+    return (binding->texture && binding->texture->base_deferred()) ||
+           (binding->texture_signed &&
+            binding->texture_signed->base_deferred());
+  }
   template <swcache::PrefetchTag tag>
   void PrefetchTextureBinding(uint32_t fetch_constant_index) const {
     swcache::Prefetch<tag>(&texture_bindings_[fetch_constant_index]);
@@ -257,13 +281,27 @@ class TextureCache {
     }
     bool IsResolved() const { return base_resolved_ || mips_resolved_; }
 
+    // Hash of the guest data that the current host data has been loaded from,
+    // if known (with texture_cache_content_hash).
+    bool content_hash_valid() const { return content_hash_valid_; }
+    uint64_t content_hash() const { return content_hash_; }
+    void SetContentHash(uint64_t content_hash);
+    void ClearContentHash();
+
     bool base_outdated(const global_unique_lock_type& global_lock) const {
       return base_outdated_;
     }
     bool mips_outdated(const global_unique_lock_type& global_lock) const {
       return mips_outdated_;
     }
+    // The base level is neither loaded nor watched while deferred.
     void MakeUpToDateAndWatch(const global_unique_lock_type& global_lock);
+    bool base_deferred() const { return base_deferred_; }
+    void EndBaseDeferral();
+    uint64_t creation_frame_index() const { return creation_frame_index_; }
+    // The frame when the data was last loaded (or found to be the same after
+    // a write).
+    uint64_t last_load_frame_index() const { return last_load_frame_index_; }
 
     void WatchCallback(const global_unique_lock_type& global_lock, bool is_mip);
 
@@ -314,6 +352,15 @@ class TextureCache {
     // Watch handles for the memory ranges.
     SharedMemory::WatchHandle base_watch_handle_ = nullptr;
     SharedMemory::WatchHandle mips_watch_handle_ = nullptr;
+
+    bool content_hash_valid_ = false;
+    uint64_t content_hash_ = 0;
+
+    uint64_t last_load_frame_index_ = 0;
+
+    uint64_t creation_frame_index_;
+    // Whether only the mips are loaded (texture_cache_deferred_base_frames).
+    bool base_deferred_ = false;
   };
 
   // Rules of data access in load shaders:
@@ -558,6 +605,15 @@ class TextureCache {
   // failure, it should return nullptr), modifying it is not allowed.
   virtual std::unique_ptr<Texture> CreateTexture(TextureKey key) = 0;
 
+  // Returns the current video memory usage of the whole process and the budget
+  // given to it by the host, in bytes, if the host API provides them. If the
+  // usage exceeds the texture_cache_memory_limit_host_budget part of the
+  // budget, unused textures are destroyed regardless of the fixed limits.
+  virtual bool QueryHostMemoryBudget(uint64_t& usage_out,
+                                     uint64_t& budget_out) const {
+    return false;
+  }
+
   // Returns nullptr not only if the key is not supported, but also if couldn't
   // create the texture - if it's nullptr, occasionally a recreation attempt
   // should be made.
@@ -577,6 +633,31 @@ class TextureCache {
   virtual bool LoadTextureDataFromResidentMemoryImpl(Texture& texture,
                                                      bool load_base,
                                                      bool load_mips) = 0;
+  // Copies all the host data from a texture with the same key apart from the
+  // addresses, and with the same guest content, instead of loading it from the
+  // memory, with texture_cache_content_hash. If returning false, the data will
+  // be loaded normally.
+  virtual bool CopyTextureDataImpl(Texture& texture, Texture& source) {
+    return false;
+  }
+  // Uploads the data from a replacement pack file, found by the guest content
+  // hash, to the host texture instead of loading the guest data. The
+  // replacement may be larger than the guest texture. If returning false, the
+  // data will be loaded normally.
+  virtual bool LoadTextureDataFromReplacementImpl(
+      Texture& texture,
+      const TextureReplacementPack::Replacement& replacement) {
+    return false;
+  }
+  // With texture_cache_resolve_aliasing, writes the base level of a texture
+  // fully covered by the destination of a recent resolve, not modified by the
+  // CPU since, from the render target the data was resolved from, instead of
+  // loading the resolved data from the memory. If returning false, the data
+  // will be loaded normally.
+  virtual bool LoadTextureDataFromResolveImpl(
+      Texture& texture, const draw_util::ResolveInfo& resolve_info) {
+    return false;
+  }
 
   // Converts a texture fetch constant to a texture key, normalizing and
   // validating the values, or creating an invalid key, and also gets the
@@ -602,11 +683,41 @@ class TextureCache {
  private:
   void UpdateTexturesTotalHostMemoryUsage(uint64_t add, uint64_t subtract);
 
+  // Key of a texture in content_hash_textures_ - the hash of the guest content
+  // and of the texture key with the addresses excluded.
+  static uint64_t GetContentHashTexturesKey(const TextureKey& key,
+                                            uint64_t content_hash);
+  // Calls LoadTextureDataFromResidentMemoryImpl, or, with
+  // texture_cache_content_hash, skips the load if the host data already has
+  // the same guest content, or copies it from another texture if possible.
+  bool LoadTextureDataFromResidentMemory(Texture& texture, bool load_base,
+                                         bool load_mips, bool resolved);
+  // For texture_cache_deferred_base_frames, whether the base level of the
+  // texture should still not be loaded, ending the deferral otherwise.
+  bool IsBaseLoadDeferred(Texture& texture);
+  // For texture_cache_recompression_candidate_frames.
+  bool IsTextureRecompressionCandidate(
+      const Texture& texture, const global_unique_lock_type& global_lock) const;
+
   // Shared memory callback for texture data invalidation.
   static void WatchCallback(const global_unique_lock_type& global_lock,
                             void* context, void* data, uint64_t argument,
                             bool invalidated_by_gpu);
 
+  // Returns the most recent resolve destination remembered with
+  // MarkResolveDestination that fully covers the base level of the texture and
+  // that is located exactly at its base address, or nullptr if there's none.
+  const draw_util::ResolveInfo* FindResolveDestination(
+      const TextureKey& key, const global_unique_lock_type& global_lock) const;
+  // Global shared memory invalidation callback for forgetting resolve
+  // destinations modified by the CPU.
+  static void ResolveDestinationGlobalWatchCallbackThunk(
+      const global_unique_lock_type& global_lock, void* context,
+      uint32_t address_first, uint32_t address_last, bool invalidated_by_gpu);
+  void ResolveDestinationGlobalWatchCallback(
+      const global_unique_lock_type& global_lock, uint32_t address_first,
+      uint32_t address_last, bool invalidated_by_gpu);
+
   // Checks if there are any pages that contain scaled resolve data within the
   // range.
   bool IsRangeScaledResolved(uint32_t start_unscaled, uint32_t length_unscaled);
@@ -640,13 +751,66 @@ class TextureCache {
   // Global watch for scaled resolve data invalidation.
   SharedMemory::GlobalWatchHandle scaled_resolve_global_watch_handle_ = nullptr;
 
+  // With texture_cache_resolve_aliasing, the destinations of the latest
+  // resolves not overwritten by the CPU or by other resolves since, as a ring
+  // buffer, protected by global_critical_region_. Post-processing chains
+  // usually sample the result of a resolve right after it, so only a few are
+  // kept.
+  struct ResolveDestination {
+    draw_util::ResolveInfo resolve_info;
+    bool valid = false;
+  };
+  static constexpr uint32_t kResolveDestinationCount = 8;
+  std::array<ResolveDestination, kResolveDestinationCount>
+      resolve_destinations_;
+  uint32_t resolve_destination_next_ = 0;
+  SharedMemory::GlobalWatchHandle resolve_destination_global_watch_handle_ =
+      nullptr;
+  // Statistics of texture_cache_resolve_aliasing for the current frame.
+  uint32_t resolve_alias_candidates_ = 0;
+  uint32_t resolve_alias_loads_ = 0;
+
   uint64_t current_submission_index_ = 0;
   uint64_t current_submission_time_ = 0;
+  uint64_t current_frame_index_ = 0;
+
+  // Textures with a valid content hash by GetContentHashTexturesKey, for
+  // sharing the loaded data between textures with the same guest content at
+  // different addresses. Declared before textures_ as textures remove
+  // themselves from it on destruction.
+  std::unordered_map<uint64_t, Texture*> content_hash_textures_;
+  // Statistics of texture_cache_content_hash for the current frame.
+  uint64_t content_hash_ticks_ = 0;
+  uint32_t content_hash_loads_skipped_ = 0;
+  uint32_t content_hash_loads_copied_ = 0;
+
+  // With texture_replacement_path, the replacements by the content hash.
+  std::unique_ptr<TextureReplacementPack> replacement_pack_;
+  // Statistics of the replacements for the current frame.
+  uint32_t replacements_found_ = 0;
+  uint32_t replacements_loaded_ = 0;
 
   std::unordered_map<TextureKey, std::unique_ptr<Texture>, TextureKey::Hasher>
       textures_;
 
+  // Caps of the texture_cache_memory_limit_* values in low_memory_mode.
+  static constexpr uint32_t kLowMemoryModeLimitSoftMB = 128;
+  static constexpr uint32_t kLowMemoryModeLimitHardMB = 256;
+  static constexpr uint32_t kLowMemoryModeLimitSoftLifetimeMs = 5000;
+
   uint64_t textures_total_host_memory_usage_ = 0;
+  // How much the process video memory usage is above the host budget limit as
+  // of the latest BeginFrame, minus the memory of the textures destroyed since.
+  uint64_t host_memory_budget_excess_ = 0;
+  // Totals for the profiler, by the reason of destruction.
+  uint64_t textures_destroyed_soft_ = 0;
+  uint64_t textures_destroyed_hard_ = 0;
+  uint64_t textures_destroyed_host_budget_ = 0;
+  // Guest base level data of textures currently deferred with
+  // texture_cache_deferred_base_frames, and of textures destroyed before it has
+  // been loaded.
+  uint64_t deferred_base_bytes_ = 0;
+  uint64_t deferred_base_bytes_never_loaded_ = 0;
 
   Texture* texture_used_first_ = nullptr;
   Texture* texture_used_last_ = nullptr;
@@ -126,6 +126,51 @@ void Untile(uint8_t* output_buffer, const uint8_t* input_buffer,
   auto log2_bpp = (input_bytes_per_block / 4) +
                   ((input_bytes_per_block / 2) >> (input_bytes_per_block / 4));
 
+  if (!untile_info->copy_callback) {
+    assert_true(input_bytes_per_block == output_bytes_per_block);
+    uint32_t output_row_offset = 0;
+    for (uint32_t y = 0; y < untile_info->height; y++) {
+      auto input_row_offset = TiledOffset2DRow(
+          untile_info->offset_y + y, untile_info->input_pitch, log2_bpp);
+      uint8_t* output_row = output_buffer + output_row_offset;
+      // Blocks are contiguous in the tiled input within up to 16 bytes, merge
+      // them to copy and swap longer runs at once.
+      uint32_t run_start_x = 0;
+      uint32_t run_input_offset = 0;
+      uint32_t run_length = 0;
+      for (uint32_t x = 0; x < untile_info->width; x++) {
+        uint32_t input_offset =
+            TiledOffset2DColumn(untile_info->offset_x + x,
+                                untile_info->offset_y + y, log2_bpp,
+                                input_row_offset) >>
+            log2_bpp;
+        if (run_length && input_offset == run_input_offset + run_length) {
+          ++run_length;
+          continue;
+        }
+        if (run_length) {
+          CopySwapBlock(
+              untile_info->endian,
+              output_row + run_start_x * output_bytes_per_block,
+              input_buffer + size_t(run_input_offset) * input_bytes_per_block,
+              run_length * output_bytes_per_block);
+        }
+        run_start_x = x;
+        run_input_offset = input_offset;
+        run_length = 1;
+      }
+      if (run_length) {
+        CopySwapBlock(
+            untile_info->endian,
+            output_row + run_start_x * output_bytes_per_block,
+            input_buffer + size_t(run_input_offset) * input_bytes_per_block,
+            run_length * output_bytes_per_block);
+      }
+      output_row_offset += output_pitch;
+    }
+    return;
+  }
+
   // Offset to the current row, in bytes.
   uint32_t output_row_offset = 0;
   for (uint32_t y = 0; y < untile_info->height; y++) {
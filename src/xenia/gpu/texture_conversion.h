@@ -43,7 +43,11 @@ typedef struct UntileInfo {
   uint32_t output_pitch;
   const FormatInfo* input_format_info;
   const FormatInfo* output_format_info;
+  // If empty, the input and the output formats must have the same block size,
+  // and the blocks are copied with CopySwapBlock using the endian, in runs of
+  // blocks contiguous in the tiled input rather than one by one.
   UntileCopyBlockCallback copy_callback;
+  xenos::Endian endian = xenos::Endian::kNone;
 } UntileInfo;
 
 void Untile(uint8_t* output_buffer, const uint8_t* input_buffer,
@@ -0,0 +1,251 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/texture_replacement.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/math.h"
+
+namespace xe {
+namespace gpu {
+
+namespace {
+
+constexpr uint32_t MakeDdsFourCC(char a, char b, char c, char d) {
+  return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) |
+         (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+}
+
+bool ParseContentHash(const std::string& stem, uint64_t& hash_out) {
+  if (stem.size() != 16) {
+    return false;
+  }
+  uint64_t hash = 0;
+  for (char c : stem) {
+    uint32_t digit;
+    if (c >= '0' && c <= '9') {
+      digit = uint32_t(c - '0');
+    } else if (c >= 'A' && c <= 'F') {
+      digit = uint32_t(c - 'A' + 10);
+    } else if (c >= 'a' && c <= 'f') {
+      digit = uint32_t(c - 'a' + 10);
+    } else {
+      return false;
+    }
+    hash = (hash << 4) | digit;
+  }
+  hash_out = hash;
+  return true;
+}
+
+}  // namespace
+
+TextureReplacementPack::TextureReplacementPack(
+    const std::filesystem::path& root) {
+  std::error_code error_code;
+  for (auto it = std::filesystem::recursive_directory_iterator(root,
+                                                               error_code);
+       !error_code && it != std::filesystem::recursive_directory_iterator();
+       it.increment(error_code)) {
+    if (!it->is_regular_file(error_code)) {
+      continue;
+    }
+    const std::filesystem::path& path = it->path();
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](char c) { return char(std::tolower(c)); });
+    uint64_t content_hash;
+    if (extension != ".dds" ||
+        !ParseContentHash(path.stem().string(), content_hash)) {
+      continue;
+    }
+    auto emplace_result = entries_.emplace(content_hash, Entry());
+    if (!emplace_result.second) {
+      XELOGW("Texture replacement: {} duplicates the hash {:016X}, ignoring",
+             xe::path_to_utf8(path), content_hash);
+      continue;
+    }
+    emplace_result.first->second.path = path;
+  }
+  if (error_code) {
+    XELOGW("Texture replacement: failed to enumerate {}: {}",
+           xe::path_to_utf8(root), error_code.message());
+  }
+  XELOGI("Texture replacement: {} replacements found in {}", entries_.size(),
+         xe::path_to_utf8(root));
+}
+
+const TextureReplacementPack::Replacement* TextureReplacementPack::Acquire(
+    uint64_t content_hash, uint64_t frame_index) {
+  auto it = entries_.find(content_hash);
+  if (it == entries_.end()) {
+    return nullptr;
+  }
+  Entry& entry = it->second;
+  if (entry.invalid) {
+    return nullptr;
+  }
+  if (!entry.mapping) {
+    entry.mapping = MappedMemory::Open(entry.path, MappedMemory::Mode::kRead);
+    if (!entry.mapping ||
+        !ParseDds(entry.mapping->data(), entry.mapping->size(),
+                  entry.replacement)) {
+      XELOGE(
+          "Texture replacement: {} is not a valid block-compressed DDS file",
+          xe::path_to_utf8(entry.path));
+      entry.mapping.reset();
+      entry.invalid = true;
+      return nullptr;
+    }
+    mapped_bytes_ += entry.mapping->size();
+  }
+  entry.last_used_frame_index = frame_index;
+  return &entry.replacement;
+}
+
+void TextureReplacementPack::Trim(uint64_t current_frame_index,
+                                  uint64_t mapped_bytes_limit) {
+  if (mapped_bytes_ <= mapped_bytes_limit) {
+    return;
+  }
+  std::vector<std::pair<uint64_t, Entry*>> unmap_candidates;
+  for (auto& entry_pair : entries_) {
+    Entry& entry = entry_pair.second;
+    if (entry.mapping && entry.last_used_frame_index < current_frame_index) {
+      unmap_candidates.emplace_back(entry.last_used_frame_index, &entry);
+    }
+  }
+  std::sort(unmap_candidates.begin(), unmap_candidates.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+  for (const auto& unmap_candidate : unmap_candidates) {
+    if (mapped_bytes_ <= mapped_bytes_limit) {
+      break;
+    }
+    Entry& entry = *unmap_candidate.second;
+    mapped_bytes_ -= entry.mapping->size();
+    entry.mapping.reset();
+  }
+}
+
+bool TextureReplacementPack::ParseDds(const uint8_t* data, size_t size,
+                                      Replacement& replacement_out) {
+  // Magic, then the 124-byte DDS_HEADER, optionally followed by the 20-byte
+  // DDS_HEADER_DXT10.
+  constexpr size_t kHeaderOffset = sizeof(uint32_t);
+  constexpr size_t kHeaderSize = 124;
+  constexpr size_t kDx10HeaderSize = 20;
+  if (size < kHeaderOffset + kHeaderSize) {
+    return false;
+  }
+  uint32_t header[kHeaderSize / sizeof(uint32_t)];
+  std::memcpy(header, data + kHeaderOffset, kHeaderSize);
+  uint32_t magic;
+  std::memcpy(&magic, data, sizeof(magic));
+  if (magic != MakeDdsFourCC('D', 'D', 'S', ' ') || header[0] != kHeaderSize) {
+    return false;
+  }
+  uint32_t flags = header[1];
+  uint32_t height = header[2];
+  uint32_t width = header[3];
+  uint32_t mip_levels = (flags & 0x20000u) ? std::max(header[6], 1u) : 1;
+  // DDS_PIXELFORMAT starts at dword 18 - size, flags, fourCC.
+  if (!(header[19] & 0x4u)) {
+    // Not block-compressed.
+    return false;
+  }
+  uint32_t fourcc = header[20];
+  size_t data_offset = kHeaderOffset + kHeaderSize;
+  Format format;
+  if (fourcc == MakeDdsFourCC('D', 'X', '1', '0')) {
+    if (size < data_offset + kDx10HeaderSize) {
+      return false;
+    }
+    uint32_t dxgi_format;
+    std::memcpy(&dxgi_format, data + data_offset, sizeof(dxgi_format));
+    data_offset += kDx10HeaderSize;
+    switch (dxgi_format) {
+      case 71:  // DXGI_FORMAT_BC1_UNORM
+      case 72:  // DXGI_FORMAT_BC1_UNORM_SRGB
+        format = Format::kBC1;
+        break;
+      case 74:  // DXGI_FORMAT_BC2_UNORM
+      case 75:  // DXGI_FORMAT_BC2_UNORM_SRGB
+        format = Format::kBC2;
+        break;
+      case 77:  // DXGI_FORMAT_BC3_UNORM
+      case 78:  // DXGI_FORMAT_BC3_UNORM_SRGB
+        format = Format::kBC3;
+        break;
+      case 80:  // DXGI_FORMAT_BC4_UNORM
+        format = Format::kBC4;
+        break;
+      case 83:  // DXGI_FORMAT_BC5_UNORM
+        format = Format::kBC5;
+        break;
+      case 95:  // DXGI_FORMAT_BC6H_UF16
+        format = Format::kBC6H;
+        break;
+      case 98:  // DXGI_FORMAT_BC7_UNORM
+      case 99:  // DXGI_FORMAT_BC7_UNORM_SRGB
+        format = Format::kBC7;
+        break;
+      default:
+        return false;
+    }
+  } else if (fourcc == MakeDdsFourCC('D', 'X', 'T', '1')) {
+    format = Format::kBC1;
+  } else if (fourcc == MakeDdsFourCC('D', 'X', 'T', '2') ||
+             fourcc == MakeDdsFourCC('D', 'X', 'T', '3')) {
+    format = Format::kBC2;
+  } else if (fourcc == MakeDdsFourCC('D', 'X', 'T', '4') ||
+             fourcc == MakeDdsFourCC('D', 'X', 'T', '5')) {
+    format = Format::kBC3;
+  } else if (fourcc == MakeDdsFourCC('A', 'T', 'I', '1') ||
+             fourcc == MakeDdsFourCC('B', 'C', '4', 'U')) {
+    format = Format::kBC4;
+  } else if (fourcc == MakeDdsFourCC('A', 'T', 'I', '2') ||
+             fourcc == MakeDdsFourCC('B', 'C', '5', 'U')) {
+    format = Format::kBC5;
+  } else {
+    return false;
+  }
+  if (!width || !height || mip_levels > 16) {
+    return false;
+  }
+  uint32_t bytes_per_block = GetBytesPerBlock(format);
+  size_t data_size = 0;
+  for (uint32_t i = 0; i < mip_levels; ++i) {
+    uint32_t mip_width = std::max(width >> i, 1u);
+    uint32_t mip_height = std::max(height >> i, 1u);
+    data_size += size_t(xe::align(mip_width, 4u) / 4) *
+                 (xe::align(mip_height, 4u) / 4) * bytes_per_block;
+  }
+  if (size < data_offset + data_size) {
+    return false;
+  }
+  replacement_out.width = width;
+  replacement_out.height = height;
+  replacement_out.mip_levels = mip_levels;
+  replacement_out.format = format;
+  replacement_out.data = data + data_offset;
+  replacement_out.data_size = data_size;
+  return true;
+}
+
+}  // namespace gpu
+}  // namespace xe
@@ -0,0 +1,96 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_TEXTURE_REPLACEMENT_H_
+#define XENIA_GPU_TEXTURE_REPLACEMENT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <unordered_map>
+
+#include "xenia/base/mapped_memory.h"
+
+namespace xe {
+namespace gpu {
+
+// A directory of replacement textures for guest textures, keyed by the hash of
+// the guest texture content (the one calculated with
+// texture_cache_content_hash). Each replacement is a block-compressed DDS file
+// named after the hash as 16 hexadecimal digits, such as
+// 0123456789ABCDEF.dds, in any subdirectory of the pack.
+//
+// Files are only indexed when the pack is opened, and are memory-mapped when a
+// texture with their hash is loaded, so the OS pages them in on demand. The
+// amount of mapped data is limited by unmapping replacements not used recently.
+class TextureReplacementPack {
+ public:
+  enum class Format : uint32_t {
+    kBC1,
+    kBC2,
+    kBC3,
+    kBC4,
+    kBC5,
+    kBC6H,
+    kBC7,
+  };
+
+  static constexpr uint32_t GetBytesPerBlock(Format format) {
+    return (format == Format::kBC1 || format == Format::kBC4) ? 8 : 16;
+  }
+
+  struct Replacement {
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_levels;
+    Format format;
+    // The mips, starting from the largest, each tightly packed, as in DDS.
+    const uint8_t* data;
+    size_t data_size;
+  };
+
+  explicit TextureReplacementPack(const std::filesystem::path& root);
+
+  size_t replacement_count() const { return entries_.size(); }
+  uint64_t mapped_bytes() const { return mapped_bytes_; }
+
+  bool HasReplacement(uint64_t content_hash) const {
+    return entries_.find(content_hash) != entries_.cend();
+  }
+  // Maps the replacement if it's not mapped yet. Returns nullptr if there's no
+  // replacement for the hash or it's not a valid block-compressed DDS file.
+  // The data stays valid until Trim unmaps it, which is never done in the same
+  // frame.
+  const Replacement* Acquire(uint64_t content_hash, uint64_t frame_index);
+  // Unmaps the least recently used replacements, not used in the current
+  // frame, until the mapped data fits in the limit.
+  void Trim(uint64_t current_frame_index, uint64_t mapped_bytes_limit);
+
+ private:
+  struct Entry {
+    std::filesystem::path path;
+    std::unique_ptr<MappedMemory> mapping;
+    Replacement replacement;
+    uint64_t last_used_frame_index = 0;
+    // Set if the file has failed to be opened or parsed, not to retry.
+    bool invalid = false;
+  };
+
+  static bool ParseDds(const uint8_t* data, size_t size,
+                       Replacement& replacement_out);
+
+  std::unordered_map<uint64_t, Entry> entries_;
+  uint64_t mapped_bytes_ = 0;
+};
+
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_TEXTURE_REPLACEMENT_H_
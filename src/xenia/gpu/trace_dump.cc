@@ -9,9 +9,16 @@
 
 #include "xenia/gpu/trace_dump.h"
 
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
 #include "third_party/stb/stb_image_write.h"
+#include "xenia/base/clock.h"
 #include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
+#include "xenia/base/math.h"
 #include "xenia/base/profiling.h"
 #include "xenia/base/string.h"
 #include "xenia/base/threading.h"
@@ -30,6 +37,15 @@
 
 DEFINE_path(target_trace_file, "", "Specifies the trace file to load.", "GPU");
 DEFINE_path(trace_dump_path, "", "Output path for dumped files.", "GPU");
+DEFINE_int32(trace_dump_benchmark_iterations, 0,
+             "Number of times to replay the whole trace after dumping, writing "
+             "the CPU and GPU timing statistics to a JSON file next to the "
+             "dumped image. 0 to disable benchmarking.",
+             "GPU");
+DEFINE_int32(trace_dump_benchmark_warmup_iterations, 1,
+             "Number of unmeasured replays of the whole trace before the "
+             "benchmark to populate the caches and create the pipelines.",
+             "GPU");
 
 namespace xe {
 namespace gpu {
@@ -146,10 +162,119 @@ int TraceDump::Run() {
     result = 1;
   }
 
+  if (cvars::trace_dump_benchmark_iterations > 0 && !RunBenchmark()) {
+    result = 1;
+  }
+
   player_.reset();
   emulator_.reset();
   return result;
 }
 
+bool TraceDump::RunBenchmark() {
+  CommandProcessor* command_processor = graphics_system_->command_processor();
+  auto call_in_thread_and_wait = [command_processor](std::function<void()> fn) {
+    threading::Fence fence;
+    command_processor->CallInThread([&fence, &fn]() {
+      fn();
+      fence.Signal();
+    });
+    fence.Wait();
+  };
+
+  for (int32_t i = 0; i < cvars::trace_dump_benchmark_warmup_iterations; ++i) {
+    player_->PlayAllFrames();
+    player_->WaitOnPlayback();
+  }
+
+  player_->ResetPacketTimings();
+  player_->set_packet_timing_enabled(true);
+  call_in_thread_and_wait(
+      [command_processor]() { command_processor->BeginBenchmark(); });
+  std::vector<double> iteration_ms;
+  iteration_ms.reserve(size_t(cvars::trace_dump_benchmark_iterations));
+  double ticks_to_ms =
+      1000.0 / static_cast<double>(Clock::QueryHostTickFrequency());
+  for (int32_t i = 0; i < cvars::trace_dump_benchmark_iterations; ++i) {
+    uint64_t start_host_tick_count = Clock::QueryHostTickCount();
+    player_->PlayAllFrames();
+    player_->WaitOnPlayback();
+    iteration_ms.push_back(
+        (Clock::QueryHostTickCount() - start_host_tick_count) * ticks_to_ms);
+  }
+  CommandProcessor::BenchmarkStatistics statistics;
+  call_in_thread_and_wait([command_processor, &statistics]() {
+    statistics = command_processor->EndBenchmark();
+  });
+  player_->set_packet_timing_enabled(false);
+
+  auto json_path = std::filesystem::path(base_output_path_)
+                       .replace_extension(".json");
+  FILE* file = filesystem::OpenFile(json_path, "w");
+  if (!file) {
+    XELOGE("Failed to open {} for writing the benchmark results",
+           xe::path_to_utf8(json_path));
+    return false;
+  }
+  std::string trace_path_escaped;
+  for (char c : xe::path_to_utf8(trace_file_path_)) {
+    if (c == '"' || c == '\\') {
+      trace_path_escaped.push_back('\\');
+    }
+    trace_path_escaped.push_back(c);
+  }
+  fprintf(file, "{\n  \"trace\": \"%s\",\n  \"frames\": %d,\n",
+          trace_path_escaped.c_str(), player_->frame_count());
+  fprintf(file, "  \"warmup_iterations\": %d,\n  \"iterations\": %d,\n",
+          cvars::trace_dump_benchmark_warmup_iterations,
+          cvars::trace_dump_benchmark_iterations);
+  fputs("  \"iteration_ms\": [", file);
+  for (size_t i = 0; i < iteration_ms.size(); ++i) {
+    fprintf(file, "%s%.3f", i ? ", " : "", iteration_ms[i]);
+  }
+  fputs("],\n  \"packets\": {", file);
+  double ticks_to_ns =
+      1000000000.0 / static_cast<double>(Clock::QueryHostTickFrequency());
+  size_t packet_type_count = 0;
+  for (const auto& packet_timing : player_->packet_timings()) {
+    fprintf(file, "%s\n    \"%s\": {\"count\": %llu, \"cpu_ns\": %.0f}",
+            packet_type_count++ ? "," : "", packet_timing.first,
+            static_cast<unsigned long long>(packet_timing.second.count),
+            packet_timing.second.host_ticks * ticks_to_ns);
+  }
+  fprintf(file, "\n  },\n  \"gpu\": {\"supported\": %s",
+          statistics.gpu_timing_supported ? "true" : "false");
+  static const char* const kGpuWorkNames[] = {
+      nullptr,
+      "render_target_update",
+      "texture_load",
+      "draw",
+      "resolve",
+      "present",
+  };
+  static_assert(xe::countof(kGpuWorkNames) ==
+                size_t(CommandProcessor::GpuTimingCategory::kCount));
+  for (size_t i = 1; i < xe::countof(kGpuWorkNames); ++i) {
+    fprintf(file, ", \"%s\": {\"count\": %llu, \"ns\": %llu}",
+            kGpuWorkNames[i],
+            static_cast<unsigned long long>(statistics.gpu_work_count[i]),
+            static_cast<unsigned long long>(statistics.gpu_work_time_ns[i]));
+  }
+  fprintf(file,
+          "},\n  \"pipeline_creation\": {\"stalls\": %llu, "
+          "\"stall_ns\": %llu, \"draws_skipped\": %llu},\n",
+          static_cast<unsigned long long>(statistics.pipeline_creation_stalls),
+          static_cast<unsigned long long>(
+              statistics.pipeline_creation_stall_ns),
+          static_cast<unsigned long long>(
+              statistics.draws_skipped_for_pipeline_creation));
+  fprintf(file, "  \"upload_bytes\": %llu\n}\n",
+          static_cast<unsigned long long>(statistics.upload_bytes));
+  fclose(file);
+  XELOGI("Wrote the benchmark results of {} iterations to {}",
+         cvars::trace_dump_benchmark_iterations, xe::path_to_utf8(json_path));
+  return true;
+}
+
 }  //  namespace gpu
 }  //  namespace xe
@@ -47,6 +47,9 @@ class TraceDump {
   bool Setup();
   bool Load(const std::filesystem::path& trace_file_path);
   int Run();
+  // Replays the whole trace multiple times, writing the timing statistics of
+  // the measured iterations to a JSON file.
+  bool RunBenchmark();
 
   std::filesystem::path trace_file_path_;
   std::filesystem::path base_output_path_;
@@ -9,17 +9,48 @@
 
 #include "xenia/gpu/trace_player.h"
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
 
+#include "third_party/zstd/lib/zstd.h"
+#include "xenia/base/assert.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/logging.h"
 #include "xenia/gpu/command_processor.h"
 #include "xenia/gpu/graphics_system.h"
+#include "xenia/gpu/packet_disassembler.h"
+#include "xenia/gpu/register_file.h"
 #include "xenia/gpu/registers.h"
 #include "xenia/gpu/xenos.h"
 #include "xenia/memory.h"
 
+DEFINE_int32(trace_keyframe_interval, 64,
+             "Interval in frames between the keyframes of the state captured "
+             "during trace playback for faster seeking, or 0 to capture them "
+             "only at the frames sought to. Each keyframe takes the memory of "
+             "the compressed EDRAM and the guest pages changed since the "
+             "previous one.",
+             "GPU");
+
 namespace xe {
 namespace gpu {
 
+namespace {
+
+void CompressKeyframeData(const void* data, size_t size,
+                          std::vector<uint8_t>& compressed_out) {
+  compressed_out.resize(ZSTD_compressBound(size));
+  size_t compressed_size = ZSTD_compress(
+      compressed_out.data(), compressed_out.size(), data, size, 1);
+  assert_false(ZSTD_isError(compressed_size));
+  compressed_out.resize(ZSTD_isError(compressed_size) ? 0 : compressed_size);
+  compressed_out.shrink_to_fit();
+}
+
+}  // namespace
+
 TracePlayer::TracePlayer(GraphicsSystem* graphics_system)
     : graphics_system_(graphics_system),
       current_frame_index_(0),
@@ -34,9 +65,12 @@ TracePlayer::TracePlayer(GraphicsSystem* graphics_system)
 
   playback_event_ = xe::threading::Event::CreateAutoResetEvent(false);
   assert_not_null(playback_event_);
+
+  dirty_pages_.resize(kPageCount, false);
+  written_pages_.resize(kPageCount, false);
 }
 
-const TraceReader::Frame* TracePlayer::current_frame() const {
+const TraceReader::Frame* TracePlayer::current_frame() {
   if (current_frame_index_ >= frame_count()) {
     return nullptr;
   }
@@ -52,39 +86,109 @@ void TracePlayer::SeekFrame(int target_frame) {
   current_command_index_ = int(frame->commands.size()) - 1;
 
   assert_true(frame->start_ptr <= frame->end_ptr);
-  PlayTrace(frame->start_ptr, frame->end_ptr - frame->start_ptr,
-            TracePlaybackMode::kBreakOnSwap, false);
+  PlayTo(target_frame, frame->end_ptr);
 }
 
 void TracePlayer::SeekCommand(int target_command) {
   if (current_command_index_ == target_command) {
     return;
   }
-  int previous_command_index = current_command_index_;
   current_command_index_ = target_command;
+  auto frame = current_frame();
   if (current_command_index_ == -1) {
+    PlayTo(current_frame_index_, frame->start_ptr);
     return;
   }
-  auto frame = current_frame();
   const auto& command = frame->commands[target_command];
   assert_true(frame->start_ptr <= command.end_ptr);
-  if (previous_command_index != -1 && target_command > previous_command_index) {
-    // Seek forward.
-    const auto& previous_command = frame->commands[previous_command_index];
-    PlayTrace(previous_command.end_ptr,
-              command.end_ptr - previous_command.end_ptr,
-              TracePlaybackMode::kBreakOnSwap, false);
-  } else {
-    // Full playback from frame start.
-    PlayTrace(frame->start_ptr, command.end_ptr - frame->start_ptr,
-              TracePlaybackMode::kBreakOnSwap, true);
+  PlayTo(current_frame_index_, command.end_ptr);
+}
+
+void TracePlayer::PlayAllFrames() {
+  int count = frame_count();
+  if (!count) {
+    playback_event_->Set();
+    return;
+  }
+  // Make sure all the frames are decoded.
+  const Frame* first_frame = frame(0);
+  for (int i = 1; i < count; ++i) {
+    frame(i);
   }
+  const Frame* last_frame = frame(count - 1);
+  current_frame_index_ = count - 1;
+  current_command_index_ = int(last_frame->commands.size()) - 1;
+  assert_true(first_frame->start_ptr <= last_frame->end_ptr);
+  PlayTrace(first_frame->start_ptr,
+            last_frame->end_ptr - first_frame->start_ptr,
+            TracePlaybackMode::kUntilEnd, false);
 }
 
 void TracePlayer::WaitOnPlayback() {
   xe::threading::Wait(playback_event_.get(), true);
 }
 
+void TracePlayer::PlayTo(int target_frame, const uint8_t* target_ptr) {
+  playing_trace_ = true;
+  graphics_system_->command_processor()->CallInThread(
+      [this, target_frame, target_ptr]() {
+        PlayToOnThread(target_frame, target_ptr);
+      });
+}
+
+void TracePlayer::PlayToOnThread(int target_frame, const uint8_t* target_ptr) {
+  int keyframe_index = FindKeyframe(target_frame);
+  const uint8_t* keyframe_ptr =
+      keyframe_index >= 0 ? frames_[keyframes_[keyframe_index]->frame].start_ptr
+                          : nullptr;
+  int start_frame;
+  const uint8_t* start_ptr;
+  if (played_ptr_ && played_ptr_ <= target_ptr &&
+      (!keyframe_ptr || keyframe_ptr <= played_ptr_)) {
+    // Continue from the current state if it's not behind the keyframe.
+    start_frame = played_frame_;
+    start_ptr = played_ptr_;
+    // The end of a frame is the start of the next one.
+    while (start_frame < target_frame &&
+           start_ptr >= frames_[start_frame].end_ptr) {
+      ++start_frame;
+    }
+  } else {
+    RestoreKeyframe(keyframe_index);
+    start_frame =
+        keyframe_index >= 0 ? keyframes_[keyframe_index]->frame : 0;
+    start_ptr = frames_[start_frame].start_ptr;
+  }
+  start_frame = std::min(start_frame, target_frame);
+
+  playback_percent_ = 0;
+  playback_range_start_ = start_ptr;
+  playback_range_end_ = target_ptr;
+  if (DecodeStream(uint64_t(start_ptr - stream_),
+                   uint64_t(target_ptr - start_ptr))) {
+    for (int frame = start_frame; frame <= target_frame; ++frame) {
+      const uint8_t* frame_start_ptr =
+          frame == start_frame ? start_ptr : frames_[frame].start_ptr;
+      if (frame_start_ptr == frames_[frame].start_ptr) {
+        OnFrameStart(frame, frame == target_frame);
+      }
+      const uint8_t* frame_end_ptr =
+          frame == target_frame ? target_ptr : frames_[frame].end_ptr;
+      if (frame_end_ptr > frame_start_ptr) {
+        ExecuteCommands(frame_start_ptr, frame_end_ptr - frame_start_ptr,
+                        TracePlaybackMode::kUntilEnd);
+      }
+    }
+    played_ptr_ = target_ptr;
+    played_frame_ = target_frame;
+  } else {
+    played_ptr_ = nullptr;
+  }
+
+  playing_trace_ = false;
+  playback_event_->Set();
+}
+
 void TracePlayer::PlayTrace(const uint8_t* trace_data, size_t trace_size,
                             TracePlaybackMode playback_mode,
                             bool clear_caches) {
@@ -98,24 +202,37 @@ void TracePlayer::PlayTraceOnThread(const uint8_t* trace_data,
                                     size_t trace_size,
                                     TracePlaybackMode playback_mode,
                                     bool clear_caches) {
-  auto memory = graphics_system_->memory();
-  auto command_processor = graphics_system_->command_processor();
-
   if (clear_caches) {
-    command_processor->ClearCaches();
+    graphics_system_->command_processor()->ClearCaches();
   }
 
   playback_percent_ = 0;
-  auto trace_end = trace_data + trace_size;
+  playback_range_start_ = trace_data;
+  playback_range_end_ = trace_data + trace_size;
+  ExecuteCommands(trace_data, trace_size, playback_mode);
+  // Not continuing from a known position anymore.
+  played_ptr_ = nullptr;
+
+  playing_trace_ = false;
+  playback_event_->Set();
+}
+
+bool TracePlayer::ExecuteCommands(const uint8_t* trace_data,
+                                  size_t trace_size,
+                                  TracePlaybackMode playback_mode) {
+  auto memory = graphics_system_->memory();
+  auto command_processor = graphics_system_->command_processor();
 
-  playing_trace_ = true;
   auto trace_ptr = trace_data;
   bool pending_break = false;
   const PacketStartCommand* pending_packet = nullptr;
   while (trace_ptr < trace_data + trace_size) {
-    playback_percent_ = uint32_t(
-        (float(trace_ptr - trace_data) / float(trace_end - trace_data)) *
-        10000);
+    if (playback_range_end_ > playback_range_start_) {
+      playback_percent_ = uint32_t(
+          (float(trace_ptr - playback_range_start_) /
+           float(playback_range_end_ - playback_range_start_)) *
+          10000);
+    }
 
     auto type = static_cast<TraceCommandType>(xe::load<uint32_t>(trace_ptr));
     switch (type) {
@@ -150,6 +267,7 @@ void TracePlayer::PlayTraceOnThread(const uint8_t* trace_data,
         trace_ptr += sizeof(*cmd);
         std::memcpy(memory->TranslatePhysical(cmd->base_ptr), trace_ptr,
                     cmd->count * 4);
+        MarkPagesWritten(cmd->base_ptr, cmd->count * 4);
         trace_ptr += cmd->count * 4;
         pending_packet = cmd;
         break;
@@ -158,13 +276,30 @@ void TracePlayer::PlayTraceOnThread(const uint8_t* trace_data,
         auto cmd = reinterpret_cast<const PacketEndCommand*>(trace_ptr);
         trace_ptr += sizeof(*cmd);
         if (pending_packet) {
-          command_processor->ExecutePacket(pending_packet->base_ptr,
-                                           pending_packet->count);
+          if (packet_timing_enabled_) {
+            PacketInfo packet_info = {};
+            const char* packet_name = "UNKNOWN";
+            if (PacketDisassembler::DisasmPacket(
+                    reinterpret_cast<const uint8_t*>(pending_packet) +
+                        sizeof(PacketStartCommand),
+                    &packet_info)) {
+              packet_name = packet_info.type_info->name;
+            }
+            uint64_t start_host_tick_count = Clock::QueryHostTickCount();
+            command_processor->ExecutePacket(pending_packet->base_ptr,
+                                             pending_packet->count);
+            PacketTiming& packet_timing = packet_timings_[packet_name];
+            ++packet_timing.count;
+            packet_timing.host_ticks +=
+                Clock::QueryHostTickCount() - start_host_tick_count;
+          } else {
+            command_processor->ExecutePacket(pending_packet->base_ptr,
+                                             pending_packet->count);
+          }
           pending_packet = nullptr;
         }
         if (pending_break) {
-          playing_trace_ = false;
-          return;
+          return true;
         }
         break;
       }
@@ -175,6 +310,7 @@ void TracePlayer::PlayTraceOnThread(const uint8_t* trace_data,
                          memory->TranslatePhysical(cmd->base_ptr),
                          cmd->decoded_length);
         trace_ptr += cmd->encoded_length;
+        MarkPagesWritten(cmd->base_ptr, cmd->decoded_length);
         command_processor->TracePlaybackWroteMemory(cmd->base_ptr,
                                                     cmd->decoded_length);
         break;
@@ -242,9 +378,213 @@ void TracePlayer::PlayTraceOnThread(const uint8_t* trace_data,
     }
   }
 
-  playing_trace_ = false;
+  return false;
+}
 
-  playback_event_->Set();
+void TracePlayer::MarkPagesWritten(uint32_t physical_address,
+                                   uint32_t length) {
+  if (!length) {
+    return;
+  }
+  physical_address &= 0x1FFFFFFF;
+  uint32_t first_page = physical_address >> kPageSizeLog2;
+  uint32_t last_page = uint32_t(
+      (std::min(uint64_t(physical_address) + length, uint64_t(0x20000000)) -
+       1) >>
+      kPageSizeLog2);
+  for (uint32_t page = first_page; page <= last_page; ++page) {
+    dirty_pages_[page] = true;
+    written_pages_[page] = true;
+  }
+}
+
+int TracePlayer::FindKeyframe(int frame) const {
+  int keyframe_index = -1;
+  for (size_t i = 0; i < keyframes_.size(); ++i) {
+    int keyframe_frame = keyframes_[i]->frame;
+    if (keyframe_frame <= frame &&
+        (keyframe_index < 0 ||
+         keyframe_frame >= keyframes_[keyframe_index]->frame)) {
+      keyframe_index = int(i);
+    }
+  }
+  return keyframe_index;
+}
+
+void TracePlayer::OnFrameStart(int frame, bool is_target_frame) {
+  // The state at the start of the first frame is the initial one.
+  if (!frame) {
+    return;
+  }
+  for (size_t i = 0; i < keyframes_.size(); ++i) {
+    if (keyframes_[i]->frame == frame) {
+      // Reached the state of an existing keyframe by playing.
+      dirty_base_keyframe_ = int(i);
+      std::fill(dirty_pages_.begin(), dirty_pages_.end(), false);
+      return;
+    }
+  }
+  if (!keyframes_supported_) {
+    return;
+  }
+  if (is_target_frame || (cvars::trace_keyframe_interval > 0 &&
+                          !(frame % cvars::trace_keyframe_interval))) {
+    CaptureKeyframe(frame);
+  }
+}
+
+bool TracePlayer::CaptureKeyframe(int frame) {
+  auto memory = graphics_system_->memory();
+  auto command_processor = graphics_system_->command_processor();
+
+  std::vector<std::pair<uint32_t, uint32_t>> gpu_written_ranges;
+  std::unique_ptr<uint8_t[]> edram_snapshot(
+      new uint8_t[xenos::kEdramSizeBytes]);
+  if (!command_processor->CaptureTracePlaybackState(gpu_written_ranges,
+                                                    edram_snapshot.get())) {
+    XELOGW(
+        "Trace player: the state can't be captured in keyframes, seeking will "
+        "replay the trace from the start");
+    keyframes_supported_ = false;
+    return false;
+  }
+  // The GPU has written some of the memory itself, such as with resolves.
+  for (const auto& range : gpu_written_ranges) {
+    MarkPagesWritten(range.first, range.second);
+  }
+
+  auto keyframe = std::make_unique<Keyframe>();
+  keyframe->frame = frame;
+  keyframe->parent = dirty_base_keyframe_;
+  keyframe->registers.reset(new uint32_t[RegisterFile::kRegisterCount]);
+  std::memcpy(keyframe->registers.get(),
+              graphics_system_->register_file()->values,
+              sizeof(uint32_t) * RegisterFile::kRegisterCount);
+  std::memcpy(keyframe->gamma_ramp_256_entry_table,
+              command_processor->gamma_ramp_256_entry_table(),
+              sizeof(keyframe->gamma_ramp_256_entry_table));
+  std::memcpy(keyframe->gamma_ramp_pwl_rgb,
+              command_processor->gamma_ramp_pwl_rgb(),
+              sizeof(keyframe->gamma_ramp_pwl_rgb));
+  keyframe->gamma_ramp_rw_component =
+      command_processor->gamma_ramp_rw_component();
+  CompressKeyframeData(edram_snapshot.get(), xenos::kEdramSizeBytes,
+                       keyframe->edram_snapshot);
+
+  std::vector<uint8_t> page_contents;
+  for (uint32_t page = 0; page < kPageCount; ++page) {
+    if (!dirty_pages_[page]) {
+      continue;
+    }
+    keyframe->pages.push_back(page);
+    const uint8_t* page_host =
+        memory->TranslatePhysical(page << kPageSizeLog2);
+    page_contents.insert(page_contents.end(), page_host,
+                         page_host + (size_t(1) << kPageSizeLog2));
+  }
+  if (!page_contents.empty()) {
+    CompressKeyframeData(page_contents.data(), page_contents.size(),
+                         keyframe->page_data);
+  }
+
+  dirty_base_keyframe_ = int(keyframes_.size());
+  keyframes_.push_back(std::move(keyframe));
+  std::fill(dirty_pages_.begin(), dirty_pages_.end(), false);
+  return true;
+}
+
+void TracePlayer::RestoreKeyframe(int keyframe_index) {
+  auto memory = graphics_system_->memory();
+  auto command_processor = graphics_system_->command_processor();
+
+  // Gather the pages that may be different in the current and the restored
+  // states - changed since the current base keyframe, or in the keyframes
+  // after the common ancestor of the current base and the restored keyframe.
+  std::vector<bool> pages_to_restore;
+  if (played_ptr_) {
+    pages_to_restore = dirty_pages_;
+    std::vector<bool> is_current_ancestor(keyframes_.size(), false);
+    for (int i = dirty_base_keyframe_; i >= 0; i = keyframes_[i]->parent) {
+      is_current_ancestor[i] = true;
+    }
+    int common_ancestor = keyframe_index;
+    while (common_ancestor >= 0 && !is_current_ancestor[common_ancestor]) {
+      for (uint32_t page : keyframes_[common_ancestor]->pages) {
+        pages_to_restore[page] = true;
+      }
+      common_ancestor = keyframes_[common_ancestor]->parent;
+    }
+    for (int i = dirty_base_keyframe_; i != common_ancestor;
+         i = keyframes_[i]->parent) {
+      for (uint32_t page : keyframes_[i]->pages) {
+        pages_to_restore[page] = true;
+      }
+    }
+  } else {
+    // The current state is not known.
+    pages_to_restore = written_pages_;
+  }
+
+  // Take the latest contents of the pages from the chain of the keyframes.
+  std::vector<uint8_t> page_contents;
+  for (int i = keyframe_index; i >= 0; i = keyframes_[i]->parent) {
+    const Keyframe& keyframe = *keyframes_[i];
+    if (std::none_of(
+            keyframe.pages.cbegin(), keyframe.pages.cend(),
+            [&](uint32_t page) { return bool(pages_to_restore[page]); })) {
+      continue;
+    }
+    page_contents.resize(keyframe.pages.size() << kPageSizeLog2);
+    if (!DecompressMemory(MemoryEncodingFormat::kZstd,
+                          keyframe.page_data.data(), keyframe.page_data.size(),
+                          page_contents.data(), page_contents.size())) {
+      XELOGE("Trace player: failed to decompress the memory of a keyframe");
+      continue;
+    }
+    for (size_t j = 0; j < keyframe.pages.size(); ++j) {
+      uint32_t page = keyframe.pages[j];
+      if (!pages_to_restore[page]) {
+        continue;
+      }
+      std::memcpy(memory->TranslatePhysical(page << kPageSizeLog2),
+                  page_contents.data() + (j << kPageSizeLog2),
+                  size_t(1) << kPageSizeLog2);
+      pages_to_restore[page] = false;
+    }
+  }
+  // Not written by the playback before the restored state.
+  for (uint32_t page = 0; page < kPageCount; ++page) {
+    if (pages_to_restore[page]) {
+      std::memset(memory->TranslatePhysical(page << kPageSizeLog2), 0,
+                  size_t(1) << kPageSizeLog2);
+    }
+  }
+
+  if (keyframe_index >= 0) {
+    const Keyframe& keyframe = *keyframes_[keyframe_index];
+    command_processor->RestoreRegisters(0, keyframe.registers.get(),
+                                        RegisterFile::kRegisterCount, false);
+    command_processor->RestoreGammaRamp(keyframe.gamma_ramp_256_entry_table,
+                                        keyframe.gamma_ramp_pwl_rgb[0],
+                                        keyframe.gamma_ramp_rw_component);
+    std::unique_ptr<uint8_t[]> edram_snapshot(
+        new uint8_t[xenos::kEdramSizeBytes]);
+    if (DecompressMemory(MemoryEncodingFormat::kZstd,
+                         keyframe.edram_snapshot.data(),
+                         keyframe.edram_snapshot.size(), edram_snapshot.get(),
+                         xenos::kEdramSizeBytes)) {
+      command_processor->RestoreEdramSnapshot(edram_snapshot.get());
+    } else {
+      XELOGE("Trace player: failed to decompress the EDRAM of a keyframe");
+    }
+  }
+  // The GPU copies of the memory, including what the GPU itself has written
+  // after the restored state, must be reloaded.
+  command_processor->ClearCaches();
+  command_processor->TracePlaybackWroteMemory(0, 0x20000000);
+
+  dirty_base_keyframe_ = keyframe_index;
+  std::fill(dirty_pages_.begin(), dirty_pages_.end(), false);
 }
 
 }  // namespace gpu
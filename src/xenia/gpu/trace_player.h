@@ -11,9 +11,15 @@
 #define XENIA_GPU_TRACE_PLAYER_H_
 
 #include <atomic>
+#include <memory>
 #include <string>
 
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
 #include "xenia/base/threading.h"
+#include "xenia/gpu/registers.h"
 #include "xenia/gpu/trace_protocol.h"
 #include "xenia/gpu/trace_reader.h"
 
@@ -35,22 +41,86 @@ class TracePlayer : public TraceReader {
   int current_frame_index() const { return current_frame_index_; }
   int current_command_index() const { return current_command_index_; }
   bool is_playing_trace() const { return playing_trace_; }
-  const Frame* current_frame() const;
+  const Frame* current_frame();
 
   // Only valid if playing_trace is true.
   // Scalar from 0-10000
   uint32_t playback_percent() const { return playback_percent_; }
 
+  // Seeking reproduces the state of the playback from the start of the trace.
+  // To avoid replaying the whole trace, keyframes of the state are captured
+  // during the playback at the start of every trace_keyframe_interval-th frame
+  // and of the frames sought to, and seeking restores the nearest keyframe
+  // before the target and replays only the rest.
   void SeekFrame(int target_frame);
   void SeekCommand(int target_command);
+  // Plays all the frames of the trace without breaking on swaps, from the
+  // current state of the caches.
+  void PlayAllFrames();
 
   void WaitOnPlayback();
 
+  struct PacketTiming {
+    uint64_t count = 0;
+    uint64_t host_ticks = 0;
+  };
+  // Keyed by the static type name from the packet disassembler.
+  using PacketTimings = std::unordered_map<const char*, PacketTiming>;
+  // Whether to measure the host CPU time spent executing each type of packets.
+  // Must be changed and the timings accessed only while not playing.
+  void set_packet_timing_enabled(bool enabled) {
+    packet_timing_enabled_ = enabled;
+  }
+  const PacketTimings& packet_timings() const { return packet_timings_; }
+  void ResetPacketTimings() { packet_timings_.clear(); }
+
+  // Must be accessed only while not playing.
+  size_t keyframe_count() const { return keyframes_.size(); }
+
  private:
+  // State of the playback at the start of a frame. The guest memory is stored
+  // as the physical pages changed since the parent keyframe.
+  struct Keyframe {
+    int frame;
+    // Index of the keyframe the pages are relative to, or -1 for the state
+    // before playing anything, with the memory written by the trace zeroed.
+    int parent;
+    std::unique_ptr<uint32_t[]> registers;
+    reg::DC_LUT_30_COLOR gamma_ramp_256_entry_table[256];
+    reg::DC_LUT_PWL_DATA gamma_ramp_pwl_rgb[128][3];
+    uint32_t gamma_ramp_rw_component;
+    // Compressed with zstd.
+    std::vector<uint8_t> edram_snapshot;
+    // In ascending order, with the contents compressed with zstd.
+    std::vector<uint32_t> pages;
+    std::vector<uint8_t> page_data;
+  };
+
+  static constexpr uint32_t kPageSizeLog2 = 12;
+  static constexpr uint32_t kPageCount = 0x20000000 >> kPageSizeLog2;
+
+  // Plays the trace up to target_ptr in target_frame, from the current state
+  // if possible, or from the nearest keyframe.
+  void PlayTo(int target_frame, const uint8_t* target_ptr);
+  void PlayToOnThread(int target_frame, const uint8_t* target_ptr);
   void PlayTrace(const uint8_t* trace_data, size_t trace_size,
                  TracePlaybackMode playback_mode, bool clear_caches);
   void PlayTraceOnThread(const uint8_t* trace_data, size_t trace_size,
                          TracePlaybackMode playback_mode, bool clear_caches);
+  // Returns true if stopped after a swap in kBreakOnSwap mode. The playback
+  // percentage is of the position in playback_range_start_ to
+  // playback_range_end_.
+  bool ExecuteCommands(const uint8_t* trace_data, size_t trace_size,
+                       TracePlaybackMode playback_mode);
+  void MarkPagesWritten(uint32_t physical_address, uint32_t length);
+  // Returns the index of the latest keyframe at or before the frame, or -1.
+  int FindKeyframe(int frame) const;
+  // Called on the command processor thread when the playback reaches the
+  // start of a frame.
+  void OnFrameStart(int frame, bool is_target_frame);
+  bool CaptureKeyframe(int frame);
+  // -1 to restore the state before playing anything.
+  void RestoreKeyframe(int keyframe_index);
 
   GraphicsSystem* graphics_system_;
   int current_frame_index_;
@@ -58,6 +128,25 @@ class TracePlayer : public TraceReader {
   bool playing_trace_ = false;
   std::atomic<uint32_t> playback_percent_ = {0};
   std::unique_ptr<xe::threading::Event> playback_event_;
+  bool packet_timing_enabled_ = false;
+  PacketTimings packet_timings_;
+  const uint8_t* playback_range_start_ = nullptr;
+  const uint8_t* playback_range_end_ = nullptr;
+
+  // Modified on the command processor thread only while playing.
+  std::vector<std::unique_ptr<Keyframe>> keyframes_;
+  // Cleared if the command processor can't capture the keyframe state.
+  bool keyframes_supported_ = true;
+  // End of the part of the command stream that has been played to reach the
+  // current state, and its frame, or nullptr if the state is unknown.
+  const uint8_t* played_ptr_ = nullptr;
+  int played_frame_ = 0;
+  // The current guest memory is the memory of dirty_base_keyframe_ (or of the
+  // state before playing anything if it's -1), with dirty_pages_ changed.
+  // written_pages_ are all the pages the playback has ever changed.
+  int dirty_base_keyframe_ = -1;
+  std::vector<bool> dirty_pages_;
+  std::vector<bool> written_pages_;
 };
 
 }  // namespace gpu
@@ -23,7 +23,23 @@ static const char kTraceExtension[] = "xtr";
 // Other changes besides the file format may require bumps, such as
 // anything that changes what is recorded into the files (new GPU
 // command processor commands, etc).
-constexpr uint32_t kTraceFormatVersion = 1;
+constexpr uint32_t kTraceFormatVersion = 2;
+
+// The compression format used for memory read/write buffers and for blocks
+// of the command stream.
+// Note that not every memory read/write will have compressed data
+// (as it's silly to compress 4 byte buffers).
+enum class MemoryEncodingFormat {
+  // Data is in its raw form. encoded_length == decoded_length.
+  kNone,
+  // Data is compressed with third_party/snappy.
+  kSnappy,
+  // Data is compressed with third_party/zstd.
+  kZstd,
+  // Data is a uint64_t offset in the decoded command stream of the data of an
+  // earlier command with the same contents.
+  kStreamReference,
+};
 
 // Trace file header identifying information about the trace.
 // This must be positioned at the start of the file and must only occur once.
@@ -40,6 +56,35 @@ struct TraceHeader {
   uint32_t title_id;
 };
 
+// The command stream following the header is split into blocks encoded
+// independently, so they can be compressed on a separate thread while
+// recording, and only the blocks needed for the frame being viewed have to be
+// decoded while reading. The commands are laid out as if the decoded blocks
+// were concatenated, and may span multiple blocks.
+struct TraceBlockHeader {
+  // Encoding format of the block in the trace file.
+  MemoryEncodingFormat encoding_format;
+  // Number of bytes the block occupies in the trace file in its encoded form.
+  uint32_t encoded_length;
+  // Number of bytes of the command stream in the block after decoding.
+  uint32_t decoded_length;
+};
+
+// Placed at the end of a trace file that has been closed properly, after the
+// frame index - an array of frame_count uint64_t offsets of the beginning of
+// each frame in the decoded command stream, located at frame_index_offset in
+// the file, for seeking to a frame without parsing the preceding frames. If
+// the trace has not been closed properly (such as due to a crash), the blocks
+// continue up to the end of the file, and the frames can only be found by
+// parsing the whole command stream.
+struct TraceFooter {
+  uint64_t frame_index_offset;
+  uint32_t frame_count;
+  // Set to kTraceFooterMagic.
+  uint32_t magic;
+};
+constexpr uint32_t kTraceFooterMagic = 0x49525458;  // 'XTRI'
+
 // Tags each command in the trace file stream as one of the *Command types.
 // Each command has this value as its first dword.
 enum class TraceCommandType : uint32_t {
@@ -87,15 +132,6 @@ struct PacketEndCommand {
   TraceCommandType type;
 };
 
-// The compression format used for memory read/write buffers.
-// Note that not every memory read/write will have compressed data
-// (as it's silly to compress 4 byte buffers).
-enum class MemoryEncodingFormat {
-  // Data is in its raw form. encoded_length == decoded_length.
-  kNone,
-  // Data is compressed with third_party/snappy.
-  kSnappy,
-};
 
 // Represents the GPU reading or writing data from or to memory.
 // Used for both TraceCommandType::kMemoryRead and kMemoryWrite.
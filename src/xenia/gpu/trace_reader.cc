@@ -9,13 +9,17 @@
 
 #include "xenia/gpu/trace_reader.h"
 
+#include <algorithm>
 #include <cinttypes>
+#include <cstring>
 
 #include "third_party/snappy/snappy.h"
+#include "third_party/zstd/lib/zstd.h"
 #include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/mapped_memory.h"
 #include "xenia/base/math.h"
+#include "xenia/base/memory.h"
 #include "xenia/base/platform.h"
 #include "xenia/gpu/packet_disassembler.h"
 #include "xenia/gpu/trace_protocol.h"
@@ -24,6 +28,8 @@
 namespace xe {
 namespace gpu {
 
+TraceReader::~TraceReader() { Close(); }
+
 bool TraceReader::Open(const std::string_view path) {
   Close();
 
@@ -62,21 +68,145 @@ bool TraceReader::Open(const std::string_view path) {
   XELOGI("    Commit: {}", commit_str);
   XELOGI("  Title ID: {}", header->title_id);
 
-  ParseTrace();
+  if (!ParseTrace()) {
+    Close();
+    return false;
+  }
 
   return true;
 }
 
 void TraceReader::Close() {
+  frames_.clear();
+  blocks_.clear();
+  if (stream_) {
+    xe::memory::DeallocFixed(stream_, 0,
+                             xe::memory::DeallocationType::kRelease);
+    stream_ = nullptr;
+  }
+  stream_size_ = 0;
+  stream_allocation_size_ = 0;
+  stream_granules_committed_.clear();
   mmap_.reset();
   trace_data_ = nullptr;
   trace_size_ = 0;
 }
 
-void TraceReader::ParseTrace() {
-  // Skip file header.
-  auto trace_ptr = trace_data_;
-  trace_ptr += sizeof(TraceHeader);
+const TraceReader::Frame* TraceReader::frame(int n) {
+  Frame& frame = frames_[n];
+  if (!frame.commands_parsed) {
+    frame.commands_parsed = true;
+    std::vector<Frame> parsed_frames;
+    if (DecodeStream(uint64_t(frame.start_ptr - stream_),
+                     uint64_t(frame.end_ptr - frame.start_ptr))) {
+      ParseFrames(frame.start_ptr, frame.end_ptr, parsed_frames);
+    }
+    // Frames are split by the writer the same way as by ParseFrames.
+    assert_true(parsed_frames.size() <= 1);
+    if (!parsed_frames.empty()) {
+      frame.command_count = parsed_frames.front().command_count;
+      frame.commands = std::move(parsed_frames.front().commands);
+      frame.command_tree = std::move(parsed_frames.front().command_tree);
+    } else {
+      frame.command_tree = std::make_unique<CommandBuffer>();
+    }
+  }
+  return &frame;
+}
+
+bool TraceReader::ParseTrace() {
+  // Check if the trace has been closed properly and has the frame index.
+  const TraceFooter* footer = nullptr;
+  size_t blocks_end = trace_size_;
+  if (trace_size_ >= sizeof(TraceHeader) + sizeof(TraceFooter)) {
+    auto footer_candidate = reinterpret_cast<const TraceFooter*>(
+        trace_data_ + trace_size_ - sizeof(TraceFooter));
+    if (footer_candidate->magic == kTraceFooterMagic &&
+        footer_candidate->frame_index_offset >= sizeof(TraceHeader) &&
+        footer_candidate->frame_index_offset +
+                sizeof(uint64_t) * footer_candidate->frame_count +
+                sizeof(TraceFooter) ==
+            trace_size_) {
+      footer = footer_candidate;
+      blocks_end = size_t(footer->frame_index_offset);
+    }
+  }
+
+  // Locate the blocks of the command stream.
+  size_t block_offset = sizeof(TraceHeader);
+  uint64_t stream_size = 0;
+  while (block_offset < blocks_end &&
+         blocks_end - block_offset >= sizeof(TraceBlockHeader)) {
+    auto block_header =
+        reinterpret_cast<const TraceBlockHeader*>(trace_data_ + block_offset);
+    block_offset += sizeof(TraceBlockHeader);
+    if (block_header->encoded_length > blocks_end - block_offset) {
+      XELOGW("Trace is truncated, ignoring the last incomplete block");
+      break;
+    }
+    Block block;
+    block.encoded_data = trace_data_ + block_offset;
+    block.stream_offset = stream_size;
+    block.encoding_format = block_header->encoding_format;
+    block.encoded_length = block_header->encoded_length;
+    block.decoded_length = block_header->decoded_length;
+    block.decoded = false;
+    blocks_.push_back(block);
+    block_offset += block_header->encoded_length;
+    stream_size += block_header->decoded_length;
+  }
+
+  // Reserve the address space for the decoded stream, to be committed in
+  // allocation granules as the blocks are decoded.
+  if (stream_size) {
+    stream_granularity_ = xe::memory::allocation_granularity();
+    stream_allocation_size_ =
+        size_t(xe::round_up(stream_size, stream_granularity_));
+    stream_ = reinterpret_cast<uint8_t*>(xe::memory::AllocFixed(
+        nullptr, stream_allocation_size_,
+        xe::memory::AllocationType::kReserve,
+        xe::memory::PageAccess::kNoAccess));
+    if (!stream_) {
+      XELOGE("Failed to reserve {} bytes for the trace command stream",
+             stream_allocation_size_);
+      return false;
+    }
+    stream_granules_committed_.resize(
+        stream_allocation_size_ / stream_granularity_, false);
+  }
+  stream_size_ = stream_size;
+
+  if (footer) {
+    // Only the frames being accessed need to be decoded and parsed.
+    const uint8_t* frame_index = trace_data_ + footer->frame_index_offset;
+    frames_.resize(footer->frame_count);
+    uint64_t frame_end = stream_size_;
+    for (uint32_t i = footer->frame_count; i-- > 0;) {
+      uint64_t frame_start = std::min(
+          xe::load<uint64_t>(frame_index + sizeof(uint64_t) * i), frame_end);
+      frames_[i].start_ptr = stream_ + frame_start;
+      frames_[i].end_ptr = stream_ + frame_end;
+      frame_end = frame_start;
+    }
+    XELOGI("    Frames: {}", frames_.size());
+    return true;
+  }
+
+  XELOGW("Trace has no frame index, parsing the whole trace");
+  if (!DecodeStream(0, stream_size_)) {
+    return false;
+  }
+  ParseFrames(stream_, stream_ + stream_size_, frames_);
+  for (Frame& frame : frames_) {
+    frame.commands_parsed = true;
+  }
+  return true;
+}
+
+void TraceReader::ParseFrames(const uint8_t* start_ptr,
+                              const uint8_t* end_ptr,
+                              std::vector<Frame>& frames_out) {
+  auto trace_ptr = start_ptr;
 
   Frame current_frame;
   current_frame.start_ptr = trace_ptr;
@@ -88,7 +218,7 @@ void TraceReader::ParseTrace() {
   current_frame.command_tree =
       std::unique_ptr<CommandBuffer>(current_command_buffer);
 
-  while (trace_ptr < trace_data_ + trace_size_) {
+  while (trace_ptr < end_ptr) {
     ++current_frame.command_count;
     auto type = static_cast<TraceCommandType>(xe::load<uint32_t>(trace_ptr));
     switch (type) {
@@ -178,7 +308,7 @@ void TraceReader::ParseTrace() {
         }
         if (pending_break) {
           current_frame.end_ptr = trace_ptr;
-          frames_.push_back(std::move(current_frame));
+          frames_out.push_back(std::move(current_frame));
           current_command_buffer = new CommandBuffer();
           current_frame.command_tree =
               std::unique_ptr<CommandBuffer>(current_command_buffer);
@@ -233,10 +363,65 @@ void TraceReader::ParseTrace() {
   }
   if (pending_break || current_frame.command_count) {
     current_frame.end_ptr = trace_ptr;
-    frames_.push_back(std::move(current_frame));
+    frames_out.push_back(std::move(current_frame));
   }
 }
 
+bool TraceReader::DecodeStream(uint64_t offset, uint64_t length) {
+  if (!length) {
+    return true;
+  }
+  if (offset > stream_size_ || length > stream_size_ - offset) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(stream_mutex_);
+  auto block_it = std::upper_bound(
+      blocks_.begin(), blocks_.end(), offset,
+      [](uint64_t value, const Block& block) {
+        return value < block.stream_offset;
+      });
+  assert_true(block_it != blocks_.begin());
+  --block_it;
+  uint64_t end = offset + length;
+  for (; block_it != blocks_.end() && block_it->stream_offset < end;
+       ++block_it) {
+    Block& block = *block_it;
+    if (block.decoded || !block.decoded_length) {
+      continue;
+    }
+    if (block.encoding_format == MemoryEncodingFormat::kStreamReference) {
+      XELOGE("Trace block at stream offset {} has an invalid encoding",
+             block.stream_offset);
+      return false;
+    }
+    size_t granule_first = size_t(block.stream_offset / stream_granularity_);
+    size_t granule_last = size_t(
+        (block.stream_offset + block.decoded_length - 1) / stream_granularity_);
+    for (size_t i = granule_first; i <= granule_last; ++i) {
+      if (stream_granules_committed_[i]) {
+        continue;
+      }
+      if (!xe::memory::AllocFixed(stream_ + stream_granularity_ * i,
+                                  stream_granularity_,
+                                  xe::memory::AllocationType::kCommit,
+                                  xe::memory::PageAccess::kReadWrite)) {
+        XELOGE("Failed to commit memory for the trace command stream");
+        return false;
+      }
+      stream_granules_committed_[i] = true;
+    }
+    if (!DecompressMemory(block.encoding_format, block.encoded_data,
+                          block.encoded_length, stream_ + block.stream_offset,
+                          block.decoded_length)) {
+      XELOGE("Failed to decode the trace block at stream offset {}",
+             block.stream_offset);
+      return false;
+    }
+    block.decoded = true;
+  }
+  return true;
+}
+
 bool TraceReader::DecompressMemory(MemoryEncodingFormat encoding_format,
                                    const void* src, size_t src_size, void* dest,
                                    size_t dest_size) {
@@ -248,6 +433,19 @@ bool TraceReader::DecompressMemory(MemoryEncodingFormat encoding_format,
     case MemoryEncodingFormat::kSnappy:
       return snappy::RawUncompress(reinterpret_cast<const char*>(src), src_size,
                                    reinterpret_cast<char*>(dest));
+    case MemoryEncodingFormat::kZstd: {
+      size_t decoded_size = ZSTD_decompress(dest, dest_size, src, src_size);
+      return !ZSTD_isError(decoded_size) && decoded_size == dest_size;
+    }
+    case MemoryEncodingFormat::kStreamReference: {
+      assert_true(src_size == sizeof(uint64_t));
+      uint64_t offset = xe::load<uint64_t>(src);
+      if (!DecodeStream(offset, dest_size)) {
+        return false;
+      }
+      std::memcpy(dest, stream_ + offset, dest_size);
+      return true;
+    }
     default:
       assert_unhandled_case(encoding_format);
       return false;
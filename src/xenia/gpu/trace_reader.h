@@ -10,6 +10,8 @@
 #ifndef XENIA_GPU_TRACE_READER_H_
 #define XENIA_GPU_TRACE_READER_H_
 
+#include <cstdint>
+#include <mutex>
 #include <string_view>
 #include <vector>
 
@@ -82,6 +84,10 @@ class TraceReader {
     const uint8_t* end_ptr = nullptr;
     int command_count = 0;
 
+    // With the frame index, the commands are parsed on the first access to
+    // the frame.
+    bool commands_parsed = false;
+
     // Flat list of all commands in this frame.
     std::vector<Command> commands;
 
@@ -90,13 +96,14 @@ class TraceReader {
   };
 
   TraceReader() = default;
-  virtual ~TraceReader() = default;
+  virtual ~TraceReader();
 
   const TraceHeader* header() const {
     return reinterpret_cast<const TraceHeader*>(trace_data_);
   }
 
-  const Frame* frame(int n) const { return &frames_[n]; }
+  // Decodes and parses the frame if it hasn't been accessed yet.
+  const Frame* frame(int n);
   int frame_count() const { return int(frames_.size()); }
 
   bool Open(const std::string_view path);
@@ -104,13 +111,39 @@ class TraceReader {
   void Close();
 
  protected:
-  void ParseTrace();
+  struct Block {
+    const uint8_t* encoded_data;
+    uint64_t stream_offset;
+    MemoryEncodingFormat encoding_format;
+    uint32_t encoded_length;
+    uint32_t decoded_length;
+    bool decoded;
+  };
+
+  bool ParseTrace();
+  void ParseFrames(const uint8_t* start_ptr, const uint8_t* end_ptr,
+                   std::vector<Frame>& frames_out);
+  // Makes sure the blocks containing the range of the command stream are
+  // decoded.
+  bool DecodeStream(uint64_t offset, uint64_t length);
   bool DecompressMemory(MemoryEncodingFormat encoding_format, const void* src,
                         size_t src_size, void* dest, size_t dest_size);
 
   std::unique_ptr<MappedMemory> mmap_;
   const uint8_t* trace_data_ = nullptr;
   size_t trace_size_ = 0;
+
+  // The command stream, with the blocks decoded into reserved address space on
+  // demand, protected with stream_mutex_ as memory reads referencing earlier
+  // data are decoded during playback.
+  std::mutex stream_mutex_;
+  std::vector<Block> blocks_;
+  uint8_t* stream_ = nullptr;
+  uint64_t stream_size_ = 0;
+  size_t stream_allocation_size_ = 0;
+  size_t stream_granularity_ = 0;
+  std::vector<bool> stream_granules_committed_;
+
   std::vector<Frame> frames_;
 };
 
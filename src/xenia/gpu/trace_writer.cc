@@ -12,14 +12,14 @@
 #include <cstring>
 #include <memory>
 
-#include "third_party/snappy/snappy-sinksource.h"
-#include "third_party/snappy/snappy.h"
+#include "third_party/zstd/lib/zstd.h"
 
 #include "build/version.h"
 #include "xenia/base/assert.h"
 #include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/string.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/gpu/registers.h"
 #include "xenia/gpu/xenos.h"
 
@@ -29,7 +29,7 @@ namespace gpu {
 TraceWriter::TraceWriter(uint8_t* membase)
     : membase_(membase), file_(nullptr) {}
 
-TraceWriter::~TraceWriter() = default;
+TraceWriter::~TraceWriter() { Close(); }
 
 bool TraceWriter::Open(const std::filesystem::path& path, uint32_t title_id) {
   Close();
@@ -52,20 +52,69 @@ bool TraceWriter::Open(const std::filesystem::path& path, uint32_t title_id) {
               sizeof(header.build_commit_sha));
   header.title_id = title_id;
   fwrite(&header, sizeof(header), 1, file_);
+  file_size_ = sizeof(header);
 
   cached_memory_reads_.clear();
+  memory_read_stream_offsets_.clear();
+  frame_stream_offsets_.clear();
+  frame_stream_offsets_.push_back(0);
+  frame_end_pending_ = false;
+  stream_size_ = 0;
+  block_.clear();
+  block_.reserve(kBlockSize);
+
+  writer_flush_requested_ = false;
+  writer_shutdown_ = false;
+  writer_thread_ =
+      xe::threading::Thread::Create({}, [this]() { WriterThread(); });
+  assert_not_null(writer_thread_);
+  writer_thread_->set_name("GPU Trace Writer");
   return true;
 }
 
 void TraceWriter::Flush() {
-  if (file_) {
-    fflush(file_);
+  if (!file_) {
+    return;
   }
+  // Not waiting for the writer thread, only making sure the data recorded so
+  // far reaches the file soon.
+  SubmitBlock();
+  {
+    std::lock_guard<std::mutex> lock(blocks_lock_);
+    writer_flush_requested_ = true;
+  }
+  blocks_submitted_cond_.notify_one();
 }
 
 void TraceWriter::Close() {
   if (file_) {
+    SubmitBlock();
+    {
+      std::lock_guard<std::mutex> lock(blocks_lock_);
+      writer_shutdown_ = true;
+    }
+    blocks_submitted_cond_.notify_one();
+    xe::threading::Wait(writer_thread_.get(), false);
+    writer_thread_.reset();
+
+    // Write the frame index, without the empty frame after the last swap.
+    if (frame_stream_offsets_.back() >= stream_size_) {
+      frame_stream_offsets_.pop_back();
+    }
+    TraceFooter footer;
+    footer.frame_index_offset = file_size_;
+    footer.frame_count = uint32_t(frame_stream_offsets_.size());
+    footer.magic = kTraceFooterMagic;
+    fwrite(frame_stream_offsets_.data(), sizeof(uint64_t),
+           frame_stream_offsets_.size(), file_);
+    fwrite(&footer, sizeof(footer), 1, file_);
+
     cached_memory_reads_.clear();
+    memory_read_stream_offsets_.clear();
+    frame_stream_offsets_.clear();
+    block_.clear();
+    block_.shrink_to_fit();
+    blocks_free_.clear();
 
     fflush(file_);
     fclose(file_);
@@ -73,6 +122,92 @@ void TraceWriter::Close() {
   }
 }
 
+void TraceWriter::Append(const void* data, size_t length) {
+  const uint8_t* data_bytes = reinterpret_cast<const uint8_t*>(data);
+  block_.insert(block_.end(), data_bytes, data_bytes + length);
+  stream_size_ += length;
+  if (block_.size() >= kBlockSize) {
+    SubmitBlock();
+  }
+}
+
+void TraceWriter::SubmitBlock() {
+  if (block_.empty()) {
+    return;
+  }
+  std::vector<uint8_t> next_block;
+  {
+    std::unique_lock<std::mutex> lock(blocks_lock_);
+    blocks_written_cond_.wait(lock, [this]() {
+      return blocks_pending_size_ < kMaxPendingBlocksSize;
+    });
+    blocks_pending_size_ += block_.size();
+    blocks_pending_.push_back(std::move(block_));
+    if (!blocks_free_.empty()) {
+      next_block = std::move(blocks_free_.back());
+      blocks_free_.pop_back();
+    }
+  }
+  blocks_submitted_cond_.notify_one();
+  block_ = std::move(next_block);
+  block_.clear();
+  block_.reserve(kBlockSize);
+}
+
+void TraceWriter::WriterThread() {
+  std::vector<uint8_t> encoded_block;
+  while (true) {
+    std::vector<uint8_t> block;
+    {
+      std::unique_lock<std::mutex> lock(blocks_lock_);
+      blocks_submitted_cond_.wait(lock, [this]() {
+        return !blocks_pending_.empty() || writer_flush_requested_ ||
+               writer_shutdown_;
+      });
+      if (blocks_pending_.empty()) {
+        // Only flushing or exiting once all the blocks have been written.
+        if (writer_shutdown_) {
+          return;
+        }
+        writer_flush_requested_ = false;
+        lock.unlock();
+        fflush(file_);
+        continue;
+      }
+      block = std::move(blocks_pending_.front());
+      blocks_pending_.pop_front();
+    }
+
+    TraceBlockHeader header;
+    header.encoding_format = MemoryEncodingFormat::kNone;
+    header.encoded_length = header.decoded_length = uint32_t(block.size());
+    const void* encoded_data = block.data();
+    if (compress_output_) {
+      // The fastest level, not to fall behind the emulation - most of the
+      // savings are from the repeated data anyway.
+      encoded_block.resize(ZSTD_compressBound(block.size()));
+      size_t encoded_length =
+          ZSTD_compress(encoded_block.data(), encoded_block.size(),
+                        block.data(), block.size(), 1);
+      if (!ZSTD_isError(encoded_length) && encoded_length < block.size()) {
+        header.encoding_format = MemoryEncodingFormat::kZstd;
+        header.encoded_length = uint32_t(encoded_length);
+        encoded_data = encoded_block.data();
+      }
+    }
+    fwrite(&header, sizeof(header), 1, file_);
+    fwrite(encoded_data, 1, header.encoded_length, file_);
+    file_size_ += sizeof(header) + header.encoded_length;
+
+    {
+      std::lock_guard<std::mutex> lock(blocks_lock_);
+      blocks_pending_size_ -= block.size();
+      blocks_free_.push_back(std::move(block));
+    }
+    blocks_written_cond_.notify_one();
+  }
+}
+
 void TraceWriter::WritePrimaryBufferStart(uint32_t base_ptr, uint32_t count) {
   if (!file_) {
     return;
@@ -82,7 +217,7 @@ void TraceWriter::WritePrimaryBufferStart(uint32_t base_ptr, uint32_t count) {
       base_ptr,
       0,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  Append(&cmd, sizeof(cmd));
 }
 
 void TraceWriter::WritePrimaryBufferEnd() {
@@ -92,7 +227,7 @@ void TraceWriter::WritePrimaryBufferEnd() {
   PrimaryBufferEndCommand cmd = {
       TraceCommandType::kPrimaryBufferEnd,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  Append(&cmd, sizeof(cmd));
 }
 
 void TraceWriter::WriteIndirectBufferStart(uint32_t base_ptr, uint32_t count) {
@@ -104,7 +239,7 @@ void TraceWriter::WriteIndirectBufferStart(uint32_t base_ptr, uint32_t count) {
       base_ptr,
       0,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  Append(&cmd, sizeof(cmd));
 }
 
 void TraceWriter::WriteIndirectBufferEnd() {
@@ -114,7 +249,7 @@ void TraceWriter::WriteIndirectBufferEnd() {
   IndirectBufferEndCommand cmd = {
       TraceCommandType::kIndirectBufferEnd,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  Append(&cmd, sizeof(cmd));
 }
 
 void TraceWriter::WritePacketStart(uint32_t base_ptr, uint32_t count) {
@@ -126,8 +261,8 @@ void TraceWriter::WritePacketStart(uint32_t base_ptr, uint32_t count) {
       base_ptr,
       count,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
-  fwrite(membase_ + base_ptr, 4, count, file_);
+  Append(&cmd, sizeof(cmd));
+  Append(membase_ + base_ptr, sizeof(uint32_t) * count);
 }
 
 void TraceWriter::WritePacketEnd() {
@@ -137,7 +272,12 @@ void TraceWriter::WritePacketEnd() {
   PacketEndCommand cmd = {
       TraceCommandType::kPacketEnd,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  Append(&cmd, sizeof(cmd));
+  // Frames end after the packet containing the swap, as in TraceReader.
+  if (frame_end_pending_) {
+    frame_end_pending_ = false;
+    frame_stream_offsets_.push_back(stream_size_);
+  }
 }
 
 void TraceWriter::WriteMemoryRead(uint32_t base_ptr, size_t length,
@@ -182,18 +322,6 @@ void TraceWriter::WriteMemoryWrite(uint32_t base_ptr, size_t length,
                      host_ptr);
 }
 
-class SnappySink : public snappy::Sink {
- public:
-  SnappySink(FILE* file) : file_(file) {}
-
-  void Append(const char* bytes, size_t n) override {
-    fwrite(bytes, 1, n, file_);
-  }
-
- private:
-  FILE* file_ = nullptr;
-};
-
 void TraceWriter::WriteMemoryCommand(TraceCommandType type, uint32_t base_ptr,
                                      size_t length, const void* host_ptr) {
   MemoryCommand cmd = {};
@@ -206,62 +334,34 @@ void TraceWriter::WriteMemoryCommand(TraceCommandType type, uint32_t base_ptr,
     host_ptr = membase_ + cmd.base_ptr;
   }
 
-  bool compress = compress_output_ && length > compression_threshold_;
-  if (compress) {
-    // Write the header now so we reserve space in the buffer.
-    long header_position = std::ftell(file_);
-    cmd.encoding_format = MemoryEncodingFormat::kSnappy;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-
-    // Stream the content right to the buffer.
-    snappy::ByteArraySource snappy_source(
-        reinterpret_cast<const char*>(host_ptr), cmd.decoded_length);
-    SnappySink snappy_sink(file_);
-    cmd.encoded_length =
-        static_cast<uint32_t>(snappy::Compress(&snappy_source, &snappy_sink));
-
-    // Seek back and overwrite the header with our final size.
-    std::fseek(file_, header_position, SEEK_SET);
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    std::fseek(file_, header_position + sizeof(cmd) + cmd.encoded_length,
-               SEEK_SET);
-  } else {
-    // Uncompressed - write buffer directly to the file.
-    cmd.encoding_format = MemoryEncodingFormat::kNone;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    fwrite(host_ptr, 1, cmd.decoded_length, file_);
+  // The same data, such as unmodified textures and vertex buffers, is often
+  // uploaded again by the GPU, reference its earlier copy in the stream.
+  if (type == TraceCommandType::kMemoryRead &&
+      length >= deduplication_threshold_) {
+    uint64_t hash = XXH3_64bits_withSeed(host_ptr, length, length);
+    auto it = memory_read_stream_offsets_.find(hash);
+    if (it != memory_read_stream_offsets_.end()) {
+      cmd.encoding_format = MemoryEncodingFormat::kStreamReference;
+      cmd.encoded_length = sizeof(uint64_t);
+      Append(&cmd, sizeof(cmd));
+      Append(&it->second, sizeof(uint64_t));
+      return;
+    }
+    memory_read_stream_offsets_.emplace(hash, stream_size_ + sizeof(cmd));
   }
+
+  // Compressed along with the rest of the block on the writer thread.
+  Append(&cmd, sizeof(cmd));
+  Append(host_ptr, cmd.decoded_length);
 }
 
 void TraceWriter::WriteEdramSnapshot(const void* snapshot) {
   EdramSnapshotCommand cmd = {};
   cmd.type = TraceCommandType::kEdramSnapshot;
-
-  if (compress_output_) {
-    // Write the header now so we reserve space in the buffer.
-    long header_position = std::ftell(file_);
-    cmd.encoding_format = MemoryEncodingFormat::kSnappy;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-
-    // Stream the content right to the buffer.
-    snappy::ByteArraySource snappy_source(
-        reinterpret_cast<const char*>(snapshot), xenos::kEdramSizeBytes);
-    SnappySink snappy_sink(file_);
-    cmd.encoded_length =
-        static_cast<uint32_t>(snappy::Compress(&snappy_source, &snappy_sink));
-
-    // Seek back and overwrite the header with our final size.
-    std::fseek(file_, header_position, SEEK_SET);
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    std::fseek(file_, header_position + sizeof(cmd) + cmd.encoded_length,
-               SEEK_SET);
-  } else {
-    // Uncompressed - write buffer directly to the file.
-    cmd.encoding_format = MemoryEncodingFormat::kNone;
-    cmd.encoded_length = xenos::kEdramSizeBytes;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    fwrite(snapshot, 1, xenos::kEdramSizeBytes, file_);
-  }
+  cmd.encoding_format = MemoryEncodingFormat::kNone;
+  cmd.encoded_length = xenos::kEdramSizeBytes;
+  Append(&cmd, sizeof(cmd));
+  Append(snapshot, xenos::kEdramSizeBytes);
 }
 
 void TraceWriter::WriteEvent(EventCommand::Type event_type) {
@@ -272,7 +372,10 @@ void TraceWriter::WriteEvent(EventCommand::Type event_type) {
       TraceCommandType::kEvent,
       event_type,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  Append(&cmd, sizeof(cmd));
+  if (event_type == EventCommand::Type::kSwap) {
+    frame_end_pending_ = true;
+  }
 }
 
 void TraceWriter::WriteRegisters(uint32_t first_register,
@@ -284,33 +387,10 @@ void TraceWriter::WriteRegisters(uint32_t first_register,
   cmd.first_register = first_register;
   cmd.register_count = register_count;
   cmd.execute_callbacks = execute_callbacks_on_play;
-
-  uint32_t uncompressed_length = uint32_t(sizeof(uint32_t) * register_count);
-  if (compress_output_) {
-    // Write the header now so we reserve space in the buffer.
-    long header_position = std::ftell(file_);
-    cmd.encoding_format = MemoryEncodingFormat::kSnappy;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-
-    // Stream the content right to the buffer.
-    snappy::ByteArraySource snappy_source(
-        reinterpret_cast<const char*>(register_values), uncompressed_length);
-    SnappySink snappy_sink(file_);
-    cmd.encoded_length =
-        static_cast<uint32_t>(snappy::Compress(&snappy_source, &snappy_sink));
-
-    // Seek back and overwrite the header with our final size.
-    std::fseek(file_, header_position, SEEK_SET);
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    std::fseek(file_, header_position + sizeof(cmd) + cmd.encoded_length,
-               SEEK_SET);
-  } else {
-    // Uncompressed - write the values directly to the file.
-    cmd.encoding_format = MemoryEncodingFormat::kNone;
-    cmd.encoded_length = uncompressed_length;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    fwrite(register_values, 1, uncompressed_length, file_);
-  }
+  cmd.encoding_format = MemoryEncodingFormat::kNone;
+  cmd.encoded_length = uint32_t(sizeof(uint32_t) * register_count);
+  Append(&cmd, sizeof(cmd));
+  Append(register_values, cmd.encoded_length);
 }
 
 void TraceWriter::WriteGammaRamp(
@@ -325,42 +405,12 @@ void TraceWriter::WriteGammaRamp(
       sizeof(reg::DC_LUT_30_COLOR) * 256;
   constexpr uint32_t kPWLUncompressedLength =
       sizeof(reg::DC_LUT_PWL_DATA) * 3 * 128;
-  constexpr uint32_t kUncompressedLength =
+  cmd.encoding_format = MemoryEncodingFormat::kNone;
+  cmd.encoded_length =
       k256EntryTableUncompressedLength + kPWLUncompressedLength;
-  if (compress_output_) {
-    // Write the header now so we reserve space in the buffer.
-    long header_position = std::ftell(file_);
-    cmd.encoding_format = MemoryEncodingFormat::kSnappy;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-
-    // Stream the content right to the buffer.
-    {
-      std::unique_ptr<char[]> gamma_ramps(new char[kUncompressedLength]);
-      std::memcpy(gamma_ramps.get(), gamma_ramp_256_entry_table,
-                  k256EntryTableUncompressedLength);
-      std::memcpy(gamma_ramps.get() + k256EntryTableUncompressedLength,
-                  gamma_ramp_pwl_rgb, kPWLUncompressedLength);
-      snappy::ByteArraySource snappy_source(gamma_ramps.get(),
-                                            kUncompressedLength);
-      SnappySink snappy_sink(file_);
-      cmd.encoded_length =
-          static_cast<uint32_t>(snappy::Compress(&snappy_source, &snappy_sink));
-    }
-
-    // Seek back and overwrite the header with our final size.
-    std::fseek(file_, header_position, SEEK_SET);
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    std::fseek(file_, header_position + sizeof(cmd) + cmd.encoded_length,
-               SEEK_SET);
-  } else {
-    // Uncompressed - write the values directly to the file.
-    cmd.encoding_format = MemoryEncodingFormat::kNone;
-    cmd.encoded_length = kUncompressedLength;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    fwrite(gamma_ramp_256_entry_table, 1, k256EntryTableUncompressedLength,
-           file_);
-    fwrite(gamma_ramp_pwl_rgb, 1, kPWLUncompressedLength, file_);
-  }
+  Append(&cmd, sizeof(cmd));
+  Append(gamma_ramp_256_entry_table, k256EntryTableUncompressedLength);
+  Append(gamma_ramp_pwl_rgb, kPWLUncompressedLength);
 }
 #endif
 }  //  namespace gpu
@@ -10,9 +10,18 @@
 #ifndef XENIA_GPU_TRACE_WRITER_H_
 #define XENIA_GPU_TRACE_WRITER_H_
 
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <filesystem>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "xenia/base/threading.h"
 
 #include "xenia/gpu/registers.h"
 #include "xenia/gpu/trace_protocol.h"
@@ -63,15 +72,53 @@ class TraceWriter {
                       uint32_t gamma_ramp_rw_component);
 
  private:
+  // Uncompressed size after which the current block is submitted to the
+  // writer thread.
+  static constexpr size_t kBlockSize = 4 * 1024 * 1024;
+  // Size of the blocks not written yet after which recording waits for the
+  // writer thread, so memory usage doesn't grow indefinitely if the disk can't
+  // keep up.
+  static constexpr size_t kMaxPendingBlocksSize = 256 * 1024 * 1024;
+
   void WriteMemoryCommand(TraceCommandType type, uint32_t base_ptr,
                           size_t length, const void* host_ptr = nullptr);
 
+  // Appends the data to the current block of the command stream.
+  void Append(const void* data, size_t length);
+  void SubmitBlock();
+  void WriterThread();
+
   std::set<uint64_t> cached_memory_reads_;
+  // Offsets in the command stream of the data of memory reads by their
+  // contents hash (seeded with the length), for referencing the earlier data
+  // instead of storing it again.
+  std::unordered_map<uint64_t, uint64_t> memory_read_stream_offsets_;
+  // Offsets in the command stream of the beginning of each frame.
+  std::vector<uint64_t> frame_stream_offsets_;
+  bool frame_end_pending_ = false;
+  uint64_t stream_size_ = 0;
+  std::vector<uint8_t> block_;
   uint8_t* membase_;
   FILE* file_;
 
+  std::unique_ptr<xe::threading::Thread> writer_thread_;
+  // Blocks submitted, but not written yet, and free ones for reuse, protected
+  // with blocks_lock_.
+  std::mutex blocks_lock_;
+  std::condition_variable blocks_submitted_cond_;
+  std::condition_variable blocks_written_cond_;
+  std::deque<std::vector<uint8_t>> blocks_pending_;
+  std::vector<std::vector<uint8_t>> blocks_free_;
+  size_t blocks_pending_size_ = 0;
+  bool writer_flush_requested_ = false;
+  bool writer_shutdown_ = false;
+  // Size of the file written so far, owned by the writer thread while it's
+  // running.
+  uint64_t file_size_ = 0;
+
   bool compress_output_ = true;
-  size_t compression_threshold_ = 1024;  // Min. number of bytes to compress.
+  // Min. number of bytes of a memory read to look for identical earlier data.
+  size_t deduplication_threshold_ = 1024;
 
 #else
   // this could be annoying to maintain if new methods are added or the
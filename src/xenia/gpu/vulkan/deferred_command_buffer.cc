@@ -46,6 +46,12 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
     stream_remaining -= kCommandHeaderSizeElements;
 
     switch (header.command) {
+      case Command::kVkBeginQuery: {
+        auto& args = *reinterpret_cast<const ArgsVkBeginQuery*>(stream);
+        dfn.vkCmdBeginQuery(command_buffer, args.query_pool, args.query,
+                            args.flags);
+      } break;
+
       case Command::kVkBeginRenderPass: {
         auto& args = *reinterpret_cast<const ArgsVkBeginRenderPass*>(stream);
         size_t offset_bytes = sizeof(ArgsVkBeginRenderPass);
@@ -70,6 +76,34 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
                                  args.contents);
       } break;
 
+      case Command::kVkBeginRendering: {
+        auto& args = *reinterpret_cast<const ArgsVkBeginRendering*>(stream);
+        const VkRenderingAttachmentInfo* attachments =
+            reinterpret_cast<const VkRenderingAttachmentInfo*>(
+                reinterpret_cast<const uint8_t*>(stream) +
+                xe::align(sizeof(ArgsVkBeginRendering),
+                          alignof(VkRenderingAttachmentInfo)));
+        VkRenderingInfo rendering_info;
+        rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        rendering_info.pNext = nullptr;
+        rendering_info.flags = args.flags;
+        rendering_info.renderArea = args.render_area;
+        rendering_info.layerCount = args.layer_count;
+        rendering_info.viewMask = args.view_mask;
+        rendering_info.colorAttachmentCount = args.color_attachment_count;
+        rendering_info.pColorAttachments =
+            args.color_attachment_count ? attachments : nullptr;
+        rendering_info.pDepthAttachment =
+            args.has_depth_attachment
+                ? &attachments[args.color_attachment_count]
+                : nullptr;
+        rendering_info.pStencilAttachment =
+            args.has_stencil_attachment
+                ? &attachments[args.color_attachment_count + 1]
+                : nullptr;
+        dfn.vkCmdBeginRendering(command_buffer, &rendering_info);
+      } break;
+
       case Command::kVkBindDescriptorSets: {
         auto& args = *reinterpret_cast<const ArgsVkBindDescriptorSets*>(stream);
         size_t offset_bytes = xe::align(sizeof(ArgsVkBindDescriptorSets),
@@ -165,6 +199,16 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
                           alignof(VkBufferImageCopy))));
       } break;
 
+      case Command::kVkCopyImage: {
+        auto& args = *reinterpret_cast<const ArgsVkCopyImage*>(stream);
+        dfn.vkCmdCopyImage(
+            command_buffer, args.src_image, args.src_image_layout,
+            args.dst_image, args.dst_image_layout, args.region_count,
+            reinterpret_cast<const VkImageCopy*>(
+                reinterpret_cast<const uint8_t*>(stream) +
+                xe::align(sizeof(ArgsVkCopyImage), alignof(VkImageCopy))));
+      } break;
+
       case Command::kVkDispatch: {
         auto& args = *reinterpret_cast<const ArgsVkDispatch*>(stream);
         dfn.vkCmdDispatch(command_buffer, args.group_count_x,
@@ -184,10 +228,19 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
                              args.vertex_offset, args.first_instance);
       } break;
 
+      case Command::kVkEndQuery: {
+        auto& args = *reinterpret_cast<const ArgsVkEndQuery*>(stream);
+        dfn.vkCmdEndQuery(command_buffer, args.query_pool, args.query);
+      } break;
+
       case Command::kVkEndRenderPass:
         dfn.vkCmdEndRenderPass(command_buffer);
         break;
 
+      case Command::kVkEndRendering:
+        dfn.vkCmdEndRendering(command_buffer);
+        break;
+
       case Command::kVkPipelineBarrier: {
         auto& args = *reinterpret_cast<const ArgsVkPipelineBarrier*>(stream);
         size_t barrier_offset_bytes = sizeof(ArgsVkPipelineBarrier);
@@ -235,6 +288,12 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
                                    sizeof(ArgsVkPushConstants));
       } break;
 
+      case Command::kVkResetQueryPool: {
+        auto& args = *reinterpret_cast<const ArgsVkResetQueryPool*>(stream);
+        dfn.vkCmdResetQueryPool(command_buffer, args.query_pool,
+                                args.first_query, args.query_count);
+      } break;
+
       case Command::kVkSetBlendConstants: {
         auto& args = *reinterpret_cast<const ArgsVkSetBlendConstants*>(stream);
         dfn.vkCmdSetBlendConstants(command_buffer, args.blend_constants);
@@ -286,6 +345,12 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
                 xe::align(sizeof(ArgsVkSetViewport), alignof(VkViewport))));
       } break;
 
+      case Command::kVkWriteTimestamp: {
+        auto& args = *reinterpret_cast<const ArgsVkWriteTimestamp*>(stream);
+        dfn.vkCmdWriteTimestamp(command_buffer, args.pipeline_stage,
+                                args.query_pool, args.query);
+      } break;
+
       default:
         assert_unhandled_case(header.command);
         break;
@@ -33,6 +33,15 @@ class DeferredCommandBuffer {
   void Execute(VkCommandBuffer command_buffer);
 
   // render_pass_begin->pNext of all barriers must be null.
+  void CmdVkBeginQuery(VkQueryPool query_pool, uint32_t query,
+                       VkQueryControlFlags flags) {
+    auto& args = *reinterpret_cast<ArgsVkBeginQuery*>(
+        WriteCommand(Command::kVkBeginQuery, sizeof(ArgsVkBeginQuery)));
+    args.query_pool = query_pool;
+    args.query = query;
+    args.flags = flags;
+  }
+
   void CmdVkBeginRenderPass(const VkRenderPassBeginInfo* render_pass_begin,
                             VkSubpassContents contents) {
     assert_null(render_pass_begin->pNext);
@@ -59,6 +68,46 @@ class DeferredCommandBuffer {
     }
   }
 
+  // pNext of the rendering info and the attachments must be null.
+  void CmdVkBeginRendering(const VkRenderingInfo* rendering_info) {
+    assert_null(rendering_info->pNext);
+    uint32_t color_attachment_count = rendering_info->colorAttachmentCount;
+    size_t arguments_size = xe::align(sizeof(ArgsVkBeginRendering),
+                                      alignof(VkRenderingAttachmentInfo));
+    size_t attachments_offset = arguments_size;
+    // Color attachments, then depth, then stencil.
+    arguments_size +=
+        sizeof(VkRenderingAttachmentInfo) * (color_attachment_count + 2);
+    uint8_t* args_ptr = reinterpret_cast<uint8_t*>(
+        WriteCommand(Command::kVkBeginRendering, arguments_size));
+    auto& args = *reinterpret_cast<ArgsVkBeginRendering*>(args_ptr);
+    args.flags = rendering_info->flags;
+    args.render_area = rendering_info->renderArea;
+    args.layer_count = rendering_info->layerCount;
+    args.view_mask = rendering_info->viewMask;
+    args.color_attachment_count = color_attachment_count;
+    args.has_depth_attachment = rendering_info->pDepthAttachment != nullptr;
+    args.has_stencil_attachment = rendering_info->pStencilAttachment != nullptr;
+    auto attachments = reinterpret_cast<VkRenderingAttachmentInfo*>(
+        args_ptr + attachments_offset);
+    for (uint32_t i = 0; i < color_attachment_count; ++i) {
+      assert_null(rendering_info->pColorAttachments[i].pNext);
+    }
+    if (color_attachment_count) {
+      std::memcpy(attachments, rendering_info->pColorAttachments,
+                  sizeof(VkRenderingAttachmentInfo) * color_attachment_count);
+    }
+    if (rendering_info->pDepthAttachment) {
+      assert_null(rendering_info->pDepthAttachment->pNext);
+      attachments[color_attachment_count] = *rendering_info->pDepthAttachment;
+    }
+    if (rendering_info->pStencilAttachment) {
+      assert_null(rendering_info->pStencilAttachment->pNext);
+      attachments[color_attachment_count + 1] =
+          *rendering_info->pStencilAttachment;
+    }
+  }
+
   void CmdVkBindDescriptorSets(VkPipelineBindPoint pipeline_bind_point,
                                VkPipelineLayout layout, uint32_t first_set,
                                uint32_t descriptor_set_count,
@@ -231,6 +280,32 @@ class DeferredCommandBuffer {
                 regions, sizeof(VkBufferImageCopy) * region_count);
   }
 
+  VkImageCopy* CmdCopyImageEmplace(VkImage src_image,
+                                   VkImageLayout src_image_layout,
+                                   VkImage dst_image,
+                                   VkImageLayout dst_image_layout,
+                                   uint32_t region_count) {
+    const size_t header_size =
+        xe::align(sizeof(ArgsVkCopyImage), alignof(VkImageCopy));
+    uint8_t* args_ptr = reinterpret_cast<uint8_t*>(
+        WriteCommand(Command::kVkCopyImage,
+                     header_size + sizeof(VkImageCopy) * region_count));
+    auto& args = *reinterpret_cast<ArgsVkCopyImage*>(args_ptr);
+    args.src_image = src_image;
+    args.src_image_layout = src_image_layout;
+    args.dst_image = dst_image;
+    args.dst_image_layout = dst_image_layout;
+    args.region_count = region_count;
+    return reinterpret_cast<VkImageCopy*>(args_ptr + header_size);
+  }
+  void CmdVkCopyImage(VkImage src_image, VkImageLayout src_image_layout,
+                      VkImage dst_image, VkImageLayout dst_image_layout,
+                      uint32_t region_count, const VkImageCopy* regions) {
+    std::memcpy(CmdCopyImageEmplace(src_image, src_image_layout, dst_image,
+                                    dst_image_layout, region_count),
+                regions, sizeof(VkImageCopy) * region_count);
+  }
+
   void CmdVkDispatch(uint32_t group_count_x, uint32_t group_count_y,
                      uint32_t group_count_z) {
     auto& args = *reinterpret_cast<ArgsVkDispatch*>(
@@ -262,8 +337,17 @@ class DeferredCommandBuffer {
     args.first_instance = first_instance;
   }
 
+  void CmdVkEndQuery(VkQueryPool query_pool, uint32_t query) {
+    auto& args = *reinterpret_cast<ArgsVkEndQuery*>(
+        WriteCommand(Command::kVkEndQuery, sizeof(ArgsVkEndQuery)));
+    args.query_pool = query_pool;
+    args.query = query;
+  }
+
   void CmdVkEndRenderPass() { WriteCommand(Command::kVkEndRenderPass, 0); }
 
+  void CmdVkEndRendering() { WriteCommand(Command::kVkEndRendering, 0); }
+
   // pNext of all barriers must be null.
   void CmdVkPipelineBarrier(VkPipelineStageFlags src_stage_mask,
                             VkPipelineStageFlags dst_stage_mask,
@@ -288,6 +372,15 @@ class DeferredCommandBuffer {
     std::memcpy(args_ptr + sizeof(ArgsVkPushConstants), values, size);
   }
 
+  void CmdVkResetQueryPool(VkQueryPool query_pool, uint32_t first_query,
+                           uint32_t query_count) {
+    auto& args = *reinterpret_cast<ArgsVkResetQueryPool*>(
+        WriteCommand(Command::kVkResetQueryPool, sizeof(ArgsVkResetQueryPool)));
+    args.query_pool = query_pool;
+    args.first_query = first_query;
+    args.query_count = query_count;
+  }
+
   void CmdVkSetBlendConstants(const float* blend_constants) {
     auto& args = *reinterpret_cast<ArgsVkSetBlendConstants*>(WriteCommand(
         Command::kVkSetBlendConstants, sizeof(ArgsVkSetBlendConstants)));
@@ -357,9 +450,20 @@ class DeferredCommandBuffer {
                 sizeof(VkViewport) * viewport_count);
   }
 
+  void CmdVkWriteTimestamp(VkPipelineStageFlagBits pipeline_stage,
+                           VkQueryPool query_pool, uint32_t query) {
+    auto& args = *reinterpret_cast<ArgsVkWriteTimestamp*>(
+        WriteCommand(Command::kVkWriteTimestamp, sizeof(ArgsVkWriteTimestamp)));
+    args.pipeline_stage = pipeline_stage;
+    args.query_pool = query_pool;
+    args.query = query;
+  }
+
  private:
   enum class Command {
+    kVkBeginQuery,
     kVkBeginRenderPass,
+    kVkBeginRendering,
     kVkBindDescriptorSets,
     kVkBindIndexBuffer,
     kVkBindPipeline,
@@ -368,12 +472,16 @@ class DeferredCommandBuffer {
     kVkClearColorImage,
     kVkCopyBuffer,
     kVkCopyBufferToImage,
+    kVkCopyImage,
     kVkDispatch,
     kVkDraw,
     kVkDrawIndexed,
+    kVkEndQuery,
     kVkEndRenderPass,
+    kVkEndRendering,
     kVkPipelineBarrier,
     kVkPushConstants,
+    kVkResetQueryPool,
     kVkSetBlendConstants,
     kVkSetDepthBias,
     kVkSetScissor,
@@ -381,6 +489,7 @@ class DeferredCommandBuffer {
     kVkSetStencilReference,
     kVkSetStencilWriteMask,
     kVkSetViewport,
+    kVkWriteTimestamp,
   };
 
   struct CommandHeader {
@@ -390,6 +499,12 @@ class DeferredCommandBuffer {
   static constexpr size_t kCommandHeaderSizeElements =
       (sizeof(CommandHeader) + sizeof(uintmax_t) - 1) / sizeof(uintmax_t);
 
+  struct ArgsVkBeginQuery {
+    VkQueryPool query_pool;
+    uint32_t query;
+    VkQueryControlFlags flags;
+  };
+
   struct ArgsVkBeginRenderPass {
     VkRenderPass render_pass;
     VkFramebuffer framebuffer;
@@ -400,6 +515,20 @@ class DeferredCommandBuffer {
     static_assert(alignof(VkClearValue) <= alignof(uintmax_t));
   };
 
+  struct ArgsVkBeginRendering {
+    VkRenderingFlags flags;
+    VkRect2D render_area;
+    uint32_t layer_count;
+    uint32_t view_mask;
+    uint32_t color_attachment_count;
+    bool has_depth_attachment;
+    bool has_stencil_attachment;
+    // Followed by aligned VkRenderingAttachmentInfo[color_attachment_count],
+    // and VkRenderingAttachmentInfo for depth and for stencil, valid only if
+    // has_depth_attachment and has_stencil_attachment respectively.
+    static_assert(alignof(VkRenderingAttachmentInfo) <= alignof(uintmax_t));
+  };
+
   struct ArgsVkBindDescriptorSets {
     VkPipelineBindPoint pipeline_bind_point;
     VkPipelineLayout layout;
@@ -463,6 +592,16 @@ class DeferredCommandBuffer {
     static_assert(alignof(VkBufferImageCopy) <= alignof(uintmax_t));
   };
 
+  struct ArgsVkCopyImage {
+    VkImage src_image;
+    VkImageLayout src_image_layout;
+    VkImage dst_image;
+    VkImageLayout dst_image_layout;
+    uint32_t region_count;
+    // Followed by aligned VkImageCopy[].
+    static_assert(alignof(VkImageCopy) <= alignof(uintmax_t));
+  };
+
   struct ArgsVkDispatch {
     uint32_t group_count_x;
     uint32_t group_count_y;
@@ -484,6 +623,11 @@ class DeferredCommandBuffer {
     uint32_t first_instance;
   };
 
+  struct ArgsVkEndQuery {
+    VkQueryPool query_pool;
+    uint32_t query;
+  };
+
   struct ArgsVkPipelineBarrier {
     VkPipelineStageFlags src_stage_mask;
     VkPipelineStageFlags dst_stage_mask;
@@ -506,6 +650,12 @@ class DeferredCommandBuffer {
     // Followed by `size` bytes of values.
   };
 
+  struct ArgsVkResetQueryPool {
+    VkQueryPool query_pool;
+    uint32_t first_query;
+    uint32_t query_count;
+  };
+
   struct ArgsVkSetBlendConstants {
     float blend_constants[4];
   };
@@ -535,6 +685,12 @@ class DeferredCommandBuffer {
     static_assert(alignof(VkViewport) <= alignof(uintmax_t));
   };
 
+  struct ArgsVkWriteTimestamp {
+    VkPipelineStageFlagBits pipeline_stage;
+    VkQueryPool query_pool;
+    uint32_t query;
+  };
+
   void* WriteCommand(Command command, size_t arguments_size_bytes);
 
   const VulkanCommandProcessor& command_processor_;
@@ -19,8 +19,11 @@
 
 #include "xenia/base/assert.h"
 #include "xenia/base/byte_order.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
+#include "xenia/base/memory.h"
 #include "xenia/base/profiling.h"
 #include "xenia/gpu/draw_util.h"
 #include "xenia/gpu/gpu_flags.h"
@@ -39,6 +42,25 @@
 #include "xenia/ui/vulkan/vulkan_provider.h"
 #include "xenia/ui/vulkan/vulkan_util.h"
 
+DEFINE_bool(vulkan_submit_on_primary_buffer_end, true,
+            "Submit the command buffer when a PM4 primary buffer ends if "
+            "submissions are tracked with a timeline semaphore, to let the GPU "
+            "start executing the commands earlier within the frame.",
+            "Vulkan");
+DEFINE_bool(vulkan_readback_memexport, false,
+            "Read data written by memory export in shaders on the CPU. This "
+            "may be needed in some games, but the readback is done "
+            "asynchronously, so the GPU is only awaited when the guest is "
+            "notified of its progress via an interrupt or a fence write.",
+            "Vulkan");
+DEFINE_bool(vulkan_readback_resolve, false,
+            "Read render-to-texture results on the CPU. This may be needed in "
+            "some games, for instance, for screenshots in saved games, but the "
+            "readback is done asynchronously, so the GPU is only awaited when "
+            "the guest is notified of its progress via an interrupt or a fence "
+            "write.",
+            "Vulkan");
+
 DECLARE_bool(clear_memory_page_state);
 
 namespace xe {
@@ -100,6 +122,12 @@ void VulkanCommandProcessor::ClearCaches() {
   cache_clear_requested_ = true;
 }
 
+void VulkanCommandProcessor::InitializeShaderStorage(
+    const std::filesystem::path& cache_root, uint32_t title_id, bool blocking) {
+  CommandProcessor::InitializeShaderStorage(cache_root, title_id, blocking);
+  pipeline_cache_->InitializeShaderStorage(cache_root, title_id, blocking);
+}
+
 void VulkanCommandProcessor::TracePlaybackWroteMemory(uint32_t base_ptr,
                                                       uint32_t length) {
   shared_memory_->MemoryInvalidationCallback(base_ptr, length, true);
@@ -134,6 +162,21 @@ std::string VulkanCommandProcessor::GetWindowTitleText() const {
   return title.str();
 }
 
+std::optional<RenderTargetCache::Path>
+VulkanCommandProcessor::GetRenderTargetPath() const {
+  if (!render_target_cache_) {
+    return std::nullopt;
+  }
+  return render_target_cache_->GetPath();
+}
+
+std::string VulkanCommandProcessor::GetHostGpuModel() const {
+  const ui::vulkan::VulkanProvider::DeviceInfo& device_info =
+      GetVulkanProvider().device_info();
+  return fmt::format("{:04X}:{:04X}", device_info.vendorID,
+                     device_info.deviceID);
+}
+
 bool VulkanCommandProcessor::SetupContext() {
   if (!CommandProcessor::SetupContext()) {
     XELOGE("Failed to initialize base command processor context");
@@ -164,6 +207,26 @@ bool VulkanCommandProcessor::SetupContext() {
     guest_shader_vertex_stages_ |= VK_SHADER_STAGE_COMPUTE_BIT;
   }
 
+  if (device_info.timelineSemaphore) {
+    VkSemaphoreTypeCreateInfo semaphore_type_create_info;
+    semaphore_type_create_info.sType =
+        VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    semaphore_type_create_info.pNext = nullptr;
+    semaphore_type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphore_type_create_info.initialValue = submission_submitted_;
+    VkSemaphoreCreateInfo semaphore_create_info;
+    semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_create_info.pNext = &semaphore_type_create_info;
+    semaphore_create_info.flags = 0;
+    if (dfn.vkCreateSemaphore(device, &semaphore_create_info, nullptr,
+                              &submission_timeline_semaphore_) != VK_SUCCESS) {
+      XELOGW(
+          "Failed to create the Vulkan submission timeline semaphore, falling "
+          "back to fences");
+      submission_timeline_semaphore_ = VK_NULL_HANDLE;
+    }
+  }
+
   // 16384 is bigger than any single uniform buffer that Xenia needs, but is the
   // minimum maxUniformBufferRange, thus the safe minimum amount.
   uniform_buffer_pool_ = std::make_unique<ui::vulkan::VulkanUploadBufferPool>(
@@ -1033,6 +1096,29 @@ bool VulkanCommandProcessor::SetupContext() {
     return false;
   }
 
+  if (cvars::query_occlusion_host) {
+    // Not fatal if failed - the fake sample count will be reported then.
+    VkQueryPoolCreateInfo occlusion_query_pool_create_info;
+    occlusion_query_pool_create_info.sType =
+        VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    occlusion_query_pool_create_info.pNext = nullptr;
+    occlusion_query_pool_create_info.flags = 0;
+    occlusion_query_pool_create_info.queryType = VK_QUERY_TYPE_OCCLUSION;
+    occlusion_query_pool_create_info.queryCount = kOcclusionQueryCount;
+    occlusion_query_pool_create_info.pipelineStatistics = 0;
+    if (dfn.vkCreateQueryPool(device, &occlusion_query_pool_create_info,
+                              nullptr,
+                              &occlusion_query_pool_) != VK_SUCCESS) {
+      XELOGE("Failed to create the host occlusion query pool");
+      occlusion_query_pool_ = VK_NULL_HANDLE;
+    } else {
+      occlusion_queries_free_.reserve(kOcclusionQueryCount);
+      for (uint32_t i = kOcclusionQueryCount; i; --i) {
+        occlusion_queries_free_.push_back(i - 1);
+      }
+    }
+  }
+
   // Just not to expose uninitialized memory.
   std::memset(&system_constants_, 0, sizeof(system_constants_));
 
@@ -1048,6 +1134,21 @@ void VulkanCommandProcessor::ShutdownContext() {
 
   DestroyScratchBuffer();
 
+  DestroyReadbackBuffers();
+
+  occlusion_query_active_.reset();
+  occlusion_query_host_active_ = false;
+  occlusion_queries_pending_.clear();
+  occlusion_queries_free_.clear();
+  ui::vulkan::util::DestroyAndNullHandle(dfn.vkDestroyQueryPool, device,
+                                         occlusion_query_pool_);
+  gpu_timestamp_submission_labels_.clear();
+  gpu_timestamp_submissions_pending_.clear();
+  gpu_timestamp_operation_skipped_ = true;
+  gpu_timestamp_creation_failed_ = false;
+  ui::vulkan::util::DestroyAndNullHandle(dfn.vkDestroyQueryPool, device,
+                                         gpu_timestamp_query_pool_);
+
   for (SwapFramebuffer& swap_framebuffer : swap_framebuffers_) {
     ui::vulkan::util::DestroyAndNullHandle(dfn.vkDestroyFramebuffer, device,
                                            swap_framebuffer.framebuffer);
@@ -1170,12 +1271,15 @@ void VulkanCommandProcessor::ShutdownContext() {
     dfn.vkDestroyFence(device, fence, nullptr);
   }
   submissions_in_flight_fences_.clear();
+  ui::vulkan::util::DestroyAndNullHandle(dfn.vkDestroySemaphore, device,
+                                         submission_timeline_semaphore_);
   current_submission_wait_stage_masks_.clear();
   for (VkSemaphore semaphore : current_submission_wait_semaphores_) {
     dfn.vkDestroySemaphore(device, semaphore, nullptr);
   }
   current_submission_wait_semaphores_.clear();
   submission_completed_ = 0;
+  submission_submitted_ = 0;
   submission_open_ = false;
 
   for (VkSemaphore semaphore : semaphores_free_) {
@@ -1275,6 +1379,7 @@ void VulkanCommandProcessor::IssueSwap(uint32_t frontbuffer_ptr,
   if (!BeginSubmission(true)) {
     return;
   }
+  WriteGpuTimestamp(GpuTimingCategory::kNone);
 
   // Obtaining the actual front buffer size to pass to RefreshGuestOutput,
   // resolution-scaled if it's a resolve destination, or not otherwise.
@@ -1591,6 +1696,7 @@ void VulkanCommandProcessor::IssueSwap(uint32_t frontbuffer_ptr,
         // Need to submit all the commands before giving the image back to the
         // presenter so it can submit its own commands for displaying it to the
         // queue, and also need to submit the release barrier.
+        WriteGpuTimestamp(GpuTimingCategory::kPresent);
         EndSubmission(true);
         return true;
       });
@@ -1790,11 +1896,35 @@ void VulkanCommandProcessor::SubmitBarriersAndEnterRenderTargetCacheRenderPass(
       current_framebuffer_ == framebuffer) {
     return;
   }
-  if (current_render_pass_ != VK_NULL_HANDLE) {
-    deferred_command_buffer_.CmdVkEndRenderPass();
-  }
+  EndRenderPass();
   current_render_pass_ = render_pass;
   current_framebuffer_ = framebuffer;
+  if (render_pass == VK_NULL_HANDLE) {
+    VkRenderingInfo rendering_info;
+    VkRenderingAttachmentInfo
+        rendering_attachments[1 + xenos::kMaxColorRenderTargets];
+    VkPipelineStageFlags dependency_stage_mask;
+    VkAccessFlags dependency_access_mask;
+    VulkanRenderTargetCache::GetFramebufferRenderingInfo(
+        *framebuffer, rendering_info, rendering_attachments,
+        dependency_stage_mask, dependency_access_mask);
+    if (dependency_stage_mask) {
+      // Without render pass objects, there are no external subpass
+      // dependencies ordering the attachment accesses with the previous
+      // rendering.
+      VkMemoryBarrier memory_barrier;
+      memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      memory_barrier.pNext = nullptr;
+      memory_barrier.srcAccessMask = dependency_access_mask;
+      memory_barrier.dstAccessMask = dependency_access_mask;
+      deferred_command_buffer_.CmdVkPipelineBarrier(
+          dependency_stage_mask, dependency_stage_mask,
+          VK_DEPENDENCY_BY_REGION_BIT, 1, &memory_barrier, 0, nullptr, 0,
+          nullptr);
+    }
+    deferred_command_buffer_.CmdVkBeginRendering(&rendering_info);
+    return;
+  }
   VkRenderPassBeginInfo render_pass_begin_info;
   render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
   render_pass_begin_info.pNext = nullptr;
@@ -1813,10 +1943,14 @@ void VulkanCommandProcessor::SubmitBarriersAndEnterRenderTargetCacheRenderPass(
 
 void VulkanCommandProcessor::EndRenderPass() {
   assert_true(submission_open_);
-  if (current_render_pass_ == VK_NULL_HANDLE) {
+  if (!current_framebuffer_) {
     return;
   }
-  deferred_command_buffer_.CmdVkEndRenderPass();
+  if (current_render_pass_ != VK_NULL_HANDLE) {
+    deferred_command_buffer_.CmdVkEndRenderPass();
+  } else {
+    deferred_command_buffer_.CmdVkEndRendering();
+  }
   current_render_pass_ = VK_NULL_HANDLE;
   current_framebuffer_ = nullptr;
 }
@@ -2256,6 +2390,7 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
     if (!BeginSubmission(true)) {
       return false;
     }
+    WriteGpuTimestamp(GpuTimingCategory::kNone);
 
     // Process primitives.
     if (!primitive_processor_->Process(primitive_processing_result)) {
@@ -2381,6 +2516,7 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
                                     normalized_color_mask, *vertex_shader)) {
     return false;
   }
+  WriteGpuTimestamp(GpuTimingCategory::kRenderTargetUpdate);
 
   // Create the pipeline (for this, need the render pass from the render target
   // cache), translating the shaders - doing this now to obtain the used
@@ -2395,6 +2531,23 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
           pipeline_layout_provider)) {
     return false;
   }
+  if (pipeline == VK_NULL_HANDLE) {
+    // Still being created asynchronously.
+    if (memexport_ranges_.empty()) {
+      // Skip the draw until the pipeline is created on the creation threads.
+      ++frame_draws_skipped_for_pipeline_creation_;
+      RecordDrawSkippedForPipelineCreation();
+      return true;
+    }
+    // The effects of memory export may be needed by the guest, can't skip.
+    uint64_t await_start_host_tick_count = Clock::QueryHostTickCount();
+    pipeline = pipeline_cache_->AwaitCurrentPipelineCreation();
+    ++frame_draws_awaiting_pipeline_creation_;
+    RecordPipelineCreationStall(await_start_host_tick_count);
+    if (pipeline == VK_NULL_HANDLE) {
+      return false;
+    }
+  }
 
   // Update the textures before most other work in the submission because
   // samplers depend on this (and in case of sampler overflow in a submission,
@@ -2405,6 +2558,7 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
            ? pixel_shader->GetUsedTextureMaskAfterTranslation()
            : 0);
   texture_cache_->RequestTextures(used_texture_mask);
+  WriteGpuTimestamp(GpuTimingCategory::kTextureLoad);
 
   // Update the graphics pipeline, and if the new graphics pipeline has a
   // different layout, invalidate incompatible descriptor sets before updating
@@ -2449,7 +2603,9 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
   bool host_render_targets_used = render_target_cache_->GetPath() ==
                                   RenderTargetCache::Path::kHostRenderTargets;
 
-  // Get dynamic rasterizer state.
+  // Get dynamic rasterizer state, recomputing only what depends on registers
+  // that have been written since the previous draw.
+  uint64_t draw_register_write_stamp = register_file_->AdvanceWriteStamp();
   draw_util::ViewportInfo viewport_info;
 
   // Just handling maxViewportDimensions is enough - viewportBoundsRange[1] must
@@ -2474,13 +2630,25 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
                 device_info.maxViewportDimensions[1], true,
                 normalized_depth_control, false, host_render_targets_used,
                 pixel_shader && pixel_shader->writes_depth());
-  gviargs.SetupRegisterValues(regs);
+  if (draw_util::GetViewportInfoArgs::AreRegistersWrittenSince(
+          regs, previous_draw_register_write_stamp_)) {
+    gviargs.SetupRegisterValues(regs);
+  } else {
+    gviargs.CopyRegisterValues(previous_viewport_info_args_);
+  }
 
-  draw_util::GetHostViewportInfo(&gviargs, viewport_info);
+  if (gviargs == previous_viewport_info_args_) {
+    viewport_info = previous_viewport_info_;
+  } else {
+    draw_util::GetHostViewportInfo(&gviargs, viewport_info);
+    previous_viewport_info_args_ = gviargs;
+    previous_viewport_info_ = viewport_info;
+  }
 
   // Update dynamic graphics pipeline state.
   UpdateDynamicState(viewport_info, primitive_polygonal,
                      normalized_depth_control);
+  previous_draw_register_write_stamp_ = draw_register_write_stamp;
 
   auto vgt_draw_initiator = regs.Get<reg::VGT_DRAW_INITIATOR>();
 
@@ -2628,12 +2796,21 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
     deferred_command_buffer_.CmdVkDrawIndexed(
         primitive_processing_result.host_draw_vertex_count, 1, 0, 0, 0);
   }
+  WriteGpuTimestamp(GpuTimingCategory::kDraw, vertex_shader->ucode_data_hash(),
+                    pixel_shader ? pixel_shader->ucode_data_hash() : 0);
 
   // Invalidate textures in memexported memory and watch for changes.
   for (const draw_util::MemExportRange& memexport_range : memexport_ranges_) {
     shared_memory_->RangeWrittenByGpu(memexport_range.base_address_dwords << 2,
                                       memexport_range.size_bytes, false);
   }
+  if (cvars::vulkan_readback_memexport) {
+    for (const draw_util::MemExportRange& memexport_range :
+         memexport_ranges_) {
+      ReadbackAsync(memexport_range.base_address_dwords << 2,
+                    memexport_range.size_bytes);
+    }
+  }
 
   return true;
 }
@@ -2646,14 +2823,21 @@ bool VulkanCommandProcessor::IssueCopy() {
   if (!BeginSubmission(true)) {
     return false;
   }
+  WriteGpuTimestamp(GpuTimingCategory::kNone);
 
   uint32_t written_address, written_length;
-  if (!render_target_cache_->Resolve(*memory_, *shared_memory_, *texture_cache_,
-                                     written_address, written_length)) {
+  bool result =
+      render_target_cache_->Resolve(*memory_, *shared_memory_, *texture_cache_,
+                                    written_address, written_length);
+  WriteGpuTimestamp(GpuTimingCategory::kResolve);
+  if (!result) {
     return false;
   }
 
-  // TODO(Triang3l): CPU readback.
+  if (cvars::vulkan_readback_resolve &&
+      !texture_cache_->IsDrawResolutionScaled()) {
+    ReadbackAsync(written_address, written_length);
+  }
 
   return true;
 }
@@ -2696,59 +2880,99 @@ void VulkanCommandProcessor::CheckSubmissionFenceAndDeviceLoss(
   const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
   VkDevice device = provider.device();
 
-  size_t fences_total = submissions_in_flight_fences_.size();
+  uint64_t submission_completed_new = submission_completed_;
   size_t fences_awaited = 0;
-  if (await_submission > submission_completed_) {
-    // Await in a blocking way if requested.
-    // TODO(Triang3l): Await only one fence. "Fence signal operations that are
-    // defined by vkQueueSubmit additionally include in the first
-    // synchronization scope all commands that occur earlier in submission
-    // order."
-    VkResult wait_result = dfn.vkWaitForFences(
-        device, uint32_t(await_submission - submission_completed_),
-        submissions_in_flight_fences_.data(), VK_TRUE, UINT64_MAX);
-    if (wait_result == VK_SUCCESS) {
-      fences_awaited += await_submission - submission_completed_;
-    } else {
-      XELOGE("Failed to await submission completion Vulkan fences");
-      if (wait_result == VK_ERROR_DEVICE_LOST) {
-        device_lost_ = true;
+  if (submission_timeline_semaphore_ != VK_NULL_HANDLE) {
+    if (await_submission > submission_completed_) {
+      // Await in a blocking way if requested. The semaphore value is the index
+      // of the last completed submission, and submissions signal it in order.
+      VkSemaphoreWaitInfo semaphore_wait_info;
+      semaphore_wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+      semaphore_wait_info.pNext = nullptr;
+      semaphore_wait_info.flags = 0;
+      semaphore_wait_info.semaphoreCount = 1;
+      semaphore_wait_info.pSemaphores = &submission_timeline_semaphore_;
+      semaphore_wait_info.pValues = &await_submission;
+      VkResult wait_result =
+          dfn.vkWaitSemaphores(device, &semaphore_wait_info, UINT64_MAX);
+      if (wait_result != VK_SUCCESS) {
+        XELOGE("Failed to await submission completion Vulkan semaphore");
+        if (wait_result == VK_ERROR_DEVICE_LOST) {
+          device_lost_ = true;
+        }
       }
     }
-  }
-  // Check how far into the submissions the GPU currently is, in order because
-  // submission themselves can be executed out of order, but Xenia serializes
-  // that for simplicity.
-  while (fences_awaited < fences_total) {
-    VkResult fence_status = dfn.vkWaitForFences(
-        device, 1, &submissions_in_flight_fences_[fences_awaited], VK_TRUE, 0);
-    if (fence_status != VK_SUCCESS) {
-      if (fence_status == VK_ERROR_DEVICE_LOST) {
+    if (!device_lost_) {
+      uint64_t semaphore_value;
+      VkResult semaphore_value_result = dfn.vkGetSemaphoreCounterValue(
+          device, submission_timeline_semaphore_, &semaphore_value);
+      if (semaphore_value_result == VK_SUCCESS) {
+        submission_completed_new =
+            std::min(std::max(semaphore_value, submission_completed_),
+                     submission_submitted_);
+      } else if (semaphore_value_result == VK_ERROR_DEVICE_LOST) {
         device_lost_ = true;
       }
-      break;
     }
-    ++fences_awaited;
+  } else {
+    size_t fences_total = submissions_in_flight_fences_.size();
+    if (await_submission > submission_completed_) {
+      // Await in a blocking way if requested.
+      // TODO(Triang3l): Await only one fence. "Fence signal operations that
+      // are defined by vkQueueSubmit additionally include in the first
+      // synchronization scope all commands that occur earlier in submission
+      // order."
+      VkResult wait_result = dfn.vkWaitForFences(
+          device, uint32_t(await_submission - submission_completed_),
+          submissions_in_flight_fences_.data(), VK_TRUE, UINT64_MAX);
+      if (wait_result == VK_SUCCESS) {
+        fences_awaited += await_submission - submission_completed_;
+      } else {
+        XELOGE("Failed to await submission completion Vulkan fences");
+        if (wait_result == VK_ERROR_DEVICE_LOST) {
+          device_lost_ = true;
+        }
+      }
+    }
+    // Check how far into the submissions the GPU currently is, in order
+    // because submission themselves can be executed out of order, but Xenia
+    // serializes that for simplicity.
+    while (fences_awaited < fences_total) {
+      VkResult fence_status = dfn.vkWaitForFences(
+          device, 1, &submissions_in_flight_fences_[fences_awaited], VK_TRUE,
+          0);
+      if (fence_status != VK_SUCCESS) {
+        if (fence_status == VK_ERROR_DEVICE_LOST) {
+          device_lost_ = true;
+        }
+        break;
+      }
+      ++fences_awaited;
+    }
   }
   if (device_lost_) {
     graphics_system_->OnHostGpuLossFromAnyThread(true);
     return;
   }
-  if (!fences_awaited) {
+  if (fences_awaited) {
+    // Reclaim fences.
+    fences_free_.reserve(fences_free_.size() + fences_awaited);
+    auto submissions_in_flight_fences_awaited_end =
+        submissions_in_flight_fences_.cbegin();
+    std::advance(submissions_in_flight_fences_awaited_end, fences_awaited);
+    fences_free_.insert(fences_free_.cend(),
+                        submissions_in_flight_fences_.cbegin(),
+                        submissions_in_flight_fences_awaited_end);
+    submissions_in_flight_fences_.erase(
+        submissions_in_flight_fences_.cbegin(),
+        submissions_in_flight_fences_awaited_end);
+    submission_completed_new += fences_awaited;
+  }
+  if (submission_completed_new == submission_completed_) {
     // Not updated - no need to reclaim or download things.
     return;
   }
-  // Reclaim fences.
-  fences_free_.reserve(fences_free_.size() + fences_awaited);
-  auto submissions_in_flight_fences_awaited_end =
-      submissions_in_flight_fences_.cbegin();
-  std::advance(submissions_in_flight_fences_awaited_end, fences_awaited);
-  fences_free_.insert(fences_free_.cend(),
-                      submissions_in_flight_fences_.cbegin(),
-                      submissions_in_flight_fences_awaited_end);
-  submissions_in_flight_fences_.erase(submissions_in_flight_fences_.cbegin(),
-                                      submissions_in_flight_fences_awaited_end);
-  submission_completed_ += fences_awaited;
+  submission_completed_ = submission_completed_new;
 
   // Reclaim semaphores.
   while (!submissions_in_flight_semaphores_.empty()) {
@@ -2804,6 +3028,12 @@ void VulkanCommandProcessor::CheckSubmissionFenceAndDeviceLoss(
     dfn.vkFreeMemory(device, destroy_pair.second, nullptr);
     destroy_memory_.pop_front();
   }
+
+  CompleteReadbacks(false);
+
+  CompleteOcclusionQueries(false);
+
+  CompleteGpuTimestamps();
 }
 
 bool VulkanCommandProcessor::BeginSubmission(bool is_guest_command) {
@@ -2847,6 +3077,27 @@ bool VulkanCommandProcessor::BeginSubmission(bool is_guest_command) {
       }
       frame_completed_ = frame;
     }
+
+    // Don't let the guest wait for the results of occlusion queries for too
+    // long if it needs them.
+    if (cvars::query_occlusion_host_latency_frames >= 0) {
+      uint64_t occlusion_query_await_submission = 0;
+      for (const OcclusionQuery& occlusion_query :
+           occlusion_queries_pending_) {
+        if (occlusion_query.frame +
+                uint64_t(cvars::query_occlusion_host_latency_frames) >
+            frame_current_) {
+          break;
+        }
+        occlusion_query_await_submission = occlusion_query.submission;
+      }
+      if (occlusion_query_await_submission > submission_completed_) {
+        CheckSubmissionFenceAndDeviceLoss(occlusion_query_await_submission);
+        if (device_lost_) {
+          return false;
+        }
+      }
+    }
   }
 
   if (!submission_open_) {
@@ -2879,6 +3130,12 @@ bool VulkanCommandProcessor::BeginSubmission(bool is_guest_command) {
     primitive_processor_->BeginSubmission();
 
     texture_cache_->BeginSubmission(GetCurrentSubmission());
+
+    // Continue counting the samples for the guest occlusion query in the new
+    // submission.
+    if (occlusion_query_active_ && !BeginHostOcclusionQuery()) {
+      occlusion_query_active_->incomplete = true;
+    }
   }
 
   if (is_opening_frame) {
@@ -2949,6 +3206,16 @@ bool VulkanCommandProcessor::BeginSubmission(bool is_guest_command) {
     primitive_processor_->BeginFrame();
 
     texture_cache_->BeginFrame();
+
+    shared_memory_->BeginFrame();
+
+    render_target_cache_->BeginFrame();
+
+    PublishHostMemoryUsage(
+        texture_cache_->textures_total_host_memory_usage(),
+        shared_memory_->GetHostGpuMemoryUsage(),
+        uniform_buffer_pool_->page_size() +
+            shared_memory_->upload_buffer_pool_size());
   }
 
   return true;
@@ -2961,7 +3228,8 @@ bool VulkanCommandProcessor::EndSubmission(bool is_swap) {
 
   // Make sure everything needed for submitting exist.
   if (submission_open_) {
-    if (fences_free_.empty()) {
+    if (submission_timeline_semaphore_ == VK_NULL_HANDLE &&
+        fences_free_.empty()) {
       VkFenceCreateInfo fence_create_info;
       fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
       fence_create_info.pNext = nullptr;
@@ -3024,6 +3292,15 @@ bool VulkanCommandProcessor::EndSubmission(bool is_swap) {
 
   if (is_closing_frame) {
     primitive_processor_->EndFrame();
+
+    COUNT_profile_set("gpu/pipeline_cache/pending_pipelines",
+                      pipeline_cache_->GetPendingPipelineCount());
+    COUNT_profile_set("gpu/pipeline_cache/draws_skipped",
+                      frame_draws_skipped_for_pipeline_creation_);
+    COUNT_profile_set("gpu/pipeline_cache/draws_awaiting_creation",
+                      frame_draws_awaiting_pipeline_creation_);
+    frame_draws_skipped_for_pipeline_creation_ = 0;
+    frame_draws_awaiting_pipeline_creation_ = 0;
   }
 
   if (submission_open_) {
@@ -3031,12 +3308,18 @@ bool VulkanCommandProcessor::EndSubmission(bool is_swap) {
 
     EndRenderPass();
 
+    EndHostOcclusionQuery();
+
+    EndGpuTimestampSubmission();
+
     render_target_cache_->EndSubmission();
 
     primitive_processor_->EndSubmission();
 
     shared_memory_->EndSubmission();
 
+    pipeline_cache_->EndSubmission();
+
     uniform_buffer_pool_->FlushWrites();
 
     // Submit sparse binds earlier, before executing the deferred command
@@ -3133,13 +3416,31 @@ bool VulkanCommandProcessor::EndSubmission(bool is_swap) {
     }
     submit_info.commandBufferCount = 1;
     submit_info.pCommandBuffers = &command_buffer.buffer;
-    submit_info.signalSemaphoreCount = 0;
-    submit_info.pSignalSemaphores = nullptr;
-    assert_false(fences_free_.empty());
-    VkFence fence = fences_free_.back();
-    if (dfn.vkResetFences(device, 1, &fence) != VK_SUCCESS) {
-      XELOGE("Failed to reset a Vulkan submission fence");
-      return false;
+    uint64_t submission_current = GetCurrentSubmission();
+    VkTimelineSemaphoreSubmitInfo timeline_semaphore_submit_info;
+    VkFence fence = VK_NULL_HANDLE;
+    if (submission_timeline_semaphore_ != VK_NULL_HANDLE) {
+      timeline_semaphore_submit_info.sType =
+          VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+      timeline_semaphore_submit_info.pNext = nullptr;
+      // The wait semaphores are binary, their values are ignored.
+      timeline_semaphore_submit_info.waitSemaphoreValueCount = 0;
+      timeline_semaphore_submit_info.pWaitSemaphoreValues = nullptr;
+      timeline_semaphore_submit_info.signalSemaphoreValueCount = 1;
+      timeline_semaphore_submit_info.pSignalSemaphoreValues =
+          &submission_current;
+      submit_info.pNext = &timeline_semaphore_submit_info;
+      submit_info.signalSemaphoreCount = 1;
+      submit_info.pSignalSemaphores = &submission_timeline_semaphore_;
+    } else {
+      submit_info.signalSemaphoreCount = 0;
+      submit_info.pSignalSemaphores = nullptr;
+      assert_false(fences_free_.empty());
+      fence = fences_free_.back();
+      if (dfn.vkResetFences(device, 1, &fence) != VK_SUCCESS) {
+        XELOGE("Failed to reset a Vulkan submission fence");
+        return false;
+      }
     }
     VkResult submit_result;
     {
@@ -3156,7 +3457,6 @@ bool VulkanCommandProcessor::EndSubmission(bool is_swap) {
       }
       return false;
     }
-    uint64_t submission_current = GetCurrentSubmission();
     current_submission_wait_stage_masks_.clear();
     for (VkSemaphore semaphore : current_submission_wait_semaphores_) {
       submissions_in_flight_semaphores_.emplace_back(submission_current,
@@ -3165,9 +3465,12 @@ bool VulkanCommandProcessor::EndSubmission(bool is_swap) {
     current_submission_wait_semaphores_.clear();
     command_buffers_submitted_.emplace_back(submission_current, command_buffer);
     command_buffers_writable_.pop_back();
+    if (fence != VK_NULL_HANDLE) {
+      submissions_in_flight_fences_.push_back(fence);
+      fences_free_.pop_back();
+    }
     // Increments the current submission number, going to the next submission.
-    submissions_in_flight_fences_.push_back(fence);
-    fences_free_.pop_back();
+    ++submission_submitted_;
 
     submission_open_ = false;
   }
@@ -3273,6 +3576,430 @@ void VulkanCommandProcessor::DestroyScratchBuffer() {
                                          scratch_buffer_memory_);
 }
 
+void VulkanCommandProcessor::OnPrimaryBufferEnd() {
+  // With fences, splitting the frame would require a fence reset and wait per
+  // submission, but with a timeline semaphore, an additional submission only
+  // increments the signaled value.
+  if (cvars::vulkan_submit_on_primary_buffer_end && submission_open_ &&
+      submission_timeline_semaphore_ != VK_NULL_HANDLE) {
+    EndSubmission(false);
+  }
+}
+
+void VulkanCommandProcessor::PrepareForWait() {
+  CommandProcessor::PrepareForWait();
+  // The guest may be waiting for the results of the work in the current
+  // submission, make sure the GPU starts executing it.
+  if (submission_open_ &&
+      ((!readbacks_pending_.empty() &&
+        readbacks_pending_.back().submission == GetCurrentSubmission()) ||
+       (!occlusion_queries_pending_.empty() &&
+        occlusion_queries_pending_.back().submission ==
+            GetCurrentSubmission()))) {
+    EndSubmission(false);
+  }
+}
+
+void VulkanCommandProcessor::PollWhileWaiting() {
+  if (!readbacks_pending_.empty() || !occlusion_queries_pending_.empty()) {
+    CheckSubmissionFenceAndDeviceLoss(0);
+  }
+}
+
+bool VulkanCommandProcessor::BeginOcclusionQuery() {
+  if (occlusion_query_pool_ == VK_NULL_HANDLE || !BeginSubmission(true)) {
+    return false;
+  }
+  if (occlusion_query_active_) {
+    // Begun again without ending - the previous result is not needed.
+    EndHostOcclusionQuery();
+    for (uint32_t host_query : occlusion_query_active_->host_queries) {
+      occlusion_queries_free_.push_back(host_query);
+    }
+    occlusion_query_active_.reset();
+  }
+  OcclusionQuery& occlusion_query = occlusion_query_active_.emplace();
+  occlusion_query.sample_counts_address = 0;
+  occlusion_query.frame = 0;
+  occlusion_query.submission = 0;
+  occlusion_query.incomplete = false;
+  if (!BeginHostOcclusionQuery()) {
+    occlusion_query_active_.reset();
+    return false;
+  }
+  return true;
+}
+
+bool VulkanCommandProcessor::EndOcclusionQuery(uint32_t sample_counts_address) {
+  if (!occlusion_query_active_) {
+    return false;
+  }
+  BeginSubmission(true);
+  EndHostOcclusionQuery();
+  OcclusionQuery& occlusion_query = *occlusion_query_active_;
+  if (occlusion_query.incomplete || occlusion_query.host_queries.empty()) {
+    for (uint32_t host_query : occlusion_query.host_queries) {
+      occlusion_queries_free_.push_back(host_query);
+    }
+    occlusion_query_active_.reset();
+    return false;
+  }
+  occlusion_query.sample_counts_address = sample_counts_address;
+  occlusion_query.frame = frame_current_;
+  occlusion_queries_pending_.push_back(std::move(occlusion_query));
+  occlusion_query_active_.reset();
+  return true;
+}
+
+bool VulkanCommandProcessor::BeginHostOcclusionQuery() {
+  assert_true(occlusion_query_active_.has_value());
+  assert_false(occlusion_query_host_active_);
+  if (!submission_open_ || occlusion_queries_free_.empty()) {
+    return false;
+  }
+  uint32_t host_query = occlusion_queries_free_.back();
+  occlusion_queries_free_.pop_back();
+  // Beginning outside a render pass so the query may span multiple render
+  // passes.
+  EndRenderPass();
+  deferred_command_buffer_.CmdVkResetQueryPool(occlusion_query_pool_,
+                                               host_query, 1);
+  deferred_command_buffer_.CmdVkBeginQuery(
+      occlusion_query_pool_, host_query,
+      GetVulkanProvider().device_info().occlusionQueryPrecise
+          ? VK_QUERY_CONTROL_PRECISE_BIT
+          : 0);
+  occlusion_query_active_->host_queries.push_back(host_query);
+  occlusion_query_host_active_ = true;
+  return true;
+}
+
+void VulkanCommandProcessor::EndHostOcclusionQuery() {
+  if (!occlusion_query_host_active_) {
+    return;
+  }
+  assert_true(submission_open_);
+  EndRenderPass();
+  deferred_command_buffer_.CmdVkEndQuery(
+      occlusion_query_pool_, occlusion_query_active_->host_queries.back());
+  occlusion_query_active_->submission = GetCurrentSubmission();
+  occlusion_query_host_active_ = false;
+}
+
+void VulkanCommandProcessor::CompleteOcclusionQueries(bool await) {
+  if (occlusion_queries_pending_.empty()) {
+    return;
+  }
+  if (await) {
+    // Calls CompleteOcclusionQueries(false) after the submissions have been
+    // awaited.
+    CheckSubmissionFenceAndDeviceLoss(
+        occlusion_queries_pending_.back().submission);
+  }
+  const ui::vulkan::VulkanProvider& provider = GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+  // Report the sample count at the guest resolution.
+  uint64_t resolution_scale =
+      uint64_t(texture_cache_->draw_resolution_scale_x()) *
+      texture_cache_->draw_resolution_scale_y();
+  while (!occlusion_queries_pending_.empty()) {
+    OcclusionQuery& occlusion_query = occlusion_queries_pending_.front();
+    if (occlusion_query.submission > submission_completed_) {
+      break;
+    }
+    uint64_t sample_count = 0;
+    for (uint32_t host_query : occlusion_query.host_queries) {
+      uint64_t host_sample_count;
+      if (dfn.vkGetQueryPoolResults(device, occlusion_query_pool_, host_query,
+                                    1, sizeof(host_sample_count),
+                                    &host_sample_count,
+                                    sizeof(host_sample_count),
+                                    VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+        sample_count += host_sample_count;
+      }
+      occlusion_queries_free_.push_back(host_query);
+    }
+    WriteOcclusionQueryResult(
+        occlusion_query.sample_counts_address,
+        uint32_t(std::min(sample_count / resolution_scale,
+                          uint64_t(UINT32_MAX))));
+    occlusion_queries_pending_.pop_front();
+  }
+}
+
+void VulkanCommandProcessor::OnBeginBenchmark() {
+  AwaitAllQueueOperationsCompletion();
+  benchmark_upload_bytes_start_ = shared_memory_->total_upload_bytes();
+}
+
+void VulkanCommandProcessor::OnEndBenchmark() {
+  AwaitAllQueueOperationsCompletion();
+  benchmark_statistics_.gpu_timing_supported =
+      gpu_timestamp_query_pool_ != VK_NULL_HANDLE;
+  benchmark_statistics_.upload_bytes =
+      shared_memory_->total_upload_bytes() - benchmark_upload_bytes_start_;
+}
+
+void VulkanCommandProcessor::WriteGpuTimestamp(GpuTimingCategory category,
+                                               uint64_t vertex_shader_hash,
+                                               uint64_t pixel_shader_hash) {
+  if (category == GpuTimingCategory::kNone) {
+    gpu_timestamp_operation_skipped_ = true;
+    if (!submission_open_ || !is_gpu_timing_enabled()) {
+      return;
+    }
+    if (gpu_timestamp_query_pool_ == VK_NULL_HANDLE) {
+      const ui::vulkan::VulkanProvider& provider = GetVulkanProvider();
+      if (gpu_timestamp_creation_failed_ ||
+          !provider.device_info().timestampComputeAndGraphics) {
+        return;
+      }
+      const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+      VkDevice device = provider.device();
+      VkQueryPoolCreateInfo timestamp_query_pool_create_info;
+      timestamp_query_pool_create_info.sType =
+          VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+      timestamp_query_pool_create_info.pNext = nullptr;
+      timestamp_query_pool_create_info.flags = 0;
+      timestamp_query_pool_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+      timestamp_query_pool_create_info.queryCount = kGpuTimestampCount;
+      timestamp_query_pool_create_info.pipelineStatistics = 0;
+      if (dfn.vkCreateQueryPool(device, &timestamp_query_pool_create_info,
+                                nullptr, &gpu_timestamp_query_pool_) !=
+          VK_SUCCESS) {
+        XELOGE("Failed to create the GPU timestamp query pool");
+        gpu_timestamp_query_pool_ = VK_NULL_HANDLE;
+        gpu_timestamp_creation_failed_ = true;
+        return;
+      }
+    }
+    if (gpu_timestamps_written_ + kGpuTimestampsPerOperationMax >
+        gpu_timestamps_reset_end_) {
+      // The timestamps of the pending submissions are still in use.
+      uint64_t first_in_use =
+          gpu_timestamp_submissions_pending_.empty()
+              ? gpu_timestamp_submission_first_
+              : gpu_timestamp_submissions_pending_.front().first;
+      auto reset_count = uint32_t(std::min(
+          uint64_t(kGpuTimestampResetBatchSize),
+          kGpuTimestampCount - (gpu_timestamps_written_ - first_in_use)));
+      if (reset_count < kGpuTimestampsPerOperationMax) {
+        return;
+      }
+      // Queries can be reset only outside a render pass.
+      EndRenderPass();
+      auto first = uint32_t(gpu_timestamps_written_ % kGpuTimestampCount);
+      // May wrap around the end of the ring.
+      uint32_t reset_count_before_end =
+          std::min(reset_count, kGpuTimestampCount - first);
+      deferred_command_buffer_.CmdVkResetQueryPool(
+          gpu_timestamp_query_pool_, first, reset_count_before_end);
+      if (reset_count_before_end < reset_count) {
+        deferred_command_buffer_.CmdVkResetQueryPool(
+            gpu_timestamp_query_pool_, 0, reset_count - reset_count_before_end);
+      }
+      gpu_timestamps_reset_end_ = gpu_timestamps_written_ + reset_count;
+    }
+    gpu_timestamp_operation_skipped_ = false;
+  } else if (gpu_timestamp_operation_skipped_ || !submission_open_ ||
+             gpu_timestamps_written_ >= gpu_timestamps_reset_end_) {
+    return;
+  }
+  deferred_command_buffer_.CmdVkWriteTimestamp(
+      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, gpu_timestamp_query_pool_,
+      uint32_t(gpu_timestamps_written_ % kGpuTimestampCount));
+  ++gpu_timestamps_written_;
+  GpuTimestampLabel& label = gpu_timestamp_submission_labels_.emplace_back();
+  label.category = category;
+  label.vertex_shader_hash = vertex_shader_hash;
+  label.pixel_shader_hash = pixel_shader_hash;
+}
+
+void VulkanCommandProcessor::EndGpuTimestampSubmission() {
+  gpu_timestamp_operation_skipped_ = true;
+  // The queries reset, but not written in this submission, will be reset again
+  // in the next one if needed.
+  gpu_timestamps_reset_end_ = gpu_timestamps_written_;
+  if (gpu_timestamp_submission_labels_.empty()) {
+    return;
+  }
+  GpuTimestampSubmission& submission =
+      gpu_timestamp_submissions_pending_.emplace_back();
+  submission.submission = GetCurrentSubmission();
+  submission.frame = frame_current_;
+  submission.first = gpu_timestamp_submission_first_;
+  submission.labels = std::move(gpu_timestamp_submission_labels_);
+  gpu_timestamp_submission_labels_.clear();
+  gpu_timestamp_submission_first_ = gpu_timestamps_written_;
+}
+
+void VulkanCommandProcessor::CompleteGpuTimestamps() {
+  if (gpu_timestamp_submissions_pending_.empty()) {
+    return;
+  }
+  const ui::vulkan::VulkanProvider& provider = GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+  auto ns_per_tick = double(provider.device_info().timestampPeriod);
+  std::vector<uint64_t> timestamps;
+  while (!gpu_timestamp_submissions_pending_.empty()) {
+    GpuTimestampSubmission& submission =
+        gpu_timestamp_submissions_pending_.front();
+    if (submission.submission > submission_completed_) {
+      break;
+    }
+    auto first = uint32_t(submission.first % kGpuTimestampCount);
+    auto count = uint32_t(submission.labels.size());
+    uint32_t count_before_end = std::min(count, kGpuTimestampCount - first);
+    timestamps.resize(count);
+    if (dfn.vkGetQueryPoolResults(
+            device, gpu_timestamp_query_pool_, first, count_before_end,
+            sizeof(uint64_t) * count_before_end, timestamps.data(),
+            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS &&
+        (count_before_end >= count ||
+         dfn.vkGetQueryPoolResults(
+             device, gpu_timestamp_query_pool_, 0, count - count_before_end,
+             sizeof(uint64_t) * (count - count_before_end),
+             timestamps.data() + count_before_end, sizeof(uint64_t),
+             VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)) {
+      AccumulateGpuTimestamps(submission.frame, timestamps.data(),
+                              submission.labels.data(), count, ns_per_tick);
+    }
+    gpu_timestamp_submissions_pending_.pop_front();
+  }
+}
+
+void VulkanCommandProcessor::ReadbackAsync(uint32_t address, uint32_t length) {
+  if (!length) {
+    return;
+  }
+  // Keep the ranges starting at cache line boundaries in the buffer, for
+  // copying with non-temporal stores.
+  VkDeviceSize length_aligned =
+      xe::align(VkDeviceSize(length), VkDeviceSize(XE_HOST_CACHE_LINE_SIZE));
+  PendingReadback* readback = nullptr;
+  if (!readbacks_pending_.empty()) {
+    PendingReadback& readback_last = readbacks_pending_.back();
+    if (readback_last.submission == GetCurrentSubmission() &&
+        readback_last.buffer.size - readback_last.buffer_used >=
+            length_aligned) {
+      readback = &readback_last;
+    }
+  }
+  if (!readback) {
+    ReadbackBuffer buffer = {};
+    for (auto it = readback_buffers_free_.begin();
+         it != readback_buffers_free_.end(); ++it) {
+      if (it->size >= length_aligned) {
+        buffer = *it;
+        readback_buffers_free_.erase(it);
+        break;
+      }
+    }
+    if (buffer.buffer == VK_NULL_HANDLE) {
+      const ui::vulkan::VulkanProvider& provider = GetVulkanProvider();
+      const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+      VkDevice device = provider.device();
+      VkDeviceSize size =
+          xe::align(length_aligned, kReadbackBufferSizeIncrement);
+      if (!ui::vulkan::util::CreateDedicatedAllocationBuffer(
+              provider, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+              ui::vulkan::util::MemoryPurpose::kReadback, buffer.buffer,
+              buffer.memory, &buffer.memory_type)) {
+        XELOGE("Failed to create a {} MB readback buffer", size >> 20);
+        return;
+      }
+      void* mapping;
+      if (dfn.vkMapMemory(device, buffer.memory, 0, VK_WHOLE_SIZE, 0,
+                          &mapping) != VK_SUCCESS) {
+        XELOGE("Failed to map a {} MB readback buffer", size >> 20);
+        dfn.vkDestroyBuffer(device, buffer.buffer, nullptr);
+        dfn.vkFreeMemory(device, buffer.memory, nullptr);
+        return;
+      }
+      buffer.mapping = reinterpret_cast<const uint8_t*>(mapping);
+      buffer.size = size;
+    }
+    readback = &readbacks_pending_.emplace_back();
+    readback->buffer = buffer;
+    readback->submission = GetCurrentSubmission();
+    readback->buffer_used = 0;
+  }
+  shared_memory_->Use(VulkanSharedMemory::Usage::kRead);
+  SubmitBarriers(true);
+  VkBufferCopy* region = deferred_command_buffer_.CmdCopyBufferEmplace(
+      shared_memory_->buffer(), readback->buffer.buffer, 1);
+  region->srcOffset = address;
+  region->dstOffset = readback->buffer_used;
+  region->size = length;
+  PushBufferMemoryBarrier(
+      readback->buffer.buffer, readback->buffer_used, length,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+      VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+  readback->ranges.emplace_back(address, length);
+  readback->buffer_used += length_aligned;
+}
+
+void VulkanCommandProcessor::CompleteReadbacks(bool await) {
+  if (readbacks_pending_.empty()) {
+    return;
+  }
+  if (await) {
+    // Calls CompleteReadbacks(false) after the submissions have been awaited.
+    CheckSubmissionFenceAndDeviceLoss(readbacks_pending_.back().submission);
+  }
+  const ui::vulkan::VulkanProvider& provider = GetVulkanProvider();
+  while (!readbacks_pending_.empty()) {
+    PendingReadback& readback = readbacks_pending_.front();
+    if (readback.submission > submission_completed_) {
+      break;
+    }
+    if (!(provider.device_info().memory_types_host_coherent &
+          (uint32_t(1) << readback.buffer.memory_type))) {
+      VkMappedMemoryRange range;
+      range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+      range.pNext = nullptr;
+      range.memory = readback.buffer.memory;
+      range.offset = 0;
+      range.size = VK_WHOLE_SIZE;
+      provider.dfn().vkInvalidateMappedMemoryRanges(provider.device(), 1,
+                                                    &range);
+    }
+    const uint8_t* source = readback.buffer.mapping;
+    for (const std::pair<uint32_t, uint32_t>& range : readback.ranges) {
+      uint8_t* destination = memory_->TranslatePhysical(range.first);
+      if (!((range.first | range.second) & (XE_HOST_CACHE_LINE_SIZE - 1))) {
+        memory::vastcpy(destination, const_cast<uint8_t*>(source),
+                        range.second);
+      } else {
+        std::memcpy(destination, source, range.second);
+      }
+      source += xe::align(range.second, uint32_t(XE_HOST_CACHE_LINE_SIZE));
+    }
+    readback_buffers_free_.push_back(readback.buffer);
+    readbacks_pending_.pop_front();
+  }
+}
+
+void VulkanCommandProcessor::DestroyReadbackBuffers() {
+  const ui::vulkan::VulkanProvider& provider = GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+
+  // All submissions must have been awaited, so the pending readbacks, if any,
+  // are only left if the device has been lost.
+  for (const PendingReadback& readback : readbacks_pending_) {
+    readback_buffers_free_.push_back(readback.buffer);
+  }
+  readbacks_pending_.clear();
+  for (const ReadbackBuffer& buffer : readback_buffers_free_) {
+    dfn.vkDestroyBuffer(device, buffer.buffer, nullptr);
+    dfn.vkFreeMemory(device, buffer.memory, nullptr);
+  }
+  readback_buffers_free_.clear();
+}
+
 void VulkanCommandProcessor::UpdateDynamicState(
     const draw_util::ViewportInfo& viewport_info, bool primitive_polygonal,
     reg::RB_DEPTHCONTROL normalized_depth_control) {
@@ -3309,8 +4036,11 @@ void VulkanCommandProcessor::UpdateDynamicState(
   SetViewport(viewport);
 
   // Scissor.
-  draw_util::Scissor scissor;
-  draw_util::GetScissor(regs, scissor);
+  if (draw_util::AreScissorRegistersWrittenSince(
+          regs, previous_draw_register_write_stamp_)) {
+    draw_util::GetScissor(regs, previous_scissor_);
+  }
+  const draw_util::Scissor& scissor = previous_scissor_;
   VkRect2D scissor_rect;
   scissor_rect.offset.x = int32_t(scissor.offset[0]);
   scissor_rect.offset.y = int32_t(scissor.offset[1]);
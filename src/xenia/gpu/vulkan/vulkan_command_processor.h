@@ -16,6 +16,7 @@
 #include <deque>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -23,6 +24,7 @@
 
 #include "xenia/base/assert.h"
 #include "xenia/base/hash.h"
+#include "xenia/base/pool_allocator.h"
 #include "xenia/gpu/command_processor.h"
 #include "xenia/gpu/draw_util.h"
 #include "xenia/gpu/registers.h"
@@ -143,6 +145,9 @@ class VulkanCommandProcessor final : public CommandProcessor {
 
   void ClearCaches() override;
 
+  void InitializeShaderStorage(const std::filesystem::path& cache_root,
+                               uint32_t title_id, bool blocking) override;
+
   void TracePlaybackWroteMemory(uint32_t base_ptr, uint32_t length) override;
 
   void RestoreEdramSnapshot(const void* snapshot) override;
@@ -160,10 +165,7 @@ class VulkanCommandProcessor final : public CommandProcessor {
   }
 
   bool submission_open() const { return submission_open_; }
-  uint64_t GetCurrentSubmission() const {
-    return submission_completed_ +
-           uint64_t(submissions_in_flight_fences_.size()) + 1;
-  }
+  uint64_t GetCurrentSubmission() const { return submission_submitted_ + 1; }
   uint64_t GetCompletedSubmission() const { return submission_completed_; }
 
   // Sparse binds are:
@@ -264,6 +266,9 @@ class VulkanCommandProcessor final : public CommandProcessor {
   // Returns the text to display in the GPU backend name in the window title.
   std::string GetWindowTitleText() const;
 
+  std::optional<RenderTargetCache::Path> GetRenderTargetPath() const override;
+  std::string GetHostGpuModel() const override;
+
  protected:
   bool SetupContext() override;
   void ShutdownContext() override;
@@ -288,6 +293,26 @@ class VulkanCommandProcessor final : public CommandProcessor {
                  bool major_mode_explicit) override;
   bool IssueCopy() override;
 
+  void FlushReadbacks() override {
+    if (!readbacks_pending_.empty()) {
+      CompleteReadbacks(true);
+    }
+  }
+
+  void OnPrimaryBufferEnd() override;
+
+  void PrepareForWait() override;
+  void PollWhileWaiting() override;
+  bool IsPollingWhileWaitingNeeded() const override {
+    return !readbacks_pending_.empty() || !occlusion_queries_pending_.empty();
+  }
+
+  bool BeginOcclusionQuery() override;
+  bool EndOcclusionQuery(uint32_t sample_counts_address) override;
+
+  void OnBeginBenchmark() override;
+  void OnEndBenchmark() override;
+
   void InitializeTrace() override;
 
  private:
@@ -432,7 +457,7 @@ class VulkanCommandProcessor final : public CommandProcessor {
   bool EndSubmission(bool is_swap);
   bool AwaitAllQueueOperationsCompletion() {
     CheckSubmissionFenceAndDeviceLoss(GetCurrentSubmission());
-    return !submission_open_ && submissions_in_flight_fences_.empty();
+    return !submission_open_ && submission_completed_ >= submission_submitted_;
   }
 
   void ClearTransientDescriptorPools();
@@ -441,6 +466,36 @@ class VulkanCommandProcessor final : public CommandProcessor {
 
   void DestroyScratchBuffer();
 
+  // Copies a range of shared memory to a persistently mapped readback buffer
+  // without waiting for the GPU, the data is written to guest memory when the
+  // current submission is completed, or when the readbacks are flushed.
+  void ReadbackAsync(uint32_t address, uint32_t length);
+  // Writes the data from the completed asynchronous readbacks to guest memory,
+  // or, if await is true, waits for all the pending ones.
+  void CompleteReadbacks(bool await);
+  void DestroyReadbackBuffers();
+
+  // Begins or ends the host query for the active guest occlusion query in the
+  // current submission, outside a render pass.
+  bool BeginHostOcclusionQuery();
+  void EndHostOcclusionQuery();
+  // Writes the results of the completed occlusion queries to guest memory, or,
+  // if await is true, waits for all the pending ones.
+  void CompleteOcclusionQueries(bool await);
+
+  // Writes a GPU timestamp ending the work of the specified category if GPU
+  // timing is enabled. kNone must be written in the beginning of an operation,
+  // and if there's no space for the timestamps of the operation in the ring,
+  // the rest of them are skipped until the next operation. May end the render
+  // pass with kNone to reset the queries.
+  void WriteGpuTimestamp(GpuTimingCategory category,
+                         uint64_t vertex_shader_hash = 0,
+                         uint64_t pixel_shader_hash = 0);
+  // Called before the current submission is ended.
+  void EndGpuTimestampSubmission();
+  // Accumulates the timestamps of the completed submissions.
+  void CompleteGpuTimestamps();
+
   void UpdateDynamicState(const draw_util::ViewportInfo& viewport_info,
                           bool primitive_polygonal,
                           reg::RB_DEPTHCONTROL normalized_depth_control);
@@ -482,6 +537,12 @@ class VulkanCommandProcessor final : public CommandProcessor {
 
   bool submission_open_ = false;
   uint64_t submission_completed_ = 0;
+  uint64_t submission_submitted_ = 0;
+  // If VK_KHR_timeline_semaphore is supported, signaled with the index of each
+  // submission, so the completed submission can be obtained with a single
+  // counter query, without a fence per submission. Otherwise, fences from
+  // fences_free_ and submissions_in_flight_fences_ are used.
+  VkSemaphore submission_timeline_semaphore_ = VK_NULL_HANDLE;
   // In case vkQueueSubmit fails after something like a successful
   // vkQueueBindSparse, to wait correctly on the next attempt.
   std::vector<VkSemaphore> current_submission_wait_semaphores_;
@@ -498,6 +559,10 @@ class VulkanCommandProcessor final : public CommandProcessor {
   uint64_t frame_completed_ = 0;
   // Submission indices of frames that have already been submitted.
   uint64_t closed_frame_submissions_[kMaxFramesInFlight] = {};
+  // Draws in the current frame that have been skipped, or that have had to
+  // wait, because their pipelines were still being created asynchronously.
+  uint32_t frame_draws_skipped_for_pipeline_creation_ = 0;
+  uint32_t frame_draws_awaiting_pipeline_creation_ = 0;
 
   // <Submission where last used, resource>, sorted by the submission number.
   std::deque<std::pair<uint64_t, VkDeviceMemory>> destroy_memory_;
@@ -655,6 +720,79 @@ class VulkanCommandProcessor final : public CommandProcessor {
   uint64_t scratch_buffer_last_usage_submission_ = 0;
   bool scratch_buffer_used_ = false;
 
+  static constexpr VkDeviceSize kReadbackBufferSizeIncrement = 4 * 1024 * 1024;
+  struct ReadbackBuffer {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    uint32_t memory_type;
+    const uint8_t* mapping;
+    VkDeviceSize size;
+  };
+  struct PendingReadback {
+    ReadbackBuffer buffer;
+    uint64_t submission;
+    VkDeviceSize buffer_used;
+    // <Guest physical address, length>, in the order of the data in the
+    // buffer, each range starting at a cache line boundary in the buffer.
+    // Usually a few, pooled as readbacks are created very frequently.
+    pooled_vector<std::pair<uint32_t, uint32_t>> ranges;
+  };
+  // Sorted by the submission number.
+  std::deque<PendingReadback> readbacks_pending_;
+  std::vector<ReadbackBuffer> readback_buffers_free_;
+
+  static constexpr uint32_t kOcclusionQueryCount = 4096;
+  VkQueryPool occlusion_query_pool_ = VK_NULL_HANDLE;
+  std::vector<uint32_t> occlusion_queries_free_;
+  struct OcclusionQuery {
+    uint32_t sample_counts_address;
+    // The frame in which the guest query has been ended.
+    uint64_t frame;
+    // The last submission with host queries for this guest query.
+    uint64_t submission;
+    // The guest query is split into multiple host queries if it spans multiple
+    // submissions, the results are summed.
+    // Pooled, as there may be a guest query for every draw.
+    pooled_vector<uint32_t> host_queries;
+    // Whether the host query couldn't be begun in some submission.
+    bool incomplete;
+  };
+  // The guest query between the begin and the end EVENT_WRITE_ZPD.
+  std::optional<OcclusionQuery> occlusion_query_active_;
+  // Whether the last of host_queries of occlusion_query_active_ has been begun
+  // in the current submission and not ended yet.
+  bool occlusion_query_host_active_ = false;
+  // Ended guest queries, sorted by the submission number.
+  std::deque<OcclusionQuery> occlusion_queries_pending_;
+
+  // Ring of GPU timestamps, created when GPU timing is enabled for the first
+  // time if supported by the device.
+  static constexpr uint32_t kGpuTimestampCount = 16384;
+  static constexpr uint32_t kGpuTimestampsPerOperationMax = 4;
+  // Queries are reset in the command buffer in batches to avoid ending the
+  // render pass for every operation.
+  static constexpr uint32_t kGpuTimestampResetBatchSize = 1024;
+  VkQueryPool gpu_timestamp_query_pool_ = VK_NULL_HANDLE;
+  bool gpu_timestamp_creation_failed_ = false;
+  // Total number of the timestamps written, not wrapped.
+  uint64_t gpu_timestamps_written_ = 0;
+  // End of the timestamps reset in the current submission, not wrapped.
+  uint64_t gpu_timestamps_reset_end_ = 0;
+  // The first timestamp of the current submission, not wrapped.
+  uint64_t gpu_timestamp_submission_first_ = 0;
+  std::vector<GpuTimestampLabel> gpu_timestamp_submission_labels_;
+  // Whether the rest of the timestamps of the current operation is skipped.
+  bool gpu_timestamp_operation_skipped_ = true;
+  struct GpuTimestampSubmission {
+    uint64_t submission;
+    uint64_t frame;
+    uint64_t first;
+    std::vector<GpuTimestampLabel> labels;
+  };
+  // Sorted by the submission number.
+  std::deque<GpuTimestampSubmission> gpu_timestamp_submissions_pending_;
+  uint64_t benchmark_upload_bytes_start_ = 0;
+
   // The current dynamic state of the graphics pipeline bind point. Note that
   // binding any pipeline to the bind point with static state (even if it's
   // unused, like depth bias being disabled, but the values themselves still not
@@ -689,6 +827,14 @@ class VulkanCommandProcessor final : public CommandProcessor {
   bool dynamic_stencil_reference_front_update_needed_;
   bool dynamic_stencil_reference_back_update_needed_;
 
+  // Host viewport and scissor derived from the registers on the previous draw,
+  // and the register file write stamp taken on it, for skipping gathering of
+  // their arguments if the registers haven't been written since.
+  draw_util::GetViewportInfoArgs previous_viewport_info_args_;
+  draw_util::ViewportInfo previous_viewport_info_;
+  draw_util::Scissor previous_scissor_;
+  uint64_t previous_draw_register_write_stamp_ = 0;
+
   // Currently used samplers.
   std::vector<std::pair<VulkanTextureCache::SamplerParameters, VkSampler>>
       current_samplers_vertex_;
@@ -696,7 +842,8 @@ class VulkanCommandProcessor final : public CommandProcessor {
       current_samplers_pixel_;
 
   // Cache render pass currently started in the command buffer with the
-  // framebuffer.
+  // framebuffer. current_framebuffer_ is not null while inside a render pass,
+  // and current_render_pass_ is VK_NULL_HANDLE if it's dynamic rendering.
   VkRenderPass current_render_pass_;
   const VulkanRenderTargetCache::Framebuffer* current_framebuffer_;
 
@@ -28,11 +28,9 @@ class VulkanGraphicsSystem : public GraphicsSystem {
 
   std::string name() const override;
 
-  X_STATUS Setup(cpu::Processor* processor, kernel::KernelState* kernel_state,
-                 ui::WindowedAppContext* app_context,
-                 bool is_surface_required) override;
-
  private:
+  std::unique_ptr<ui::GraphicsProvider> CreateProvider(
+      bool is_surface_required) override;
   std::unique_ptr<CommandProcessor> CreateCommandProcessor() override;
 };
 
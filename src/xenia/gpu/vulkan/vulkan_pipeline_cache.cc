@@ -11,16 +11,25 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <cstring>
 #include <memory>
+#include <set>
+#include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 #include "third_party/fmt/include/fmt/format.h"
 #include "xenia/base/assert.h"
+#include "xenia/base/byte_order.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
+#include "xenia/base/memory.h"
 #include "xenia/base/profiling.h"
 #include "xenia/base/xxhash.h"
 #include "xenia/gpu/draw_util.h"
@@ -34,6 +43,23 @@
 #include "xenia/gpu/xenos.h"
 #include "xenia/ui/vulkan/vulkan_util.h"
 
+DEFINE_bool(
+    vulkan_spirv_optimize, false,
+    "Run SPIRV-Tools performance optimization passes on the translated "
+    "shaders, which may help drivers that compile unoptimized SPIR-V slowly or "
+    "poorly. Requires the SPIRV-Tools shared library from the Vulkan SDK. The "
+    "optimized shaders are kept in the shader storage, so each shader is "
+    "optimized only once.",
+    "Vulkan");
+DEFINE_bool(
+    vulkan_graphics_pipeline_library, true,
+    "Link graphics pipelines from separately created vertex and fragment parts "
+    "if VK_EXT_graphics_pipeline_library with fast linking is supported, "
+    "reducing the number of shader compilations and the time spent creating "
+    "pipelines. Pipelines are linked with link-time optimizations in the "
+    "background afterwards.",
+    "Vulkan");
+
 namespace xe {
 namespace gpu {
 namespace vulkan {
@@ -64,6 +90,19 @@ bool VulkanPipelineCache::Initialize() {
       render_target_cache_.msaa_2x_no_attachments_supported(),
       edram_fragment_shader_interlock);
 
+  if (cvars::vulkan_spirv_optimize) {
+    spirv_tools_context_ = std::make_unique<ui::vulkan::SpirvToolsContext>();
+    if (!spirv_tools_context_->Initialize(
+            SpirvShaderTranslator::Features(provider.device_info())
+                .spirv_version) ||
+        !spirv_tools_context_->IsOptimizerAvailable()) {
+      XELOGW(
+          "VulkanPipelineCache: SPIRV-Tools optimizer is not available, "
+          "shaders will not be optimized");
+      spirv_tools_context_.reset();
+    }
+  }
+
   if (edram_fragment_shader_interlock) {
     std::vector<uint8_t> depth_only_fragment_shader_code =
         shader_translator_->CreateDepthOnlyFragmentShader();
@@ -81,6 +120,43 @@ bool VulkanPipelineCache::Initialize() {
     }
   }
 
+  pipeline_libraries_used_ =
+      cvars::vulkan_graphics_pipeline_library &&
+      provider.device_info().graphicsPipelineLibrary &&
+      provider.device_info().graphicsPipelineLibraryFastLinking;
+  if (pipeline_libraries_used_) {
+    optimization_thread_busy_ = false;
+    optimization_thread_shutdown_ = false;
+    // Only improves the performance of what is already drawn correctly, must
+    // not take time from the guest threads.
+    xe::threading::Thread::CreationParameters thread_parameters;
+    thread_parameters.initial_priority =
+        xe::threading::ThreadPriority::kBelowNormal;
+    optimization_thread_ = xe::threading::Thread::Create(
+        thread_parameters, [this]() { OptimizationThread(); });
+    assert_not_null(optimization_thread_);
+    optimization_thread_->set_name("Vulkan Pipeline Optimization");
+  }
+
+  if (cvars::async_pipeline_creation) {
+    uint32_t logical_processor_count = xe::threading::logical_processor_count();
+    if (!logical_processor_count) {
+      // Pick some reasonable amount if couldn't determine the number of cores.
+      logical_processor_count = 6;
+    }
+    size_t creation_thread_count =
+        std::max(logical_processor_count * 3 / 4, uint32_t(1));
+    creation_threads_busy_ = 0;
+    creation_threads_shutdown_ = false;
+    for (size_t i = 0; i < creation_thread_count; ++i) {
+      std::unique_ptr<xe::threading::Thread> creation_thread =
+          xe::threading::Thread::Create({}, [this]() { CreationThread(); });
+      assert_not_null(creation_thread);
+      creation_thread->set_name("Vulkan Pipelines");
+      creation_threads_.push_back(std::move(creation_thread));
+    }
+  }
+
   return true;
 }
 
@@ -90,14 +166,59 @@ void VulkanPipelineCache::Shutdown() {
   const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
   VkDevice device = provider.device();
 
+  // Shut down all threads, before destroying the pipelines since they may be
+  // creating them.
+  if (!creation_threads_.empty()) {
+    {
+      std::lock_guard<std::mutex> lock(creation_request_lock_);
+      creation_threads_shutdown_ = true;
+    }
+    creation_request_cond_.notify_all();
+    for (const std::unique_ptr<xe::threading::Thread>& creation_thread :
+         creation_threads_) {
+      xe::threading::Wait(creation_thread.get(), false);
+    }
+    creation_threads_.clear();
+  }
+  creation_queue_.clear();
+  if (optimization_thread_) {
+    {
+      std::lock_guard<std::mutex> lock(optimization_request_lock_);
+      optimization_thread_shutdown_ = true;
+    }
+    optimization_request_cond_.notify_all();
+    xe::threading::Wait(optimization_thread_.get(), false);
+    optimization_thread_.reset();
+  }
+  optimization_queue_.clear();
+
+  // Shut down the persistent shader / pipeline storage.
+  ShutdownShaderStorage();
+
   // Destroy all pipelines.
   last_pipeline_ = nullptr;
   for (const auto& pipeline_pair : pipelines_) {
     if (pipeline_pair.second.pipeline != VK_NULL_HANDLE) {
       dfn.vkDestroyPipeline(device, pipeline_pair.second.pipeline, nullptr);
     }
+    if (pipeline_pair.second.optimized_pipeline != VK_NULL_HANDLE) {
+      dfn.vkDestroyPipeline(device, pipeline_pair.second.optimized_pipeline,
+                            nullptr);
+    }
   }
   pipelines_.clear();
+  for (const auto& library_pair : pre_rasterization_pipeline_libraries_) {
+    if (library_pair.second != VK_NULL_HANDLE) {
+      dfn.vkDestroyPipeline(device, library_pair.second, nullptr);
+    }
+  }
+  pre_rasterization_pipeline_libraries_.clear();
+  for (const auto& library_pair : fragment_pipeline_libraries_) {
+    if (library_pair.second != VK_NULL_HANDLE) {
+      dfn.vkDestroyPipeline(device, library_pair.second, nullptr);
+    }
+  }
+  fragment_pipeline_libraries_.clear();
 
   // Destroy all internal shaders.
   ui::vulkan::util::DestroyAndNullHandle(dfn.vkDestroyShaderModule, device,
@@ -114,19 +235,767 @@ void VulkanPipelineCache::Shutdown() {
     delete it.second;
   }
   shaders_.clear();
+  shader_storage_index_ = 0;
   texture_binding_layout_map_.clear();
   texture_binding_layouts_.clear();
 
   // Shut down shader translation.
+  optimized_spirv_.clear();
+  spirv_tools_context_.reset();
   shader_translator_.reset();
 }
 
+void VulkanPipelineCache::InitializeShaderStorage(
+    const std::filesystem::path& cache_root, uint32_t title_id, bool blocking) {
+  ShutdownShaderStorage();
+
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::InstanceFunctions& ifn = provider.ifn();
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+
+  auto shader_storage_root = cache_root / "shaders";
+  // For files that can be moved between different hosts.
+  auto shader_storage_shareable_root = shader_storage_root / "shareable";
+  if (!std::filesystem::exists(shader_storage_shareable_root)) {
+    if (!std::filesystem::create_directories(shader_storage_shareable_root)) {
+      XELOGE(
+          "Failed to create the shareable shader storage directory, persistent "
+          "shader storage will be disabled: {}",
+          xe::path_to_utf8(shader_storage_shareable_root));
+      return;
+    }
+  }
+
+  bool edram_fragment_shader_interlock =
+      render_target_cache_.GetPath() ==
+      RenderTargetCache::Path::kPixelShaderInterlock;
+
+  // Initialize the pipeline storage stream - read pipeline descriptions and
+  // collect used shader modifications to translate.
+  std::vector<PipelineStoredDescription> pipeline_stored_descriptions;
+  // <Shader hash, modification bits>.
+  std::set<std::pair<uint64_t, uint64_t>> shader_translations_needed;
+  auto pipeline_storage_file_path =
+      shader_storage_shareable_root /
+      fmt::format("{:08X}.{}.vulkan.xpso", title_id,
+                  edram_fragment_shader_interlock ? "fsi" : "rtv");
+  pipeline_storage_file_ =
+      xe::filesystem::OpenFile(pipeline_storage_file_path, "a+b");
+  if (!pipeline_storage_file_) {
+    XELOGE(
+        "Failed to open the Vulkan pipeline description storage file for "
+        "writing, persistent shader storage will be disabled: {}",
+        xe::path_to_utf8(pipeline_storage_file_path));
+    return;
+  }
+  pipeline_storage_file_flush_needed_ = false;
+  // 'XEPS'.
+  const uint32_t pipeline_storage_magic = 0x53504558;
+  // 'VKFS' or 'VKRT'.
+  const uint32_t pipeline_storage_magic_api =
+      edram_fragment_shader_interlock ? 0x53464B56 : 0x54524B56;
+  const uint32_t pipeline_storage_version_swapped =
+      xe::byte_swap(PipelineDescription::kVersion);
+  const uint32_t pipeline_storage_modification_version_swapped =
+      xe::byte_swap(SpirvShaderTranslator::Modification::kVersion);
+  struct {
+    uint32_t magic;
+    uint32_t magic_api;
+    uint32_t version_swapped;
+    uint32_t modification_version_swapped;
+  } pipeline_storage_file_header;
+  if (fread(&pipeline_storage_file_header, sizeof(pipeline_storage_file_header),
+            1, pipeline_storage_file_) &&
+      pipeline_storage_file_header.magic == pipeline_storage_magic &&
+      pipeline_storage_file_header.magic_api == pipeline_storage_magic_api &&
+      pipeline_storage_file_header.version_swapped ==
+          pipeline_storage_version_swapped &&
+      pipeline_storage_file_header.modification_version_swapped ==
+          pipeline_storage_modification_version_swapped) {
+    xe::filesystem::Seek(pipeline_storage_file_, 0, SEEK_END);
+    int64_t pipeline_storage_told_end =
+        xe::filesystem::Tell(pipeline_storage_file_);
+    size_t pipeline_storage_told_count =
+        size_t(pipeline_storage_told_end >=
+                       int64_t(sizeof(pipeline_storage_file_header))
+                   ? (uint64_t(pipeline_storage_told_end) -
+                      sizeof(pipeline_storage_file_header)) /
+                         sizeof(PipelineStoredDescription)
+                   : 0);
+    if (pipeline_storage_told_count &&
+        xe::filesystem::Seek(pipeline_storage_file_,
+                             int64_t(sizeof(pipeline_storage_file_header)),
+                             SEEK_SET)) {
+      pipeline_stored_descriptions.resize(pipeline_storage_told_count);
+      pipeline_stored_descriptions.resize(
+          fread(pipeline_stored_descriptions.data(),
+                sizeof(PipelineStoredDescription), pipeline_storage_told_count,
+                pipeline_storage_file_));
+      size_t pipeline_storage_read_count = pipeline_stored_descriptions.size();
+      for (size_t i = 0; i < pipeline_storage_read_count; ++i) {
+        const PipelineStoredDescription& pipeline_stored_description =
+            pipeline_stored_descriptions[i];
+        // Validate file integrity, stop and truncate the stream if data is
+        // corrupted.
+        if (XXH3_64bits(&pipeline_stored_description.description,
+                        sizeof(pipeline_stored_description.description)) !=
+            pipeline_stored_description.description_hash) {
+          pipeline_stored_descriptions.resize(i);
+          break;
+        }
+        // Pipelines requiring features not supported by this device are kept
+        // in the file, to keep it shareable across devices, but not created.
+        if (!ArePipelineRequirementsMet(
+                pipeline_stored_description.description)) {
+          continue;
+        }
+        // Mark the shader modifications as needed for translation.
+        shader_translations_needed.emplace(
+            pipeline_stored_description.description.vertex_shader_hash,
+            pipeline_stored_description.description.vertex_shader_modification);
+        if (pipeline_stored_description.description.pixel_shader_hash) {
+          shader_translations_needed.emplace(
+              pipeline_stored_description.description.pixel_shader_hash,
+              pipeline_stored_description.description
+                  .pixel_shader_modification);
+        }
+      }
+    }
+  }
+
+  size_t logical_processor_count = xe::threading::logical_processor_count();
+  if (!logical_processor_count) {
+    // Pick some reasonable amount if couldn't determine the number of cores.
+    logical_processor_count = 6;
+  }
+
+  auto shader_storage_local_root = shader_storage_root / "local";
+
+  // Initialize the optimized SPIR-V storage stream - read the shaders optimized
+  // in the previous runs before translating the shaders.
+  if (spirv_tools_context_) {
+    auto optimized_spirv_storage_file_path =
+        shader_storage_local_root /
+        fmt::format("{:08X}.vulkan.xspo", title_id);
+    if (std::filesystem::exists(shader_storage_local_root) ||
+        std::filesystem::create_directories(shader_storage_local_root)) {
+      optimized_spirv_storage_file_ =
+          xe::filesystem::OpenFile(optimized_spirv_storage_file_path, "a+b");
+    }
+    if (optimized_spirv_storage_file_) {
+      struct {
+        uint32_t magic;
+        uint32_t version_swapped;
+      } optimized_spirv_storage_file_header;
+      // 'XESO'.
+      const uint32_t optimized_spirv_storage_magic = 0x4F534558;
+      if (fread(&optimized_spirv_storage_file_header,
+                sizeof(optimized_spirv_storage_file_header), 1,
+                optimized_spirv_storage_file_) &&
+          optimized_spirv_storage_file_header.magic ==
+              optimized_spirv_storage_magic &&
+          xe::byte_swap(optimized_spirv_storage_file_header.version_swapped) ==
+              OptimizedSpirvStoredHeader::kVersion) {
+        uint64_t optimized_spirv_storage_valid_bytes =
+            sizeof(optimized_spirv_storage_file_header);
+        OptimizedSpirvStoredHeader optimized_spirv_header;
+        std::lock_guard<std::mutex> lock(optimized_spirv_mutex_);
+        while (true) {
+          if (!fread(&optimized_spirv_header, sizeof(optimized_spirv_header),
+                     1, optimized_spirv_storage_file_)) {
+            break;
+          }
+          OptimizedSpirv optimized_spirv;
+          optimized_spirv.translated_word_count =
+              optimized_spirv_header.translated_word_count;
+          size_t optimized_size =
+              sizeof(uint32_t) * optimized_spirv_header.optimized_word_count;
+          optimized_spirv.optimized.resize(optimized_size);
+          if (!optimized_size ||
+              !fread(optimized_spirv.optimized.data(), optimized_size, 1,
+                     optimized_spirv_storage_file_) ||
+              XXH3_64bits(optimized_spirv.optimized.data(), optimized_size) !=
+                  optimized_spirv_header.optimized_hash) {
+            // Validation failed.
+            break;
+          }
+          optimized_spirv_storage_valid_bytes +=
+              sizeof(optimized_spirv_header) + optimized_size;
+          optimized_spirv_.emplace(optimized_spirv_header.translated_hash,
+                                   std::move(optimized_spirv));
+        }
+        xe::filesystem::TruncateStdioFile(optimized_spirv_storage_file_,
+                                          optimized_spirv_storage_valid_bytes);
+      } else {
+        xe::filesystem::TruncateStdioFile(optimized_spirv_storage_file_, 0);
+        optimized_spirv_storage_file_header.magic =
+            optimized_spirv_storage_magic;
+        optimized_spirv_storage_file_header.version_swapped =
+            xe::byte_swap(OptimizedSpirvStoredHeader::kVersion);
+        fwrite(&optimized_spirv_storage_file_header,
+               sizeof(optimized_spirv_storage_file_header), 1,
+               optimized_spirv_storage_file_);
+      }
+    } else {
+      XELOGW(
+          "Failed to open the optimized SPIR-V storage file for writing, "
+          "shaders will be optimized in every run: {}",
+          xe::path_to_utf8(optimized_spirv_storage_file_path));
+    }
+  }
+
+  // Initialize the Xenos shader storage stream.
+  uint64_t shader_storage_initialization_start =
+      xe::Clock::QueryHostTickCount();
+  auto shader_storage_file_path =
+      shader_storage_shareable_root / fmt::format("{:08X}.xsh", title_id);
+  shader_storage_file_ =
+      xe::filesystem::OpenFile(shader_storage_file_path, "a+b");
+  if (!shader_storage_file_) {
+    XELOGE(
+        "Failed to open the guest shader storage file for writing, persistent "
+        "shader storage will be disabled: {}",
+        xe::path_to_utf8(shader_storage_file_path));
+    fclose(pipeline_storage_file_);
+    pipeline_storage_file_ = nullptr;
+    if (optimized_spirv_storage_file_) {
+      fclose(optimized_spirv_storage_file_);
+      optimized_spirv_storage_file_ = nullptr;
+    }
+    return;
+  }
+  ++shader_storage_index_;
+  shader_storage_file_flush_needed_ = false;
+  struct {
+    uint32_t magic;
+    uint32_t version_swapped;
+  } shader_storage_file_header;
+  // 'XESH'.
+  const uint32_t shader_storage_magic = 0x48534558;
+  if (fread(&shader_storage_file_header, sizeof(shader_storage_file_header), 1,
+            shader_storage_file_) &&
+      shader_storage_file_header.magic == shader_storage_magic &&
+      xe::byte_swap(shader_storage_file_header.version_swapped) ==
+          ShaderStoredHeader::kVersion) {
+    uint64_t shader_storage_valid_bytes = sizeof(shader_storage_file_header);
+    // Load and translate shaders written by previous Xenia executions until the
+    // end of the file or until a corrupted one is detected.
+    ShaderStoredHeader shader_header;
+    std::vector<uint32_t> ucode_dwords;
+    ucode_dwords.reserve(0xFFFF);
+    size_t shaders_translated = 0;
+
+    // Threads overlapping file reading.
+    std::mutex shaders_translation_thread_mutex;
+    std::condition_variable shaders_translation_thread_cond;
+    std::deque<VulkanShader*> shaders_to_translate;
+    size_t shader_translation_threads_busy = 0;
+    bool shader_translation_threads_shutdown = false;
+    std::mutex shaders_failed_to_translate_mutex;
+    std::vector<VulkanShader::VulkanTranslation*> shaders_failed_to_translate;
+    auto shader_translation_thread_function = [&]() {
+      StringBuffer ucode_disasm_buffer;
+      SpirvShaderTranslator translator(
+          SpirvShaderTranslator::Features(provider.device_info()),
+          render_target_cache_.msaa_2x_attachments_supported(),
+          render_target_cache_.msaa_2x_no_attachments_supported(),
+          edram_fragment_shader_interlock);
+      for (;;) {
+        VulkanShader* shader_to_translate;
+        for (;;) {
+          std::unique_lock<std::mutex> lock(shaders_translation_thread_mutex);
+          if (shaders_to_translate.empty()) {
+            if (shader_translation_threads_shutdown) {
+              return;
+            }
+            shaders_translation_thread_cond.wait(lock);
+            continue;
+          }
+          shader_to_translate = shaders_to_translate.front();
+          shaders_to_translate.pop_front();
+          ++shader_translation_threads_busy;
+          break;
+        }
+        shader_to_translate->AnalyzeUcode(ucode_disasm_buffer);
+        // Translate each needed modification on this thread after performing
+        // modification-independent analysis of the whole shader.
+        uint64_t ucode_data_hash = shader_to_translate->ucode_data_hash();
+        for (auto modification_it = shader_translations_needed.lower_bound(
+                 std::make_pair(ucode_data_hash, uint64_t(0)));
+             modification_it != shader_translations_needed.end() &&
+             modification_it->first == ucode_data_hash;
+             ++modification_it) {
+          VulkanShader::VulkanTranslation* translation =
+              static_cast<VulkanShader::VulkanTranslation*>(
+                  shader_to_translate->GetOrCreateTranslation(
+                      modification_it->second));
+          // Only try (and delete in case of failure) if it's a new translation.
+          // If it's a shader previously encountered in the game, translation of
+          // which has failed, and the shader storage is loaded later, keep it
+          // this way not to try to translate it again.
+          if (!translation->is_translated() &&
+              !TranslateAnalyzedShader(translator, *translation)) {
+            std::lock_guard<std::mutex> lock(shaders_failed_to_translate_mutex);
+            shaders_failed_to_translate.push_back(translation);
+          }
+        }
+        {
+          std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+          --shader_translation_threads_busy;
+        }
+      }
+    };
+    std::vector<std::unique_ptr<xe::threading::Thread>>
+        shader_translation_threads;
+
+    while (true) {
+      if (!fread(&shader_header, sizeof(shader_header), 1,
+                 shader_storage_file_)) {
+        break;
+      }
+      size_t ucode_byte_count =
+          shader_header.ucode_dword_count * sizeof(uint32_t);
+      ucode_dwords.resize(shader_header.ucode_dword_count);
+      if (shader_header.ucode_dword_count &&
+          !fread(ucode_dwords.data(), ucode_byte_count, 1,
+                 shader_storage_file_)) {
+        break;
+      }
+      uint64_t ucode_data_hash =
+          XXH3_64bits(ucode_dwords.data(), ucode_byte_count);
+      if (shader_header.ucode_data_hash != ucode_data_hash) {
+        // Validation failed.
+        break;
+      }
+      shader_storage_valid_bytes += sizeof(shader_header) + ucode_byte_count;
+      VulkanShader* shader =
+          LoadShader(shader_header.type, ucode_dwords.data(),
+                     shader_header.ucode_dword_count, ucode_data_hash);
+      if (shader->ucode_storage_index() == shader_storage_index_) {
+        // Appeared twice in this file for some reason - skip, otherwise race
+        // condition will be caused by translating twice in parallel.
+        continue;
+      }
+      // Loaded from the current storage - don't write again.
+      shader->set_ucode_storage_index(shader_storage_index_);
+      // Create new threads if the currently existing threads can't keep up
+      // with file reading, but not more than the number of logical processors
+      // minus one.
+      size_t shader_translation_threads_needed;
+      {
+        std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+        shader_translation_threads_needed =
+            std::min(shader_translation_threads_busy +
+                         shaders_to_translate.size() + size_t(1),
+                     logical_processor_count - size_t(1));
+      }
+      while (shader_translation_threads.size() <
+             shader_translation_threads_needed) {
+        auto thread = xe::threading::Thread::Create(
+            {}, shader_translation_thread_function);
+        assert_not_null(thread);
+        thread->set_name("Shader Translation");
+        shader_translation_threads.push_back(std::move(thread));
+      }
+      // Request ucode information gathering and translation of all the needed
+      // shaders.
+      {
+        std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+        shaders_to_translate.push_back(shader);
+      }
+      shaders_translation_thread_cond.notify_one();
+      ++shaders_translated;
+    }
+    if (!shader_translation_threads.empty()) {
+      {
+        std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+        shader_translation_threads_shutdown = true;
+      }
+      shaders_translation_thread_cond.notify_all();
+      for (auto& shader_translation_thread : shader_translation_threads) {
+        xe::threading::Wait(shader_translation_thread.get(), false);
+      }
+      shader_translation_threads.clear();
+      for (VulkanShader::VulkanTranslation* translation :
+           shaders_failed_to_translate) {
+        VulkanShader* shader =
+            static_cast<VulkanShader*>(&translation->shader());
+        shader->DestroyTranslation(translation->modification());
+        if (shader->translations().empty()) {
+          shaders_.erase(shader->ucode_data_hash());
+          delete shader;
+        }
+      }
+    }
+    XELOGGPU("Translated {} shaders from the storage in {} milliseconds",
+             shaders_translated,
+             (xe::Clock::QueryHostTickCount() -
+              shader_storage_initialization_start) *
+                 1000 / xe::Clock::QueryHostTickFrequency());
+    xe::filesystem::TruncateStdioFile(shader_storage_file_,
+                                      shader_storage_valid_bytes);
+  } else {
+    xe::filesystem::TruncateStdioFile(shader_storage_file_, 0);
+    shader_storage_file_header.magic = shader_storage_magic;
+    shader_storage_file_header.version_swapped =
+        xe::byte_swap(ShaderStoredHeader::kVersion);
+    fwrite(&shader_storage_file_header, sizeof(shader_storage_file_header), 1,
+           shader_storage_file_);
+  }
+
+  // Create the driver pipeline cache from the data of the previous runs on the
+  // same device and driver - unlike the guest shaders and the pipeline
+  // descriptions, it's not shareable, so it's stored in shaders/local/.
+  if (!std::filesystem::exists(shader_storage_local_root) &&
+      !std::filesystem::create_directories(shader_storage_local_root)) {
+    XELOGW(
+        "Failed to create the local shader storage directory, the Vulkan "
+        "pipeline cache will not be preserved: {}",
+        xe::path_to_utf8(shader_storage_local_root));
+  } else {
+    VkPhysicalDeviceProperties device_properties;
+    ifn.vkGetPhysicalDeviceProperties(provider.physical_device(),
+                                      &device_properties);
+    std::string pipeline_cache_uuid;
+    for (uint32_t i = 0; i < VK_UUID_SIZE; ++i) {
+      pipeline_cache_uuid +=
+          fmt::format("{:02X}", device_properties.pipelineCacheUUID[i]);
+    }
+    vk_pipeline_cache_file_path_ =
+        shader_storage_local_root /
+        fmt::format("{:08X}.vulkan.{}.{:08X}.vkpc", title_id,
+                    pipeline_cache_uuid, device_properties.driverVersion);
+    std::vector<uint8_t> pipeline_cache_data;
+    FILE* pipeline_cache_file =
+        xe::filesystem::OpenFile(vk_pipeline_cache_file_path_, "rb");
+    if (pipeline_cache_file) {
+      xe::filesystem::Seek(pipeline_cache_file, 0, SEEK_END);
+      int64_t pipeline_cache_file_size =
+          xe::filesystem::Tell(pipeline_cache_file);
+      if (pipeline_cache_file_size > 0 &&
+          xe::filesystem::Seek(pipeline_cache_file, 0, SEEK_SET)) {
+        pipeline_cache_data.resize(size_t(pipeline_cache_file_size));
+        if (!fread(pipeline_cache_data.data(), pipeline_cache_data.size(), 1,
+                   pipeline_cache_file)) {
+          pipeline_cache_data.clear();
+        }
+      }
+      fclose(pipeline_cache_file);
+    }
+    // The data written by a different device or driver is ignored by the
+    // implementation anyway, but don't rely on it for data that may have been
+    // moved from another host.
+    struct {
+      uint32_t header_size;
+      VkPipelineCacheHeaderVersion header_version;
+      uint32_t vendor_id;
+      uint32_t device_id;
+      uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+    } pipeline_cache_header;
+    if (pipeline_cache_data.size() >= sizeof(pipeline_cache_header)) {
+      std::memcpy(&pipeline_cache_header, pipeline_cache_data.data(),
+                  sizeof(pipeline_cache_header));
+      if (pipeline_cache_header.header_size < sizeof(pipeline_cache_header) ||
+          pipeline_cache_header.header_size > pipeline_cache_data.size() ||
+          pipeline_cache_header.header_version !=
+              VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+          pipeline_cache_header.vendor_id != device_properties.vendorID ||
+          pipeline_cache_header.device_id != device_properties.deviceID ||
+          std::memcmp(pipeline_cache_header.pipeline_cache_uuid,
+                      device_properties.pipelineCacheUUID, VK_UUID_SIZE)) {
+        pipeline_cache_data.clear();
+      }
+    } else {
+      pipeline_cache_data.clear();
+    }
+    VkPipelineCacheCreateInfo pipeline_cache_create_info;
+    pipeline_cache_create_info.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipeline_cache_create_info.pNext = nullptr;
+    pipeline_cache_create_info.flags = 0;
+    pipeline_cache_create_info.initialDataSize = pipeline_cache_data.size();
+    pipeline_cache_create_info.pInitialData = pipeline_cache_data.data();
+    if (dfn.vkCreatePipelineCache(device, &pipeline_cache_create_info, nullptr,
+                                  &vk_pipeline_cache_) != VK_SUCCESS &&
+        !pipeline_cache_data.empty()) {
+      // Try to start from scratch if the driver has rejected the data.
+      pipeline_cache_create_info.initialDataSize = 0;
+      pipeline_cache_create_info.pInitialData = nullptr;
+      if (dfn.vkCreatePipelineCache(device, &pipeline_cache_create_info,
+                                    nullptr,
+                                    &vk_pipeline_cache_) != VK_SUCCESS) {
+        vk_pipeline_cache_ = VK_NULL_HANDLE;
+      }
+    }
+    if (vk_pipeline_cache_ == VK_NULL_HANDLE) {
+      XELOGW("Failed to create the Vulkan pipeline cache");
+      vk_pipeline_cache_file_path_.clear();
+    } else {
+      XELOGGPU("Loaded {} bytes of the Vulkan pipeline cache data",
+               pipeline_cache_create_info.initialDataSize);
+    }
+  }
+
+  // Create the pipelines.
+  if (!pipeline_stored_descriptions.empty()) {
+    uint64_t pipeline_creation_start_ = xe::Clock::QueryHostTickCount();
+
+    // Look up the objects needed for creation on this thread, as the caches
+    // they're stored in are not thread-safe, and gather the pipelines.
+    std::vector<PipelineCreationArguments> pipelines_to_create;
+    for (const PipelineStoredDescription& pipeline_stored_description :
+         pipeline_stored_descriptions) {
+      const PipelineDescription& pipeline_description =
+          pipeline_stored_description.description;
+      if (!ArePipelineRequirementsMet(pipeline_description)) {
+        continue;
+      }
+      // Skip already known pipelines.
+      if (pipelines_.find(pipeline_description) != pipelines_.end()) {
+        continue;
+      }
+      auto vertex_shader_it =
+          shaders_.find(pipeline_description.vertex_shader_hash);
+      if (vertex_shader_it == shaders_.end()) {
+        continue;
+      }
+      PipelineCreationArguments creation_arguments;
+      creation_arguments.vertex_shader =
+          static_cast<const VulkanShader::VulkanTranslation*>(
+              vertex_shader_it->second->GetTranslation(
+                  pipeline_description.vertex_shader_modification));
+      if (!creation_arguments.vertex_shader ||
+          !creation_arguments.vertex_shader->is_translated() ||
+          !creation_arguments.vertex_shader->is_valid()) {
+        continue;
+      }
+      if (pipeline_description.pixel_shader_hash) {
+        auto pixel_shader_it =
+            shaders_.find(pipeline_description.pixel_shader_hash);
+        if (pixel_shader_it == shaders_.end()) {
+          continue;
+        }
+        creation_arguments.pixel_shader =
+            static_cast<const VulkanShader::VulkanTranslation*>(
+                pixel_shader_it->second->GetTranslation(
+                    pipeline_description.pixel_shader_modification));
+        if (!creation_arguments.pixel_shader ||
+            !creation_arguments.pixel_shader->is_translated() ||
+            !creation_arguments.pixel_shader->is_valid()) {
+          continue;
+        }
+      } else {
+        creation_arguments.pixel_shader = nullptr;
+      }
+      const PipelineLayoutProvider* pipeline_layout;
+      if (!GetPipelineCreationObjects(
+              pipeline_description, creation_arguments.vertex_shader,
+              creation_arguments.pixel_shader, pipeline_layout,
+              creation_arguments.geometry_shader,
+              creation_arguments.render_pass)) {
+        continue;
+      }
+      creation_arguments.pipeline =
+          &*pipelines_
+                .emplace(std::piecewise_construct,
+                         std::forward_as_tuple(pipeline_description),
+                         std::forward_as_tuple(pipeline_layout))
+                .first;
+      pipelines_to_create.push_back(creation_arguments);
+    }
+
+    // Create the pipelines on all cores, including this thread. There are no
+    // persistent creation threads to leave the work to, so the creation is
+    // completed before returning even if not blocking. The pipeline map is not
+    // modified during the creation, so the references to its entries stay
+    // valid.
+    std::atomic<size_t> pipeline_creation_next_index(0);
+    auto pipeline_creation_function = [&]() {
+      for (;;) {
+        size_t pipeline_index = pipeline_creation_next_index++;
+        if (pipeline_index >= pipelines_to_create.size()) {
+          return;
+        }
+        CreatePipeline(pipelines_to_create[pipeline_index]);
+      }
+    };
+    std::vector<std::unique_ptr<xe::threading::Thread>> creation_threads;
+    size_t creation_thread_count =
+        std::min(pipelines_to_create.size(), logical_processor_count) -
+        std::min(pipelines_to_create.size(), size_t(1));
+    for (size_t i = 0; i < creation_thread_count; ++i) {
+      auto creation_thread =
+          xe::threading::Thread::Create({}, pipeline_creation_function);
+      assert_not_null(creation_thread);
+      creation_thread->set_name("Vulkan Pipelines");
+      creation_threads.push_back(std::move(creation_thread));
+    }
+    pipeline_creation_function();
+    for (auto& creation_thread : creation_threads) {
+      xe::threading::Wait(creation_thread.get(), false);
+    }
+    creation_threads.clear();
+
+    // Drop the pipelines that have failed to be created, to retry and to
+    // report the failure if they're actually used.
+    size_t pipelines_created = 0;
+    for (const PipelineCreationArguments& creation_arguments :
+         pipelines_to_create) {
+      if (creation_arguments.pipeline->second.pipeline != VK_NULL_HANDLE) {
+        ++pipelines_created;
+      } else {
+        pipelines_.erase(creation_arguments.pipeline->first);
+      }
+    }
+
+    XELOGGPU(
+        "Created {} graphics pipelines (not including reading the "
+        "descriptions) from the storage in {} milliseconds",
+        pipelines_created,
+        (xe::Clock::QueryHostTickCount() - pipeline_creation_start_) * 1000 /
+            xe::Clock::QueryHostTickFrequency());
+    // If any pipeline descriptions were corrupted (or the whole file has excess
+    // bytes in the end), truncate to the last valid pipeline description.
+    xe::filesystem::TruncateStdioFile(
+        pipeline_storage_file_,
+        uint64_t(sizeof(pipeline_storage_file_header) +
+                 sizeof(PipelineStoredDescription) *
+                     pipeline_stored_descriptions.size()));
+  } else {
+    xe::filesystem::TruncateStdioFile(pipeline_storage_file_, 0);
+    pipeline_storage_file_header.magic = pipeline_storage_magic;
+    pipeline_storage_file_header.magic_api = pipeline_storage_magic_api;
+    pipeline_storage_file_header.version_swapped =
+        pipeline_storage_version_swapped;
+    pipeline_storage_file_header.modification_version_swapped =
+        pipeline_storage_modification_version_swapped;
+    fwrite(&pipeline_storage_file_header, sizeof(pipeline_storage_file_header),
+           1, pipeline_storage_file_);
+  }
+
+  // Start the storage writing thread.
+  storage_write_flush_shaders_ = false;
+  storage_write_flush_pipelines_ = false;
+  storage_write_thread_shutdown_ = false;
+  storage_write_thread_ =
+      xe::threading::Thread::Create({}, [this]() { StorageWriteThread(); });
+  assert_not_null(storage_write_thread_);
+  storage_write_thread_->set_name("Vulkan Storage writer");
+}
+
+void VulkanPipelineCache::ShutdownShaderStorage() {
+  // The driver pipeline cache is about to be destroyed.
+  CompleteBackgroundPipelineCreation();
+
+  if (storage_write_thread_) {
+    {
+      std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+      storage_write_thread_shutdown_ = true;
+    }
+    storage_write_request_cond_.notify_all();
+    xe::threading::Wait(storage_write_thread_.get(), false);
+    storage_write_thread_.reset();
+  }
+  storage_write_shader_queue_.clear();
+  storage_write_pipeline_queue_.clear();
+  storage_write_optimized_spirv_queue_.clear();
+
+  if (optimized_spirv_storage_file_) {
+    fclose(optimized_spirv_storage_file_);
+    optimized_spirv_storage_file_ = nullptr;
+  }
+
+  if (vk_pipeline_cache_ != VK_NULL_HANDLE) {
+    const ui::vulkan::VulkanProvider& provider =
+        command_processor_.GetVulkanProvider();
+    const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+    VkDevice device = provider.device();
+    size_t pipeline_cache_data_size = 0;
+    std::vector<uint8_t> pipeline_cache_data;
+    if (dfn.vkGetPipelineCacheData(device, vk_pipeline_cache_,
+                                   &pipeline_cache_data_size,
+                                   nullptr) == VK_SUCCESS &&
+        pipeline_cache_data_size) {
+      pipeline_cache_data.resize(pipeline_cache_data_size);
+      // VK_INCOMPLETE if the data has grown in the meantime, but all the
+      // creation has been done by now.
+      if (dfn.vkGetPipelineCacheData(device, vk_pipeline_cache_,
+                                     &pipeline_cache_data_size,
+                                     pipeline_cache_data.data()) !=
+          VK_SUCCESS) {
+        pipeline_cache_data.clear();
+      }
+    }
+    if (!pipeline_cache_data.empty()) {
+      FILE* pipeline_cache_file =
+          xe::filesystem::OpenFile(vk_pipeline_cache_file_path_, "wb");
+      if (pipeline_cache_file) {
+        fwrite(pipeline_cache_data.data(), pipeline_cache_data_size, 1,
+               pipeline_cache_file);
+        fclose(pipeline_cache_file);
+      } else {
+        XELOGW("Failed to open the Vulkan pipeline cache file for writing: {}",
+               xe::path_to_utf8(vk_pipeline_cache_file_path_));
+      }
+    }
+    dfn.vkDestroyPipelineCache(device, vk_pipeline_cache_, nullptr);
+    vk_pipeline_cache_ = VK_NULL_HANDLE;
+  }
+  vk_pipeline_cache_file_path_.clear();
+
+  if (pipeline_storage_file_) {
+    fclose(pipeline_storage_file_);
+    pipeline_storage_file_ = nullptr;
+    pipeline_storage_file_flush_needed_ = false;
+  }
+
+  if (shader_storage_file_) {
+    fclose(shader_storage_file_);
+    shader_storage_file_ = nullptr;
+    shader_storage_file_flush_needed_ = false;
+  }
+}
+
+void VulkanPipelineCache::EndSubmission() {
+  if (shader_storage_file_flush_needed_ ||
+      pipeline_storage_file_flush_needed_) {
+    {
+      std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+      if (shader_storage_file_flush_needed_) {
+        storage_write_flush_shaders_ = true;
+      }
+      if (pipeline_storage_file_flush_needed_) {
+        storage_write_flush_pipelines_ = true;
+      }
+    }
+    storage_write_request_cond_.notify_one();
+    shader_storage_file_flush_needed_ = false;
+    pipeline_storage_file_flush_needed_ = false;
+  }
+}
+
+size_t VulkanPipelineCache::GetPendingPipelineCount() {
+  if (creation_threads_.empty()) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(creation_request_lock_);
+  return creation_queue_.size() + creation_threads_busy_;
+}
+
 VulkanShader* VulkanPipelineCache::LoadShader(xenos::ShaderType shader_type,
                                               const uint32_t* host_address,
                                               uint32_t dword_count) {
   // Hash the input memory and lookup the shader.
-  uint64_t data_hash =
-      XXH3_64bits(host_address, dword_count * sizeof(uint32_t));
+  return LoadShader(shader_type, host_address, dword_count,
+                    XXH3_64bits(host_address, dword_count * sizeof(uint32_t)));
+}
+
+VulkanShader* VulkanPipelineCache::LoadShader(xenos::ShaderType shader_type,
+                                              const uint32_t* host_address,
+                                              uint32_t dword_count,
+                                              uint64_t data_hash) {
   auto it = shaders_.find(data_hash);
   if (it != shaders_.end()) {
     // Shader has been previously loaded.
@@ -238,6 +1107,7 @@ bool VulkanPipelineCache::EnsureShadersTranslated(
       XELOGE("Failed to translate the vertex shader!");
       return false;
     }
+    StoreShader(vertex_shader->shader());
   }
   if (!vertex_shader->is_valid()) {
     // Translation attempted previously, but not valid.
@@ -250,6 +1120,7 @@ bool VulkanPipelineCache::EnsureShadersTranslated(
         XELOGE("Failed to translate the pixel shader!");
         return false;
       }
+      StoreShader(pixel_shader->shader());
     }
     if (!pixel_shader->is_valid()) {
       // Translation attempted previously, but not valid.
@@ -284,79 +1155,81 @@ bool VulkanPipelineCache::ConfigurePipeline(
           description)) {
     return false;
   }
-  if (last_pipeline_ && last_pipeline_->first == description) {
-    pipeline_out = last_pipeline_->second.pipeline;
-    pipeline_layout_out = last_pipeline_->second.pipeline_layout;
-    return true;
+  if (!last_pipeline_ || !(last_pipeline_->first == description)) {
+    auto it = pipelines_.find(description);
+    last_pipeline_ = it != pipelines_.end() ? &*it : nullptr;
   }
-  auto it = pipelines_.find(description);
-  if (it != pipelines_.end()) {
-    last_pipeline_ = &*it;
-    pipeline_out = it->second.pipeline;
-    pipeline_layout_out = it->second.pipeline_layout;
+  if (last_pipeline_) {
+    if (!last_pipeline_->second.created.load(std::memory_order_acquire)) {
+      // Still being created.
+      pipeline_out = VK_NULL_HANDLE;
+    } else {
+      pipeline_out = last_pipeline_->second.GetPipelineToUse();
+      if (pipeline_out == VK_NULL_HANDLE) {
+        // Creation has failed previously.
+        return false;
+      }
+    }
+    pipeline_layout_out = last_pipeline_->second.pipeline_layout;
     return true;
   }
 
   // Create the pipeline if not the latest and not already existing.
-  const PipelineLayoutProvider* pipeline_layout =
-      command_processor_.GetPipelineLayout(
-          pixel_shader
-              ? static_cast<const VulkanShader&>(pixel_shader->shader())
-                    .GetTextureBindingsAfterTranslation()
-                    .size()
-              : 0,
-          pixel_shader
-              ? static_cast<const VulkanShader&>(pixel_shader->shader())
-                    .GetSamplerBindingsAfterTranslation()
-                    .size()
-              : 0,
-          static_cast<const VulkanShader&>(vertex_shader->shader())
-              .GetTextureBindingsAfterTranslation()
-              .size(),
-          static_cast<const VulkanShader&>(vertex_shader->shader())
-              .GetSamplerBindingsAfterTranslation()
-              .size());
-  if (!pipeline_layout) {
-    return false;
-  }
-  VkShaderModule geometry_shader = VK_NULL_HANDLE;
-  GeometryShaderKey geometry_shader_key;
-  if (GetGeometryShaderKey(
-          description.geometry_shader,
-          SpirvShaderTranslator::Modification(vertex_shader->modification()),
-          SpirvShaderTranslator::Modification(
-              pixel_shader ? pixel_shader->modification() : 0),
-          geometry_shader_key)) {
-    geometry_shader = GetGeometryShader(geometry_shader_key);
-    if (geometry_shader == VK_NULL_HANDLE) {
-      return false;
-    }
-  }
-  VkRenderPass render_pass =
-      render_target_cache_.GetPath() ==
-              RenderTargetCache::Path::kPixelShaderInterlock
-          ? render_target_cache_.GetFragmentShaderInterlockRenderPass()
-          : render_target_cache_.GetHostRenderTargetsRenderPass(
-                render_pass_key);
-  if (render_pass == VK_NULL_HANDLE) {
+  PipelineCreationArguments creation_arguments;
+  const PipelineLayoutProvider* pipeline_layout;
+  if (!GetPipelineCreationObjects(description, vertex_shader, pixel_shader,
+                                  pipeline_layout,
+                                  creation_arguments.geometry_shader,
+                                  creation_arguments.render_pass)) {
     return false;
   }
-  PipelineCreationArguments creation_arguments;
-  auto& pipeline =
-      *pipelines_.emplace(description, Pipeline(pipeline_layout)).first;
+  auto& pipeline = *pipelines_
+                        .emplace(std::piecewise_construct,
+                                 std::forward_as_tuple(description),
+                                 std::forward_as_tuple(pipeline_layout))
+                        .first;
+  last_pipeline_ = &pipeline;
   creation_arguments.pipeline = &pipeline;
   creation_arguments.vertex_shader = vertex_shader;
   creation_arguments.pixel_shader = pixel_shader;
-  creation_arguments.geometry_shader = geometry_shader;
-  creation_arguments.render_pass = render_pass;
-  if (!EnsurePipelineCreated(creation_arguments)) {
+  if (!creation_threads_.empty()) {
+    // Submit the pipeline for creation to any available thread.
+    {
+      std::lock_guard<std::mutex> lock(creation_request_lock_);
+      creation_queue_.push_back(creation_arguments);
+    }
+    creation_request_cond_.notify_one();
+  } else if (!CreatePipeline(creation_arguments)) {
     return false;
   }
-  pipeline_out = pipeline.second.pipeline;
+
+  if (pipeline_storage_file_) {
+    assert_not_null(storage_write_thread_);
+    pipeline_storage_file_flush_needed_ = true;
+    {
+      std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+      storage_write_pipeline_queue_.emplace_back();
+      PipelineStoredDescription& stored_description =
+          storage_write_pipeline_queue_.back();
+      stored_description.description_hash = description.GetHash();
+      std::memcpy(&stored_description.description, &description,
+                  sizeof(description));
+    }
+    storage_write_request_cond_.notify_all();
+  }
+
+  pipeline_out = creation_threads_.empty() ? pipeline.second.pipeline
+                                           : VK_NULL_HANDLE;
   pipeline_layout_out = pipeline_layout;
   return true;
 }
 
+VkPipeline VulkanPipelineCache::AwaitCurrentPipelineCreation() {
+  assert_not_null(last_pipeline_);
+  AwaitPipelineCreation(*last_pipeline_);
+  return last_pipeline_->second.GetPipelineToUse();
+}
+
 bool VulkanPipelineCache::TranslateAnalyzedShader(
     SpirvShaderTranslator& translator,
     VulkanShader::VulkanTranslation& translation) {
@@ -369,6 +1242,9 @@ bool VulkanPipelineCache::TranslateAnalyzedShader(
            shader.ucode_data_hash());
     return false;
   }
+  if (spirv_tools_context_) {
+    OptimizeTranslatedSpirv(translation);
+  }
   if (translation.GetOrCreateShaderModule() == VK_NULL_HANDLE) {
     return false;
   }
@@ -385,6 +1261,7 @@ bool VulkanPipelineCache::TranslateAnalyzedShader(
         shader.GetTextureBindingsAfterTranslation();
     size_t texture_binding_count = texture_bindings.size();
     if (texture_binding_count) {
+      std::lock_guard<std::mutex> layouts_lock(layouts_mutex_);
       size_t texture_binding_layout_bytes =
           texture_binding_count * sizeof(*texture_bindings.data());
       uint64_t texture_binding_layout_hash =
@@ -436,6 +1313,75 @@ bool VulkanPipelineCache::TranslateAnalyzedShader(
   return true;
 }
 
+void VulkanPipelineCache::OptimizeTranslatedSpirv(
+    VulkanShader::VulkanTranslation& translation) {
+  const std::vector<uint8_t>& translated = translation.translated_binary();
+  uint32_t translated_word_count =
+      uint32_t(translated.size() / sizeof(uint32_t));
+  uint64_t translated_hash = XXH3_64bits(translated.data(), translated.size());
+  {
+    std::lock_guard<std::mutex> lock(optimized_spirv_mutex_);
+    auto it = optimized_spirv_.find(translated_hash);
+    if (it != optimized_spirv_.end() &&
+        it->second.translated_word_count == translated_word_count) {
+      translation.ReplaceTranslatedBinary(it->second.optimized);
+      return;
+    }
+  }
+
+  std::vector<uint32_t> optimized_words;
+  std::string validation_error;
+  if (spirv_tools_context_->Optimize(
+          reinterpret_cast<const uint32_t*>(translated.data()),
+          translated_word_count, optimized_words) != SPV_SUCCESS ||
+      optimized_words.empty() ||
+      spirv_tools_context_->Validate(optimized_words.data(),
+                                     optimized_words.size(),
+                                     &validation_error) != SPV_SUCCESS) {
+    // Keep the SPIR-V from the translator, and try again in the next run in
+    // case the SPIRV-Tools version is different.
+    XELOGW(
+        "VulkanPipelineCache: Failed to optimize the SPIR-V of shader "
+        "{:016X}: {}",
+        translation.shader().ucode_data_hash(), validation_error);
+    return;
+  }
+  OptimizedSpirv optimized_spirv;
+  optimized_spirv.translated_word_count = translated_word_count;
+  optimized_spirv.optimized.resize(sizeof(uint32_t) * optimized_words.size());
+  std::memcpy(optimized_spirv.optimized.data(), optimized_words.data(),
+              optimized_spirv.optimized.size());
+  {
+    std::lock_guard<std::mutex> lock(optimized_spirv_mutex_);
+    optimized_spirv_.emplace(translated_hash, optimized_spirv);
+  }
+  if (optimized_spirv_storage_file_) {
+    {
+      std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+      storage_write_optimized_spirv_queue_.emplace_back(translated_hash,
+                                                        optimized_spirv);
+      storage_write_flush_optimized_spirv_ = true;
+    }
+    storage_write_request_cond_.notify_all();
+  }
+  translation.ReplaceTranslatedBinary(std::move(optimized_spirv.optimized));
+}
+
+void VulkanPipelineCache::StoreShader(Shader& shader) {
+  if (!shader_storage_file_ ||
+      shader.ucode_storage_index() == shader_storage_index_) {
+    return;
+  }
+  shader.set_ucode_storage_index(shader_storage_index_);
+  assert_not_null(storage_write_thread_);
+  shader_storage_file_flush_needed_ = true;
+  {
+    std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+    storage_write_shader_queue_.push_back(&shader);
+  }
+  storage_write_request_cond_.notify_all();
+}
+
 void VulkanPipelineCache::WritePipelineRenderTargetDescription(
     reg::RB_BLENDCONTROL blend_control, uint32_t write_mask,
     PipelineRenderTarget& render_target_out) const {
@@ -1864,6 +2810,67 @@ VkShaderModule VulkanPipelineCache::GetGeometryShader(GeometryShaderKey key) {
   return shader_module;
 }
 
+bool VulkanPipelineCache::GetPipelineCreationObjects(
+    const PipelineDescription& description,
+    const VulkanShader::VulkanTranslation* vertex_shader,
+    const VulkanShader::VulkanTranslation* pixel_shader,
+    const PipelineLayoutProvider*& pipeline_layout_out,
+    VkShaderModule& geometry_shader_out, VkRenderPass& render_pass_out) {
+  const PipelineLayoutProvider* pipeline_layout =
+      command_processor_.GetPipelineLayout(
+          pixel_shader
+              ? static_cast<const VulkanShader&>(pixel_shader->shader())
+                    .GetTextureBindingsAfterTranslation()
+                    .size()
+              : 0,
+          pixel_shader
+              ? static_cast<const VulkanShader&>(pixel_shader->shader())
+                    .GetSamplerBindingsAfterTranslation()
+                    .size()
+              : 0,
+          static_cast<const VulkanShader&>(vertex_shader->shader())
+              .GetTextureBindingsAfterTranslation()
+              .size(),
+          static_cast<const VulkanShader&>(vertex_shader->shader())
+              .GetSamplerBindingsAfterTranslation()
+              .size());
+  if (!pipeline_layout) {
+    return false;
+  }
+  VkShaderModule geometry_shader = VK_NULL_HANDLE;
+  GeometryShaderKey geometry_shader_key;
+  if (GetGeometryShaderKey(
+          description.geometry_shader,
+          SpirvShaderTranslator::Modification(vertex_shader->modification()),
+          SpirvShaderTranslator::Modification(
+              pixel_shader ? pixel_shader->modification() : 0),
+          geometry_shader_key)) {
+    geometry_shader = GetGeometryShader(geometry_shader_key);
+    if (geometry_shader == VK_NULL_HANDLE) {
+      return false;
+    }
+  }
+  // With dynamic rendering, the attachment formats are specified directly.
+  VkRenderPass render_pass = VK_NULL_HANDLE;
+  if (render_target_cache_.GetPath() ==
+          RenderTargetCache::Path::kPixelShaderInterlock ||
+      !render_target_cache_.dynamic_rendering_used()) {
+    render_pass =
+        render_target_cache_.GetPath() ==
+                RenderTargetCache::Path::kPixelShaderInterlock
+            ? render_target_cache_.GetFragmentShaderInterlockRenderPass()
+            : render_target_cache_.GetHostRenderTargetsRenderPass(
+                  description.render_pass_key);
+    if (render_pass == VK_NULL_HANDLE) {
+      return false;
+    }
+  }
+  pipeline_layout_out = pipeline_layout;
+  geometry_shader_out = geometry_shader;
+  render_pass_out = render_pass;
+  return true;
+}
+
 bool VulkanPipelineCache::EnsurePipelineCreated(
     const PipelineCreationArguments& creation_arguments) {
   if (creation_arguments.pipeline->second.pipeline != VK_NULL_HANDLE) {
@@ -2254,9 +3261,19 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
         VK_DYNAMIC_STATE_STENCIL_REFERENCE;
   }
 
+  VkPipelineRenderingCreateInfo rendering_create_info;
+  VkFormat rendering_color_formats[xenos::kMaxColorRenderTargets];
+  if (creation_arguments.render_pass == VK_NULL_HANDLE) {
+    render_target_cache_.GetHostRenderTargetsPipelineRenderingInfo(
+        description.render_pass_key, rendering_create_info,
+        rendering_color_formats);
+  }
+
   VkGraphicsPipelineCreateInfo pipeline_create_info;
   pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipeline_create_info.pNext = nullptr;
+  pipeline_create_info.pNext = creation_arguments.render_pass == VK_NULL_HANDLE
+                                   ? &rendering_create_info
+                                   : nullptr;
   pipeline_create_info.flags = 0;
   pipeline_create_info.stageCount = shader_stage_count;
   pipeline_create_info.pStages = shader_stages.data();
@@ -2278,8 +3295,110 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
 
   const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
   VkDevice device = provider.device();
+
+  if (pipeline_libraries_used_) {
+    // Vertex input and pre-rasterization shader state.
+    uint32_t fragment_stage_count =
+        uint32_t(shader_stage_fragment.module != VK_NULL_HANDLE);
+    uint32_t pre_rasterization_stage_count =
+        shader_stage_count - fragment_stage_count;
+    PipelineLibraryKey pre_rasterization_key;
+    pre_rasterization_key.shaders[0] = shader_stage_vertex.module;
+    pre_rasterization_key.shaders[1] = creation_arguments.geometry_shader;
+    pre_rasterization_key.pipeline_layout = pipeline_create_info.layout;
+    pre_rasterization_key.render_pass = pipeline_create_info.renderPass;
+    PipelineDescription& pre_rasterization_description =
+        pre_rasterization_key.description;
+    pre_rasterization_description.primitive_topology =
+        description.primitive_topology;
+    pre_rasterization_description.primitive_restart =
+        description.primitive_restart;
+    pre_rasterization_description.depth_clamp_enable =
+        description.depth_clamp_enable;
+    pre_rasterization_description.polygon_mode = description.polygon_mode;
+    pre_rasterization_description.cull_front = description.cull_front;
+    pre_rasterization_description.cull_back = description.cull_back;
+    pre_rasterization_description.front_face_clockwise =
+        description.front_face_clockwise;
+    VkGraphicsPipelineCreateInfo pre_rasterization_create_info =
+        pipeline_create_info;
+    pre_rasterization_create_info.stageCount = pre_rasterization_stage_count;
+    pre_rasterization_create_info.pMultisampleState = nullptr;
+    pre_rasterization_create_info.pDepthStencilState = nullptr;
+    pre_rasterization_create_info.pColorBlendState = nullptr;
+
+    // Fragment shader and fragment output state. The shader stages, the
+    // primitive topology and the rasterization state are reset in the key.
+    PipelineLibraryKey fragment_key;
+    fragment_key.shaders[0] = shader_stage_fragment.module;
+    fragment_key.pipeline_layout = pipeline_create_info.layout;
+    fragment_key.render_pass = pipeline_create_info.renderPass;
+    fragment_key.description = description;
+    PipelineDescription& fragment_description = fragment_key.description;
+    fragment_description.vertex_shader_hash = 0;
+    fragment_description.vertex_shader_modification = 0;
+    fragment_description.pixel_shader_hash = 0;
+    fragment_description.pixel_shader_modification = 0;
+    fragment_description.geometry_shader = PipelineGeometryShader::kNone;
+    fragment_description.primitive_topology =
+        PipelinePrimitiveTopology::kPointList;
+    fragment_description.primitive_restart = 0;
+    fragment_description.depth_clamp_enable = 0;
+    fragment_description.polygon_mode = PipelinePolygonMode::kFill;
+    fragment_description.cull_front = 0;
+    fragment_description.cull_back = 0;
+    fragment_description.front_face_clockwise = 0;
+    VkGraphicsPipelineCreateInfo fragment_create_info = pipeline_create_info;
+    fragment_create_info.stageCount = fragment_stage_count;
+    fragment_create_info.pStages =
+        shader_stages.data() + pre_rasterization_stage_count;
+    fragment_create_info.pVertexInputState = nullptr;
+    fragment_create_info.pInputAssemblyState = nullptr;
+    fragment_create_info.pViewportState = nullptr;
+    fragment_create_info.pRasterizationState = nullptr;
+
+    PipelineOptimizationRequest optimization_request;
+    optimization_request.pipeline = creation_arguments.pipeline;
+    optimization_request.libraries[0] = GetPipelineLibrary(
+        pre_rasterization_key, pre_rasterization_create_info, false);
+    optimization_request.libraries[1] =
+        GetPipelineLibrary(fragment_key, fragment_create_info, true);
+    if (optimization_request.libraries[0] == VK_NULL_HANDLE ||
+        optimization_request.libraries[1] == VK_NULL_HANDLE) {
+      return false;
+    }
+
+    // Fast-link the libraries, and request an optimized link.
+    VkPipelineLibraryCreateInfoKHR library_create_info;
+    library_create_info.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+    library_create_info.pNext = nullptr;
+    library_create_info.libraryCount =
+        uint32_t(xe::countof(optimization_request.libraries));
+    library_create_info.pLibraries = optimization_request.libraries;
+    VkGraphicsPipelineCreateInfo link_create_info = {};
+    link_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    link_create_info.pNext = &library_create_info;
+    link_create_info.layout = pipeline_create_info.layout;
+    link_create_info.basePipelineHandle = VK_NULL_HANDLE;
+    link_create_info.basePipelineIndex = -1;
+    VkPipeline pipeline;
+    if (dfn.vkCreateGraphicsPipelines(device, vk_pipeline_cache_, 1,
+                                      &link_create_info, nullptr,
+                                      &pipeline) != VK_SUCCESS) {
+      return false;
+    }
+    creation_arguments.pipeline->second.pipeline = pipeline;
+    {
+      std::lock_guard<std::mutex> lock(optimization_request_lock_);
+      optimization_queue_.push_back(optimization_request);
+    }
+    optimization_request_cond_.notify_one();
+    return true;
+  }
+
   VkPipeline pipeline;
-  if (dfn.vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1,
+  if (dfn.vkCreateGraphicsPipelines(device, vk_pipeline_cache_, 1,
                                     &pipeline_create_info, nullptr,
                                     &pipeline) != VK_SUCCESS) {
     // TODO(Triang3l): Move these error messages outside.
@@ -2298,6 +3417,317 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
   return true;
 }
 
+VkPipeline VulkanPipelineCache::GetPipelineLibrary(
+    const PipelineLibraryKey& key,
+    const VkGraphicsPipelineCreateInfo& create_info, bool is_fragment) {
+  auto& libraries = is_fragment ? fragment_pipeline_libraries_
+                                : pre_rasterization_pipeline_libraries_;
+  {
+    std::lock_guard<std::mutex> lock(pipeline_libraries_mutex_);
+    auto it = libraries.find(key);
+    if (it != libraries.end()) {
+      return it->second;
+    }
+  }
+
+  // Create without holding the lock, so other libraries can be created in
+  // parallel. If the same library is created on multiple threads, the first
+  // one is kept.
+  VkGraphicsPipelineLibraryCreateInfoEXT library_create_info;
+  library_create_info.sType =
+      VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+  // Keeping the attachment formats for dynamic rendering.
+  library_create_info.pNext = create_info.pNext;
+  library_create_info.flags =
+      is_fragment
+          ? (VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT |
+             VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT)
+          : (VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT |
+             VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT);
+  VkGraphicsPipelineCreateInfo library_pipeline_create_info = create_info;
+  library_pipeline_create_info.pNext = &library_create_info;
+  library_pipeline_create_info.flags |=
+      VK_PIPELINE_CREATE_LIBRARY_BIT_KHR |
+      VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+  VkPipeline library;
+  if (dfn.vkCreateGraphicsPipelines(device, vk_pipeline_cache_, 1,
+                                    &library_pipeline_create_info, nullptr,
+                                    &library) != VK_SUCCESS) {
+    XELOGE("VulkanPipelineCache: Failed to create a {} pipeline library",
+           is_fragment ? "fragment" : "pre-rasterization");
+    return VK_NULL_HANDLE;
+  }
+  std::lock_guard<std::mutex> lock(pipeline_libraries_mutex_);
+  auto emplace_result = libraries.emplace(key, library);
+  if (!emplace_result.second) {
+    dfn.vkDestroyPipeline(device, library, nullptr);
+  }
+  return emplace_result.first->second;
+}
+
+bool VulkanPipelineCache::CreatePipeline(
+    const PipelineCreationArguments& creation_arguments) {
+  bool created = EnsurePipelineCreated(creation_arguments);
+  creation_arguments.pipeline->second.created.store(true,
+                                                    std::memory_order_release);
+  return created;
+}
+
+void VulkanPipelineCache::AwaitPipelineCreation(
+    const std::pair<const PipelineDescription, Pipeline>& pipeline) {
+  while (!pipeline.second.created.load(std::memory_order_acquire)) {
+    PipelineCreationArguments creation_arguments;
+    {
+      std::unique_lock<std::mutex> lock(creation_request_lock_);
+      // Checking again with the lock held not to miss the notification if the
+      // creation has been completed after the previous check.
+      if (pipeline.second.created.load(std::memory_order_acquire)) {
+        break;
+      }
+      if (creation_queue_.empty()) {
+        // Being created on one of the creation threads.
+        creation_completion_cond_.wait(lock);
+        continue;
+      }
+      // Help the creation threads with the pipelines queued before.
+      creation_arguments = creation_queue_.front();
+      creation_queue_.pop_front();
+    }
+    CreatePipeline(creation_arguments);
+  }
+}
+
+void VulkanPipelineCache::CompleteBackgroundPipelineCreation() {
+  if (!creation_threads_.empty()) {
+    while (true) {
+      PipelineCreationArguments creation_arguments;
+      {
+        std::unique_lock<std::mutex> lock(creation_request_lock_);
+        if (creation_queue_.empty()) {
+          if (!creation_threads_busy_) {
+            break;
+          }
+          creation_completion_cond_.wait(lock);
+          continue;
+        }
+        creation_arguments = creation_queue_.front();
+        creation_queue_.pop_front();
+      }
+      CreatePipeline(creation_arguments);
+    }
+  }
+  // Pipelines created on this thread may have requested optimization too, so
+  // dropping the requests after all the creation is done.
+  if (optimization_thread_) {
+    std::unique_lock<std::mutex> lock(optimization_request_lock_);
+    optimization_queue_.clear();
+    while (optimization_thread_busy_) {
+      optimization_request_cond_.wait(lock);
+    }
+  }
+}
+
+void VulkanPipelineCache::StorageWriteThread() {
+  ShaderStoredHeader shader_header;
+  // Don't leak anything in unused bits.
+  std::memset(&shader_header, 0, sizeof(shader_header));
+
+  std::vector<uint32_t> ucode_guest_endian;
+  ucode_guest_endian.reserve(0xFFFF);
+
+  OptimizedSpirvStoredHeader optimized_spirv_header;
+  std::memset(&optimized_spirv_header, 0, sizeof(optimized_spirv_header));
+
+  bool flush_shaders = false;
+  bool flush_pipelines = false;
+  bool flush_optimized_spirv = false;
+
+  while (true) {
+    if (flush_shaders) {
+      flush_shaders = false;
+      assert_not_null(shader_storage_file_);
+      fflush(shader_storage_file_);
+    }
+    if (flush_pipelines) {
+      flush_pipelines = false;
+      assert_not_null(pipeline_storage_file_);
+      fflush(pipeline_storage_file_);
+    }
+    if (flush_optimized_spirv) {
+      flush_optimized_spirv = false;
+      assert_not_null(optimized_spirv_storage_file_);
+      fflush(optimized_spirv_storage_file_);
+    }
+
+    const Shader* shader = nullptr;
+    PipelineStoredDescription pipeline_description;
+    bool write_pipeline = false;
+    std::pair<uint64_t, OptimizedSpirv> optimized_spirv;
+    bool write_optimized_spirv = false;
+    {
+      std::unique_lock<std::mutex> lock(storage_write_request_lock_);
+      if (storage_write_thread_shutdown_) {
+        return;
+      }
+      if (!storage_write_shader_queue_.empty()) {
+        shader = storage_write_shader_queue_.front();
+        storage_write_shader_queue_.pop_front();
+      } else if (storage_write_flush_shaders_) {
+        storage_write_flush_shaders_ = false;
+        flush_shaders = true;
+      }
+      if (!storage_write_pipeline_queue_.empty()) {
+        std::memcpy(&pipeline_description,
+                    &storage_write_pipeline_queue_.front(),
+                    sizeof(pipeline_description));
+        storage_write_pipeline_queue_.pop_front();
+        write_pipeline = true;
+      } else if (storage_write_flush_pipelines_) {
+        storage_write_flush_pipelines_ = false;
+        flush_pipelines = true;
+      }
+      if (!storage_write_optimized_spirv_queue_.empty()) {
+        optimized_spirv =
+            std::move(storage_write_optimized_spirv_queue_.front());
+        storage_write_optimized_spirv_queue_.pop_front();
+        write_optimized_spirv = true;
+      } else if (storage_write_flush_optimized_spirv_) {
+        storage_write_flush_optimized_spirv_ = false;
+        flush_optimized_spirv = true;
+      }
+      if (!shader && !write_pipeline && !write_optimized_spirv) {
+        storage_write_request_cond_.wait(lock);
+        continue;
+      }
+    }
+
+    if (shader) {
+      shader_header.ucode_data_hash = shader->ucode_data_hash();
+      shader_header.ucode_dword_count = shader->ucode_dword_count();
+      shader_header.type = shader->type();
+      assert_not_null(shader_storage_file_);
+      fwrite(&shader_header, sizeof(shader_header), 1, shader_storage_file_);
+      if (shader_header.ucode_dword_count) {
+        ucode_guest_endian.resize(shader_header.ucode_dword_count);
+        // Need to swap because the hash is calculated for the shader with guest
+        // endianness.
+        xe::copy_and_swap(ucode_guest_endian.data(), shader->ucode_dwords(),
+                          shader_header.ucode_dword_count);
+        fwrite(ucode_guest_endian.data(),
+               shader_header.ucode_dword_count * sizeof(uint32_t), 1,
+               shader_storage_file_);
+      }
+    }
+
+    if (write_pipeline) {
+      assert_not_null(pipeline_storage_file_);
+      fwrite(&pipeline_description, sizeof(pipeline_description), 1,
+             pipeline_storage_file_);
+    }
+
+    if (write_optimized_spirv) {
+      const std::vector<uint8_t>& optimized = optimized_spirv.second.optimized;
+      optimized_spirv_header.translated_hash = optimized_spirv.first;
+      optimized_spirv_header.optimized_hash =
+          XXH3_64bits(optimized.data(), optimized.size());
+      optimized_spirv_header.translated_word_count =
+          optimized_spirv.second.translated_word_count;
+      optimized_spirv_header.optimized_word_count =
+          uint32_t(optimized.size() / sizeof(uint32_t));
+      assert_not_null(optimized_spirv_storage_file_);
+      fwrite(&optimized_spirv_header, sizeof(optimized_spirv_header), 1,
+             optimized_spirv_storage_file_);
+      fwrite(optimized.data(), optimized.size(), 1,
+             optimized_spirv_storage_file_);
+    }
+  }
+}
+
+void VulkanPipelineCache::CreationThread() {
+  while (true) {
+    PipelineCreationArguments creation_arguments;
+    {
+      std::unique_lock<std::mutex> lock(creation_request_lock_);
+      if (creation_threads_shutdown_) {
+        return;
+      }
+      if (creation_queue_.empty()) {
+        creation_request_cond_.wait(lock);
+        continue;
+      }
+      creation_arguments = creation_queue_.front();
+      creation_queue_.pop_front();
+      ++creation_threads_busy_;
+    }
+
+    CreatePipeline(creation_arguments);
+
+    {
+      std::lock_guard<std::mutex> lock(creation_request_lock_);
+      --creation_threads_busy_;
+    }
+    creation_completion_cond_.notify_all();
+  }
+}
+
+void VulkanPipelineCache::OptimizationThread() {
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+
+  while (true) {
+    PipelineOptimizationRequest request;
+    {
+      std::unique_lock<std::mutex> lock(optimization_request_lock_);
+      if (optimization_thread_busy_) {
+        optimization_thread_busy_ = false;
+        // Notify CompleteBackgroundPipelineCreation if it's waiting.
+        optimization_request_cond_.notify_all();
+      }
+      if (optimization_thread_shutdown_) {
+        return;
+      }
+      if (optimization_queue_.empty()) {
+        optimization_request_cond_.wait(lock);
+        continue;
+      }
+      request = optimization_queue_.front();
+      optimization_queue_.pop_front();
+      optimization_thread_busy_ = true;
+    }
+
+    VkPipelineLibraryCreateInfoKHR library_create_info;
+    library_create_info.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+    library_create_info.pNext = nullptr;
+    library_create_info.libraryCount = uint32_t(xe::countof(request.libraries));
+    library_create_info.pLibraries = request.libraries;
+    VkGraphicsPipelineCreateInfo link_create_info = {};
+    link_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    link_create_info.pNext = &library_create_info;
+    link_create_info.flags = VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT;
+    link_create_info.layout =
+        request.pipeline->second.pipeline_layout->GetPipelineLayout();
+    link_create_info.basePipelineHandle = VK_NULL_HANDLE;
+    link_create_info.basePipelineIndex = -1;
+    VkPipeline optimized_pipeline;
+    if (dfn.vkCreateGraphicsPipelines(device, vk_pipeline_cache_, 1,
+                                      &link_create_info, nullptr,
+                                      &optimized_pipeline) == VK_SUCCESS) {
+      // The fast-linked pipeline may still be used by submissions in flight,
+      // so it's kept until the shutdown.
+      request.pipeline->second.optimized_pipeline = optimized_pipeline;
+      request.pipeline->second.optimized.store(true,
+                                               std::memory_order_release);
+    }
+  }
+}
+
 }  // namespace vulkan
 }  // namespace gpu
 }  // namespace xe
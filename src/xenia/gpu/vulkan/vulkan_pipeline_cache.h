@@ -10,15 +10,24 @@
 #ifndef XENIA_GPU_VULKAN_VULKAN_PIPELINE_STATE_CACHE_H_
 #define XENIA_GPU_VULKAN_VULKAN_PIPELINE_STATE_CACHE_H_
 
+#include <atomic>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdio>
 #include <cstring>
+#include <deque>
+#include <filesystem>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "xenia/base/hash.h"
 #include "xenia/base/platform.h"
+#include "xenia/base/string_buffer.h"
+#include "xenia/base/threading.h"
 #include "xenia/base/xxhash.h"
 #include "xenia/gpu/primitive_processor.h"
 #include "xenia/gpu/register_file.h"
@@ -27,6 +36,7 @@
 #include "xenia/gpu/vulkan/vulkan_render_target_cache.h"
 #include "xenia/gpu/vulkan/vulkan_shader.h"
 #include "xenia/gpu/xenos.h"
+#include "xenia/ui/vulkan/spirv_tools_context.h"
 #include "xenia/ui/vulkan/vulkan_provider.h"
 
 namespace xe {
@@ -59,6 +69,16 @@ class VulkanPipelineCache {
   bool Initialize();
   void Shutdown();
 
+  // Loads the shaders and the pipelines stored in the previous runs, and
+  // preloads the Vulkan pipeline cache data of the device.
+  void InitializeShaderStorage(const std::filesystem::path& cache_root,
+                               uint32_t title_id, bool blocking);
+  void ShutdownShaderStorage();
+
+  void EndSubmission();
+  // Number of pipelines queued or being created on the creation threads.
+  size_t GetPendingPipelineCount();
+
   VulkanShader* LoadShader(xenos::ShaderType shader_type,
                            const uint32_t* host_address, uint32_t dword_count);
   // Analyze shader microcode on the translator thread.
@@ -78,7 +98,9 @@ class VulkanPipelineCache {
 
   bool EnsureShadersTranslated(VulkanShader::VulkanTranslation* vertex_shader,
                                VulkanShader::VulkanTranslation* pixel_shader);
-  // TODO(Triang3l): Return a deferred creation handle.
+  // With asynchronous pipeline creation, returns true with pipeline_out set to
+  // VK_NULL_HANDLE if the pipeline is still being created on the creation
+  // threads - AwaitCurrentPipelineCreation can be used to obtain it then.
   bool ConfigurePipeline(
       VulkanShader::VulkanTranslation* vertex_shader,
       VulkanShader::VulkanTranslation* pixel_shader,
@@ -88,8 +110,33 @@ class VulkanPipelineCache {
       VulkanRenderTargetCache::RenderPassKey render_pass_key,
       VkPipeline& pipeline_out,
       const PipelineLayoutProvider*& pipeline_layout_out);
+  // Waits for the creation of the pipeline returned by the latest successful
+  // ConfigurePipeline call, or VK_NULL_HANDLE if it has failed.
+  VkPipeline AwaitCurrentPipelineCreation();
 
  private:
+  XEPACKEDSTRUCT(ShaderStoredHeader, {
+    uint64_t ucode_data_hash;
+
+    uint32_t ucode_dword_count : 31;
+    xenos::ShaderType type : 1;
+
+    static constexpr uint32_t kVersion = 0x20201219;
+  });
+
+  // Followed by the optimized SPIR-V.
+  XEPACKEDSTRUCT(OptimizedSpirvStoredHeader, {
+    // XXH3 of the SPIR-V generated by the translator.
+    uint64_t translated_hash;
+    // XXH3 of the optimized SPIR-V.
+    uint64_t optimized_hash;
+    uint32_t translated_word_count;
+    uint32_t optimized_word_count;
+
+    // Update if the optimization passes are changed.
+    static constexpr uint32_t kVersion = 0x20261014;
+  });
+
   enum class PipelineGeometryShader : uint32_t {
     kNone,
     kPointList,
@@ -198,6 +245,12 @@ class VulkanPipelineCache {
         return size_t(description.GetHash());
       }
     };
+    static constexpr uint32_t kVersion = 0x20261014;
+  });
+
+  XEPACKEDSTRUCT(PipelineStoredDescription, {
+    uint64_t description_hash;
+    PipelineDescription description;
   });
 
   struct Pipeline {
@@ -205,10 +258,52 @@ class VulkanPipelineCache {
     // The layouts are owned by the VulkanCommandProcessor, and must not be
     // destroyed by it while the pipeline cache is active.
     const PipelineLayoutProvider* pipeline_layout;
+    // Set after the creation is completed, successfully or not, with release
+    // ordering, as it may be done on the creation threads.
+    std::atomic<bool> created{false};
+    // For pipelines linked from graphics pipeline libraries, the pipeline
+    // linked with link-time optimizations in the background, to use instead of
+    // the fast-linked one once it's set, with release ordering.
+    VkPipeline optimized_pipeline = VK_NULL_HANDLE;
+    std::atomic<bool> optimized{false};
+    VkPipeline GetPipelineToUse() const {
+      return optimized.load(std::memory_order_acquire) ? optimized_pipeline
+                                                       : pipeline;
+    }
     Pipeline(const PipelineLayoutProvider* pipeline_layout_provider)
         : pipeline_layout(pipeline_layout_provider) {}
   };
 
+  // State of a VK_EXT_graphics_pipeline_library part of pipelines - the
+  // vertex input and pre-rasterization shader state with the vertex and the
+  // geometry shaders, or the fragment shader and fragment output state with
+  // the fragment shader. The fields of the description not affecting the part
+  // are reset, so the part is shared by pipelines that differ only in them.
+  struct PipelineLibraryKey {
+    VkShaderModule shaders[2];
+    VkPipelineLayout pipeline_layout;
+    VkRenderPass render_pass;
+    PipelineDescription description;
+
+    // Including all the padding, for a stable hash.
+    PipelineLibraryKey() { std::memset(this, 0, sizeof(*this)); }
+    PipelineLibraryKey(const PipelineLibraryKey& key) {
+      std::memcpy(this, &key, sizeof(*this));
+    }
+    PipelineLibraryKey& operator=(const PipelineLibraryKey& key) {
+      std::memcpy(this, &key, sizeof(*this));
+      return *this;
+    }
+    bool operator==(const PipelineLibraryKey& key) const {
+      return std::memcmp(this, &key, sizeof(*this)) == 0;
+    }
+    struct Hasher {
+      size_t operator()(const PipelineLibraryKey& key) const {
+        return size_t(XXH3_64bits(&key, sizeof(key)));
+      }
+    };
+  };
+
   // Description that can be passed from the command processor thread to the
   // creation threads, with everything needed from caches pre-looked-up.
   struct PipelineCreationArguments {
@@ -246,9 +341,20 @@ class VulkanPipelineCache {
     }
   };
 
+  VulkanShader* LoadShader(xenos::ShaderType shader_type,
+                           const uint32_t* host_address, uint32_t dword_count,
+                           uint64_t data_hash);
+
   // Can be called from multiple threads.
   bool TranslateAnalyzedShader(SpirvShaderTranslator& translator,
                                VulkanShader::VulkanTranslation& translation);
+  // Replaces the translated SPIR-V with the optimized one, taken from the
+  // previously optimized shaders if possible. Can be called from multiple
+  // threads.
+  void OptimizeTranslatedSpirv(VulkanShader::VulkanTranslation& translation);
+  // Requests writing the shader to the storage if it's open and the shader is
+  // not in it yet.
+  void StoreShader(Shader& shader);
 
   void WritePipelineRenderTargetDescription(
       reg::RB_BLENDCONTROL blend_control, uint32_t write_mask,
@@ -272,11 +378,33 @@ class VulkanPipelineCache {
       GeometryShaderKey& key_out);
   VkShaderModule GetGeometryShader(GeometryShaderKey key);
 
+  // Looks up or creates the objects needed for creating the pipeline, on the
+  // command processor thread. The shaders must be translated and valid.
+  bool GetPipelineCreationObjects(
+      const PipelineDescription& description,
+      const VulkanShader::VulkanTranslation* vertex_shader,
+      const VulkanShader::VulkanTranslation* pixel_shader,
+      const PipelineLayoutProvider*& pipeline_layout_out,
+      VkShaderModule& geometry_shader_out, VkRenderPass& render_pass_out);
+
   // Can be called from creation threads - all needed data must be fully set up
   // at the point of the call: shaders must be translated, pipeline layout and
   // render pass objects must be available.
   bool EnsurePipelineCreated(
       const PipelineCreationArguments& creation_arguments);
+  // Returns the graphics pipeline library with the state from the create
+  // info, creating it if needed. Can be called from creation threads.
+  VkPipeline GetPipelineLibrary(
+      const PipelineLibraryKey& key,
+      const VkGraphicsPipelineCreateInfo& create_info, bool is_fragment);
+  // EnsurePipelineCreated marking the pipeline as created.
+  bool CreatePipeline(const PipelineCreationArguments& creation_arguments);
+  void AwaitPipelineCreation(
+      const std::pair<const PipelineDescription, Pipeline>& pipeline);
+  // Creates or awaits the creation of all the queued pipelines, and drops the
+  // pending optimized links, so the driver pipeline cache is not used by other
+  // threads until new pipelines are requested.
+  void CompleteBackgroundPipelineCreation();
 
   VulkanCommandProcessor& command_processor_;
   const RegisterFile& register_file_;
@@ -287,6 +415,19 @@ class VulkanPipelineCache {
   StringBuffer ucode_disasm_buffer_;
   // Reusable shader translator on the command processor thread.
   std::unique_ptr<SpirvShaderTranslator> shader_translator_;
+  // For optimizing the translated shaders if enabled, null otherwise.
+  std::unique_ptr<ui::vulkan::SpirvToolsContext> spirv_tools_context_;
+
+  struct OptimizedSpirv {
+    uint32_t translated_word_count;
+    std::vector<uint8_t> optimized;
+  };
+  std::mutex optimized_spirv_mutex_;
+  // XXH3 of the translated SPIR-V -> SPIR-V after optimization, also loaded
+  // from the storage, protected with optimized_spirv_mutex_.
+  std::unordered_map<uint64_t, OptimizedSpirv,
+                     xe::hash::IdentityHasher<uint64_t>>
+      optimized_spirv_;
 
   struct LayoutUID {
     size_t uid;
@@ -321,9 +462,88 @@ class VulkanPipelineCache {
   std::unordered_map<PipelineDescription, Pipeline, PipelineDescription::Hasher>
       pipelines_;
 
+  // Whether pipelines are linked from VK_EXT_graphics_pipeline_library parts
+  // rather than created as a whole.
+  bool pipeline_libraries_used_ = false;
+  // Pipeline library parts, may be accessed from creation threads, protected
+  // with pipeline_libraries_mutex_.
+  std::mutex pipeline_libraries_mutex_;
+  std::unordered_map<PipelineLibraryKey, VkPipeline,
+                     PipelineLibraryKey::Hasher>
+      pre_rasterization_pipeline_libraries_;
+  std::unordered_map<PipelineLibraryKey, VkPipeline,
+                     PipelineLibraryKey::Hasher>
+      fragment_pipeline_libraries_;
+
+  // Thread linking pipelines from libraries with link-time optimizations after
+  // they have been fast-linked.
+  struct PipelineOptimizationRequest {
+    std::pair<const PipelineDescription, Pipeline>* pipeline;
+    VkPipeline libraries[2];
+  };
+  void OptimizationThread();
+  std::mutex optimization_request_lock_;
+  std::condition_variable optimization_request_cond_;
+  // Protected with optimization_request_lock_, notify
+  // optimization_request_cond_ when changed.
+  std::deque<PipelineOptimizationRequest> optimization_queue_;
+  bool optimization_thread_busy_ = false;
+  bool optimization_thread_shutdown_ = false;
+  std::unique_ptr<xe::threading::Thread> optimization_thread_;
+
   // Previously used pipeline, to avoid lookups if the state wasn't changed.
   const std::pair<const PipelineDescription, Pipeline>* last_pipeline_ =
       nullptr;
+
+  // Driver pipeline cache, with its initial data loaded from and its final
+  // data written to the local storage of the device, while the shader storage
+  // is open.
+  VkPipelineCache vk_pipeline_cache_ = VK_NULL_HANDLE;
+  std::filesystem::path vk_pipeline_cache_file_path_;
+
+  // Shader storage output stream, for preload in the next emulator runs.
+  FILE* shader_storage_file_ = nullptr;
+  // For only writing shaders to the currently open storage once, incremented
+  // when switching the storage.
+  uint32_t shader_storage_index_ = 0;
+  bool shader_storage_file_flush_needed_ = false;
+
+  // Pipeline storage output stream, for preload in the next emulator runs.
+  FILE* pipeline_storage_file_ = nullptr;
+  bool pipeline_storage_file_flush_needed_ = false;
+
+  // Optimized SPIR-V storage output stream, for optimizing each shader only
+  // once. Depends on the device features, so it's local.
+  FILE* optimized_spirv_storage_file_ = nullptr;
+
+  // Thread for asynchronous writing to the storage streams.
+  void StorageWriteThread();
+  std::mutex storage_write_request_lock_;
+  std::condition_variable storage_write_request_cond_;
+  // Storage thread input is protected with storage_write_request_lock_, and the
+  // thread is notified about its change via storage_write_request_cond_.
+  std::deque<const Shader*> storage_write_shader_queue_;
+  std::deque<PipelineStoredDescription> storage_write_pipeline_queue_;
+  std::deque<std::pair<uint64_t, OptimizedSpirv>>
+      storage_write_optimized_spirv_queue_;
+  bool storage_write_flush_shaders_ = false;
+  bool storage_write_flush_pipelines_ = false;
+  bool storage_write_flush_optimized_spirv_ = false;
+  bool storage_write_thread_shutdown_ = false;
+  std::unique_ptr<xe::threading::Thread> storage_write_thread_;
+
+  // Pipeline creation threads, used with asynchronous pipeline creation.
+  void CreationThread();
+  std::mutex creation_request_lock_;
+  // Notified when pipelines are queued or the shutdown is requested.
+  std::condition_variable creation_request_cond_;
+  // Notified when the creation of a pipeline is completed.
+  std::condition_variable creation_completion_cond_;
+  // Protected with creation_request_lock_.
+  std::deque<PipelineCreationArguments> creation_queue_;
+  size_t creation_threads_busy_ = 0;
+  bool creation_threads_shutdown_ = false;
+  std::vector<std::unique_ptr<xe::threading::Thread>> creation_threads_;
 };
 
 }  // namespace vulkan
@@ -54,6 +54,11 @@ DEFINE_string(
     "  Choose what is considered the most optimal for the system (currently "
     "always FB because the FSI path is much slower now).",
     "GPU");
+DEFINE_bool(
+    vulkan_dynamic_rendering, false,
+    "Use dynamic rendering instead of render pass and framebuffer objects for "
+    "host render targets if Vulkan 1.3 dynamic rendering is supported.",
+    "Vulkan");
 
 namespace xe {
 namespace gpu {
@@ -216,7 +221,11 @@ bool VulkanRenderTargetCache::Initialize(uint32_t shared_memory_binding_count) {
   const ui::vulkan::VulkanProvider::DeviceInfo& device_info =
       provider.device_info();
 
-  if (cvars::render_target_path_vulkan == "fsi") {
+  std::optional<Path> path_override =
+      command_processor_.render_target_path_override();
+  if (path_override) {
+    path_ = *path_override;
+  } else if (cvars::render_target_path_vulkan == "fsi") {
     path_ = Path::kPixelShaderInterlock;
   } else {
     path_ = Path::kHostRenderTargets;
@@ -254,6 +263,10 @@ bool VulkanRenderTargetCache::Initialize(uint32_t shared_memory_binding_count) {
     }
   }
 
+  dynamic_rendering_used_ = path_ == Path::kHostRenderTargets &&
+                            cvars::vulkan_dynamic_rendering &&
+                            device_info.dynamicRendering;
+
   // Format support.
   constexpr VkFormatFeatureFlags kUsedDepthFormatFeatures =
       VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
@@ -1165,6 +1178,7 @@ bool VulkanRenderTargetCache::Resolve(const Memory& memory,
           texture_cache.MarkRangeAsResolved(
               resolve_info.copy_dest_extent_start,
               resolve_info.copy_dest_extent_length);
+          texture_cache.MarkResolveDestination(resolve_info);
           written_address_out = resolve_info.copy_dest_extent_start;
           written_length_out = resolve_info.copy_dest_extent_length;
           copied = true;
@@ -1328,16 +1342,24 @@ bool VulkanRenderTargetCache::Update(
       }
 
       const Framebuffer* framebuffer = last_update_framebuffer_;
-      VkRenderPass render_pass = last_update_render_pass_key_ == render_pass_key
-                                     ? last_update_render_pass_
-                                     : VK_NULL_HANDLE;
-      if (render_pass == VK_NULL_HANDLE) {
-        render_pass = GetHostRenderTargetsRenderPass(render_pass_key);
+      VkRenderPass render_pass = VK_NULL_HANDLE;
+      if (dynamic_rendering_used_) {
+        if (last_update_render_pass_key_ != render_pass_key) {
+          // Framebuffer for different attachments needed now.
+          framebuffer = nullptr;
+        }
+      } else {
+        render_pass = last_update_render_pass_key_ == render_pass_key
+                          ? last_update_render_pass_
+                          : VK_NULL_HANDLE;
         if (render_pass == VK_NULL_HANDLE) {
-          return false;
+          render_pass = GetHostRenderTargetsRenderPass(render_pass_key);
+          if (render_pass == VK_NULL_HANDLE) {
+            return false;
+          }
+          // Framebuffer for a different render pass needed now.
+          framebuffer = nullptr;
         }
-        // Framebuffer for a different render pass needed now.
-        framebuffer = nullptr;
       }
 
       uint32_t pitch_tiles_at_32bpp =
@@ -1514,16 +1536,11 @@ VkRenderPass VulkanRenderTargetCache::GetHostRenderTargetsRenderPass(
   subpass.preserveAttachmentCount = 0;
   subpass.pPreserveAttachments = nullptr;
 
-  VkPipelineStageFlags dependency_stage_mask = 0;
-  VkAccessFlags dependency_access_mask = 0;
-  if (key.depth_and_color_used & 0b1) {
-    dependency_stage_mask |= VulkanRenderTarget::kDepthDrawStageMask;
-    dependency_access_mask |= VulkanRenderTarget::kDepthDrawAccessMask;
-  }
-  if (key.depth_and_color_used >> 1) {
-    dependency_stage_mask |= VulkanRenderTarget::kColorDrawStageMask;
-    dependency_access_mask |= VulkanRenderTarget::kColorDrawAccessMask;
-  }
+  VkPipelineStageFlags dependency_stage_mask;
+  VkAccessFlags dependency_access_mask;
+  GetHostRenderTargetsDependencyMasks(key.depth_and_color_used,
+                                      dependency_stage_mask,
+                                      dependency_access_mask);
   VkSubpassDependency subpass_dependencies[2];
   subpass_dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
   subpass_dependencies[0].dstSubpass = 0;
@@ -1569,6 +1586,93 @@ VkRenderPass VulkanRenderTargetCache::GetHostRenderTargetsRenderPass(
   return render_pass;
 }
 
+void VulkanRenderTargetCache::GetHostRenderTargetsPipelineRenderingInfo(
+    RenderPassKey key, VkPipelineRenderingCreateInfo& info_out,
+    VkFormat* color_formats_out) const {
+  assert_true(dynamic_rendering_used_);
+  xenos::ColorRenderTargetFormat color_formats[] = {
+      key.color_0_view_format,
+      key.color_1_view_format,
+      key.color_2_view_format,
+      key.color_3_view_format,
+  };
+  info_out.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+  info_out.pNext = nullptr;
+  info_out.viewMask = 0;
+  info_out.colorAttachmentCount =
+      32 - xe::lzcnt(uint32_t(key.depth_and_color_used >> 1));
+  for (uint32_t i = 0; i < info_out.colorAttachmentCount; ++i) {
+    if (!(key.depth_and_color_used & (uint32_t(1) << (1 + i)))) {
+      color_formats_out[i] = VK_FORMAT_UNDEFINED;
+      continue;
+    }
+    color_formats_out[i] =
+        key.color_rts_use_transfer_formats
+            ? GetColorOwnershipTransferVulkanFormat(color_formats[i])
+            : GetColorVulkanFormat(color_formats[i]);
+  }
+  info_out.pColorAttachmentFormats = color_formats_out;
+  VkFormat depth_format = (key.depth_and_color_used & 0b1)
+                              ? GetDepthVulkanFormat(key.depth_format)
+                              : VK_FORMAT_UNDEFINED;
+  info_out.depthAttachmentFormat = depth_format;
+  info_out.stencilAttachmentFormat = depth_format;
+}
+
+void VulkanRenderTargetCache::GetFramebufferRenderingInfo(
+    const Framebuffer& framebuffer, VkRenderingInfo& info_out,
+    VkRenderingAttachmentInfo* attachments_out,
+    VkPipelineStageFlags& dependency_stage_mask_out,
+    VkAccessFlags& dependency_access_mask_out) {
+  uint32_t depth_and_color_used =
+      framebuffer.render_pass_key.depth_and_color_used;
+  info_out.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+  info_out.pNext = nullptr;
+  info_out.flags = 0;
+  info_out.renderArea.offset.x = 0;
+  info_out.renderArea.offset.y = 0;
+  info_out.renderArea.extent = framebuffer.host_extent;
+  info_out.layerCount = 1;
+  info_out.viewMask = 0;
+  info_out.colorAttachmentCount =
+      32 - xe::lzcnt(uint32_t(depth_and_color_used >> 1));
+  info_out.pColorAttachments = attachments_out;
+  info_out.pDepthAttachment = nullptr;
+  info_out.pStencilAttachment = nullptr;
+  for (uint32_t i = 0; i < 1 + xenos::kMaxColorRenderTargets; ++i) {
+    // Depth after the color attachments.
+    uint32_t rt_index = (i + 1) % (1 + xenos::kMaxColorRenderTargets);
+    if (rt_index && rt_index > info_out.colorAttachmentCount) {
+      continue;
+    }
+    VkRenderingAttachmentInfo& attachment = attachments_out[i];
+    attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    attachment.pNext = nullptr;
+    if (rt_index) {
+      // Null for unused attachments between the used ones.
+      attachment.imageView = framebuffer.color_attachments[rt_index - 1];
+      attachment.imageLayout = VulkanRenderTarget::kColorDrawLayout;
+    } else {
+      if (!(depth_and_color_used & 0b1)) {
+        continue;
+      }
+      attachment.imageView = framebuffer.depth_stencil_attachment;
+      attachment.imageLayout = VulkanRenderTarget::kDepthDrawLayout;
+      info_out.pDepthAttachment = &attachment;
+      info_out.pStencilAttachment = &attachment;
+    }
+    attachment.resolveMode = VK_RESOLVE_MODE_NONE;
+    attachment.resolveImageView = VK_NULL_HANDLE;
+    attachment.resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.clearValue = {};
+  }
+  GetHostRenderTargetsDependencyMasks(depth_and_color_used,
+                                      dependency_stage_mask_out,
+                                      dependency_access_mask_out);
+}
+
 VkFormat VulkanRenderTargetCache::GetDepthVulkanFormat(
     xenos::DepthRenderTargetFormat format) const {
   if (format == xenos::DepthRenderTargetFormat::kD24S8 &&
@@ -2040,6 +2144,21 @@ void VulkanRenderTargetCache::CommitEdramBufferShaderWrites(
   PixelShaderInterlockFullEdramBarrierPlaced();
 }
 
+void VulkanRenderTargetCache::GetHostRenderTargetsDependencyMasks(
+    uint32_t depth_and_color_used, VkPipelineStageFlags& stage_mask_out,
+    VkAccessFlags& access_mask_out) {
+  stage_mask_out = 0;
+  access_mask_out = 0;
+  if (depth_and_color_used & 0b1) {
+    stage_mask_out |= VulkanRenderTarget::kDepthDrawStageMask;
+    access_mask_out |= VulkanRenderTarget::kDepthDrawAccessMask;
+  }
+  if (depth_and_color_used >> 1) {
+    stage_mask_out |= VulkanRenderTarget::kColorDrawStageMask;
+    access_mask_out |= VulkanRenderTarget::kColorDrawAccessMask;
+  }
+}
+
 const VulkanRenderTargetCache::Framebuffer*
 VulkanRenderTargetCache::GetHostRenderTargetsFramebuffer(
     RenderPassKey render_pass_key, uint32_t pitch_tiles_at_32bpp,
@@ -2078,11 +2197,16 @@ VulkanRenderTargetCache::GetHostRenderTargetsFramebuffer(
   const ui::vulkan::VulkanProvider::DeviceInfo& device_info =
       provider.device_info();
 
-  VkRenderPass render_pass = GetHostRenderTargetsRenderPass(render_pass_key);
-  if (render_pass == VK_NULL_HANDLE) {
-    return nullptr;
+  VkRenderPass render_pass = VK_NULL_HANDLE;
+  if (!dynamic_rendering_used_) {
+    render_pass = GetHostRenderTargetsRenderPass(render_pass_key);
+    if (render_pass == VK_NULL_HANDLE) {
+      return nullptr;
+    }
   }
 
+  Framebuffer framebuffer;
+  framebuffer.render_pass_key = render_pass_key;
   VkImageView attachments[1 + xenos::kMaxColorRenderTargets];
   uint32_t attachment_count = 0;
   uint32_t depth_and_color_rts_remaining = render_pass_key.depth_and_color_used;
@@ -2100,6 +2224,11 @@ VulkanRenderTargetCache::GetHostRenderTargetsFramebuffer(
       attachment = vulkan_rt.view_depth_stencil();
     }
     attachments[attachment_count++] = attachment;
+    if (rt_index) {
+      framebuffer.color_attachments[rt_index - 1] = attachment;
+    } else {
+      framebuffer.depth_stencil_attachment = attachment;
+    }
   }
 
   VkFramebufferCreateInfo framebuffer_create_info;
@@ -2128,19 +2257,18 @@ VulkanRenderTargetCache::GetHostRenderTargetsFramebuffer(
                                device_info.maxFramebufferWidth);
   host_extent.height = std::min(host_extent.height * draw_resolution_scale_y(),
                                 device_info.maxFramebufferHeight);
-  framebuffer_create_info.width = host_extent.width;
-  framebuffer_create_info.height = host_extent.height;
-  framebuffer_create_info.layers = 1;
-  VkFramebuffer framebuffer;
-  if (dfn.vkCreateFramebuffer(device, &framebuffer_create_info, nullptr,
-                              &framebuffer) != VK_SUCCESS) {
-    return nullptr;
+  framebuffer.host_extent = host_extent;
+  if (!dynamic_rendering_used_) {
+    framebuffer_create_info.width = host_extent.width;
+    framebuffer_create_info.height = host_extent.height;
+    framebuffer_create_info.layers = 1;
+    if (dfn.vkCreateFramebuffer(device, &framebuffer_create_info, nullptr,
+                                &framebuffer.framebuffer) != VK_SUCCESS) {
+      return nullptr;
+    }
   }
   // Creates at a persistent location - safe to use pointers.
-  return &framebuffers_
-              .emplace(std::piecewise_construct, std::forward_as_tuple(key),
-                       std::forward_as_tuple(framebuffer, host_extent))
-              .first->second;
+  return &framebuffers_.emplace(key, framebuffer).first->second;
 }
 
 VkShaderModule VulkanRenderTargetCache::GetTransferShader(
@@ -4214,10 +4342,17 @@ VkPipeline const* VulkanRenderTargetCache::GetTransferPipelines(
                                                     : nullptr;
   }
 
-  VkRenderPass render_pass =
-      GetHostRenderTargetsRenderPass(key.render_pass_key);
+  VkRenderPass render_pass = VK_NULL_HANDLE;
+  VkPipelineRenderingCreateInfo rendering_create_info;
+  VkFormat rendering_color_formats[xenos::kMaxColorRenderTargets];
+  if (dynamic_rendering_used_) {
+    GetHostRenderTargetsPipelineRenderingInfo(
+        key.render_pass_key, rendering_create_info, rendering_color_formats);
+  } else {
+    render_pass = GetHostRenderTargetsRenderPass(key.render_pass_key);
+  }
   VkShaderModule fragment_shader_module = GetTransferShader(key.shader_key);
-  if (render_pass == VK_NULL_HANDLE ||
+  if ((!dynamic_rendering_used_ && render_pass == VK_NULL_HANDLE) ||
       fragment_shader_module == VK_NULL_HANDLE) {
     transfer_pipelines_.emplace(key, std::array<VkPipeline, 4>{});
     return nullptr;
@@ -4420,7 +4555,8 @@ VkPipeline const* VulkanRenderTargetCache::GetTransferPipelines(
   std::array<VkPipeline, 4> pipelines{};
   VkGraphicsPipelineCreateInfo pipeline_create_info;
   pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipeline_create_info.pNext = nullptr;
+  pipeline_create_info.pNext =
+      dynamic_rendering_used_ ? &rendering_create_info : nullptr;
   pipeline_create_info.flags = 0;
   if (dest_is_masked_sample) {
     pipeline_create_info.flags |= VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
@@ -4603,6 +4739,7 @@ void VulkanRenderTargetCache::PerformTransfersAndResolveClears(
         command_buffer.CmdVkDispatch(group_count_x, group_count_y, 1);
         MarkEdramBufferModified();
       }
+      CountTransferPasses(transfer_rectangle_count, transfer_rectangle_count);
     }
     break;
   }
@@ -4784,10 +4921,13 @@ void VulkanRenderTargetCache::PerformTransfersAndResolveClears(
           dest_rt_key.GetColorFormat();
       transfer_render_pass_key.color_rts_use_transfer_formats = 1;
     }
-    VkRenderPass transfer_render_pass =
-        GetHostRenderTargetsRenderPass(transfer_render_pass_key);
-    if (transfer_render_pass == VK_NULL_HANDLE) {
-      continue;
+    VkRenderPass transfer_render_pass = VK_NULL_HANDLE;
+    if (!dynamic_rendering_used_) {
+      transfer_render_pass =
+          GetHostRenderTargetsRenderPass(transfer_render_pass_key);
+      if (transfer_render_pass == VK_NULL_HANDLE) {
+        continue;
+      }
     }
     const RenderTarget*
         transfer_framebuffer_render_targets[1 + xenos::kMaxColorRenderTargets] =
@@ -5291,6 +5431,9 @@ void VulkanRenderTargetCache::PerformTransfersAndResolveClears(
               kTransferUsedPushConstantDwordAddressBit;
         }
 
+        CountTransferPasses(
+            transfer_sample_pipeline_count * (transfer_is_stencil_bit ? 8 : 1),
+            transfer_rectangle_count);
         for (uint32_t j = 0; j < transfer_sample_pipeline_count; ++j) {
           if (j) {
             command_processor_.BindExternalGraphicsPipeline(
@@ -89,8 +89,14 @@ class VulkanRenderTargetCache final : public RenderTargetCache {
   static_assert_size(RenderPassKey, sizeof(uint32_t));
 
   struct Framebuffer {
+    // VK_NULL_HANDLE with dynamic rendering, in which case the attachments are
+    // specified directly when beginning rendering.
     VkFramebuffer framebuffer = VK_NULL_HANDLE;
     VkExtent2D host_extent{};
+    // For dynamic rendering.
+    RenderPassKey render_pass_key;
+    VkImageView depth_stencil_attachment = VK_NULL_HANDLE;
+    VkImageView color_attachments[xenos::kMaxColorRenderTargets] = {};
     Framebuffer() = default;
     Framebuffer(VkFramebuffer framebuffer, const VkExtent2D& host_extent)
         : framebuffer(framebuffer), host_extent(host_extent) {}
@@ -168,10 +174,32 @@ class VulkanRenderTargetCache final : public RenderTargetCache {
                                    : msaa_2x_no_attachments_supported_;
   }
 
+  // Whether host render targets are drawn to with dynamic rendering instead of
+  // render pass and framebuffer objects - in this case, VK_NULL_HANDLE is used
+  // as the render pass of the host render targets, and pipelines are created
+  // with the formats from GetHostRenderTargetsPipelineRenderingInfo.
+  bool dynamic_rendering_used() const { return dynamic_rendering_used_; }
+
   // Returns the render pass object, or VK_NULL_HANDLE if failed to create.
   // A render pass managed by the render target cache may be ended and resumed
   // at any time (to allow for things like copying and texture loading).
   VkRenderPass GetHostRenderTargetsRenderPass(RenderPassKey key);
+  // For dynamic rendering, writes the attachment formats for the render pass
+  // key, with color_formats_out having space for kMaxColorRenderTargets
+  // elements, referenced by info_out.
+  void GetHostRenderTargetsPipelineRenderingInfo(
+      RenderPassKey key, VkPipelineRenderingCreateInfo& info_out,
+      VkFormat* color_formats_out) const;
+  // For dynamic rendering, writes the information for beginning rendering to
+  // the framebuffer, with attachments_out having space for
+  // 1 + kMaxColorRenderTargets elements, referenced by info_out. The stage and
+  // access masks are for the dependency on the previous rendering, which the
+  // external subpass dependencies provide with render pass objects.
+  static void GetFramebufferRenderingInfo(
+      const Framebuffer& framebuffer, VkRenderingInfo& info_out,
+      VkRenderingAttachmentInfo* attachments_out,
+      VkPipelineStageFlags& dependency_stage_mask_out,
+      VkAccessFlags& dependency_access_mask_out);
   VkRenderPass GetFragmentShaderInterlockRenderPass() const {
     assert_true(GetPath() == Path::kPixelShaderInterlock);
     return fsi_render_pass_;
@@ -835,6 +863,12 @@ class VulkanRenderTargetCache final : public RenderTargetCache {
     }
   };
 
+  // Returns the stages and accesses of the attachments in a render pass with
+  // the usage of depth and color from a RenderPassKey.
+  static void GetHostRenderTargetsDependencyMasks(
+      uint32_t depth_and_color_used, VkPipelineStageFlags& stage_mask_out,
+      VkAccessFlags& access_mask_out);
+
   // Returns the framebuffer object, or VK_NULL_HANDLE if failed to create.
   const Framebuffer* GetHostRenderTargetsFramebuffer(
       RenderPassKey render_pass_key, uint32_t pitch_tiles_at_32bpp,
@@ -872,6 +906,8 @@ class VulkanRenderTargetCache final : public RenderTargetCache {
   bool msaa_2x_attachments_supported_ = false;
   bool msaa_2x_no_attachments_supported_ = false;
 
+  bool dynamic_rendering_used_ = false;
+
   // VK_NULL_HANDLE if failed to create.
   std::unordered_map<RenderPassKey, VkRenderPass, RenderPassKey::Hasher>
       render_passes_;
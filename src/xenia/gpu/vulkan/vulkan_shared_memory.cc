@@ -18,6 +18,7 @@
 #include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
+#include "xenia/gpu/gpu_flags.h"
 #include "xenia/gpu/vulkan/deferred_command_buffer.h"
 #include "xenia/gpu/vulkan/vulkan_command_processor.h"
 #include "xenia/ui/vulkan/vulkan_util.h"
@@ -28,6 +29,14 @@ DEFINE_bool(vulkan_sparse_shared_memory, true,
             "allows graphics debuggers that don't support sparse binding to "
             "work.",
             "Vulkan");
+DEFINE_bool(
+    vulkan_shared_memory_host_import, false,
+    "Import the guest physical memory as the shared memory buffer with "
+    "VK_EXT_external_memory_host if possible, so CPU writes don't need to be "
+    "uploaded and GPU writes land directly in guest memory. Mostly beneficial "
+    "on integrated GPUs and with Resizable BAR, may be slow for GPU access on "
+    "discrete GPUs otherwise.",
+    "Vulkan");
 
 namespace xe {
 namespace gpu {
@@ -70,7 +79,14 @@ bool VulkanSharedMemory::Initialize() {
   buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
   buffer_create_info.queueFamilyIndexCount = 0;
   buffer_create_info.pQueueFamilyIndices = nullptr;
-  if (cvars::vulkan_sparse_shared_memory && device_info.sparseResidencyBuffer) {
+  host_memory_imported_ = false;
+  if (cvars::vulkan_shared_memory_host_import &&
+      device_info.ext_VK_EXT_external_memory_host) {
+    host_memory_imported_ = ImportHostMemory(buffer_create_info);
+  }
+  if (!host_memory_imported_ &&
+      (cvars::vulkan_sparse_shared_memory || cvars::low_memory_mode) &&
+      device_info.sparseResidencyBuffer) {
     if (dfn.vkCreateBuffer(device, &buffer_create_info, nullptr, &buffer_) ==
         VK_SUCCESS) {
       VkMemoryRequirements buffer_memory_requirements;
@@ -111,7 +127,8 @@ bool VulkanSharedMemory::Initialize() {
     }
   }
 
-  // Create a non-sparse buffer if there were issues with the sparse buffer.
+  // Create a non-sparse buffer if there were issues with the sparse buffer or
+  // the imported memory.
   if (buffer_ == VK_NULL_HANDLE) {
     XELOGGPU(
         "Vulkan sparse binding is not used for shared memory emulation - video "
@@ -182,6 +199,12 @@ bool VulkanSharedMemory::Initialize() {
   last_usage_ = Usage::kTransferDestination;
   last_written_range_ = std::make_pair<uint32_t, uint32_t>(0, 0);
 
+  if (host_memory_imported_) {
+    XELOGGPU(
+        "Shared memory: Guest physical memory is imported as the Vulkan "
+        "buffer, uploads are not needed");
+  }
+
   upload_buffer_pool_ = std::make_unique<ui::vulkan::VulkanUploadBufferPool>(
       provider, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
       xe::align(ui::vulkan::VulkanUploadBufferPool::kDefaultPageSize,
@@ -319,6 +342,7 @@ void VulkanSharedMemory::InitializeTraceCompleteDownloads() {
           download_range.first, download_range.second,
           reinterpret_cast<const uint8_t*>(download_mapping) +
               download_buffer_offset);
+      download_buffer_offset += download_range.second;
     }
     dfn.vkUnmapMemory(device, trace_download_buffer_memory_);
   } else {
@@ -381,6 +405,21 @@ bool VulkanSharedMemory::UploadRanges(
     return true;
   }
 
+  if (host_memory_imported_) {
+    // The buffer is the guest memory itself, and host writes done before the
+    // submission are made visible to the device by vkQueueSubmit - only need
+    // to mark the ranges as valid to start watching them again.
+    for (uint32_t i = 0; i < num_upload_ranges; ++i) {
+      uint32_t upload_range_start = upload_page_ranges[i].first
+                                    << page_size_log2();
+      uint32_t upload_range_length = upload_page_ranges[i].second
+                                     << page_size_log2();
+      trace_writer_.WriteMemoryRead(upload_range_start, upload_range_length);
+      MakeRangeValid(upload_range_start, upload_range_length, false, false);
+    }
+    return true;
+  }
+
   auto& range_front = upload_page_ranges[0];
   auto& range_back = upload_page_ranges[num_upload_ranges - 1];
 
@@ -454,6 +493,103 @@ bool VulkanSharedMemory::UploadRanges(
   return successful;
 }
 
+bool VulkanSharedMemory::ImportHostMemory(
+    const VkBufferCreateInfo& buffer_create_info) {
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+  const ui::vulkan::VulkanProvider::DeviceInfo& device_info =
+      provider.device_info();
+
+  void* host_pointer = memory().physical_membase();
+  VkDeviceSize alignment =
+      std::max(device_info.minImportedHostPointerAlignment, VkDeviceSize(1));
+  if ((reinterpret_cast<uintptr_t>(host_pointer) & (alignment - 1)) ||
+      (kBufferSize & (alignment - 1))) {
+    XELOGW(
+        "Shared memory: Guest physical memory doesn't satisfy the {} byte "
+        "Vulkan host pointer import alignment",
+        alignment);
+    return false;
+  }
+
+  // The guest memory is a shared memory mapping rather than a plain heap
+  // allocation, which some drivers only accept as foreign memory.
+  const VkExternalMemoryHandleTypeFlagBits handle_types[] = {
+      VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+      VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_MAPPED_FOREIGN_MEMORY_BIT_EXT,
+  };
+  for (VkExternalMemoryHandleTypeFlagBits handle_type : handle_types) {
+    VkMemoryHostPointerPropertiesEXT host_pointer_properties = {
+        VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT};
+    if (dfn.vkGetMemoryHostPointerPropertiesEXT(
+            device, handle_type, host_pointer, &host_pointer_properties) !=
+        VK_SUCCESS) {
+      continue;
+    }
+
+    VkExternalMemoryBufferCreateInfo external_memory_buffer_create_info = {
+        VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO};
+    external_memory_buffer_create_info.handleTypes = handle_type;
+    VkBufferCreateInfo import_buffer_create_info = buffer_create_info;
+    import_buffer_create_info.pNext = &external_memory_buffer_create_info;
+    import_buffer_create_info.flags = 0;
+    if (dfn.vkCreateBuffer(device, &import_buffer_create_info, nullptr,
+                           &buffer_) != VK_SUCCESS) {
+      continue;
+    }
+    VkMemoryRequirements buffer_memory_requirements;
+    dfn.vkGetBufferMemoryRequirements(device, buffer_,
+                                      &buffer_memory_requirements);
+    uint32_t memory_types = buffer_memory_requirements.memoryTypeBits &
+                            host_pointer_properties.memoryTypeBits;
+    // Prefer device-local memory types (with Resizable BAR or on UMA devices),
+    // then cached ones for faster CPU access.
+    if (!xe::bit_scan_forward(
+            memory_types & device_info.memory_types_device_local,
+            &buffer_memory_type_) &&
+        !xe::bit_scan_forward(
+            memory_types & device_info.memory_types_host_cached,
+            &buffer_memory_type_) &&
+        !xe::bit_scan_forward(memory_types, &buffer_memory_type_)) {
+      dfn.vkDestroyBuffer(device, buffer_, nullptr);
+      buffer_ = VK_NULL_HANDLE;
+      continue;
+    }
+    VkImportMemoryHostPointerInfoEXT import_memory_host_pointer_info = {
+        VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT};
+    import_memory_host_pointer_info.handleType = handle_type;
+    import_memory_host_pointer_info.pHostPointer = host_pointer;
+    VkMemoryAllocateInfo buffer_memory_allocate_info = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    buffer_memory_allocate_info.pNext = &import_memory_host_pointer_info;
+    buffer_memory_allocate_info.allocationSize = kBufferSize;
+    buffer_memory_allocate_info.memoryTypeIndex = buffer_memory_type_;
+    VkDeviceMemory buffer_memory;
+    if (dfn.vkAllocateMemory(device, &buffer_memory_allocate_info, nullptr,
+                             &buffer_memory) != VK_SUCCESS) {
+      dfn.vkDestroyBuffer(device, buffer_, nullptr);
+      buffer_ = VK_NULL_HANDLE;
+      continue;
+    }
+    if (dfn.vkBindBufferMemory(device, buffer_, buffer_memory, 0) !=
+        VK_SUCCESS) {
+      dfn.vkFreeMemory(device, buffer_memory, nullptr);
+      dfn.vkDestroyBuffer(device, buffer_, nullptr);
+      buffer_ = VK_NULL_HANDLE;
+      continue;
+    }
+    buffer_memory_.push_back(buffer_memory);
+    return true;
+  }
+
+  XELOGW(
+      "Shared memory: Failed to import the guest physical memory as the "
+      "Vulkan buffer, uploading to a separate buffer instead");
+  return false;
+}
+
 void VulkanSharedMemory::GetUsageMasks(Usage usage,
                                        VkPipelineStageFlags& stage_mask,
                                        VkAccessFlags& access_mask) const {
@@ -40,6 +40,13 @@ class VulkanSharedMemory : public SharedMemory {
   void CompletedSubmissionUpdated();
   void EndSubmission();
 
+  uint64_t GetHostGpuMemoryUsage() const override {
+    return host_memory_imported_ ? 0 : SharedMemory::GetHostGpuMemoryUsage();
+  }
+  size_t upload_buffer_pool_size() const {
+    return upload_buffer_pool_->page_size();
+  }
+
   enum class Usage {
     // Index buffer, vfetch, compute read, transfer source.
     kRead,
@@ -66,6 +73,10 @@ class VulkanSharedMemory : public SharedMemory {
                     uint32_t num_ranges) override;
 
  private:
+  // Tries to create buffer_ with the guest physical memory imported as its
+  // storage, returns false and leaves buffer_ null if not possible.
+  bool ImportHostMemory(const VkBufferCreateInfo& buffer_create_info);
+
   void GetUsageMasks(Usage usage, VkPipelineStageFlags& stage_mask,
                      VkAccessFlags& access_mask) const;
 
@@ -77,6 +88,9 @@ class VulkanSharedMemory : public SharedMemory {
   uint32_t buffer_memory_type_;
   // Single for non-sparse, every allocation so far for sparse.
   std::vector<VkDeviceMemory> buffer_memory_;
+  // Whether buffer_ is backed by the guest physical memory itself, so CPU
+  // writes don't need to be uploaded.
+  bool host_memory_imported_ = false;
 
   Usage last_usage_;
   std::pair<uint32_t, uint32_t> last_written_range_;
@@ -480,6 +480,14 @@ VulkanTextureCache::~VulkanTextureCache() {
   }
 }
 
+void VulkanTextureCache::BeginFrame() {
+  TextureCache::BeginFrame();
+
+  COUNT_profile_set("gpu/texture_cache/vulkan/decompressed_loads_kb",
+                    decompressed_load_bytes_ >> 10);
+  decompressed_load_bytes_ = 0;
+}
+
 void VulkanTextureCache::BeginSubmission(uint64_t new_submission_index) {
   TextureCache::BeginSubmission(new_submission_index);
 
@@ -680,6 +688,10 @@ VulkanTextureCache::SamplerParameters VulkanTextureCache::GetSamplerParameters(
   texture_util::GetSubresourcesFromFetchConstant(fetch, nullptr, nullptr,
                                                  nullptr, nullptr, nullptr,
                                                  &mip_min_level, nullptr);
+  if (IsActiveTextureBaseDeferred(binding.fetch_constant)) {
+    // Only the mips have been loaded so far.
+    mip_min_level = std::max(mip_min_level, uint32_t(1));
+  }
   parameters.mip_min_level = mip_min_level;
 
   return parameters;
@@ -1041,8 +1053,10 @@ std::unique_ptr<TextureCache::Texture> VulkanTextureCache::CreateTexture(
   image_create_info.arrayLayers = is_3d ? 1 : depth_or_array_size;
   image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
   image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
-  image_create_info.usage =
-      VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  // Transfer source for copying to textures with the same content.
+  image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                            VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                            VK_IMAGE_USAGE_SAMPLED_BIT;
   image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
   image_create_info.queueFamilyIndexCount = 0;
   image_create_info.pQueueFamilyIndices = nullptr;
@@ -1074,6 +1088,77 @@ std::unique_ptr<TextureCache::Texture> VulkanTextureCache::CreateTexture(
       new VulkanTexture(*this, key, image, allocation));
 }
 
+bool VulkanTextureCache::QueryHostMemoryBudget(uint64_t& usage_out,
+                                               uint64_t& budget_out) const {
+  return command_processor_.GetVulkanProvider().QueryVideoMemoryBudget(
+      usage_out, budget_out);
+}
+
+bool VulkanTextureCache::CopyTextureDataImpl(Texture& texture,
+                                             Texture& source) {
+  VulkanTexture& vulkan_texture = static_cast<VulkanTexture&>(texture);
+  VulkanTexture& vulkan_source = static_cast<VulkanTexture&>(source);
+  // Update LRU caching because the textures will be used by the command
+  // buffer.
+  vulkan_texture.MarkAsUsed();
+  vulkan_source.MarkAsUsed();
+  std::pair<VulkanTexture*, VulkanTexture::Usage> transitions[] = {
+      {&vulkan_texture, VulkanTexture::Usage::kTransferDestination},
+      {&vulkan_source, VulkanTexture::Usage::kTransferSource},
+  };
+  for (const std::pair<VulkanTexture*, VulkanTexture::Usage>& transition :
+       transitions) {
+    VulkanTexture::Usage old_usage =
+        transition.first->SetUsage(transition.second);
+    if (old_usage == transition.second) {
+      continue;
+    }
+    VkPipelineStageFlags src_stage_mask, dst_stage_mask;
+    VkAccessFlags src_access_mask, dst_access_mask;
+    VkImageLayout old_layout, new_layout;
+    GetTextureUsageMasks(old_usage, src_stage_mask, src_access_mask,
+                         old_layout);
+    GetTextureUsageMasks(transition.second, dst_stage_mask, dst_access_mask,
+                         new_layout);
+    command_processor_.PushImageMemoryBarrier(
+        transition.first->image(),
+        ui::vulkan::util::InitializeSubresourceRange(), src_stage_mask,
+        dst_stage_mask, src_access_mask, dst_access_mask, old_layout,
+        new_layout);
+  }
+  command_processor_.SubmitBarriers(true);
+
+  // Not resolution-scaled, and the keys are the same other than the addresses.
+  const TextureKey& texture_key = texture.key();
+  uint32_t width = texture_key.GetWidth();
+  uint32_t height = texture_key.GetHeight();
+  bool is_3d = texture_key.dimension == xenos::DataDimension::k3D;
+  uint32_t depth = is_3d ? texture_key.GetDepthOrArraySize() : 1;
+  uint32_t level_count = texture_key.mip_max_level + 1;
+  VkImageCopy* copy_regions =
+      command_processor_.deferred_command_buffer().CmdCopyImageEmplace(
+          vulkan_source.image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          vulkan_texture.image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          level_count);
+  for (uint32_t level = 0; level < level_count; ++level) {
+    VkImageCopy& copy_region = copy_regions[level];
+    copy_region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy_region.srcSubresource.mipLevel = level;
+    copy_region.srcSubresource.baseArrayLayer = 0;
+    copy_region.srcSubresource.layerCount =
+        is_3d ? 1 : texture_key.GetDepthOrArraySize();
+    copy_region.srcOffset.x = 0;
+    copy_region.srcOffset.y = 0;
+    copy_region.srcOffset.z = 0;
+    copy_region.dstSubresource = copy_region.srcSubresource;
+    copy_region.dstOffset = copy_region.srcOffset;
+    copy_region.extent.width = std::max(width >> level, UINT32_C(1));
+    copy_region.extent.height = std::max(height >> level, UINT32_C(1));
+    copy_region.extent.depth = std::max(depth >> level, UINT32_C(1));
+  }
+  return true;
+}
+
 bool VulkanTextureCache::LoadTextureDataFromResidentMemoryImpl(Texture& texture,
                                                                bool load_base,
                                                                bool load_mips) {
@@ -1212,6 +1297,10 @@ bool VulkanTextureCache::LoadTextureDataFromResidentMemoryImpl(Texture& texture,
         level_guest_z_extent_texels;
     host_buffer_size += level_host_layout.slice_size_bytes * array_size;
   }
+  if (!host_format.block_compressed &&
+      guest_format_info->type == FormatType::kCompressed) {
+    decompressed_load_bytes_ += host_buffer_size;
+  }
   VulkanCommandProcessor::ScratchBufferAcquisition scratch_buffer_acquisition(
       command_processor_.AcquireScratchGpuBuffer(
           host_buffer_size, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
@@ -2086,6 +2175,38 @@ bool VulkanTextureCache::Initialize() {
     }
   }
 
+  // Report how each guest block-compressed format is stored on the host, since
+  // decompression multiplies the memory usage and the bandwidth.
+  for (size_t i = 0; i < xe::countof(host_formats_); ++i) {
+    const FormatInfo* guest_format_info =
+        FormatInfo::Get(xenos::TextureFormat(i));
+    if (guest_format_info->type != FormatType::kCompressed ||
+        kBestHostFormats[i].format_unsigned.format == VK_FORMAT_UNDEFINED) {
+      continue;
+    }
+    const HostFormat& host_format = host_formats_[i].format_unsigned;
+    if (host_format.format == VK_FORMAT_UNDEFINED) {
+      continue;
+    }
+    const LoadShaderInfo& load_shader_info =
+        GetLoadShaderInfo(host_format.load_shader);
+    if (host_format.block_compressed) {
+      XELOGI("VulkanTextureCache: Format {} is stored as compressed ({})",
+             FormatInfo::GetName(xenos::TextureFormat(i)),
+             uint32_t(host_format.format));
+    } else {
+      XELOGI(
+          "VulkanTextureCache: Format {} is decompressed to the Vulkan format "
+          "{} ({} bytes per guest {}x{} block instead of {})",
+          FormatInfo::GetName(xenos::TextureFormat(i)),
+          uint32_t(host_format.format),
+          load_shader_info.bytes_per_host_block *
+              guest_format_info->block_width * guest_format_info->block_height,
+          guest_format_info->block_width, guest_format_info->block_height,
+          guest_format_info->bytes_per_block());
+    }
+  }
+
   // Load pipeline layout.
 
   VkDescriptorSetLayout load_descriptor_set_layouts[kLoadDescriptorSetCount] =
@@ -2610,6 +2731,11 @@ void VulkanTextureCache::GetTextureUsageMasks(VulkanTexture::Usage usage,
   switch (usage) {
     case VulkanTexture::Usage::kUndefined:
       break;
+    case VulkanTexture::Usage::kTransferSource:
+      stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+      access_mask = VK_ACCESS_TRANSFER_READ_BIT;
+      layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+      break;
     case VulkanTexture::Usage::kTransferDestination:
       stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT;
       access_mask = VK_ACCESS_TRANSFER_WRITE_BIT;
@@ -83,6 +83,7 @@ class VulkanTextureCache final : public TextureCache {
   ~VulkanTextureCache();
 
   void BeginSubmission(uint64_t new_submission_index) override;
+  void BeginFrame() override;
 
   // Must be called within a frame - creates and untiles textures needed by
   // shaders, and enqueues transitioning them into the sampled usage. This may
@@ -133,6 +134,11 @@ class VulkanTextureCache final : public TextureCache {
 
   std::unique_ptr<Texture> CreateTexture(TextureKey key) override;
 
+  bool QueryHostMemoryBudget(uint64_t& usage_out,
+                             uint64_t& budget_out) const override;
+
+  bool CopyTextureDataImpl(Texture& texture, Texture& source) override;
+
   bool LoadTextureDataFromResidentMemoryImpl(Texture& texture, bool load_base,
                                              bool load_mips) override;
 
@@ -178,6 +184,7 @@ class VulkanTextureCache final : public TextureCache {
    public:
     enum class Usage {
       kUndefined,
+      kTransferSource,
       kTransferDestination,
       kGuestShaderSampled,
       kSwapSampled,
@@ -328,6 +335,9 @@ class VulkanTextureCache final : public TextureCache {
   static const HostFormatPair kHostFormatGBGRUnaligned;
   static const HostFormatPair kHostFormatBGRGUnaligned;
   HostFormatPair host_formats_[64];
+  // Host bytes written by load shaders decompressing guest block-compressed
+  // formats since the beginning of the frame.
+  uint64_t decompressed_load_bytes_ = 0;
 
   VkPipelineLayout load_pipeline_layout_ = VK_NULL_HANDLE;
   std::array<VkPipeline, kLoadShaderCount> load_pipelines_{};
@@ -11,7 +11,12 @@
 
 #include "xenia/hid/input_system.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include "xenia/base/clock.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/startup_timeline.h"
 #include "xenia/hid/hid_flags.h"
 #include "xenia/hid/input_driver.h"
 #include "xenia/kernel/util/shim_utils.h"
@@ -28,11 +33,79 @@ DEFINE_double(
     right_stick_deadzone_percentage, 0.0,
     "Defines deadzone level for right stick. Allowed range [0.0-1.0].", "HID");
 
+DEFINE_uint32(input_poll_rate, 0,
+              "Rate in Hz at which the controllers are polled on a dedicated "
+              "thread, with the games reading the latest state without "
+              "waiting for the drivers (such as 1000). 0 to poll them when "
+              "the game requests the state.",
+              "HID");
+
 InputSystem::InputSystem(xe::ui::Window* window) : window_(window) {}
 
-InputSystem::~InputSystem() = default;
+InputSystem::~InputSystem() {
+  if (!poll_thread_) {
+    return;
+  }
+  poll_thread_shutdown_.store(true, std::memory_order_relaxed);
+  xe::threading::Wait(poll_thread_.get(), false);
+  poll_thread_.reset();
+  uint64_t read_count = snapshot_read_count_.load(std::memory_order_relaxed);
+  if (read_count) {
+    double ticks_to_us =
+        1000000.0 / static_cast<double>(Clock::QueryHostTickFrequency());
+    XELOGI(
+        "Input: {} states read, poll-to-guest latency {:.1f} us on average, "
+        "{:.1f} us at most",
+        read_count,
+        snapshot_latency_ticks_sum_.load(std::memory_order_relaxed) *
+            ticks_to_us / read_count,
+        snapshot_latency_ticks_max_.load(std::memory_order_relaxed) *
+            ticks_to_us);
+  }
+}
 
-X_STATUS InputSystem::Setup() { return X_STATUS_SUCCESS; }
+X_STATUS InputSystem::Setup() {
+  StartupTimelinePhase startup_phase("InputSystem::Setup");
+  if (cvars::input_poll_rate) {
+    for (SeqLockValue<StateSnapshot>& snapshot : state_snapshots_) {
+      StateSnapshot empty_snapshot = {};
+      empty_snapshot.result = X_ERROR_DEVICE_NOT_CONNECTED;
+      snapshot.Store(empty_snapshot);
+    }
+    xe::threading::Thread::CreationParameters thread_parameters;
+    thread_parameters.stack_size = 256 * 1024;
+    thread_parameters.initial_priority =
+        xe::threading::ThreadPriority::kAboveNormal;
+    poll_thread_ = xe::threading::Thread::Create(thread_parameters,
+                                                 [this]() { PollThread(); });
+    if (!poll_thread_) {
+      XELOGE("Input: Failed to create the input polling thread");
+      return X_STATUS_UNSUCCESSFUL;
+    }
+    poll_thread_->set_name("Input Polling");
+  }
+  return X_STATUS_SUCCESS;
+}
+
+void InputSystem::PollThread() {
+  const auto period = std::chrono::microseconds(
+      1000000 / std::min(cvars::input_poll_rate, uint32_t(1000000)));
+  while (!poll_thread_shutdown_.load(std::memory_order_relaxed)) {
+    {
+      auto global_lock = lock();
+      for (uint32_t user_index = 0; user_index < XUserMaxUserCount;
+           ++user_index) {
+        X_INPUT_STATE state = {};
+        StateSnapshot snapshot;
+        snapshot.result = PollState(user_index, &state);
+        std::memcpy(snapshot.state, &state, sizeof(state));
+        snapshot.poll_host_ticks = Clock::QueryHostTickCount();
+        state_snapshots_[user_index].Store(snapshot);
+      }
+    }
+    xe::threading::Sleep(period);
+  }
+}
 
 void InputSystem::AddDriver(std::unique_ptr<InputDriver> driver) {
   drivers_.push_back(std::move(driver));
@@ -91,6 +164,29 @@ X_RESULT InputSystem::GetCapabilities(uint32_t user_index, uint32_t flags,
 X_RESULT InputSystem::GetState(uint32_t user_index, X_INPUT_STATE* out_state) {
   SCOPE_profile_cpu_f("hid");
 
+  if (poll_thread_ && user_index < XUserMaxUserCount) {
+    StateSnapshot snapshot = state_snapshots_[user_index].Load();
+    if (snapshot.result == X_ERROR_SUCCESS) {
+      std::memcpy(out_state, snapshot.state, sizeof(snapshot.state));
+    }
+    uint64_t latency_ticks =
+        Clock::QueryHostTickCount() - snapshot.poll_host_ticks;
+    snapshot_read_count_.fetch_add(1, std::memory_order_relaxed);
+    snapshot_latency_ticks_sum_.fetch_add(latency_ticks,
+                                          std::memory_order_relaxed);
+    uint64_t latency_ticks_max =
+        snapshot_latency_ticks_max_.load(std::memory_order_relaxed);
+    while (latency_ticks > latency_ticks_max &&
+           !snapshot_latency_ticks_max_.compare_exchange_weak(
+               latency_ticks_max, latency_ticks, std::memory_order_relaxed)) {
+    }
+    return snapshot.result;
+  }
+  return PollState(user_index, out_state);
+}
+
+X_RESULT InputSystem::PollState(uint32_t user_index,
+                                X_INPUT_STATE* out_state) {
   bool any_connected = false;
   for (auto& driver : drivers_) {
     X_RESULT result = driver->GetState(user_index, out_state);
@@ -10,10 +10,14 @@
 #ifndef XENIA_HID_INPUT_SYSTEM_H_
 #define XENIA_HID_INPUT_SYSTEM_H_
 
+#include <array>
+#include <atomic>
 #include <bitset>
 #include <memory>
 #include <vector>
 #include "xenia/base/mutex.h"
+#include "xenia/base/seqlock.h"
+#include "xenia/base/threading.h"
 #include "xenia/hid/input.h"
 #include "xenia/hid/input_driver.h"
 #include "xenia/xbox.h"
@@ -34,12 +38,16 @@ class InputSystem {
 
   xe::ui::Window* window() const { return window_; }
 
+  // Starts the input polling thread if input_poll_rate is not 0, after the
+  // drivers have been added.
   X_STATUS Setup();
 
   void AddDriver(std::unique_ptr<InputDriver> driver);
 
   X_RESULT GetCapabilities(uint32_t user_index, uint32_t flags,
                            X_INPUT_CAPABILITIES* out_caps);
+  // Returns the latest snapshot of the input polling thread, if it's active,
+  // which doesn't need the lock, or polls the drivers otherwise.
   X_RESULT GetState(uint32_t user_index, X_INPUT_STATE* out_state);
   X_RESULT SetState(uint32_t user_index, X_INPUT_VIBRATION* vibration);
   X_RESULT GetKeystroke(uint32_t user_index, uint32_t flags,
@@ -55,6 +63,8 @@ class InputSystem {
 
   uint32_t GetLastUsedSlot() const { return last_used_slot; }
 
+  bool is_polling_thread_active() const { return poll_thread_ != nullptr; }
+
   std::unique_lock<xe_unlikely_mutex> lock();
 
  private:
@@ -64,6 +74,18 @@ class InputSystem {
       "Controller disconnected from slot {}.",
       "New controller connected to slot {}."};
 
+  struct StateSnapshot {
+    X_RESULT result;
+    // X_INPUT_STATE, with big-endian fields that aren't trivially copyable.
+    uint8_t state[sizeof(X_INPUT_STATE)];
+    // When the drivers were polled, for measuring the latency.
+    uint64_t poll_host_ticks;
+  };
+
+  // With the lock held.
+  X_RESULT PollState(uint32_t user_index, X_INPUT_STATE* out_state);
+  void PollThread();
+
   void UpdateUsedSlot(InputDriver* driver, uint8_t slot, bool connected);
   void AdjustDeadzoneLevels(const uint8_t slot, X_INPUT_GAMEPAD* gamepad);
   X_INPUT_VIBRATION ModifyVibrationLevel(X_INPUT_VIBRATION* vibration);
@@ -78,6 +100,14 @@ class InputSystem {
   uint32_t last_used_slot = 0;
 
   xe_unlikely_mutex lock_;
+
+  std::array<SeqLockValue<StateSnapshot>, XUserMaxUserCount> state_snapshots_;
+  std::unique_ptr<xe::threading::Thread> poll_thread_;
+  std::atomic<bool> poll_thread_shutdown_{false};
+  // Poll-to-guest latency of the snapshots returned by GetState.
+  std::atomic<uint64_t> snapshot_read_count_{0};
+  std::atomic<uint64_t> snapshot_latency_ticks_sum_{0};
+  std::atomic<uint64_t> snapshot_latency_ticks_max_{0};
 };
 
 }  // namespace hid
@@ -14,3 +14,9 @@ DEFINE_bool(headless, false,
             "UI");
 DEFINE_bool(log_high_frequency_kernel_calls, false,
             "Log kernel calls with the kHighFrequency tag.", "Kernel");
+DEFINE_bool(profile_kernel_exports, false,
+            "Count the calls of every kernel export and their duration, to be "
+            "viewed from the CPU menu or dumped to kernel_export_profile_path.",
+            "Kernel");
+DEFINE_path(kernel_export_profile_path, "kernel_export_profile.csv",
+            "File the kernel export profile is dumped to as CSV.", "Kernel");
@@ -9,12 +9,17 @@
 
 #include "xenia/kernel/kernel_state.h"
 
+#include <algorithm>
 #include <string>
+#include <utility>
 
 #include "third_party/fmt/include/fmt/format.h"
 #include "xenia/base/assert.h"
 #include "xenia/base/byte_stream.h"
+#include "xenia/base/clock.h"
 #include "xenia/base/logging.h"
+#include "xenia/base/profiling.h"
+#include "xenia/base/startup_timeline.h"
 #include "xenia/base/string.h"
 #include "xenia/cpu/processor.h"
 #include "xenia/emulator.h"
@@ -40,6 +45,19 @@ DEFINE_bool(apply_title_update, true, "Apply title updates.", "Kernel");
 DEFINE_uint32(kernel_build_version, 1888, "Define current kernel version",
               "Kernel");
 
+DEFINE_uint32(async_file_io_threads, 0,
+              "Number of threads performing overlapped guest file reads, so "
+              "the guest threads requesting them don't wait for the reads to "
+              "complete. 0 to perform all reads on the requesting thread.",
+              "Kernel");
+
+DEFINE_uint32(guest_stack_pool_size_mb, 16,
+              "Megabytes of guest stacks of destroyed threads kept allocated "
+              "to be reused by new threads, for faster creation of threads in "
+              "titles that create many short-lived ones. 0 to release the "
+              "stacks immediately.",
+              "Kernel");
+
 DECLARE_string(cl);
 
 namespace xe {
@@ -47,6 +65,9 @@ namespace kernel {
 
 constexpr uint32_t kDeferredOverlappedDelayMillis = 100;
 
+// The host APCs are followed by the host tick count when they were queued.
+constexpr uint32_t kHostApcSize = XAPC::kSize + sizeof(uint64_t);
+
 // This is a global object initialized with the XboxkrnlModule.
 // It references the current kernel state object that all kernel methods should
 // be using to stash their variables.
@@ -58,7 +79,6 @@ KernelState::KernelState(Emulator* emulator)
     : emulator_(emulator),
       memory_(emulator->memory()),
       dispatch_thread_running_(false),
-      dpc_list_(emulator->memory()),
       kernel_trampoline_group_(emulator->processor()->backend()) {
   assert_null(shared_kernel_state_);
   shared_kernel_state_ = this;
@@ -90,6 +110,33 @@ KernelState::~KernelState() {
     dispatch_thread_->Wait(0, 0, 0, nullptr);
   }
 
+  if (file_io_threads_running_) {
+    {
+      std::lock_guard<std::mutex> file_io_lock(file_io_lock_);
+      file_io_threads_running_ = false;
+    }
+    file_io_cond_.notify_all();
+    for (auto& file_io_thread : file_io_threads_) {
+      file_io_thread->Wait(0, 0, 0, nullptr);
+    }
+    file_io_threads_.clear();
+    file_io_queue_.clear();
+  }
+
+  dpc_threads_running_ = false;
+  for (DpcQueue& dpc_queue : dpc_queues_) {
+    object_ref<XHostThread> dpc_thread;
+    {
+      std::lock_guard<std::mutex> dpc_lock(dpc_queue.lock);
+      dpc_thread = std::move(dpc_queue.thread);
+      dpc_queue.dpcs.clear();
+    }
+    dpc_queue.cond.notify_all();
+    if (dpc_thread) {
+      dpc_thread->Wait(0, 0, 0, nullptr);
+    }
+  }
+
   executable_module_.reset();
   user_modules_.clear();
   kernel_modules_.clear();
@@ -281,6 +328,7 @@ object_ref<XModule> KernelState::GetModule(const std::string_view name,
 }
 
 object_ref<XThread> KernelState::LaunchModule(object_ref<UserModule> module) {
+  StartupTimelinePhase startup_phase("KernelState::LaunchModule");
   if (!module->is_executable()) {
     return nullptr;
   }
@@ -345,6 +393,14 @@ void KernelState::SetExecutableModule(object_ref<UserModule> module) {
     SetProcessTLSVars(title_process, tls_header->slot_count,
                       tls_header->data_size, tls_header->raw_data_address);
   }
+  // The same layout as the TLS blocks allocated by XThread::Create.
+  if (tls_header && tls_header->slot_count) {
+    processor()->frontend()->SetGuestTlsLayout(tls_header->data_size,
+                                               tls_header->slot_count);
+  } else {
+    processor()->frontend()->SetGuestTlsLayout(0,
+                                               XThread::kDefaultTlsSlotCount);
+  }
 
   uint32_t kernel_stacksize = 0;
 
@@ -431,6 +487,197 @@ void KernelState::SetExecutableModule(object_ref<UserModule> module) {
     dispatch_thread_->set_name("Kernel Dispatch");
     dispatch_thread_->Create();
   }
+
+  if (!file_io_threads_running_ && cvars::async_file_io_threads) {
+    file_io_threads_running_ = true;
+    for (uint32_t i = 0; i < std::min(cvars::async_file_io_threads, 16u);
+         ++i) {
+      auto file_io_thread = object_ref<XHostThread>(new XHostThread(
+          this, 128 * 1024, 0,
+          [this]() {
+            std::unique_lock<std::mutex> file_io_lock(file_io_lock_);
+            while (true) {
+              file_io_cond_.wait(file_io_lock, [this]() {
+                return !file_io_threads_running_ || !file_io_queue_.empty();
+              });
+              if (!file_io_threads_running_) {
+                break;
+              }
+              auto fn = std::move(file_io_queue_.front());
+              file_io_queue_.pop_front();
+              file_io_lock.unlock();
+
+              fn();
+
+              file_io_lock.lock();
+            }
+            return 0;
+          },
+          GetSystemProcess()));
+      file_io_thread->set_name(fmt::format("Kernel File I/O {}", i));
+      file_io_thread->Create();
+      file_io_threads_.push_back(std::move(file_io_thread));
+    }
+  }
+}
+
+bool KernelState::QueueFileIO(std::function<void()> fn) {
+  if (!file_io_threads_running_) {
+    return false;
+  }
+  size_t queue_depth;
+  {
+    std::lock_guard<std::mutex> file_io_lock(file_io_lock_);
+    file_io_queue_.push_back(std::move(fn));
+    queue_depth = file_io_queue_.size();
+  }
+  file_io_cond_.notify_one();
+  COUNT_profile_set("kernel/file_io/queue_depth", queue_depth);
+  return true;
+}
+
+bool KernelState::InsertQueueDpc(uint32_t dpc_ptr, uint32_t arg1,
+                                 uint32_t arg2, uint32_t cpu) {
+  if (!dpc_threads_running_) {
+    return false;
+  }
+  cpu = std::min(cpu, kDpcCpuCount - 1);
+  auto dpc = memory()->TranslateVirtual<XDPC*>(dpc_ptr);
+  DpcQueue& dpc_queue = dpc_queues_[cpu];
+  size_t queue_depth;
+  {
+    std::lock_guard<std::mutex> dpc_lock(dpc_queue.lock);
+    // The list entry links to itself while the DPC is queued.
+    if (dpc->list_entry.flink_ptr) {
+      return false;
+    }
+    dpc->list_entry.flink_ptr = dpc_ptr + offsetof(XDPC, list_entry);
+    dpc->selected_cpu_number = uint8_t(cpu);
+    dpc->arg1 = arg1;
+    dpc->arg2 = arg2;
+    dpc_queue.dpcs.push_back({dpc_ptr, Clock::QueryHostTickCount()});
+    queue_depth = dpc_queue.dpcs.size();
+    if (!dpc_queue.thread) {
+      dpc_queue.thread = object_ref<XHostThread>(new XHostThread(
+          this, 128 * 1024, 0,
+          [this, cpu]() {
+            XThread* current_thread = XThread::GetCurrentThread();
+            current_thread->SetActiveCpu(uint8_t(cpu));
+            auto context = current_thread->thread_state()->context();
+            DpcQueue& queue = dpc_queues_[cpu];
+            std::unique_lock<std::mutex> lock(queue.lock);
+            while (true) {
+              queue.cond.wait(lock, [this, &queue]() {
+                return !dpc_threads_running_ || !queue.dpcs.empty();
+              });
+              if (!dpc_threads_running_) {
+                break;
+              }
+              QueuedDpc queued_dpc = queue.dpcs.front();
+              queue.dpcs.pop_front();
+              // May be queued again by its own routine.
+              auto queued = memory()->TranslateVirtual<XDPC*>(
+                  queued_dpc.dpc_ptr);
+              queued->list_entry.flink_ptr = 0;
+              uint64_t args[] = {queued_dpc.dpc_ptr, queued->context,
+                                 queued->arg1, queued->arg2};
+              uint32_t routine = queued->routine;
+              lock.unlock();
+
+              COUNT_profile_set(
+                  "kernel/dpc/delivery_latency_us",
+                  (Clock::QueryHostTickCount() - queued_dpc.queue_host_ticks) *
+                      1000000 / Clock::QueryHostTickFrequency());
+              DPCImpersonationScope dpc_scope{};
+              BeginDPCImpersonation(context, dpc_scope);
+              processor_->Execute(current_thread->thread_state(), routine,
+                                  args, xe::countof(args));
+              EndDPCImpersonation(context, dpc_scope);
+
+              lock.lock();
+            }
+            return 0;
+          },
+          GetSystemProcess()));
+      // As we run guest callbacks the debugger must be able to suspend us.
+      dpc_queue.thread->set_can_debugger_suspend(true);
+      dpc_queue.thread->set_name(fmt::format("Kernel DPC {}", cpu));
+      dpc_queue.thread->Create();
+    }
+  }
+  dpc_queue.cond.notify_one();
+  COUNT_profile_set("kernel/dpc/queue_depth", queue_depth);
+  return true;
+}
+
+bool KernelState::RemoveQueueDpc(uint32_t dpc_ptr) {
+  auto dpc = memory()->TranslateVirtual<XDPC*>(dpc_ptr);
+  DpcQueue& dpc_queue =
+      dpc_queues_[std::min(uint32_t(dpc->selected_cpu_number),
+                           kDpcCpuCount - 1)];
+  std::lock_guard<std::mutex> dpc_lock(dpc_queue.lock);
+  if (!dpc->list_entry.flink_ptr) {
+    return false;
+  }
+  auto it = std::find_if(
+      dpc_queue.dpcs.begin(), dpc_queue.dpcs.end(),
+      [dpc_ptr](const QueuedDpc& queued) { return queued.dpc_ptr == dpc_ptr; });
+  if (it == dpc_queue.dpcs.end()) {
+    return false;
+  }
+  dpc_queue.dpcs.erase(it);
+  dpc->list_entry.flink_ptr = 0;
+  return true;
+}
+
+uint32_t KernelState::AllocateHostApc() {
+  uint64_t head = free_host_apcs_.load(std::memory_order_acquire);
+  uint32_t apc_ptr;
+  while (true) {
+    apc_ptr = uint32_t(head);
+    if (!apc_ptr) {
+      apc_ptr = memory()->SystemHeapAlloc(kHostApcSize);
+      if (!apc_ptr) {
+        return 0;
+      }
+      break;
+    }
+    // Unused APCs are never returned to the heap, so this is readable even if
+    // another thread takes it first, and the counter then fails the exchange.
+    uint32_t next_apc_ptr =
+        memory()->TranslateVirtual<XAPC*>(apc_ptr)->list_entry.flink_ptr;
+    uint64_t new_head = (((head >> 32) + 1) << 32) | next_apc_ptr;
+    if (free_host_apcs_.compare_exchange_weak(head, new_head,
+                                              std::memory_order_acquire)) {
+      break;
+    }
+  }
+  xe::store(memory()->TranslateVirtual(apc_ptr + XAPC::kSize),
+            Clock::QueryHostTickCount());
+  COUNT_profile_set("kernel/apc/host_queued",
+                    queued_host_apc_count_.fetch_add(1) + 1);
+  return apc_ptr;
+}
+
+void KernelState::FreeHostApc(uint32_t apc_ptr, bool delivered) {
+  if (delivered) {
+    uint64_t queue_host_ticks =
+        xe::load<uint64_t>(memory()->TranslateVirtual(apc_ptr + XAPC::kSize));
+    COUNT_profile_set("kernel/apc/delivery_latency_us",
+                      (Clock::QueryHostTickCount() - queue_host_ticks) *
+                          1000000 / Clock::QueryHostTickFrequency());
+  }
+  COUNT_profile_set("kernel/apc/host_queued",
+                    queued_host_apc_count_.fetch_sub(1) - 1);
+  auto apc = memory()->TranslateVirtual<XAPC*>(apc_ptr);
+  uint64_t head = free_host_apcs_.load(std::memory_order_relaxed);
+  uint64_t new_head;
+  do {
+    apc->list_entry.flink_ptr = uint32_t(head);
+    new_head = (((head >> 32) + 1) << 32) | apc_ptr;
+  } while (!free_host_apcs_.compare_exchange_weak(head, new_head,
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed));
 }
 
 void KernelState::LoadKernelModule(object_ref<KernelModule> kernel_module) {
@@ -513,14 +760,15 @@ object_ref<UserModule> KernelState::LoadUserModuleFromMemory(
 
 X_RESULT KernelState::FinishLoadingUserModule(
     const object_ref<UserModule> module, bool call_entry) {
+  StartupTimelinePhase startup_phase("KernelState::FinishLoadingUserModule");
   // TODO(Gliniak): Apply custom patches here
   X_RESULT result = module->LoadContinue();
   if (XFAILED(result)) {
     return result;
   }
   module->Dump();
-  emulator_->patcher()->ApplyPatchesForTitle(memory_, module->title_id(),
-                                             module->hash());
+  emulator_->patcher()->ApplyPatchesForTitle(
+      memory_, processor(), module->title_id(), module->hash());
   emulator_->on_patch_apply();
   if (module->xex_module()) {
     module->xex_module()->Precompile();
@@ -856,6 +1104,46 @@ object_ref<XThread> KernelState::GetThreadByID(uint32_t thread_id) {
   return retain_object(thread);
 }
 
+uint32_t KernelState::AcquirePooledGuestStack(uint32_t alloc_size) {
+  std::lock_guard<std::mutex> lock(guest_stack_pool_mutex_);
+  auto it = guest_stack_pool_.find(alloc_size);
+  if (it == guest_stack_pool_.end()) {
+    return 0;
+  }
+  uint32_t alloc_base = it->second;
+  guest_stack_pool_.erase(it);
+  guest_stack_pool_bytes_ -= alloc_size;
+  return alloc_base;
+}
+
+bool KernelState::PoolGuestStack(uint32_t alloc_base, uint32_t alloc_size) {
+  std::lock_guard<std::mutex> lock(guest_stack_pool_mutex_);
+  if (guest_stack_pool_bytes_ + alloc_size >
+      uint64_t(cvars::guest_stack_pool_size_mb) << 20) {
+    return false;
+  }
+  guest_stack_pool_.emplace(alloc_size, alloc_base);
+  guest_stack_pool_bytes_ += alloc_size;
+  return true;
+}
+
+void KernelState::ReleasePooledGuestStacks() {
+  std::lock_guard<std::mutex> lock(guest_stack_pool_mutex_);
+  auto heap = memory()->LookupHeap(XThread::kStackAddressRangeBegin);
+  for (const auto& pooled_stack : guest_stack_pool_) {
+    heap->Release(pooled_stack.second);
+  }
+  guest_stack_pool_.clear();
+  guest_stack_pool_bytes_ = 0;
+}
+
+void KernelState::RecordThreadCreation(uint64_t start_host_ticks) {
+  thread_creation_count_.fetch_add(1, std::memory_order_relaxed);
+  thread_creation_host_ticks_.fetch_add(
+      Clock::QueryHostTickCount() - start_host_ticks,
+      std::memory_order_relaxed);
+}
+
 void KernelState::RegisterNotifyListener(XNotifyListener* listener) {
   auto global_lock = global_critical_region_.Acquire();
   notify_listeners_.push_back(retain_object(listener));
@@ -1013,6 +1301,10 @@ void KernelState::CompleteOverlappedDeferredEx(
 
 bool KernelState::Save(ByteStream* stream) {
   XELOGD("Serializing the kernel...");
+  // The pool is not saved, not to keep its stacks allocated forever in the
+  // restored memory.
+  ReleasePooledGuestStacks();
+
   stream->Write(kKernelSaveSignature);
 
   // Save the object table
@@ -1136,16 +1428,23 @@ bool KernelState::Restore(ByteStream* stream) {
     return false;
   }
 
+  // The pooled stacks are in the memory that is about to be replaced.
+  {
+    std::lock_guard<std::mutex> lock(guest_stack_pool_mutex_);
+    guest_stack_pool_.clear();
+    guest_stack_pool_bytes_ = 0;
+  }
+
   // Restore the object table
   object_table_.Restore(stream);
 
   // Read the TLS allocation bitmap
   auto num_bitmap_entries = stream->Read<uint32_t>();
-  auto& tls_bitmap = tls_bitmap_.data();
-  tls_bitmap.resize(num_bitmap_entries);
+  std::vector<uint64_t> tls_bitmap(num_bitmap_entries);
   for (uint32_t i = 0; i < num_bitmap_entries; i++) {
     tls_bitmap[i] = stream->Read<uint64_t>();
   }
+  tls_bitmap_.SetData(std::move(tls_bitmap));
 
   uint32_t num_threads = stream->Read<uint32_t>();
   XELOGD("Loading {} threads...", num_threads);
@@ -10,12 +10,16 @@
 #ifndef XENIA_KERNEL_KERNEL_STATE_H_
 #define XENIA_KERNEL_KERNEL_STATE_H_
 
+#include <array>
 #include <atomic>
 #include <bitset>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <list>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 #include "xenia/base/bit_map.h"
@@ -267,11 +271,44 @@ class KernelState {
   void OnThreadExit(XThread* thread);
   object_ref<XThread> GetThreadByID(uint32_t thread_id);
 
+  // Guest stacks of destroyed threads are kept allocated, up to
+  // guest_stack_pool_size_mb, and reused by new threads with the same
+  // allocation size. Returns the allocation base, or 0 if there's no pooled
+  // stack of the size.
+  uint32_t AcquirePooledGuestStack(uint32_t alloc_size);
+  // Returns false if the pool is full and the stack must be released instead.
+  bool PoolGuestStack(uint32_t alloc_base, uint32_t alloc_size);
+  void ReleasePooledGuestStacks();
+
+  // Guest threads created so far and the host time their creation has taken.
+  // Can be read from any thread.
+  uint64_t thread_creation_count() const {
+    return thread_creation_count_.load(std::memory_order_relaxed);
+  }
+  uint64_t thread_creation_host_ticks() const {
+    return thread_creation_host_ticks_.load(std::memory_order_relaxed);
+  }
+  void RecordThreadCreation(uint64_t start_host_ticks);
+
   void RegisterNotifyListener(XNotifyListener* listener);
   void UnregisterNotifyListener(XNotifyListener* listener);
   void BroadcastNotification(XNotificationID id, uint32_t data);
 
-  util::NativeList* dpc_list() { return &dpc_list_; }
+  // Queues the DPC on the dispatcher thread of the guest CPU, returns false if
+  // it's already queued.
+  bool InsertQueueDpc(uint32_t dpc_ptr, uint32_t arg1, uint32_t arg2,
+                      uint32_t cpu);
+  bool RemoveQueueDpc(uint32_t dpc_ptr);
+
+  // Guest memory for the APCs queued by the host, such as I/O completions,
+  // recycled instead of being allocated from the system heap for every APC.
+  uint32_t AllocateHostApc();
+  void FreeHostApc(uint32_t apc_ptr, bool delivered);
+
+  // Runs the function on one of the threads completing overlapped file I/O
+  // asynchronously. Returns false if there are no such threads, and the I/O
+  // must be done immediately instead.
+  bool QueueFileIO(std::function<void()> fn);
 
   void CompleteOverlapped(uint32_t overlapped_ptr, X_RESULT result);
   void CompleteOverlappedEx(uint32_t overlapped_ptr, X_RESULT result,
@@ -357,6 +394,14 @@ class KernelState {
   std::vector<object_ref<XNotifyListener>> notify_listeners_;
   bool has_notified_startup_ = false;
 
+  std::mutex guest_stack_pool_mutex_;
+  // Allocation base addresses by the allocation size.
+  std::unordered_multimap<uint32_t, uint32_t> guest_stack_pool_;
+  uint64_t guest_stack_pool_bytes_ = 0;
+
+  std::atomic<uint64_t> thread_creation_count_{0};
+  std::atomic<uint64_t> thread_creation_host_ticks_{0};
+
   object_ref<UserModule> executable_module_;
   std::vector<object_ref<KernelModule>> kernel_modules_;
   std::vector<object_ref<UserModule>> user_modules_;
@@ -365,11 +410,37 @@ class KernelState {
 
   std::atomic<bool> dispatch_thread_running_;
   object_ref<XHostThread> dispatch_thread_;
-  // Must be guarded by the global critical region.
-  util::NativeList dpc_list_;
   std::condition_variable_any dispatch_cond_;
   std::list<std::function<void()>> dispatch_queue_;
 
+  std::atomic<bool> file_io_threads_running_ = false;
+  std::vector<object_ref<XHostThread>> file_io_threads_;
+  std::mutex file_io_lock_;
+  std::condition_variable file_io_cond_;
+  // Protected by file_io_lock_.
+  std::list<std::function<void()>> file_io_queue_;
+
+  struct QueuedDpc {
+    uint32_t dpc_ptr;
+    uint64_t queue_host_ticks;
+  };
+  struct DpcQueue {
+    std::mutex lock;
+    std::condition_variable cond;
+    // Protected by lock.
+    std::deque<QueuedDpc> dpcs;
+    // Created when the first DPC is queued on the CPU.
+    object_ref<XHostThread> thread;
+  };
+  static constexpr uint32_t kDpcCpuCount = 6;
+  std::atomic<bool> dpc_threads_running_ = true;
+  std::array<DpcQueue, kDpcCpuCount> dpc_queues_;
+
+  // Lock-free stack of the unused host APCs, linked through their list
+  // entries, with a counter in the upper 32 bits against ABA.
+  std::atomic<uint64_t> free_host_apcs_ = 0;
+  std::atomic<uint32_t> queued_host_apc_count_ = 0;
+
   BitMap tls_bitmap_;
   uint32_t ke_timestamp_bundle_ptr_ = 0;
   std::unique_ptr<xe::threading::HighResolutionTimer> timestamp_timer_;
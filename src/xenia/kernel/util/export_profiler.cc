@@ -0,0 +1,219 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/kernel/util/export_profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include "xenia/base/assert.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/math.h"
+
+namespace xe {
+namespace kernel {
+namespace util {
+
+namespace {
+
+constexpr uint32_t kExportsPerChunk = 64;
+constexpr uint32_t kMaxExportCount = 8192;
+constexpr uint32_t kChunkCount = kMaxExportCount / kExportsPerChunk;
+
+// Only written by the thread owning them, and read by the UI thread, so plain
+// loads and stores are enough instead of read-modify-write operations.
+struct ExportCounters {
+  std::atomic<uint64_t> call_count;
+  std::atomic<uint64_t> host_ticks;
+  std::atomic<uint64_t> latency_buckets[ExportProfiler::kLatencyBucketCount];
+};
+
+struct ThreadCounters {
+  // Allocated on the first call of any export in the chunk by the thread.
+  std::atomic<ExportCounters*> chunks[kChunkCount] = {};
+
+  ~ThreadCounters() {
+    for (std::atomic<ExportCounters*>& chunk : chunks) {
+      delete[] chunk.load(std::memory_order_relaxed);
+    }
+  }
+};
+
+struct ProfilerState {
+  ProfilerState()
+      : host_ticks_per_us(std::max(
+            Clock::QueryHostTickFrequency() / 1000000, uint64_t(1))) {}
+
+  std::mutex mutex;
+  std::vector<ExportProfiler::ExportStatistics> exports;
+  // Totals at the last Reset, subtracted from the statistics.
+  std::vector<ExportProfiler::ExportStatistics> baseline;
+  // Kept after the threads exit so their calls are still counted.
+  std::vector<std::unique_ptr<ThreadCounters>> threads;
+  uint64_t host_ticks_per_us;
+};
+
+// The exports are registered during static initialization, so the state is
+// created on first use.
+ProfilerState& GetProfilerState() {
+  static ProfilerState state;
+  return state;
+}
+
+thread_local ThreadCounters* thread_counters = nullptr;
+
+template <typename T>
+void Increase(std::atomic<T>& counter, T value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value,
+                std::memory_order_relaxed);
+}
+
+// Must be called with the mutex held.
+std::vector<ExportProfiler::ExportStatistics> GetTotalStatistics(
+    ProfilerState& state) {
+  std::vector<ExportProfiler::ExportStatistics> totals = state.exports;
+  for (const std::unique_ptr<ThreadCounters>& thread : state.threads) {
+    for (uint32_t i = 0; i < kChunkCount; ++i) {
+      const ExportCounters* chunk =
+          thread->chunks[i].load(std::memory_order_acquire);
+      if (!chunk) {
+        continue;
+      }
+      for (uint32_t j = 0; j < kExportsPerChunk &&
+                           i * kExportsPerChunk + j < totals.size();
+           ++j) {
+        const ExportCounters& counters = chunk[j];
+        ExportProfiler::ExportStatistics& total =
+            totals[i * kExportsPerChunk + j];
+        total.call_count +=
+            counters.call_count.load(std::memory_order_relaxed);
+        total.host_ticks += counters.host_ticks.load(std::memory_order_relaxed);
+        for (uint32_t k = 0; k < ExportProfiler::kLatencyBucketCount; ++k) {
+          total.latency_buckets[k] +=
+              counters.latency_buckets[k].load(std::memory_order_relaxed);
+        }
+      }
+    }
+  }
+  return totals;
+}
+
+}  // namespace
+
+uint32_t ExportProfiler::RegisterExport(const char* module_name,
+                                        const cpu::Export* export_entry) {
+  ProfilerState& state = GetProfilerState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  assert_true(state.exports.size() < kMaxExportCount);
+  ExportStatistics statistics = {};
+  statistics.module_name = module_name;
+  statistics.export_entry = export_entry;
+  state.exports.push_back(statistics);
+  state.baseline.push_back(statistics);
+  return uint32_t(state.exports.size() - 1);
+}
+
+void ExportProfiler::RecordCall(uint32_t export_index, uint64_t host_ticks) {
+  if (export_index >= kMaxExportCount) {
+    return;
+  }
+  ThreadCounters* counters = thread_counters;
+  if (!counters) {
+    ProfilerState& state = GetProfilerState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.threads.push_back(std::make_unique<ThreadCounters>());
+    counters = state.threads.back().get();
+    thread_counters = counters;
+  }
+  std::atomic<ExportCounters*>& chunk_ptr =
+      counters->chunks[export_index / kExportsPerChunk];
+  ExportCounters* chunk = chunk_ptr.load(std::memory_order_relaxed);
+  if (!chunk) {
+    chunk = new ExportCounters[kExportsPerChunk]();
+    chunk_ptr.store(chunk, std::memory_order_release);
+  }
+  ExportCounters& export_counters = chunk[export_index % kExportsPerChunk];
+  Increase(export_counters.call_count, uint64_t(1));
+  Increase(export_counters.host_ticks, host_ticks);
+  uint64_t us = host_ticks / GetProfilerState().host_ticks_per_us;
+  uint32_t bucket =
+      us ? std::min(uint32_t(xe::log2_floor(us)) + 1, kLatencyBucketCount - 1)
+         : 0;
+  Increase(export_counters.latency_buckets[bucket], uint64_t(1));
+}
+
+std::vector<ExportProfiler::ExportStatistics> ExportProfiler::GetStatistics() {
+  ProfilerState& state = GetProfilerState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  std::vector<ExportStatistics> totals = GetTotalStatistics(state);
+  std::vector<ExportStatistics> statistics;
+  for (size_t i = 0; i < totals.size(); ++i) {
+    ExportStatistics& total = totals[i];
+    const ExportStatistics& baseline = state.baseline[i];
+    if (total.call_count == baseline.call_count) {
+      continue;
+    }
+    total.call_count -= baseline.call_count;
+    total.host_ticks -= baseline.host_ticks;
+    for (uint32_t j = 0; j < kLatencyBucketCount; ++j) {
+      total.latency_buckets[j] -= baseline.latency_buckets[j];
+    }
+    statistics.push_back(total);
+  }
+  return statistics;
+}
+
+void ExportProfiler::Reset() {
+  ProfilerState& state = GetProfilerState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  // The counters are owned by the threads calling the exports, so instead of
+  // clearing them, the current totals are subtracted from later statistics.
+  state.baseline = GetTotalStatistics(state);
+}
+
+bool ExportProfiler::DumpStatistics(const std::filesystem::path& path) {
+  FILE* file = xe::filesystem::OpenFile(path, "w");
+  if (!file) {
+    XELOGE("Failed to open {} for writing the kernel export profile",
+           xe::path_to_utf8(path));
+    return false;
+  }
+  fputs("module,ordinal,name,calls,total_us,average_us", file);
+  fputs(",under_1us", file);
+  for (uint32_t i = 1; i < kLatencyBucketCount - 1; ++i) {
+    fprintf(file, ",under_%uus", 1u << i);
+  }
+  fprintf(file, ",over_%uus\n", 1u << (kLatencyBucketCount - 2));
+  double ticks_to_us =
+      1000000.0 / static_cast<double>(Clock::QueryHostTickFrequency());
+  std::vector<ExportStatistics> statistics = GetStatistics();
+  for (const ExportStatistics& export_statistics : statistics) {
+    double total_us = export_statistics.host_ticks * ticks_to_us;
+    fprintf(file, "%s,%u,%s,%llu,%.3f,%.3f", export_statistics.module_name,
+            export_statistics.export_entry->ordinal,
+            export_statistics.export_entry->name,
+            static_cast<unsigned long long>(export_statistics.call_count),
+            total_us, total_us / export_statistics.call_count);
+    for (uint64_t bucket_count : export_statistics.latency_buckets) {
+      fprintf(file, ",%llu", static_cast<unsigned long long>(bucket_count));
+    }
+    fputc('\n', file);
+  }
+  fclose(file);
+  XELOGI("Dumped the profile of {} kernel exports to {}", statistics.size(),
+         xe::path_to_utf8(path));
+  return true;
+}
+
+}  // namespace util
+}  // namespace kernel
+}  // namespace xe
@@ -0,0 +1,81 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_KERNEL_UTIL_EXPORT_PROFILER_H_
+#define XENIA_KERNEL_UTIL_EXPORT_PROFILER_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "xenia/base/clock.h"
+#include "xenia/cpu/export_resolver.h"
+#include "xenia/kernel/kernel_flags.h"
+
+namespace xe {
+namespace kernel {
+namespace util {
+
+// Call counts and latency histograms of the HLE exports, gathered by the
+// export trampolines when the profile_kernel_exports cvar is enabled. Every
+// thread counts into its own blocks, which are only summed up when the
+// statistics are displayed or dumped, so profiled calls from different threads
+// never share cache lines.
+class ExportProfiler {
+ public:
+  // Bucket 0 counts calls shorter than 1 us, bucket i counts calls taking
+  // [2^(i-1), 2^i) us, and the last bucket also counts all longer calls.
+  static constexpr uint32_t kLatencyBucketCount = 16;
+
+  struct ExportStatistics {
+    const char* module_name;
+    const cpu::Export* export_entry;
+    uint64_t call_count;
+    uint64_t host_ticks;
+    uint64_t latency_buckets[kLatencyBucketCount];
+  };
+
+  // Called once for every export when it's registered, returns the index of
+  // its counters.
+  static uint32_t RegisterExport(const char* module_name,
+                                 const cpu::Export* export_entry);
+  static void RecordCall(uint32_t export_index, uint64_t host_ticks);
+
+  // Totals of all threads since the last Reset, only for the exports that
+  // have been called, in the order of their registration.
+  static std::vector<ExportStatistics> GetStatistics();
+  static void Reset();
+  static bool DumpStatistics(const std::filesystem::path& path);
+};
+
+// Measures the duration of an export call within its scope.
+class ExportCallTimer {
+ public:
+  explicit ExportCallTimer(uint32_t export_index)
+      : export_index_(export_index),
+        start_host_ticks_(cvars::profile_kernel_exports
+                              ? Clock::QueryHostTickCount()
+                              : 0) {}
+  ~ExportCallTimer() {
+    if (start_host_ticks_) {
+      ExportProfiler::RecordCall(
+          export_index_, Clock::QueryHostTickCount() - start_host_ticks_);
+    }
+  }
+
+ private:
+  uint32_t export_index_;
+  uint64_t start_host_ticks_;
+};
+
+}  // namespace util
+}  // namespace kernel
+}  // namespace xe
+
+#endif  // XENIA_KERNEL_UTIL_EXPORT_PROFILER_H_
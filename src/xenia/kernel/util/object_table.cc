@@ -10,10 +10,11 @@
 #include "xenia/kernel/util/object_table.h"
 
 #include <algorithm>
-#include <cstring>
 
 #include "xenia/base/byte_stream.h"
 #include "xenia/base/logging.h"
+#include "xenia/base/math.h"
+#include "xenia/base/threading.h"
 #include "xenia/kernel/xobject.h"
 #include "xenia/kernel/xthread.h"
 
@@ -29,27 +30,55 @@ void ObjectTable::Reset() {
   auto global_lock = global_critical_region_.Acquire();
 
   // Release all objects.
+  std::vector<XObject*> objects;
   for (uint32_t n = 0; n < table_capacity_; n++) {
-    ObjectTableEntry& entry = table_[n];
-    if (entry.object) {
-      entry.object->Release();
+    XObject* object = GetEntryInLock(n, false).object.exchange(nullptr);
+    if (object) {
+      objects.push_back(object);
     }
   }
   for (uint32_t n = 0; n < host_table_capacity_; n++) {
-    ObjectTableEntry& entry = host_table_[n];
-    if (entry.object) {
-      entry.object->Release();
+    XObject* object = GetEntryInLock(n, true).object.exchange(nullptr);
+    if (object) {
+      objects.push_back(object);
     }
   }
+  WaitForLookups();
+  for (XObject* object : objects) {
+    object->Release();
+  }
 
+  std::vector<ObjectTableEntry*> chunks;
+  for (uint32_t i = 0; i < kMaxTableChunkCount; ++i) {
+    ObjectTableEntry* chunk = table_chunks_[i].exchange(nullptr);
+    if (chunk) {
+      chunks.push_back(chunk);
+    }
+    chunk = host_table_chunks_[i].exchange(nullptr);
+    if (chunk) {
+      chunks.push_back(chunk);
+    }
+  }
   table_capacity_ = 0;
   host_table_capacity_ = 0;
   last_free_entry_ = 0;
   last_free_host_entry_ = 0;
-  free(table_);
-  table_ = nullptr;
-  free(host_table_);
-  host_table_ = nullptr;
+  WaitForLookups();
+  for (ObjectTableEntry* chunk : chunks) {
+    delete[] chunk;
+  }
+}
+
+void ObjectTable::WaitForLookups() {
+  // A lookup may be counted in either half of the epoch depending on when it
+  // has read it, so both halves are drained, flipping the epoch before each so
+  // new lookups are counted in the other half.
+  for (uint32_t i = 0; i < 2; ++i) {
+    uint32_t epoch = lookup_epoch_.fetch_add(1);
+    while (active_lookup_counts_[epoch & 1].load()) {
+      xe::threading::MaybeYield();
+    }
+  }
 }
 
 X_STATUS ObjectTable::FindFreeSlot(uint32_t* out_slot, bool host) {
@@ -58,8 +87,8 @@ X_STATUS ObjectTable::FindFreeSlot(uint32_t* out_slot, bool host) {
   uint32_t capacity = host ? host_table_capacity_ : table_capacity_;
   uint32_t scan_count = 0;
   while (scan_count < capacity) {
-    ObjectTableEntry& entry = host ? host_table_[slot] : table_[slot];
-    if (!entry.object) {
+    ObjectTableEntry& entry = GetEntryInLock(slot, host);
+    if (!entry.object.load(std::memory_order_relaxed)) {
       *out_slot = slot;
       return X_STATUS_SUCCESS;
     }
@@ -87,28 +116,30 @@ X_STATUS ObjectTable::FindFreeSlot(uint32_t* out_slot, bool host) {
 
 bool ObjectTable::Resize(uint32_t new_capacity, bool host) {
   uint32_t capacity = host ? host_table_capacity_ : table_capacity_;
-  uint32_t new_size = new_capacity * sizeof(ObjectTableEntry);
-  uint32_t old_size = capacity * sizeof(ObjectTableEntry);
-  auto new_table = reinterpret_cast<ObjectTableEntry*>(
-      realloc(host ? host_table_ : table_, new_size));
-  if (!new_table) {
+  if (new_capacity <= capacity) {
+    // Chunks are never freed while the table is in use.
+    return true;
+  }
+  if (new_capacity > kMaxTableChunkCount * kTableChunkEntryCount) {
     return false;
   }
+  new_capacity = xe::align(new_capacity, kTableChunkEntryCount);
 
-  // Zero out new entries.
-  if (new_size > old_size) {
-    std::memset(reinterpret_cast<uint8_t*>(new_table) + old_size, 0,
-                new_size - old_size);
+  std::atomic<ObjectTableEntry*>* chunks =
+      host ? host_table_chunks_ : table_chunks_;
+  for (uint32_t i = capacity >> kTableChunkEntryCountLog2;
+       i < (new_capacity >> kTableChunkEntryCountLog2); ++i) {
+    // Published after the entries have been initialized as free.
+    chunks[i].store(new ObjectTableEntry[kTableChunkEntryCount],
+                    std::memory_order_release);
   }
 
   if (host) {
     last_free_host_entry_ = capacity;
     host_table_capacity_ = new_capacity;
-    host_table_ = new_table;
   } else {
     last_free_entry_ = capacity;
     table_capacity_ = new_capacity;
-    table_ = new_table;
   }
 
   return true;
@@ -128,9 +159,7 @@ X_STATUS ObjectTable::AddHandle(XObject* object, X_HANDLE* out_handle) {
 
     // Stash.
     if (XSUCCEEDED(result)) {
-      ObjectTableEntry& entry = host_object ? host_table_[slot] : table_[slot];
-      entry.object = object;
-      entry.handle_ref_count = 1;
+      ObjectTableEntry& entry = GetEntryInLock(slot, host_object);
       handle = slot << 2;
       if (!host_object) {
         if (object->type() != XObject::Type::Socket) {
@@ -141,8 +170,12 @@ X_STATUS ObjectTable::AddHandle(XObject* object, X_HANDLE* out_handle) {
       }
       object->handles().push_back(handle);
 
-      // Retain so long as the object is in the table.
+      // Retain so long as the object is in the table. Done before publishing
+      // the object to lock-free lookups, so their references are never the
+      // last ones.
       object->Retain();
+      entry.handle_ref_count.store(1, std::memory_order_relaxed);
+      entry.object.store(object, std::memory_order_release);
 
       XELOGI("Added handle:{:08X} for {}", handle, typeid(*object).name());
     }
@@ -173,18 +206,40 @@ X_STATUS ObjectTable::DuplicateHandle(X_HANDLE handle, X_HANDLE* out_handle) {
 }
 
 X_STATUS ObjectTable::RetainHandle(X_HANDLE handle) {
-  auto global_lock = global_critical_region_.Acquire();
-
-  ObjectTableEntry* entry = LookupTableInLock(handle);
+  ObjectTableEntry* entry = LookupTable(handle);
   if (!entry) {
     return X_STATUS_INVALID_HANDLE;
   }
 
-  entry->handle_ref_count++;
+  // Only handles that have not been closed yet can be retained.
+  int32_t handle_ref_count =
+      entry->handle_ref_count.load(std::memory_order_relaxed);
+  do {
+    if (handle_ref_count <= 0) {
+      return X_STATUS_INVALID_HANDLE;
+    }
+  } while (!entry->handle_ref_count.compare_exchange_weak(
+      handle_ref_count, handle_ref_count + 1, std::memory_order_relaxed));
   return X_STATUS_SUCCESS;
 }
 
 X_STATUS ObjectTable::ReleaseHandle(X_HANDLE handle) {
+  ObjectTableEntry* entry = LookupTable(handle);
+  if (!entry) {
+    return X_STATUS_INVALID_HANDLE;
+  }
+
+  // The lock is only needed for releasing the last reference.
+  int32_t handle_ref_count =
+      entry->handle_ref_count.load(std::memory_order_relaxed);
+  while (handle_ref_count > 1) {
+    if (entry->handle_ref_count.compare_exchange_weak(
+            handle_ref_count, handle_ref_count - 1,
+            std::memory_order_acq_rel)) {
+      return X_STATUS_SUCCESS;
+    }
+  }
+
   auto global_lock = global_critical_region_.Acquire();
 
   return ReleaseHandleInLock(handle);
@@ -195,7 +250,7 @@ X_STATUS ObjectTable::ReleaseHandleInLock(X_HANDLE handle) {
     return X_STATUS_INVALID_HANDLE;
   }
 
-  if (--entry->handle_ref_count == 0) {
+  if (entry->handle_ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
     // No more references. Remove it from the table.
     return RemoveHandle(handle);
   }
@@ -218,11 +273,11 @@ X_STATUS ObjectTable::RemoveHandle(X_HANDLE handle) {
     return X_STATUS_INVALID_HANDLE;
   }
 
-  if (entry->object) {
-    auto object = entry->object;
-    entry->object = nullptr;
+  // Sequentially consistent with the counting of the lock-free lookups.
+  XObject* object = entry->object.exchange(nullptr);
+  if (object) {
     assert_zero(entry->handle_ref_count);
-    entry->handle_ref_count = 0;
+    entry->handle_ref_count.store(0, std::memory_order_relaxed);
 
     // Walk the object's handles and remove this one.
     auto handle_entry =
@@ -237,7 +292,9 @@ X_STATUS ObjectTable::RemoveHandle(X_HANDLE handle) {
     if (!object->name().empty()) {
       RemoveNameMapping(object->name());
     }
-    // Release now that the object has been removed from the table.
+    // Release now that the object has been removed from the table, and no
+    // lookup that has obtained it before can be retaining it anymore.
+    WaitForLookups();
     object->Release();
   }
 
@@ -249,19 +306,21 @@ std::vector<object_ref<XObject>> ObjectTable::GetAllObjects() {
   std::vector<object_ref<XObject>> results;
 
   for (uint32_t slot = 0; slot < host_table_capacity_; slot++) {
-    auto& entry = host_table_[slot];
-    if (entry.object && std::find(results.begin(), results.end(),
-                                  entry.object) == results.end()) {
-      entry.object->Retain();
-      results.push_back(object_ref<XObject>(entry.object));
+    XObject* object =
+        GetEntryInLock(slot, true).object.load(std::memory_order_relaxed);
+    if (object &&
+        std::find(results.begin(), results.end(), object) == results.end()) {
+      object->Retain();
+      results.push_back(object_ref<XObject>(object));
     }
   }
   for (uint32_t slot = 0; slot < table_capacity_; slot++) {
-    auto& entry = table_[slot];
-    if (entry.object && std::find(results.begin(), results.end(),
-                                  entry.object) == results.end()) {
-      entry.object->Retain();
-      results.push_back(object_ref<XObject>(entry.object));
+    XObject* object =
+        GetEntryInLock(slot, false).object.load(std::memory_order_relaxed);
+    if (object &&
+        std::find(results.begin(), results.end(), object) == results.end()) {
+      object->Retain();
+      results.push_back(object_ref<XObject>(object));
     }
   }
 
@@ -270,19 +329,24 @@ std::vector<object_ref<XObject>> ObjectTable::GetAllObjects() {
 
 void ObjectTable::PurgeAllObjects() {
   auto lock = global_critical_region_.Acquire();
+  std::vector<XObject*> objects;
   for (uint32_t slot = 0; slot < table_capacity_; slot++) {
-    auto& entry = table_[slot];
-    if (entry.object) {
-      entry.handle_ref_count = 0;
-      entry.object->Release();
-
-      entry.object = nullptr;
+    auto& entry = GetEntryInLock(slot, false);
+    XObject* object = entry.object.exchange(nullptr);
+    if (object) {
+      entry.handle_ref_count.store(0, std::memory_order_relaxed);
+      objects.push_back(object);
     }
   }
+  WaitForLookups();
+  for (XObject* object : objects) {
+    object->Release();
+  }
 }
 
 ObjectTable::ObjectTableEntry* ObjectTable::LookupTable(X_HANDLE handle) {
-  auto global_lock = global_critical_region_.Acquire();
+  // Entries are never freed while the table is in use, so the lock is not
+  // needed to locate one.
   return LookupTableInLock(handle);
 }
 
@@ -293,16 +357,7 @@ ObjectTable::ObjectTableEntry* ObjectTable::LookupTableInLock(X_HANDLE handle) {
   }
 
   const bool is_host_object = XObject::is_handle_host_object(handle);
-  uint32_t slot = GetHandleSlot(handle, is_host_object);
-  if (is_host_object) {
-    if (slot <= host_table_capacity_) {
-      return &host_table_[slot];
-    }
-  } else if (slot <= table_capacity_) {
-    return &table_[slot];
-  }
-
-  return nullptr;
+  return GetEntry(GetHandleSlot(handle, is_host_object), is_host_object);
 }
 
 // Generic lookup
@@ -320,37 +375,31 @@ XObject* ObjectTable::LookupObject(X_HANDLE handle, bool already_locked) {
     return nullptr;
   }
 
-  XObject* object = nullptr;
-  if (!already_locked) {
-    global_critical_region_.mutex().lock();
-  }
-
   const bool is_host_object = XObject::is_handle_host_object(handle);
-  uint32_t slot = GetHandleSlot(handle, is_host_object);
+  ObjectTableEntry* entry =
+      GetEntry(GetHandleSlot(handle, is_host_object), is_host_object);
+  if (!entry) {
+    return nullptr;
+  }
 
-  // Verify slot.
-  if (is_host_object) {
-    if (slot < host_table_capacity_) {
-      ObjectTableEntry& entry = host_table_[slot];
-      if (entry.object) {
-        object = entry.object;
-      }
-    }
-  } else if (slot < table_capacity_) {
-    ObjectTableEntry& entry = table_[slot];
-    if (entry.object) {
-      object = entry.object;
+  if (already_locked) {
+    // Objects can't be removed from the table concurrently.
+    XObject* object = entry->object.load(std::memory_order_relaxed);
+    if (object) {
+      object->Retain();
     }
+    return object;
   }
 
-  // Retain the object pointer.
+  // Without the lock, the reference of the table keeps the object alive until
+  // the lookup is not counted as active anymore.
+  uint32_t epoch_half = lookup_epoch_.load(std::memory_order_relaxed) & 1;
+  active_lookup_counts_[epoch_half].fetch_add(1);
+  XObject* object = entry->object.load();
   if (object) {
     object->Retain();
   }
-
-  if (!already_locked) {
-    global_critical_region_.mutex().unlock();
-  }
+  active_lookup_counts_[epoch_half].fetch_sub(1, std::memory_order_release);
 
   return object;
 }
@@ -359,20 +408,22 @@ void ObjectTable::GetObjectsByType(XObject::Type type,
                                    std::vector<object_ref<XObject>>* results) {
   auto global_lock = global_critical_region_.Acquire();
   for (uint32_t slot = 0; slot < host_table_capacity_; ++slot) {
-    auto& entry = host_table_[slot];
-    if (entry.object) {
-      if (entry.object->type() == type) {
-        entry.object->Retain();
-        results->push_back(object_ref<XObject>(entry.object));
+    XObject* object =
+        GetEntryInLock(slot, true).object.load(std::memory_order_relaxed);
+    if (object) {
+      if (object->type() == type) {
+        object->Retain();
+        results->push_back(object_ref<XObject>(object));
       }
     }
   }
   for (uint32_t slot = 0; slot < table_capacity_; ++slot) {
-    auto& entry = table_[slot];
-    if (entry.object) {
-      if (entry.object->type() == type) {
-        entry.object->Retain();
-        results->push_back(object_ref<XObject>(entry.object));
+    XObject* object =
+        GetEntryInLock(slot, false).object.load(std::memory_order_relaxed);
+    if (object) {
+      if (object->type() == type) {
+        object->Retain();
+        results->push_back(object_ref<XObject>(object));
       }
     }
   }
@@ -433,32 +484,38 @@ X_STATUS ObjectTable::GetObjectByName(const std::string_view name,
 bool ObjectTable::Save(ByteStream* stream) {
   stream->Write<uint32_t>(host_table_capacity_);
   for (uint32_t i = 0; i < host_table_capacity_; i++) {
-    auto& entry = host_table_[i];
-    stream->Write<int32_t>(entry.handle_ref_count);
+    auto& entry = GetEntryInLock(i, true);
+    stream->Write<int32_t>(
+        entry.handle_ref_count.load(std::memory_order_relaxed));
   }
 
   stream->Write<uint32_t>(table_capacity_);
   for (uint32_t i = 0; i < table_capacity_; i++) {
-    auto& entry = table_[i];
-    stream->Write<int32_t>(entry.handle_ref_count);
+    auto& entry = GetEntryInLock(i, false);
+    stream->Write<int32_t>(
+        entry.handle_ref_count.load(std::memory_order_relaxed));
   }
 
   return true;
 }
 
 bool ObjectTable::Restore(ByteStream* stream) {
-  Resize(stream->Read<uint32_t>(), true);
-  for (uint32_t i = 0; i < host_table_capacity_; i++) {
-    auto& entry = host_table_[i];
+  uint32_t host_table_capacity = stream->Read<uint32_t>();
+  Resize(host_table_capacity, true);
+  for (uint32_t i = 0; i < host_table_capacity; i++) {
+    auto& entry = GetEntryInLock(i, true);
     // entry.object = nullptr;
-    entry.handle_ref_count = stream->Read<int32_t>();
+    entry.handle_ref_count.store(stream->Read<int32_t>(),
+                                 std::memory_order_relaxed);
   }
 
-  Resize(stream->Read<uint32_t>(), false);
-  for (uint32_t i = 0; i < table_capacity_; i++) {
-    auto& entry = table_[i];
+  uint32_t table_capacity = stream->Read<uint32_t>();
+  Resize(table_capacity, false);
+  for (uint32_t i = 0; i < table_capacity; i++) {
+    auto& entry = GetEntryInLock(i, false);
     // entry.object = nullptr;
-    entry.handle_ref_count = stream->Read<int32_t>();
+    entry.handle_ref_count.store(stream->Read<int32_t>(),
+                                 std::memory_order_relaxed);
   }
 
   return true;
@@ -468,12 +525,12 @@ X_STATUS ObjectTable::RestoreHandle(X_HANDLE handle, XObject* object) {
   const bool is_host_object = XObject::is_handle_host_object(handle);
   uint32_t slot = GetHandleSlot(handle, is_host_object);
   uint32_t capacity = is_host_object ? host_table_capacity_ : table_capacity_;
-  assert_true(capacity >= slot);
+  assert_true(capacity > slot);
 
-  if (capacity >= slot) {
-    auto& entry = is_host_object ? host_table_[slot] : table_[slot];
-    entry.object = object;
+  if (capacity > slot) {
+    auto& entry = GetEntryInLock(slot, is_host_object);
     object->Retain();
+    entry.object.store(object, std::memory_order_release);
   }
 
   return X_STATUS_SUCCESS;
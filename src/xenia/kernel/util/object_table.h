@@ -10,6 +10,7 @@
 #ifndef XENIA_KERNEL_UTIL_OBJECT_TABLE_H_
 #define XENIA_KERNEL_UTIL_OBJECT_TABLE_H_
 
+#include <atomic>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -82,9 +83,41 @@ class ObjectTable {
 
  private:
   struct ObjectTableEntry {
-    int handle_ref_count = 0;
-    XObject* object = nullptr;
+    std::atomic<int32_t> handle_ref_count{0};
+    // Written only with the lock held, but read without it in LookupObject.
+    std::atomic<XObject*> object{nullptr};
   };
+  // Entries are allocated in chunks which are never moved or freed until
+  // Reset, so lookups can access them without the lock.
+  static constexpr uint32_t kTableChunkEntryCountLog2 = 14;
+  static constexpr uint32_t kTableChunkEntryCount =
+      uint32_t(1) << kTableChunkEntryCountLog2;
+  // Enough for all the guest handles, from kHandleBase to 0xFFFFFFFF.
+  static constexpr uint32_t kMaxTableChunkCount =
+      ((~XObject::kHandleBase + 1) >> 2) >> kTableChunkEntryCountLog2;
+
+  // Returns nullptr if the chunk containing the slot is not allocated.
+  ObjectTableEntry* GetEntry(uint32_t slot, bool host) const {
+    uint32_t chunk_index = slot >> kTableChunkEntryCountLog2;
+    if (chunk_index >= kMaxTableChunkCount) {
+      return nullptr;
+    }
+    ObjectTableEntry* chunk =
+        (host ? host_table_chunks_ : table_chunks_)[chunk_index].load(
+            std::memory_order_acquire);
+    if (!chunk) {
+      return nullptr;
+    }
+    return &chunk[slot & (kTableChunkEntryCount - 1)];
+  }
+  // For slots known to be below the capacity, with the lock held.
+  ObjectTableEntry& GetEntryInLock(uint32_t slot, bool host) const {
+    return *GetEntry(slot, host);
+  }
+  // Waits for the lock-free lookups that may have obtained an object that
+  // has been removed from the table before its reference is released.
+  void WaitForLookups();
+
   ObjectTableEntry* LookupTableInLock(X_HANDLE handle);
   ObjectTableEntry* LookupTable(X_HANDLE handle);
   XObject* LookupObject(X_HANDLE handle, bool already_locked);
@@ -102,8 +135,13 @@ class ObjectTable {
   xe::global_critical_region global_critical_region_;
   uint32_t table_capacity_ = 0;
   uint32_t host_table_capacity_ = 0;
-  ObjectTableEntry* table_ = nullptr;
-  ObjectTableEntry* host_table_ = nullptr;
+  std::atomic<ObjectTableEntry*> table_chunks_[kMaxTableChunkCount] = {};
+  std::atomic<ObjectTableEntry*> host_table_chunks_[kMaxTableChunkCount] = {};
+  // Lock-free lookups in progress, counted separately for the two halves of
+  // the lookup epoch like in sleepable RCU, so removals are not starved by a
+  // constant stream of new lookups.
+  std::atomic<uint32_t> lookup_epoch_{0};
+  std::atomic<uint32_t> active_lookup_counts_[2] = {};
   uint32_t last_free_entry_ = 0;
   uint32_t last_free_host_entry_ = 0;
   std::unordered_map<string_key_case, X_HANDLE> name_table_;
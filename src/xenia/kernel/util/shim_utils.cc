@@ -17,6 +17,44 @@ thread_local StringBuffer string_buffer_;
 
 StringBuffer* thread_local_string_buffer() { return &string_buffer_; }
 
+void AppendGuestUtf16String(StringBuffer* string_buffer,
+                            const char16_t* guest_string) {
+  for (size_t i = 0;; ++i) {
+    uint32_t c = xe::load_and_swap<uint16_t>(guest_string + i);
+    if (!c) {
+      break;
+    }
+    if (c >= 0xD800 && c <= 0xDFFF) {
+      uint32_t low = c <= 0xDBFF
+                         ? uint32_t(xe::load_and_swap<uint16_t>(
+                               guest_string + i + 1))
+                         : 0;
+      if (low >= 0xDC00 && low <= 0xDFFF) {
+        c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+        ++i;
+      } else {
+        // Unpaired surrogate.
+        c = 0xFFFD;
+      }
+    }
+    if (c < 0x80) {
+      string_buffer->Append(char(c));
+    } else if (c < 0x800) {
+      string_buffer->Append(char(0xC0 | (c >> 6)));
+      string_buffer->Append(char(0x80 | (c & 0x3F)));
+    } else if (c < 0x10000) {
+      string_buffer->Append(char(0xE0 | (c >> 12)));
+      string_buffer->Append(char(0x80 | ((c >> 6) & 0x3F)));
+      string_buffer->Append(char(0x80 | (c & 0x3F)));
+    } else {
+      string_buffer->Append(char(0xF0 | (c >> 18)));
+      string_buffer->Append(char(0x80 | ((c >> 12) & 0x3F)));
+      string_buffer->Append(char(0x80 | ((c >> 6) & 0x3F)));
+      string_buffer->Append(char(0x80 | (c & 0x3F)));
+    }
+  }
+}
+
 XThread* ContextParam::CurrentXThread() const {
   return XThread::GetCurrentThread();
 }
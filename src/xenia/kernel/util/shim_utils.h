@@ -21,8 +21,10 @@
 #include "xenia/base/string_buffer.h"
 #include "xenia/cpu/export_resolver.h"
 #include "xenia/cpu/ppc/ppc_context.h"
+#include "xenia/cpu/processor.h"
 #include "xenia/kernel/kernel_flags.h"
 #include "xenia/kernel/kernel_state.h"
+#include "xenia/kernel/util/export_profiler.h"
 
 namespace xe {
 namespace kernel {
@@ -137,7 +139,33 @@ namespace shim {
 class Param {
  public:
   struct Init {
+    explicit Init(PPCContext* ppc_context)
+        : ppc_context(ppc_context),
+#if !XE_PLATFORM_WIN32
+          memory(ppc_context->processor->memory()),
+#endif
+          ordinal(0),
+          float_ordinal(0) {
+    }
+
+    // Translates the pointer arguments, with the memory looked up once for all
+    // of them rather than for every argument.
+    template <typename T>
+    T TranslatePointer(uint32_t guest_address) const {
+      if (!guest_address) {
+        return nullptr;
+      }
+#if XE_PLATFORM_WIN32
+      return ppc_context->TranslateVirtual<T>(guest_address);
+#else
+      return memory->TranslateVirtual<T>(guest_address);
+#endif
+    }
+
     PPCContext* ppc_context;
+#if !XE_PLATFORM_WIN32
+    const Memory* memory;
+#endif
     int ordinal;
     int float_ordinal;
   };
@@ -158,7 +186,7 @@ class Param {
       uint32_t stack_ptr =
           uint32_t(init.ppc_context->r[1]) + 0x54 + (ordinal_ - 8) * 8;
       *out_value =
-          xe::load_and_swap<V>(init.ppc_context->TranslateVirtual(stack_ptr));
+          xe::load_and_swap<V>(init.TranslatePointer<uint8_t*>(stack_ptr));
     }
   }
 
@@ -222,7 +250,7 @@ class ContextParam : public Param {
 class PointerParam : public ParamBase<uint32_t> {
  public:
   PointerParam(Init& init) : ParamBase(init) {
-    host_ptr_ = value_ ? init.ppc_context->TranslateVirtual(value_) : nullptr;
+    host_ptr_ = init.TranslatePointer<void*>(value_);
   }
   PointerParam(void* host_ptr) : ParamBase(), host_ptr_(host_ptr) {}
   PointerParam& operator=(void*& other) {
@@ -260,8 +288,7 @@ template <typename T>
 class PrimitivePointerParam : public ParamBase<uint32_t> {
  public:
   PrimitivePointerParam(Init& init) : ParamBase(init) {
-    host_ptr_ = value_ ? init.ppc_context->TranslateVirtual<xe::be<T>*>(value_)
-                       : nullptr;
+    host_ptr_ = init.TranslatePointer<xe::be<T>*>(value_);
   }
   PrimitivePointerParam(T* host_ptr) : ParamBase() {
     host_ptr_ = reinterpret_cast<xe::be<T>*>(host_ptr);
@@ -291,8 +318,7 @@ template <typename CHAR, typename STR>
 class StringPointerParam : public ParamBase<uint32_t> {
  public:
   StringPointerParam(Init& init) : ParamBase(init) {
-    host_ptr_ =
-        value_ ? init.ppc_context->TranslateVirtual<CHAR*>(value_) : nullptr;
+    host_ptr_ = init.TranslatePointer<CHAR*>(value_);
   }
   StringPointerParam(CHAR* host_ptr) : ParamBase(), host_ptr_(host_ptr) {}
   StringPointerParam& operator=(const CHAR*& other) {
@@ -315,8 +341,7 @@ template <typename T>
 class TypedPointerParam : public ParamBase<uint32_t> {
  public:
   TypedPointerParam(Init& init) : ParamBase(init) {
-    host_ptr_ =
-        value_ ? init.ppc_context->TranslateVirtual<T*>(value_) : nullptr;
+    host_ptr_ = init.TranslatePointer<T*>(value_);
   }
   TypedPointerParam(T* host_ptr) : ParamBase(), host_ptr_(host_ptr) {}
   TypedPointerParam& operator=(const T*& other) {
@@ -445,16 +470,25 @@ inline void AppendParam(StringBuffer* string_buffer, lpdouble_t param) {
 inline void AppendParam(StringBuffer* string_buffer, ppc_context_t param) {
   string_buffer->Append("ContextArg");
 }
+// Appends a big-endian null-terminated guest UTF-16 string as UTF-8, without
+// converting it to temporary strings.
+void AppendGuestUtf16String(StringBuffer* string_buffer,
+                            const char16_t* guest_string);
 inline void AppendParam(StringBuffer* string_buffer, lpstring_t param) {
   string_buffer->AppendFormat("{:08X}", param.guest_address());
   if (param) {
-    string_buffer->AppendFormat("({})", param.value());
+    // Single-byte characters, no need to swap into a copy.
+    string_buffer->Append('(');
+    string_buffer->Append(static_cast<const char*>(param));
+    string_buffer->Append(')');
   }
 }
 inline void AppendParam(StringBuffer* string_buffer, lpu16string_t param) {
   string_buffer->AppendFormat("{:08X}", param.guest_address());
   if (param) {
-    string_buffer->AppendFormat("({})", xe::to_utf8(param.value()));
+    string_buffer->Append('(');
+    AppendGuestUtf16String(string_buffer, param);
+    string_buffer->Append(')');
   }
 }
 inline void AppendParam(StringBuffer* string_buffer,
@@ -494,6 +528,18 @@ enum class KernelModuleId {
   xbdm,
 };
 
+constexpr const char* GetKernelModuleName(KernelModuleId module_id) {
+  switch (module_id) {
+    case KernelModuleId::xboxkrnl:
+      return "xboxkrnl";
+    case KernelModuleId::xam:
+      return "xam";
+    case KernelModuleId::xbdm:
+      return "xbdm";
+  }
+  return "";
+}
+
 template <size_t I = 0, typename... Ps>
 typename std::enable_if<I == sizeof...(Ps)>::type AppendKernelCallParams(
     StringBuffer& string_buffer, xe::cpu::Export* export_entry,
@@ -507,8 +553,7 @@ template <size_t I = 0, typename... Ps>
   if (I) {
     string_buffer.Append(", ");
   }
-  auto param = std::get<I>(params);
-  AppendParam(&string_buffer, param);
+  AppendParam(&string_buffer, std::get<I>(params));
   AppendKernelCallParams<I + 1>(string_buffer, export_entry, params);
 }
 
@@ -517,19 +562,22 @@ StringBuffer* thread_local_string_buffer();
 template <typename Tuple>
 XE_NOALIAS void PrintKernelCall(cpu::Export* export_entry,
                                 const Tuple& params) {
+  // Not formatting the parameters of the calls that won't be logged, debug
+  // ones usually.
+  bool is_important = export_entry->tags & xe::cpu::ExportTag::kImportant;
+  xe::LogLevel log_level =
+      is_important ? xe::LogLevel::Info : xe::LogLevel::Debug;
+  if (!xe::logging::internal::ShouldLog(log_level, LogSrc::Kernel)) {
+    return;
+  }
   auto& string_buffer = *thread_local_string_buffer();
   string_buffer.Reset();
   string_buffer.Append(export_entry->name);
   string_buffer.Append('(');
   AppendKernelCallParams(string_buffer, export_entry, params);
   string_buffer.Append(')');
-  if (export_entry->tags & xe::cpu::ExportTag::kImportant) {
-    xe::logging::AppendLogLine(xe::LogLevel::Info, 'i',
-                               string_buffer.to_string_view(), LogSrc::Kernel);
-  } else {
-    xe::logging::AppendLogLine(xe::LogLevel::Debug, 'd',
-                               string_buffer.to_string_view(), LogSrc::Kernel);
-  }
+  xe::logging::AppendLogLine(log_level, is_important ? 'i' : 'd',
+                             string_buffer.to_string_view(), LogSrc::Kernel);
 }
 /*
         todo: need faster string formatting/concatenation (all arguments are
@@ -542,6 +590,26 @@ XE_FORCEINLINE static auto KernelTrampoline(F&& f, Tuple&& t,
   return std::forward<F>(f)(std::get<I>(std::forward<Tuple>(t))...);
 }
 
+// Whether a call of the export needs to be logged or profiled, checked once
+// before anything else in the trampoline, so the calls that aren't take the
+// path that only loads the arguments and calls the export.
+template <xe::cpu::ExportTag::type TAGS>
+XE_FORCEINLINE bool IsKernelCallInstrumented() {
+  if (cvars::profile_kernel_exports) {
+    return true;
+  }
+  if constexpr (!(TAGS & xe::cpu::ExportTag::kLog)) {
+    return false;
+  } else if constexpr (TAGS & xe::cpu::ExportTag::kHighFrequency) {
+    return cvars::log_high_frequency_kernel_calls;
+  } else {
+    return xe::logging::internal::ShouldLog(
+        (TAGS & xe::cpu::ExportTag::kImportant) ? xe::LogLevel::Info
+                                                : xe::LogLevel::Debug,
+        LogSrc::Kernel);
+  }
+}
+
 template <KernelModuleId MODULE, uint16_t ORDINAL, typename R, typename... Ps>
 struct ExportRegistrerHelper {
   template <R (*fn)(Ps&...), xe::cpu::ExportTag::type tags>
@@ -556,22 +624,25 @@ struct ExportRegistrerHelper {
 
     static const auto export_entry =
         new cpu::Export(ORDINAL, xe::cpu::Export::Type::kFunction, name, TAGS);
+    static const uint32_t profile_index =
+        util::ExportProfiler::RegisterExport(GetKernelModuleName(MODULE),
+                                             export_entry);
     struct X {
       static void Trampoline(PPCContext* ppc_context) {
-        Param::Init init = {
-            ppc_context,
-            0,
-        };
+        if (XE_UNLIKELY(IsKernelCallInstrumented<TAGS>())) {
+          InstrumentedTrampoline(ppc_context);
+          return;
+        }
+        Call(ppc_context);
+      }
+
+      static XE_FORCEINLINE void Call(PPCContext* ppc_context) {
+        Param::Init init(ppc_context);
         // Using braces initializer instead of make_tuple because braces
         // enforce execution order across compilers.
         // The make_tuple order is undefined per the C++ standard and
         // cause inconsitencies between msvc and clang.
         std::tuple<Ps...> params = {Ps(init)...};
-        if (TAGS & xe::cpu::ExportTag::kLog &&
-            (!(TAGS & xe::cpu::ExportTag::kHighFrequency) ||
-             cvars::log_high_frequency_kernel_calls)) {
-          PrintKernelCall(export_entry, params);
-        }
         if constexpr (std::is_void<R>::value) {
           KernelTrampoline(fn, std::forward<std::tuple<Ps...>>(params),
                            std::make_index_sequence<sizeof...(Ps)>());
@@ -580,20 +651,20 @@ struct ExportRegistrerHelper {
               KernelTrampoline(fn, std::forward<std::tuple<Ps...>>(params),
                                std::make_index_sequence<sizeof...(Ps)>());
           result.Store(ppc_context);
-          if (TAGS &
-              (xe::cpu::ExportTag::kLog | xe::cpu::ExportTag::kLogResult)) {
-            // TODO(benvanik): log result.
-          }
         }
       }
-    };
-    struct Y {
-      static void Trampoline(PPCContext* ppc_context) {
-        Param::Init init = {
-            ppc_context,
-            0,
-        };
+
+      static XE_NOINLINE void InstrumentedTrampoline(PPCContext* ppc_context) {
+        // Including the loading of the arguments, so the profile shows the
+        // whole overhead of the call.
+        util::ExportCallTimer call_timer(profile_index);
+        Param::Init init(ppc_context);
         std::tuple<Ps...> params = {Ps(init)...};
+        if (TAGS & xe::cpu::ExportTag::kLog &&
+            (!(TAGS & xe::cpu::ExportTag::kHighFrequency) ||
+             cvars::log_high_frequency_kernel_calls)) {
+          PrintKernelCall(export_entry, params);
+        }
         if constexpr (std::is_void<R>::value) {
           KernelTrampoline(fn, std::forward<std::tuple<Ps...>>(params),
                            std::make_index_sequence<sizeof...(Ps)>());
@@ -602,6 +673,10 @@ struct ExportRegistrerHelper {
               KernelTrampoline(fn, std::forward<std::tuple<Ps...>>(params),
                                std::make_index_sequence<sizeof...(Ps)>());
           result.Store(ppc_context);
+          if (TAGS &
+              (xe::cpu::ExportTag::kLog | xe::cpu::ExportTag::kLogResult)) {
+            // TODO(benvanik): log result.
+          }
         }
       }
     };
@@ -0,0 +1,85 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/kernel/util/spinlock_profiler.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace xe {
+namespace kernel {
+namespace util {
+
+namespace {
+
+// Contention is already slow, so unlike the export counters, a single map
+// behind a mutex is enough.
+struct ProfilerState {
+  std::mutex mutex;
+  std::unordered_map<uint32_t, SpinLockProfiler::LockStatistics> locks;
+};
+
+ProfilerState& GetProfilerState() {
+  static ProfilerState state;
+  return state;
+}
+
+SpinLockProfiler::LockStatistics& GetLockStatistics(ProfilerState& state,
+                                                    uint32_t guest_address) {
+  auto it = state.locks.find(guest_address);
+  if (it == state.locks.end()) {
+    SpinLockProfiler::LockStatistics statistics = {};
+    statistics.guest_address = guest_address;
+    it = state.locks.emplace(guest_address, statistics).first;
+  }
+  return it->second;
+}
+
+}  // namespace
+
+void SpinLockProfiler::RecordContention(uint32_t guest_address,
+                                        uint64_t spin_count,
+                                        uint64_t yield_count,
+                                        uint64_t wait_host_ticks) {
+  ProfilerState& state = GetProfilerState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  LockStatistics& statistics = GetLockStatistics(state, guest_address);
+  ++statistics.contended_count;
+  statistics.spin_count += spin_count;
+  statistics.yield_count += yield_count;
+  statistics.wait_host_ticks += wait_host_ticks;
+}
+
+void SpinLockProfiler::RecordFailedTry(uint32_t guest_address) {
+  ProfilerState& state = GetProfilerState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  ++GetLockStatistics(state, guest_address).failed_try_count;
+}
+
+std::vector<SpinLockProfiler::LockStatistics>
+SpinLockProfiler::GetStatistics() {
+  ProfilerState& state = GetProfilerState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  std::vector<LockStatistics> statistics;
+  statistics.reserve(state.locks.size());
+  for (const auto& lock_statistics : state.locks) {
+    statistics.push_back(lock_statistics.second);
+  }
+  return statistics;
+}
+
+void SpinLockProfiler::Reset() {
+  ProfilerState& state = GetProfilerState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.locks.clear();
+}
+
+}  // namespace util
+}  // namespace kernel
+}  // namespace xe
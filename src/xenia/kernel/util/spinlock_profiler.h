@@ -0,0 +1,52 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_KERNEL_UTIL_SPINLOCK_PROFILER_H_
+#define XENIA_KERNEL_UTIL_SPINLOCK_PROFILER_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace xe {
+namespace kernel {
+namespace util {
+
+// Contention of the guest kernel spinlocks, keyed by the guest address of the
+// lock, gathered along with the export profile when the profile_kernel_exports
+// cvar is enabled. Only the acquisitions that found the lock held are recorded,
+// so uncontended locks cost nothing.
+class SpinLockProfiler {
+ public:
+  struct LockStatistics {
+    uint32_t guest_address;
+    // Acquisitions that had to wait for the lock.
+    uint64_t contended_count;
+    // KeTryToAcquireSpinLockAtRaisedIrql calls that found the lock held.
+    uint64_t failed_try_count;
+    // Pause instructions executed and yields to the host scheduler while
+    // waiting.
+    uint64_t spin_count;
+    uint64_t yield_count;
+    uint64_t wait_host_ticks;
+  };
+
+  static void RecordContention(uint32_t guest_address, uint64_t spin_count,
+                               uint64_t yield_count, uint64_t wait_host_ticks);
+  static void RecordFailedTry(uint32_t guest_address);
+
+  // Statistics since the last Reset, in no particular order.
+  static std::vector<LockStatistics> GetStatistics();
+  static void Reset();
+};
+
+}  // namespace util
+}  // namespace kernel
+}  // namespace xe
+
+#endif  // XENIA_KERNEL_UTIL_SPINLOCK_PROFILER_H_
@@ -9,6 +9,7 @@
 
 #include "xenia/kernel/xam/content_manager.h"
 
+#include <algorithm>
 #include <array>
 #include <string>
 #include <unordered_set>
@@ -195,11 +196,64 @@ std::unordered_set<uint32_t> ContentManager::FindPublisherTitleIds(
 std::vector<XCONTENT_AGGREGATE_DATA> ContentManager::ListContent(
     const uint32_t device_id, const uint64_t xuid, const uint32_t title_id,
     const XContentType content_type) const {
+  const ContentIndexKey key = {
+      device_id, xuid, title_id,
+      title_id == kCurrentlyRunningTitleId ? kernel_state_->title_id()
+                                           : title_id,
+      content_type};
+  {
+    std::lock_guard<std::mutex> lock(content_index_lock_);
+    auto it = content_index_.find(key);
+    if (it != content_index_.end()) {
+      const ContentIndexEntry& entry = it->second;
+      if (std::all_of(entry.dependencies.cbegin(), entry.dependencies.cend(),
+                      [](const ContentIndexDependency& dependency) {
+                        return GetContentIndexDependency(dependency.path)
+                                   .write_time == dependency.write_time;
+                      })) {
+        return entry.content;
+      }
+      content_index_.erase(it);
+    }
+  }
+
+  ContentIndexEntry entry;
+  entry.content =
+      ScanContent(device_id, xuid, title_id, content_type, entry.dependencies);
+  std::lock_guard<std::mutex> lock(content_index_lock_);
+  return content_index_.insert_or_assign(key, std::move(entry))
+      .first->second.content;
+}
+
+ContentManager::ContentIndexDependency
+ContentManager::GetContentIndexDependency(const std::filesystem::path& path) {
+  std::error_code error_code;
+  std::filesystem::file_time_type write_time =
+      std::filesystem::last_write_time(path, error_code);
+  if (error_code) {
+    // Doesn't exist (yet).
+    write_time = std::filesystem::file_time_type::min();
+  }
+  return {path, write_time};
+}
+
+void ContentManager::InvalidateContentIndex() {
+  std::lock_guard<std::mutex> lock(content_index_lock_);
+  content_index_.clear();
+}
+
+std::vector<XCONTENT_AGGREGATE_DATA> ContentManager::ScanContent(
+    const uint32_t device_id, const uint64_t xuid, const uint32_t title_id,
+    const XContentType content_type,
+    std::vector<ContentIndexDependency>& dependencies) const {
   std::vector<XCONTENT_AGGREGATE_DATA> result;
 
   std::unordered_set<uint32_t> title_ids = {title_id};
 
   if (content_type == XContentType::kPublisher) {
+    // The publisher directories are found in the XUID directory.
+    dependencies.push_back(
+        GetContentIndexDependency(root_path_ / fmt::format("{:016X}", xuid)));
     title_ids = FindPublisherTitleIds(xuid, title_id);
   }
 
@@ -207,6 +261,10 @@ std::vector<XCONTENT_AGGREGATE_DATA> ContentManager::ListContent(
     // Search path:
     // content_root/xuid/title_id/type_name/*
     auto package_root = ResolvePackageRoot(xuid, title_id, content_type);
+    dependencies.push_back(GetContentIndexDependency(package_root));
+    dependencies.push_back(GetContentIndexDependency(
+        ResolvePackageHeaderPath("", xuid, title_id, content_type)
+            .parent_path()));
     auto file_infos = xe::filesystem::ListFiles(package_root);
 
     for (const auto& file_info : file_infos) {
@@ -276,6 +334,7 @@ X_RESULT ContentManager::WriteContentHeaderFile(const uint64_t xuid,
   }
 
   xe::filesystem::CreateEmptyFile(header_path);
+  InvalidateContentIndex();
 
   if (std::filesystem::exists(header_path)) {
     auto file = xe::filesystem::OpenFile(header_path, "wb");
@@ -338,6 +397,8 @@ X_RESULT ContentManager::CreateContent(const std::string_view root_name,
     return X_ERROR_ACCESS_DENIED;
   }
 
+  InvalidateContentIndex();
+
   auto package = ResolvePackage(root_name, xuid, data);
   assert_not_null(package);
 
@@ -440,6 +501,7 @@ X_RESULT ContentManager::DeleteContent(const uint64_t xuid,
   }
 
   auto package_path = ResolvePackagePath(xuid, data);
+  InvalidateContentIndex();
   if (std::filesystem::remove_all(package_path) > 0) {
     return X_ERROR_SUCCESS;
   } else {
@@ -10,8 +10,12 @@
 #ifndef XENIA_KERNEL_XAM_CONTENT_MANAGER_H_
 #define XENIA_KERNEL_XAM_CONTENT_MANAGER_H_
 
+#include <filesystem>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -196,9 +200,38 @@ class ContentManager {
       const uint64_t xuid,
       uint32_t base_title_id = kCurrentlyRunningTitleId) const;
 
+  // A directory whose entries an enumeration was built from, and its
+  // modification time at that point.
+  struct ContentIndexDependency {
+    std::filesystem::path path;
+    std::filesystem::file_time_type write_time;
+  };
+  struct ContentIndexEntry {
+    std::vector<XCONTENT_AGGREGATE_DATA> content;
+    std::vector<ContentIndexDependency> dependencies;
+  };
+  // Device, XUID, title ID as requested and resolved, and content type.
+  using ContentIndexKey =
+      std::tuple<uint32_t, uint64_t, uint32_t, uint32_t, XContentType>;
+
+  std::vector<XCONTENT_AGGREGATE_DATA> ScanContent(
+      const uint32_t device_id, const uint64_t xuid, const uint32_t title_id,
+      const XContentType content_type,
+      std::vector<ContentIndexDependency>& dependencies) const;
+  static ContentIndexDependency GetContentIndexDependency(
+      const std::filesystem::path& path);
+  void InvalidateContentIndex();
+
   KernelState* kernel_state_;
   std::filesystem::path root_path_;
 
+  // Enumerations of the packages, reused while none of the directories they
+  // have been built from has changed. Packages and headers created through the
+  // content manager clear it, as they may not change the directory times
+  // visibly within their resolution.
+  mutable std::mutex content_index_lock_;
+  mutable std::map<ContentIndexKey, ContentIndexEntry> content_index_;
+
   // TODO(benvanik): remove use of global lock, it's bad here!
   xe::global_critical_region global_critical_region_;
   std::unordered_map<string_key, ContentPackage*> open_packages_;
@@ -9,9 +9,12 @@
 
 #include "xenia/kernel/xam/user_profile.h"
 
+#include <cstring>
 #include <sstream>
 
 #include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
 #include "xenia/kernel/kernel_state.h"
 #include "xenia/kernel/util/shim_utils.h"
 
@@ -90,6 +93,19 @@ UserProfile::UserProfile(uint64_t xuid, X_XAMACCOUNTINFO* account_info)
   AddSetting(std::make_unique<UserSetting>(0x63E83FFD, std::vector<uint8_t>()));
 }
 
+UserProfile::~UserProfile() {
+  if (!writer_thread_) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(pending_writes_mutex_);
+    writer_shutdown_ = true;
+  }
+  pending_writes_cv_.notify_one();
+  // The writer flushes all the pending settings before exiting.
+  xe::threading::Wait(writer_thread_.get(), false);
+}
+
 void UserProfile::AddSetting(std::unique_ptr<UserSetting> setting) {
   UserSetting* previous_setting = setting.get();
 
@@ -129,43 +145,129 @@ UserSetting* UserProfile::GetSetting(uint32_t setting_id) {
   return setting;
 }
 
-void UserProfile::LoadSetting(UserSetting* setting) {
-  if (setting->is_title_specific()) {
-    const std::filesystem::path content_dir =
-        kernel_state()->content_manager()->ResolveGameUserContentPath(xuid_);
-    const std::string setting_id_str =
-        fmt::format("{:08X}", setting->GetSettingId());
-    const std::filesystem::path file_path = content_dir / setting_id_str;
-    FILE* file = xe::filesystem::OpenFile(file_path, "rb");
-    if (!file) {
-      return;
+std::filesystem::path UserProfile::GetSettingPath(uint32_t setting_id) const {
+  return kernel_state()->content_manager()->ResolveGameUserContentPath(xuid_) /
+         fmt::format("{:08X}", setting_id);
+}
+
+std::vector<uint8_t> UserProfile::ReadSettingRecord(
+    const std::filesystem::path& file_path, uint32_t setting_id) {
+  std::vector<uint8_t> record;
+  FILE* file = xe::filesystem::OpenFile(file_path, "rb");
+  if (!file) {
+    return record;
+  }
+
+  const uint32_t input_file_size =
+      static_cast<uint32_t>(std::filesystem::file_size(file_path));
+
+  if (input_file_size < sizeof(X_USER_PROFILE_SETTING_HEADER)) {
+    fclose(file);
+    // Setting seems to be invalid, remove it.
+    std::filesystem::remove(file_path);
+    return record;
+  }
+
+  record.resize(input_file_size);
+  record.resize(fread(record.data(), 1, record.size(), file));
+  fclose(file);
+  X_USER_PROFILE_SETTING_HEADER header;
+  std::memcpy(&header, record.data(), sizeof(header));
+  if (header.setting_id != setting_id) {
+    // It's setting with different ID? Corrupted perhaps.
+    std::filesystem::remove(file_path);
+    record.clear();
+  }
+  return record;
+}
+
+void UserProfile::QueueSettingWrite(const std::filesystem::path& file_path,
+                                    std::vector<uint8_t> record) {
+  {
+    std::lock_guard<std::mutex> lock(pending_writes_mutex_);
+    pending_writes_[file_path] = std::move(record);
+  }
+  pending_writes_cv_.notify_one();
+  if (!writer_thread_) {
+    writer_thread_ =
+        xe::threading::Thread::Create({}, [this]() { WriteSettings(); });
+    if (writer_thread_) {
+      writer_thread_->set_name("Profile Setting Writer");
+    } else {
+      XELOGE("Failed to create the profile setting writer thread");
+      WriteSettings();
     }
+  }
+}
 
-    const uint32_t input_file_size =
-        static_cast<uint32_t>(std::filesystem::file_size(file_path));
+void UserProfile::WriteSettings() {
+  std::unique_lock<std::mutex> lock(pending_writes_mutex_);
+  while (true) {
+    pending_writes_cv_.wait(lock, [this]() {
+      return !pending_writes_.empty() || writer_shutdown_ || !writer_thread_;
+    });
+    if (pending_writes_.empty()) {
+      // Either shutting down, or flushing synchronously without a thread.
+      break;
+    }
+    std::map<std::filesystem::path, std::vector<uint8_t>> writes;
+    writes.swap(pending_writes_);
+    lock.unlock();
+    for (const auto& write : writes) {
+      const std::filesystem::path& file_path = write.first;
+      std::filesystem::create_directories(file_path.parent_path());
+      // Written to a temporary file replacing the setting once complete, so
+      // the previous value is kept if the emulator exits while writing.
+      std::filesystem::path temp_path = file_path;
+      temp_path += ".tmp";
+      FILE* file = xe::filesystem::OpenFile(temp_path, "wb");
+      if (!file) {
+        XELOGE("Failed to write the profile setting {}",
+               xe::path_to_utf8(file_path));
+        continue;
+      }
+      bool written = fwrite(write.second.data(), 1, write.second.size(),
+                            file) == write.second.size();
+      written &= fclose(file) == 0;
+      std::error_code ec;
+      if (written) {
+        std::filesystem::rename(temp_path, file_path, ec);
+      }
+      if (!written || ec) {
+        XELOGE("Failed to write the profile setting {}",
+               xe::path_to_utf8(file_path));
+        std::filesystem::remove(temp_path, ec);
+      }
+    }
+    lock.lock();
+  }
+}
 
-    if (input_file_size < sizeof(X_USER_PROFILE_SETTING_HEADER)) {
-      fclose(file);
-      // Setting seems to be invalid, remove it.
-      std::filesystem::remove(file_path);
+void UserProfile::LoadSetting(UserSetting* setting) {
+  if (setting->is_title_specific()) {
+    const std::filesystem::path file_path =
+        GetSettingPath(setting->GetSettingId());
+    auto record_it = setting_records_.find(file_path);
+    if (record_it == setting_records_.end()) {
+      std::vector<uint8_t> record =
+          ReadSettingRecord(file_path, setting->GetSettingId());
+      record_it = setting_records_.emplace(file_path, std::move(record)).first;
+    }
+    const std::vector<uint8_t>& record = record_it->second;
+    if (record.empty()) {
       return;
     }
 
     X_USER_PROFILE_SETTING_HEADER header;
-    fread(&header, sizeof(X_USER_PROFILE_SETTING_HEADER), 1, file);
-    if (header.setting_id != setting->GetSettingId()) {
-      // It's setting with different ID? Corrupted perhaps.
-      fclose(file);
-      std::filesystem::remove(file_path);
-      return;
-    }
+    std::memcpy(&header, record.data(), sizeof(header));
 
     // TODO(Gliniak): Right now we only care about CONTENT, WSTRING, BINARY
     setting->SetNewSettingHeader(&header);
     setting->SetNewSettingSource(X_USER_PROFILE_SETTING_SOURCE::TITLE);
     std::vector<uint8_t> serialized_data(setting->GetSettingHeader()->size);
-    fread(serialized_data.data(), 1, serialized_data.size(), file);
-    fclose(file);
+    std::memcpy(
+        serialized_data.data(), record.data() + sizeof(header),
+        std::min(serialized_data.size(), record.size() - sizeof(header)));
     setting->GetSettingData()->Deserialize(serialized_data);
   } else {
     // Unsupported for now.  Other settings aren't per-game and need to be
@@ -177,30 +279,22 @@ void UserProfile::LoadSetting(UserSetting* setting) {
 void UserProfile::SaveSetting(UserSetting* setting) {
   if (setting->is_title_specific() &&
       setting->GetSettingSource() == X_USER_PROFILE_SETTING_SOURCE::TITLE) {
-    const std::filesystem::path content_dir =
-        kernel_state()->content_manager()->ResolveGameUserContentPath(xuid_);
-
-    std::filesystem::create_directories(content_dir);
-
-    const std::string setting_id_str =
-        fmt::format("{:08X}", setting->GetSettingId());
-    std::filesystem::path file_path = content_dir / setting_id_str;
-    FILE* file = xe::filesystem::OpenFile(file_path, "wb");
-
-    if (!file) {
-      return;
-    }
+    const std::filesystem::path file_path =
+        GetSettingPath(setting->GetSettingId());
 
     const std::vector<uint8_t> serialized_setting =
         setting->GetSettingData()->Serialize();
     const uint32_t serialized_setting_length = std::min(
         kMaxSettingSize, static_cast<uint32_t>(serialized_setting.size()));
 
-    fwrite(setting->GetSettingHeader(), sizeof(X_USER_PROFILE_SETTING_HEADER),
-           1, file);
-    // Writing data
-    fwrite(serialized_setting.data(), 1, serialized_setting_length, file);
-    fclose(file);
+    std::vector<uint8_t> record(sizeof(X_USER_PROFILE_SETTING_HEADER) +
+                                serialized_setting_length);
+    std::memcpy(record.data(), setting->GetSettingHeader(),
+                sizeof(X_USER_PROFILE_SETTING_HEADER));
+    std::memcpy(record.data() + sizeof(X_USER_PROFILE_SETTING_HEADER),
+                serialized_setting.data(), serialized_setting_length);
+    setting_records_[file_path] = record;
+    QueueSettingWrite(file_path, std::move(record));
   } else {
     // Unsupported for now.  Other settings aren't per-game and need to be
     // stored some other way.
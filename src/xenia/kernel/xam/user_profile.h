@@ -10,13 +10,17 @@
 #ifndef XENIA_KERNEL_XAM_USER_PROFILE_H_
 #define XENIA_KERNEL_XAM_USER_PROFILE_H_
 
+#include <condition_variable>
+#include <filesystem>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "xenia/base/byte_stream.h"
+#include "xenia/base/threading.h"
 #include "xenia/kernel/util/property.h"
 #include "xenia/kernel/util/xuserdata.h"
 #include "xenia/xbox.h"
@@ -154,6 +158,7 @@ class UserSetting {
 class UserProfile {
  public:
   UserProfile(uint64_t xuid, X_XAMACCOUNTINFO* account_info);
+  ~UserProfile();
 
   uint64_t xuid() const { return xuid_; }
   std::string name() const { return account_info_.GetGamertagString(); }
@@ -177,6 +182,27 @@ class UserProfile {
 
   std::vector<Property> properties_;
 
+  // Header and serialized data of the title-specific settings, as stored in
+  // their files, by the file path. Empty if the file doesn't exist, so the
+  // disk is only accessed the first time a setting is requested for a title.
+  std::map<std::filesystem::path, std::vector<uint8_t>> setting_records_;
+
+  // Settings written by the title, flushed to the disk by the writer thread,
+  // so the title doesn't wait for the file system. Writing the same setting
+  // again before it's flushed only replaces the pending record.
+  std::mutex pending_writes_mutex_;
+  std::condition_variable pending_writes_cv_;
+  std::map<std::filesystem::path, std::vector<uint8_t>> pending_writes_;
+  bool writer_shutdown_ = false;
+  std::unique_ptr<xe::threading::Thread> writer_thread_;
+
+  std::filesystem::path GetSettingPath(uint32_t setting_id) const;
+  static std::vector<uint8_t> ReadSettingRecord(
+      const std::filesystem::path& file_path, uint32_t setting_id);
+  void QueueSettingWrite(const std::filesystem::path& file_path,
+                         std::vector<uint8_t> record);
+  void WriteSettings();
+
   void LoadSetting(UserSetting*);
   void SaveSetting(UserSetting*);
 };
@@ -126,7 +126,11 @@ dword_result_t XamInputGetState_entry(dword_t user_index, dword_t flags,
   }
 
   auto input_system = kernel_state()->emulator()->input_system();
-  auto lock = input_system->lock();
+  // A lock-free copy of the latest state with the input polling thread.
+  std::unique_lock<xe_unlikely_mutex> lock;
+  if (!input_system->is_polling_thread_active()) {
+    lock = input_system->lock();
+  }
   return input_system->GetState(user_index, input_state);
 }
 DECLARE_XAM_EXPORT2(XamInputGetState, kInput, kImplemented, kHighFrequency);
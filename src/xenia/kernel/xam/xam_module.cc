@@ -27,6 +27,9 @@ XamModule::XamModule(Emulator* emulator, KernelState* kernel_state)
     : KernelModule(kernel_state, "xe:\\xam.xex"), loader_data_() {
   RegisterExportTable(export_resolver_);
 
+  // Started only when the title issues an overlapped receive.
+  socket_reactor_ = std::make_unique<XSocketReactor>();
+
   // Register all exported functions.
 #define XE_MODULE_EXPORT_GROUP(m, n) \
   Register##n##Exports(export_resolver_, kernel_state_);
@@ -10,12 +10,14 @@
 #ifndef XENIA_KERNEL_XAM_XAM_MODULE_H_
 #define XENIA_KERNEL_XAM_XAM_MODULE_H_
 
+#include <memory>
 #include <string>
 
 #include "xenia/cpu/export_resolver.h"
 #include "xenia/kernel/kernel_module.h"
 #include "xenia/kernel/kernel_state.h"
 #include "xenia/kernel/xam/xam_ordinals.h"
+#include "xenia/kernel/xsocket_reactor.h"
 
 namespace xe {
 namespace kernel {
@@ -48,8 +50,11 @@ class XamModule : public KernelModule {
   const LoaderData& loader_data() const { return loader_data_; }
   LoaderData& loader_data() { return loader_data_; }
 
+  XSocketReactor* socket_reactor() const { return socket_reactor_.get(); }
+
  private:
   LoaderData loader_data_;
+  std::unique_ptr<XSocketReactor> socket_reactor_;
 };
 
 }  // namespace xam
@@ -7,9 +7,12 @@
  ******************************************************************************
  */
 
+#include <atomic>
 #include <cstring>
+#include <vector>
 
 #include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/kernel/kernel_state.h"
 #include "xenia/kernel/util/shim_utils.h"
@@ -19,6 +22,7 @@
 #include "xenia/kernel/xboxkrnl/xboxkrnl_threading.h"
 #include "xenia/kernel/xevent.h"
 #include "xenia/kernel/xsocket.h"
+#include "xenia/kernel/xsocket_reactor.h"
 #include "xenia/kernel/xthread.h"
 #include "xenia/xbox.h"
 
@@ -33,6 +37,13 @@
 #include <sys/socket.h>
 #endif
 
+DEFINE_bool(network_overlapped_recv, true,
+            "Complete overlapped WSARecvFrom calls when data arrives on the "
+            "socket, receiving on a host thread. If disabled, WSARecvFrom "
+            "always fails, which may help titles that wait for packets that "
+            "will never come.",
+            "Kernel");
+
 namespace xe {
 namespace kernel {
 namespace xam {
@@ -316,25 +327,168 @@ dword_result_t NetDll_WSAGetLastError_entry() {
 }
 DECLARE_XAM_EXPORT1(NetDll_WSAGetLastError, kNetworking, kImplemented);
 
+void StoreRecvFromAddress(const N_XSOCKADDR_IN& native_from,
+                          uint32_t native_from_len, XSOCKADDR_IN* from,
+                          xe::be<uint32_t>* from_len) {
+  if (from) {
+    from->sin_family = native_from.sin_family;
+    from->sin_port = native_from.sin_port;
+    from->sin_addr = native_from.sin_addr;
+    std::memset(from->x_sin_zero, 0, sizeof(from->x_sin_zero));
+  }
+  if (from_len) {
+    *from_len = native_from_len;
+  }
+}
+
+// For overlapped socket operations, internal is X_STATUS_PENDING until the
+// operation is completed, then X_STATUS_SUCCESS or X_STATUS_UNSUCCESSFUL with
+// the WSA error code in offset.low (the offset is not used for sockets), and
+// internal_high is the number of bytes transferred.
 dword_result_t NetDll_WSARecvFrom_entry(
-    dword_t caller, dword_t socket, pointer_t<XWSABUF> buffers_ptr,
+    dword_t caller, dword_t socket_handle, pointer_t<XWSABUF> buffers_ptr,
     dword_t buffer_count, lpdword_t num_bytes_recv, lpdword_t flags_ptr,
-    pointer_t<XSOCKADDR_IN> from_addr, pointer_t<XWSAOVERLAPPED> overlapped_ptr,
+    pointer_t<XSOCKADDR_IN> from_ptr, lpdword_t from_len_ptr,
+    pointer_t<XWSAOVERLAPPED> overlapped_ptr,
     lpvoid_t completion_routine_ptr) {
-  if (overlapped_ptr) {
-    // auto evt = kernel_state()->object_table()->LookupObject<XEvent>(
-    //    overlapped_ptr->event_handle);
+  if (!cvars::network_overlapped_recv) {
+    // we're not going to be receiving packets any time soon
+    // return error so we don't wait on that - Cancerous
+    return -1;
+  }
 
-    // if (evt) {
-    //  //evt->Set(0, false);
-    //}
+  if (completion_routine_ptr) {
+    // The completion routine takes 4 arguments, so it can't be called as an
+    // APC normal routine directly.
+    XELOGW("NetDll_WSARecvFrom: Completion routines are not supported");
+    XThread::SetLastError(uint32_t(X_WSAError::X_WSAEINVAL));
+    return -1;
   }
 
-  // we're not going to be receiving packets any time soon
-  // return error so we don't wait on that - Cancerous
+  auto socket =
+      kernel_state()->object_table()->LookupObject<XSocket>(socket_handle);
+  if (!socket) {
+    XThread::SetLastError(uint32_t(X_WSAError::X_WSAENOTSOCK));
+    return -1;
+  }
+
+  // Receiving directly into the guest buffers.
+  std::vector<XSocket::RecvBuffer> buffers(buffer_count);
+  for (uint32_t i = 0; i < buffer_count; ++i) {
+    buffers[i].data =
+        kernel_memory()->TranslateVirtual<uint8_t*>(buffers_ptr[i].buf_ptr);
+    buffers[i].length = buffers_ptr[i].len;
+  }
+  uint32_t flags = flags_ptr ? flags_ptr.value() : 0;
+  XSOCKADDR_IN* from = from_ptr;
+  xe::be<uint32_t>* from_len = from_len_ptr;
+
+  if (!overlapped_ptr) {
+    N_XSOCKADDR_IN native_from;
+    uint32_t native_from_len = sizeof(XSOCKADDR_IN);
+    int ret = socket->RecvFromBuffers(buffers, flags, &native_from,
+                                      &native_from_len);
+    if (ret < 0) {
+      XThread::SetLastError(socket->GetLastWSAError());
+      return -1;
+    }
+    StoreRecvFromAddress(native_from, native_from_len, from, from_len);
+    if (num_bytes_recv) {
+      *num_bytes_recv = uint32_t(ret);
+    }
+    if (flags_ptr) {
+      *flags_ptr = 0;
+    }
+    return 0;
+  }
+
+  // Completed on the reactor thread when the socket becomes readable, the
+  // guest waits for the event or polls internal.
+  XWSAOVERLAPPED* overlapped = overlapped_ptr;
+  overlapped->internal_high = 0;
+  overlapped->internal = X_STATUS_PENDING;
+  uint32_t event_handle = overlapped->event_handle;
+  if (event_handle) {
+    xboxkrnl::xeNtClearEvent(event_handle);
+  }
+  auto xam = kernel_state()->GetKernelModule<XamModule>("xam.xex");
+  if (!xam->socket_reactor()->QueueRecv(
+          socket, std::move(buffers), flags,
+          [overlapped, from, from_len,
+           event_handle](const XSocketReactor::RecvResult& result) {
+            if (result.result >= 0) {
+              StoreRecvFromAddress(result.from, result.from_len, from,
+                                   from_len);
+              overlapped->internal_high = uint32_t(result.result);
+            } else {
+              overlapped->offset.low = result.error;
+            }
+            std::atomic_thread_fence(std::memory_order_release);
+            overlapped->internal = result.result >= 0 ? X_STATUS_SUCCESS
+                                                      : X_STATUS_UNSUCCESSFUL;
+            if (event_handle) {
+              auto event =
+                  kernel_state()->object_table()->LookupObject<XEvent>(
+                      event_handle);
+              if (event) {
+                event->Set(0, false);
+              }
+            }
+          })) {
+    overlapped->internal = X_STATUS_UNSUCCESSFUL;
+    XThread::SetLastError(uint32_t(X_WSAError::X_WSAENOBUFS));
+    return -1;
+  }
+  XThread::SetLastError(uint32_t(X_WSAError::X_WSA_IO_PENDING));
   return -1;
 }
-DECLARE_XAM_EXPORT2(NetDll_WSARecvFrom, kNetworking, kStub, kHighFrequency);
+DECLARE_XAM_EXPORT2(NetDll_WSARecvFrom, kNetworking, kImplemented,
+                    kHighFrequency);
+
+dword_result_t NetDll_WSAGetOverlappedResult_entry(
+    dword_t caller, dword_t socket_handle,
+    pointer_t<XWSAOVERLAPPED> overlapped_ptr, lpdword_t bytes_transferred_ptr,
+    dword_t wait, lpdword_t flags_ptr) {
+  if (!overlapped_ptr) {
+    XThread::SetLastError(uint32_t(X_WSAError::X_WSAEFAULT));
+    return 0;
+  }
+
+  if (overlapped_ptr->internal == X_STATUS_PENDING) {
+    if (!wait || !overlapped_ptr->event_handle) {
+      XThread::SetLastError(uint32_t(X_WSAError::X_WSA_IO_INCOMPLETE));
+      return 0;
+    }
+    X_STATUS result;
+    do {
+      result = xboxkrnl::NtWaitForSingleObjectEx(overlapped_ptr->event_handle,
+                                                 1, 0, nullptr);
+    } while (result == X_STATUS_ALERTED);
+    if (XFAILED(result)) {
+      XThread::SetLastError(xboxkrnl::xeRtlNtStatusToDosError(result));
+      return 0;
+    }
+    if (overlapped_ptr->internal == X_STATUS_PENDING) {
+      // The event was set by something else.
+      XThread::SetLastError(uint32_t(X_WSAError::X_WSA_IO_INCOMPLETE));
+      return 0;
+    }
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  if (bytes_transferred_ptr) {
+    *bytes_transferred_ptr = overlapped_ptr->internal_high;
+  }
+  if (flags_ptr) {
+    *flags_ptr = 0;
+  }
+  if (overlapped_ptr->internal != X_STATUS_SUCCESS) {
+    XThread::SetLastError(overlapped_ptr->offset.low);
+    return 0;
+  }
+  return 1;
+}
+DECLARE_XAM_EXPORT1(NetDll_WSAGetOverlappedResult, kNetworking, kImplemented);
 
 // If the socket is a VDP socket, buffer 0 is the game data length, and buffer 1
 // is the unencrypted game data.
@@ -671,6 +825,10 @@ dword_result_t NetDll_closesocket_entry(dword_t caller, dword_t socket_handle) {
     return -1;
   }
 
+  // Aborting the overlapped receives before the host socket is closed.
+  auto xam = kernel_state()->GetKernelModule<XamModule>("xam.xex");
+  xam->socket_reactor()->CancelSocket(socket.get());
+
   // TODO: Absolutely delete this object. It is no longer valid after calling
   // closesocket.
   socket->Close();
@@ -979,15 +1137,7 @@ dword_result_t NetDll_recvfrom_entry(dword_t caller, dword_t socket_handle,
   int ret = socket->RecvFrom(buf_ptr, buf_len, flags, &native_from,
                              fromlen_ptr ? &native_fromlen : 0);
 
-  if (from_ptr) {
-    from_ptr->sin_family = native_from.sin_family;
-    from_ptr->sin_port = native_from.sin_port;
-    from_ptr->sin_addr = native_from.sin_addr;
-    std::memset(from_ptr->x_sin_zero, 0, sizeof(from_ptr->x_sin_zero));
-  }
-  if (fromlen_ptr) {
-    *fromlen_ptr = native_fromlen;
-  }
+  StoreRecvFromAddress(native_from, native_fromlen, from_ptr, fromlen_ptr);
 
   if (ret == -1) {
     XThread::SetLastError(socket->GetLastWSAError());
@@ -274,6 +274,8 @@ class MessageBoxDialog : public XamDialog {
 
   uint32_t chosen_button() const { return chosen_button_; }
 
+  bool ChangesOnlyOnInput() const override { return true; }
+
   void OnDraw(ImGuiIO& io) override {
     bool first_draw = false;
     if (!has_opened_) {
@@ -7,9 +7,13 @@
  ******************************************************************************
  */
 
+#include <atomic>
+
+#include "xenia/base/clock.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/memory.h"
 #include "xenia/base/mutex.h"
+#include "xenia/base/profiling.h"
 #include "xenia/cpu/processor.h"
 #include "xenia/kernel/info/file.h"
 #include "xenia/kernel/kernel_state.h"
@@ -125,6 +129,47 @@ dword_result_t NtOpenFile_entry(
 }
 DECLARE_XBOXKRNL_EXPORT1(NtOpenFile, kFileSystem, kImplemented);
 
+// Performs an overlapped read on one of the file I/O threads, completing the
+// I/O status block, the APC, the completion ports and the event there.
+// Returns false if the read must be done immediately instead.
+static bool QueueAsyncRead(object_ref<XFile> file, object_ref<XEvent> ev,
+                           uint32_t apc_routine, uint32_t apc_context,
+                           uint32_t io_status_block_ptr, uint32_t buffer_ptr,
+                           uint32_t buffer_length, uint64_t byte_offset) {
+  auto thread = retain_object(XThread::GetCurrentThread());
+  if (byte_offset == uint64_t(-1)) {
+    byte_offset = file->position();
+  }
+  uint64_t queue_host_ticks = Clock::QueryHostTickCount();
+  return kernel_state()->QueueFileIO([file, ev, thread, apc_routine,
+                                      apc_context, io_status_block_ptr,
+                                      buffer_ptr, buffer_length, byte_offset,
+                                      queue_host_ticks]() {
+    uint32_t bytes_read = 0;
+    X_STATUS result = file->Read(buffer_ptr, buffer_length, byte_offset,
+                                 &bytes_read, apc_context, false);
+    if (io_status_block_ptr) {
+      auto io_status_block =
+          kernel_memory()->TranslateVirtual<X_IO_STATUS_BLOCK*>(
+              io_status_block_ptr);
+      io_status_block->information = bytes_read;
+      // The guest may be polling the status.
+      std::atomic_thread_fence(std::memory_order_release);
+      io_status_block->status = result;
+    }
+    if (apc_routine && apc_context) {
+      thread->EnqueueApc(apc_routine, apc_context, io_status_block_ptr, 0);
+    }
+    file->CompleteIO(apc_context, bytes_read, result);
+    if (ev) {
+      ev->Set(0, false);
+    }
+    COUNT_profile_set("kernel/file_io/read_latency_us",
+                      (Clock::QueryHostTickCount() - queue_host_ticks) *
+                          1000000 / Clock::QueryHostTickFrequency());
+  });
+}
+
 dword_result_t NtReadFile_entry(dword_t file_handle, dword_t event_handle,
                                 lpvoid_t apc_routine_ptr, lpvoid_t apc_context,
                                 pointer_t<X_IO_STATUS_BLOCK> io_status_block,
@@ -143,6 +188,26 @@ dword_result_t NtReadFile_entry(dword_t file_handle, dword_t event_handle,
     result = X_STATUS_INVALID_HANDLE;
   }
 
+  if (XSUCCEEDED(result) && !file->is_synchronous()) {
+    // Not signaled until the asynchronous completion.
+    file->BeginAsyncIO();
+    if (ev) {
+      ev->Reset();
+    }
+    if (io_status_block) {
+      io_status_block->status = X_STATUS_PENDING;
+      io_status_block->information = 0;
+    }
+    if (QueueAsyncRead(
+            file, ev, static_cast<uint32_t>(apc_routine_ptr) & ~1u,
+            apc_context, io_status_block.guest_address(),
+            buffer.guest_address(), buffer_length,
+            byte_offset_ptr ? static_cast<uint64_t>(*byte_offset_ptr)
+                            : uint64_t(-1))) {
+      return X_STATUS_PENDING;
+    }
+  }
+
   if (XSUCCEEDED(result)) {
     if (true || file->is_synchronous()) {
       // Synchronous.
@@ -536,6 +601,12 @@ dword_result_t NtFlushBuffersFile_entry(
     dword_t file_handle, pointer_t<X_IO_STATUS_BLOCK> io_status_block_ptr) {
   auto result = X_STATUS_SUCCESS;
 
+  // Writes may be buffered before reaching the host files.
+  auto file = kernel_state()->object_table()->LookupObject<XFile>(file_handle);
+  if (file) {
+    result = file->Flush();
+  }
+
   if (io_status_block_ptr) {
     io_status_block_ptr->status = result;
     io_status_block_ptr->information = 0;
@@ -543,7 +614,7 @@ dword_result_t NtFlushBuffersFile_entry(
 
   return result;
 }
-DECLARE_XBOXKRNL_EXPORT1(NtFlushBuffersFile, kFileSystem, kStub);
+DECLARE_XBOXKRNL_EXPORT1(NtFlushBuffersFile, kFileSystem, kImplemented);
 
 // https://docs.microsoft.com/en-us/windows/win32/devnotes/ntopensymboliclinkobject
 dword_result_t NtOpenSymbolicLinkObject_entry(
@@ -10,12 +10,16 @@
 #include "xenia/kernel/xboxkrnl/xboxkrnl_rtl.h"
 
 #include <algorithm>
+#include <atomic>
 #include <string>
 
 #include "third_party/pe/pe_image.h"
 #include "xenia/base/atomic.h"
 #include "xenia/base/chrono.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
+#include "xenia/base/memory.h"
+#include "xenia/base/profiling.h"
 #include "xenia/base/string.h"
 #include "xenia/base/threading.h"
 #include "xenia/kernel/kernel_state.h"
@@ -25,6 +29,14 @@
 #include "xenia/kernel/xboxkrnl/xboxkrnl_threading.h"
 #include "xenia/kernel/xevent.h"
 #include "xenia/kernel/xthread.h"
+
+DEFINE_int32(critical_section_spin_count, 0,
+             "Number of times to try to acquire a contended guest critical "
+             "section initialized without a spin count before waiting for it. "
+             "Spinning avoids putting the thread to sleep for critical "
+             "sections held for a short time, at the expense of CPU time.",
+             "Kernel");
+
 namespace xe {
 namespace kernel {
 namespace xboxkrnl {
@@ -36,41 +48,19 @@ struct X_STRING {
 // https://msdn.microsoft.com/en-us/library/ff561778
 dword_result_t RtlCompareMemory_entry(lpvoid_t source1, lpvoid_t source2,
                                       dword_t length) {
-  uint8_t* p1 = source1;
-  uint8_t* p2 = source2;
-
-  // Note that the return value is the number of bytes that match, so it's best
-  // we just do this ourselves vs. using memcmp.
-  // On Windows we could use the builtin function.
-
-  uint32_t c = 0;
-  for (uint32_t n = 0; n < length; n++, p1++, p2++) {
-    if (*p1 == *p2) {
-      c++;
-    }
-  }
-
-  return c;
+  // The return value is the number of bytes that match before the first
+  // difference, so memcmp can't be used.
+  return uint32_t(xe::count_matching_prefix(
+      source1.as<uint8_t*>(), source2.as<uint8_t*>(), length));
 }
 DECLARE_XBOXKRNL_EXPORT1(RtlCompareMemory, kMemory, kImplemented);
 
 // https://msdn.microsoft.com/en-us/library/ff552123
 dword_result_t RtlCompareMemoryUlong_entry(lpvoid_t source, dword_t length,
                                            dword_t pattern) {
-  uint32_t num_compared_bytes = 0;
-
-  uint32_t swapped_pattern = xe::byte_swap(pattern.value());
-
-  char* host_source = (char*)source.host_address();
-
-  for (uint32_t aligned_length = length & 0xFFFFFFFCU; aligned_length;
-       num_compared_bytes += 4) {
-    if (*(uint32_t*)(host_source + num_compared_bytes) != swapped_pattern) {
-      break;
-    }
-    aligned_length = aligned_length - 4;
-  }
-  return num_compared_bytes;
+  size_t matching_count = xe::count_matching_prefix_32(
+      source.as<uint32_t*>(), length >> 2, xe::byte_swap(pattern.value()));
+  return uint32_t(matching_count * 4);
 }
 DECLARE_XBOXKRNL_EXPORT1(RtlCompareMemoryUlong, kMemory, kImplemented);
 
@@ -78,13 +68,8 @@ DECLARE_XBOXKRNL_EXPORT1(RtlCompareMemoryUlong, kMemory, kImplemented);
 void RtlFillMemoryUlong_entry(lpvoid_t destination, dword_t length,
                               dword_t pattern) {
   // NOTE: length must be % 4, so we can work on uint32s.
-  uint32_t count = length >> 2;
-
-  uint32_t* p = destination.as<uint32_t*>();
-  uint32_t swapped_pattern = xe::byte_swap(pattern.value());
-  for (uint32_t n = 0; n < count; n++, p++) {
-    *p = swapped_pattern;
-  }
+  xe::fill_32(destination.as<uint32_t*>(), length >> 2,
+              xe::byte_swap(pattern.value()));
 }
 DECLARE_XBOXKRNL_EXPORT1(RtlFillMemoryUlong, kMemory, kImplemented);
 
@@ -589,6 +574,10 @@ static void CriticalSectionPrefetchW(const void* vp) {
 #endif
 }
 
+// Only updated on the slow paths of RtlEnterCriticalSection.
+static std::atomic<uint64_t> critical_section_spin_acquisition_count{0};
+static std::atomic<uint64_t> critical_section_wait_count{0};
+
 void RtlEnterCriticalSection_entry(pointer_t<X_RTL_CRITICAL_SECTION> cs) {
   if (!cs.guest_address()) {
     XELOGE("Null critical section in RtlEnterCriticalSection!");
@@ -597,6 +586,9 @@ void RtlEnterCriticalSection_entry(pointer_t<X_RTL_CRITICAL_SECTION> cs) {
   CriticalSectionPrefetchW(&cs->lock_count);
   uint32_t cur_thread = XThread::GetCurrentThread()->guest_object();
   uint32_t spin_count = cs->header.absolute * 256;
+  if (!spin_count && cvars::critical_section_spin_count > 0) {
+    spin_count = uint32_t(cvars::critical_section_spin_count);
+  }
 
   if (cs->owning_thread == cur_thread) {
     // We already own the lock.
@@ -605,17 +597,39 @@ void RtlEnterCriticalSection_entry(pointer_t<X_RTL_CRITICAL_SECTION> cs) {
     return;
   }
 
+  if (xe::atomic_cas(-1, 0, &cs->lock_count)) {
+    // Acquired without contention.
+    cs->owning_thread = cur_thread;
+    cs->recursion_count = 1;
+    return;
+  }
+
   // Spin loop
   while (spin_count--) {
-    if (xe::atomic_cas(-1, 0, &cs->lock_count)) {
+#if XE_ARCH_AMD64 == 1
+    _mm_pause();
+#endif
+    // Only try to take the lock when it appears to be free not to steal the
+    // cache line from the owner.
+    if (*reinterpret_cast<volatile int32_t*>(&cs->lock_count) == -1 &&
+        xe::atomic_cas(-1, 0, &cs->lock_count)) {
       // Acquired.
       cs->owning_thread = cur_thread;
       cs->recursion_count = 1;
+      COUNT_profile_set(
+          "kernel/critical_section/spin_acquisitions",
+          critical_section_spin_acquisition_count.fetch_add(
+              1, std::memory_order_relaxed) +
+              1);
       return;
     }
   }
 
   if (xe::atomic_inc(&cs->lock_count) != 0) {
+    COUNT_profile_set(
+        "kernel/critical_section/waits",
+        critical_section_wait_count.fetch_add(1, std::memory_order_relaxed) +
+            1);
     // Create a full waiter.
     xeKeWaitForSingleObject(reinterpret_cast<void*>(cs.host_address()), 8, 0, 0,
                             nullptr);
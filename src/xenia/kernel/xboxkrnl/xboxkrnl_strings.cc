@@ -7,11 +7,15 @@
  ******************************************************************************
  */
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <cstring>
 #include <iomanip>
 #include <sstream>
 #include <string>
 
+#include "xenia/base/byte_order.h"
 #include "xenia/base/logging.h"
 #include "xenia/kernel/kernel_state.h"
 #include "xenia/kernel/user_module.h"
@@ -77,6 +81,9 @@ class ArgList {
   virtual uint64_t get64() = 0;
 };
 
+// The formatting is instantiated for the final FormatData and ArgList classes
+// so the calls for every character and argument are direct.
+//
 // Making the assumption that the Xbox 360's implementation of the
 // printf-functions matches what is described on MSDN's documentation for the
 // Windows CRT:
@@ -117,7 +124,8 @@ std::string format_double(double value, int32_t precision, uint16_t c,
   return temp.str();
 }
 
-int32_t format_core(PPCContext* ppc_context, FormatData& data, ArgList& args,
+template <typename Data, typename Args>
+int32_t format_core(PPCContext* ppc_context, Data& data, Args& args,
                     const bool wide) {
   int32_t count = 0;
 
@@ -682,44 +690,48 @@ int32_t format_core(PPCContext* ppc_context, FormatData& data, ArgList& args,
   return count;
 }
 
-class StackArgList : public ArgList {
+// The arguments past the registers are contiguous in the guest memory, so the
+// stack is translated only once rather than for every argument.
+class StackArgList final : public ArgList {
  public:
   StackArgList(PPCContext* ppc_context, int32_t index)
-      : ppc_context(ppc_context), index_(index) {}
+      : ppc_context(ppc_context),
+        stack_args_(ppc_context->TranslateVirtual<const xe::be<uint64_t>*>(
+            util::get_arg_stack_ptr(ppc_context, 0))),
+        index_(index) {}
 
   uint32_t get32() { return (uint32_t)get64(); }
 
   uint64_t get64() {
-    auto value = SHIM_GET_ARG_64(index_);
-    ++index_;
-    return value;
+    int32_t index = index_++;
+    if (index <= 7) {
+      return ppc_context->r[3 + index];
+    }
+    return stack_args_[index - 8];
   }
 
  private:
   PPCContext* ppc_context;
+  const xe::be<uint64_t>* stack_args_;
   int32_t index_;
 };
 
-class ArrayArgList : public ArgList {
+class ArrayArgList final : public ArgList {
  public:
   ArrayArgList(PPCContext* ppc_context, uint32_t arg_ptr)
-      : ppc_context(ppc_context), arg_ptr_(arg_ptr), index_(0) {}
+      : args_(ppc_context->TranslateVirtual<const xe::be<uint64_t>*>(arg_ptr)),
+        index_(0) {}
 
   uint32_t get32() { return (uint32_t)get64(); }
 
-  uint64_t get64() {
-    auto value = SHIM_MEM_64(arg_ptr_ + (8 * index_));
-    ++index_;
-    return value;
-  }
+  uint64_t get64() { return args_[index_++]; }
 
  private:
-  PPCContext* ppc_context;
-  uint32_t arg_ptr_;
+  const xe::be<uint64_t>* args_;
   int32_t index_;
 };
 
-class StringFormatData : public FormatData {
+class StringFormatData final : public FormatData {
  public:
   StringFormatData(const uint8_t* input) : input_(input) {}
 
@@ -756,7 +768,7 @@ class StringFormatData : public FormatData {
   std::string output_;
 };
 
-class WideStringFormatData : public FormatData {
+class WideStringFormatData final : public FormatData {
  public:
   WideStringFormatData(const uint16_t* input) : input_(input) {}
 
@@ -790,7 +802,7 @@ class WideStringFormatData : public FormatData {
   std::u16string output_;
 };
 
-class WideCountFormatData : public FormatData {
+class WideCountFormatData final : public FormatData {
  public:
   WideCountFormatData(const uint16_t* input) : input_(input), count_(0) {}
 
@@ -987,7 +999,7 @@ SHIM_CALL swprintf_entry(PPCContext* ppc_context) {
   StackArgList args(ppc_context, 2);
   WideStringFormatData data(format);
 
-  int32_t count = format_core(ppc_context, data, args, false);
+  int32_t count = format_core(ppc_context, data, args, true);
   if (count <= 0) {
     buffer[0] = '\0';
   } else {
@@ -1179,6 +1191,135 @@ SHIM_CALL vswprintf_entry(PPCContext* ppc_context) {
   }
   SHIM_SET_RETURN_32(count);
 }
+// Returns the length of the prefix of the string in the decimal
+// floating-point syntax of the CRT, including the leading whitespace, or 0 if
+// the string doesn't start with a number. Unlike the host CRT, the CRT of the
+// titles doesn't parse hexadecimal numbers, infinities and NaNs.
+size_t GetCrtDoubleLength(const char* str) {
+  const char* s = str;
+  while (std::isspace(uint8_t(*s))) {
+    ++s;
+  }
+  if (*s == '+' || *s == '-') {
+    ++s;
+  }
+  const char* digits = s;
+  while (*s >= '0' && *s <= '9') {
+    ++s;
+  }
+  bool has_digits = s != digits;
+  if (*s == '.') {
+    digits = ++s;
+    while (*s >= '0' && *s <= '9') {
+      ++s;
+    }
+    has_digits |= s != digits;
+  }
+  if (!has_digits) {
+    return 0;
+  }
+  if (*s == 'e' || *s == 'E') {
+    const char* exponent = s + 1;
+    if (*exponent == '+' || *exponent == '-') {
+      ++exponent;
+    }
+    if (*exponent >= '0' && *exponent <= '9') {
+      s = exponent;
+      while (*s >= '0' && *s <= '9') {
+        ++s;
+      }
+    }
+  }
+  return size_t(s - str);
+}
+
+double ParseCrtDouble(const char* str, size_t* length_out) {
+  size_t length = GetCrtDoubleLength(str);
+  *length_out = length;
+  if (!length) {
+    return 0.0;
+  }
+  return std::strtod(std::string(str, length).c_str(), nullptr);
+}
+
+// strtol and strtoul with the 32-bit long of the guest.
+uint32_t ParseCrtLong(const char* str, int base, bool is_signed,
+                      size_t* length_out) {
+  char* end;
+  uint32_t result;
+  if (is_signed) {
+    long long value = std::strtoll(str, &end, base);
+    result = uint32_t(int32_t(std::clamp(value, (long long)INT32_MIN,
+                                         (long long)INT32_MAX)));
+  } else {
+    // Like the guest, negative numbers are negated after the conversion, and
+    // numbers out of range become ULONG_MAX.
+    unsigned long long value = std::strtoull(str, &end, base);
+    const char* sign = str;
+    while (std::isspace(uint8_t(*sign))) {
+      ++sign;
+    }
+    bool is_negative = *sign == '-';
+    unsigned long long magnitude = is_negative ? 0 - value : value;
+    if (magnitude > UINT32_MAX) {
+      result = UINT32_MAX;
+    } else {
+      result = uint32_t(magnitude);
+      if (is_negative) {
+        result = 0 - result;
+      }
+    }
+  }
+  *length_out = size_t(end - str);
+  return result;
+}
+
+// Number parsing routines of the CRT statically linked into titles, replaced
+// by signature. Unlike the guest, they don't set errno.
+
+void GuestAtof(PPCContext* ppc_context) {
+  auto str = (const char*)SHIM_MEM_ADDR(SHIM_GET_ARG_32(0));
+  size_t length;
+  ppc_context->f[1] = str ? ParseCrtDouble(str, &length) : 0.0;
+}
+
+void GuestStrtod(PPCContext* ppc_context) {
+  uint32_t str_ptr = SHIM_GET_ARG_32(0);
+  uint32_t end_ptr = SHIM_GET_ARG_32(1);
+  size_t length = 0;
+  double value = 0.0;
+  if (str_ptr) {
+    value = ParseCrtDouble((const char*)SHIM_MEM_ADDR(str_ptr), &length);
+  }
+  if (end_ptr) {
+    SHIM_SET_MEM_32(end_ptr, str_ptr + uint32_t(length));
+  }
+  ppc_context->f[1] = value;
+}
+
+void GuestAtol(PPCContext* ppc_context) {
+  auto str = (const char*)SHIM_MEM_ADDR(SHIM_GET_ARG_32(0));
+  size_t length;
+  SHIM_SET_RETURN_32(str ? ParseCrtLong(str, 10, true, &length) : 0);
+}
+
+template <bool is_signed>
+void GuestStrtol(PPCContext* ppc_context) {
+  uint32_t str_ptr = SHIM_GET_ARG_32(0);
+  uint32_t end_ptr = SHIM_GET_ARG_32(1);
+  int32_t base = int32_t(SHIM_GET_ARG_32(2));
+  size_t length = 0;
+  uint32_t value = 0;
+  if (str_ptr) {
+    value = ParseCrtLong((const char*)SHIM_MEM_ADDR(str_ptr), base, is_signed,
+                         &length);
+  }
+  if (end_ptr) {
+    SHIM_SET_MEM_32(end_ptr, str_ptr + uint32_t(length));
+  }
+  ppc_context->r[3] = is_signed ? uint64_t(int64_t(int32_t(value))) : value;
+}
+
 #if 1
 void RegisterStringExports(xe::cpu::ExportResolver* export_resolver,
                            KernelState* state) {
@@ -1192,6 +1333,31 @@ void RegisterStringExports(xe::cpu::ExportResolver* export_resolver,
   SHIM_SET_MAPPING("xboxkrnl.exe", _vscwprintf, state);
   SHIM_SET_MAPPING("xboxkrnl.exe", vswprintf, state);
   SHIM_SET_MAPPING("xboxkrnl.exe", _vsnwprintf, state);
+
+  // The copies of the same routines in the CRT statically linked into titles.
+  static const struct {
+    const char* name;
+    xe::cpu::ExportTrampoline trampoline;
+  } kCrtRoutines[] = {
+      {"sprintf", sprintf_entry},
+      {"_snprintf", _snprintf_entry},
+      {"vsprintf", vsprintf_entry},
+      {"_vsnprintf", _vsnprintf_entry},
+      {"swprintf", swprintf_entry},
+      {"_snwprintf", _snwprintf_entry},
+      {"vswprintf", vswprintf_entry},
+      {"_vsnwprintf", (xe::cpu::ExportTrampoline)(void*)_vsnwprintf_entry},
+      {"_vscwprintf", (xe::cpu::ExportTrampoline)(void*)_vscwprintf_entry},
+      {"atof", GuestAtof},
+      {"strtod", GuestStrtod},
+      {"atoi", GuestAtol},
+      {"atol", GuestAtol},
+      {"strtol", GuestStrtol<true>},
+      {"strtoul", GuestStrtol<false>},
+  };
+  for (const auto& routine : kCrtRoutines) {
+    export_resolver->SetRoutineReplacement(routine.name, routine.trampoline);
+  }
 }
 #endif
 }  // namespace xboxkrnl
@@ -12,12 +12,16 @@
 #include <vector>
 #include "xenia/base/atomic.h"
 #include "xenia/base/clock.h"
+#include "xenia/base/concurrent_queue.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/mutex.h"
 #include "xenia/cpu/processor.h"
+#include "xenia/kernel/kernel_flags.h"
 #include "xenia/kernel/kernel_state.h"
 #include "xenia/kernel/user_module.h"
 #include "xenia/kernel/util/shim_utils.h"
+#include "xenia/kernel/util/spinlock_profiler.h"
 #include "xenia/kernel/xboxkrnl/xboxkrnl_private.h"
 #include "xenia/kernel/xevent.h"
 #include "xenia/kernel/xmutant.h"
@@ -26,6 +30,18 @@
 #include "xenia/kernel/xtimer.h"
 #include "xenia/xbox.h"
 
+DEFINE_uint32(spinlock_max_backoff, 64,
+              "Maximum number of pause instructions between the attempts to "
+              "take a contended guest kernel spinlock. The backoff starts at "
+              "one pause and doubles after every failed attempt.",
+              "Kernel");
+DEFINE_uint32(spinlock_spins_before_yield, 1024,
+              "Number of pause instructions executed while waiting for a "
+              "contended guest kernel spinlock before giving the rest of the "
+              "time slice to other host threads after every attempt. 0 to "
+              "always yield, like before the backoff was added.",
+              "Kernel");
+
 namespace xe {
 namespace kernel {
 namespace xboxkrnl {
@@ -1105,6 +1121,43 @@ DECLARE_XBOXKRNL_EXPORT3(NtSignalAndWaitForSingleObjectEx, kThreading,
 
 static void PrefetchForCAS(const void* value) { swcache::PrefetchW(value); }
 
+// Contended path of the spinlock acquisition. The lock word is only read while
+// it's held, so the waiting host threads don't keep taking the cache line from
+// the owner with their compare-exchanges, and the reads are spaced out with
+// exponentially more pause instructions. Once the waiter has spun for long,
+// the owner has likely been preempted on the host, so the waiter gives it the
+// processor instead.
+// TODO(benvanik): error on deadlock?
+static void WaitForSpinLock(X_KSPINLOCK* lock, uint32_t owner) {
+  bool profile = cvars::profile_kernel_exports;
+  uint64_t start_host_ticks = profile ? Clock::QueryHostTickCount() : 0;
+  uint32_t max_backoff = std::max(cvars::spinlock_max_backoff, uint32_t(1));
+  uint32_t spins_before_yield = cvars::spinlock_spins_before_yield;
+  uint32_t backoff = 1;
+  uint64_t spin_count = 0;
+  uint64_t yield_count = 0;
+  do {
+    do {
+      if (spin_count < spins_before_yield) {
+        for (uint32_t i = 0; i < backoff; ++i) {
+          xe::SpinPause();
+        }
+        spin_count += backoff;
+        backoff = std::min(backoff * 2, max_backoff);
+      } else {
+        xe::threading::MaybeYield();
+        ++yield_count;
+      }
+    } while (*reinterpret_cast<volatile uint32_t*>(
+        &lock->prcb_of_owner.value));
+  } while (!xe::atomic_cas(0, owner, &lock->prcb_of_owner.value));
+  if (profile) {
+    util::SpinLockProfiler::RecordContention(
+        kernel_memory()->HostToGuestVirtual(lock), spin_count, yield_count,
+        Clock::QueryHostTickCount() - start_host_ticks);
+  }
+}
+
 uint32_t xeKeKfAcquireSpinLock(PPCContext* ctx, X_KSPINLOCK* lock,
                                bool change_irql) {
   auto old_irql = change_irql ? xeKfRaiseIrql(ctx, 2) : 0;
@@ -1112,13 +1165,11 @@ uint32_t xeKeKfAcquireSpinLock(PPCContext* ctx, X_KSPINLOCK* lock,
   PrefetchForCAS(lock);
   assert_true(lock->prcb_of_owner != static_cast<uint32_t>(ctx->r[13]));
   // Lock.
-  while (!xe::atomic_cas(0, xe::byte_swap(static_cast<uint32_t>(ctx->r[13])),
-                         &lock->prcb_of_owner.value)) {
-    // Spin!
-    // TODO(benvanik): error on deadlock?
-    xe::threading::MaybeYield();
+  uint32_t owner = xe::byte_swap(static_cast<uint32_t>(ctx->r[13]));
+  if (XE_LIKELY(xe::atomic_cas(0, owner, &lock->prcb_of_owner.value))) {
+    return old_irql;
   }
-
+  WaitForSpinLock(lock, owner);
   return old_irql;
 }
 
@@ -1166,10 +1217,21 @@ dword_result_t KeTryToAcquireSpinLockAtRaisedIrql_entry(
   // Lock.
   auto lock = reinterpret_cast<uint32_t*>(lock_ptr.host_address());
   assert_true(lock_ptr->prcb_of_owner != static_cast<uint32_t>(ppc_ctx->r[13]));
+  // Fail without the compare-exchange if the lock is visibly held, so titles
+  // polling a held lock don't take the cache line from the owner.
+  if (*reinterpret_cast<volatile uint32_t*>(lock)) {
+    if (cvars::profile_kernel_exports) {
+      util::SpinLockProfiler::RecordFailedTry(lock_ptr.guest_address());
+    }
+    return 0;
+  }
   PrefetchForCAS(lock);
   if (!ppc_ctx->processor->GuestAtomicCAS32(
           ppc_ctx, 0, static_cast<uint32_t>(ppc_ctx->r[13]),
           lock_ptr.guest_address())) {
+    if (cvars::profile_kernel_exports) {
+      util::SpinLockProfiler::RecordFailedTry(lock_ptr.guest_address());
+    }
     return 0;
   }
   return 1;
@@ -1254,7 +1316,6 @@ uint32_t xeNtQueueApcThread(uint32_t thread_handle, uint32_t apc_routine,
                             uint32_t apc_routine_context, uint32_t arg1,
                             uint32_t arg2, cpu::ppc::PPCContext* context) {
   auto kernelstate = context->kernel_state;
-  auto memory = kernelstate->memory();
   auto thread =
       kernelstate->object_table()->LookupObject<XThread>(thread_handle);
 
@@ -1263,7 +1324,7 @@ uint32_t xeNtQueueApcThread(uint32_t thread_handle, uint32_t apc_routine,
     return X_STATUS_INVALID_HANDLE;
   }
 
-  uint32_t apc_ptr = memory->SystemHeapAlloc(XAPC::kSize);
+  uint32_t apc_ptr = kernelstate->AllocateHostApc();
   if (!apc_ptr) {
     return X_STATUS_NO_MEMORY;
   }
@@ -1272,7 +1333,7 @@ uint32_t xeNtQueueApcThread(uint32_t thread_handle, uint32_t apc_routine,
                     apc_routine, 1 /*user apc mode*/, apc_routine_context);
 
   if (!xeKeInsertQueueApc(apc, arg1, arg2, 0, context)) {
-    memory->SystemHeapFree(apc_ptr);
+    kernelstate->FreeHostApc(apc_ptr, false);
     return X_STATUS_UNSUCCESSFUL;
   }
   // no-op, just meant to awaken a sleeping alertable thread to process real
@@ -1298,11 +1359,18 @@ X_STATUS xeProcessUserApcs(PPCContext* ctx) {
 
   auto current_thread = ctx->TranslateVirtual(kpcr->prcb_data.current_thread);
 
+  auto& user_apc_queue = current_thread->apc_lists[1];
+
+  // Checked without the lock first, as this is called on every alertable wait
+  // and mostly finds the queue empty. APCs queued concurrently wake up the
+  // thread, which then checks again.
+  if (user_apc_queue.empty(ctx)) {
+    return alert_status;
+  }
+
   uint32_t unlocked_irql =
       xeKeKfAcquireSpinLock(ctx, &current_thread->apc_lock);
 
-  auto& user_apc_queue = current_thread->apc_lists[1];
-
   // use guest stack for temporaries
   uint32_t old_stack_pointer = static_cast<uint32_t>(ctx->r[1]);
 
@@ -1336,7 +1404,7 @@ X_STATUS xeProcessUserApcs(PPCContext* ctx) {
       ctx->processor->Execute(ctx->thread_state, apc->kernel_routine,
                               kernel_args, xe::countof(kernel_args));
     } else {
-      ctx->kernel_state->memory()->SystemHeapFree(apc_ptr);
+      ctx->kernel_state->FreeHostApc(apc_ptr, true);
     }
 
     uint32_t normal_routine = xe::load_and_swap<uint32_t>(scratch_ptr + 0);
@@ -1390,6 +1458,9 @@ static void YankApcList(PPCContext* ctx, X_KTHREAD* current_thread,
         kernel_state()->processor()->Execute(ctx->thread_state,
                                              this_entry->rundown_routine, args,
                                              xe::countof(args));
+      } else if (this_entry->kernel_routine == XAPC::kDummyKernelRoutine) {
+        ctx->kernel_state->FreeHostApc(ctx->HostToGuestVirtual(this_entry),
+                                       false);
       } else {
         ctx->kernel_state->memory()->SystemHeapFree(
             ctx->HostToGuestVirtual(this_entry));
@@ -1533,42 +1604,17 @@ DECLARE_XBOXKRNL_EXPORT2(KeInitializeDpc, kThreading, kImplemented, kSketchy);
 
 dword_result_t KeInsertQueueDpc_entry(pointer_t<XDPC> dpc, dword_t arg1,
                                       dword_t arg2) {
-  assert_always("DPC does not dispatch yet; going to hang!");
-
-  uint32_t list_entry_ptr = dpc.guest_address() + 4;
-
-  // Lock dispatcher.
-  auto global_lock = xe::global_critical_region::AcquireDirect();
-  auto dpc_list = kernel_state()->dpc_list();
-
-  // If already in a queue, abort.
-  if (dpc_list->IsQueued(list_entry_ptr)) {
-    return 0;
-  }
-
-  // Prep DPC.
-  dpc->arg1 = (uint32_t)arg1;
-  dpc->arg2 = (uint32_t)arg2;
-
-  dpc_list->Insert(list_entry_ptr);
-
-  return 1;
+  // Dispatched on the DPC thread of the CPU the caller is running on.
+  XThread* current_thread = XThread::GetCurrentThread();
+  uint32_t cpu = current_thread ? current_thread->active_cpu() : 0;
+  return kernel_state()->InsertQueueDpc(dpc.guest_address(), arg1, arg2, cpu)
+             ? 1
+             : 0;
 }
-DECLARE_XBOXKRNL_EXPORT2(KeInsertQueueDpc, kThreading, kStub, kSketchy);
+DECLARE_XBOXKRNL_EXPORT2(KeInsertQueueDpc, kThreading, kImplemented, kSketchy);
 
 dword_result_t KeRemoveQueueDpc_entry(pointer_t<XDPC> dpc) {
-  bool result = false;
-
-  uint32_t list_entry_ptr = dpc.guest_address() + 4;
-
-  auto global_lock = xe::global_critical_region::AcquireDirect();
-  auto dpc_list = kernel_state()->dpc_list();
-  if (dpc_list->IsQueued(list_entry_ptr)) {
-    dpc_list->Remove(list_entry_ptr);
-    result = true;
-  }
-
-  return result ? 1 : 0;
+  return kernel_state()->RemoveQueueDpc(dpc.guest_address()) ? 1 : 0;
 }
 DECLARE_XBOXKRNL_EXPORT1(KeRemoveQueueDpc, kThreading, kImplemented);
 
@@ -10,7 +10,11 @@
 #include "xenia/kernel/xfile.h"
 #include "xenia/vfs/virtual_file_system.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "xenia/base/byte_stream.h"
+#include "xenia/base/clock.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/mutex.h"
@@ -93,6 +97,48 @@ X_STATUS XFile::QueryDirectory(X_FILE_DIRECTORY_INFORMATION* out_info,
   return X_STATUS_SUCCESS;
 }
 
+uint8_t* XFile::TranslateReadBuffer(uint32_t buffer_guest_address,
+                                   uint32_t buffer_length,
+                                   xe::PhysicalHeap** physical_heap_out) {
+  *physical_heap_out = nullptr;
+  if (UINT32_MAX - buffer_guest_address < buffer_length) {
+    return nullptr;
+  }
+  // Games often read directly to texture/vertex buffer memory - in this
+  // case, invalidation notifications must be sent. However, having any
+  // memory callbacks in the range will result in STATUS_ACCESS_VIOLATION at
+  // least on Windows, without anything being read or any callbacks being
+  // triggered. So for physical memory, host protection must be bypassed,
+  // and invalidation callbacks must be triggered manually (it's also wrong
+  // to trigger invalidation callbacks before reading in this case, because
+  // during the read, the guest may still access the data around the buffer
+  // that is located in the same host pages as the buffer's start and end,
+  // on the GPU - and that must not trigger a race condition).
+  uint32_t buffer_guest_high_address = buffer_guest_address + buffer_length - 1;
+  xe::BaseHeap* buffer_start_heap = memory()->LookupHeap(buffer_guest_address);
+  const xe::BaseHeap* buffer_end_heap =
+      memory()->LookupHeap(buffer_guest_high_address);
+  if (!buffer_start_heap || !buffer_end_heap ||
+      (buffer_start_heap->heap_type() == HeapType::kGuestPhysical) !=
+          (buffer_end_heap->heap_type() == HeapType::kGuestPhysical) ||
+      (buffer_start_heap->heap_type() == HeapType::kGuestPhysical &&
+       buffer_start_heap != buffer_end_heap)) {
+    return nullptr;
+  }
+  if (buffer_start_heap->heap_type() != HeapType::kGuestPhysical) {
+    return memory()->TranslateVirtual(buffer_guest_address);
+  }
+  auto buffer_physical_heap = static_cast<xe::PhysicalHeap*>(buffer_start_heap);
+  if (buffer_physical_heap->QueryRangeAccess(buffer_guest_address,
+                                             buffer_guest_high_address) !=
+      memory::PageAccess::kReadWrite) {
+    return nullptr;
+  }
+  *physical_heap_out = buffer_physical_heap;
+  return memory()->TranslatePhysical(
+      buffer_physical_heap->GetPhysicalAddress(buffer_guest_address));
+}
+
 X_STATUS XFile::Read(uint32_t buffer_guest_address, uint32_t buffer_length,
                      uint64_t byte_offset, uint32_t* out_bytes_read,
                      uint32_t apc_context, bool notify_completion) {
@@ -106,58 +152,26 @@ X_STATUS XFile::Read(uint32_t buffer_guest_address, uint32_t buffer_length,
   // Zero length means success for a valid file object according to Windows
   // tests.
   if (buffer_length) {
-    if (UINT32_MAX - buffer_guest_address < buffer_length) {
+    xe::PhysicalHeap* buffer_physical_heap;
+    uint8_t* buffer = TranslateReadBuffer(buffer_guest_address, buffer_length,
+                                          &buffer_physical_heap);
+    if (!buffer) {
       result = X_STATUS_ACCESS_VIOLATION;
     } else {
-      // Games often read directly to texture/vertex buffer memory - in this
-      // case, invalidation notifications must be sent. However, having any
-      // memory callbacks in the range will result in STATUS_ACCESS_VIOLATION at
-      // least on Windows, without anything being read or any callbacks being
-      // triggered. So for physical memory, host protection must be bypassed,
-      // and invalidation callbacks must be triggered manually (it's also wrong
-      // to trigger invalidation callbacks before reading in this case, because
-      // during the read, the guest may still access the data around the buffer
-      // that is located in the same host pages as the buffer's start and end,
-      // on the GPU - and that must not trigger a race condition).
-      uint32_t buffer_guest_high_address =
-          buffer_guest_address + buffer_length - 1;
-      xe::BaseHeap* buffer_start_heap =
-          memory()->LookupHeap(buffer_guest_address);
-      const xe::BaseHeap* buffer_end_heap =
-          memory()->LookupHeap(buffer_guest_high_address);
-      if (!buffer_start_heap || !buffer_end_heap ||
-          (buffer_start_heap->heap_type() == HeapType::kGuestPhysical) !=
-              (buffer_end_heap->heap_type() == HeapType::kGuestPhysical) ||
-          (buffer_start_heap->heap_type() == HeapType::kGuestPhysical &&
-           buffer_start_heap != buffer_end_heap)) {
-        result = X_STATUS_ACCESS_VIOLATION;
-      } else {
-        xe::PhysicalHeap* buffer_physical_heap =
-            buffer_start_heap->heap_type() == HeapType::kGuestPhysical
-                ? static_cast<xe::PhysicalHeap*>(buffer_start_heap)
-                : nullptr;
-        if (buffer_physical_heap &&
-            buffer_physical_heap->QueryRangeAccess(buffer_guest_address,
-                                                   buffer_guest_high_address) !=
-                memory::PageAccess::kReadWrite) {
-          result = X_STATUS_ACCESS_VIOLATION;
-        } else {
-          result = file_->ReadSync(
-              buffer_physical_heap
-                  ? memory()->TranslatePhysical(
-                        buffer_physical_heap->GetPhysicalAddress(
-                            buffer_guest_address))
-                  : memory()->TranslateVirtual(buffer_guest_address),
-              buffer_length, size_t(byte_offset), &bytes_read);
-          if (XSUCCEEDED(result)) {
-            if (buffer_physical_heap) {
-              buffer_physical_heap->TriggerCallbacks(
-                  xe::global_critical_region::AcquireDirect(),
-                  buffer_guest_address, buffer_length, true, true);
-            }
-            position_ += bytes_read;
-          }
+      uint64_t start_host_ticks = Clock::QueryHostTickCount();
+      result = file_->ReadSync(buffer, buffer_length, size_t(byte_offset),
+                               &bytes_read);
+      file_->entry()->device()->RecordRead(
+          bytes_read, Clock::QueryHostTickCount() - start_host_ticks);
+      if (XSUCCEEDED(result)) {
+        if (buffer_physical_heap) {
+          buffer_physical_heap->TriggerCallbacks(
+              xe::global_critical_region::AcquireDirect(),
+              buffer_guest_address, buffer_length, true, true);
         }
+        position_ += bytes_read;
+        kernel_state()->file_system()->access_trace().RecordRead(
+            file_->entry(), size_t(byte_offset), bytes_read);
       }
     }
   }
@@ -167,19 +181,24 @@ X_STATUS XFile::Read(uint32_t buffer_guest_address, uint32_t buffer_length,
   }
 
   if (notify_completion) {
-    XIOCompletion::IONotification notify;
-    notify.apc_context = apc_context;
-    notify.num_bytes = uint32_t(bytes_read);
-    notify.status = result;
-
-    NotifyIOCompletionPorts(notify);
-
-    async_event_->Set();
+    CompleteIO(apc_context, uint32_t(bytes_read), result);
   }
 
   return result;
 }
 
+void XFile::CompleteIO(uint32_t apc_context, uint32_t bytes_transferred,
+                       X_STATUS status) {
+  XIOCompletion::IONotification notify;
+  notify.apc_context = apc_context;
+  notify.num_bytes = bytes_transferred;
+  notify.status = status;
+
+  NotifyIOCompletionPorts(notify);
+
+  async_event_->Set();
+}
+
 X_STATUS XFile::ReadScatter(uint32_t segments_guest_address, uint32_t length,
                             uint64_t byte_offset, uint32_t* out_bytes_read,
                             uint32_t apc_context) {
@@ -187,51 +206,84 @@ X_STATUS XFile::ReadScatter(uint32_t segments_guest_address, uint32_t length,
 
   // segments points to an array of buffer pointers of type
   // "FILE_SEGMENT_ELEMENT", but they can just be treated as normal pointers
-  xe::be<uint32_t>* segments = reinterpret_cast<xe::be<uint32_t>*>(
+  const xe::be<uint32_t>* segments = reinterpret_cast<xe::be<uint32_t>*>(
       memory()->TranslateVirtual(segments_guest_address));
 
   // TODO: not sure if this is meant to change depending on buffer address?
   // (only game seen using this always seems to use 4096-byte buffers)
   uint32_t page_size = 4096;
 
-  uint32_t read_total = 0;
-  uint32_t read_remain = length;
-  while (read_remain) {
-    uint32_t read_length = read_remain;
-    uint32_t read_buffer = *segments;
-    if (read_length > page_size) {
-      read_length = page_size;
-      segments++;
-    }
-
-    uint32_t bytes_read = 0;
-    result = Read(read_buffer, read_length,
-                  byte_offset ? ((byte_offset != -1 && byte_offset != -2)
-                                     ? byte_offset + read_total
-                                     : byte_offset)
-                              : -1,
-                  &bytes_read, apc_context, false);
+  if (!byte_offset || byte_offset == uint64_t(-1) ||
+      byte_offset == uint64_t(-2)) {
+    // Read from current position.
+    byte_offset = position_;
+  }
 
-    if (result != X_STATUS_SUCCESS) {
+  // Segments contiguous in host memory, usually consecutive guest pages, are
+  // merged, so the whole request is done with as few host reads as possible.
+  struct PhysicalRange {
+    xe::PhysicalHeap* heap;
+    uint32_t guest_address;
+    uint32_t length;
+  };
+  std::vector<xe::filesystem::ScatterBuffer> buffers;
+  std::vector<PhysicalRange> physical_ranges;
+  for (uint32_t offset = 0; offset < length; offset += page_size) {
+    uint32_t segment_length = std::min(page_size, length - offset);
+    uint32_t segment_guest_address = *(segments++);
+    xe::PhysicalHeap* segment_physical_heap;
+    uint8_t* segment = TranslateReadBuffer(
+        segment_guest_address, segment_length, &segment_physical_heap);
+    if (!segment) {
+      // Read the segments up to the inaccessible one.
+      result = X_STATUS_ACCESS_VIOLATION;
       break;
     }
+    if (!buffers.empty() &&
+        static_cast<uint8_t*>(buffers.back().data) + buffers.back().length ==
+            segment) {
+      buffers.back().length += segment_length;
+    } else {
+      buffers.push_back({segment, segment_length});
+    }
+    if (segment_physical_heap) {
+      if (!physical_ranges.empty() &&
+          physical_ranges.back().heap == segment_physical_heap &&
+          physical_ranges.back().guest_address +
+                  physical_ranges.back().length ==
+              segment_guest_address) {
+        physical_ranges.back().length += segment_length;
+      } else {
+        physical_ranges.push_back(
+            {segment_physical_heap, segment_guest_address, segment_length});
+      }
+    }
+  }
 
-    read_total += bytes_read;
-    read_remain -= read_length;
+  size_t read_total = 0;
+  if (!buffers.empty()) {
+    uint64_t start_host_ticks = Clock::QueryHostTickCount();
+    X_STATUS read_result = file_->ReadScatterSync(
+        buffers.data(), buffers.size(), size_t(byte_offset), &read_total);
+    file_->entry()->device()->RecordRead(
+        read_total, Clock::QueryHostTickCount() - start_host_ticks);
+    if (XSUCCEEDED(read_result)) {
+      for (const PhysicalRange& physical_range : physical_ranges) {
+        physical_range.heap->TriggerCallbacks(
+            xe::global_critical_region::AcquireDirect(),
+            physical_range.guest_address, physical_range.length, true, true);
+      }
+    } else {
+      result = read_result;
+    }
+    position_ += read_total;
   }
 
   if (out_bytes_read) {
     *out_bytes_read = uint32_t(read_total);
   }
 
-  XIOCompletion::IONotification notify;
-  notify.apc_context = apc_context;
-  notify.num_bytes = uint32_t(read_total);
-  notify.status = result;
-
-  NotifyIOCompletionPorts(notify);
-
-  async_event_->Set();
+  CompleteIO(apc_context, uint32_t(read_total), result);
 
   return result;
 }
@@ -245,9 +297,12 @@ X_STATUS XFile::Write(uint32_t buffer_guest_address, uint32_t buffer_length,
   }
 
   size_t bytes_written = 0;
+  uint64_t start_host_ticks = Clock::QueryHostTickCount();
   X_STATUS result =
       file_->WriteSync(memory()->TranslateVirtual(buffer_guest_address),
                        buffer_length, size_t(byte_offset), &bytes_written);
+  file_->entry()->device()->RecordWrite(
+      bytes_written, Clock::QueryHostTickCount() - start_host_ticks);
   if (XSUCCEEDED(result)) {
     position_ += bytes_written;
   }
@@ -268,6 +323,7 @@ X_STATUS XFile::Write(uint32_t buffer_guest_address, uint32_t buffer_length,
 }
 
 X_STATUS XFile::SetLength(size_t length) { return file_->SetLength(length); }
+X_STATUS XFile::Flush() { return file_->Flush(); }
 X_STATUS XFile::Rename(const std::filesystem::path file_path) {
   entry()->Rename(file_path);
   return X_STATUS_SUCCESS;
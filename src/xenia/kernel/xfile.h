@@ -166,11 +166,19 @@ class XFile : public XObject {
                  uint32_t apc_context);
 
   X_STATUS SetLength(size_t length);
+  X_STATUS Flush();
   X_STATUS Rename(const std::filesystem::path file_path);
 
   void RegisterIOCompletionPort(uint32_t key, object_ref<XIOCompletion> port);
   void RemoveIOCompletionPort(uint32_t key);
 
+  // For overlapped I/O completed asynchronously, the file is not signaled
+  // until it's done.
+  void BeginAsyncIO() { async_event_->Reset(); }
+  // Notifies the completion ports and signals the file.
+  void CompleteIO(uint32_t apc_context, uint32_t bytes_transferred,
+                  X_STATUS status);
+
   bool Save(ByteStream* stream) override;
   static object_ref<XFile> Restore(KernelState* kernel_state,
                                    ByteStream* stream);
@@ -180,6 +188,13 @@ class XFile : public XObject {
  protected:
   void NotifyIOCompletionPorts(XIOCompletion::IONotification& notification);
 
+  // Returns the host pointer for reading into guest memory with host
+  // protection bypassed, and the physical heap if invalidation callbacks must
+  // be triggered after reading, or nullptr if the buffer is not accessible.
+  uint8_t* TranslateReadBuffer(uint32_t buffer_guest_address,
+                               uint32_t buffer_length,
+                               xe::PhysicalHeap** physical_heap_out);
+
   xe::threading::WaitHandle* GetWaitHandle() override {
     return async_event_.get();
   }
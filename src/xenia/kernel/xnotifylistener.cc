@@ -43,21 +43,26 @@ void XNotifyListener::EnqueueNotification(XNotificationID id, uint32_t data) {
   if (key.version > max_version_) {
     return;
   }
-  auto global_lock = global_critical_region_.Acquire();
+  std::lock_guard<std::mutex> lock(notifications_mutex_);
   notifications_.push_back(std::pair<XNotificationID, uint32_t>(id, data));
+  notification_count_.store(notifications_.size(), std::memory_order_release);
   wait_handle_->Set();
 }
 
 bool XNotifyListener::DequeueNotification(XNotificationID* out_id,
                                           uint32_t* out_data) {
-  auto global_lock = global_critical_region_.Acquire();
+  if (!HasNotifications()) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(notifications_mutex_);
   bool dequeued = false;
   if (notifications_.size()) {
     dequeued = true;
-    auto it = notifications_.begin();
-    *out_id = it->first;
-    *out_data = it->second;
-    notifications_.erase(it);
+    *out_id = notifications_.front().first;
+    *out_data = notifications_.front().second;
+    notifications_.pop_front();
+    notification_count_.store(notifications_.size(),
+                              std::memory_order_release);
     if (!notifications_.size()) {
       wait_handle_->Reset();
     }
@@ -67,10 +72,10 @@ bool XNotifyListener::DequeueNotification(XNotificationID* out_id,
 
 bool XNotifyListener::DequeueNotification(XNotificationID id,
                                           uint32_t* out_data) {
-  auto global_lock = global_critical_region_.Acquire();
-  if (!notifications_.size()) {
+  if (!HasNotifications()) {
     return false;
   }
+  std::lock_guard<std::mutex> lock(notifications_mutex_);
   bool dequeued = false;
   for (auto it = notifications_.begin(); it != notifications_.end(); ++it) {
     if (it->first != id) {
@@ -79,6 +84,8 @@ bool XNotifyListener::DequeueNotification(XNotificationID id,
     dequeued = true;
     *out_data = it->second;
     notifications_.erase(it);
+    notification_count_.store(notifications_.size(),
+                              std::memory_order_release);
     if (!notifications_.size()) {
       wait_handle_->Reset();
     }
@@ -90,6 +97,7 @@ bool XNotifyListener::DequeueNotification(XNotificationID id,
 bool XNotifyListener::Save(ByteStream* stream) {
   SaveObject(stream);
 
+  std::lock_guard<std::mutex> lock(notifications_mutex_);
   stream->Write(mask_);
   stream->Write(max_version_);
   stream->Write(notifications_.size());
@@ -119,6 +127,11 @@ object_ref<XNotifyListener> XNotifyListener::Restore(KernelState* kernel_state,
     pair.second = stream->Read<uint32_t>();
     notify->notifications_.push_back(pair);
   }
+  notify->notification_count_.store(notify->notifications_.size(),
+                                    std::memory_order_release);
+  if (!notify->notifications_.empty()) {
+    notify->wait_handle_->Set();
+  }
 
   return object_ref<XNotifyListener>(notify);
 }
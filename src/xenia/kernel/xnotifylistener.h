@@ -10,11 +10,13 @@
 #ifndef XENIA_KERNEL_XNOTIFYLISTENER_H_
 #define XENIA_KERNEL_XNOTIFYLISTENER_H_
 
+#include <atomic>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 
 #include "xenia/base/assert.h"
-#include "xenia/base/mutex.h"
 #include "xenia/base/threading.h"
 #include "xenia/kernel/xobject.h"
 #include "xenia/xbox.h"
@@ -56,6 +58,12 @@ class XNotifyListener : public XObject {
   bool DequeueNotification(XNotificationID* out_id, uint32_t* out_data);
   bool DequeueNotification(XNotificationID id, uint32_t* out_data);
 
+  // Doesn't take the lock - titles call XNotifyGetNext every frame, often from
+  // multiple threads, while notifications arrive rarely.
+  bool HasNotifications() const {
+    return notification_count_.load(std::memory_order_acquire) != 0;
+  }
+
   bool Save(ByteStream* stream) override;
   static object_ref<XNotifyListener> Restore(KernelState* kernel_state,
                                              ByteStream* stream);
@@ -67,8 +75,12 @@ class XNotifyListener : public XObject {
 
  private:
   std::unique_ptr<xe::threading::Event> wait_handle_;
-  xe::global_critical_region global_critical_region_;
-  std::vector<std::pair<XNotificationID, uint32_t>> notifications_;
+  // Per listener rather than the global critical region, not to contend with
+  // unrelated kernel work and other listeners.
+  std::mutex notifications_mutex_;
+  std::deque<std::pair<XNotificationID, uint32_t>> notifications_;
+  // Updated with notifications_mutex_ locked, for the lock-free empty check.
+  std::atomic<size_t> notification_count_{0};
   uint64_t mask_ = 0;
   uint32_t max_version_ = 0;
 };
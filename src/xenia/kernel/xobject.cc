@@ -13,6 +13,8 @@
 
 #include "xenia/base/byte_stream.h"
 #include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/platform.h"
 #include "xenia/kernel/kernel_state.h"
 #include "xenia/kernel/util/shim_utils.h"
 #include "xenia/kernel/xboxkrnl/xboxkrnl_private.h"
@@ -27,9 +29,36 @@
 #include "xenia/kernel/xthread.h"
 #include "xenia/xbox.h"
 
+DEFINE_int32(kernel_wait_spin_count, 0,
+             "Number of times to check whether a waited object has been "
+             "signaled before blocking the guest thread. Spinning avoids the "
+             "cost of putting the thread to sleep and waking it up for waits "
+             "that are satisfied quickly, at the expense of CPU time.",
+             "Kernel");
+
 namespace xe {
 namespace kernel {
 
+namespace {
+
+// Waits with a zero timeout up to kernel_wait_spin_count times while the wait
+// times out, returning the last result.
+template <typename WaitFunction>
+auto SpinWait(WaitFunction wait_function) {
+  auto result = wait_function(std::chrono::milliseconds(0));
+  for (int32_t i = 1; i < cvars::kernel_wait_spin_count &&
+                      result == xe::threading::WaitResult::kTimeout;
+       ++i) {
+#if XE_ARCH_AMD64
+    _mm_pause();
+#endif
+    result = wait_function(std::chrono::milliseconds(0));
+  }
+  return result;
+}
+
+}  // namespace
+
 XObject::XObject(Type type)
     : kernel_state_(nullptr), pointer_ref_count_(1), type_(type) {
   handles_.reserve(10);
@@ -204,8 +233,16 @@ X_STATUS XObject::Wait(uint32_t wait_reason, uint32_t processor_mode,
                         TimeoutTicksToMs(*opt_timeout)))
                   : std::chrono::milliseconds::max();
 
-  auto result =
-      xe::threading::Wait(wait_handle, alertable ? true : false, timeout_ms);
+  auto wait = [wait_handle, alertable](std::chrono::milliseconds timeout) {
+    return xe::threading::Wait(wait_handle, alertable ? true : false, timeout);
+  };
+  auto result = xe::threading::WaitResult::kTimeout;
+  if (cvars::kernel_wait_spin_count > 0 && timeout_ms.count()) {
+    result = SpinWait(wait);
+  }
+  if (result == xe::threading::WaitResult::kTimeout) {
+    result = wait(timeout_ms);
+  }
   switch (result) {
     case xe::threading::WaitResult::kSuccess:
       WaitCallback();
@@ -268,8 +305,19 @@ X_STATUS XObject::WaitMultiple(uint32_t count, XObject** objects,
                   : std::chrono::milliseconds::max();
 
   if (wait_type) {
-    auto result = xe::threading::WaitAny(wait_handles, count,
-                                         alertable ? true : false, timeout_ms);
+    std::pair<xe::threading::WaitResult, size_t> result = {
+        xe::threading::WaitResult::kTimeout, 0};
+    auto wait_any = [&](std::chrono::milliseconds timeout) {
+      result = xe::threading::WaitAny(wait_handles, count,
+                                      alertable ? true : false, timeout);
+      return result.first;
+    };
+    if (cvars::kernel_wait_spin_count > 0 && timeout_ms.count()) {
+      SpinWait(wait_any);
+    }
+    if (result.first == xe::threading::WaitResult::kTimeout) {
+      wait_any(timeout_ms);
+    }
     switch (result.first) {
       case xe::threading::WaitResult::kSuccess:
         objects[result.second]->WaitCallback();
@@ -27,6 +27,7 @@
 #include <netinet/in.h>
 #include <netinet/ip.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #endif
 
@@ -222,6 +223,57 @@ int XSocket::RecvFrom(uint8_t* buf, uint32_t buf_len, uint32_t flags,
   return ret;
 }
 
+int XSocket::RecvFromBuffers(const std::vector<RecvBuffer>& buffers,
+                             uint32_t flags, N_XSOCKADDR_IN* from,
+                             uint32_t* from_len) {
+  sockaddr_in nfrom = {};
+  int ret;
+#ifdef XE_PLATFORM_WIN32
+  std::vector<WSABUF> wsa_buffers(buffers.size());
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    wsa_buffers[i].len = buffers[i].length;
+    wsa_buffers[i].buf = reinterpret_cast<char*>(buffers[i].data);
+  }
+  int nfromlen = sizeof(sockaddr_in);
+  DWORD bytes_received = 0;
+  DWORD wsa_flags = flags;
+  ret = WSARecvFrom(native_handle_, wsa_buffers.data(),
+                    DWORD(wsa_buffers.size()), &bytes_received, &wsa_flags,
+                    (sockaddr*)&nfrom, &nfromlen, nullptr, nullptr)
+            ? -1
+            : int(bytes_received);
+#else
+  std::vector<iovec> iovecs(buffers.size());
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    iovecs[i].iov_base = buffers[i].data;
+    iovecs[i].iov_len = buffers[i].length;
+  }
+  msghdr message = {};
+  message.msg_name = &nfrom;
+  message.msg_namelen = sizeof(sockaddr_in);
+  message.msg_iov = iovecs.data();
+  message.msg_iovlen = iovecs.size();
+  ret = int(recvmsg(int(native_handle_), &message, int(flags)));
+  socklen_t nfromlen = message.msg_namelen;
+#endif
+  if (ret < 0) {
+    return ret;
+  }
+
+  if (from) {
+    from->sin_family = nfrom.sin_family;
+    from->sin_addr = ntohl(nfrom.sin_addr.s_addr);  // BE <- BE
+    from->sin_port = nfrom.sin_port;
+    std::memset(from->x_sin_zero, 0, sizeof(from->x_sin_zero));
+  }
+
+  if (from_len) {
+    *from_len = uint32_t(nfromlen);
+  }
+
+  return ret;
+}
+
 int XSocket::Send(const uint8_t* buf, uint32_t buf_len, uint32_t flags) {
   return send(native_handle_, reinterpret_cast<const char*>(buf), buf_len,
               flags);
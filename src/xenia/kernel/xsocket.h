@@ -12,6 +12,7 @@
 
 #include <cstring>
 #include <queue>
+#include <vector>
 
 #include "xenia/base/byte_order.h"
 #include "xenia/base/math.h"
@@ -21,10 +22,14 @@ namespace xe {
 namespace kernel {
 enum class X_WSAError : uint32_t {
   X_WSA_INVALID_PARAMETER = 0x0057,
+  X_WSA_OPERATION_ABORTED = 0x03E3,
+  X_WSA_IO_INCOMPLETE = 0x03E4,
+  X_WSA_IO_PENDING = 0x03E5,
   X_WSAEFAULT = 0x271E,
   X_WSAEINVAL = 0x2726,
   X_WSAENOTSOCK = 0x2736,
   X_WSAEMSGSIZE = 0x2738,
+  X_WSAENOBUFS = 0x2747,
 };
 
 struct XSOCKADDR {
@@ -128,6 +133,15 @@ class XSocket : public XObject {
   int SendTo(uint8_t* buf, uint32_t buf_len, uint32_t flags, N_XSOCKADDR_IN* to,
              uint32_t to_len);
 
+  struct RecvBuffer {
+    uint8_t* data;
+    uint32_t length;
+  };
+  // Scatters the received data directly into the buffers (such as ones in
+  // guest memory) without combining them in an intermediate buffer.
+  int RecvFromBuffers(const std::vector<RecvBuffer>& buffers, uint32_t flags,
+                      N_XSOCKADDR_IN* from, uint32_t* from_len);
+
   uint32_t GetLastWSAError() const;
 
   struct packet {
@@ -0,0 +1,265 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/kernel/xsocket_reactor.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "xenia/base/assert.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/platform.h"
+
+#ifdef XE_PLATFORM_WIN32
+// clang-format off
+#include "xenia/base/platform_win.h"
+#include <WS2tcpip.h>
+#include <WinSock2.h>
+// clang-format on
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace xe {
+namespace kernel {
+
+namespace {
+
+#ifdef XE_PLATFORM_WIN32
+using PollFd = WSAPOLLFD;
+int PollSockets(PollFd* fds, size_t count, int timeout_ms) {
+  return WSAPoll(fds, ULONG(count), timeout_ms);
+}
+void CloseHostSocket(uint64_t host_socket) { closesocket(SOCKET(host_socket)); }
+#else
+using PollFd = pollfd;
+int PollSockets(PollFd* fds, size_t count, int timeout_ms) {
+  return poll(fds, nfds_t(count), timeout_ms);
+}
+void CloseHostSocket(uint64_t host_socket) { close(int(host_socket)); }
+#endif
+
+PollFd MakePollFd(uint64_t host_socket) {
+  PollFd poll_fd = {};
+  poll_fd.fd = decltype(poll_fd.fd)(host_socket);
+  poll_fd.events = POLLIN;
+  return poll_fd;
+}
+
+}  // namespace
+
+XSocketReactor::XSocketReactor() = default;
+
+XSocketReactor::~XSocketReactor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  if (thread_) {
+    Wake();
+    xe::threading::Wait(thread_.get(), false);
+    thread_.reset();
+  }
+  if (wake_socket_ != uint64_t(-1)) {
+    CloseHostSocket(wake_socket_);
+  }
+  // The guest memory of the receives still pending may be gone already, so
+  // they're dropped without completing them.
+}
+
+bool XSocketReactor::EnsureStarted() {
+  if (thread_) {
+    return true;
+  }
+  if (start_failed_) {
+    return false;
+  }
+  start_failed_ = true;
+
+  wake_socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (wake_socket_ == uint64_t(-1)) {
+    XELOGE("XSocketReactor: Failed to create the wake-up socket");
+    return false;
+  }
+  sockaddr_in wake_address = {};
+  wake_address.sin_family = AF_INET;
+  wake_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t wake_address_len = sizeof(wake_address);
+  if (bind(wake_socket_, (sockaddr*)&wake_address, sizeof(wake_address)) ||
+      getsockname(wake_socket_, (sockaddr*)&wake_address, &wake_address_len) ||
+      connect(wake_socket_, (sockaddr*)&wake_address, wake_address_len)) {
+    XELOGE("XSocketReactor: Failed to bind the loopback wake-up socket");
+    CloseHostSocket(wake_socket_);
+    wake_socket_ = uint64_t(-1);
+    return false;
+  }
+
+  thread_ = xe::threading::Thread::Create({}, [this]() { ReactorThread(); });
+  if (!thread_) {
+    XELOGE("XSocketReactor: Failed to create the thread");
+    CloseHostSocket(wake_socket_);
+    wake_socket_ = uint64_t(-1);
+    return false;
+  }
+  thread_->set_name("Socket Reactor");
+  start_failed_ = false;
+  return true;
+}
+
+void XSocketReactor::Wake() {
+  char wake_byte = 0;
+  send(wake_socket_, &wake_byte, sizeof(wake_byte), 0);
+}
+
+bool XSocketReactor::QueueRecv(object_ref<XSocket> socket,
+                               std::vector<XSocket::RecvBuffer> buffers,
+                               uint32_t flags, RecvCompletion completion) {
+  assert_not_null(socket);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (shutdown_ || !EnsureStarted()) {
+    return false;
+  }
+  PendingRecv& pending_recv = pending_recvs_.emplace_back();
+  pending_recv.socket = std::move(socket);
+  pending_recv.buffers = std::move(buffers);
+  pending_recv.flags = flags;
+  pending_recv.completion = std::move(completion);
+  if (polling_) {
+    // Add the socket to the polled set if it's not there yet.
+    Wake();
+  }
+  return true;
+}
+
+void XSocketReactor::CancelSocket(XSocket* socket) {
+  std::vector<PendingRecv> cancelled_recvs;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto cancelled_begin = std::stable_partition(
+        pending_recvs_.begin(), pending_recvs_.end(),
+        [socket](const PendingRecv& pending_recv) {
+          return pending_recv.socket.get() != socket;
+        });
+    if (cancelled_begin == pending_recvs_.end()) {
+      return;
+    }
+    std::move(cancelled_begin, pending_recvs_.end(),
+              std::back_inserter(cancelled_recvs));
+    pending_recvs_.erase(cancelled_begin, pending_recvs_.end());
+    if (polling_) {
+      // The host socket may still be in the polled set.
+      uint64_t poll_count = poll_count_;
+      Wake();
+      poll_cond_.wait(lock, [this, poll_count]() {
+        return poll_count_ != poll_count;
+      });
+    }
+  }
+  for (PendingRecv& cancelled_recv : cancelled_recvs) {
+    RecvResult& result = cancelled_recv.result;
+    result.result = -1;
+    result.error = uint32_t(X_WSAError::X_WSA_OPERATION_ABORTED);
+    result.from_len = 0;
+    cancelled_recv.completion(result);
+  }
+}
+
+void XSocketReactor::DrainWakeSocket() {
+  // Only called when the socket is readable, so the first receive doesn't
+  // block, and the following ones are done only while there's more data.
+  char wake_bytes[64];
+  PollFd wake_poll_fd;
+  do {
+    recv(wake_socket_, wake_bytes, sizeof(wake_bytes), 0);
+    wake_poll_fd = MakePollFd(wake_socket_);
+  } while (PollSockets(&wake_poll_fd, 1, 0) > 0);
+}
+
+void XSocketReactor::ReactorThread() {
+  std::vector<PollFd> poll_fds;
+  std::vector<XSocket*> poll_sockets;
+  // Completed outside the lock, also releasing the references to the sockets
+  // there as that may close them.
+  std::vector<PendingRecv> completed_recvs;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!shutdown_) {
+    poll_fds.clear();
+    poll_sockets.clear();
+    poll_fds.push_back(MakePollFd(wake_socket_));
+    for (const PendingRecv& pending_recv : pending_recvs_) {
+      XSocket* socket = pending_recv.socket.get();
+      if (std::find(poll_sockets.cbegin(), poll_sockets.cend(), socket) !=
+          poll_sockets.cend()) {
+        continue;
+      }
+      poll_sockets.push_back(socket);
+      poll_fds.push_back(MakePollFd(socket->native_handle()));
+    }
+    polling_ = true;
+    lock.unlock();
+    int poll_result = PollSockets(poll_fds.data(), poll_fds.size(), -1);
+    lock.lock();
+    polling_ = false;
+    ++poll_count_;
+    poll_cond_.notify_all();
+    if (poll_result <= 0) {
+      continue;
+    }
+
+    if (poll_fds[0].revents) {
+      DrainWakeSocket();
+    }
+
+    // Only the oldest receive is done on every readable socket, as the
+    // following ones might block.
+    for (size_t i = 1; i < poll_fds.size(); ++i) {
+      if (!poll_fds[i].revents) {
+        continue;
+      }
+      XSocket* socket = poll_sockets[i - 1];
+      auto pending_recv_it = std::find_if(
+          pending_recvs_.begin(), pending_recvs_.end(),
+          [socket](const PendingRecv& pending_recv) {
+            return pending_recv.socket.get() == socket;
+          });
+      if (pending_recv_it == pending_recvs_.end()) {
+        // Cancelled while polling.
+        continue;
+      }
+      RecvResult& result = pending_recv_it->result;
+      result.from_len = sizeof(XSOCKADDR_IN);
+      result.result = socket->RecvFromBuffers(pending_recv_it->buffers,
+                                              pending_recv_it->flags,
+                                              &result.from, &result.from_len);
+      result.error = result.result < 0 ? socket->GetLastWSAError() : 0;
+      if (result.result < 0) {
+        result.from_len = 0;
+      }
+      completed_recvs.push_back(std::move(*pending_recv_it));
+      pending_recvs_.erase(pending_recv_it);
+    }
+
+    if (!completed_recvs.empty()) {
+      lock.unlock();
+      for (PendingRecv& completed_recv : completed_recvs) {
+        completed_recv.completion(completed_recv.result);
+      }
+      completed_recvs.clear();
+      lock.lock();
+    }
+  }
+}
+
+}  // namespace kernel
+}  // namespace xe
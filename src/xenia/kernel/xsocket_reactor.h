@@ -0,0 +1,97 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_KERNEL_XSOCKET_REACTOR_H_
+#define XENIA_KERNEL_XSOCKET_REACTOR_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "xenia/base/threading.h"
+#include "xenia/kernel/xobject.h"
+#include "xenia/kernel/xsocket.h"
+
+namespace xe {
+namespace kernel {
+
+// Completes overlapped receives on guest sockets on a host thread once the
+// host sockets become readable, so the guest thread neither blocks in the host
+// receive nor has to poll it. The data is received directly into the guest
+// buffers.
+//
+// Readiness is checked with poll (WSAPoll on Windows) on all the sockets with
+// pending receives - titles only have a few sockets, so the socket set is
+// rebuilt for every poll rather than maintained in epoll or an I/O completion
+// port. The poll is woken up to update the set by a datagram sent to a loopback
+// socket, which works the same way on all platforms.
+class XSocketReactor {
+ public:
+  struct RecvResult {
+    // The return value of the receive, -1 if it has failed or was cancelled.
+    int result;
+    // The guest WSA error code if the receive has failed.
+    uint32_t error;
+    N_XSOCKADDR_IN from;
+    uint32_t from_len;
+  };
+  // Called on the reactor thread, or on the thread cancelling the receive.
+  using RecvCompletion = std::function<void(const RecvResult& result)>;
+
+  XSocketReactor();
+  ~XSocketReactor();
+
+  // The buffers must stay valid until the completion is called. Returns false
+  // if the reactor could not be started.
+  bool QueueRecv(object_ref<XSocket> socket,
+                 std::vector<XSocket::RecvBuffer> buffers, uint32_t flags,
+                 RecvCompletion completion);
+  // Completes the pending receives on the socket as aborted. Once this
+  // returns, the reactor doesn't access the host socket anymore, so it can be
+  // closed.
+  void CancelSocket(XSocket* socket);
+
+ private:
+  struct PendingRecv {
+    object_ref<XSocket> socket;
+    std::vector<XSocket::RecvBuffer> buffers;
+    uint32_t flags;
+    RecvCompletion completion;
+    RecvResult result;
+  };
+
+  // Must be called with the mutex locked.
+  bool EnsureStarted();
+  void Wake();
+  void DrainWakeSocket();
+  void ReactorThread();
+
+  std::mutex mutex_;
+  std::condition_variable poll_cond_;
+  std::unique_ptr<xe::threading::Thread> thread_;
+  bool start_failed_ = false;
+  bool shutdown_ = false;
+  // Whether the thread is waiting in poll with the sockets of the pending
+  // receives, and the number of polls that have ended, to wait for the thread
+  // to stop using a cancelled socket.
+  bool polling_ = false;
+  uint64_t poll_count_ = 0;
+  // Host socket woken up by sending a datagram from it to itself.
+  uint64_t wake_socket_ = uint64_t(-1);
+  // In the order the receives were issued in.
+  std::vector<PendingRecv> pending_recvs_;
+};
+
+}  // namespace kernel
+}  // namespace xe
+
+#endif  // XENIA_KERNEL_XSOCKET_REACTOR_H_
@@ -9,7 +9,10 @@
 
 #include "xenia/kernel/xthread.h"
 
+#include <algorithm>
+#include <array>
 #include <cstring>
+#include <map>
 
 #include "third_party/fmt/include/fmt/format.h"
 #include "xenia/base/byte_stream.h"
@@ -32,6 +35,18 @@ DEFINE_bool(ignore_thread_priorities, true,
             "Ignores game-specified thread priorities.", "Kernel");
 DEFINE_bool(ignore_thread_affinities, true,
             "Ignores game-specified thread affinities.", "Kernel");
+DEFINE_string(
+    thread_affinity_policy, "direct",
+    "How the guest hardware threads are mapped to the host logical processors "
+    "when game-specified thread affinities are not ignored.\n"
+    "Use: [direct, topology]\n"
+    " direct (or any value not listed here):\n"
+    "  Guest hardware thread N runs on host logical processor N.\n"
+    " topology:\n"
+    "  The two hardware threads of each guest core run on the SMT siblings of "
+    "a host core, and the guest cores run on host cores sharing the last level "
+    "cache when possible, preferring the fastest cores of hybrid CPUs.",
+    "Kernel");
 
 #if 0
 DEFINE_int64(stack_size_multiplier_hack, 1,
@@ -255,7 +270,18 @@ bool XThread::AllocateStack(uint32_t size) {
   size = xe::round_up(size, alignment);
   auto actual_size = size + padding;
 
-  uint32_t address = 0;
+  uint32_t address = kernel_state()->AcquirePooledGuestStack(actual_size);
+  if (address) {
+    // Reusing the stack of a destroyed thread, with the guard pages already
+    // set up, only clearing it as a new stack would be.
+    stack_alloc_base_ = address;
+    stack_alloc_size_ = actual_size;
+    stack_limit_ = address + (padding / 2);
+    stack_base_ = stack_limit_ + size;
+    memory()->Fill(stack_limit_, size, 0);
+    return true;
+  }
+
   if (!heap->AllocRange(
           kStackAddressRangeBegin, kStackAddressRangeEnd, actual_size,
           alignment, kMemoryAllocationReserve | kMemoryAllocationCommit,
@@ -277,8 +303,10 @@ bool XThread::AllocateStack(uint32_t size) {
 
 void XThread::FreeStack() {
   if (stack_alloc_base_) {
-    auto heap = memory()->LookupHeap(kStackAddressRangeBegin);
-    heap->Release(stack_alloc_base_);
+    if (!kernel_state()->PoolGuestStack(stack_alloc_base_, stack_alloc_size_)) {
+      auto heap = memory()->LookupHeap(kStackAddressRangeBegin);
+      heap->Release(stack_alloc_base_);
+    }
 
     stack_alloc_base_ = 0;
     stack_alloc_size_ = 0;
@@ -288,6 +316,8 @@ void XThread::FreeStack() {
 }
 
 X_STATUS XThread::Create() {
+  uint64_t start_host_ticks = Clock::QueryHostTickCount();
+
   // Thread kernel object.
   if (!CreateNative<X_KTHREAD>()) {
     XELOGW("Unable to allocate thread object");
@@ -307,7 +337,6 @@ X_STATUS XThread::Create() {
     module->GetOptHeader(XEX_HEADER_TLS_INFO, &tls_header);
   }
 
-  const uint32_t kDefaultTlsSlotCount = 1024;
   uint32_t tls_slots = kDefaultTlsSlotCount;
   uint32_t tls_extended_size = 0;
   if (tls_header && tls_header->slot_count) {
@@ -446,6 +475,7 @@ X_STATUS XThread::Create() {
     thread_->Resume();
   }
 
+  kernel_state()->RecordThreadCreation(start_host_ticks);
   return X_STATUS_SUCCESS;
 }
 
@@ -653,6 +683,86 @@ void XThread::SetPriority(int32_t increment) {
   }
 }
 
+namespace {
+
+// Orders the host logical processors so the first six are the best ones to
+// run the guest hardware threads on, with SMT siblings next to each other.
+std::array<uint64_t, 6> GetTopologyAffinityMasks() {
+  struct Core {
+    uint32_t efficiency_class = 0;
+    uint32_t cache_id = 0;
+    std::vector<uint32_t> processors;
+  };
+  std::map<uint32_t, Core> cores_by_id;
+  for (const xe::threading::LogicalProcessor& processor :
+       xe::threading::GetLogicalProcessors()) {
+    Core& core = cores_by_id[processor.core_id];
+    core.efficiency_class = processor.efficiency_class;
+    core.cache_id = processor.cache_id;
+    core.processors.push_back(processor.index);
+  }
+  uint32_t max_efficiency_class = 0;
+  for (const auto& core : cores_by_id) {
+    max_efficiency_class =
+        std::max(max_efficiency_class, core.second.efficiency_class);
+  }
+  // Prefer the cache shared by the most logical processors of the fastest
+  // cores.
+  std::map<uint32_t, uint32_t> fast_processor_counts_by_cache_id;
+  for (const auto& core : cores_by_id) {
+    if (core.second.efficiency_class == max_efficiency_class) {
+      fast_processor_counts_by_cache_id[core.second.cache_id] +=
+          uint32_t(core.second.processors.size());
+    }
+  }
+  uint32_t preferred_cache_id = 0;
+  uint32_t preferred_cache_processor_count = 0;
+  for (const auto& cache : fast_processor_counts_by_cache_id) {
+    if (cache.second > preferred_cache_processor_count) {
+      preferred_cache_id = cache.first;
+      preferred_cache_processor_count = cache.second;
+    }
+  }
+  std::vector<const Core*> cores;
+  for (const auto& core : cores_by_id) {
+    cores.push_back(&core.second);
+  }
+  std::stable_sort(
+      cores.begin(), cores.end(), [&](const Core* a, const Core* b) {
+        if (a->efficiency_class != b->efficiency_class) {
+          return a->efficiency_class > b->efficiency_class;
+        }
+        bool a_preferred = a->cache_id == preferred_cache_id;
+        bool b_preferred = b->cache_id == preferred_cache_id;
+        if (a_preferred != b_preferred) {
+          return a_preferred;
+        }
+        if (a->cache_id != b->cache_id) {
+          return a->cache_id < b->cache_id;
+        }
+        return a->processors.front() < b->processors.front();
+      });
+
+  std::array<uint64_t, 6> masks;
+  uint32_t mask_count = 0;
+  for (const Core* core : cores) {
+    for (uint32_t processor : core->processors) {
+      if (mask_count < masks.size()) {
+        masks[mask_count++] = uint64_t(1) << processor;
+      }
+    }
+  }
+  if (mask_count < masks.size()) {
+    // Not enough processors with known topology.
+    for (uint32_t i = 0; i < masks.size(); ++i) {
+      masks[i] = uint64_t(1) << i;
+    }
+  }
+  return masks;
+}
+
+}  // namespace
+
 void XThread::SetAffinity(uint32_t affinity) {
   SetActiveCpu(GetFakeCpuNumber(affinity));
 }
@@ -678,7 +788,13 @@ void XThread::SetActiveCpu(uint8_t cpu_index) {
 
   if (xe::threading::logical_processor_count() >= 6) {
     if (!cvars::ignore_thread_affinities) {
-      thread_->set_affinity_mask(uint64_t(1) << cpu_index);
+      uint64_t affinity_mask = uint64_t(1) << cpu_index;
+      if (cvars::thread_affinity_policy == "topology") {
+        static const std::array<uint64_t, 6> topology_affinity_masks =
+            GetTopologyAffinityMasks();
+        affinity_mask = topology_affinity_masks[cpu_index];
+      }
+      thread_->set_affinity_mask(affinity_mask);
     }
   } else {
     // there no good reason why we need to log this... we don't perfectly
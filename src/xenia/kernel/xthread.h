@@ -46,6 +46,9 @@ struct XDPC {
     type = 19;
     selected_cpu_number = 0;
     desired_cpu_number = 0;
+    // Not queued.
+    list_entry.flink_ptr = 0;
+    list_entry.blink_ptr = 0;
     routine = guest_func;
     context = guest_context;
   }
@@ -271,6 +274,9 @@ class XThread : public XObject, public cpu::Thread {
 
   static constexpr uint32_t kThreadKernelStackSize = 0xF0;
 
+  // TLS slots of the threads of titles not specifying the count.
+  static constexpr uint32_t kDefaultTlsSlotCount = 1024;
+
   struct CreationParams {
     uint32_t stack_size;
     uint32_t xapi_thread_startup;
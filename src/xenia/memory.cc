@@ -14,13 +14,19 @@
 #include <utility>
 
 #include "third_party/fmt/include/fmt/format.h"
+#include "third_party/zstd/lib/zstd.h"
 #include "xenia/base/assert.h"
 #include "xenia/base/byte_stream.h"
 #include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
+#include "xenia/base/mapped_memory.h"
 #include "xenia/base/math.h"
+#include "xenia/base/profiling.h"
+#include "xenia/base/startup_timeline.h"
 #include "xenia/base/threading.h"
+#include "xenia/base/xxhash.h"
 
 #include "xenia/cpu/mmio_handler.h"
 
@@ -33,6 +39,30 @@ DEFINE_bool(protect_on_release, false,
             "Protect released memory to prevent accesses.", "Memory");
 DEFINE_bool(scribble_heap, false,
             "Scribble 0xCD into all allocated heap memory.", "Memory");
+DEFINE_bool(
+    physical_memory_write_watch, false,
+    "Detect CPU writes to GPU-visible physical memory by polling the write "
+    "tracking of the host OS in batches when the GPU receives commands, "
+    "instead of protecting the pages and handling an access violation on the "
+    "first write to each of them.\n"
+    "Requires Linux 6.7 or newer (asynchronous userfaultfd write protection "
+    "and PAGEMAP_SCAN), not available on Windows.\n"
+    "Compare the memory/physical_write_faults and "
+    "memory/physical_write_watch_ranges profiler counters.",
+    "Memory");
+DEFINE_bool(
+    guest_memory_large_pages, false,
+    "Ask the host to back the guest address space with large (2 MB) pages "
+    "where possible to reduce TLB misses on guest memory accesses.\n"
+    "Uses transparent huge pages on Linux (requires "
+    "/sys/kernel/mm/transparent_hugepage/enabled to be madvise or always), "
+    "not available on Windows.",
+    "Memory");
+DEFINE_uint32(
+    memory_statistics_log_interval, 0,
+    "Interval in milliseconds between log lines with the page usage, "
+    "fragmentation and allocation rate of every guest heap, 0 to disable.",
+    "Memory");
 
 namespace xe {
 uint32_t get_page_count(uint32_t value, uint32_t page_size) {
@@ -107,6 +137,12 @@ Memory::~Memory() {
   assert_true(active_memory_ == this);
   active_memory_ = nullptr;
 
+  if (statistics_log_thread_) {
+    statistics_log_shutdown_event_->Set();
+    xe::threading::Wait(statistics_log_thread_.get(), false);
+    statistics_log_thread_.reset();
+  }
+
   // Uninstall the MMIO handler, as we won't be able to service more
   // requests.
   mmio_handler_.reset();
@@ -114,6 +150,9 @@ Memory::~Memory() {
   for (auto invalidation_callback : physical_memory_invalidation_callbacks_) {
     delete invalidation_callback;
   }
+  for (auto write_unprotect_callback : write_unprotect_callbacks_) {
+    delete write_unprotect_callback;
+  }
 
   heaps_.v00000000.Dispose();
   heaps_.v40000000.Dispose();
@@ -137,6 +176,7 @@ Memory::~Memory() {
 }
 
 bool Memory::Initialize() {
+  StartupTimelinePhase startup_phase("Memory::Initialize");
   file_name_ = fmt::format("xenia_memory_{}", Clock::QueryHostTickCount());
 
   // Create main page file-backed mapping. This is all reserved but
@@ -229,14 +269,76 @@ bool Memory::Initialize() {
     return false;
   }
 
+  if (cvars::physical_memory_write_watch) {
+    physical_write_watch_ = xe::memory::WriteWatch::Create();
+    if (physical_write_watch_ &&
+        (!heaps_.vA0000000.RegisterWriteWatch(*physical_write_watch_) ||
+         !heaps_.vC0000000.RegisterWriteWatch(*physical_write_watch_) ||
+         !heaps_.vE0000000.RegisterWriteWatch(*physical_write_watch_))) {
+      physical_write_watch_.reset();
+    }
+    if (physical_write_watch_) {
+      XELOGI("Using OS write tracking for physical memory watches");
+    } else {
+      XELOGW(
+          "OS write tracking is not available, using page protection for "
+          "physical memory watches");
+    }
+  }
+
   // ?
   uint32_t unk_phys_alloc;
   heaps_.vA0000000.Alloc(0x340000, 64 * 1024, kMemoryAllocationReserve,
                          kMemoryProtectNoAccess, true, &unk_phys_alloc);
 
+  if (cvars::memory_statistics_log_interval) {
+    statistics_log_shutdown_event_ =
+        xe::threading::Event::CreateManualResetEvent(false);
+    statistics_log_thread_ =
+        xe::threading::Thread::Create({}, [this]() { StatisticsLogThread(); });
+    statistics_log_thread_->set_name("Memory Statistics Log");
+  }
+
   return true;
 }
 
+void Memory::StatisticsLogThread() {
+  std::vector<HeapStatistics> statistics;
+  std::vector<HeapStatistics> last_statistics;
+  uint64_t last_host_ticks = Clock::QueryHostTickCount();
+  double ticks_to_us =
+      1000000.0 / static_cast<double>(Clock::QueryHostTickFrequency());
+  while (xe::threading::Wait(statistics_log_shutdown_event_.get(), false,
+                             std::chrono::milliseconds(
+                                 cvars::memory_statistics_log_interval)) ==
+         xe::threading::WaitResult::kTimeout) {
+    GetHeapStatistics(statistics);
+    uint64_t host_ticks = Clock::QueryHostTickCount();
+    double seconds = double(host_ticks - last_host_ticks) /
+                     double(Clock::QueryHostTickFrequency());
+    last_host_ticks = host_ticks;
+    for (size_t i = 0; i < statistics.size(); ++i) {
+      const HeapStatistics& heap = statistics[i];
+      uint64_t allocs = heap.alloc_count;
+      if (i < last_statistics.size()) {
+        allocs -= last_statistics[i].alloc_count;
+      }
+      // Key-value pairs so the lines can be parsed by scripts.
+      XELOGI(
+          "Memory statistics: heap={} page_size={} committed_pages={} "
+          "reserved_pages={} free_pages={} free_ranges={} "
+          "largest_free_range={} allocs={} alloc_failures={} "
+          "allocs_per_second={:.1f} alloc_max_us={:.3f}",
+          heap.name, heap.page_size, heap.committed_page_count,
+          heap.reserved_page_count, heap.unreserved_page_count,
+          heap.free_range_count, heap.largest_free_range, heap.alloc_count,
+          heap.alloc_failure_count, seconds > 0.0 ? allocs / seconds : 0.0,
+          heap.alloc_max_host_ticks * ticks_to_us);
+    }
+    std::swap(statistics, last_statistics);
+  }
+}
+
 void Memory::SetMMIOExceptionRecordingCallback(
     cpu::MmioAccessRecordCallback callback, void* context) {
   mmio_handler_->SetMMIOExceptionRecordingCallback(callback, context);
@@ -305,7 +407,9 @@ static const struct {
 int Memory::MapViews(uint8_t* mapping_base) {
   assert_true(xe::countof(map_info) == xe::countof(views_.all_views));
   // 0xE0000000 4 KB offset is emulated via host_address_offset and on the CPU
-  // side if system allocation granularity is bigger than 4 KB.
+  // side if system allocation granularity is bigger than 4 KB. Both the host
+  // address and the mapping offset of a view must be aligned to the
+  // granularity, so no view layout can make the 4 KB offset a single base add.
   uint64_t granularity_mask = ~uint64_t(system_allocation_granularity_ - 1);
   for (size_t n = 0; n < xe::countof(map_info); n++) {
     views_.all_views[n] = reinterpret_cast<uint8_t*>(xe::memory::MapFileView(
@@ -319,6 +423,22 @@ int Memory::MapViews(uint8_t* mapping_base) {
       return 1;
     }
   }
+  if (cvars::guest_memory_large_pages) {
+    size_t large_page_view_count = 0;
+    for (size_t n = 0; n < xe::countof(map_info); n++) {
+      if (xe::memory::AdviseLargePages(
+              views_.all_views[n], map_info[n].virtual_address_end -
+                                       map_info[n].virtual_address_start + 1)) {
+        ++large_page_view_count;
+      }
+    }
+    if (large_page_view_count) {
+      XELOGI("Requested large pages for {} of {} guest memory views",
+             large_page_view_count, xe::countof(map_info));
+    } else {
+      XELOGW("Large pages for the guest memory aren't supported by the host");
+    }
+  }
   return 0;
 }
 
@@ -444,6 +564,20 @@ void Memory::GetHeapsPageStatsSummary(const BaseHeap* const* provided_heaps,
   }
 }
 
+void Memory::GetHeapStatistics(std::vector<HeapStatistics>& statistics) {
+  const std::pair<const char*, BaseHeap*> heaps[] = {
+      {"v00000000", &heaps_.v00000000}, {"v40000000", &heaps_.v40000000},
+      {"v80000000", &heaps_.v80000000}, {"v90000000", &heaps_.v90000000},
+      {"vA0000000", &heaps_.vA0000000}, {"vC0000000", &heaps_.vC0000000},
+      {"vE0000000", &heaps_.vE0000000}, {"physical", &heaps_.physical},
+  };
+  statistics.resize(xe::countof(heaps));
+  for (size_t i = 0; i < xe::countof(heaps); ++i) {
+    heaps[i].second->GetStatistics(statistics[i]);
+    statistics[i].name = heaps[i].first;
+  }
+}
+
 uint32_t Memory::HostToGuestVirtual(const void* host_address) const {
   size_t virtual_address = reinterpret_cast<size_t>(host_address) -
                            reinterpret_cast<size_t>(virtual_membase_);
@@ -473,17 +607,17 @@ uint32_t Memory::GetPhysicalAddress(uint32_t address) const {
 }
 
 void Memory::Zero(uint32_t address, uint32_t size) {
-  std::memset(TranslateVirtual(address), 0, size);
+  xe::fill_bytes(TranslateVirtual(address), 0, size);
 }
 
 void Memory::Fill(uint32_t address, uint32_t size, uint8_t value) {
-  std::memset(TranslateVirtual(address), value, size);
+  xe::fill_bytes(TranslateVirtual(address), value, size);
 }
 
 void Memory::Copy(uint32_t dest, uint32_t src, uint32_t size) {
   uint8_t* pdest = TranslateVirtual(dest);
   const uint8_t* psrc = TranslateVirtual(src);
-  std::memcpy(pdest, psrc, size);
+  xe::copy_bytes(pdest, psrc, size);
 }
 
 uint32_t Memory::SearchAligned(uint32_t start, uint32_t end,
@@ -552,8 +686,12 @@ bool Memory::AccessViolationCallback(
   // Will be rounded to physical page boundaries internally, so just pass 1 as
   // the length - guranteed not to cross page boundaries also.
   auto physical_heap = static_cast<PhysicalHeap*>(heap);
-  return physical_heap->TriggerCallbacks(std::move(global_lock_locked_once),
-                                         virtual_address, 1, is_write, false);
+  if (!physical_heap->TriggerCallbacks(std::move(global_lock_locked_once),
+                                       virtual_address, 1, is_write, false)) {
+    return false;
+  }
+  physical_write_faults_.fetch_add(1, std::memory_order_relaxed);
+  return true;
 }
 
 bool Memory::AccessViolationCallbackThunk(
@@ -576,6 +714,22 @@ bool Memory::TriggerPhysicalMemoryCallbacks(
   return false;
 }
 
+void Memory::PollPhysicalMemoryWrites() {
+  COUNT_profile_set("memory/physical_write_faults",
+                    physical_write_faults_.load(std::memory_order_relaxed));
+  if (!physical_write_watch_) {
+    return;
+  }
+  physical_write_watch_ranges_ +=
+      heaps_.vA0000000.PollWriteWatch(*physical_write_watch_);
+  physical_write_watch_ranges_ +=
+      heaps_.vC0000000.PollWriteWatch(*physical_write_watch_);
+  physical_write_watch_ranges_ +=
+      heaps_.vE0000000.PollWriteWatch(*physical_write_watch_);
+  COUNT_profile_set("memory/physical_write_watch_ranges",
+                    physical_write_watch_ranges_);
+}
+
 void* Memory::RegisterPhysicalMemoryInvalidationCallback(
     PhysicalMemoryInvalidationCallback callback, void* callback_context) {
   auto entry = new std::pair<PhysicalMemoryInvalidationCallback, void*>(
@@ -602,6 +756,30 @@ void Memory::UnregisterPhysicalMemoryInvalidationCallback(
   delete entry;
 }
 
+void* Memory::RegisterWriteUnprotectCallback(WriteUnprotectCallback callback,
+                                             void* callback_context) {
+  auto entry =
+      new std::pair<WriteUnprotectCallback, void*>(callback, callback_context);
+  auto lock = global_critical_region_.Acquire();
+  write_unprotect_callbacks_.push_back(entry);
+  return entry;
+}
+
+void Memory::UnregisterWriteUnprotectCallback(void* callback_handle) {
+  auto entry = reinterpret_cast<std::pair<WriteUnprotectCallback, void*>*>(
+      callback_handle);
+  {
+    auto lock = global_critical_region_.Acquire();
+    auto it = std::find(write_unprotect_callbacks_.begin(),
+                        write_unprotect_callbacks_.end(), entry);
+    assert_true(it != write_unprotect_callbacks_.end());
+    if (it != write_unprotect_callbacks_.end()) {
+      write_unprotect_callbacks_.erase(it);
+    }
+  }
+  delete entry;
+}
+
 void Memory::EnablePhysicalMemoryAccessCallbacks(
     uint32_t physical_address, uint32_t length,
     bool enable_invalidation_notifications, bool enable_data_providers) {
@@ -682,6 +860,13 @@ bool Memory::Save(ByteStream* stream) {
 }
 
 bool Memory::Restore(ByteStream* stream) {
+  if (stream->data_length() - stream->offset() >= sizeof(uint32_t)) {
+    if (stream->Read<uint32_t>() == kMemorySnapshotSignature) {
+      return RestoreSnapshot(stream);
+    }
+    stream->set_offset(stream->offset() - sizeof(uint32_t));
+  }
+
   XELOGD("Restoring memory...");
   heaps_.v00000000.Restore(stream);
   heaps_.v40000000.Restore(stream);
@@ -692,6 +877,254 @@ bool Memory::Restore(ByteStream* stream) {
   return true;
 }
 
+void Memory::GetSnapshotHeaps(BaseHeap* heaps[MemorySnapshot::kHeapCount]) {
+  heaps[0] = &heaps_.v00000000;
+  heaps[1] = &heaps_.v40000000;
+  heaps[2] = &heaps_.v80000000;
+  heaps[3] = &heaps_.v90000000;
+  heaps[4] = &heaps_.physical;
+}
+
+std::shared_ptr<MemorySnapshot> Memory::CaptureSnapshot(
+    const std::filesystem::path& path, uint64_t offset) {
+  // Long chains make restoring slower, and each file in them must be kept.
+  constexpr size_t kMaxSnapshotChainLength = 16;
+  if (snapshot_chain_paths_.size() >= kMaxSnapshotChainLength ||
+      std::find(snapshot_chain_paths_.begin(), snapshot_chain_paths_.end(),
+                path) != snapshot_chain_paths_.end()) {
+    ResetSnapshotChain();
+  }
+  auto snapshot = std::make_shared<MemorySnapshot>();
+  if (!snapshot_chain_paths_.empty()) {
+    snapshot->parent_path = snapshot_chain_paths_.back();
+    snapshot->parent_offset = snapshot_offset_;
+  }
+  BaseHeap* heaps[MemorySnapshot::kHeapCount];
+  GetSnapshotHeaps(heaps);
+  for (uint32_t i = 0; i < MemorySnapshot::kHeapCount; ++i) {
+    heaps[i]->CaptureSnapshot(i, snapshot_page_hashes_[i], *snapshot);
+  }
+  XELOGD("Captured {} changed pages in a memory snapshot",
+         snapshot->pages.size());
+  snapshot_chain_paths_.push_back(path);
+  snapshot_offset_ = offset;
+  return snapshot;
+}
+
+void Memory::ResetSnapshotChain() {
+  for (std::vector<uint64_t>& page_hashes : snapshot_page_hashes_) {
+    page_hashes.clear();
+  }
+  snapshot_chain_paths_.clear();
+  snapshot_offset_ = 0;
+}
+
+bool MemorySnapshot::Write(FILE* file) const {
+  // The slowest part, done on multiple threads.
+  std::vector<std::vector<uint8_t>> encoded_blocks(blocks.size());
+  xe::threading::ParallelFor(
+      blocks.size(), "Memory Snapshot Compression", [&](size_t block_index) {
+        const std::vector<uint8_t>& block = blocks[block_index];
+        std::vector<uint8_t>& encoded_block = encoded_blocks[block_index];
+        encoded_block.resize(ZSTD_compressBound(block.size()));
+        size_t encoded_length =
+            ZSTD_compress(encoded_block.data(), encoded_block.size(),
+                          block.data(), block.size(), 1);
+        if (!ZSTD_isError(encoded_length) && encoded_length < block.size()) {
+          encoded_block.resize(encoded_length);
+        } else {
+          // Stored uncompressed.
+          encoded_block.clear();
+        }
+      });
+
+  bool result = true;
+  auto write = [&](const void* data, size_t size) {
+    if (size && fwrite(data, 1, size, file) != size) {
+      result = false;
+    }
+  };
+  auto write_uint32 = [&](uint32_t value) { write(&value, sizeof(value)); };
+  write_uint32(kMemorySnapshotSignature);
+  write_uint32(kVersion);
+  std::string parent_path_utf8 = xe::path_to_utf8(parent_path);
+  write_uint32(uint32_t(parent_path_utf8.size()));
+  write(parent_path_utf8.data(), parent_path_utf8.size());
+  write(&parent_offset, sizeof(parent_offset));
+  for (const std::vector<uint64_t>& page_table : page_tables) {
+    write_uint32(uint32_t(page_table.size()));
+    write(page_table.data(), sizeof(uint64_t) * page_table.size());
+  }
+  write_uint32(uint32_t(pages.size()));
+  write(pages.data(), sizeof(Page) * pages.size());
+  write_uint32(uint32_t(blocks.size()));
+  auto get_stored_block = [&](size_t i) -> const std::vector<uint8_t>& {
+    return encoded_blocks[i].empty() ? blocks[i] : encoded_blocks[i];
+  };
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    write_uint32(uint32_t(blocks[i].size()));
+    write_uint32(uint32_t(get_stored_block(i).size()));
+  }
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    write(get_stored_block(i).data(), get_stored_block(i).size());
+  }
+  return result;
+}
+
+bool Memory::RestoreSnapshot(ByteStream* stream) {
+  XELOGD("Restoring the memory snapshot...");
+  BaseHeap* heaps[MemorySnapshot::kHeapCount];
+  GetSnapshotHeaps(heaps);
+  std::vector<bool> restored_pages[MemorySnapshot::kHeapCount];
+  // Committed pages not restored from any snapshot in the chain yet.
+  size_t remaining_page_count = 0;
+
+  // The signature has already been read for the first snapshot in the chain.
+  std::unique_ptr<MappedMemory> parent_map;
+  std::unique_ptr<ByteStream> parent_stream;
+  std::vector<uint8_t> decoded_block;
+  bool is_newest = true;
+  bool result = true;
+  while (true) {
+    auto has_remaining = [&](size_t size) {
+      return stream->data_length() - stream->offset() >= size;
+    };
+    if (!has_remaining(sizeof(uint32_t)) ||
+        stream->Read<uint32_t>() != MemorySnapshot::kVersion) {
+      XELOGE("Unsupported memory snapshot version");
+      result = false;
+      break;
+    }
+    std::string parent_path = stream->Read<std::string>();
+    uint64_t parent_offset = stream->Read<uint64_t>();
+
+    for (uint32_t i = 0; i < MemorySnapshot::kHeapCount; ++i) {
+      std::vector<uint64_t> page_table(stream->Read<uint32_t>());
+      if (page_table.size() != heaps[i]->total_page_count() ||
+          !has_remaining(sizeof(uint64_t) * page_table.size())) {
+        XELOGE("Memory snapshot heap {} doesn't match the current heap", i);
+        result = false;
+        break;
+      }
+      stream->Read(page_table.data(), sizeof(uint64_t) * page_table.size());
+      if (!is_newest) {
+        continue;
+      }
+      heaps[i]->RestoreSnapshotPageTable(page_table);
+      restored_pages[i].resize(page_table.size());
+      for (uint32_t j = 0; j < uint32_t(page_table.size()); ++j) {
+        if (heaps[i]->IsPageCommitted(j)) {
+          ++remaining_page_count;
+        }
+      }
+    }
+    if (!result) {
+      break;
+    }
+
+    std::vector<MemorySnapshot::Page> pages(stream->Read<uint32_t>());
+    if (!has_remaining(sizeof(MemorySnapshot::Page) * pages.size())) {
+      result = false;
+      break;
+    }
+    stream->Read(pages.data(), sizeof(MemorySnapshot::Page) * pages.size());
+    struct BlockSize {
+      uint32_t decoded_length;
+      uint32_t encoded_length;
+    };
+    std::vector<BlockSize> block_sizes(stream->Read<uint32_t>());
+    if (!has_remaining(sizeof(BlockSize) * block_sizes.size())) {
+      result = false;
+      break;
+    }
+    stream->Read(block_sizes.data(), sizeof(BlockSize) * block_sizes.size());
+    size_t page_index = 0;
+    for (const BlockSize& block_size : block_sizes) {
+      if (!has_remaining(block_size.encoded_length)) {
+        result = false;
+        break;
+      }
+      const uint8_t* block = stream->data() + stream->offset();
+      stream->Advance(block_size.encoded_length);
+      if (block_size.encoded_length != block_size.decoded_length) {
+        decoded_block.resize(block_size.decoded_length);
+        if (ZSTD_decompress(decoded_block.data(), decoded_block.size(), block,
+                            block_size.encoded_length) !=
+            block_size.decoded_length) {
+          result = false;
+          break;
+        }
+        block = decoded_block.data();
+      }
+      for (uint32_t block_offset = 0;
+           block_offset < block_size.decoded_length; ++page_index) {
+        if (page_index >= pages.size() ||
+            pages[page_index].heap_index >= MemorySnapshot::kHeapCount) {
+          result = false;
+          break;
+        }
+        const MemorySnapshot::Page& page = pages[page_index];
+        BaseHeap* heap = heaps[page.heap_index];
+        uint32_t page_size = heap->page_size();
+        if (page.page_index >= heap->total_page_count() ||
+            block_size.decoded_length - block_offset < page_size) {
+          result = false;
+          break;
+        }
+        // Only the newest contents of the pages that are committed now.
+        if (heap->IsPageCommitted(page.page_index) &&
+            !restored_pages[page.heap_index][page.page_index]) {
+          std::memcpy(heap->TranslateRelative(size_t(page.page_index) *
+                                              page_size),
+                      block + block_offset, page_size);
+          restored_pages[page.heap_index][page.page_index] = true;
+          --remaining_page_count;
+        }
+        block_offset += page_size;
+      }
+      if (!result) {
+        break;
+      }
+    }
+    if (!result) {
+      XELOGE("The memory snapshot is corrupted");
+      break;
+    }
+
+    is_newest = false;
+    if (!remaining_page_count || parent_path.empty()) {
+      break;
+    }
+    parent_map = MappedMemory::Open(xe::to_path(parent_path),
+                                    MappedMemory::Mode::kRead);
+    if (!parent_map || parent_offset >= parent_map->size()) {
+      XELOGE("Failed to open the parent memory snapshot {}", parent_path);
+      result = false;
+      break;
+    }
+    parent_stream = std::make_unique<ByteStream>(
+        parent_map->data(), parent_map->size(), size_t(parent_offset));
+    stream = parent_stream.get();
+    if (!has_remaining(sizeof(uint32_t)) ||
+        stream->Read<uint32_t>() != kMemorySnapshotSignature) {
+      XELOGE("{} doesn't contain a memory snapshot", parent_path);
+      result = false;
+      break;
+    }
+  }
+  if (result && remaining_page_count) {
+    XELOGW("{} committed pages are missing from the memory snapshots",
+           remaining_page_count);
+  }
+
+  for (BaseHeap* heap : heaps) {
+    heap->RestoreSnapshotProtection();
+  }
+  // The hashes of the restored pages are unknown.
+  ResetSnapshotChain();
+  return result;
+}
+
 uint32_t FromPageAccess(xe::memory::PageAccess protect) {
   switch (protect) {
     case memory::PageAccess::kNoAccess:
@@ -732,6 +1165,128 @@ void BaseHeap::Initialize(Memory* memory, uint8_t* membase, HeapType heap_type,
   host_address_offset_ = host_address_offset;
   page_table_.resize(heap_size / page_size);
   unreserved_page_count_ = uint32_t(page_table_.size());
+  free_pages_.resize((page_table_.size() + 63) >> 6);
+  free_page_summary_.resize((free_pages_.size() + 63) >> 6);
+  RebuildFreePages();
+}
+
+void BaseHeap::SetPagesFree(uint32_t first_page, uint32_t page_count,
+                            bool is_free) {
+  uint32_t page = first_page;
+  uint32_t end_page = first_page + page_count;
+  while (page < end_page) {
+    uint32_t word_index = page >> 6;
+    uint32_t bit_index = page & 63;
+    uint32_t bit_count = std::min(64 - bit_index, end_page - page);
+    uint64_t mask =
+        (bit_count == 64 ? ~uint64_t(0) : (uint64_t(1) << bit_count) - 1)
+        << bit_index;
+    uint64_t& word = free_pages_[word_index];
+    if (is_free) {
+      word |= mask;
+    } else {
+      word &= ~mask;
+    }
+    uint64_t summary_mask = uint64_t(1) << (word_index & 63);
+    if (word) {
+      free_page_summary_[word_index >> 6] |= summary_mask;
+    } else {
+      free_page_summary_[word_index >> 6] &= ~summary_mask;
+    }
+    page += bit_count;
+  }
+}
+
+void BaseHeap::RebuildFreePages() {
+  std::fill(free_pages_.begin(), free_pages_.end(), 0);
+  std::fill(free_page_summary_.begin(), free_page_summary_.end(), 0);
+  for (uint32_t i = 0; i < uint32_t(page_table_.size()); ++i) {
+    if (!page_table_[i].state) {
+      SetPagesFree(i, 1, true);
+    }
+  }
+}
+
+uint32_t BaseHeap::FindPage(uint32_t first_page, uint32_t last_page,
+                            bool is_free) const {
+  if (first_page > last_page) {
+    return UINT32_MAX;
+  }
+  uint64_t invert = is_free ? 0 : ~uint64_t(0);
+  uint32_t last_word_index = last_page >> 6;
+  uint32_t word_index = first_page >> 6;
+  uint64_t word =
+      (free_pages_[word_index] ^ invert) & (~uint64_t(0) << (first_page & 63));
+  while (!word) {
+    if (++word_index > last_word_index) {
+      return UINT32_MAX;
+    }
+    if (is_free) {
+      // Skip the fully reserved words using the summary.
+      uint32_t summary_index = word_index >> 6;
+      uint64_t summary = free_page_summary_[summary_index] &
+                         (~uint64_t(0) << (word_index & 63));
+      while (!summary) {
+        if (++summary_index > (last_word_index >> 6)) {
+          return UINT32_MAX;
+        }
+        summary = free_page_summary_[summary_index];
+      }
+      word_index = (summary_index << 6) + xe::tzcnt(summary);
+      if (word_index > last_word_index) {
+        return UINT32_MAX;
+      }
+    }
+    word = free_pages_[word_index] ^ invert;
+  }
+  uint32_t page = (word_index << 6) + xe::tzcnt(word);
+  return page <= last_page ? page : UINT32_MAX;
+}
+
+uint32_t BaseHeap::FindPageReverse(uint32_t first_page, uint32_t last_page,
+                                   bool is_free) const {
+  if (first_page > last_page) {
+    return UINT32_MAX;
+  }
+  uint64_t invert = is_free ? 0 : ~uint64_t(0);
+  uint32_t first_word_index = first_page >> 6;
+  uint32_t word_index = last_page >> 6;
+  uint64_t word = (free_pages_[word_index] ^ invert) &
+                  (~uint64_t(0) >> (63 - (last_page & 63)));
+  while (!word) {
+    if (word_index-- == first_word_index) {
+      return UINT32_MAX;
+    }
+    if (is_free) {
+      // Skip the fully reserved words using the summary.
+      uint32_t summary_index = word_index >> 6;
+      uint64_t summary = free_page_summary_[summary_index] &
+                         (~uint64_t(0) >> (63 - (word_index & 63)));
+      while (!summary) {
+        if (summary_index-- == (first_word_index >> 6)) {
+          return UINT32_MAX;
+        }
+        summary = free_page_summary_[summary_index];
+      }
+      word_index = (summary_index << 6) + 63 - xe::lzcnt(summary);
+      if (word_index < first_word_index) {
+        return UINT32_MAX;
+      }
+    }
+    word = free_pages_[word_index] ^ invert;
+  }
+  uint32_t page = (word_index << 6) + 63 - xe::lzcnt(word);
+  return page >= first_page ? page : UINT32_MAX;
+}
+
+void BaseHeap::RecordAllocation(uint64_t start_host_ticks, bool succeeded) {
+  uint64_t host_ticks = Clock::QueryHostTickCount() - start_host_ticks;
+  ++alloc_count_;
+  if (!succeeded) {
+    ++alloc_failure_count_;
+  }
+  alloc_host_ticks_ += host_ticks;
+  alloc_max_host_ticks_ = std::max(alloc_max_host_ticks_, host_ticks);
 }
 
 void BaseHeap::Dispose() {
@@ -747,6 +1302,46 @@ void BaseHeap::Dispose() {
   }
 }
 
+void BaseHeap::GetStatistics(HeapStatistics& statistics) {
+  auto global_lock = global_critical_region_.Acquire();
+  statistics = {};
+  statistics.heap_base = heap_base_;
+  statistics.heap_size = heap_size_;
+  statistics.page_size = page_size_;
+  statistics.total_page_count = uint32_t(page_table_.size());
+  statistics.unreserved_page_count = unreserved_page_count_;
+  statistics.alloc_count = alloc_count_;
+  statistics.alloc_failure_count = alloc_failure_count_;
+  statistics.alloc_host_ticks = alloc_host_ticks_;
+  statistics.alloc_max_host_ticks = alloc_max_host_ticks_;
+  // Alternating free and reserved ranges, only the pages of the reserved ones
+  // are visited for their commit state.
+  uint32_t last_page = uint32_t(page_table_.size()) - 1;
+  uint32_t page = 0;
+  while (page <= last_page) {
+    uint32_t end_page =
+        FindPage(page, last_page, page_table_[page].state != 0);
+    if (end_page == UINT32_MAX) {
+      end_page = last_page + 1;
+    }
+    if (page_table_[page].state) {
+      for (uint32_t i = page; i < end_page; ++i) {
+        if (page_table_[i].state & kMemoryAllocationCommit) {
+          ++statistics.committed_page_count;
+        }
+      }
+    } else {
+      ++statistics.free_range_count;
+      statistics.largest_free_range =
+          std::max(statistics.largest_free_range, end_page - page);
+    }
+    page = end_page;
+  }
+  statistics.reserved_page_count = statistics.total_page_count -
+                                   statistics.unreserved_page_count -
+                                   statistics.committed_page_count;
+}
+
 void BaseHeap::DumpMap() {
   auto global_lock = global_critical_region_.Acquire();
   XELOGE("------------------------------------------------------------------");
@@ -757,6 +1352,27 @@ void BaseHeap::DumpMap() {
   XELOGE("            Page Size: {0} ({0:08X})", page_size_);
   XELOGE("           Page Count: {}", page_table_.size());
   XELOGE("  Host Address Offset: {0} ({0:08X})", host_address_offset_);
+  HeapStatistics statistics;
+  GetStatistics(statistics);
+  XELOGE("      Committed Pages: {}, {} only reserved",
+         statistics.committed_page_count, statistics.reserved_page_count);
+  // The share of the unreserved pages not available to the largest
+  // allocation.
+  XELOGE("     Unreserved Pages: {} in {} ranges, largest {}, {:.1f}% "
+         "fragmented",
+         unreserved_page_count_, statistics.free_range_count,
+         statistics.largest_free_range,
+         unreserved_page_count_
+             ? 100.0 * (1.0 - double(statistics.largest_free_range) /
+                                  double(unreserved_page_count_))
+             : 0.0);
+  double ticks_to_us =
+      1000000.0 / static_cast<double>(Clock::QueryHostTickFrequency());
+  XELOGE("          Allocations: {} ({} failed), {:.3f} us average, {:.3f} "
+         "us max",
+         alloc_count_, alloc_failure_count_,
+         alloc_count_ ? alloc_host_ticks_ * ticks_to_us / alloc_count_ : 0.0,
+         alloc_max_host_ticks_ * ticks_to_us);
   bool is_empty_span = false;
   uint32_t empty_span_start = 0;
   for (uint32_t i = 0; i < uint32_t(page_table_.size()); ++i) {
@@ -866,13 +1482,107 @@ bool BaseHeap::Restore(ByteStream* stream) {
       xe::memory::Protect(addr, page_size_, page_access, nullptr);
     }
   }
+  RebuildFreePages();
 
   return true;
 }
 
+void BaseHeap::CaptureSnapshot(uint32_t heap_index,
+                               std::vector<uint64_t>& page_hashes,
+                               MemorySnapshot& snapshot) {
+  auto global_lock = global_critical_region_.Acquire();
+  std::vector<uint64_t>& page_table = snapshot.page_tables[heap_index];
+  page_table.resize(page_table_.size());
+  page_hashes.resize(page_table_.size());
+  for (size_t i = 0; i < page_table_.size(); ++i) {
+    const PageEntry& page = page_table_[i];
+    page_table[i] = page.qword;
+    if (!(page.state & kMemoryAllocationCommit)) {
+      page_hashes[i] = 0;
+      continue;
+    }
+    uint8_t* address = TranslateRelative(i * page_size_);
+    memory::PageAccess old_access;
+    bool is_unreadable = !(page.current_protect & kMemoryProtectRead);
+    if (is_unreadable) {
+      memory::Protect(address, page_size_, memory::PageAccess::kReadOnly,
+                      &old_access);
+    }
+    // 0 is reserved for pages not stored in the snapshots.
+    uint64_t page_hash =
+        std::max(uint64_t(XXH3_64bits(address, page_size_)), uint64_t(1));
+    if (page_hash != page_hashes[i]) {
+      page_hashes[i] = page_hash;
+      if (snapshot.blocks.empty() ||
+          snapshot.blocks.back().size() + page_size_ >
+              MemorySnapshot::kBlockSize) {
+        snapshot.blocks.emplace_back().reserve(
+            std::max(MemorySnapshot::kBlockSize, size_t(page_size_)));
+      }
+      std::vector<uint8_t>& block = snapshot.blocks.back();
+      block.insert(block.end(), address, address + page_size_);
+      snapshot.pages.push_back({heap_index, uint32_t(i)});
+    }
+    if (is_unreadable) {
+      memory::Protect(address, page_size_, old_access, nullptr);
+    }
+  }
+}
+
+bool BaseHeap::RestoreSnapshotPageTable(
+    const std::vector<uint64_t>& page_table) {
+  if (page_table.size() != page_table_.size()) {
+    return false;
+  }
+  auto global_lock = global_critical_region_.Acquire();
+  unreserved_page_count_ = 0;
+  for (size_t i = 0; i < page_table_.size(); ++i) {
+    PageEntry& page = page_table_[i];
+    page.qword = page_table[i];
+    if (!page.state) {
+      ++unreserved_page_count_;
+      continue;
+    }
+    // Commit the memory if it isn't already. We do not need to reserve any
+    // memory, as the mapping has already taken care of that.
+    if (page.state & kMemoryAllocationCommit) {
+      void* address = TranslateRelative(i * page_size_);
+      xe::memory::AllocFixed(address, page_size_,
+                             memory::AllocationType::kCommit,
+                             memory::PageAccess::kReadWrite);
+      xe::memory::Protect(address, page_size_, memory::PageAccess::kReadWrite,
+                          nullptr);
+    }
+  }
+  RebuildFreePages();
+  return true;
+}
+
+void BaseHeap::RestoreSnapshotProtection() {
+  auto global_lock = global_critical_region_.Acquire();
+  for (size_t i = 0; i < page_table_.size(); ++i) {
+    const PageEntry& page = page_table_[i];
+    if (!(page.state & kMemoryAllocationCommit)) {
+      continue;
+    }
+    memory::PageAccess page_access = memory::PageAccess::kNoAccess;
+    if ((page.current_protect & kMemoryProtectRead) &&
+        (page.current_protect & kMemoryProtectWrite)) {
+      page_access = memory::PageAccess::kReadWrite;
+    } else if (page.current_protect & kMemoryProtectRead) {
+      page_access = memory::PageAccess::kReadOnly;
+    }
+    if (page_access != memory::PageAccess::kReadWrite) {
+      xe::memory::Protect(TranslateRelative(i * page_size_), page_size_,
+                          page_access, nullptr);
+    }
+  }
+}
+
 void BaseHeap::Reset() {
   // TODO(DrChat): protect pages.
   std::memset(page_table_.data(), 0, sizeof(PageEntry) * page_table_.size());
+  RebuildFreePages();
   // TODO(Triang3l): Remove access callbacks from pages if this is a physical
   // memory heap.
 }
@@ -914,7 +1624,7 @@ bool BaseHeap::AllocFixed(uint32_t base_address, uint32_t size,
   uint32_t start_page_number = (base_address - heap_base_) / page_size_;
   uint32_t end_page_number = start_page_number + page_count - 1;
   if (start_page_number >= page_table_.size() ||
-      end_page_number > page_table_.size()) {
+      end_page_number >= page_table_.size()) {
     XELOGE("BaseHeap::AllocFixed passed out of range address range");
     return false;
   }
@@ -981,6 +1691,7 @@ bool BaseHeap::AllocFixed(uint32_t base_address, uint32_t size,
     }
     page_entry.state = kMemoryAllocationReserve | allocation_type;
   }
+  SetPagesFree(start_page_number, page_count, false);
 
   return true;
 }
@@ -1016,12 +1727,13 @@ bool BaseHeap::AllocRange(uint32_t low_address, uint32_t high_address,
     return false;
   }
 
+  uint64_t start_host_ticks = Clock::QueryHostTickCount();
   auto global_lock = global_critical_region_.Acquire();
 
   // Find a free page range.
-  // The base page must match the requested alignment, so we first scan for
-  // a free aligned page and only then check for continuous free pages.
-  // TODO(benvanik): optimized searching (free list buckets, bitmap, etc).
+  // The base page must match the requested alignment, so the free page bitmap
+  // is searched for a free page where an aligned range may start or end, and
+  // then for a reserved page within the candidate range to skip past.
   uint32_t start_page_number = UINT_MAX;
   uint32_t end_page_number = UINT_MAX;
   // chrispy:todo, page_scan_stride is probably always a power of two...
@@ -1029,81 +1741,66 @@ bool BaseHeap::AllocRange(uint32_t low_address, uint32_t high_address,
   high_page_number =
       high_page_number - QuickMod(high_page_number, page_scan_stride);
   if (top_down) {
-    for (int64_t base_page_number =
-             high_page_number - xe::round_up(page_count, page_scan_stride);
-         base_page_number >= low_page_number;
-         base_page_number -= page_scan_stride) {
-      if (page_table_[base_page_number].state != 0) {
-        // Base page not free, skip to next usable page.
-        continue;
-      }
-      // Check requested range to ensure free.
-      start_page_number = uint32_t(base_page_number);
-      end_page_number = uint32_t(base_page_number) + page_count - 1;
-      assert_true(end_page_number < page_table_.size());
-      bool any_taken = false;
-      for (uint32_t page_number = uint32_t(base_page_number);
-           !any_taken && page_number <= end_page_number; ++page_number) {
-        bool is_free = page_table_[page_number].state == 0;
-        if (!is_free) {
-          // At least one page in the range is used, skip to next.
-          // We know we'll be starting at least before this page.
-          any_taken = true;
-          if (page_count > page_number) {
-            // Not enough space left to fit entire page range. Breaks outer
-            // loop.
-            base_page_number = -1;
-          } else {
-            base_page_number = page_number - page_count;
-            base_page_number -= QuickMod(base_page_number, page_scan_stride);
-            base_page_number += page_scan_stride;  // cancel out loop logic
-          }
-          break;
-        }
-      }
-      if (!any_taken) {
+    int64_t base_page_number = int64_t(high_page_number) -
+                               xe::round_up(page_count, page_scan_stride);
+    while (base_page_number >= low_page_number) {
+      uint32_t reserved_page_number =
+          FindPageReverse(uint32_t(base_page_number),
+                          uint32_t(base_page_number) + page_count - 1, false);
+      if (reserved_page_number == UINT32_MAX) {
         // Found our place.
+        start_page_number = uint32_t(base_page_number);
+        end_page_number = start_page_number + page_count - 1;
+        assert_true(end_page_number < page_table_.size());
         break;
       }
-      // Retry.
-      start_page_number = end_page_number = UINT_MAX;
+      // The range must end at a free page below the reserved one.
+      uint32_t free_page_number =
+          reserved_page_number
+              ? FindPageReverse(low_page_number, reserved_page_number - 1, true)
+              : UINT32_MAX;
+      if (free_page_number == UINT32_MAX ||
+          free_page_number + 1 < low_page_number + page_count) {
+        // Not enough space left to fit entire page range.
+        break;
+      }
+      base_page_number -= xe::round_up(
+          uint32_t(base_page_number - (free_page_number + 1 - page_count)),
+          page_scan_stride, false);
     }
-  } else {
-    for (uint32_t base_page_number = low_page_number;
-         base_page_number <= high_page_number - page_count;
-         base_page_number += page_scan_stride) {
-      if (page_table_[base_page_number].state != 0) {
-        // Base page not free, skip to next usable page.
-        continue;
+  } else if (high_page_number >= page_count) {
+    uint32_t last_base_page_number = high_page_number - page_count;
+    uint32_t base_page_number = low_page_number;
+    while (base_page_number <= last_base_page_number) {
+      // The range must start at a free page.
+      uint32_t free_page_number =
+          FindPage(base_page_number, last_base_page_number, true);
+      if (free_page_number == UINT32_MAX) {
+        break;
       }
-      // Check requested range to ensure free.
-      start_page_number = base_page_number;
-      end_page_number = base_page_number + page_count - 1;
-      bool any_taken = false;
-      for (uint32_t page_number = base_page_number;
-           !any_taken && page_number <= end_page_number; ++page_number) {
-        bool is_free = page_table_[page_number].state == 0;
-        if (!is_free) {
-          // At least one page in the range is used, skip to next.
-          // We know we'll be starting at least after this page.
-          any_taken = true;
-          base_page_number = xe::round_up(page_number + 1, page_scan_stride);
-          base_page_number -= page_scan_stride;  // cancel out loop logic
-          break;
-        }
+      base_page_number += xe::round_up(free_page_number - base_page_number,
+                                       page_scan_stride, false);
+      if (base_page_number > last_base_page_number) {
+        break;
       }
-      if (!any_taken) {
+      uint32_t reserved_page_number =
+          FindPage(base_page_number, base_page_number + page_count - 1, false);
+      if (reserved_page_number == UINT32_MAX) {
         // Found our place.
+        start_page_number = base_page_number;
+        end_page_number = base_page_number + page_count - 1;
         break;
       }
-      // Retry.
-      start_page_number = end_page_number = UINT_MAX;
+      // We know we'll be starting at least after the reserved page.
+      base_page_number += xe::round_up(
+          reserved_page_number + 1 - base_page_number, page_scan_stride);
     }
   }
   if (start_page_number == UINT_MAX || end_page_number == UINT_MAX) {
     // Out of memory.
     XELOGE("BaseHeap::Alloc failed to find contiguous range");
     // assert_always("Heap exhausted!");
+    RecordAllocation(start_host_ticks, false);
     return false;
   }
 
@@ -1119,6 +1816,7 @@ bool BaseHeap::AllocRange(uint32_t low_address, uint32_t high_address,
         page_count << page_size_shift_, alloc_type, ToPageAccess(protect));
     if (!result) {
       XELOGE("BaseHeap::Alloc failed to alloc range from host");
+      RecordAllocation(start_host_ticks, false);
       return false;
     }
 
@@ -1138,6 +1836,8 @@ bool BaseHeap::AllocRange(uint32_t low_address, uint32_t high_address,
     page_entry.state = kMemoryAllocationReserve | allocation_type;
     unreserved_page_count_--;
   }
+  SetPagesFree(start_page_number, page_count, false);
+  RecordAllocation(start_host_ticks, true);
 
   *out_address = heap_base_ + (start_page_number << page_size_shift_);
   return true;
@@ -1247,6 +1947,7 @@ bool BaseHeap::Release(uint32_t base_address, uint32_t* out_region_size) {
     page_entry.qword = 0;
     unreserved_page_count_++;
   }
+  SetPagesFree(base_page_number, base_page_entry.region_page_count, true);
 
   return true;
 }
@@ -1332,12 +2033,26 @@ bool BaseHeap::Protect(uint32_t address, uint32_t size, uint32_t protect,
   }
 
   // Perform table change.
+  bool made_writable = false;
   for (uint32_t page_number = start_page_number; page_number <= end_page_number;
        ++page_number) {
     auto& page_entry = page_table_[page_number];
+    if ((protect & kMemoryProtectWrite) &&
+        !(page_entry.current_protect & kMemoryProtectWrite)) {
+      made_writable = true;
+    }
     page_entry.current_protect = protect;
   }
 
+  if (made_writable) {
+    for (auto write_unprotect_callback : memory_->write_unprotect_callbacks_) {
+      write_unprotect_callback->first(
+          write_unprotect_callback->second,
+          heap_base_ + (start_page_number << page_size_shift_),
+          page_count << page_size_shift_);
+    }
+  }
+
   return true;
 }
 
@@ -1805,7 +2520,8 @@ XE_NOINLINE void PhysicalHeap::EnableAccessCallbacksInner(
         }
       }
     }
-    if (protect_system_page) {
+    // With OS write tracking, only the flags are needed.
+    if (protect_system_page && !memory_->physical_write_watch_) {
       if (protect_system_page_first == UINT32_MAX) {
         protect_system_page_first = i;
       }
@@ -2000,6 +2716,36 @@ bool PhysicalHeap::TriggerCallbacks(
   return true;
 }
 
+bool PhysicalHeap::RegisterWriteWatch(xe::memory::WriteWatch& write_watch) {
+  return write_watch.Register(membase_ + heap_base_,
+                              size_t(system_page_count_) << system_page_shift_);
+}
+
+uint32_t PhysicalHeap::PollWriteWatch(xe::memory::WriteWatch& write_watch) {
+  uint8_t* watch_base = membase_ + heap_base_;
+  uint32_t range_count = 0;
+  write_watch.ScanWrittenRanges(
+      watch_base, size_t(system_page_count_) << system_page_shift_,
+      [this, watch_base, &range_count](void* address, size_t length) {
+        // Back from system pages to guest addresses within the heap, which
+        // TriggerCallbacks clamps to the heap.
+        uint32_t offset = uint32_t(static_cast<uint8_t*>(address) - watch_base);
+        uint32_t offset_end = offset + uint32_t(length);
+        uint32_t address_start =
+            heap_base_ + xe::sat_sub(offset, host_address_offset());
+        uint32_t address_end =
+            heap_base_ + xe::sat_sub(offset_end, host_address_offset());
+        if (address_end <= address_start) {
+          return;
+        }
+        ++range_count;
+        // Pages are not protected, so nothing to unprotect.
+        TriggerCallbacks(global_critical_region_.Acquire(), address_start,
+                         address_end - address_start, true, true, false);
+      });
+  return range_count;
+}
+
 uint32_t PhysicalHeap::GetPhysicalAddress(uint32_t address) const {
   assert_true(address >= heap_base_);
   address -= heap_base_;
@@ -10,7 +10,10 @@
 #ifndef XENIA_MEMORY_H_
 #define XENIA_MEMORY_H_
 
+#include <atomic>
 #include <cstdint>
+#include <cstdio>
+#include <filesystem>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -19,6 +22,8 @@
 
 #include "xenia/base/memory.h"
 #include "xenia/base/mutex.h"
+#include "xenia/base/threading.h"
+#include "xenia/base/write_watch.h"
 #include "xenia/cpu/mmio_handler.h"
 #include "xenia/guest_pointers.h"
 namespace xe {
@@ -98,6 +103,61 @@ union PageEntry {
   };
 };
 
+// Page usage of a heap at one point in time, for monitoring.
+struct HeapStatistics {
+  // Set by Memory::GetHeapStatistics, null for a single heap.
+  const char* name;
+  uint32_t heap_base;
+  uint32_t heap_size;
+  uint32_t page_size;
+  uint32_t total_page_count;
+  uint32_t committed_page_count;
+  // Reserved, but not committed.
+  uint32_t reserved_page_count;
+  uint32_t unreserved_page_count;
+  // Ranges of contiguous unreserved pages, and the length of the longest one,
+  // which is the largest allocation that can still succeed.
+  uint32_t free_range_count;
+  uint32_t largest_free_range;
+  // Totals of AllocRange since the heap was initialized.
+  uint64_t alloc_count;
+  uint64_t alloc_failure_count;
+  uint64_t alloc_host_ticks;
+  uint64_t alloc_max_host_ticks;
+};
+
+constexpr fourcc_t kMemorySnapshotSignature = make_fourcc("XMSN");
+
+// Guest memory captured by Memory::CaptureSnapshot while the guest is paused,
+// with only the pages changed since the parent snapshot, to be compressed and
+// written to the file while the guest is running again.
+struct MemorySnapshot {
+  static constexpr uint32_t kVersion = 1;
+  static constexpr uint32_t kHeapCount = 5;
+  // Page data is compressed in blocks of this size.
+  static constexpr size_t kBlockSize = 256 * 1024;
+
+  struct Page {
+    uint32_t heap_index;
+    uint32_t page_index;
+  };
+
+  // Snapshot providing the pages not stored in this one, or empty if all
+  // committed pages are stored.
+  std::filesystem::path parent_path;
+  // Offset of the memory section in the parent snapshot file.
+  uint64_t parent_offset = 0;
+  // The page tables of all heaps are always stored completely.
+  std::vector<uint64_t> page_tables[kHeapCount];
+  // Stored pages in the order of their data in the blocks.
+  std::vector<Page> pages;
+  std::vector<std::vector<uint8_t>> blocks;
+
+  // Compresses the blocks on multiple threads and appends the memory section to
+  // the file.
+  bool Write(FILE* file) const;
+};
+
 // Heap abstraction for page-based allocation.
 class BaseHeap {
  public:
@@ -143,6 +203,9 @@ class BaseHeap {
   // Dumps information about all allocations within the heap to the log.
   void DumpMap();
 
+  // Counts the pages in every state and finds the free ranges.
+  void GetStatistics(HeapStatistics& statistics);
+
   // Allocates pages with the given properties and allocation strategy.
   // This can reserve and commit the pages as well as set protection modes.
   // This will fail if not enough contiguous pages can be found.
@@ -201,6 +264,18 @@ class BaseHeap {
   bool Save(ByteStream* stream);
   bool Restore(ByteStream* stream);
 
+  // Adds the committed pages with contents different than in page_hashes to
+  // the snapshot, and updates the hashes.
+  void CaptureSnapshot(uint32_t heap_index, std::vector<uint64_t>& page_hashes,
+                       MemorySnapshot& snapshot);
+  // Replaces the page table, with the committed pages writable until
+  // RestoreSnapshotProtection so their contents can be restored.
+  bool RestoreSnapshotPageTable(const std::vector<uint64_t>& page_table);
+  void RestoreSnapshotProtection();
+  bool IsPageCommitted(uint32_t page_index) const {
+    return (page_table_[page_index].state & kMemoryAllocationCommit) != 0;
+  }
+
   void Reset();
 
  protected:
@@ -210,6 +285,18 @@ class BaseHeap {
                   uint32_t heap_base, uint32_t heap_size, uint32_t page_size,
                   uint32_t host_address_offset = 0);
 
+  // Must be called with the global critical region held, whenever pages are
+  // reserved or released.
+  void SetPagesFree(uint32_t first_page, uint32_t page_count, bool is_free);
+  void RebuildFreePages();
+  // Lowest or highest page within [first_page, last_page] that is unreserved
+  // (if is_free is true) or reserved, or UINT32_MAX if there's none.
+  uint32_t FindPage(uint32_t first_page, uint32_t last_page,
+                    bool is_free) const;
+  uint32_t FindPageReverse(uint32_t first_page, uint32_t last_page,
+                           bool is_free) const;
+  void RecordAllocation(uint64_t start_host_ticks, bool succeeded);
+
   Memory* memory_;
   uint8_t* membase_;
   HeapType heap_type_;
@@ -221,6 +308,16 @@ class BaseHeap {
   uint32_t unreserved_page_count_;
   xe::global_critical_region global_critical_region_;
   std::vector<PageEntry> page_table_;
+  // A bit for every page, set if it's unreserved, and a bit in the summary for
+  // every word of free_pages_, set if it contains any unreserved page, so free
+  // ranges are found without walking the page table entry by entry.
+  std::vector<uint64_t> free_pages_;
+  std::vector<uint64_t> free_page_summary_;
+  // Statistics of AllocRange reported by DumpMap and GetStatistics.
+  uint64_t alloc_count_ = 0;
+  uint64_t alloc_failure_count_ = 0;
+  uint64_t alloc_host_ticks_ = 0;
+  uint64_t alloc_max_host_ticks_ = 0;
 };
 
 // Normal heap allowing allocations from guest virtual address ranges.
@@ -284,6 +381,13 @@ class PhysicalHeap : public BaseHeap {
 
   uint32_t GetPhysicalAddress(uint32_t address) const;
 
+  // OS-assisted write tracking used instead of protection for invalidation
+  // notifications.
+  bool RegisterWriteWatch(xe::memory::WriteWatch& write_watch);
+  // Triggers the callbacks for the watched pages written since the previous
+  // poll, returns the number of written ranges.
+  uint32_t PollWriteWatch(xe::memory::WriteWatch& write_watch);
+
   uint32_t SystemPagenumToGuestPagenum(uint32_t num) const {
     return ((num << system_page_shift_) - host_address_offset()) >>
            page_size_shift_;
@@ -487,6 +591,19 @@ class Memory {
   // RegisterPhysicalMemoryInvalidationCallback.
   void UnregisterPhysicalMemoryInvalidationCallback(void* callback_handle);
 
+  // Called with the global critical region locked when guest pages not
+  // writable before have been made writable by a protection change, for
+  // invalidation of what has been derived from their contents assuming they
+  // can't be modified.
+  typedef void (*WriteUnprotectCallback)(void* context_ptr, uint32_t address,
+                                         uint32_t length);
+  // Returns a handle for unregistering.
+  void* RegisterWriteUnprotectCallback(WriteUnprotectCallback callback,
+                                       void* callback_context);
+  // Unregisters a write unprotection callback previously added with
+  // RegisterWriteUnprotectCallback.
+  void UnregisterWriteUnprotectCallback(void* callback_handle);
+
   // Enables physical memory access callbacks for the specified memory range,
   // snapped to system page boundaries.
   void EnablePhysicalMemoryAccessCallbacks(
@@ -503,6 +620,16 @@ class Memory {
       uint32_t length, bool is_write, bool unwatch_exact_range,
       bool unprotect = true);
 
+  // With physical_memory_write_watch, triggers the invalidation callbacks for
+  // the watched physical memory written by the CPU since the previous poll,
+  // pages not being protected in this case. Must be called at points where the
+  // consumers of the callbacks need to see the guest writes - such as before
+  // processing new GPU commands. Also reports the statistics of both methods.
+  void PollPhysicalMemoryWrites();
+  bool IsPhysicalMemoryWriteWatched() const {
+    return physical_write_watch_ != nullptr;
+  }
+
   // Allocates virtual memory from the 'system' heap.
   // System memory is kept separate from game memory but is still accessible
   // using normal guest virtual addresses. Kernel structures and other internal
@@ -536,9 +663,23 @@ class Memory {
   // Dumps a map of all allocated memory to the log.
   void DumpMap();
 
+  // Statistics of all the heaps, in the order of their addresses, with the
+  // physical heap last.
+  void GetHeapStatistics(std::vector<HeapStatistics>& statistics);
+
   bool Save(ByteStream* stream);
   bool Restore(ByteStream* stream);
 
+  // Captures the pages changed since the previous snapshot, which the new one
+  // refers to for the rest, unless the previous one was saved to the same path
+  // (thus is being overwritten) or couldn't be written. offset is where the
+  // memory section will be in the file.
+  std::shared_ptr<MemorySnapshot> CaptureSnapshot(
+      const std::filesystem::path& path, uint64_t offset);
+  // Makes the next snapshot full, for instance if the previous one couldn't be
+  // written.
+  void ResetSnapshotChain();
+
   void SetMMIOExceptionRecordingCallback(cpu::MmioAccessRecordCallback callback,
                                          void* context);
 
@@ -546,9 +687,16 @@ class Memory {
   int MapViews(uint8_t* mapping_base);
   void UnmapViews();
 
+  // Periodically logs the heap statistics, while
+  // memory_statistics_log_interval is not 0.
+  void StatisticsLogThread();
+
   static uint32_t HostToGuestVirtualThunk(const void* context,
                                           const void* host_address);
 
+  void GetSnapshotHeaps(BaseHeap* heaps[MemorySnapshot::kHeapCount]);
+  bool RestoreSnapshot(ByteStream* stream);
+
   bool AccessViolationCallback(global_unique_lock_type global_lock_locked_once,
                                void* host_address, bool is_write);
   static bool AccessViolationCallbackThunk(
@@ -599,6 +747,23 @@ class Memory {
   xe::global_critical_region global_critical_region_;
   std::vector<std::pair<PhysicalMemoryInvalidationCallback, void*>*>
       physical_memory_invalidation_callbacks_;
+  std::vector<std::pair<WriteUnprotectCallback, void*>*>
+      write_unprotect_callbacks_;
+
+  // Hashes of the pages in the previous snapshot, 0 if not stored in it or in
+  // its parents.
+  std::vector<uint64_t> snapshot_page_hashes_[MemorySnapshot::kHeapCount];
+  // Newest last, a snapshot overwriting any of them must be full.
+  std::vector<std::filesystem::path> snapshot_chain_paths_;
+  uint64_t snapshot_offset_ = 0;
+
+  std::unique_ptr<xe::memory::WriteWatch> physical_write_watch_;
+  // Access violations handled for invalidation notifications.
+  std::atomic<uint64_t> physical_write_faults_{0};
+  uint64_t physical_write_watch_ranges_ = 0;
+
+  std::unique_ptr<xe::threading::Event> statistics_log_shutdown_event_;
+  std::unique_ptr<xe::threading::Thread> statistics_log_thread_;
 };
 
 }  // namespace xe
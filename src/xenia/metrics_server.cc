@@ -0,0 +1,365 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/metrics_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/apu/audio_system.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/math.h"
+#include "xenia/cpu/backend/backend.h"
+#include "xenia/cpu/backend/code_cache.h"
+#include "xenia/cpu/ppc/ppc_frontend.h"
+#include "xenia/cpu/processor.h"
+#include "xenia/emulator.h"
+#include "xenia/gpu/command_processor.h"
+#include "xenia/gpu/graphics_system.h"
+#include "xenia/memory.h"
+#include "xenia/ui/graphics_provider.h"
+#include "xenia/vfs/virtual_file_system.h"
+
+DEFINE_uint32(metrics_port, 0,
+              "Local TCP port to serve the performance counters on over HTTP, "
+              "in the Prometheus text format, or 0 not to serve them. Only "
+              "accessible from the same machine.",
+              "General");
+
+namespace xe {
+
+namespace {
+
+// Upper bound of the request line and the headers, which are not used.
+constexpr size_t kMaxRequestSize = 8192;
+constexpr auto kRequestTimeout = std::chrono::milliseconds(2000);
+
+// Escapes a label value of the text format.
+std::string EscapeLabel(const std::string_view value) {
+  std::string escaped;
+  escaped.reserve(value.size());
+  for (char c : value) {
+    switch (c) {
+      case '\\':
+        escaped += "\\\\";
+        break;
+      case '"':
+        escaped += "\\\"";
+        break;
+      case '\n':
+        escaped += "\\n";
+        break;
+      default:
+        escaped.push_back(c);
+    }
+  }
+  return escaped;
+}
+
+void AppendMetricHeader(std::string& out, const char* name, const char* type,
+                        const char* help) {
+  out += fmt::format("# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+}
+
+void AppendMetric(std::string& out, const char* name, const char* type,
+                  const char* help, double value) {
+  AppendMetricHeader(out, name, type, help);
+  out += fmt::format("{} {}\n", name, value);
+}
+
+}  // namespace
+
+bool MetricsServer::IsRequested() { return cvars::metrics_port != 0; }
+
+std::unique_ptr<MetricsServer> MetricsServer::Create(Emulator* emulator) {
+  if (cvars::metrics_port > UINT16_MAX) {
+    XELOGE("Metrics server: invalid port {}", cvars::metrics_port);
+    return nullptr;
+  }
+  std::unique_ptr<MetricsServer> metrics_server(new MetricsServer(emulator));
+  MetricsServer* metrics_server_ptr = metrics_server.get();
+  metrics_server->socket_server_ = SocketServer::Create(
+      uint16_t(cvars::metrics_port),
+      [metrics_server_ptr](std::unique_ptr<Socket> client) {
+        metrics_server_ptr->ServeClient(*client);
+      });
+  if (!metrics_server->socket_server_) {
+    XELOGE("Metrics server: failed to listen on port {}",
+           cvars::metrics_port);
+    return nullptr;
+  }
+  XELOGI("Metrics server: serving on http://localhost:{}/metrics",
+         cvars::metrics_port);
+  return metrics_server;
+}
+
+MetricsServer::MetricsServer(Emulator* emulator) : emulator_(emulator) {}
+
+MetricsServer::~MetricsServer() {
+  // Waits for the client being served.
+  socket_server_.reset();
+}
+
+void MetricsServer::ServeClient(Socket& client) {
+  // Read the whole request before responding and closing, as closing with
+  // unread data resets the connection, possibly before the response is read.
+  std::string request;
+  char buffer[1024];
+  while (request.find("\r\n\r\n") == std::string::npos &&
+         request.size() < kMaxRequestSize) {
+    if (xe::threading::Wait(client.wait_handle(), false, kRequestTimeout) !=
+        xe::threading::WaitResult::kSuccess) {
+      return;
+    }
+    size_t received = client.Receive(buffer, sizeof(buffer));
+    if (received == size_t(-1)) {
+      return;
+    }
+    request.append(buffer, received);
+  }
+  std::string body;
+  if (request.compare(0, 4, "GET ") == 0) {
+    body = FormatMetrics();
+  }
+  std::string header =
+      body.empty()
+          ? std::string("HTTP/1.1 405 Method Not Allowed\r\n"
+                        "Content-Length: 0\r\nConnection: close\r\n\r\n")
+          : fmt::format(
+                "HTTP/1.1 200 OK\r\n"
+                "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                "Content-Length: {}\r\nConnection: close\r\n\r\n",
+                body.size());
+  std::pair<const void*, size_t> response[] = {
+      {header.data(), header.size()}, {body.data(), body.size()}};
+  client.Send(response, xe::countof(response));
+  client.Close();
+}
+
+std::string MetricsServer::FormatMetrics() const {
+  std::string out;
+  double ticks_to_seconds = 1.0 / double(Clock::QueryHostTickFrequency());
+
+  gpu::GraphicsSystem* graphics_system = emulator_->graphics_system();
+  gpu::CommandProcessor* command_processor =
+      graphics_system ? graphics_system->command_processor() : nullptr;
+  if (command_processor) {
+    gpu::CommandProcessor::RuntimeStatistics gpu_statistics =
+        command_processor->GetRuntimeStatistics();
+    AppendMetric(out, "xenia_guest_frames_total", "counter",
+                 "Guest frames presented.", double(gpu_statistics.swap_count));
+
+    // The frame rate counts the frames of the last second, so it drops to
+    // zero if the emulation hangs.
+    std::vector<uint64_t> swap_host_ticks;
+    command_processor->GetRecentSwapHostTicks(swap_host_ticks);
+    uint64_t now_host_ticks = Clock::QueryHostTickCount();
+    uint64_t second_start_host_ticks =
+        now_host_ticks - std::min(now_host_ticks,
+                                  Clock::QueryHostTickFrequency());
+    AppendMetric(out, "xenia_fps", "gauge",
+                 "Guest frames presented during the last second.",
+                 double(std::count_if(swap_host_ticks.cbegin(),
+                                      swap_host_ticks.cend(),
+                                      [second_start_host_ticks](uint64_t t) {
+                                        return t >= second_start_host_ticks;
+                                      })));
+    std::vector<uint64_t> frame_host_ticks;
+    for (size_t i = 1; i < swap_host_ticks.size(); ++i) {
+      frame_host_ticks.push_back(swap_host_ticks[i] - swap_host_ticks[i - 1]);
+    }
+    std::sort(frame_host_ticks.begin(), frame_host_ticks.end());
+    if (!frame_host_ticks.empty()) {
+      AppendMetricHeader(out, "xenia_frame_time_seconds", "gauge",
+                         "Percentiles of the time between the latest guest "
+                         "frames.");
+      for (double quantile : {0.5, 0.9, 0.99, 1.0}) {
+        size_t index = std::min(
+            size_t(quantile * double(frame_host_ticks.size() - 1) + 0.5),
+            frame_host_ticks.size() - 1);
+        out += fmt::format("xenia_frame_time_seconds{{quantile=\"{}\"}} {}\n",
+                           quantile,
+                           double(frame_host_ticks[index]) * ticks_to_seconds);
+      }
+    }
+
+    AppendMetric(out, "xenia_gpu_pipeline_creation_stalls_total", "counter",
+                 "Draws that waited for their pipelines to be created.",
+                 double(gpu_statistics.pipeline_creation_stalls));
+    AppendMetric(out, "xenia_gpu_pipeline_creation_stall_seconds_total",
+                 "counter",
+                 "Time draws spent waiting for their pipelines to be created.",
+                 double(gpu_statistics.pipeline_creation_stall_ns) * 1e-9);
+    AppendMetric(out, "xenia_gpu_draws_skipped_for_pipeline_creation_total",
+                 "counter",
+                 "Draws skipped while their pipelines were being created.",
+                 double(gpu_statistics.draws_skipped_for_pipeline_creation));
+  }
+
+  ui::GraphicsProvider* provider =
+      graphics_system ? graphics_system->provider() : nullptr;
+  uint64_t video_memory_usage, video_memory_budget;
+  if (provider &&
+      provider->QueryVideoMemoryBudget(video_memory_usage,
+                                       video_memory_budget)) {
+    AppendMetric(out, "xenia_gpu_video_memory_usage_bytes", "gauge",
+                 "Host video memory used by the process.",
+                 double(video_memory_usage));
+    AppendMetric(out, "xenia_gpu_video_memory_budget_bytes", "gauge",
+                 "Host video memory budget given to the process by the OS.",
+                 double(video_memory_budget));
+  }
+
+  cpu::Processor* processor = emulator_->processor();
+  cpu::ppc::PPCFrontend* frontend = processor->frontend();
+  AppendMetric(out, "xenia_jit_translations_total", "counter",
+               "Guest functions translated.",
+               double(frontend->translation_count()));
+  AppendMetric(out, "xenia_jit_translation_seconds_total", "counter",
+               "Time spent translating guest functions.",
+               double(frontend->translation_host_ticks()) * ticks_to_seconds);
+  AppendMetric(out, "xenia_jit_known_extent_functions_total", "counter",
+               "Guest functions scanned with the exact extents from .pdata.",
+               double(frontend->known_extent_function_count()));
+  AppendMetric(out, "xenia_jit_early_function_ends_avoided_total", "counter",
+               "Guest functions the scanning heuristics would have ended "
+               "early, splitting them into separately translated functions.",
+               double(frontend->early_end_avoided_count()));
+  AppendMetric(out, "xenia_jit_pending_compilations", "gauge",
+               "Functions queued for the background compilation.",
+               double(processor->GetPendingCompilationCount()));
+
+  apu::AudioSystem* audio_system = emulator_->audio_system();
+  if (audio_system) {
+    AppendMetric(out, "xenia_audio_underruns_total", "counter",
+                 "Buffer underruns of the host audio output.",
+                 double(audio_system->GetUnderrunCount()));
+  }
+
+  std::vector<HeapStatistics> heap_statistics;
+  emulator_->memory()->GetHeapStatistics(heap_statistics);
+  struct HeapMetric {
+    const char* name;
+    const char* type;
+    const char* help;
+    double (*value)(const HeapStatistics& heap);
+  };
+  static const HeapMetric heap_metrics[] = {
+      {"xenia_guest_memory_size_bytes", "gauge", "Size of the guest heap.",
+       [](const HeapStatistics& heap) { return double(heap.heap_size); }},
+      {"xenia_guest_memory_committed_bytes", "gauge",
+       "Committed guest heap memory.",
+       [](const HeapStatistics& heap) {
+         return double(heap.committed_page_count) * heap.page_size;
+       }},
+      {"xenia_guest_memory_unreserved_bytes", "gauge",
+       "Guest heap memory that is not reserved.",
+       [](const HeapStatistics& heap) {
+         return double(heap.unreserved_page_count) * heap.page_size;
+       }},
+      {"xenia_guest_memory_largest_free_range_bytes", "gauge",
+       "Largest guest heap allocation that can still succeed.",
+       [](const HeapStatistics& heap) {
+         return double(heap.largest_free_range) * heap.page_size;
+       }},
+      {"xenia_guest_memory_allocation_failures_total", "counter",
+       "Guest heap allocations that failed.",
+       [](const HeapStatistics& heap) {
+         return double(heap.alloc_failure_count);
+       }},
+  };
+  for (const HeapMetric& heap_metric : heap_metrics) {
+    AppendMetricHeader(out, heap_metric.name, heap_metric.type,
+                       heap_metric.help);
+    for (const HeapStatistics& heap : heap_statistics) {
+      out += fmt::format("{}{{heap=\"{}\",base=\"{:08X}\"}} {}\n",
+                         heap_metric.name,
+                         EscapeLabel(heap.name ? heap.name : ""),
+                         heap.heap_base, heap_metric.value(heap));
+    }
+  }
+
+  // Breakdown of the host memory footprint by subsystem, for tuning
+  // low_memory_mode.
+  uint64_t guest_committed_bytes = 0;
+  for (const HeapStatistics& heap : heap_statistics) {
+    guest_committed_bytes +=
+        uint64_t(heap.committed_page_count) * heap.page_size;
+  }
+  AppendMetricHeader(out, "xenia_host_memory_bytes", "gauge",
+                     "Host memory used by the emulator subsystems.");
+  out += fmt::format(
+      "xenia_host_memory_bytes{{subsystem=\"guest_memory\"}} {}\n",
+      guest_committed_bytes);
+  cpu::backend::CodeCache* code_cache =
+      processor->backend() ? processor->backend()->code_cache() : nullptr;
+  if (code_cache) {
+    out += fmt::format(
+        "xenia_host_memory_bytes{{subsystem=\"jit_code\"}} {}\n",
+        code_cache->committed_size());
+  }
+  if (command_processor) {
+    gpu::CommandProcessor::RuntimeStatistics gpu_statistics =
+        command_processor->GetRuntimeStatistics();
+    out += fmt::format(
+        "xenia_host_memory_bytes{{subsystem=\"gpu_textures\"}} {}\n"
+        "xenia_host_memory_bytes{{subsystem=\"gpu_shared_memory\"}} {}\n"
+        "xenia_host_memory_bytes{{subsystem=\"gpu_upload_buffers\"}} {}\n",
+        gpu_statistics.texture_memory_bytes, gpu_statistics.shared_memory_bytes,
+        gpu_statistics.upload_buffer_bytes);
+  }
+
+  std::vector<vfs::DeviceStatistics> device_statistics;
+  emulator_->file_system()->GetDeviceStatistics(device_statistics);
+  struct DeviceMetric {
+    const char* name;
+    const char* help;
+    double (*value)(const vfs::DeviceStatistics& device,
+                    double ticks_to_seconds);
+  };
+  static const DeviceMetric device_metrics[] = {
+      {"xenia_io_reads_total", "Guest file reads.",
+       [](const vfs::DeviceStatistics& device, double ticks_to_seconds) {
+         return double(device.read_count);
+       }},
+      {"xenia_io_read_bytes_total", "Bytes read from the guest files.",
+       [](const vfs::DeviceStatistics& device, double ticks_to_seconds) {
+         return double(device.read_bytes);
+       }},
+      {"xenia_io_read_seconds_total", "Time spent reading the guest files.",
+       [](const vfs::DeviceStatistics& device, double ticks_to_seconds) {
+         return double(device.read_host_ticks) * ticks_to_seconds;
+       }},
+      {"xenia_io_writes_total", "Guest file writes.",
+       [](const vfs::DeviceStatistics& device, double ticks_to_seconds) {
+         return double(device.write_count);
+       }},
+      {"xenia_io_write_bytes_total", "Bytes written to the guest files.",
+       [](const vfs::DeviceStatistics& device, double ticks_to_seconds) {
+         return double(device.write_bytes);
+       }},
+  };
+  for (const DeviceMetric& device_metric : device_metrics) {
+    AppendMetricHeader(out, device_metric.name, "counter", device_metric.help);
+    for (const vfs::DeviceStatistics& device : device_statistics) {
+      out += fmt::format("{}{{device=\"{}\"}} {}\n", device_metric.name,
+                         EscapeLabel(device.mount_path),
+                         device_metric.value(device, ticks_to_seconds));
+    }
+  }
+
+  return out;
+}
+
+}  // namespace xe
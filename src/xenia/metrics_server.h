@@ -0,0 +1,54 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_METRICS_SERVER_H_
+#define XENIA_METRICS_SERVER_H_
+
+#include <memory>
+#include <string>
+
+#include "xenia/base/socket.h"
+
+namespace xe {
+class Emulator;
+}  // namespace xe
+
+namespace xe {
+
+// Serves the performance counters of the emulator over HTTP on the local
+// metrics_port, in the Prometheus text format, for watching emulators running
+// unattended without the UI. Counters are cumulative since the emulator has
+// been set up, so rates such as the I/O throughput are computed by the
+// scraper, while the frame rate and the frame time percentiles are of the
+// latest guest frames.
+class MetricsServer {
+ public:
+  // Whether the server has been requested with the cvars.
+  static bool IsRequested();
+  // Returns nullptr if the port can't be bound. The emulator must be set up
+  // and outlive the server.
+  static std::unique_ptr<MetricsServer> Create(Emulator* emulator);
+
+  ~MetricsServer();
+
+ private:
+  explicit MetricsServer(Emulator* emulator);
+
+  // Called on the accept thread of the socket server, clients are served one
+  // at a time.
+  void ServeClient(Socket& client);
+  std::string FormatMetrics() const;
+
+  Emulator* emulator_;
+  std::unique_ptr<SocketServer> socket_server_;
+};
+
+}  // namespace xe
+
+#endif  // XENIA_METRICS_SERVER_H_
@@ -38,6 +38,10 @@ void PatchDB::LoadPatches() {
   const std::vector<xe::filesystem::FileInfo> patch_files =
       filesystem::ListFiles(patches_directory);
 
+  std::map<uint32_t, std::vector<IndexedPatchFile>> old_patch_file_index =
+      std::move(patch_file_index_);
+  patch_file_index_.clear();
+  size_t indexed_file_count = 0;
   for (const xe::filesystem::FileInfo& patch_file : patch_files) {
     // Skip files that doesn't have only title_id as name and .patch as
     // extension
@@ -48,13 +52,55 @@ void PatchDB::LoadPatches() {
       continue;
     }
 
-    const PatchFileEntry loaded_title_patches =
-        ReadPatchFile(patch_file.path / patch_file.name);
-    if (loaded_title_patches.title_id != -1) {
-      loaded_patches_.push_back(loaded_title_patches);
+    // Parsing thousands of files on every launch is slow, so only the files
+    // of the launched title are parsed, found by the title ID in their names.
+    const uint32_t title_id = static_cast<uint32_t>(
+        strtoul(path_to_utf8(patch_file.name).substr(0, 8).c_str(), NULL, 16));
+    IndexedPatchFile indexed_file;
+    indexed_file.path = patch_file.path / patch_file.name;
+    indexed_file.write_timestamp = patch_file.write_timestamp;
+    indexed_file.size = patch_file.total_size;
+    auto old_title_it = old_patch_file_index.find(title_id);
+    if (old_title_it != old_patch_file_index.end()) {
+      for (IndexedPatchFile& old_file : old_title_it->second) {
+        if (old_file.path == indexed_file.path &&
+            old_file.write_timestamp == indexed_file.write_timestamp &&
+            old_file.size == indexed_file.size) {
+          indexed_file.entry = std::move(old_file.entry);
+          break;
+        }
+      }
+    }
+    patch_file_index_[title_id].push_back(std::move(indexed_file));
+    ++indexed_file_count;
+  }
+  XELOGI("PatchDB: Indexed {} patch files for {} titles", indexed_file_count,
+         patch_file_index_.size());
+}
+
+const PatchFileEntry& PatchDB::GetIndexedPatchFileEntry(
+    uint32_t title_id, IndexedPatchFile& indexed_file) const {
+  // Patches may be toggled between launches without restarting the emulator.
+  xe::filesystem::FileInfo file_info;
+  if (indexed_file.entry &&
+      xe::filesystem::GetInfo(indexed_file.path, &file_info) &&
+      (file_info.write_timestamp != indexed_file.write_timestamp ||
+       file_info.total_size != indexed_file.size)) {
+    indexed_file.write_timestamp = file_info.write_timestamp;
+    indexed_file.size = file_info.total_size;
+    indexed_file.entry.reset();
+  }
+  if (!indexed_file.entry) {
+    indexed_file.entry = ReadPatchFile(indexed_file.path);
+    if (indexed_file.entry->title_id != -1 &&
+        indexed_file.entry->title_id != title_id) {
+      XELOGW("PatchDB: Patch file {} is for title {:08X}, not the one in its "
+             "name",
+             path_to_utf8(indexed_file.path.filename()),
+             indexed_file.entry->title_id);
     }
   }
-  XELOGI("PatchDB: Loaded patches for {} titles", loaded_patches_.size());
+  return *indexed_file.entry;
 }
 
 PatchFileEntry PatchDB::ReadPatchFile(
@@ -214,18 +260,37 @@ std::vector<PatchFileEntry> PatchDB::GetTitlePatches(
     const uint32_t title_id, const std::optional<uint64_t> hash) {
   std::vector<PatchFileEntry> title_patches;
 
-  std::copy_if(
-      loaded_patches_.cbegin(), loaded_patches_.cend(),
-      std::back_inserter(title_patches), [=](const PatchFileEntry entry) {
-        bool hash_exist = std::find(entry.hashes.cbegin(), entry.hashes.cend(),
-                                    hash) != entry.hashes.cend();
-
-        return entry.title_id == title_id && hash_exist;
-      });
+  auto title_it = patch_file_index_.find(title_id);
+  if (title_it == patch_file_index_.end()) {
+    return title_patches;
+  }
+  for (IndexedPatchFile& indexed_file : title_it->second) {
+    const PatchFileEntry& entry =
+        GetIndexedPatchFileEntry(title_id, indexed_file);
+    bool hash_exist = std::find(entry.hashes.cbegin(), entry.hashes.cend(),
+                                hash) != entry.hashes.cend();
+    if (entry.title_id == title_id && hash_exist) {
+      title_patches.push_back(entry);
+    }
+  }
 
   return title_patches;
 }
 
+std::vector<PatchFileEntry> PatchDB::GetAllPatches() {
+  std::vector<PatchFileEntry> all_patches;
+  for (auto& title_files : patch_file_index_) {
+    for (IndexedPatchFile& indexed_file : title_files.second) {
+      const PatchFileEntry& entry =
+          GetIndexedPatchFileEntry(title_files.first, indexed_file);
+      if (entry.title_id != -1) {
+        all_patches.push_back(entry);
+      }
+    }
+  }
+  return all_patches;
+}
+
 void PatchDB::ReadHashes(PatchFileEntry& patch_entry,
                          const toml::node* hashes_node) const {
   auto add_hash = [&patch_entry](const toml::node* hash_node) {
@@ -94,15 +94,33 @@ class PatchDB {
   PatchDB(const std::filesystem::path patches_root);
   ~PatchDB();
 
+  // Indexes the patch files by the title ID in their names, without parsing
+  // them. Called again to rescan, keeping the files that haven't been modified
+  // parsed.
   void LoadPatches();
 
   PatchFileEntry ReadPatchFile(const std::filesystem::path& file_path) const;
 
+  // Parses only the patch files of the title not parsed yet or modified since
+  // they were parsed.
   std::vector<PatchFileEntry> GetTitlePatches(
       const uint32_t title_id, const std::optional<uint64_t> hash);
-  std::vector<PatchFileEntry>& GetAllPatches() { return loaded_patches_; }
+  // Parses all the indexed patch files not parsed yet or modified.
+  std::vector<PatchFileEntry> GetAllPatches();
 
  private:
+  struct IndexedPatchFile {
+    std::filesystem::path path;
+    // For detecting modifications when rescanning.
+    uint64_t write_timestamp;
+    size_t size;
+    // With the title ID -1 if the file couldn't be loaded.
+    std::optional<PatchFileEntry> entry;
+  };
+
+  const PatchFileEntry& GetIndexedPatchFileEntry(
+      uint32_t title_id, IndexedPatchFile& indexed_file) const;
+
   void ReadHashes(PatchFileEntry& patch_entry,
                   const toml::node* patch_toml_fields) const;
   void ReadPatchHeader(PatchInfoEntry& patch_info,
@@ -125,7 +143,7 @@ class PatchDB {
       {"be16", PatchData(sizeof(uint16_t), PatchDataType::kBE16)},
       {"be8", PatchData(sizeof(uint8_t), PatchDataType::kBE8)}};
 
-  std::vector<PatchFileEntry> loaded_patches_;
+  std::map<uint32_t, std::vector<IndexedPatchFile>> patch_file_index_;
   std::filesystem::path patches_root_;
 };
 }  // namespace patcher
@@ -6,9 +6,11 @@
  * Released under the BSD license - see LICENSE in the root for more details. *
  ******************************************************************************
  */
+#include <algorithm>
 #include <cstring>
 
 #include "xenia/base/logging.h"
+#include "xenia/cpu/processor.h"
 #include "xenia/patcher/patcher.h"
 
 namespace xe {
@@ -19,10 +21,13 @@ Patcher::Patcher(const std::filesystem::path patches_root) {
   patch_db_ = new PatchDB(patches_root);
 }
 
-void Patcher::ApplyPatchesForTitle(Memory* memory, const uint32_t title_id,
+void Patcher::ApplyPatchesForTitle(Memory* memory, cpu::Processor* processor,
+                                   const uint32_t title_id,
                                    const std::optional<uint64_t> hash) {
   const auto title_patches = patch_db_->GetTitlePatches(title_id, hash);
 
+  std::vector<const PatchDataEntry*> patch_data;
+  size_t patch_count = 0;
   for (const PatchFileEntry& patchFile : title_patches) {
     for (const PatchInfoEntry& patchEntry : patchFile.patch_info) {
       if (!patchEntry.is_enabled) {
@@ -30,36 +35,103 @@ void Patcher::ApplyPatchesForTitle(Memory* memory, const uint32_t title_id,
       }
       XELOGE("Patcher: Applying patch for: {}({:08X}) - {}",
              patchFile.title_name, patchFile.title_id, patchEntry.patch_name);
-      ApplyPatch(memory, &patchEntry);
+      for (const PatchDataEntry& patch_data_entry : patchEntry.patch_data) {
+        patch_data.push_back(&patch_data_entry);
+      }
+      ++patch_count;
+    }
+  }
+  if (patch_data.empty()) {
+    return;
+  }
+
+  const std::vector<std::pair<uint32_t, uint32_t>> ranges =
+      WritePatchData(memory, patch_data);
+  // Usually applied before the module is precompiled, but the code may have
+  // already been translated if it's in another module.
+  size_t retranslated_count = 0;
+  if (processor) {
+    for (cpu::GuestFunction* function :
+         processor->RetranslateFunctionsInRanges(ranges)) {
+      XELOGI("Patcher: Patched translated function {:08X}-{:08X}",
+             function->address(), function->end_address());
+      ++retranslated_count;
     }
   }
+  XELOGI(
+      "Patcher: Applied {} patches to {} ranges of memory, {} translated "
+      "functions affected",
+      patch_count, ranges.size(), retranslated_count);
 }
 
 void Patcher::ApplyPatch(Memory* memory, const PatchInfoEntry* patch) {
+  std::vector<const PatchDataEntry*> patch_data;
   for (const PatchDataEntry& patch_data_entry : patch->patch_data) {
-    uint32_t old_address_protect = 0;
-    uint8_t* address = memory->TranslateVirtual(patch_data_entry.address);
-    xe::BaseHeap* heap = memory->LookupHeap(patch_data_entry.address);
+    patch_data.push_back(&patch_data_entry);
+  }
+  WritePatchData(memory, patch_data);
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> Patcher::WritePatchData(
+    Memory* memory, const std::vector<const PatchDataEntry*>& patch_data) {
+  struct Range {
+    uint32_t address;
+    uint32_t end;
+    xe::BaseHeap* heap;
+    uint32_t old_protect;
+  };
+  std::vector<const PatchDataEntry*> sorted_patch_data = patch_data;
+  std::sort(sorted_patch_data.begin(), sorted_patch_data.end(),
+            [](const PatchDataEntry* a, const PatchDataEntry* b) {
+              return a->address < b->address;
+            });
+  // Overlapping or adjacent data in the same heap and with the same
+  // protection is merged, so the processor and the memory watches are only
+  // notified once for each range made writable.
+  std::vector<Range> ranges;
+  for (const PatchDataEntry* patch_data_entry : sorted_patch_data) {
+    uint32_t address = patch_data_entry->address;
+    uint32_t end = address + uint32_t(patch_data_entry->data.alloc_size);
+    xe::BaseHeap* heap = memory->LookupHeap(address);
     if (!heap) {
       continue;
     }
+    uint32_t protect = 0;
+    heap->QueryProtect(address, &protect);
+    if (!ranges.empty()) {
+      Range& last_range = ranges.back();
+      if (last_range.heap == heap && last_range.old_protect == protect &&
+          address <= last_range.end) {
+        last_range.end = std::max(last_range.end, end);
+        continue;
+      }
+    }
+    ranges.push_back({address, end, heap, protect});
+  }
 
-    heap->QueryProtect(patch_data_entry.address, &old_address_protect);
-
-    heap->Protect(patch_data_entry.address,
-                  (uint32_t)patch_data_entry.data.alloc_size,
-                  kMemoryProtectRead | kMemoryProtectWrite);
-
-    std::memcpy(address, patch_data_entry.data.patch_data.data(),
-                patch_data_entry.data.alloc_size);
-
-    // Restore previous protection
-    heap->Protect(patch_data_entry.address,
-                  (uint32_t)patch_data_entry.data.alloc_size,
-                  old_address_protect);
-
+  for (const Range& range : ranges) {
+    range.heap->Protect(range.address, range.end - range.address,
+                        kMemoryProtectRead | kMemoryProtectWrite);
+  }
+  // In the original order, for overlapping patches.
+  for (const PatchDataEntry* patch_data_entry : patch_data) {
+    if (!memory->LookupHeap(patch_data_entry->address)) {
+      continue;
+    }
+    std::memcpy(memory->TranslateVirtual(patch_data_entry->address),
+                patch_data_entry->data.patch_data.data(),
+                patch_data_entry->data.alloc_size);
     is_any_patch_applied_ = true;
   }
+  // Restore previous protection
+  std::vector<std::pair<uint32_t, uint32_t>> written_ranges;
+  written_ranges.reserve(ranges.size());
+  for (const Range& range : ranges) {
+    range.heap->Protect(range.address, range.end - range.address,
+                        range.old_protect);
+    written_ranges.emplace_back(range.address, range.end - range.address);
+  }
+  return written_ranges;
 }
 
 }  // namespace patcher
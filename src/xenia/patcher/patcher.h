@@ -14,6 +14,10 @@
 #include "xenia/patcher/patch_db.h"
 
 namespace xe {
+namespace cpu {
+class Processor;
+}  // namespace cpu
+
 namespace patcher {
 
 class Patcher {
@@ -21,12 +25,20 @@ class Patcher {
   Patcher(const std::filesystem::path patches_root);
 
   void ApplyPatch(Memory* memory, const PatchInfoEntry* patch);
-  void ApplyPatchesForTitle(Memory* memory, const uint32_t title_id,
+  // Applies all the enabled patches for the module in one pass, and
+  // retranslates the functions already translated from the patched code.
+  void ApplyPatchesForTitle(Memory* memory, cpu::Processor* processor,
+                            const uint32_t title_id,
                             const std::optional<uint64_t> hash);
 
   bool IsAnyPatchApplied() { return is_any_patch_applied_; }
 
  private:
+  // Writes the data, making every continuous range of it writable only once,
+  // and returns the <address, length> ranges.
+  std::vector<std::pair<uint32_t, uint32_t>> WritePatchData(
+      Memory* memory, const std::vector<const PatchDataEntry*>& patch_data);
+
   PatchDB* patch_db_;
   bool is_any_patch_applied_;
 };
@@ -0,0 +1,290 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/performance_governor.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "xenia/base/assert.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/logging.h"
+#include "xenia/emulator.h"
+#include "xenia/gpu/command_processor.h"
+#include "xenia/gpu/gpu_flags.h"
+#include "xenia/gpu/graphics_system.h"
+#include "xenia/kernel/kernel_state.h"
+#include "xenia/kernel/xthread.h"
+
+DEFINE_bool(performance_governor, true,
+            "On hosts providing thermal and performance hint APIs (Android), "
+            "report the frame times to the OS for raising the CPU clocks in "
+            "advance, run the GPU thread on the fastest cores, and lower the "
+            "frame rate limit before thermal throttling sets in.",
+            "General");
+DEFINE_uint32(performance_governor_min_framerate, 30,
+              "Frame rate limit the performance governor doesn't go below when "
+              "the host is about to be thermally throttled.",
+              "General");
+
+namespace xe {
+
+namespace {
+
+constexpr auto kTickInterval = std::chrono::milliseconds(100);
+constexpr uint32_t kTicksPerSecond = 10;
+// The thermal headroom may be queried at most once per second.
+constexpr uint32_t kThermalForecastSeconds = 10;
+// Headroom of 1 is severe throttling.
+constexpr float kHeadroomToLowerFramerateLimit = 0.9f;
+constexpr float kHeadroomToRaiseFramerateLimit = 0.7f;
+constexpr uint32_t kFramerateLimitStep = 10;
+// Giving the lowered load time to affect the temperature.
+constexpr uint32_t kSecondsBetweenFramerateLimitLowering = 5;
+// Raising cautiously not to oscillate.
+constexpr uint32_t kSecondsBetweenFramerateLimitRaising = 30;
+// Used when the frame rate is not limited.
+constexpr uint32_t kDefaultFramerate = 60;
+
+}  // namespace
+
+std::unique_ptr<PerformanceGovernor> PerformanceGovernor::Create(
+    Emulator* emulator) {
+  if (!cvars::performance_governor) {
+    return nullptr;
+  }
+  if (!power::IsThermalHeadroomAvailable() &&
+      !power::PerformanceHintSession::IsSupported()) {
+    return nullptr;
+  }
+  if (!emulator->graphics_system() ||
+      !emulator->graphics_system()->command_processor()) {
+    return nullptr;
+  }
+  XELOGI(
+      "Performance governor: thermal headroom {}, performance hints {}",
+      power::IsThermalHeadroomAvailable() ? "available" : "not available",
+      power::PerformanceHintSession::IsSupported() ? "supported"
+                                                   : "not supported");
+  return std::unique_ptr<PerformanceGovernor>(
+      new PerformanceGovernor(emulator));
+}
+
+PerformanceGovernor::PerformanceGovernor(Emulator* emulator)
+    : emulator_(emulator) {
+  hint_sessions_supported_ = power::PerformanceHintSession::IsSupported();
+  governor_thread_ =
+      xe::threading::Thread::Create({}, [this]() { GovernorThread(); });
+  assert_not_null(governor_thread_);
+  governor_thread_->set_name("Performance Governor");
+}
+
+PerformanceGovernor::~PerformanceGovernor() {
+  {
+    std::lock_guard<std::mutex> lock(governor_shutdown_mutex_);
+    governor_shutdown_ = true;
+  }
+  governor_shutdown_cond_.notify_all();
+  xe::threading::Wait(governor_thread_.get(), false);
+  governor_thread_.reset();
+  // Not keeping the emulation throttled after the governor is gone.
+  emulator_->graphics_system()->set_governed_framerate_limit(0);
+}
+
+void PerformanceGovernor::GovernorThread() {
+  uint32_t tick = 0;
+  std::unique_lock<std::mutex> shutdown_lock(governor_shutdown_mutex_);
+  while (!governor_shutdown_cond_.wait_for(
+      shutdown_lock, kTickInterval, [this]() { return governor_shutdown_; })) {
+    shutdown_lock.unlock();
+    if (!(tick % kTicksPerSecond)) {
+      PinGpuThreadToFastCores();
+      UpdateHintSession();
+      UpdateFramerateLimit();
+    }
+    ReportFrameDurations();
+    ++tick;
+    shutdown_lock.lock();
+  }
+}
+
+uint64_t PerformanceGovernor::GetTargetFrameDurationNs() const {
+  uint64_t framerate_limit = emulator_->graphics_system()->GetFramerateLimit();
+  return 1000000000 / (framerate_limit ? framerate_limit : kDefaultFramerate);
+}
+
+void PerformanceGovernor::PinGpuThreadToFastCores() {
+  if (gpu_thread_pinned_) {
+    return;
+  }
+  kernel::XHostThread* gpu_thread =
+      emulator_->graphics_system()->command_processor()->worker_thread();
+  if (!gpu_thread || !gpu_thread->thread()) {
+    // Not started yet.
+    return;
+  }
+  gpu_thread_pinned_ = true;
+  const std::vector<xe::threading::LogicalProcessor>& processors =
+      xe::threading::GetLogicalProcessors();
+  uint32_t max_efficiency_class = 0;
+  for (const xe::threading::LogicalProcessor& processor : processors) {
+    max_efficiency_class =
+        std::max(max_efficiency_class, processor.efficiency_class);
+  }
+  uint64_t fast_processor_mask = 0;
+  bool heterogeneous = false;
+  for (const xe::threading::LogicalProcessor& processor : processors) {
+    if (processor.efficiency_class == max_efficiency_class) {
+      fast_processor_mask |= uint64_t(1) << processor.index;
+    } else {
+      heterogeneous = true;
+    }
+  }
+  if (!heterogeneous || !fast_processor_mask) {
+    return;
+  }
+  gpu_thread->thread()->set_affinity_mask(fast_processor_mask);
+  XELOGI("Performance governor: GPU thread pinned to processors 0x{:X}",
+         fast_processor_mask);
+}
+
+void PerformanceGovernor::UpdateHintSession() {
+  if (!hint_sessions_supported_) {
+    return;
+  }
+  std::vector<uint32_t> thread_ids;
+  kernel::XHostThread* gpu_thread =
+      emulator_->graphics_system()->command_processor()->worker_thread();
+  if (gpu_thread && gpu_thread->thread()) {
+    thread_ids.push_back(gpu_thread->thread()->system_id());
+  }
+  auto threads =
+      emulator_->kernel_state()->object_table()->GetObjectsByType<
+          kernel::XThread>(kernel::XObject::Type::Thread);
+  for (const auto& thread : threads) {
+    if (thread->is_guest_thread() && thread->is_running() &&
+        thread->thread()) {
+      thread_ids.push_back(thread->thread()->system_id());
+    }
+  }
+  std::sort(thread_ids.begin(), thread_ids.end());
+
+  uint64_t target_ns = GetTargetFrameDurationNs();
+  if (thread_ids != hint_session_thread_ids_) {
+    // The threads of a session can't be changed on the older API levels.
+    hint_session_.reset();
+    hint_session_thread_ids_ = std::move(thread_ids);
+    if (!hint_session_thread_ids_.empty()) {
+      hint_session_ = power::PerformanceHintSession::Create(
+          hint_session_thread_ids_, target_ns);
+      if (!hint_session_) {
+        // Not retrying every second.
+        hint_sessions_supported_ = false;
+        return;
+      }
+    }
+    hint_session_target_ns_ = target_ns;
+  } else if (hint_session_ && target_ns != hint_session_target_ns_) {
+    hint_session_->UpdateTargetWorkDuration(target_ns);
+    hint_session_target_ns_ = target_ns;
+  }
+}
+
+void PerformanceGovernor::ReportFrameDurations() {
+  if (!hint_session_) {
+    return;
+  }
+  emulator_->graphics_system()->command_processor()->GetRecentSwapHostTicks(
+      swap_host_ticks_);
+  if (swap_host_ticks_.empty()) {
+    return;
+  }
+  uint64_t host_tick_frequency = Clock::QueryHostTickFrequency();
+  for (size_t i = 1; i < swap_host_ticks_.size(); ++i) {
+    if (swap_host_ticks_[i] <= last_reported_swap_host_tick_) {
+      continue;
+    }
+    uint64_t duration_ticks = swap_host_ticks_[i] - swap_host_ticks_[i - 1];
+    // Longer gaps are pauses or loading, not frames of the usual workload.
+    if (duration_ticks >= host_tick_frequency) {
+      continue;
+    }
+    hint_session_->ReportActualWorkDuration(duration_ticks * 1000000000 /
+                                            host_tick_frequency);
+  }
+  last_reported_swap_host_tick_ = swap_host_ticks_.back();
+}
+
+void PerformanceGovernor::UpdateFramerateLimit() {
+  float headroom = power::GetThermalHeadroom(kThermalForecastSeconds);
+  if (headroom < 0.0f) {
+    return;
+  }
+  ++seconds_since_framerate_limit_change_;
+  gpu::GraphicsSystem* graphics_system = emulator_->graphics_system();
+  uint32_t governed_limit = graphics_system->governed_framerate_limit();
+  uint64_t framerate_limit = graphics_system->GetFramerateLimit();
+  uint32_t current_limit =
+      framerate_limit
+          ? uint32_t(std::min<uint64_t>(framerate_limit, UINT32_MAX))
+          : kDefaultFramerate;
+  if (headroom >= kHeadroomToLowerFramerateLimit) {
+    uint32_t min_limit =
+        std::max(cvars::performance_governor_min_framerate, uint32_t(1));
+    if (seconds_since_framerate_limit_change_ <
+            kSecondsBetweenFramerateLimitLowering ||
+        current_limit <= min_limit) {
+      return;
+    }
+    uint32_t new_limit =
+        std::max(current_limit - std::min(current_limit, kFramerateLimitStep),
+                 min_limit);
+    graphics_system->set_governed_framerate_limit(new_limit);
+    seconds_since_framerate_limit_change_ = 0;
+    XELOGI(
+        "Performance governor: thermal headroom forecast {:.2f}, lowering the "
+        "frame rate limit to {}",
+        headroom, new_limit);
+    if (!throttling_reported_) {
+      throttling_reported_ = true;
+      // The render targets and the textures are created with the scale.
+      XELOGW(
+          "Performance governor: the device is running hot - lower "
+          "draw_resolution_scale_x and draw_resolution_scale_y to reduce the "
+          "GPU load, this can't be done while the emulator is running");
+    }
+    return;
+  }
+  if (governed_limit && headroom < kHeadroomToRaiseFramerateLimit &&
+      seconds_since_framerate_limit_change_ >=
+          kSecondsBetweenFramerateLimitRaising) {
+    uint64_t ungoverned_limit = cvars::framerate_limit;
+    uint32_t new_limit = governed_limit + kFramerateLimitStep;
+    if (new_limit >= (ungoverned_limit ? ungoverned_limit
+                                       : uint64_t(kDefaultFramerate))) {
+      new_limit = 0;
+    }
+    graphics_system->set_governed_framerate_limit(new_limit);
+    seconds_since_framerate_limit_change_ = 0;
+    if (new_limit) {
+      XELOGI(
+          "Performance governor: thermal headroom forecast {:.2f}, raising "
+          "the frame rate limit to {}",
+          headroom, new_limit);
+    } else {
+      XELOGI(
+          "Performance governor: thermal headroom forecast {:.2f}, removing "
+          "the frame rate limit",
+          headroom);
+    }
+  }
+}
+
+}  // namespace xe
@@ -0,0 +1,79 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_PERFORMANCE_GOVERNOR_H_
+#define XENIA_PERFORMANCE_GOVERNOR_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "xenia/base/power.h"
+#include "xenia/base/threading.h"
+
+namespace xe {
+class Emulator;
+}  // namespace xe
+
+namespace xe {
+
+// Keeps the frame times stable under sustained load on hosts with thermal and
+// performance hint APIs (currently Android):
+// - Reports the guest frame times to the OS for the GPU command processor and
+//   the guest threads, so the CPU clocks are raised before frames are missed
+//   rather than after the load is noticed.
+// - Runs the GPU command processor thread on the fastest cores of
+//   heterogeneous CPUs.
+// - Lowers the frame rate limit in steps when the thermal headroom forecast
+//   shows that throttling is about to set in, and raises it back once the
+//   device has cooled down, as a steadily lower frame rate is better than the
+//   frame time collapse when the clocks are throttled.
+class PerformanceGovernor {
+ public:
+  // Returns nullptr if disabled or if the host provides none of the APIs. The
+  // emulator must be set up and outlive the governor.
+  static std::unique_ptr<PerformanceGovernor> Create(Emulator* emulator);
+
+  ~PerformanceGovernor();
+
+ private:
+  explicit PerformanceGovernor(Emulator* emulator);
+
+  void GovernorThread();
+  uint64_t GetTargetFrameDurationNs() const;
+  void PinGpuThreadToFastCores();
+  // Recreates the session if the set of the threads has changed.
+  void UpdateHintSession();
+  void ReportFrameDurations();
+  void UpdateFramerateLimit();
+
+  Emulator* emulator_;
+
+  std::unique_ptr<xe::threading::Thread> governor_thread_;
+  std::mutex governor_shutdown_mutex_;
+  std::condition_variable governor_shutdown_cond_;
+  bool governor_shutdown_ = false;
+
+  // Accessed only on the governor thread.
+  bool hint_sessions_supported_ = true;
+  std::unique_ptr<power::PerformanceHintSession> hint_session_;
+  std::vector<uint32_t> hint_session_thread_ids_;
+  uint64_t hint_session_target_ns_ = 0;
+  std::vector<uint64_t> swap_host_ticks_;
+  uint64_t last_reported_swap_host_tick_ = 0;
+  bool gpu_thread_pinned_ = false;
+  uint32_t seconds_since_framerate_limit_change_ = 0;
+  bool throttling_reported_ = false;
+};
+
+}  // namespace xe
+
+#endif  // XENIA_PERFORMANCE_GOVERNOR_H_
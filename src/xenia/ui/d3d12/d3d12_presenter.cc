@@ -234,13 +234,18 @@ D3D12Presenter::ConnectOrReconnectPaintingToSurfaceFromUIThread(
          paint_context_.swap_chain_buffers) {
       swap_chain_buffer_ref.Reset();
     }
+    // The same applies to the frame latency waitable object flag.
+    UINT swap_chain_flags = 0;
+    if (paint_context_.swap_chain_allows_tearing) {
+      swap_chain_flags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+    }
+    if (paint_context_.swap_chain_frame_latency_waitable_object) {
+      swap_chain_flags |= DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+    }
     bool swap_chain_resized =
         SUCCEEDED(paint_context_.swap_chain->ResizeBuffers(
             0, UINT(new_swap_chain_width), UINT(new_swap_chain_height),
-            DXGI_FORMAT_UNKNOWN,
-            paint_context_.swap_chain_allows_tearing
-                ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING
-                : 0));
+            DXGI_FORMAT_UNKNOWN, swap_chain_flags));
     if (swap_chain_resized) {
       for (uint32_t i = 0; i < PaintContext::kSwapChainBufferCount; ++i) {
         if (FAILED(paint_context_.swap_chain->GetBuffer(
@@ -291,6 +296,12 @@ D3D12Presenter::ConnectOrReconnectPaintingToSurfaceFromUIThread(
       // rate.
       swap_chain_desc.Flags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
     }
+    if (cvars::present_max_frame_latency > 0) {
+      // Let the presenter wait until the presentation queue has space instead
+      // of blocking in Present with more frames queued than needed.
+      swap_chain_desc.Flags |=
+          DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+    }
     IDXGIFactory2* dxgi_factory = provider_.GetDXGIFactory();
     ID3D12CommandQueue* direct_queue = provider_.GetDirectQueue();
     Microsoft::WRL::ComPtr<IDXGISwapChain1> swap_chain_1;
@@ -333,6 +344,19 @@ D3D12Presenter::ConnectOrReconnectPaintingToSurfaceFromUIThread(
     paint_context_.swap_chain_height = new_swap_chain_height;
     paint_context_.swap_chain_allows_tearing =
         (swap_chain_desc.Flags & DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING) != 0;
+    if (swap_chain_desc.Flags &
+        DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT) {
+      if (SUCCEEDED(paint_context_.swap_chain->SetMaximumFrameLatency(
+              UINT(std::min(cvars::present_max_frame_latency,
+                            int32_t(DXGI_MAX_SWAP_CHAIN_BUFFERS)))))) {
+        paint_context_.swap_chain_frame_latency_waitable_object =
+            paint_context_.swap_chain->GetFrameLatencyWaitableObject();
+      } else {
+        XELOGW(
+            "D3D12Presenter: Failed to set the maximum frame latency of a "
+            "swap chain");
+      }
+    }
     for (uint32_t i = 0; i < PaintContext::kSwapChainBufferCount; ++i) {
       if (FAILED(paint_context_.swap_chain->GetBuffer(
               i, IID_PPV_ARGS(&paint_context_.swap_chain_buffers[i])))) {
@@ -442,6 +466,10 @@ void D3D12Presenter::PaintContext::DestroySwapChain() {
        swap_chain_buffers) {
     swap_chain_buffer_ref.Reset();
   }
+  if (swap_chain_frame_latency_waitable_object) {
+    CloseHandle(swap_chain_frame_latency_waitable_object);
+    swap_chain_frame_latency_waitable_object = nullptr;
+  }
   swap_chain.Reset();
   swap_chain_allows_tearing = false;
   swap_chain_height = 0;
@@ -450,6 +478,15 @@ void D3D12Presenter::PaintContext::DestroySwapChain() {
 
 Presenter::PaintResult D3D12Presenter::PaintAndPresentImpl(
     bool execute_ui_drawers) {
+  // With a limited frame latency, wait until the presentation queue can accept
+  // a new frame before doing anything so the frame is painted from the most
+  // up-to-date state. Timing out after a second in case of a hang in the
+  // presentation engine - a late present is better than a frozen UI thread.
+  if (paint_context_.swap_chain_frame_latency_waitable_object) {
+    WaitForSingleObjectEx(
+        paint_context_.swap_chain_frame_latency_waitable_object, 1000, TRUE);
+  }
+
   // Begin the command list with the command allocator not currently potentially
   // used on the GPU.
   UINT64 current_paint_submission =
@@ -606,11 +643,13 @@ Presenter::PaintResult D3D12Presenter::PaintAndPresentImpl(
       }
 
       // Make sure intermediate textures of the needed size are available, and
-      // unneeded intermediate textures are destroyed.
+      // intermediate textures unneeded for a long time are destroyed.
       for (size_t i = 0; i < kMaxGuestOutputPaintEffects - 1; ++i) {
         std::pair<uint32_t, uint32_t> intermediate_needed_size(0, 0);
         if (i + 1 < guest_output_flow.effect_count) {
           intermediate_needed_size = guest_output_flow.effect_output_sizes[i];
+          paint_context_.guest_output_intermediate_texture_last_needed[i] =
+              current_paint_submission;
         }
         Microsoft::WRL::ComPtr<ID3D12Resource>& intermediate_texture_ptr_ref =
             paint_context_.guest_output_intermediate_textures[i];
@@ -690,8 +729,13 @@ Presenter::PaintResult D3D12Presenter::PaintAndPresentImpl(
                     uint32_t(PaintContext::kRTVIndexGuestOutputIntermediate0 +
                              i)));
           } else {
-            // Was previously needed, but not anymore - destroy when possible.
+            // Was previously needed, but not anymore - keep for some time in
+            // case it's needed again, then destroy when possible.
             if (intermediate_texture_ptr_ref &&
+                current_paint_submission -
+                        paint_context_
+                            .guest_output_intermediate_texture_last_needed[i] >=
+                    kGuestOutputIntermediateRetentionPaintCount &&
                 paint_context_.paint_submission_tracker
                         .GetCompletedSubmission() >=
                     paint_context_
@@ -262,6 +262,10 @@ class D3D12Presenter final : public Presenter {
                kMaxGuestOutputPaintEffects - 1>
         guest_output_intermediate_textures;
     UINT64 guest_output_intermediate_texture_last_usage = 0;
+    // Paint submission indices when each intermediate texture was last needed
+    // by the effect chain, for delayed destruction of unneeded textures.
+    std::array<UINT64, kMaxGuestOutputPaintEffects - 1>
+        guest_output_intermediate_texture_last_needed = {};
 
     // Connection-specific.
 
@@ -269,6 +273,9 @@ class D3D12Presenter final : public Presenter {
     uint32_t swap_chain_height = 0;
     bool swap_chain_allows_tearing = false;
     Microsoft::WRL::ComPtr<IDXGISwapChain3> swap_chain;
+    // If present_max_frame_latency is used, the handle signaled by DXGI when
+    // the swap chain can accept a new frame without exceeding the latency.
+    HANDLE swap_chain_frame_latency_waitable_object = nullptr;
     std::array<Microsoft::WRL::ComPtr<ID3D12Resource>, kSwapChainBufferCount>
         swap_chain_buffers;
   };
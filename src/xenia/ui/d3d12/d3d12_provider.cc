@@ -77,6 +77,9 @@ D3D12Provider::~D3D12Provider() {
   if (device_ != nullptr) {
     device_->Release();
   }
+  if (dxgi_adapter3_ != nullptr) {
+    dxgi_adapter3_->Release();
+  }
   if (dxgi_factory_ != nullptr) {
     dxgi_factory_->Release();
   }
@@ -293,6 +296,7 @@ bool D3D12Provider::Initialize() {
     return false;
   }
   adapter_vendor_id_ = GpuVendorID(adapter_desc.VendorId);
+  adapter_device_id_ = adapter_desc.DeviceId;
   int adapter_name_mb_size = WideCharToMultiByte(
       CP_UTF8, 0, adapter_desc.Description, -1, nullptr, 0, nullptr, nullptr);
   if (adapter_name_mb_size != 0) {
@@ -315,6 +319,10 @@ bool D3D12Provider::Initialize() {
     dxgi_factory->Release();
     return false;
   }
+  // For the video memory budget, optional (Windows 10 and newer).
+  if (FAILED(adapter->QueryInterface(IID_PPV_ARGS(&dxgi_adapter3_)))) {
+    dxgi_adapter3_ = nullptr;
+  }
   adapter->Release();
 
   // Configure the Direct3D 12 debug info queue.
@@ -551,6 +559,21 @@ std::unique_ptr<ImmediateDrawer> D3D12Provider::CreateImmediateDrawer() {
   return D3D12ImmediateDrawer::Create(*this);
 }
 
+bool D3D12Provider::QueryVideoMemoryBudget(uint64_t& usage_out,
+                                           uint64_t& budget_out) const {
+  if (!dxgi_adapter3_) {
+    return false;
+  }
+  DXGI_QUERY_VIDEO_MEMORY_INFO video_memory_info;
+  if (FAILED(dxgi_adapter3_->QueryVideoMemoryInfo(
+          0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &video_memory_info))) {
+    return false;
+  }
+  usage_out = video_memory_info.CurrentUsage;
+  budget_out = video_memory_info.Budget;
+  return budget_out != 0;
+}
+
 }  // namespace d3d12
 }  // namespace ui
 }  // namespace xe
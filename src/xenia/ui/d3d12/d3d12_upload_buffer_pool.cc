@@ -77,6 +77,9 @@ uint8_t* D3D12UploadBufferPool::RequestPartial(
 
 GraphicsUploadBufferPool::Page*
 D3D12UploadBufferPool::CreatePageImplementation() {
+  // The size may have been increased when growing the ring.
+  page_size_ =
+      xe::align(page_size_, size_t(D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT));
   D3D12_RESOURCE_DESC buffer_desc;
   util::FillBufferResourceDesc(buffer_desc, page_size_,
                                D3D12_RESOURCE_FLAG_NONE);
@@ -10,6 +10,7 @@
 #ifndef XENIA_UI_GRAPHICS_PROVIDER_H_
 #define XENIA_UI_GRAPHICS_PROVIDER_H_
 
+#include <cstdint>
 #include <memory>
 
 #include "xenia/ui/immediate_drawer.h"
@@ -46,6 +47,14 @@ class GraphicsProvider {
 
   virtual std::unique_ptr<ImmediateDrawer> CreateImmediateDrawer() = 0;
 
+  // Returns the current usage by the process and the budget provided by the OS
+  // for the video memory, or false if not available. Can be called from any
+  // thread.
+  virtual bool QueryVideoMemoryBudget(uint64_t& usage_out,
+                                      uint64_t& budget_out) const {
+    return false;
+  }
+
  protected:
   GraphicsProvider() = default;
 };
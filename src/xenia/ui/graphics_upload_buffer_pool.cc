@@ -12,79 +12,104 @@
 #include <algorithm>
 
 #include "xenia/base/assert.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 
+DECLARE_bool(low_memory_mode);
+
 namespace xe {
 namespace ui {
 
 GraphicsUploadBufferPool::~GraphicsUploadBufferPool() { ClearCache(); }
 
 void GraphicsUploadBufferPool::Reclaim(uint64_t completed_submission_index) {
-  while (submitted_first_) {
-    if (submitted_first_->last_submission_index_ > completed_submission_index) {
+  while (!submission_ends_.empty()) {
+    const SubmissionEnd& submission_end = submission_ends_.front();
+    if (submission_end.submission_index > completed_submission_index) {
       break;
     }
-    if (writable_last_) {
-      writable_last_->next_ = submitted_first_;
-    } else {
-      writable_first_ = submitted_first_;
+    ring_tail_ = submission_end.position;
+    submission_ends_.pop_front();
+  }
+  while (retired_first_) {
+    if (retired_first_->last_submission_index_ > completed_submission_index) {
+      break;
     }
-    writable_last_ = submitted_first_;
-    submitted_first_ = submitted_first_->next_;
-    writable_last_->next_ = nullptr;
+    Page* next = retired_first_->next_;
+    delete retired_first_;
+    retired_first_ = next;
+  }
+  if (!retired_first_) {
+    retired_last_ = nullptr;
   }
-  if (!submitted_first_) {
-    submitted_last_ = nullptr;
+  // Release the memory of a ring grown for a burst of uploads once nothing is
+  // using it, to create one with the base size on the next request.
+  if (cvars::low_memory_mode && ring_ && page_size_ > base_page_size_ &&
+      submission_ends_.empty() && ring_flushed_ >= ring_head_ &&
+      Clock::QueryHostTickCount() - large_use_host_ticks_ >=
+          Clock::QueryHostTickFrequency() * kLowMemoryModeShrinkDelaySeconds) {
+    XELOGI("Upload buffer ring idle, shrinking from {} to {} bytes",
+           page_size_, base_page_size_);
+    delete ring_;
+    ring_ = nullptr;
+    page_size_ = base_page_size_;
+    ring_head_ = 0;
+    ring_tail_ = 0;
+    ring_flushed_ = 0;
   }
 }
 
 void GraphicsUploadBufferPool::ChangeSubmissionTimeline() {
-  // Reclaim all submitted pages.
-  if (writable_last_) {
-    writable_last_->next_ = submitted_first_;
-  } else {
-    writable_first_ = submitted_first_;
+  // Reclaim all the space used by the submissions.
+  submission_ends_.clear();
+  ring_tail_ = ring_head_;
+  while (retired_first_) {
+    Page* next = retired_first_->next_;
+    delete retired_first_;
+    retired_first_ = next;
   }
-  writable_last_ = submitted_last_;
-  submitted_first_ = nullptr;
-  submitted_last_ = nullptr;
+  retired_last_ = nullptr;
 
-  // Mark all pages as never used yet in the new timeline.
-  Page* page = writable_first_;
-  while (page) {
-    page->last_submission_index_ = 0;
-    page = page->next_;
+  // Mark the ring as never used yet in the new timeline.
+  if (ring_) {
+    ring_->last_submission_index_ = 0;
   }
 }
 
 void GraphicsUploadBufferPool::ClearCache() {
   // Called from the destructor - must not call virtual functions here.
-  current_page_flushed_ = 0;
-  current_page_used_ = 0;
-  while (submitted_first_) {
-    Page* next_ = submitted_first_->next_;
-    delete submitted_first_;
-    submitted_first_ = next_;
-  }
-  submitted_last_ = nullptr;
-  while (writable_first_) {
-    Page* next_ = writable_first_->next_;
-    delete writable_first_;
-    writable_first_ = next_;
-  }
-  writable_last_ = nullptr;
+  submission_ends_.clear();
+  ring_head_ = 0;
+  ring_tail_ = 0;
+  ring_flushed_ = 0;
+  delete ring_;
+  ring_ = nullptr;
+  while (retired_first_) {
+    Page* next = retired_first_->next_;
+    delete retired_first_;
+    retired_first_ = next;
+  }
+  retired_last_ = nullptr;
 }
 
 GraphicsUploadBufferPool::Page::~Page() {}
 
 void GraphicsUploadBufferPool::FlushWrites() {
-  if (current_page_flushed_ >= current_page_used_) {
+  if (ring_flushed_ >= ring_head_) {
     return;
   }
-  assert_not_null(writable_first_);
-  FlushPageWrites(writable_first_, current_page_flushed_,
-                  current_page_used_ - current_page_flushed_);
-  current_page_flushed_ = current_page_used_;
+  assert_not_null(ring_);
+  size_t offset = size_t(ring_flushed_ % page_size_);
+  size_t size = size_t(ring_head_ - ring_flushed_);
+  // May wrap around the end of the ring.
+  size_t size_before_end = std::min(size, page_size_ - offset);
+  FlushPageWrites(ring_, offset, size_before_end);
+  if (size_before_end < size) {
+    FlushPageWrites(ring_, 0, size - size_before_end);
+  }
+  ring_flushed_ = ring_head_;
 }
 
 GraphicsUploadBufferPool::Page* GraphicsUploadBufferPool::Request(
@@ -93,53 +118,15 @@ GraphicsUploadBufferPool::Page* GraphicsUploadBufferPool::Request(
   alignment = std::max(alignment, size_t(1));
   assert_true(xe::is_pow2(alignment));
   size = xe::align(size, alignment);
-  assert_true(size <= page_size_);
-  if (size > page_size_) {
-    return nullptr;
-  }
-  assert_true(!current_page_used_ ||
-              submission_index >= writable_first_->last_submission_index_);
-  assert_true(!submitted_last_ ||
-              submission_index >= submitted_last_->last_submission_index_);
-  size_t current_page_used_aligned = xe::align(current_page_used_, alignment);
-  if (current_page_used_aligned + size > page_size_ || !writable_first_) {
-    // Start a new page if can't fit all the bytes or don't have an open page.
-    if (writable_first_) {
-      // Close the page that was current.
-      FlushWrites();
-      if (submitted_last_) {
-        submitted_last_->next_ = writable_first_;
-      } else {
-        submitted_first_ = writable_first_;
-      }
-      submitted_last_ = writable_first_;
-      writable_first_ = writable_first_->next_;
-      submitted_last_->next_ = nullptr;
-      if (!writable_first_) {
-        writable_last_ = nullptr;
-      }
-    }
-    if (!writable_first_) {
-      // Create a new page if none available.
-      writable_first_ = CreatePageImplementation();
-      if (!writable_first_) {
-        // Failed to create.
-        return nullptr;
-      }
-      writable_first_->last_submission_index_ = submission_index;
-      writable_first_->next_ = nullptr;
-      writable_last_ = writable_first_;
-      // After CreatePageImplementation (more specifically, the first successful
-      // call), page_size_ may grow - but this doesn't matter here.
+  uint64_t position;
+  if (GetContiguousFreeSpace(alignment, false, position) < size &&
+      GetContiguousFreeSpace(alignment, true, position) < size) {
+    if (!GrowRing(submission_index, size)) {
+      return nullptr;
     }
-    current_page_used_ = 0;
-    current_page_used_aligned = 0;
-    current_page_flushed_ = 0;
-  }
-  writable_first_->last_submission_index_ = submission_index;
-  offset_out = current_page_used_aligned;
-  current_page_used_ = current_page_used_aligned + size;
-  return writable_first_;
+    position = 0;
+  }
+  return Allocate(submission_index, position, size, offset_out);
 }
 
 GraphicsUploadBufferPool::Page* GraphicsUploadBufferPool::RequestPartial(
@@ -148,13 +135,22 @@ GraphicsUploadBufferPool::Page* GraphicsUploadBufferPool::RequestPartial(
   alignment = std::max(alignment, size_t(1));
   assert_true(xe::is_pow2(alignment));
   size = xe::align(size, alignment);
-  size = std::min(size, page_size_);
-  size_t current_page_used_aligned = xe::align(current_page_used_, alignment);
-  if (current_page_used_aligned + alignment <= page_size_) {
-    size = std::min(
-        size, (page_size_ - current_page_used_aligned) & ~(alignment - 1));
+  uint64_t position;
+  size_t free_size =
+      GetContiguousFreeSpace(alignment, false, position) & ~(alignment - 1);
+  if (!free_size) {
+    free_size =
+        GetContiguousFreeSpace(alignment, true, position) & ~(alignment - 1);
+  }
+  if (!free_size) {
+    if (!GrowRing(submission_index, alignment)) {
+      return nullptr;
+    }
+    position = 0;
+    free_size = page_size_ & ~(alignment - 1);
   }
-  Page* page = Request(submission_index, size, alignment, offset_out);
+  size = std::min(size, free_size);
+  Page* page = Allocate(submission_index, position, size, offset_out);
   if (!page) {
     return nullptr;
   }
@@ -165,5 +161,91 @@ GraphicsUploadBufferPool::Page* GraphicsUploadBufferPool::RequestPartial(
 void GraphicsUploadBufferPool::FlushPageWrites(Page* page, size_t offset,
                                                size_t size) {}
 
+size_t GraphicsUploadBufferPool::GetContiguousFreeSpace(
+    size_t alignment, bool wrap, uint64_t& position_out) const {
+  if (!ring_) {
+    return 0;
+  }
+  uint64_t cycle_start = ring_head_ - ring_head_ % page_size_;
+  uint64_t position =
+      cycle_start + xe::align(size_t(ring_head_ - cycle_start), alignment);
+  if (wrap || position >= cycle_start + page_size_) {
+    cycle_start += page_size_;
+    position = cycle_start;
+  }
+  uint64_t end = std::min(cycle_start + page_size_, ring_tail_ + page_size_);
+  position_out = position;
+  return position < end ? size_t(end - position) : 0;
+}
+
+bool GraphicsUploadBufferPool::GrowRing(uint64_t submission_index,
+                                        size_t min_size) {
+  size_t old_page_size = page_size_;
+  size_t new_page_size = page_size_;
+  if (ring_) {
+    FlushWrites();
+    new_page_size *= 2;
+  }
+  page_size_ = std::max(new_page_size, min_size);
+  Page* new_ring = CreatePageImplementation();
+  if (!new_ring) {
+    page_size_ = old_page_size;
+    return false;
+  }
+  new_ring->last_submission_index_ = submission_index;
+  new_ring->next_ = nullptr;
+  if (!ring_ && old_page_size == base_page_size_ && min_size <= old_page_size) {
+    // The implementation may have rounded the base size up.
+    base_page_size_ = page_size_;
+  }
+  if (ring_) {
+    ++grow_count_;
+    XELOGI("Upload buffer ring full, growing from {} to {} bytes",
+           old_page_size, page_size_);
+    if (submission_ends_.empty()) {
+      delete ring_;
+    } else {
+      ring_->last_submission_index_ =
+          submission_ends_.back().submission_index;
+      ring_->next_ = nullptr;
+      if (retired_last_) {
+        retired_last_->next_ = ring_;
+      } else {
+        retired_first_ = ring_;
+      }
+      retired_last_ = ring_;
+    }
+  }
+  ring_ = new_ring;
+  submission_ends_.clear();
+  ring_head_ = 0;
+  ring_tail_ = 0;
+  ring_flushed_ = 0;
+  return true;
+}
+
+GraphicsUploadBufferPool::Page* GraphicsUploadBufferPool::Allocate(
+    uint64_t submission_index, uint64_t position, size_t size,
+    size_t& offset_out) {
+  assert_not_null(ring_);
+  assert_true(submission_ends_.empty() ||
+              submission_index >= submission_ends_.back().submission_index);
+  ring_head_ = position + size;
+  if (!submission_ends_.empty() &&
+      submission_ends_.back().submission_index == submission_index) {
+    submission_ends_.back().position = ring_head_;
+  } else {
+    submission_ends_.push_back({submission_index, ring_head_});
+  }
+  ring_->last_submission_index_ = submission_index;
+  size_t used_size = size_t(ring_head_ - ring_tail_);
+  peak_used_size_ = std::max(peak_used_size_, used_size);
+  if (used_size > base_page_size_) {
+    large_use_host_ticks_ = Clock::QueryHostTickCount();
+  }
+  offset_out = size_t(position % page_size_);
+  return ring_;
+}
+
 }  // namespace ui
 }  // namespace xe
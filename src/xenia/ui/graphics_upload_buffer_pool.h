@@ -12,6 +12,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 
 #include "xenia/base/literals.h"
 
@@ -23,6 +24,13 @@ using namespace xe::literals;
 // Submission index is the fence value or a value derived from it (if reclaiming
 // less often than once per fence value, for instance).
 
+// A persistently mapped ring buffer, with the space used by each submission
+// being reclaimed when the submission is completed. If the GPU falls behind and
+// the ring doesn't have enough free space, or for a request larger than the
+// whole ring, the ring is replaced with a bigger one, and the old one is
+// destroyed after the completion of the last submission using it. In
+// low_memory_mode, a grown ring is shrunk back once it has been idle for some
+// time.
 class GraphicsUploadBufferPool {
  public:
   // Taken from the Direct3D 12 MiniEngine sample (LinearAllocator
@@ -39,6 +47,15 @@ class GraphicsUploadBufferPool {
   // implementation doesn't require explicit flushing.
   void FlushWrites();
 
+  // Current size of the ring.
+  size_t page_size() const { return page_size_; }
+  // The maximum amount of space, including the padding at the end of the ring
+  // when wrapping around, that has been used by the submissions not completed
+  // yet at once.
+  size_t peak_used_size() const { return peak_used_size_; }
+  // Number of times the ring had to be replaced with a bigger one.
+  uint32_t grow_count() const { return grow_count_; }
+
  protected:
   // Extended by the implementation.
   struct Page {
@@ -47,36 +64,71 @@ class GraphicsUploadBufferPool {
     Page* next_;
   };
 
-  GraphicsUploadBufferPool(size_t page_size) : page_size_(page_size) {}
+  GraphicsUploadBufferPool(size_t page_size)
+      : page_size_(page_size), base_page_size_(page_size) {}
 
-  // Request to write data in a single piece, creating a new page if the current
-  // one doesn't have enough free space.
+  // Request to write data in a single piece, wrapping around or growing the
+  // ring if there's not enough contiguous free space.
   Page* Request(uint64_t submission_index, size_t size, size_t alignment,
                 size_t& offset_out);
-  // Request to write data in multiple parts, filling the buffer entirely.
+  // Request to write data in multiple parts, using the contiguous free space
+  // until the end of the ring (or until the data still in use by the GPU) if
+  // there is any.
   Page* RequestPartial(uint64_t submission_index, size_t size, size_t alignment,
                        size_t& offset_out, size_t& size_out);
 
+  // Creates a buffer of page_size_ bytes.
   virtual Page* CreatePageImplementation() = 0;
 
   virtual void FlushPageWrites(Page* page, size_t offset, size_t size);
 
-  // May be increased by the implementation on creation or on first allocation
-  // to avoid wasting space if the real allocation turns out to be bigger than
-  // the specified page size.
+  // The size of the current ring. May be increased by the implementation in
+  // CreatePageImplementation to avoid wasting space if the real allocation
+  // turns out to be bigger than the specified size.
   size_t page_size_;
 
-  // A list of buffers with free space, with the first buffer being the one
-  // currently being filled.
-  Page* writable_first_ = nullptr;
-  Page* writable_last_ = nullptr;
-  // A list of full buffers that can be reclaimed when the GPU doesn't use them
-  // anymore.
-  Page* submitted_first_ = nullptr;
-  Page* submitted_last_ = nullptr;
-
-  size_t current_page_used_ = 0;
-  size_t current_page_flushed_ = 0;
+ private:
+  // Returns the contiguous free space in the ring starting at the aligned
+  // position at or after ring_head_, in the current cycle or, if wrap is true,
+  // after wrapping around.
+  size_t GetContiguousFreeSpace(size_t alignment, bool wrap,
+                                uint64_t& position_out) const;
+  // Replaces the ring with a bigger one able to hold at least min_size bytes.
+  bool GrowRing(uint64_t submission_index, size_t min_size);
+  Page* Allocate(uint64_t submission_index, uint64_t position, size_t size,
+                 size_t& offset_out);
+
+  // Seconds the ring must not need more than base_page_size_ to be shrunk in
+  // low_memory_mode.
+  static constexpr uint32_t kLowMemoryModeShrinkDelaySeconds = 10;
+
+  // The size of the ring before it has grown.
+  size_t base_page_size_;
+  // Host tick count of the latest allocation that left more than
+  // base_page_size_ in use.
+  uint64_t large_use_host_ticks_ = 0;
+
+  // The current ring.
+  Page* ring_ = nullptr;
+  // Positions in the ring are counted from the creation of the ring without
+  // wrapping, so the offset is the position modulo page_size_.
+  uint64_t ring_head_ = 0;
+  uint64_t ring_tail_ = 0;
+  uint64_t ring_flushed_ = 0;
+  // The end positions of the data written in the pending submissions, sorted
+  // by the submission index.
+  struct SubmissionEnd {
+    uint64_t submission_index;
+    uint64_t position;
+  };
+  std::deque<SubmissionEnd> submission_ends_;
+
+  // Replaced rings to destroy once their last submission has been completed.
+  Page* retired_first_ = nullptr;
+  Page* retired_last_ = nullptr;
+
+  size_t peak_used_size_ = 0;
+  uint32_t grow_count_ = 0;
 };
 
 }  // namespace ui
@@ -55,6 +55,8 @@ class MessageBoxDialog final : public ImGuiDialog {
         title_(std::move(title)),
         body_(std::move(body)) {}
 
+  bool ChangesOnlyOnInput() const override { return true; }
+
   void OnDraw(ImGuiIO& io) override {
     if (!has_opened_) {
       ImGui::OpenPopup(title_.c_str());
@@ -34,6 +34,11 @@ class ImGuiDialog {
 
   void Draw();
 
+  // Whether the dialog is drawn the same way as long as there's no input, so
+  // the drawer may stop repainting continuously when the result is unchanged.
+  // Dialogs displaying anything updated asynchronously must return false.
+  virtual bool ChangesOnlyOnInput() const { return false; }
+
  protected:
   ImGuiDialog(ImGuiDrawer* imgui_drawer);
 
@@ -10,7 +10,9 @@
 #include "xenia/ui/imgui_drawer.h"
 
 #include <cfloat>
+#include <cstdint>
 #include <cstring>
+#include <utility>
 
 #include "third_party/imgui/imgui.h"
 #include "xenia/base/assert.h"
@@ -89,6 +91,7 @@ void ImGuiDrawer::AddDialog(ImGuiDialog* dialog) {
     }
   }
   dialogs_.push_back(dialog);
+  RequestPaintIfActive();
 }
 
 void ImGuiDrawer::RemoveDialog(ImGuiDialog* dialog) {
@@ -105,6 +108,7 @@ void ImGuiDrawer::RemoveDialog(ImGuiDialog* dialog) {
     }
   }
   dialogs_.erase(it);
+  RequestPaintIfActive();
   DetachIfLastWindowRemoved();
 }
 
@@ -121,6 +125,7 @@ void ImGuiDrawer::AddNotification(ImGuiNotification* dialog) {
     }
   }
   notifications_.push_back(dialog);
+  RequestPaintIfActive();
 }
 
 void ImGuiDrawer::RemoveNotification(ImGuiNotification* dialog) {
@@ -130,6 +135,7 @@ void ImGuiDrawer::RemoveNotification(ImGuiNotification* dialog) {
     return;
   }
   notifications_.erase(it);
+  RequestPaintIfActive();
   DetachIfLastWindowRemoved();
 }
 
@@ -468,57 +474,132 @@ void ImGuiDrawer::Draw(UIDrawContext& ui_draw_context) {
   dialog_loop_next_index_ = SIZE_MAX;
 
   if (!notifications_.empty()) {
-    std::vector<ui::ImGuiNotification*> guest_notifications = {};
-    std::vector<ui::ImGuiNotification*> host_notifications = {};
-
-    std::copy_if(notifications_.cbegin(), notifications_.cend(),
-                 std::back_inserter(guest_notifications),
-                 [](ui::ImGuiNotification* notification) {
-                   return notification->GetNotificationType() ==
-                          NotificationType::Guest;
-                 });
-
-    std::copy_if(notifications_.cbegin(), notifications_.cend(),
-                 std::back_inserter(host_notifications),
-                 [](ui::ImGuiNotification* notification) {
-                   return notification->GetNotificationType() ==
-                          NotificationType::Host;
-                 });
-
-    if (guest_notifications.size() > 0) {
-      guest_notifications.at(0)->Draw();
+    // Only the first notification of each type is drawn. Looking them up
+    // before drawing, as drawing may remove a notification.
+    ImGuiNotification* guest_notification = nullptr;
+    ImGuiNotification* host_notification = nullptr;
+    bool has_more_host_notifications = false;
+    for (ImGuiNotification* notification : notifications_) {
+      switch (notification->GetNotificationType()) {
+        case NotificationType::Guest:
+          if (!guest_notification) {
+            guest_notification = notification;
+          }
+          break;
+        case NotificationType::Host:
+          if (host_notification) {
+            has_more_host_notifications = true;
+          } else {
+            host_notification = notification;
+          }
+          break;
+      }
+    }
+
+    if (guest_notification) {
+      guest_notification->Draw();
     }
 
-    if (host_notifications.size() > 0) {
-      host_notifications.at(0)->Draw();
+    if (host_notification) {
+      host_notification->Draw();
 
-      if (host_notifications.size() > 1) {
-        host_notifications.at(0)->SetDeletionPending();
+      if (has_more_host_notifications) {
+        host_notification->SetDeletionPending();
       }
     }
   }
 
   ImGui::Render();
   ImDrawData* draw_data = ImGui::GetDrawData();
+  bool frame_unchanged = false;
   if (draw_data) {
-    RenderDrawLists(draw_data, ui_draw_context);
+    frame_unchanged = RenderDrawLists(draw_data, ui_draw_context);
   }
 
   if (reset_mouse_position_after_next_frame_) {
     reset_mouse_position_after_next_frame_ = false;
     io.MousePos = ImVec2(-FLT_MAX, -FLT_MAX);
+    // Need to draw without hovering.
+    frame_unchanged = false;
   }
 
   // Detaching is deferred if the last dialog is removed during drawing, perform
   // it now if needed.
   DetachIfLastWindowRemoved();
 
-  if (!dialogs_.empty() || !notifications_.empty()) {
-    // Repaint (and handle input) continuously if still active.
+  if ((!dialogs_.empty() || !notifications_.empty()) &&
+      (!frame_unchanged || !IsIdle())) {
+    // Repaint (and handle input) continuously if still active. If nothing has
+    // changed in the last frame and nothing can change without input, the next
+    // paint is requested by the input or done for a new guest frame.
     presenter_->RequestUIPaintFromUIThread();
   }
 }
 
+bool ImGuiDrawer::IsIdle() const {
+  // Notifications are animated and time out.
+  if (!notifications_.empty()) {
+    return false;
+  }
+  for (const ImGuiDialog* dialog : dialogs_) {
+    if (!dialog->ChangesOnlyOnInput()) {
+      return false;
+    }
+  }
+  ImGui::SetCurrentContext(internal_state_);
+  // The text cursor blinks, and dragging may be scrolling.
+  return !ImGui::GetIO().WantTextInput && !ImGui::IsAnyMouseDown();
+}
+
+void ImGuiDrawer::RequestPaintIfActive() {
+  if (presenter_ && (!dialogs_.empty() || !notifications_.empty())) {
+    presenter_->RequestUIPaintFromUIThread();
+  }
+}
+
+bool ImGuiDrawer::FrameGeometry::operator==(const FrameGeometry& other) const {
+  if (display_width != other.display_width ||
+      display_height != other.display_height ||
+      vertices.size() != other.vertices.size() ||
+      indices.size() != other.indices.size() ||
+      draws.size() != other.draws.size() ||
+      batches.size() != other.batches.size()) {
+    return false;
+  }
+  if (!vertices.empty() &&
+      std::memcmp(vertices.data(), other.vertices.data(),
+                  sizeof(ImmediateVertex) * vertices.size())) {
+    return false;
+  }
+  if (!indices.empty() &&
+      std::memcmp(indices.data(), other.indices.data(),
+                  sizeof(uint16_t) * indices.size())) {
+    return false;
+  }
+  if (!batches.empty() &&
+      std::memcmp(batches.data(), other.batches.data(),
+                  sizeof(FrameBatch) * batches.size())) {
+    return false;
+  }
+  for (size_t i = 0; i < draws.size(); ++i) {
+    const ImmediateDraw& draw = draws[i];
+    const ImmediateDraw& other_draw = other.draws[i];
+    if (draw.primitive_type != other_draw.primitive_type ||
+        draw.count != other_draw.count ||
+        draw.index_offset != other_draw.index_offset ||
+        draw.base_vertex != other_draw.base_vertex ||
+        draw.texture != other_draw.texture ||
+        draw.scissor != other_draw.scissor ||
+        draw.scissor_left != other_draw.scissor_left ||
+        draw.scissor_top != other_draw.scissor_top ||
+        draw.scissor_right != other_draw.scissor_right ||
+        draw.scissor_bottom != other_draw.scissor_bottom) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void ImGuiDrawer::ClearDialogs() {
   size_t dialog_loop = 0;
 
@@ -527,43 +608,118 @@ void ImGuiDrawer::ClearDialogs() {
   }
 }
 
-void ImGuiDrawer::RenderDrawLists(ImDrawData* data,
+bool ImGuiDrawer::RenderDrawLists(ImDrawData* data,
                                   UIDrawContext& ui_draw_context) {
+  // Each batch is a separate upload and binding of the vertices and the
+  // indices, so the draw lists are merged into one batch, while keeping the
+  // batches well within the upload buffer pool pages (a larger draw list still
+  // gets a batch of its own).
+  static constexpr size_t kMaxBatchVertexCount = UINT16_MAX + 1;
+  static constexpr size_t kMaxBatchIndexCount = kMaxBatchVertexCount * 3;
+
   ImGuiIO& io = ImGui::GetIO();
 
-  immediate_drawer_->Begin(ui_draw_context, io.DisplaySize.x, io.DisplaySize.y);
+  std::swap(frame_geometry_, previous_frame_geometry_);
+  FrameGeometry& frame = frame_geometry_;
+  frame.Clear();
+  frame.display_width = io.DisplaySize.x;
+  frame.display_height = io.DisplaySize.y;
 
   for (int i = 0; i < data->CmdListsCount; ++i) {
     const auto cmd_list = data->CmdLists[i];
-
-    ImmediateDrawBatch batch;
-    batch.vertices =
-        reinterpret_cast<ImmediateVertex*>(cmd_list->VtxBuffer.Data);
-    batch.vertex_count = cmd_list->VtxBuffer.size();
-    batch.indices = cmd_list->IdxBuffer.Data;
-    batch.index_count = cmd_list->IdxBuffer.size();
-    immediate_drawer_->BeginDrawBatch(batch);
+    size_t list_vertex_count = size_t(cmd_list->VtxBuffer.size());
+    size_t list_index_count = size_t(cmd_list->IdxBuffer.size());
+
+    if (frame.batches.empty() ||
+        frame.batches.back().vertex_count + list_vertex_count >
+            kMaxBatchVertexCount ||
+        frame.batches.back().index_count + list_index_count >
+            kMaxBatchIndexCount) {
+      FrameBatch& new_batch = frame.batches.emplace_back();
+      new_batch.vertex_offset = frame.vertices.size();
+      new_batch.vertex_count = 0;
+      new_batch.index_offset = frame.indices.size();
+      new_batch.index_count = 0;
+      new_batch.draw_offset = frame.draws.size();
+      new_batch.draw_count = 0;
+    }
+    FrameBatch& batch = frame.batches.back();
+
+    int list_base_vertex = int(batch.vertex_count);
+    int list_index_offset = int(batch.index_count);
+    const auto list_vertices =
+        reinterpret_cast<const ImmediateVertex*>(cmd_list->VtxBuffer.Data);
+    frame.vertices.insert(frame.vertices.cend(), list_vertices,
+                          list_vertices + list_vertex_count);
+    frame.indices.insert(frame.indices.cend(), cmd_list->IdxBuffer.Data,
+                         cmd_list->IdxBuffer.Data + list_index_count);
+    batch.vertex_count += list_vertex_count;
+    batch.index_count += list_index_count;
 
     for (int j = 0; j < cmd_list->CmdBuffer.size(); ++j) {
       const auto& cmd = cmd_list->CmdBuffer[j];
+      if (!cmd.ElemCount) {
+        continue;
+      }
 
       ImmediateDraw draw;
       draw.primitive_type = ImmediatePrimitiveType::kTriangles;
       draw.count = cmd.ElemCount;
-      draw.index_offset = cmd.IdxOffset;
+      draw.index_offset = list_index_offset + int(cmd.IdxOffset);
+      draw.base_vertex = list_base_vertex + int(cmd.VtxOffset);
       draw.texture = reinterpret_cast<ImmediateTexture*>(cmd.TextureId);
       draw.scissor = true;
       draw.scissor_left = cmd.ClipRect.x;
       draw.scissor_top = cmd.ClipRect.y;
       draw.scissor_right = cmd.ClipRect.z;
       draw.scissor_bottom = cmd.ClipRect.w;
-      immediate_drawer_->Draw(draw);
+
+      // Dear ImGui splits the commands when the state changes, but adjacent
+      // commands with the same state, such as after restoring the clip rect,
+      // can still be drawn together.
+      if (batch.draw_count) {
+        ImmediateDraw& last_draw = frame.draws.back();
+        if (last_draw.texture == draw.texture &&
+            last_draw.base_vertex == draw.base_vertex &&
+            last_draw.index_offset + last_draw.count == draw.index_offset &&
+            last_draw.scissor_left == draw.scissor_left &&
+            last_draw.scissor_top == draw.scissor_top &&
+            last_draw.scissor_right == draw.scissor_right &&
+            last_draw.scissor_bottom == draw.scissor_bottom) {
+          last_draw.count += draw.count;
+          continue;
+        }
+      }
+      frame.draws.push_back(draw);
+      ++batch.draw_count;
+    }
+  }
+
+  immediate_drawer_->Begin(ui_draw_context, frame.display_width,
+                           frame.display_height);
+
+  for (const FrameBatch& frame_batch : frame.batches) {
+    if (!frame_batch.draw_count) {
+      continue;
+    }
+
+    ImmediateDrawBatch batch;
+    batch.vertices = frame.vertices.data() + frame_batch.vertex_offset;
+    batch.vertex_count = int(frame_batch.vertex_count);
+    batch.indices = frame.indices.data() + frame_batch.index_offset;
+    batch.index_count = int(frame_batch.index_count);
+    immediate_drawer_->BeginDrawBatch(batch);
+
+    for (size_t j = 0; j < frame_batch.draw_count; ++j) {
+      immediate_drawer_->Draw(frame.draws[frame_batch.draw_offset + j]);
     }
 
     immediate_drawer_->EndDrawBatch();
   }
 
   immediate_drawer_->End();
+
+  return frame == previous_frame_geometry_;
 }
 
 ImGuiIO& ImGuiDrawer::GetIO() {
@@ -582,6 +738,7 @@ void ImGuiDrawer::OnKeyChar(KeyEvent& e) {
   if (character > 0 && character < 0x10000) {
     io.AddInputCharacter(character);
     e.set_handled(true);
+    RequestPaintIfActive();
   }
 }
 
@@ -721,6 +878,7 @@ void ImGuiDrawer::OnKey(KeyEvent& e, bool is_down) {
     default:
       break;
   }
+  RequestPaintIfActive();
 }
 
 void ImGuiDrawer::UpdateMousePosition(float x, float y) {
@@ -729,6 +887,8 @@ void ImGuiDrawer::UpdateMousePosition(float x, float y) {
       float(window_->GetMediumDpi()) / float(window_->GetDpi());
   io.MousePos.x = x * physical_to_logical;
   io.MousePos.y = y * physical_to_logical;
+  // All mouse and touch events update the position.
+  RequestPaintIfActive();
 }
 
 void ImGuiDrawer::SwitchToPhysicalMouseAndUpdateMousePosition(
@@ -76,7 +76,8 @@ class ImGuiDrawer : public WindowInputListener, public UIDrawer {
   void OnMouseUp(MouseEvent& e) override;
   void OnMouseWheel(MouseEvent& e) override;
   void OnTouchEvent(TouchEvent& e) override;
-  // For now, no need for OnDpiChanged because redrawing is done continuously.
+  // For now, no need for OnDpiChanged because redrawing is done continuously
+  // unless the dialogs are idle, and the DPI change results in a repaint.
 
  private:
   void Initialize();
@@ -88,7 +89,14 @@ class ImGuiDrawer : public WindowInputListener, public UIDrawer {
   void SetupNotificationTextures();
   void SetupFontTexture();
 
-  void RenderDrawLists(ImDrawData* data, UIDrawContext& ui_draw_context);
+  // Returns whether the frame is the same as the previous one.
+  bool RenderDrawLists(ImDrawData* data, UIDrawContext& ui_draw_context);
+  // Whether there's nothing that may change the result without any input, so
+  // continuous repainting can be paused.
+  bool IsIdle() const;
+  // For the input and the changes of the dialog list, which may break being
+  // idle.
+  void RequestPaintIfActive();
 
   void ClearInput();
   void OnKey(KeyEvent& e, bool is_down);
@@ -135,6 +143,36 @@ class ImGuiDrawer : public WindowInputListener, public UIDrawer {
   // anything.
   bool reset_mouse_position_after_next_frame_ = false;
 
+  // Geometry of all the draw lists of a frame merged into as few immediate
+  // drawer batches and draws as possible, kept between frames to avoid
+  // reallocating it and to detect unchanged frames.
+  struct FrameBatch {
+    size_t vertex_offset;
+    size_t vertex_count;
+    size_t index_offset;
+    size_t index_count;
+    size_t draw_offset;
+    size_t draw_count;
+  };
+  struct FrameGeometry {
+    float display_width = 0.0f;
+    float display_height = 0.0f;
+    std::vector<ImmediateVertex> vertices;
+    std::vector<uint16_t> indices;
+    std::vector<ImmediateDraw> draws;
+    std::vector<FrameBatch> batches;
+
+    void Clear() {
+      vertices.clear();
+      indices.clear();
+      draws.clear();
+      batches.clear();
+    }
+    bool operator==(const FrameGeometry& other) const;
+  };
+  FrameGeometry frame_geometry_;
+  FrameGeometry previous_frame_geometry_;
+
   double frame_time_tick_frequency_;
   uint64_t last_frame_time_ticks_;
 };
@@ -16,6 +16,7 @@
 #include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/platform.h"
+#include "xenia/base/startup_timeline.h"
 #include "xenia/ui/window.h"
 
 #if XE_PLATFORM_WIN32
@@ -47,6 +48,15 @@ DEFINE_bool(
     "the letterbox area.",
     "Display");
 
+DEFINE_int32(
+    present_max_frame_latency, 0,
+    "Maximum number of frames that may be queued for presentation on the host "
+    "GPU before painting a new one waits for the oldest to be displayed. Lower "
+    "values reduce the input latency at the cost of possible stuttering if the "
+    "GPU can't keep up. 0 to use the default queue depth of the graphics "
+    "backend.",
+    "Display");
+
 DEFINE_bool(
     present_letterbox, true,
     "Maintain aspect ratio when stretching by displaying bars around the image "
@@ -373,6 +383,9 @@ bool Presenter::RefreshGuestOutput(
       // output either though because the failure may be something transient.
       return false;
     }
+    if (!guest_output_active_last_refresh_) {
+      StartupTimeline::MarkFirstGuestFrame();
+    }
     guest_output_active_last_refresh_ = true;
   } else {
     // Request presenting a blank image if there was a true image previously,
@@ -45,6 +45,7 @@
 
 // For implementation use.
 DECLARE_bool(present_render_pass_clear);
+DECLARE_int32(present_max_frame_latency);
 
 namespace xe {
 namespace ui {
@@ -435,6 +436,12 @@ class Presenter {
   static constexpr size_t kMaxGuestOutputPaintEffects =
       GuestOutputPaintConfig::kFsrMaxUpscalingPassesMax + 2;
 
+  // How many paints an intermediate texture that is not needed by the effect
+  // chain anymore is kept for, so it can be reused without reallocation if the
+  // chain becomes longer again with the same sizes (for instance, if the guest
+  // briefly switches the frontbuffer size, or the effects are being tweaked).
+  static constexpr uint64_t kGuestOutputIntermediateRetentionPaintCount = 120;
+
   struct GuestOutputPaintFlow {
     // Letterbox on up to 4 sides.
     static constexpr size_t kMaxClearRectangles = 4;
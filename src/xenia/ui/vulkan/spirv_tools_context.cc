@@ -79,6 +79,20 @@ bool SpirvToolsContext::Initialize(unsigned int spirv_version) {
     Shutdown();
     return false;
   }
+  target_env_ = target_env;
+  // The optimizer is optional, not available in old versions of the library.
+  if (!LoadLibraryFunction(fn_spvBinaryDestroy_, "spvBinaryDestroy") ||
+      !LoadLibraryFunction(fn_spvOptimizerCreate_, "spvOptimizerCreate") ||
+      !LoadLibraryFunction(fn_spvOptimizerDestroy_, "spvOptimizerDestroy") ||
+      !LoadLibraryFunction(fn_spvOptimizerRegisterPerformancePasses_,
+                           "spvOptimizerRegisterPerformancePasses") ||
+      !LoadLibraryFunction(fn_spvOptimizerOptionsCreate_,
+                           "spvOptimizerOptionsCreate") ||
+      !LoadLibraryFunction(fn_spvOptimizerOptionsDestroy_,
+                           "spvOptimizerOptionsDestroy") ||
+      !LoadLibraryFunction(fn_spvOptimizerRun_, "spvOptimizerRun")) {
+    fn_spvOptimizerRun_ = nullptr;
+  }
   return true;
 }
 
@@ -95,6 +109,7 @@ void SpirvToolsContext::Shutdown() {
 #endif
     library_ = nullptr;
   }
+  fn_spvOptimizerRun_ = nullptr;
 }
 
 spv_result_t SpirvToolsContext::Validate(const uint32_t* words,
@@ -118,6 +133,35 @@ spv_result_t SpirvToolsContext::Validate(const uint32_t* words,
   return result;
 }
 
+spv_result_t SpirvToolsContext::Optimize(
+    const uint32_t* words, size_t num_words,
+    std::vector<uint32_t>& optimized_out) const {
+  optimized_out.clear();
+  if (!context_ || !IsOptimizerAvailable()) {
+    return SPV_UNSUPPORTED;
+  }
+  spv_optimizer_t* optimizer = fn_spvOptimizerCreate_(target_env_);
+  if (!optimizer) {
+    return SPV_ERROR_OUT_OF_MEMORY;
+  }
+  fn_spvOptimizerRegisterPerformancePasses_(optimizer);
+  spv_optimizer_options options = fn_spvOptimizerOptionsCreate_();
+  spv_binary optimized_binary = nullptr;
+  spv_result_t result = fn_spvOptimizerRun_(optimizer, words, num_words,
+                                            &optimized_binary, options);
+  if (optimized_binary) {
+    if (result == SPV_SUCCESS) {
+      optimized_out.assign(
+          optimized_binary->code,
+          optimized_binary->code + optimized_binary->wordCount);
+    }
+    fn_spvBinaryDestroy_(optimized_binary);
+  }
+  fn_spvOptimizerOptionsDestroy_(options);
+  fn_spvOptimizerDestroy_(optimizer);
+  return result;
+}
+
 }  // namespace vulkan
 }  // namespace ui
 }  // namespace xe
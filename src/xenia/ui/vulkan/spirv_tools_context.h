@@ -12,6 +12,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "third_party/SPIRV-Tools/include/spirv-tools/libspirv.h"
 #include "xenia/base/platform.h"
@@ -38,6 +39,12 @@ class SpirvToolsContext {
   spv_result_t Validate(const uint32_t* words, size_t num_words,
                         std::string* error) const;
 
+  // Whether the library provides the optimizer, which is optional.
+  bool IsOptimizerAvailable() const { return fn_spvOptimizerRun_ != nullptr; }
+  // Runs the performance passes (like spirv-opt -O).
+  spv_result_t Optimize(const uint32_t* words, size_t num_words,
+                        std::vector<uint32_t>& optimized_out) const;
+
  private:
 #if XE_PLATFORM_LINUX
   void* library_ = nullptr;
@@ -61,7 +68,17 @@ class SpirvToolsContext {
   decltype(&spvContextDestroy) fn_spvContextDestroy_ = nullptr;
   decltype(&spvValidateBinary) fn_spvValidateBinary_ = nullptr;
   decltype(&spvDiagnosticDestroy) fn_spvDiagnosticDestroy_ = nullptr;
+  decltype(&spvBinaryDestroy) fn_spvBinaryDestroy_ = nullptr;
+  decltype(&spvOptimizerCreate) fn_spvOptimizerCreate_ = nullptr;
+  decltype(&spvOptimizerDestroy) fn_spvOptimizerDestroy_ = nullptr;
+  decltype(&spvOptimizerRegisterPerformancePasses)
+      fn_spvOptimizerRegisterPerformancePasses_ = nullptr;
+  decltype(&spvOptimizerOptionsCreate) fn_spvOptimizerOptionsCreate_ = nullptr;
+  decltype(&spvOptimizerOptionsDestroy) fn_spvOptimizerOptionsDestroy_ =
+      nullptr;
+  decltype(&spvOptimizerRun) fn_spvOptimizerRun_ = nullptr;
 
+  spv_target_env target_env_ = SPV_ENV_VULKAN_1_0;
   spv_context context_ = nullptr;
 };
 
@@ -1364,6 +1364,18 @@ Presenter::PaintResult VulkanPresenter::PaintAndPresentImpl(
     paint_context_.submission_tracker.AwaitSubmissionCompletion(
         current_paint_submission_index - paint_submission_count);
   }
+  // With a limited frame latency, also don't let the paint submissions (which
+  // are immediately followed by presentation on the same queue) get too far
+  // ahead of the GPU, so the frame is painted from the most up-to-date state.
+  if (cvars::present_max_frame_latency > 0) {
+    uint64_t max_frame_latency =
+        std::min(uint64_t(cvars::present_max_frame_latency),
+                 paint_submission_count);
+    if (current_paint_submission_index >= max_frame_latency) {
+      paint_context_.submission_tracker.AwaitSubmissionCompletion(
+          current_paint_submission_index - max_frame_latency);
+    }
+  }
   const PaintContext::Submission& paint_submission =
       *paint_context_.submissions[current_paint_submission_index %
                                   paint_submission_count];
@@ -1569,11 +1581,13 @@ Presenter::PaintResult VulkanPresenter::PaintAndPresentImpl(
       }
 
       // Make sure intermediate textures of the needed size are available, and
-      // unneeded intermediate textures are destroyed.
+      // intermediate textures unneeded for a long time are destroyed.
       for (size_t i = 0; i < kMaxGuestOutputPaintEffects - 1; ++i) {
         std::pair<uint32_t, uint32_t> intermediate_needed_size(0, 0);
         if (i + 1 < guest_output_flow.effect_count) {
           intermediate_needed_size = guest_output_flow.effect_output_sizes[i];
+          paint_context_.guest_output_intermediate_image_last_needed[i] =
+              current_paint_submission_index;
         }
         std::unique_ptr<GuestOutputImage>& intermediate_image_ptr_ref =
             paint_context_.guest_output_intermediate_images[i];
@@ -1666,8 +1680,13 @@ Presenter::PaintResult VulkanPresenter::PaintAndPresentImpl(
             dfn.vkUpdateDescriptorSets(
                 device, 1, &intermediate_descriptor_write, 0, nullptr);
           } else {
-            // Was previously needed, but not anymore - destroy when possible.
+            // Was previously needed, but not anymore - keep for some time in
+            // case it's needed again, then destroy when possible.
             if (intermediate_image_ptr_ref &&
+                current_paint_submission_index -
+                        paint_context_
+                            .guest_output_intermediate_image_last_needed[i] >=
+                    kGuestOutputIntermediateRetentionPaintCount &&
                 paint_context_.submission_tracker
                         .UpdateAndGetCompletedSubmission() >=
                     paint_context_
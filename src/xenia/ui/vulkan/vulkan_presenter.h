@@ -437,6 +437,10 @@ class VulkanPresenter final : public Presenter {
     std::array<VkFramebuffer, kMaxGuestOutputPaintEffects - 1>
         guest_output_intermediate_framebuffers = {};
     uint64_t guest_output_intermediate_image_last_submission = 0;
+    // Paint submission indices when each intermediate image was last needed by
+    // the effect chain, for delayed destruction of unneeded images.
+    std::array<uint64_t, kMaxGuestOutputPaintEffects - 1>
+        guest_output_intermediate_image_last_needed = {};
 
     // Command buffers optionally executed before the draw command buffer,
     // outside the painting render pass.
@@ -608,6 +608,39 @@ std::unique_ptr<ImmediateDrawer> VulkanProvider::CreateImmediateDrawer() {
   return VulkanImmediateDrawer::Create(*this);
 }
 
+bool VulkanProvider::QueryVideoMemoryBudget(uint64_t& usage_out,
+                                            uint64_t& budget_out) const {
+  if (!instance_extensions_.khr_get_physical_device_properties2 ||
+      !device_info_.ext_VK_EXT_memory_budget) {
+    return false;
+  }
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT memory_budget_properties = {};
+  memory_budget_properties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+  VkPhysicalDeviceMemoryProperties2 memory_properties = {};
+  memory_properties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+  memory_properties.pNext = &memory_budget_properties;
+  ifn_.vkGetPhysicalDeviceMemoryProperties2(physical_device_,
+                                            &memory_properties);
+  uint64_t usage = 0;
+  uint64_t budget = 0;
+  for (uint32_t i = 0; i < memory_properties.memoryProperties.memoryHeapCount;
+       ++i) {
+    if (memory_properties.memoryProperties.memoryHeaps[i].flags &
+        VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      usage += memory_budget_properties.heapUsage[i];
+      budget += memory_budget_properties.heapBudget[i];
+    }
+  }
+  if (!budget) {
+    return false;
+  }
+  usage_out = usage;
+  budget_out = budget;
+  return true;
+}
+
 void VulkanProvider::AccumulateInstanceExtensions(
     size_t properties_count, const VkExtensionProperties* properties,
     bool request_debug_utils, InstanceExtensions& instance_extensions,
@@ -744,6 +777,8 @@ void VulkanProvider::TryCreateDevice() {
   }
 
   device_info_.apiVersion = properties.apiVersion;
+  device_info_.vendorID = properties.vendorID;
+  device_info_.deviceID = properties.deviceID;
 
   XELOGVK("Device Vulkan API version: {}.{}.{}",
           VK_API_VERSION_MAJOR(properties.apiVersion),
@@ -792,6 +827,7 @@ void VulkanProvider::TryCreateDevice() {
     device_info_.ext_1_2_VK_KHR_image_format_list = true;
     device_info_.ext_1_2_VK_KHR_shader_float_controls = true;
     device_info_.ext_1_2_VK_KHR_spirv_1_4 = true;
+    device_info_.ext_1_2_VK_KHR_timeline_semaphore = true;
   }
   if (properties.apiVersion >= VK_MAKE_API_VERSION(0, 1, 3, 0)) {
     device_info_.ext_1_3_VK_EXT_shader_demote_to_helper_invocation = true;
@@ -821,7 +857,12 @@ void VulkanProvider::TryCreateDevice() {
       EXTENSION(VK_KHR_portability_subset)
       EXTENSION(VK_EXT_memory_budget)
       EXTENSION(VK_EXT_fragment_shader_interlock)
+      EXTENSION(VK_KHR_pipeline_library)
+      EXTENSION(VK_EXT_graphics_pipeline_library)
       EXTENSION(VK_EXT_non_seamless_cube_map)
+      if (properties.apiVersion >= VK_MAKE_API_VERSION(0, 1, 1, 0)) {
+        EXTENSION(VK_EXT_external_memory_host)
+      }
     } else {
       if (!std::strcmp(extension.extensionName, "VK_KHR_portability_subset")) {
         XELOGW(
@@ -845,6 +886,7 @@ void VulkanProvider::TryCreateDevice() {
       EXTENSION_PROMOTED(VK_KHR_image_format_list, 2)
       if (instance_extensions_.khr_get_physical_device_properties2) {
         EXTENSION_PROMOTED(VK_KHR_shader_float_controls, 2)
+        EXTENSION_PROMOTED(VK_KHR_timeline_semaphore, 2)
       }
       if (properties.apiVersion >= VK_MAKE_API_VERSION(0, 1, 1, 0)) {
         EXTENSION_PROMOTED(VK_KHR_spirv_1_4, 2)
@@ -922,6 +964,8 @@ void VulkanProvider::TryCreateDevice() {
   LIMIT_SAMPLE_COUNTS(sampledImageIntegerSampleCounts)
   LIMIT_SAMPLE_COUNTS(sampledImageDepthSampleCounts)
   LIMIT_SAMPLE_COUNTS(sampledImageStencilSampleCounts)
+  LIMIT(timestampComputeAndGraphics)
+  LIMIT(timestampPeriod)
   LIMIT(standardSampleLocations)
   LIMIT(optimalBufferCopyOffsetAlignment)
   LIMIT(optimalBufferCopyRowPitchAlignment)
@@ -950,6 +994,7 @@ void VulkanProvider::TryCreateDevice() {
   FEATURE(depthClamp)
   FEATURE(fillModeNonSolid)
   FEATURE(samplerAnisotropy)
+  FEATURE(occlusionQueryPrecise)
   FEATURE(vertexPipelineStoresAndAtomics)
   FEATURE(fragmentStoresAndAtomics)
   FEATURE(shaderClipDistance)
@@ -1009,10 +1054,19 @@ void VulkanProvider::TryCreateDevice() {
   if (device_info_.ext_VK_KHR_portability_subset) {
     FEATURES2_ADD(PortabilitySubsetFeaturesKHR)
   }
+  PROPERTIES2_DECLARE(ExternalMemoryHostPropertiesEXT,
+                      EXTERNAL_MEMORY_HOST_PROPERTIES_EXT)
+  if (device_info_.ext_VK_EXT_external_memory_host) {
+    PROPERTIES2_ADD(ExternalMemoryHostPropertiesEXT)
+  }
   PROPERTIES2_DECLARE(FloatControlsProperties, FLOAT_CONTROLS_PROPERTIES)
   if (device_info_.ext_1_2_VK_KHR_shader_float_controls) {
     PROPERTIES2_ADD(FloatControlsProperties)
   }
+  FEATURES2_DECLARE(TimelineSemaphoreFeatures, TIMELINE_SEMAPHORE_FEATURES)
+  if (device_info_.ext_1_2_VK_KHR_timeline_semaphore) {
+    FEATURES2_ADD_PROMOTED(TimelineSemaphoreFeatures, 2)
+  }
   FEATURES2_DECLARE(FragmentShaderInterlockFeaturesEXT,
                     FRAGMENT_SHADER_INTERLOCK_FEATURES_EXT)
   if (device_info_.ext_VK_EXT_fragment_shader_interlock) {
@@ -1023,6 +1077,14 @@ void VulkanProvider::TryCreateDevice() {
   if (device_info_.ext_1_3_VK_EXT_shader_demote_to_helper_invocation) {
     FEATURES2_ADD_PROMOTED(ShaderDemoteToHelperInvocationFeatures, 3)
   }
+  FEATURES2_DECLARE(GraphicsPipelineLibraryFeaturesEXT,
+                    GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT)
+  PROPERTIES2_DECLARE(GraphicsPipelineLibraryPropertiesEXT,
+                      GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT)
+  if (device_info_.ext_VK_EXT_graphics_pipeline_library) {
+    FEATURES2_ADD(GraphicsPipelineLibraryFeaturesEXT)
+    PROPERTIES2_ADD(GraphicsPipelineLibraryPropertiesEXT)
+  }
   FEATURES2_DECLARE(NonSeamlessCubeMapFeaturesEXT,
                     NON_SEAMLESS_CUBE_MAP_FEATURES_EXT)
   if (device_info_.ext_VK_EXT_non_seamless_cube_map) {
@@ -1097,6 +1159,15 @@ void VulkanProvider::TryCreateDevice() {
     }
   }
 
+  if (properties.apiVersion >= VK_MAKE_API_VERSION(0, 1, 3, 0)) {
+    EXTENSION_FEATURE_PROMOTED_AS_OPTIONAL(dynamicRendering, 3)
+  }
+
+  if (device_info_.ext_VK_EXT_external_memory_host) {
+    EXTENSION_PROPERTY(ExternalMemoryHostPropertiesEXT,
+                       minImportedHostPointerAlignment)
+  }
+
   if (device_info_.ext_1_2_VK_KHR_shader_float_controls) {
     EXTENSION_PROPERTY(FloatControlsProperties,
                        shaderSignedZeroInfNanPreserveFloat32)
@@ -1104,6 +1175,10 @@ void VulkanProvider::TryCreateDevice() {
     EXTENSION_PROPERTY(FloatControlsProperties, shaderRoundingModeRTEFloat32)
   }
 
+  if (device_info_.ext_1_2_VK_KHR_timeline_semaphore) {
+    EXTENSION_FEATURE_PROMOTED(TimelineSemaphoreFeatures, timelineSemaphore, 2)
+  }
+
   if (device_info_.ext_VK_EXT_fragment_shader_interlock) {
     EXTENSION_FEATURE(FragmentShaderInterlockFeaturesEXT,
                       fragmentShaderSampleInterlock)
@@ -1121,6 +1196,15 @@ void VulkanProvider::TryCreateDevice() {
                                shaderDemoteToHelperInvocation, 3)
   }
 
+  // VK_EXT_graphics_pipeline_library requires VK_KHR_pipeline_library.
+  if (device_info_.ext_VK_EXT_graphics_pipeline_library &&
+      device_info_.ext_VK_KHR_pipeline_library) {
+    EXTENSION_FEATURE(GraphicsPipelineLibraryFeaturesEXT,
+                      graphicsPipelineLibrary)
+    EXTENSION_PROPERTY(GraphicsPipelineLibraryPropertiesEXT,
+                       graphicsPipelineLibraryFastLinking)
+  }
+
   if (device_info_.ext_VK_EXT_non_seamless_cube_map) {
     EXTENSION_FEATURE(NonSeamlessCubeMapFeaturesEXT, nonSeamlessCubeMap)
   }
@@ -1338,8 +1422,16 @@ void VulkanProvider::TryCreateDevice() {
 #include "xenia/ui/vulkan/functions/device_khr_bind_memory2.inc"
 #include "xenia/ui/vulkan/functions/device_khr_get_memory_requirements2.inc"
   }
+  if (properties.apiVersion >= VK_MAKE_API_VERSION(0, 1, 2, 0)) {
+    if (device_info_.timelineSemaphore) {
+#include "xenia/ui/vulkan/functions/device_khr_timeline_semaphore.inc"
+    }
+  }
   if (properties.apiVersion >= VK_MAKE_API_VERSION(0, 1, 3, 0)) {
 #include "xenia/ui/vulkan/functions/device_khr_maintenance4.inc"
+    if (device_info_.dynamicRendering) {
+#include "xenia/ui/vulkan/functions/device_khr_dynamic_rendering.inc"
+    }
   }
 #undef XE_UI_VULKAN_FUNCTION_PROMOTED
 
@@ -1351,6 +1443,9 @@ void VulkanProvider::TryCreateDevice() {
            ifn_.vkGetDeviceProcAddr(device_, #extension_name))) != nullptr;
   if (device_info_.ext_VK_KHR_swapchain) {
 #include "xenia/ui/vulkan/functions/device_khr_swapchain.inc"
+  }
+  if (device_info_.ext_VK_EXT_external_memory_host) {
+#include "xenia/ui/vulkan/functions/device_ext_external_memory_host.inc"
   }
   if (properties.apiVersion < VK_MAKE_API_VERSION(0, 1, 1, 0)) {
     if (device_info_.ext_1_1_VK_KHR_get_memory_requirements2) {
@@ -1360,6 +1455,11 @@ void VulkanProvider::TryCreateDevice() {
 #include "xenia/ui/vulkan/functions/device_khr_bind_memory2.inc"
     }
   }
+  if (properties.apiVersion < VK_MAKE_API_VERSION(0, 1, 2, 0)) {
+    if (device_info_.timelineSemaphore) {
+#include "xenia/ui/vulkan/functions/device_khr_timeline_semaphore.inc"
+    }
+  }
   if (properties.apiVersion < VK_MAKE_API_VERSION(0, 1, 3, 0)) {
     if (device_info_.ext_1_3_VK_KHR_maintenance4) {
 #include "xenia/ui/vulkan/functions/device_khr_maintenance4.inc"
@@ -73,6 +73,8 @@ class VulkanProvider : public GraphicsProvider {
     uint32_t memory_types_host_cached;
 
     uint32_t apiVersion;
+    uint32_t vendorID;
+    uint32_t deviceID;
     uint32_t maxImageDimension2D;
     uint32_t maxImageDimension3D;
     uint32_t maxImageDimensionCube;
@@ -105,6 +107,8 @@ class VulkanProvider : public GraphicsProvider {
     VkSampleCountFlags sampledImageIntegerSampleCounts;
     VkSampleCountFlags sampledImageDepthSampleCounts;
     VkSampleCountFlags sampledImageStencilSampleCounts;
+    bool timestampComputeAndGraphics;
+    float timestampPeriod;
     VkSampleCountFlags standardSampleLocations;
     VkDeviceSize optimalBufferCopyOffsetAlignment;
     VkDeviceSize optimalBufferCopyRowPitchAlignment;
@@ -118,6 +122,7 @@ class VulkanProvider : public GraphicsProvider {
     bool depthClamp;
     bool fillModeNonSolid;
     bool samplerAnisotropy;
+    bool occlusionQueryPrecise;
     bool vertexPipelineStoresAndAtomics;
     bool fragmentStoresAndAtomics;
     bool shaderClipDistance;
@@ -135,6 +140,11 @@ class VulkanProvider : public GraphicsProvider {
 
     bool samplerMirrorClampToEdge;
 
+    // VK_KHR_dynamic_rendering (#45, Vulkan 1.3), only used as a Vulkan 1.3
+    // feature (as an extension, it requires more render pass extensions).
+
+    bool dynamicRendering;
+
     // VK_KHR_dedicated_allocation (#128, Vulkan 1.1).
 
     bool ext_1_1_VK_KHR_dedicated_allocation;
@@ -171,6 +181,13 @@ class VulkanProvider : public GraphicsProvider {
     bool shaderSampleRateInterpolationFunctions;
     bool triangleFans;
 
+    // VK_EXT_external_memory_host (#179), only used on Vulkan 1.1 where
+    // VK_KHR_external_memory it depends on is core.
+
+    bool ext_VK_EXT_external_memory_host;
+
+    VkDeviceSize minImportedHostPointerAlignment;
+
     // VK_KHR_shader_float_controls (#198, Vulkan 1.2).
 
     bool ext_1_2_VK_KHR_shader_float_controls;
@@ -179,6 +196,12 @@ class VulkanProvider : public GraphicsProvider {
     bool shaderDenormFlushToZeroFloat32;
     bool shaderRoundingModeRTEFloat32;
 
+    // VK_KHR_timeline_semaphore (#208, Vulkan 1.2).
+
+    bool ext_1_2_VK_KHR_timeline_semaphore;
+
+    bool timelineSemaphore;
+
     // VK_KHR_spirv_1_4 (#237, Vulkan 1.2).
 
     bool ext_1_2_VK_KHR_spirv_1_4;
@@ -200,6 +223,17 @@ class VulkanProvider : public GraphicsProvider {
 
     bool shaderDemoteToHelperInvocation;
 
+    // VK_KHR_pipeline_library (#291).
+
+    bool ext_VK_KHR_pipeline_library;
+
+    // VK_EXT_graphics_pipeline_library (#321).
+
+    bool ext_VK_EXT_graphics_pipeline_library;
+
+    bool graphicsPipelineLibrary;
+    bool graphicsPipelineLibraryFastLinking;
+
     // VK_KHR_maintenance4 (#414, Vulkan 1.3).
 
     bool ext_1_3_VK_KHR_maintenance4;
@@ -327,10 +361,13 @@ class VulkanProvider : public GraphicsProvider {
 #define XE_UI_VULKAN_FUNCTION_PROMOTED(extension_name, core_name) \
   PFN_##core_name core_name;
 #include "xenia/ui/vulkan/functions/device_1_0.inc"
+#include "xenia/ui/vulkan/functions/device_ext_external_memory_host.inc"
 #include "xenia/ui/vulkan/functions/device_khr_bind_memory2.inc"
+#include "xenia/ui/vulkan/functions/device_khr_dynamic_rendering.inc"
 #include "xenia/ui/vulkan/functions/device_khr_get_memory_requirements2.inc"
 #include "xenia/ui/vulkan/functions/device_khr_maintenance4.inc"
 #include "xenia/ui/vulkan/functions/device_khr_swapchain.inc"
+#include "xenia/ui/vulkan/functions/device_khr_timeline_semaphore.inc"
 #undef XE_UI_VULKAN_FUNCTION_PROMOTED
 #undef XE_UI_VULKAN_FUNCTION
   };
@@ -367,6 +404,10 @@ class VulkanProvider : public GraphicsProvider {
     return host_samplers_[size_t(sampler)];
   }
 
+  // Summed over the device-local memory heaps, requires VK_EXT_memory_budget.
+  bool QueryVideoMemoryBudget(uint64_t& usage_out,
+                              uint64_t& budget_out) const override;
+
  private:
   explicit VulkanProvider(bool is_surface_required)
       : is_surface_required_(is_surface_required) {}
@@ -75,6 +75,10 @@ VulkanUploadBufferPool::CreatePageImplementation() {
   const VulkanProvider::DeviceFunctions& dfn = provider_.dfn();
   VkDevice device = provider_.device();
 
+  // The size may have been increased when growing the ring.
+  page_size_ =
+      size_t(util::GetMappableMemorySize(provider_, VkDeviceSize(page_size_)));
+
   VkBufferCreateInfo buffer_create_info;
   buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   buffer_create_info.pNext = nullptr;
@@ -91,9 +95,10 @@ VulkanUploadBufferPool::CreatePageImplementation() {
     return nullptr;
   }
 
+  VkMemoryRequirements memory_requirements;
+  dfn.vkGetBufferMemoryRequirements(device, buffer, &memory_requirements);
+  VkDeviceSize allocation_size = memory_requirements.size;
   if (memory_type_ == kMemoryTypeUnknown) {
-    VkMemoryRequirements memory_requirements;
-    dfn.vkGetBufferMemoryRequirements(device, buffer, &memory_requirements);
     memory_type_ = util::ChooseHostMemoryType(
         provider_, memory_requirements.memoryTypeBits, false);
     if (memory_type_ == UINT32_MAX) {
@@ -105,11 +110,10 @@ VulkanUploadBufferPool::CreatePageImplementation() {
       dfn.vkDestroyBuffer(device, buffer, nullptr);
       return nullptr;
     }
-    allocation_size_ = memory_requirements.size;
-    if (allocation_size_ > page_size_) {
+    if (allocation_size > page_size_) {
       // Try to occupy the allocation padding. If that's going to require even
       // more memory for some reason, don't.
-      buffer_create_info.size = allocation_size_;
+      buffer_create_info.size = allocation_size;
       VkBuffer buffer_expanded;
       if (dfn.vkCreateBuffer(device, &buffer_create_info, nullptr,
                              &buffer_expanded) == VK_SUCCESS) {
@@ -118,10 +122,10 @@ VulkanUploadBufferPool::CreatePageImplementation() {
                                           &memory_requirements_expanded);
         uint32_t memory_type_expanded = util::ChooseHostMemoryType(
             provider_, memory_requirements.memoryTypeBits, false);
-        if (memory_requirements_expanded.size <= allocation_size_ &&
+        if (memory_requirements_expanded.size <= allocation_size &&
             memory_type_expanded != UINT32_MAX) {
-          page_size_ = size_t(allocation_size_);
-          allocation_size_ = memory_requirements_expanded.size;
+          page_size_ = size_t(allocation_size);
+          allocation_size = memory_requirements_expanded.size;
           memory_type_ = memory_type_expanded;
           dfn.vkDestroyBuffer(device, buffer, nullptr);
           buffer = buffer_expanded;
@@ -136,7 +140,7 @@ VulkanUploadBufferPool::CreatePageImplementation() {
   VkMemoryAllocateInfo* memory_allocate_info_last = &memory_allocate_info;
   memory_allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
   memory_allocate_info.pNext = nullptr;
-  memory_allocate_info.allocationSize = allocation_size_;
+  memory_allocate_info.allocationSize = allocation_size;
   memory_allocate_info.memoryTypeIndex = memory_type_;
   VkMemoryDedicatedAllocateInfo memory_dedicated_allocate_info;
   if (provider_.device_info().ext_1_1_VK_KHR_dedicated_allocation) {
@@ -153,7 +157,7 @@ VulkanUploadBufferPool::CreatePageImplementation() {
   if (dfn.vkAllocateMemory(device, &memory_allocate_info, nullptr, &memory) !=
       VK_SUCCESS) {
     XELOGE("Failed to allocate {} bytes of Vulkan upload buffer memory",
-           allocation_size_);
+           allocation_size);
     dfn.vkDestroyBuffer(device, buffer, nullptr);
     return nullptr;
   }
@@ -170,20 +174,21 @@ VulkanUploadBufferPool::CreatePageImplementation() {
   if (dfn.vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapping) !=
       VK_SUCCESS) {
     XELOGE("Failed to map {} bytes of Vulkan upload buffer memory",
-           allocation_size_);
+           allocation_size);
     dfn.vkDestroyBuffer(device, buffer, nullptr);
     dfn.vkFreeMemory(device, memory, nullptr);
     return nullptr;
   }
 
-  return new VulkanPage(provider_, buffer, memory, mapping);
+  return new VulkanPage(provider_, buffer, memory, mapping, allocation_size);
 }
 
 void VulkanUploadBufferPool::FlushPageWrites(Page* page, size_t offset,
                                              size_t size) {
+  auto vulkan_page = static_cast<const VulkanPage*>(page);
   util::FlushMappedMemoryRange(
-      provider_, static_cast<const VulkanPage*>(page)->memory_, memory_type_,
-      VkDeviceSize(offset), allocation_size_, VkDeviceSize(size));
+      provider_, vulkan_page->memory_, memory_type_, VkDeviceSize(offset),
+      vulkan_page->allocation_size_, VkDeviceSize(size));
 }
 
 VulkanUploadBufferPool::VulkanPage::~VulkanPage() {
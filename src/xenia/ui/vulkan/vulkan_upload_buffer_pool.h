@@ -38,21 +38,22 @@ class VulkanUploadBufferPool : public GraphicsUploadBufferPool {
   struct VulkanPage : public Page {
     // Takes ownership of the buffer and its memory and mapping.
     VulkanPage(const VulkanProvider& provider, VkBuffer buffer,
-               VkDeviceMemory memory, void* mapping)
+               VkDeviceMemory memory, void* mapping,
+               VkDeviceSize allocation_size)
         : provider_(provider),
           buffer_(buffer),
           memory_(memory),
-          mapping_(mapping) {}
+          mapping_(mapping),
+          allocation_size_(allocation_size) {}
     ~VulkanPage() override;
     const VulkanProvider& provider_;
     VkBuffer buffer_;
     VkDeviceMemory memory_;
     void* mapping_;
+    VkDeviceSize allocation_size_;
   };
 
   const VulkanProvider& provider_;
-
-  VkDeviceSize allocation_size_;
   static constexpr uint32_t kMemoryTypeUnknown = UINT32_MAX;
   static constexpr uint32_t kMemoryTypeUnavailable = kMemoryTypeUnknown - 1;
   uint32_t memory_type_ = UINT32_MAX;
@@ -9,13 +9,70 @@
 
 #include "xenia/vfs/device.h"
 
+#include <algorithm>
+
+#include "xenia/base/clock.h"
 #include "xenia/base/logging.h"
+#include "xenia/base/math.h"
 
 namespace xe {
 namespace vfs {
 
-Device::Device(const std::string_view mount_path) : mount_path_(mount_path) {}
+Device::Device(const std::string_view mount_path)
+    : mount_path_(mount_path),
+      host_ticks_per_us_(
+          std::max(Clock::QueryHostTickFrequency() / 1000000, uint64_t(1))) {}
 Device::~Device() = default;
 
+void Device::RecordRead(size_t length, uint64_t host_ticks) {
+  read_count_.fetch_add(1, std::memory_order_relaxed);
+  read_bytes_.fetch_add(length, std::memory_order_relaxed);
+  read_host_ticks_.fetch_add(host_ticks, std::memory_order_relaxed);
+  uint64_t max_host_ticks =
+      read_max_host_ticks_.load(std::memory_order_relaxed);
+  while (host_ticks > max_host_ticks &&
+         !read_max_host_ticks_.compare_exchange_weak(
+             max_host_ticks, host_ticks, std::memory_order_relaxed)) {
+  }
+  uint64_t us = host_ticks / host_ticks_per_us_;
+  uint32_t bucket =
+      us ? std::min(uint32_t(xe::log2_floor(us)) + 1,
+                    DeviceStatistics::kLatencyBucketCount - 1)
+         : 0;
+  read_latency_buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Device::RecordWrite(size_t length, uint64_t host_ticks) {
+  write_count_.fetch_add(1, std::memory_order_relaxed);
+  write_bytes_.fetch_add(length, std::memory_order_relaxed);
+  write_host_ticks_.fetch_add(host_ticks, std::memory_order_relaxed);
+}
+
+void Device::RecordCacheAccess(bool is_hit) {
+  (is_hit ? cache_hit_count_ : cache_miss_count_)
+      .fetch_add(1, std::memory_order_relaxed);
+}
+
+void Device::GetStatistics(DeviceStatistics& statistics) const {
+  statistics.mount_path = mount_path_;
+  statistics.name = name();
+  statistics.read_count = read_count_.load(std::memory_order_relaxed);
+  statistics.read_bytes = read_bytes_.load(std::memory_order_relaxed);
+  statistics.read_host_ticks = read_host_ticks_.load(std::memory_order_relaxed);
+  statistics.read_max_host_ticks =
+      read_max_host_ticks_.load(std::memory_order_relaxed);
+  for (uint32_t i = 0; i < DeviceStatistics::kLatencyBucketCount; ++i) {
+    statistics.read_latency_buckets[i] =
+        read_latency_buckets_[i].load(std::memory_order_relaxed);
+  }
+  statistics.write_count = write_count_.load(std::memory_order_relaxed);
+  statistics.write_bytes = write_bytes_.load(std::memory_order_relaxed);
+  statistics.write_host_ticks =
+      write_host_ticks_.load(std::memory_order_relaxed);
+  statistics.cache_hit_count = cache_hit_count_.load(std::memory_order_relaxed);
+  statistics.cache_miss_count =
+      cache_miss_count_.load(std::memory_order_relaxed);
+}
+
 }  // namespace vfs
 }  // namespace xe
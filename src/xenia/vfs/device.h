@@ -10,6 +10,8 @@
 #ifndef XENIA_VFS_DEVICE_H_
 #define XENIA_VFS_DEVICE_H_
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
 
@@ -20,6 +22,28 @@
 namespace xe {
 namespace vfs {
 
+// Totals of the guest I/O through the files of a device since it has been
+// mounted.
+struct DeviceStatistics {
+  // Bucket 0 counts reads shorter than 1 us, bucket i counts reads taking
+  // [2^(i-1), 2^i) us, and the last bucket also counts all longer reads.
+  static constexpr uint32_t kLatencyBucketCount = 20;
+
+  std::string mount_path;
+  std::string name;
+  uint64_t read_count;
+  uint64_t read_bytes;
+  uint64_t read_host_ticks;
+  uint64_t read_max_host_ticks;
+  uint64_t read_latency_buckets[kLatencyBucketCount];
+  uint64_t write_count;
+  uint64_t write_bytes;
+  uint64_t write_host_ticks;
+  // Lookups in the caches of decompressed data of the device, if it has any.
+  uint64_t cache_hit_count;
+  uint64_t cache_miss_count;
+};
+
 class Device {
  public:
   explicit Device(const std::string_view mount_path);
@@ -42,9 +66,29 @@ class Device {
   virtual uint32_t sectors_per_allocation_unit() const = 0;
   virtual uint32_t bytes_per_sector() const = 0;
 
+  // Called by any thread, the counters are only updated with relaxed atomics.
+  void RecordRead(size_t length, uint64_t host_ticks);
+  void RecordWrite(size_t length, uint64_t host_ticks);
+  void RecordCacheAccess(bool is_hit);
+  void GetStatistics(DeviceStatistics& statistics) const;
+
  protected:
   xe::global_critical_region global_critical_region_;
   std::string mount_path_;
+
+ private:
+  uint64_t host_ticks_per_us_;
+  std::atomic<uint64_t> read_count_{0};
+  std::atomic<uint64_t> read_bytes_{0};
+  std::atomic<uint64_t> read_host_ticks_{0};
+  std::atomic<uint64_t> read_max_host_ticks_{0};
+  std::atomic<uint64_t>
+      read_latency_buckets_[DeviceStatistics::kLatencyBucketCount] = {};
+  std::atomic<uint64_t> write_count_{0};
+  std::atomic<uint64_t> write_bytes_{0};
+  std::atomic<uint64_t> write_host_ticks_{0};
+  std::atomic<uint64_t> cache_hit_count_{0};
+  std::atomic<uint64_t> cache_miss_count_{0};
 };
 
 }  // namespace vfs
@@ -0,0 +1,460 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/devices/compressed_disc_image_device.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "xenia/base/filesystem.h"
+#include "xenia/base/literals.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/math.h"
+#include "xenia/base/memory.h"
+#include "xenia/base/string.h"
+#include "xenia/base/threading.h"
+#include "xenia/vfs/devices/compressed_disc_image_entry.h"
+
+#include "third_party/zstd/lib/zstd.h"
+
+namespace xe {
+namespace vfs {
+
+using namespace xe::literals;
+
+namespace {
+
+const size_t kXESectorSize = 2_KiB;
+// Blocks with the most recently decompressed data, for small reads.
+const size_t kCachedBlockCount = 64;
+// From this number of blocks, a read is decompressed on multiple threads
+// instead of through the cache.
+const size_t kParallelReadMinBlockCount = 8;
+
+}  // namespace
+
+CompressedDiscImageDevice::CompressedDiscImageDevice(
+    const std::string_view mount_path, const std::filesystem::path& host_path)
+    : Device(mount_path), name_("GDFX"), host_path_(host_path) {}
+
+CompressedDiscImageDevice::~CompressedDiscImageDevice() = default;
+
+bool CompressedDiscImageDevice::Initialize() {
+  mmap_ = MappedMemory::Open(host_path_, MappedMemory::Mode::kRead);
+  if (!mmap_) {
+    XELOGE("Compressed disc image could not be mapped");
+    return false;
+  }
+  XELOGFS("CompressedDiscImageDevice::Initialize");
+
+  CompressedDiscImageHeader header;
+  if (mmap_->size() < sizeof(header)) {
+    XELOGE("Compressed disc image is truncated");
+    return false;
+  }
+  std::memcpy(&header, mmap_->data(), sizeof(header));
+  if (header.signature != kCompressedDiscImageSignature ||
+      header.version != kCompressedDiscImageVersion || !header.block_size ||
+      header.block_count != (header.image_size + header.block_size - 1) /
+                                header.block_size) {
+    XELOGE("Unsupported compressed disc image header");
+    return false;
+  }
+  block_size_ = header.block_size;
+  image_size_ = header.image_size;
+
+  // The offsets are validated once here so the reads don't need to.
+  size_t offsets_size = (size_t(header.block_count) + 1) * sizeof(uint64_t);
+  if (mmap_->size() - sizeof(header) < offsets_size) {
+    XELOGE("Compressed disc image block index is truncated");
+    return false;
+  }
+  block_offsets_.resize(size_t(header.block_count) + 1);
+  const uint8_t* offsets_ptr = mmap_->data() + sizeof(header);
+  for (size_t i = 0; i < block_offsets_.size(); ++i) {
+    block_offsets_[i] = xe::load<uint64_t>(offsets_ptr + i * sizeof(uint64_t));
+    uint64_t previous_offset =
+        i ? block_offsets_[i - 1] : sizeof(header) + offsets_size;
+    if (block_offsets_[i] < previous_offset ||
+        block_offsets_[i] > mmap_->size() ||
+        (i && block_offsets_[i] - previous_offset > GetBlockLength(i - 1))) {
+      XELOGE("Compressed disc image block index is damaged");
+      return false;
+    }
+  }
+
+  ParseState state = {};
+  if (!Verify(&state)) {
+    XELOGE("Failed to verify compressed disc image header");
+    return false;
+  }
+
+  auto root_entry = new CompressedDiscImageEntry(this, nullptr, "", "");
+  root_entry->attributes_ = kFileAttributeDirectory;
+  root_entry_ = std::unique_ptr<Entry>(root_entry);
+  std::vector<uint8_t> root_buffer(state.root_size);
+  if (ReadImage(state.game_offset + state.root_sector * kXESectorSize,
+                root_buffer.size(), root_buffer.data()) != root_buffer.size() ||
+      !ReadEntry(&state, root_buffer, 0, root_entry)) {
+    XELOGE("Failed to read all GDFX entries of the compressed disc image");
+    return false;
+  }
+
+  XELOGI("Mounted a compressed disc image of {} MB in {} blocks of {} KB",
+         image_size_ / 1_MiB, header.block_count, block_size_ / 1_KiB);
+  return true;
+}
+
+void CompressedDiscImageDevice::Dump(StringBuffer* string_buffer) {
+  auto global_lock = global_critical_region_.Acquire();
+  root_entry_->Dump(string_buffer, 0);
+}
+
+Entry* CompressedDiscImageDevice::ResolvePath(const std::string_view path) {
+  // The filesystem will have stripped our prefix off already, so the path will
+  // be in the form:
+  // some\PATH.foo
+  XELOGFS("CompressedDiscImageDevice::ResolvePath({})", path);
+  return root_entry_->ResolvePath(path);
+}
+
+size_t CompressedDiscImageDevice::GetBlockLength(uint64_t block_index) const {
+  return size_t(
+      std::min(uint64_t(block_size_), image_size_ - block_index * block_size_));
+}
+
+bool CompressedDiscImageDevice::DecompressBlock(uint64_t block_index,
+                                                uint8_t* output) const {
+  size_t block_length = GetBlockLength(block_index);
+  const uint8_t* compressed_data = mmap_->data() + block_offsets_[block_index];
+  size_t compressed_length =
+      size_t(block_offsets_[block_index + 1] - block_offsets_[block_index]);
+  if (compressed_length == block_length) {
+    // Stored uncompressed.
+    std::memcpy(output, compressed_data, block_length);
+    return true;
+  }
+  size_t decompressed_length = ZSTD_decompress(
+      output, block_length, compressed_data, compressed_length);
+  if (ZSTD_isError(decompressed_length) ||
+      decompressed_length != block_length) {
+    XELOGE("Failed to decompress block {} of the compressed disc image",
+           block_index);
+    return false;
+  }
+  return true;
+}
+
+bool CompressedDiscImageDevice::ReadBlock(uint64_t block_index, size_t offset,
+                                          size_t length, uint8_t* buffer) {
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto it = cached_block_lookup_.find(block_index);
+    if (it != cached_block_lookup_.end()) {
+      cached_blocks_.splice(cached_blocks_.begin(), cached_blocks_,
+                            it->second);
+      std::memcpy(buffer, it->second->data.data() + offset, length);
+      RecordCacheAccess(true);
+      return true;
+    }
+  }
+  RecordCacheAccess(false);
+  // Decompressed without holding the lock so other threads can read other
+  // blocks meanwhile.
+  std::vector<uint8_t> data(GetBlockLength(block_index));
+  if (!DecompressBlock(block_index, data.data())) {
+    return false;
+  }
+  std::memcpy(buffer, data.data() + offset, length);
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  if (cached_block_lookup_.find(block_index) != cached_block_lookup_.end()) {
+    // Decompressed by another thread too.
+    return true;
+  }
+  if (cached_blocks_.size() >= kCachedBlockCount) {
+    cached_block_lookup_.erase(cached_blocks_.back().block_index);
+    cached_blocks_.pop_back();
+  }
+  cached_blocks_.push_front({block_index, std::move(data)});
+  cached_block_lookup_.emplace(block_index, cached_blocks_.begin());
+  return true;
+}
+
+size_t CompressedDiscImageDevice::ReadImage(uint64_t offset, size_t length,
+                                            void* buffer) {
+  if (offset >= image_size_ || !length) {
+    return 0;
+  }
+  length = size_t(std::min(uint64_t(length), image_size_ - offset));
+  uint64_t first_block_index = offset / block_size_;
+  size_t block_count =
+      size_t((offset + length - 1) / block_size_ - first_block_index + 1);
+  auto read_block = [&](size_t i, bool use_cache) {
+    uint64_t block_index = first_block_index + i;
+    uint64_t block_start = block_index * block_size_;
+    uint64_t block_end = block_start + GetBlockLength(block_index);
+    uint64_t copy_start = std::max(offset, block_start);
+    uint64_t copy_end = std::min(offset + length, block_end);
+    uint8_t* output =
+        reinterpret_cast<uint8_t*>(buffer) + size_t(copy_start - offset);
+    if (!use_cache) {
+      if (copy_start == block_start && copy_end == block_end) {
+        return DecompressBlock(block_index, output);
+      }
+      std::vector<uint8_t> data(size_t(block_end - block_start));
+      if (!DecompressBlock(block_index, data.data())) {
+        return false;
+      }
+      std::memcpy(output, data.data() + size_t(copy_start - block_start),
+                  size_t(copy_end - copy_start));
+      return true;
+    }
+    return ReadBlock(block_index, size_t(copy_start - block_start),
+                     size_t(copy_end - copy_start), output);
+  };
+
+  if (block_count >= kParallelReadMinBlockCount) {
+    std::atomic<bool> failed{false};
+    xe::threading::ParallelFor(
+        block_count, "Disc Image Decompression", [&](size_t i) {
+          if (!read_block(i, false)) {
+            failed.store(true, std::memory_order_relaxed);
+          }
+        });
+    return failed.load(std::memory_order_relaxed) ? 0 : length;
+  }
+  for (size_t i = 0; i < block_count; ++i) {
+    if (!read_block(i, true)) {
+      return 0;
+    }
+  }
+  return length;
+}
+
+void CompressedDiscImageDevice::PrefetchImage(uint64_t offset, size_t length) {
+  if (offset >= image_size_ || !length) {
+    return;
+  }
+  length = size_t(std::min(uint64_t(length), image_size_ - offset));
+  uint64_t compressed_start = block_offsets_[offset / block_size_];
+  uint64_t compressed_end =
+      block_offsets_[(offset + length - 1) / block_size_ + 1];
+  xe::memory::AdviseWillNeed(mmap_->data() + compressed_start,
+                             size_t(compressed_end - compressed_start));
+}
+
+bool CompressedDiscImageDevice::Verify(ParseState* state) {
+  // Find sector 32 of the game partition - try at a few points.
+  static const size_t likely_offsets[] = {
+      0x00000000, 0x0000FB20, 0x00020600, 0x02080000, 0x0FD90000,
+  };
+  uint8_t fs_sector[32];
+  for (size_t n = 0; n < xe::countof(likely_offsets); n++) {
+    state->game_offset = likely_offsets[n];
+    if (ReadImage(state->game_offset + (32 * kXESectorSize), sizeof(fs_sector),
+                  fs_sector) == sizeof(fs_sector) &&
+        std::memcmp(fs_sector, "MICROSOFT*XBOX*MEDIA", 20) == 0) {
+      state->root_sector = xe::load<uint32_t>(fs_sector + 20);
+      state->root_size = xe::load<uint32_t>(fs_sector + 24);
+      return state->root_size >= 13 && state->root_size <= 32_MiB;
+    }
+  }
+  // File doesn't have the magic values - likely not a real GDFX source.
+  return false;
+}
+
+bool CompressedDiscImageDevice::ReadEntry(ParseState* state,
+                                          const std::vector<uint8_t>& buffer,
+                                          uint16_t entry_ordinal,
+                                          CompressedDiscImageEntry* parent) {
+  if (size_t(entry_ordinal) * 4 + 14 > buffer.size()) {
+    return false;
+  }
+  const uint8_t* p = buffer.data() + (entry_ordinal * 4);
+
+  uint16_t node_l = xe::load<uint16_t>(p + 0);
+  uint16_t node_r = xe::load<uint16_t>(p + 2);
+  size_t sector = xe::load<uint32_t>(p + 4);
+  size_t length = xe::load<uint32_t>(p + 8);
+  uint8_t attributes = xe::load<uint8_t>(p + 12);
+  uint8_t name_length = xe::load<uint8_t>(p + 13);
+  if (size_t(entry_ordinal) * 4 + 14 + name_length > buffer.size()) {
+    return false;
+  }
+  auto name_buffer = reinterpret_cast<const char*>(p + 14);
+
+  if (node_l && !ReadEntry(state, buffer, node_l, parent)) {
+    return false;
+  }
+
+  // Filename is stored as Windows-1252, convert it to UTF-8.
+  auto ansi_name = std::string(name_buffer, name_length);
+  auto name = xe::win1252_to_utf8(ansi_name);
+
+  auto entry = CompressedDiscImageEntry::Create(this, parent, name);
+  entry->attributes_ = attributes | kFileAttributeReadOnly;
+  entry->size_ = length;
+  entry->allocation_size_ = xe::round_up(length, bytes_per_sector());
+
+  // Set to January 1, 1970 (UTC) in 100-nanosecond intervals
+  entry->create_timestamp_ = 10000 * 11644473600000LL;
+  entry->access_timestamp_ = 10000 * 11644473600000LL;
+  entry->write_timestamp_ = 10000 * 11644473600000LL;
+
+  if (attributes & kFileAttributeDirectory) {
+    // Folder.
+    entry->data_offset_ = 0;
+    entry->data_size_ = 0;
+    if (length) {
+      // Not a leaf - read in children.
+      std::vector<uint8_t> folder_buffer(std::min(length, size_t(32_MiB)));
+      if (ReadImage(state->game_offset + (sector * kXESectorSize),
+                    folder_buffer.size(),
+                    folder_buffer.data()) != folder_buffer.size()) {
+        // Out of bounds read.
+        return false;
+      }
+      if (!ReadEntry(state, folder_buffer, 0, entry.get())) {
+        return false;
+      }
+    }
+  } else {
+    // File.
+    entry->data_offset_ = state->game_offset + (sector * kXESectorSize);
+    entry->data_size_ = length;
+  }
+
+  // Add to parent.
+  parent->children_.emplace_back(std::move(entry));
+
+  // Read next file in the list.
+  if (node_r && !ReadEntry(state, buffer, node_r, parent)) {
+    return false;
+  }
+
+  return true;
+}
+
+bool CompressedDiscImageDevice::Compress(
+    const std::filesystem::path& source_path,
+    const std::filesystem::path& target_path, uint32_t block_size,
+    int compression_level) {
+  std::error_code error_code;
+  uint64_t image_size = std::filesystem::file_size(source_path, error_code);
+  if (error_code || !block_size) {
+    XELOGE("Unable to get the size of the disc image {}",
+           xe::path_to_utf8(source_path));
+    return false;
+  }
+  FILE* source = xe::filesystem::OpenFile(source_path, "rb");
+  if (!source) {
+    XELOGE("Unable to open the disc image {}", xe::path_to_utf8(source_path));
+    return false;
+  }
+  FILE* target = xe::filesystem::OpenFile(target_path, "wb");
+  if (!target) {
+    XELOGE("Unable to create the compressed disc image {}",
+           xe::path_to_utf8(target_path));
+    fclose(source);
+    return false;
+  }
+
+  CompressedDiscImageHeader header;
+  header.signature = kCompressedDiscImageSignature;
+  header.version = kCompressedDiscImageVersion;
+  header.block_size = block_size;
+  header.block_count = uint32_t((image_size + block_size - 1) / block_size);
+  header.image_size = image_size;
+  std::vector<xe::le<uint64_t>> block_offsets(size_t(header.block_count) + 1);
+  uint64_t offset =
+      sizeof(header) + block_offsets.size() * sizeof(block_offsets[0]);
+
+  // The index is written after the blocks, once their sizes are known.
+  bool succeeded = xe::filesystem::Seek(target, int64_t(offset), SEEK_SET);
+  // Enough blocks for every logical processor to compress a few before the
+  // results are written in order.
+  size_t batch_block_count =
+      size_t(xe::threading::logical_processor_count()) * 4;
+  std::vector<std::vector<uint8_t>> blocks(batch_block_count);
+  std::vector<std::vector<uint8_t>> compressed_blocks(batch_block_count);
+  uint64_t compressed_block_count = 0;
+  for (uint64_t first_block_index = 0;
+       succeeded && first_block_index < header.block_count;
+       first_block_index += batch_block_count) {
+    size_t block_count = size_t(std::min(
+        uint64_t(batch_block_count), header.block_count - first_block_index));
+    for (size_t i = 0; i < block_count; ++i) {
+      blocks[i].resize(size_t(std::min(
+          uint64_t(block_size),
+          image_size - (first_block_index + i) * block_size)));
+      if (fread(blocks[i].data(), 1, blocks[i].size(), source) !=
+          blocks[i].size()) {
+        XELOGE("Unable to read from the disc image {}",
+               xe::path_to_utf8(source_path));
+        succeeded = false;
+        break;
+      }
+    }
+    if (!succeeded) {
+      break;
+    }
+    xe::threading::ParallelFor(
+        block_count, "Disc Image Compression", [&](size_t i) {
+          const std::vector<uint8_t>& block = blocks[i];
+          std::vector<uint8_t>& compressed_block = compressed_blocks[i];
+          compressed_block.resize(ZSTD_compressBound(block.size()));
+          size_t compressed_length = ZSTD_compress(
+              compressed_block.data(), compressed_block.size(), block.data(),
+              block.size(), compression_level);
+          if (!ZSTD_isError(compressed_length) &&
+              compressed_length < block.size()) {
+            compressed_block.resize(compressed_length);
+          } else {
+            // Stored uncompressed.
+            compressed_block.clear();
+          }
+        });
+    for (size_t i = 0; i < block_count; ++i) {
+      const std::vector<uint8_t>& data =
+          compressed_blocks[i].empty() ? blocks[i] : compressed_blocks[i];
+      compressed_block_count += !compressed_blocks[i].empty();
+      block_offsets[size_t(first_block_index + i)] = offset;
+      if (fwrite(data.data(), 1, data.size(), target) != data.size()) {
+        succeeded = false;
+        break;
+      }
+      offset += data.size();
+    }
+  }
+  block_offsets.back() = offset;
+  fclose(source);
+
+  succeeded = succeeded && xe::filesystem::Seek(target, 0, SEEK_SET) &&
+              fwrite(&header, sizeof(header), 1, target) == 1 &&
+              fwrite(block_offsets.data(), sizeof(block_offsets[0]),
+                     block_offsets.size(),
+                     target) == block_offsets.size();
+  fclose(target);
+  if (!succeeded) {
+    XELOGE("Unable to write the compressed disc image {}",
+           xe::path_to_utf8(target_path));
+    std::filesystem::remove(target_path, error_code);
+    return false;
+  }
+  XELOGI(
+      "Compressed {} ({} MB) to {} ({} MB), {} of {} blocks compressed",
+      xe::path_to_utf8(source_path), image_size / 1_MiB,
+      xe::path_to_utf8(target_path), offset / 1_MiB, compressed_block_count,
+      uint32_t(header.block_count));
+  return true;
+}
+
+}  // namespace vfs
+}  // namespace xe
@@ -0,0 +1,132 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_VFS_DEVICES_COMPRESSED_DISC_IMAGE_DEVICE_H_
+#define XENIA_VFS_DEVICES_COMPRESSED_DISC_IMAGE_DEVICE_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "xenia/base/assert.h"
+#include "xenia/base/byte_order.h"
+#include "xenia/base/mapped_memory.h"
+#include "xenia/vfs/device.h"
+
+namespace xe {
+namespace vfs {
+
+class CompressedDiscImageEntry;
+
+constexpr fourcc_t kCompressedDiscImageSignature =
+    make_fourcc(0x58, 0x43, 0x5A, 0x1A);
+constexpr uint32_t kCompressedDiscImageVersion = 1;
+
+// A disc image split into blocks of block_size bytes, each compressed with
+// zstd independently, or stored as is if compressing doesn't make it smaller,
+// so any range of the image can be decompressed without the preceding data.
+// The header is followed by the file offsets of the block_count blocks and of
+// the end of the last one, and then by the blocks in their order. Apart from
+// the signature, stored as "XCZ\x1A", all values are little-endian.
+struct CompressedDiscImageHeader {
+  xe::be<fourcc_t> signature;
+  xe::le<uint32_t> version;
+  xe::le<uint32_t> block_size;
+  xe::le<uint32_t> block_count;
+  xe::le<uint64_t> image_size;
+};
+static_assert_size(CompressedDiscImageHeader, 0x18);
+
+class CompressedDiscImageDevice : public Device {
+ public:
+  static constexpr uint32_t kDefaultBlockSize = 64 * 1024;
+
+  CompressedDiscImageDevice(const std::string_view mount_path,
+                            const std::filesystem::path& host_path);
+  ~CompressedDiscImageDevice() override;
+
+  bool Initialize() override;
+  void Dump(StringBuffer* string_buffer) override;
+  Entry* ResolvePath(const std::string_view path) override;
+
+  const std::string& name() const override { return name_; }
+  uint32_t attributes() const override { return 0; }
+  uint32_t component_name_max_length() const override { return 255; }
+
+  uint32_t total_allocation_units() const override {
+    return uint32_t(image_size_ / sectors_per_allocation_unit() /
+                    bytes_per_sector());
+  }
+  uint32_t available_allocation_units() const override { return 0; }
+  uint32_t sectors_per_allocation_unit() const override { return 1; }
+  uint32_t bytes_per_sector() const override { return 0x200; }
+
+  // Reads a range of the uncompressed disc image. Small reads go through a
+  // cache of recently decompressed blocks, while the blocks of large reads
+  // are decompressed on all logical processors directly into the buffer.
+  // Returns the number of bytes read.
+  size_t ReadImage(uint64_t offset, size_t length, void* buffer);
+  // Starts loading the compressed blocks of a range of the uncompressed disc
+  // image from the storage in the background.
+  void PrefetchImage(uint64_t offset, size_t length);
+
+  // Converts an uncompressed disc image, compressing the blocks on all
+  // logical processors.
+  static bool Compress(const std::filesystem::path& source_path,
+                       const std::filesystem::path& target_path,
+                       uint32_t block_size = kDefaultBlockSize,
+                       int compression_level = 19);
+
+ private:
+  struct CachedBlock {
+    uint64_t block_index;
+    std::vector<uint8_t> data;
+  };
+
+  typedef struct {
+    size_t game_offset;  // Offset (bytes) of game partition.
+    size_t root_sector;  // Offset (sector) of root.
+    size_t root_size;    // Size (bytes) of root.
+  } ParseState;
+
+  size_t GetBlockLength(uint64_t block_index) const;
+  // The output must have room for GetBlockLength(block_index) bytes.
+  bool DecompressBlock(uint64_t block_index, uint8_t* output) const;
+  bool ReadBlock(uint64_t block_index, size_t offset, size_t length,
+                 uint8_t* buffer);
+
+  bool Verify(ParseState* state);
+  bool ReadEntry(ParseState* state, const std::vector<uint8_t>& buffer,
+                 uint16_t entry_ordinal, CompressedDiscImageEntry* parent);
+
+  std::string name_;
+  std::filesystem::path host_path_;
+  std::unique_ptr<Entry> root_entry_;
+  std::unique_ptr<MappedMemory> mmap_;
+
+  uint32_t block_size_ = 0;
+  uint64_t image_size_ = 0;
+  // block_count + 1 file offsets, the last is the end of the last block.
+  std::vector<uint64_t> block_offsets_;
+
+  std::mutex cache_mutex_;
+  // Most recently used first.
+  std::list<CachedBlock> cached_blocks_;
+  std::unordered_map<uint64_t, std::list<CachedBlock>::iterator>
+      cached_block_lookup_;
+};
+
+}  // namespace vfs
+}  // namespace xe
+
+#endif  // XENIA_VFS_DEVICES_COMPRESSED_DISC_IMAGE_DEVICE_H_
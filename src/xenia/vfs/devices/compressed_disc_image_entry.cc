@@ -0,0 +1,50 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/devices/compressed_disc_image_entry.h"
+
+#include <algorithm>
+
+#include "xenia/base/string.h"
+#include "xenia/vfs/devices/compressed_disc_image_device.h"
+#include "xenia/vfs/devices/compressed_disc_image_file.h"
+
+namespace xe {
+namespace vfs {
+
+CompressedDiscImageEntry::CompressedDiscImageEntry(Device* device,
+                                                   Entry* parent,
+                                                   const std::string_view path,
+                                                   const std::string_view name)
+    : Entry(device, parent, path, name), data_offset_(0), data_size_(0) {}
+
+CompressedDiscImageEntry::~CompressedDiscImageEntry() = default;
+
+std::unique_ptr<CompressedDiscImageEntry> CompressedDiscImageEntry::Create(
+    Device* device, Entry* parent, const std::string_view name) {
+  auto path = xe::utf8::join_guest_paths(parent->path(), name);
+  return std::make_unique<CompressedDiscImageEntry>(device, parent, path, name);
+}
+
+X_STATUS CompressedDiscImageEntry::Open(uint32_t desired_access,
+                                        File** out_file) {
+  *out_file = new CompressedDiscImageFile(desired_access, this);
+  return X_STATUS_SUCCESS;
+}
+
+void CompressedDiscImageEntry::Prefetch(size_t offset, size_t length) {
+  if (offset >= data_size_) {
+    return;
+  }
+  static_cast<CompressedDiscImageDevice*>(device_)->PrefetchImage(
+      data_offset_ + offset, std::min(length, data_size_ - offset));
+}
+
+}  // namespace vfs
+}  // namespace xe
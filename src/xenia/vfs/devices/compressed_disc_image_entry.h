@@ -0,0 +1,51 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_VFS_DEVICES_COMPRESSED_DISC_IMAGE_ENTRY_H_
+#define XENIA_VFS_DEVICES_COMPRESSED_DISC_IMAGE_ENTRY_H_
+
+#include <memory>
+#include <string>
+
+#include "xenia/vfs/entry.h"
+
+namespace xe {
+namespace vfs {
+
+class CompressedDiscImageDevice;
+
+class CompressedDiscImageEntry : public Entry {
+ public:
+  CompressedDiscImageEntry(Device* device, Entry* parent,
+                           const std::string_view path,
+                           const std::string_view name);
+  ~CompressedDiscImageEntry() override;
+
+  static std::unique_ptr<CompressedDiscImageEntry> Create(
+      Device* device, Entry* parent, const std::string_view name);
+
+  size_t data_offset() const { return data_offset_; }
+  size_t data_size() const { return data_size_; }
+
+  X_STATUS Open(uint32_t desired_access, File** out_file) override;
+
+  void Prefetch(size_t offset, size_t length) override;
+
+ private:
+  friend class CompressedDiscImageDevice;
+  friend class CompressedDiscImageFile;
+
+  size_t data_offset_;
+  size_t data_size_;
+};
+
+}  // namespace vfs
+}  // namespace xe
+
+#endif  // XENIA_VFS_DEVICES_COMPRESSED_DISC_IMAGE_ENTRY_H_
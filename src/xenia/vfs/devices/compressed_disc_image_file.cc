@@ -0,0 +1,51 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/devices/compressed_disc_image_file.h"
+
+#include <algorithm>
+
+#include "xenia/base/logging.h"
+#include "xenia/vfs/devices/compressed_disc_image_device.h"
+#include "xenia/vfs/devices/compressed_disc_image_entry.h"
+
+namespace xe {
+namespace vfs {
+
+CompressedDiscImageFile::CompressedDiscImageFile(
+    uint32_t file_access, CompressedDiscImageEntry* entry)
+    : File(file_access, entry), entry_(entry) {}
+
+CompressedDiscImageFile::~CompressedDiscImageFile() = default;
+
+void CompressedDiscImageFile::Destroy() { delete this; }
+
+X_STATUS CompressedDiscImageFile::ReadSync(void* buffer, size_t buffer_length,
+                                           size_t byte_offset,
+                                           size_t* out_bytes_read) {
+  if (byte_offset >= entry_->size()) {
+    return X_STATUS_END_OF_FILE;
+  }
+  size_t real_length =
+      std::min(buffer_length, entry_->data_size() - byte_offset);
+  size_t bytes_read =
+      static_cast<CompressedDiscImageDevice*>(entry_->device())
+          ->ReadImage(entry_->data_offset() + byte_offset, real_length,
+                      buffer);
+  if (bytes_read != real_length) {
+    xe::FatalError(
+        "This compressed disc image is corrupted and cannot be played.");
+    return X_STATUS_END_OF_FILE;
+  }
+  *out_bytes_read = bytes_read;
+  return X_STATUS_SUCCESS;
+}
+
+}  // namespace vfs
+}  // namespace xe
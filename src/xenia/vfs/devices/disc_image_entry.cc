@@ -12,6 +12,7 @@
 #include <algorithm>
 
 #include "xenia/base/math.h"
+#include "xenia/base/memory.h"
 #include "xenia/vfs/devices/disc_image_file.h"
 
 namespace xe {
@@ -53,5 +54,15 @@ std::unique_ptr<MappedMemory> DiscImageEntry::OpenMapped(
   return mmap_->Slice(real_offset, real_length);
 }
 
+void DiscImageEntry::Prefetch(size_t offset, size_t length) {
+  if (offset >= data_size_ || data_offset_ + offset >= mmap_->size()) {
+    return;
+  }
+  size_t real_offset = data_offset_ + offset;
+  size_t real_length = std::min(std::min(length, data_size_ - offset),
+                                mmap_->size() - real_offset);
+  xe::memory::AdviseWillNeed(mmap_->data() + real_offset, real_length);
+}
+
 }  // namespace vfs
 }  // namespace xe
@@ -41,6 +41,7 @@ class DiscImageEntry : public Entry {
   std::unique_ptr<MappedMemory> OpenMapped(MappedMemory::Mode mode,
                                            size_t offset,
                                            size_t length) override;
+  void Prefetch(size_t offset, size_t length) override;
 
  private:
   friend class DiscImageDevice;
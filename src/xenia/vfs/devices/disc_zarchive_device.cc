@@ -9,23 +9,63 @@
 
 #include "xenia/vfs/devices/disc_zarchive_device.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
+#include "xenia/base/profiling.h"
 #include "xenia/vfs/devices/disc_zarchive_entry.h"
 
 #include "third_party/zarchive/include/zarchive/zarchivereader.h"
 
+DEFINE_uint32(zarchive_block_cache_size, 64,
+              "Size in MB of the cache of decompressed blocks shared by all "
+              "files of a mounted ZArchive, 0 to disable it.",
+              "Storage");
+DEFINE_uint32(zarchive_read_ahead_blocks, 4,
+              "Number of 64 KB blocks following a sequential read from a "
+              "ZArchive file to decompress in advance on a separate thread, "
+              "0 to disable read-ahead. Requires the block cache.",
+              "Storage");
+
 namespace xe {
 namespace vfs {
 
+using namespace xe::literals;
+
 DiscZarchiveDevice::DiscZarchiveDevice(const std::string_view mount_path,
                                        const std::filesystem::path& host_path)
     : Device(mount_path), name_("GDFX"), host_path_(host_path), reader_() {}
 
-DiscZarchiveDevice::~DiscZarchiveDevice() {};
+DiscZarchiveDevice::~DiscZarchiveDevice() {
+  if (read_ahead_thread_) {
+    {
+      std::lock_guard<std::mutex> lock(read_ahead_mutex_);
+      read_ahead_shutdown_ = true;
+    }
+    read_ahead_cv_.notify_one();
+    xe::threading::Wait(read_ahead_thread_.get(), false);
+    read_ahead_thread_.reset();
+  }
+  if (cache_hit_count_ || cache_miss_count_) {
+    XELOGI(
+        "ZArchive block cache: {} hits, {} misses ({:.1f}% hit rate), {} "
+        "blocks read ahead, {:.3f} ms decompressing",
+        cache_hit_count_, cache_miss_count_,
+        100.0 * cache_hit_count_ / (cache_hit_count_ + cache_miss_count_),
+        read_ahead_block_count_,
+        decompress_host_ticks_ * 1000.0 / Clock::QueryHostTickFrequency());
+  }
+}
 
 bool DiscZarchiveDevice::Initialize() {
+  cache_capacity_blocks_ =
+      size_t(cvars::zarchive_block_cache_size) * 1_MiB / kCacheBlockSize;
+
   reader_ =
       std::unique_ptr<ZArchiveReader>(ZArchiveReader::OpenFromFile(host_path_));
 
@@ -137,5 +177,153 @@ bool DiscZarchiveDevice::ReadAllEntries(const std::string& path,
   return false;
 }
 
+size_t DiscZarchiveDevice::ReadFile(const DiscZarchiveEntry* entry,
+                                    size_t offset, size_t length, void* buffer,
+                                    bool is_sequential) {
+  const uint32_t handle = entry->handle_;
+  const uint64_t file_size = entry->size();
+  if (offset >= file_size) {
+    return 0;
+  }
+  length = size_t(std::min(uint64_t(length), file_size - offset));
+  if (!cache_capacity_blocks_) {
+    return size_t(reader_->ReadFromFile(handle, offset, length, buffer));
+  }
+
+  uint8_t* p = static_cast<uint8_t*>(buffer);
+  size_t remaining_length = length;
+  uint64_t block_index = offset / kCacheBlockSize;
+  while (remaining_length) {
+    size_t block_offset = offset % kCacheBlockSize;
+    size_t copy_length =
+        std::min(remaining_length, size_t(kCacheBlockSize) - block_offset);
+    uint64_t key = GetCacheBlockKey(handle, block_index);
+    if (!ReadCachedBlock(key, block_offset, copy_length, p)) {
+      std::vector<uint8_t> data =
+          DecompressBlock(handle, file_size, block_index);
+      if (data.size() < block_offset + copy_length) {
+        XELOGE("Failed to read block {} of ZArchive file {}", block_index,
+               entry->path());
+        break;
+      }
+      std::memcpy(p, data.data() + block_offset, copy_length);
+      InsertCachedBlock(key, std::move(data));
+    }
+    p += copy_length;
+    offset += copy_length;
+    remaining_length -= copy_length;
+    ++block_index;
+  }
+
+  if (is_sequential && cvars::zarchive_read_ahead_blocks) {
+    QueueReadAhead(handle, file_size, block_index);
+  }
+  return length - remaining_length;
+}
+
+std::vector<uint8_t> DiscZarchiveDevice::DecompressBlock(
+    uint32_t handle, uint64_t file_size, uint64_t block_index) {
+  uint64_t block_offset = block_index * kCacheBlockSize;
+  std::vector<uint8_t> data(size_t(
+      std::min(uint64_t(kCacheBlockSize), file_size - block_offset)));
+  uint64_t start_host_ticks = Clock::QueryHostTickCount();
+  data.resize(size_t(
+      reader_->ReadFromFile(handle, block_offset, data.size(), data.data())));
+  uint64_t host_ticks = Clock::QueryHostTickCount() - start_host_ticks;
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  decompress_host_ticks_ += host_ticks;
+  return data;
+}
+
+bool DiscZarchiveDevice::ReadCachedBlock(uint64_t key, size_t offset,
+                                         size_t length, void* buffer) {
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  auto it = cached_block_lookup_.find(key);
+  if (it == cached_block_lookup_.end() ||
+      it->second->data.size() < offset + length) {
+    ++cache_miss_count_;
+    COUNT_profile_set("vfs/zarchive_cache_misses", cache_miss_count_);
+    RecordCacheAccess(false);
+    return false;
+  }
+  cached_blocks_.splice(cached_blocks_.begin(), cached_blocks_, it->second);
+  std::memcpy(buffer, it->second->data.data() + offset, length);
+  ++cache_hit_count_;
+  COUNT_profile_set("vfs/zarchive_cache_hits", cache_hit_count_);
+  RecordCacheAccess(true);
+  return true;
+}
+
+void DiscZarchiveDevice::InsertCachedBlock(uint64_t key,
+                                           std::vector<uint8_t>&& data) {
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  if (cached_block_lookup_.count(key)) {
+    // Decompressed by another thread in the meantime.
+    return;
+  }
+  while (cached_blocks_.size() >= cache_capacity_blocks_) {
+    cached_block_lookup_.erase(cached_blocks_.back().key);
+    cached_blocks_.pop_back();
+  }
+  cached_blocks_.push_front({key, std::move(data)});
+  cached_block_lookup_.emplace(key, cached_blocks_.begin());
+}
+
+void DiscZarchiveDevice::QueueReadAhead(uint32_t handle, uint64_t file_size,
+                                        uint64_t first_block_index) {
+  uint64_t block_count = (file_size + kCacheBlockSize - 1) / kCacheBlockSize;
+  uint64_t end_block_index = std::min(
+      first_block_index + cvars::zarchive_read_ahead_blocks, block_count);
+  if (first_block_index >= end_block_index) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(read_ahead_mutex_);
+    for (uint64_t i = first_block_index; i < end_block_index; ++i) {
+      read_ahead_queue_.push_back({handle, file_size, i});
+    }
+    // Only the most recent requests are relevant if the thread falls behind.
+    while (read_ahead_queue_.size() >
+           size_t(cvars::zarchive_read_ahead_blocks) * 4) {
+      read_ahead_queue_.pop_front();
+    }
+    if (!read_ahead_thread_) {
+      read_ahead_thread_ = xe::threading::Thread::Create(
+          {}, [this]() { ReadAheadThread(); });
+      if (read_ahead_thread_) {
+        read_ahead_thread_->set_name("ZArchive Read-Ahead");
+      }
+    }
+  }
+  read_ahead_cv_.notify_one();
+}
+
+void DiscZarchiveDevice::ReadAheadThread() {
+  while (true) {
+    ReadAheadRequest request;
+    {
+      std::unique_lock<std::mutex> lock(read_ahead_mutex_);
+      read_ahead_cv_.wait(lock, [this]() {
+        return !read_ahead_queue_.empty() || read_ahead_shutdown_;
+      });
+      if (read_ahead_shutdown_) {
+        return;
+      }
+      request = read_ahead_queue_.front();
+      read_ahead_queue_.pop_front();
+    }
+    uint64_t key = GetCacheBlockKey(request.handle, request.block_index);
+    {
+      std::lock_guard<std::mutex> lock(cache_mutex_);
+      if (cached_block_lookup_.count(key)) {
+        continue;
+      }
+      ++read_ahead_block_count_;
+    }
+    InsertCachedBlock(key, DecompressBlock(request.handle, request.file_size,
+                                           request.block_index));
+  }
+}
+
 }  // namespace vfs
 }  // namespace xe
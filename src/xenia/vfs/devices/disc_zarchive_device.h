@@ -10,10 +10,18 @@
 #ifndef XENIA_VFS_DEVICES_DISC_ZARCHIVE_DEVICE_H_
 #define XENIA_VFS_DEVICES_DISC_ZARCHIVE_DEVICE_H_
 
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "xenia/base/mapped_memory.h"
+#include "xenia/base/threading.h"
 #include "xenia/vfs/device.h"
 
 #include "third_party/zarchive/include/zarchive/zarchivereader.h"
@@ -49,14 +57,68 @@ class DiscZarchiveDevice : public Device {
 
   ZArchiveReader* reader() const { return reader_.get(); }
 
+  // Reads from a file through the cache of decompressed blocks shared by all
+  // files of the archive. After sequential reads, the following blocks are
+  // decompressed in advance on the read-ahead thread. Returns the number of
+  // bytes read.
+  size_t ReadFile(const DiscZarchiveEntry* entry, size_t offset, size_t length,
+                  void* buffer, bool is_sequential);
+
  private:
+  // Files are cached in blocks of this size, which is also the size of the
+  // compressed blocks of ZArchive.
+  static constexpr uint32_t kCacheBlockSize = 64 * 1024;
+
+  struct CachedBlock {
+    uint64_t key;
+    std::vector<uint8_t> data;
+  };
+
+  struct ReadAheadRequest {
+    uint32_t handle;
+    uint64_t file_size;
+    uint64_t block_index;
+  };
+
+  static uint64_t GetCacheBlockKey(uint32_t handle, uint64_t block_index) {
+    return (uint64_t(handle) << 40) | block_index;
+  }
+
   bool ReadAllEntries(const std::string& path, DiscZarchiveEntry* node,
                       DiscZarchiveEntry* parent);
 
+  std::vector<uint8_t> DecompressBlock(uint32_t handle, uint64_t file_size,
+                                       uint64_t block_index);
+  // Copies from the block and marks it as the most recently used, returns
+  // false if it's not cached.
+  bool ReadCachedBlock(uint64_t key, size_t offset, size_t length,
+                       void* buffer);
+  void InsertCachedBlock(uint64_t key, std::vector<uint8_t>&& data);
+  void QueueReadAhead(uint32_t handle, uint64_t file_size,
+                      uint64_t first_block_index);
+  void ReadAheadThread();
+
   std::string name_;
   std::filesystem::path host_path_;
   std::unique_ptr<Entry> root_entry_;
   std::unique_ptr<ZArchiveReader> reader_;
+
+  size_t cache_capacity_blocks_ = 0;
+  std::mutex cache_mutex_;
+  // Most recently used first.
+  std::list<CachedBlock> cached_blocks_;
+  std::unordered_map<uint64_t, std::list<CachedBlock>::iterator>
+      cached_block_lookup_;
+  uint64_t cache_hit_count_ = 0;
+  uint64_t cache_miss_count_ = 0;
+  uint64_t read_ahead_block_count_ = 0;
+  uint64_t decompress_host_ticks_ = 0;
+
+  std::mutex read_ahead_mutex_;
+  std::condition_variable read_ahead_cv_;
+  std::deque<ReadAheadRequest> read_ahead_queue_;
+  bool read_ahead_shutdown_ = false;
+  std::unique_ptr<xe::threading::Thread> read_ahead_thread_;
 };
 
 }  // namespace vfs
@@ -31,13 +31,11 @@ X_STATUS DiscZarchiveFile::ReadSync(void* buffer, size_t buffer_length,
   if (byte_offset >= entry_->size()) {
     return X_STATUS_END_OF_FILE;
   }
-  const uint64_t bytes_read =
-      ((DiscZarchiveDevice*)entry_->device_)
-          ->reader()
-          ->ReadFromFile(entry_->handle_, byte_offset, buffer_length, buffer);
-  const size_t real_length =
-      std::min(buffer_length, entry_->data_size() - byte_offset);
-  *out_bytes_read = real_length;
+  bool is_sequential = byte_offset == next_sequential_offset_;
+  *out_bytes_read = ((DiscZarchiveDevice*)entry_->device_)
+                        ->ReadFile(entry_, byte_offset, buffer_length, buffer,
+                                   is_sequential);
+  next_sequential_offset_ = byte_offset + *out_bytes_read;
   return X_STATUS_SUCCESS;
 }
 
@@ -34,6 +34,8 @@ class DiscZarchiveFile : public File {
 
  private:
   DiscZarchiveEntry* entry_;
+  // Where the previous read has ended, for detecting sequential reads.
+  size_t next_sequential_offset_ = 0;
 };
 
 }  // namespace vfs
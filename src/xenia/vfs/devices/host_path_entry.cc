@@ -9,6 +9,10 @@
 
 #include "xenia/vfs/devices/host_path_entry.h"
 
+#include <algorithm>
+#include <vector>
+
+#include "xenia/base/cvar.h"
 #include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/mapped_memory.h"
@@ -18,6 +22,12 @@
 #include "xenia/vfs/devices/host_path_device.h"
 #include "xenia/vfs/devices/host_path_file.h"
 
+DEFINE_uint32(host_write_buffer_size, 64,
+              "Size in KB of the buffer collecting small sequential writes of "
+              "titles to host files, such as save data and cache partitions, "
+              "before passing them to the host. 0 to write directly.",
+              "Storage");
+
 namespace xe {
 namespace vfs {
 
@@ -73,6 +83,7 @@ X_STATUS HostPathEntry::Open(uint32_t desired_access, File** out_file) {
 std::unique_ptr<MappedMemory> HostPathEntry::OpenMapped(MappedMemory::Mode mode,
                                                         size_t offset,
                                                         size_t length) {
+  FlushWrites();
   return MappedMemory::Open(host_path_, mode, offset, length);
 }
 
@@ -123,6 +134,13 @@ void HostPathEntry::RenameEntryInternal(const std::filesystem::path file_path) {
 }
 
 void HostPathEntry::update() {
+  // Nothing can change the files of a read-only device through the guest, so
+  // the information gathered when the device has been populated is still
+  // valid, and the host filesystem doesn't need to be queried again.
+  if (device_->is_read_only()) {
+    return;
+  }
+  FlushWrites();
   xe::filesystem::FileInfo file_info;
   if (!xe::filesystem::GetInfo(host_path_, &file_info)) {
     return;
@@ -134,6 +152,87 @@ void HostPathEntry::update() {
   }
 }
 
+bool HostPathEntry::Write(xe::filesystem::FileHandle* file_handle,
+                          size_t offset, const void* buffer, size_t length,
+                          size_t* out_bytes_written) {
+  size_t capacity = size_t(cvars::host_write_buffer_size) * 1024;
+  std::lock_guard<std::mutex> lock(write_buffer_mutex_);
+  if (!write_buffer_.empty() &&
+      (file_handle != write_buffer_handle_ ||
+       offset != write_buffer_offset_ + write_buffer_.size() ||
+       write_buffer_.size() + length > capacity)) {
+    if (!FlushWritesLocked()) {
+      return false;
+    }
+  }
+  if (length >= capacity) {
+    return file_handle->Write(offset, buffer, length, out_bytes_written);
+  }
+  if (write_buffer_.empty()) {
+    write_buffer_handle_ = file_handle;
+    write_buffer_offset_ = offset;
+    write_buffer_.reserve(capacity);
+  }
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(buffer);
+  write_buffer_.insert(write_buffer_.end(), data, data + length);
+  *out_bytes_written = length;
+  if (write_buffer_.size() >= capacity) {
+    return FlushWritesLocked();
+  }
+  return true;
+}
+
+bool HostPathEntry::FlushWrites() {
+  std::lock_guard<std::mutex> lock(write_buffer_mutex_);
+  return FlushWritesLocked();
+}
+
+void HostPathEntry::CloseFileHandle(xe::filesystem::FileHandle* file_handle) {
+  std::lock_guard<std::mutex> lock(write_buffer_mutex_);
+  if (write_buffer_handle_ == file_handle) {
+    FlushWritesLocked();
+  }
+}
+
+bool HostPathEntry::FlushWritesLocked() {
+  if (write_buffer_.empty()) {
+    return true;
+  }
+  size_t bytes_written = 0;
+  bool is_written =
+      write_buffer_handle_->Write(write_buffer_offset_, write_buffer_.data(),
+                                  write_buffer_.size(), &bytes_written) &&
+      bytes_written == write_buffer_.size();
+  if (!is_written) {
+    XELOGE("Failed to write {} buffered bytes to {}", write_buffer_.size(),
+           xe::path_to_utf8(host_path_));
+  }
+  write_buffer_.clear();
+  write_buffer_handle_ = nullptr;
+  return is_written;
+}
+
+void HostPathEntry::Prefetch(size_t offset, size_t length) {
+  auto file_handle = xe::filesystem::FileHandle::OpenExisting(
+      host_path_, xe::filesystem::FileAccess::kGenericRead);
+  if (!file_handle) {
+    return;
+  }
+  // Read into a scratch buffer, the data itself stays in the page cache.
+  constexpr size_t kChunkSize = 1024 * 1024;
+  std::vector<uint8_t> buffer(std::min(length, kChunkSize));
+  while (length) {
+    size_t chunk_length = std::min(length, kChunkSize);
+    size_t bytes_read;
+    if (!file_handle->Read(offset, buffer.data(), chunk_length, &bytes_read) ||
+        !bytes_read) {
+      break;
+    }
+    offset += bytes_read;
+    length -= std::min(length, bytes_read);
+  }
+}
+
 bool HostPathEntry::SetAttributes(uint64_t attributes) {
   if (device_->is_read_only()) {
     return false;
@@ -10,7 +10,9 @@
 #ifndef XENIA_VFS_DEVICES_HOST_PATH_ENTRY_H_
 #define XENIA_VFS_DEVICES_HOST_PATH_ENTRY_H_
 
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "xenia/base/filesystem.h"
 #include "xenia/vfs/entry.h"
@@ -40,6 +42,19 @@ class HostPathEntry : public Entry {
                                            size_t offset,
                                            size_t length) override;
   void update() override;
+  void Prefetch(size_t offset, size_t length) override;
+
+  // Writes through the handle of one of the open files. Small sequential
+  // writes are collected in a buffer shared by all the handles of the file,
+  // and only passed to the host when it's full, or when the file is read,
+  // queried, resized, flushed or closed. As the guest is told about the
+  // success of buffered writes right away, host failures only reach it if
+  // they happen in a direct write.
+  bool Write(xe::filesystem::FileHandle* file_handle, size_t offset,
+             const void* buffer, size_t length, size_t* out_bytes_written);
+  bool FlushWrites();
+  // Flushes the buffered writes if they're from the handle being closed.
+  void CloseFileHandle(xe::filesystem::FileHandle* file_handle);
 
   bool SetAttributes(uint64_t attributes) override;
   bool SetCreateTimestamp(uint64_t timestamp) override;
@@ -54,7 +69,15 @@ class HostPathEntry : public Entry {
   bool DeleteEntryInternal(Entry* entry) override;
   void RenameEntryInternal(const std::filesystem::path file_path) override;
 
+  // Must be called with the write buffer mutex held.
+  bool FlushWritesLocked();
+
   std::filesystem::path host_path_;
+
+  std::mutex write_buffer_mutex_;
+  xe::filesystem::FileHandle* write_buffer_handle_ = nullptr;
+  size_t write_buffer_offset_ = 0;
+  std::vector<uint8_t> write_buffer_;
 };
 
 }  // namespace vfs
@@ -21,7 +21,14 @@ HostPathFile::HostPathFile(
 
 HostPathFile::~HostPathFile() = default;
 
+HostPathEntry* HostPathFile::host_entry() const {
+  return static_cast<HostPathEntry*>(entry_);
+}
+
 void HostPathFile::Destroy() {
+  if (entry_) {
+    host_entry()->CloseFileHandle(file_handle_.get());
+  }
   if (entry_ && entry_->delete_on_close()) {
     entry()->Delete();
   }
@@ -35,6 +42,7 @@ X_STATUS HostPathFile::ReadSync(void* buffer, size_t buffer_length,
     return X_STATUS_ACCESS_DENIED;
   }
 
+  host_entry()->FlushWrites();
   if (file_handle_->Read(byte_offset, buffer, buffer_length, out_bytes_read)) {
     return X_STATUS_SUCCESS;
   } else {
@@ -42,6 +50,23 @@ X_STATUS HostPathFile::ReadSync(void* buffer, size_t buffer_length,
   }
 }
 
+X_STATUS HostPathFile::ReadScatterSync(
+    const xe::filesystem::ScatterBuffer* buffers, size_t buffer_count,
+    size_t byte_offset, size_t* out_bytes_read) {
+  if (!(file_access_ &
+        (FileAccess::kGenericRead | FileAccess::kFileReadData))) {
+    return X_STATUS_ACCESS_DENIED;
+  }
+
+  host_entry()->FlushWrites();
+  if (file_handle_->ReadScatter(byte_offset, buffers, buffer_count,
+                                out_bytes_read)) {
+    return X_STATUS_SUCCESS;
+  } else {
+    return X_STATUS_END_OF_FILE;
+  }
+}
+
 X_STATUS HostPathFile::WriteSync(const void* buffer, size_t buffer_length,
                                  size_t byte_offset,
                                  size_t* out_bytes_written) {
@@ -50,20 +75,28 @@ X_STATUS HostPathFile::WriteSync(const void* buffer, size_t buffer_length,
     return X_STATUS_ACCESS_DENIED;
   }
 
-  if (file_handle_->Write(byte_offset, buffer, buffer_length,
-                          out_bytes_written)) {
+  if (host_entry()->Write(file_handle_.get(), byte_offset, buffer,
+                          buffer_length, out_bytes_written)) {
     return X_STATUS_SUCCESS;
   } else {
     return X_STATUS_END_OF_FILE;
   }
 }
 
+X_STATUS HostPathFile::Flush() {
+  if (!host_entry()->FlushWrites()) {
+    return X_STATUS_UNSUCCESSFUL;
+  }
+  return X_STATUS_SUCCESS;
+}
+
 X_STATUS HostPathFile::SetLength(size_t length) {
   if (!(file_access_ &
         (FileAccess::kGenericWrite | FileAccess::kFileWriteData))) {
     return X_STATUS_ACCESS_DENIED;
   }
 
+  host_entry()->FlushWrites();
   if (file_handle_->SetLength(length)) {
     return X_STATUS_SUCCESS;
   } else {
@@ -131,7 +131,19 @@ void XContentContainerDevice::Dump(StringBuffer* string_buffer) {
   root_entry_->Dump(string_buffer, 0);
 }
 
+void XContentContainerDevice::MapHostFile(size_t index,
+                                          const std::filesystem::path& path) {
+  auto mapping = MappedMemory::Open(path, MappedMemory::Mode::kRead);
+  if (!mapping) {
+    XELOGW("Failed to map XContent file {}, reading it through stdio",
+           xe::path_to_utf8(path));
+    return;
+  }
+  mapped_files_[index] = std::move(mapping);
+}
+
 void XContentContainerDevice::CloseFiles() {
+  mapped_files_.clear();
   for (auto& file : files_) {
     fclose(file.second);
   }
@@ -19,6 +19,7 @@
 #include "xenia/kernel/xam/content_manager.h"
 #include "xenia/vfs/device.h"
 #include "xenia/vfs/devices/stfs_xbox.h"
+#include "xenia/vfs/devices/xcontent_container_entry.h"
 
 namespace xe {
 namespace vfs {
@@ -88,6 +89,9 @@ class XContentContainerDevice : public Device {
   virtual void SetupContainer() {};
 
   Entry* ResolvePath(const std::string_view path);
+  // Maps the host file opened as files_[index] so file data is read without
+  // going through stdio. stdio is still used if mapping fails.
+  void MapHostFile(size_t index, const std::filesystem::path& path);
   void CloseFiles();
   void Dump(StringBuffer* string_buffer);
   Result ReadHeaderAndVerify(FILE* header_file);
@@ -107,7 +111,8 @@ class XContentContainerDevice : public Device {
   std::string name_;
   std::filesystem::path host_path_;
 
-  std::map<size_t, FILE*> files_;
+  MultiFileHandles files_;
+  MultiFileMappings mapped_files_;
   size_t files_total_size_;
   std::unique_ptr<Entry> root_entry_;
   std::unique_ptr<XContentContainerHeader> header_;
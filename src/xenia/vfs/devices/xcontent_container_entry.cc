@@ -10,17 +10,22 @@
 #include "xenia/vfs/devices/xcontent_container_entry.h"
 #include "xenia/vfs/devices/xcontent_container_file.h"
 
+#include <algorithm>
 #include <map>
 
+#include "xenia/base/memory.h"
+
 namespace xe {
 namespace vfs {
 
 XContentContainerEntry::XContentContainerEntry(Device* device, Entry* parent,
                                                const std::string_view path,
                                                const std::string_view name,
-                                               MultiFileHandles* files)
+                                               MultiFileHandles* files,
+                                               MultiFileMappings* mappings)
     : Entry(device, parent, path, name),
       files_(files),
+      mappings_(mappings),
       data_offset_(0),
       data_size_(0),
       block_(0) {}
@@ -29,10 +34,10 @@ XContentContainerEntry::~XContentContainerEntry() = default;
 
 std::unique_ptr<XContentContainerEntry> XContentContainerEntry::Create(
     Device* device, Entry* parent, const std::string_view name,
-    MultiFileHandles* files) {
+    MultiFileHandles* files, MultiFileMappings* mappings) {
   auto path = xe::utf8::join_guest_paths(parent->path(), name);
   auto entry = std::make_unique<XContentContainerEntry>(device, parent, path,
-                                                        name, files);
+                                                        name, files, mappings);
 
   return std::move(entry);
 }
@@ -43,5 +48,62 @@ X_STATUS XContentContainerEntry::Open(uint32_t desired_access,
   return X_STATUS_SUCCESS;
 }
 
+bool XContentContainerEntry::can_map() const {
+  if (block_list_.size() != 1) {
+    return false;
+  }
+  const BlockRecord& record = block_list_.front();
+  MappedMemory* file_mapping = mapping(record.file);
+  return file_mapping && record.length >= size_ &&
+         record.offset + size_ <= file_mapping->size();
+}
+
+std::unique_ptr<MappedMemory> XContentContainerEntry::OpenMapped(
+    MappedMemory::Mode mode, size_t offset, size_t length) {
+  if (mode != MappedMemory::Mode::kRead || !can_map() || offset > size_) {
+    return nullptr;
+  }
+  const BlockRecord& record = block_list_.front();
+  size_t real_length =
+      length ? std::min(length, size_ - offset) : size_ - offset;
+  return mapping(record.file)->Slice(record.offset + offset, real_length);
+}
+
+void XContentContainerEntry::IndexBlockList() {
+  block_record_ends_.clear();
+  block_record_ends_.reserve(block_list_.size());
+  size_t record_end = 0;
+  for (const BlockRecord& record : block_list_) {
+    record_end += record.length;
+    block_record_ends_.push_back(record_end);
+  }
+}
+
+size_t XContentContainerEntry::FindBlockRecord(size_t byte_offset) const {
+  return size_t(std::upper_bound(block_record_ends_.cbegin(),
+                                 block_record_ends_.cend(), byte_offset) -
+                block_record_ends_.cbegin());
+}
+
+void XContentContainerEntry::Prefetch(size_t offset, size_t length) {
+  for (size_t i = FindBlockRecord(offset); i < block_list_.size(); ++i) {
+    const BlockRecord& record = block_list_[i];
+    size_t record_start = GetBlockRecordStart(i);
+    size_t record_end = block_record_ends_[i];
+    if (record_end > offset && record_start < offset + length) {
+      MappedMemory* file_mapping = mapping(record.file);
+      size_t start = std::max(offset, record_start) - record_start;
+      size_t end = std::min(offset + length, record_end) - record_start;
+      if (file_mapping && record.offset + end <= file_mapping->size()) {
+        xe::memory::AdviseWillNeed(file_mapping->data() + record.offset + start,
+                                   end - start);
+      }
+    }
+    if (record_end >= offset + length) {
+      break;
+    }
+  }
+}
+
 }  // namespace vfs
 }  // namespace xe
\ No newline at end of file
@@ -11,15 +11,19 @@
 #define XENIA_VFS_DEVICES_XCONTENT_CONTAINER_ENTRY_H_
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "xenia/base/mapped_memory.h"
 #include "xenia/vfs/entry.h"
 #include "xenia/vfs/file.h"
 
 namespace xe {
 namespace vfs {
 typedef std::map<size_t, FILE*> MultiFileHandles;
+// Read-only mappings of the same host files, for the ones that could be mapped.
+typedef std::map<size_t, std::unique_ptr<MappedMemory>> MultiFileMappings;
 
 class XContentContainerDevice;
 
@@ -27,36 +31,64 @@ class XContentContainerEntry : public Entry {
  public:
   XContentContainerEntry(Device* device, Entry* parent,
                          const std::string_view path,
-                         const std::string_view name, MultiFileHandles* files);
+                         const std::string_view name, MultiFileHandles* files,
+                         MultiFileMappings* mappings);
   ~XContentContainerEntry() override;
 
   static std::unique_ptr<XContentContainerEntry> Create(
       Device* device, Entry* parent, const std::string_view name,
-      MultiFileHandles* files);
+      MultiFileHandles* files, MultiFileMappings* mappings);
 
   MultiFileHandles* files() const { return files_; }
+  // Mapping of the host file, or nullptr if it couldn't be mapped.
+  MappedMemory* mapping(size_t file) const {
+    auto it = mappings_->find(file);
+    return it != mappings_->end() ? it->second.get() : nullptr;
+  }
   size_t data_offset() const { return data_offset_; }
   size_t data_size() const { return data_size_; }
   size_t block() const { return block_; }
 
   X_STATUS Open(uint32_t desired_access, File** out_file) override;
 
+  // Only files stored contiguously in a mapped host file can be mapped.
+  bool can_map() const override;
+  std::unique_ptr<MappedMemory> OpenMapped(MappedMemory::Mode mode,
+                                           size_t offset,
+                                           size_t length) override;
+  void Prefetch(size_t offset, size_t length) override;
+
   struct BlockRecord {
     size_t file;
     size_t offset;
     size_t length;
   };
   const std::vector<BlockRecord>& block_list() const { return block_list_; }
+  // Index of the block record containing the offset in the file data, or the
+  // number of records if it's past the end.
+  size_t FindBlockRecord(size_t byte_offset) const;
+  // Offset in the file data where the block record starts.
+  size_t GetBlockRecordStart(size_t record_index) const {
+    return record_index ? block_record_ends_[record_index - 1] : 0;
+  }
 
  private:
   friend class StfsContainerDevice;
   friend class SvodContainerDevice;
 
   MultiFileHandles* files_;
+  MultiFileMappings* mappings_;
   size_t data_offset_;
   size_t data_size_;
   size_t block_;
   std::vector<BlockRecord> block_list_;
+  // Offset in the file data where every block record ends, for looking up
+  // the records with a binary search rather than walking the whole list for
+  // every read of a large file. Built by IndexBlockList once block_list_ is
+  // filled.
+  std::vector<size_t> block_record_ends_;
+
+  void IndexBlockList();
 };
 
 }  // namespace vfs
@@ -9,6 +9,8 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <mutex>
 
 #include "xenia/base/math.h"
 #include "xenia/vfs/devices/xcontent_container_entry.h"
@@ -17,6 +19,10 @@
 namespace xe {
 namespace vfs {
 
+// The stdio handles of the containers are shared by all their files, so
+// seeking and reading must not be interleaved with other threads.
+static std::mutex stdio_read_mutex;
+
 XContentContainerFile::XContentContainerFile(uint32_t file_access,
                                              XContentContainerEntry* entry)
     : File(file_access, entry), entry_(entry) {}
@@ -32,28 +38,36 @@ X_STATUS XContentContainerFile::ReadSync(void* buffer, size_t buffer_length,
     return X_STATUS_END_OF_FILE;
   }
 
-  size_t src_offset = 0;
   uint8_t* p = reinterpret_cast<uint8_t*>(buffer);
   size_t remaining_length =
       std::min(buffer_length, entry_->size() - byte_offset);
 
   *out_bytes_read = 0;
-  for (size_t i = 0; i < entry_->block_list().size(); i++) {
+  size_t first_record = entry_->FindBlockRecord(byte_offset);
+  size_t src_offset = entry_->GetBlockRecordStart(first_record);
+  for (size_t i = first_record; i < entry_->block_list().size(); i++) {
     auto& record = entry_->block_list()[i];
-    if (src_offset + record.length <= byte_offset) {
-      // Doesn't begin in this region. Skip it.
-      src_offset += record.length;
-      continue;
-    }
-
     size_t read_offset =
         (byte_offset > src_offset) ? byte_offset - src_offset : 0;
     size_t read_length =
         std::min(record.length - read_offset, remaining_length);
 
-    auto& file = entry_->files()->at(record.file);
-    xe::filesystem::Seek(file, record.offset + read_offset, SEEK_SET);
-    auto num_read = fread(p, 1, read_length, file);
+    size_t num_read;
+    MappedMemory* mapping = entry_->mapping(record.file);
+    if (mapping) {
+      // Copied directly, also without sharing the file position between the
+      // threads reading from the container.
+      size_t file_offset = record.offset + read_offset;
+      num_read = file_offset < mapping->size()
+                     ? std::min(read_length, mapping->size() - file_offset)
+                     : 0;
+      std::memcpy(p, mapping->data() + file_offset, num_read);
+    } else {
+      auto& file = entry_->files()->at(record.file);
+      std::lock_guard<std::mutex> lock(stdio_read_mutex);
+      xe::filesystem::Seek(file, record.offset + read_offset, SEEK_SET);
+      num_read = fread(p, 1, read_length, file);
+    }
 
     *out_bytes_read += num_read;
     p += num_read;
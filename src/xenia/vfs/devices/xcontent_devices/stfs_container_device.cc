@@ -8,16 +8,62 @@
  */
 
 #include <algorithm>
+#include <cstring>
+#include <system_error>
 #include <vector>
 
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/kernel/xam/content_manager.h"
 #include "xenia/vfs/devices/xcontent_container_entry.h"
 #include "xenia/vfs/devices/xcontent_devices/stfs_container_device.h"
 
+DEFINE_bool(stfs_index_cache, true,
+            "Store the parsed file table of STFS packages in a .index file "
+            "next to the package for faster mounting the next time.",
+            "Storage");
+
 namespace xe {
 namespace vfs {
 
+namespace {
+
+constexpr fourcc_t kStfsIndexSignature = make_fourcc("XSIX");
+constexpr uint32_t kStfsIndexVersion = 1;
+
+struct StfsIndexHeader {
+  fourcc_t signature;
+  uint32_t version;
+  // The index is discarded if the package has been modified.
+  uint64_t package_size;
+  int64_t package_write_time;
+  uint8_t volume_descriptor[sizeof(StfsVolumeDescriptor)];
+  uint32_t entry_count;
+};
+
+// Followed by the name and the block records of the entry. Parents are always
+// stored before their children.
+struct StfsIndexEntry {
+  // UINT32_MAX for the children of the root.
+  uint32_t parent_index;
+  uint32_t attributes;
+  uint64_t size;
+  uint64_t data_offset;
+  uint64_t create_timestamp;
+  uint64_t access_timestamp;
+  uint64_t write_timestamp;
+  uint32_t name_length;
+  uint32_t block_record_count;
+};
+
+struct StfsIndexBlockRecord {
+  uint64_t offset;
+  uint64_t length;
+};
+
+}  // namespace
+
 StfsContainerDevice::StfsContainerDevice(const std::string_view mount_path,
                                          const std::filesystem::path& host_path)
     : XContentContainerDevice(mount_path, host_path),
@@ -47,16 +93,22 @@ XContentContainerDevice::Result StfsContainerDevice::LoadHostFiles(
   }
 
   files_.emplace(std::make_pair(0, header_file));
+  MapHostFile(0, host_path_);
   return Result::kSuccess;
 }
 
 StfsContainerDevice::Result StfsContainerDevice::Read() {
   auto& file = files_.at(0);
 
-  auto root_entry = new XContentContainerEntry(this, nullptr, "", "", &files_);
+  auto root_entry = new XContentContainerEntry(this, nullptr, "", "", &files_,
+                                               &mapped_files_);
   root_entry->attributes_ = kFileAttributeDirectory;
   root_entry_ = std::unique_ptr<Entry>(root_entry);
 
+  if (cvars::stfs_index_cache && LoadIndexCache(root_entry)) {
+    return Result::kSuccess;
+  }
+
   std::vector<XContentContainerEntry*> all_entries;
 
   // Load all listings.
@@ -107,9 +159,173 @@ StfsContainerDevice::Result StfsContainerDevice::Read() {
     assert_always();
   }
 
+  if (cvars::stfs_index_cache) {
+    StoreIndexCache();
+  }
+
   return Result::kSuccess;
 }
 
+std::filesystem::path StfsContainerDevice::GetIndexCachePath() const {
+  std::filesystem::path index_path = host_path_;
+  index_path += ".index";
+  return index_path;
+}
+
+static bool GetPackageFileState(const std::filesystem::path& path,
+                                uint64_t& size, int64_t& write_time) {
+  std::error_code error;
+  size = std::filesystem::file_size(path, error);
+  if (error) {
+    return false;
+  }
+  write_time = int64_t(
+      std::filesystem::last_write_time(path, error).time_since_epoch().count());
+  return !error;
+}
+
+bool StfsContainerDevice::LoadIndexCache(XContentContainerEntry* root_entry) {
+  FILE* file = xe::filesystem::OpenFile(GetIndexCachePath(), "rb");
+  if (!file) {
+    return false;
+  }
+  const StfsVolumeDescriptor& descriptor =
+      GetContainerHeader()->content_metadata.volume_descriptor.stfs;
+  StfsIndexHeader header;
+  uint64_t package_size;
+  int64_t package_write_time;
+  bool loaded =
+      fread(&header, sizeof(header), 1, file) == 1 &&
+      header.signature == kStfsIndexSignature &&
+      header.version == kStfsIndexVersion &&
+      GetPackageFileState(host_path_, package_size, package_write_time) &&
+      header.package_size == package_size &&
+      header.package_write_time == package_write_time &&
+      !std::memcmp(header.volume_descriptor, &descriptor,
+                   sizeof(header.volume_descriptor));
+  std::vector<XContentContainerEntry*> all_entries;
+  std::string name;
+  for (uint32_t i = 0; loaded && i < header.entry_count; ++i) {
+    StfsIndexEntry index_entry;
+    if (fread(&index_entry, sizeof(index_entry), 1, file) != 1 ||
+        (index_entry.parent_index != UINT32_MAX &&
+         index_entry.parent_index >= all_entries.size()) ||
+        index_entry.name_length > 0xFF ||
+        index_entry.block_record_count > descriptor.total_block_count) {
+      loaded = false;
+      break;
+    }
+    name.resize(index_entry.name_length);
+    if (fread(name.data(), 1, name.size(), file) != name.size()) {
+      loaded = false;
+      break;
+    }
+    XContentContainerEntry* parent_entry =
+        index_entry.parent_index == UINT32_MAX
+            ? root_entry
+            : all_entries[index_entry.parent_index];
+    auto entry = XContentContainerEntry::Create(this, parent_entry, name,
+                                                &files_, &mapped_files_);
+    entry->attributes_ = index_entry.attributes;
+    entry->size_ = size_t(index_entry.size);
+    entry->allocation_size_ = xe::round_up(entry->size_, size_t(kBlockSize));
+    entry->data_offset_ = size_t(index_entry.data_offset);
+    entry->data_size_ =
+        (entry->attributes_ & kFileAttributeDirectory) ? 0 : entry->size_;
+    entry->create_timestamp_ = index_entry.create_timestamp;
+    entry->access_timestamp_ = index_entry.access_timestamp;
+    entry->write_timestamp_ = index_entry.write_timestamp;
+    entry->block_list_.reserve(index_entry.block_record_count);
+    for (uint32_t j = 0; j < index_entry.block_record_count; ++j) {
+      StfsIndexBlockRecord record;
+      if (fread(&record, sizeof(record), 1, file) != 1) {
+        loaded = false;
+        break;
+      }
+      entry->block_list_.push_back(
+          {0, size_t(record.offset), size_t(record.length)});
+    }
+    entry->IndexBlockList();
+    all_entries.push_back(entry.get());
+    parent_entry->children_.emplace_back(std::move(entry));
+  }
+  fclose(file);
+  if (!loaded) {
+    XELOGW("Discarding the outdated or invalid STFS index {}",
+           xe::path_to_utf8(GetIndexCachePath()));
+    root_entry->children_.clear();
+    return false;
+  }
+  XELOGI("Loaded {} STFS entries from the index", all_entries.size());
+  return true;
+}
+
+void StfsContainerDevice::StoreIndexCache() const {
+  StfsIndexHeader header = {};
+  header.signature = kStfsIndexSignature;
+  header.version = kStfsIndexVersion;
+  if (!GetPackageFileState(host_path_, header.package_size,
+                           header.package_write_time)) {
+    return;
+  }
+  std::memcpy(header.volume_descriptor,
+              &GetContainerHeader()->content_metadata.volume_descriptor.stfs,
+              sizeof(header.volume_descriptor));
+
+  // Flattened with the children of every directory stored together.
+  std::vector<std::pair<const XContentContainerEntry*, uint32_t>> entries;
+  std::vector<std::pair<const Entry*, uint32_t>> pending = {
+      {root_entry_.get(), UINT32_MAX}};
+  while (!pending.empty()) {
+    auto [parent_entry, parent_index] = pending.back();
+    pending.pop_back();
+    uint32_t first_child_index = uint32_t(entries.size());
+    for (const auto& child : parent_entry->children()) {
+      entries.emplace_back(
+          static_cast<const XContentContainerEntry*>(child.get()),
+          parent_index);
+    }
+    // Reversed so the children are visited in their order.
+    for (uint32_t i = uint32_t(entries.size()); i > first_child_index; --i) {
+      if (!entries[i - 1].first->children().empty()) {
+        pending.emplace_back(entries[i - 1].first, i - 1);
+      }
+    }
+  }
+  header.entry_count = uint32_t(entries.size());
+
+  std::filesystem::path index_path = GetIndexCachePath();
+  FILE* file = xe::filesystem::OpenFile(index_path, "wb");
+  if (!file) {
+    return;
+  }
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+  for (size_t i = 0; written && i < entries.size(); ++i) {
+    const XContentContainerEntry* entry = entries[i].first;
+    StfsIndexEntry index_entry = {};
+    index_entry.parent_index = entries[i].second;
+    index_entry.attributes = entry->attributes();
+    index_entry.size = entry->size();
+    index_entry.data_offset = entry->data_offset();
+    index_entry.create_timestamp = entry->create_timestamp();
+    index_entry.access_timestamp = entry->access_timestamp();
+    index_entry.write_timestamp = entry->write_timestamp();
+    index_entry.name_length = uint32_t(entry->name().size());
+    index_entry.block_record_count = uint32_t(entry->block_list().size());
+    written = fwrite(&index_entry, sizeof(index_entry), 1, file) == 1 &&
+              fwrite(entry->name().data(), 1, entry->name().size(), file) ==
+                  entry->name().size();
+    for (const auto& block_record : entry->block_list()) {
+      StfsIndexBlockRecord record = {block_record.offset, block_record.length};
+      written = written && fwrite(&record, sizeof(record), 1, file) == 1;
+    }
+  }
+  fclose(file);
+  if (!written) {
+    std::filesystem::remove(index_path);
+  }
+}
+
 std::unique_ptr<XContentContainerEntry> StfsContainerDevice::ReadEntry(
     Entry* parent, MultiFileHandles* files,
     const StfsDirectoryEntry* dir_entry) {
@@ -118,7 +334,8 @@ std::unique_ptr<XContentContainerEntry> StfsContainerDevice::ReadEntry(
                         dir_entry->flags.name_length & 0x3F);
   std::string name = xe::win1252_to_utf8(ansi_name);
 
-  auto entry = XContentContainerEntry::Create(this, parent, name, &files_);
+  auto entry = XContentContainerEntry::Create(this, parent, name, &files_,
+                                              &mapped_files_);
 
   if (dir_entry->flags.directory) {
     entry->attributes_ = kFileAttributeDirectory;
@@ -143,15 +360,27 @@ std::unique_ptr<XContentContainerEntry> StfsContainerDevice::ReadEntry(
   if (entry->attributes() & X_FILE_ATTRIBUTE_NORMAL) {
     uint32_t block_index = dir_entry->start_block_number();
     size_t remaining_size = dir_entry->length;
+    uint32_t block_count = 0;
     while (remaining_size && block_index != kEndOfChain) {
       size_t block_size =
           std::min(static_cast<size_t>(kBlockSize), remaining_size);
       size_t offset = BlockToOffset(block_index);
-      entry->block_list_.push_back({0, offset, block_size});
+      // Blocks not separated by a hash table are consecutive in the file, so
+      // they're read with one copy.
+      if (!entry->block_list_.empty() &&
+          entry->block_list_.back().offset +
+                  entry->block_list_.back().length ==
+              offset) {
+        entry->block_list_.back().length += block_size;
+      } else {
+        entry->block_list_.push_back({0, offset, block_size});
+      }
+      ++block_count;
       remaining_size -= block_size;
       auto block_hash = GetBlockHash(block_index);
       block_index = block_hash->level0_next_block();
     }
+    entry->IndexBlockList();
 
     if (remaining_size) {
       // Loop above must have exited prematurely, bad hash tables?
@@ -165,12 +394,11 @@ std::unique_ptr<XContentContainerEntry> StfsContainerDevice::ReadEntry(
 
     // Check that the number of blocks retrieved from hash entries matches
     // the block count read from the file entry
-    if (entry->block_list_.size() != dir_entry->allocated_data_blocks()) {
+    if (block_count != dir_entry->allocated_data_blocks()) {
       XELOGW(
           "STFS failed to read correct block-chain for entry {}, read {} "
           "blocks, expected {}",
-          entry->name_, entry->block_list_.size(),
-          dir_entry->allocated_data_blocks());
+          entry->name_, block_count, dir_entry->allocated_data_blocks());
       assert_always();
     }
   }
@@ -248,12 +476,25 @@ void StfsContainerDevice::UpdateCachedHashTable(
   const size_t hash_offset = BlockToHashBlockOffset(block_index, hash_level);
   // Do nothing. It's already there.
   if (!cached_hash_tables_.count(hash_offset)) {
-    auto& file = files_.at(0);
-    xe::filesystem::Seek(file, hash_offset + secondary_table_offset, SEEK_SET);
+    const size_t table_offset = hash_offset + secondary_table_offset;
     StfsHashTable table;
-    if (fread(&table, sizeof(StfsHashTable), 1, file) != 1) {
+    bool is_read;
+    auto mapping = mapped_files_.find(0);
+    if (mapping != mapped_files_.end()) {
+      is_read =
+          table_offset + sizeof(StfsHashTable) <= mapping->second->size();
+      if (is_read) {
+        std::memcpy(&table, mapping->second->data() + table_offset,
+                    sizeof(StfsHashTable));
+      }
+    } else {
+      auto& file = files_.at(0);
+      xe::filesystem::Seek(file, table_offset, SEEK_SET);
+      is_read = fread(&table, sizeof(StfsHashTable), 1, file) == 1;
+    }
+    if (!is_read) {
       XELOGE("GetBlockHash failed to read level{} hash table at 0x{:08X}",
-             hash_level, hash_offset + secondary_table_offset);
+             hash_level, table_offset);
       return;
     }
     cached_hash_tables_[hash_offset] = table;
@@ -64,6 +64,12 @@ class StfsContainerDevice : public XContentContainerDevice {
   Result LoadHostFiles(FILE* header_file) override;
 
   Result Read() override;
+  // The file table with the block lists of all files, stored next to the
+  // package after it has been parsed, so the directory blocks and the hash
+  // tables don't have to be walked again when it's mounted the next time.
+  std::filesystem::path GetIndexCachePath() const;
+  bool LoadIndexCache(XContentContainerEntry* root_entry);
+  void StoreIndexCache() const;
   std::unique_ptr<XContentContainerEntry> ReadEntry(
       Entry* parent, MultiFileHandles* files,
       const StfsDirectoryEntry* dir_entry);
@@ -65,6 +65,7 @@ SvodContainerDevice::Result SvodContainerDevice::LoadHostFiles(
     files_total_size_ += xe::filesystem::Tell(file);
     // no need to seek back, any reads from this file will seek first anyway
     files_.emplace(std::make_pair(i, file));
+    MapHostFile(i, path);
   }
   XELOGI("SVOD successfully mapped {} files.", fragment_files.size());
   return Result::kSuccess;
@@ -99,7 +100,8 @@ XContentContainerDevice::Result SvodContainerDevice::Read() {
   const uint64_t root_creation_timestamp =
       decode_fat_timestamp(root_data.creation_date, root_data.creation_time);
 
-  auto root_entry = new XContentContainerEntry(this, nullptr, "", "", &files_);
+  auto root_entry = new XContentContainerEntry(this, nullptr, "", "", &files_,
+                                               &mapped_files_);
   root_entry->attributes_ = kFileAttributeDirectory;
   root_entry->access_timestamp_ = root_creation_timestamp;
   root_entry->create_timestamp_ = root_creation_timestamp;
@@ -173,7 +175,8 @@ SvodContainerDevice::Result SvodContainerDevice::ReadEntry(
   // NOTE: SVOD entries don't have timestamps for individual files, which can
   //       cause issues when decrypting games. Using the root entry's timestamp
   //       solves this issues.
-  auto entry = XContentContainerEntry::Create(this, parent, name, &files_);
+  auto entry = XContentContainerEntry::Create(this, parent, name, &files_,
+                                              &mapped_files_);
   if (dir_entry.attributes & kFileAttributeDirectory) {
     // Entry is a directory
     entry->attributes_ = kFileAttributeDirectory | kFileAttributeReadOnly;
@@ -230,6 +233,7 @@ SvodContainerDevice::Result SvodContainerDevice::ReadEntry(
         last_record = entry->block_list_.size() - 1;
         last_offset = offset;
       }
+      entry->IndexBlockList();
     }
   }
 
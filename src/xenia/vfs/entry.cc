@@ -28,7 +28,8 @@ Entry::Entry(Device* device, Entry* parent, const std::string_view path,
       create_timestamp_(0),
       access_timestamp_(0),
       write_timestamp_(0),
-      delete_on_close_(false) {
+      delete_on_close_(false),
+      child_index_count_(0) {
   assert_not_null(device);
   absolute_path_ = xe::utf8::join_guest_paths(device->mount_path(), path);
 }
@@ -49,7 +50,28 @@ void Entry::Dump(xe::StringBuffer* string_buffer, int indent) {
 bool Entry::is_read_only() const { return device_->is_read_only(); }
 
 Entry* Entry::GetChild(const std::string_view name) {
+  // Below this, comparing all the names is cheaper than hashing.
+  constexpr size_t kMinIndexedChildCount = 16;
   auto global_lock = global_critical_region_.Acquire();
+  if (children_.size() >= kMinIndexedChildCount) {
+    if (child_index_count_ != children_.size()) {
+      child_index_.clear();
+      child_index_.reserve(children_.size());
+      for (size_t i = 0; i < children_.size(); ++i) {
+        child_index_.emplace(xe::utf8::hash_fnv1a_case(children_[i]->name()),
+                             i);
+      }
+      child_index_count_ = children_.size();
+    }
+    auto range = child_index_.equal_range(xe::utf8::hash_fnv1a_case(name));
+    for (auto it = range.first; it != range.second; ++it) {
+      Entry* child = children_[it->second].get();
+      if (xe::utf8::equal_case(child->name(), name)) {
+        return child;
+      }
+    }
+    return nullptr;
+  }
   auto it = std::find_if(children_.cbegin(), children_.cend(),
                          [&](const auto& child) {
                            return xe::utf8::equal_case(child->name(), name);
@@ -100,6 +122,7 @@ Entry* Entry::CreateEntry(const std::string_view name, uint32_t attributes) {
     return nullptr;
   }
   children_.push_back(std::move(entry));
+  InvalidateChildIndex();
   // TODO(benvanik): resort? would break iteration?
   Touch();
   return children_.back().get();
@@ -119,6 +142,7 @@ bool Entry::Delete(Entry* entry) {
   for (auto it = children_.begin(); it != children_.end(); ++it) {
     if (it->get() == entry) {
       children_.erase(it);
+      InvalidateChildIndex();
       break;
     }
   }
@@ -131,6 +155,11 @@ bool Entry::Delete() {
   return parent_->Delete(this);
 }
 
+void Entry::InvalidateChildIndex() {
+  child_index_.clear();
+  child_index_count_ = 0;
+}
+
 void Entry::Touch() {
   // TODO(benvanik): update timestamps.
 }
@@ -150,6 +179,10 @@ void Entry::Rename(const std::filesystem::path file_path) {
                                               guest_path_without_root);
   path_ = guest_path_without_root;
   name_ = xe::path_to_utf8(file_path.filename());
+  if (parent_) {
+    auto global_lock = global_critical_region_.Acquire();
+    parent_->InvalidateChildIndex();
+  }
 }
 
 }  // namespace vfs
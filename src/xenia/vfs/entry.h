@@ -12,6 +12,7 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "xenia/base/filesystem.h"
@@ -132,6 +133,10 @@ class Entry {
     return nullptr;
   }
   virtual void update() { return; }
+  // Starts loading the range of the file from the host storage in the
+  // background or, if that's not possible, reads it on the calling thread,
+  // without returning the data.
+  virtual void Prefetch(size_t offset, size_t length) {}
 
  protected:
   Entry(Device* device, Entry* parent, const std::string_view path,
@@ -144,6 +149,8 @@ class Entry {
   virtual bool DeleteEntryInternal(Entry* entry) { return false; }
   virtual void RenameEntryInternal(const std::filesystem::path file_path) {}
 
+  void InvalidateChildIndex();
+
   xe::global_critical_region global_critical_region_;
   Device* device_;
   Entry* parent_;
@@ -158,6 +165,12 @@ class Entry {
   uint64_t write_timestamp_;
   bool delete_on_close_;
   std::vector<std::unique_ptr<Entry>> children_;
+  // Case-insensitive hashes of the names of the children to their indices in
+  // children_, built on the first lookup in a large enough directory. The
+  // devices add the children directly, so the index is also rebuilt whenever
+  // the child count differs from the one it has been built for.
+  std::unordered_multimap<size_t, size_t> child_index_;
+  size_t child_index_count_;
 };
 
 }  // namespace vfs
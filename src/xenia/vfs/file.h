@@ -12,6 +12,7 @@
 
 #include <cstdint>
 
+#include "xenia/base/filesystem.h"
 #include "xenia/xbox.h"
 
 namespace xe {
@@ -32,6 +33,28 @@ class File {
   virtual X_STATUS WriteSync(const void* buffer, size_t buffer_length,
                              size_t byte_offset, size_t* out_bytes_written) = 0;
 
+  // Reads into the buffers in order, as if they were one contiguous buffer.
+  virtual X_STATUS ReadScatterSync(const xe::filesystem::ScatterBuffer* buffers,
+                                   size_t buffer_count, size_t byte_offset,
+                                   size_t* out_bytes_read) {
+    size_t bytes_read_total = 0;
+    X_STATUS result = X_STATUS_SUCCESS;
+    for (size_t i = 0; i < buffer_count; ++i) {
+      size_t bytes_read = 0;
+      result = ReadSync(buffers[i].data, buffers[i].length,
+                        byte_offset + bytes_read_total, &bytes_read);
+      if (XFAILED(result)) {
+        break;
+      }
+      bytes_read_total += bytes_read;
+      if (bytes_read < buffers[i].length) {
+        break;
+      }
+    }
+    *out_bytes_read = bytes_read_total;
+    return result;
+  }
+
   // TODO: Parameters
   virtual X_STATUS ReadAsync(void* buffer, size_t buffer_length,
                              size_t byte_offset, size_t* out_bytes_read) {
@@ -45,6 +68,8 @@ class File {
   }
 
   virtual X_STATUS SetLength(size_t length) { return X_STATUS_NOT_IMPLEMENTED; }
+  // Passes data written, but possibly still buffered, to the host.
+  virtual X_STATUS Flush() { return X_STATUS_SUCCESS; }
   virtual X_STATUS Rename(const std::filesystem::path file_path) {
     return X_STATUS_NOT_IMPLEMENTED;
   }
@@ -0,0 +1,236 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/file_access_trace.h"
+
+#include <algorithm>
+
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/memory.h"
+#include "xenia/vfs/entry.h"
+#include "xenia/vfs/virtual_file_system.h"
+
+DEFINE_bool(prefetch_title_file_reads, true,
+            "Record the file ranges read by a title after it's launched, and "
+            "read them in advance on a background thread on the next launch "
+            "to reduce loading times from slow storage.",
+            "Storage");
+DEFINE_uint32(title_file_read_trace_duration, 60,
+              "Number of seconds after launching a title during which the "
+              "file reads are recorded for prefetching.",
+              "Storage");
+
+namespace xe {
+namespace vfs {
+
+namespace {
+
+constexpr fourcc_t kFileAccessTraceSignature = make_fourcc("XFAT");
+constexpr uint32_t kFileAccessTraceVersion = 1;
+// Bounds the size of the trace if the title reads a lot of small pieces.
+constexpr size_t kMaxRecordCount = 65536;
+constexpr uint32_t kMaxPathLength = 1024;
+
+struct FileAccessTraceHeader {
+  fourcc_t signature;
+  uint32_t version;
+  uint32_t record_count;
+};
+
+// Followed by the absolute guest path of the file.
+struct FileAccessTraceRecord {
+  uint64_t offset;
+  uint64_t length;
+  uint32_t time_ms;
+  uint32_t path_length;
+};
+
+}  // namespace
+
+FileAccessTrace::FileAccessTrace(VirtualFileSystem* file_system)
+    : file_system_(file_system) {}
+
+FileAccessTrace::~FileAccessTrace() { Stop(); }
+
+void FileAccessTrace::Start(const std::filesystem::path& path) {
+  Stop();
+  if (!cvars::prefetch_title_file_reads) {
+    return;
+  }
+
+  if (LoadRecords(path, prefetch_records_) && !prefetch_records_.empty()) {
+    XELOGI("Prefetching {} file ranges read by the title on its last launch",
+           prefetch_records_.size());
+    prefetch_cancelled_.store(false, std::memory_order_relaxed);
+    prefetch_thread_ =
+        xe::threading::Thread::Create({}, [this]() { PrefetchThread(); });
+    if (prefetch_thread_) {
+      prefetch_thread_->set_name("File Prefetch");
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(recording_mutex_);
+  path_ = path;
+  start_host_ticks_ = Clock::QueryHostTickCount();
+  records_.clear();
+  is_recording_.store(true, std::memory_order_release);
+}
+
+void FileAccessTrace::Stop() {
+  CancelPrefetch();
+
+  std::lock_guard<std::mutex> lock(recording_mutex_);
+  if (path_.empty()) {
+    return;
+  }
+  is_recording_.store(false, std::memory_order_relaxed);
+  // Not replacing a trace with an empty one if the title has been closed
+  // before loading anything.
+  if (!records_.empty()) {
+    StoreRecords(path_, records_);
+  }
+  path_.clear();
+  records_.clear();
+}
+
+void FileAccessTrace::CancelPrefetch() {
+  if (prefetch_thread_) {
+    prefetch_cancelled_.store(true, std::memory_order_relaxed);
+    xe::threading::Wait(prefetch_thread_.get(), false);
+    prefetch_thread_.reset();
+  }
+  prefetch_records_.clear();
+}
+
+void FileAccessTrace::RecordRead(const Entry* entry, size_t offset,
+                                 size_t length) {
+  if (!length || !is_recording_.load(std::memory_order_acquire)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(recording_mutex_);
+  if (!is_recording_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  uint64_t time_ms = (Clock::QueryHostTickCount() - start_host_ticks_) *
+                     1000 / Clock::QueryHostTickFrequency();
+  if (time_ms >= uint64_t(cvars::title_file_read_trace_duration) * 1000 ||
+      records_.size() >= kMaxRecordCount) {
+    is_recording_.store(false, std::memory_order_relaxed);
+    return;
+  }
+  const std::string& path = entry->absolute_path();
+  if (!records_.empty()) {
+    // Sequential reads are prefetched as one range.
+    Record& last_record = records_.back();
+    if (last_record.offset + last_record.length == offset &&
+        last_record.path == path) {
+      last_record.length += length;
+      return;
+    }
+  }
+  records_.push_back({path, offset, length, uint32_t(time_ms)});
+}
+
+bool FileAccessTrace::LoadRecords(const std::filesystem::path& path,
+                                  std::vector<Record>& records) {
+  records.clear();
+  FILE* file = xe::filesystem::OpenFile(path, "rb");
+  if (!file) {
+    return false;
+  }
+  FileAccessTraceHeader header;
+  bool loaded = fread(&header, sizeof(header), 1, file) == 1 &&
+                header.signature == kFileAccessTraceSignature &&
+                header.version == kFileAccessTraceVersion &&
+                header.record_count <= kMaxRecordCount;
+  for (uint32_t i = 0; loaded && i < header.record_count; ++i) {
+    FileAccessTraceRecord trace_record;
+    if (fread(&trace_record, sizeof(trace_record), 1, file) != 1 ||
+        trace_record.path_length > kMaxPathLength) {
+      loaded = false;
+      break;
+    }
+    Record record;
+    record.offset = trace_record.offset;
+    record.length = trace_record.length;
+    record.time_ms = trace_record.time_ms;
+    record.path.resize(trace_record.path_length);
+    if (fread(record.path.data(), 1, record.path.size(), file) !=
+        record.path.size()) {
+      loaded = false;
+      break;
+    }
+    records.push_back(std::move(record));
+  }
+  fclose(file);
+  if (!loaded) {
+    XELOGW("Ignoring the invalid file access trace {}", xe::path_to_utf8(path));
+    records.clear();
+  }
+  return loaded;
+}
+
+void FileAccessTrace::StoreRecords(const std::filesystem::path& path,
+                                   const std::vector<Record>& records) {
+  std::filesystem::create_directories(path.parent_path());
+  FILE* file = xe::filesystem::OpenFile(path, "wb");
+  if (!file) {
+    return;
+  }
+  FileAccessTraceHeader header;
+  header.signature = kFileAccessTraceSignature;
+  header.version = kFileAccessTraceVersion;
+  header.record_count = uint32_t(records.size());
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+  for (size_t i = 0; written && i < records.size(); ++i) {
+    const Record& record = records[i];
+    FileAccessTraceRecord trace_record;
+    trace_record.offset = record.offset;
+    trace_record.length = record.length;
+    trace_record.time_ms = record.time_ms;
+    trace_record.path_length = uint32_t(record.path.size());
+    written = fwrite(&trace_record, sizeof(trace_record), 1, file) == 1 &&
+              fwrite(record.path.data(), 1, record.path.size(), file) ==
+                  record.path.size();
+  }
+  fclose(file);
+  if (!written) {
+    std::filesystem::remove(path);
+  }
+}
+
+void FileAccessTrace::PrefetchThread() {
+  // Prefetched in the order of the original reads, as far ahead of the title
+  // as the storage allows.
+  uint64_t start_host_ticks = Clock::QueryHostTickCount();
+  uint64_t prefetched_bytes = 0;
+  for (const Record& record : prefetch_records_) {
+    if (prefetch_cancelled_.load(std::memory_order_relaxed)) {
+      return;
+    }
+    Entry* entry = file_system_->ResolvePath(record.path);
+    if (!entry || record.offset >= entry->size()) {
+      continue;
+    }
+    size_t length = size_t(
+        std::min(record.length, uint64_t(entry->size()) - record.offset));
+    entry->Prefetch(size_t(record.offset), length);
+    prefetched_bytes += length;
+  }
+  XELOGI("Prefetched {} MB of title files in {} ms",
+         prefetched_bytes / (1024 * 1024),
+         (Clock::QueryHostTickCount() - start_host_ticks) * 1000 /
+             Clock::QueryHostTickFrequency());
+}
+
+}  // namespace vfs
+}  // namespace xe
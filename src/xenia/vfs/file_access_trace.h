@@ -0,0 +1,81 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Xenia Canary. All rights reserved.                          *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_VFS_FILE_ACCESS_TRACE_H_
+#define XENIA_VFS_FILE_ACCESS_TRACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "xenia/base/threading.h"
+
+namespace xe {
+namespace vfs {
+
+class Entry;
+class VirtualFileSystem;
+
+// Records the file ranges read by a title in the beginning of its execution.
+// On the next launch of the title, the recorded ranges are read in advance on
+// a background thread, so they're already in the page cache of the host when
+// the title requests them, which mostly helps loading from hard drives and
+// network storage.
+class FileAccessTrace {
+ public:
+  explicit FileAccessTrace(VirtualFileSystem* file_system);
+  ~FileAccessTrace();
+
+  // Prefetches the ranges recorded in the trace at the path, if it exists,
+  // and starts recording the new trace replacing it.
+  void Start(const std::filesystem::path& path);
+  // Stops prefetching and stores the recorded trace.
+  void Stop();
+  // Must be called before devices are removed while the prefetch thread may be
+  // accessing their entries, without holding the global lock.
+  void CancelPrefetch();
+
+  void RecordRead(const Entry* entry, size_t offset, size_t length);
+
+ private:
+  struct Record {
+    std::string path;
+    uint64_t offset;
+    uint64_t length;
+    // Since the start of the recording.
+    uint32_t time_ms;
+  };
+
+  static bool LoadRecords(const std::filesystem::path& path,
+                          std::vector<Record>& records);
+  static void StoreRecords(const std::filesystem::path& path,
+                           const std::vector<Record>& records);
+  void PrefetchThread();
+
+  VirtualFileSystem* file_system_;
+
+  std::atomic<bool> is_recording_{false};
+  std::mutex recording_mutex_;
+  std::filesystem::path path_;
+  uint64_t start_host_ticks_ = 0;
+  std::vector<Record> records_;
+
+  std::vector<Record> prefetch_records_;
+  std::atomic<bool> prefetch_cancelled_{false};
+  std::unique_ptr<xe::threading::Thread> prefetch_thread_;
+};
+
+}  // namespace vfs
+}  // namespace xe
+
+#endif  // XENIA_VFS_FILE_ACCESS_TRACE_H_
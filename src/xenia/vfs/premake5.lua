@@ -29,6 +29,8 @@ project("xenia-vfs-dump")
     "fmt",
     "xenia-base",
     "xenia-vfs",
+    "zarchive",
+    "zstd",
   })
   defines({})
 
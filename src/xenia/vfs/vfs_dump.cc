@@ -13,10 +13,14 @@
 
 #include "xenia/base/console_app_main.h"
 #include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 
+#include "xenia/vfs/devices/compressed_disc_image_device.h"
+#include "xenia/vfs/devices/disc_image_device.h"
+#include "xenia/vfs/devices/disc_zarchive_device.h"
 #include "xenia/vfs/devices/xcontent_container_device.h"
 #include "xenia/vfs/file.h"
 #include "xenia/vfs/virtual_file_system.h"
@@ -30,6 +34,48 @@ DEFINE_transient_path(source, "", "Specifies the file to dump from.",
 DEFINE_transient_path(dump_path, "",
                       "Specifies the directory to dump files to.", "General");
 
+DEFINE_transient_bool(compress_disc_image, false,
+                      "Converts the source disc image to a compressed disc "
+                      "image (.xcz) at dump_path instead of dumping its files.",
+                      "General");
+
+// Picks the device by the signature at the beginning or, for ZArchive, at the
+// end of the file, falling back to a GDFX disc image without a header.
+static std::unique_ptr<Device> CreateSourceDevice(
+    const std::filesystem::path& path) {
+  FILE* file = xe::filesystem::OpenFile(path, "rb");
+  if (!file) {
+    XELOGE("Unable to open {}", xe::path_to_utf8(path));
+    return nullptr;
+  }
+  char head_magic[4] = {};
+  char tail_magic[4] = {};
+  bool is_read = fread(head_magic, sizeof(head_magic), 1, file) == 1 &&
+                 xe::filesystem::Seek(file, -int64_t(sizeof(tail_magic)),
+                                      SEEK_END) &&
+                 fread(tail_magic, sizeof(tail_magic), 1, file) == 1;
+  fclose(file);
+  if (!is_read) {
+    XELOGE("{} is too small to be a package", xe::path_to_utf8(path));
+    return nullptr;
+  }
+
+  if (make_fourcc(head_magic[0], head_magic[1], head_magic[2],
+                  head_magic[3]) == kCompressedDiscImageSignature) {
+    return std::make_unique<CompressedDiscImageDevice>("", path);
+  }
+  if (make_fourcc(tail_magic[0], tail_magic[1], tail_magic[2],
+                  tail_magic[3]) == kZarMagic) {
+    return std::make_unique<DiscZarchiveDevice>("", path);
+  }
+  std::unique_ptr<Device> device =
+      XContentContainerDevice::CreateContentDevice("", path);
+  if (device) {
+    return device;
+  }
+  return std::make_unique<DiscImageDevice>("", path);
+}
+
 int vfs_dump_main(const std::vector<std::string>& args) {
   if (cvars::source.empty() || cvars::dump_path.empty()) {
     XELOGE("Usage: {} [source] [dump_path]", xe::path_to_utf8(args[0]));
@@ -37,14 +83,30 @@ int vfs_dump_main(const std::vector<std::string>& args) {
   }
 
   std::filesystem::path base_path = cvars::dump_path;
-  std::unique_ptr<vfs::Device> device =
-      vfs::XContentContainerDevice::CreateContentDevice("", cvars::source);
+  if (cvars::compress_disc_image) {
+    // Only disc images with a valid file system are converted.
+    DiscImageDevice disc_image_device("", cvars::source);
+    if (!disc_image_device.Initialize()) {
+      XELOGE("{} is not a disc image", xe::path_to_utf8(cvars::source));
+      return 1;
+    }
+    if (!CompressedDiscImageDevice::Compress(cvars::source, base_path)) {
+      return 1;
+    }
+    return 0;
+  }
 
-  if (!device->Initialize()) {
+  std::unique_ptr<vfs::Device> device = CreateSourceDevice(cvars::source);
+
+  if (!device || !device->Initialize()) {
     XELOGE("Failed to initialize device");
     return 1;
   }
-  return VirtualFileSystem::ExtractContentFiles(device.get(), base_path);
+  if (VirtualFileSystem::ExtractContentFiles(device.get(), base_path) !=
+      X_STATUS_SUCCESS) {
+    return 1;
+  }
+  return 0;
 }
 
 }  // namespace vfs
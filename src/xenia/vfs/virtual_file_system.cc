@@ -11,28 +11,56 @@
 #include "xenia/kernel/xam/content_manager.h"
 #include "xenia/vfs/devices/xcontent_container_device.h"
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
 #include "devices/host_path_entry.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/string.h"
+#include "xenia/base/threading.h"
 #include "xenia/kernel/xfile.h"
 
+DEFINE_uint32(vfs_statistics_log_interval, 0,
+              "Interval in milliseconds for logging the guest I/O statistics "
+              "of the mounted devices, 0 to disable.",
+              "Storage");
+
 namespace xe {
 namespace vfs {
 
 using namespace xe::literals;
 
-VirtualFileSystem::VirtualFileSystem() {}
+VirtualFileSystem::VirtualFileSystem() : access_trace_(this) {
+  if (cvars::vfs_statistics_log_interval) {
+    statistics_log_shutdown_event_ =
+        xe::threading::Event::CreateManualResetEvent(false);
+    statistics_log_thread_ =
+        xe::threading::Thread::Create({}, [this]() { StatisticsLogThread(); });
+    statistics_log_thread_->set_name("VFS Statistics Log");
+  }
+}
 
 VirtualFileSystem::~VirtualFileSystem() {
+  if (statistics_log_thread_) {
+    statistics_log_shutdown_event_->Set();
+    xe::threading::Wait(statistics_log_thread_.get(), false);
+    statistics_log_thread_.reset();
+  }
   // Delete all devices.
   // This will explode if anyone is still using data from them.
   Clear();
 }
 
 void VirtualFileSystem::Clear() {
+  access_trace_.Stop();
   devices_.clear();
   symlinks_.clear();
+  resolved_symlink_cache_.clear();
 }
 
 bool VirtualFileSystem::RegisterDevice(std::unique_ptr<Device> device) {
@@ -42,6 +70,9 @@ bool VirtualFileSystem::RegisterDevice(std::unique_ptr<Device> device) {
 }
 
 bool VirtualFileSystem::UnregisterDevice(const std::string_view path) {
+  // The prefetch thread may be using the entries of the device, and it takes
+  // the global lock to resolve paths.
+  access_trace_.CancelPrefetch();
   auto global_lock = global_critical_region_.Acquire();
   for (auto it = devices_.begin(); it != devices_.end(); ++it) {
     if ((*it)->mount_path() == path) {
@@ -53,10 +84,73 @@ bool VirtualFileSystem::UnregisterDevice(const std::string_view path) {
   return false;
 }
 
+void VirtualFileSystem::GetDeviceStatistics(
+    std::vector<DeviceStatistics>& statistics) {
+  auto global_lock = global_critical_region_.Acquire();
+  statistics.resize(devices_.size());
+  for (size_t i = 0; i < devices_.size(); ++i) {
+    devices_[i]->GetStatistics(statistics[i]);
+  }
+}
+
+void VirtualFileSystem::StatisticsLogThread() {
+  std::vector<DeviceStatistics> statistics;
+  std::vector<DeviceStatistics> last_statistics;
+  uint64_t last_host_ticks = Clock::QueryHostTickCount();
+  double ticks_to_us =
+      1000000.0 / static_cast<double>(Clock::QueryHostTickFrequency());
+  while (xe::threading::Wait(statistics_log_shutdown_event_.get(), false,
+                             std::chrono::milliseconds(
+                                 cvars::vfs_statistics_log_interval)) ==
+         xe::threading::WaitResult::kTimeout) {
+    GetDeviceStatistics(statistics);
+    uint64_t host_ticks = Clock::QueryHostTickCount();
+    double seconds = double(host_ticks - last_host_ticks) /
+                     double(Clock::QueryHostTickFrequency());
+    last_host_ticks = host_ticks;
+    for (const DeviceStatistics& device : statistics) {
+      // Devices may have been mounted since, or remounted at the same path.
+      auto last_it = std::find_if(
+          last_statistics.cbegin(), last_statistics.cend(),
+          [&](const DeviceStatistics& last_device) {
+            return last_device.mount_path == device.mount_path &&
+                   last_device.read_count <= device.read_count &&
+                   last_device.read_bytes <= device.read_bytes;
+          });
+      uint64_t reads = device.read_count;
+      uint64_t read_bytes = device.read_bytes;
+      uint64_t read_host_ticks = device.read_host_ticks;
+      if (last_it != last_statistics.cend()) {
+        reads -= last_it->read_count;
+        read_bytes -= last_it->read_bytes;
+        read_host_ticks -= last_it->read_host_ticks;
+        if (!reads && device.write_count == last_it->write_count) {
+          // Idle, not worth a line.
+          continue;
+        }
+      }
+      // Key-value pairs so the lines can be parsed by scripts.
+      XELOGI(
+          "VFS statistics: device={} type={} reads={} read_bytes={} "
+          "reads_per_second={:.1f} read_mb_per_second={:.2f} "
+          "read_average_us={:.1f} read_max_us={:.1f} writes={} "
+          "write_bytes={} cache_hits={} cache_misses={}",
+          device.mount_path, device.name, device.read_count,
+          device.read_bytes, seconds > 0.0 ? reads / seconds : 0.0,
+          seconds > 0.0 ? read_bytes / double(1_MiB) / seconds : 0.0,
+          reads ? read_host_ticks * ticks_to_us / reads : 0.0,
+          device.read_max_host_ticks * ticks_to_us, device.write_count,
+          device.write_bytes, device.cache_hit_count, device.cache_miss_count);
+    }
+    std::swap(statistics, last_statistics);
+  }
+}
+
 bool VirtualFileSystem::RegisterSymbolicLink(const std::string_view path,
                                              const std::string_view target) {
   auto global_lock = global_critical_region_.Acquire();
   symlinks_.insert({std::string(path), std::string(target)});
+  resolved_symlink_cache_.clear();
   XELOGD("Registered symbolic link: {} => {}", path, target);
 
   return true;
@@ -73,6 +167,7 @@ bool VirtualFileSystem::UnregisterSymbolicLink(const std::string_view path) {
   XELOGD("Unregistered symbolic link: {} => {}", it->first, it->second);
 
   symlinks_.erase(it);
+  resolved_symlink_cache_.clear();
   return true;
 }
 
@@ -116,9 +211,22 @@ Entry* VirtualFileSystem::ResolvePath(const std::string_view path) {
   auto normalized_path(xe::utf8::canonicalize_guest_path(path));
 
   // Resolve symlinks.
-  std::string resolved_path;
-  if (ResolveSymbolicLink(normalized_path, resolved_path)) {
-    normalized_path = resolved_path;
+  auto cached_it = resolved_symlink_cache_.find(normalized_path);
+  if (cached_it != resolved_symlink_cache_.end()) {
+    normalized_path = cached_it->second;
+  } else {
+    // Keep the cache bounded for titles enumerating many distinct paths.
+    constexpr size_t kMaxResolvedSymlinkCacheSize = 4096;
+    if (resolved_symlink_cache_.size() >= kMaxResolvedSymlinkCacheSize) {
+      resolved_symlink_cache_.clear();
+    }
+    std::string resolved_path;
+    if (ResolveSymbolicLink(normalized_path, resolved_path)) {
+      resolved_symlink_cache_.emplace(normalized_path, resolved_path);
+      normalized_path = resolved_path;
+    } else {
+      resolved_symlink_cache_.emplace(normalized_path, normalized_path);
+    }
   }
 
   // Find the device.
@@ -333,13 +441,72 @@ X_STATUS VirtualFileSystem::OpenFile(Entry* root_entry,
   return result;
 }
 
+namespace {
+
+// Files larger than this are extracted in chunks of this size on multiple
+// threads, so a single multi-gigabyte file in a title update or a DLC package
+// doesn't leave all the other threads idle.
+constexpr size_t kExtractionChunkSize = 64_MiB;
+
+bool WriteFully(xe::filesystem::FileHandle* file, size_t offset,
+                const uint8_t* data, size_t length) {
+  while (length) {
+    size_t bytes_written = 0;
+    if (!file->Write(offset, data, length, &bytes_written) || !bytes_written) {
+      return false;
+    }
+    offset += bytes_written;
+    data += bytes_written;
+    length -= bytes_written;
+  }
+  return true;
+}
+
+// Copies a range of the file to the same offset in a destination file already
+// created with the full size, so the chunks of the file can be extracted in
+// any order.
+X_STATUS ExtractContentFileChunk(Entry* entry,
+                                 xe::filesystem::FileHandle* dest_file,
+                                 size_t offset, size_t length) {
+  if (entry->can_map()) {
+    std::unique_ptr<MappedMemory> map =
+        entry->OpenMapped(xe::MappedMemory::Mode::kRead, offset, length);
+    if (map) {
+      bool written = WriteFully(dest_file, offset, map->data(), map->size());
+      map->Close();
+      return written ? X_STATUS_SUCCESS : X_STATUS_UNSUCCESSFUL;
+    }
+  }
+
+  vfs::File* in_file = nullptr;
+  X_STATUS result = entry->Open(FileAccess::kFileReadData, &in_file);
+  if (result != X_STATUS_SUCCESS) {
+    return result;
+  }
+  constexpr size_t kCopyChunkSize = 4_MiB;
+  std::vector<uint8_t> buffer(std::min(length, kCopyChunkSize));
+  size_t end = offset + length;
+  while (offset < end) {
+    size_t bytes_read = 0;
+    if (in_file->ReadSync(buffer.data(),
+                          std::min(buffer.size(), end - offset), offset,
+                          &bytes_read) != X_STATUS_SUCCESS ||
+        !bytes_read ||
+        !WriteFully(dest_file, offset, buffer.data(), bytes_read)) {
+      result = X_STATUS_UNSUCCESSFUL;
+      break;
+    }
+    offset += bytes_read;
+  }
+  in_file->Destroy();
+  return result;
+}
+
+}  // namespace
+
 X_STATUS VirtualFileSystem::ExtractContentFile(Entry* entry,
                                                std::filesystem::path base_path,
                                                bool extract_to_root) {
-  // Allocate a buffer when needed.
-  size_t buffer_size = 0;
-  uint8_t* buffer = nullptr;
-
   XELOGI("Extracting file: {}", entry->path());
 
   auto dest_name = base_path / xe::to_path(entry->path());
@@ -369,40 +536,53 @@ X_STATUS VirtualFileSystem::ExtractContentFile(Entry* entry,
     return 1;
   }
 
-  if (entry->can_map()) {
-    auto map = entry->OpenMapped(xe::MappedMemory::Mode::kRead);
-    fwrite(map->data(), map->size(), 1, file);
+  result = X_STATUS_SUCCESS;
+  std::unique_ptr<MappedMemory> map;
+  if (entry->size() && entry->can_map()) {
+    map = entry->OpenMapped(xe::MappedMemory::Mode::kRead);
+  }
+  if (map) {
+    if (fwrite(map->data(), map->size(), 1, file) != 1) {
+      result = X_STATUS_UNSUCCESSFUL;
+    }
     map->Close();
-  } else {
-    // Can't map the file into memory. Read it into a temporary buffer.
-    if (!buffer || entry->size() > buffer_size) {
-      // Resize the buffer.
-      if (buffer) {
-        delete[] buffer;
+  } else if (entry->size()) {
+    // Can't map the file into memory. Copy it through a buffer, in chunks so
+    // extracting many large files at once doesn't need much memory.
+    constexpr size_t kCopyChunkSize = 4_MiB;
+    std::vector<uint8_t> buffer(std::min(entry->size(), kCopyChunkSize));
+    size_t offset = 0;
+    while (offset < entry->size()) {
+      size_t bytes_read = 0;
+      if (in_file->ReadSync(buffer.data(),
+                            std::min(buffer.size(), entry->size() - offset),
+                            offset, &bytes_read) != X_STATUS_SUCCESS ||
+          !bytes_read) {
+        result = X_STATUS_UNSUCCESSFUL;
+        break;
       }
-
-      // Allocate a buffer rounded up to the nearest 512MB.
-      buffer_size = xe::round_up(entry->size(), 512_MiB);
-      buffer = new uint8_t[buffer_size];
+      if (fwrite(buffer.data(), 1, bytes_read, file) != bytes_read) {
+        result = X_STATUS_UNSUCCESSFUL;
+        break;
+      }
+      offset += bytes_read;
     }
-
-    size_t bytes_read = 0;
-    in_file->ReadSync(buffer, entry->size(), 0, &bytes_read);
-    fwrite(buffer, bytes_read, 1, file);
   }
 
   fclose(file);
   in_file->Destroy();
-
-  if (buffer) {
-    delete[] buffer;
+  if (result != X_STATUS_SUCCESS) {
+    XELOGE("Failed to extract file: {}", entry->path());
   }
-  return 0;
+  return result;
 }
 
 X_STATUS VirtualFileSystem::ExtractContentFiles(
     Device* device, std::filesystem::path base_path) {
-  // Run through all the files, breadth-first style.
+  // Run through all the files, breadth-first style, creating the directories
+  // right away so the files can then be extracted in any order.
+  std::vector<vfs::Entry*> files;
+  uint64_t total_size = 0;
   std::queue<vfs::Entry*> queue;
   auto root = device->ResolvePath("/");
   queue.push(root);
@@ -414,9 +594,107 @@ X_STATUS VirtualFileSystem::ExtractContentFiles(
       queue.push(entry.get());
     }
 
-    ExtractContentFile(entry, base_path);
+    if (entry->attributes() & kFileAttributeDirectory) {
+      ExtractContentFile(entry, base_path);
+    } else {
+      files.push_back(entry);
+      total_size += entry->size();
+    }
   }
-  return X_STATUS_SUCCESS;
+
+  const uint64_t start_host_ticks = Clock::QueryHostTickCount();
+  const uint64_t host_tick_frequency = Clock::QueryHostTickFrequency();
+  std::atomic<X_STATUS> first_error{X_STATUS_SUCCESS};
+  auto report_error = [&first_error](X_STATUS result) {
+    X_STATUS expected = X_STATUS_SUCCESS;
+    first_error.compare_exchange_strong(expected, result);
+  };
+
+  // Small files are extracted whole, large ones are created with their full
+  // size first and then extracted in chunks.
+  struct ExtractionJob {
+    vfs::Entry* entry;
+    // nullptr to extract the whole file.
+    xe::filesystem::FileHandle* dest_file;
+    size_t offset;
+    size_t length;
+  };
+  std::vector<ExtractionJob> jobs;
+  std::vector<std::unique_ptr<xe::filesystem::FileHandle>> chunked_files;
+  for (vfs::Entry* entry : files) {
+    if (entry->size() <= kExtractionChunkSize) {
+      jobs.push_back({entry, nullptr, 0, entry->size()});
+      continue;
+    }
+    auto dest_name = base_path / xe::to_path(entry->path());
+    std::unique_ptr<xe::filesystem::FileHandle> dest_file;
+    if (xe::filesystem::CreateEmptyFile(dest_name)) {
+      dest_file = xe::filesystem::FileHandle::OpenExisting(
+          dest_name, xe::filesystem::FileAccess::kFileWriteData);
+    }
+    if (!dest_file || !dest_file->SetLength(entry->size())) {
+      XELOGE("Failed to extract file: {}", entry->path());
+      report_error(X_STATUS_UNSUCCESSFUL);
+      continue;
+    }
+    for (size_t offset = 0; offset < entry->size();
+         offset += kExtractionChunkSize) {
+      jobs.push_back({entry, dest_file.get(), offset,
+                      std::min(entry->size() - offset, kExtractionChunkSize)});
+    }
+    chunked_files.push_back(std::move(dest_file));
+  }
+
+  // Largest first, so a big file isn't left for the end, extracted by a
+  // single thread while the others are idle.
+  std::stable_sort(jobs.begin(), jobs.end(),
+                   [](const ExtractionJob& a, const ExtractionJob& b) {
+                     return a.length > b.length;
+                   });
+
+  std::atomic<uint64_t> last_report_host_ticks{start_host_ticks};
+  std::atomic<size_t> extracted_job_count{0};
+  std::atomic<uint64_t> extracted_size{0};
+  auto get_throughput = [&](uint64_t size, uint64_t host_ticks) {
+    double seconds = double(host_ticks - start_host_ticks) /
+                     double(host_tick_frequency);
+    return seconds > 0.0 ? double(size) / double(1_MiB) / seconds : 0.0;
+  };
+  xe::threading::ParallelFor(
+      jobs.size(), "VFS Extraction", [&](size_t job_index) {
+        const ExtractionJob& job = jobs[job_index];
+        X_STATUS result;
+        if (job.dest_file) {
+          result = ExtractContentFileChunk(job.entry, job.dest_file,
+                                           job.offset, job.length);
+          if (result != X_STATUS_SUCCESS) {
+            XELOGE("Failed to extract file: {}", job.entry->path());
+          }
+        } else {
+          result = ExtractContentFile(job.entry, base_path);
+        }
+        if (result != X_STATUS_SUCCESS) {
+          report_error(result);
+        }
+        size_t job_count = extracted_job_count.fetch_add(1) + 1;
+        uint64_t size = extracted_size.fetch_add(job.length) + job.length;
+        // Reported at most once a second, by whichever thread notices first.
+        uint64_t host_ticks = Clock::QueryHostTickCount();
+        uint64_t last_host_ticks = last_report_host_ticks.load();
+        if (host_ticks - last_host_ticks >= host_tick_frequency &&
+            last_report_host_ticks.compare_exchange_strong(last_host_ticks,
+                                                           host_ticks)) {
+          XELOGI(
+              "Extracted {} of {} files and chunks, {} of {} MB, {:.1f} MB/s",
+              job_count, jobs.size(), size / 1_MiB, total_size / 1_MiB,
+              get_throughput(size, host_ticks));
+        }
+      });
+  chunked_files.clear();
+  XELOGI("Extracted {} files, {} MB, at {:.1f} MB/s", files.size(),
+         total_size / 1_MiB,
+         get_throughput(total_size, Clock::QueryHostTickCount()));
+  return first_error.load();
 }
 
 void VirtualFileSystem::ExtractContentHeader(Device* device,
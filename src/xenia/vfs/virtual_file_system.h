@@ -16,9 +16,11 @@
 #include <vector>
 
 #include "xenia/base/mutex.h"
+#include "xenia/base/threading.h"
 #include "xenia/vfs/device.h"
 #include "xenia/vfs/entry.h"
 #include "xenia/vfs/file.h"
+#include "xenia/vfs/file_access_trace.h"
 
 namespace xe {
 namespace vfs {
@@ -57,12 +59,30 @@ class VirtualFileSystem {
   static void ExtractContentHeader(Device* device,
                                    std::filesystem::path base_path);
 
+  FileAccessTrace& access_trace() { return access_trace_; }
+
+  // The I/O statistics of the mounted devices, in the order of registration.
+  void GetDeviceStatistics(std::vector<DeviceStatistics>& statistics);
+
  private:
   xe::global_critical_region global_critical_region_;
   std::vector<std::unique_ptr<Device>> devices_;
   std::unordered_map<std::string, std::string> symlinks_;
+  // Canonicalized guest paths to the paths with the symbolic links resolved,
+  // cleared whenever the links change. Titles open files through the same
+  // few links over and over, and every resolution otherwise checks all links
+  // as prefixes, repeatedly until none matches.
+  std::unordered_map<std::string, std::string> resolved_symlink_cache_;
+  FileAccessTrace access_trace_;
 
   bool ResolveSymbolicLink(const std::string_view path, std::string& result);
+
+  // Logs the statistics of the devices, while vfs_statistics_log_interval is
+  // not 0.
+  void StatisticsLogThread();
+
+  std::unique_ptr<xe::threading::Event> statistics_log_shutdown_event_;
+  std::unique_ptr<xe::threading::Thread> statistics_log_thread_;
 };
 
 }  // namespace vfs